@@ -53,6 +53,7 @@ contains(QT_CONFIG, opengl):!no-gl:!no-widgets {
 !no-avfilter: OptionalDepends *= avfilter
 ## sse2 sse4_1 may be defined in Qt5 qmodule.pri but is not included. Qt4 defines sse and sse2
 !no-sse4_1:!sse4_1: OptionalDepends *= sse4_1
+!no-avx2:!avx2: OptionalDepends *= avx2
 # no-xxx can set in $$PWD/user.conf
 !no-openal: OptionalDepends *= openal
 !no-portaudio: OptionalDepends *= portaudio
@@ -63,6 +64,7 @@ win32 {
   !no-direct2d:!no-widgets: OptionalDepends *= direct2d
   !no-gdiplus:!no-widgets: OptionalDepends *= gdiplus
   !no-dxva: OptionalDepends *= dxva
+  !no-d3d11va: OptionalDepends *= d3d11va
 }
 unix {
   !no-pulseaudio: OptionalDepends *= pulseaudio
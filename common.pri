@@ -176,18 +176,22 @@ config_simd {
 win32-icc {
   QMAKE_CFLAGS_SSE2 = -arch:SSE2
   QMAKE_CFLAGS_SSE4_1 = -arch:SSE4.1
+  QMAKE_CFLAGS_AVX2 = -arch:CORE-AVX2
 } else:*-icc { #mac, linux
   QMAKE_CFLAGS_SSE2 = -xSSE2
   QMAKE_CFLAGS_SSE4_1 = -xSSE4.1
+  QMAKE_CFLAGS_AVX2 = -xCORE-AVX2
 } else:*msvc* {
 # all x64 processors supports sse2. unknown option for vc
   #!isEqual(QT_ARCH, x86_64)|!x86_64 {
     QMAKE_CFLAGS_SSE2 = -arch:SSE2
     QMAKE_CFLAGS_SSE4_1 = -arch:SSE2
   #}
+  QMAKE_CFLAGS_AVX2 = -arch:AVX2
 } else {
   QMAKE_CFLAGS_SSE2 = -msse2
   QMAKE_CFLAGS_SSE4_1 = -msse4.1
+  QMAKE_CFLAGS_AVX2 = -mavx2
 }
 
 #mac: simd will load qt_build_config and the result is soname will prefixed with QT_INSTALL_LIBS and link flag will append soname after QMAKE_LFLAGS_SONAME
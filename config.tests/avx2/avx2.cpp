@@ -0,0 +1,33 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <immintrin.h>
+
+int main(int, char**)
+{
+    __m256i src[2];
+    src[0] = _mm256_set1_epi32(42);
+    src[1] = _mm256_add_epi32(src[0], _mm256_set1_epi32(64)); // avx2
+    __m256i result = _mm256_stream_load_si256(src);
+    (void)result;
+    _mm256_zeroupper();
+    return 0;
+}
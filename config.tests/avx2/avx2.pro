@@ -0,0 +1,17 @@
+SOURCES = avx2.cpp
+CONFIG -= qt dylib release debug_and_release
+CONFIG += debug console
+
+# streaming load of 256 bits is AVX2
+win32-icc {
+  QMAKE_CFLAGS_AVX2 = -arch:CORE-AVX2
+} else:*-icc { #mac, linux
+  QMAKE_CFLAGS_AVX2 = -xCORE-AVX2
+} else:*msvc* {
+  QMAKE_CFLAGS_AVX2 = -arch:AVX2
+} else {
+  QMAKE_CFLAGS_AVX2 = -mavx2
+}
+
+isEmpty(QMAKE_CFLAGS_AVX2):error("This compiler does not support AVX2")
+else:QMAKE_CXXFLAGS += $$QMAKE_CFLAGS_AVX2
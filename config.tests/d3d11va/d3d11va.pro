@@ -0,0 +1,5 @@
+CONFIG -= qt
+CONFIG += console
+
+SOURCES += main.cpp
+include(../paths.pri)
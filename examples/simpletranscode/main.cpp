@@ -20,6 +20,7 @@
 
 #include <QApplication>
 #include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
 #include <QtAV>
 #include <QtAV/AVTranscoder.h>
 using namespace QtAV;
@@ -28,11 +29,13 @@ int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
     qDebug("QtAV simpletranscode");
-    qDebug("./simpletranscode -i infile -o outfile [-c:v video_codec (default: libx264)] [-f format]");
+    qDebug("./simpletranscode -i infile -o outfile [-c:v video_codec (default: libx264)] [-f format] [-async] [-ss start_ms] [-t duration_ms]");
+    qDebug("-c:v copy, -c:a copy: copy the stream without decoding and encoding");
     qDebug() << "examples:\n"
              << "./simpletranscode -i test.mp4 -o /tmp/test-%05d.png -f image2 -c:v png\n"
              << "./simpletranscode -i test.mp4 -o /tmp/bbb%04d.ts -f segment\n"
              << "./simpletranscode -i test.mp4 -o /tmp/test.mkv\n"
+             << "./simpletranscode -i test.mp4 -o /tmp/cut.mkv -c:v copy -c:a copy -ss 60000 -t 10000\n"
              ;
     if (a.arguments().contains(QString::fromLatin1("-h"))) {
         return 0;
@@ -68,14 +71,28 @@ int main(int argc, char *argv[])
 
     AVPlayer player;
     player.setFile(file);
-    player.setFrameRate(1000.0); // as fast as possible
+    player.setOfflineMode(true); // as fast as possible, no clock waits and no frame drop
     player.audio()->setBackends(QStringList() << QString::fromLatin1("null"));
+    idx = a.arguments().indexOf(QLatin1String("-ss"));
+    if (idx > 0)
+        player.setStartPosition(a.arguments().at(idx + 1).toLongLong());
+    idx = a.arguments().indexOf(QLatin1String("-t"));
+    if (idx > 0)
+        player.setStopPosition(player.startPosition() + a.arguments().at(idx + 1).toLongLong());
     AVTranscoder avt;
     avt.setMediaSource(&player);
     avt.setOutputMedia(outFile);
     avt.setOutputOptions(muxopt);
     if (!fmt.isEmpty())
         avt.setOutputFormat(fmt); // segment, image2
+    const bool copy_video = cv == QLatin1String("copy");
+    const bool copy_audio = ca == QLatin1String("copy");
+    if (copy_video || copy_audio) {
+        avt.setStreamCopy(copy_video, copy_audio);
+        QObject::connect(&avt, SIGNAL(stopped()), qApp, SLOT(quit()));
+        avt.start(); // the player is not played
+        return a.exec();
+    }
     if (!avt.createVideoEncoder()) {
         qWarning("Failed to create video encoder");
         return 1;
@@ -86,9 +103,16 @@ int main(int argc, char *argv[])
     if (fmt == QLatin1String("image2"))
         venc->setPixelFormat(VideoFormat::Format_RGBA32);
 
+    // encode video, audio and mux in parallel threads
+    avt.setAsync(a.arguments().contains(QLatin1String("-async")));
+
     QObject::connect(&avt, SIGNAL(stopped()), qApp, SLOT(quit()));
+    QElapsedTimer timer;
+    timer.start();
     avt.start(); //start transcoder first
     player.play();
 
-    return a.exec();
+    const int ret = a.exec();
+    qDebug("transcoded in %lld ms (async: %d)", timer.elapsed(), avt.isAsync());
+    return ret;
 }
@@ -31,18 +31,25 @@
 #include <QMimeData>
 #include <QtCore/QUrl>
 #include <QtAV/AudioOutput.h>
+#include <QtAV/VideoWallManager.h>
 #include <QtAVWidgets>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QtAVWidgets/OpenGLVideoWall.h>
+#define HAVE_GLWALL 1
+#endif
 
 using namespace QtAV;
-const int kSyncInterval = 2000;
 
 VideoWall::VideoWall(QObject *parent) :
-    QObject(parent),r(3),c(3),view(0),menu(0)
+    QObject(parent),r(3),c(3),view(0),menu(0),glwall(0)
   , vid(QString::fromLatin1("qpainter"))
 {
     QtAV::Widgets::registerRenderers();
     clock = new AVClock(this);
     clock->setClockType(AVClock::ExternalClock);
+    // hidden tiles are paused and small tiles decode at their size. all players follow clock
+    manager = new VideoWallManager(this);
+    manager->setClock(clock);
     view = new QWidget;
     if (view) {
         qDebug("WA_OpaquePaintEvent=%d", view->testAttribute(Qt::WA_OpaquePaintEvent));
@@ -66,8 +73,8 @@ VideoWall::~VideoWall()
                 renderer->widget()->close(); //TODO: rename
                 if (!renderer->widget()->testAttribute(Qt::WA_DeleteOnClose) && !renderer->widget()->parent())
                     delete renderer;
-                delete player;
             }
+            delete player; // renderers of glwall are owned by the wall
         }
         players.clear();
     }
@@ -109,8 +116,8 @@ void VideoWall::show()
                 renderer->widget()->close();
                 if (!renderer->widget()->testAttribute(Qt::WA_DeleteOnClose) && !renderer->widget()->parent())
                     delete renderer;
-                delete player;
             }
+            delete player; // renderers of glwall are owned by the wall
         }
         players.clear();
     }
@@ -118,7 +125,7 @@ void VideoWall::show()
 
     int w = view ? view->frameGeometry().width()/c : qApp->desktop()->width()/c;
     int h = view ? view->frameGeometry().height()/r : qApp->desktop()->height()/r;
-    if (view) {
+    if (view && !view->layout()) {
         QGridLayout *layout = new QGridLayout;
         layout->setSizeConstraint(QLayout::SetMaximumSize);
         layout->setSpacing(1);
@@ -126,6 +133,30 @@ void VideoWall::show()
         layout->setContentsMargins(0, 0, 0, 0);
         view->setLayout(layout);
     }
+#if HAVE_GLWALL
+    if (vid == QLatin1String("glwall")) {
+        // all videos are composited in 1 widget, i.e. 1 context and 1 swap for the whole wall
+        if (!glwall) {
+            glwall = new OpenGLVideoWall(view);
+            glwall->resize(w*c, h*r);
+            if (view)
+                ((QGridLayout*)view->layout())->addWidget(glwall, 0, 0);
+            glwall->show();
+        }
+        glwall->setGrid(r, c);
+        for (int i = 0; i < r; ++i) {
+            for (int j = 0; j < c; ++j) {
+                AVPlayer *player = new AVPlayer;
+                player->setRenderer(glwall->renderer(i, j));
+                player->masterClock()->setClockAuto(false);
+                player->masterClock()->setClockType(AVClock::ExternalClock);
+                manager->addPlayer(player);
+                players.append(player);
+            }
+        }
+        return;
+    }
+#endif //HAVE_GLWALL
 
     VideoRendererId v = VideoRendererId_Widget;
     if (vid == QLatin1String("gl"))
@@ -147,6 +178,7 @@ void VideoWall::show()
             player->setRenderer(renderer);
             player->masterClock()->setClockAuto(false);
             player->masterClock()->setClockType(AVClock::ExternalClock);
+            manager->addPlayer(player);
             players.append(player);
             if (view)
                 ((QGridLayout*)view->layout())->addWidget(renderer->widget(), i, j);
@@ -163,13 +195,11 @@ void VideoWall::play(const QString &file)
     foreach (AVPlayer *player, players) {
         player->play(file);
     }
-    timer_id = startTimer(kSyncInterval);
 }
 
 void VideoWall::stop()
 {
     clock->reset();
-    killTimer(timer_id);
     foreach (AVPlayer* player, players) {
         player->stop(); //check playing?
     }
@@ -183,7 +213,6 @@ void VideoWall::openLocalFile()
     stop();
     clock->reset();
     clock->start();
-    timer_id = startTimer(kSyncInterval);
     foreach (AVPlayer* player, players) {
         player->setFile(file); //TODO: load all players before play
         player->play();
@@ -198,7 +227,6 @@ void VideoWall::openUrl()
     stop();
     clock->reset();
     clock->start();
-    timer_id = startTimer(kSyncInterval);
     foreach (AVPlayer* player, players) {
         player->setFile(url);
         player->play(); //TODO: load all players before play
@@ -215,7 +243,7 @@ void VideoWall::about()
 void VideoWall::help()
 {
     QMessageBox::about(0, tr("Help"),
-                        tr("Command line: %1 [-r rows=3] [-c cols=3] path/of/video\n").arg(qApp->applicationFilePath())
+                        tr("Command line: %1 [-r rows=3] [-c cols=3] [-vo qpainter|gl|glwall|d2d|gdi|xv] path/of/video\n").arg(qApp->applicationFilePath())
                        + tr("Drag and drop a file to player\n")
                        + tr("Shortcut:\n")
                        + tr("Space: pause/continue\n")
@@ -275,7 +303,6 @@ bool VideoWall::eventFilter(QObject *watched, QEvent *event)
             foreach (AVPlayer* player, players) {
                 player->play();
             }
-            timer_id = startTimer(kSyncInterval);
             break;
         case Qt::Key_S:
             stop();
@@ -374,18 +401,3 @@ bool VideoWall::eventFilter(QObject *watched, QEvent *event)
     }
     return true; //false: for text input
 }
-
-void VideoWall::timerEvent(QTimerEvent *e)
-{
-    if (e->timerId() != timer_id) {
-        qDebug("Not clock id");
-        return;
-    }
-    if (!clock->isActive()) {
-        qDebug("clock not running");
-        return;
-    }
-    foreach (AVPlayer *player, players) {
-        player->masterClock()->updateExternalClock(*clock);
-    }
-}
@@ -26,6 +26,10 @@
 #include <QtAVWidgets/WidgetRenderer.h>
 
 class QMenu;
+namespace QtAV {
+class OpenGLVideoWall;
+class VideoWallManager;
+}
 class VideoWall : public QObject
 {
     Q_OBJECT
@@ -49,14 +53,14 @@ public slots:
 
 protected:
     virtual bool eventFilter(QObject *, QEvent *);
-    virtual void timerEvent(QTimerEvent *e);
 private:
     int r, c;
-    int timer_id;
     QtAV::AVClock *clock;
+    QtAV::VideoWallManager *manager;
     QList<QtAV::AVPlayer*> players;
     QWidget *view;
     QMenu *menu;
+    QtAV::OpenGLVideoWall *glwall;
     QString vid;
 };
 
@@ -48,7 +48,7 @@ int main(int argc, char *argv[])
     }
     qDebug("vo: %s", vo.toUtf8().constData());
     vo = vo.toLower();
-    if (vo != QLatin1String("gl") && vo != QLatin1String("d2d") && vo != QLatin1String("gdi") && vo != QLatin1String("xv"))
+    if (vo != QLatin1String("gl") && vo != QLatin1String("glwall") && vo != QLatin1String("d2d") && vo != QLatin1String("gdi") && vo != QLatin1String("xv"))
         vo = QString::fromLatin1("qpainter");
     VideoWall wall;
     wall.setVideoRendererTypeString(vo);
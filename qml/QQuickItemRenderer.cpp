@@ -22,6 +22,7 @@
 
 #include "QmlAV/QQuickItemRenderer.h"
 #include "QtCore/QCoreApplication"
+#include <QtCore/QAtomicInt>
 #include <QtQuick/QQuickWindow>
 #include <QtQuick/QSGFlatColorMaterial>
 #include <QtQuick/QSGSimpleTextureNode>
@@ -53,6 +54,7 @@ public:
       , texture(0)
       , node(0)
       , source(0)
+      , update_posted(0)
     {
     }
     virtual ~QQuickItemRendererPrivate() {
@@ -78,6 +80,8 @@ public:
     QSGNode *node;
     QObject *source;
     QImage image;
+    // 1 if an update event is queued in gui thread. frames received before it's processed are coalesced
+    QAtomicInt update_posted;
 };
 
 QQuickItemRenderer::QQuickItemRenderer(QQuickItem *parent)
@@ -86,7 +90,6 @@ QQuickItemRenderer::QQuickItemRenderer(QQuickItem *parent)
 {
     Q_UNUSED(parent);
     setFlag(QQuickItem::ItemHasContents, true);
-    connect(this, SIGNAL(windowChanged(QQuickWindow*)), SLOT(handleWindowChange(QQuickWindow*)));
 }
 
 VideoRendererId QQuickItemRenderer::id() const
@@ -108,6 +111,8 @@ bool QQuickItemRenderer::event(QEvent *e)
 {
     if (e->type() != QEvent::User)
         return QQuickItem::event(e);
+    // the only work in gui thread: schedule a sync. the frame is taken in updatePaintNode() in render thread
+    d_func().update_posted.storeRelease(0);
     update();
     return true;
 }
@@ -135,10 +140,13 @@ bool QQuickItemRenderer::receiveFrame(const VideoFrame &frame)
         if (r != QRect(0, 0, frame.width(), frame.height()))
             d.image = d.image.copy(r);
     }
+    // d.video_frame is a mailbox of 1 frame guarded by img_mutex, which is held only to replace or take it. a frame not
+    // synchronized yet is replaced by the newer one
     d.frame_changed = true;
 //    update();  // why update slow? because of calling in a different thread?
     //QMetaObject::invokeMethod(this, "update"); // slower than directly postEvent
-    QCoreApplication::postEvent(this, new QEvent(QEvent::User));
+    if (d.update_posted.testAndSetOrdered(0, 1))
+        QCoreApplication::postEvent(this, new QEvent(QEvent::User));
     return true;
 }
 
@@ -266,25 +274,6 @@ QSGNode *QQuickItemRenderer::updatePaintNode(QSGNode *node, QQuickItem::UpdatePa
     return node;
 }
 
-void QQuickItemRenderer::handleWindowChange(QQuickWindow *win)
-{
-    if (!win)
-        return;
-    connect(win, SIGNAL(beforeRendering()), this, SLOT(beforeRendering()), Qt::DirectConnection);
-    connect(win, SIGNAL(afterRendering()), this, SLOT(afterRendering()), Qt::DirectConnection);
-}
-
-void QQuickItemRenderer::beforeRendering()
-{
-    d_func().img_mutex.lock();
-    // TODO: what if current frame not rendered but new frame comes?
-}
-
-void QQuickItemRenderer::afterRendering()
-{
-    d_func().img_mutex.unlock();
-}
-
 bool QQuickItemRenderer::onSetRegionOfInterest(const QRectF &roi)
 {
     Q_UNUSED(roi);
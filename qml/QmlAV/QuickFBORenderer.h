@@ -39,6 +39,8 @@ class QuickFBORenderer : public QQuickFramebufferObject, public VideoRenderer
     // regionOfInterest > sourceRect
     Q_PROPERTY(QRectF regionOfInterest READ regionOfInterest WRITE setRegionOfInterest NOTIFY regionOfInterestChanged)
     Q_PROPERTY(qreal sourceAspectRatio READ sourceAspectRatio NOTIFY sourceAspectRatioChanged)
+    // see OpenGLRendererBase::setFrameTimingOverlay(). present interval is the interval of rendering new frames into the fbo
+    Q_PROPERTY(bool frameTimingOverlay READ isFrameTimingOverlay WRITE setFrameTimingOverlay NOTIFY frameTimingOverlayChanged)
     Q_ENUMS(FillMode)
 public:
     enum FillMode {
@@ -61,6 +63,8 @@ public:
 
     bool isOpenGL() const;
     void setOpenGL(bool o);
+    bool isFrameTimingOverlay() const;
+    void setFrameTimingOverlay(bool value);
     void fboSizeChanged(const QSize& size);
     void renderToFbo();
 Q_SIGNALS:
@@ -69,6 +73,7 @@ Q_SIGNALS:
     void orientationChanged();
     void regionOfInterestChanged();
     void openGLChanged();    
+    void frameTimingOverlayChanged();
     void sourceAspectRatioChanged(qreal value);
 protected:
     virtual bool event(QEvent *e) Q_DECL_OVERRIDE;
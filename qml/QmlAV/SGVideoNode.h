@@ -42,6 +42,7 @@ private:
     QRectF m_textureRect;
     int m_orientation;
     qreal m_validWidth;
+    int m_texCoords;
 };
 
 } //namespace QtAV
@@ -24,10 +24,17 @@
 #include "QtAV/AVPlayer.h"
 #include "QtAV/FactoryDefine.h"
 #include "QtAV/OpenGLVideo.h"
+#include "QtAV/Statistics.h"
+#include "QtAV/private/FrameTimingOverlay.h"
 #include "QtAV/private/VideoRenderer_p.h"
 #include "QtAV/private/mkid.h"
 #include "QtAV/private/prepost.h"
+#include <QtCore/QAtomicInt>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtGui/QOpenGLPaintDevice>
+#include <QtGui/QPainter>
+#include <QtGui/QScreen>
 #include <QtGui/QOpenGLFramebufferObject>
 #include <QtQuick/QQuickWindow>
 // for dynamicgl. qglfunctions before qt5.3 does not have portable gl functions
@@ -80,6 +87,7 @@ public:
       , node(0)
       , source(0)
       , glctx(0)
+      , update_posted(0)
     {}
     void setupAspectRatio() {
         matrix.setToIdentity();
@@ -99,6 +107,8 @@ public:
     QOpenGLContext *glctx;
     QMatrix4x4 matrix;
     OpenGLVideo glv;
+    FrameTimingOverlay timing;
+    QAtomicInt update_posted; // see QQuickItemRendererPrivate
 };
 
 QuickFBORenderer::QuickFBORenderer(QQuickItem *parent)
@@ -134,7 +144,8 @@ bool QuickFBORenderer::receiveFrame(const VideoFrame &frame)
     d.glv.setCurrentFrame(frame);
 //    update();  // why update slow? because of calling in a different thread?
     //QMetaObject::invokeMethod(this, "update"); // slower than directly postEvent
-    QCoreApplication::postEvent(this, new QEvent(QEvent::User));
+    if (d.update_posted.testAndSetOrdered(0, 1))
+        QCoreApplication::postEvent(this, new QEvent(QEvent::User));
     return true;
 }
 
@@ -186,6 +197,21 @@ void QuickFBORenderer::setOpenGL(bool o)
         setPreferredPixelFormat(VideoFormat::Format_RGB32);
 }
 
+bool QuickFBORenderer::isFrameTimingOverlay() const
+{
+    return d_func().timing.isEnabled();
+}
+
+void QuickFBORenderer::setFrameTimingOverlay(bool value)
+{
+    DPTR_D(QuickFBORenderer);
+    if (d.timing.isEnabled() == value)
+        return;
+    d.timing.setEnabled(value);
+    emit frameTimingOverlayChanged();
+    update();
+}
+
 void QuickFBORenderer::fboSizeChanged(const QSize &size)
 {
     DPTR_D(QuickFBORenderer);
@@ -197,7 +223,21 @@ void QuickFBORenderer::fboSizeChanged(const QSize &size)
 
 void QuickFBORenderer::renderToFbo()
 {
+    DPTR_D(QuickFBORenderer);
     handlePaintEvent();
+    // no buffer swap here. the scene graph renders once per vsync, so a frame is presented at the next swap
+    const qreal refresh = window() && window()->screen() ? window()->screen()->refreshRate() : 0;
+    if (d.timing.framePresented(refresh > 1 ? 1.0/refresh : 0) && d.statistics)
+        d.statistics->count(Statistics::StutterFrames);
+    if (d.statistics)
+        d.statistics->setMemoryUsage(Statistics::TextureMemory, d.glv.textureMemory());
+    if (!d.timing.isEnabled())
+        return;
+    QOpenGLPaintDevice device(rendererSize());
+    QPainter painter(&device);
+    d.timing.draw(&painter, QRect(QPoint(), rendererSize()));
+    painter.end();
+    window()->resetOpenGLState();
 }
 
 bool QuickFBORenderer::needUpdateBackground() const
@@ -228,13 +268,17 @@ void QuickFBORenderer::drawFrame()
         return;
     }
     //d.glv.setCurrentFrame(d.video_frame);
+    QElapsedTimer draw_timer;
+    draw_timer.start();
     d.glv.render(d.out_rect, normalizedROI(), d.matrix);
+    d.timing.frameDrawn(d.video_frame, d.glv.uploadTime(), qreal(draw_timer.nsecsElapsed())/1e6);
 }
 
 bool QuickFBORenderer::event(QEvent *e)
 {
     if (e->type() != QEvent::User)
         return QQuickFramebufferObject::event(e);
+    d_func().update_posted.storeRelease(0);
     update();
     return true;
 }
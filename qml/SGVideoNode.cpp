@@ -23,6 +23,8 @@
 #include "QmlAV/SGVideoNode.h"
 #include "QtAV/VideoShader.h"
 #include "QtAV/VideoFrame.h"
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
 #include <QtCore/QScopedPointer>
 #include <QtGui/QOpenGLFunctions>
 #include <QtQuick/QSGMaterialShader>
@@ -59,7 +61,18 @@ public:
     SGVideoMaterial() : QSGMaterial(), m_opacity(1.0) {}
 
     virtual QSGMaterialType *type() const {
-        return reinterpret_cast<QSGMaterialType*>((quintptr)m_material.type());
+        // scenegraph compares the addresses. a type value can be 0, so it's not used as the address
+        static QMutex mutex; // a render thread per window
+        static QHash<qint64, QSGMaterialType*> types;
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        const qint64 t = m_material.type();
+        QSGMaterialType *mt = types.value(t, 0);
+        if (!mt) {
+            mt = new QSGMaterialType();
+            types.insert(t, mt);
+        }
+        return mt;
     }
 
     virtual QSGMaterialShader *createShader() const {
@@ -105,7 +118,9 @@ void SGVideoMaterialShader::updateState(const RenderState &state, QSGMaterial *n
 SGVideoNode::SGVideoNode()
     : QSGGeometryNode()
     , m_material(new SGVideoMaterial())
+    , m_orientation(0)
     , m_validWidth(1.0)
+    , m_texCoords(1)
 {
     setFlag(QSGNode::OwnsGeometry);
     setFlag(QSGNode::OwnsMaterial);
@@ -117,20 +132,38 @@ SGVideoNode::~SGVideoNode() {}
 void SGVideoNode::setCurrentFrame(const VideoFrame &frame)
 {
     m_material->setCurrentFrame(frame);
+    // rectangle textures (e.g. mac interop) of planar formats have a coordinate per plane. see VideoShader::attributeNames()
+    const bool rect = frame.metaData(QStringLiteral("target")).toByteArray().toLower() == QByteArrayLiteral("rect");
+    const int tc = rect && frame.format().isPlanar() ? 3 : 1;
+    if (tc != m_texCoords) {
+        m_texCoords = tc;
+        m_rect = QRectF(); // update geometry
+    }
     markDirty(DirtyMaterial);
 }
 
 /* Helpers */
-static inline void qSetGeom(QSGGeometry::TexturedPoint2D *v, const QPointF &p)
+// tl, bl, tr, br
+static inline QPointF rectCorner(const QRectF &r, int corner)
 {
-    v->x = p.x();
-    v->y = p.y();
+    switch (corner) {
+    case 0: return r.topLeft();
+    case 1: return r.bottomLeft();
+    case 2: return r.topRight();
+    default: return r.bottomRight();
+    }
 }
 
-static inline void qSetTex(QSGGeometry::TexturedPoint2D *v, const QPointF &p)
+static const QSGGeometry::AttributeSet& multiTexturedPoint2D()
 {
-    v->tx = p.x();
-    v->ty = p.y();
+    static const QSGGeometry::Attribute attrs[] = {
+        QSGGeometry::Attribute::create(0, 2, GL_FLOAT, true),
+        QSGGeometry::Attribute::create(1, 2, GL_FLOAT),
+        QSGGeometry::Attribute::create(2, 2, GL_FLOAT),
+        QSGGeometry::Attribute::create(3, 2, GL_FLOAT)
+    };
+    static const QSGGeometry::AttributeSet attrSet = { 4, 8*sizeof(float), attrs };
+    return attrSet;
 }
 
 void SGVideoNode::setTexturedRectGeometry(const QRectF &rect, const QRectF &textureRect, int orientation)
@@ -143,58 +176,39 @@ void SGVideoNode::setTexturedRectGeometry(const QRectF &rect, const QRectF &text
     m_rect = rect;
     m_textureRect = textureRect;
     m_orientation = orientation;
-    QRectF validTexRect = m_material->videoMaterial()->normalizedROI(textureRect);
-    //qDebug() << ">>>>>>>valid: " << m_validWidth << "  roi: " << validTexRect;
+    // texture corner of each vertex(tl, bl, tr, br) for orientation 0, 90, 180, 270
+    static const int kTexCorners[4][4] = {
+        { 0, 1, 2, 3 }, // tl, bl, tr, br
+        { 2, 0, 3, 1 }, // tr, tl, br, bl
+        { 3, 2, 1, 0 }, // br, tr, bl, tl
+        { 1, 3, 0, 2 }  // bl, br, tl, tr
+    };
+    const int *corners = kTexCorners[(orientation/90)&3];
+    if (orientation % 90)
+        corners = kTexCorners[0];
+    const int tc = m_texCoords;
     QSGGeometry *g = geometry();
-
-    if (g == 0)
-        g = new QSGGeometry(QSGGeometry::defaultAttributes_TexturedPoint2D(), 4);
-
-    QSGGeometry::TexturedPoint2D *v = g->vertexDataAsTexturedPoint2D();
-
-    // Set geometry first
-    qSetGeom(v + 0, rect.topLeft());
-    qSetGeom(v + 1, rect.bottomLeft());
-    qSetGeom(v + 2, rect.topRight());
-    qSetGeom(v + 3, rect.bottomRight());
-
-    // and then texture coordinates
-    switch (orientation) {
-        default:
-            // tl, bl, tr, br
-            qSetTex(v + 0, validTexRect.topLeft());
-            qSetTex(v + 1, validTexRect.bottomLeft());
-            qSetTex(v + 2, validTexRect.topRight());
-            qSetTex(v + 3, validTexRect.bottomRight());
-            break;
-
-        case 90:
-            // tr, tl, br, bl
-            qSetTex(v + 0, validTexRect.topRight());
-            qSetTex(v + 1, validTexRect.topLeft());
-            qSetTex(v + 2, validTexRect.bottomRight());
-            qSetTex(v + 3, validTexRect.bottomLeft());
-            break;
-
-        case 180:
-            // br, tr, bl, tl
-            qSetTex(v + 0, validTexRect.bottomRight());
-            qSetTex(v + 1, validTexRect.topRight());
-            qSetTex(v + 2, validTexRect.bottomLeft());
-            qSetTex(v + 3, validTexRect.topLeft());
-            break;
-
-        case 270:
-            // bl, br, tl, tr
-            qSetTex(v + 0, validTexRect.bottomLeft());
-            qSetTex(v + 1, validTexRect.bottomRight());
-            qSetTex(v + 2, validTexRect.topLeft());
-            qSetTex(v + 3, validTexRect.topRight());
-            break;
+    if (g && g->attributeCount() != 1 + tc)
+        g = 0;
+    if (!g)
+        g = new QSGGeometry(tc > 1 ? multiTexturedPoint2D() : QSGGeometry::defaultAttributes_TexturedPoint2D(), 4);
+    // x, y, then tx, ty of each plane. mapToTexture() normalizes only 2d textures
+    float *v = static_cast<float*>(g->vertexData());
+    QRectF texRect[3];
+    for (int i = 0; i < tc; ++i)
+        texRect[i] = m_material->videoMaterial()->mapToTexture(i, textureRect);
+    for (int k = 0; k < 4; ++k) {
+        const QPointF p(rectCorner(rect, k));
+        *v++ = p.x();
+        *v++ = p.y();
+        for (int i = 0; i < tc; ++i) {
+            const QPointF t(rectCorner(texRect[i], corners[k]));
+            *v++ = t.x();
+            *v++ = t.y();
+        }
     }
-
-    if (!geometry())
-        setGeometry(g);
+    if (g != geometry())
+        setGeometry(g); // the old one is deleted because of OwnsGeometry
 
     markDirty(DirtyGeometry);
 }
@@ -21,29 +21,25 @@
 
 
 #include <QtAV/AVClock.h>
-#include <QtCore/QTimer>
-#include <QtCore/QTimerEvent>
-#include <QtCore/QDateTime>
 #include "utils/Logger.h"
 
 namespace QtAV {
 
-enum {
-    kRunning,
-    kPaused,
-    kStopped
-};
 AVClock::AVClock(AVClock::ClockType c, QObject *parent):
     QObject(parent)
   , auto_clock(true)
   , m_state(kStopped)
   , clock_type(c)
   , mSpeed(1.0)
+  , mCatchUp(0)
+  , catchup_(0)
   , value0(0)
-  , avg_err(0)
-  , nb_restarted(0)
+  , audio_ts_(-1)
+  , ref_(0)
+  , ref_offset_(0)
 {
-    last_pts = pts_ = pts_v = delay_ = 0;
+    pts_ = pts_v = delay_ = 0;
+    mono.start();
 }
 
 AVClock::AVClock(QObject *parent):
@@ -52,19 +48,39 @@ AVClock::AVClock(QObject *parent):
   , m_state(kStopped)
   , clock_type(AudioClock)
   , mSpeed(1.0)
+  , mCatchUp(0)
+  , catchup_(0)
   , value0(0)
-  , avg_err(0)
-  , nb_restarted(0)
+  , audio_ts_(-1)
+  , ref_(0)
+  , ref_offset_(0)
 {
-    last_pts = pts_ = pts_v = delay_ = 0;
+    pts_ = pts_v = delay_ = 0;
+    mono.start();
+}
+
+void AVClock::rebase()
+{
+    if (!timer.isValid())
+        return;
+    const qint64 dt = elapsedNs(timer);
+    catchup_ += qint64(qreal(dt)*mCatchUp*speed());
+    if (clock_type == ExternalClock)
+        pts_ += dt;
+    else if (clock_type == VideoClock)
+        pts_v += dt;
+    timer.restart();
 }
 
 void AVClock::setClockType(ClockType ct)
 {
     if (clock_type == ct)
         return;
+    QMutexLocker lock(&rebase_mutex);
+    Q_UNUSED(lock);
+    rebase();
     clock_type = ct;
-    QTimer::singleShot(0, this, SLOT(restartCorrectionTimer()));
+    audio_ts_ = -1;
 }
 
 AVClock::ClockType AVClock::clockType() const
@@ -74,6 +90,8 @@ AVClock::ClockType AVClock::clockType() const
 
 bool AVClock::isActive() const
 {
+    if (ref_)
+        return ref_->isActive();
     return clock_type == AudioClock || timer.isValid();
 }
 
@@ -102,11 +120,11 @@ void AVClock::updateExternalClock(qint64 msecs)
     if (clock_type == AudioClock)
         return;
     qDebug("External clock change: %f ==> %f", value(), double(msecs) * kThousandth);
-    pts_ = double(msecs) * kThousandth; //can not use msec/1000.
+    QMutexLocker lock(&rebase_mutex);
+    Q_UNUSED(lock);
+    pts_ = msecs*1000000LL;
+    catchup_ = 0;
     timer.restart();
-
-    last_pts = pts_;
-    t = QDateTime::currentMSecsSinceEpoch();
     if (clockType() == VideoClock)
         pts_v = pts_;
 }
@@ -116,11 +134,27 @@ void AVClock::updateExternalClock(const AVClock &clock)
     if (clock_type != ExternalClock)
         return;
     qDebug("External clock change: %f ==> %f", value(), clock.value());
-    pts_ = clock.value();
+    const qint64 pts = toNs(clock.value());
+    QMutexLocker lock(&rebase_mutex);
+    Q_UNUSED(lock);
+    pts_ = pts;
+    catchup_ = 0;
     timer.restart();
+}
 
-    last_pts = pts_;
-    t = QDateTime::currentMSecsSinceEpoch();
+void AVClock::setExternalValue(double value)
+{
+    if (clock_type == AudioClock)
+        return;
+    QMutexLocker lock(&rebase_mutex);
+    Q_UNUSED(lock);
+    rebase();
+    const double v = value - toSeconds(catchup_) - (clock_type == ExternalClock ? value0 : 0);
+    const qint64 pts = toNs(speed() != 0 ? v/speed() : v);
+    if (clock_type == ExternalClock)
+        pts_ = pts;
+    else
+        pts_v = pts;
 }
 
 void AVClock::setSpeed(qreal speed)
@@ -128,17 +162,79 @@ void AVClock::setSpeed(qreal speed)
     mSpeed = speed;
 }
 
+void AVClock::setCatchUpSpeed(qreal extra)
+{
+    // called for every packet of a live stream
+    if (mCatchUp == extra)
+        return;
+    QMutexLocker lock(&rebase_mutex);
+    Q_UNUSED(lock);
+    // time gained with the old ratio is kept
+    rebase();
+    mCatchUp = extra;
+}
+
+qreal AVClock::catchUpSpeed() const
+{
+    return mCatchUp;
+}
+
 bool AVClock::isPaused() const
 {
     return m_state == kPaused;
 }
 
+bool AVClock::isStopped() const
+{
+    return m_state == kStopped;
+}
+
+void AVClock::setReferenceClock(AVClock *clock)
+{
+    if (ref_ == clock)
+        return;
+    for (AVClock *c = clock; c; c = c->referenceClock()) {
+        if (c == this) {
+            qWarning("AVClock: reference clock %p follows this clock %p", clock, this);
+            return;
+        }
+    }
+    if (ref_)
+        disconnect(ref_, SIGNAL(destroyed()), this, SLOT(onReferenceDestroyed()));
+    ref_ = clock;
+    if (ref_)
+        connect(ref_, SIGNAL(destroyed()), this, SLOT(onReferenceDestroyed()), Qt::DirectConnection);
+}
+
+AVClock* AVClock::referenceClock() const
+{
+    return ref_;
+}
+
+void AVClock::setReferenceOffset(double value)
+{
+    ref_offset_ = value;
+}
+
+double AVClock::referenceOffset() const
+{
+    return ref_offset_;
+}
+
+void AVClock::onReferenceDestroyed()
+{
+    ref_ = 0;
+}
+
 void AVClock::start()
 {
     m_state = kRunning;
     qDebug("AVClock started!!!!!!!!");
-    timer.start();
-    QTimer::singleShot(0, this, SLOT(restartCorrectionTimer()));
+    {
+        QMutexLocker lock(&rebase_mutex);
+        Q_UNUSED(lock);
+        timer.start();
+    }
     emit started();
 }
 //remember last value because we don't reset  pts_, pts_v, delay_
@@ -146,23 +242,33 @@ void AVClock::pause(bool p)
 {
     if (isPaused() == p)
         return;
-    if (clock_type == AudioClock)
+    if (clock_type == AudioClock) {
+        // audio thread stops reporting. stop interpolation
+        m_state = p ? kPaused : kRunning;
+        audio_ts_ = -1;
         return;
+    }
     m_state = p ? kPaused : kRunning;
     if (p) {
-        QTimer::singleShot(0, this, SLOT(stopCorrectionTimer()));
+        {
+            QMutexLocker lock(&rebase_mutex);
+            Q_UNUSED(lock);
+            rebase();
 #if QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
-        timer.invalidate();
+            timer.invalidate();
 #else
-        timer.stop();
+            timer.stop();
 #endif //QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
+        }
         emit paused();
     } else {
-        timer.start();
-        QTimer::singleShot(0, this, SLOT(restartCorrectionTimer()));
+        {
+            QMutexLocker lock(&rebase_mutex);
+            Q_UNUSED(lock);
+            timer.start();
+        }
         emit resumed();
     }
-    t = QDateTime::currentMSecsSinceEpoch();
     emit paused(p);
 }
 
@@ -171,59 +277,18 @@ void AVClock::reset()
     // keep mSpeed
     m_state = kStopped;
     value0 = 0;
-    pts_ = pts_v = delay_ = 0;
-    QTimer::singleShot(0, this, SLOT(stopCorrectionTimer()));
+    {
+        QMutexLocker lock(&rebase_mutex);
+        Q_UNUSED(lock);
+        pts_ = pts_v = delay_ = 0;
+        catchup_ = 0;
 #if QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
-    timer.invalidate();
+        timer.invalidate();
 #else
-    timer.stop();
+        timer.stop();
 #endif //QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
-    t = QDateTime::currentMSecsSinceEpoch();
-    emit resetted();
-}
-
-void AVClock::timerEvent(QTimerEvent *event)
-{
-    Q_ASSERT_X(clockType() != AudioClock, "AVClock::timerEvent", "Internal error. AudioClock can not call this");
-    if (event->timerId() != correction_schedule_timer.timerId())
-        return;
-    if (isPaused())
-        return;
-    const double delta_pts = (value() - last_pts)/speed();
-    //const double err = double(correction_timer.restart()) * kThousandth - delta_pts;
-    const qint64 now = QDateTime::currentMSecsSinceEpoch();
-    const double err = double(now - t) * kThousandth - delta_pts;
-    t = now;
-    // FIXME: avfoundation camera error is large (about -0.6s)
-    if (qAbs(err*10.0) < kCorrectionInterval || clock_type == VideoClock) {
-        avg_err += err/(nb_restarted+1);
     }
-    //qDebug("correction timer event. error = %f, avg_err=%f, nb_restarted=%d", err, avg_err, nb_restarted);
-    last_pts = value();
-    nb_restarted = 0;
-}
-
-void AVClock::restartCorrectionTimer()
-{
-    nb_restarted = 0;
-    avg_err = 0;
-    correction_schedule_timer.stop();
-    if (clockType() == AudioClock) // TODO: for all clock type
-        return;
-    // parameters are reset. do not start correction timer if not running
-    if (m_state != kRunning)
-        return;
-    // timer is always started in AVClock::start()
-    if (!timer.isValid())
-        return;
-    t = QDateTime::currentMSecsSinceEpoch();
-    correction_schedule_timer.start(kCorrectionInterval*1000, this);
-}
-
-void AVClock::stopCorrectionTimer()
-{
-    nb_restarted = 0;
-    avg_err = 0;
-    correction_schedule_timer.stop();
+    audio_ts_ = -1;
+    emit resetted();
 }
 } //namespace QtAV
@@ -24,8 +24,12 @@
 #include "QtAV/AVClock.h"
 #include "QtAV/AVDemuxer.h"
 #include "QtAV/AVDecoder.h"
+#include "QtAV/Statistics.h"
+#include "QtAV/TraceRecorder.h"
+#include "PacketRecorder.h"
 #include "VideoThread.h"
 #include <QtCore/QTime>
+#include <QtCore/QWaitCondition>
 #include "utils/Logger.h"
 
 #define RESUME_ONCE_ON_SEEK 0
@@ -41,6 +45,7 @@ public:
     virtual void call() {
         if (!mDemuxThread)
             return;
+        mDemuxThread->wakeUp(); // eof packet may be put again
         if (mDemuxThread->isEnd())
             return;
         mDemuxThread->updateBufferState(); // ensure detect buffering immediately
@@ -57,6 +62,77 @@ private:
     AVDemuxThread *mDemuxThread;
 };
 
+// reads audio packets with another demuxer. read/seek of the demuxer and put to the queue are protected by mutex
+class AVDemuxThread::AudioReader : public QThread
+{
+public:
+    AudioReader(AVDemuxThread *dt, AVDemuxer *dmx)
+        : QThread(0)
+        , demux_thread(dt)
+        , demuxer(dmx)
+        , stop(false)
+        , eof(false)
+    {
+        setObjectName(QStringLiteral("AudioReader"));
+    }
+    void requestStop() {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        stop = true;
+        cond.wakeAll();
+    }
+    // called in demux thread
+    void seek(qint64 pos, SeekType type) {
+        TraceRecorder::Span span("seek", "demux");
+        demuxer->abortIO(false);
+        demuxer->setSeekType(type);
+        demuxer->seek(pos);
+        eof = false;
+        cond.wakeAll();
+    }
+    QMutex mutex;
+protected:
+    void run() Q_DECL_OVERRIDE {
+        demux_thread->thread_policy.apply();
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        while (!stop) {
+            AVThread *t = demux_thread->audio_thread;
+            PacketBuffer *aqueue = t ? t->packetQueue() : 0;
+            // the queue is full, or wait for seek. no audio in trick play, leaving it seeks
+            if (!aqueue || eof || aqueue->isFull() || demuxer->isIOAborted() || demux_thread->key_frame_only) {
+                cond.wait(&mutex, 20);
+                continue;
+            }
+            bool read = false;
+            {
+                TraceRecorder::Span span("demux", "demux");
+                read = demuxer->readFrame();
+            }
+            if (!read) {
+                if (demuxer->atEnd()) {
+                    aqueue->put(Packet::createEOF());
+                    aqueue->blockEmpty(false);
+                    eof = true;
+                }
+                continue;
+            }
+            // follow audio track changes of the main demuxer
+            if (demuxer->stream() != demux_thread->demuxer->audioStream())
+                continue;
+            demux_thread->countPacket(demuxer->packet(), false);
+            aqueue->blockFull(false); // never block with mutex locked
+            aqueue->put(demuxer->packet());
+        }
+    }
+private:
+    AVDemuxThread *demux_thread;
+    AVDemuxer *demuxer;
+    bool stop;
+    bool eof;
+    QWaitCondition cond;
+};
+
 AVDemuxThread::AVDemuxThread(QObject *parent) :
     QThread(parent)
   , paused(false)
@@ -66,13 +142,41 @@ AVDemuxThread::AVDemuxThread(QObject *parent) :
   , m_buffer(0)
   , demuxer(0)
   , ademuxer(0)
+  , areader_demuxer(0)
+  , audio_reader(0)
   , audio_thread(0)
   , video_thread(0)
+  , statistics(0)
+  , gop_packets(0)
+  , read_batch(16)
+  , read_batch_bytes(256*1024)
+  , live_latency(0)
+  , live_drop_video(false)
+  , m_latency(0)
+  , previewing(false)
+  , reverse(false)
+  , reverse_request(false)
+  , reverse_end(false)
+  , reverse_pos(0)
+  , reverse_back(1)
+  , key_frame_only(false)
+  , loop_start(0)
+  , loop_stop(std::numeric_limits<qint64>::max())
+  , loop_left(0)
+  , loop_wrap(false)
+  , loop_end(0)
+  , loop_offset(0)
+  , loop_length(0)
+  , loop_count(0)
+  , loop_base(0)
+  , loop_base_offset(0)
+  , recorder(0)
+  , wake_pending(false)
+  , seek_task(0)
   , nb_next_frame(0)
   , clock_type(-1)
 {
-    seek_tasks.setCapacity(1);
-    seek_tasks.blockFull(false);
+    setObjectName(QStringLiteral("AVDemuxThread"));
 }
 
 AVDemuxThread::AVDemuxThread(AVDemuxer *dmx, QObject *parent) :
@@ -81,12 +185,48 @@ AVDemuxThread::AVDemuxThread(AVDemuxer *dmx, QObject *parent) :
   , end(false)
   , m_buffering(false)
   , m_buffer(0)
+  , ademuxer(0)
+  , areader_demuxer(0)
+  , audio_reader(0)
   , audio_thread(0)
   , video_thread(0)
+  , statistics(0)
+  , gop_packets(0)
+  , read_batch(16)
+  , read_batch_bytes(256*1024)
+  , live_latency(0)
+  , live_drop_video(false)
+  , m_latency(0)
+  , previewing(false)
+  , reverse(false)
+  , reverse_request(false)
+  , reverse_end(false)
+  , reverse_pos(0)
+  , reverse_back(1)
+  , key_frame_only(false)
+  , loop_start(0)
+  , loop_stop(std::numeric_limits<qint64>::max())
+  , loop_left(0)
+  , loop_wrap(false)
+  , loop_end(0)
+  , loop_offset(0)
+  , loop_length(0)
+  , loop_count(0)
+  , loop_base(0)
+  , loop_base_offset(0)
+  , recorder(0)
+  , wake_pending(false)
+  , seek_task(0)
 {
+    setObjectName(QStringLiteral("AVDemuxThread"));
     setDemuxer(dmx);
-    seek_tasks.setCapacity(1);
-    seek_tasks.blockFull(false);
+}
+
+AVDemuxThread::~AVDemuxThread()
+{
+    QRunnable *task = takeSeekTask();
+    if (task && task->autoDelete())
+        delete task;
 }
 
 void AVDemuxThread::setDemuxer(AVDemuxer *dmx)
@@ -101,6 +241,298 @@ void AVDemuxThread::setAudioDemuxer(AVDemuxer *demuxer)
     ademuxer = demuxer;
 }
 
+void AVDemuxThread::setAudioReader(AVDemuxer *dmx)
+{
+    areader_demuxer = dmx;
+}
+
+void AVDemuxThread::setReadBatch(int maxPackets, qint64 maxBytes)
+{
+    read_batch = maxPackets;
+    read_batch_bytes = maxBytes;
+}
+
+void AVDemuxThread::setLiveLatency(qint64 maxLatency)
+{
+    live_latency = maxLatency;
+}
+
+qint64 AVDemuxThread::latency() const
+{
+    return m_latency;
+}
+
+void AVDemuxThread::setTimeshift(qint64 duration, qint64 maxBytes)
+{
+    timeshift.setLimits(duration, maxBytes);
+}
+
+bool AVDemuxThread::timeshiftRange(qint64 *startTime, qint64 *endTime) const
+{
+    return timeshift.range(startTime, endTime);
+}
+
+void AVDemuxThread::setRecorder(PacketRecorder *value)
+{
+    QMutexLocker lock(&recorder_mutex);
+    Q_UNUSED(lock);
+    recorder = value;
+}
+
+void AVDemuxThread::recordPacket(const Packet &pkt, bool video)
+{
+    QMutexLocker lock(&recorder_mutex);
+    Q_UNUSED(lock);
+    if (recorder)
+        recorder->record(pkt, video);
+}
+
+void AVDemuxThread::discontinueRecorder()
+{
+    QMutexLocker lock(&recorder_mutex);
+    Q_UNUSED(lock);
+    if (recorder)
+        recorder->discontinue();
+}
+
+bool AVDemuxThread::isTimeshift() const
+{
+    return timeshift.isEnabled() && !ademuxer && !audio_reader && !reverse && !key_frame_only;
+}
+
+bool AVDemuxThread::readTimeshift(PacketBuffer *aqueue, PacketBuffer *vqueue)
+{
+    bool read = false;
+    if (!demuxer->atEnd()) {
+        {
+            TraceRecorder::Span span("demux", "demux");
+            read = demuxer->readFrame();
+        }
+        if (read) {
+            const int stream = demuxer->stream();
+            const Packet pkt = demuxer->packet();
+            if (stream == demuxer->audioStream()) {
+                countPacket(pkt, false);
+                recordPacket(pkt, false);
+                if (aqueue)
+                    timeshift.append(pkt, false);
+            } else if (stream == demuxer->videoStream()) {
+                countPacket(pkt, true);
+                recordPacket(pkt, true);
+                if (vqueue)
+                    timeshift.append(pkt, true);
+            } else if (demuxer->subtitleStreams().contains(stream)) {
+                Q_EMIT internalSubtitlePacketRead(demuxer->subtitleStreams().indexOf(stream), pkt);
+            }
+        } else if (demuxer->isIOAborted() && !hasSeekTask()) {
+            msleep(1); // stopping
+        }
+    }
+    if (timeshift.takeCursorLost())
+        qWarning("timeshift buffer is full. skip to the oldest recorded packets");
+    updateBufferState();
+    // never block here, so the source is recorded while paused or the queues are full
+    int fed = 0;
+    Packet pkt;
+    bool video = false;
+    while (!paused && timeshift.peek(&pkt, &video)) {
+        PacketBuffer *q = video ? vqueue : aqueue;
+        PacketBuffer *other = video ? aqueue : vqueue;
+        AVThread *t = video ? video_thread : audio_thread;
+        if (q && t && t->isRunning()) {
+            // packets are in source order. put to a full queue if the other one needs more
+            if (q->isFull() && (!other || other->isEnough()))
+                break;
+            q->blockFull(false);
+            q->put(pkt);
+            ++fed;
+        }
+        timeshift.next();
+    }
+    if (read || fed || !demuxer->atEnd())
+        return true;
+    if (timeshift.atEnd())
+        return false;
+    // the source ended. wait for the queues to be drained, or a seek
+    waitForWakeUp(20);
+    return true;
+}
+
+void AVDemuxThread::setStatistics(Statistics *value)
+{
+    statistics = value;
+}
+
+void AVDemuxThread::setThreadPolicy(const ThreadPolicy &policy)
+{
+    thread_policy = policy;
+}
+
+void AVDemuxThread::countPacket(const Packet &pkt, bool video)
+{
+    if (!statistics)
+        return;
+    if (!video) {
+        statistics->count(Statistics::DemuxedAudioBytes, pkt.data.size());
+        return;
+    }
+    statistics->count(Statistics::DemuxedVideoBytes, pkt.data.size());
+    if (pkt.hasKeyFrame) {
+        if (gop_packets > 0)
+            statistics->setGopLength(gop_packets);
+        gop_packets = 0;
+    }
+    ++gop_packets;
+}
+
+void AVDemuxThread::setSeamlessLoop(qint64 startPos, qint64 stopPos, int loops)
+{
+    QMutexLocker lock(&loop_mutex);
+    Q_UNUSED(lock);
+    loop_start = startPos;
+    loop_stop = stopPos;
+    loop_left = loops;
+}
+
+qreal AVDemuxThread::loopPosition(qreal t, int *loops) const
+{
+    QMutexLocker lock(&loop_mutex);
+    Q_UNUSED(lock);
+    int n = loop_base;
+    qreal offset = loop_base_offset;
+    for (int i = loop_wraps.size() - 1; i >= 0; --i) {
+        if (t >= loop_wraps.at(i).at) {
+            n = loop_wraps.at(i).count;
+            offset = loop_wraps.at(i).offset;
+            break;
+        }
+    }
+    if (loops)
+        *loops = n;
+    return t - offset;
+}
+
+void AVDemuxThread::resetLoop()
+{
+    QMutexLocker lock(&loop_mutex);
+    Q_UNUSED(lock);
+    loop_wraps.clear();
+    loop_count = loop_base = 0;
+    loop_base_offset = 0;
+    loop_offset = loop_length = 0;
+    loop_end = 0;
+    loop_wrap = false;
+}
+
+bool AVDemuxThread::checkLoop(Packet *pkt, bool video, bool primary)
+{
+    if (ademuxer || audio_reader)
+        return true;
+    if (loop_left != 0 && loop_stop < std::numeric_limits<qint64>::max()) {
+        // dts: packets of a gop after loop_stop are not needed
+        if ((video ? pkt->dts : pkt->pts)*1000.0 >= qreal(loop_stop)) {
+            if (primary)
+                loop_wrap = true;
+            return false;
+        }
+    }
+    if (primary)
+        loop_end = qMax(loop_end, pkt->pts + pkt->duration);
+    if (loop_wraps.isEmpty())
+        return true;
+    if (pkt->pts*1000.0 < qreal(loop_start)) {
+        if (!video)
+            return false;
+        // frames of the previous loop have the same timestamps and are already displayed. VideoThread drops them after decoding
+        pkt->isDecodeOnly = true;
+        pkt->shiftTimestamps(loop_offset - loop_length);
+        return true;
+    }
+    pkt->shiftTimestamps(loop_offset);
+    return true;
+}
+
+bool AVDemuxThread::wrapLoop()
+{
+    QMutexLocker lock(&loop_mutex);
+    Q_UNUSED(lock);
+    const bool stop_reached = loop_wrap;
+    loop_wrap = false;
+    if (loop_left == 0)
+        return false;
+    if (ademuxer || audio_reader || !demuxer->isSeekable()) {
+        loop_left = 0;
+        return false;
+    }
+    // ends at loop_stop, or the last packet at the end of media
+    const qreal stop = stop_reached ? qreal(loop_stop)/1000.0 : loop_end;
+    const qreal length = stop - qreal(loop_start)/1000.0;
+    if (length <= 0)
+        return false;
+    const SeekType st = demuxer->seekType();
+    demuxer->setSeekType(AccurateSeek); // backward to the key frame before loop_start
+    const bool ok = demuxer->seek(loop_start);
+    demuxer->setSeekType(st);
+    if (!ok) {
+        qWarning("seamless loop seek failed. repeat by player");
+        loop_left = 0;
+        return false;
+    }
+    gop_packets = 0;
+    discontinueRecorder();
+    if (loop_left > 0)
+        --loop_left;
+    loop_offset += length;
+    loop_length = length;
+    loop_end = 0;
+    LoopWrap w;
+    w.at = qreal(loop_start)/1000.0 + loop_offset;
+    w.offset = loop_offset;
+    w.count = ++loop_count;
+    loop_wraps.append(w);
+    if (loop_wraps.size() > 8) {
+        loop_base = loop_wraps.first().count;
+        loop_base_offset = loop_wraps.first().offset;
+        loop_wraps.remove(0);
+    }
+    qDebug("seamless loop %d from %lld ms. timestamp offset: %f", loop_count, loop_start, loop_offset);
+    return true;
+}
+
+bool AVDemuxThread::checkLiveLatency(const Packet &pkt, bool video)
+{
+    if (live_latency <= 0)
+        return true;
+    AVThread *thread = video ? video_thread : audio_thread;
+    if (!thread)
+        return true;
+    PacketBuffer *buf = thread->packetQueue();
+    const qint64 backlog = buf->bufferedTime();
+    if (buf == m_buffer) {
+        AVClock *clock = thread->clock();
+        if (backlog > live_latency/2)
+            clock->setCatchUpSpeed(0.05);
+        else if (backlog < live_latency/4)
+            clock->setCatchUpSpeed(0);
+        qint64 latency = backlog;
+        if (clock->isActive() && pkt.pts >= 0)
+            latency = qMax(latency, qint64((pkt.pts - clock->value())*1000.0));
+        m_latency = latency;
+    }
+    if (!video)
+        return backlog <= live_latency;
+    // decoding can restart from a key frame
+    if (pkt.hasKeyFrame) {
+        live_drop_video = false;
+        return true;
+    }
+    if (!live_drop_video && backlog > live_latency) {
+        qtavDebugLimited(LogDemux, 1000, "live latency %lldms > %lldms. drop video packets until next key frame", backlog, live_latency);
+        live_drop_video = true;
+    }
+    return !live_drop_video;
+}
+
 void AVDemuxThread::setAVThread(AVThread*& pOld, AVThread *pNew)
 {
     if (pOld == pNew)
@@ -114,7 +546,8 @@ void AVDemuxThread::setAVThread(AVThread*& pOld, AVThread *pNew)
     if (!pNew)
         return;
     pOld->packetQueue()->setEmptyCallback(new QueueEmptyCall(this));
-    connect(pOld, SIGNAL(finished()), SLOT(onAVThreadQuit()));
+    // direct: wake up demuxer thread waiting at the end of media without a trip through the event loop
+    connect(pOld, SIGNAL(finished()), SLOT(onAVThreadQuit()), Qt::DirectConnection);
 }
 
 void AVDemuxThread::setAudioThread(AVThread *thread)
@@ -139,6 +572,7 @@ AVThread* AVDemuxThread::audioThread()
 
 void AVDemuxThread::seek(qint64 pos, SeekType type)
 {
+    TraceRecorder::instant("seek request", "demux");
     end = false;
     // queue maybe blocked by put()
     if (audio_thread) {
@@ -162,18 +596,136 @@ void AVDemuxThread::seek(qint64 pos, SeekType type)
         SeekType type;
         qint64 position;
     };
+    // a stalled read returns now and the task is processed. abort before queueing, otherwise the thread may run the task
+    // and reset the abort before it's set, then the abort is never cleared. the thread waits for the task if aborted
+    abortIO(true);
     newSeekRequest(new SeekTask(this, pos, type));
 }
 
+void AVDemuxThread::setReverse(bool value, qint64 pos)
+{
+    reverse_request = value;
+    seek(pos, AccurateSeek);
+}
+
+bool AVDemuxThread::isReverse() const
+{
+    return reverse_request;
+}
+
+void AVDemuxThread::setKeyFrameOnly(bool value)
+{
+    key_frame_only = value;
+}
+
+bool AVDemuxThread::isKeyFrameOnly() const
+{
+    return key_frame_only;
+}
+
+bool AVDemuxThread::readReverseGop(PacketBuffer *vqueue)
+{
+    // the gop read last is not taken yet
+    if (!vqueue || !video_thread || !video_thread->isRunning() || reverse_end || !vqueue->isEmpty())
+        return false;
+    const qint64 start = demuxer->startTime();
+    const qint64 target = qMax(start, reverse_pos - reverse_back);
+    demuxer->setSeekType(AccurateSeek); // backward to the key frame before target
+    if (!demuxer->seek(target)) {
+        reverse_end = true;
+        return false;
+    }
+    QVector<Packet> gop;
+    qreal key = -1;
+    while (!end && !hasSeekTask()) {
+        if (!demuxer->readFrame()) {
+            if (demuxer->atEnd() || demuxer->isIOAborted())
+                break;
+            continue;
+        }
+        if (demuxer->stream() != demuxer->videoStream())
+            continue;
+        Packet pkt = demuxer->packet();
+        if (pkt.hasKeyFrame) {
+            if (pkt.pts*1000.0 >= qreal(reverse_pos)) // the gop read last
+                break;
+            // seek target is too far, a later gop is still before reverse_pos
+            gop.clear();
+            key = pkt.pts;
+        }
+        if (key < 0)
+            continue;
+        // displayed already, or leading frames of an open gop referencing the gop before
+        if (pkt.pts*1000.0 >= qreal(reverse_pos) || pkt.pts < key)
+            pkt.isDecodeOnly = true;
+        gop.append(pkt);
+    }
+    if (end || hasSeekTask())
+        return true;
+    if (key < 0) { // no key frame between target and reverse_pos
+        if (target <= start)
+            reverse_end = true;
+        else
+            reverse_back *= 2;
+        return true;
+    }
+    reverse_back = 1;
+    reverse_pos = qint64(key*1000.0);
+    if (reverse_pos <= start)
+        reverse_end = true;
+    vqueue->blockFull(false);
+    vqueue->put(gop);
+    vqueue->put(Packet::createEOF());
+    return true;
+}
+
+void AVDemuxThread::abortIO(bool value)
+{
+    if (demuxer)
+        demuxer->abortIO(value);
+    if (ademuxer)
+        ademuxer->abortIO(value);
+    // the reader resets it in its seek()
+    if (areader_demuxer && value)
+        areader_demuxer->abortIO(value);
+}
+
 void AVDemuxThread::seekInternal(qint64 pos, SeekType type)
 {
+    TraceRecorder::Span span("seek", "demux");
+    gop_packets = 0; // the gop is broken
+    resetLoop();
+    // seek in the recorded packets instead of the source. pos is the latest key frame if it is after the recorded range
+    const bool timeshift_seek = isTimeshift() && !reverse_request && timeshift.seek(&pos);
+    reverse = reverse_request;
+    reverse_pos = pos;
+    reverse_back = 1;
+    reverse_end = false;
     AVThread* av[] = { audio_thread, video_thread};
     qDebug("seek to %s %lld ms (%f%%)", QTime(0, 0, 0).addMSecs(pos).toString().toUtf8().constData(), pos, double(pos - demuxer->startTime())/double(demuxer->duration())*100.0);
-    demuxer->setSeekType(type);
-    demuxer->seek(pos);
-    if (ademuxer) {
-        ademuxer->setSeekType(type);
-        ademuxer->seek(pos);
+    // reader can not put packets until seek packets are put
+    QMutexLocker reader_lock(audio_reader ? &audio_reader->mutex : 0);
+    Q_UNUSED(reader_lock);
+    // a newer request aborts io again
+    abortIO(false);
+    if (type == PreviewSeek && !video_thread)
+        type = KeyFrameSeek;
+    const bool was_preview = previewing;
+    previewing = type == PreviewSeek;
+    if (video_thread) { // the previous seek is not finished
+        disconnect(video_thread, SIGNAL(seekFinished(qint64)), this, SLOT(seekPreviewFinished()));
+        disconnect(video_thread, SIGNAL(seekFinished(qint64)), this, SLOT(seekOnPauseFinished()));
+    }
+    if (!timeshift_seek) {
+        discontinueRecorder();
+        demuxer->setSeekType(type);
+        demuxer->seek(pos);
+        if (audio_reader)
+            audio_reader->seek(pos, type);
+        if (ademuxer) {
+            ademuxer->setSeekType(type);
+            ademuxer->seek(pos);
+        }
     }
     AVThread *watch_thread = 0;
     // TODO: why queue may not empty?
@@ -182,42 +734,75 @@ void AVDemuxThread::seekInternal(qint64 pos, SeekType type)
         if (!t)
             continue;
         t->packetQueue()->clear();
+        // e.g. video thread stopped after the cover is displayed. it will not report seekFinished()
+        if (!t->isRunning())
+            continue;
+        if (reverse && t == audio_thread) // no audio in reverse
+            continue;
+        if (previewing && t == audio_thread) { // no audio until next seek
+            t->pause(true);
+            continue;
+        }
         // TODO: the first frame (key frame) will not be decoded correctly if flush() is called.
         //PacketBuffer *pb = t->packetQueue();
         //qDebug("%s put seek packet. %d/%d-%.3f, progress: %.3f", t->metaObject()->className(), pb->buffered(), pb->bufferValue(), pb->bufferMax(), pb->bufferProgress());
         t->packetQueue()->setBlocking(false); // aqueue bufferValue can be small (1), we can not put and take
         Packet pkt;
-        pkt.pts = qreal(pos)/1000.0;
+        // preview: render the 1st decoded frame, i.e. the key frame, instead of decoding to pos
+        pkt.pts = previewing ? 0 : qreal(pos)/1000.0;
         t->packetQueue()->put(pkt);
         t->packetQueue()->setBlocking(true); // blockEmpty was false when eof is read.
-        if (isPaused()) {
+        // was_preview: threads are paused by preview, or will be paused in seekPreviewFinished()
+        // reverse: frame steps are displayed in paused state
+        if (!reverse && (isPaused() || previewing || was_preview)) {
             t->pause(false);
             watch_thread = t;
         }
     }
     if (watch_thread) {
         pauseInternal(false);
-        emit requestClockPause(false); // need direct connection
         // direct connection is fine here
-        connect(watch_thread, SIGNAL(seekFinished(qint64)), this, SLOT(seekOnPauseFinished()), Qt::DirectConnection);
+        if (previewing) {
+            connect(watch_thread, SIGNAL(seekFinished(qint64)), this, SLOT(seekPreviewFinished()), Qt::DirectConnection);
+        } else {
+            emit requestClockPause(false); // need direct connection
+            connect(watch_thread, SIGNAL(seekFinished(qint64)), this, SLOT(seekOnPauseFinished()), Qt::DirectConnection);
+        }
     }
 }
 
 void AVDemuxThread::newSeekRequest(QRunnable *r)
 {
-    if (seek_tasks.size() >= seek_tasks.capacity()) {
-        QRunnable *r = seek_tasks.take();
-        if (r->autoDelete())
-            delete r;
+    QMutexLocker lock(&seek_mutex);
+    Q_UNUSED(lock);
+    if (seek_task) {
+        qDebug("drop a pending seek request");
+        if (seek_task->autoDelete())
+            delete seek_task;
     }
-    seek_tasks.put(r);
+    seek_task = r;
+    wakeUp();
+}
+
+QRunnable* AVDemuxThread::takeSeekTask()
+{
+    QMutexLocker lock(&seek_mutex);
+    Q_UNUSED(lock);
+    QRunnable *task = seek_task;
+    seek_task = 0;
+    return task;
+}
+
+bool AVDemuxThread::hasSeekTask()
+{
+    QMutexLocker lock(&seek_mutex);
+    Q_UNUSED(lock);
+    return !!seek_task;
 }
 
 void AVDemuxThread::processNextSeekTask()
 {
-    if (seek_tasks.isEmpty())
-        return;
-    QRunnable *task = seek_tasks.take();
+    QRunnable *task = takeSeekTask();
     if (!task)
         return;
     task->run();
@@ -228,6 +813,8 @@ void AVDemuxThread::processNextSeekTask()
 void AVDemuxThread::pauseInternal(bool value)
 {
     paused = value;
+    if (!paused)
+        wakeUp();
 }
 
 bool AVDemuxThread::isPaused() const
@@ -252,6 +839,8 @@ void AVDemuxThread::updateBufferState()
     if (m_buffering) { // always report progress when buffering
         Q_EMIT bufferProgressChanged(m_buffer->bufferProgress());
     }
+    if (m_buffer->adapt(demuxer->bitRate()))
+        Q_EMIT bufferValueChanged(m_buffer->bufferValue());
     if (m_buffering == m_buffer->isBuffering())
         return;
     m_buffering = m_buffer->isBuffering();
@@ -267,6 +856,7 @@ void AVDemuxThread::stop()
 {
     //this will not affect the pause state if we pause the output
     //TODO: why remove blockFull(false) can not play another file?
+    abortIO(true); // do not wait for a stalled read
     AVThread* av[] = { audio_thread, video_thread};
     for (size_t i = 0; i < sizeof(av)/sizeof(av[0]); ++i) {
         AVThread* t = av[i];
@@ -281,9 +871,9 @@ void AVDemuxThread::stop()
         }
     }
     pause(false);
-    cond.wakeAll();
     qDebug("all avthread finished. try to exit demux thread<<<<<<");
     end = true;
+    wakeUp();
 }
 
 void AVDemuxThread::pause(bool p, bool wait)
@@ -293,7 +883,7 @@ void AVDemuxThread::pause(bool p, bool wait)
     paused = p;
     user_paused = paused;
     if (!paused)
-        cond.wakeAll();
+        wakeUp();
     else {
         if (wait) {
             // block until current loop finished
@@ -348,6 +938,15 @@ void AVDemuxThread::seekOnPauseFinished()
     }
 }
 
+void AVDemuxThread::seekPreviewFinished()
+{
+    disconnect(video_thread, SIGNAL(seekFinished(qint64)), this, SLOT(seekPreviewFinished()));
+    // hold the key frame until the next seek. user_paused is not changed
+    pauseInternal(true);
+    emit requestClockPause(true); // need direct connection
+    video_thread->pause(true);
+}
+
 void AVDemuxThread::frameDeliveredNextFrame()
 {
     AVThread *thread = video_thread ? video_thread : audio_thread;
@@ -385,16 +984,24 @@ void AVDemuxThread::onAVThreadQuit()
     for (size_t i = 0; i < sizeof(av)/sizeof(av[0]); ++i) {
         if (!av[i])
             continue;
+        // called in the finishing thread. Qt4 QThread::isRunning() is still true in finished()
+        if (av[i] == sender())
+            continue;
         if (av[i]->isRunning())
             return;
     }
     end = true; //(!audio_thread || !audio_thread->isRunning()) &&
+    wakeUp();
 }
 
 void AVDemuxThread::run()
 {
+    thread_policy.apply();
     m_buffering = false;
     end = false;
+    abortIO(false);
+    if (areader_demuxer)
+        areader_demuxer->abortIO(false);
     if (audio_thread && !audio_thread->isRunning())
         audio_thread->start(QThread::HighPriority);
     if (video_thread && !video_thread->isRunning())
@@ -402,6 +1009,8 @@ void AVDemuxThread::run()
 
     int stream = 0;
     Packet pkt;
+    QVector<Packet> pkts, apkts, vpkts; // batch read
+    QVector<int> streams;
     pause(false);
     qDebug("get av queue a/v thread = %p %p", audio_thread, video_thread);
     PacketBuffer *aqueue = audio_thread ? audio_thread->packetQueue() : 0;
@@ -419,18 +1028,42 @@ void AVDemuxThread::run()
         vqueue->setBlocking(true);
     }
     connect(thread, SIGNAL(seekFinished(qint64)), this, SIGNAL(seekFinished(qint64)), Qt::DirectConnection);
-    seek_tasks.clear();
+    QRunnable *old_task = takeSeekTask();
+    if (old_task && old_task->autoDelete())
+        delete old_task;
     bool was_end = false;
+    live_drop_video = false;
+    m_latency = 0;
+    previewing = false;
     if (ademuxer) {
         ademuxer->seek(0LL);
     }
+    resetLoop();
+    reverse = reverse_request = false;
+    if (areader_demuxer && aqueue && !ademuxer) {
+        audio_reader = new AudioReader(this, areader_demuxer);
+        audio_reader->start(QThread::HighPriority);
+    }
+    timeshift.reset(!!vqueue);
     while (!end) {
         processNextSeekTask();
         //vthread maybe changed by AVPlayer.setPriority() from no dec case
         vqueue = video_thread ? video_thread->packetQueue() : 0;
+        if (reverse) {
+            // not paused, frame steps backward need the gops
+            // the empty callback is called only if video thread waits for packets. poll to read the gop ahead
+            if (!readReverseGop(vqueue))
+                waitForWakeUp(20);
+            continue;
+        }
+        if (isTimeshift() && readTimeshift(aqueue, vqueue))
+            continue;
+        // continue with the next loop while the tail in queues is playing
+        if ((loop_wrap || demuxer->atEnd()) && wrapLoop())
+            continue;
         if (demuxer->atEnd()) {
             // if avthread may skip 1st eof packet because of a/v sync
-            if (aqueue && (!was_end || aqueue->isEmpty())) {
+            if (aqueue && !audio_reader && (!was_end || aqueue->isEmpty())) {
                 aqueue->put(Packet::createEOF());
                 aqueue->blockEmpty(false); // do not block if buffer is not enough. block again on seek
             }
@@ -441,8 +1074,8 @@ void AVDemuxThread::run()
             m_buffering = false;
             Q_EMIT mediaStatusChanged(QtAV::BufferedMedia);
             was_end = true;
-            // wait for a/v thread finished
-            msleep(100);
+            // wait for a/v threads finished, the queues drained or a seek. the timeout is a safety net
+            waitForWakeUp(1000);
             continue;
         }
         was_end = false;
@@ -450,7 +1083,70 @@ void AVDemuxThread::run()
             continue; //the queue is empty and will block
         }
         updateBufferState();
-        if (!demuxer->readFrame()) {
+        if (!ademuxer && read_batch > 1) {
+            pkts.resize(0);
+            streams.resize(0);
+            int nb_read = 0;
+            {
+                TraceRecorder::Span span("demux", "demux");
+                nb_read = demuxer->readFrames(&pkts, &streams, read_batch, read_batch_bytes);
+            }
+            if (nb_read <= 0) {
+                if (demuxer->isIOAborted() && !hasSeekTask())
+                    msleep(1); // stopping
+                continue;
+            }
+            apkts.resize(0);
+            vpkts.resize(0);
+            const int astream = demuxer->audioStream();
+            const int vstream = demuxer->videoStream();
+            for (int i = 0; i < pkts.size(); ++i) {
+                if (streams.at(i) == astream) {
+                    if (!audio_reader) {
+                        countPacket(pkts.at(i), false);
+                        recordPacket(pkts.at(i), false);
+                    }
+                    if (!audio_reader && !key_frame_only && checkLoop(&pkts[i], false, thread == audio_thread) && checkLiveLatency(pkts.at(i), false))
+                        apkts.append(pkts.at(i));
+                } else if (streams.at(i) == vstream) {
+                    countPacket(pkts.at(i), true);
+                    recordPacket(pkts.at(i), true);
+                    if ((!key_frame_only || pkts.at(i).hasKeyFrame) && checkLoop(&pkts[i], true, thread == video_thread) && checkLiveLatency(pkts.at(i), true))
+                        vpkts.append(pkts.at(i));
+                } else if (demuxer->subtitleStreams().contains(streams.at(i))) {
+                    Q_EMIT internalSubtitlePacketRead(demuxer->subtitleStreams().indexOf(streams.at(i)), pkts.at(i));
+                }
+            }
+            // the same as putting packets one by one below, but the conditions are checked once for each queue
+            if (aqueue && !apkts.isEmpty()) {
+                if (!audio_thread || !audio_thread->isRunning()) {
+                    aqueue->clear();
+                } else {
+                    if (m_buffer != aqueue)
+                        aqueue->setBufferValue(m_buffer->isBuffering() ? std::numeric_limits<qint64>::max() : buf2);
+                    aqueue->blockFull(!video_thread || !video_thread->isRunning() || !vqueue || demuxer->hasAttacedPicture());
+                    aqueue->put(apkts);
+                }
+            }
+            if (vqueue && !vpkts.isEmpty()) {
+                if (!video_thread || !video_thread->isRunning()) {
+                    vqueue->clear();
+                } else {
+                    // trick play: aqueue is not filled
+                    vqueue->blockFull(key_frame_only || audio_reader || !audio_thread || !audio_thread->isRunning() || !aqueue || aqueue->isEnough());
+                    vqueue->put(vpkts);
+                }
+            }
+            continue;
+        }
+        bool read = false;
+        {
+            TraceRecorder::Span span("demux", "demux");
+            read = demuxer->readFrame();
+        }
+        if (!read) {
+            if (demuxer->isIOAborted() && !hasSeekTask())
+                msleep(1); // stopping
             continue;
         }
         stream = demuxer->stream();
@@ -495,6 +1191,14 @@ void AVDemuxThread::run()
          */
         //TODO: use cache queue, take from cache queue if not empty?
         const bool a_internal = stream == demuxer->audioStream();
+        if (a_internal && audio_reader)
+            continue;
+        if (a_internal)
+            recordPacket(pkt, false);
+        if (a_ext > 0) // external audio. internal audio packets are ignored
+            countPacket(apkt, false);
+        else if (a_internal && !ademuxer)
+            countPacket(pkt, false);
         if (a_internal || a_ext > 0) {//apkt.isValid()) {
             if (a_internal && !a_ext) // internal is always read even if external audio used
                 apkt = demuxer->packet();
@@ -513,19 +1217,23 @@ void AVDemuxThread::run()
                 // attached picture is cover for song, 1 frame
                 aqueue->blockFull(!video_thread || !video_thread->isRunning() || !vqueue || audio_has_pic);
                 // external audio: a_ext < 0, stream = audio_idx=>put invalid packet
-                if (a_ext >= 0)
+                if (a_ext >= 0 && !key_frame_only && checkLoop(&apkt, false, thread == audio_thread) && checkLiveLatency(apkt, false))
                     aqueue->put(apkt); //affect video_thread
             }
         }
         // always check video stream if use external audio
         if (stream == demuxer->videoStream()) {
+            countPacket(pkt, true);
+            recordPacket(pkt, true);
             if (vqueue) {
                 if (!video_thread || !video_thread->isRunning()) {
                     vqueue->clear();
                     continue;
                 }
-                vqueue->blockFull(!audio_thread || !audio_thread->isRunning() || !aqueue || aqueue->isEnough());
-                vqueue->put(pkt); //affect audio_thread
+                // audio reader fills aqueue by itself
+                vqueue->blockFull(key_frame_only || audio_reader || !audio_thread || !audio_thread->isRunning() || !aqueue || aqueue->isEnough());
+                if ((!key_frame_only || pkt.hasKeyFrame) && checkLoop(&pkt, true, thread == video_thread) && checkLiveLatency(pkt, true))
+                    vqueue->put(pkt); //affect audio_thread
             }
         } else if (demuxer->subtitleStreams().contains(stream)) { //subtitle
             Q_EMIT internalSubtitlePacketRead(demuxer->subtitleStreams().indexOf(stream), pkt);
@@ -535,6 +1243,14 @@ void AVDemuxThread::run()
     }
     m_buffering = false;
     m_buffer = 0;
+    if (live_latency > 0)
+        thread->clock()->setCatchUpSpeed(0);
+    if (audio_reader) {
+        audio_reader->requestStop();
+        audio_reader->wait();
+        delete audio_reader;
+        audio_reader = 0;
+    }
     while (audio_thread && audio_thread->isRunning()) {
         qDebug("waiting audio thread.......");
         aqueue->blockEmpty(false); //FIXME: why need this
@@ -554,10 +1270,26 @@ bool AVDemuxThread::tryPause(unsigned long timeout)
 {
     if (!paused)
         return false;
-    QMutexLocker lock(&buffer_mutex);
-    Q_UNUSED(lock);
-    cond.wait(&buffer_mutex, timeout);
+    waitForWakeUp(timeout);
     return true;
 }
 
+void AVDemuxThread::wakeUp()
+{
+    QMutexLocker lock(&wake_mutex);
+    Q_UNUSED(lock);
+    wake_pending = true;
+    wake_cond.wakeAll();
+}
+
+void AVDemuxThread::waitForWakeUp(unsigned long timeout)
+{
+    QMutexLocker lock(&wake_mutex);
+    Q_UNUSED(lock);
+    // an event happened after the last wait
+    if (!wake_pending && !end)
+        wake_cond.wait(&wake_mutex, timeout);
+    wake_pending = false;
+}
+
 } //namespace QtAV
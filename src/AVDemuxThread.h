@@ -22,30 +22,121 @@
 #ifndef QAV_DEMUXTHREAD_H
 #define QAV_DEMUXTHREAD_H
 
+#include <climits>
 #include <QtCore/QAtomicInt>
 #include <QtCore/QMutex>
 #include <QtCore/QThread>
 #include <QtCore/QRunnable>
+#include <QtCore/QVector>
 #include "QtAV/CommonTypes.h"
 #include "PacketBuffer.h"
+#include "utils/ThreadPolicy.h"
+#include "utils/TimeshiftBuffer.h"
 
 namespace QtAV {
 
 class AVDemuxer;
 class AVThread;
+class PacketRecorder;
+class Statistics;
 class AVDemuxThread : public QThread
 {
     Q_OBJECT
 public:
     explicit AVDemuxThread(QObject *parent = 0);
     explicit AVDemuxThread(AVDemuxer *dmx, QObject *parent = 0);
+    ~AVDemuxThread();
     void setDemuxer(AVDemuxer *dmx);
     void setAudioDemuxer(AVDemuxer *demuxer); //not thread safe
+    /*!
+     * \brief setAudioReader
+     * Read audio packets from dmx, another demuxer on the same source, in a standalone thread. Then audio and video
+     * queues are filled independently, and a badly interleaved media does not block one queue when the other is full.
+     * Audio packets from the main demuxer are ignored. Stream indexes are the same as the main demuxer.
+     * Call it before start(). Not compatible with setAudioDemuxer()
+     */
+    void setAudioReader(AVDemuxer *dmx);
+    /*!
+     * \brief setReadBatch
+     * Read at most maxPackets packets or maxBytes bytes by AVDemuxer::readFrames() in 1 loop, and put them into each queue at once.
+     * It reduces per packet overhead for high packet rate streams, e.g. aac audio. Not used with setAudioDemuxer().
+     * \param maxPackets <=1: read packet one by one. default is 16
+     * \param maxBytes default is 256KB. <=0: no limit
+     */
+    void setReadBatch(int maxPackets, qint64 maxBytes = 256*1024);
+    /*!
+     * \brief setLiveLatency
+     * Keep latency of live streams low. If buffered time of a queue exceeds maxLatency, audio packets are dropped, and video
+     * packets are dropped until the next key frame. The clock runs 5% faster while buffered time of buffer() exceeds maxLatency/2.
+     * \param maxLatency in msecs. <=0: disable
+     */
+    void setLiveLatency(qint64 maxLatency);
+    /// current end-to-end latency in msecs if live latency is enabled
+    qint64 latency() const;
+    /*!
+     * \brief setTimeshift
+     * Record the last duration ms of the source in a memory ring segmented by key frames (see TimeshiftBuffer), and feed the
+     * a/v queues from it. Recording goes on while paused, and seeking inside the recorded range moves the read cursor
+     * without seeking the source, seeking after the range goes to the latest key frame. For live streams. Live latency
+     * is not applied. Not used with setAudioDemuxer(), setAudioReader(), seamless loop, reverse and key frame only reading.
+     * Thread safe. Recorded packets are cleared in start()
+     * \param duration <=0: disable
+     * \param maxBytes <=0: no limit
+     */
+    void setTimeshift(qint64 duration, qint64 maxBytes = 0);
+    /// recorded range in ms. return false if nothing is recorded
+    bool timeshiftRange(qint64 *startTime, qint64 *endTime) const;
+    /*!
+     * \brief setRecorder
+     * Forward audio and video packets of demuxer to recorder as they are read, before packets are dropped or timestamps are
+     * changed for playback. Audio read by setAudioReader() and setAudioDemuxer() is not forwarded. The recorder is told
+     * when timestamps are discontinuous. Thread safe
+     * \param recorder null: stop forwarding. The recorder is not used when this function returns
+     */
+    void setRecorder(PacketRecorder *recorder);
+    /// input bit rates and gop length are counted if set. call it before start()
+    void setStatistics(Statistics *statistics);
+    /// scheduling of the demux thread and the audio reader. applied when they start. call it before start()
+    void setThreadPolicy(const ThreadPolicy& policy);
+    /*!
+     * \brief setSeamlessLoop
+     * Loop [startPos, stopPos) without stopping or flushing. When the primary stream reaches stopPos or the end, the demuxer
+     * seeks back to the key frame before startPos while the queued tail is still playing. Video packets before startPos are
+     * decoded but not displayed, audio packets before startPos are dropped, and timestamps of later packets are shifted by
+     * the played loop length, so the clock increases monotonically. Not used with setAudioDemuxer() or setAudioReader().
+     * Thread safe
+     * \param startPos, stopPos absolute media positions in ms. stopPos >= the media end: loop at the end
+     * \param loops number of loops left. <0: forever, 0: disable
+     */
+    void setSeamlessLoop(qint64 startPos, qint64 stopPos, int loops);
+    /*!
+     * \brief loopPosition
+     * Map a clock value in s to the media position in s if timestamps are shifted by seamless loops. Thread safe
+     * \param loops number of loop wraps the clock passed since start() or the last seek
+     */
+    qreal loopPosition(qreal t, int *loops = 0) const;
     void setAudioThread(AVThread *thread);
     AVThread* audioThread();
     void setVideoThread(AVThread *thread);
     AVThread* videoThread();
     void seek(qint64 pos, SeekType type); //ms
+    /*!
+     * \brief setReverse
+     * Read video backward from pos (ms) for VideoThread::setReverse(). Seek to the key frame before the current GOP, and queue
+     * the video packets of the GOP followed by an eof packet. Packets displayed at or after pos are decode only. The GOP
+     * before it is read when the video queue is drained, so 1 GOP is read ahead. Audio and subtitle packets are not read.
+     * Seeking keeps the direction. false: seek to pos and play forward. Thread safe
+     */
+    void setReverse(bool value, qint64 pos);
+    bool isReverse() const;
+    /*!
+     * \brief setKeyFrameOnly
+     * Trick play. Forward only key frames of video and drop audio packets, see VideoThread::setKeyFrameOnly(). Packets
+     * already queued are kept, so it starts without a flush. Leaving the mode needs a seek because the decoder missed the
+     * references of the next packets. Thread safe
+     */
+    void setKeyFrameOnly(bool value);
+    bool isKeyFrameOnly() const;
     //AVDemuxer* demuxer
     bool isPaused() const;
     bool isEnd() const;
@@ -60,10 +151,12 @@ Q_SIGNALS:
     void requestClockPause(bool value);
     void mediaStatusChanged(QtAV::MediaStatus);
     void bufferProgressChanged(qreal);
+    void bufferValueChanged(qint64 value); // adaptive buffer value of buffer() is changed
     void seekFinished(qint64 timestamp);
     void internalSubtitlePacketRead(int index, const QtAV::Packet& packet);
 private slots:
     void seekOnPauseFinished();
+    void seekPreviewFinished();
     void frameDeliveredNextFrame();
     void onAVThreadQuit();
 
@@ -72,15 +165,41 @@ protected:
     /*
      * If the pause state is true setted by pause(true), then block the thread and wait for pause state changed, i.e. pause(false)
      * and return true. Otherwise, return false immediatly.
+     * It's waked up by wakeUp(). timeout is a safety net only
      */
-    bool tryPause(unsigned long timeout = 100);
+    bool tryPause(unsigned long timeout = ULONG_MAX); // waked up by pause(false), seek, stop and empty queues
 
 private:
     void setAVThread(AVThread *&pOld, AVThread* pNew);
+    // wake up the thread waiting in tryPause() or at the end of stream. thread safe
+    void wakeUp();
+    void waitForWakeUp(unsigned long timeout);
     void newSeekRequest(QRunnable *r);
+    QRunnable* takeSeekTask();
+    bool hasSeekTask();
     void processNextSeekTask();
     void seekInternal(qint64 pos, SeekType type); //must call in AVDemuxThread
+    // abort or resume blocking io of the demuxers. thread safe
+    void abortIO(bool value);
     void pauseInternal(bool value);
+    // return false if pkt should be dropped for live latency
+    bool checkLiveLatency(const Packet& pkt, bool video);
+    // count a packet read by the demux thread, or audio packets by the audio reader
+    void countPacket(const Packet& pkt, bool video);
+    // forward a packet read by the demux thread to the recorder
+    void recordPacket(const Packet& pkt, bool video);
+    void discontinueRecorder();
+    // read the gop before reverse_pos and queue it. return false if nothing is read, e.g. the previous gop is not taken yet
+    bool readReverseGop(PacketBuffer *vqueue);
+    // return false if pkt should be dropped for seamless loop. timestamps of pkt are shifted to the loop timeline
+    bool checkLoop(Packet *pkt, bool video, bool primary);
+    // seek to the loop start without flushing. return false if no loop is left
+    bool wrapLoop();
+    // the timeline restarts from media time, e.g. after seeking
+    void resetLoop();
+    bool isTimeshift() const;
+    // read a packet into the timeshift buffer and fill the queues from it without blocking. return false at the end
+    bool readTimeshift(PacketBuffer *aqueue, PacketBuffer *vqueue);
 
     bool paused;
     bool user_paused;
@@ -89,16 +208,59 @@ private:
     PacketBuffer *m_buffer;
     AVDemuxer *demuxer;
     AVDemuxer *ademuxer;
+    AVDemuxer *areader_demuxer;
+    class AudioReader;
+    AudioReader *audio_reader; // running in run() if areader_demuxer is set
     AVThread *audio_thread, *video_thread;
+    Statistics *statistics;
+    ThreadPolicy thread_policy;
+    int gop_packets; // video packets since the last key frame
     int audio_stream, video_stream;
+    int read_batch;
+    qint64 read_batch_bytes;
+    qint64 live_latency;
+    bool live_drop_video; // until next key frame
+    volatile qint64 m_latency;
+    bool previewing; // the last seek is PreviewSeek
+    // reverse read. reverse_request is applied in seekInternal()
+    volatile bool reverse, reverse_request;
+    bool reverse_end; // the first gop is read
+    qint64 reverse_pos, reverse_back; // start of the gop read last, and how far to seek back from it. ms
+    volatile bool key_frame_only;
+    // seamless loop. positions are in ms, other values are in s
+    struct LoopWrap {
+        qreal at; // the clock value where the new loop starts
+        qreal offset; // added to timestamps of the loop
+        int count;
+    };
+    mutable QMutex loop_mutex; // guards settings and loop_wraps
+    qint64 loop_start, loop_stop;
+    int loop_left;
+    bool loop_wrap; // the primary stream reached loop_stop
+    qreal loop_end; // end time of the primary stream in the current loop
+    qreal loop_offset, loop_length; // of the latest wrap
+    int loop_count; // wraps since start()
+    int loop_base; // count of wraps before loop_wraps
+    qreal loop_base_offset;
+    QVector<LoopWrap> loop_wraps;
+    TimeshiftBuffer timeshift;
+    QMutex recorder_mutex;
+    PacketRecorder *recorder;
     QMutex buffer_mutex;
-    QWaitCondition cond;
-    BlockingQueue<QRunnable*> seek_tasks;
+    // events the thread waits for instead of polling: seek requests, resume, stop, a/v queues drained and a/v threads finished
+    QMutex wake_mutex;
+    QWaitCondition wake_cond;
+    bool wake_pending;
+    // only the latest seek request is kept. older pending ones are dropped
+    QMutex seek_mutex;
+    QRunnable *seek_task;
 
     QAtomicInt nb_next_frame;
     QMutex next_frame_mutex;
     int clock_type; // change happens in different threads(direct connection)
     friend class SeekTask;
+    friend class AudioReader;
+    friend class QueueEmptyCall;
 };
 
 } //namespace QtAV
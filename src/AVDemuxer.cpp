@@ -21,7 +21,11 @@
 
 #include "QtAV/AVDemuxer.h"
 #include "QtAV/MediaIO.h"
+#include "QtAV/Statistics.h"
 #include "QtAV/private/AVCompat.h"
+#include <QtCore/QDateTime>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
 #include <QtCore/QMutex>
 #include <QtCore/QStringList>
 #if QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
@@ -30,7 +34,10 @@
 #include <QtCore/QTime>
 typedef QTime QElapsedTimer;
 #endif
+#include "KeyFrameIndexer.h"
+#include "utils/BitstreamFilter.h"
 #include "utils/internal.h"
+#include "utils/StreamInfoCache.h"
 #include "utils/Logger.h"
 
 namespace QtAV {
@@ -51,6 +58,9 @@ public:
       , mTimeout(timeout)
       , mTimeoutAbort(true)
       , mEmitError(true)
+      , mDeadline(0)
+      , mLoading(false)
+      , mAbort(false)
       //, mLastTime(0)
       , mAction(Open)
       , mpDemuxer(demuxer)
@@ -86,6 +96,18 @@ public:
             break;
         }
     }
+    // start the total timer of opening and probing
+    void beginLoad() {
+        mLoading = true;
+        mLoadTimer.start();
+    }
+    // opening and probing are finished. the deadline is not applied to later io, e.g. seek
+    void endLoad() { mLoading = false; }
+    qint64 loadElapsed() const { return mLoadTimer.elapsed(); }
+    qint64 getDeadline() const { return mDeadline; }
+    void setDeadline(qint64 value) { mDeadline = value; }
+    bool isAborted() const { return mAbort; }
+    void setAborted(bool value) { mAbort = value; }
     qint64 getTimeout() const { return mTimeout; }
     void setTimeout(qint64 timeout) { mTimeout = timeout; }
     bool setInterruptOnTimeout(bool value) {
@@ -112,6 +134,9 @@ public:
             qWarning("InterruptHandler is null");
             return -1;
         }
+        // checked first and no log, ffmpeg calls it very frequently
+        if (handler->mAbort)
+            return 1;
         //check manual interruption
         if (handler->getStatus() < 0) {
             qDebug("User Interrupt: -> quit!");
@@ -134,6 +159,12 @@ public:
         default:
             break;
         }
+        if (handler->mLoading && handler->mDeadline > 0 && handler->mLoadTimer.elapsed() > handler->mDeadline) {
+            qDebug("Load deadline expired: %lld/%lld -> quit!", handler->mLoadTimer.elapsed(), handler->mDeadline);
+            if (handler->mStatus == 0)
+                handler->mStatus = handler->mAction == Open ? (int)AVError::OpenTimedout : (int)AVError::FindStreamInfoTimedout;
+            return 1;
+        }
         if (handler->mTimeout < 0)
             return 0;
         if (!handler->mTimer.isValid()) {
@@ -180,10 +211,15 @@ private:
     qint64 mTimeout;
     bool mTimeoutAbort;
     bool mEmitError;
+    qint64 mDeadline;
+    bool mLoading; // between beginLoad() and endLoad()
+    volatile bool mAbort;
     //qint64 mLastTime;
     Action mAction;
     AVDemuxer *mpDemuxer;
+    friend class AVDemuxer;
     QElapsedTimer mTimer;
+    QElapsedTimer mLoadTimer;
 };
 
 class AVDemuxer::Private
@@ -206,9 +242,17 @@ public:
         , seek_unit(SeekByTime)
         , seek_type(AccurateSeek)
         , dict(0)
+        , fast_start(false)
+        , discard_unselected(true)
+        , probe_time(0)
+        , connect_time(0)
+        , kf_index_enabled(false)
+        , kf_index(0)
         , interrupt_hanlder(0)
     {}
     ~Private() {
+        qDeleteAll(bsfs);
+        delete kf_index;
         delete interrupt_hanlder;
         if (dict) {
             av_dict_free(&dict);
@@ -264,8 +308,35 @@ public:
     // set wanted_xx_stream. call openCodecs() to read new stream frames
     // stream < 0 is choose best
     bool setStream(AVDemuxer::StreamType st, int streamValue);
+    // AVDISCARD_ALL for unselected streams if discard_unselected, otherwise AVDISCARD_DEFAULT for all
+    void updateDiscard();
     //called by loadFile(). if change to a new stream, call it(e.g. in AVPlayer)
     bool prepareStreams();
+    // empty if the source can not be identified, e.g. QIODevice
+    QString probeCacheKey() const {
+        if (!file.isEmpty())
+            return file;
+        if (input)
+            return input->url();
+        return QString();
+    }
+    // size and mtime of a local file. size is -1 if not a local file (or unknown before open)
+    void fingerprint(qint64 *size, qint64 *mtime) const {
+        *size = -1;
+        *mtime = 0;
+        QFileInfo fi(file);
+        if (file.isEmpty() || !fi.isFile())
+            return;
+        *size = fi.size();
+        *mtime = fi.lastModified().toTime_t();
+    }
+    StreamInfoCache::Entry probeCacheEntry() const;
+    // fill unknown parameters if streams are the same as cached. format_ctx must be open
+    void applyProbeCache(const StreamInfoCache::Entry& e);
+    // whether the container header has enough parameters to open decoders without avformat_find_stream_info()
+    bool hasCodecParameters() const;
+    // seek to the key frame before upos in kf_index. return false if not indexed
+    bool seekByKeyFrameIndex(qint64 upos);
 
     MediaStatus media_status;
     bool seekable;
@@ -292,6 +363,13 @@ public:
 
     AVDictionary *dict;
     QVariantHash options;
+    bool fast_start;
+    bool discard_unselected;
+    qint64 probe_time;
+    qint64 connect_time;
+    bool kf_index_enabled;
+    KeyFrameIndexer *kf_index; // created by buildKeyFrameIndex() for current media
+    QHash<int, BitstreamFilter*> bsfs; // by stream index. applied in readFrameLocked()
     typedef struct StreamInfo {
         StreamInfo()
             : stream(-1)
@@ -368,14 +446,44 @@ bool AVDemuxer::readFrame()
 {
     QMutexLocker lock(&d->mutex);
     Q_UNUSED(lock);
+    return readFrameLocked() > 0;
+}
+
+int AVDemuxer::readFrames(QVector<Packet> *packets, QVector<int> *streams, int maxPackets, qint64 maxBytes)
+{
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    int n = 0, skipped = 0;
+    qint64 bytes = 0;
+    while (n < maxPackets && (maxBytes <= 0 || bytes < maxBytes)) {
+        const int ret = readFrameLocked();
+        if (ret < 0)
+            break;
+        if (ret == 0) { // unselected stream. do not hold the lock too long
+            if (++skipped >= maxPackets)
+                break;
+            continue;
+        }
+        packets->append(d->pkt);
+        streams->append(d->stream);
+        bytes += d->pkt.data.size();
+        ++n;
+    }
+    return n;
+}
+
+int AVDemuxer::readFrameLocked()
+{
     if (!d->format_ctx)
-        return false;
+        return -1;
     d->pkt = Packet();
     // no lock required because in AVDemuxThread read and seek are in the same thread
     AVPacket packet;
     d->interrupt_hanlder->begin(InterruptHandler::Read);
     int ret = av_read_frame(d->format_ctx, &packet); //0: ok, <0: error/end
     d->interrupt_hanlder->end();
+    if (ret < 0 && d->interrupt_hanlder->isAborted()) // not eof or error
+        return -1;
     // TODO: why return 0 if interrupted by user?
     if (ret < 0) {
         //end of file. FIXME: why no d->eof if replaying by seek(0)?
@@ -397,17 +505,17 @@ bool AVDemuxer::readFrame()
 #endif
                 qDebug("End of file. erreof=%d feof=%d", ret == AVERROR_EOF, avio_feof(d->format_ctx->pb));
             }
-            return false;
+            return -1;
         }
         if (ret == AVERROR(EAGAIN)) {
             qWarning("demuxer EAGAIN :%s", av_err2str(ret));
-            return false;
+            return -1;
         }
         AVError::ErrorCode ec(AVError::ReadError);
         QString msg(tr("error reading stream data"));
         handleError(ret, &ec, msg);
         qWarning("[AVDemuxer] error: %s", av_err2str(ret));
-        return false;
+        return -1;
     }
     d->stream = packet.stream_index;
     //check whether the 1st frame is alreay got. emit only once
@@ -417,15 +525,24 @@ bool AVDemuxer::readFrame()
     }
     if (d->stream != videoStream() && d->stream != audioStream() && d->stream != subtitleStream()) {
         //qWarning("[AVDemuxer] unknown stream index: %d", stream);
-        return false;
+        av_free_packet(&packet);
+        return 0;
+    }
+    if (!d->bsfs.isEmpty()) {
+        BitstreamFilter *bsf = d->bsfs.value(d->stream);
+        // packet is replaced by the filtered one. nothing to free if no output
+        if (bsf && !bsf->filter(&packet))
+            return 0;
     }
     d->pkt = Packet::fromAVPacket(&packet, av_q2d(d->format_ctx->streams[d->stream]->time_base));
     av_free_packet(&packet); //important!
+    if (Statistics::isLatencyTracing())
+        d->pkt.demuxTime = Statistics::tracingTime();
     d->eof = false;
     if (d->pkt.pts > qreal(duration())/1000.0) {
         d->max_pts = d->pkt.pts;
     }
-    return true;
+    return 1;
 }
 
 Packet AVDemuxer::packet() const
@@ -505,7 +622,7 @@ bool AVDemuxer::seek(qint64 pos)
 #else
     //TODO: d->pkt.pts may be 0, compute manually.
 
-    bool backward = d->seek_type == AccurateSeek || upos <= (int64_t)(d->pkt.pts*AV_TIME_BASE);
+    bool backward = d->seek_type == AccurateSeek || d->seek_type == PreviewSeek || upos <= (int64_t)(d->pkt.pts*AV_TIME_BASE);
     //qDebug("[AVDemuxer] seek to %f %f %lld / %lld backward=%d", double(upos)/double(durationUs()), d->pkt.pts, upos, durationUs(), backward);
     //AVSEEK_FLAG_BACKWARD has no effect? because we know the timestamp
     // FIXME: back flag is opposite? otherwise seek is bad and may crash?
@@ -514,17 +631,24 @@ bool AVDemuxer::seek(qint64 pos)
      * from AV_TIME_BASE units to the stream specific time_base.
      */
     int seek_flag = (backward ? AVSEEK_FLAG_BACKWARD : 0);
-    if (d->seek_type == AccurateSeek) {
+    if (d->seek_type == AccurateSeek || d->seek_type == PreviewSeek) {
         seek_flag = AVSEEK_FLAG_BACKWARD;
     }
     if (d->seek_type == AnyFrameSeek) {
         seek_flag = AVSEEK_FLAG_ANY;
     }
     //bool seek_bytes = !!(d->format_ctx->iformat->flags & AVFMT_TS_DISCONT) && strcmp("ogg", d->format_ctx->iformat->name);
-    int ret = av_seek_frame(d->format_ctx, -1, upos, seek_flag);
+    int ret = 0;
+    // land on the GOP directly. decoders drop frames before upos
+    if ((d->seek_type != AccurateSeek && d->seek_type != PreviewSeek) || !d->seekByKeyFrameIndex(upos))
+        ret = av_seek_frame(d->format_ctx, -1, upos, seek_flag);
     //int ret = avformat_seek_file(d->format_ctx, -1, INT64_MIN, upos, upos, seek_flag);
     //avformat_seek_file()
 #endif
+    if (ret < 0 && d->interrupt_hanlder->isAborted()) {
+        qDebug("seek is aborted");
+        return false;
+    }
     if (ret < 0) {
         AVError::ErrorCode ec(AVError::SeekError);
         QString msg(tr("seek error"));
@@ -674,6 +798,8 @@ bool AVDemuxer::load()
     }
     QMutexLocker lock(&d->mutex);
     Q_UNUSED(lock);
+    d->interrupt_hanlder->beginLoad();
+    d->probe_time = d->connect_time = 0;
     setMediaStatus(LoadingMedia);
     d->checkNetwork();
 #if QTAV_HAVE(AVDEVICE)
@@ -709,7 +835,30 @@ bool AVDemuxer::load()
         d->input_format = av_find_input_format(d->format_forced.toUtf8().constData());
         qDebug() << "force format: " << d->format_forced;
     }
+    QElapsedTimer probe_timer;
+    probe_timer.start();
+    const QString cache_key(d->probeCacheKey());
+    qint64 media_size = -1, media_mtime = 0;
+    d->fingerprint(&media_size, &media_mtime);
+    StreamInfoCache::Entry cached;
+    // a media in disk cache is loaded fast even if not fast start
+    bool has_cache = (d->fast_start || !StreamInfoCache::instance().directory().isEmpty())
+            && !cache_key.isEmpty() && StreamInfoCache::instance().get(cache_key, &cached);
+    if (has_cache && (cached.mtime != media_mtime || (media_size >= 0 && cached.size != media_size))) {
+        qDebug("stream info cache is out of date");
+        has_cache = false;
+    }
+    if (d->fast_start) {
+        // user options have higher priority
+        av_dict_set(&d->dict, "probesize", "32768", AV_DICT_DONT_OVERWRITE);
+        av_dict_set(&d->dict, "analyzeduration", "500000", AV_DICT_DONT_OVERWRITE);
+    }
+    if (has_cache && !d->input_format && !cached.format.isEmpty()) {
+        d->input_format = av_find_input_format(cached.format.constData());
+        qDebug("probed format from cache: %s", cached.format.constData());
+    }
     int ret = 0;
+    Q_EMIT loadProgress(QStringLiteral("connect"), d->interrupt_hanlder->loadElapsed());
     // used dict entries will be removed in avformat_open_input
     d->interrupt_hanlder->begin(InterruptHandler::Open);
     if (d->input) {
@@ -719,15 +868,17 @@ bool AVDemuxer::load()
         d->format_ctx->pb = (AVIOContext*)d->input->avioContext();
         d->format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
         qDebug("avformat_open_input: d->format_ctx:'%p'..., MediaIO('%s'): %p", d->format_ctx, d->input->name().toUtf8().constData(), d->input);
-        ret = avformat_open_input(&d->format_ctx, "MediaIO", d->input_format, d->options.isEmpty() ? NULL : &d->dict);
+        ret = avformat_open_input(&d->format_ctx, "MediaIO", d->input_format, d->dict ? &d->dict : NULL);
         qDebug("avformat_open_input: (with MediaIO) ret:%d", ret);
     } else {
         qDebug("avformat_open_input: d->format_ctx:'%p', url:'%s'...",d->format_ctx, qPrintable(d->file));
-        ret = avformat_open_input(&d->format_ctx, d->file.toUtf8().constData(), d->input_format, d->options.isEmpty() ? NULL : &d->dict);
+        ret = avformat_open_input(&d->format_ctx, d->file.toUtf8().constData(), d->input_format, d->dict ? &d->dict : NULL);
         qDebug("avformat_open_input: url:'%s' ret:%d",qPrintable(d->file), ret);
     }
     d->interrupt_hanlder->end();
+    d->connect_time = probe_timer.elapsed();
     if (ret < 0) {
+        d->interrupt_hanlder->endLoad();
         // d->format_ctx is 0
         AVError::ErrorCode ec = AVError::OpenError;
         QString msg = tr("failed to open media");
@@ -738,12 +889,32 @@ bool AVDemuxer::load()
         Q_EMIT unloaded(); //context not ready. so will not emit in unload()
         return false;
     }
+    // size of a remote media is known after open
+    if (media_size < 0 && d->format_ctx->pb)
+        media_size = avio_size(d->format_ctx->pb);
+    if (has_cache && cached.size > 0 && media_size > 0 && cached.size != media_size) {
+        qDebug("stream info cache is out of date. size: %lld=>%lld", cached.size, media_size);
+        has_cache = false;
+    }
+    bool find_info = true;
+    if (has_cache)
+        d->applyProbeCache(cached);
+    if (d->fast_start || has_cache) {
+        find_info = !d->hasCodecParameters();
+        qDebug("fast start: avformat_find_stream_info %s", find_info ? "is required" : "is skipped");
+    }
     //deprecated
     //if(av_find_stread->inputfo(d->format_ctx)<0) {
     //TODO: avformat_find_stread->inputfo is too slow, only useful for some video format
-    d->interrupt_hanlder->begin(InterruptHandler::FindStreamInfo);
-    ret = avformat_find_stream_info(d->format_ctx, NULL);
-    d->interrupt_hanlder->end();
+    if (find_info) {
+        Q_EMIT loadProgress(QStringLiteral("probe"), d->interrupt_hanlder->loadElapsed());
+        d->interrupt_hanlder->begin(InterruptHandler::FindStreamInfo);
+        ret = avformat_find_stream_info(d->format_ctx, NULL);
+        d->interrupt_hanlder->end();
+    }
+    d->interrupt_hanlder->endLoad();
+    d->probe_time = probe_timer.elapsed();
+    qDebug("probe time: %lldms, connect time: %lldms", d->probe_time, d->connect_time);
     if (ret < 0) {
         setMediaStatus(InvalidMedia);
         AVError::ErrorCode ec(AVError::FindStreamInfoError);
@@ -755,6 +926,12 @@ bool AVDemuxer::load()
             setMediaStatus(InvalidMedia);
         return false;
     }
+    if (find_info && !cache_key.isEmpty()) {
+        StreamInfoCache::Entry e(d->probeCacheEntry());
+        e.size = media_size;
+        e.mtime = media_mtime;
+        StreamInfoCache::instance().put(cache_key, e);
+    }
 
     if (!d->prepareStreams()) {
         if (mediaStatus() == LoadingMedia)
@@ -763,7 +940,10 @@ bool AVDemuxer::load()
     }
     d->started = false;
     setMediaStatus(LoadedMedia);
+    Q_EMIT loadProgress(QStringLiteral("loaded"), d->interrupt_hanlder->loadElapsed());
     emit loaded();
+    if (d->kf_index_enabled)
+        buildKeyFrameIndex();
     const bool was_seekable = d->seekable;
     d->seekable = d->checkSeekable();
     if (was_seekable != d->seekable)
@@ -794,7 +974,14 @@ bool AVDemuxer::unload()
     d->started = false;
     d->max_pts = 0.0;
     d->resetStreams();
+    qDeleteAll(d->bsfs);
+    d->bsfs.clear();
     d->interrupt_hanlder->setStatus(0);
+    d->interrupt_hanlder->endLoad();
+    if (d->kf_index) {
+        delete d->kf_index; // stop scanning the old media
+        d->kf_index = 0;
+    }
     //av_close_input_file(d->format_ctx); //deprecated
     if (d->format_ctx) {
         qDebug("closing d->format_ctx");
@@ -814,6 +1001,27 @@ bool AVDemuxer::isLoaded() const
     return d->format_ctx && (d->astream.avctx || d->vstream.avctx || d->sstream.avctx);
 }
 
+void AVDemuxer::swap(AVDemuxer &other)
+{
+    if (&other == this)
+        return;
+    if (d->kf_index)
+        disconnect(d->kf_index, 0, this, 0);
+    if (other.d->kf_index)
+        disconnect(other.d->kf_index, 0, &other, 0);
+    d.swap(other.d);
+    d->interrupt_hanlder->mpDemuxer = this;
+    other.d->interrupt_hanlder->mpDemuxer = &other;
+    if (d->kf_index) {
+        connect(d->kf_index, SIGNAL(progressChanged(qreal)), this, SIGNAL(keyFrameIndexProgressChanged(qreal)));
+        connect(d->kf_index, SIGNAL(indexFinished()), this, SIGNAL(keyFrameIndexReady()));
+    }
+    if (other.d->kf_index) {
+        connect(other.d->kf_index, SIGNAL(progressChanged(qreal)), &other, SIGNAL(keyFrameIndexProgressChanged(qreal)));
+        connect(other.d->kf_index, SIGNAL(indexFinished()), &other, SIGNAL(keyFrameIndexReady()));
+    }
+}
+
 bool AVDemuxer::hasAttacedPicture() const
 {
     return d->has_attached_pic;
@@ -847,6 +1055,7 @@ bool AVDemuxer::setStreamIndex(StreamType st, int index)
         si->stream = -1;
         si->wanted_index = -1;
         si->wanted_stream = -1;
+        d->updateDiscard();
         return true;
     }
     if (!d->setStream(st, streams->at(index)))
@@ -1054,6 +1263,26 @@ void AVDemuxer::setInterruptStatus(int interrupt)
     d->interrupt_hanlder->setStatus(interrupt);
 }
 
+void AVDemuxer::abortIO(bool value)
+{
+    d->interrupt_hanlder->setAborted(value);
+}
+
+bool AVDemuxer::isIOAborted() const
+{
+    return d->interrupt_hanlder->isAborted();
+}
+
+void AVDemuxer::setLoadDeadline(qint64 ms)
+{
+    d->interrupt_hanlder->setDeadline(ms);
+}
+
+qint64 AVDemuxer::loadDeadline() const
+{
+    return d->interrupt_hanlder->getDeadline();
+}
+
 void AVDemuxer::setOptions(const QVariantHash &dict)
 {
     d->options = dict;
@@ -1065,6 +1294,135 @@ QVariantHash AVDemuxer::options() const
     return d->options;
 }
 
+void AVDemuxer::setFastStart(bool value)
+{
+    d->fast_start = value;
+}
+
+void AVDemuxer::setDiscardUnselectedStreams(bool value)
+{
+    if (d->discard_unselected == value)
+        return;
+    d->discard_unselected = value;
+    d->updateDiscard();
+}
+
+bool AVDemuxer::isDiscardUnselectedStreams() const
+{
+    return d->discard_unselected;
+}
+
+bool AVDemuxer::setBitstreamFilter(StreamType st, const QString &filters)
+{
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    const int s = currentStream(st);
+    if (s < 0 || !d->format_ctx || s >= (int)d->format_ctx->nb_streams)
+        return false;
+    BitstreamFilter *bsf = d->bsfs.value(s);
+    if (bsf && bsf->filters() == filters)
+        return true;
+    delete d->bsfs.take(s);
+    if (filters.isEmpty())
+        return true;
+    AVStream *stream = d->format_ctx->streams[s];
+    bsf = new BitstreamFilter();
+    if (!bsf->open(filters, stream->codec, stream->time_base)) {
+        delete bsf;
+        return false;
+    }
+    // decoders opened later get parameters of the filtered packets. the filters treat already filtered input as is
+    bsf->applyParameters(stream->codec);
+    d->bsfs.insert(s, bsf);
+    qDebug("bitstream filter '%s' for stream %d", filters.toUtf8().constData(), s);
+    return true;
+}
+
+QString AVDemuxer::bitstreamFilter(StreamType st) const
+{
+    QMutexLocker lock(&d->mutex);
+    Q_UNUSED(lock);
+    const BitstreamFilter *bsf = d->bsfs.value(currentStream(st));
+    return bsf ? bsf->filters() : QString();
+}
+
+bool AVDemuxer::isFastStart() const
+{
+    return d->fast_start;
+}
+
+qint64 AVDemuxer::probeTime() const
+{
+    return d->probe_time;
+}
+
+qint64 AVDemuxer::connectTime() const
+{
+    return d->connect_time;
+}
+
+void AVDemuxer::setStreamInfoCacheDir(const QString &dir, qint64 maxBytes)
+{
+    StreamInfoCache::instance().setDirectory(dir, maxBytes);
+}
+
+QString AVDemuxer::streamInfoCacheDir()
+{
+    return StreamInfoCache::instance().directory();
+}
+
+void AVDemuxer::setKeyFrameIndexEnabled(bool value)
+{
+    d->kf_index_enabled = value;
+}
+
+bool AVDemuxer::isKeyFrameIndexEnabled() const
+{
+    return d->kf_index_enabled;
+}
+
+bool AVDemuxer::buildKeyFrameIndex()
+{
+    if (d->kf_index)
+        return true;
+    if (!d->format_ctx || d->vstream.stream < 0 || durationUs() <= 0)
+        return false;
+    if (d->has_attached_pic)
+        return false;
+    QString url(d->file);
+    if (d->input) {
+        url = d->input->url();
+        if (url.isEmpty()) {
+            qWarning("Can not build key frame index for MediaIO without url");
+            return false;
+        }
+    }
+    d->kf_index = new KeyFrameIndexer(url, !!d->input, d->format_ctx->iformat, d->vstream.stream);
+    connect(d->kf_index, SIGNAL(progressChanged(qreal)), this, SIGNAL(keyFrameIndexProgressChanged(qreal)));
+    connect(d->kf_index, SIGNAL(indexFinished()), this, SIGNAL(keyFrameIndexReady()));
+    const QString key(d->probeCacheKey());
+    StreamInfoCache::Entry e;
+    if (!key.isEmpty() && StreamInfoCache::instance().get(key, &e)
+            && e.keyframe_stream == d->vstream.stream && !e.keyframes.isEmpty()) {
+        qDebug("key frame index from cache");
+        d->kf_index->setEntries(KeyFrameIndexer::fromArray(e.keyframes));
+        return true;
+    }
+    d->kf_index->setCacheKey(key);
+    d->kf_index->start(QThread::LowPriority);
+    return true;
+}
+
+bool AVDemuxer::hasKeyFrameIndex() const
+{
+    return d->kf_index && d->kf_index->isComplete();
+}
+
+qreal AVDemuxer::keyFrameIndexProgress() const
+{
+    return d->kf_index ? d->kf_index->progress() : 0;
+}
+
 void AVDemuxer::setMediaStatus(MediaStatus status)
 {
     if (d->media_status == status)
@@ -1208,9 +1566,21 @@ bool AVDemuxer::Private::setStream(AVDemuxer::StreamType st, int streamValue)
     si->wanted_stream = streamValue;
     si->avctx = format_ctx->streams[s]->codec;
     has_attached_pic = !!(format_ctx->streams[s]->disposition & AV_DISPOSITION_ATTACHED_PIC);
+    updateDiscard();
     return true;
 }
 
+void AVDemuxer::Private::updateDiscard()
+{
+    if (!format_ctx)
+        return;
+    for (unsigned int i = 0; i < format_ctx->nb_streams; ++i) {
+        const int s = i;
+        const bool selected = !discard_unselected || s == astream.stream || s == vstream.stream || s == sstream.stream;
+        format_ctx->streams[i]->discard = selected ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+}
+
 bool AVDemuxer::Private::prepareStreams()
 {
     has_attached_pic = false;
@@ -1235,4 +1605,129 @@ bool AVDemuxer::Private::prepareStreams()
     setStream(AVDemuxer::SubtitleStream, -1);
     return true;
 }
+StreamInfoCache::Entry AVDemuxer::Private::probeCacheEntry() const
+{
+    StreamInfoCache::Entry e;
+    if (!format_ctx)
+        return e;
+    if (format_ctx->iformat)
+        e.format = format_ctx->iformat->name;
+    e.size = -1;
+    e.mtime = 0;
+    e.keyframe_stream = -1;
+    e.start_time = format_ctx->start_time;
+    e.duration = format_ctx->duration;
+    e.streams.resize(format_ctx->nb_streams);
+    for (unsigned int i = 0; i < format_ctx->nb_streams; ++i) {
+        const AVStream *st = format_ctx->streams[i];
+        const AVCodecContext *avctx = st->codec;
+        StreamInfoCache::Stream &s = e.streams[i];
+        s.type = avctx->codec_type;
+        s.codec_id = avctx->codec_id;
+        s.width = avctx->width;
+        s.height = avctx->height;
+        s.pix_fmt = avctx->pix_fmt;
+        s.sample_rate = avctx->sample_rate;
+        s.channels = avctx->channels;
+        s.sample_fmt = avctx->sample_fmt;
+        s.channel_layout = avctx->channel_layout;
+        s.avg_frame_rate = st->avg_frame_rate;
+        if (avctx->extradata_size > 0)
+            s.extradata = QByteArray((const char*)avctx->extradata, avctx->extradata_size);
+    }
+    return e;
+}
+
+void AVDemuxer::Private::applyProbeCache(const StreamInfoCache::Entry &e)
+{
+    if ((int)format_ctx->nb_streams != e.streams.size())
+        return;
+    for (int i = 0; i < e.streams.size(); ++i) {
+        const AVCodecContext *avctx = format_ctx->streams[i]->codec;
+        if (avctx->codec_type != e.streams[i].type || avctx->codec_id != e.streams[i].codec_id) {
+            qDebug("fast start: streams changed. ignore cache");
+            return;
+        }
+    }
+    for (int i = 0; i < e.streams.size(); ++i) {
+        AVStream *st = format_ctx->streams[i];
+        AVCodecContext *avctx = st->codec;
+        const StreamInfoCache::Stream &s = e.streams[i];
+        if (avctx->width <= 0 || avctx->height <= 0) {
+            avctx->width = s.width;
+            avctx->height = s.height;
+        }
+        if (avctx->pix_fmt == QTAV_PIX_FMT_C(NONE))
+            avctx->pix_fmt = (AVPixelFormat)s.pix_fmt;
+        if (avctx->sample_rate <= 0)
+            avctx->sample_rate = s.sample_rate;
+        if (avctx->channels <= 0) {
+            avctx->channels = s.channels;
+            avctx->channel_layout = s.channel_layout;
+        }
+        if (avctx->sample_fmt == AV_SAMPLE_FMT_NONE)
+            avctx->sample_fmt = (AVSampleFormat)s.sample_fmt;
+        if (st->avg_frame_rate.num <= 0 || st->avg_frame_rate.den <= 0)
+            st->avg_frame_rate = s.avg_frame_rate;
+        if (avctx->extradata_size <= 0 && !s.extradata.isEmpty()) {
+            avctx->extradata = (uint8_t*)av_mallocz(s.extradata.size() + FF_INPUT_BUFFER_PADDING_SIZE);
+            if (avctx->extradata) {
+                memcpy(avctx->extradata, s.extradata.constData(), s.extradata.size());
+                avctx->extradata_size = s.extradata.size();
+            }
+        }
+    }
+    // used if avformat_find_stream_info() is skipped
+    if (format_ctx->start_time == (int64_t)AV_NOPTS_VALUE)
+        format_ctx->start_time = e.start_time;
+    if (format_ctx->duration == (int64_t)AV_NOPTS_VALUE || format_ctx->duration <= 0)
+        format_ctx->duration = e.duration;
+}
+
+bool AVDemuxer::Private::hasCodecParameters() const
+{
+    if (!format_ctx || format_ctx->nb_streams == 0)
+        return false;
+    for (unsigned int i = 0; i < format_ctx->nb_streams; ++i) {
+        const AVCodecContext *avctx = format_ctx->streams[i]->codec;
+        if (avctx->codec_id == QTAV_CODEC_ID(NONE))
+            return false;
+        if (avctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+            // attached picture is decoded without parameters
+            if (!(format_ctx->streams[i]->disposition & AV_DISPOSITION_ATTACHED_PIC)
+                    && (avctx->width <= 0 || avctx->height <= 0))
+                return false;
+        } else if (avctx->codec_type == AVMEDIA_TYPE_AUDIO) {
+            if (avctx->sample_rate <= 0 || avctx->channels <= 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+bool AVDemuxer::Private::seekByKeyFrameIndex(qint64 upos)
+{
+    if (!kf_index)
+        return false;
+    const int s = kf_index->stream();
+    if (s < 0 || s >= (int)format_ctx->nb_streams)
+        return false;
+    const AVStream *st = format_ctx->streams[s];
+    KeyFrameIndexer::Entry e;
+    if (!kf_index->find(av_rescale_q(upos, AV_TIME_BASE_Q, st->time_base), &e))
+        return false;
+    // timestamps are not reliable, e.g. mpegts. byte position is exact
+    const bool by_byte = e.pos >= 0 && (format_ctx->iformat->flags & AVFMT_TS_DISCONT) && !(format_ctx->iformat->flags & AVFMT_NO_BYTE_SEEK);
+    int ret = 0;
+    if (by_byte)
+        ret = av_seek_frame(format_ctx, -1, e.pos, AVSEEK_FLAG_BYTE);
+    else
+        ret = av_seek_frame(format_ctx, s, e.dts, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+        qDebug("seek by key frame index error: %s", av_err2str(ret));
+        return false;
+    }
+    return true;
+}
+
 } //namespace QtAV
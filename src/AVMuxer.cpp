@@ -50,6 +50,16 @@ public:
         , dict(0)
         , aenc(0)
         , venc(0)
+        , copy_actx(0)
+        , copy_vctx(0)
+        , segment_duration(0)
+        , fragment_duration(0)
+        , mem_ctx(0)
+        , segment_index(0)
+        , segment_start(0)
+        , fragment_start(0)
+        , segment_end(0)
+        , fragment_independent(true)
     {
         av_register_all();
     }
@@ -63,9 +73,29 @@ public:
             delete io;
             io = 0;
         }
+        releaseMemory();
     }
     AVStream* addStream(AVFormatContext* ctx, const QString& codecName, AVCodecID codecId);
+    AVStream* addStreamCopy(AVFormatContext* ctx, AVCodecContext* avctx);
+    // for stream copy. avpkt of a demuxed packet is in the source time base, the timestamps in seconds are used instead
+    static void setTimestamps(AVPacket* pkt, const Packet& packet, const AVStream* s) {
+        const double tb = av_q2d(s->time_base);
+        pkt->pts = qRound64(packet.pts/tb);
+        pkt->dts = qRound64(packet.dts/tb);
+        pkt->duration = qRound64(packet.duration/tb);
+    }
     bool prepareStreams();
+    static int writeMemory(void *opaque, unsigned char *buf, int buf_size) {
+        Private *p = static_cast<Private*>(opaque);
+        p->fragment.append((const char*)buf, buf_size);
+        return buf_size;
+    }
+    void releaseMemory() {
+        if (!mem_ctx)
+            return;
+        av_freep(&mem_ctx->buffer);
+        av_freep(&mem_ctx);
+    }
     void applyOptionsForDict();
     void applyOptionsForContext();
 
@@ -87,6 +117,15 @@ public:
     QList<int> audio_streams, video_streams, subtitle_streams;
     AudioEncoder *aenc; // not owner
     VideoEncoder *venc; // not owner
+    AVCodecContext *copy_actx, *copy_vctx; // not owner
+    // segment output
+    qreal segment_duration, fragment_duration;
+    AVIOContext *mem_ctx;
+    QByteArray fragment, segment; // data of current fragment and segment
+    int segment_index;
+    qreal segment_start, fragment_start;
+    qreal segment_end; // end time of the last packet checked
+    bool fragment_independent;
 };
 
 AVStream *AVMuxer::Private::addStream(AVFormatContext* ctx, const QString &codecName, AVCodecID codecId)
@@ -129,6 +168,25 @@ AVStream *AVMuxer::Private::addStream(AVFormatContext* ctx, const QString &codec
     return s;
 }
 
+AVStream *AVMuxer::Private::addStreamCopy(AVFormatContext *ctx, AVCodecContext *avctx)
+{
+    AVStream *s = avformat_new_stream(ctx, NULL);
+    if (!s) {
+        qWarning("Can not allocate stream");
+        return 0;
+    }
+    s->id = ctx->nb_streams - 1;
+    s->time_base = kTB;
+    AVCodecContext *c = s->codec;
+    AV_ENSURE_OK(avcodec_copy_context(c, avctx), 0);
+    // codec tag of the source container may be invalid for output format. let the muxer choose one
+    c->codec_tag = 0;
+    c->time_base = s->time_base;
+    if (ctx->oformat->flags & AVFMT_GLOBALHEADER)
+        c->flags |= CODEC_FLAG_GLOBAL_HEADER;
+    return s;
+}
+
 bool AVMuxer::Private::prepareStreams()
 {
     audio_streams.clear();
@@ -146,6 +204,10 @@ bool AVMuxer::Private::prepareStreams()
             c->pix_fmt = (AVPixelFormat)VideoFormat::pixelFormatToFFmpeg(venc->pixelFormat());
             video_streams.push_back(s->id);
         }
+    } else if (copy_vctx) {
+        AVStream *s = addStreamCopy(format_ctx, copy_vctx);
+        if (s)
+            video_streams.push_back(s->id);
     }
     if (aenc) {
         AVStream *s = addStream(format_ctx, aenc->codecName(), fmt->audio_codec);
@@ -160,6 +222,10 @@ bool AVMuxer::Private::prepareStreams()
             c->bits_per_raw_sample = aenc->audioFormat().bytesPerSample()*8; // need??
             audio_streams.push_back(s->id);
         }
+    } else if (copy_actx) {
+        AVStream *s = addStreamCopy(format_ctx, copy_actx);
+        if (s)
+            audio_streams.push_back(s->id);
     }
     return !(audio_streams.isEmpty() && video_streams.isEmpty() && subtitle_streams.isEmpty());
 }
@@ -316,8 +382,25 @@ bool AVMuxer::open()
         qDebug() << "force format: " << d->format_forced;
     }
 
+    const bool segment_output = d->segment_duration > 0;
+    if (segment_output) {
+        if (d->format_forced.isEmpty())
+            d->format_forced = QStringLiteral("mp4");
+        if (!av_dict_get(d->dict, "movflags", NULL, 0))
+            av_dict_set(&d->dict, "movflags", "frag_custom+empty_moov+default_base_moof", 0);
+    }
     //d->interrupt_hanlder->begin(InterruptHandler::Open);
-    if (d->io) {
+    if (segment_output) {
+        AV_ENSURE_OK(avformat_alloc_output_context2(&d->format_ctx, d->format, d->format_forced.toUtf8().constData(), ""), false);
+        const int buf_size = 32768;
+        d->mem_ctx = avio_alloc_context((unsigned char*)av_malloc(buf_size), buf_size, 1, d.data(), NULL, &Private::writeMemory, NULL);
+        d->format_ctx->pb = d->mem_ctx;
+        d->format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        d->fragment.clear();
+        d->segment.clear();
+        d->segment_index = 0;
+        d->fragment_independent = true;
+    } else if (d->io) {
         if (d->io->accessMode() == MediaIO::Read) {
             qWarning("wrong MediaIO accessMode. MUST be Write");
         }
@@ -342,6 +425,11 @@ bool AVMuxer::open()
     // d->format_ctx->start_time_realtime
     AV_ENSURE_OK(avformat_write_header(d->format_ctx, &d->dict), false);
     d->started = false;
+    if (segment_output) {
+        avio_flush(d->format_ctx->pb);
+        Q_EMIT initSegmentReady(d->fragment);
+        d->fragment.clear();
+    }
 
     return true;
 }
@@ -350,7 +438,14 @@ bool AVMuxer::close()
 {
     if (!isOpen())
         return true;
+    if (d->mem_ctx && d->started)
+        flushFragment(true, d->segment_end);
     av_write_trailer(d->format_ctx);
+    if (d->mem_ctx) { // trailer (mfra) is not a part of segments
+        d->fragment.clear();
+        d->format_ctx->pb = 0;
+        d->releaseMemory();
+    }
     // close AVCodecContext* in encoder
     // custom io will call avio_close in ~MediaIO()
     if (!(d->format_ctx->oformat->flags & AVFMT_NOFILE) && !(d->format_ctx->flags & AVFMT_FLAG_CUSTOM_IO)) {
@@ -375,11 +470,24 @@ bool AVMuxer::isOpen() const
 
 bool AVMuxer::writeAudio(const QtAV::Packet& packet)
 {
+#if QTAV_HAVE(AVPACKET_REF)
+    // the muxer modifies and takes the ownership of the packet. write a new reference instead of the shared one, no payload copy
+    AVPacket avpkt;
+    av_init_packet(&avpkt);
+    av_packet_ref(&avpkt, (AVPacket*)packet.asAVPacket());
+    AVPacket *pkt = &avpkt;
+#else
     AVPacket *pkt = (AVPacket*)packet.asAVPacket(); //FIXME
+#endif //QTAV_HAVE(AVPACKET_REF)
     pkt->stream_index = d->audio_streams[0]; //FIXME
+    if (d->mem_ctx && d->video_streams.isEmpty())
+        checkSegment(packet);
     AVStream *s = d->format_ctx->streams[pkt->stream_index];
     // stream.time_base is set in avformat_write_header
-    av_packet_rescale_ts(pkt, kTB, s->time_base);
+    if (!d->aenc && d->copy_actx)
+        d->setTimestamps(pkt, packet, s);
+    else
+        av_packet_rescale_ts(pkt, kTB, s->time_base);
     av_interleaved_write_frame(d->format_ctx, pkt);
 
     d->started = true;
@@ -388,11 +496,23 @@ bool AVMuxer::writeAudio(const QtAV::Packet& packet)
 
 bool AVMuxer::writeVideo(const QtAV::Packet& packet)
 {
+#if QTAV_HAVE(AVPACKET_REF)
+    AVPacket avpkt;
+    av_init_packet(&avpkt);
+    av_packet_ref(&avpkt, (AVPacket*)packet.asAVPacket());
+    AVPacket *pkt = &avpkt;
+#else
     AVPacket *pkt = (AVPacket*)packet.asAVPacket();
+#endif //QTAV_HAVE(AVPACKET_REF)
     pkt->stream_index = d->video_streams[0];
+    if (d->mem_ctx)
+        checkSegment(packet);
     AVStream *s = d->format_ctx->streams[pkt->stream_index];
     // stream.time_base is set in avformat_write_header
-    av_packet_rescale_ts(pkt, kTB, s->time_base);
+    if (!d->venc && d->copy_vctx)
+        d->setTimestamps(pkt, packet, s);
+    else
+        av_packet_rescale_ts(pkt, kTB, s->time_base);
     //av_write_frame
     av_interleaved_write_frame(d->format_ctx, pkt);
 #if 0
@@ -412,11 +532,25 @@ bool AVMuxer::writeVideo(const QtAV::Packet& packet)
 void AVMuxer::copyProperties(VideoEncoder *enc)
 {
     d->venc = enc;
+    d->copy_vctx = 0;
 }
 
 void AVMuxer::copyProperties(AudioEncoder *enc)
 {
     d->aenc = enc;
+    d->copy_actx = 0;
+}
+
+void AVMuxer::copyVideoContext(void *avctx)
+{
+    d->copy_vctx = (AVCodecContext*)avctx;
+    d->venc = 0;
+}
+
+void AVMuxer::copyAudioContext(void *avctx)
+{
+    d->copy_actx = (AVCodecContext*)avctx;
+    d->aenc = 0;
 }
 
 void AVMuxer::setOptions(const QVariantHash &dict)
@@ -430,6 +564,65 @@ QVariantHash AVMuxer::options() const
     return d->options;
 }
 
+void AVMuxer::setSegmentDuration(qreal seconds)
+{
+    d->segment_duration = seconds;
+}
+
+qreal AVMuxer::segmentDuration() const
+{
+    return d->segment_duration;
+}
+
+void AVMuxer::setFragmentDuration(qreal seconds)
+{
+    d->fragment_duration = seconds;
+}
+
+qreal AVMuxer::fragmentDuration() const
+{
+    return d->fragment_duration;
+}
+
+void AVMuxer::checkSegment(const Packet &packet)
+{
+    const qreal t = packet.pts;
+    if (!d->started) {
+        d->segment_start = d->fragment_start = t;
+        d->segment_end = t + packet.duration;
+        return;
+    }
+    d->segment_end = qMax(d->segment_end, t + packet.duration);
+    // audio packets are all key frames
+    if (packet.hasKeyFrame && t - d->segment_start >= d->segment_duration) {
+        flushFragment(true, t);
+        return;
+    }
+    if (d->fragment_duration > 0 && t - d->fragment_start >= d->fragment_duration)
+        flushFragment(false, t);
+}
+
+void AVMuxer::flushFragment(bool endOfSegment, qreal timestamp)
+{
+    // packets in interleaving queues belong to this fragment. then write moof+mdat of queued samples (frag_custom)
+    av_interleaved_write_frame(d->format_ctx, NULL);
+    av_write_frame(d->format_ctx, NULL);
+    avio_flush(d->format_ctx->pb);
+    if (!d->fragment.isEmpty()) {
+        Q_EMIT fragmentReady(d->fragment, d->segment_index, d->fragment_independent);
+        d->segment.append(d->fragment);
+        d->fragment.clear();
+    }
+    d->fragment_start = timestamp;
+    d->fragment_independent = endOfSegment;
+    if (!endOfSegment)
+        return;
+    Q_EMIT segmentReady(d->segment, d->segment_index, d->segment_start, timestamp - d->segment_start);
+    d->segment.clear();
+    d->segment_index++;
+    d->segment_start = timestamp;
+}
+
 void AVMuxer::Private::applyOptionsForDict()
 {
     if (dict) {
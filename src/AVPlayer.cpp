@@ -27,6 +27,8 @@
 #include <QtCore/QEvent>
 #include <QtCore/QDir>
 #include <QtCore/QIODevice>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
 #include <QtCore/QThreadPool>
 #include <QtCore/QTimer>
 #include "QtAV/AVDemuxer.h"
@@ -43,6 +45,7 @@
 #include "AudioThread.h"
 #include "VideoThread.h"
 #include "AVDemuxThread.h"
+#include "PacketRecorder.h"
 #include "QtAV/private/AVCompat.h"
 #include "utils/Logger.h"
 
@@ -51,7 +54,23 @@ namespace QtAV {
 
 static const qint64 kSeekMS = 10000;
 
-Q_GLOBAL_STATIC(QThreadPool, loaderThreadPool)
+// loading is mainly blocked by io. a small pool makes loading many media, e.g. a video wall, serial
+class LoaderThreadPool : public QThreadPool
+{
+public:
+    LoaderThreadPool() : QThreadPool() {
+        setMaxThreadCount(qMax(32, QThread::idealThreadCount()));
+    }
+};
+Q_GLOBAL_STATIC(LoaderThreadPool, loaderThreadPool)
+
+class PlayerList
+{
+public:
+    QMutex mutex;
+    QList<AVPlayer*> players;
+};
+Q_GLOBAL_STATIC(PlayerList, playerList)
 
 /// Supported input protocols. A static string list
 const QStringList& AVPlayer::supportedProtocols()
@@ -76,21 +95,39 @@ AVPlayer::AVPlayer(QObject *parent) :
     connect(&d->demuxer, SIGNAL(error(QtAV::AVError)), this, SIGNAL(error(QtAV::AVError)));
     connect(&d->demuxer, SIGNAL(mediaStatusChanged(QtAV::MediaStatus)), this, SLOT(updateMediaStatus(QtAV::MediaStatus)), Qt::DirectConnection);
     connect(&d->demuxer, SIGNAL(loaded()), this, SIGNAL(loaded()));
+    connect(&d->demuxer, SIGNAL(loadProgress(QString,qint64)), this, SIGNAL(loadProgress(QString,qint64)));
     connect(&d->demuxer, SIGNAL(seekableChanged()), this, SIGNAL(seekableChanged()));
+    connect(&d->demuxer, SIGNAL(keyFrameIndexProgressChanged(qreal)), this, SIGNAL(keyFrameIndexProgressChanged(qreal)));
     d->read_thread = new AVDemuxThread(this);
     d->read_thread->setDemuxer(&d->demuxer);
+    d->read_thread->setStatistics(&d->statistics);
     //direct connection can not sure slot order?
     connect(d->read_thread, SIGNAL(finished()), this, SLOT(stopFromDemuxerThread()));
     connect(d->read_thread, SIGNAL(requestClockPause(bool)), masterClock(), SLOT(pause(bool)), Qt::DirectConnection);
     connect(d->read_thread, SIGNAL(mediaStatusChanged(QtAV::MediaStatus)), this, SLOT(updateMediaStatus(QtAV::MediaStatus)));
     connect(d->read_thread, SIGNAL(bufferProgressChanged(qreal)), this, SIGNAL(bufferProgressChanged(qreal)));
+    connect(d->read_thread, SIGNAL(bufferValueChanged(qint64)), this, SIGNAL(bufferValueChanged(qint64)));
     connect(d->read_thread, SIGNAL(seekFinished(qint64)), this, SLOT(onSeekFinished()), Qt::DirectConnection);
     connect(d->read_thread, SIGNAL(internalSubtitlePacketRead(int, QtAV::Packet)), this, SIGNAL(internalSubtitlePacketRead(int, QtAV::Packet)), Qt::DirectConnection);
     d->vcapture = new VideoCapture(this);
+    PlayerList *pl = playerList();
+    if (pl) {
+        QMutexLocker lock(&pl->mutex);
+        Q_UNUSED(lock);
+        pl->players.append(this);
+    }
 }
 
 AVPlayer::~AVPlayer()
 {
+    PlayerList *pl = playerList();
+    if (pl) {
+        QMutexLocker lock(&pl->mutex);
+        Q_UNUSED(lock);
+        pl->players.removeAll(this);
+    }
+    cancelLoad();
+    d->waitForLoadTasks();
     stop();
     // if not uninstall here, player's qobject children filters will call uninstallFilter too late that player is almost be destroyed
     QList<Filter*> filters(FilterManager::instance().videoFilters(this));
@@ -115,6 +152,8 @@ void AVPlayer::addVideoRenderer(VideoRenderer *renderer)
         return;
     }
     renderer->setStatistics(&d->statistics);
+    if (d->battery_saver)
+        renderer->setPowerSaving(true);
     d->vos->addOutput(renderer);
 }
 
@@ -128,6 +167,24 @@ void AVPlayer::clearVideoRenderers()
     d->vos->clearOutputs();
 }
 
+void AVPlayer::setFrameSource(AVPlayer *source)
+{
+    if (source == this)
+        source = 0;
+    if (d->frame_source == source)
+        return;
+    if (d->frame_source)
+        d->frame_source->d->vos->removeFollower(d->vos);
+    d->frame_source = source;
+    if (source)
+        source->d->vos->addFollower(d->vos);
+}
+
+AVPlayer* AVPlayer::frameSource() const
+{
+    return d->frame_source;
+}
+
 //TODO: check components compatiblity(also when change the filter chain)
 void AVPlayer::setRenderer(VideoRenderer *r)
 {
@@ -184,6 +241,7 @@ void AVPlayer::setSpeed(qreal speed)
         d->ao->setSpeed(d->speed);
     }
     masterClock()->setSpeed(d->speed);
+    d->updateTrickPlay(this);
     emit speedChanged(d->speed);
 }
 
@@ -192,6 +250,32 @@ qreal AVPlayer::speed() const
     return d->speed;
 }
 
+void AVPlayer::setTrickPlaySpeed(qreal value)
+{
+    if (d->trick_play_speed == value)
+        return;
+    d->trick_play_speed = value;
+    d->updateTrickPlay(this);
+}
+
+qreal AVPlayer::trickPlaySpeed() const
+{
+    return d->trick_play_speed;
+}
+
+void AVPlayer::setKeyFrameOnlyDecode(bool value)
+{
+    if (d->key_frame_decode == value)
+        return;
+    d->key_frame_decode = value;
+    d->updateTrickPlay(this);
+}
+
+bool AVPlayer::isKeyFrameOnlyDecode() const
+{
+    return d->key_frame_decode;
+}
+
 void AVPlayer::setInterruptTimeout(qint64 ms)
 {
     if (ms < 0LL)
@@ -235,6 +319,7 @@ qreal AVPlayer::forcedFrameRate() const
 
 const Statistics& AVPlayer::statistics() const
 {
+    d->statistics.latency = d->read_thread->latency();
     return d->statistics;
 }
 
@@ -364,7 +449,12 @@ void AVPlayer::setPriority(const QVector<VideoDecoderId> &ids)
                 if (!vd)
                     continue;
                 vd->setCodecContext(avctx); // It's fine because AVDecoder copy the avctx properties
-                vd->setOptions(player->d->vc_opt);
+                if (!vd->isSupported()) {
+                    delete vd;
+                    vd = 0;
+                    continue;
+                }
+                vd->setOptions(player->d->videoCodecOptions());
                 if (vd->open()) {
                     qDebug("**************Video decoder found:%p", vd);
                     break;
@@ -418,6 +508,317 @@ QVariantHash AVPlayer::optionsForFormat() const
     return d->demuxer.options();
 }
 
+void AVPlayer::setFastStart(bool value)
+{
+    d->demuxer.setFastStart(value);
+}
+
+bool AVPlayer::isFastStart() const
+{
+    return d->demuxer.isFastStart();
+}
+
+qint64 AVPlayer::probeTime() const
+{
+    return d->demuxer.probeTime();
+}
+
+qint64 AVPlayer::connectTime() const
+{
+    return d->demuxer.connectTime();
+}
+
+qint64 AVPlayer::openCodecTime() const
+{
+    return d->open_codec_time;
+}
+
+void AVPlayer::setDecoupledDemux(bool value)
+{
+    d->decoupled_demux = value;
+}
+
+bool AVPlayer::isDecoupledDemux() const
+{
+    return d->decoupled_demux;
+}
+
+void AVPlayer::setLiveMode(bool value)
+{
+    if (d->live_mode == value)
+        return;
+    d->live_mode = value;
+    d->updateBufferValue();
+}
+
+bool AVPlayer::isLiveMode() const
+{
+    return d->live_mode;
+}
+
+void AVPlayer::setOfflineMode(bool value)
+{
+    d->offline_mode = value;
+}
+
+bool AVPlayer::isOfflineMode() const
+{
+    return d->offline_mode;
+}
+
+void AVPlayer::setLiveLatency(int msecs)
+{
+    if (msecs <= 0 || d->live_latency == msecs)
+        return;
+    d->live_latency = msecs;
+    d->updateBufferValue();
+}
+
+int AVPlayer::liveLatency() const
+{
+    return d->live_latency;
+}
+
+void AVPlayer::setTimeshift(int msecs, qint64 maxBytes)
+{
+    d->timeshift = qMax(0, msecs);
+    d->timeshift_bytes = maxBytes;
+    d->read_thread->setTimeshift(d->timeshift, d->timeshift_bytes);
+}
+
+int AVPlayer::timeshift() const
+{
+    return d->timeshift;
+}
+
+bool AVPlayer::timeshiftRange(qint64 *start, qint64 *end) const
+{
+    qint64 t0 = 0, t1 = 0;
+    if (!d->read_thread->timeshiftRange(&t0, &t1))
+        return false;
+    // packet timestamps are absolute
+    if (relativeTimeMode()) {
+        t0 -= absoluteMediaStartPosition();
+        t1 -= absoluteMediaStartPosition();
+    }
+    if (start)
+        *start = t0;
+    if (end)
+        *end = t1;
+    return true;
+}
+
+bool AVPlayer::startRecording(const QString &fileName, const QString &format)
+{
+    if (!isPlaying())
+        return false;
+    stopRecording();
+    d->recorder = new PacketRecorder();
+    // codec contexts are alive until the demuxer is unloaded, which stops recording first
+    d->recorder->setOutput(fileName, format, d->demuxer.videoCodecContext(), d->demuxer.audioCodecContext());
+    d->recorder->start(QThread::LowPriority);
+    d->read_thread->setRecorder(d->recorder);
+    return true;
+}
+
+void AVPlayer::stopRecording()
+{
+    if (!d->recorder)
+        return;
+    d->read_thread->setRecorder(0);
+    d->recorder->stop();
+    delete d->recorder;
+    d->recorder = 0;
+}
+
+bool AVPlayer::isRecording() const
+{
+    return d->recorder && d->recorder->isRunning();
+}
+
+void AVPlayer::setPowerSaving(bool value)
+{
+    d->power_saving = value;
+}
+
+bool AVPlayer::isPowerSaving() const
+{
+    return d->power_saving;
+}
+
+void AVPlayer::setReducedResolutionDecode(bool value)
+{
+    if (d->reduced_resolution == value)
+        return;
+    d->reduced_resolution = value;
+    if (!isPlaying() || !d->vdec || !d->vthread || !d->vthread->isRunning())
+        return;
+    if (d->vdec->outputSizeHint() == d->videoOutputSizeHint())
+        return;
+    class ReopenDecoderTask : public QRunnable {
+        AVPlayer* player;
+    public:
+        ReopenDecoderTask(AVPlayer *p) : player(p) {}
+        void run() Q_DECL_OVERRIDE {
+            player->d->tryApplyDecoderPriority(player, true);
+        }
+    };
+    d->vthread->scheduleTask(new ReopenDecoderTask(this));
+}
+
+bool AVPlayer::isReducedResolutionDecode() const
+{
+    return d->reduced_resolution;
+}
+
+void AVPlayer::setBatterySaver(bool value)
+{
+    if (d->battery_saver == value)
+        return;
+    d->battery_saver = value;
+    foreach (VideoRenderer *vo, videoOutputs()) {
+        vo->setPowerSaving(value);
+    }
+}
+
+bool AVPlayer::isBatterySaver() const
+{
+    return d->battery_saver;
+}
+
+void AVPlayer::setVideoFilterStage(int frames)
+{
+    d->video_filter_stage = qMax(frames, 0);
+}
+
+int AVPlayer::videoFilterStage() const
+{
+    return d->video_filter_stage;
+}
+
+void AVPlayer::setVideoPresentQueue(int frames)
+{
+    d->video_present_queue = qMax(frames, 0);
+}
+
+int AVPlayer::videoPresentQueue() const
+{
+    return d->video_present_queue;
+}
+
+void AVPlayer::setThreadPolicy(ThreadRole role, QThread::Priority priority, quint64 cpuMask)
+{
+    if (role < DemuxThreadRole || role > FilterThreadRole)
+        return;
+    d->thread_policy[role].priority = priority;
+    d->thread_policy[role].affinity = cpuMask;
+}
+
+QThread::Priority AVPlayer::threadPriority(ThreadRole role) const
+{
+    if (role < DemuxThreadRole || role > FilterThreadRole)
+        return QThread::InheritPriority;
+    return d->thread_policy[role].priority;
+}
+
+quint64 AVPlayer::threadAffinity(ThreadRole role) const
+{
+    if (role < DemuxThreadRole || role > FilterThreadRole)
+        return 0;
+    return d->thread_policy[role].affinity;
+}
+
+void AVPlayer::setRealtimeAudio(bool value)
+{
+    d->thread_policy[AudioThreadRole].realtime = value;
+}
+
+bool AVPlayer::isRealtimeAudio() const
+{
+    return d->thread_policy[AudioThreadRole].realtime;
+}
+
+void AVPlayer::setFrameDropPolicy(const FrameDropPolicyPtr &policy)
+{
+    d->drop_policy = policy;
+    if (d->vthread)
+        d->vthread->setFrameDropPolicy(policy);
+}
+
+FrameDropPolicyPtr AVPlayer::frameDropPolicy() const
+{
+    return d->drop_policy;
+}
+
+void AVPlayer::setFieldRateOutput(bool value)
+{
+    d->field_rate = value;
+}
+
+bool AVPlayer::isFieldRateOutput() const
+{
+    return d->field_rate;
+}
+
+void AVPlayer::setFastFirstFrame(bool value)
+{
+    d->fast_first_frame = value;
+}
+
+bool AVPlayer::isFastFirstFrame() const
+{
+    return d->fast_first_frame;
+}
+
+void AVPlayer::setSeamlessLoop(bool value)
+{
+    if (d->seamless_loop == value)
+        return;
+    if (!value && d->updateLoopCount())
+        Q_EMIT currentRepeatChanged(d->repeat_current);
+    d->seamless_loop = value;
+    d->updateSeamlessLoop(this);
+}
+
+bool AVPlayer::isSeamlessLoop() const
+{
+    return d->seamless_loop;
+}
+
+void AVPlayer::setReversePlayback(bool value)
+{
+    if (!isPlaying())
+        return;
+    d->reverse = value;
+    d->setReverseActive(this, value);
+}
+
+bool AVPlayer::isReversePlayback() const
+{
+    return d->reverse;
+}
+
+void AVPlayer::setReverseCacheSize(qint64 bytes, bool downscale)
+{
+    d->reverse_cache = bytes;
+    d->reverse_downscale = downscale;
+}
+
+qint64 AVPlayer::reverseCacheSize() const
+{
+    return d->reverse_cache;
+}
+
+void AVPlayer::setKeyFrameIndexEnabled(bool value)
+{
+    d->demuxer.setKeyFrameIndexEnabled(value);
+}
+
+bool AVPlayer::isKeyFrameIndexEnabled() const
+{
+    return d->demuxer.isKeyFrameIndexEnabled();
+}
+
 void AVPlayer::setOptionsForAudioCodec(const QVariantHash &dict)
 {
     d->ac_opt = dict;
@@ -554,13 +955,18 @@ void AVPlayer::togglePause()
 
 void AVPlayer::pause(bool p)
 {
+    // stepBackward() switched to reverse
+    if (!p && d->reverse_active != d->reverse)
+        d->setReverseActive(this, d->reverse);
     //pause thread. check pause state?
     d->read_thread->pause(p);
     if (d->athread)
         d->athread->pause(p);
     if (d->vthread)
         d->vthread->pause(p);
-    d->clock->pause(p);
+    d->clock->pause(p || d->reverse_active);
+    if (!p)
+        d->updateTrickPlay(this);
     emit paused(p);
 }
 
@@ -602,6 +1008,113 @@ bool AVPlayer::isAsyncLoad() const
     return d->async_load;
 }
 
+void AVPlayer::cancelLoad()
+{
+    if (mediaStatus() != LoadingMedia)
+        return;
+    // a load task not started yet checks it. a running one is interrupted
+    d->load_cancelled = true;
+    d->demuxer.setInterruptStatus(-1);
+}
+
+void AVPlayer::setLoadDeadline(qint64 ms)
+{
+    d->load_deadline = ms;
+}
+
+qint64 AVPlayer::loadDeadline() const
+{
+    return d->load_deadline;
+}
+
+void AVPlayer::setLoaderThreadCount(int value)
+{
+    loaderThreadPool()->setMaxThreadCount(qMax(1, value));
+}
+
+int AVPlayer::loaderThreadCount()
+{
+    return loaderThreadPool()->maxThreadCount();
+}
+
+QList<AVPlayer*> AVPlayer::players()
+{
+    PlayerList *pl = playerList();
+    if (!pl)
+        return QList<AVPlayer*>();
+    QMutexLocker lock(&pl->mutex);
+    Q_UNUSED(lock);
+    return pl->players;
+}
+
+void AVPlayer::setNextFile(const QString &path)
+{
+    {
+        QMutexLocker lock(&d->next_mutex);
+        Q_UNUSED(lock);
+        if (d->next_file == path)
+            return;
+        d->next_file = path;
+        if (d->next) {
+            delete d->next;
+            d->next = 0;
+        }
+    }
+    if (d->vthread)
+        d->vthread->setKeepLastFrame(!path.isEmpty());
+    if (path.isEmpty())
+        return;
+    class PrefetchWorker : public QRunnable {
+    public:
+        PrefetchWorker(AVPlayer *player, const QString& file)
+            : m_player(player)
+            , m_file(file)
+            , m_options(player->d->demuxer.options())
+            , m_timeout(player->d->interrupt_timeout)
+            , m_vids(player->d->vc_ids)
+            , m_vopt(player->d->videoCodecOptions())
+            , m_aopt(player->d->ac_opt)
+            , m_depth(player->d->videoPipelineDepth(player))
+        {
+            m_player->d->loadTaskStarted();
+        }
+        virtual void run() {
+            AVPlayer::Private::Prefetch *p = new AVPlayer::Private::Prefetch();
+            if (!p->load(m_file, m_options, m_timeout, m_vids, m_vopt, m_aopt, m_depth)) {
+                qWarning() << "Prefetching " << m_file << " failed";
+                delete p;
+                p = 0;
+            }
+            {
+                QMutexLocker lock(&m_player->d->next_mutex);
+                Q_UNUSED(lock);
+                if (p && m_player->d->next_file == m_file && !m_player->d->next) {
+                    m_player->d->next = p;
+                    p = 0;
+                }
+            }
+            delete p; // next media changed
+            m_player->d->loadTaskFinished();
+        }
+    private:
+        AVPlayer* m_player;
+        QString m_file;
+        QVariantHash m_options;
+        qint64 m_timeout;
+        QVector<VideoDecoderId> m_vids;
+        QVariantHash m_vopt, m_aopt;
+        int m_depth;
+    };
+    loaderThreadPool()->start(new PrefetchWorker(this, path));
+}
+
+QString AVPlayer::nextFile() const
+{
+    QMutexLocker lock(&d->next_mutex);
+    Q_UNUSED(lock);
+    return d->next_file;
+}
+
 bool AVPlayer::isLoaded() const
 {
     return d->loaded;
@@ -615,6 +1128,7 @@ bool AVPlayer::load(const QString &path, bool reload)
 
 bool AVPlayer::load(bool reload)
 {
+    d->load_timer.start();
     // TODO: call unload if reload?
     if (mediaStatus() == QtAV::LoadingMedia)
         return true;
@@ -644,19 +1158,21 @@ bool AVPlayer::load(bool reload)
     }
     if (reload) {
         d->status = LoadingMedia;
+        d->load_cancelled = false;
         if (isAsyncLoad()) {
             class LoadWorker : public QRunnable {
             public:
-                LoadWorker(AVPlayer *player) : m_player(player) {}
+                LoadWorker(AVPlayer *player) : m_player(player) {
+                    m_player->d->loadTaskStarted();
+                }
                 virtual void run() {
-                    if (!m_player)
-                        return;
                     m_player->loadInternal();
+                    // the player can be destroyed after this
+                    m_player->d->loadTaskFinished();
                 }
             private:
                 AVPlayer* m_player;
             };
-            // TODO: thread pool has a max thread limit
             loaderThreadPool()->start(new LoadWorker(this));
             return true;
         }
@@ -679,18 +1195,35 @@ void AVPlayer::loadInternal()
         if (d->vdec)
             d->vdec->setCodecContext(0);
     }
+    if (d->load_cancelled) {
+        qDebug() << "Loading " << d->current_source << " is canceled";
+        d->loaded = false;
+        updateMediaStatus(NoMedia);
+        return;
+    }
     qDebug() << "Loading " << d->current_source << " ...";
-    if (d->current_source.type() == QVariant::String) {
-        d->demuxer.setMedia(d->current_source.toString());
+    if (d->takeNextDemuxer(d->current_source)) {
+        qDebug("use prefetched demuxer");
+        // signals were emitted by the prefetch demuxer
+        d->loaded = true;
+        d->status = d->demuxer.mediaStatus();
+        updateMediaStatus(d->status);
+        Q_EMIT seekableChanged();
+        Q_EMIT loaded();
     } else {
-        if (d->current_source.canConvert<QIODevice*>()) {
-            d->demuxer.setMedia(d->current_source.value<QIODevice*>());
-        } else { // MediaIO
-            d->demuxer.setMedia(d->current_source.value<QtAV::MediaIO*>());
+        d->demuxer.setLoadDeadline(d->load_deadline);
+        if (d->current_source.type() == QVariant::String) {
+            d->demuxer.setMedia(d->current_source.toString());
+        } else {
+            if (d->current_source.canConvert<QIODevice*>()) {
+                d->demuxer.setMedia(d->current_source.value<QIODevice*>());
+            } else { // MediaIO
+                d->demuxer.setMedia(d->current_source.value<QtAV::MediaIO*>());
+            }
         }
+        d->loaded = d->demuxer.load();
+        d->status = d->demuxer.mediaStatus();
     }
-    d->loaded = d->demuxer.load();
-    d->status = d->demuxer.mediaStatus();
     if (!d->loaded) {
         d->statistics.reset();
         qWarning("Load failed!");
@@ -726,6 +1259,7 @@ void AVPlayer::loadInternal()
 
 void AVPlayer::unload()
 {
+    cancelLoad(); // do not wait for a slow load
     QMutexLocker lock(&d->load_mutex);
     Q_UNUSED(lock);
     d->loaded = false;
@@ -744,11 +1278,7 @@ void AVPlayer::unload()
         delete d->adec;
         d->adec = 0;
     }
-    if (d->vdec) {
-        d->vdec->setCodecContext(0);
-        delete d->vdec;
-        d->vdec = 0;
-    }
+    d->recycleVideoDecoder();
     d->demuxer.unload();
     Q_EMIT durationChanged(0LL);
     // ??
@@ -824,6 +1354,7 @@ void AVPlayer::setStartPosition(qint64 pos)
         d->start_position += mediaStopPosition();
     if (d->start_position < 0)
         d->start_position = mediaStartPosition();
+    d->updateSeamlessLoop(this);
     emit startPositionChanged(d->start_position);
 }
 
@@ -853,6 +1384,7 @@ void AVPlayer::setStopPosition(qint64 pos)
         qWarning("stop postion %lld < start position %lld. ignore", d->stop_position, startPosition());
         return;
     }
+    d->updateSeamlessLoop(this);
     emit stopPositionChanged(d->stop_position);
 }
 
@@ -868,13 +1400,22 @@ qreal AVPlayer::positionF() const
 
 qint64 AVPlayer::position() const
 {
-    const qint64 pts = d->clock->value()*1000.0; //TODO: avoid *1000.0
+    qreal t = d->clock->value();
+    // the clock keeps increasing in seamless loops. the clock value is the seek target while seeking
+    if (d->seamless_loop && !d->seeking)
+        t = d->read_thread->loopPosition(t);
+    const qint64 pts = t*1000.0; //TODO: avoid *1000.0
     if (relativeTimeMode())
         return pts - absoluteMediaStartPosition();
     return pts;
 }
 
 void AVPlayer::setPosition(qint64 position)
+{
+    seek(position, seekType());
+}
+
+void AVPlayer::seek(qint64 position, SeekType type)
 {
     // FIXME: strange things happen if seek out of eof
     if (position > stopPosition())
@@ -887,10 +1428,14 @@ void AVPlayer::setPosition(qint64 position)
     // position passed in is relative to the start pts in relative time mode
     if (relativeTimeMode())
         pos_pts += absoluteMediaStartPosition();
+    // played seamless loops are counted. the timeline restarts from the media position
+    if (d->updateLoopCount())
+        Q_EMIT currentRepeatChanged(d->repeat_current);
+    d->loop_played = 0;
     d->seeking = true;
     masterClock()->updateValue(double(pos_pts)/1000.0); //what is duration == 0
     masterClock()->updateExternalClock(pos_pts); //in msec. ignore usec part using t/1000
-    d->read_thread->seek(pos_pts, seekType());
+    d->read_thread->seek(pos_pts, type);
 
     emit positionChanged(position); //emit relative position
 }
@@ -911,6 +1456,7 @@ void AVPlayer::setRepeat(int max)
     d->repeat_max = max;
     if (d->repeat_max < 0)
         d->repeat_max = std::numeric_limits<int>::max();
+    d->updateSeamlessLoop(this);
     emit repeatChanged(d->repeat_max);
 }
 
@@ -1167,6 +1713,9 @@ void AVPlayer::playInternal()
         return;
     // FIXME: if call play() frequently playInternal may not be called if disconnect here
     disconnect(this, SIGNAL(loaded()), this, SLOT(playInternal()));
+    Q_EMIT loadProgress(QStringLiteral("openCodec"), d->load_timer.elapsed());
+    QElapsedTimer open_timer;
+    open_timer.start();
     if (!d->setupAudioThread(this)) {
         d->read_thread->setAudioThread(0); //set 0 before delete. ptr is used in demux thread when set 0
         if (d->athread) {
@@ -1183,11 +1732,19 @@ void AVPlayer::playInternal()
             d->vthread = 0;//shared ptr?
         }
     }
+    d->open_codec_time = open_timer.elapsed();
+    if (d->prefetched) { // decoders not taken are not used
+        delete d->prefetched;
+        d->prefetched = 0;
+    }
+    d->gapless_switch = false;
+    qDebug("open codec time: %lldms", d->open_codec_time);
     if (!d->athread && !d->vthread) {
         d->loaded = false;
         qWarning("load failed");
         return;
     }
+    Q_EMIT loadProgress(QStringLiteral("ready"), d->load_timer.elapsed());
     // setup clock before avthread.start() becuase avthreads use clock. after avthreads setup because of ao check
     if (d->last_position > 0) {//start_last) {
         masterClock()->pause(false); //external clock
@@ -1222,22 +1779,46 @@ void AVPlayer::playInternal()
         masterClock()->setInitialValue((double)absoluteMediaStartPosition()/1000.0);
         qDebug("Clock initial value: %f", masterClock()->value());
     }
+    if (d->athread)
+        d->athread->setOffline(d->offline_mode);
+    if (d->vthread)
+        d->vthread->setOffline(d->offline_mode);
+    d->applyThreadPolicy();
+    // fast first frame: the clock stays stopped after reset() until audio preroll, or the poster if no audio is played
+    if (d->athread)
+        d->athread->setClockStarter(false);
+    if (d->vthread)
+        d->vthread->setClockStarter(false);
+    if (d->fast_first_frame && masterClock()->clockType() != AVClock::VideoClock) {
+        if (d->athread && d->demuxer.audioCodecContext() && d->ao && d->ao->isOpen())
+            d->athread->setClockStarter(true);
+        else if (d->vthread)
+            d->vthread->setClockStarter(true);
+    }
     // from previous play()
+    // live mode: do not wait for the threads. packets are queued until they are ready
     if (d->demuxer.audioCodecContext() && d->athread) {
         qDebug("Starting audio thread...");
         d->athread->start();
-        d->athread->waitForReady();
+        if (!d->live_mode)
+            d->athread->waitForReady();
     }
     if (d->demuxer.videoCodecContext() && d->vthread) {
         qDebug("Starting video thread...");
         d->vthread->start();
-        d->vthread->waitForReady();
-    }
+        if (!d->live_mode)
+            d->vthread->waitForReady();
+    }
+    d->setupAudioReader();
+    d->read_thread->setLiveLatency(d->live_mode ? d->live_latency : 0);
+    d->read_thread->setTimeshift(d->timeshift, d->timeshift_bytes);
+    d->loop_played = 0;
+    d->updateSeamlessLoop(this);
     if (startPosition() > 0 && startPosition() < mediaStopPosition() && d->last_position <= 0) {
-        if (relativeTimeMode())
-            d->demuxer.seek(qint64((startPosition() + absoluteMediaStartPosition())));
-        else
-            d->demuxer.seek((qint64)(startPosition()));
+        const qint64 pos = relativeTimeMode() ? qint64(startPosition() + absoluteMediaStartPosition()) : startPosition();
+        d->demuxer.seek(pos);
+        if (d->audio_reader_demuxer.isLoaded())
+            d->audio_reader_demuxer.seek(pos);
     }
     d->read_thread->start();
 
@@ -1267,6 +1848,22 @@ void AVPlayer::stopFromDemuxerThread()
         d->repeat_current = d->repeat_max = 0;
         qDebug("avplayer emit stopped()");
         emit stopped();
+        QString next;
+        if (d->demuxer.atEnd()) { // not stopped by user
+            QMutexLocker lock(&d->next_mutex);
+            Q_UNUSED(lock);
+            next = d->next_file;
+            d->next_file.clear(); // the prefetched demuxer is taken by loadInternal()
+        }
+        if (!next.isEmpty()) {
+            d->gapless_switch = true;
+            setFile(next);
+            play();
+        } else if (!d->next_file.isEmpty() && d->vthread && d->vos) {
+            // stopped by user. last frame was kept for next media
+            d->vthread->setKeepLastFrame(false);
+            d->vos->sendVideoFrame(VideoFrame());
+        }
     } else {
         qDebug("stopPosition() == mediaStopPosition() or !seekable. repeate: %d/%d", currentRepeat(), repeat());
         d->repeat_current++;
@@ -1332,6 +1929,7 @@ void AVPlayer::onStarted()
         d->ao->setSpeed(d->speed);
     }
     masterClock()->setSpeed(d->speed);
+    d->updateTrickPlay(this);
 }
 
 void AVPlayer::updateMediaStatus(QtAV::MediaStatus status)
@@ -1378,8 +1976,13 @@ void AVPlayer::stop()
     }
     d->seeking = false;
     d->reset_state = true;
+    d->reverse = d->reverse_active = false;
+    if (d->vthread)
+        d->vthread->setReverse(false);
+    d->setTrickPlay(this, false, false);
 
     d->last_position = mediaStopPosition() != kInvalidPosition ? startPosition() : 0;
+    stopRecording();
     if (!isPlaying()) {
         qDebug("Not playing~");
         return;
@@ -1391,7 +1994,11 @@ void AVPlayer::stop()
         d->read_thread->wait(500);
         // interrupt to quit av_read_frame quickly.
         d->demuxer.setInterruptStatus(-1);
+        if (d->audio_reader_demuxer.isLoaded())
+            d->audio_reader_demuxer.setInterruptStatus(-1);
     }
+    d->read_thread->setAudioReader(0);
+    d->audio_reader_demuxer.unload();
     qDebug("all audio/video threads  stopped...");
 }
 
@@ -1403,6 +2010,8 @@ void AVPlayer::timerEvent(QTimerEvent *te)
             return;
         }
         // active only when playing
+        if (d->updateLoopCount())
+            Q_EMIT currentRepeatChanged(d->repeat_current);
         const qint64 t = position();
         if (stopPosition() == kInvalidPosition) { // or check stopPosition() < 0
             // not seekable. network stream
@@ -1423,6 +2032,9 @@ void AVPlayer::timerEvent(QTimerEvent *te)
             }
             return;
         }
+        // the tail is playing and the next seamless loop is queued
+        if (d->pendingLoops() > 0)
+            return;
         // atEnd() supports dynamic changed duration. but we can not break A-B repeat mode, so check stoppos and mediastoppos
         if (!d->demuxer.atEnd() && stopPosition() >= mediaStopPosition()) {
             if (!d->seeking) {
@@ -1462,9 +2074,21 @@ void AVPlayer::playNextFrame()
 {
     // pause clock
     pause(true); // must pause AVDemuxThread (set user_paused true)
+    d->reverse = false;
+    d->setReverseActive(this, false);
     d->read_thread->nextFrame();
 }
 
+void AVPlayer::stepBackward()
+{
+    if (!isPlaying())
+        return;
+    pause(true);
+    d->setReverseActive(this, true);
+    if (d->reverse_active && d->vthread)
+        d->vthread->stepBackward();
+}
+
 void AVPlayer::seek(qreal r)
 {
     seek(qint64(r*double(duration())));
@@ -1530,6 +2154,19 @@ int AVPlayer::bufferValue() const
     return d->buffer_value;
 }
 
+void AVPlayer::setAdaptiveBuffering(bool value)
+{
+    if (d->adaptive_buffer == value)
+        return;
+    d->adaptive_buffer = value;
+    d->updateBufferValue();
+}
+
+bool AVPlayer::isAdaptiveBuffering() const
+{
+    return d->adaptive_buffer;
+}
+
 void AVPlayer::updateClock(qint64 msecs)
 {
     d->clock->updateExternalClock(msecs);
@@ -20,12 +20,15 @@
 ******************************************************************************/
 
 #include "AVPlayerPrivate.h"
+#include <limits>
 #include "filter/FilterManager.h"
 #include "output/OutputSet.h"
 #include "QtAV/AudioDecoder.h"
 #include "QtAV/AudioFormat.h"
 #include "QtAV/AudioResampler.h"
 #include "QtAV/VideoCapture.h"
+#include "QtAV/VideoRenderer.h"
+#include "SPDIFMuxer.h"
 #include "QtAV/private/AVCompat.h"
 #include "utils/Logger.h"
 
@@ -79,9 +82,39 @@ AVPlayer::Private::Private()
     , audio_track(0)
     , video_track(0)
     , subtitle_track(0)
+    , decoupled_demux(false)
     , buffer_mode(BufferPackets)
     , buffer_value(-1)
+    , adaptive_buffer(false)
+    , live_mode(false)
+    , live_latency(200)
+    , timeshift(0)
+    , timeshift_bytes(0)
+    , offline_mode(false)
+    , power_saving(false)
+    , reduced_resolution(false)
+    , battery_saver(false)
+    , video_filter_stage(0)
+    , video_present_queue(0)
+    , drop_policy(new PredictiveFrameDropPolicy())
+    , field_rate(false)
+    , fast_first_frame(false)
+    , seamless_loop(false)
+    , loop_played(0)
+    , reverse(false)
+    , reverse_active(false)
+    , reverse_cache(256*1024*1024)
+    , reverse_downscale(false)
+    , trick_play_speed(4.0)
+    , key_frame_decode(false)
+    , trick_play(false)
+    , trick_clock(-1)
+    , next(0)
+    , prefetched(0)
+    , gapless_switch(false)
+    , idle_vdec(0)
     , read_thread(0)
+    , recorder(0)
     , clock(new AVClock(AVClock::AudioClock))
     , vo(0)
     , ao(new AudioOutput())
@@ -102,8 +135,13 @@ AVPlayer::Private::Private()
     , force_fps(0)
     , notify_interval(-500)
     , status(NoMedia)
+    , load_tasks(0)
+    , load_cancelled(false)
+    , load_deadline(0)
+    , open_codec_time(0)
 {
     demuxer.setInterruptTimeout(interrupt_timeout);
+    thread_policy[AVPlayer::AudioThreadRole].priority = QThread::HighPriority;
     /*
      * reset_state = true;
      * must be the same value at the end of stop(), and must be different from value in
@@ -124,6 +162,18 @@ AVPlayer::Private::Private()
 }
 AVPlayer::Private::~Private() {
     // TODO: scoped ptr
+    if (next) {
+        delete next;
+        next = 0;
+    }
+    if (prefetched) {
+        delete prefetched;
+        prefetched = 0;
+    }
+    if (idle_vdec) {
+        delete idle_vdec;
+        idle_vdec = 0;
+    }
     if (ao) {
         delete ao;
         ao = 0;
@@ -160,6 +210,29 @@ AVPlayer::Private::~Private() {
     }
 }
 
+void AVPlayer::Private::loadTaskStarted()
+{
+    QMutexLocker lock(&load_task_mutex);
+    Q_UNUSED(lock);
+    ++load_tasks;
+}
+
+void AVPlayer::Private::loadTaskFinished()
+{
+    QMutexLocker lock(&load_task_mutex);
+    Q_UNUSED(lock);
+    --load_tasks;
+    load_task_cond.wakeAll();
+}
+
+void AVPlayer::Private::waitForLoadTasks()
+{
+    QMutexLocker lock(&load_task_mutex);
+    Q_UNUSED(lock);
+    while (load_tasks > 0)
+        load_task_cond.wait(&load_task_mutex);
+}
+
 void AVPlayer::Private::updateNotifyInterval()
 {
     if (notify_interval <= 0) {
@@ -278,13 +351,164 @@ void AVPlayer::Private::initVideoStatistics(int s)
     statistics.video_only.height = avctx->height;
     statistics.video_only.width = avctx->width;
 }
+void AVPlayer::Private::applyThreadPolicy()
+{
+    read_thread->setThreadPolicy(thread_policy[AVPlayer::DemuxThreadRole]);
+    if (athread)
+        athread->setThreadPolicy(thread_policy[AVPlayer::AudioThreadRole]);
+    if (vthread) {
+        vthread->setThreadPolicy(thread_policy[AVPlayer::VideoThreadRole]);
+        vthread->setFilterThreadPolicy(thread_policy[AVPlayer::FilterThreadRole]);
+    }
+}
+
+void AVPlayer::Private::setupAudioReader()
+{
+    read_thread->setAudioReader(0);
+    audio_reader_demuxer.unload();
+    if (!decoupled_demux || !athread || !vthread || !external_audio.isEmpty())
+        return;
+    if (current_source.type() != QVariant::String || demuxer.hasAttacedPicture())
+        return;
+    audio_reader_demuxer.setMedia(demuxer.fileName());
+    audio_reader_demuxer.setOptions(demuxer.options());
+    audio_reader_demuxer.setInterruptTimeout(interrupt_timeout);
+    audio_reader_demuxer.setFastStart(true); // stream info is cached by demuxer
+    if (!audio_reader_demuxer.load()) {
+        qWarning("failed to open audio reader demuxer. decoupled demux is disabled");
+        return;
+    }
+    AVFormatContext *ctx = demuxer.formatContext();
+    AVFormatContext *actx = audio_reader_demuxer.formatContext();
+    if (ctx->nb_streams != actx->nb_streams) {
+        qWarning("audio reader demuxer has different streams. decoupled demux is disabled");
+        audio_reader_demuxer.unload();
+        return;
+    }
+    audio_reader_demuxer.setStreamIndex(AVDemuxer::VideoStream, -1);
+    audio_reader_demuxer.setStreamIndex(AVDemuxer::SubtitleStream, -1);
+    updateAudioReaderStreams();
+    read_thread->setAudioReader(&audio_reader_demuxer);
+}
+
+void AVPlayer::Private::updateAudioReaderStreams()
+{
+    if (!audio_reader_demuxer.isLoaded())
+        return;
+    // only read what the demuxer needs. unselected streams are already discarded by both demuxers
+    audio_reader_demuxer.setStreamIndex(AVDemuxer::AudioStream, audio_track);
+    const int s = demuxer.audioStream();
+    if (s >= 0)
+        demuxer.formatContext()->streams[s]->discard = AVDISCARD_ALL;
+}
+
 // notify statistics change after audio/video thread is set
+AVPlayer::Private::Prefetch::Prefetch()
+    : demuxer(0)
+    , vdec(0)
+    , adec(0)
+    , video_stream(-1)
+    , audio_stream(-1)
+{}
+
+AVPlayer::Private::Prefetch::~Prefetch()
+{
+    // decoders use codec contexts of demuxer
+    if (vdec)
+        delete vdec;
+    if (adec)
+        delete adec;
+    if (demuxer)
+        delete demuxer;
+}
+
+bool AVPlayer::Private::Prefetch::load(const QString &file, const QVariantHash &options, qint64 timeout, const QVector<VideoDecoderId> &vids,
+                                       const QVariantHash &vopt, const QVariantHash &aopt, int pipelineDepth)
+{
+    if (!demuxer)
+        demuxer = new AVDemuxer();
+    demuxer->setOptions(options);
+    demuxer->setInterruptTimeout(timeout);
+    demuxer->setMedia(file);
+    if (!demuxer->load())
+        return false;
+    if (AVCodecContext *avctx = demuxer->audioCodecContext()) {
+        adec = AudioDecoder::create();
+        if (adec) {
+            adec->setCodecContext(avctx);
+            adec->setOptions(aopt);
+            if (adec->open()) {
+                audio_stream = demuxer->audioStream();
+            } else {
+                delete adec;
+                adec = 0;
+            }
+        }
+    }
+    AVCodecContext *avctx = demuxer->videoCodecContext();
+    if (!avctx)
+        return true;
+    foreach(VideoDecoderId vid, vids) {
+        VideoDecoder *vd = VideoDecoderFactory::create(vid);
+        if (!vd)
+            continue;
+        vd->setCodecContext(avctx);
+        if (!vd->isSupported()) {
+            delete vd;
+            continue;
+        }
+        vd->setOptions(vopt);
+        vd->setPipelineDepth(pipelineDepth);
+        if (vd->open()) {
+            vdec = vd;
+            break;
+        }
+        delete vd;
+    }
+    if (!vdec)
+        return true;
+    video_stream = demuxer->videoStream();
+    // the hw decoder and gpu surfaces are ready and the first picture is ready to show at the switch
+    if (!demuxer->isSeekable() || demuxer->hasAttacedPicture())
+        return true;
+    for (int i = 0; i < 512 && !frame.isValid() && demuxer->readFrame(); ++i) {
+        if (demuxer->stream() != video_stream)
+            continue;
+        if (vdec->decode(demuxer->packet()))
+            frame = vdec->frame();
+    }
+    vdec->flush();
+    demuxer->seek(demuxer->startTime());
+    return true;
+}
+
+bool AVPlayer::Private::takeNextDemuxer(const QVariant &source)
+{
+    QMutexLocker lock(&next_mutex);
+    Q_UNUSED(lock);
+    if (!next)
+        return false;
+    if (source.type() != QVariant::String || next->demuxer->fileName() != source.toString() || !next->demuxer->isLoaded())
+        return false;
+    demuxer.unload();
+    demuxer.swap(*next->demuxer);
+    delete next->demuxer; // now holds the old media
+    next->demuxer = 0;
+    if (prefetched)
+        delete prefetched;
+    prefetched = next;
+    next = 0;
+    return true;
+}
+
 bool AVPlayer::Private::setupAudioThread(AVPlayer *player)
 {
     AVDemuxer *ademuxer = &demuxer;
     if (!external_audio.isEmpty())
         ademuxer = &audio_demuxer;
     ademuxer->setStreamIndex(AVDemuxer::AudioStream, audio_track);
+    if (ademuxer == &demuxer)
+        updateAudioReaderStreams(); // the audio stream selected again
     // pause demuxer, clear queues, set demuxer stream, set decoder, set ao, resume
     // clear packets before stream changed
     if (athread) {
@@ -304,62 +528,92 @@ bool AVPlayer::Private::setupAudioThread(AVPlayer *player)
         delete adec;
         adec = 0;
     }
-    adec = AudioDecoder::create();
-    if (!adec)
-    {
-        qWarning("failed to create audio decoder");
-        return false;
+    if (prefetched && prefetched->adec && ademuxer == &demuxer && prefetched->audio_stream == demuxer.audioStream()) {
+        qDebug("use prefetched audio decoder");
+        adec = prefetched->adec;
+        prefetched->adec = 0;
+        QObject::connect(adec, SIGNAL(error(QtAV::AVError)), player, SIGNAL(error(QtAV::AVError)));
+    } else {
+        adec = AudioDecoder::create();
+        if (!adec)
+        {
+            qWarning("failed to create audio decoder");
+            return false;
+        }
+        QObject::connect(adec, SIGNAL(error(QtAV::AVError)), player, SIGNAL(error(QtAV::AVError)));
+        adec->setCodecContext(avctx);
+        adec->setOptions(ac_opt);
     }
-    QObject::connect(adec, SIGNAL(error(QtAV::AVError)), player, SIGNAL(error(QtAV::AVError)));
-    adec->setCodecContext(avctx);
-    adec->setOptions(ac_opt);
-    if (!adec->open()) {
+    if (!adec->isOpen() && !adec->open()) {
         AVError e(AVError::AudioCodecNotFound);
         qWarning() << e.string();
         emit player->error(e);
         return false;
     }
     correct_audio_channels(avctx);
-    AudioFormat af;
-    af.setSampleRate(avctx->sample_rate);
-    af.setSampleFormatFFmpeg(avctx->sample_fmt);
-    // 5, 6, 7 channels may not play
-    if (avctx->channels > 2)
-        af.setChannelLayout(ao->preferredChannelLayout());
-    else
-        af.setChannelLayoutFFmpeg(avctx->channel_layout);
-    //af.setChannels(avctx->channels);
-    // FIXME: workaround. planar convertion crash now!
-    if (af.isPlanar()) {
-        af.setSampleFormat(AudioFormat::packedSampleFormat(af.sampleFormat()));
-    }
-    if (!ao->isSupported(af)) {
-        if (!ao->isSupported(af.sampleFormat())) {
-            af.setSampleFormat(ao->preferredSampleFormat());
+    ao->setPowerSaving(isAudioPowerSaving());
+    SPDIFMuxer *spdif = 0;
+    if (ao->isPassthrough() && SPDIFMuxer::isSupported(avctx->codec_id) && ao->isPassthroughSupported(avctx->codec_id)) {
+        spdif = new SPDIFMuxer();
+        ao->close();
+        if (spdif->open(avctx)) {
+            ao->setAudioFormat(spdif->audioFormat());
+            ao->setPassthroughCodec(avctx->codec_id);
+            qDebug() << "AudioOutput passthrough format: " << ao->audioFormat();
+            if (!ao->open()) {
+                qWarning("failed to open audio output for passthrough. decode audio");
+                delete spdif;
+                spdif = 0;
+            }
+        } else {
+            delete spdif;
+            spdif = 0;
         }
-        if (!ao->isSupported(af.channelLayout())) {
+    }
+    if (!spdif) {
+        ao->setPassthroughCodec(0);
+        AudioFormat af;
+        af.setSampleRate(avctx->sample_rate);
+        af.setSampleFormatFFmpeg(avctx->sample_fmt);
+        // 5, 6, 7 channels may not play
+        if (avctx->channels > 2)
             af.setChannelLayout(ao->preferredChannelLayout());
+        else
+            af.setChannelLayoutFFmpeg(avctx->channel_layout);
+        //af.setChannels(avctx->channels);
+        // FIXME: workaround. planar convertion crash now!
+        if (af.isPlanar()) {
+            af.setSampleFormat(AudioFormat::packedSampleFormat(af.sampleFormat()));
         }
-    }
-    // always reopen to ensure internal buffer queue inside audio backend(openal) is clear. also make it possible to change backend when replay.
-    //if (ao->audioFormat() != af) {
-        //qDebug("ao audio format is changed. reopen ao");
-        ao->close();
-        if (ao->audioFormat() != af)
-            ao->setAudioFormat(af);
-        qDebug() << "AudioOutput format: " <<ao->audioFormat();
-        if (!ao->open()) {
-            return false;
+        if (!ao->isSupported(af)) {
+            if (!ao->isSupported(af.sampleFormat())) {
+                af.setSampleFormat(ao->preferredSampleFormat());
+            }
+            if (!ao->isSupported(af.channelLayout())) {
+                af.setChannelLayout(ao->preferredChannelLayout());
+            }
         }
-    //}
-    adec->resampler()->setOutAudioFormat(ao->audioFormat());
-    // no need to set resampler if AudioFrame is used
+        // always reopen to ensure internal buffer queue inside audio backend(openal) is clear. also make it possible to change backend when replay.
+        // but a gapless switch keeps the tail of previous media queued in the backend, so samples are continuous
+        if (!gapless_switch || !ao->isOpen() || ao->audioFormat() != af || ao->isPassthrough()) {
+            //qDebug("ao audio format is changed. reopen ao");
+            ao->close();
+            if (ao->audioFormat() != af)
+                ao->setAudioFormat(af);
+            qDebug() << "AudioOutput format: " <<ao->audioFormat();
+            if (!ao->open()) {
+                return false;
+            }
+        }
+        adec->resampler()->setOutAudioFormat(ao->audioFormat());
+        // no need to set resampler if AudioFrame is used
 #if !USE_AUDIO_FRAME
-    adec->resampler()->inAudioFormat().setSampleFormatFFmpeg(avctx->sample_fmt);
-    adec->resampler()->inAudioFormat().setSampleRate(avctx->sample_rate);
-    adec->resampler()->inAudioFormat().setChannels(avctx->channels);
-    adec->resampler()->inAudioFormat().setChannelLayoutFFmpeg(avctx->channel_layout);
+        adec->resampler()->inAudioFormat().setSampleFormatFFmpeg(avctx->sample_fmt);
+        adec->resampler()->inAudioFormat().setSampleRate(avctx->sample_rate);
+        adec->resampler()->inAudioFormat().setChannels(avctx->channels);
+        adec->resampler()->inAudioFormat().setChannelLayoutFFmpeg(avctx->channel_layout);
 #endif
+    }
     if (!athread) {
         qDebug("new audio thread");
         athread = new AudioThread(player);
@@ -377,6 +631,7 @@ bool AVPlayer::Private::setupAudioThread(AVPlayer *player)
             }
         }
     }
+    athread->setPassthrough(spdif);
     athread->setDecoder(adec);
     setAVOutput(ao, ao, athread);
     updateBufferValue(athread->packetQueue());
@@ -449,7 +704,7 @@ bool AVPlayer::Private::applySubtitleStream(int n, AVPlayer *player)
     return true;
 }
 
-bool AVPlayer::Private::tryApplyDecoderPriority(AVPlayer *player)
+bool AVPlayer::Private::tryApplyDecoderPriority(AVPlayer *player, bool reopen)
 {
     // TODO: add an option to apply the new decoder even if not available
     qint64 pos = player->position();
@@ -461,7 +716,16 @@ bool AVPlayer::Private::tryApplyDecoderPriority(AVPlayer *player)
         if (!vd)
             continue;
         vd->setCodecContext(avctx); // It's fine because AVDecoder copy the avctx properties
-        vd->setOptions(vc_opt);
+        if (!vd->isSupported()) {
+            qDebug("video decoder %s can not decode the stream on this device. skip", vd->name().toUtf8().constData());
+            delete vd;
+            vd = 0;
+            continue;
+        }
+        vd->setOptions(videoCodecOptions());
+        vd->setPipelineDepth(videoPipelineDepth(player));
+        vd->setOutputSizeHint(videoOutputSizeHint());
+        vd->setFrameAllocator(videoFrameAllocator());
         if (vd->open()) {
             qDebug("**************Video decoder found:%p", vd);
             break;
@@ -474,13 +738,15 @@ bool AVPlayer::Private::tryApplyDecoderPriority(AVPlayer *player)
         Q_EMIT player->error(AVError(AVError::VideoCodecNotFound));
         return false;
     }
-    if (vd->id() == vdec->id()) {
+    if (!reopen && vd->id() == vdec->id()) {
         qDebug("Video decoder does not change");
         delete vd;
         return true;
     }
+    applyVideoBitstreamFilter(vd);
     vthread->packetQueue()->clear();
     vthread->setDecoder(vd);
+    vthread->setDecoderFallback(vc_ids, avctx, videoCodecOptions());
     // MUST delete decoder after video thread set the decoder to ensure the deleted vdec will not be used in vthread!
     if (vdec)
         delete vdec;
@@ -492,6 +758,111 @@ bool AVPlayer::Private::tryApplyDecoderPriority(AVPlayer *player)
     return true;
 }
 
+void AVPlayer::Private::applyVideoBitstreamFilter(VideoDecoder *vd)
+{
+    // filtered once by the demuxer instead of copying every packet in the decoder. the demuxer also changes extradata
+    // of the codec context, so the fallback decoders of video thread opened later accept the filtered packets
+    const QString bsf = vd->requiredBitstreamFilter();
+    vd->setBitstreamFiltered(!bsf.isEmpty() && demuxer.setBitstreamFilter(AVDemuxer::VideoStream, bsf));
+}
+
+void AVPlayer::Private::VideoCodecParameters::setCodecContext(AVCodecContext *avctx)
+{
+    codec_id = avctx->codec_id;
+    codec_tag = avctx->codec_tag;
+    profile = avctx->profile;
+    level = avctx->level;
+    width = avctx->width;
+    height = avctx->height;
+    pix_fmt = avctx->pix_fmt;
+    if (avctx->extradata && avctx->extradata_size > 0)
+        extradata = QByteArray((const char*)avctx->extradata, avctx->extradata_size);
+    else
+        extradata.clear();
+}
+
+bool AVPlayer::Private::VideoCodecParameters::operator==(const VideoCodecParameters &other) const
+{
+    // sps/pps etc. in extradata must be the same because packets may not repeat them
+    return codec_id == other.codec_id && codec_tag == other.codec_tag
+            && profile == other.profile && level == other.level
+            && width == other.width && height == other.height && pix_fmt == other.pix_fmt
+            && extradata == other.extradata;
+}
+
+void AVPlayer::Private::recycleVideoDecoder()
+{
+    if (!vdec)
+        return;
+    if (!vdec->isOpen()) {
+        vdec->setCodecContext(0);
+        delete vdec;
+        vdec = 0;
+        return;
+    }
+    if (idle_vdec)
+        delete idle_vdec;
+    vdec->disconnect();
+    idle_vdec = vdec;
+    idle_vdec_params = vdec_params;
+    vdec = 0;
+}
+
+QSize AVPlayer::Private::videoOutputSizeHint() const
+{
+    if ((!reduced_resolution && !battery_saver) || !vos)
+        return QSize();
+    QSize s;
+    foreach (AVOutput *out, vos->outputs()) {
+        const QSize rs(static_cast<VideoRenderer*>(out)->rendererSize());
+        if (!rs.isValid() || rs.isEmpty()) // not shown yet, size is unknown
+            return QSize();
+        s = s.expandedTo(rs);
+    }
+    return s;
+}
+
+QVariantHash AVPlayer::Private::videoCodecOptions() const
+{
+    if (!battery_saver)
+        return vc_opt;
+    // deblock key frames only. a value set by user is kept
+    static const int kNonKey = 48; // AVDISCARD_NONKEY
+    const QString kSkip(QStringLiteral("skip_loop_filter"));
+    QVariantHash opt(vc_opt);
+    // decoders based on libavcodec apply "avcodec" options to the context
+    QVariantHash avcodec(opt.value(QStringLiteral("avcodec")).toHash());
+    if (!avcodec.contains(kSkip))
+        avcodec[kSkip] = kNonKey;
+    opt[QStringLiteral("avcodec")] = avcodec;
+    // "FFmpeg" decoder sets the context from its property when opened. properties are top level if no "FFmpeg" key
+    const QString name(opt.contains(QStringLiteral("FFmpeg")) ? QStringLiteral("FFmpeg") : QStringLiteral("ffmpeg"));
+    if (opt.contains(name)) {
+        QVariantHash ffmpeg(opt.value(name).toHash());
+        if (!ffmpeg.contains(kSkip))
+            ffmpeg[kSkip] = kNonKey;
+        opt[name] = ffmpeg;
+    } else if (!opt.contains(kSkip)) {
+        opt[kSkip] = kNonKey;
+    }
+    return opt;
+}
+
+VideoFrameAllocatorPtr AVPlayer::Private::videoFrameAllocator() const
+{
+    // frames sent to other outputs would be displayed by them, but still held in memory of the first one
+    if (!vos || vos->outputs().size() != 1)
+        return VideoFrameAllocatorPtr();
+    return static_cast<VideoRenderer*>(vos->outputs().first())->frameAllocator();
+}
+
+int AVPlayer::Private::videoPipelineDepth(AVPlayer *player) const
+{
+    // frames held after decoding: 1 for each output, 1 queued for renderer and 1 for each filter
+    const int nb_filters = vthread ? vthread->filters().size() : FilterManager::instance().videoFilters(player).size();
+    return qMax(1, vos ? vos->outputs().size() : 0) + 1 + nb_filters;
+}
+
 bool AVPlayer::Private::setupVideoThread(AVPlayer *player)
 {
     demuxer.setStreamIndex(AVDemuxer::VideoStream, video_track);
@@ -506,12 +877,40 @@ bool AVPlayer::Private::setupVideoThread(AVPlayer *player)
     if (!avctx) {
         return false;
     }
+    const int pipeline_depth = videoPipelineDepth(player);
     if (vdec) {
         vdec->disconnect();
         delete vdec;
         vdec = 0;
     }
+    if (prefetched && prefetched->vdec && prefetched->video_stream == demuxer.videoStream()) {
+        qDebug("use prefetched video decoder");
+        vdec = prefetched->vdec;
+        prefetched->vdec = 0;
+        // show the new media at once. the frame is decoded again by video thread
+        if (prefetched->frame.isValid() && vos)
+            vos->sendVideoFrame(prefetched->frame);
+    }
+    VideoCodecParameters params;
+    params.setCodecContext(avctx);
+    if (idle_vdec) {
+        // reuse the device, surfaces and context for the same codec and stream parameters
+        if (!vdec && idle_vdec_params == params && vc_ids.contains(idle_vdec->id()) && idle_vdec->options() == videoCodecOptions()
+                && idle_vdec->outputSizeHint() == videoOutputSizeHint()
+                && idle_vdec->frameAllocator() == videoFrameAllocator()) {
+            qDebug("reuse video decoder of previous media");
+            idle_vdec->flush();
+            idle_vdec->setPipelineDepth(pipeline_depth);
+            vdec = idle_vdec;
+        } else {
+            idle_vdec->setCodecContext(0);
+            delete idle_vdec;
+        }
+        idle_vdec = 0;
+    }
     foreach(VideoDecoderId vid, vc_ids) {
+        if (vdec)
+            break;
         qDebug("**********trying video decoder: %s...", VideoDecoderFactory::name(vid).c_str());
         VideoDecoder *vd = VideoDecoderFactory::create(vid);
         if (!vd) {
@@ -519,7 +918,16 @@ bool AVPlayer::Private::setupVideoThread(AVPlayer *player)
         }
         //vd->isAvailable() //TODO: the value is wrong now
         vd->setCodecContext(avctx);
-        vd->setOptions(vc_opt);
+        // skip a hw decoder known to fail, an open costs hundreds of ms
+        if (!vd->isSupported()) {
+            qDebug("video decoder %s can not decode the stream on this device. skip", vd->name().toUtf8().constData());
+            delete vd;
+            continue;
+        }
+        vd->setOptions(videoCodecOptions());
+        vd->setPipelineDepth(pipeline_depth);
+        vd->setOutputSizeHint(videoOutputSizeHint());
+        vd->setFrameAllocator(videoFrameAllocator());
         if (vd->open()) {
             vdec = vd;
             qDebug("**************Video decoder found:%p", vdec);
@@ -534,7 +942,9 @@ bool AVPlayer::Private::setupVideoThread(AVPlayer *player)
         emit player->error(e);
         return false;
     }
+    applyVideoBitstreamFilter(vdec);
     QObject::connect(vdec, SIGNAL(error(QtAV::AVError)), player, SIGNAL(error(QtAV::AVError)));
+    vdec_params = params;
     if (!vthread) {
         vthread = new VideoThread(player);
         vthread->setClock(clock);
@@ -551,6 +961,15 @@ bool AVPlayer::Private::setupVideoThread(AVPlayer *player)
         }
     }
     vthread->setDecoder(vdec);
+    vthread->setKeepLastFrame(!next_file.isEmpty());
+    // the cover is decoded once
+    vthread->setSingleFrame(power_saving && demuxer.hasAttacedPicture());
+    vthread->setFilterStage(video_filter_stage);
+    vthread->setPresentQueue(video_present_queue);
+    vthread->setFrameDropPolicy(drop_policy);
+    vthread->setFieldRate(field_rate);
+    vthread->setFastFirstFrame(fast_first_frame && force_fps <= 0);
+    vthread->setDecoderFallback(vc_ids, demuxer.videoCodecContext(), videoCodecOptions());
 
     vthread->setBrightness(brightness);
     vthread->setContrast(contrast);
@@ -581,8 +1000,32 @@ void AVPlayer::Private::updateBufferValue(PacketBuffer* buf)
         if (demuxer.hasAttacedPicture() || (statistics.video.frames > 0 && statistics.video.frames < bv))
             bv = qMax<qint64>(1LL, statistics.video.frames);
     }
+    if (live_mode) {
+        // start playback quickly. the demux thread drops packets if buffered time exceeds live_latency, so it never blocks
+        buf->setBufferMode(BufferTime);
+        buf->setBufferValue(qMax(1, live_latency/4));
+        buf->setBufferMax(8.0);
+        buf->setAdaptive(false, 0, 0);
+        return;
+    }
+    if (!video && isAudioPowerSaving()) {
+        // start as usual, then read about 30s at once and sleep until less than 1s left
+        buf->setBufferMode(BufferTime);
+        buf->setBufferValue(1000LL);
+        buf->setBufferMax(30.0);
+        buf->setAdaptive(false, 0, 0);
+        return;
+    }
     buf->setBufferMode(buffer_mode);
-    buf->setBufferValue(buffer_value < 0LL ? bv : buffer_value);
+    bv = buffer_value < 0LL ? bv : buffer_value;
+    buf->setBufferValue(bv);
+    buf->setBufferMax(1.5);
+    buf->setAdaptive(adaptive_buffer, qMax<qint64>(1LL, bv/4), bv*8);
+}
+
+bool AVPlayer::Private::isAudioPowerSaving() const
+{
+    return power_saving && !live_mode && (!demuxer.videoCodecContext() || demuxer.hasAttacedPicture());
 }
 
 void AVPlayer::Private::updateBufferValue()
@@ -593,4 +1036,107 @@ void AVPlayer::Private::updateBufferValue()
         updateBufferValue(vthread->packetQueue());
 }
 
+void AVPlayer::Private::updateSeamlessLoop(AVPlayer *player)
+{
+    if (!read_thread)
+        return;
+    int loops = 0;
+    if (seamless_loop && player->isSeekable() && external_audio.isEmpty()) {
+        if (repeat_max == std::numeric_limits<int>::max())
+            loops = -1;
+        else
+            loops = qMax(0, repeat_max - repeat_current - pendingLoops());
+    }
+    const qint64 offset = player->relativeTimeMode() ? player->absoluteMediaStartPosition() : 0;
+    qint64 stop = std::numeric_limits<qint64>::max();
+    if (player->stopPosition() < player->mediaStopPosition())
+        stop = player->stopPosition() + offset;
+    read_thread->setSeamlessLoop(player->startPosition() + offset, stop, loops);
+}
+
+int AVPlayer::Private::pendingLoops() const
+{
+    if (!read_thread || !seamless_loop)
+        return 0;
+    int n = 0;
+    read_thread->loopPosition(std::numeric_limits<qreal>::max(), &n);
+    return qMax(0, n - loop_played);
+}
+
+void AVPlayer::Private::setReverseActive(AVPlayer *player, bool value)
+{
+    if (reverse_active == value || !read_thread || !vthread)
+        return;
+    if (value && (!player->isPlaying() || !player->isSeekable()))
+        return;
+    reverse_active = value;
+    if (value) // the reverse seek flushes
+        setTrickPlay(player, false, false);
+    // continue from the displayed frame
+    qint64 pos = clock->value()*1000.0;
+    const VideoFrame frame(vthread->displayedFrame());
+    if (frame.isValid() && frame.timestamp() > 0)
+        pos = frame.timestamp()*1000.0;
+    vthread->setReverse(value, reverse_cache, reverse_downscale ? videoOutputSizeHint() : QSize());
+    read_thread->setReverse(value, pos);
+    // the clock is updated by displayed frames in reverse
+    clock->updateValue(double(pos)/1000.0);
+    clock->updateExternalClock(pos);
+    clock->pause(value || player->isPaused());
+    if (!value)
+        updateTrickPlay(player);
+}
+
+void AVPlayer::Private::updateTrickPlay(AVPlayer *player)
+{
+    // reverse playback reads key frames by itself
+    const bool value = ((trick_play_speed > 0 && speed >= trick_play_speed) || key_frame_decode) && !reverse_active
+            && player->isPlaying() && !demuxer.hasAttacedPicture();
+    // the clock switched from audio must be running. entered in AVPlayer::pause(false)
+    if (value && player->isPaused())
+        return;
+    setTrickPlay(player, value);
+}
+
+void AVPlayer::Private::setTrickPlay(AVPlayer *player, bool value, bool resume)
+{
+    if (trick_play == value || !read_thread || !vthread)
+        return;
+    trick_play = value;
+    if (value) {
+        // audio is not decoded, the clock runs by itself from the current value
+        trick_clock = int(clock->isClockAuto()) + 2*int(clock->clockType());
+        const double t = clock->value();
+        clock->setClockAuto(false);
+        clock->setClockType(AVClock::ExternalClock);
+        clock->setExternalValue(t);
+    }
+    read_thread->setKeyFrameOnly(value);
+    vthread->setKeyFrameOnly(value);
+    if (value)
+        return;
+    const qint64 pos = player->position();
+    if (trick_clock >= 0) {
+        clock->setClockAuto(trick_clock & 1);
+        clock->setClockType(AVClock::ClockType(trick_clock/2));
+        trick_clock = -1;
+    }
+    // the decoder has not seen the references of following packets
+    if (resume && player->isPlaying())
+        player->seek(pos);
+}
+
+bool AVPlayer::Private::updateLoopCount()
+{
+    if (!read_thread || !seamless_loop || seeking)
+        return false;
+    int n = 0;
+    read_thread->loopPosition(clock->value(), &n);
+    if (n <= loop_played)
+        return false;
+    repeat_current += n - loop_played;
+    loop_played = n;
+    return true;
+}
+
 } //namespace QtAV
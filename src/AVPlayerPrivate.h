@@ -23,6 +23,14 @@
 #define QTAV_AVPLAYER_PRIVATE_H
 
 #include <limits>
+#include <QtCore/QPointer>
+#include <QtCore/QWaitCondition>
+#if QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
+#include <QtCore/QElapsedTimer>
+#else
+#include <QtCore/QTime>
+typedef QTime QElapsedTimer;
+#endif
 #include "QtAV/AVDemuxer.h"
 #include "QtAV/AVPlayer.h"
 #include "QtAV/CommonTypes.h"
@@ -34,6 +42,7 @@
 namespace QtAV {
 
 static const qint64 kInvalidPosition = std::numeric_limits<qint64>::max();
+class PacketRecorder;
 class AVPlayer::Private
 {
 public:
@@ -52,10 +61,56 @@ public:
     bool applySubtitleStream(int n, AVPlayer *player);
     bool setupAudioThread(AVPlayer *player);
     bool setupVideoThread(AVPlayer *player);
-    bool tryApplyDecoderPriority(AVPlayer *player);
+    // parameters a video decoder (and its hw context) is opened with. equal parameters can share the decoder
+    struct VideoCodecParameters {
+        VideoCodecParameters() : codec_id(0), codec_tag(0), profile(0), level(0), width(0), height(0), pix_fmt(-1) {}
+        void setCodecContext(AVCodecContext *avctx);
+        bool operator==(const VideoCodecParameters& other) const;
+        int codec_id;
+        unsigned int codec_tag;
+        int profile;
+        int level;
+        int width;
+        int height;
+        int pix_fmt;
+        QByteArray extradata;
+    };
+    // keep the open video decoder for the next media. called when media is unloaded
+    void recycleVideoDecoder();
+    int videoPipelineDepth(AVPlayer *player) const;
+    // size of the largest renderer if reduced_resolution or battery_saver, otherwise invalid
+    QSize videoOutputSizeHint() const;
+    // vc_opt with the quality reduced by battery_saver
+    QVariantHash videoCodecOptions() const;
+    // allocator of the renderer if it is the only video output, see VideoRenderer::frameAllocator()
+    VideoFrameAllocatorPtr videoFrameAllocator() const;
+    // set thread_policy to the threads before they start
+    void applyThreadPolicy();
+    // load audio_reader_demuxer for decoupled demux. call before read_thread starts
+    void setupAudioReader();
+    // audio reader reads the selected audio stream only, and the demuxer reads the others
+    void updateAudioReaderStreams();
+    // reopen: open a new decoder even if the decoder id does not change, e.g. to apply a new output size hint
+    bool tryApplyDecoderPriority(AVPlayer *player, bool reopen = false);
+    // filter video packets in the demuxer for vd if it requires a bitstream filter. call after vd is open
+    void applyVideoBitstreamFilter(VideoDecoder *vd);
     // TODO: what if buffer mode changed during playback?
     void updateBufferValue(PacketBuffer *buf);
     void updateBufferValue();
+    // loop range and loops left of the demux thread for seamless loop
+    void updateSeamlessLoop(AVPlayer *player);
+    // wraps of the demux thread not played yet
+    int pendingLoops() const;
+    // count the wraps the clock passed as repeats. return true if repeat_current is changed
+    bool updateLoopCount();
+    // switch video and demux threads to reverse or forward at the current frame
+    void setReverseActive(AVPlayer *player, bool value);
+    // decode key frames only if speed >= trick_play_speed. see updateTrickPlay()
+    void updateTrickPlay(AVPlayer *player);
+    // resume: seek to the current position to decode every frame and audio again when leaving trick play
+    void setTrickPlay(AVPlayer *player, bool value, bool resume = true);
+    // power saving is enabled and the media is audio only or music with cover
+    bool isAudioPowerSaving() const;
     //TODO: addAVOutput()
     template<class Out>
     void setAVOutput(Out *&pOut, Out *pNew, AVThread *thread) {
@@ -124,12 +179,66 @@ public:
     QVariantList subtitle_tracks;
     QString external_audio;
     AVDemuxer audio_demuxer;
+    bool decoupled_demux;
+    AVDemuxer audio_reader_demuxer; // the same source as demuxer, audio only
     QVariantList audio_tracks, external_audio_tracks;
     BufferMode buffer_mode;
     qint64 buffer_value;
+    bool adaptive_buffer;
+    bool live_mode;
+    int live_latency;
+    int timeshift;
+    qint64 timeshift_bytes;
+    bool offline_mode;
+    bool power_saving;
+    bool reduced_resolution;
+    bool battery_saver;
+    int video_filter_stage;
+    int video_present_queue;
+    ThreadPolicy thread_policy[AVPlayer::FilterThreadRole + 1]; // indexed by AVPlayer::ThreadRole
+    FrameDropPolicyPtr drop_policy;
+    bool field_rate;
+    bool fast_first_frame;
+    bool seamless_loop;
+    int loop_played; // wraps of the demux thread counted in repeat_current
+    bool reverse; // reverse playback requested
+    bool reverse_active; // threads run in reverse, e.g. stepBackward() when reverse is false
+    qint64 reverse_cache;
+    bool reverse_downscale;
+    qreal trick_play_speed;
+    bool key_frame_decode; // trick play at any speed
+    bool trick_play; // demux and video threads forward/decode key frames only
+    int trick_clock; // clock type and auto flag before trick play. -1: not saved
     //the following things are required and must be set not null
     AVDemuxer demuxer;
+    // media opened and pre-rolled in a loader thread for gapless playback. see AVPlayer::setNextFile()
+    class Prefetch {
+    public:
+        Prefetch();
+        ~Prefetch();
+        // load the media, open decoders and decode the first video frame
+        bool load(const QString& file, const QVariantHash& options, qint64 timeout, const QVector<VideoDecoderId>& vids,
+                  const QVariantHash& vopt, const QVariantHash& aopt, int pipelineDepth);
+        AVDemuxer *demuxer;
+        VideoDecoder *vdec; // opened for video_stream
+        AudioDecoder *adec; // opened for audio_stream
+        int video_stream;
+        int audio_stream;
+        VideoFrame frame; // the first decoded video frame
+    };
+    Prefetch *next; // for next_file. guarded by next_mutex
+    QString next_file;
+    QMutex next_mutex;
+    // taken from next by loadInternal(). decoders are used by setupAudioThread() and setupVideoThread()
+    Prefetch *prefetched;
+    // swap the prefetched demuxer into demuxer if it's loaded with the given source
+    bool takeNextDemuxer(const QVariant& source);
+    bool gapless_switch; // switching to next_file at the end of media. keep outputs open
+    VideoDecoder *idle_vdec; // decoder of previous media, flushed and reused by setupVideoThread() if compatible
+    VideoCodecParameters vdec_params, idle_vdec_params;
     AVDemuxThread *read_thread;
+    PacketRecorder *recorder;
+    QPointer<AVPlayer> frame_source;
     AVClock *clock;
     VideoRenderer *vo; //list? // TODO: remove
     AudioOutput *ao; // TODO: remove
@@ -157,6 +266,17 @@ public:
     int notify_interval;
     MediaStatus status; // status changes can be from demuxer or demux thread
     QMutex load_mutex;
+    // async load tasks queued or running. the player must not be destroyed until they finish
+    void loadTaskStarted();
+    void loadTaskFinished();
+    void waitForLoadTasks();
+    int load_tasks;
+    QMutex load_task_mutex;
+    QWaitCondition load_task_cond;
+    volatile bool load_cancelled;
+    qint64 load_deadline;
+    QElapsedTimer load_timer; // started in load()
+    qint64 open_codec_time;
 };
 
 } //namespace QtAV
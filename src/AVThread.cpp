@@ -26,6 +26,7 @@
 #include "QtAV/AVOutput.h"
 #include "QtAV/Filter.h"
 #include "output/OutputSet.h"
+#include <QtCore/QElapsedTimer>
 #include "utils/Logger.h"
 
 namespace QtAV {
@@ -35,11 +36,12 @@ QVariantHash AVThreadPrivate::dec_opt_normal;
 
 AVThreadPrivate::~AVThreadPrivate() {
     stop = true;
-    if (!paused) {
-        qDebug("~AVThreadPrivate wake up paused thread");
+    {
+        QMutexLocker lock(&wait_mutex);
+        Q_UNUSED(lock);
         paused = false;
         next_pause = false;
-        cond.wakeAll();
+        wait_cond.wakeAll();
     }
     ready_cond.wakeAll();
     packets.setBlocking(true); //???
@@ -119,7 +121,18 @@ const QList<Filter*>& AVThread::filters() const
 
 void AVThread::scheduleTask(QRunnable *task)
 {
-    d_func().tasks.put(task);
+    DPTR_D(AVThread);
+    d.tasks.put(task);
+    wakeUp();
+}
+
+void AVThread::wakeUp()
+{
+    DPTR_D(AVThread);
+    QMutexLocker lock(&d.wait_mutex);
+    Q_UNUSED(lock);
+    d.wake_pending = true;
+    d.wait_cond.wakeAll();
 }
 
 void AVThread::scheduleFrameDrop(bool value)
@@ -146,6 +159,7 @@ void AVThread::stop()
 {
     DPTR_D(AVThread);
     d.stop = true; //stop as soon as possible
+    wakeUp();
     QMutexLocker locker(&d.mutex);
     Q_UNUSED(locker);
     d.packets.setBlocking(false); //stop blocking take()
@@ -160,22 +174,28 @@ void AVThread::stop()
 void AVThread::pause(bool p)
 {
     DPTR_D(AVThread);
+    QMutexLocker lock(&d.wait_mutex);
+    Q_UNUSED(lock);
     if (d.paused == p)
         return;
     d.paused = p;
     if (!d.paused) {
         qDebug("wake up paused thread");
         d.next_pause = false;
-        d.cond.wakeAll();
+        d.wake_pending = true;
+        d.wait_cond.wakeAll();
     }
 }
 
 void AVThread::nextAndPause()
 {
     DPTR_D(AVThread);
+    QMutexLocker lock(&d.wait_mutex);
+    Q_UNUSED(lock);
     d.next_pause = true;
     d.paused = true;
-    d.cond.wakeAll();
+    d.wake_pending = true;
+    d.wait_cond.wakeAll();
 }
 
 void AVThread::lock()
@@ -268,11 +288,17 @@ bool AVThread::tryPause(unsigned long timeout)
     DPTR_D(AVThread);
     if (!isPaused())
         return false;
-    QMutexLocker lock(&d.mutex);
+    QMutexLocker lock(&d.wait_mutex);
     Q_UNUSED(lock);
-    return d.cond.wait(&d.mutex, timeout);
-    qDebug("paused thread waked up!!!");
-    return true;
+    // an event happened after the last wait, e.g. a task scheduled while processing the previous one
+    bool waked = d.wake_pending || d.stop || !d.tasks.isEmpty();
+    if (!waked)
+        waked = d.wait_cond.wait(&d.wait_mutex, timeout);
+    d.wake_pending = false;
+    // a task or wakeUp() only: process it and wait again. nextAndPause(): run 1 loop
+    const bool step = d.next_pause;
+    d.next_pause = false;
+    return waked && (!d.paused || step || d.stop);
 }
 
 bool AVThread::processNextTask()
@@ -294,6 +320,26 @@ void AVThread::setStatistics(Statistics *statistics)
     d.statistics = statistics;
 }
 
+void AVThread::setOffline(bool value)
+{
+    d_func().offline = value;
+}
+
+bool AVThread::isOffline() const
+{
+    return d_func().offline;
+}
+
+void AVThread::setClockStarter(bool value)
+{
+    d_func().clock_starter = value;
+}
+
+void AVThread::setThreadPolicy(const ThreadPolicy &policy)
+{
+    d_func().thread_policy = policy;
+}
+
 void AVThread::waitForReady()
 {
     QMutexLocker lock(&d_func().ready_mutex);
@@ -305,24 +351,37 @@ void AVThread::waitForReady()
 void AVThread::waitAndCheck(ulong value, qreal pts)
 {
     DPTR_D(AVThread);
-    if (value <= 0)
+    if (value <= 0 || d.offline)
         return;
     //qDebug("wating for %lu msecs", value);
-    ulong us = value * 1000UL;
-    static const ulong kWaitSlice = 20 * 1000UL; //20ms
-    while (us > kWaitSlice) {
-        usleep(kWaitSlice);
-        if (d.stop)
-            us = 0;
-        else
-            us -= kWaitSlice;
-        us = qMin(us, ulong((double)(pts - d.clock->value())*1000000.0));
-        processNextTask();
-    }
-    if (us > 0) {
-        usleep(us);
+    // wait for an event (stop, a new task) instead of waking up periodically. the clock is checked again after a slice
+    // because it can be corrected by audio
+    static const qint64 kCheckSlice = 100; //ms
+    qint64 ms = value;
+    QElapsedTimer timer;
+    while (ms > 0 && !d.stop) {
+        timer.start();
+        {
+            QMutexLocker lock(&d.wait_mutex);
+            Q_UNUSED(lock);
+            if (!d.stop && d.tasks.isEmpty())
+                d.wait_cond.wait(&d.wait_mutex, (ulong)qMin(ms, kCheckSlice));
+        }
         processNextTask();
+        ms -= timer.elapsed();
+        ms = qMin(ms, qint64((pts - d.clock->value())*1000.0));
     }
 }
 
+void AVThread::startClock()
+{
+    DPTR_D(AVThread);
+    if (!d.clock_starter)
+        return;
+    d.clock_starter = false;
+    // paused by user before the first output: resumed by AVPlayer
+    if (d.clock && d.clock->isStopped())
+        d.clock->start();
+}
+
 } //namespace QtAV
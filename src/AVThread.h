@@ -22,6 +22,7 @@
 #ifndef QTAV_AVTHREAD_H
 #define QTAV_AVTHREAD_H
 
+#include <climits>
 #include <QtCore/QRunnable>
 #include <QtCore/QScopedPointer>
 #include <QtCore/QThread>
@@ -37,6 +38,7 @@ class AVClock;
 class Filter;
 class Statistics;
 class OutputSet;
+struct ThreadPolicy;
 class AVThread : public QThread
 {
     Q_OBJECT
@@ -64,6 +66,17 @@ public:
     OutputSet* outputSet() const;
 
     void setDemuxEnded(bool ended);
+    /// see AVPlayer::setOfflineMode()
+    void setOffline(bool value);
+    bool isOffline() const;
+    /*!
+     * \brief setClockStarter
+     * Start clock() after the first output, i.e. audio preroll is written to the device or the first video frame is
+     * delivered, if the clock is not started or paused since reset(). Used by AVPlayer::setFastFirstFrame(). Set before start()
+     */
+    void setClockStarter(bool value);
+    /// scheduling of the thread. applied when the thread starts. Set before start()
+    void setThreadPolicy(const ThreadPolicy& policy);
 
     bool isPaused() const;
 
@@ -94,13 +107,17 @@ protected:
     AVThread(AVThreadPrivate& d, QObject *parent = 0);
     void resetState();
     /*
-     * If the pause state is true setted by pause(true), then block the thread and wait for pause state changed, i.e. pause(false)
-     * and return true. Otherwise, return false immediatly.
+     * If the pause state is true setted by pause(true), then block the thread until pause(false), nextAndPause(), stop(),
+     * a new task or wakeUp(), and return true if the thread should continue, i.e. not paused or a step is requested.
+     * Otherwise, return false immediatly. A paused thread does not wake up periodically.
      */
-    // has timeout so that the pending tasks can be processed
-    bool tryPause(unsigned long timeout = 100);
+    bool tryPause(unsigned long timeout = ULONG_MAX);
+    // wake up the thread waiting in tryPause() or waitAndCheck(). thread safe
+    void wakeUp();
     bool processNextTask(); //in AVThread
     void waitAndCheck(ulong value, qreal pts);
+    // start the clock if this thread is the clock starter. only the first call takes effect
+    void startClock();
 
     DPTR_DECLARE(AVThread)
 
@@ -27,6 +27,7 @@
 #include <QtCore/QVariant>
 #include <QtCore/QWaitCondition>
 #include "PacketBuffer.h"
+#include "utils/ThreadPolicy.h"
 
 class QRunnable;
 namespace QtAV {
@@ -45,6 +46,7 @@ public:
     AVThreadPrivate():
         paused(false)
       , next_pause(false)
+      , wake_pending(false)
       , stop(false)
       , clock(0)
       , dec(0)
@@ -53,6 +55,8 @@ public:
       , statistics(0)
       , ready(false)
       , render_pts0(-1)
+      , offline(false)
+      , clock_starter(false)
     {
         tasks.blockFull(false);
 
@@ -65,13 +69,16 @@ public:
     virtual ~AVThreadPrivate();
 
     bool paused, next_pause;
+    bool wake_pending; // guarded by wait_mutex. a wake up since the last wait
     volatile bool stop; //true when packets is empty and demux is end.
     AVClock *clock;
     PacketBuffer packets;
     AVDecoder *dec;
     OutputSet *outputSet;
     QMutex mutex;
-    QWaitCondition cond; //pause
+    // tryPause() and waitAndCheck() wait on it, and are waked up by pause(false), stop() and new tasks. no polling
+    QMutex wait_mutex;
+    QWaitCondition wait_cond;
     qreal delay;
     QList<Filter*> filters;
     Statistics *statistics; //not obj. Statistics is unique for the player, which is in AVPlayer
@@ -81,6 +88,11 @@ public:
     bool ready;
     //only decode video without display or skip decode audio until pts reaches
     qreal render_pts0;
+    // no clock waits and no frame drop. frames are processed as fast as outputs and filters accept them
+    bool offline;
+    // start the clock after the first output if it's still stopped. see AVThread::setClockStarter()
+    bool clock_starter;
+    ThreadPolicy thread_policy;
 
     static QVariantHash dec_opt_framedrop, dec_opt_normal;
 };
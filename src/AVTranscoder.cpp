@@ -21,26 +21,223 @@
 
 #include "QtAV/AVTranscoder.h"
 #include "QtAV/AVPlayer.h"
+#include "QtAV/AVDemuxer.h"
 #include "QtAV/AVMuxer.h"
 #include "QtAV/EncodeFilter.h"
 #include "QtAV/Statistics.h"
-#include "utils/BlockingQueue.h"
+#include <QtCore/QMutex>
+#include <QtCore/QQueue>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+#include <limits>
 #include "utils/Logger.h"
 
 namespace QtAV {
 
+/*!
+ * Writes packets from encoder threads in dts order. The packet with the smallest dts is written when each stream has a packet
+ * queued or has ended, so the output is interleaved however fast each encoder is. A producer waits if its queue is full and the
+ * other stream can be written, otherwise the queue grows, e.g. audio packets waiting for the first video packet(encoder delay).
+ */
+class MuxThread : public QThread
+{
+public:
+    enum { Audio = 0, Video = 1 };
+    MuxThread(AVMuxer *muxer, bool audio, bool video) : m_muxer(muxer) {
+        m_ended[Audio] = !audio;
+        m_ended[Video] = !video;
+        m_capacity[Audio] = 64;
+        m_capacity[Video] = 16;
+    }
+    void put(const Packet& packet, int stream) {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        const int other = 1 - stream;
+        while (m_queue[stream].size() >= m_capacity[stream] && (!m_queue[other].isEmpty() || m_ended[other]))
+            m_cond_space.wait(&m_mutex);
+        m_queue[stream].enqueue(packet);
+        m_cond_packet.wakeAll();
+    }
+    void end(int stream) {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_ended[stream] = true;
+        m_cond_packet.wakeAll();
+    }
+    // end streams and wait for queued packets to be written
+    void finish() {
+        end(Audio);
+        end(Video);
+        wait();
+    }
+protected:
+    void run() Q_DECL_OVERRIDE {
+        for (;;) {
+            Packet packet;
+            int stream = Audio;
+            {
+                QMutexLocker lock(&m_mutex);
+                Q_UNUSED(lock);
+                while (!ready(Audio) || !ready(Video))
+                    m_cond_packet.wait(&m_mutex);
+                if (m_queue[Audio].isEmpty() && m_queue[Video].isEmpty())
+                    break; // both ended
+                if (m_queue[Audio].isEmpty())
+                    stream = Video;
+                else if (!m_queue[Video].isEmpty() && m_queue[Video].head().dts < m_queue[Audio].head().dts)
+                    stream = Video;
+                packet = m_queue[stream].dequeue();
+                m_cond_space.wakeAll();
+            }
+            // producers are not blocked by io
+            if (stream == Video)
+                m_muxer->writeVideo(packet);
+            else
+                m_muxer->writeAudio(packet);
+        }
+    }
+private:
+    bool ready(int stream) const { return !m_queue[stream].isEmpty() || m_ended[stream]; }
+    AVMuxer *m_muxer;
+    QMutex m_mutex;
+    QWaitCondition m_cond_packet, m_cond_space;
+    QQueue<Packet> m_queue[2];
+    bool m_ended[2];
+    int m_capacity[2];
+};
+
+/*!
+ * Copies packets from demuxer to muxer without decoding and encoding. Output starts at the key frame before the start
+ * position(the first video key frame for audio only output too if video exists), and timestamps are rebased to start from 0.
+ * Packets with dts after the stop position are not written.
+ */
+class StreamCopyThread : public QThread
+{
+public:
+    StreamCopyThread(AVMuxer *muxer, QAtomicInt *packets)
+        : m_video(false)
+        , m_audio(false)
+        , m_relative(true)
+        , m_start(0)
+        , m_stop(std::numeric_limits<qint64>::max())
+        , m_quit(false)
+        , m_muxer(muxer)
+        , m_packets(packets)
+    {}
+    void setSource(const QString& file, bool video, bool audio) {
+        m_file = file;
+        m_video = video;
+        m_audio = audio;
+    }
+    void setRange(qint64 start, qint64 stop, bool relative) {
+        m_start = start;
+        m_stop = stop;
+        m_relative = relative;
+    }
+    void setFormat(const QString& fmt) { m_format = fmt;}
+    void quit() { m_quit = true;}
+protected:
+    void run() Q_DECL_OVERRIDE {
+        AVDemuxer demuxer;
+        demuxer.setMedia(m_file);
+        demuxer.setSeekType(KeyFrameSeek);
+        if (!demuxer.load()) {
+            qWarning("stream copy: failed to load %s", m_file.toUtf8().constData());
+            return;
+        }
+        AVCodecContext *vctx = m_video ? demuxer.videoCodecContext() : 0;
+        AVCodecContext *actx = m_audio ? demuxer.audioCodecContext() : 0;
+        if (!vctx && !actx) {
+            qWarning("stream copy: no stream to copy");
+            return;
+        }
+        m_muxer->copyVideoContext(vctx);
+        m_muxer->copyAudioContext(actx);
+        if (!m_format.isEmpty())
+            m_muxer->setFormat(m_format);
+        if (!m_muxer->open()) {
+            qWarning("stream copy: failed to open muxer");
+            return;
+        }
+        const qint64 t_base = m_relative ? demuxer.startTime() : 0;
+        if (m_start > 0)
+            demuxer.seek(m_start + t_base);
+        const qreal t_stop = m_stop == std::numeric_limits<qint64>::max() ? std::numeric_limits<qreal>::max() : qreal(m_stop + t_base)/1000.0;
+        const int vs = vctx ? demuxer.videoStream() : -1;
+        const int as = actx ? demuxer.audioStream() : -1;
+        bool v_end = vs < 0, a_end = as < 0;
+        qreal t0 = -1; // dts of the first written packet
+        while (!m_quit && !(v_end && a_end)) {
+            if (!demuxer.readFrame()) {
+                if (demuxer.atEnd())
+                    break;
+                continue;
+            }
+            const int s = demuxer.stream();
+            if (s != vs && s != as)
+                continue;
+            Packet pkt(demuxer.packet());
+            if (t0 < 0.0) {
+                if (vs >= 0 && (s != vs || !pkt.hasKeyFrame)) // start at a video key frame
+                    continue;
+                t0 = pkt.dts;
+            }
+            if (pkt.dts < t0) // audio before the first video key frame
+                continue;
+            if (pkt.dts >= t_stop) {
+                if (s == vs)
+                    v_end = true;
+                else
+                    a_end = true;
+                continue;
+            }
+            if (s == vs ? v_end : a_end)
+                continue;
+            pkt.pts = qMax<qreal>(0, pkt.pts - t0);
+            pkt.dts -= t0;
+            if (s == vs)
+                m_muxer->writeVideo(pkt);
+            else
+                m_muxer->writeAudio(pkt);
+            m_packets->ref();
+        }
+        // close here because the codec contexts are destroyed with demuxer
+        m_muxer->close();
+        m_muxer->copyVideoContext(0);
+        m_muxer->copyAudioContext(0);
+    }
+private:
+    bool m_video, m_audio;
+    bool m_relative;
+    qint64 m_start, m_stop;
+    volatile bool m_quit;
+    QString m_file, m_format;
+    AVMuxer *m_muxer;
+    QAtomicInt *m_packets;
+};
+
 class AVTranscoder::Private
 {
 public:
     Private()
         : started(false)
+        , async(false)
+        , copy_video(false)
+        , copy_audio(false)
+        , range_start(-std::numeric_limits<qreal>::max())
+        , range_stop(std::numeric_limits<qreal>::max())
+        , range_ended(0)
         , encoded_frames(0)
         , source_player(0)
         , afilter(0)
         , vfilter(0)
+        , mux_thread(0)
+        , copy_thread(0)
     {}
 
     ~Private() {
+        stopStreamCopy();
+        stopMuxThread();
         muxer.close();
         if (afilter) {
             delete afilter;
@@ -50,13 +247,35 @@ public:
         }
     }
 
+    void stopMuxThread() {
+        if (!mux_thread)
+            return;
+        mux_thread->finish();
+        delete mux_thread;
+        mux_thread = 0;
+    }
+    void stopStreamCopy() {
+        if (!copy_thread)
+            return;
+        copy_thread->quit();
+        copy_thread->wait();
+        delete copy_thread;
+        copy_thread = 0;
+    }
+
     bool started;
-    int encoded_frames;
+    bool async;
+    bool copy_video, copy_audio;
+    qreal range_start, range_stop;
+    int range_ended; // number of filters got frames after range_stop
+    QAtomicInt encoded_frames; // audio and video may be encoded in different threads
     AVPlayer *source_player;
     AudioEncodeFilter *afilter;
     VideoEncodeFilter *vfilter;
-    //BlockingQueue<Packet> aqueue, vqueue; // TODO: 1 queue if packet.mediaType is enabled
     AVMuxer muxer;
+    MuxThread *mux_thread;
+    StreamCopyThread *copy_thread;
+    QMutex prepare_mutex; // encoders are opened in their threads if async
     QString format;
 };
 
@@ -145,6 +364,7 @@ bool AVTranscoder::createVideoEncoder(const QString &name)
         connect(d->vfilter, SIGNAL(readyToEncode()), SLOT(prepareMuxer()), Qt::DirectConnection);
         // direct: can ensure delayed frames (when stop()) are written at last
         connect(d->vfilter, SIGNAL(frameEncoded(QtAV::Packet)), SLOT(writeVideo(QtAV::Packet)), Qt::DirectConnection);
+        connect(d->vfilter, SIGNAL(timeRangeEnded()), SLOT(onTimeRangeEnded()), Qt::QueuedConnection);
     }
     return !!d->vfilter->createEncoder(name);
 }
@@ -163,6 +383,7 @@ bool AVTranscoder::createAudioEncoder(const QString &name)
         connect(d->afilter, SIGNAL(readyToEncode()), SLOT(prepareMuxer()), Qt::DirectConnection);
         // direct: can ensure delayed frames (when stop()) are written at last
         connect(d->afilter, SIGNAL(frameEncoded(QtAV::Packet)), SLOT(writeAudio(QtAV::Packet)), Qt::DirectConnection);
+        connect(d->afilter, SIGNAL(timeRangeEnded()), SLOT(onTimeRangeEnded()), Qt::QueuedConnection);
     }
     return !!d->afilter->createEncoder(name);
 }
@@ -174,6 +395,33 @@ AudioEncoder* AVTranscoder::audioEncoder() const
     return d->afilter->encoder();
 }
 
+void AVTranscoder::setAsync(bool value)
+{
+    d->async = value;
+}
+
+bool AVTranscoder::isAsync() const
+{
+    return d->async;
+}
+
+void AVTranscoder::setStreamCopy(bool video, bool audio)
+{
+    d->copy_video = video;
+    d->copy_audio = audio;
+}
+
+bool AVTranscoder::isStreamCopy() const
+{
+    return d->copy_video || d->copy_audio;
+}
+
+void AVTranscoder::setTimeRange(qreal start, qreal stop)
+{
+    d->range_start = start;
+    d->range_stop = stop;
+}
+
 bool AVTranscoder::isRunning() const
 {
     return d->started;
@@ -196,12 +444,41 @@ bool AVTranscoder::isPaused() const
 
 void AVTranscoder::start()
 {
-    if (!videoEncoder())
-        return;
     if (!sourcePlayer())
         return;
+    if (isStreamCopy()) {
+        if (isRunning())
+            return;
+        d->encoded_frames = 0;
+        d->started = true;
+        d->copy_thread = new StreamCopyThread(&d->muxer, &d->encoded_frames);
+        d->copy_thread->setSource(sourcePlayer()->file(), d->copy_video, d->copy_audio);
+        d->copy_thread->setRange(sourcePlayer()->startPosition(), sourcePlayer()->stopPosition(), sourcePlayer()->relativeTimeMode());
+        d->copy_thread->setFormat(d->format);
+        // queued. stop() waits for the thread
+        connect(d->copy_thread, SIGNAL(finished()), this, SLOT(stop()));
+        d->copy_thread->start();
+        Q_EMIT started();
+        return;
+    }
+    if (!videoEncoder())
+        return;
     d->encoded_frames = 0;
     d->started = true;
+    d->range_ended = 0;
+    if (d->afilter) {
+        d->afilter->setAsync(d->async);
+        d->afilter->setTimeRange(d->range_start, d->range_stop);
+    }
+    if (d->vfilter) {
+        d->vfilter->setAsync(d->async);
+        d->vfilter->setTimeRange(d->range_start, d->range_stop);
+    }
+    if (d->async) {
+        d->stopMuxThread();
+        d->mux_thread = new MuxThread(&d->muxer, !!audioEncoder(), !!videoEncoder());
+        d->mux_thread->start();
+    }
     if (sourcePlayer()) {
         if (d->afilter) {
             sourcePlayer()->installAudioFilter(d->afilter);
@@ -221,6 +498,12 @@ void AVTranscoder::stop()
 {
     if (!isRunning())
         return;
+    if (d->copy_thread) {
+        d->stopStreamCopy();
+        d->started = false;
+        Q_EMIT stopped();
+        return;
+    }
     if (!d->muxer.isOpen())
         return;
     // uninstall encoder filters first then encoders can be closed safely
@@ -228,23 +511,37 @@ void AVTranscoder::stop()
         sourcePlayer()->uninstallFilter(d->afilter);
         sourcePlayer()->uninstallFilter(d->vfilter);
     }
+    // encode queued frames
+    if (d->afilter)
+        d->afilter->finish();
+    if (d->vfilter)
+        d->vfilter->finish();
     // get delayed frames. call VideoEncoder.encode() directly instead of through filter
     if (audioEncoder()) {
         while (audioEncoder()->encode()) {
             qDebug("encode delayed audio frames...");
             Packet pkt(audioEncoder()->encoded());
-            d->muxer.writeAudio(pkt);
+            if (d->mux_thread)
+                d->mux_thread->put(pkt, MuxThread::Audio);
+            else
+                d->muxer.writeAudio(pkt);
         }
         audioEncoder()->close();
     }
+    if (d->mux_thread)
+        d->mux_thread->end(MuxThread::Audio);
     if (videoEncoder()) {
         while (videoEncoder()->encode()) {
             qDebug("encode delayed video frames...");
             Packet pkt(videoEncoder()->encoded());
-            d->muxer.writeVideo(pkt);
+            if (d->mux_thread)
+                d->mux_thread->put(pkt, MuxThread::Video);
+            else
+                d->muxer.writeVideo(pkt);
         }
         videoEncoder()->close();
     }
+    d->stopMuxThread();
     d->muxer.close();
     d->started = false;
     Q_EMIT stopped();
@@ -269,8 +566,22 @@ void AVTranscoder::onSourceStarted()
     }
 }
 
+void AVTranscoder::onTimeRangeEnded()
+{
+    if (!isRunning() || !sourcePlayer())
+        return;
+    // stop when frames of all streams reach the end. the source stops this
+    const int nb_filters = (audioEncoder() ? 1 : 0) + (videoEncoder() ? 1 : 0);
+    if (++d->range_ended >= nb_filters)
+        sourcePlayer()->stop();
+}
+
 void AVTranscoder::prepareMuxer()
 {
+    QMutexLocker lock(&d->prepare_mutex);
+    Q_UNUSED(lock);
+    if (d->muxer.isOpen())
+        return;
     // open muxer only if all encoders are open
     if (audioEncoder() && videoEncoder()) {
         if (!audioEncoder()->isOpen() || !videoEncoder()->isOpen())
@@ -295,13 +606,16 @@ void AVTranscoder::writeAudio(const QtAV::Packet &packet)
         //d->aqueue.put(packet);
         return;
     }
-    d->muxer.writeAudio(packet);
+    if (d->mux_thread)
+        d->mux_thread->put(packet, MuxThread::Audio);
+    else
+        d->muxer.writeAudio(packet);
     Q_EMIT audioFrameEncoded(packet.pts);
 
     if (d->vfilter)
         return;
     // TODO: startpts, duration, encoded size
-    d->encoded_frames++;
+    d->encoded_frames.ref();
     //qDebug("encoded frames: %d, pos: %lld", d->encoded_frames, packet.position);
 }
 
@@ -310,11 +624,14 @@ void AVTranscoder::writeVideo(const QtAV::Packet &packet)
     // TODO: muxer maybe is not open. queue the packet
     if (!d->muxer.isOpen())
         return;
-    d->muxer.writeVideo(packet);
+    if (d->mux_thread)
+        d->mux_thread->put(packet, MuxThread::Video);
+    else
+        d->muxer.writeVideo(packet);
     Q_EMIT videoFrameEncoded(packet.pts);
 
     // TODO: startpts, duration, encoded size
-    d->encoded_frames++;
+    d->encoded_frames.ref();
     //printf("encoded frames: %d, pos: %lld\r", d->encoded_frames, packet.position);
     //fflush(0);
 }
@@ -112,6 +112,9 @@ public:
       , sample_rate(0)
       , channel_layout(AudioFormat::ChannelLayout_Unsupported)
       , channel_layout_ff(0)
+      , bytes_per_frame(0)
+      , us_num(0)
+      , us_den(1)
     {}
     void setChannels(int cs) {
         channels = cs;
@@ -119,12 +122,33 @@ public:
             channel_layout_ff = av_get_default_channel_layout(channels);
             channel_layout = AudioFormat::channelLayoutFromFFmpeg(channel_layout_ff);
         }
+        update();
     }
     void setChannelLayoutFF(qint64 clff) {
         channel_layout_ff = clff;
         if (av_get_channel_layout_nb_channels(channel_layout_ff) != channels) {
             channels = av_get_channel_layout_nb_channels(channel_layout_ff);
         }
+        update();
+    }
+    // call it when sample rate, channels or sample format changes
+    void update() {
+        const bool valid = sample_rate > 0 && (channels > 0 || channel_layout > 0) && sample_fmt != AudioFormat::SampleFormat_Unknown;
+        bytes_per_frame = valid ? (sample_fmt & ((1<<(kSize+1)) - 1)) * channels : 0;
+        if (!valid) {
+            us_num = 0;
+            us_den = 1;
+            return;
+        }
+        // reduced kHz/sample_rate, e.g. 44100Hz: 10000/441. frames*us_num/us_den is exact and overflows much later
+        qint64 a = kHz, b = sample_rate;
+        while (b) {
+            const qint64 t = a % b;
+            a = b;
+            b = t;
+        }
+        us_num = kHz/a;
+        us_den = sample_rate/a;
     }
 
     AudioFormat::SampleFormat sample_fmt;
@@ -133,6 +157,9 @@ public:
     int sample_rate;
     AudioFormat::ChannelLayout channel_layout;
     qint64 channel_layout_ff;
+    // cached for conversions between bytes, frames and durations. 0 if format is invalid
+    int bytes_per_frame;
+    qint64 us_num, us_den; // microseconds per frame
 };
 
 bool AudioFormat::isPlanar(SampleFormat format)
@@ -254,6 +281,7 @@ int AudioFormat::planeCount() const
 void AudioFormat::setSampleRate(int sampleRate)
 {
     d->sample_rate = sampleRate;
+    d->update();
 }
 
 /*!
@@ -285,8 +313,10 @@ void AudioFormat::setChannelLayout(ChannelLayout layout)
     qint64 clff = channelLayoutToFFmpeg(layout);
     d->channel_layout = layout;
     //TODO: shall we set ffmpeg channel layout to 0(not valid value)?
-    if (!clff)
+    if (!clff) {
+        d->update(); // channel_layout affects isValid()
         return;
+    }
     d->setChannelLayoutFF(clff);
 }
 
@@ -327,6 +357,7 @@ void AudioFormat::setSampleFormat(AudioFormat::SampleFormat sampleFormat)
 {
     d->sample_fmt = sampleFormat;
     d->av_sample_fmt = (AVSampleFormat)AudioFormat::sampleFormatToFFmpeg(sampleFormat);
+    d->update();
 }
 
 /*!
@@ -341,6 +372,7 @@ void AudioFormat::setSampleFormatFFmpeg(int ffSampleFormat)
 {
     d->sample_fmt = AudioFormat::sampleFormatFromFFmpeg(ffSampleFormat);
     d->av_sample_fmt = (AVSampleFormat)ffSampleFormat;
+    d->update();
 }
 
 int AudioFormat::sampleFormatFFmpeg() const
@@ -387,11 +419,11 @@ qint32 AudioFormat::bytesForDuration(qint64 duration) const
 */
 qint64 AudioFormat::durationForBytes(qint32 bytes) const
 {
-    if (!isValid() || bytes <= 0)
+    if (d->bytes_per_frame <= 0 || bytes <= 0)
         return 0;
 
     // We round the byte count to ensure whole frames
-    return qint64(kHz * (bytes / bytesPerFrame())) / sampleRate();
+    return durationForFrames(bytes / d->bytes_per_frame);
 }
 
 /*!
@@ -403,7 +435,7 @@ qint64 AudioFormat::durationForBytes(qint32 bytes) const
 */
 qint32 AudioFormat::bytesForFrames(qint32 frameCount) const
 {
-    return frameCount * bytesPerFrame();
+    return frameCount * d->bytes_per_frame;
 }
 
 /*!
@@ -418,9 +450,8 @@ qint32 AudioFormat::bytesForFrames(qint32 frameCount) const
 */
 qint32 AudioFormat::framesForBytes(qint32 byteCount) const
 {
-    int size = bytesPerFrame();
-    if (size > 0)
-        return byteCount / size;
+    if (d->bytes_per_frame > 0)
+        return byteCount / d->bytes_per_frame;
     return 0;
 }
 
@@ -432,10 +463,10 @@ qint32 AudioFormat::framesForBytes(qint32 byteCount) const
 */
 qint32 AudioFormat::framesForDuration(qint64 duration) const
 {
-    if (!isValid())
+    if (d->bytes_per_frame <= 0)
         return 0;
 
-    return qint32((duration * sampleRate()) / kHz);
+    return qint32((duration * d->us_den) / d->us_num);
 }
 
 /*!
@@ -443,18 +474,36 @@ qint32 AudioFormat::framesForDuration(qint64 duration) const
 */
 qint64 AudioFormat::durationForFrames(qint32 frameCount) const
 {
-    if (!isValid() || frameCount <= 0)
+    if (d->bytes_per_frame <= 0 || frameCount <= 0)
         return 0;
 
-    return (frameCount * kHz) / sampleRate();
+    return (frameCount * d->us_num) / d->us_den;
 }
 
-int AudioFormat::bytesPerFrame() const
+/*!
+    Returns the time in seconds of \a frameCount frames from the beginning, e.g. frames played since a timestamp.
+    Use it instead of accumulating durations of buffers, so the error does not grow with the played time.
+*/
+qreal AudioFormat::secondsForFrames(qint64 frameCount) const
+{
+    if (d->bytes_per_frame <= 0)
+        return 0;
+    return qreal(frameCount)/qreal(d->sample_rate);
+}
+
+/*!
+    Returns the number of frames in \a seconds, rounded to the nearest frame.
+*/
+qint64 AudioFormat::framesForSeconds(qreal seconds) const
 {
-    if (!isValid())
+    if (d->bytes_per_frame <= 0)
         return 0;
+    return qRound64(seconds*qreal(d->sample_rate));
+}
 
-    return bytesPerSample() * channels();
+int AudioFormat::bytesPerFrame() const
+{
+    return d->bytes_per_frame;
 }
 
 // kSize: assume 12 bytes(long double) at most
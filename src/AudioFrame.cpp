@@ -24,6 +24,7 @@
 #include "QtAV/AudioResampler.h"
 #include "QtAV/AudioResamplerTypes.h"
 #include "QtAV/private/AVCompat.h"
+#include "utils/FrameBufferPool.h"
 #include "utils/Logger.h"
 
 namespace QtAV {
@@ -36,19 +37,24 @@ public:
         , format(fmt)
         , samples_per_ch(0)
         , conv(0)
+        , pooled(false)
     {
         if (!format.isValid())
             return;
         const int nb_planes(format.planeCount());
-        planes.reserve(nb_planes);
-        planes.resize(nb_planes);
-        line_sizes.reserve(nb_planes);
-        line_sizes.resize(nb_planes);
+        resizePlanes(&planes, nb_planes);
+        resizePlanes(&line_sizes, nb_planes);
+    }
+    ~AudioFramePrivate() {
+        // the last frame referencing data is destroyed. data is kept by the pool only if it's not shared, e.g. by ao backend
+        if (pooled)
+            FrameBufferPool::instance().put(data);
     }
 
     AudioFormat format;
     int samples_per_ch;
     AudioResampler *conv;
+    bool pooled; // data is from FrameBufferPool or AudioResampler
 };
 
 AudioFrame::AudioFrame(const AudioFormat &format) :
@@ -135,15 +141,16 @@ AudioFrame AudioFrame::clone() const
         return AudioFrame();
     if (d->samples_per_ch <= 0 || bytesPerLine(0) <= 0)
         return AudioFrame(format());
-    QByteArray buf(bytesPerLine()*planeCount(), 0);
-    AudioFrame f(buf, d->format);
-    f.setSamplesPerChannel(samplesPerChannel());
+    QByteArray buf(FrameBufferPool::instance().get(bytesPerLine()*planeCount()));
     char *dst = buf.data(); //must before buf is shared, otherwise data will be detached.
-    for (int i = 0; i < f.planeCount(); ++i) {
-        const int plane_size = f.bytesPerLine(i);
-        memcpy(dst, f.constBits(i), plane_size);
+    for (int i = 0; i < planeCount(); ++i) {
+        const int plane_size = bytesPerLine(i);
+        memcpy(dst, constBits(i), plane_size);
         dst += plane_size;
     }
+    AudioFrame f(buf, d->format);
+    f.d_func()->pooled = true;
+    f.setSamplesPerChannel(samplesPerChannel());
     f.setTimestamp(timestamp());
     // meta data?
     return f;
@@ -154,7 +161,10 @@ int AudioFrame::allocate()
     Q_D(AudioFrame);
     int line_size;
     int size = av_samples_get_buffer_size(&line_size, d->format.channels(), d->samples_per_ch, (AVSampleFormat)d->format.sampleFormatFFmpeg(), 0);
-    d->data.resize(size);
+    if (d->pooled)
+        FrameBufferPool::instance().put(d->data);
+    d->data = FrameBufferPool::instance().get(size);
+    d->pooled = true;
     init();
     return size;
 }
@@ -206,7 +216,6 @@ AudioFrame AudioFrame::to(const AudioFormat &fmt) const
     //if (fmt == format())
       //  return clone(); //FIXME: clone a frame from ffmpeg is not enough?
     Q_D(const AudioFrame);
-    // TODO: use a pool
     AudioResampler *conv = d->conv;
     QScopedPointer<AudioResampler> c;
     if (!conv) {
@@ -227,10 +236,12 @@ AudioFrame AudioFrame::to(const AudioFormat &fmt) const
         qWarning() << "AudioFrame::to error: " << format() << "=>" << fmt;
         return AudioFrame();
     }
+    // output buffer of the resampler is recycled by FrameBufferPool once neither the frame nor the resampler uses it
     AudioFrame f(conv->outData(), fmt);
+    f.d_func()->pooled = true;
     f.setSamplesPerChannel(conv->outSamplesPerChannel());
     f.setTimestamp(timestamp());
-    f.d_ptr->metadata = d->metadata; // need metadata?
+    f.d_ptr->copyMetaData(d); // need metadata?
     return f;
 }
 
@@ -239,8 +250,8 @@ void AudioFrame::init()
 {
     Q_D(AudioFrame);
     const int nb_planes = d->format.planeCount();
-    d->line_sizes.resize(nb_planes);
-    d->planes.resize(nb_planes);
+    resizePlanes(&d->line_sizes, nb_planes);
+    resizePlanes(&d->planes, nb_planes);
     if (d->data.isEmpty())
         return;
     const int bpl(d->data.size()/nb_planes);
@@ -74,6 +74,30 @@ qreal AudioResampler::speed() const
     return d_func().speed;
 }
 
+void AudioResampler::setVolume(qreal volume)
+{
+    DPTR_D(AudioResampler);
+    if (volume < 0 || d.volume == volume)
+        return;
+    d.volume = volume;
+    d.volume_applied = qFuzzyCompare(volume, 1.0); // updated by prepare()
+}
+
+qreal AudioResampler::volume() const
+{
+    return d_func().volume;
+}
+
+bool AudioResampler::isVolumeApplied() const
+{
+    return d_func().volume_applied;
+}
+
+bool AudioResampler::isPassthrough() const
+{
+    return d_func().passthrough;
+}
+
 
 void AudioResampler::setInAudioFormat(const AudioFormat& format)
 {
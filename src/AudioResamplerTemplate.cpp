@@ -24,6 +24,7 @@
 #include "QtAV/private/AudioResampler_p.h"
 #include "QtAV/private/AVCompat.h"
 #include "QtAV/private/prepost.h"
+#include "utils/FrameBufferPool.h"
 #include "utils/Logger.h"
 
 namespace QtAV {
@@ -69,6 +70,17 @@ public:
             context = 0;
         }
     }
+    // data_out of the given size. the last output may be still referenced, e.g. by a frame queued in ao, then a recycled
+    // buffer is taken instead of detaching
+    uint8_t* outBuffer(int size) {
+        if (!data_out.isDetached() || size > data_out.capacity()) {
+            FrameBufferPool::instance().put(data_out);
+            data_out = FrameBufferPool::instance().get(size);
+        } else {
+            data_out.resize(size);
+        }
+        return (uint8_t*)data_out.data();
+    }
     SwrContext *context;
     // defined in swr<1
 #ifndef SWR_CH_MAX
@@ -85,6 +97,17 @@ AudioResamplerFF::AudioResamplerFF():
 bool AudioResamplerFF::convert(const quint8 **data)
 {
     DPTR_D(AudioResamplerFF);
+    if (d.passthrough) {
+        d.out_samples_per_channel = d.in_samples_per_channel;
+        const int nb_planes = d.out_format.planeCount();
+        const int plane_size = d.in_samples_per_channel*d.out_format.bytesPerSample()*(d.out_format.isPlanar() ? 1 : d.out_format.channels());
+        uint8_t *dst = d.outBuffer(plane_size*nb_planes);
+        for (int i = 0; i < nb_planes; ++i) {
+            memcpy(dst, data[i], plane_size);
+            dst += plane_size;
+        }
+        return true;
+    }
     /*
      * swr_get_delay: Especially when downsampling by a large value, the output sample rate may be a poor choice to represent
      * the delay, similarly  upsampling and the input sample rate.
@@ -104,9 +127,7 @@ bool AudioResamplerFF::convert(const quint8 **data)
     //int out_size = av_samples_get_buffer_size(NULL/*out linesize*/, d.out_channels, d.out_samples_per_channel, (AVSampleFormat)d.out_sample_format, 0/*alignment default*/);
     int size_per_sample_with_channels = d.out_format.channels()*d.out_format.bytesPerSample();
     int out_size = d.out_samples_per_channel*size_per_sample_with_channels;
-    if (out_size > d.data_out.size())
-        d.data_out.resize(out_size);
-    uint8_t *out[] = {(uint8_t*)d.data_out.data()}; // detach if implicitly shared by others
+    uint8_t *out[] = {d.outBuffer(out_size)};
     //number of input/output samples available in one channel
     int converted_samplers_per_channel = swr_convert(d.context, out, d.out_samples_per_channel, data, d.in_samples_per_channel);
     d.out_samples_per_channel = converted_samplers_per_channel;
@@ -167,6 +188,15 @@ bool AudioResamplerFF::prepare()
         d.out_format.setSampleRate(inAudioFormat().sampleRate());
     if (d.speed <= 0)
         d.speed = 1.0;
+    // e.g. the decoder outputs s16 and ao accepts it. convert() just copies the samples, volume is applied by ao
+    d.passthrough = d.in_format == d.out_format && qFuzzyCompare(d.speed, 1.0);
+    if (d.passthrough) {
+        if (d.context)
+            swr_free(&d.context);
+        d.volume_applied = qFuzzyCompare(d.volume, 1.0);
+        qDebug("audio resampler passthrough: %s", qPrintable(d.out_format.sampleFormatName()));
+        return true;
+    }
     //DO NOT set sample rate here, we should keep the original and multiply 1/speed when needed
     //if (d.speed != 1.0)
     //    d.out_format.setSampleRate(int(qreal(d.out_format.sampleFormat())/d.speed));
@@ -206,6 +236,7 @@ bool AudioResamplerFF::prepare()
         qWarning("Allocat swr context failed!");
         return false;
     }
+    d.volume_applied = qFuzzyCompare(d.volume, 1.0);
     //avresample 0.0.2(FFmpeg 0.11)~1.0.1(FFmpeg 1.1) has no channel mapping. but has remix matrix, so does swresample
 //TODO: why crash if use channel mapping for L or R?
 #if QTAV_HAVE(SWR_AVR_MAP) //LIBAVRESAMPLE_VERSION_INT < AV_VERSION_INT(1, 1, 0)
@@ -239,8 +270,20 @@ bool AudioResamplerFF::prepare()
             i = (i + i)%in_c;
         }
     }
+    // volume is fused into the remix pass. an identity matrix enables it if channels are not changed
+    if (!d.volume_applied && !remix && in_c == out_c) {
+        remix = true;
+        matrix = (double*)calloc(in_c*out_c, sizeof(double));
+        for (int i = 0; i < in_c; ++i) {
+            matrix[i + in_c * i] = 1;
+        }
+    }
     if (remix && matrix) {
-        avresample_set_matrix(d.context, matrix, in_c);
+        if (!d.volume_applied) {
+            for (int i = 0; i < in_c*out_c; ++i)
+                matrix[i] *= d.volume;
+        }
+        d.volume_applied = avresample_set_matrix(d.context, matrix, in_c) >= 0 || d.volume_applied;
         free(matrix);
     }
 #else
@@ -272,6 +315,17 @@ bool AudioResamplerFF::prepare()
         av_opt_set_int(d.context, "uch", d.out_format.channels(), 0);
         swr_set_channel_mapping(d.context, d.channel_map);
     }
+    if (!d.volume_applied) {
+        // volume is fused into the rematrix pass, which is enabled if rematrix_volume is not 1. coefficients greater than
+        // rematrix_maxval are normalized, and maxval is 1 for integer output by default
+        bool ok = av_opt_set_double(d.context, "rematrix_volume", d.volume, 0) >= 0;
+        if (ok && d.volume > 1.0) {
+            ok = av_opt_set_double(d.context, "rematrix_maxval", d.volume, 0) >= 0;
+            if (!ok)
+                av_opt_set_double(d.context, "rematrix_volume", 1.0, 0);
+        }
+        d.volume_applied = ok;
+    }
 #endif //QTAV_HAVE(SWR_AVR_MAP)
     int ret = swr_init(d.context);
     if (ret < 0) {
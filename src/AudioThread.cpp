@@ -24,49 +24,217 @@
 #include "QtAV/AudioDecoder.h"
 #include "QtAV/Packet.h"
 #include "QtAV/AudioFormat.h"
+#include "QtAV/AudioFrame.h"
 #include "QtAV/AudioOutput.h"
 #include "QtAV/AudioResampler.h"
+#include "QtAV/AudioResamplerTypes.h"
 #include "QtAV/AVClock.h"
 #include "QtAV/Filter.h"
+#include "QtAV/Statistics.h"
+#include "QtAV/TraceRecorder.h"
 #include "output/OutputSet.h"
+#include "SPDIFMuxer.h"
 #include "QtAV/private/AVCompat.h"
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include "utils/AudioTimeStretch.h"
 #include "utils/Logger.h"
 
 namespace QtAV {
 
+/*!
+ * Accumulates frames as planar float and runs filters of the same AudioFilter::blockSize() on whole blocks.
+ * The output frame is the processed blocks, the rest is kept for the next frame.
+ */
+class AudioBlockStage
+{
+public:
+    AudioBlockStage(int samples)
+        : block(samples)
+        , conv(0)
+        , fill(0)
+        , pts(0)
+    {}
+    ~AudioBlockStage() {
+        if (conv) {
+            delete conv;
+            conv = 0;
+        }
+    }
+    int blockSize() const { return block;}
+    void reset() { fill = 0;}
+    // invalid frame if less than a block is buffered
+    AudioFrame process(const AudioFrame& frame, const QList<AudioFilter*>& filters, Statistics* statistics) {
+        AudioFormat fmt(frame.format());
+        fmt.setSampleFormat(AudioFormat::SampleFormat_FloatPlanar);
+        if (fmt != format) {
+            format = fmt;
+            fill = 0;
+            buf.resize(format.channels());
+        }
+        AudioFrame in(frame);
+        if (frame.format() != format) {
+            if (!conv) {
+                conv = AudioResamplerFactory::create(AudioResamplerId_FF);
+                if (!conv)
+                    conv = AudioResamplerFactory::create(AudioResamplerId_Libav);
+                if (!conv)
+                    return AudioFrame();
+            }
+            in.setAudioResampler(conv);
+            in = in.to(format);
+            if (!in)
+                return AudioFrame();
+        }
+        const int n = in.samplesPerChannel();
+        if (fill == 0)
+            pts = in.timestamp();
+        for (int c = 0; c < buf.size(); ++c) {
+            if (buf[c].size() < fill + n)
+                buf[c].resize(fill + n);
+            memcpy(buf[c].data() + fill, in.constBits(c), n*sizeof(float));
+        }
+        fill += n;
+        const int nb_blocks = fill/block;
+        if (nb_blocks <= 0)
+            return AudioFrame();
+        const int out_samples = nb_blocks*block;
+        AudioFrame out(format);
+        out.setSamplesPerChannel(out_samples);
+        out.allocate();
+        out.setTimestamp(pts);
+        for (int c = 0; c < buf.size(); ++c) {
+            memcpy(out.bits(c), buf[c].constData(), out_samples*sizeof(float));
+            memmove(buf[c].data(), buf[c].constData() + out_samples, (fill - out_samples)*sizeof(float));
+        }
+        fill -= out_samples;
+        QVector<uchar*> bits(buf.size());
+        for (int k = 0; k < nb_blocks; ++k) {
+            // a view of out
+            AudioFrame b(format);
+            for (int c = 0; c < bits.size(); ++c) {
+                bits[c] = out.bits(c) + k*block*sizeof(float);
+                b.setBytesPerLine(block*sizeof(float), c);
+            }
+            b.setBits(bits);
+            b.setSamplesPerChannel(block);
+            b.setTimestamp(pts + qreal(k*block)/qreal(format.sampleRate()));
+            foreach (AudioFilter *f, filters)
+                f->apply(statistics, &b);
+        }
+        pts += qreal(out_samples)/qreal(format.sampleRate());
+        return out;
+    }
+private:
+    int block;
+    AudioResampler *conv;
+    AudioFormat format; // planar float
+    QVector<QVector<float> > buf; // per channel, fill samples not processed
+    int fill;
+    qreal pts; // of buf
+};
+
 class AudioThreadPrivate : public AVThreadPrivate
 {
 public:
+    AudioThreadPrivate()
+        : spdif(0)
+        , pending_pts(0)
+        , pending_volume_applied(false)
+    {}
+    ~AudioThreadPrivate() {
+        if (spdif) {
+            delete spdif;
+            spdif = 0;
+        }
+        qDeleteAll(block_stages);
+    }
     void init() {
         resample = false;
         last_pts = 0;
+        stretch.flush();
+        pending.clear();
+        resetBlocks();
+    }
+    void resetBlocks() {
+        foreach (AudioBlockStage *s, block_stages)
+            s->reset();
+    }
+    bool processBlocks(AudioFrame *frame, const QList<AudioFilter*>& group) {
+        const int samples = group.first()->blockSize();
+        AudioBlockStage *&s = block_stages[group.first()];
+        if (s && s->blockSize() != samples) {
+            delete s;
+            s = 0;
+        }
+        if (!s)
+            s = new AudioBlockStage(samples);
+        const AudioFrame f(s->process(*frame, group, statistics));
+        if (!f)
+            return false;
+        *frame = f;
+        return true;
     }
 
     bool resample;
     qreal last_pts; //used when audio output is not available, to calculate the aproximate sleeping time
+    AudioTimeStretch stretch; // ao speed without pitch shift
+    SPDIFMuxer *spdif; // compressed passthrough if not null
+    // ao power saving: decoded data not played yet, less than a chunk
+    QByteArray pending;
+    qreal pending_pts; // end of pending
+    bool pending_volume_applied;
+    QHash<AudioFilter*, AudioBlockStage*> block_stages; // by the first filter of a group
 };
 
 AudioThread::AudioThread(QObject *parent)
     :AVThread(*new AudioThreadPrivate(), parent)
 {
+    setObjectName(QStringLiteral("AudioThread"));
 }
 
-void AudioThread::applyFilters(AudioFrame &frame)
+void AudioThread::setPassthrough(SPDIFMuxer *spdif)
+{
+    DPTR_D(AudioThread);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (d.spdif == spdif)
+        return;
+    if (d.spdif)
+        delete d.spdif;
+    d.spdif = spdif;
+}
+
+bool AudioThread::applyFilters(AudioFrame &frame)
 {
     DPTR_D(AudioThread);
     //QMutexLocker locker(&d.mutex);
     //Q_UNUSED(locker);
-    if (!d.filters.isEmpty()) {
-        //sort filters by format. vo->defaultFormat() is the last
-        foreach (Filter *filter, d.filters) {
-            AudioFilter *af = static_cast<AudioFilter*>(filter);
-            if (!af->isEnabled())
-                continue;
-            af->apply(d.statistics, &frame);
+    if (d.filters.isEmpty())
+        return true;
+    TraceRecorder::Span span("filter", "audio");
+    QList<AudioFilter*> group; // consecutive filters of the same block size
+    //sort filters by format. vo->defaultFormat() is the last
+    foreach (Filter *filter, d.filters) {
+        AudioFilter *af = static_cast<AudioFilter*>(filter);
+        if (!af->isEnabled())
+            continue;
+        const int samples = qMax(0, af->blockSize());
+        if (!group.isEmpty() && group.first()->blockSize() != samples) {
+            if (!d.processBlocks(&frame, group))
+                return false;
+            group.clear();
         }
+        if (samples > 0) {
+            group.append(af);
+            continue;
+        }
+        af->apply(d.statistics, &frame);
     }
+    if (!group.isEmpty())
+        return d.processBlocks(&frame, group);
+    return true;
 }
 /*
  *TODO:
@@ -78,12 +246,15 @@ void AudioThread::run()
     //No decoder or output. No audio output is ok, just display picture
     if (!d.dec || !d.dec->isAvailable() || !d.outputSet)
         return;
+    d.thread_policy.apply();
     resetState();
     Q_ASSERT(d.clock != 0);
     d.init();
     //TODO: bool need_sync in private class
     bool is_external_clock = d.clock->clockType() == AVClock::ExternalClock;
     Packet pkt;
+    bool frames_left = false; // the last decoding got a frame. more frames of the packet may be left in the decoder
+    qint64 trace_dequeue = 0, trace_decode = 0, trace_decoded = 0, trace_filtered = 0; // latency tracing (ns)
     while (true) {
         processNextTask();
         //TODO: why put it at the end of loop then playNextFrame() not work?
@@ -96,6 +267,13 @@ void AudioThread::run()
         }
         if (!pkt.isValid() && !pkt.isEOF()) { // can't seek back if eof packet is read
             pkt = d.packets.take(); //wait to dequeue
+            if (Statistics::isLatencyTracing())
+                trace_dequeue = Statistics::tracingTime();
+            if (d.statistics) {
+                d.statistics->count(Statistics::AudioBytes, pkt.data.size());
+                d.statistics->setAudioQueueSize(d.packets.size());
+                d.statistics->setMemoryUsage(Statistics::AudioPacketMemory, d.packets.bufferedBytes());
+            }
         }
         if (pkt.isEOF()) {
             qDebug("audio thread gets an eof packet.");
@@ -108,6 +286,9 @@ void AudioThread::run()
                 Q_UNUSED(locker);
                 if (d.dec) //maybe set to null in setDecoder()
                     d.dec->flush();
+                d.stretch.flush();
+                d.pending.clear();
+                d.resetBlocks();
                 d.render_pts0 = pkt.pts;
                 continue;
             }
@@ -125,7 +306,8 @@ void AudioThread::run()
              */
             qreal a_v = dts - d.clock->videoTime();
             //qDebug("skip audio decode at %f/%f v=%f a-v=%fms", dts, d.render_pts0, d.clock->videoTime(), a_v*1000.0);
-            if (a_v > 0) {
+            if (d.offline) {
+            } else if (a_v > 0) {
                 msleep(qMin((ulong)20, ulong(a_v*1000.0)));
             } else {
                 // audio maybe too late compared with video packet before seeking backword. so just ignore
@@ -134,7 +316,7 @@ void AudioThread::run()
             pkt = Packet(); //mark invalid to take next
             continue;
         }
-        if (is_external_clock) {
+        if (is_external_clock && !d.offline) {
             d.delay = dts - d.clock->value();
             /*
              *after seeking forward, a packet may be the old, v packet may be
@@ -173,18 +355,49 @@ void AudioThread::run()
 
         //DO NOT decode and convert if ao is not available or mute!
         bool has_ao = ao && ao->isAvailable();
+        if (d.statistics)
+            d.statistics->setMemoryUsage(Statistics::AudioFrameMemory, has_ao ? ao->bufferSizeTotal() : 0);
+        if (d.spdif && has_ao && !d.offline) {
+            // compressed data is played as is. no decoding, filters, volume or speed
+            if (pkt.isEOF())
+                break;
+            if (d.render_pts0 >= 0.0) { // seeking
+                d.render_pts0 = -1.0;
+                Q_EMIT seekFinished(qint64(pkt.pts*1000.0));
+            }
+            const QByteArray burst(d.spdif->mux(pkt));
+            const qreal byte_rate = ao->audioFormat().bytesPerSecond();
+            for (int pos = 0; pos < burst.size() && !d.stop; ) {
+                const int chunk = qMin(burst.size() - pos, ao->bufferSize());
+                pkt.pts += (qreal)chunk/byte_rate;
+                ao->play(QByteArray::fromRawData(burst.constData() + pos, chunk), pkt.pts);
+                d.clock->updateAudioTime(ao->timestamp(), ao->latency());
+                pos += chunk;
+            }
+            startClock();
+            emit frameDelivered();
+            pkt = Packet();
+            d.last_pts = d.clock->value();
+            continue;
+        }
         //if (!has_ao) {//do not decode?
         // TODO: move resampler to AudioFrame, like VideoFrame does
+        // ao speed is applied by time-stretching the converted data, or by resampling which also shifts pitch
+        // catch up speed of an audio clock (live latency) plays audio faster, audio clock has no timer to speed up
+        const qreal ao_speed = !has_ao ? 1.0 : d.clock->clockType() == AVClock::AudioClock ? ao->speed()*(1.0 + d.clock->catchUpSpeed()) : ao->speed();
+        const bool stretch = has_ao && ao->preservesPitch() && !qFuzzyCompare(ao_speed, 1.0)
+                && AudioTimeStretch::isSupported(ao->audioFormat());
         if (has_ao && dec->resampler()) {
-            if (dec->resampler()->speed() != ao->speed()
+            const qreal resample_speed = stretch ? 1.0 : ao_speed;
+            if (dec->resampler()->speed() != resample_speed
                     || dec->resampler()->outAudioFormat() != ao->audioFormat()) {
                 //resample later to ensure thread safe. TODO: test
                 if (d.resample) {
                     qDebug() << "ao.format " << ao->audioFormat();
                     qDebug() << "swr.format " << dec->resampler()->outAudioFormat();
-                    qDebug("decoder set speed: %.2f", ao->speed());
+                    qDebug("decoder set speed: %.2f", resample_speed);
                     dec->resampler()->setOutAudioFormat(ao->audioFormat());
-                    dec->resampler()->setSpeed(ao->speed());
+                    dec->resampler()->setSpeed(resample_speed);
                     dec->resampler()->prepare();
                     d.resample = false;
                 } else {
@@ -207,17 +420,32 @@ void AudioThread::run()
             qDebug("audio thread stop before decode()");
             break;
         }
-        if (!dec->decode(pkt)) {
-            qWarning("Decode audio failed. undecoded: %d", dec->undecodedSize());
+        const bool tracing = Statistics::isLatencyTracing() && d.statistics;
+        if (tracing)
+            trace_decode = Statistics::tracingTime();
+        bool dec_ok = false;
+        bool received = false; // a frame left in the decoder is taken. pkt is not decoded yet
+        {
+            TraceRecorder::Span span("decode", "audio");
+            if (frames_left)
+                received = dec->receiveFrame();
+            dec_ok = received || dec->decode(pkt);
+        }
+        frames_left = dec_ok;
+        if (!dec_ok) {
+            qtavWarningLimited(LogAudio, 1000, "Decode audio failed. undecoded: %d", dec->undecodedSize());
             if (pkt.isEOF()) {
                 qDebug("audio decode eof done");
+                if (!d.pending.isEmpty() && has_ao && ao->isOpen() && !d.offline)
+                    ao->play(d.pending, d.pending_pts, d.pending_volume_applied);
+                d.pending.clear();
                 break;
             }
             qreal dt = dts - d.last_pts;
             if (dt > 0.5 || dt < 0) {
                 dt = 0;
             }
-            if (!qFuzzyIsNull(dt)) {
+            if (!qFuzzyIsNull(dt) && !d.offline) {
                 msleep((unsigned long)(dt*1000.0));
             }
             pkt = Packet();
@@ -225,8 +453,17 @@ void AudioThread::run()
             continue;
         }
         // reduce here to ensure to decode the rest data in the next loop
-        if (!pkt.isEOF())
+        if (!pkt.isEOF() && !received)
             pkt.data = QByteArray::fromRawData(pkt.data.constData() + pkt.data.size() - dec->undecodedSize(), dec->undecodedSize());
+        bool volume_applied = false;
+        if (tracing) {
+            trace_decoded = Statistics::tracingTime();
+            Statistics::Common &st = d.statistics->audio;
+            st.addLatency(Statistics::LatencyDemux, pkt.demuxTime, pkt.enqueueTime);
+            st.addLatency(Statistics::LatencyQueue, pkt.enqueueTime, trace_dequeue);
+            st.addLatency(Statistics::LatencyWait, trace_dequeue, trace_decode);
+            st.addLatency(Statistics::LatencyDecode, trace_decode, trace_decoded);
+        }
 #if USE_AUDIO_FRAME
         AudioFrame frame(dec->frame());
         if (!frame)
@@ -235,7 +472,7 @@ void AudioThread::run()
             frame.setTimestamp(pkt.pts); // pkt.pts is wrong. >= real timestamp
         if (d.render_pts0 >= 0.0) { // seeking
             if (frame.timestamp() < d.render_pts0) {
-                qDebug("skip audio rendering: %f-%f", frame.timestamp(), d.render_pts0);
+                qtavDebugLimited(LogAudio, 1000, "skip audio rendering: %f-%f", frame.timestamp(), d.render_pts0);
                 d.clock->updateValue(frame.timestamp());
                 continue;
             }
@@ -243,7 +480,19 @@ void AudioThread::run()
             Q_EMIT seekFinished(qint64(frame.timestamp()*1000.0));
         }
         if (has_ao) {
-            applyFilters(frame);
+            if (!applyFilters(frame))
+                continue;
+            // apply software volume while converting instead of scaling the samples again in ao
+            AudioResampler *conv = dec->resampler();
+            if (conv) {
+                const qreal vol = ao->softwareVolume();
+                if (!qFuzzyCompare(conv->volume() + 1.0, vol + 1.0)) {
+                    conv->setVolume(vol);
+                    if (conv->inAudioFormat().isValid())
+                        conv->prepare();
+                }
+                volume_applied = conv->isVolumeApplied();
+            }
             frame.setAudioResampler(dec->resampler()); //!!!
             // FIXME: resample ONCE is required for audio frames from ffmpeg
             //if (ao->audioFormat() != frame.format()) {
@@ -254,12 +503,58 @@ void AudioThread::run()
 #else
         QByteArray decoded(dec->data());
 #endif
+        // a frame left in the decoder belongs to the previous packet. pkt is not decoded yet and keeps its timestamps
+        qreal frame_pts = pkt.pts, frame_dts = pkt.dts;
+#if USE_AUDIO_FRAME
+        if (received)
+            frame_pts = frame_dts = frame.timestamp();
+#endif
+        if (tracing) { // filters and resampling
+            trace_filtered = Statistics::tracingTime();
+            d.statistics->audio.addLatency(Statistics::LatencyFilter, trace_decoded, trace_filtered);
+        }
+        bool stretched = false;
+        if (stretch) {
+            d.stretch.setAudioFormat(ao->audioFormat());
+            d.stretch.setSpeed(ao_speed);
+            decoded = d.stretch.process(decoded);
+            stretched = true;
+        } else if (d.stretch.bufferedSamples() > 0) {
+            d.stretch.flush();
+        }
+        // timestamps are computed from frame counts instead of adding durations of chunks, so errors do not accumulate
+        const AudioFormat &af = dec->resampler()->outAudioFormat();
+        bool joined = false;
+        qreal pts_end = 0, dts_end = 0;
+        if (has_ao && ao->isOpen() && ao->isPowerSaving()) {
+            // play whole chunks only, so the device and this thread wake up once per chunk
+            const qreal duration = af.secondsForFrames(af.framesForBytes(decoded.size()));
+            pts_end = frame_pts + duration;
+            dts_end = frame_dts + duration;
+            d.pending.append(decoded);
+            d.pending_pts = pts_end;
+            d.pending_volume_applied = volume_applied;
+            const int chunk = qMax(ao->bufferSize(), 1);
+            const int bytes = d.pending.size()/chunk*chunk;
+            if (bytes == 0) {
+                if (!received) {
+                    pkt.pts = pts_end;
+                    pkt.dts = dts_end;
+                }
+                continue;
+            }
+            const qreal pending_duration = af.secondsForFrames(af.framesForBytes(d.pending.size()));
+            frame_pts = pts_end - pending_duration;
+            frame_dts = dts_end - pending_duration;
+            decoded = d.pending.left(bytes);
+            d.pending.remove(0, bytes);
+            joined = true;
+        }
         int decodedSize = decoded.size();
         int decodedPos = 0;
         qreal delay = 0;
-        //AudioFormat.durationForBytes() calculates int type internally. not accurate
-        const AudioFormat &af = dec->resampler()->outAudioFormat();
-        const qreal byte_rate = af.bytesPerSecond();
+        const qreal pts0 = frame_pts, dts0 = frame_dts;
+        qreal written = 0; // duration since pts0
         while (decodedSize > 0) {
             if (d.stop) {
                 qDebug("audio thread stop after decode()");
@@ -267,14 +562,31 @@ void AudioThread::run()
             }
             // TODO: set to format.bytesPerFrame()*1024?
             const int chunk = qMin(decodedSize, has_ao ? ao->bufferSize() : 1024*4);//int(max_len*byte_rate));
-            //AudioFormat.bytesForDuration
-            const qreal chunk_delay = (qreal)chunk/(qreal)byte_rate;
-            pkt.pts += chunk_delay;
-            pkt.dts += chunk_delay;
-            if (has_ao && ao->isOpen()) {
-                QByteArray decodedChunk = QByteArray::fromRawData(decoded.constData() + decodedPos, chunk);
-                ao->play(decodedChunk, pkt.pts);
-                d.clock->updateValue(ao->timestamp());
+            // chunk may be not a multiple of frame size if no ao. frames are counted from all bytes written
+            const qreal end = af.secondsForFrames(af.framesForBytes(decodedPos + chunk));
+            const qreal chunk_delay = end - written;
+            written = end;
+            frame_pts = pts0 + written;
+            frame_dts = dts0 + written;
+            if (d.offline) {
+                // not played, the device would block in real time
+                d.clock->updateValue(frame_pts);
+            } else if (has_ao && ao->isOpen()) {
+                TraceRecorder::Span span("audio write", "audio");
+#if USE_AUDIO_FRAME
+                if (chunk == decoded.size() && !stretched && !joined) {
+                    // the whole frame. no copy for backends queueing buffers, and the buffer is recycled
+                    frame.setTimestamp(frame_pts);
+                    ao->play(frame, volume_applied);
+                } else
+#endif
+                {
+                    QByteArray decodedChunk = QByteArray::fromRawData(decoded.constData() + decodedPos, chunk);
+                    ao->play(decodedChunk, frame_pts, volume_applied);
+                }
+                // the data being heard is behind the data taken by the device
+                d.clock->updateAudioTime(ao->timestamp(), ao->latency());
+                startClock(); // preroll is written
             } else {
                 d.clock->updateDelay(delay += chunk_delay);
             /*
@@ -288,8 +600,24 @@ void AudioThread::run()
             decodedPos += chunk;
             decodedSize -= chunk;
         }
-        if (has_ao)
+        if (!received) { // the rest of the packet follows written or pending data
+            pkt.pts = joined ? pts_end : frame_pts;
+            pkt.dts = joined ? dts_end : frame_dts;
+        }
+        if (tracing && has_ao && ao->isOpen() && !d.offline && decodedPos > 0) {
+            // output: until the device takes the data. present: the device latency until it's heard
+            const qint64 now = Statistics::tracingTime();
+            const qint64 heard = now + qint64(ao->latency()*1e9);
+            Statistics::Common &st = d.statistics->audio;
+            st.addLatency(Statistics::LatencyOutput, trace_filtered, now);
+            st.addLatency(Statistics::LatencyPresent, now, heard);
+            st.addLatency(Statistics::LatencyTotal, pkt.demuxTime, heard);
+        }
+        if (has_ao) {
+            if (d.statistics)
+                ao->getTimingStatistics(&d.statistics->audio_only);
             emit frameDelivered();
+        }
         d.last_pts = d.clock->value(); //not pkt.pts! the delay is updated!
     }
     d.packets.clear();
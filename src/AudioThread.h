@@ -28,6 +28,7 @@ namespace QtAV {
 
 class AudioDecoder;
 class AudioFrame;
+class SPDIFMuxer;
 class AudioThreadPrivate;
 class AudioThread : public AVThread
 {
@@ -35,9 +36,16 @@ class AudioThread : public AVThread
     DPTR_DECLARE_PRIVATE(AudioThread)
 public:
     explicit AudioThread(QObject *parent = 0);
+    /*!
+     * \brief setPassthrough
+     * Play packets as IEC 61937 bursts muxed by spdif instead of decoding them. The thread takes the ownership.
+     * \param spdif an opened muxer for the current stream. 0: decode
+     */
+    void setPassthrough(SPDIFMuxer* spdif);
 
 protected:
-    void applyFilters(AudioFrame& frame);
+    // false if the frame is buffered by a block size filter and there is nothing to play now
+    bool applyFilters(AudioFrame& frame);
     virtual void run();
 };
 
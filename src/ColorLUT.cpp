@@ -0,0 +1,202 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/ColorLUT.h"
+#include <QtCore/QFile>
+#include <QtCore/QList>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+class ColorLUT::Private : public QSharedData
+{
+public:
+    Private() : size(0), domain_min(0, 0, 0), domain_max(1, 1, 1) {}
+    void init(int n) {
+        size = n;
+        data.resize(n*n*n*4);
+        uchar *p = (uchar*)data.data();
+        for (int g = 0; g < n; ++g) {
+            for (int b = 0; b < n; ++b) {
+                for (int r = 0; r < n; ++r) {
+                    *p++ = r*255/(n - 1);
+                    *p++ = g*255/(n - 1);
+                    *p++ = b*255/(n - 1);
+                    *p++ = 255;
+                }
+            }
+        }
+    }
+    int offset(int r, int g, int b) const {
+        return ((g*size + b)*size + r)*4;
+    }
+    int size;
+    QByteArray data;
+    QVector3D domain_min, domain_max;
+};
+
+static inline uchar toByte(float v)
+{
+    return uchar(qBound(0.0f, v, 1.0f)*255.0f + 0.5f);
+}
+
+// read 3 floats. return false if the line is not a triple
+static bool parseTriple(const QByteArray& line, float *v)
+{
+    const QList<QByteArray> tokens = line.simplified().split(' ');
+    if (tokens.size() != 3)
+        return false;
+    bool ok = false;
+    for (int i = 0; i < 3; ++i) {
+        v[i] = tokens.at(i).toFloat(&ok);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+ColorLUT ColorLUT::fromCube(const QString &fileName)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning("ColorLUT: can not open %s: %s", qPrintable(fileName), qPrintable(f.errorString()));
+        return ColorLUT();
+    }
+    ColorLUT lut;
+    QVector3D dmin(0, 0, 0), dmax(1, 1, 1);
+    int n = 0; // entries read
+    uchar *p = 0;
+    while (!f.atEnd()) {
+        const QByteArray line = f.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        float v[3];
+        if (lut.isValid() && parseTriple(line, v)) {
+            // red changes fastest, then green, then blue
+            const int s = lut.size();
+            if (n >= s*s*s)
+                break;
+            const int r = n % s, g = (n/s) % s, b = n/(s*s);
+            uchar *t = p + lut.d->offset(r, g, b);
+            t[0] = toByte(v[0]);
+            t[1] = toByte(v[1]);
+            t[2] = toByte(v[2]);
+            ++n;
+            continue;
+        }
+        if (line.startsWith("LUT_3D_SIZE")) {
+            const int s = line.mid(11).trimmed().toInt();
+            if (s < 2 || s > kMaxSize) {
+                qWarning("ColorLUT: unsupported size %d in %s", s, qPrintable(fileName));
+                return ColorLUT();
+            }
+            lut = ColorLUT(s);
+            p = (uchar*)lut.d->data.data();
+        } else if (line.startsWith("LUT_1D_SIZE")) {
+            qWarning("ColorLUT: 1D LUT is not supported: %s", qPrintable(fileName));
+            return ColorLUT();
+        } else if (line.startsWith("DOMAIN_MIN")) {
+            if (parseTriple(line.mid(10), v))
+                dmin = QVector3D(v[0], v[1], v[2]);
+        } else if (line.startsWith("DOMAIN_MAX")) {
+            if (parseTriple(line.mid(10), v))
+                dmax = QVector3D(v[0], v[1], v[2]);
+        } else if (line.startsWith("LUT_3D_INPUT_RANGE")) { // resolve
+            const QList<QByteArray> range = line.mid(18).simplified().split(' ');
+            if (range.size() == 2) {
+                const float lo = range.at(0).toFloat(), hi = range.at(1).toFloat();
+                dmin = QVector3D(lo, lo, lo);
+                dmax = QVector3D(hi, hi, hi);
+            }
+        } // TITLE and unknown keywords are ignored
+    }
+    if (!lut.isValid() || n != lut.size()*lut.size()*lut.size()) {
+        qWarning("ColorLUT: %d entries in %s, expect %d", n, qPrintable(fileName), lut.size()*lut.size()*lut.size());
+        return ColorLUT();
+    }
+    lut.setDomain(dmin, dmax);
+    return lut;
+}
+
+ColorLUT::ColorLUT()
+    : d(new Private())
+{}
+
+ColorLUT::ColorLUT(int size)
+    : d(new Private())
+{
+    if (size >= 2 && size <= kMaxSize)
+        d->init(size);
+}
+
+ColorLUT::~ColorLUT()
+{}
+
+bool ColorLUT::isValid() const
+{
+    return d->size > 0;
+}
+
+int ColorLUT::size() const
+{
+    return d->size;
+}
+
+void ColorLUT::setValue(int r, int g, int b, const QVector3D &value)
+{
+    if (r < 0 || g < 0 || b < 0 || r >= d->size || g >= d->size || b >= d->size)
+        return;
+    uchar *t = (uchar*)d->data.data() + d->offset(r, g, b);
+    t[0] = toByte(value.x());
+    t[1] = toByte(value.y());
+    t[2] = toByte(value.z());
+}
+
+QVector3D ColorLUT::value(int r, int g, int b) const
+{
+    if (r < 0 || g < 0 || b < 0 || r >= d->size || g >= d->size || b >= d->size)
+        return QVector3D();
+    const uchar *t = (const uchar*)d->data.constData() + d->offset(r, g, b);
+    return QVector3D(t[0], t[1], t[2])/255.0f;
+}
+
+void ColorLUT::setDomain(const QVector3D &min, const QVector3D &max)
+{
+    d->domain_min = min;
+    d->domain_max = max;
+}
+
+QVector3D ColorLUT::domainMin() const
+{
+    return d->domain_min;
+}
+
+QVector3D ColorLUT::domainMax() const
+{
+    return d->domain_max;
+}
+
+QByteArray ColorLUT::data() const
+{
+    return d->data;
+}
+
+} //namespace QtAV
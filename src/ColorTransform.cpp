@@ -55,6 +55,20 @@ static const QMatrix4x4 yuv2rgb_bt709 =
                 0.0f, 0.0f, 1.0f, -0.5f,
                 0.0f, 0.0f, 0.0f, 1.0f);
 
+// Kr = 0.2627, Kb = 0.0593
+static const QMatrix4x4 yuv2rgb_bt2020 =
+           QMatrix4x4(
+                1.0f,  0.000f,    1.4746f,  0.0f,
+                1.0f, -0.16455f, -0.57135f, 0.0f,
+                1.0f,  1.8814f,   0.000f,   0.0f,
+                0.0f,  0.000f,    0.000f,   1.0f)
+            *
+            QMatrix4x4(
+                1.0f, 0.0f, 0.0f, 0.0f,
+                0.0f, 1.0f, 0.0f, -0.5f,
+                0.0f, 0.0f, 1.0f, -0.5f,
+                0.0f, 0.0f, 0.0f, 1.0f);
+
 const QMatrix4x4& ColorTransform::YUV2RGB(ColorSpace cs)
 {
     switch (cs) {
@@ -62,12 +76,34 @@ const QMatrix4x4& ColorTransform::YUV2RGB(ColorSpace cs)
         return yuv2rgb_bt601;
     case ColorSpace_BT709:
         return yuv2rgb_bt709;
+    case ColorSpace_BT2020:
+        return yuv2rgb_bt2020;
     default:
         return yuv2rgb_bt601;
     }
     return yuv2rgb_bt601;
 }
 
+QMatrix3x3 ColorTransform::gamutMatrix(ColorPrimaries from, ColorPrimaries to)
+{
+    // ITU-R BT.2087
+    static const float bt709_to_bt2020[] = {
+        0.6274f, 0.3293f, 0.0433f,
+        0.0691f, 0.9195f, 0.0114f,
+        0.0164f, 0.0880f, 0.8956f
+    };
+    static const float bt2020_to_bt709[] = {
+         1.6605f, -0.5876f, -0.0728f,
+        -0.1246f,  1.1329f, -0.0083f,
+        -0.0182f, -0.1006f,  1.1187f
+    };
+    if (from == to)
+        return QMatrix3x3();
+    if (from == ColorPrimaries_BT709)
+        return QMatrix3x3(bt709_to_bt2020);
+    return QMatrix3x3(bt2020_to_bt709);
+}
+
 class ColorTransform::Private : public QSharedData
 {
 public:
@@ -49,8 +49,27 @@ ColorSpace colorSpaceFromFFmpeg(AVColorSpace cs)
     case AVCOL_SPC_BT709: return ColorSpace_BT709;
     case AVCOL_SPC_BT470BG: return ColorSpace_BT601;
     case AVCOL_SPC_SMPTE170M: return ColorSpace_BT601;
+    case AVCOL_SPC_BT2020_NCL: return ColorSpace_BT2020;
+    case AVCOL_SPC_BT2020_CL: return ColorSpace_BT2020; // cl is rare. ncl matrix is a good approximation
     default: return ColorSpace_Unknow;
     }
 }
 
+ColorTransfer colorTransferFromFFmpeg(AVColorTransferCharacteristic trc)
+{
+    // values of AVCOL_TRC_SMPTE2084 and AVCOL_TRC_ARIB_STD_B67, which are not defined in old versions
+    switch ((int)trc) {
+    case 16: return ColorTransfer_PQ;
+    case 18: return ColorTransfer_HLG;
+    default: return ColorTransfer_SDR;
+    }
+}
+
+ColorPrimaries colorPrimariesFromFFmpeg(AVColorPrimaries cp)
+{
+    if (cp == AVCOL_PRI_BT2020)
+        return ColorPrimaries_BT2020;
+    return ColorPrimaries_BT709;
+}
+
 }
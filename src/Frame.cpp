@@ -24,6 +24,26 @@
 #include "utils/Logger.h"
 
 namespace QtAV {
+namespace {
+// metadata keys of Frame::SideData
+static const char* const kSideDataKeys[] = {
+    "pict_type",
+    "latency_demux",
+    "latency_decoded",
+    "latency_filtered",
+    "latency_sent",
+    "decode_time"
+};
+
+int sideDataIndex(const QString& key)
+{
+    for (int i = 0; i < Frame::SideDataCount; ++i) {
+        if (key == QLatin1String(kSideDataKeys[i]))
+            return i;
+    }
+    return -1;
+}
+} //namespace
 
 Frame::Frame(const Frame &other)
     :d_ptr(other.d_ptr)
@@ -79,7 +99,10 @@ uchar* Frame::bits(int plane)
         qWarning("Invalid plane! Valid range is [0, %d)", planeCount());
         return 0;
     }
-    return d_func()->planes[plane];
+    Q_D(Frame);
+    if (!d->planes[plane])
+        d->mapToHost();
+    return d->planes[plane];
 }
 
 const uchar* Frame::constBits(int plane) const
@@ -88,7 +111,10 @@ const uchar* Frame::constBits(int plane) const
         qWarning("Invalid plane! Valid range is [0, %d)", planeCount());
         return 0;
     }
-    return d_func()->planes[plane];
+    const FramePrivate *d = d_func();
+    if (!d->planes[plane])
+        const_cast<FramePrivate*>(d)->mapToHost();
+    return d->planes[plane];
 }
 
 void Frame::setBits(uchar *b, int plane)
@@ -105,7 +131,7 @@ void Frame::setBits(const QVector<uchar *> &b)
 {
     Q_D(Frame);
     const int nb_planes = planeCount();
-    d->planes = b;
+    assignPlanes(&d->planes, b);
     if (d->planes.size() > nb_planes) {
         d->planes.reserve(nb_planes);
         d->planes.resize(nb_planes);
@@ -133,7 +159,7 @@ void Frame::setBytesPerLine(const QVector<int> &lineSize)
 {
     Q_D(Frame);
     const int nb_planes = planeCount();
-    d->line_sizes = lineSize;
+    assignPlanes(&d->line_sizes, lineSize);
     if (d->line_sizes.size() > nb_planes) {
         d->line_sizes.reserve(nb_planes);
         d->line_sizes.resize(nb_planes);
@@ -164,7 +190,13 @@ int Frame::channelCount() const
 QVariantMap Frame::availableMetaData() const
 {
     Q_D(const Frame);
-    return d->metadata;
+    QVariantMap m(d->metadata);
+    for (int i = 0; i < SideDataCount; ++i) {
+        if (d->side_mask & (1 << i))
+            m.insert(QLatin1String(kSideDataKeys[i]), d->side_data[i]);
+    }
+    d->availableSideMetaData(&m);
+    return m;
 }
 
 /*!
@@ -179,6 +211,12 @@ QVariantMap Frame::availableMetaData() const
 QVariant Frame::metaData(const QString &key) const
 {
     Q_D(const Frame);
+    const int i = sideDataIndex(key);
+    if (i >= 0)
+        return hasSideData(SideData(i)) ? QVariant(d->side_data[i]) : QVariant();
+    QVariant v;
+    if (d->sideMetaData(key, &v))
+        return v;
     return d->metadata.value(key);
 }
 
@@ -194,12 +232,51 @@ QVariant Frame::metaData(const QString &key) const
 void Frame::setMetaData(const QString &key, const QVariant &value)
 {
     Q_D(Frame);
+    const int i = sideDataIndex(key);
+    if (i >= 0) {
+        if (value.isNull())
+            d->side_mask &= ~(1 << i);
+        else
+            setSideData(SideData(i), value.toLongLong());
+        return;
+    }
+    if (d->setSideMetaData(key, value))
+        return;
     if (!value.isNull())
         d->metadata.insert(key, value);
     else
         d->metadata.remove(key);
 }
 
+bool Frame::hasSideData(SideData key) const
+{
+    return d_func()->side_mask & (1 << key);
+}
+
+qint64 Frame::sideData(SideData key) const
+{
+    if (!hasSideData(key))
+        return 0;
+    return d_func()->side_data[key];
+}
+
+void Frame::setSideData(SideData key, qint64 value)
+{
+    Q_D(Frame);
+    d->side_data[key] = value;
+    d->side_mask |= 1 << key;
+}
+
+void Frame::setBufferRef(const FrameBufferRef &ref)
+{
+    d_func()->buffer_ref = ref;
+}
+
+FrameBufferRef Frame::bufferRef() const
+{
+    return d_func()->buffer_ref;
+}
+
 qreal Frame::timestamp() const
 {
     return d_func()->timestamp;
@@ -0,0 +1,120 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/FrameDropPolicy.h"
+
+namespace QtAV {
+namespace {
+static const qreal kAlpha = 0.1; // weight of a new sample in moving averages
+static const qreal kRestore = 0.7; // non reference frames are decoded again if the predicted cost is below budget*kRestore
+static const int kMaxRenderSkip = 4; // display at least 1 of kMaxRenderSkip+1 late frames, so the picture keeps moving
+}
+
+PredictiveFrameDropPolicy::PredictiveFrameDropPolicy()
+    : m_budget(0.8)
+    , m_max_late(2.0)
+    , m_drop_nonref(false)
+    , m_render_skipped(0)
+{
+    for (int i = 0; i < 4; ++i) {
+        m_cost[i] = 0;
+        m_ratio[i] = 0;
+    }
+}
+
+void PredictiveFrameDropPolicy::setBudget(qreal value)
+{
+    m_budget = qBound<qreal>(0.1, value, 1.0);
+}
+
+qreal PredictiveFrameDropPolicy::budget() const
+{
+    return m_budget;
+}
+
+void PredictiveFrameDropPolicy::setMaxLateness(qreal value)
+{
+    m_max_late = value;
+}
+
+qreal PredictiveFrameDropPolicy::maxLateness() const
+{
+    return m_max_late;
+}
+
+qreal PredictiveFrameDropPolicy::predictedDecodeTime(bool refOnly) const
+{
+    // cost per frame of the stream. frames not decoded cost nothing
+    qreal cost = 0, ratio = 0;
+    for (int i = 0; i < 4; ++i) {
+        ratio += m_ratio[i];
+        if (refOnly && i == BPicture)
+            continue;
+        cost += m_cost[i]*m_ratio[i];
+    }
+    if (ratio <= 0)
+        return 0;
+    return cost/ratio;
+}
+
+void PredictiveFrameDropPolicy::reset()
+{
+    m_drop_nonref = false;
+    m_render_skipped = 0;
+}
+
+void PredictiveFrameDropPolicy::frameDecoded(PictureType type, qint64 decodeTime)
+{
+    const qreal us = qreal(decodeTime);
+    m_cost[type] = m_cost[type] > 0 ? m_cost[type]*(1.0 - kAlpha) + us*kAlpha : us;
+    // b frames are absent while they are dropped, the ratio of the stream is kept
+    if (m_drop_nonref)
+        return;
+    for (int i = 0; i < 4; ++i)
+        m_ratio[i] = m_ratio[i]*(1.0 - kAlpha) + (i == type ? kAlpha : 0.0);
+}
+
+FrameDropPolicy::Decision PredictiveFrameDropPolicy::decide(qreal lateness, qreal frameInterval, bool keyFrame)
+{
+    if (lateness > m_max_late && !keyFrame)
+        return DropToKeyFrame;
+    const qreal budget = m_budget*frameInterval*1000000.0;
+    const qreal cost = predictedDecodeTime();
+    // drop before falling behind if the decoder can not keep up, or catch up if already behind
+    if (cost > budget || lateness > qMax<qreal>(2.0*frameInterval, 0.05))
+        m_drop_nonref = true;
+    else if (m_drop_nonref && cost < budget*kRestore && lateness <= 0)
+        m_drop_nonref = false;
+    return m_drop_nonref ? DropNonRef : DecodeAll;
+}
+
+bool PredictiveFrameDropPolicy::render(PictureType type, qreal lateness, qreal frameInterval)
+{
+    // a frame displayed later than the next one is due is worth less than the time it takes
+    const bool droppable = type == BPicture || type == UnknownPicture || (type == PPicture && lateness > 4.0*frameInterval);
+    if (droppable && lateness > qMax<qreal>(frameInterval, 0.04) && m_render_skipped < kMaxRenderSkip) {
+        ++m_render_skipped;
+        return false;
+    }
+    m_render_skipped = 0;
+    return true;
+}
+} //namespace QtAV
@@ -0,0 +1,255 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "GLFrameConverter.h"
+#include <QtCore/QCoreApplication>
+#include <QtCore/QThread>
+#define QT_GL_CONVERTER (QT_VERSION >= QT_VERSION_CHECK(5, 1, 0))
+#if QT_GL_CONVERTER
+#include <QtCore/QMutex>
+#include <QtCore/QPointer>
+#include <QtCore/QThreadStorage>
+#include <QtGui/QColor>
+#include <QtGui/QOffscreenSurface>
+#include <QtGui/QOpenGLBuffer>
+#include <QtGui/QOpenGLFramebufferObject>
+#include "QtAV/OpenGLVideo.h"
+#include "utils/OpenGLHelper.h"
+#endif //QT_GL_CONVERTER
+#include <string.h>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+#if QT_GL_CONVERTER
+/*!
+ * QOffscreenSurface::create() must be called in gui thread. Other threads post a request and fail until it's created.
+ * The surface is a child of qApp, so it's destroyed with the application and the pointer becomes null.
+ */
+class OffscreenSurfaceCreator : public QObject
+{
+    Q_OBJECT
+public:
+    OffscreenSurfaceCreator() : requested(false) {
+        moveToThread(qApp->thread());
+    }
+    QOffscreenSurface* surface() {
+        if (QThread::currentThread() == qApp->thread())
+            create();
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        if (!surf && !requested) {
+            requested = true;
+            QMetaObject::invokeMethod(this, "create", Qt::QueuedConnection);
+        }
+        return surf;
+    }
+public Q_SLOTS:
+    void create() {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        requested = false;
+        if (surf)
+            return;
+        surf = new QOffscreenSurface();
+        surf->setParent(qApp);
+        surf->setFormat(QOpenGLContext::globalShareContext() ? QOpenGLContext::globalShareContext()->format() : QSurfaceFormat::defaultFormat());
+        surf->create();
+        if (!surf->isValid()) {
+            qWarning("GLFrameConverter: failed to create offscreen surface");
+            delete surf;
+        }
+    }
+private:
+    QMutex mutex;
+    QPointer<QOffscreenSurface> surf;
+    bool requested;
+};
+Q_GLOBAL_STATIC(OffscreenSurfaceCreator, surfaceCreator)
+
+class OffscreenRenderer
+{
+public:
+    OffscreenRenderer() : ctx(0), fbo(0), glv(0), pbo(QOpenGLBuffer::PixelPackBuffer) {}
+    ~OffscreenRenderer() {
+        if (!ctx)
+            return;
+        // gl resources are leaked if the surface is destroyed with qApp before this thread exits
+        if (surface && ctx->makeCurrent(surface)) {
+            delete glv;
+            delete fbo;
+            pbo.destroy();
+            ctx->doneCurrent();
+        }
+        delete ctx;
+    }
+    bool convert(QOffscreenSurface *s, const VideoFrame& frame, const QRectF& roi, VideoFormat::PixelFormat pixfmt, const QSize& size, uchar* dst, int dst_pitch) {
+        if (!ctx) {
+            ctx = new QOpenGLContext();
+            ctx->setFormat(s->format());
+            ctx->setShareContext(QOpenGLContext::globalShareContext());
+            if (!ctx->create()) {
+                qWarning("GLFrameConverter: failed to create context");
+                delete ctx;
+                ctx = 0;
+                return false;
+            }
+        }
+        surface = s;
+        // VideoFrame::to() may be called in a rendering thread with its context current
+        QOpenGLContext *old_ctx = QOpenGLContext::currentContext();
+        QSurface *old_surface = old_ctx ? old_ctx->surface() : 0;
+        if (!ctx->makeCurrent(surface))
+            return false;
+        const bool ok = render(frame, roi, pixfmt, size, dst, dst_pitch);
+        if (old_ctx)
+            old_ctx->makeCurrent(old_surface);
+        else
+            ctx->doneCurrent();
+        return ok;
+    }
+private:
+    bool render(const VideoFrame& frame, const QRectF& roi, VideoFormat::PixelFormat pixfmt, const QSize& size, uchar* dst, int dst_pitch) {
+        const int w = size.width(), h = size.height();
+        if (!fbo || fbo->size() != size) {
+            delete fbo;
+            fbo = new QOpenGLFramebufferObject(size);
+        }
+        if (!fbo->isValid() || !fbo->bind()) {
+            qWarning("GLFrameConverter: invalid fbo");
+            return false;
+        }
+        if (!glv) {
+            glv = new OpenGLVideo();
+            glv->setOpenGLContext(ctx);
+        }
+        DYGL(glViewport(0, 0, w, h));
+        glv->setProjectionMatrixToRect(QRectF(0, 0, w, h));
+        glv->setCurrentFrame(frame);
+        glv->fill(QColor(Qt::black));
+        glv->render(QRectF(0, 0, w, h), roi);
+        // opengl es2 can only read GL_RGBA. b and r are swapped while copying
+        const bool gles = OpenGLHelper::isOpenGLES();
+        const bool bgra = pixfmt == VideoFormat::Format_BGRA32 || pixfmt == VideoFormat::Format_RGB32;
+        const GLenum gl_fmt = bgra && !gles ? GL_BGRA : GL_RGBA;
+        const int pitch = w*4;
+        DYGL(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+        const uchar *src = 0;
+        QByteArray buf;
+        // glReadPixels to a pbo returns without waiting for the rendering, the driver copies when the result is ready
+        if (!gles) {
+            if (!pbo.isCreated() && pbo.create())
+                pbo.setUsagePattern(QOpenGLBuffer::StreamRead);
+            if (pbo.isCreated() && pbo.bind()) {
+                if (pbo.size() != pitch*h)
+                    pbo.allocate(pitch*h);
+                DYGL(glReadPixels(0, 0, w, h, gl_fmt, GL_UNSIGNED_BYTE, 0));
+                src = (const uchar*)pbo.map(QOpenGLBuffer::ReadOnly);
+                if (!src)
+                    pbo.release();
+            }
+        }
+        if (!src) {
+            buf.resize(pitch*h);
+            DYGL(glReadPixels(0, 0, w, h, gl_fmt, GL_UNSIGNED_BYTE, buf.data()));
+            src = (const uchar*)buf.constData();
+        }
+        // fbo rows are bottom up
+        for (int y = 0; y < h; ++y) {
+            const uchar *s = src + (h - 1 - y)*pitch;
+            uchar *d = dst + y*dst_pitch;
+            if (gl_fmt == GL_RGBA && bgra) {
+                for (int x = 0; x < pitch; x += 4) {
+                    d[x] = s[x+2];
+                    d[x+1] = s[x+1];
+                    d[x+2] = s[x];
+                    d[x+3] = s[x+3];
+                }
+            } else {
+                memcpy(d, s, pitch);
+            }
+        }
+        if (buf.isEmpty()) {
+            pbo.unmap();
+            pbo.release();
+        }
+        fbo->release();
+        return true;
+    }
+
+    QOpenGLContext *ctx;
+    QPointer<QOffscreenSurface> surface;
+    QOpenGLFramebufferObject *fbo;
+    OpenGLVideo *glv;
+    QOpenGLBuffer pbo;
+};
+Q_GLOBAL_STATIC(QThreadStorage<OffscreenRenderer*>, offscreenRenderers)
+#endif //QT_GL_CONVERTER
+
+bool GLFrameConverter::isSupported(VideoFormat::PixelFormat pixfmt)
+{
+#if QT_GL_CONVERTER
+    switch (pixfmt) {
+    case VideoFormat::Format_RGBA32:
+    case VideoFormat::Format_BGRA32:
+        return true;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    case VideoFormat::Format_RGB32: // BGRA bytes
+    case VideoFormat::Format_BGR32: // RGBA bytes
+        return true;
+#endif
+    default:
+        return false;
+    }
+#else
+    Q_UNUSED(pixfmt);
+    return false;
+#endif //QT_GL_CONVERTER
+}
+
+bool GLFrameConverter::convert(const VideoFrame &frame, const QRectF &roi, VideoFormat::PixelFormat pixfmt, const QSize &dstSize, uchar *dst, int dst_pitch)
+{
+#if QT_GL_CONVERTER
+    if (!isSupported(pixfmt) || !OpenGLVideo::isSupported(frame.pixelFormat()) || dstSize.isEmpty() || !dst)
+        return false;
+    if (!qApp)
+        return false;
+    QOffscreenSurface *surface = surfaceCreator()->surface();
+    if (!surface)
+        return false;
+    QThreadStorage<OffscreenRenderer*> *renderers = offscreenRenderers();
+    if (!renderers->hasLocalData())
+        renderers->setLocalData(new OffscreenRenderer());
+    return renderers->localData()->convert(surface, frame, roi, pixfmt, dstSize, dst, dst_pitch);
+#else
+    Q_UNUSED(frame);
+    Q_UNUSED(roi);
+    Q_UNUSED(pixfmt);
+    Q_UNUSED(dstSize);
+    Q_UNUSED(dst);
+    Q_UNUSED(dst_pitch);
+    return false;
+#endif //QT_GL_CONVERTER
+}
+} //namespace QtAV
+#if QT_GL_CONVERTER
+#include "GLFrameConverter.moc"
+#endif
@@ -0,0 +1,50 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_GLFRAMECONVERTER_H
+#define QTAV_GLFRAMECONVERTER_H
+
+#include "QtAV/VideoFrame.h"
+
+namespace QtAV {
+/*!
+ * \brief The GLFrameConverter class
+ * Scales and converts a frame whose data is on gpu, e.g. a zero copy hw decoded frame, to packed rgb by rendering it with
+ * OpenGLVideo into an fbo of an offscreen context, and reads back the result through a pixel pack buffer. So the frame is
+ * neither copied back in its own format nor converted by ImageConverter. Used by VideoFrame::to().
+ * Every thread uses its own context. The offscreen surface is created in gui thread, so the first conversion in another
+ * thread may fail and the caller must fall back to ImageConverter.
+ */
+class GLFrameConverter
+{
+public:
+    /// RGBA32, BGRA32, and RGB32, BGR32 on little endian. false if Qt < 5.1
+    static bool isSupported(VideoFormat::PixelFormat pixfmt);
+    /*!
+     * \brief convert
+     * \param roi region of frame in pixels. null rect: the whole frame
+     * \param dst host memory of at least dstSize.height() lines of dst_pitch bytes
+     * \return false if failed, and dst is not modified
+     */
+    static bool convert(const VideoFrame& frame, const QRectF& roi, VideoFormat::PixelFormat pixfmt, const QSize& dstSize, uchar* dst, int dst_pitch);
+};
+} //namespace QtAV
+#endif // QTAV_GLFRAMECONVERTER_H
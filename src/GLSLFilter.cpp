@@ -0,0 +1,92 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/GLSLFilter.h"
+
+namespace QtAV {
+
+class GLSLFilterPrivate : public DPtrPrivate<GLSLFilter>
+{
+public:
+    GLSLFilterPrivate()
+        : enabled(true)
+    {}
+    bool enabled;
+    QByteArray shader;
+    QSize output_size;
+};
+
+GLSLFilter::GLSLFilter(QObject *parent)
+    : QObject(parent)
+{}
+
+GLSLFilter::~GLSLFilter()
+{}
+
+void GLSLFilter::setEnabled(bool value)
+{
+    DPTR_D(GLSLFilter);
+    if (d.enabled == value)
+        return;
+    d.enabled = value;
+    Q_EMIT enabledChanged(value);
+}
+
+bool GLSLFilter::isEnabled() const
+{
+    return d_func().enabled;
+}
+
+void GLSLFilter::setFragmentShader(const QByteArray &code)
+{
+    DPTR_D(GLSLFilter);
+    if (d.shader == code)
+        return;
+    d.shader = code;
+    Q_EMIT fragmentShaderChanged();
+}
+
+QByteArray GLSLFilter::fragmentShader() const
+{
+    return d_func().shader;
+}
+
+void GLSLFilter::setOutputSize(const QSize &value)
+{
+    DPTR_D(GLSLFilter);
+    if (d.output_size == value)
+        return;
+    d.output_size = value;
+    Q_EMIT outputSizeChanged();
+}
+
+QSize GLSLFilter::outputSize() const
+{
+    return d_func().output_size;
+}
+
+void GLSLFilter::setUniforms(QOpenGLShaderProgram *program, const QSize &inputSize)
+{
+    Q_UNUSED(program);
+    Q_UNUSED(inputSize);
+}
+
+} //namespace QtAV
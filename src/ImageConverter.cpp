@@ -47,6 +47,13 @@ QByteArray ImageConverter::outData() const
     return d_func().data_out;
 }
 
+void ImageConverter::releaseOutData()
+{
+    DPTR_D(ImageConverter);
+    FrameBufferPool::instance().put(d.data_out);
+    memset(&d.picture, 0, sizeof(d.picture));
+}
+
 bool ImageConverter::check() const
 {
     DPTR_D(const ImageConverter);
@@ -189,9 +196,11 @@ bool ImageConverter::prepareData()
     if (d.fmt_out == QTAV_PIX_FMT_C(NONE) || d.w_out <=0 || d.h_out <= 0)
         return false;
     int bytes = avpicture_get_size((AVPixelFormat)d.fmt_out, d.w_out, d.h_out);
-    //if (d.data_out.size() < bytes) {
-        d.data_out.resize(bytes);
-    //}
+    // a frame may share data_out of the last conversion. a new buffer instead of modifying it
+    if (d.data_out.size() != bytes || !d.data_out.isDetached()) {
+        FrameBufferPool::instance().put(d.data_out);
+        d.data_out = FrameBufferPool::instance().get(bytes);
+    }
     //picture的数据按PIX_FMT格式自动"关联"到 data
     avpicture_fill(
             &d.picture,
@@ -35,7 +35,7 @@ class ImageConverter;
 FACTORY_DECLARE(ImageConverter)
 
 class ImageConverterPrivate;
-class ImageConverter //export is not needed
+class Q_AV_PRIVATE_EXPORT ImageConverter // private export for tests/microbench
 {
     DPTR_DECLARE_PRIVATE(ImageConverter)
 public:
@@ -43,6 +43,12 @@ public:
     virtual ~ImageConverter();
 
     QByteArray outData() const;
+    /*!
+     * \brief releaseOutData
+     * Drop the reference to outData(), e.g. the data is used by a frame and the converter is kept for later conversions.
+     * A new buffer is prepared in next convert()
+     */
+    void releaseOutData();
     // return false if i/o format not supported, or size is not valid.
     virtual bool check() const;
     void setInSize(int width, int height);
@@ -82,11 +88,19 @@ class ImageConverterFFPrivate;
  * \brief The ImageConverterFF class
  * based on libswscale
  */
-class ImageConverterFF : public ImageConverter //Q_AV_EXPORT is not needed
+class Q_AV_PRIVATE_EXPORT ImageConverterFF : public ImageConverter
 {
     DPTR_DECLARE_PRIVATE(ImageConverterFF)
 public:
     ImageConverterFF();
+    /*!
+     * \brief setThreads
+     * Convert horizontal slices in parallel. Each slice has its own SwsContext.
+     * Slicing is used only if slices of input and output map exactly, i.e. the vertical scale ratio is a small integer ratio.
+     * \param value 0: auto, sliced if the frame is at least 1080p (default). 1: convert in the calling thread
+     */
+    void setThreads(int value);
+    int threads() const;
     virtual bool check() const;
     virtual bool convert(const quint8 *const srcSlice[], const int srcStride[]);
 };
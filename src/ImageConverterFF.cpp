@@ -24,7 +24,14 @@
 #include "QtAV/private/AVCompat.h"
 #include "QtAV/private/mkid.h"
 #include "QtAV/private/prepost.h"
+#include "utils/ImageConvert.h"
 #include "utils/Logger.h"
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVarLengthArray>
+#include <QtCore/QVector>
 
 namespace QtAV {
 
@@ -36,23 +43,109 @@ void RegisterImageConverterFF_Man()
     FACTORY_REGISTER_ID_MAN(ImageConverter, FF, "FFmpeg")
 }
 
+namespace {
+class SwsThreadPool : public QThreadPool
+{
+public:
+    SwsThreadPool() : QThreadPool() {
+        setMaxThreadCount(qBound(1, QThread::idealThreadCount() - 1, 7));
+    }
+};
+Q_GLOBAL_STATIC(SwsThreadPool, swsThreadPool)
+// smaller frames are converted in 1 thread if thread count is auto
+static const int kSliceMinPixels = 1920*1080;
+
+// rows [y, y+h) of a picture
+struct SwsSlice {
+    SwsContext *ctx;
+    const quint8 *src[4];
+    int src_stride[4];
+    int src_h;
+    quint8 *dst[4];
+    int dst_stride[4];
+    int dst_h;
+
+    bool scale() const {
+        return sws_scale(ctx, src, src_stride, 0, src_h, dst, dst_stride) == dst_h;
+    }
+};
+
+class SwsSliceTask : public QRunnable
+{
+public:
+    SwsSliceTask(const SwsSlice& slice, bool *ok, QSemaphore *done)
+        : m_slice(slice), m_ok(ok), m_done(done)
+    {}
+    void run() Q_DECL_OVERRIDE {
+        *m_ok = m_slice.scale();
+        m_done->release();
+    }
+private:
+    SwsSlice m_slice;
+    bool *m_ok;
+    QSemaphore *m_done;
+};
+
+int gcd(int a, int b)
+{
+    while (b) {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+bool setupColorspace(SwsContext *ctx, int brightness, int contrast, int saturation)
+{
+    // FIXME: how to fill the ranges?
+    const int srcRange = 1;
+    const int dstRange = 0;
+    // TODO: SWS_CS_DEFAULT?
+    return sws_setColorspaceDetails(ctx, sws_getCoefficients(SWS_CS_DEFAULT)
+                             , srcRange, sws_getCoefficients(SWS_CS_DEFAULT)
+                             , dstRange
+                             , ((brightness << 16) + 50)/100
+                             , (((contrast + 100) << 16) + 50)/100
+                             , (((saturation + 100) << 16) + 50)/100
+                             ) >= 0;
+    // TODO: b, c, s map function?
+}
+} //namespace
+
 class ImageConverterFFPrivate Q_DECL_FINAL: public ImageConverterPrivate
 {
 public:
     ImageConverterFFPrivate()
         : sws_ctx(0)
         , update_eq(true)
+        , threads(0)
+        , update_slice_eq(true)
     {}
     ~ImageConverterFFPrivate() {
         if (sws_ctx) {
             sws_freeContext(sws_ctx);
             sws_ctx = 0;
         }
+        foreach (SwsContext* ctx, slice_ctx) {
+            sws_freeContext(ctx);
+        }
     }
     virtual bool setupColorspaceDetails(bool force = true) Q_DECL_FINAL;
+    /*!
+     * split the picture into horizontal slices converted in parallel, each with its own context.
+     * slice boundaries must map to the same position of input and output, so vertical scaling must be in an small integer ratio.
+     * return -1 if slicing is not used, otherwise whether succeeded
+     */
+    int convertSlices(const quint8 *const srcSlice[], const int srcStride[], int flags);
+    // yuv420 to rgb32 and box scaling down by 2 or 4 without swscale. false if not supported
+    bool convertFast(const quint8 *const srcSlice[], const int srcStride[]);
 
     SwsContext *sws_ctx;
     bool update_eq;
+    int threads;
+    bool update_slice_eq;
+    QVector<SwsContext*> slice_ctx;
 };
 
 ImageConverterFF::ImageConverterFF()
@@ -60,6 +153,16 @@ ImageConverterFF::ImageConverterFF()
 {
 }
 
+void ImageConverterFF::setThreads(int value)
+{
+    d_func().threads = qMax(0, value);
+}
+
+int ImageConverterFF::threads() const
+{
+    return d_func().threads;
+}
+
 bool ImageConverterFF::check() const
 {
     if (!ImageConverter::check())
@@ -85,11 +188,20 @@ bool ImageConverterFF::convert(const quint8 *const srcSlice[], const int srcStri
             return false;
         setOutSize(d.w_in, d.h_in);
     }
+    // output buffer is released or still used by a frame of last conversion
+    if (d.data_out.isEmpty() || !d.data_out.isDetached())
+        prepareData();
+    if (d.convertFast(srcSlice, srcStride))
+        return true;
+    const int flags = (d.w_in == d.w_out && d.h_in == d.h_out) ? SWS_POINT : SWS_FAST_BILINEAR; //SWS_BICUBIC
+    const int sliced = d.convertSlices(srcSlice, srcStride, flags);
+    if (sliced >= 0)
+        return sliced > 0;
 //TODO: move those code to prepare()
     d.sws_ctx = sws_getCachedContext(d.sws_ctx
             , d.w_in, d.h_in, (AVPixelFormat)d.fmt_in
             , d.w_out, d.h_out, (AVPixelFormat)d.fmt_out
-            , (d.w_in == d.w_out && d.h_in == d.h_out) ? SWS_POINT : SWS_FAST_BILINEAR //SWS_BICUBIC
+            , flags
             , NULL, NULL, NULL
             );
     //int64_t flags = SWS_CPU_CAPS_SSE2 | SWS_CPU_CAPS_MMX | SWS_CPU_CAPS_MMX2;
@@ -150,8 +262,155 @@ bool ImageConverterFF::convert(const quint8 *const srcSlice[], const int srcStri
     return true;
 }
 
+bool ImageConverterFFPrivate::convertFast(const quint8 *const srcSlice[], const int srcStride[])
+{
+    // equalizer is applied by swscale
+    if (brightness || contrast || saturation)
+        return false;
+    if (!picture.data[0])
+        return false;
+    int factor = 1;
+    if (w_out != w_in || h_out != h_in) {
+        if (w_out*2 == w_in && h_out*2 == h_in)
+            factor = 2;
+        else if (w_out*4 == w_in && h_out*4 == h_in)
+            factor = 4;
+        else
+            return false;
+    }
+    const AVPixelFormat in = (AVPixelFormat)fmt_in;
+    const AVPixelFormat out = (AVPixelFormat)fmt_out;
+    const bool yuv420p = in == QTAV_PIX_FMT_C(YUV420P) || in == QTAV_PIX_FMT_C(YUVJ420P);
+    if (out == QTAV_PIX_FMT_C(BGRA) || out == QTAV_PIX_FMT_C(RGBA)) {
+        const bool rgba = out == QTAV_PIX_FMT_C(RGBA);
+        if (yuv420p && factor > 1)
+            return yuv420p_to_rgba_down(srcSlice, srcStride, picture.data[0], picture.linesize[0], w_out, h_out, factor, rgba);
+        if (factor > 1)
+            return false;
+        if (yuv420p) {
+            yuv420_to_rgba(srcSlice, srcStride, 1, picture.data[0], picture.linesize[0], w_out, h_out, rgba);
+            return true;
+        }
+        if (in == QTAV_PIX_FMT_C(NV12) || in == QTAV_PIX_FMT_C(NV21)) {
+            const quint8 *src[] = { srcSlice[0], srcSlice[1], srcSlice[1] + 1 };
+            if (in == QTAV_PIX_FMT_C(NV21))
+                qSwap(src[1], src[2]);
+            const int stride[] = { srcStride[0], srcStride[1], srcStride[1] };
+            yuv420_to_rgba(src, stride, 2, picture.data[0], picture.linesize[0], w_out, h_out, rgba);
+            return true;
+        }
+        return false;
+    }
+    // box scaling of the same format. chroma planes must be scaled exactly
+    if (factor == 1 || in != out || (w_in % (2*factor)) || (h_in % (2*factor)))
+        return false;
+    if (in == QTAV_PIX_FMT_C(BGRA) || in == QTAV_PIX_FMT_C(RGBA)
+            || in == QTAV_PIX_FMT_C(ARGB) || in == QTAV_PIX_FMT_C(ABGR)) {
+        return box_down(srcSlice[0], srcStride[0], picture.data[0], picture.linesize[0], w_out, h_out, factor, 4);
+    }
+    int w_shift = 0, h_shift = 0, planes = 3;
+    if (yuv420p) {
+        w_shift = h_shift = 1;
+    } else if (in == QTAV_PIX_FMT_C(YUV422P) || in == QTAV_PIX_FMT_C(YUVJ422P)) {
+        w_shift = 1;
+    } else if (in == QTAV_PIX_FMT_C(GRAY8)) {
+        planes = 1;
+    } else if (in != QTAV_PIX_FMT_C(YUV444P) && in != QTAV_PIX_FMT_C(YUVJ444P)) {
+        return false;
+    }
+    for (int i = 0; i < planes; ++i) {
+        const int ws = i ? w_shift : 0;
+        const int hs = i ? h_shift : 0;
+        box_down(srcSlice[i], srcStride[i], picture.data[i], picture.linesize[i], w_out >> ws, h_out >> hs, factor, 1);
+    }
+    return true;
+}
+
+int ImageConverterFFPrivate::convertSlices(const quint8 *const srcSlice[], const int srcStride[], int flags)
+{
+    int n = threads;
+    if (n == 0)
+        n = w_in*h_in < kSliceMinPixels ? 1 : QThread::idealThreadCount();
+    n = qMin(n, swsThreadPool()->maxThreadCount() + 1);
+    if (n <= 1)
+        return -1;
+    const AVPixFmtDescriptor *din = av_pix_fmt_desc_get((AVPixelFormat)fmt_in);
+    const AVPixFmtDescriptor *dout = av_pix_fmt_desc_get((AVPixelFormat)fmt_out);
+    if (!din || !dout)
+        return -1;
+    if ((din->flags | dout->flags) & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_PSEUDOPAL | AV_PIX_FMT_FLAG_HWACCEL))
+        return -1;
+    // a unit of slice height is the smallest rows mapping to whole chroma rows of input and output
+    const int g = gcd(h_in, h_out);
+    int in_unit = h_in/g;
+    int out_unit = h_out/g;
+    while ((in_unit & ((1 << din->log2_chroma_h) - 1)) || (out_unit & ((1 << dout->log2_chroma_h) - 1))) {
+        in_unit *= 2;
+        out_unit *= 2;
+    }
+    const int units = h_out/out_unit;
+    n = qMin(n, units);
+    if (n <= 1)
+        return -1;
+    if (slice_ctx.size() != n) {
+        foreach (SwsContext* ctx, slice_ctx) {
+            sws_freeContext(ctx);
+        }
+        slice_ctx.fill(0, n);
+    }
+    QVector<SwsSlice> slices(n);
+    for (int i = 0; i < n; ++i) {
+        const int u0 = units*i/n;
+        // the last slice includes the rows out of units
+        const int u1 = i == n - 1 ? -1 : units*(i+1)/n;
+        const int sy = u0*in_unit;
+        const int dy = u0*out_unit;
+        SwsSlice &s = slices[i];
+        s.src_h = (u1 < 0 ? h_in : u1*in_unit) - sy;
+        s.dst_h = (u1 < 0 ? h_out : u1*out_unit) - dy;
+        SwsContext *ctx = sws_getCachedContext(slice_ctx[i]
+                , w_in, s.src_h, (AVPixelFormat)fmt_in
+                , w_out, s.dst_h, (AVPixelFormat)fmt_out
+                , flags
+                , NULL, NULL, NULL
+                );
+        if (!ctx)
+            return 0;
+        if (ctx != slice_ctx[i] || update_slice_eq)
+            setupColorspace(ctx, brightness, contrast, saturation);
+        slice_ctx[i] = ctx;
+        s.ctx = ctx;
+        for (int p = 0; p < 4; ++p) {
+            const int sh = (p == 1 || p == 2) ? din->log2_chroma_h : 0;
+            const int dh = (p == 1 || p == 2) ? dout->log2_chroma_h : 0;
+            s.src[p] = srcSlice[p] ? srcSlice[p] + (sy >> sh)*srcStride[p] : 0;
+            s.src_stride[p] = srcStride[p];
+            s.dst[p] = picture.data[p] ? picture.data[p] + (dy >> dh)*picture.linesize[p] : 0;
+            s.dst_stride[p] = picture.linesize[p];
+        }
+    }
+    update_slice_eq = false;
+    QSemaphore done;
+    QVarLengthArray<bool, 16> ok(n);
+    // the last slice is converted in current thread
+    for (int i = 0; i < n - 1; ++i) {
+        swsThreadPool()->start(new SwsSliceTask(slices[i], &ok[i], &done));
+    }
+    ok[n-1] = slices[n-1].scale();
+    done.acquire(n - 1);
+    for (int i = 0; i < n; ++i) {
+        if (!ok[i]) {
+            qDebug("convert slice %d/%d failed", i, n);
+            return 0;
+        }
+    }
+    return 1;
+}
+
 bool ImageConverterFFPrivate::setupColorspaceDetails(bool force)
 {
+    if (force)
+        update_slice_eq = true;
     if (!sws_ctx) {
         update_eq = true;
         return false;
@@ -161,18 +420,7 @@ bool ImageConverterFFPrivate::setupColorspaceDetails(bool force)
     if (!update_eq) {
         return true;
     }
-    // FIXME: how to fill the ranges?
-    const int srcRange = 1;
-    const int dstRange = 0;
-    // TODO: SWS_CS_DEFAULT?
-    bool supported = sws_setColorspaceDetails(sws_ctx, sws_getCoefficients(SWS_CS_DEFAULT)
-                             , srcRange, sws_getCoefficients(SWS_CS_DEFAULT)
-                             , dstRange
-                             , ((brightness << 16) + 50)/100
-                             , (((contrast + 100) << 16) + 50)/100
-                             , (((saturation + 100) << 16) + 50)/100
-                             ) >= 0;
-    // TODO: b, c, s map function?
+    bool supported = setupColorspace(sws_ctx, brightness, contrast, saturation);
     //sws_init_context(d.sws_ctx, NULL, NULL);
     update_eq = false;
     return supported;
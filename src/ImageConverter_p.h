@@ -25,6 +25,7 @@
 
 #include "QtAV/private/AVCompat.h"
 #include <QtCore/QByteArray>
+#include "utils/FrameBufferPool.h"
 
 namespace QtAV {
 
@@ -42,6 +43,9 @@ public:
         , contrast(0)
         , saturation(0)
     {}
+    virtual ~ImageConverterPrivate() {
+        FrameBufferPool::instance().put(data_out);
+    }
     virtual bool setupColorspaceDetails(bool force = true) {
         Q_UNUSED(force);
         return true;
@@ -51,7 +55,7 @@ public:
     int w_in, h_in, w_out, h_out;
     int fmt_in, fmt_out;
     int brightness, contrast, saturation;
-    QByteArray data_out;
+    QByteArray data_out; // from FrameBufferPool
     AVPicture picture;
 };
 
@@ -0,0 +1,223 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "KeyFrameIndexer.h"
+#include "QtAV/MediaIO.h"
+#include "QtAV/private/AVCompat.h"
+#include "utils/StreamInfoCache.h"
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+KeyFrameIndexer::KeyFrameIndexer(const QString &url, bool mediaIO, AVInputFormat *format, int stream, QObject *parent)
+    : QThread(parent)
+    , m_url(url)
+    , m_mediaio(mediaIO)
+    , m_format(format)
+    , m_stream(stream)
+    , m_stop(false)
+    , m_last_pts((qint64)AV_NOPTS_VALUE)
+    , m_finished(false)
+    , m_progress(0)
+{}
+
+KeyFrameIndexer::~KeyFrameIndexer()
+{
+    stop();
+}
+
+void KeyFrameIndexer::stop()
+{
+    m_stop = true;
+    wait();
+}
+
+bool KeyFrameIndexer::isComplete() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_finished;
+}
+
+qreal KeyFrameIndexer::progress() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_progress;
+}
+
+bool KeyFrameIndexer::find(qint64 ts, Entry *e) const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_entries.isEmpty())
+        return false;
+    // the next key frame may be not scanned
+    if (!m_finished && (m_last_pts == (qint64)AV_NOPTS_VALUE || ts > m_last_pts))
+        return false;
+    // the last entry whose pts <= ts
+    int lo = 0, hi = m_entries.size();
+    while (lo < hi) {
+        const int mid = (lo + hi)/2;
+        if (m_entries.at(mid).pts <= ts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return false;
+    *e = m_entries.at(lo - 1);
+    return true;
+}
+
+QVector<KeyFrameIndexer::Entry> KeyFrameIndexer::entries() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_entries;
+}
+
+void KeyFrameIndexer::setEntries(const QVector<Entry> &entries)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_entries = entries;
+        m_finished = true;
+        m_progress = 1.0;
+    }
+    Q_EMIT progressChanged(1.0);
+    Q_EMIT indexFinished();
+}
+
+QVector<qint64> KeyFrameIndexer::toArray(const QVector<Entry> &entries)
+{
+    QVector<qint64> a;
+    a.reserve(entries.size()*3);
+    foreach (const Entry& e, entries) {
+        a.append(e.pts);
+        a.append(e.dts);
+        a.append(e.pos);
+    }
+    return a;
+}
+
+QVector<KeyFrameIndexer::Entry> KeyFrameIndexer::fromArray(const QVector<qint64> &array)
+{
+    QVector<Entry> entries(array.size()/3);
+    for (int i = 0; i < entries.size(); ++i) {
+        entries[i].pts = array.at(3*i);
+        entries[i].dts = array.at(3*i+1);
+        entries[i].pos = array.at(3*i+2);
+    }
+    return entries;
+}
+
+int KeyFrameIndexer::interruptCb(void *opaque)
+{
+    return static_cast<KeyFrameIndexer*>(opaque)->m_stop ? 1 : 0;
+}
+
+void KeyFrameIndexer::run()
+{
+    AVFormatContext *ctx = avformat_alloc_context();
+    ctx->interrupt_callback.callback = interruptCb;
+    ctx->interrupt_callback.opaque = this;
+    MediaIO *io = 0;
+    int ret = 0;
+    if (m_mediaio) {
+        io = MediaIO::createForUrl(m_url);
+        if (!io) {
+            qWarning("KeyFrameIndexer: can not create MediaIO for %s", qPrintable(m_url));
+            avformat_free_context(ctx);
+            return;
+        }
+        ctx->pb = (AVIOContext*)io->avioContext();
+        ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        ret = avformat_open_input(&ctx, "MediaIO", m_format, NULL);
+    } else {
+        ret = avformat_open_input(&ctx, m_url.toUtf8().constData(), m_format, NULL);
+    }
+    if (ret < 0) { // ctx is freed
+        qWarning("KeyFrameIndexer: failed to open: %s", av_err2str(ret));
+        delete io;
+        return;
+    }
+    const qint64 size = ctx->pb ? avio_size(ctx->pb) : -1;
+    const qint64 duration = ctx->duration == (int64_t)AV_NOPTS_VALUE ? 0 : ctx->duration;
+    qreal progress = 0;
+    AVPacket packet;
+    while (!m_stop) {
+        if (av_read_frame(ctx, &packet) < 0)
+            break;
+        if (packet.stream_index != m_stream) {
+            av_free_packet(&packet);
+            continue;
+        }
+        const qint64 pts = packet.pts != (int64_t)AV_NOPTS_VALUE ? packet.pts : packet.dts;
+        if (pts == (qint64)AV_NOPTS_VALUE) {
+            av_free_packet(&packet);
+            continue;
+        }
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        if (m_last_pts == (qint64)AV_NOPTS_VALUE || pts > m_last_pts)
+            m_last_pts = pts;
+        if ((packet.flags & AV_PKT_FLAG_KEY) && (m_entries.isEmpty() || pts > m_entries.last().pts)) {
+            Entry e;
+            e.pts = pts;
+            e.dts = packet.dts != (int64_t)AV_NOPTS_VALUE ? packet.dts : pts;
+            e.pos = packet.pos;
+            m_entries.append(e);
+        }
+        if (size > 0 && packet.pos >= 0) {
+            m_progress = qreal(packet.pos)/qreal(size);
+        } else if (duration > 0) {
+            const AVStream *st = ctx->streams[m_stream];
+            m_progress = qreal(av_rescale_q(pts - (st->start_time == (int64_t)AV_NOPTS_VALUE ? 0 : st->start_time), st->time_base, AV_TIME_BASE_Q))/qreal(duration);
+        }
+        m_progress = qBound<qreal>(0, m_progress, 1.0);
+        const qreal p = m_progress;
+        lock.unlock();
+        av_free_packet(&packet);
+        if (p - progress >= 0.01) {
+            progress = p;
+            Q_EMIT progressChanged(progress);
+        }
+    }
+    avformat_close_input(&ctx);
+    delete io;
+    if (m_stop)
+        return;
+    {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_finished = true;
+        m_progress = 1.0;
+    }
+    qDebug("KeyFrameIndexer: %d key frames in stream %d", m_entries.size(), m_stream);
+    if (!m_cache_key.isEmpty())
+        StreamInfoCache::instance().setKeyFrames(m_cache_key, m_stream, toArray(m_entries));
+    Q_EMIT progressChanged(1.0);
+    Q_EMIT indexFinished();
+}
+
+} //namespace QtAV
@@ -0,0 +1,93 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_KEYFRAMEINDEXER_H
+#define QTAV_KEYFRAMEINDEXER_H
+
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+struct AVInputFormat;
+namespace QtAV {
+/*!
+ * \brief The KeyFrameIndexer class
+ * Scan packets of a stream once in a background thread, with a new demuxer context on the same source.
+ * Only packet flags are used, nothing is decoded. The partial index can be used while scanning.
+ */
+class KeyFrameIndexer : public QThread
+{
+    Q_OBJECT
+public:
+    typedef struct {
+        qint64 pts; // stream time base. used to find the key frame
+        qint64 dts; // stream time base. used to seek. equals pts if dts is unknown
+        qint64 pos; // byte position. -1 if unknown
+    } Entry;
+
+    /*!
+     * \param url the url of the media or a MediaIO url. MediaIO::createForUrl() is used if mediaIO is true
+     * \param format input format of the loaded media. no probing if not null
+     * \param stream the index in AVFormatContext.streams
+     */
+    KeyFrameIndexer(const QString& url, bool mediaIO, AVInputFormat *format, int stream, QObject *parent = 0);
+    ~KeyFrameIndexer();
+    int stream() const { return m_stream;}
+    void stop();
+    bool isComplete() const;
+    qreal progress() const;
+    /*!
+     * \brief find
+     * find the last key frame whose pts <= ts
+     * \param ts timestamp in stream time base
+     * \return false if ts is not indexed yet or no key frame before ts
+     */
+    bool find(qint64 ts, Entry *e) const;
+    QVector<Entry> entries() const;
+    /// set a completed index, e.g. from cache. progress will be 1.0
+    void setEntries(const QVector<Entry>& entries);
+    /// save the index to StreamInfoCache when finished
+    void setCacheKey(const QString& key) { m_cache_key = key;}
+    /// (pts, dts, pos) array for StreamInfoCache
+    static QVector<qint64> toArray(const QVector<Entry>& entries);
+    static QVector<Entry> fromArray(const QVector<qint64>& array);
+Q_SIGNALS:
+    void progressChanged(qreal value);
+    void indexFinished();
+protected:
+    void run() Q_DECL_OVERRIDE;
+private:
+    static int interruptCb(void *opaque);
+
+    QString m_url;
+    QString m_cache_key;
+    bool m_mediaio;
+    AVInputFormat *m_format;
+    int m_stream;
+    volatile bool m_stop;
+    mutable QMutex m_mutex;
+    QVector<Entry> m_entries; // ordered by pts
+    qint64 m_last_pts; // pts of the last scanned packet
+    bool m_finished;
+    qreal m_progress;
+};
+} //namespace QtAV
+#endif // QTAV_KEYFRAMEINDEXER_H
@@ -0,0 +1,258 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/MetricsExporter.h"
+#include "QtAV/AVPlayer.h"
+#include "QtAV/Statistics.h"
+#include "QtAV/VideoFrame.h"
+#if QTAV_HAVE(NETWORK)
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#endif
+#include "utils/Logger.h"
+
+namespace QtAV {
+namespace {
+struct PlayerMetrics {
+    QByteArray label; // player="..."
+    Statistics::Snapshot s;
+    QByteArray decoder, codec, url;
+    int surface_starvation;
+    int underruns;
+    bool playing;
+};
+
+QByteArray escapeLabel(const QString& value)
+{
+    QByteArray v(value.toUtf8());
+    v.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return v;
+}
+
+class Writer
+{
+public:
+    explicit Writer(const QList<PlayerMetrics>& m) : metrics(m) {}
+    void family(const char* name, const char* type, const char* help) {
+        text.append("# TYPE ").append(name).append(' ').append(type).append('\n');
+        text.append("# HELP ").append(name).append(' ').append(help).append('\n');
+    }
+    // sample of a player. labels: extra labels, e.g. stream="video"
+    void sample(const char* name, const char* suffix, const PlayerMetrics& m, const QByteArray& value, const QByteArray& labels = QByteArray()) {
+        text.append(name).append(suffix).append('{').append(m.label);
+        if (!labels.isEmpty())
+            text.append(',').append(labels);
+        text.append("} ").append(value).append('\n');
+    }
+    void counter(const char* name, const char* help, qint64 Statistics::Snapshot::*field) {
+        family(name, "counter", help);
+        foreach (const PlayerMetrics& m, metrics)
+            sample(name, "_total", m, QByteArray::number(m.s.*field));
+    }
+    void gauge(const char* name, const char* help, qreal Statistics::Snapshot::*field) {
+        family(name, "gauge", help);
+        foreach (const PlayerMetrics& m, metrics)
+            sample(name, "", m, QByteArray::number(m.s.*field, 'f', 1));
+    }
+
+    const QList<PlayerMetrics>& metrics;
+    QByteArray text;
+};
+} //namespace
+
+QByteArray MetricsExporter::openMetrics()
+{
+    return openMetrics(AVPlayer::players());
+}
+
+QByteArray MetricsExporter::openMetrics(const QList<AVPlayer*>& players)
+{
+    QList<PlayerMetrics> metrics;
+    for (int i = 0; i < players.size(); ++i) {
+        AVPlayer *player = players.at(i);
+        const Statistics &st = player->statistics();
+        PlayerMetrics m;
+        const QString name(player->objectName().isEmpty() ? QString::number(i) : player->objectName());
+        m.label = QByteArray("player=\"").append(escapeLabel(name)).append('"');
+        m.s = st.snapshot();
+        m.decoder = escapeLabel(st.video.decoder);
+        m.codec = escapeLabel(st.video.codec);
+        m.url = escapeLabel(st.url);
+        m.surface_starvation = st.video_only.surface_starvation;
+        m.underruns = st.audio_only.underruns;
+        m.playing = player->isPlaying() && !player->isPaused();
+        metrics.append(m);
+    }
+    Writer w(metrics);
+    w.counter("qtav_video_frames_decoded", "Video frames decoded.", &Statistics::Snapshot::decoded_frames);
+    w.counter("qtav_video_frames_dropped", "Decoded video frames not rendered because they are late.", &Statistics::Snapshot::dropped_frames);
+    w.counter("qtav_video_frames_rendered", "Video frames delivered to renderers.", &Statistics::Snapshot::rendered_frames);
+    w.counter("qtav_video_frames_late", "Rendered video frames later than the clock by more than 40ms.", &Statistics::Snapshot::late_frames);
+    w.family("qtav_video_frames_by_type", "counter", "Decoded video frames by picture type.");
+    foreach (const PlayerMetrics& m, metrics) {
+        w.sample("qtav_video_frames_by_type", "_total", m, QByteArray::number(m.s.i_frames), "type=\"I\"");
+        w.sample("qtav_video_frames_by_type", "_total", m, QByteArray::number(m.s.p_frames), "type=\"P\"");
+        w.sample("qtav_video_frames_by_type", "_total", m, QByteArray::number(m.s.b_frames), "type=\"B\"");
+    }
+    w.gauge("qtav_video_decode_fps", "Video frames decoded per second.", &Statistics::Snapshot::decode_fps);
+    w.gauge("qtav_video_render_fps", "Video frames rendered per second.", &Statistics::Snapshot::render_fps);
+    w.family("qtav_input_bit_rate", "gauge", "Bits per second of demuxed packets.");
+    foreach (const PlayerMetrics& m, metrics) {
+        w.sample("qtav_input_bit_rate", "", m, QByteArray::number(m.s.video_input_bit_rate), "stream=\"video\"");
+        w.sample("qtav_input_bit_rate", "", m, QByteArray::number(m.s.audio_input_bit_rate), "stream=\"audio\"");
+    }
+    w.family("qtav_packet_queue_packets", "gauge", "Packets in the decoding queue.");
+    foreach (const PlayerMetrics& m, metrics) {
+        w.sample("qtav_packet_queue_packets", "", m, QByteArray::number(m.s.video_queue), "stream=\"video\"");
+        w.sample("qtav_packet_queue_packets", "", m, QByteArray::number(m.s.audio_queue), "stream=\"audio\"");
+    }
+    w.family("qtav_video_gop_length", "gauge", "Video packets of the last group of pictures.");
+    foreach (const PlayerMetrics& m, metrics)
+        w.sample("qtav_video_gop_length", "", m, QByteArray::number(m.s.gop_length));
+    w.family("qtav_memory_bytes", "gauge", "Bytes held by the player.");
+    foreach (const PlayerMetrics& m, metrics) {
+        w.sample("qtav_memory_bytes", "", m, QByteArray::number(m.s.packet_memory), "kind=\"packets\"");
+        w.sample("qtav_memory_bytes", "", m, QByteArray::number(m.s.frame_memory), "kind=\"frames\"");
+        w.sample("qtav_memory_bytes", "", m, QByteArray::number(m.s.texture_memory), "kind=\"textures\"");
+        w.sample("qtav_memory_bytes", "", m, QByteArray::number(m.s.surface_memory), "kind=\"surfaces\"");
+    }
+    w.family("qtav_video_surface_starvation", "counter", "Times the hardware decoder found no free surface.");
+    foreach (const PlayerMetrics& m, metrics)
+        w.sample("qtav_video_surface_starvation", "_total", m, QByteArray::number(m.surface_starvation));
+    w.family("qtav_audio_underruns", "counter", "Times the audio device ran out of data.");
+    foreach (const PlayerMetrics& m, metrics)
+        w.sample("qtav_audio_underruns", "_total", m, QByteArray::number(m.underruns));
+    w.family("qtav_playing", "gauge", "1 if playing and not paused.");
+    foreach (const PlayerMetrics& m, metrics)
+        w.sample("qtav_playing", "", m, m.playing ? "1" : "0");
+    w.family("qtav_media", "info", "Current media and video decoder.");
+    foreach (const PlayerMetrics& m, metrics) {
+        w.sample("qtav_media", "_info", m, "1", QByteArray("url=\"").append(m.url)
+                 .append("\",codec=\"").append(m.codec)
+                 .append("\",decoder=\"").append(m.decoder).append('"'));
+    }
+    qint64 pool_idle = 0, pool_used = 0;
+    VideoFrame::bufferPoolStatistics(0, 0, &pool_idle, &pool_used);
+    w.family("qtav_frame_pool_bytes", "gauge", "Bytes of frame buffers from the pool shared by all players.");
+    w.text.append("qtav_frame_pool_bytes{state=\"idle\"} ").append(QByteArray::number(pool_idle)).append('\n');
+    w.text.append("qtav_frame_pool_bytes{state=\"used\"} ").append(QByteArray::number(pool_used)).append('\n');
+    w.text.append("# EOF\n");
+    return w.text;
+}
+
+class MetricsExporter::Private
+{
+public:
+#if QTAV_HAVE(NETWORK)
+    QTcpServer server;
+#endif
+};
+
+MetricsExporter::MetricsExporter(QObject *parent)
+    : QObject(parent)
+    , d(new Private())
+{
+#if QTAV_HAVE(NETWORK)
+    connect(&d->server, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+#endif
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    close();
+    delete d;
+}
+
+bool MetricsExporter::listen(quint16 port)
+{
+#if QTAV_HAVE(NETWORK)
+    close();
+    if (!d->server.listen(QHostAddress::Any, port)) {
+        qWarning("MetricsExporter failed to listen on port %u: %s", port, qPrintable(d->server.errorString()));
+        return false;
+    }
+    qDebug("MetricsExporter is listening on port %u", port);
+    return true;
+#else
+    Q_UNUSED(port);
+    qWarning("MetricsExporter: QtAV is built without QtNetwork");
+    return false;
+#endif
+}
+
+void MetricsExporter::close()
+{
+#if QTAV_HAVE(NETWORK)
+    d->server.close();
+#endif
+}
+
+bool MetricsExporter::isListening() const
+{
+#if QTAV_HAVE(NETWORK)
+    return d->server.isListening();
+#else
+    return false;
+#endif
+}
+
+void MetricsExporter::onNewConnection()
+{
+#if QTAV_HAVE(NETWORK)
+    while (d->server.hasPendingConnections()) {
+        QTcpSocket *s = d->server.nextPendingConnection();
+        connect(s, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+        connect(s, SIGNAL(disconnected()), s, SLOT(deleteLater()));
+    }
+#endif
+}
+
+void MetricsExporter::onReadyRead()
+{
+#if QTAV_HAVE(NETWORK)
+    QTcpSocket *s = qobject_cast<QTcpSocket*>(sender());
+    if (!s || !s->canReadLine())
+        return;
+    // only the request line matters. headers are ignored
+    const QList<QByteArray> request(s->readLine().trimmed().split(' '));
+    s->readAll();
+    disconnect(s, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    const QByteArray path(request.size() > 1 ? request.at(1) : QByteArray());
+    QByteArray status("200 OK"), body;
+    QByteArray type("application/openmetrics-text; version=1.0.0; charset=utf-8");
+    if (request.at(0) != "GET") {
+        status = "405 Method Not Allowed";
+        type = "text/plain";
+    } else if (path == "/" || path == "/metrics" || path.startsWith("/metrics?")) {
+        body = openMetrics();
+    } else {
+        status = "404 Not Found";
+        type = "text/plain";
+    }
+    QByteArray response("HTTP/1.1 ");
+    response.append(status).append("\r\nContent-Type: ").append(type)
+            .append("\r\nContent-Length: ").append(QByteArray::number(body.size()))
+            .append("\r\nConnection: close\r\n\r\n").append(body);
+    s->write(response);
+    s->disconnectFromHost();
+#endif
+}
+} //namespace QtAV
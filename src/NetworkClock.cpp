@@ -0,0 +1,334 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/NetworkClock.h"
+#include <QtCore/QDataStream>
+#include <QtCore/QList>
+#include <QtCore/QTimerEvent>
+#include <QtNetwork/QHostInfo>
+#include <QtNetwork/QUdpSocket>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+// request: magic, version, type, seq, t1. reply: request fields, t2, t3, flags, speed, value
+static const quint32 kMagic = 0x51415643; // QAVC
+static const quint8 kVersion = 1;
+enum {
+    kRequest,
+    kReply
+};
+enum {
+    kActive = 1,
+    kPaused = 1 << 1
+};
+
+static inline qint64 monotonicNs(const QElapsedTimer& t)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(4, 8, 0)
+    return t.nsecsElapsed();
+#else
+    return qint64(t.elapsed())*1000000LL;
+#endif
+}
+
+class NetworkClockServer::Private
+{
+public:
+    Private() : clock(0) {
+        mono.start();
+    }
+    AVClock *clock;
+    QUdpSocket socket;
+    QElapsedTimer mono;
+};
+
+NetworkClockServer::NetworkClockServer(QObject *parent)
+    : QObject(parent)
+    , d(new Private())
+{
+    connect(&d->socket, SIGNAL(readyRead()), SLOT(processPendingDatagrams()));
+}
+
+NetworkClockServer::~NetworkClockServer()
+{
+    close();
+    delete d;
+}
+
+void NetworkClockServer::setClock(AVClock *clock)
+{
+    d->clock = clock;
+}
+
+AVClock* NetworkClockServer::clock() const
+{
+    return d->clock;
+}
+
+bool NetworkClockServer::listen(quint16 port)
+{
+    close();
+    if (!d->socket.bind(QHostAddress::Any, port)) {
+        qWarning("NetworkClockServer failed to bind port %u: %s", port, qPrintable(d->socket.errorString()));
+        return false;
+    }
+    qDebug("NetworkClockServer is listening on port %u", port);
+    return true;
+}
+
+void NetworkClockServer::close()
+{
+    d->socket.close();
+}
+
+bool NetworkClockServer::isListening() const
+{
+    return d->socket.state() == QAbstractSocket::BoundState;
+}
+
+void NetworkClockServer::processPendingDatagrams()
+{
+    while (d->socket.hasPendingDatagrams()) {
+        QByteArray request(int(d->socket.pendingDatagramSize()), 0);
+        QHostAddress host;
+        quint16 port = 0;
+        d->socket.readDatagram(request.data(), request.size(), &host, &port);
+        // receive time. processing time of the server is not a part of network delay
+        const qint64 t2 = monotonicNs(d->mono);
+        QDataStream in(request);
+        in.setVersion(QDataStream::Qt_4_6);
+        quint32 magic = 0;
+        quint8 version = 0, type = 0;
+        quint32 seq = 0;
+        qint64 t1 = 0;
+        in >> magic >> version >> type >> seq >> t1;
+        if (in.status() != QDataStream::Ok || magic != kMagic || version != kVersion || type != kRequest)
+            continue;
+        if (!d->clock)
+            continue;
+        quint8 flags = 0;
+        if (d->clock->isActive())
+            flags |= kActive;
+        if (d->clock->isPaused())
+            flags |= kPaused;
+        const qint64 value = qint64(d->clock->value()*1e9);
+        QByteArray reply;
+        QDataStream out(&reply, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_4_6);
+        out << kMagic << kVersion << quint8(kReply) << seq << t1 << t2 << monotonicNs(d->mono) << flags << double(d->clock->speed()) << value;
+        d->socket.writeDatagram(reply, host, port);
+    }
+}
+
+class NetworkClockClient::Private
+{
+public:
+    Private()
+        : interval(200)
+        , timer_id(0)
+        , port(0)
+        , seq(0)
+        , nb_unanswered(0)
+        , offset(0)
+        , delay(0)
+        , synced(false)
+    {
+        mono.start();
+        clock.setClockAuto(false);
+        clock.setClockType(AVClock::ExternalClock);
+    }
+
+    AVClock clock;
+    int interval;
+    int timer_id;
+    QUdpSocket socket;
+    QHostAddress host;
+    quint16 port;
+    QElapsedTimer mono;
+    quint32 seq;
+    int nb_unanswered;
+    QList<qint64> delays; // recent network delays
+    double offset;
+    double delay;
+    bool synced;
+};
+
+// errors larger than this are corrected by a jump, smaller ones in kSlewTime by catch up speed
+static const qint64 kMaxSlewError = 40000000LL; // 40ms
+static const double kSlewTime = 1.0;
+static const double kMaxCatchUp = 0.05;
+static const int kDelayWindow = 16;
+
+NetworkClockClient::NetworkClockClient(QObject *parent)
+    : QObject(parent)
+    , d(new Private())
+{
+    connect(&d->socket, SIGNAL(readyRead()), SLOT(processPendingDatagrams()));
+}
+
+NetworkClockClient::~NetworkClockClient()
+{
+    disconnectFromServer();
+    delete d;
+}
+
+AVClock* NetworkClockClient::clock() const
+{
+    return &d->clock;
+}
+
+void NetworkClockClient::setInterval(int ms)
+{
+    if (ms <= 0 || d->interval == ms)
+        return;
+    d->interval = ms;
+    if (!d->timer_id)
+        return;
+    killTimer(d->timer_id);
+    d->timer_id = startTimer(d->interval);
+}
+
+int NetworkClockClient::interval() const
+{
+    return d->interval;
+}
+
+bool NetworkClockClient::connectToServer(const QString &host, quint16 port)
+{
+    disconnectFromServer();
+    QHostAddress addr(host);
+    if (addr.isNull()) {
+        const QList<QHostAddress> addrs(QHostInfo::fromName(host).addresses());
+        if (addrs.isEmpty()) {
+            qWarning("NetworkClockClient can not resolve host %s", qPrintable(host));
+            return false;
+        }
+        addr = addrs.first();
+    }
+    if (!d->socket.bind()) {
+        qWarning("NetworkClockClient failed to bind: %s", qPrintable(d->socket.errorString()));
+        return false;
+    }
+    d->host = addr;
+    d->port = port;
+    d->timer_id = startTimer(d->interval);
+    return true;
+}
+
+void NetworkClockClient::disconnectFromServer()
+{
+    if (d->timer_id)
+        killTimer(d->timer_id);
+    d->timer_id = 0;
+    d->socket.close();
+    d->delays.clear();
+    d->nb_unanswered = 0;
+    d->synced = false;
+}
+
+double NetworkClockClient::offset() const
+{
+    return d->offset;
+}
+
+double NetworkClockClient::delay() const
+{
+    return d->delay;
+}
+
+void NetworkClockClient::timerEvent(QTimerEvent *e)
+{
+    if (e->timerId() != d->timer_id) {
+        QObject::timerEvent(e);
+        return;
+    }
+    if (++d->nb_unanswered == 10)
+        Q_EMIT timeout();
+    QByteArray request;
+    QDataStream out(&request, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << kMagic << kVersion << quint8(kRequest) << ++d->seq << monotonicNs(d->mono);
+    d->socket.writeDatagram(request, d->host, d->port);
+}
+
+void NetworkClockClient::processPendingDatagrams()
+{
+    while (d->socket.hasPendingDatagrams()) {
+        QByteArray reply(int(d->socket.pendingDatagramSize()), 0);
+        d->socket.readDatagram(reply.data(), reply.size());
+        const qint64 t4 = monotonicNs(d->mono);
+        QDataStream in(reply);
+        in.setVersion(QDataStream::Qt_4_6);
+        quint32 magic = 0, seq = 0;
+        quint8 version = 0, type = 0, flags = 0;
+        qint64 t1 = 0, t2 = 0, t3 = 0, value = 0;
+        double speed = 1.0;
+        in >> magic >> version >> type >> seq >> t1 >> t2 >> t3 >> flags >> speed >> value;
+        if (in.status() != QDataStream::Ok || magic != kMagic || version != kVersion || type != kReply)
+            continue;
+        d->nb_unanswered = 0;
+        const qint64 delay = qMax<qint64>(0, (t4 - t1) - (t3 - t2));
+        d->delays.append(delay);
+        if (d->delays.size() > kDelayWindow)
+            d->delays.removeFirst();
+        qint64 min_delay = delay;
+        foreach (qint64 v, d->delays) {
+            min_delay = qMin(min_delay, v);
+        }
+        // delayed by queueing somewhere, so the path is not symmetric. 2ms for the jitter of event loops
+        if (d->synced && delay > 2*min_delay + 2000000LL)
+            continue;
+        const bool running = (flags & kActive) && !(flags & kPaused);
+        AVClock &clock = d->clock;
+        // the server value was taken half a delay ago
+        const qint64 target = value + (running ? qint64(double(delay/2)*speed) : 0);
+        const qint64 err = target - qint64(clock.value()*1e9);
+        if (clock.speed() != speed)
+            clock.setSpeed(speed);
+        if (!running) {
+            if (!clock.isActive() && !clock.isPaused())
+                clock.start();
+            clock.pause(true);
+            clock.setCatchUpSpeed(0);
+            clock.setExternalValue(double(target)*1e-9);
+        } else {
+            if (!clock.isActive()) {
+                if (clock.isPaused())
+                    clock.pause(false);
+                else
+                    clock.start();
+            }
+            if (!d->synced || qAbs(err) > kMaxSlewError) {
+                clock.setCatchUpSpeed(0);
+                clock.setExternalValue(double(target)*1e-9);
+            } else {
+                clock.setCatchUpSpeed(qBound(-kMaxCatchUp, double(err)*1e-9/kSlewTime, kMaxCatchUp));
+            }
+        }
+        d->synced = true;
+        d->offset = double(err)*1e-9;
+        d->delay = double(delay)*1e-9;
+        Q_EMIT synchronized(d->offset, d->delay);
+    }
+}
+
+} //namespace QtAV
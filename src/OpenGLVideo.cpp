@@ -27,7 +27,25 @@
 #if QT_VAO
 #include <QtGui/QOpenGLVertexArrayObject>
 #endif //QT_VAO
+// QOffscreenSurface: 5.1
+#define QT_ASYNC_UPLOAD (QT_VERSION >= QT_VERSION_CHECK(5, 1, 0))
+#if QT_ASYNC_UPLOAD
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+#include <QtGui/QOffscreenSurface>
+#endif //QT_ASYNC_UPLOAD
+#define QT_GLSL_FILTER 1
+#include <QtGui/QOpenGLFramebufferObject>
+#include <QtGui/QOpenGLFunctions>
+#include <QtGui/QVector2D>
 #endif //5.0
+#include <QtCore/QPointer>
+#include "QtAV/GLSLFilter.h"
+#include "QtAV/Subtitle.h"
 #include "QtAV/SurfaceInterop.h"
 #include "QtAV/VideoShader.h"
 #include "ShaderManager.h"
@@ -36,6 +54,554 @@
 
 namespace QtAV {
 
+#if QT_ASYNC_UPLOAD
+/*!
+ * Uploads frames in its own thread with a context shared with the rendering context. Each frame is uploaded to a
+ * material(textures) in a ring which is neither displayed nor ready to display, then a fence is inserted.
+ * The rendering thread takes the latest ready material and waits its fence on gpu.
+ */
+class TextureUploader : public QThread
+{
+public:
+    enum { kRingSize = 3 };
+    TextureUploader(OpenGLVideo *video)
+        : glv(video)
+        , ctx(0)
+        , surface(0)
+        , stop(false)
+        , has_pending(false)
+        , ready(-1)
+        , displaying(-1)
+    {
+        for (int i = 0; i < kRingSize; ++i) {
+            materials[i] = new VideoMaterial();
+            fences[i] = 0;
+        }
+    }
+    ~TextureUploader() {
+        shutdown();
+        for (int i = 0; i < kRingSize; ++i)
+            delete materials[i]; // 0 if deleted in run()
+        delete ctx;
+        delete surface;
+    }
+    // call in gui thread with share current
+    bool startUpload(QOpenGLContext *share) {
+        if (QThread::currentThread() != qApp->thread()) {
+            qWarning("TextureUploader: the context must be set in gui thread");
+            return false;
+        }
+        if (!OpenGLHelper::isFenceSyncSupported()) {
+            qWarning("TextureUploader: fence sync is not supported");
+            return false;
+        }
+        surface = new QOffscreenSurface();
+        surface->setFormat(share->format());
+        surface->create();
+        ctx = new QOpenGLContext();
+        ctx->setFormat(share->format());
+        ctx->setShareContext(share);
+        if (!ctx->create()) {
+            qWarning("TextureUploader: failed to create shared context");
+            return false;
+        }
+        ctx->moveToThread(this);
+        start();
+        return true;
+    }
+    void shutdown() {
+        if (!isRunning())
+            return;
+        mutex.lock();
+        stop = true;
+        cond.wakeAll();
+        mutex.unlock();
+        wait();
+    }
+    void upload(const VideoFrame& frame) {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        pending = frame; // drop the old one if not uploaded yet
+        has_pending = true;
+        cond.wakeAll();
+    }
+    /*!
+     * call in rendering thread. return the material of the latest uploaded frame, 0 if no frame is uploaded
+     */
+    VideoMaterial* acquire() {
+        void *fence = 0;
+        {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            if (ready >= 0) {
+                displaying = ready;
+                ready = -1;
+                fence = fences[displaying];
+            }
+            if (displaying < 0)
+                return 0;
+        }
+        // the uploader never touches the displaying slot
+        OpenGLHelper::waitSync(fence);
+        return materials[displaying];
+    }
+
+    VideoMaterial *materials[kRingSize];
+protected:
+    void run() Q_DECL_OVERRIDE {
+        if (!ctx->makeCurrent(surface)) {
+            qWarning("TextureUploader: failed to make context current");
+            // nothing is uploaded, no texture to delete. do not let the destructor delete them without a context
+            for (int i = 0; i < kRingSize; ++i) {
+                delete materials[i];
+                materials[i] = 0;
+            }
+            return;
+        }
+        while (true) {
+            VideoFrame frame;
+            int slot = 0;
+            {
+                QMutexLocker lock(&mutex);
+                Q_UNUSED(lock);
+                while (!stop && !has_pending)
+                    cond.wait(&mutex);
+                if (stop)
+                    break;
+                frame = pending;
+                pending = VideoFrame();
+                has_pending = false;
+                while (slot == ready || slot == displaying)
+                    ++slot;
+            }
+            VideoMaterial *m = materials[slot];
+            m->setCurrentFrame(frame);
+            if (m->bind()) // upload
+                m->unbind();
+            void *fence = OpenGLHelper::fenceSync();
+            DYGL(glFlush()); // the fence must reach gpu before other contexts wait it
+            {
+                QMutexLocker lock(&mutex);
+                Q_UNUSED(lock);
+                OpenGLHelper::deleteSync(fences[slot]);
+                fences[slot] = fence;
+                ready = slot;
+            }
+            Q_EMIT glv->frameUploaded();
+        }
+        // textures are deleted in a context of the share group
+        for (int i = 0; i < kRingSize; ++i) {
+            delete materials[i];
+            materials[i] = 0;
+            OpenGLHelper::deleteSync(fences[i]);
+            fences[i] = 0;
+        }
+        ctx->doneCurrent();
+    }
+private:
+    OpenGLVideo *glv;
+    QOpenGLContext *ctx;
+    QOffscreenSurface *surface;
+    QMutex mutex;
+    QWaitCondition cond;
+    bool stop;
+    bool has_pending;
+    VideoFrame pending;
+    void* fences[kRingSize];
+    int ready; // slot uploaded and not rendered yet
+    int displaying; // slot used by rendering thread
+};
+#endif //QT_ASYNC_UPLOAD
+
+#if QT_GLSL_FILTER
+static const char kFilterVertexShader[] =
+        "attribute vec4 a_Position;\n"
+        "attribute vec2 a_TexCoords;\n"
+        "uniform mat4 u_MVP_matrix;\n"
+        "varying vec2 v_TexCoords;\n"
+        "void main() {\n"
+        "  gl_Position = u_MVP_matrix * a_Position;\n"
+        "  v_TexCoords = a_TexCoords;\n"
+        "}\n";
+// declarations documented in GLSLFilter
+static const char kFilterFragmentHeader[] =
+        "#ifdef GL_ES\n"
+        "precision mediump int;\n"
+        "precision mediump float;\n"
+        "#else\n"
+        "#define highp\n"
+        "#define mediump\n"
+        "#define lowp\n"
+        "#endif\n"
+        "uniform sampler2D u_Texture;\n"
+        "uniform vec2 u_TextureSize;\n"
+        "uniform vec2 u_PixelSize;\n"
+        "varying vec2 v_TexCoords;\n";
+// draws the last pass to the target
+static const char kBlitFragmentShader[] =
+        "void main() {\n"
+        "  gl_FragColor = texture2D(u_Texture, v_TexCoords);\n"
+        "}\n";
+
+/*!
+ * Renders the frame to an rgb framebuffer object, then runs GLSLFilter passes between framebuffer objects taken from a
+ * small pool and draws the last one. All gl resources belong to the rendering context.
+ */
+class FilterPipeline
+{
+public:
+    enum { kMaxFBOs = 4 };
+    FilterPipeline() : blit(0) {}
+    ~FilterPipeline() { reset(); }
+    // the context may be not current while it's destroyed, the same as ShaderManager
+    void reset() {
+        qDeleteAll(fbos);
+        fbos.clear();
+        foreach (const Program& p, programs)
+            delete p.program;
+        programs.clear();
+        delete blit;
+        blit = 0;
+    }
+    void removeUnused(const QList<GLSLFilter*>& filters) {
+        QHash<GLSLFilter*, Program>::iterator it = programs.begin();
+        while (it != programs.end()) {
+            if (filters.contains(it.key())) {
+                ++it;
+                continue;
+            }
+            delete it.value().program;
+            it = programs.erase(it);
+        }
+    }
+    // 0 if failed to compile
+    QOpenGLShaderProgram* program(GLSLFilter* f) {
+        const QByteArray code(f->fragmentShader());
+        QHash<GLSLFilter*, Program>::iterator it = programs.find(f);
+        if (it != programs.end()) {
+            if (it.value().source == code)
+                return it.value().program;
+            delete it.value().program;
+            programs.erase(it);
+        }
+        Program p;
+        p.source = code;
+        p.program = createProgram(code);
+        programs.insert(f, p);
+        return p.program;
+    }
+    QOpenGLShaderProgram* blitProgram() {
+        if (!blit)
+            blit = createProgram(kBlitFragmentShader);
+        return blit;
+    }
+    // a framebuffer object of the given size except the one being sampled
+    QOpenGLFramebufferObject* fbo(const QSize& size, QOpenGLFramebufferObject* exclude) {
+        foreach (QOpenGLFramebufferObject* f, fbos) {
+            if (f != exclude && f->size() == size)
+                return f;
+        }
+        if (fbos.size() >= kMaxFBOs) {
+            for (int i = 0; i < fbos.size(); ++i) {
+                if (fbos.at(i) == exclude)
+                    continue;
+                delete fbos.takeAt(i);
+                break;
+            }
+        }
+        QOpenGLFramebufferObject *f = new QOpenGLFramebufferObject(size);
+        if (!f->isValid()) {
+            qWarning("GLSLFilter: invalid fbo %dx%d", size.width(), size.height());
+            delete f;
+            return 0;
+        }
+        fbos.append(f);
+        return f;
+    }
+    void draw(QOpenGLShaderProgram* p, QOpenGLFramebufferObject* src, const TexturedGeometry& geo, const QMatrix4x4& mvp) {
+        p->bind();
+        DYGL(glActiveTexture(GL_TEXTURE0));
+        DYGL(glBindTexture(GL_TEXTURE_2D, src->texture()));
+        const QSize s(src->size());
+        p->setUniformValue("u_Texture", 0);
+        p->setUniformValue("u_TextureSize", QVector2D(s.width(), s.height()));
+        p->setUniformValue("u_PixelSize", QVector2D(1.0/qreal(s.width()), 1.0/qreal(s.height())));
+        p->setUniformValue("u_MVP_matrix", mvp);
+        p->setAttributeArray(0, GL_FLOAT, geo.data(0), geo.tupleSize(), geo.stride());
+        p->setAttributeArray(1, GL_FLOAT, geo.data(1), geo.tupleSize(), geo.stride());
+        p->enableAttributeArray(0);
+        p->enableAttributeArray(1);
+        DYGL(glDrawArrays(geo.mode(), 0, geo.textureVertexCount()));
+        p->disableAttributeArray(0);
+        p->disableAttributeArray(1);
+    }
+
+private:
+    QOpenGLShaderProgram* createProgram(const QByteArray& code) {
+        QOpenGLShaderProgram *p = new QOpenGLShaderProgram();
+        if (!p->addShaderFromSourceCode(QOpenGLShader::Vertex, kFilterVertexShader)
+                || !p->addShaderFromSourceCode(QOpenGLShader::Fragment, QByteArray(kFilterFragmentHeader).append(code))) {
+            qWarning("GLSLFilter: failed to compile shader: %s", p->log().toUtf8().constData());
+            delete p;
+            return 0;
+        }
+        p->bindAttributeLocation("a_Position", 0);
+        p->bindAttributeLocation("a_TexCoords", 1);
+        if (!p->link()) {
+            qWarning("GLSLFilter: failed to link shader: %s", p->log().toUtf8().constData());
+            delete p;
+            return 0;
+        }
+        return p;
+    }
+
+    struct Program {
+        QByteArray source;
+        QOpenGLShaderProgram *program;
+    };
+    QHash<GLSLFilter*, Program> programs;
+    QOpenGLShaderProgram *blit;
+    QList<QOpenGLFramebufferObject*> fbos;
+};
+#endif //QT_GLSL_FILTER
+
+static const char kSubImagesVertexShader[] =
+        "attribute vec4 a_Position;\n"
+        "attribute vec2 a_TexCoords;\n"
+        "attribute vec4 a_Color;\n"
+        "uniform mat4 u_MVP_matrix;\n"
+        "varying vec2 v_TexCoords;\n"
+        "varying vec4 v_Color;\n"
+        "void main() {\n"
+        "  gl_Position = u_MVP_matrix * a_Position;\n"
+        "  v_TexCoords = a_TexCoords;\n"
+        "  v_Color = a_Color;\n"
+        "}\n";
+static const char kSubImagesFragmentShader[] =
+        "#ifdef GL_ES\n"
+        "precision mediump float;\n"
+        "#endif\n"
+        "uniform sampler2D u_Texture;\n"
+        "varying vec2 v_TexCoords;\n"
+        "varying vec4 v_Color;\n"
+        "void main() {\n"
+        "  gl_FragColor = vec4(v_Color.rgb, v_Color.a*texture2D(u_Texture, v_TexCoords).r);\n"
+        "}\n";
+
+/*!
+ * Composites a SubImageSet in 1 draw call. Alpha masks are packed in rows(shelves) of a luminance texture atlas and kept
+ * until the atlas is full, so a mask is uploaded only once while it's on screen. Vertices are rebuilt only if the set changes.
+ */
+class SubImagesRenderer
+{
+public:
+    enum { kAtlasSize = 1024, kMaxAtlasSize = 4096 };
+    SubImagesRenderer() : program(0), program_failed(false), texture(0), atlas_size(kAtlasSize), shelf_x(0), shelf_y(0), shelf_h(0) {}
+    ~SubImagesRenderer() { reset(); }
+    // the context may be not current while it's destroyed, the same as ShaderManager
+    void reset() {
+        delete program;
+        program = 0;
+        program_failed = false;
+        if (texture && QOpenGLContext::currentContext())
+            DYGL(glDeleteTextures(1, &texture));
+        texture = 0;
+        atlas_size = kAtlasSize;
+        clearAtlas();
+    }
+    // false if failed to create gl resources
+    bool render(const SubImageSet& subs, const QRectF& target, const QMatrix4x4& mvp) {
+        if (subs.isEmpty())
+            return true;
+        if (!program && !createProgram())
+            return false;
+        if (subs.id != current.id || subs.images.constData() != current.images.constData() || target != current_target) {
+            if (!build(subs, target))
+                return false;
+        }
+        if (vertices.isEmpty())
+            return true;
+        program->bind();
+        DYGL(glActiveTexture(GL_TEXTURE0));
+        DYGL(glBindTexture(GL_TEXTURE_2D, texture));
+        program->setUniformValue("u_Texture", 0);
+        program->setUniformValue("u_MVP_matrix", mvp);
+        const int stride = kTupleSize*sizeof(GLfloat);
+        program->setAttributeArray(0, GL_FLOAT, vertices.constData(), 2, stride);
+        program->setAttributeArray(1, GL_FLOAT, vertices.constData() + 2, 2, stride);
+        program->setAttributeArray(2, GL_FLOAT, vertices.constData() + 4, 4, stride);
+        for (int i = 0; i < 3; ++i)
+            program->enableAttributeArray(i);
+        DYGL(glEnable(GL_BLEND));
+        DYGL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+        DYGL(glDrawArrays(GL_TRIANGLES, 0, vertices.size()/kTupleSize));
+        DYGL(glDisable(GL_BLEND));
+        for (int i = 0; i < 3; ++i)
+            program->disableAttributeArray(i);
+        DYGL(glBindTexture(GL_TEXTURE_2D, 0));
+        program->release();
+        return true;
+    }
+
+private:
+    enum { kTupleSize = 8 }; // position, texture coordinates, color
+    struct Mask {
+        int w, h;
+        QByteArray data;
+        QRect rect; // in atlas
+    };
+    void clearAtlas() {
+        masks.clear();
+        shelf_x = shelf_y = shelf_h = 0;
+        current = SubImageSet();
+    }
+    bool createProgram() {
+        if (program_failed)
+            return false;
+        program = new QOpenGLShaderProgram();
+        program->bindAttributeLocation("a_Position", 0);
+        program->bindAttributeLocation("a_TexCoords", 1);
+        program->bindAttributeLocation("a_Color", 2);
+        if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex, kSubImagesVertexShader)
+                || !program->addShaderFromSourceCode(QOpenGLShader::Fragment, kSubImagesFragmentShader)
+                || !program->link()) {
+            qWarning("OpenGLVideo: failed to build subtitle shader: %s", program->log().toUtf8().constData());
+            delete program;
+            program = 0;
+            program_failed = true; // do not try every frame
+            return false;
+        }
+        return true;
+    }
+    bool createTexture() {
+        if (texture)
+            return true;
+        GLint max_size = 0;
+        DYGL(glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size));
+        max_atlas_size = qMax<int>(kAtlasSize, qMin<int>(kMaxAtlasSize, max_size));
+        atlas_size = qMin(atlas_size, max_atlas_size);
+        DYGL(glGenTextures(1, &texture));
+        if (!texture)
+            return false;
+        DYGL(glBindTexture(GL_TEXTURE_2D, texture));
+        // masks are mapped 1:1 on the frame, and no gap between them is needed
+        DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        DYGL(glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, atlas_size, atlas_size, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, NULL));
+        return true;
+    }
+    // rect of the mask in atlas, uploaded if not found. null if atlas is full. texture is bound and unpack alignment is 1
+    QRect place(const SubImage& s) {
+        const uint key = qHash(s.data);
+        for (QMultiHash<uint, Mask>::const_iterator it = masks.constFind(key); it != masks.constEnd() && it.key() == key; ++it) {
+            if (it->w == s.w && it->h == s.h && it->data == s.data)
+                return it->rect;
+        }
+        if (shelf_x + s.w > atlas_size) {
+            shelf_y += shelf_h;
+            shelf_x = shelf_h = 0;
+        }
+        if (s.w > atlas_size || shelf_y + s.h > atlas_size)
+            return QRect();
+        Mask m;
+        m.w = s.w;
+        m.h = s.h;
+        m.data = s.data;
+        m.rect = QRect(shelf_x, shelf_y, s.w, s.h);
+        shelf_x += s.w;
+        shelf_h = qMax(shelf_h, s.h);
+        QByteArray packed;
+        const char *data = s.data.constData();
+        if (s.stride != s.w) {
+            packed.resize(s.w*s.h);
+            for (int y = 0; y < s.h; ++y)
+                memcpy(packed.data() + y*s.w, data + y*s.stride, s.w);
+            data = packed.constData();
+        }
+        DYGL(glTexSubImage2D(GL_TEXTURE_2D, 0, m.rect.x(), m.rect.y(), s.w, s.h, GL_LUMINANCE, GL_UNSIGNED_BYTE, data));
+        masks.insert(key, m);
+        return m.rect;
+    }
+    bool build(const SubImageSet& subs, const QRectF& target) {
+        if (!createTexture())
+            return false;
+        DYGL(glBindTexture(GL_TEXTURE_2D, texture));
+        GLint unpack_align = 4;
+        DYGL(glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_align));
+        DYGL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+        QVector<QRect> rects(subs.images.size());
+        bool cleared = false;
+        for (int i = 0; i < subs.images.size();) {
+            const SubImage &s = subs.images.at(i);
+            if (s.w <= 0 || s.h <= 0 || s.stride < s.w || s.data.size() < s.stride*(s.h - 1) + s.w) {
+                rects[i++] = QRect();
+                continue;
+            }
+            rects[i] = place(s);
+            if (rects[i].isValid()) {
+                ++i;
+                continue;
+            }
+            // full. evict all masks, then try a larger atlas. a mask too large is not drawn
+            if (cleared) {
+                if (atlas_size >= max_atlas_size) {
+                    ++i;
+                    continue;
+                }
+                DYGL(glDeleteTextures(1, &texture));
+                texture = 0;
+                atlas_size *= 2;
+                if (!createTexture()) {
+                    DYGL(glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_align));
+                    return false;
+                }
+            }
+            cleared = true;
+            clearAtlas();
+            i = 0;
+        }
+        DYGL(glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_align));
+        DYGL(glBindTexture(GL_TEXTURE_2D, 0));
+        current = subs;
+        current_target = target;
+        vertices.resize(0);
+        vertices.reserve(subs.images.size()*6*kTupleSize);
+        const qreal sx = target.width()/qreal(subs.w);
+        const qreal sy = target.height()/qreal(subs.h);
+        const GLfloat ts = 1.0/GLfloat(atlas_size);
+        for (int i = 0; i < subs.images.size(); ++i) {
+            const QRect &r = rects.at(i);
+            if (!r.isValid())
+                continue;
+            const SubImage &s = subs.images.at(i);
+            const GLfloat x0 = target.x() + qreal(s.x)*sx, y0 = target.y() + qreal(s.y)*sy;
+            const GLfloat x1 = target.x() + qreal(s.x + s.w)*sx, y1 = target.y() + qreal(s.y + s.h)*sy;
+            const GLfloat u0 = GLfloat(r.x())*ts, v0 = GLfloat(r.y())*ts;
+            const GLfloat u1 = GLfloat(r.x() + r.width())*ts, v1 = GLfloat(r.y() + r.height())*ts;
+            const GLfloat c[] = { GLfloat(qRed(s.color))/255.0f, GLfloat(qGreen(s.color))/255.0f, GLfloat(qBlue(s.color))/255.0f, GLfloat(qAlpha(s.color))/255.0f };
+            const GLfloat quad[] = { x0, y0, u0, v0, x1, y0, u1, v0, x0, y1, u0, v1,
+                                     x0, y1, u0, v1, x1, y0, u1, v0, x1, y1, u1, v1 };
+            for (int v = 0; v < 6; ++v) {
+                vertices << quad[v*4] << quad[v*4+1] << quad[v*4+2] << quad[v*4+3];
+                vertices << c[0] << c[1] << c[2] << c[3];
+            }
+        }
+        return true;
+    }
+
+    QOpenGLShaderProgram *program;
+    bool program_failed;
+    GLuint texture;
+    int atlas_size, max_atlas_size;
+    int shelf_x, shelf_y, shelf_h;
+    QMultiHash<uint, Mask> masks;
+    SubImageSet current; // keep the images referenced to detect changes with id and address
+    QRectF current_target;
+    QVector<GLfloat> vertices;
+};
+
 // FIXME: why crash if inherits both QObject and DPtrPrivate?
 class OpenGLVideoPrivate : public DPtrPrivate<OpenGLVideo>
 {
@@ -49,6 +615,18 @@ public:
         , try_vao(true)
         , tex_target(0)
         , valiad_tex_width(1.0)
+        , async_upload(false)
+        , uploader(0)
+        , brightness(0)
+        , contrast(0)
+        , hue(0)
+        , saturation(0)
+        , deinterlace(NoDeinterlace)
+        , out_trc(ColorTransfer_SDR)
+        , out_peak(0)
+        , tone_mapping(ToneMappingBT2390)
+        , material_gen(0)
+        , upload_ns(0)
     {
         static bool disable_vbo = qgetenv("QTAV_NO_VBO").toInt() > 0;
         try_vbo = !disable_vbo;
@@ -56,14 +634,57 @@ public:
         try_vao = !disable_vao;
     }
     ~OpenGLVideoPrivate() {
+        stopUploader();
         if (material) {
             delete material;
             material = 0;
         }
     }
 
+    void stopUploader() {
+#if QT_ASYNC_UPLOAD
+        if (uploader) {
+            delete uploader;
+            uploader = 0;
+        }
+        uploader_gens.clear();
+#endif
+    }
+    void applySettings(VideoMaterial *m) {
+        m->setBrightness(brightness);
+        m->setContrast(contrast);
+        m->setHue(hue);
+        m->setSaturation(saturation);
+        m->setDeinterlaceMode(deinterlace);
+        m->setOutputColorTransfer(out_trc, out_peak);
+        m->setToneMapping(tone_mapping);
+        m->setColorLUT(lut);
+    }
+    void startUploader(OpenGLVideo *glv) {
+#if QT_ASYNC_UPLOAD
+        if (!async_upload || uploader || !ctx)
+            return;
+        uploader = new TextureUploader(glv);
+        // settings are applied to the uploader's materials when acquired in render(), see material_gen
+        if (!uploader->startUpload(ctx))
+            stopUploader();
+#else
+        Q_UNUSED(glv);
+#endif
+    }
+    // materials can be changed by setters. the uploader's materials are used in the upload thread and not included
+    QList<VideoMaterial*> materials() const {
+        QList<VideoMaterial*> ms;
+        ms.append(material);
+        return ms;
+    }
     void resetGL() {
+        stopUploader();
         ctx = 0;
+#if QT_GLSL_FILTER
+        pipeline.reset();
+#endif
+        sub_images.reset();
         vbo.destroy();
 #if QT_VAO
         vao.destroy();
@@ -76,10 +697,23 @@ public:
         if (material) {
             delete material;
             material = new VideoMaterial();
+            material->setDeinterlaceMode(deinterlace);
+            material->setOutputColorTransfer(out_trc, out_peak);
+            material->setToneMapping(tone_mapping);
+            material->setColorLUT(lut);
         }
     }
+    QList<GLSLFilter*> activeFilters() const {
+        QList<GLSLFilter*> fs;
+        foreach (const QPointer<GLSLFilter>& f, filters) {
+            if (f && f->isEnabled() && !f->fragmentShader().isEmpty())
+                fs.append(f);
+        }
+        return fs;
+    }
+    bool renderFilters(VideoShader* shader, VideoMaterial* material, const QRectF& roi, const QMatrix4x4& transform);
     // update geometry(vertex array) set attributes or bind VAO/VBO.
-    void bindAttributes(VideoShader* shader, const QRectF& t, const QRectF& r);
+    void bindAttributes(VideoShader* shader, VideoMaterial* material, const QRectF& t, const QRectF& r);
     void unbindAttributes(VideoShader* shader) {
 #if QT_VAO
         if (try_vao && vao.isCreated()) {
@@ -115,9 +749,125 @@ public:
     TexturedGeometry geometry;
     QRectF rect;
     QMatrix4x4 matrix;
+    bool async_upload;
+#if QT_ASYNC_UPLOAD
+    TextureUploader *uploader;
+#else
+    void *uploader;
+#endif
+    qreal brightness, contrast, hue, saturation;
+    DeinterlaceMode deinterlace;
+    ColorTransfer out_trc;
+    qreal out_peak;
+    ToneMapping tone_mapping;
+    ColorLUT lut;
+    int material_gen; // increased if a setting above is changed
+#if QT_ASYNC_UPLOAD
+    QHash<VideoMaterial*, int> uploader_gens; // material_gen applied to the uploader's materials. used in rendering thread
+#endif
+    qint64 upload_ns; // of the last render()
+    QList<QPointer<GLSLFilter> > filters;
+#if QT_GLSL_FILTER
+    FilterPipeline pipeline;
+#endif
+    SubImagesRenderer sub_images;
 };
 
-void OpenGLVideoPrivate::bindAttributes(VideoShader* shader, const QRectF &t, const QRectF &r)
+bool OpenGLVideoPrivate::renderFilters(VideoShader *shader, VideoMaterial *material, const QRectF &roi, const QMatrix4x4 &transform)
+{
+#if QT_GLSL_FILTER
+    const QList<GLSLFilter*> passes(activeFilters());
+    if (passes.isEmpty() || !QOpenGLFramebufferObject::hasOpenGLFramebufferObjects())
+        return false;
+    const QSize size(material->frameSize());
+    if (size.isEmpty())
+        return false;
+    QOpenGLFramebufferObject *src = pipeline.fbo(size, 0);
+    if (!src)
+        return false;
+    GLint vp[4];
+    DYGL(glGetIntegerv(GL_VIEWPORT, vp));
+    GLint target_fbo = 0; // may be not the default framebuffer, e.g. QOpenGLWidget or the renderer cache
+    DYGL(glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target_fbo));
+    QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+    // pass 0: the whole frame to rgb using the material's shader
+    src->bind();
+    DYGL(glViewport(0, 0, size.width(), size.height()));
+    DYGL(glClearColor(0, 0, 0, 0));
+    DYGL(glClear(GL_COLOR_BUFFER_BIT));
+    const QRectF rect0(rect);
+    const QMatrix4x4 matrix0(matrix);
+    rect = QRectF(QPointF(), size);
+    matrix.setToIdentity();
+    matrix.ortho(rect);
+    update_geo = true;
+    shader->program()->setUniformValue(shader->matrixLocation(), matrix);
+    bindAttributes(shader, material, QRectF(), QRectF());
+    DYGL(glDrawArrays(geometry.mode(), 0, geometry.textureVertexCount()));
+    unbindAttributes(shader);
+    material->unbind();
+    rect = rect0;
+    matrix = matrix0;
+    update_geo = true;
+    // filter passes in normalized device coordinates
+    TexturedGeometry geo;
+    geo.setRect(QRectF(-1, -1, 2, 2), QRectF(0, 0, 1, 1));
+    const QMatrix4x4 identity;
+    foreach (GLSLFilter *f, passes) {
+        QOpenGLShaderProgram *p = pipeline.program(f);
+        if (!p)
+            continue;
+        const QSize out_size(f->outputSize().isValid() ? f->outputSize() : src->size());
+        QOpenGLFramebufferObject *dst = pipeline.fbo(out_size, src);
+        if (!dst)
+            continue;
+        dst->bind();
+        DYGL(glViewport(0, 0, out_size.width(), out_size.height()));
+        p->bind();
+        f->setUniforms(p, src->size());
+        pipeline.draw(p, src, geo, identity);
+        src = dst;
+    }
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, target_fbo);
+    DYGL(glViewport(vp[0], vp[1], vp[2], vp[3]));
+    QOpenGLShaderProgram *p = pipeline.blitProgram();
+    if (!p)
+        return true;
+    // roi is in frame, the same rule as VideoMaterial::mapToTexture(). fbo rows are bottom up
+    QRectF r(0, 0, 1, 1);
+    if (roi.isValid()) {
+        qreal x = roi.x(), y = roi.y(), w = roi.width(), h = roi.height();
+        if (qAbs(x) > 1)
+            x /= qreal(size.width());
+        if (qAbs(y) > 1)
+            y /= qreal(size.height());
+        if (qAbs(w) > 1)
+            w /= qreal(size.width());
+        if (qAbs(h) > 1)
+            h /= qreal(size.height());
+        r = QRectF(x, y, w, h);
+    }
+    geo.setRect(rect, QRectF(r.x(), 1.0 - r.y(), r.width(), -r.height()));
+    const bool blending = material->hasAlpha();
+    if (blending) {
+        DYGL(glEnable(GL_BLEND));
+        DYGL(glBlendFunc(GL_SRC_ALPHA , GL_ONE_MINUS_SRC_ALPHA));
+    }
+    pipeline.draw(p, src, geo, transform*matrix);
+    if (blending)
+        DYGL(glDisable(GL_BLEND));
+    DYGL(glBindTexture(GL_TEXTURE_2D, 0));
+    return true;
+#else
+    Q_UNUSED(shader);
+    Q_UNUSED(material);
+    Q_UNUSED(roi);
+    Q_UNUSED(transform);
+    return false;
+#endif //QT_GLSL_FILTER
+}
+
+void OpenGLVideoPrivate::bindAttributes(VideoShader* shader, VideoMaterial *material, const QRectF &t, const QRectF &r)
 {
     const bool tex_rect = shader->textureTarget() == GL_TEXTURE_RECTANGLE;
     // also check size change for normalizedROI computation if roi is not normalized
@@ -254,6 +1004,7 @@ void OpenGLVideo::setOpenGLContext(QOpenGLContext *ctx)
 #endif
     d.ctx = ctx; // Qt4: set to null in resetGL()
     setProjectionMatrixToRect(QRectF(QPointF(), surfaceSize));
+    d.startUploader(this);
     if (d.manager)
         return;
     // TODO: what if ctx is delete?
@@ -269,9 +1020,72 @@ QOpenGLContext* OpenGLVideo::openGLContext()
     return d_func().ctx;
 }
 
+void OpenGLVideo::setAsyncUpload(bool value)
+{
+    d_func().async_upload = value;
+}
+
+bool OpenGLVideo::isAsyncUpload() const
+{
+    return !!d_func().uploader;
+}
+
+void OpenGLVideo::precompileShaders(const QList<VideoFormat::PixelFormat> &formats)
+{
+    DPTR_D(OpenGLVideo);
+    if (!d.manager) {
+        qWarning("OpenGLVideo::precompileShaders: call setOpenGLContext() first");
+        return;
+    }
+    QList<VideoFormat::PixelFormat> fmts(formats);
+    if (fmts.isEmpty()) {
+        fmts << VideoFormat::Format_YUV420P << VideoFormat::Format_NV12
+             << VideoFormat::Format_RGB32 << VideoFormat::Format_YUV420P10LE;
+    }
+    foreach (VideoFormat::PixelFormat pixfmt, fmts) {
+        if (!isSupported(pixfmt))
+            continue;
+        // material type only depends on the format and texture target. no texture is created
+        VideoMaterial material;
+        material.setCurrentFrame(VideoFrame(16, 16, VideoFormat(pixfmt)));
+        d.manager->prepareMaterial(&material);
+    }
+}
+
 void OpenGLVideo::setCurrentFrame(const VideoFrame &frame)
 {
-    d_func().material->setCurrentFrame(frame);
+    DPTR_D(OpenGLVideo);
+#if QT_ASYNC_UPLOAD
+    if (d.uploader) {
+        d.uploader->upload(frame);
+        return;
+    }
+#endif
+    d.material->setCurrentFrame(frame);
+}
+
+void OpenGLVideo::setFilters(const QList<GLSLFilter *> &filters)
+{
+    DPTR_D(OpenGLVideo);
+    d.filters.clear();
+    foreach (GLSLFilter *f, filters)
+        d.filters.append(f);
+#if QT_GLSL_FILTER
+    d.pipeline.removeUnused(filters);
+#else
+    if (!filters.isEmpty())
+        qWarning("OpenGLVideo: GLSLFilter requires Qt5");
+#endif
+}
+
+QList<GLSLFilter*> OpenGLVideo::filters() const
+{
+    QList<GLSLFilter*> fs;
+    foreach (const QPointer<GLSLFilter>& f, d_func().filters) {
+        if (f)
+            fs.append(f);
+    }
+    return fs;
 }
 
 void OpenGLVideo::setProjectionMatrixToRect(const QRectF &v)
@@ -292,22 +1106,102 @@ void OpenGLVideo::setProjectionMatrix(const QMatrix4x4 &matrix)
 
 void OpenGLVideo::setBrightness(qreal value)
 {
-    d_func().material->setBrightness(value);
+    DPTR_D(OpenGLVideo);
+    d.brightness = value;
+    ++d.material_gen;
+    foreach (VideoMaterial *m, d.materials())
+        m->setBrightness(value);
 }
 
 void OpenGLVideo::setContrast(qreal value)
 {
-    d_func().material->setContrast(value);
+    DPTR_D(OpenGLVideo);
+    d.contrast = value;
+    ++d.material_gen;
+    foreach (VideoMaterial *m, d.materials())
+        m->setContrast(value);
 }
 
 void OpenGLVideo::setHue(qreal value)
 {
-    d_func().material->setHue(value);
+    DPTR_D(OpenGLVideo);
+    d.hue = value;
+    ++d.material_gen;
+    foreach (VideoMaterial *m, d.materials())
+        m->setHue(value);
 }
 
 void OpenGLVideo::setSaturation(qreal value)
 {
-    d_func().material->setSaturation(value);
+    DPTR_D(OpenGLVideo);
+    d.saturation = value;
+    ++d.material_gen;
+    foreach (VideoMaterial *m, d.materials())
+        m->setSaturation(value);
+}
+
+void OpenGLVideo::setDeinterlaceMode(DeinterlaceMode value)
+{
+    DPTR_D(OpenGLVideo);
+    d.deinterlace = value;
+    ++d.material_gen;
+    foreach (VideoMaterial *m, d.materials())
+        m->setDeinterlaceMode(value);
+}
+
+DeinterlaceMode OpenGLVideo::deinterlaceMode() const
+{
+    return d_func().deinterlace;
+}
+
+void OpenGLVideo::setOutputColorTransfer(ColorTransfer value, qreal peakLuminance)
+{
+    DPTR_D(OpenGLVideo);
+    d.out_trc = value;
+    d.out_peak = peakLuminance;
+    ++d.material_gen;
+    foreach (VideoMaterial *m, d.materials())
+        m->setOutputColorTransfer(value, peakLuminance);
+}
+
+ColorTransfer OpenGLVideo::outputColorTransfer() const
+{
+    return d_func().out_trc;
+}
+
+void OpenGLVideo::setToneMapping(ToneMapping value)
+{
+    DPTR_D(OpenGLVideo);
+    d.tone_mapping = value;
+    ++d.material_gen;
+    foreach (VideoMaterial *m, d.materials())
+        m->setToneMapping(value);
+}
+
+ToneMapping OpenGLVideo::toneMapping() const
+{
+    return d_func().tone_mapping;
+}
+
+void OpenGLVideo::setColorLUT(const ColorLUT &lut)
+{
+    DPTR_D(OpenGLVideo);
+    d.lut = lut;
+    ++d.material_gen;
+    foreach (VideoMaterial *m, d.materials())
+        m->setColorLUT(lut);
+}
+
+bool OpenGLVideo::setColorLUT(const QString &fileName)
+{
+    const ColorLUT lut(fileName.isEmpty() ? ColorLUT() : ColorLUT::fromCube(fileName));
+    setColorLUT(lut);
+    return fileName.isEmpty() || lut.isValid();
+}
+
+ColorLUT OpenGLVideo::colorLUT() const
+{
+    return d_func().lut;
 }
 
 void OpenGLVideo::fill(const QColor &color)
@@ -320,14 +1214,33 @@ void OpenGLVideo::render(const QRectF &target, const QRectF& roi, const QMatrix4
 {
     DPTR_D(OpenGLVideo);
     Q_ASSERT(d.manager);
-    VideoShader *shader = d.manager->prepareMaterial(d.material);
-    shader->update(d.material);
+    VideoMaterial *material = d.material;
+#if QT_ASYNC_UPLOAD
+    if (d.uploader) {
+        material = d.uploader->acquire();
+        if (!material)
+            return;
+        // the displaying material is not touched by the upload thread
+        QHash<VideoMaterial*, int>::iterator it = d.uploader_gens.find(material);
+        if (it == d.uploader_gens.end() || it.value() != d.material_gen) {
+            d.applySettings(material);
+            d.uploader_gens[material] = d.material_gen;
+        }
+    }
+#endif
+    VideoShader *shader = d.manager->prepareMaterial(material);
+    QElapsedTimer upload_timer;
+    upload_timer.start();
+    shader->update(material);
+    d.upload_ns = upload_timer.nsecsElapsed();
     shader->program()->setUniformValue(shader->opacityLocation(), (GLfloat)1.0);
+    if (!d.filters.isEmpty() && d.renderFilters(shader, material, roi, transform))
+        return;
     shader->program()->setUniformValue(shader->matrixLocation(), transform*d.matrix);
     // uniform end. attribute begin
-    d.bindAttributes(shader, target, roi);
+    d.bindAttributes(shader, material, target, roi);
     // normalize?
-    const bool blending = d.material->hasAlpha();
+    const bool blending = material->hasAlpha();
     if (blending) {
         DYGL(glEnable(GL_BLEND));
         DYGL(glBlendFunc(GL_SRC_ALPHA , GL_ONE_MINUS_SRC_ALPHA));
@@ -337,7 +1250,38 @@ void OpenGLVideo::render(const QRectF &target, const QRectF& roi, const QMatrix4
         DYGL(glDisable(GL_BLEND));
     // d.shader->program()->release(); //glUseProgram(0)
     d.unbindAttributes(shader);
-    d.material->unbind();
+    material->unbind();
+}
+
+qreal OpenGLVideo::uploadTime() const
+{
+    return qreal(d_func().upload_ns)/1e6;
+}
+
+qint64 OpenGLVideo::textureMemory() const
+{
+    qint64 bytes = 0;
+    DPTR_D(const OpenGLVideo);
+    QList<VideoMaterial*> ms(d.materials());
+#if QT_ASYNC_UPLOAD
+    if (d.uploader) {
+        for (int i = 0; i < TextureUploader::kRingSize; ++i)
+            ms.append(d.uploader->materials[i]);
+    }
+#endif
+    foreach (const VideoMaterial* m, ms) {
+        if (m)
+            bytes += m->textureMemory();
+    }
+    return bytes;
+}
+
+bool OpenGLVideo::renderSubImages(const SubImageSet &images, const QRectF &target, const QMatrix4x4 &transform)
+{
+    DPTR_D(OpenGLVideo);
+    if (!images.isValid())
+        return false;
+    return d.sub_images.render(images, target.isValid() ? target : d.rect, transform*d.matrix);
 }
 
 void OpenGLVideo::resetGL()
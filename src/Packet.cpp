@@ -20,12 +20,11 @@
 ******************************************************************************/
 
 #include "QtAV/Packet.h"
+#include <QtCore/QMutex>
+#include <QtCore/QVector>
 #include "QtAV/private/AVCompat.h"
 #include "utils/Logger.h"
 
-//ffmpeg2.1 libav10
-#define AVPACKET_REF AV_MODULE_CHECK(LIBAVCODEC, 55, 34, 1 ,39, 101)
-
 namespace QtAV {
 namespace {
 static const struct RegisterMetaTypes {
@@ -35,22 +34,162 @@ static const struct RegisterMetaTypes {
 } _registerMetaTypes;
 } //namespace
 
+/*!
+ * PacketPrivate shells are recycled. A packet is created in demux thread for every av_read_frame() and is released in
+ * AVThread, so the free list is protected by a mutex which is almost never contended.
+ * Payloads allocated by QtAV, i.e. copies of packets which are not reference counted, are taken from AVBufferPools of
+ * power of 2 size classes. Payloads read by av_read_frame() are allocated inside FFmpeg and are only referenced.
+ */
+class PacketPool
+{
+public:
+    enum { MaxFree = 1024 }; //enough for large buffers of several streams
+    enum { MinPayloadShift = 12, MaxPayloadShift = 22 }; // 4KB ~ 4MB. larger ones are not pooled
+    PacketPool() : hits(0), misses(0), copies(0) {
+        free_list.reserve(MaxFree);
+#if QTAV_HAVE(AVBUFREF)
+        for (int i = 0; i <= MaxPayloadShift - MinPayloadShift; ++i)
+            payload_pools[i] = 0;
+#endif //QTAV_HAVE(AVBUFREF)
+    }
+    ~PacketPool() {
+        foreach (void* p, free_list) {
+            ::operator delete(p);
+        }
+#if QTAV_HAVE(AVBUFREF)
+        // buffers still referenced by packets are freed when released
+        for (int i = 0; i <= MaxPayloadShift - MinPayloadShift; ++i)
+            av_buffer_pool_uninit(&payload_pools[i]);
+#endif //QTAV_HAVE(AVBUFREF)
+    }
+#if QTAV_HAVE(AVBUFREF)
+    // size including padding. AVBufferPool is thread safe, the mutex only protects lazy creation
+    AVBufferRef* allocPayload(int size) {
+        int shift = MinPayloadShift;
+        while (shift <= MaxPayloadShift && (1 << shift) < size)
+            ++shift;
+        if (shift > MaxPayloadShift)
+            return av_buffer_alloc(size);
+        AVBufferPool *&pool = payload_pools[shift - MinPayloadShift];
+        {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            if (!pool)
+                pool = av_buffer_pool_init(1 << shift, NULL);
+        }
+        if (!pool)
+            return av_buffer_alloc(size);
+        return av_buffer_pool_get(pool);
+    }
+#endif //QTAV_HAVE(AVBUFREF)
+    void* alloc(size_t size) {
+        {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            if (!free_list.isEmpty()) {
+                ++hits;
+                void* p = free_list.last();
+                free_list.pop_back();
+                return p;
+            }
+            ++misses;
+        }
+        return ::operator new(size);
+    }
+    void release(void* p) {
+        {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            if (free_list.size() < MaxFree) {
+                free_list.push_back(p);
+                return;
+            }
+        }
+        ::operator delete(p);
+    }
+    QMutex mutex;
+    void payloadCopied() {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        ++copies;
+    }
+    QVector<void*> free_list;
+    qint64 hits, misses;
+    qint64 copies; // not a pool statistic, but shares the mutex. copies are rare
+#if QTAV_HAVE(AVBUFREF)
+    AVBufferPool *payload_pools[MaxPayloadShift - MinPayloadShift + 1];
+#endif //QTAV_HAVE(AVBUFREF)
+};
+Q_GLOBAL_STATIC(PacketPool, packetPool)
+
+static void countPayloadCopy()
+{
+    PacketPool *pool = packetPool();
+    if (pool)
+        pool->payloadCopied();
+}
+
+#if QTAV_HAVE(AVPACKET_REF)
+// av_packet_ref() copies the payload if the source is not reference counted. copy to a pooled buffer instead
+static void refPacket(AVPacket *dst, const AVPacket *src)
+{
+    if (!src->buf && src->data) {
+        countPayloadCopy();
+#if QTAV_HAVE(AVBUFREF)
+        PacketPool *pool = packetPool();
+        AVBufferRef *buf = pool ? pool->allocPayload(src->size + FF_INPUT_BUFFER_PADDING_SIZE) : 0;
+        if (buf) {
+            if (av_packet_copy_props(dst, src) < 0) {
+                av_buffer_unref(&buf);
+                return;
+            }
+            memcpy(buf->data, src->data, src->size);
+            memset(buf->data + src->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+            dst->buf = buf;
+            dst->data = buf->data;
+            dst->size = src->size;
+            return;
+        }
+#endif //QTAV_HAVE(AVBUFREF)
+    }
+    av_packet_ref(dst, (AVPacket*)src);
+}
+#endif //QTAV_HAVE(AVPACKET_REF)
+
 class PacketPrivate : public QSharedData
 {
 public:
+    // packetPool() is 0 if it's destroyed, e.g. a static Packet
+    static void* operator new(size_t size) {
+        PacketPool *pool = packetPool();
+        if (!pool)
+            return ::operator new(size);
+        return pool->alloc(size);
+    }
+    static void operator delete(void* p) {
+        if (!p)
+            return;
+        PacketPool *pool = packetPool();
+        if (!pool) {
+            ::operator delete(p);
+            return;
+        }
+        pool->release(p);
+    }
+
     PacketPrivate()
         : QSharedData()
         , initialized(false)
     {
         av_init_packet(&avpkt);
     }
-#if AVPACKET_REF
+#if QTAV_HAVE(AVPACKET_REF)
     PacketPrivate(const PacketPrivate& o)
         : QSharedData(o)
         , initialized(o.initialized)
     { //used by QSharedDataPointer.detach()
         av_init_packet(&avpkt);
-        av_packet_ref(&avpkt, (AVPacket*)&o.avpkt);
+        refPacket(&avpkt, &o.avpkt);
     }
      ~PacketPrivate() {
         av_packet_unref(&avpkt);
@@ -64,10 +203,42 @@ public:
     AVPacket avpkt;
 };
 
+qint64 Packet::poolHits()
+{
+    PacketPool *pool = packetPool();
+    if (!pool)
+        return 0;
+    QMutexLocker lock(&pool->mutex);
+    Q_UNUSED(lock);
+    return pool->hits;
+}
+
+qint64 Packet::poolMisses()
+{
+    PacketPool *pool = packetPool();
+    if (!pool)
+        return 0;
+    QMutexLocker lock(&pool->mutex);
+    Q_UNUSED(lock);
+    return pool->misses;
+}
+
+qint64 Packet::payloadCopies()
+{
+    PacketPool *pool = packetPool();
+    if (!pool)
+        return 0;
+    QMutexLocker lock(&pool->mutex);
+    Q_UNUSED(lock);
+    return pool->copies;
+}
+
 Packet Packet::createEOF()
 {
+    // shared, no allocation for every eof packet
+    static const QByteArray kEOF("eof");
     Packet pkt;
-    pkt.data = QByteArray("eof");
+    pkt.data = kEOF;
     return pkt;
 }
 
@@ -91,9 +262,11 @@ bool Packet::fromAVPacket(Packet* pkt, const AVPacket *avpkt, double time_base)
         return false;
 
     pkt->position = avpkt->pos;
+    pkt->demuxTime = pkt->enqueueTime = 0;
     pkt->hasKeyFrame = !!(avpkt->flags & AV_PKT_FLAG_KEY);
     // what about marking avpkt as invalid and do not use isCorrupt?
     pkt->isCorrupt = !!(avpkt->flags & AV_PKT_FLAG_CORRUPT);
+    pkt->isDecodeOnly = false;
     if (pkt->isCorrupt)
         qDebug("currupt packet. pts: %f", pkt->pts);
 
@@ -135,13 +308,14 @@ bool Packet::fromAVPacket(Packet* pkt, const AVPacket *avpkt, double time_base)
     pkt->d = QSharedDataPointer<PacketPrivate>(new PacketPrivate());
     pkt->d->initialized = true;
     AVPacket *p = &pkt->d->avpkt;
-#if AVPACKET_REF
-    av_packet_ref(p, (AVPacket*)avpkt);  //properties are copied internally
+#if QTAV_HAVE(AVPACKET_REF)
+    refPacket(p, avpkt);  //properties are copied internally
     // add ref without copy, bytearray does not copy either. bytearray options linke remove() is safe. omit FF_INPUT_BUFFER_PADDING_SIZE
     pkt->data = QByteArray::fromRawData((const char*)p->data, p->size);
 #else
     if (avpkt->data) {
         // copy packet data. packet will be reset after AVDemuxer.readFrame() and in next av_read_frame
+        countPayloadCopy();
 #if NO_PADDING_DATA
         pkt->data = QByteArray((const char*)avpkt->data, avpkt->size);
 #else
@@ -161,7 +335,7 @@ bool Packet::fromAVPacket(Packet* pkt, const AVPacket *avpkt, double time_base)
         p->data = (uint8_t*)pkt->data.constData();
         p->size = pkt->data.size();
     }
-#endif //AVPACKET_REF
+#endif //QTAV_HAVE(AVPACKET_REF)
     // QtAV always use ms (1/1000s) and s. As a result no time_base is required in Packet
     p->pts = pkt->pts * 1000.0;
     p->dts = pkt->dts * 1000.0;
@@ -172,10 +346,13 @@ bool Packet::fromAVPacket(Packet* pkt, const AVPacket *avpkt, double time_base)
 Packet::Packet()
     : hasKeyFrame(false)
     , isCorrupt(false)
+    , isDecodeOnly(false)
     , pts(-1)
     , duration(-1)
     , dts(-1)
     , position(-1)
+    , demuxTime(0)
+    , enqueueTime(0)
 {
 }
 
@@ -183,11 +360,14 @@ Packet::Packet()
 Packet::Packet(const Packet &other)
     : hasKeyFrame(other.hasKeyFrame)
     , isCorrupt(other.isCorrupt)
+    , isDecodeOnly(other.isDecodeOnly)
     , data(other.data)
     , pts(other.pts)
     , duration(other.duration)
     , dts(other.dts)
     , position(other.position)
+    , demuxTime(other.demuxTime)
+    , enqueueTime(other.enqueueTime)
     , d(other.d)
 {
 }
@@ -199,10 +379,13 @@ Packet& Packet::operator =(const Packet& other)
     d = other.d;
     hasKeyFrame = other.hasKeyFrame;
     isCorrupt = other.isCorrupt;
+    isDecodeOnly = other.isDecodeOnly;
     pts = other.pts;
     duration = other.duration;
     dts = other.dts;
     position = other.position;
+    demuxTime = other.demuxTime;
+    enqueueTime = other.enqueueTime;
     data = other.data;
     return *this;
 }
@@ -213,11 +396,20 @@ Packet::~Packet()
 
 const AVPacket *Packet::asAVPacket() const
 {
-    if (d.constData()) { //why d->initialized (ref==1) result in detach?
+    if (d.constData()) {
         if (d.constData()->initialized) {//d.data() was 0 if d has not been accessed. now only contains avpkt, check d.constData() is engough
-            d->avpkt.data = (uint8_t*)data.constData();
-            d->avpkt.size = data.size();
-            return &d->avpkt;
+            // d-> detaches if the packet is copied, i.e. a new PacketPrivate and av_packet_ref() for every call.
+            // data and size are the same for all copies unless data is changed, so modifying the shared avpkt is fine
+            AVPacket *p = &const_cast<PacketPrivate*>(d.constData())->avpkt;
+#if QTAV_HAVE(AVPACKET_REF)
+            // data was detached from the AVBufferRef, e.g. modified by non-const QByteArray functions
+            if (p->buf && !data.isEmpty()
+                    && (data.constData() < (const char*)p->buf->data || data.constData() + data.size() > (const char*)p->buf->data + p->buf->size))
+                countPayloadCopy();
+#endif //QTAV_HAVE(AVPACKET_REF)
+            p->data = (uint8_t*)data.constData();
+            p->size = data.size();
+            return p;
         }
     } else {
         d = QSharedDataPointer<PacketPrivate>(new PacketPrivate());
@@ -239,4 +431,15 @@ const AVPacket *Packet::asAVPacket() const
     }
     return p;
 }
+
+void Packet::shiftTimestamps(qreal dt)
+{
+    pts += dt;
+    dts += dt;
+    if (!d.constData() || !d.constData()->initialized)
+        return;
+    // detach. copies, e.g. the one kept by AVDemuxer, keep the original timestamps
+    d->avpkt.pts = pts * 1000.0;
+    d->avpkt.dts = dts * 1000.0;
+}
 } //namespace QtAV
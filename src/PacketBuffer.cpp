@@ -23,6 +23,9 @@
 
 namespace QtAV {
 
+static const qint64 kSampleInterval = 500; // msecs
+static const qint64 kStableTime = 10000; // msecs without underrun to shrink the buffer
+
 PacketBuffer::PacketBuffer()
     : m_mode(BufferTime)
     , m_buffering(true) // in buffering state at the beginning
@@ -30,7 +33,27 @@ PacketBuffer::PacketBuffer()
     , m_buffer(0)
     , m_value0(0)
     , m_value1(0)
+    , m_head_reset(0)
+    , m_bytes0(0)
+    , m_bytes1(0)
+    , m_duration0(0)
+    , m_duration1(0)
+    , m_adaptive(false)
+    , m_min(0)
+    , m_max_value(0)
+    , m_floor(0)
+    , m_underruns(0)
+    , m_adapted_underruns(0)
+    , m_adapt_time(0)
+    , m_sample_time(0)
+    , m_sample_value(0)
+    , m_sample_time_value(0)
+    , m_packets1(0)
+    , m_time1(0)
+    , m_speed(0)
+    , m_time_speed(0)
 {
+    m_timer.start();
 }
 
 PacketBuffer::~PacketBuffer()
@@ -39,16 +62,8 @@ PacketBuffer::~PacketBuffer()
 
 void PacketBuffer::setBufferMode(BufferMode mode)
 {
+    // all values are always counted, so no queue access is required
     m_mode = mode;
-    if (queue.isEmpty()) {
-        m_value0 = m_value1 = 0;
-        return;
-    }
-    if (m_mode == BufferTime) {
-        m_value0 = qint64(queue[0].pts*1000.0);
-    } else {
-        m_value0 = 0;
-    }
 }
 
 BufferMode PacketBuffer::bufferMode() const
@@ -82,8 +97,27 @@ qreal PacketBuffer::bufferMax() const
 
 qint64 PacketBuffer::buffered() const
 {
-    Q_ASSERT(m_value1 >= m_value0);
-    return m_value1 - m_value0;
+    if (m_mode == BufferTime)
+        return bufferedTime();
+    if (m_mode == BufferBytes)
+        return bufferedBytes();
+    return queue.size();
+}
+
+// x0 and x1 are written in different threads, the difference can be negative for a moment
+qint64 PacketBuffer::bufferedTime() const
+{
+    return qMax<qint64>(0LL, m_value1 - m_value0);
+}
+
+qint64 PacketBuffer::bufferedBytes() const
+{
+    return qMax<qint64>(0LL, m_bytes1 - m_bytes0);
+}
+
+qint64 PacketBuffer::bufferedDuration() const
+{
+    return qMax<qint64>(0LL, m_duration1 - m_duration0);
 }
 
 bool PacketBuffer::isBuffering() const
@@ -97,6 +131,63 @@ qreal PacketBuffer::bufferProgress() const
     return qMax<qreal>(qMin<qreal>(p, 1.0), 0.0);
 }
 
+qreal PacketBuffer::bufferSpeed() const
+{
+    return m_speed;
+}
+
+void PacketBuffer::setAdaptive(bool value, qint64 minValue, qint64 maxValue)
+{
+    m_adaptive = value;
+    m_min = qMax<qint64>(1LL, minValue);
+    m_max_value = qMax<qint64>(m_min, maxValue);
+    m_floor = m_min;
+    m_adapted_underruns = m_underruns;
+    m_adapt_time = m_timer.elapsed();
+    if (m_adaptive)
+        m_buffer = qBound(m_min, m_buffer, m_max_value);
+}
+
+bool PacketBuffer::isAdaptive() const
+{
+    return m_adaptive;
+}
+
+bool PacketBuffer::adapt(qint64 bitRate)
+{
+    if (!m_adaptive)
+        return false;
+    // input speed / playback speed. < 1: the buffer will drain while playing
+    qreal ratio = m_time_speed/1000.0;
+    if (m_mode == BufferBytes && bitRate > 0)
+        ratio = m_speed*8.0/qreal(bitRate);
+    const qint64 now = m_timer.elapsed();
+    const int underruns = m_underruns;
+    qint64 v = m_buffer;
+    if (underruns != m_adapted_underruns) {
+        m_adapted_underruns = underruns;
+        // v was not enough. do not shrink to v again
+        m_floor = qMin(m_max_value, qMax(m_floor, v + v/4));
+        v = ratio < 1.0 ? v*2 : v + v/2;
+    } else if (now - m_adapt_time >= kStableTime && !m_buffering && checkEnough() && ratio >= 0.9) {
+        v = v - v/5;
+    } else {
+        return false;
+    }
+    v = qBound(qMax(m_min, m_floor), v, m_max_value);
+    m_adapt_time = now;
+    if (v == m_buffer)
+        return false;
+    qDebug("adaptive buffer: %lld => %lld. speed ratio: %.2f, underruns: %d", m_buffer, v, ratio, underruns);
+    m_buffer = v;
+    return true;
+}
+
+int PacketBuffer::underruns() const
+{
+    return m_underruns;
+}
+
 bool PacketBuffer::checkEnough() const
 {
     return buffered() >= bufferValue();
@@ -109,17 +200,32 @@ bool PacketBuffer::checkFull() const
 
 void PacketBuffer::onPut(const Packet &p)
 {
-    if (m_mode == BufferTime) {
-        m_value1 = qint64(p.pts*1000.0); // FIXME: what if no pts
-        m_value0 = qint64(queue[0].pts*1000.0); // must compute here because it is reset to 0 if take from empty
-        //if (isBuffering())
-          //  qDebug("+buffering progress: %.1f%%=%.1f/%.1f~%.1fs %d-%d", bufferProgress()*100.0, (qreal)buffered()/1000.0, (qreal)bufferValue()/1000.0, qreal(bufferValue())*bufferMax()/1000.0, m_value1, m_value0);
-    } else if (m_mode == BufferBytes) {
-        m_value1 += p.data.size();
-    } else {
-        m_value1++;
+    const qint64 last = m_value1;
+    m_value1 = qint64(p.pts*1000.0); // FIXME: what if no pts
+    // media time put. ignore discontinuities, e.g. seek
+    if (m_value1 > last && m_value1 - last < kSampleInterval*10)
+        m_time1 += m_value1 - last;
+    ++m_packets1;
+    // p is the new head after the queue becomes empty. the old m_value0 is the last pts put before, e.g. before seek
+    if (m_head_reset.testAndSetOrdered(1, 0))
+        m_value0 = m_value1;
+    m_bytes1 += p.data.size();
+    if (p.duration > 0)
+        m_duration1 += qint64(p.duration*1000.0);
+    //if (isBuffering())
+      //  qDebug("+buffering progress: %.1f%%=%.1f/%.1f~%.1fs %d-%d", bufferProgress()*100.0, (qreal)buffered()/1000.0, (qreal)bufferValue()/1000.0, qreal(bufferValue())*bufferMax()/1000.0, m_value1, m_value0);
+    const qint64 now = m_timer.elapsed();
+    if (now - m_sample_time >= kSampleInterval) {
+        const qint64 value = m_mode == BufferBytes ? m_bytes1 : (m_mode == BufferPackets ? m_packets1 : m_time1);
+        const qreal dt = qreal(now - m_sample_time)/1000.0;
+        if (m_sample_time > 0) { // smooth
+            m_speed = 0.7*m_speed + 0.3*qreal(value - m_sample_value)/dt;
+            m_time_speed = 0.7*m_time_speed + 0.3*qreal(m_time1 - m_sample_time_value)/dt;
+        }
+        m_sample_time = now;
+        m_sample_value = value;
+        m_sample_time_value = m_time1;
     }
-    // TODO: compute buffer speed (and auto set the best bufferValue)
     if (!m_buffering)
         return;
     if (checkEnough()) {
@@ -129,24 +235,25 @@ void PacketBuffer::onPut(const Packet &p)
 
 void PacketBuffer::onTake(const Packet &p)
 {
-    if (checkEmpty()) {
+    const bool empty = checkEmpty();
+    if (empty) {
+        // taken the last packet while playing. the queue is also empty after clear() and at the end
+        if (!m_buffering && !p.data.isEmpty() && !p.isEOF())
+            ++m_underruns;
         m_buffering = true;
-    }
-    if (queue.isEmpty()) {
-        m_value0 = 0;
-        m_value1 = 0;
+        // nothing is buffered. also resync with producer if the queue was cleared, i.e. p is a default constructed packet
+        m_value0 = m_value1;
+        m_bytes0 = m_bytes1;
+        m_duration0 = m_duration1;
+        m_head_reset.fetchAndStoreOrdered(1);
         return;
     }
-    if (m_mode == BufferTime) {
-        m_value0 = qint64(queue[0].pts*1000.0);
-        //if (isBuffering())
-          //  qDebug("-buffering progress: %.1f=%.1f/%.1fs", bufferProgress(), (qreal)buffered()/1000.0, (qreal)bufferValue()/1000.0);
-    } else if (m_mode == BufferBytes) {
-        m_value1 -= p.data.size();
-        m_value1 = qMax<qint64>(0LL, m_value1);
-    } else {
-        m_value1--;
-    }
+    m_value0 = qint64(queue.head().pts*1000.0);
+    //if (isBuffering())
+      //  qDebug("-buffering progress: %.1f=%.1f/%.1fs", bufferProgress(), (qreal)buffered()/1000.0, (qreal)bufferValue()/1000.0);
+    m_bytes0 += p.data.size();
+    if (p.duration > 0)
+        m_duration0 += qint64(p.duration*1000.0);
 }
 
 } //namespace QtAV
@@ -22,24 +22,64 @@
 #ifndef QTAV_PACKETBUFFER_H
 #define QTAV_PACKETBUFFER_H
 
-#include <QtCore/QQueue>
 #include <QtAV/Packet.h>
 #include "QtAV/CommonTypes.h"
+#include "QtAV/Statistics.h"
+#if QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
+#include <QtCore/QAtomicInt>
+#include <QtCore/QElapsedTimer>
+#else
+#include <QtCore/QTime>
+typedef QTime QElapsedTimer;
+#endif
+#if QTAV_HAVE(SPSC_QUEUE)
+#include "utils/SPSCQueue.h"
+#else
 #include "utils/BlockingQueue.h"
+#include "utils/ring.h"
+#endif
 
 namespace QtAV {
 
+// packets are put in demux thread and taken in AVThread only
+#if QTAV_HAVE(SPSC_QUEUE)
+typedef SPSCBlockingQueue<Packet> PacketQueue;
+#else
+typedef BlockingQueue<Packet, RingQueue> PacketQueue; // no allocation after warm up
+#endif
+
 /*
  * take empty: start buffering, block at next take if still empty
  * take enough: start to put more packets
  * put enough: end buffering, end take block
  * put full: stop putting more packets
  */
-class PacketBuffer : public BlockingQueue<Packet, QQueue>
+class Q_AV_PRIVATE_EXPORT PacketBuffer : public PacketQueue
 {
 public:
     PacketBuffer();
     ~PacketBuffer();
+    // tag Packet::enqueueTime before waiting for free space if latency tracing is enabled
+    void put(const Packet& p) {
+        if (!Statistics::isLatencyTracing()) {
+            PQ::put(p);
+            return;
+        }
+        Packet pkt(p);
+        pkt.enqueueTime = Statistics::tracingTime();
+        PQ::put(pkt);
+    }
+    void put(const QVector<Packet>& ps) {
+        if (!Statistics::isLatencyTracing()) {
+            PQ::put(ps);
+            return;
+        }
+        QVector<Packet> pkts(ps);
+        const qint64 t = Statistics::tracingTime();
+        for (int i = 0; i < pkts.size(); ++i)
+            pkts[i].enqueueTime = t;
+        PQ::put(pkts);
+    }
 
     void setBufferMode(BufferMode mode);
     BufferMode bufferMode() const;
@@ -62,6 +102,17 @@ public:
      * Current buffered value in the queue
      */
     qint64 buffered() const;
+    /*!
+     * \brief bufferedTime
+     * pts range in msecs of buffered packets
+     */
+    qint64 bufferedTime() const;
+    qint64 bufferedBytes() const;
+    /*!
+     * \brief bufferedDuration
+     * sum of buffered packets' duration in msecs. packets without duration are not counted
+     */
+    qint64 bufferedDuration() const;
     bool isBuffering() const;
     /*!
      * \brief bufferProgress
@@ -70,7 +121,30 @@ public:
      * \return Percent of buffered time, bytes or packets.
      */
     qreal bufferProgress() const;
+    /*!
+     * \brief bufferSpeed
+     * Average input speed of recent puts in bufferMode() unit per second. Time: msecs/s, i.e. 1000 is as fast as playback.
+     * Less than the real throughput if put() is blocked because the queue is full.
+     */
     qreal bufferSpeed() const;
+    /*!
+     * \brief setAdaptive
+     * Let adapt() change bufferValue() in [minValue, maxValue] starting from the current bufferValue().
+     * Call it after setBufferMode() and setBufferValue().
+     */
+    void setAdaptive(bool value, qint64 minValue, qint64 maxValue);
+    bool isAdaptive() const;
+    /*!
+     * \brief adapt
+     * Grow the buffer if an underrun happens while playing. Shrink it if no underrun for a while and enough is buffered,
+     * but never below a value that caused an underrun. So it settles at the smallest value that does not stall.
+     * Call it in producer thread.
+     * \param bitRate stream bit rate. Used to compare input speed to playback speed in BufferBytes mode. <=0: unknown
+     * \return true if bufferValue() is changed
+     */
+    bool adapt(qint64 bitRate);
+    /// number of times the queue becomes empty after at least 1 packet is taken, i.e. playback stalled
+    int underruns() const;
 
 protected:
     bool checkEnough() const Q_DECL_OVERRIDE;
@@ -78,7 +152,7 @@ protected:
     void onTake(const Packet &) Q_DECL_OVERRIDE;
     void onPut(const Packet &) Q_DECL_OVERRIDE;
 protected:
-    typedef BlockingQueue<Packet, QQueue> PQ;
+    typedef PacketQueue PQ;
     using PQ::setCapacity;
     using PQ::setThreshold;
     using PQ::capacity;
@@ -88,9 +162,29 @@ private:
     BufferMode m_mode;
     bool m_buffering;
     qreal m_max;
-    // bytes or count
     qint64 m_buffer;
+    // running totals, O(1) for every buffer mode. x1 is only modified in onPut() (producer), x0 in onTake() (consumer, see m_head_reset),
+    // so no lock is required if put() and take() are in different threads.
+    // head and last put pts in msecs
     qint64 m_value0, m_value1;
+    // set in onTake() when the queue becomes empty, e.g. clear() after seek. the consumer does not write m_value0 until
+    // the next packet is taken, so the next onPut() can resync m_value0 with the new head and clear the flag
+    QAtomicInt m_head_reset;
+    // total taken and put bytes
+    qint64 m_bytes0, m_bytes1;
+    // total taken and put packet durations in msecs
+    qint64 m_duration0, m_duration1;
+    // adaptive buffer. m_underruns is written in consumer, others in producer
+    bool m_adaptive;
+    qint64 m_min, m_max_value, m_floor;
+    volatile int m_underruns;
+    int m_adapted_underruns;
+    qint64 m_adapt_time; // msecs of last change
+    // input speed. sampled in onPut()
+    QElapsedTimer m_timer;
+    qint64 m_sample_time, m_sample_value, m_sample_time_value;
+    qint64 m_packets1, m_time1; // put packets and media msecs
+    qreal m_speed, m_time_speed; // bufferMode() unit and media msecs per second
 };
 
 } //namespace QtAV
@@ -0,0 +1,169 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "PacketRecorder.h"
+#include <limits>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+PacketRecorder::PacketRecorder(QObject *parent)
+    : QThread(parent)
+    , m_vctx(0)
+    , m_actx(0)
+    , m_max(1024)
+    , m_stop(false)
+    , m_wait_key(true)
+    , m_rebase(false)
+    , m_dropped(0)
+    , m_t0(0)
+    , m_last(0)
+    , m_started(false)
+{
+    setObjectName(QStringLiteral("PacketRecorder"));
+    // record() never waits. packets are dropped by record() if too many are queued
+    m_queue.setCapacity(std::numeric_limits<int>::max());
+    m_queue.blockFull(false);
+}
+
+PacketRecorder::~PacketRecorder()
+{
+    stop();
+}
+
+void PacketRecorder::setOutput(const QString &fileName, const QString &format, void *videoContext, void *audioContext)
+{
+    m_file = fileName;
+    m_format = format;
+    m_vctx = videoContext;
+    m_actx = audioContext;
+    m_wait_key = !!m_vctx;
+}
+
+QString PacketRecorder::fileName() const
+{
+    return m_file;
+}
+
+void PacketRecorder::setMaxPackets(int value)
+{
+    m_max = qMax(1, value);
+}
+
+int PacketRecorder::maxPackets() const
+{
+    return m_max;
+}
+
+void PacketRecorder::record(const Packet &pkt, bool video)
+{
+    if (m_stop || !(video ? m_vctx : m_actx) || !pkt.isValid())
+        return;
+    if (m_wait_key) {
+        if (!video || !pkt.hasKeyFrame)
+            return;
+        m_wait_key = false;
+    }
+    if (m_queue.size() >= m_max) {
+        m_dropped.ref();
+        m_wait_key = !!m_vctx;
+        return;
+    }
+    Entry e;
+    e.packet = pkt;
+    e.video = video;
+    e.rebase = m_rebase;
+    m_rebase = false;
+    m_queue.put(e);
+}
+
+void PacketRecorder::discontinue()
+{
+    m_wait_key = !!m_vctx;
+    m_rebase = true;
+}
+
+void PacketRecorder::stop()
+{
+    if (!isRunning())
+        return;
+    // the producer is detached now. an invalid packet wakes up the writer after queued packets are written
+    m_stop = true;
+    m_queue.put(Entry());
+    wait();
+}
+
+int PacketRecorder::droppedPackets() const
+{
+    return spsc::loadAcquire(m_dropped);
+}
+
+void PacketRecorder::run()
+{
+    m_started = false;
+    m_t0 = 0;
+    m_last = 0;
+    spsc::storeRelease(m_dropped, 0);
+    m_muxer.setMedia(m_file);
+    if (!m_format.isEmpty())
+        m_muxer.setFormat(m_format);
+    m_muxer.copyVideoContext(m_vctx);
+    m_muxer.copyAudioContext(m_actx);
+    if (!m_muxer.open()) {
+        qWarning("PacketRecorder: failed to open %s", m_file.toUtf8().constData());
+        m_stop = true;
+        return;
+    }
+    while (true) {
+        Entry e(m_queue.take());
+        if (!e.packet.isValid()) {
+            if (m_stop && m_queue.isEmpty())
+                break;
+            continue;
+        }
+        write(&e);
+    }
+    m_muxer.close();
+    if (droppedPackets() > 0)
+        qWarning("PacketRecorder: %d packets are dropped because writing is too slow", droppedPackets());
+}
+
+bool PacketRecorder::write(Entry *e)
+{
+    Packet &pkt = e->packet;
+    if (!m_started || e->rebase) { // a video key frame, or an audio packet if no video
+        m_t0 = m_started ? pkt.dts - m_last : pkt.dts;
+        m_started = true;
+    }
+    pkt.pts -= m_t0;
+    pkt.dts -= m_t0;
+    if (pkt.dts < 0) // audio before the first key frame
+        return false;
+    if (e->video)
+        m_muxer.writeVideo(pkt);
+    else
+        m_muxer.writeAudio(pkt);
+    if (e->video || !m_vctx)
+        m_last = qMax(m_last, pkt.dts + pkt.duration);
+    return true;
+}
+
+} //namespace QtAV
@@ -0,0 +1,92 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_PACKETRECORDER_H
+#define QTAV_PACKETRECORDER_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QThread>
+#include "QtAV/AVMuxer.h"
+#include "QtAV/Packet.h"
+#include "utils/SPSCQueue.h"
+
+namespace QtAV {
+/*!
+ * \brief The PacketRecorder class
+ * Write demuxed packets to a file by AVMuxer in stream copy mode in a standalone thread, e.g. record a live stream while
+ * playing. record() is called by 1 producer thread (AVDemuxThread) and never blocks: if the writer can not keep up and
+ * maxPackets() are queued, packets are dropped until the next video key frame. Writing starts at a video key frame if
+ * there is a video stream, and timestamps start from 0.
+ */
+class PacketRecorder : public QThread
+{
+public:
+    PacketRecorder(QObject *parent = 0);
+    ~PacketRecorder();
+    /*!
+     * \brief setOutput
+     * Call before start()
+     * \param videoContext, audioContext AVCodecContext* of the demuxed streams. must be alive until the thread finished. null: not recorded
+     */
+    void setOutput(const QString& fileName, const QString& format, void* videoContext, void* audioContext);
+    QString fileName() const;
+    /// default is 1024
+    void setMaxPackets(int value);
+    int maxPackets() const;
+    /// producer thread only
+    void record(const Packet& pkt, bool video);
+    /*!
+     * \brief discontinue
+     * Timestamps of the next packets are not continuous, e.g. after seeking. Writing restarts at the next key frame, and
+     * timestamps continue from the last written packet. Producer thread only
+     */
+    void discontinue();
+    /// write queued packets, close the file and wait for the thread finished
+    void stop();
+    int droppedPackets() const;
+protected:
+    void run() Q_DECL_OVERRIDE;
+private:
+    typedef struct Entry {
+        Entry() : video(false), rebase(false) {}
+        Packet packet;
+        bool video;
+        bool rebase; // the first packet after a discontinuity
+    } Entry;
+    // rebase pkt and write. false if it is before the start
+    bool write(Entry *e);
+
+    QString m_file, m_format;
+    void *m_vctx, *m_actx;
+    int m_max;
+    volatile bool m_stop;
+    // producer states
+    bool m_wait_key, m_rebase;
+    QAtomicInt m_dropped;
+    SPSCBlockingQueue<Entry> m_queue;
+    // writer states
+    AVMuxer m_muxer;
+    qreal m_t0; // source time of the output time 0
+    qreal m_last; // the end of the last written video packet, or audio packet if no video. output time
+    bool m_started;
+};
+} //namespace QtAV
+#endif //QTAV_PACKETRECORDER_H
@@ -23,7 +23,7 @@
 #define QTAV_AVCLOCK_H
 
 #include <QtAV/QtAV_Global.h>
-#include <QtCore/QBasicTimer>
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
 #if QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
 #include <QtCore/QElapsedTimer>
@@ -41,6 +41,8 @@ typedef QTime QElapsedTimer;
 namespace QtAV {
 
 static const double kThousandth = 0.001;
+static const qint64 kMaxAudioInterpolation = 100000000LL; // 100ms in ns
+static const qint64 kMaxAudioJitter = 10000000LL; // 10ms in ns
 
 class Q_AV_EXPORT AVClock : public QObject
 {
@@ -77,10 +79,23 @@ public:
      */
     inline double value() const;
     inline void updateValue(double pts); //update the pts
+    /*!
+     * \brief updateAudioTime
+     * Update audio clock with the timestamp of data taken by the device and the device latency, i.e. pts - latency is being
+     * heard now. value() is interpolated by a monotonic timer until the next update, so it's accurate between 2 reports.
+     * updateValue() and updateDelay() stop the interpolation, e.g. no audio device
+     */
+    inline void updateAudioTime(double pts, double latency);
     /*used when seeking and correcting from external*/
     void updateExternalClock(qint64 msecs);
     /*external clock outside still running, so it's more accurate for syncing multiple clocks serially*/
     void updateExternalClock(const AVClock& clock);
+    /*!
+     * \brief setExternalValue
+     * Make value() of ExternalClock or VideoClock equal to value now and keep running or paused. Unlike updateExternalClock(),
+     * precision is not limited to ms and the time gained by catch up speed is kept. Used by a clock following a remote clock
+     */
+    void setExternalValue(double value);
 
     inline void updateVideoTime(double pts);
     inline double videoTime() const;
@@ -89,8 +104,36 @@ public:
 
     void setSpeed(qreal speed);
     inline qreal speed() const;
+    /*!
+     * \brief setCatchUpSpeed
+     * Make ExternalClock and VideoClock run faster than speed() by ratio extra, e.g. 0.05 is 5% faster. 0: normal.
+     * Unlike setSpeed(), value() does not jump. Used to reduce latency of live streams. AudioClock is not changed, instead
+     * AudioThread plays audio faster by the ratio. Thread safe
+     * The time gained is discarded by reset() and updateExternalClock()
+     */
+    void setCatchUpSpeed(qreal extra);
+    qreal catchUpSpeed() const;
 
     bool isPaused() const;
+    /// not started or resumed since reset()
+    bool isStopped() const;
+    /*!
+     * \brief setReferenceClock
+     * Follow another clock continuously, e.g. a clock shared by the players of a video wall or a multi-angle playback, instead
+     * of periodic updateExternalClock(const AVClock&). value() is clock->value() + referenceOffset() regardless of clockType(),
+     * so video threads of all players drop or repeat frames against the same value, and frames with the same timestamp are
+     * displayed at the same time. Seek and pause the reference clock. Audio is not resampled to follow the reference, so mute
+     * the followers, or use the clock of the player playing audio as the reference.
+     * \param clock 0: stop following. It's cleared if the reference clock is destroyed. A clock following this one is rejected
+     */
+    void setReferenceClock(AVClock* clock);
+    AVClock* referenceClock() const;
+    /*!
+     * \brief setReferenceOffset
+     * Added to the reference clock value, in seconds. e.g. the difference of start times of multi-angle recordings
+     */
+    void setReferenceOffset(double value);
+    double referenceOffset() const;
 signals:
     void paused(bool);
     void paused(); //equals to paused(true)
@@ -106,86 +149,135 @@ public slots:
     /*reset clock intial value and external clock parameters (and stop timer). keep speed() and isClockAuto()*/
     void reset();
 
-protected:
-    virtual void timerEvent(QTimerEvent *event);
 private Q_SLOTS:
-    /// make sure QBasic timer start/stop in a right thread
-    void restartCorrectionTimer();
-    void stopCorrectionTimer();
+    void onReferenceDestroyed();
 private:
+    enum {
+        kRunning,
+        kPaused,
+        kStopped
+    };
+    static inline qint64 elapsedNs(const QElapsedTimer& t) {
+#if QT_VERSION >= QT_VERSION_CHECK(4, 8, 0)
+        return t.nsecsElapsed();
+#else
+        return qint64(t.elapsed())*1000000LL;
+#endif
+    }
+    static inline qint64 toNs(double s) { return qint64(s*1e9);}
+    static inline double toSeconds(qint64 ns) { return double(ns)*1e-9;}
+    // move the time elapsed since timer started to the base values and restart timer. rebase_mutex must be locked
+    void rebase();
+
     bool auto_clock;
     int m_state;
     ClockType clock_type;
-    mutable double pts_;
-    mutable double pts_v;
-    double delay_;
-    mutable QElapsedTimer timer;
+    /*
+     * Times are integer nanoseconds. External and video clock values are base values plus the time elapsed since the timer
+     * started, never accumulated per value() call, so there is no accumulative error to correct periodically.
+     */
+    qint64 pts_;
+    qint64 pts_v;
+    qint64 delay_;
+    QElapsedTimer timer;
     qreal mSpeed;
+    qreal mCatchUp;
+    qint64 catchup_; // time gained by catch up speed before timer started
+    // rebase() from demux thread (setCatchUpSpeed()) and video thread (updateVideoTime())
+    QMutex rebase_mutex;
     double value0;
-    /*!
-     * \brief correction_schedule_timer
-     * accumulative error is too large using QElapsedTimer.restart() frequently.
-     * we periodically correct value() to keep the error always less
-     * than the error of calling QElapsedTimer.restart() once
-     * see github issue 46, 307 etc
+    /*
+     * Monotonic time audio_ts_ was reported by updateAudioTime(). Audio clock value is interpolated from it between 2 reports
+     * because the device keeps playing. -1: not reported with device latency, no interpolation
      */
-    QBasicTimer correction_schedule_timer;
-    qint64 t; // absolute time for elapsed timer correction
-    static const int kCorrectionInterval = 1; // 1000ms
-    double last_pts;
-    double avg_err; // average error of restart()
-    mutable int nb_restarted;
+    QElapsedTimer mono;
+    qint64 audio_ts_;
+    AVClock *ref_;
+    double ref_offset_;
 };
 
+double AVClock::pts() const
+{
+    return toSeconds(pts_);
+}
+
 double AVClock::value() const
 {
+    if (ref_)
+        return ref_->value() + ref_offset_;
     if (clock_type == AudioClock) {
-        // TODO: audio clock need a timer too
         // timestamp from media stream is >= value0
-        return pts_ == 0 ? value0 : pts_ + delay_;
-    } else if (clock_type == ExternalClock) {
-        if (timer.isValid()) {
-            ++nb_restarted;
-            pts_ += double(timer.restart()) * kThousandth + avg_err;
-        } else {//timer is paused
-            //qDebug("clock is paused. return the last value %f", pts_);
+        if (pts_ == 0)
+            return value0;
+        qint64 v = pts_ + delay_;
+        if (audio_ts_ >= 0 && m_state == kRunning) {
+            // the device plays at most 1 buffer between 2 reports. limit it in case audio thread is blocked
+            const qint64 dt = qBound<qint64>(0, elapsedNs(mono) - audio_ts_, kMaxAudioInterpolation);
+            v += qint64(qreal(dt)*speed());
         }
-        return pts_ * speed() + value0;
-    } else {
-        if (timer.isValid()) {
-            ++nb_restarted;
-            pts_v += double(timer.restart()) * kThousandth + avg_err;
-        }
-        return pts_v * speed(); // value0 is 1st video pts_v already
+        return toSeconds(v);
     }
+    const qint64 dt = timer.isValid() ? elapsedNs(timer) : 0;
+    const double catchup = toSeconds(catchup_ + qint64(qreal(dt)*mCatchUp*speed()));
+    if (clock_type == ExternalClock)
+        return toSeconds(pts_ + dt) * speed() + value0 + catchup;
+    return toSeconds(pts_v + dt) * speed() + catchup; // value0 is 1st video pts_v already
 }
 
 void AVClock::updateValue(double pts)
 {
-    if (clock_type == AudioClock)
-        pts_ = pts;
+    if (clock_type != AudioClock)
+        return;
+    pts_ = toNs(pts);
+    audio_ts_ = -1;
+}
+
+void AVClock::updateAudioTime(double pts, double latency)
+{
+    if (clock_type != AudioClock)
+        return;
+    const qint64 now = elapsedNs(mono);
+    const qint64 v = toNs(pts);
+    qint64 d = toNs(-latency);
+    if (audio_ts_ >= 0 && m_state == kRunning) {
+        // keep value() monotonic. a report slightly behind the value interpolated from the last one is jitter of
+        // latency measurement, not a seek
+        const qint64 dt = qBound<qint64>(0, now - audio_ts_, kMaxAudioInterpolation);
+        const qint64 last = pts_ + delay_ + qint64(qreal(dt)*speed());
+        if (v + d < last && last - (v + d) < kMaxAudioJitter)
+            d = last - v;
+    }
+    pts_ = v;
+    delay_ = d;
+    audio_ts_ = now;
 }
 
 void AVClock::updateVideoTime(double pts)
 {
-    pts_v = pts;
-    if (clock_type == VideoClock)
-        timer.restart();
+    if (clock_type == VideoClock) {
+        QMutexLocker lock(&rebase_mutex);
+        Q_UNUSED(lock);
+        rebase();
+        pts_v = toNs(pts);
+        return;
+    }
+    pts_v = toNs(pts);
 }
 
 double AVClock::videoTime() const
 {
-    return pts_v;
+    return toSeconds(pts_v);
 }
 
 double AVClock::delay() const
 {
-    return delay_;
+    return toSeconds(delay_);
 }
 
 void AVClock::updateDelay(double delay)
 {
-    delay_ = delay;
+    delay_ = toNs(delay);
+    audio_ts_ = -1;
 }
 
 qreal AVClock::speed() const
@@ -55,6 +55,13 @@ public:
     bool isAvailable() const;
     QTAV_DEPRECATED virtual bool decode(const QByteArray& encoded) = 0;
     virtual bool decode(const Packet& packet) = 0;
+    /*!
+     * \brief receiveFrame
+     * Take the next frame left in the decoder without decoding a packet, e.g. a packet produced several frames, or frame threads
+     * output more than 1 frame at once. Call frame() if it returns true. Call it until false is returned before decoding the
+     * next packet, then frames are not delayed. Default returns false, i.e. the decoder outputs at most 1 frame per packet
+     */
+    virtual bool receiveFrame();
     int undecodedSize() const; //TODO: remove. always decode whole input data completely
 
     // avcodec_open2
@@ -28,6 +28,7 @@
 #include <QtCore/QVariant>
 #include <QtCore/QObject>
 #include <QtCore/QScopedPointer>
+#include <QtCore/QVector>
 
 struct AVFormatContext;
 struct AVCodecContext;
@@ -77,6 +78,13 @@ public:
     bool load();
     bool unload();
     bool isLoaded() const;
+    /*!
+     * \brief swap
+     * Exchange the media, loaded contexts and all settings with other demuxer. Signal connections are not exchanged.
+     * Used to switch to a media prefetched by another demuxer without opening it again.
+     * Neither demuxer can be used by other threads when swapping.
+     */
+    void swap(AVDemuxer& other);
     /*!
      * \brief readFrame
      * Read a packet from 1 of the streams. use packet() to get the result packet. packet() returns last valid packet.
@@ -85,6 +93,16 @@ public:
      * \return true if no error. false if error occurs, eof reaches, interrupted by user or time out(getInterruptTimeout())
      */
     bool readFrame(); // TODO: rename int readPacket(), return stream number
+    /*!
+     * \brief readFrames
+     * Read up to maxPackets packets in 1 call, with the demuxer locked only once. Packets of unselected streams are skipped.
+     * Stops at the first error, eof or interruption as readFrame() does. packet() and stream() are the last packet read.
+     * \param packets read packets are appended
+     * \param streams stream index of each appended packet
+     * \param maxBytes stop if total size of read packets reaches maxBytes. <=0: no limit
+     * \return number of appended packets. 0 if readFrame() would return false
+     */
+    int readFrames(QVector<Packet> *packets, QVector<int> *streams, int maxPackets, qint64 maxBytes = 0);
     /*!
      * \brief packet
      * return the packet read by demuxer. packet is invalid if readFrame() returns false.
@@ -137,6 +155,25 @@ public:
      * index < 0 is invalid
      */
     bool setStreamIndex(StreamType st, int index);
+    /*!
+     * \brief setDiscardUnselectedStreams
+     * Set AVStream.discard to AVDISCARD_ALL for streams not selected by setStreamIndex(), so their packets are skipped by
+     * FFmpeg and never returned by readFrame(). Updated when a stream is selected. Default is true.
+     * Set false to read packets of all streams, e.g. to process all subtitle tracks at the same time
+     */
+    void setDiscardUnselectedStreams(bool value);
+    bool isDiscardUnselectedStreams() const;
+    /*!
+     * \brief setBitstreamFilter
+     * Filter packets of the current stream st by FFmpeg bitstream filters once when they are read, e.g. "h264_mp4toannexb"
+     * required by a hardware decoder (VideoDecoder::requiredBitstreamFilter()). Filtered packets are refcounted, no copy is made
+     * except the filters' output. Extradata of the codec context is replaced by the filtered one, so decoders opened later
+     * with it accept the filtered packets. Call it after loaded. Filters are removed in unload(). Requires FFmpeg >= 3.1
+     * \param filters comma separated filter names. empty: no filter
+     * \return false if filters are not available or can not filter the stream
+     */
+    bool setBitstreamFilter(StreamType st, const QString& filters);
+    QString bitstreamFilter(StreamType st) const;
     // current open stream
     int currentStream(StreamType st) const;
     QList<int> streams(StreamType st) const;
@@ -175,6 +212,22 @@ public:
      *                   0: no interrupt
      */
     void setInterruptStatus(int interrupt);
+    /*!
+     * \brief abortIO
+     * Make the blocking io of other threads, e.g. readFrame() and seek(), return immediately. Following io fails until
+     * abortIO(false) is called. Unlike setInterruptStatus(), no error is reported, and getInterruptTimeout() is not waited.
+     * Used to quit stalled network reads for seeking and stopping. Thread safe
+     */
+    void abortIO(bool value = true);
+    bool isIOAborted() const;
+    /*!
+     * \brief setLoadDeadline
+     * Abort load() if opening and probing take longer than ms in total, no matter whether isInterruptOnTimeout() is true.
+     * getInterruptTimeout() still limits each blocking call.
+     * \param ms <=0: no deadline (default)
+     */
+    void setLoadDeadline(qint64 ms);
+    qint64 loadDeadline() const;
     /*!
      * \brief setOptions
      * libav's AVDictionary. we can ignore the flags used in av_dict_xxx because we can use hash api.
@@ -184,6 +237,54 @@ public:
      */
     void setOptions(const QVariantHash &dict);
     QVariantHash options() const;
+    /*!
+     * \brief setFastStart
+     * Low latency open for live streams. Takes effect in next load().
+     * - probesize and analyzeduration are reduced if not set in options()
+     * - stream parameters probed by a previous load() of the same url fill the parameters the container header does not have
+     * - avformat_find_stream_info() is skipped if all streams have enough parameters to open decoders
+     * Duration, start time and frame rate may be less accurate if probing is skipped.
+     */
+    void setFastStart(bool value);
+    bool isFastStart() const;
+    /*!
+     * \brief probeTime
+     * Time of opening and probing the media (avformat_open_input() + avformat_find_stream_info()) in last load(). In ms.
+     */
+    qint64 probeTime() const;
+    /*!
+     * \brief connectTime
+     * Time of avformat_open_input() in last load(), i.e. connecting and reading the container header. In ms.
+     * probeTime() - connectTime() is the time of probing streams.
+     */
+    qint64 connectTime() const;
+    /*!
+     * \brief setStreamInfoCacheDir
+     * Save probed stream layout, codec parameters and duration of loaded media in dir, keyed by url. A media is validated by
+     * file size and modification time (local file) or size (remote). If the cache is valid, load() skips probing like fast start.
+     * \param dir empty: disable disk cache. probed info is still cached in memory for fast start
+     * \param maxBytes max total size of cache files. the oldest are removed
+     */
+    static void setStreamInfoCacheDir(const QString& dir, qint64 maxBytes = 8*1024*1024);
+    static QString streamInfoCacheDir();
+    /*!
+     * \brief setKeyFrameIndexEnabled
+     * If enabled, buildKeyFrameIndex() is called when a media is loaded
+     */
+    void setKeyFrameIndexEnabled(bool value);
+    bool isKeyFrameIndexEnabled() const;
+    /*!
+     * \brief buildKeyFrameIndex
+     * Scan key frames of current video stream in a background thread. The source is opened again, and only packet flags are read.
+     * AccurateSeek jumps to the indexed key frame directly, then only frames from the key frame to the position are decoded.
+     * The partial index is used while scanning. The index is saved in stream info cache, see setStreamInfoCacheDir().
+     * Call it after loaded. The index is released in unload().
+     * \return false if no video stream, not a seekable media with duration, or the source can not be opened again (e.g. QIODevice)
+     */
+    bool buildKeyFrameIndex();
+    bool hasKeyFrameIndex() const;
+    /// [0, 1]
+    qreal keyFrameIndexProgress() const;
 signals:
     void unloaded();
     void userInterrupted(); //NO direct connection because it's emit before interrupted happens
@@ -194,10 +295,21 @@ signals:
     void error(const QtAV::AVError& e); //explictly use QtAV::AVError in connection for Qt4 syntax
     void mediaStatusChanged(QtAV::MediaStatus status);
     void seekableChanged();
+    // emitted in index thread
+    void keyFrameIndexProgressChanged(qreal value);
+    void keyFrameIndexReady();
+    /*!
+     * \brief loadProgress
+     * Emitted in the thread calling load() when a phase starts. phase: "connect", "probe", "loaded"
+     * \param elapsed time since load() in ms
+     */
+    void loadProgress(const QString& phase, qint64 elapsed);
 private:
     void setMediaStatus(MediaStatus status);
     // error code (errorCode) and message (msg) may be modified internally
     void handleError(int averr, AVError::ErrorCode* errorCode, QString& msg);
+    // 1: packet of selected streams, 0: other stream, <0: error or eof. d->mutex must be locked
+    int readFrameLocked();
 
     class Private;
     QScopedPointer<Private> d;
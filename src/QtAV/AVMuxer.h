@@ -69,12 +69,55 @@ public:
     bool close();
     bool isOpen() const;
 
-    // TODO: copyAudioContext(void* avctx) for copy encoding without decoding
     void copyProperties(VideoEncoder* enc); //rename to setEncoder
     void copyProperties(AudioEncoder* enc);
+    /*!
+     * \brief copyVideoContext
+     * Add a stream with codec parameters of a demuxed stream, e.g. AVDemuxer::videoCodecContext(), to write packets without
+     * decoding and encoding (stream copy). Timestamps of the written packets are Packet::pts and dts, so they can be rebased
+     * by user. Replaces the encoder set by copyProperties(). Call before open()
+     * \param avctx AVCodecContext*. null: no stream copy
+     */
+    void copyVideoContext(void* avctx);
+    void copyAudioContext(void* avctx);
 
     void setOptions(const QVariantHash &dict);
     QVariantHash options() const;
+    /*!
+     * \brief setSegmentDuration
+     * Write fragmented MP4 into memory instead of the media for live streaming, e.g. LL-HLS and DASH. initSegmentReady() is
+     * emitted in open(), then a segment ends at the 1st video key frame (audio packet if no video) after the duration and
+     * segmentReady() is emitted. Format is "mp4" unless forced, and "movflags" option is "frag_custom+empty_moov+default_base_moof"
+     * unless set in options(). Call before open()
+     * \param seconds <= 0: disable (default)
+     */
+    void setSegmentDuration(qreal seconds);
+    qreal segmentDuration() const;
+    /*!
+     * \brief setFragmentDuration
+     * Duration of fragments (CMAF chunks, LL-HLS partial segments) in a segment. fragmentReady() is emitted for each one.
+     * Smaller value means lower latency and more overhead.
+     * \param seconds <= 0: one fragment per segment (default)
+     */
+    void setFragmentDuration(qreal seconds);
+    qreal fragmentDuration() const;
+
+Q_SIGNALS:
+    /*!
+     * Signals of segment output. They are emitted in the thread calling open(), writeAudio(), writeVideo() and close()
+     */
+    void initSegmentReady(const QByteArray& data);
+    /*!
+     * \brief fragmentReady
+     * \param independent true if the fragment starts with a key frame
+     */
+    void fragmentReady(const QByteArray& data, int segment, bool independent);
+    /*!
+     * \brief segmentReady
+     * \param data all fragments of the segment
+     * \param startTime in seconds
+     */
+    void segmentReady(const QByteArray& data, int index, qreal startTime, qreal duration);
 
 public Q_SLOTS:
     // TODO: multiple streams. Packet.type,stream
@@ -82,6 +125,9 @@ public Q_SLOTS:
     bool writeVideo(const QtAV::Packet& packet);
 
 private:
+    // called before writing a packet of the stream where segments are split. timestamp in seconds
+    void checkSegment(const QtAV::Packet& packet);
+    void flushFragment(bool endOfSegment, qreal timestamp);
     class Private;
     QScopedPointer<Private> d;
 };
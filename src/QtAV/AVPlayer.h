@@ -24,11 +24,13 @@
 
 #include <QtCore/QHash>
 #include <QtCore/QScopedPointer>
+#include <QtCore/QThread>
 #include <QtAV/AudioOutput.h>
 #include <QtAV/AVClock.h>
 #include <QtAV/Statistics.h>
 #include <QtAV/VideoDecoderTypes.h>
 #include <QtAV/AVError.h>
+#include <QtAV/FrameDropPolicy.h>
 
 class QIODevice;
 
@@ -81,6 +83,17 @@ public:
      */
     void setFile(const QString& path);
     QString file() const;
+    /*!
+     * \brief setNextFile
+     * Gapless playback. The next media is opened and probed in a loader thread while current media is playing,
+     * its decoders are opened and the first video frame is decoded.
+     * When current media reaches the end, stopped() is emitted, then the next media becomes current media
+     * and starts playing without opening it again. The last frame of current media is displayed until the first frame
+     * of next media is ready, and audio output is not reopened if audio format does not change. nextFile() is cleared after switching.
+     * \param path empty: no next media
+     */
+    void setNextFile(const QString& path);
+    QString nextFile() const;
     //QIODevice support
     void setIODevice(QIODevice* device);
     /*!
@@ -111,10 +124,36 @@ public:
     void unload(); //TODO: emit signal?
     /*!
      * \brief setAsyncLoad
-     * async load is enabled by default
+     * async load is enabled by default. Media is loaded in a thread pool shared by all players, so many players can load
+     * concurrently. See setLoaderThreadCount()
      */
     void setAsyncLoad(bool value = true);
     bool isAsyncLoad() const;
+    /*!
+     * \brief cancelLoad
+     * Abort loading current media. A blocking open or probe returns as soon as possible and mediaStatus() will not
+     * be LoadedMedia. Thread safe. Does nothing if mediaStatus() is not LoadingMedia
+     */
+    void cancelLoad();
+    /*!
+     * \brief setLoadDeadline
+     * Fail loading if opening and probing take longer than ms in total. See AVDemuxer::setLoadDeadline(). Takes effect in next load()
+     * \param ms <=0: no deadline (default). interruptTimeout() still limits each blocking operation
+     */
+    void setLoadDeadline(qint64 ms);
+    qint64 loadDeadline() const;
+    /*!
+     * \brief setLoaderThreadCount
+     * Max number of media loading concurrently in async load. Loading is mainly waiting for io, so it can be much more
+     * than the number of cpu cores. Default is 32 or QThread::idealThreadCount() if it's larger
+     */
+    static void setLoaderThreadCount(int value);
+    static int loaderThreadCount();
+    /*!
+     * \brief players
+     * All AVPlayer instances in the process, in creation order. A player may be destroyed in its thread after the list is returned
+     */
+    static QList<AVPlayer*> players();
     /*!
      * \brief setAutoLoad
      * true: current media source changed immediatly and stop current playback if new media source is set.
@@ -244,6 +283,17 @@ public:
     void setRenderer(VideoRenderer* renderer);
     VideoRenderer* renderer();
     QList<VideoRenderer*> videoOutputs();
+    /*!
+     * \brief setFrameSource
+     * Show the decoded video frames of source in video renderers of this player, e.g. the same camera in several windows
+     * with 1 connection, 1 demuxer and 1 decoder. Do not play a media in this player. Each renderer gets frames through a
+     * latest frame mailbox drained by a thread pool, so a slow renderer drops frames without stalling source and the other
+     * renderers. Frames are converted in the pool if a renderer does not support the format. Video filters of this player
+     * are not applied, audio is not shared. The link is removed if either player is destroyed
+     * \param source null: stop following
+     */
+    void setFrameSource(AVPlayer *source);
+    AVPlayer* frameSource() const;
     /*!
      * \brief audio
      * AVPlayer always has an AudioOutput instance. You can access or control audio output properties through audio().
@@ -253,11 +303,30 @@ public:
     AudioOutput* audio();
     /*!
      * \brief setSpeed set playback speed.
+     * Audio pitch is not changed by default, see AudioOutput::setPreservesPitch()
      * \param speed  speed > 0. 1.0: normal speed
      * TODO: playbackRate
      */
     void setSpeed(qreal speed);
     qreal speed() const;
+    /*!
+     * \brief setTrickPlaySpeed
+     * At speed() >= value, only key frames are read and decoded, each is displayed when the clock reaches it or dropped
+     * before decoding if already late, so fast forward costs about the same at any speed. Audio is not played and the
+     * clock runs by itself. Below it, playback seeks to the current position to decode every frame and audio again.
+     * Not used in reverse playback
+     * \param value default is 4.0. <=0: disable
+     */
+    void setTrickPlaySpeed(qreal value);
+    qreal trickPlaySpeed() const;
+    /*!
+     * \brief setKeyFrameOnlyDecode
+     * Read and decode key frames only at any speed as trick play does, e.g. small or background tiles of a video wall
+     * (see VideoWallManager). Audio is not played and the clock runs by itself, or follows AVClock::setReferenceClock().
+     * Leaving the mode seeks to the current position. Takes effect immediately. Default is false
+     */
+    void setKeyFrameOnlyDecode(bool value);
+    bool isKeyFrameOnlyDecode() const;
 
     /*!
      * \brief setInterruptTimeout
@@ -337,6 +406,212 @@ public:
     // avformat_open_input
     void setOptionsForFormat(const QVariantHash &dict);
     QVariantHash optionsForFormat() const;
+    /*!
+     * \brief setFastStart
+     * Reduce time to first frame for live streams. See AVDemuxer::setFastStart(). Takes effect in next load()
+     */
+    void setFastStart(bool value);
+    bool isFastStart() const;
+    /*!
+     * \brief probeTime
+     * Time spent in opening and probing current media. In ms. Valid after loaded()
+     */
+    qint64 probeTime() const;
+    /*!
+     * \brief connectTime
+     * Time spent in opening current media, i.e. connecting and reading the container header. Part of probeTime(). In ms. Valid after loaded()
+     */
+    qint64 connectTime() const;
+    /*!
+     * \brief openCodecTime
+     * Time spent in opening decoders and outputs when playback starts. In ms
+     */
+    qint64 openCodecTime() const;
+    /*!
+     * \brief setDecoupledDemux
+     * Read audio packets with another demuxer on the same source in a standalone thread, so audio and video buffers are filled
+     * independently. Useful for badly interleaved media (aaaaaavvvvvvaaaaaa), demuxing does not stall when one buffer is full
+     * and the other is empty. Only for media opened by url. Takes effect in next play()
+     */
+    void setDecoupledDemux(bool value);
+    bool isDecoupledDemux() const;
+    /*!
+     * \brief setLiveMode
+     * Low latency playback for live streams, e.g. rtsp cameras. Buffers are in BufferTime mode and capped by liveLatency().
+     * If the backlog exceeds liveLatency(), stale audio packets and video packets until the next key frame are dropped, and the
+     * clock runs slightly faster to catch up. Audio and video threads start without waiting for each other.
+     * Statistics::latency is the current latency. bufferMode(), bufferValue() and adaptive buffering are not used.
+     * Takes effect in next play()
+     */
+    void setLiveMode(bool value);
+    bool isLiveMode() const;
+    /// max latency in msecs in live mode. default is 200
+    void setLiveLatency(int msecs);
+    int liveLatency() const;
+    /*!
+     * \brief setTimeshift
+     * Keep the last msecs of a live stream in memory while playing. Playback can be paused without losing the stream, and
+     * seek() inside timeshiftRange() is done in the recorded packets without network requests. Seeking after the range goes
+     * back to live, i.e. the latest key frame. Recording starts in play(). Not used with setDecoupledDemux(), external audio
+     * tracks and seamless loop, and liveLatency() is not applied.
+     * \param msecs <=0: disable
+     * \param maxBytes max memory of recorded packets. <=0: no limit
+     */
+    void setTimeshift(int msecs, qint64 maxBytes = 0);
+    int timeshift() const;
+    /// recorded range of timeshift in the time base of position(). return false if nothing is recorded
+    bool timeshiftRange(qint64 *start, qint64 *end) const;
+    /*!
+     * \brief startRecording
+     * Save the playing media to fileName without decoding and encoding (stream copy), e.g. record a live stream while viewing
+     * it without a second connection. Demuxed audio and video packets are written by AVMuxer in a standalone thread from the
+     * next video key frame, and timestamps start from 0. A slow disk never blocks playback: packets are dropped until the
+     * next key frame if too many are waiting. Audio of setDecoupledDemux() and external audio tracks is not recorded.
+     * Recording stops in stop() and unload()
+     * \param format output format. empty: guessed from fileName
+     * \return false if not playing
+     */
+    bool startRecording(const QString& fileName, const QString& format = QString());
+    /// write the queued packets and close the file
+    void stopRecording();
+    bool isRecording() const;
+    /*!
+     * \brief setOfflineMode
+     * Process the media as fast as possible, e.g. for transcoding (AVTranscoder) or analysis. Audio and video threads never
+     * wait for the clock and never drop frames, audio is not played, and the clock follows the decoded frames. A thread is
+     * slowed down only by its filters and outputs, e.g. a blocking encoder filter, and the demuxer by full packet buffers.
+     * Takes effect in next play()
+     */
+    void setOfflineMode(bool value);
+    bool isOfflineMode() const;
+    /*!
+     * \brief setPowerSaving
+     * Power efficient playback of audio only media and music with cover art, e.g. background music on mobile. The audio buffer
+     * is refilled about 30s at once, the audio output plays in 100ms periods (AudioOutput::setPowerSaving()), and the cover
+     * is decoded once then the video thread stops, so the cpu can sleep for long between wakeups. Other media, and live mode,
+     * are not affected. bufferMode() and bufferValue() are not used for the audio buffer. Takes effect in next play()
+     */
+    void setPowerSaving(bool value);
+    bool isPowerSaving() const;
+    /*!
+     * \brief setReducedResolutionDecode
+     * Decode at a reduced resolution not smaller than the largest renderer, e.g. 4k videos in small tiles of a video wall.
+     * Only decoders supporting it (FFmpeg lowres) are affected, see VideoDecoder::setOutputSizeHint(). The size is
+     * chosen when decoder is opened, so resizing renderers later does not change it until next play(). Changing the value
+     * while playing reopens the video decoder and seeks to the current position. Default is false
+     */
+    void setReducedResolutionDecode(bool value);
+    bool isReducedResolutionDecode() const;
+    /*!
+     * \brief setBatterySaver
+     * A policy for playback on battery. Video renderers repaint at the content frame rate (VideoRenderer::setPowerSaving()),
+     * including renderers added later, and decoders trade quality for power: reduced resolution decode as
+     * setReducedResolutionDecode(true), and the loop filter is skipped on non key frames if the decoder supports it (FFmpeg
+     * skip_loop_filter) and it is not set in optionsForVideoCodec(). Renderers are changed immediately, decoders in next play()
+     */
+    void setBatterySaver(bool value);
+    bool isBatterySaver() const;
+    /*!
+     * \brief setVideoFilterStage
+     * Run video filters in their own thread, so a slow filter (e.g. deinterlacing) overlaps decoding instead of slowing it
+     * down. Filters must not depend on the thread they run in. Statistics::VideoOnly::filter_stage_frames is the current depth.
+     * Takes effect in next play()
+     * \param frames max frames between decoder and renderer. 0: filters run in video thread (default)
+     */
+    void setVideoFilterStage(int frames);
+    int videoFilterStage() const;
+    /*!
+     * \brief setVideoPresentQueue
+     * Decode video ahead of presentation into a small queue, and present each frame at its due time in another thread, so a
+     * slow frame (e.g. a key frame) is absorbed instead of delaying presentation. Frames of hardware decoders are held
+     * fewer if the decoder runs out of surfaces. Not used with a forced frame rate. Takes effect in next play()
+     * \param frames queue depth, 2~4 is usually enough. 0: no queue (default)
+     */
+    void setVideoPresentQueue(int frames);
+    int videoPresentQueue() const;
+    enum ThreadRole {
+        DemuxThreadRole, // demux thread and the audio reader of setDecoupledDemux()
+        AudioThreadRole,
+        VideoThreadRole, // video decoding and the presenter of setVideoPresentQueue()
+        FilterThreadRole // the filter thread of setVideoFilterStage()
+    };
+    /*!
+     * \brief setThreadPolicy
+     * Scheduling of the pipeline threads of a role, e.g. keep video decoding and audio away from the cpus of background work.
+     * Threads apply it when they start, so it takes effect in next play(). Use VideoFrameExtractorPool::setThreadPolicy()
+     * for frame extraction workers.
+     * \param priority QThread::InheritPriority: unchanged. Default is HighPriority for audio, InheritPriority for others
+     * \param cpuMask cpu affinity. bit i: cpu i. 0: any cpu (default). Not supported on apple platforms
+     */
+    void setThreadPolicy(ThreadRole role, QThread::Priority priority, quint64 cpuMask = 0);
+    QThread::Priority threadPriority(ThreadRole role) const;
+    quint64 threadAffinity(ThreadRole role) const;
+    /*!
+     * \brief setRealtimeAudio
+     * Real-time scheduling for the audio thread where the os allows: SCHED_FIFO on linux (requires CAP_SYS_NICE or
+     * RLIMIT_RTPRIO), MMCSS "Pro Audio" on windows, QOS_CLASS_USER_INTERACTIVE on apple. Falls back to threadPriority()
+     * if it's not allowed. Takes effect in next play()
+     */
+    void setRealtimeAudio(bool value);
+    bool isRealtimeAudio() const;
+    /*!
+     * \brief setFrameDropPolicy
+     * Decides which frames are not decoded or displayed if decoding is too slow. The default is a PredictiveFrameDropPolicy,
+     * which skips non reference frames when the measured decode time exceeds the frame interval. The policy is used by the
+     * video thread of this player only, do not share it with other players. Takes effect immediately
+     * \param policy null: drop frames only after the video is late for a while
+     */
+    void setFrameDropPolicy(const FrameDropPolicyPtr& policy);
+    FrameDropPolicyPtr frameDropPolicy() const;
+    /*!
+     * \brief setFieldRateOutput
+     * Display each field of interlaced frames, e.g. 1080i50 is displayed at 50fps. Renderers must deinterlace in shader,
+     * see OpenGLVideo::setDeinterlaceMode(). Progressive frames are not affected. Takes effect in next play(). Default is false
+     */
+    void setFieldRateOutput(bool value);
+    bool isFieldRateOutput() const;
+    /*!
+     * \brief setFastFirstFrame
+     * Display the first decoded video frame at once as a poster, while the clock is not running and queues are still
+     * buffering, even if paused. The clock starts after the audio preroll is written to the device, or after the poster is
+     * displayed if no audio is played. Not used with a forced frame rate. Takes effect in next play(). Default is false
+     */
+    void setFastFirstFrame(bool value);
+    bool isFastFirstFrame() const;
+    /*!
+     * \brief setSeamlessLoop
+     * Repeat (see setRepeat()) from startPosition() to stopPosition() or the end without stopping or flushing decoders, so
+     * A-B loops are frame accurate without a gap. The demuxer goes back to the key frame before startPosition() while the
+     * tail is still playing, and frames before startPosition() are decoded but not displayed. Timestamps and the clock keep
+     * increasing, position() is the media position. The media must be seekable. External audio is repeated by seeking.
+     * Default is false
+     */
+    void setSeamlessLoop(bool value);
+    bool isSeamlessLoop() const;
+    /*!
+     * \brief setReversePlayback
+     * Play video backward from the current position at speed(). A GOP is decoded into a cache bounded by
+     * setReverseCacheSize() and displayed from the last frame, while the demuxer reads the GOP before it. Audio is not
+     * played. false: continue forward from the current position. Only when playing and seekable. Reset when stopped
+     */
+    void setReversePlayback(bool value);
+    bool isReversePlayback() const;
+    /*!
+     * \brief setReverseCacheSize
+     * Memory of decoded frames of a GOP in reverse playback and stepBackward(). If exceeded, every other frame is displayed.
+     * Takes effect when reverse playback starts
+     * \param bytes default is 256MB. <=0: no limit
+     * \param downscale cache frames scaled down to the size of video output
+     */
+    void setReverseCacheSize(qint64 bytes, bool downscale = false);
+    qint64 reverseCacheSize() const;
+    /*!
+     * \brief setKeyFrameIndexEnabled
+     * Build key frame index in background when loaded, then AccurateSeek decodes only the frames from the key frame before the position.
+     * Progress is reported by keyFrameIndexProgressChanged(). See AVDemuxer::buildKeyFrameIndex()
+     */
+    void setKeyFrameIndexEnabled(bool value);
+    bool isKeyFrameIndexEnabled() const;
     // avcodec_open2. TODO: the same for audio/video codec?
     /*!
      * \sa AVDecoder::setOptions()
@@ -365,7 +640,12 @@ public slots:
     void stop();
     void playNextFrame(); //deprecated
     //void stepForward();
-    //void stepBackward();
+    /*!
+     * \brief stepBackward
+     * Pause and display the previous frame. Frames of the GOP are cached, so stepping again is fast.
+     * pause(false) continues forward unless isReversePlayback()
+     */
+    void stepBackward();
 
     void setRelativeTimeMode(bool value);
     /*!
@@ -406,6 +686,14 @@ public slots:
     void setPosition(qint64 position);
     void seek(qreal r); // r: [0, 1]
     void seek(qint64 pos); //ms. same as setPosition(pos)
+    /*!
+     * \brief seek
+     * Seek with a given type instead of seekType(). Requests not processed yet are dropped, only the latest one is executed.
+     * Dragging a slider can use PreviewSeek when moving and AccurateSeek when released. isPaused() is true when a PreviewSeek
+     * finishes until the next seek
+     * \param pos ms
+     */
+    void seek(qint64 pos, SeekType type);
     void seekForward();
     void seekBackward();
     void setSeekType(SeekType type);
@@ -432,6 +720,14 @@ public slots:
      */
     void setBufferValue(qint64 value);
     int bufferValue() const;
+    /*!
+     * \brief setAdaptiveBuffering
+     * Adjust the buffer value while playing, from 1/4 to 8 times of bufferValue() (or the auto value), depending on
+     * input speed, bit rate and underruns. Live streams settle at a small buffer, and VOD grows after stalls.
+     * bufferValueChanged() is emitted with the new value. bufferValue() is not changed.
+     */
+    void setAdaptiveBuffering(bool value);
+    bool isAdaptiveBuffering() const;
 
     /*!
      * \brief setNotifyInterval
@@ -450,12 +746,20 @@ public slots:
 
 Q_SIGNALS:
     void bufferProgressChanged(qreal);
+    void bufferValueChanged(qint64 value); // emitted by adaptive buffering
     void relativeTimeModeChanged();
     void autoLoadChanged();
     void asyncLoadChanged();
     void muteChanged();
     void sourceChanged();
     void loaded(); // == mediaStatusChanged(QtAV::LoadedMedia)
+    /*!
+     * \brief loadProgress
+     * Emitted when a phase of loading and starting playback begins. phase: "connect", "probe", "loaded" (emitted in loader
+     * thread, see AVDemuxer::loadProgress()), "openCodec" and "ready" (decoders are open)
+     * \param elapsed time since loading started in ms
+     */
+    void loadProgress(const QString& phase, qint64 elapsed);
     void mediaStatusChanged(QtAV::MediaStatus status); //explictly use QtAV::MediaStatus
     /*!
      * \brief durationChanged emit when media is loaded/unloaded
@@ -471,6 +775,7 @@ Q_SIGNALS:
     void startPositionChanged(qint64 position);
     void stopPositionChanged(qint64 position);
     void seekableChanged();
+    void keyFrameIndexProgressChanged(qreal value);
     void seekFinished();
     void positionChanged(qint64 position);
     void interruptTimeoutChanged();
@@ -37,6 +37,11 @@ public:
     ~AVTranscoder();
 
     // TODO: other source (more operations needed, e.g. seek)?
+    /*!
+     * \brief setMediaSource
+     * For batch transcoding enable AVPlayer::setOfflineMode() of the player, then it runs as fast as the encoders can go
+     * instead of in real time, and no frame is dropped.
+     */
     void setMediaSource(AVPlayer* player);
     AVPlayer* sourcePlayer() const;
 
@@ -86,6 +91,30 @@ public:
      * \return Encoder instance or null if createAudioEncoder failed
      */
     AudioEncoder* audioEncoder() const;
+    /*!
+     * \brief setAsync
+     * If true, video and audio are encoded in their own threads(see VideoEncodeFilter::setAsync()), and packets are muxed in
+     * another thread in dts order, so decoding, encoding and muxing overlap. Otherwise encoders run in the player's threads and
+     * packets are written there. Set before start(). Default is false.
+     */
+    void setAsync(bool value);
+    bool isAsync() const;
+    /*!
+     * \brief setStreamCopy
+     * Copy video and/or audio packets of sourcePlayer()->file() to output without decoding and encoding, e.g. to change the
+     * container or to trim. The player is not played, only its startPosition() and stopPosition() are used. The output starts
+     * at the key frame before startPosition() and timestamps start from 0. Streams not copied are not written, and encoders
+     * are not used. stopped() is emitted when all packets are written. Set before start()
+     */
+    void setStreamCopy(bool video, bool audio);
+    bool isStreamCopy() const;
+    /*!
+     * \brief setTimeRange
+     * Encode only frames with timestamp in [start, stop), in seconds of source media time(Frame::timestamp()), and stop the
+     * source player when frames of all encoded streams reach stop. Unlike AVPlayer::stopPosition(), the range is frame
+     * accurate. Set before start(). Default is all frames
+     */
+    void setTimeRange(qreal start, qreal stop);
     /*!
      * \brief isRunning
      * \return true if encoding started
@@ -120,6 +149,7 @@ public Q_SLOTS:
 
 private Q_SLOTS:
     void onSourceStarted();
+    void onTimeRangeEnded();
     void prepareMuxer();
     void writeAudio(const QtAV::Packet& packet);
     void writeVideo(const QtAV::Packet& packet);
@@ -68,6 +68,12 @@ public:
      */
     const AudioFormat& audioFormat() const;
     void setAudioFormat(const AudioFormat& format);
+    /*!
+     * \brief frameSize
+     * Samples per channel of every frame passed to encode() except the last one. Valid after open().
+     * \return 0 if frames of any size can be encoded
+     */
+    int frameSize() const;
 Q_SIGNALS:
     void audioFormatChanged();
 protected:
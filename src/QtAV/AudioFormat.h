@@ -120,7 +120,7 @@ public:
     int sampleFormatFFmpeg() const;
     QString sampleFormatName() const;
 
-    // Helper functions
+    // Helper functions. coefficients are cached when the format changes, and integer conversions are exact (rounded down)
     // in microseconds
     qint32 bytesForDuration(qint64 duration) const;
     qint64 durationForBytes(qint32 byteCount) const;
@@ -131,6 +131,9 @@ public:
     // in microseconds
     qint32 framesForDuration(qint64 duration) const;
     qint64 durationForFrames(qint32 frameCount) const;
+    // 64 bit frame counts for timestamps, e.g. pts = start + secondsForFrames(frames written since start)
+    qreal secondsForFrames(qint64 frameCount) const;
+    qint64 framesForSeconds(qreal seconds) const;
 
     // 1 frame = 1 sample with channels
     /*!
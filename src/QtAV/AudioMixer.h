@@ -0,0 +1,72 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_AUDIOMIXER_H
+#define QTAV_AUDIOMIXER_H
+
+#include <QtAV/AudioFormat.h>
+
+/*!
+ * Play audio of several players by one device stream:
+ * foreach (AVPlayer *player, players)
+ *     player->audio()->setBackends(QStringList() << QStringLiteral("Mixer"));
+ * player->audio()->setVolume(0.5); // volume of a source
+ * player->audio()->setMute(true); // not heard, still in sync
+ */
+namespace QtAV {
+
+class AudioOutput;
+class AudioMixerPrivate;
+/*!
+ * \brief The AudioMixer class
+ * The in-process mixer used by AudioOutput with the "Mixer" backend. Every such output is a source of the mixer. Sources
+ * are resampled to audioFormat() if sample rates are different, scaled by volume and summed in a mixer thread which plays
+ * the result by output(). The output is opened when the first source is opened, and closed when the last one is closed.
+ */
+class Q_AV_EXPORT AudioMixer
+{
+    DPTR_DECLARE_PRIVATE(AudioMixer)
+public:
+    static AudioMixer& instance();
+    /*!
+     * \brief output
+     * The device output. Backends, buffer size and volume can be changed before the first source is opened.
+     * The "Mixer" backend can not be used for it.
+     */
+    AudioOutput* output() const;
+    /*!
+     * \brief setAudioFormat
+     * Format of the mixed data. The sample format is always packed float, and sources must use the same channel layout.
+     * Takes effect when the first source is opened. default is 48000Hz stereo
+     */
+    void setAudioFormat(const AudioFormat& format);
+    AudioFormat audioFormat() const;
+    /// number of opened sources
+    int sourceCount() const;
+private:
+    AudioMixer();
+    ~AudioMixer();
+    Q_DISABLE_COPY(AudioMixer)
+    friend class AudioOutputMixer;
+    DPTR_DECLARE(AudioMixer)
+};
+} //namespace QtAV
+#endif //QTAV_AUDIOMIXER_H
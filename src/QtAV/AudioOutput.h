@@ -26,6 +26,7 @@
 #include <QtCore/QStringList>
 #include <QtAV/AVOutput.h>
 #include <QtAV/AudioFrame.h>
+#include <QtAV/Statistics.h>
 
 /*!
  * AudioOutput ao;
@@ -80,6 +81,8 @@ public:
      * \brief setBackends
      * set the given backends. Old backend instance and backend() is updated soon if backendsChanged.
      * It is called internally with a default backend names when AudioOutput is created.
+     * The backend is created when it's used the first time, e.g. by open(), backend() or isSupported(), so an output
+     * never opened does not load the audio library or connect to the sound server.
      */
     void setBackends(const QStringList &backendNames = QStringList());
     QStringList backends() const;
@@ -100,6 +103,21 @@ public:
      * \return true if play successfully
      */
     bool play(const QByteArray& data, qreal pts = 0.0);
+    /*!
+     * \brief play
+     * The same as play(data, pts). If volumeApplied is true, data is already scaled by softwareVolume(), e.g. by AudioResampler
+     * while converting, and it's not scaled again.
+     */
+    bool play(const QByteArray& data, qreal pts, bool volumeApplied);
+    /*!
+     * \brief play
+     * Play the whole frame at frame.timestamp(), its size must not be greater than bufferSize(). Backends queueing buffers,
+     * e.g. OpenSL and XAudio2, keep a reference of frame data until it's played instead of copying, so frame data must not
+     * be modified after this call, and must not be QByteArray::fromRawData(). Frames from AudioFrame::to() and clone() use
+     * recycled buffers, so no allocation is required for each frame.
+     * \param volumeApplied see play(data, pts, volumeApplied)
+     */
+    bool play(const AudioFrame& frame, bool volumeApplied = false);
     void setAudioFormat(const AudioFormat& format);
     AudioFormat& audioFormat();
     const AudioFormat& audioFormat() const;
@@ -117,6 +135,11 @@ public:
      */
     void setVolume(qreal value);
     qreal volume() const;
+    /*!
+     * \brief softwareVolume
+     * The gain play() applies to data by software. 1.0 if the volume is set by backend api
+     */
+    qreal softwareVolume() const;
     /*!
      * \brief setMute
      * If SetMute feature is not set or not supported, software implemention will be used.
@@ -126,15 +149,22 @@ public:
     bool isMute() const;
     /*!
      * \brief setSpeed  set audio playing speed
-     * Currently only store the value and does nothing else in audio output. You may change sample rate to get the same effect.
+     * Only store the value. AVPlayer's audio thread changes the tempo of data played by this output, by time-stretching if
+     * preservesPitch() is true, otherwise by resampling.
      * The speed affects the playing only if audio is available and clock type is
      * audio clock. For example, play a video contains audio without special configurations.
      * To change the playing speed in other cases, use AVPlayer::setSpeed(qreal)
      * \param speed linear. > 0
-     * TODO: resample internally
      */
     void setSpeed(qreal speed);
     qreal speed() const;
+    /*!
+     * \brief setPreservesPitch
+     * If true (default), speed() is changed by time-stretching (WSOLA) so that voice sounds natural, e.g. 1.5x speech. Only
+     * packed s16 and float formats are supported, others are resampled. If false, data is resampled and pitch shifts with speed.
+     */
+    void setPreservesPitch(bool value);
+    bool preservesPitch() const;
     /*!
      * \brief isSupported
      *  check \a isSupported(format.sampleFormat()) and \a isSupported(format.channelLayout())
@@ -165,6 +195,50 @@ public:
     int bufferCount() const;
     void setBufferCount(int value);
     int bufferSizeTotal() const { return bufferCount() * bufferSize();}
+    /*!
+     * \brief setLowLatency
+     * Low latency profile, e.g. for live monitoring. open() replaces bufferSize() and bufferCount() with about 20ms of small
+     * chunks, and the backend negotiates the smallest stable period of the device, e.g. pulseaudio tlength/minreq.
+     * Call before open(). default is false
+     */
+    void setLowLatency(bool value);
+    bool isLowLatency() const;
+    /*!
+     * \brief setPowerSaving
+     * Power saving profile, e.g. for background music. open() replaces bufferSize() and bufferCount() with 8 chunks of 100ms,
+     * and AVPlayer's audio thread joins decoded frames into whole chunks, so the device and the thread wake up rarely.
+     * Ignored if isLowLatency(). Call before open(). default is false
+     */
+    void setPowerSaving(bool value);
+    bool isPowerSaving() const;
+    /*!
+     * \brief setPassthrough
+     * Send compressed AC3, E-AC3 and DTS streams to the receiver (SPDIF/HDMI) as IEC 61937 bursts instead of decoding them,
+     * if supported by the backend, see isPassthroughSupported(). Volume, speed and audio filters have no effect on such
+     * streams. Other codecs and unsupported devices are decoded as usual. Takes effect when a stream is opened. default is false
+     */
+    void setPassthrough(bool value);
+    bool isPassthrough() const;
+    /// codecId: FFmpeg codec id
+    bool isPassthroughSupported(int codecId) const;
+    /*!
+     * \brief setPassthroughCodec
+     * For internal use. FFmpeg codec id of the bursts written by play(). 0: PCM. Call before open() with the burst format.
+     */
+    void setPassthroughCodec(int codecId);
+    int passthroughCodec() const;
+    /*!
+     * \brief latency
+     * Measured time in seconds from the data taken by the backend to the data being heard. timestamp() - latency() is the
+     * timestamp of the sound playing now. 0 if the backend can not measure it
+     */
+    qreal latency() const;
+    /*!
+     * \brief getTimingStatistics
+     * Copy the backend name, callback interval, buffer fill level and wait time histograms and underrun count since
+     * open() to st. Values written by the device callback thread are read without locking and may be 1 sample behind
+     */
+    void getTimingStatistics(Statistics::AudioOnly* st) const;
     /*!
      * \brief setDeviceFeatures
      * Unsupported features will not be set.
@@ -186,6 +260,11 @@ public:
 signals:
     void volumeChanged(qreal);
     void muteChanged(bool);
+    /*!
+     * \brief underrun
+     * The device ran out of data and played silence. count is the total underruns since open()
+     */
+    void underrun(int count);
     void deviceFeaturesChanged();
     void backendsChanged();
 protected:
@@ -200,7 +279,9 @@ private Q_SLOTS:
     void reportVolume(qreal value);
     void reportMute(bool value);
 private:
+    void ensureBackend() const;
     void onCallback();
+    int pullData(char* data, int bytes);
     friend class AudioOutputBackend;
     Q_DISABLE_COPY(AudioOutput)
 };
@@ -52,6 +52,23 @@ public:
     //speed: >0, default is 1
     void setSpeed(qreal speed); //out_sample_rate = out_sample_rate/speed
     qreal speed() const;
+    /*!
+     * \brief setVolume
+     * Linear gain applied while converting, so the output samples are not scaled again by another pass.
+     * Call prepare() if changed. Check isVolumeApplied() after prepare(), not all resamplers and parameters support it
+     * \param volume >= 0. default is 1.0
+     */
+    void setVolume(qreal volume);
+    qreal volume() const;
+    /// true if outData() is scaled by volume(). always true if volume() is 1.0
+    bool isVolumeApplied() const;
+    /*!
+     * \brief isPassthrough
+     * true if prepare() finds the input is already in the output format and speed is 1.0. Then convert() only copies the
+     * samples and no resampling library is used. It's checked again by prepare() if format or speed is changed.
+     * volume() is not applied in this mode
+     */
+    bool isPassthrough() const;
 
     void setInAudioFormat(const AudioFormat& format);
     AudioFormat& inAudioFormat();
@@ -0,0 +1,81 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_COLORLUT_H
+#define QTAV_COLORLUT_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QByteArray>
+#include <QtCore/QSharedDataPointer>
+#include <QtCore/QString>
+#include <QtGui/QVector3D>
+
+namespace QtAV {
+
+/*!
+ * \brief The ColorLUT class
+ * A 3D color lookup table, e.g. a camera LUT, a grading look or a broadcast safe legalizer. OpenGL renderers apply it after
+ * yuv to rgb conversion in shader with trilinear interpolation, see OpenGLVideo::setColorLUT().
+ * Implicitly shared.
+ */
+class Q_AV_EXPORT ColorLUT
+{
+public:
+    /*!
+     * \brief fromCube
+     * Load a 3D LUT in .cube format (Adobe/Resolve). 1D LUTs are not supported.
+     * \return an invalid LUT if failed
+     */
+    static ColorLUT fromCube(const QString& fileName);
+    ColorLUT();
+    /*!
+     * \brief ColorLUT
+     * An identity LUT of size entries per channel. Modify it by setValue()
+     */
+    explicit ColorLUT(int size);
+    ~ColorLUT();
+    bool isValid() const;
+    /// entries per channel, 2~kMaxSize
+    int size() const;
+    // r, g, b: 0 ~ size()-1. components of value are clamped to [0, 1]
+    void setValue(int r, int g, int b, const QVector3D& value);
+    QVector3D value(int r, int g, int b) const;
+    /*!
+     * \brief setDomain
+     * Input range mapped to the first and the last entries. Default is [0, 1] for all channels
+     */
+    void setDomain(const QVector3D& min, const QVector3D& max);
+    QVector3D domainMin() const;
+    QVector3D domainMax() const;
+    /*!
+     * \brief data
+     * Entries as rgba8 texels of a size()*size() x size() image. Texel (r + b*size(), g) is the output of (r, g, b)
+     */
+    QByteArray data() const;
+
+    enum { kMaxSize = 128 };
+private:
+    class Private;
+    QSharedDataPointer<ColorLUT::Private> d;
+};
+
+} //namespace QtAV
+#endif // QTAV_COLORLUT_H
@@ -41,8 +41,13 @@ class ColorTransform
 {
 public:
     //http://msdn.microsoft.com/en-us/library/dd206750.aspx
-    // cs: BT601 or BT709
+    // cs: BT601, BT709 or BT2020
     static const QMatrix4x4& YUV2RGB(ColorSpace cs);
+    /*!
+     * \brief gamutMatrix
+     * Transform linear rgb of primaries from to linear rgb of primaries to. Out of gamut colors have negative components.
+     */
+    static QMatrix3x3 gamutMatrix(ColorPrimaries from, ColorPrimaries to);
 
     ColorTransform();
     ~ColorTransform(); //required by QSharedDataPointer if Private is forward declared
@@ -54,7 +54,10 @@ enum SeekUnit {
 enum SeekType {
     AccurateSeek, // slow
     KeyFrameSeek, // fast
-    AnyFrameSeek
+    AnyFrameSeek,
+    // fastest. only the key frame before the position is decoded and displayed, then playback holds until the next seek. no audio.
+    // e.g. seek while dragging a slider and AccurateSeek on release. KeyFrameSeek if no video
+    PreviewSeek
 };
 
 //http://www.itu.int/dms_pubrec/itu-r/rec/bt/R-REC-BT.709-5-200204-I!!PDF-E.pdf
@@ -64,7 +67,35 @@ enum ColorSpace {
     ColorSpace_RGB,
     ColorSpace_GBR, // for planar gbr format(e.g. video from x264) used in glsl
     ColorSpace_BT601,
-    ColorSpace_BT709
+    ColorSpace_BT709,
+    ColorSpace_BT2020 // non-constant luminance
+};
+
+// transfer characteristics of a video frame or a display
+enum ColorTransfer {
+    ColorTransfer_SDR, // BT.709/BT.1886 gamma, also used if unknown
+    ColorTransfer_PQ, // SMPTE ST 2084, HDR10
+    ColorTransfer_HLG // ARIB STD-B67
+};
+
+enum ColorPrimaries {
+    ColorPrimaries_BT709, // also used if unknown. BT.601 primaries are close enough
+    ColorPrimaries_BT2020
+};
+
+// how OpenGL renderers map the luminance of frames brighter than the display, see OpenGLVideo::setToneMapping()
+enum ToneMapping {
+    ToneMappingClip,
+    ToneMappingHable, // filmic curve from Uncharted 2
+    ToneMappingBT2390 // EETF of ITU-R BT.2390
+};
+
+// rendering of interlaced frames, see VideoFrame::isInterlaced()
+enum DeinterlaceMode {
+    NoDeinterlace, // weave. fields are displayed as is
+    DeinterlaceBob, // the lines of the other field are interpolated
+    DeinterlaceBlend, // lines of both fields are blended. fields of a frame are not displayed at different time
+    DeinterlaceMotionAdaptive // weave where the 2 fields match, interpolate where they comb (i.e. moving)
 };
 
 enum SurfaceType {
@@ -74,6 +105,7 @@ enum SurfaceType {
     VAAPISurface,
     DXVASurface,
     CUDASurface,
+    DmaBufSurface,
     UnknownSurface
 };
 
@@ -29,6 +29,7 @@
 
 namespace QtAV {
 
+template<typename F, class T> class EncodeThread;
 class AudioEncoder;
 class AudioEncodeFilterPrivate;
 class Q_AV_EXPORT AudioEncodeFilter : public AudioFilter
@@ -52,7 +53,27 @@ public:
      * \return Encoder instance or null if createEncoder failed
      */
     AudioEncoder* encoder() const;
-    // TODO: async property
+    /*!
+     * \brief setAsync
+     * If true, frames are queued(at most 32) and encoded in a worker thread of the filter, including the format conversion, so the
+     * thread applying filters does not wait for the encoder. readyToEncode() and frameEncoded() are emitted in the worker thread.
+     * Queued frames share data with the source frames, so filters after this one must not modify frame data.
+     * Default is false
+     */
+    void setAsync(bool value);
+    bool isAsync() const;
+    /*!
+     * \brief finish
+     * Wait for queued frames to be encoded and stop the worker thread, then encode samples not enough for
+     * AudioEncoder::frameSize() as the last frame. Call it after the filter is uninstalled.
+     */
+    void finish();
+    /*!
+     * \brief setTimeRange
+     * Encode only frames with timestamp in [start, stop), in seconds of Frame::timestamp(). timeRangeEnded() is emitted once
+     * when the first frame after the range comes. Default is all frames
+     */
+    void setTimeRange(qreal start, qreal stop);
 
 Q_SIGNALS:
     /*!
@@ -62,10 +83,13 @@ Q_SIGNALS:
      */
     void readyToEncode();
     void frameEncoded(const QtAV::Packet& packet);
+    void timeRangeEnded();
 
 protected:
     virtual void process(Statistics* statistics, AudioFrame* frame = 0) Q_DECL_OVERRIDE;
     void encode(const AudioFrame& frame = AudioFrame());
+private:
+    template<typename F, class T> friend class EncodeThread;
 };
 
 class VideoEncoder;
@@ -91,7 +115,26 @@ public:
      * \return Encoder instance or null if createEncoder failed
      */
     VideoEncoder* encoder() const;
-    // TODO: async property
+    /*!
+     * \brief setAsync
+     * If true, frames are queued(at most 8) and encoded in a worker thread of the filter, including the format conversion, so the
+     * thread applying filters does not wait for the encoder. readyToEncode() and frameEncoded() are emitted in the worker thread.
+     * Queued frames share data with the source frames, so filters after this one must not modify frame data.
+     * Default is false
+     */
+    void setAsync(bool value);
+    bool isAsync() const;
+    /*!
+     * \brief finish
+     * Wait for queued frames to be encoded and stop the worker thread. Call it after the filter is uninstalled.
+     */
+    void finish();
+    /*!
+     * \brief setTimeRange
+     * Encode only frames with timestamp in [start, stop), in seconds of Frame::timestamp(). timeRangeEnded() is emitted once
+     * when the first frame after the range comes. Default is all frames
+     */
+    void setTimeRange(qreal start, qreal stop);
 
 Q_SIGNALS:
     /*!
@@ -101,10 +144,13 @@ Q_SIGNALS:
      */
     void readyToEncode();
     void frameEncoded(const QtAV::Packet& packet);
+    void timeRangeEnded();
 
 protected:
     virtual void process(Statistics* statistics, VideoFrame* frame = 0) Q_DECL_OVERRIDE;
     void encode(const VideoFrame& frame = VideoFrame());
+private:
+    template<typename F, class T> friend class EncodeThread;
 };
 
 } //namespace QtAV
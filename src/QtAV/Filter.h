@@ -25,6 +25,7 @@
 #include <QtCore/QObject>
 #include <QtAV/QtAV_Global.h>
 #include <QtAV/FilterContext.h>
+#include <QtAV/Statistics.h>
 
 namespace QtAV {
 
@@ -56,6 +57,18 @@ public:
     void setOwnedByTarget(bool value = true);
     // default is false
     bool isOwnedByTarget() const;
+    /*!
+     * \brief setProfilingEnabled
+     * Measure every apply() of all filters. Disabled by default, then applying a filter only checks the flag.
+     */
+    static void setProfilingEnabled(bool value);
+    static bool isProfilingEnabled();
+    /*!
+     * \brief timing
+     * Thread safe copy of the cost measured since profiling is enabled or resetTiming(). See FilterManager::timings()
+     */
+    Statistics::FilterTiming timing() const;
+    void resetTiming();
     // setInput/Output: no need to call installTo
     // bool setInput(Filter*);
     // bool setOutput(Filter*);
@@ -84,6 +97,20 @@ public:
 
     VideoFilterContext* context();
     virtual VideoFilterContext::Type contextType() const;
+    /*!
+     * \brief isReadOnly
+     * Reimplement and return true if process() only reads the frame and has no side effect on other filters, e.g. histogram
+     * or motion detection. Consecutive read only filters of a video thread run concurrently in a thread pool on the same
+     * frame, so process() must not modify the frame, the statistics or shared data without locking.
+     * Ignored if contextType() is not None. Default is false
+     */
+    virtual bool isReadOnly() const;
+    /*!
+     * \brief needsEveryFrame
+     * Reimplement and return false if the filter only affects displayed frames, e.g. an overlay, then it's not applied on
+     * frames the video thread drops to catch up. Encoders, analytics and stateful filters need every frame. Default is true
+     */
+    virtual bool needsEveryFrame() const;
     bool installTo(AVPlayer *player);
     /*
      * filter.installTo(target,...) calls target.installFilter(filter)
@@ -102,6 +129,10 @@ public:
 protected:
     VideoFilter(VideoFilterPrivate& d, QObject *parent = 0);
     virtual void process(Statistics* statistics, VideoFrame* frame = 0) = 0;
+private:
+    // called by the video thread if the filter is not applied to a dropped frame
+    void skip();
+    friend class VideoThreadPrivate;
 };
 
 class AudioFrame;
@@ -114,6 +145,16 @@ public:
     AudioFilter(QObject* parent = 0);
     bool installTo(AVPlayer *player);
     void apply(Statistics* statistics, AudioFrame *frame = 0);
+    /*!
+     * \brief blockSize
+     * Reimplement and return the samples per channel process() requires, e.g. 256 or 512. Then decoded frames are converted to
+     * planar float (AudioFormat::SampleFormat_FloatPlanar, the same rate and channels) and accumulated by the audio thread,
+     * and process() is called with frames of exactly blockSize() samples, so DSP code can use fixed size vector loops without
+     * checking the format. process() must modify the samples in place, and must not change the format or size of the frame.
+     * Consecutive filters of the same block size share the buffer. Output is delayed by less than a block.
+     * 0 (default): process() is called with decoded frames as is
+     */
+    virtual int blockSize() const;
 protected:
     AudioFilter(AudioFilterPrivate& d, QObject *parent = 0);
     virtual void process(Statistics* statistics, AudioFrame* frame = 0) = 0;
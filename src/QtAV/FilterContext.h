@@ -35,6 +35,7 @@ class QPaintDevice;
 class QTextDocument;
 namespace QtAV {
 
+class OpenGLVideo;
 class VideoFrame;
 class Q_AV_EXPORT VideoFilterContext
 {
@@ -80,6 +81,11 @@ public:
      */
     QPaintDevice *paint_device;
     int video_width, video_height; //original size
+    /*
+     * set by OpenGL renderers. filters can draw on gpu with it between painter->beginNativePainting() and endNativePainting()
+     * 0 if not rendered by OpenGLVideo
+     */
+    OpenGLVideo *opengl;
 
 protected:
     bool own_painter;
@@ -25,15 +25,44 @@
 #include <QtAV/QtAV_Global.h>
 #include <QtCore/QVariant>
 #include <QtCore/QSharedData>
+#include <QtCore/QSharedPointer>
 
 // TODO: fromAVFrame() asAVFrame()?
+struct AVFrame;
 namespace QtAV {
 
+/*!
+ * \brief The FrameBuffer class
+ * Owner of the buffers planes of a frame point to, e.g. a ref counted AVFrame. See Frame::setBufferRef()
+ */
+class Q_AV_EXPORT FrameBuffer
+{
+public:
+    virtual ~FrameBuffer() {}
+    /// the AVFrame planes point to, e.g. to feed libavfilter without copy. null if not an AVFrame
+    virtual const AVFrame* avframe() const { return 0;}
+};
+typedef QSharedPointer<FrameBuffer> FrameBufferRef;
+
 class FramePrivate;
 class Q_AV_EXPORT Frame
 {
     Q_DECLARE_PRIVATE(Frame)
 public:
+    /*!
+     * \brief The SideData enum
+     * Typed side data set for every frame, stored in the frame without allocation or a hash insert. metaData() and
+     * setMetaData() of the key in comment use it too.
+     */
+    enum SideData {
+        PictureType, // "pict_type". AVPictureType
+        DemuxTime, // "latency_demux". for latency tracing. ns, see Statistics::tracingTime()
+        DecodedTime, // "latency_decoded"
+        FilteredTime, // "latency_filtered"
+        SentTime, // "latency_sent"
+        DecodeDuration, // "decode_time". us
+        SideDataCount
+    };
     Frame(const Frame& other);
     virtual ~Frame() = 0;
     Frame& operator =(const Frame &other);
@@ -91,6 +120,17 @@ public:
     QVariantMap availableMetaData() const;
     QVariant metaData(const QString& key) const;
     void setMetaData(const QString &key, const QVariant &value);
+    bool hasSideData(SideData key) const;
+    /// 0 if not set
+    qint64 sideData(SideData key) const;
+    void setSideData(SideData key, qint64 value);
+    /*!
+     * \brief setBufferRef
+     * Keep ref alive as long as the frame or a copy sharing its planes exists, e.g. the AVFrame the planes point to.
+     * It replaces metadata "avframe_hoder_ref" and "avbuf".
+     */
+    void setBufferRef(const FrameBufferRef& ref);
+    FrameBufferRef bufferRef() const;
     void setTimestamp(qreal ts);
     qreal timestamp() const;
     inline void swap(Frame &other) { qSwap(d_ptr, other.d_ptr); }
@@ -0,0 +1,114 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_FRAMEDROPPOLICY_H
+#define QTAV_FRAMEDROPPOLICY_H
+
+#include <QtCore/QSharedPointer>
+#include <QtAV/QtAV_Global.h>
+
+namespace QtAV {
+/*!
+ * \brief The FrameDropPolicy class
+ * Decides which video frames are not decoded or not displayed when decoding can not keep up with the clock. It's called
+ * by the video thread only, so an instance must not be shared by players. Set by AVPlayer::setFrameDropPolicy().
+ * Without a policy, frames are dropped only after the video is late for a while.
+ */
+class Q_AV_EXPORT FrameDropPolicy
+{
+public:
+    enum PictureType {
+        UnknownPicture, ///< the decoder does not report picture types
+        IPicture,
+        PPicture,
+        BPicture ///< usually not a reference frame
+    };
+    enum Decision {
+        DecodeAll, ///< decode and display normally
+        DropNonRef, ///< decode with skip_frame nonref. Decoders discard frames no other frame depends on, references are intact
+        DropToKeyFrame ///< drop packets until the next key frame. The picture freezes until then
+    };
+    virtual ~FrameDropPolicy() {}
+    /*!
+     * \brief reset
+     * A seek or decoder change. Timing after it is not related to the previous frames, but measured costs are still valid
+     */
+    virtual void reset() {}
+    /*!
+     * \brief frameDecoded
+     * A frame is output by the decoder.
+     * \param decodeTime usecs spent in VideoDecoder::decode() for the frame
+     */
+    virtual void frameDecoded(PictureType type, qint64 decodeTime) = 0;
+    /*!
+     * \brief decide
+     * Called before a packet is decoded.
+     * \param lateness seconds the packet is behind its due time of the clock. < 0: ahead of the clock
+     * \param frameInterval seconds between 2 frames at current speed, i.e. the budget of decoding and displaying a frame
+     * \param keyFrame the packet is a key frame. DropToKeyFrame for a key frame is treated as DropNonRef
+     */
+    virtual Decision decide(qreal lateness, qreal frameInterval, bool keyFrame) = 0;
+    /*!
+     * \brief render
+     * Called after a frame is decoded. Return false to skip displaying it. Decoded frames are still references for others
+     * \param lateness seconds the frame is behind its due time
+     */
+    virtual bool render(PictureType type, qreal lateness, qreal frameInterval) = 0;
+};
+typedef QSharedPointer<FrameDropPolicy> FrameDropPolicyPtr;
+
+/*!
+ * \brief The PredictiveFrameDropPolicy class
+ * The default policy of AVPlayer. The decode time of each picture type and how often it appears are measured, so the
+ * cost of the coming frames is predicted. If it exceeds the frame interval, non reference frames are skipped by the
+ * decoder before the video falls behind, and restored with some hysteresis when the cost drops. Late non reference frames
+ * are not displayed first. Dropping to the next key frame is the last resort for video later than maxLateness().
+ */
+class Q_AV_EXPORT PredictiveFrameDropPolicy : public FrameDropPolicy
+{
+public:
+    PredictiveFrameDropPolicy();
+    /*!
+     * \brief setBudget
+     * Ratio of the frame interval available to decoding. The rest is for filters, rendering and jitter. Default is 0.8
+     */
+    void setBudget(qreal value);
+    qreal budget() const;
+    /// seconds of lateness to drop packets until the next key frame. default is 2.0
+    void setMaxLateness(qreal value);
+    qreal maxLateness() const;
+    /// predicted usecs of decoding a frame, of all frames, or of reference frames only. 0 if nothing is measured
+    qreal predictedDecodeTime(bool refOnly = false) const;
+
+    void reset() Q_DECL_OVERRIDE;
+    void frameDecoded(PictureType type, qint64 decodeTime) Q_DECL_OVERRIDE;
+    Decision decide(qreal lateness, qreal frameInterval, bool keyFrame) Q_DECL_OVERRIDE;
+    bool render(PictureType type, qreal lateness, qreal frameInterval) Q_DECL_OVERRIDE;
+private:
+    qreal m_budget;
+    qreal m_max_late;
+    qreal m_cost[4]; // moving average of decode usecs of each PictureType
+    qreal m_ratio[4]; // moving average of how often each PictureType appears
+    bool m_drop_nonref;
+    int m_render_skipped; // frames not displayed in a row
+};
+} //namespace QtAV
+#endif // QTAV_FRAMEDROPPOLICY_H
@@ -0,0 +1,89 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_FRAMETAPFILTER_H
+#define QTAV_FRAMETAPFILTER_H
+
+#include <QtCore/QSize>
+#include <QtAV/Filter.h>
+#include <QtAV/VideoFrame.h>
+
+namespace QtAV {
+
+class FrameTapFilterPrivate;
+/*!
+ * \brief The FrameTapFilter class
+ * Taps displayed frames of a player for analytics at a reduced rate and size, e.g. 5 fps 320x180, without blocking playback.
+ * The filter only keeps a reference to the frame in the video thread. Scaling and conversion run in a worker thread of
+ * the filter, and if the consumer is slower than frameRate(), older frames are replaced by the latest one.
+ * Install it by AVPlayer::installFilter() or installTo()
+ */
+class Q_AV_EXPORT FrameTapFilter : public VideoFilter
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(FrameTapFilter)
+    Q_PROPERTY(qreal frameRate READ frameRate WRITE setFrameRate NOTIFY frameRateChanged)
+    Q_PROPERTY(QSize frameSize READ frameSize WRITE setFrameSize NOTIFY frameSizeChanged)
+    Q_PROPERTY(QtAV::VideoFormat::PixelFormat pixelFormat READ pixelFormat WRITE setPixelFormat NOTIFY pixelFormatChanged)
+public:
+    FrameTapFilter(QObject *parent = 0);
+    ~FrameTapFilter();
+    bool isReadOnly() const Q_DECL_OVERRIDE { return true;}
+    bool needsEveryFrame() const Q_DECL_OVERRIDE { return false;}
+    /*!
+     * \brief setFrameRate
+     * Max rate of tapped frames, in frames per second of media time
+     * \param value <= 0: every displayed frame. default is 5
+     */
+    void setFrameRate(qreal value);
+    qreal frameRate() const;
+    /*!
+     * \brief setFrameSize
+     * Size of tapped frames. If only width or height is > 0, the other one is computed from the frame's aspect ratio.
+     * Invalid size (default): the source size
+     */
+    void setFrameSize(const QSize& value);
+    QSize frameSize() const;
+    /*!
+     * \brief setPixelFormat
+     * Format of tapped frames. Default is Format_RGB32, then a frame on gpu is scaled and converted by OpenGL and only the
+     * result is read back, see VideoFrame::to(). Format_Invalid: the source format, only scaled if frameSize() is set.
+     */
+    void setPixelFormat(VideoFormat::PixelFormat value);
+    VideoFormat::PixelFormat pixelFormat() const;
+    /// number of frames replaced by a newer one before the worker thread took them
+    int droppedFrames() const;
+Q_SIGNALS:
+    /*!
+     * \brief frameAvailable
+     * Emitted in the worker thread of the filter. Use a direct connection to process the frame there, the next frame is not
+     * converted until the slot returns
+     */
+    void frameAvailable(const QtAV::VideoFrame& frame);
+    void frameRateChanged();
+    void frameSizeChanged();
+    void pixelFormatChanged();
+protected:
+    void process(Statistics* statistics, VideoFrame* frame = 0) Q_DECL_OVERRIDE;
+};
+
+} //namespace QtAV
+#endif // QTAV_FRAMETAPFILTER_H
@@ -0,0 +1,103 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_GLSLFILTER_H
+#define QTAV_GLSLFILTER_H
+#ifndef QT_NO_OPENGL
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QObject>
+#include <QtCore/QSize>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QtGui/QOpenGLShaderProgram>
+#else
+#include <QtOpenGL/QGLShaderProgram>
+#define QOpenGLShaderProgram QGLShaderProgram
+#endif
+
+namespace QtAV {
+
+class GLSLFilterPrivate;
+/*!
+ * \brief The GLSLFilter class
+ * A fragment shader pass on the rgb image of a frame, e.g. sharpen, deinterlace or color lookup. Filters are applied by
+ * OpenGLVideo in rendering, see OpenGLVideo::setFilters(). The frame is converted to rgb into a framebuffer object once,
+ * then each enabled filter renders the output of the previous one into another pooled framebuffer object, and the last
+ * result is drawn to the target. So the frame never leaves gpu.
+ * fragmentShader() is the code after the following declarations, and must write gl_FragColor:
+ * \code
+ * uniform sampler2D u_Texture; // output of the previous pass
+ * uniform vec2 u_TextureSize;  // size of u_Texture in pixels
+ * uniform vec2 u_PixelSize;    // 1.0/u_TextureSize
+ * varying vec2 v_TexCoords;
+ * \endcode
+ * For example, a sharpen filter:
+ * \code
+ * void main() {
+ *     vec4 c = texture2D(u_Texture, v_TexCoords);
+ *     vec4 n = texture2D(u_Texture, v_TexCoords + vec2(0.0, u_PixelSize.y)) + texture2D(u_Texture, v_TexCoords - vec2(0.0, u_PixelSize.y))
+ *            + texture2D(u_Texture, v_TexCoords + vec2(u_PixelSize.x, 0.0)) + texture2D(u_Texture, v_TexCoords - vec2(u_PixelSize.x, 0.0));
+ *     gl_FragColor = vec4(clamp(5.0*c.rgb - n.rgb, 0.0, 1.0), c.a);
+ * }
+ * \endcode
+ * Requires Qt5 (framebuffer objects), otherwise filters are ignored.
+ */
+class Q_AV_EXPORT GLSLFilter : public QObject
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(GLSLFilter)
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(QByteArray fragmentShader READ fragmentShader WRITE setFragmentShader NOTIFY fragmentShaderChanged)
+    Q_PROPERTY(QSize outputSize READ outputSize WRITE setOutputSize NOTIFY outputSizeChanged)
+public:
+    GLSLFilter(QObject* parent = 0);
+    virtual ~GLSLFilter();
+    void setEnabled(bool value = true);
+    bool isEnabled() const;
+    /*!
+     * \brief setFragmentShader
+     * The shader is compiled in the rendering context when the filter is used next time. A filter failed to compile is skipped
+     */
+    void setFragmentShader(const QByteArray& code);
+    QByteArray fragmentShader() const;
+    /*!
+     * \brief setOutputSize
+     * Size of the framebuffer object this pass renders to, e.g. half of the video size for a downscale pass.
+     * Invalid (default): the same as the input
+     */
+    void setOutputSize(const QSize& value);
+    QSize outputSize() const;
+    /*!
+     * \brief setUniforms
+     * Called with the program bound, before this pass is drawn. Reimplement to set uniforms declared by fragmentShader()
+     * \param inputSize size of u_Texture in pixels
+     */
+    virtual void setUniforms(QOpenGLShaderProgram* program, const QSize& inputSize);
+Q_SIGNALS:
+    void enabledChanged(bool);
+    void fragmentShaderChanged();
+    void outputSizeChanged();
+protected:
+    DPTR_DECLARE(GLSLFilter)
+};
+
+} //namespace QtAV
+#endif //QT_NO_OPENGL
+#endif // QTAV_GLSLFILTER_H
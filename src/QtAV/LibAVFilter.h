@@ -50,10 +50,20 @@ public:
     /*!
      * \brief setOptions
      * Set new option. Filter graph will be setup if receives a frame if options changed.
+     * If options is a single chain without labels, e.g. "eq=contrast=1.2:saturation=1.5,crop=w=640", and only values
+     * of key=value arguments change, the new values are sent to the running graph as commands (FFmpeg only) instead, so
+     * interactive adjustments do not rebuild the graph. It's rebuilt if a filter does not support the command.
      * \param options option string for libavfilter. libav and ffmpeg are different
      */
     void setOptions(const QString& options);
     QString options() const;
+    /*!
+     * \brief sendCommand
+     * Send a runtime command to the configured graph, e.g. sendCommand("hue", "h", "90"). Commands are queued and sent
+     * in the filtering thread before the next frame. Ignored if the graph is not configured or not supported (libav).
+     * \param target instance name "Parsed_<filter>_<index in options>", a filter name or "all"
+     */
+    void sendCommand(const QString& target, const QString& command, const QString& arg = QString());
 
     Status status() const;
 protected:
@@ -68,6 +78,12 @@ private:
     Private *priv;
 };
 
+/*!
+ * \brief The LibAVFilterVideo class
+ * Frames from VideoDecoderVAAPI in zero copy mode are pushed as va surfaces (FFmpeg >= 3.1), so vaapi filters can be used
+ * directly, e.g. "deinterlace_vaapi" or "scale_vaapi=w=1280:h=720". va surfaces from the graph are rendered without copy.
+ * Use "hwdownload,format=nv12" to get host frames.
+ */
 class Q_AV_EXPORT LibAVFilterVideo : public VideoFilter, public LibAVFilter
 {
     Q_OBJECT
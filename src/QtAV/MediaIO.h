@@ -39,6 +39,26 @@ namespace QtAV {
  *   properties:
  *     device - read only. example: io->device()
  *   protocols: "", "qrc"
+ * "MMap"
+ *   local file mapped into memory. read only
+ *   protocols: "mmap"
+ * "Memory"
+ *   data in memory, e.g. QByteArray::fromRawData() of user memory or a qrc resource. read only
+ *   properties:
+ *     data - read/write. parameter: QByteArray
+ *   protocols: "memory" (memory:qrc:/path)
+ * "HTTPRange"
+ *   remote file fetched by parallel ranged requests, with a LRU chunk cache. read only
+ *   properties:
+ *     connections, chunkSize, cacheChunks - read/write. set before avioContext()
+ *   protocols: "http+range", "https+range"
+ * "HLS"
+ *   HLS media or master playlist read as a continuous stream of its segments. the next segments are prefetched in parallel. read only
+ *   properties:
+ *     prefetchSegments, cacheDir - read/write. set before avioContext()
+ *     lastDownloadTime - read only
+ *   signals: segmentDownloaded(qint64 sequence, qint64 bytes, qint64 msecs)
+ *   protocols: "hls+http", "hls+https"
  */
 
 typedef int MediaIOId;
@@ -52,13 +72,15 @@ class Q_AV_EXPORT MediaIO : public QObject
     DPTR_DECLARE_PRIVATE(MediaIO)
     Q_DISABLE_COPY(MediaIO)
     Q_ENUMS(AccessMode)
+    Q_PROPERTY(int bufferSize READ bufferSize WRITE setBufferSize)
+    Q_PROPERTY(bool directRead READ isDirectRead WRITE setDirectRead)
 public:
     enum AccessMode {
         Read, // default
         Write
     };
 
-    /// Registered MediaIO::name(): "QIODevice", "QFile"
+    /// Registered MediaIO::name(): "QIODevice", "QFile", "MMap", "Memory", "HTTPRange", "HLS"
     static QStringList builtInNames();
     static MediaIO* create(const QString& name);
     /*!
@@ -96,6 +118,7 @@ public:
     /*!
      * \brief read
      * read at most maxSize bytes to data, and return the bytes were actually read
+     * \return 0: end of stream. <0: error, reported to FFmpeg as AVERROR(EIO)
      */
     virtual qint64 read(char *data, qint64 maxSize) = 0;
     /*!
@@ -130,6 +153,50 @@ public:
      * Demuxer seeking should work for this case.
      */
     virtual bool isVariableSize() const { return false;}
+    /*!
+     * \brief setReadAhead
+     * Read the source in a background thread into a ring buffer, so that a stall of read() (network, slow disk) does not
+     * stall the demuxer. Once buffered bytes is not greater than lowWatermark, the background thread fills the ring until full.
+     * Seeking inside buffered data (including recently read data that is not overwritten) does not touch the source.
+     * Only works for Read mode. Must be called before the MediaIO is used by AVDemuxer, i.e. before avioContext().
+     * When enabled, read(), seek() and position() of this object are called in the background thread.
+     * \param bufferSize <= 0: disable read ahead (default)
+     * \param lowWatermark in bytes. < 0: bufferSize/2
+     */
+    void setReadAhead(int bufferSize, int lowWatermark = -1);
+    /*!
+     * \brief setWriteBehind
+     * Write to the MediaIO in a background thread from a ring buffer, so that a stall of write() (network, slow disk) does not
+     * stall the muxer and the encoders. Small writes are coalesced into 64KB blocks ended at aligned offsets. Once buffered
+     * bytes reaches highWatermark, the muxer waits for the background thread (back-pressure).
+     * Only works for Write mode. Must be called before the MediaIO is used by AVMuxer, i.e. before avioContext().
+     * When enabled, write(), seek(), position() and size() of this object are called in the background thread, so a QIODevice
+     * with thread affinity (e.g. a socket) can not be used. Seeking flushes buffered data first. All data is written in release().
+     * \param bufferSize <= 0: disable write behind (default)
+     * \param highWatermark in bytes. <= 0: bufferSize
+     */
+    void setWriteBehind(int bufferSize, int highWatermark = -1);
+    int writeBehindSize() const;
+    int writeBehindHighWatermark() const;
+    /*!
+     * \brief setBufferSize
+     * Size of the AVIOContext buffer, i.e. the max bytes requested by a read() call. Default is 32768.
+     * Larger buffer means less read() calls for high bitrate streams. Must be called before avioContext()
+     * value <= 0: use default size
+     */
+    void setBufferSize(int value);
+    int bufferSize() const;
+    /*!
+     * \brief setDirectRead
+     * If true, large reads requested by the demuxer are passed to read() with the demuxer's memory, instead of filling the
+     * internal buffer and then copying. Small reads (container headers) still go through the buffer. And seek() is always
+     * called instead of seeking in the buffer.
+     * Must be called before avioContext(). Default is false
+     */
+    void setDirectRead(bool value);
+    bool isDirectRead() const;
+    int readAheadSize() const;
+    int readAheadLowWatermark() const;
     // The followings are for internal use. used by AVDemuxer, AVMuxer
     //struct AVIOContext; //anonymous struct in FFmpeg1.0.x
     void* avioContext(); //const?
@@ -0,0 +1,71 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_METRICSEXPORTER_H
+#define QTAV_METRICSEXPORTER_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+
+/*
+ * Export statistics of players in OpenMetrics text format (https://openmetrics.io), which is scraped by Prometheus.
+ * Every player is labeled by player="<objectName>", or its index in AVPlayer::players() if no object name.
+ * Exported families (qtav_ prefix): video decoded/dropped/rendered/late frames, decode and render fps, input bit rate and
+ * packet queue depth of each stream, gop length, frame types, decoder info, hardware surface starvation, audio underruns
+ * and playing state. Counters are read from Statistics::snapshot().
+ */
+namespace QtAV {
+
+class AVPlayer;
+class Q_AV_EXPORT MetricsExporter : public QObject
+{
+    Q_OBJECT
+public:
+    static const quint16 kDefaultPort = 9464;
+
+    MetricsExporter(QObject *parent = 0);
+    ~MetricsExporter();
+    /*!
+     * \brief openMetrics
+     * Metrics of all players in the process, see AVPlayer::players(). Call it in the thread players are created and destroyed in
+     */
+    static QByteArray openMetrics();
+    static QByteArray openMetrics(const QList<AVPlayer*>& players);
+    /*!
+     * \brief listen
+     * Serve openMetrics() over http, e.g. http://host:9464/metrics. Requests are handled in the thread of this object
+     * \return false if the port can not be bound, or QtAV is built without QtNetwork
+     */
+    bool listen(quint16 port = kDefaultPort);
+    void close();
+    bool isListening() const;
+private Q_SLOTS:
+    void onNewConnection();
+    void onReadyRead();
+private:
+    class Private;
+    Private *d;
+};
+} //namespace QtAV
+#endif // QTAV_METRICSEXPORTER_H
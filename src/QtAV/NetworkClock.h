@@ -0,0 +1,104 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_NETWORKCLOCK_H
+#define QTAV_NETWORKCLOCK_H
+
+#include <QtAV/AVClock.h>
+#include <QtCore/QString>
+
+/*
+ * Synchronize players on different hosts, e.g. a video wall driven by several PCs.
+ * The host with the reference clock runs a NetworkClockServer. Every other host runs a NetworkClockClient, and its players
+ * follow the client's clock by AVClock::setReferenceClock(client->clock()).
+ * Client polls the server by UDP like NTP: the network delay is the round trip time without the server processing time,
+ * and the server value is compensated by half of the delay. Samples with a delay much longer than the recent minimal
+ * delay are ignored. Small errors are corrected smoothly by catch up speed of the client clock, large errors by a jump.
+ */
+namespace QtAV {
+
+class Q_AV_EXPORT NetworkClockServer : public QObject
+{
+    Q_OBJECT
+public:
+    static const quint16 kDefaultPort = 48170;
+
+    NetworkClockServer(QObject *parent = 0);
+    ~NetworkClockServer();
+    /*!
+     * \brief setClock
+     * The reference clock to serve, e.g. AVPlayer::masterClock() of the player playing audio, or a clock the local players
+     * follow. It must live until the server is closed or another clock is set.
+     */
+    void setClock(AVClock *clock);
+    AVClock* clock() const;
+    /// listen on all interfaces. return false if the port can not be bound
+    bool listen(quint16 port = kDefaultPort);
+    void close();
+    bool isListening() const;
+private Q_SLOTS:
+    void processPendingDatagrams();
+private:
+    class Private;
+    Private *d;
+};
+
+class Q_AV_EXPORT NetworkClockClient : public QObject
+{
+    Q_OBJECT
+public:
+    NetworkClockClient(QObject *parent = 0);
+    ~NetworkClockClient();
+    /*!
+     * \brief clock
+     * An ExternalClock following the server clock. Local players use it by AVClock::setReferenceClock().
+     * It's paused if the server clock is paused or not active.
+     */
+    AVClock* clock() const;
+    /*!
+     * \brief setInterval
+     * Polling interval in ms. default is 200
+     */
+    void setInterval(int ms);
+    int interval() const;
+    /// start polling the server. return false if the local socket can not be bound
+    bool connectToServer(const QString& host, quint16 port = NetworkClockServer::kDefaultPort);
+    void disconnectFromServer();
+    /// error of the local clock at the last accepted sample, in seconds. positive if the local clock is behind
+    double offset() const;
+    /// network delay of the last accepted sample, in seconds
+    double delay() const;
+Q_SIGNALS:
+    /// emitted for every accepted sample
+    void synchronized(double offset, double delay);
+    // server did not reply for 10 intervals
+    void timeout();
+protected:
+    void timerEvent(QTimerEvent *e) Q_DECL_OVERRIDE;
+private Q_SLOTS:
+    void processPendingDatagrams();
+private:
+    class Private;
+    Private *d;
+};
+
+} //namespace QtAV
+#endif // QTAV_NETWORKCLOCK_H
@@ -32,6 +32,8 @@
 
 namespace QtAV {
 
+class OpenGLVideo;
+class VideoFilter;
 /*!
  * \brief The OpenGLRendererBase class
  * Renderering video frames using GLSL. A more generic high level class OpenGLVideo is used internally.
@@ -48,6 +50,32 @@ public:
     virtual ~OpenGLRendererBase();
     virtual bool isSupported(VideoFormat::PixelFormat pixfmt) const;
     virtual void onUpdate() = 0;
+    /*!
+     * \brief opengl
+     * The OpenGLVideo used to render frames, e.g. to set GLSLFilter passes. Access it in the rendering thread
+     */
+    OpenGLVideo* opengl() const;
+    /*!
+     * \brief setFrameTimingOverlay
+     * Paint graphs of decode, upload and draw time and present interval of the last frames over the video, and the number of
+     * stutters, i.e. presented frames whose interval deviates from the frame duration. Stutters are always counted in
+     * Statistics::StutterFrames whether or not the overlay is shown. Present intervals are measured by onFrameSwapped().
+     * Enabling it turns on Statistics::setLatencyTracing() for decode time. Default is false, or true if QTAV_FRAME_TIMING=1.
+     */
+    void setFrameTimingOverlay(bool value);
+    bool isFrameTimingOverlay() const;
+    /*!
+     * \brief setCaptureFilter
+     * Capture what is painted, i.e. the video with subtitles, filter overlays and the frame timing overlay, and apply filter
+     * on it, e.g. a VideoEncodeFilter with setAsync(true) to record the output in the filter's thread.
+     * After a new frame is painted, the framebuffer is read into a ring of 3 pixel pack buffers and a fence is inserted. A
+     * buffer is mapped in a later paint once its fence is signaled, so the render loop does not wait for the readback. If
+     * all buffers are busy, the frame is not captured. Captured frames are BGRA32 (RGBA32 for OpenGL ES) in the
+     * framebuffer size, with the timestamp of the video frame. OpenGL ES2 reads synchronously. Qt5 only. Thread safe
+     * \param filter null: stop capturing. The ownership is not transferred. filter is applied in the rendering thread
+     */
+    void setCaptureFilter(VideoFilter *filter);
+    VideoFilter* captureFilter() const;
 protected:
     virtual bool receiveFrame(const VideoFrame& frame);
     virtual bool needUpdateBackground() const;
@@ -60,6 +88,12 @@ protected:
     void onResizeGL(int w, int h);
     void onResizeEvent(int w, int h);
     void onShowEvent();
+    /*!
+     * \brief onFrameSwapped
+     * Call it after a buffer swap, e.g. frameSwapped() signal of QOpenGLWindow. The vsync timing learned from swaps is used
+     * to schedule frames for exact vsyncs and count missed vsyncs. See Statistics::VideoOnly::frameSwapped()
+     */
+    void onFrameSwapped(qreal refreshRate);
 private:
     virtual void onSetOutAspectRatioMode(OutAspectRatioMode mode);
     virtual void onSetOutAspectRatio(qreal ratio);
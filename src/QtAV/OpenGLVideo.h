@@ -25,6 +25,7 @@
 #include <QtAV/QtAV_Global.h>
 #include <QtAV/VideoFormat.h>
 #include <QtCore/QHash>
+#include <QtCore/QList>
 #include <QtGui/QMatrix4x4>
 #include <QtCore/QObject>
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
@@ -37,7 +38,10 @@ class QColor;
 
 namespace QtAV {
 
+class GLSLFilter;
+class SubImageSet;
 class VideoFrame;
+class ColorLUT;
 class OpenGLVideoPrivate;
 /*!
  * \brief The OpenGLVideo class
@@ -62,7 +66,39 @@ public:
      */
     void setOpenGLContext(QOpenGLContext *ctx);
     QOpenGLContext* openGLContext();
+    /*!
+     * \brief setAsyncUpload
+     * If enabled, frames from setCurrentFrame() are uploaded in a background thread, using an OpenGL context shared with
+     * openGLContext(), into a ring of textures. render() draws the latest uploaded frame after waiting its fence on gpu,
+     * so uploading never blocks the rendering thread, which is often the gui thread.
+     * frameUploaded() is emitted when a new frame can be rendered. Connect it to update the renderer.
+     * Must be called before setOpenGLContext(). The context must be set in gui thread.
+     * Requires Qt5 and fence sync (GL3.2, GL_ARB_sync or es3). Otherwise frames are uploaded in render() as usual.
+     */
+    void setAsyncUpload(bool value);
+    /*!
+     * \brief isAsyncUpload
+     * true if frames are uploaded by the background thread now
+     */
+    bool isAsyncUpload() const;
+    /*!
+     * \brief precompileShaders
+     * Compile and link the shaders of the given formats for openGLContext() in advance, e.g. at startup, so the first frame
+     * of a new format does not wait for the compiler. Linked programs are also stored in the program binary cache if supported,
+     * then later runs only load the binaries. Must be called after setOpenGLContext() with the context current.
+     * \param formats empty: the common formats yuv420p, nv12, rgb32 and yuv420p10le
+     */
+    void precompileShaders(const QList<VideoFormat::PixelFormat>& formats = QList<VideoFormat::PixelFormat>());
     void setCurrentFrame(const VideoFrame& frame);
+    /*!
+     * \brief setFilters
+     * GLSLFilter passes applied in order on the rgb image of the current frame in render(). The frame is rendered to framebuffer
+     * objects at frame size, and the region of interest is applied when the last result is drawn to the target.
+     * Filters are not owned. A destroyed filter is removed automatically. Programs are compiled in openGLContext().
+     * Requires Qt5. An empty list (default) renders frames directly as before.
+     */
+    void setFilters(const QList<GLSLFilter*>& filters);
+    QList<GLSLFilter*> filters() const;
     void fill(const QColor& color);
     /*!
      * \brief render
@@ -73,6 +109,24 @@ public:
      * \param transform: additinal transformation.
      */
     void render(const QRectF& target = QRectF(), const QRectF& roi = QRectF(), const QMatrix4x4& transform = QMatrix4x4());
+    /*!
+     * \brief uploadTime
+     * CPU time in ms of binding textures in the last render(), including uploading if the frame is new and not uploaded asynchronously
+     */
+    qreal uploadTime() const;
+    /*!
+     * \brief textureMemory
+     * Estimated bytes of textures and PBOs of the materials, see VideoMaterial::textureMemory()
+     */
+    qint64 textureMemory() const;
+    /*!
+     * \brief renderSubImages
+     * Composite subtitle images over what is rendered, e.g. after render(). Alpha masks are kept in a texture atlas, and only
+     * masks not in the atlas are uploaded, so unchanged or partially changed subtitles cost no cpu blending and little uploading.
+     * \param target the rect the frame of images is mapped to, in Qt's coordinate. invalid: the whole viewport
+     * \return false if images is invalid or failed to create gl resources
+     */
+    bool renderSubImages(const SubImageSet& images, const QRectF& target = QRectF(), const QMatrix4x4& transform = QMatrix4x4());
     void setProjectionMatrixToRect(const QRectF& v);
     void setProjectionMatrix(const QMatrix4x4 &matrix);
 
@@ -80,6 +134,45 @@ public:
     void setContrast(qreal value);
     void setHue(qreal value);
     void setSaturation(qreal value);
+    /*!
+     * \brief setDeinterlaceMode
+     * Deinterlace interlaced frames in shader, so no cpu filter (e.g. yadif in LibAVFilterVideo) is required.
+     * Use AVPlayer::setFieldRateOutput() to display each field of a frame at field rate, e.g. 50fps for 1080i50.
+     * Default is NoDeinterlace. See VideoMaterial::setDeinterlaceMode()
+     */
+    void setDeinterlaceMode(DeinterlaceMode value);
+    DeinterlaceMode deinterlaceMode() const;
+    /*!
+     * \brief setOutputColorTransfer
+     * Transfer of the surface rendering to. PQ and HLG frames are tone mapped and gamut mapped to it in shader, so no cpu
+     * filter (e.g. zscale) is required. ColorTransfer_PQ is for an HDR10 surface (10bit, BT.2020). Default is ColorTransfer_SDR.
+     * See VideoMaterial::setOutputColorTransfer()
+     * \param peakLuminance of the display in nits. 0: default
+     */
+    void setOutputColorTransfer(ColorTransfer value, qreal peakLuminance = 0);
+    ColorTransfer outputColorTransfer() const;
+    void setToneMapping(ToneMapping value);
+    ToneMapping toneMapping() const;
+    /*!
+     * \brief setColorLUT
+     * Apply a 3D LUT, e.g. a look or a broadcast safe legalizer, in shader after yuv to rgb conversion, brightness, contrast,
+     * hue and saturation. The cost is 2 texture samples per pixel. See VideoMaterial::setColorLUT()
+     * \param lut an invalid lut disables it
+     */
+    void setColorLUT(const ColorLUT& lut);
+    /*!
+     * \brief setColorLUT
+     * Load a .cube file, see ColorLUT::fromCube(). Empty fileName disables the lut
+     * \return false if failed to load, and the lut is disabled
+     */
+    bool setColorLUT(const QString& fileName);
+    ColorLUT colorLUT() const;
+Q_SIGNALS:
+    /*!
+     * \brief frameUploaded
+     * Emitted in the upload thread if isAsyncUpload()
+     */
+    void frameUploaded();
 protected:
     DPTR_DECLARE(OpenGLVideo)
 
@@ -47,6 +47,8 @@ protected:
     virtual void resizeGL(int w, int h) Q_DECL_OVERRIDE;
     virtual void resizeEvent(QResizeEvent *) Q_DECL_OVERRIDE;
     //virtual void showEvent(QShowEvent *);
+private Q_SLOTS:
+    void handleFrameSwapped();
 };
 typedef OpenGLWindowRenderer VideoRendererOpenGLWindow;
 
@@ -38,6 +38,20 @@ public:
     static Packet fromAVPacket(const AVPacket* avpkt, double time_base);
     static bool fromAVPacket(Packet *pkt, const AVPacket *avpkt, double time_base);
     static Packet createEOF();
+    /*!
+     * \brief poolHits
+     * Private data of packets (including the AVPacket) is recycled. poolHits() is the number of reused ones,
+     * poolMisses() is the number of heap allocations. Statistics of all packets in the process.
+     */
+    static qint64 poolHits();
+    static qint64 poolMisses();
+    /*!
+     * \brief payloadCopies
+     * Number of times packet payload bytes are copied, for debugging. Packets from AVDemuxer reference the AVBufferRef of the
+     * AVPacket and copying a Packet only adds a reference, so the value does not increase in playback if FFmpeg supports
+     * av_packet_ref(). Otherwise every fromAVPacket() copies. Statistics of all packets in the process.
+     */
+    static qint64 payloadCopies();
 
     Packet();
     ~Packet();
@@ -55,14 +69,23 @@ public:
      * Packet takes the owner ship. time unit is always ms even constructed from AVPacket.
      */
     const AVPacket* asAVPacket() const;
+    /*!
+     * \brief shiftTimestamps
+     * Add dt (in s) to pts and dts, and timestamps of the AVPacket if any, so decoded frames have the new timestamps
+     */
+    void shiftTimestamps(qreal dt);
 
     bool hasKeyFrame;
     bool isCorrupt;
+    // decode for reference only and do not display the frame, e.g. packets before the start of a seamless loop
+    bool isDecodeOnly;
     QByteArray data;
     // time unit is s.
     qreal pts, duration;
     qreal dts;
     qint64 position; // position in source file byte stream
+    // Statistics::tracingTime() when read by demuxer and put into packet queue. 0 if not traced, see Statistics::setLatencyTracing()
+    qint64 demuxTime, enqueueTime;
 
 private:
     // TODO: implicity shared. can not use QSharedData
@@ -33,10 +33,14 @@
 #include <QtAV/AVPlayer.h>
 #include <QtAV/Packet.h>
 #include <QtAV/Statistics.h>
+#include <QtAV/TraceRecorder.h>
+#include <QtAV/MetricsExporter.h>
+#include <QtAV/VideoWallManager.h>
 
 #include <QtAV/AudioDecoder.h>
 #include <QtAV/AudioFormat.h>
 #include <QtAV/AudioOutput.h>
+#include <QtAV/AudioMixer.h>
 #include <QtAV/AudioResampler.h>
 #include <QtAV/AudioResamplerTypes.h>
 
@@ -45,7 +49,9 @@
 #include <QtAV/LibAVFilter.h>
 
 #include <QtAV/VideoShader.h>
+#include <QtAV/ColorLUT.h>
 #include <QtAV/OpenGLVideo.h>
+#include <QtAV/GLSLFilter.h>
 
 #include <QtAV/VideoCapture.h>
 #include <QtAV/VideoDecoder.h>
@@ -53,6 +59,7 @@
 #include <QtAV/VideoFormat.h>
 #include <QtAV/VideoFrame.h>
 #include <QtAV/VideoFrameExtractor.h>
+#include <QtAV/FrameDropPolicy.h>
 #include <QtAV/VideoRenderer.h>
 #include <QtAV/VideoRendererTypes.h>
 #include <QtAV/VideoOutput.h>
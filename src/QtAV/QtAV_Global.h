@@ -66,6 +66,13 @@ Q_AV_EXPORT QString aboutQtAV_HTML();
 */
 Q_AV_EXPORT void setLogLevel(LogLevel value);
 Q_AV_EXPORT LogLevel logLevel();
+/*!
+ * \brief setLogCategoryEnabled
+ * Enable or disable debug and warning messages of a playback pipeline category: "demux", "video", "audio" or "render".
+ * All are enabled by default. Disabled messages are not formatted. Critical messages are always logged if logLevel() allows.
+ * Categories can also be disabled by environment QTAV_LOG_DISABLE, e.g. "video,audio"
+ */
+Q_AV_EXPORT void setLogCategoryEnabled(const QString& category, bool value);
 /// Default handler is qt message logger. Set environment QTAV_FFMPEG_LOG=0 or setFFmpegLogHandler(0) to disable.
 Q_AV_EXPORT void setFFmpegLogHandler(void(*)(void *, int, const char *, va_list));
 } //namespace QtAV
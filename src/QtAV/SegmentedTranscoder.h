@@ -0,0 +1,105 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_SEGMENTEDTRANSCODER_H
+#define QTAV_SEGMENTEDTRANSCODER_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+namespace QtAV {
+
+class AVTranscoder;
+/*!
+ * \brief The SegmentedTranscoder class
+ * Transcode a local media in parallel. The source is split into ranges starting at video key frames, every range is transcoded
+ * by an AVPlayer in offline mode and an AVTranscoder into a temporary file, several at the same time, then the files are
+ * concatenated into the output without encoding again, with continuous timestamps.
+ * Call start() in a thread with an event loop.
+ */
+class Q_AV_EXPORT SegmentedTranscoder : public QObject
+{
+    Q_OBJECT
+public:
+    SegmentedTranscoder(QObject* parent = 0);
+    ~SegmentedTranscoder();
+
+    void setMedia(const QString& fileName);
+    QString media() const;
+    void setOutputMedia(const QString& fileName);
+    QString outputMedia() const;
+    /// force the output format
+    void setOutputFormat(const QString& fmt);
+    QString outputFormatForced() const;
+    /*!
+     * \brief setSegments
+     * Number of ranges the source is split into. Short GOPs are merged, so the real count can be less.
+     * \param count 0: QThread::idealThreadCount() (default)
+     */
+    void setSegments(int count);
+    int segments() const;
+    /*!
+     * \brief setMaxParallel
+     * Max segments transcoded at the same time
+     * \param value 0: QThread::idealThreadCount() (default)
+     */
+    void setMaxParallel(int value);
+    int maxParallel() const;
+
+    bool isRunning() const;
+    /// number of segments transcoded
+    int finishedSegments() const;
+
+Q_SIGNALS:
+    /*!
+     * \brief segmentCreated
+     * Emitted before transcoding a segment. Create and set encoders of transcoder in a directly connected slot, every segment
+     * must use the same settings. If no video encoder is created, libx264 is used, and audio is not encoded.
+     */
+    void segmentCreated(int index, QtAV::AVTranscoder* transcoder);
+    void segmentFinished(int index);
+    void started();
+    /*!
+     * \brief finished
+     * Emitted when the output is written or failed, or stop() is called
+     */
+    void finished(bool ok);
+
+public Q_SLOTS:
+    /*!
+     * \brief start
+     * The media is opened to find the key frames where ranges start, then segments are started.
+     */
+    void start();
+    void stop();
+
+private Q_SLOTS:
+    void onSegmentStopped();
+    void onConcatFinished();
+
+private:
+    bool startNextSegment();
+    class Private;
+    QScopedPointer<Private> d;
+};
+} //namespace QtAV
+#endif // QTAV_SEGMENTEDTRANSCODER_H
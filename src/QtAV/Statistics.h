@@ -35,25 +35,162 @@ namespace QtAV {
 class Q_AV_EXPORT Statistics
 {
 public:
+    /*!
+     * \brief The LatencyStage enum
+     * Stages of a packet and the frame decoded from it, see Common::stage_latency
+     */
+    enum LatencyStage {
+        LatencyDemux,   ///< read by AVDemuxer::readFrame() -> put into the packet queue
+        LatencyQueue,   ///< put into the packet queue, including waiting for free space -> taken by the decoding thread
+        LatencyWait,    ///< taken -> decode started, e.g. waiting for the clock
+        LatencyDecode,  ///< decode started -> frame decoded. The decoded frame is attributed to the packet just decoded
+        LatencyFilter,  ///< frame decoded -> filters applied, including the filter stage queue
+        LatencyOutput,  ///< filters applied -> sent to outputs (OutputSet::sendVideoFrame(), AudioOutput::play()), including waiting
+        LatencyPresent, ///< sent -> presented. The buffer swap of OpenGL renderers, the device latency for audio
+        LatencyTotal,   ///< read by demuxer -> presented
+        LatencyStageCount
+    };
+    /*!
+     * \brief setLatencyTracing
+     * Tag packets and frames of all players with monotonic times at every LatencyStage and add the stage latencies to
+     * Common::stage_latency. Default is false, then nothing is tagged or recorded.
+     */
+    static void setLatencyTracing(bool value);
+    static bool isLatencyTracing() { return latency_tracing;}
+    /// monotonic time in ns used by latency tracing
+    static qint64 tracingTime();
+
+    /*!
+     * \brief The Counter enum
+     * Counted atomically by the playback threads. A counter is counted by only 1 thread, see count()
+     */
+    enum Counter {
+        DecodedFrames,  ///< video frames decoded
+        DroppedFrames,  ///< decoded video frames not rendered because they are late
+        RenderedFrames, ///< video frames delivered to renderers
+        LateFrames,     ///< rendered video frames later than the clock by more than 40ms
+        VideoBytes,     ///< bytes of video packets taken by the video thread
+        AudioBytes,     ///< bytes of audio packets taken by the audio thread
+        DemuxedVideoBytes, ///< bytes of video packets read by the demux thread
+        DemuxedAudioBytes, ///< bytes of audio packets read by the demux thread, or by the audio reader thread if used
+        IFrames,        ///< decoded video frames of each picture type if known by the decoder
+        PFrames,
+        BFrames,
+        StutterFrames,  ///< presented video frames whose interval to the previous one deviates from the content frame duration. counted by OpenGL renderers
+        CounterCount
+    };
+    /*!
+     * \brief The MemoryUsage enum
+     * Bytes held by a player, set by the thread owning the memory, see setMemoryUsage(). Stored in KiB granularity
+     */
+    enum MemoryUsage {
+        VideoPacketMemory, ///< packets in the video queue. set by the video thread
+        AudioPacketMemory, ///< packets in the audio queue. set by the audio thread
+        VideoFrameMemory,  ///< host memory of decoded video frames held by the video thread, its filter stage and the renderer. estimated from the last decoded frame
+        AudioFrameMemory,  ///< audio output buffers. set by the audio thread
+        TextureMemory,     ///< textures and PBOs allocated by the video material of the last OpenGL renderer drawing a frame
+        SurfaceMemory,     ///< surfaces allocated by the hardware video decoder. estimated from surface count, size and format
+        MemoryUsageCount
+    };
+    /*!
+     * \brief The Snapshot class
+     * Values of the counters at the time of snapshot(). Rates are measured in windows of about 1 second, and are 0 if nothing is counted in 2 seconds
+     */
+    class Q_AV_EXPORT Snapshot {
+    public:
+        Snapshot();
+        qint64 decoded_frames;
+        qint64 dropped_frames;
+        qint64 rendered_frames;
+        qint64 late_frames;
+        qreal decode_fps;
+        qreal render_fps;
+        qint64 video_bit_rate; ///< bits per second
+        qint64 audio_bit_rate;
+        int video_queue; ///< packets in the video queue when the video thread took the last one
+        int audio_queue;
+        qint64 video_input_bit_rate; ///< bits per second of demuxed packets of the stream
+        qint64 audio_input_bit_rate;
+        int gop_length; ///< packets from the last key frame to the previous one of video stream. 0 if unknown
+        qint64 i_frames, p_frames, b_frames;
+        qint64 stutter_frames;
+        qint64 packet_memory; ///< bytes, see MemoryUsage. audio + video
+        qint64 frame_memory; ///< audio + video
+        qint64 texture_memory;
+        qint64 surface_memory;
+        /// total bytes attributed to the player. Idle buffers pooled for all players are not included, see VideoFrame::bufferPoolStatistics()
+        qint64 memory() const { return packet_memory + frame_memory + texture_memory + surface_memory;}
+    };
+
     Statistics();
     ~Statistics();
     void reset();
+    /*!
+     * \brief snapshot
+     * Lock free and cheap, safe to be called in any thread at any rate, e.g. by a 10Hz timer in gui thread.
+     */
+    Snapshot snapshot() const;
+    /*!
+     * \brief count
+     * Add n to a counter and update its rate. Called by the only thread updating the counter, e.g. DecodedFrames by video thread
+     */
+    void count(Counter c, int n = 1);
+    void setVideoQueueSize(int packets);
+    void setAudioQueueSize(int packets);
+    void setGopLength(int packets);
+    void setMemoryUsage(MemoryUsage m, qint64 bytes);
 
     QString url;
     int bit_rate;
     QString format;
     QTime start_time, duration;
     QHash<QString, QString> metadata;
+    /*!
+     * \brief latency
+     * Current end-to-end latency in msecs, i.e. timestamp of the last demuxed packet - the clock value.
+     * Only updated in AVPlayer live mode
+     */
+    qint64 latency;
+
+    /*!
+     * \brief The Histogram class
+     * Count, mean, max, standard deviation (jitter) and power of 2 buckets of values, e.g. in msecs. bucket i >= 1 counts
+     * [2^(i-1), 2^i), bucket 0 counts [0, 1), and the last bucket counts values above.
+     */
+    class Q_AV_EXPORT Histogram {
+    public:
+        enum { BucketCount = 24 };
+        Histogram();
+        void add(qreal value);
+        void reset();
+        qint64 count() const { return m_count;}
+        qreal mean() const;
+        qreal maximum() const { return m_max;}
+        qreal standardDeviation() const;
+        qint64 bucket(int i) const;
+        /// lower bound of bucket i
+        static qreal bucketValue(int i);
+        /*!
+         * \brief percentile
+         * Estimated from the buckets, linear in a bucket and never greater than maximum().
+         * \param p in [0, 100], e.g. 95 for p95
+         */
+        qreal percentile(qreal p) const;
+    private:
+        qint64 m_count;
+        qreal m_sum, m_sum2, m_max;
+        qint64 m_buckets[BucketCount];
+    };
+
     class Common {
     public:
         Common();
-        //TODO: dynamic bit rate compute
         bool available;
         QString codec, codec_long;
         QString decoder;
         QString decoder_detail;
         QTime current_time, total_time, start_time;
-        int bit_rate;
+        int bit_rate; ///< from stream information. see Snapshot::video_input_bit_rate for the measured rate
         qint64 frames;
         qreal frame_rate; // average fps stored in media stream information
         //union member with ctor, dtor, copy ctor only works in c++11
@@ -62,8 +199,31 @@ public:
             video_only video;
         } only;*/
         QHash<QString, QString> metadata;
+        /*!
+         * msecs of each LatencyStage if isLatencyTracing(). LatencyPresent and LatencyTotal of video are added only by renderers
+         * reporting buffer swaps, e.g. OpenGL renderers
+         */
+        Histogram stage_latency[LatencyStageCount];
+        /// add to stage_latency if both times are tagged
+        void addLatency(LatencyStage stage, qint64 from, qint64 to) {
+            if (from > 0 && to > 0)
+                stage_latency[stage].add(qreal(to - from)/1e6);
+        }
     } audio, video; //init them
 
+    /*!
+     * \brief The FilterTiming class
+     * Cost of a filter if Filter::setProfilingEnabled(true). See Filter::timing()
+     */
+    class Q_AV_EXPORT FilterTiming {
+    public:
+        FilterTiming();
+        QString name; ///< class name and object name
+        qint64 frames; ///< frames processed
+        qint64 skipped; ///< frames dropped by the video thread which the filter is not applied to, see VideoFilter::needsEveryFrame()
+        Histogram time; ///< usecs per frame. time.mean(), time.percentile(95), time.percentile(99)
+    };
+
     //from AVCodecContext
     class Q_AV_EXPORT AudioOnly {
     public:
@@ -82,6 +242,16 @@ public:
          * Used by some WAV based audio codecs.
          */
         int block_align;
+        /// audio output timing since opened, see AudioOutput::getTimingStatistics(). updated by the audio thread
+        QString backend;
+        /// msecs between 2 data callbacks of the device, or between buffers done for backends without a callback
+        Histogram callback_interval;
+        /// msecs of data queued in audio output when a callback happens. small values are about to underrun
+        Histogram buffer_fill;
+        /// msecs blocked in AudioOutput::waitForNextBuffer() per play()
+        Histogram wait_time;
+        /// times the device ran out of data while playing. silence is played instead
+        int underruns;
     } audio_only;
     //from AVCodecContext
     class Q_AV_EXPORT VideoOnly {
@@ -106,12 +276,36 @@ public:
          */
         int gop_size;
         QString pix_fmt;
+        /// times the hardware decoder had no free surface, see VideoDecoder::surfaceStarvation(). a growing value means more surfaces are required
+        int surface_starvation;
+        /// frames in the filter stage thread, see AVPlayer::setVideoFilterStage(). 0 if filters run in video thread
+        int filter_stage_frames;
+        /// usecs of the VideoDecoder::decode() call which outputs a frame, by picture type of the frame if known by the decoder
+        Histogram decode_time_i, decode_time_p, decode_time_b;
         /// return current absolute time (seconds since epcho
         qint64 frameDisplayed(qreal pts); // used to compute currentDisplayFPS()
+        /// times a frame is presented later than the vsync targeted by alignToVSync(). updated by frameSwapped()
+        int missed_vsync;
+        /// called by renderer after a frame was swapped. vsync timing is learned from swap times and refreshRate(e.g. QScreen::refreshRate(), <=0: unknown)
+        void frameSwapped(qreal refreshRate = 0);
+        /// estimated display refresh interval in seconds. 0 if no swap is reported by renderer
+        qreal vsyncInterval() const;
+        /*!
+         * \brief alignToVSync
+         * Used by video thread to schedule a frame for the vsync nearest to its due time, so frames are presented at a regular
+         * cadence (e.g. 3:2 for 24fps on 60Hz) and are not delivered too late for the vsync.
+         * \param delay seconds from now to the due time of the frame
+         * \return seconds from now to deliver the frame, i.e. half an interval before the vsync. delay if vsyncInterval() is unknown
+         */
+        qreal alignToVSync(qreal delay);
     private:
         class Private;
         QExplicitlySharedDataPointer<Private> d;
     } video_only;
+private:
+    static bool latency_tracing;
+    class Private;
+    QExplicitlySharedDataPointer<Private> d;
 };
 
 } //namespace QtAV
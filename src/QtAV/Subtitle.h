@@ -25,6 +25,7 @@
 #include <QtCore/QObject>
 #include <QtCore/QStringList>
 #include <QtCore/QUrl>
+#include <QtCore/QVector>
 #include <QtGui/QImage>
 #include <QtAV/QtAV_Global.h>
 
@@ -51,6 +52,46 @@ public:
     QString text; //plain text. always valid
 };
 
+/*!
+ * \brief The SubImage class
+ * A part of a rendered subtitle, e.g. a glyph run from libass: an 8 bit alpha mask drawn in a single color
+ */
+class Q_AV_EXPORT SubImage
+{
+public:
+    SubImage(int x = 0, int y = 0, int w = 0, int h = 0, int stride = 0) :
+        x(x), y(y)
+      , w(w), h(h)
+      , stride(stride)
+      , color(0)
+    {}
+    int x, y; // position in the frame
+    int w, h;
+    int stride; // bytes per line of data
+    QRgb color; // with alpha
+    QByteArray data; // alpha mask, stride*h bytes
+};
+
+/*!
+ * \brief The SubImageSet class
+ * Subtitle images at a time for a given frame size. id changes only if the images change, so a renderer can keep what it uploaded
+ */
+class Q_AV_EXPORT SubImageSet
+{
+public:
+    SubImageSet(int width = 0, int height = 0, int id = 0) :
+        w(width), h(height)
+      , id(id)
+    {}
+    // false if not supported by the subtitle processor
+    bool isValid() const { return w > 0 && h > 0;}
+    // nothing to show
+    bool isEmpty() const { return images.isEmpty();}
+    int w, h; // frame size
+    int id;
+    QVector<SubImage> images;
+};
+
 class Q_AV_EXPORT Subtitle : public QObject
 {
     Q_OBJECT
@@ -66,6 +107,7 @@ class Q_AV_EXPORT Subtitle : public QObject
     Q_PROPERTY(QStringList supportedSuffixes READ supportedSuffixes NOTIFY supportedSuffixesChanged)
     Q_PROPERTY(qreal timestamp READ timestamp WRITE setTimestamp)
     Q_PROPERTY(qreal delay READ delay WRITE setDelay NOTIFY delayChanged)
+    Q_PROPERTY(int lookahead READ lookahead WRITE setLookahead NOTIFY lookaheadChanged)
     Q_PROPERTY(QString text READ getText)
     Q_PROPERTY(bool loaded READ isLoaded)
     Q_PROPERTY(bool canRender READ canRender NOTIFY canRenderChanged)
@@ -162,6 +204,22 @@ public:
       * \return empty image if no image, or subtitle processor does not support renderering
       */
     QImage getImage(int width, int height, QRect* boundingRect = 0);
+    /*!
+     * \brief setLookahead
+     * Pre-render images of the next \a cues cue beginnings in a worker thread at the size of the last getImage(), so heavy events
+     * do not make a spike in the thread calling getImage() when they start. A pre-rendered image is taken only at the start of
+     * its cue, later images are rendered as usual, which are cheap because the engine caches glyphs in the pre-rendering.
+     * Only for rendering engines(canRender()). Default is 0: disabled
+     */
+    void setLookahead(int cues);
+    int lookahead() const;
+    /*!
+     * \brief getSubImages
+     * Get the subtitle at given (video) frame size as alpha masks and colors, which can be composited by gpu, e.g. OpenGLVideo::renderSubImages().
+     * No image is blended by cpu. boundingRect is the same as getImage()
+     * \return an invalid set if subtitle processor does not support it
+     */
+    SubImageSet getSubImages(int width, int height, QRect* boundingRect = 0);
     // used for embedded subtitles.
     /*!
      * \brief processHeader
@@ -169,7 +227,7 @@ public:
      * Used by libass to set style etc.
      */
     bool processHeader(const QByteArray &codec, const QByteArray& data);
-    // ffmpeg decodes subtitle lines and call processLine. if AVPacket contains plain text, no decoding is ok
+    // ffmpeg decodes subtitle lines and call processLine. if AVPacket contains plain text, no decoding is ok. thread safe
     bool processLine(const QByteArray& data, qreal pts = -1, qreal duration = 0);
 
     QString fontFile() const;
@@ -182,13 +240,25 @@ public:
     void setFontsDir(const QString& value);
     bool isFontFileForced() const;
     void setFontFileForced(bool value);
+    /// a loadAsync() is running
+    bool isLoading() const;
 public slots:
     /*!
-     * \brief start
-     * start to process the whole subtitle content in a thread
+     * \brief load
+     * Process the whole subtitle content in current thread. A loading by loadAsync() is canceled and waited.
      */
     void load();
+    /*!
+     * \brief loadAsync
+     * Read, detect charset and process the subtitle in a background thread. loaded() is emitted in that thread if succeeded.
+     * A previous loading not finished is canceled, so only the last one is published.
+     */
     void loadAsync();
+    /*!
+     * \brief cancelLoad
+     * Stop the current loadAsync() at its next step, e.g. between files and engines. Its result is discarded.
+     */
+    void cancelLoad();
     void setTimestamp(qreal t);
 signals:
     // TODO: also add to AVPlayer?
@@ -210,11 +280,14 @@ signals:
     void supportedSuffixesChanged();
     void engineChanged();
     void delayChanged();
+    void lookaheadChanged();
     void fontFileChanged();
     void fontsDirChanged();
     void fontFileForcedChanged();
 private:
     void checkCapability();
+    // stops if id is not the latest
+    void doLoad(int id);
     class Private;
     Private *priv;
 };
@@ -86,6 +86,8 @@ public:
     QFont font() const;
     void setColor(const QColor& c);
     QColor color() const;
+    // subtitles are rendered on displayed frames only
+    bool needsEveryFrame() const Q_DECL_OVERRIDE { return false;}
 public slots:
     // TODO: enable changed & autoload=> load
     void setAutoLoad(bool value);
@@ -112,7 +114,6 @@ signals:
     void fontFileChanged();
     void fontsDirChanged();
     void fontFileForcedChanged();
-
 protected:
     virtual void process(Statistics* statistics, VideoFrame* frame);
 };
@@ -29,6 +29,22 @@
 
 namespace QtAV {
 
+/*!
+ * \brief The DmaBufSurfaceInfo struct
+ * Layout of a surface exported as dma-buf by VideoSurfaceInterop::map(DmaBufSurface, ...). Planes can be in the same
+ * buffer object. The fds are owned by the interop and are valid while it's alive, dup() them if they are imported.
+ */
+struct DmaBufSurfaceInfo {
+    quint32 fourcc; // drm fourcc of the surface, e.g. DRM_FORMAT_NV12
+    quint64 modifier; // drm format modifier of all planes
+    int width, height; // visible size
+    int planes;
+    int fd[4];
+    quint32 size[4]; // size of the buffer object of each plane
+    quint32 offset[4];
+    quint32 pitch[4];
+};
+
 class Q_AV_EXPORT VideoSurfaceInterop
 {
 public:
@@ -42,6 +58,8 @@ public:
      * \param handle address of real handle
      *   GLTextureSurface: usually opengl texture. maybe other objects for some decoders in the feature
      *   HostMemorySurface: a VideoFrame ptr
+     *   DXTextureSurface: address of a d3d texture, e.g. ID3D11Texture2D* on the d3d11 decoder device from createHandle()
+     *   DmaBufSurface: a DmaBufSurfaceInfo ptr. plane is ignored
      * \param plane
      * \return Null if not supported or failed. handle if success.
      */
@@ -0,0 +1,95 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_TRACERECORDER_H
+#define QTAV_TRACERECORDER_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+namespace QtAV {
+/*!
+ * \brief The TraceRecorder class
+ * Records spans of the playback pipeline, e.g. demux, decode, filter, upload, draw, audio write and seek, and saves them
+ * in Chrome trace event JSON format, which can be opened by chrome://tracing and Perfetto UI (https://ui.perfetto.dev).
+ * Each thread writes events into its own ring buffer without locking, only the latest bufferSize() events of a thread are kept.
+ * A thread is named by QThread::objectName(), e.g. "VideoThread", "AudioThread" and "AVDemuxThread" of AVPlayer.
+ * Disabled by default, then a Span only tests a static bool.
+ * \code
+ *   TraceRecorder::setEnabled(true);
+ *   ...
+ *   TraceRecorder::save(QStringLiteral("trace.json"));
+ * \endcode
+ */
+class Q_AV_EXPORT TraceRecorder
+{
+public:
+    /*!
+     * \brief The Span class
+     * Records a complete event from construction to destruction in the current thread if recording is enabled when it's constructed.
+     * name and category must be string literals or live until the events are saved or cleared.
+     */
+    class Span {
+    public:
+        explicit Span(const char* name, const char* category = "pipeline")
+            : m_name(name)
+            , m_category(category)
+            , m_begin(TraceRecorder::isEnabled() ? TraceRecorder::now() : 0)
+        {}
+        ~Span() {
+            if (m_begin > 0)
+                TraceRecorder::complete(m_name, m_category, m_begin, TraceRecorder::now());
+        }
+    private:
+        const char* m_name;
+        const char* m_category;
+        qint64 m_begin;
+    };
+
+    static void setEnabled(bool value);
+    static bool isEnabled() { return enabled;}
+    /*!
+     * \brief setBufferSize
+     * Max events kept for each thread. Takes effect for buffers created after clear(). Default is 8192
+     */
+    static void setBufferSize(int events);
+    static int bufferSize();
+    /// record an instant event in the current thread
+    static void instant(const char* name, const char* category = "pipeline");
+    /// record a complete event in the current thread. begin and end are times from now()
+    static void complete(const char* name, const char* category, qint64 begin, qint64 end);
+    /// monotonic time in ns, the same as Statistics::tracingTime()
+    static qint64 now();
+    /*!
+     * \brief toJson
+     * Events of all threads in Chrome trace event JSON format. Can be called while recording, events being written
+     * at the same time may be lost.
+     */
+    static QByteArray toJson();
+    static bool save(const QString& fileName);
+    /// discard recorded events and buffers of finished threads
+    static void clear();
+private:
+    static bool enabled;
+};
+} //namespace QtAV
+#endif // QTAV_TRACERECORDER_H
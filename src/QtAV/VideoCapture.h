@@ -24,12 +24,14 @@
 #define QTAV_VIDEOCAPTURE_H
 
 #include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
 #include <QtGui/QImage>
 #include <QtAV/QtAV_Global.h>
 #include <QtAV/VideoFrame.h>
 
 namespace QtAV {
 
+class CaptureQueue;
 //on capture per thread or all in one thread?
 class Q_AV_EXPORT VideoCapture : public QObject
 {
@@ -41,8 +43,17 @@ class Q_AV_EXPORT VideoCapture : public QObject
     Q_PROPERTY(int quality READ quality WRITE setQuality NOTIFY qualityChanged)
     Q_PROPERTY(QString captureName READ captureName WRITE setCaptureName NOTIFY captureNameChanged)
     Q_PROPERTY(QString captureDir READ captureDir WRITE setCaptureDir NOTIFY captureDirChanged)
+    Q_PROPERTY(int maxPendingCaptures READ maxPendingCaptures WRITE setMaxPendingCaptures NOTIFY maxPendingCapturesChanged)
+    Q_PROPERTY(DropPolicy dropPolicy READ dropPolicy WRITE setDropPolicy NOTIFY dropPolicyChanged)
+    Q_PROPERTY(bool directEncode READ isDirectEncode WRITE setDirectEncode NOTIFY directEncodeChanged)
+    Q_ENUMS(DropPolicy)
 public:
+    enum DropPolicy {
+        DropNewest, /// a new capture request is discarded if too many captures are pending
+        DropOldest  /// the oldest pending capture which is not started yet is discarded
+    };
     explicit VideoCapture(QObject *parent = 0);
+    ~VideoCapture();
     void setAsync(bool value = true);
     bool isAsync() const;
     /*!
@@ -84,6 +95,39 @@ public:
     QString captureName() const;
     void setCaptureDir(const QString& value);
     QString captureDir() const;
+    /*!
+     * \brief setMaxPendingCaptures
+     *  Max number of async captures waiting for or being converted and saved. If a capture is requested when the limit is
+     *  reached, a capture is discarded according to dropPolicy() and dropped() is emitted, so burst capturing never piles up
+     *  frames in memory. Not used if isAsync() is false.
+     * \param value 0: no limit. default is 8
+     */
+    void setMaxPendingCaptures(int value);
+    int maxPendingCaptures() const;
+    /// number of async captures waiting for or being converted and saved now
+    int pendingCaptures() const;
+    /*!
+     * \brief setDropPolicy
+     *  Which capture to discard if maxPendingCaptures() is reached. default is DropNewest
+     */
+    void setDropPolicy(DropPolicy value);
+    DropPolicy dropPolicy() const;
+    /*!
+     * \brief setDirectEncode
+     *  If true and saveFormat() is "jpg" or "jpeg", a YUV frame is encoded by FFmpeg's mjpeg encoder without converting to
+     *  a QImage first. Frames in other pixel formats are converted to YUV420P, which is much cheaper than to RGB. imageCaptured() is still
+     *  emitted, but only the image is converted if a slot is connected to it. Fall back to QImage if encoding fails.
+     *  default is false
+     */
+    void setDirectEncode(bool value = true);
+    bool isDirectEncode() const;
+    /*!
+     * \brief setWorkerCount
+     *  Number of threads converting and saving async captures. The threads are shared by all VideoCapture objects.
+     * \param value <= 0: QThread::idealThreadCount()
+     */
+    static void setWorkerCount(int value);
+    static int workerCount();
 public Q_SLOTS:
     void capture();
     QTAV_DEPRECATED void request();
@@ -108,6 +152,12 @@ Q_SIGNALS:
      * \param path the saved captured frame path.
      */
     void saved(const QString& path);
+    /*!
+     * \brief dropped
+     * Emitted when a capture is discarded because maxPendingCaptures() is reached.
+     * \param timestamp timestamp of the discarded frame
+     */
+    void dropped(qreal timestamp);
 
     void asyncChanged();
     void autoSaveChanged();
@@ -116,6 +166,9 @@ Q_SIGNALS:
     void qualityChanged();
     void captureNameChanged();
     void captureDirChanged();
+    void maxPendingCapturesChanged();
+    void dropPolicyChanged();
+    void directEncodeChanged();
 private slots:
     void handleAppQuit();
 private:
@@ -128,6 +181,9 @@ private:
     bool async;
     bool auto_save;
     bool original_fmt;
+    bool direct_encode;
+    int max_pending;
+    DropPolicy drop_policy;
     //TODO: use blocking queue? If not, the parameters will change when thre previous is not finished
     //or use a capture event that wrapper all these parameters
     int qual;
@@ -135,6 +191,7 @@ private:
     QString fmt;
     QString name, dir;
     VideoFrame frame;
+    QSharedPointer<CaptureQueue> queue;
 };
 
 } //namespace QtAV
@@ -25,6 +25,7 @@
 #include <QtAV/AVDecoder.h>
 #include <QtAV/FactoryDefine.h>
 #include <QtAV/VideoFrame.h>
+#include <QtAV/VideoFrameAllocator.h>
 
 class QSize;
 namespace QtAV {
@@ -46,7 +47,7 @@ FACTORY_DECLARE(VideoDecoder)
       deinterlace: 0 "Weave", 1 "Bob", 2 "Adaptive"
     VA-API
       display: 0 "X11", 1 "GLX", 2 "DRM"
-    DXVA, VA-API
+    DXVA, D3D11, VA-API
       surfaces: 0 default
     DXVA, VA-API, VDA:
       sse4: bool
@@ -54,7 +55,8 @@ FACTORY_DECLARE(VideoDecoder)
       neon: bool
     FFmpeg
       skip_loop_filter, skip_idct, skip_frame: -16 "None", 0: "Default", 8 "NoRef", 16 "Bidir", 32 "NoKey", 64 "All"
-      threads: int, 0 is auto
+      threads: int, 0 is auto. auto threads of all decoders are limited by setSoftwareThreadBudget()
+      priority: int, weight for the share of setSoftwareThreadBudget(). <=0: 1 thread, 1: normal (default), >1: e.g. focused player
       vismv(motion vector visualization): flag, 0 "NO", 1 "PF", 2 "BF", 4 "BB"
  */
 
@@ -68,10 +70,94 @@ public:
     /*!
      * \brief create
      * create a decoder from registered name. FFmpeg decoder will be created for empty name
-     * \param name can be "FFmpeg", "CUDA", "VDA", "VAAPI", "DXVA", "Cedarv"
+     * \param name can be "FFmpeg", "CUDA", "VDA", "VAAPI", "DXVA", "D3D11", "Cedarv"
      * \return 0 if not registered
      */
     static VideoDecoder* create(const QString& name = QStringLiteral("FFmpeg"));
+    /*!
+     * \brief setSoftwareThreadBudget
+     * Max total threads of FFmpeg software decoders using auto threads (threads = 0). Each decoder gets a share weighted by
+     * its "priority" property when it is opened. Useful if many players run at the same time.
+     * \param value 0: QThread::idealThreadCount() (default)
+     */
+    static void setSoftwareThreadBudget(int value);
+    static int softwareThreadBudget();
+    /*!
+     * \brief setCapabilityCacheDir
+     * Save results of hardware capability probes (VA-API profiles, CUDA device) in dir. They are validated by the driver
+     * files and reused by hardware decoders opened after the application restarts, so a decoder whose hardware can not decode
+     * the stream fails without initializing the driver. Libraries of hardware decoders are loaded when they are opened.
+     * \param dir empty: disable disk cache (default). probed capabilities are still cached in memory
+     */
+    static void setCapabilityCacheDir(const QString& dir);
+    static QString capabilityCacheDir();
+    /*!
+     * \brief setDeviceUtilization
+     * Report the decoding engine load of a GPU, e.g. NVDEC utilization from NVML, for hardware decoders whose "devicePolicy"
+     * property is LeastLoadedDevice. Devices with fewer active decoders are still preferred.
+     * \param decoder decoder name, e.g. "CUDA", "VAAPI"
+     * \param device device index of the decoder's "device" property
+     * \param percent 0~100. <0: unknown
+     */
+    static void setDeviceUtilization(const QString& decoder, int device, int percent);
+    /*!
+     * \brief setPipelineDepth
+     * Number of decoded frames held after decoding, e.g. by outputs, the renderer queue and filters. If property "surfaces"
+     * is 0 (auto), hardware decoders (DXVA, D3D11, VA-API, CUDA) allocate codec reference frames + frames being decoded + pipelineDepth() surfaces.
+     * Call it before open(). AVPlayer sets it from its outputs and filters. Default is 2
+     */
+    void setPipelineDepth(int frames);
+    int pipelineDepth() const;
+    /*!
+     * \brief setOutputSizeHint
+     * The size frames will be displayed at, e.g. a small video wall tile. A decoder supporting reduced resolution decoding
+     * (FFmpeg lowres) decodes at the smallest supported size not smaller than the hint. Call it before open().
+     * AVPlayer sets it from the renderer size if AVPlayer::setReducedResolutionDecode(true)
+     * \param size invalid: full resolution. Default is invalid
+     */
+    void setOutputSizeHint(const QSize& size);
+    QSize outputSizeHint() const;
+    /*!
+     * \brief surfaceStarvation
+     * Number of times a hardware decoder found no free surface since it was created, i.e. all surfaces were still held
+     * downstream. The decoder then waits, allocates or reuses a surface. Always 0 for software decoders.
+     * Also reported in Statistics::VideoOnly::surface_starvation
+     */
+    int surfaceStarvation() const;
+    /*!
+     * \brief surfaceMemory
+     * Estimated bytes of surfaces allocated by a hardware decoder, from surface count, size and format. 0 for software decoders.
+     * Also reported in Statistics::Snapshot::surface_memory
+     */
+    qint64 surfaceMemory() const;
+    /*!
+     * \brief isSupported
+     * Check the capability database of this decoder for the stream set by setCodecContext() without opening the decoder.
+     * Hardware decoders record codec, profile, bit depth and size of the streams they opened or can not decode on this
+     * device, keyed by decoder name and validated by the driver (see setCapabilityCacheDir()). AVPlayer skips a decoder in
+     * the priority list if it's not supported, so a hardware open known to fail is not tried again.
+     * \return false only if the stream is known to be not decodable. Always true for software decoders
+     */
+    bool isSupported() const;
+    /*!
+     * \brief setFrameAllocator
+     * Decode into memory of the allocator if the decoder supports direct rendering (FFmpeg software decoder) and the
+     * allocator accepts the format and size. Otherwise decoder's own buffers are used. Call it before open().
+     * AVPlayer sets it from the renderer, see VideoRenderer::frameAllocator()
+     */
+    void setFrameAllocator(const VideoFrameAllocatorPtr& allocator);
+    VideoFrameAllocatorPtr frameAllocator() const;
+    /*!
+     * \brief requiredBitstreamFilter
+     * FFmpeg bitstream filters the decoder needs for the stream of codec context, e.g. "h264_mp4toannexb" for a hardware decoder
+     * parsing Annex B only. AVPlayer asks the demuxer to filter packets once when they are read (AVDemuxer::setBitstreamFilter())
+     * and calls setBitstreamFiltered(true) if it succeeds, otherwise the decoder filters packets itself.
+     * \return comma separated filter names. empty: no filter is required (default)
+     */
+    virtual QString requiredBitstreamFilter() const;
+    /// packets to decode are already filtered by requiredBitstreamFilter(). call it before decoding. default is false
+    void setBitstreamFiltered(bool value);
+    bool isBitstreamFiltered() const;
     virtual VideoDecoderId id() const = 0;
     QString name() const; //name from factory
     virtual VideoFrame frame() = 0;
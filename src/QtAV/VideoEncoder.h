@@ -82,11 +82,24 @@ public:
     /*!
      * \brief setPixelFormat
      * If not set or set to an invalid format, a supported format will be used and pixelFormat() will be that format after open()
+     * For hw encoders accepting only gpu frames, e.g. "h264_vaapi", it's the format of input frames uploaded to gpu (NV12
+     * by default). Frames from VideoDecoderVAAPI in zero copy mode are encoded without copy.
      * \param format
      */
     void setPixelFormat(const VideoFormat::PixelFormat format);
     VideoFormat::PixelFormat pixelFormat() const;
-    // TODO: supportedPixelFormats() const;
+    /*!
+     * \brief setSourcePixelFormat
+     * Format of frames to be encoded, e.g. decoded frames. If pixelFormat is not set by user, open() chooses it if the codec
+     * supports it, so frames are encoded without conversion. VideoEncodeFilter sets it from the first frame.
+     */
+    void setSourcePixelFormat(VideoFormat::PixelFormat format);
+    VideoFormat::PixelFormat sourcePixelFormat() const;
+    /*!
+     * \brief supportedPixelFormats
+     * Input pixel formats of codecName() which need no conversion. Empty if unknown
+     */
+    virtual QVector<VideoFormat::PixelFormat> supportedPixelFormats() const;
 Q_SIGNALS:
     void widthChanged();
     void heightChanged();
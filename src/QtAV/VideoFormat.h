@@ -127,6 +127,8 @@ public:
         Format_BGRA64, //native endian
         Format_BGRA64LE,
         Format_BGRA64BE,
+        Format_P010LE, // semi-planar 4:2:0 10 bits, msb aligned in 16 bits
+        Format_P010BE,
         Format_User
     };
 
@@ -26,10 +26,23 @@
 #include <QtAV/CommonTypes.h>
 #include <QtAV/Frame.h>
 #include <QtAV/VideoFormat.h>
+#include <QtAV/SurfaceInterop.h>
 #include <QtCore/QSize>
 
 namespace QtAV {
 
+/*!
+ * \brief The HDRMetadata struct
+ * Luminance of the mastering display (SMPTE ST 2086) and content light level (CTA-861.3) in nits. 0: unknown
+ */
+struct HDRMetadata {
+    HDRMetadata() : max_luminance(0), min_luminance(0), max_cll(0), max_fall(0) {}
+    qreal max_luminance;
+    qreal min_luminance;
+    qreal max_cll; // max content light level
+    qreal max_fall; // max frame average light level
+};
+
 class VideoFramePrivate;
 class Q_AV_EXPORT VideoFrame : public Frame
 {
@@ -46,8 +59,44 @@ public:
      * \param pitch plane pitch on GPU. pitch[0] must be valid. pitch[i>0] will be filled depending on pixel format, pitch[0] and surface_h if it's NULL.
      * \param optimized try to use SIMD to copy from GPU. otherwise use memcpy
      * \param swapUV
+     * \param hostFormat format of the result frame. Format_Invalid: the same as fmt. If fmt is NV12 or NV21 and hostFormat is
+     * Format_YUV420P, chroma is deinterleaved while copying from GPU (always SIMD if possible), so no conversion pass is needed.
+     * Other formats are copied as fmt
+     */
+    static VideoFrame fromGPU(const VideoFormat& fmt, int width, int height, int surface_h, quint8 *src[], int pitch[], bool optimized = true, bool swapUV = false, VideoFormat::PixelFormat hostFormat = VideoFormat::Format_Invalid);
+    /*!
+     * \brief setBufferPoolSize
+     * Data of frames from allocate(), clone(), to() and fromGPU() is taken from a pool of buffers of the same size, and put back
+     * when the last frame referencing it is destroyed, unless frameData() is still referenced by user.
+     * \param bytes max size of idle buffers kept in the pool. 0: no pooling. default is 64MB
+     */
+    static void setBufferPoolSize(qint64 bytes);
+    static qint64 bufferPoolSize();
+    /*!
+     * \brief bufferPoolStatistics
+     * \param hits number of buffers reused from the pool
+     * \param misses number of buffers newly allocated
+     * \param idleBytes size of buffers in the pool now
+     * \param inUseBytes size of buffers taken from the pool by frames of all players, converters and decoders, and not put back yet
      */
-    static VideoFrame fromGPU(const VideoFormat& fmt, int width, int height, int surface_h, quint8 *src[], int pitch[], bool optimized = true, bool swapUV = false);
+    static void bufferPoolStatistics(qint64 *hits, qint64 *misses = 0, qint64 *idleBytes = 0, qint64 *inUseBytes = 0);
+    /*!
+     * \brief setMemoryLimit
+     * A global cap of pooled buffers, including buffers in use. When in use + idle bytes exceed it, idle buffers are freed
+     * instead of kept for reuse, so the pool shrinks under memory pressure. The in use buffers are never freed.
+     * \param bytes 0: no limit (default)
+     */
+    static void setMemoryLimit(qint64 bytes);
+    static qint64 memoryLimit();
+    /*!
+     * \brief setDefaultAlignment
+     * Alignment of every plane address and bytesPerLine() of frames allocated by allocate() and clone(), and of plane addresses
+     * of frames from fromGPU() (line sizes are the gpu pitch), if alignment() of the frame is not set.
+     * The default is 64, which suits AVX2/AVX-512 kernels and GL_UNPACK_ALIGNMENT.
+     * \param bytes a power of 2. 1: no padding, planes are packed as avpicture_fill()
+     */
+    static void setDefaultAlignment(int bytes);
+    static int defaultAlignment();
 
     VideoFrame();
     //must set planes and linesize manually
@@ -71,6 +120,20 @@ public:
      * The memory can be initialized by user
      */
     virtual int allocate();
+    /*!
+     * \brief setAlignment
+     * Alignment used by allocate() and clone() of this frame, see setDefaultAlignment().
+     * \param bytes a power of 2. 0: defaultAlignment()
+     */
+    void setAlignment(int bytes);
+    int alignment() const;
+    /*!
+     * \brief hasHostData
+     * false if frame data is on gpu, e.g. a frame from a hw decoder in zero copy mode, and not copied back.
+     * The first bits() or constBits() call copies back the data in format() if the surface interop supports it, so frames only
+     * rendered by OpenGL are never copied. Use this instead of constBits() to check whether data is on gpu
+     */
+    bool hasHostData() const;
     VideoFormat format() const;
     VideoFormat::PixelFormat pixelFormat() const;
     QImage::Format imageFormat() const;
@@ -94,6 +157,37 @@ public:
     // TODO: pixel aspect ratio
     ColorSpace colorSpace() const;
     void setColorSpace(ColorSpace value);
+    /*!
+     * \brief colorTransfer
+     * Transfer characteristics and primaries of the frame, set by decoders. OpenGL renderers convert PQ and HLG frames to
+     * the output of OpenGLVideo::setOutputColorTransfer() with tone and gamut mapping in shader
+     */
+    ColorTransfer colorTransfer() const;
+    void setColorTransfer(ColorTransfer value);
+    ColorPrimaries colorPrimaries() const;
+    void setColorPrimaries(ColorPrimaries value);
+    HDRMetadata hdrMetadata() const;
+    void setHDRMetadata(const HDRMetadata& value);
+    /*!
+     * \brief isInterlaced
+     * The frame is 2 fields of different time, top field is the even lines. Set by decoders. OpenGL renderers deinterlace it
+     * on gpu if OpenGLVideo::deinterlaceMode() is not NoDeinterlace
+     */
+    bool isInterlaced() const;
+    bool isTopFieldFirst() const;
+    void setInterlaced(bool interlaced, bool topFieldFirst = true);
+    /*!
+     * \brief field
+     * Field of an interlaced frame to display. 0: the first field in time (default), 1: the second field.
+     */
+    int field() const;
+    void setField(int value);
+    /*!
+     * \brief secondField
+     * A frame displaying field 1 which shares planes, metadata and gpu surface with this frame, no data is copied.
+     * Used to output interlaced frames at field rate. Timestamp is the same as this frame.
+     */
+    VideoFrame secondField() const;
 
     // no padded bytes
     int effectiveBytesPerLine(int plane) const;
@@ -101,15 +195,18 @@ public:
      * \brief toImage
      * Return a QImage of current video frame, with given format, image size and region of interest.
      * \param dstSize result image size
-     * \param roi NOT implemented!
+     * \param roi interested region of source frame. see to()
      */
     QImage toImage(QImage::Format fmt = QImage::Format_ARGB32, const QSize& dstSize = QSize(), const QRectF& roi = QRect()) const;
     /*!
      * \brief to
      * The result frame data is always on host memory.
      * \param pixfmt target pixel format
-     * \param dstSize target frame size
-     * \param roi interested region of source frame
+     * \param dstSize target frame size. roi size if not valid
+     * \param roi interested region of source frame in pixels. Only the region is converted and scaled. The left and top edges
+     * are moved to aligned positions of chroma subsampling if necessary. Null rect: the whole frame
+     * If data is on gpu and pixfmt is packed 32bit rgb, the frame is scaled and converted by OpenGL in an offscreen context
+     * and only the result is read back, otherwise it's copied back and converted by ImageConverter.
      */
     VideoFrame to(VideoFormat::PixelFormat pixfmt, const QSize& dstSize = QSize(), const QRectF& roi = QRect()) const;
     VideoFrame to(const VideoFormat& fmt, const QSize& dstSize = QSize(), const QRectF& roi = QRect()) const;
@@ -126,6 +223,12 @@ public:
      * \return null on error. otherwise return the input handle
      */
     void* createInteropHandle(void* handle, SurfaceType type, int plane);
+    /*!
+     * \brief surfaceInterop
+     * Interop of the gpu surface, set by hw decoders. Stored in the frame without allocation. metaData("surface_interop") is the same
+     */
+    VideoSurfaceInteropPtr surfaceInterop() const;
+    void setSurfaceInterop(const VideoSurfaceInteropPtr& value);
     //copy to host. Used if gpu filter not supported. To avoid copy too frequent, sort the filters first?
     //bool mapToHost();
     /*!
@@ -140,7 +243,6 @@ private:
     void init();
 };
 
-class ImageConverter;
 class Q_AV_EXPORT VideoFrameConverter
 {
 public:
@@ -157,7 +259,6 @@ public:
     VideoFrame convert(const VideoFrame& frame, QImage::Format fmt) const;
     VideoFrame convert(const VideoFrame& frame, int fffmt) const;
 private:
-    mutable ImageConverter *m_cvt;
     int m_eq[3];
 };
 } //namespace QtAV
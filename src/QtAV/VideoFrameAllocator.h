@@ -0,0 +1,61 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_VIDEOFRAMEALLOCATOR_H
+#define QTAV_VIDEOFRAMEALLOCATOR_H
+
+#include <QtCore/QSharedPointer>
+#include <QtAV/VideoFormat.h>
+
+namespace QtAV {
+/*!
+ * \brief The VideoFrameAllocator class
+ * Lets a decoder supporting direct rendering (FFmpeg software decoder) decode into memory provided by a renderer,
+ * e.g. shared memory of the display server, so that the renderer does not have to copy frames.
+ * A renderer provides it by VideoRenderer::frameAllocator(), AVPlayer passes it to the video decoder.
+ * A renderer recognizes its frames by the plane addresses, e.g. VideoFrame::constBits(0).
+ */
+class Q_AV_EXPORT VideoFrameAllocator
+{
+public:
+    virtual ~VideoFrameAllocator() {}
+    /*!
+     * \brief allocate
+     * Called by decoding threads. MUST be thread safe. Must not block for a long time, e.g. display server round trips.
+     * \param fmt pixel format of the decoded frame
+     * \param width padded width required by the decoder, >= frame width
+     * \param height padded height
+     * \param align plane addresses and line sizes must be multiples of it
+     * \param data plane addresses. Each plane is readable for 16 + align bytes after its last line
+     * \param linesize line sizes of planes
+     * \return a handle passed to release(). 0 if not supported, then the decoder allocates itself
+     */
+    virtual void* allocate(VideoFormat::PixelFormat fmt, int width, int height, int align, quint8* data[4], int linesize[4]) = 0;
+    /*!
+     * \brief release
+     * Called when the decoder and all frames no longer reference the buffer. Can be in any thread, and after the renderer is destroyed
+     * if frames are still held by others.
+     */
+    virtual void release(void* handle) = 0;
+};
+typedef QSharedPointer<VideoFrameAllocator> VideoFrameAllocatorPtr;
+} //namespace QtAV
+#endif // QTAV_VIDEOFRAMEALLOCATOR_H
@@ -23,6 +23,8 @@
 #define QTAV_VIDEOFRAMEEXTRACTOR_H
 
 #include <QtCore/QObject>
+#include <QtCore/QList>
+#include <QtCore/QThread>
 #include <QtAV/VideoFrame.h>
 
 namespace QtAV {
@@ -37,6 +39,7 @@ class Q_AV_EXPORT VideoFrameExtractor : public QObject
     Q_PROPERTY(bool async READ async WRITE setAsync NOTIFY asyncChanged)
     Q_PROPERTY(int precision READ precision WRITE setPrecision NOTIFY precisionChanged)
     Q_PROPERTY(qint64 position READ position WRITE setPosition NOTIFY positionChanged)
+    Q_PROPERTY(bool keyFrameOnly READ keyFrameOnly WRITE setKeyFrameOnly NOTIFY keyFrameOnlyChanged)
 public:
     explicit VideoFrameExtractor(QObject *parent = 0);
     /*!
@@ -66,6 +69,46 @@ public:
     int precision() const;
     void setPosition(qint64 value);
     qint64 position() const;
+    /*!
+     * \brief setKeyFrameOnly
+     * Fast preview mode, e.g. for seek bar hovering. The key frame before the position is extracted regardless of precision(),
+     * and only key frames are decoded (skip_frame=nonkey) with low resolution if the codec supports it, so an extraction
+     * is about 1 intra frame decode. Default is false.
+     */
+    void setKeyFrameOnly(bool value);
+    bool keyFrameOnly() const;
+    /*!
+     * \brief extractBatch
+     * Extract frames at a list of positions, e.g. thumbnails for a seek bar. Positions are sorted and frames are decoded
+     * forward in one pass, seeking only if the next position is not in the current GOP. A frame is accepted if it's not
+     * earlier than position - precision(). batchFrameExtracted() is emitted for each position, then batchFinished().
+     * In async mode, it's ignored like setPosition() if an extraction is running.
+     * \param positions in ms. Index in this list is used in batchFrameExtracted()
+     * \param size size of result frames. Frames are scaled while converted to RGB32. If width or height <= 0, it's computed
+     * from the other one and frame aspect ratio. Invalid size: original size and format
+     */
+    void extractBatch(const QList<qint64>& positions, const QSize& size = QSize());
+    /*!
+     * \brief setFrameSize
+     * Size of frames emitted by frameExtracted(). See extractBatch(). Scaled frames are smaller in frame cache.
+     */
+    void setFrameSize(const QSize& value);
+    QSize frameSize() const;
+    /*!
+     * \brief setCacheSize
+     * Extracted frames are kept in a least recently used cache shared by all extractors, keyed by source, position
+     * rounded by precision() and frameSize(). extract() uses a cached frame if it's in precision() instead of seeking.
+     * \param bytes max size of cached frames in memory. 0: disable. Default is 32MB
+     */
+    static void setCacheSize(qint64 bytes);
+    static qint64 cacheSize();
+    /*!
+     * \brief setDiskCacheDirectory
+     * The second tier of frame cache which survives restarts. Frames are stored as png files in dir.
+     * \param dir empty: disable disk cache. Default is empty
+     */
+    static void setDiskCacheDirectory(const QString& dir);
+    static QString diskCacheDirectory();
 
     virtual bool event(QEvent *e);
 signals:
@@ -80,8 +123,11 @@ signals:
      */
     void positionChanged();
     void precisionChanged();
+    void keyFrameOnlyChanged();
 
     void aboutToExtract(qint64 pos);
+    void batchFrameExtracted(int index, qint64 position, const QtAV::VideoFrame& frame);
+    void batchFinished();
 
 public slots:
     /*!
@@ -93,11 +139,72 @@ public slots:
     void extract();
 private slots:
     void extractInternal(qint64 pos);
+private:
+    void extractBatchInternal(const QList<qint64>& positions, const QSize& size);
 
 protected:
     //VideoFrameExtractor(VideoFrameExtractorPrivate &d, QObject* parent = 0);
     DPTR_DECLARE(VideoFrameExtractor)
 };
 
+class VideoFrameExtractorPoolPrivate;
+/*!
+ * \brief The VideoFrameExtractorPool class
+ * Extract frames of many files with a fixed number of worker threads, e.g. thumbnails of a media library.
+ * Each worker keeps its demuxer for requests of the same file and its decoder for files with the same codec parameters.
+ * Requests of higher priority are extracted first, e.g. visible items. frameExtracted() and error() are emitted in worker threads.
+ */
+class Q_AV_EXPORT VideoFrameExtractorPool : public QObject
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(VideoFrameExtractorPool)
+public:
+    explicit VideoFrameExtractorPool(QObject *parent = 0);
+    ~VideoFrameExtractorPool();
+    /*!
+     * \brief setWorkerCount
+     * Default is QThread::idealThreadCount()/2, at least 1
+     */
+    void setWorkerCount(int value);
+    int workerCount() const;
+    // see VideoFrameExtractor. applied to new requests
+    void setPrecision(int value);
+    int precision() const;
+    void setKeyFrameOnly(bool value);
+    bool keyFrameOnly() const;
+    /*!
+     * \brief setFrameSize
+     * Result frames are scaled to size while converted to RGB32. See VideoFrameExtractor::extractBatch()
+     */
+    void setFrameSize(const QSize& value);
+    QSize frameSize() const;
+    /*!
+     * \brief setThreadPolicy
+     * Scheduling of the workers, applied when a worker starts. See AVPlayer::setThreadPolicy()
+     * \param priority default is QThread::LowPriority
+     * \param cpuMask bit i: cpu i. 0: any cpu (default)
+     */
+    void setThreadPolicy(QThread::Priority priority, quint64 cpuMask = 0);
+    QThread::Priority threadPriority() const;
+    quint64 threadAffinity() const;
+    /*!
+     * \brief request
+     * Queue a request to extract the frame at position (ms) of file.
+     * \return request id, used by frameExtracted(), error(), setPriority() and cancel()
+     */
+    int request(const QString& file, qint64 position, int priority = 0);
+    // change the priority of a queued request. return false if it's not queued
+    bool setPriority(int id, int priority);
+    // remove a queued request. return false if it's not queued, e.g. running or finished
+    bool cancel(int id);
+    void cancelAll();
+    int pendingCount() const;
+Q_SIGNALS:
+    void frameExtracted(int id, const QString& file, qint64 position, const QtAV::VideoFrame& frame);
+    void error(int id, const QString& file, qint64 position);
+private:
+    DPTR_DECLARE(VideoFrameExtractorPool)
+};
+
 } //namespace QtAV
 #endif // QTAV_VIDEOFRAMEEXTRACTOR_H
@@ -64,6 +64,7 @@ public:
     QWindow* qwindow() Q_DECL_OVERRIDE Q_DECL_FINAL;
     QWidget* widget() Q_DECL_OVERRIDE Q_DECL_FINAL;
     QGraphicsItem* graphicsItem() Q_DECL_OVERRIDE Q_DECL_FINAL;
+    VideoFrameAllocatorPtr frameAllocator() Q_DECL_OVERRIDE Q_DECL_FINAL;
 
 Q_SIGNALS:
     void sourceAspectRatioChanged(qreal value) Q_DECL_OVERRIDE Q_DECL_FINAL;
@@ -89,6 +90,7 @@ private:
     virtual void onSetOutAspectRatioMode(OutAspectRatioMode mode) Q_DECL_OVERRIDE;
     virtual void onSetOutAspectRatio(qreal ratio) Q_DECL_OVERRIDE;
     virtual bool onSetQuality(Quality q) Q_DECL_OVERRIDE;
+    virtual bool onSetPowerSaving(bool value) Q_DECL_OVERRIDE;
     virtual bool onSetOrientation(int value) Q_DECL_OVERRIDE;
     virtual void onResizeRenderer(int width, int height) Q_DECL_OVERRIDE;
     virtual bool onSetRegionOfInterest(const QRectF& roi) Q_DECL_OVERRIDE;
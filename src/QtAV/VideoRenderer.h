@@ -27,6 +27,7 @@
 #include <QtCore/QRectF>
 #include <QtAV/AVOutput.h>
 #include <QtAV/VideoFrame.h>
+#include <QtAV/VideoFrameAllocator.h>
 #include <QtAV/FactoryDefine.h>
 
 /*!
@@ -106,6 +107,14 @@ public:
 
     void setQuality(Quality q);
     Quality quality() const;
+    /*!
+     * \brief setPowerSaving
+     * Repaint at the content frame rate. Repaint requests posted by the renderer (new frames and property changes) are
+     * coalesced, at most 1 is pending in the ui thread, so frames and changes arriving while the ui thread is busy are drawn
+     * by 1 repaint. OpenGL renderers draw repaints of unchanged content from a cache. Default is false
+     */
+    void setPowerSaving(bool value);
+    bool isPowerSaving() const;
 
     void resizeRenderer(const QSize& size);
     void resizeRenderer(int width, int height);
@@ -167,6 +176,13 @@ public:
      * \return default is 0. A QGraphicsItem subclass can return \a this
      */
     virtual QGraphicsItem* graphicsItem() { return 0; }
+    /*!
+     * \brief frameAllocator
+     * Memory a video decoder can decode into directly, e.g. shared memory of XVideo images. Used by AVPlayer if the renderer
+     * is the only video output.
+     * \return default is null, i.e. frames are decoded into the decoder's own buffers
+     */
+    virtual VideoFrameAllocatorPtr frameAllocator() { return VideoFrameAllocatorPtr(); }
 
     /*!
      * \brief brightness, contrast, hue, saturation
@@ -209,6 +225,7 @@ private: //used by VideoOutput class
     virtual void onSetOutAspectRatioMode(OutAspectRatioMode mode);
     virtual void onSetOutAspectRatio(qreal ratio);
     virtual bool onSetQuality(Quality q);
+    virtual bool onSetPowerSaving(bool value);
     virtual void onResizeRenderer(int width, int height);
     virtual bool onSetOrientation(int value);
     virtual bool onSetRegionOfInterest(const QRectF& roi);
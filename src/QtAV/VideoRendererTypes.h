@@ -29,6 +29,7 @@ namespace QtAV {
 //Q_AV_EXPORT(dllexport/import) is needed if used out of the library
 //TODO graphics item?
 extern Q_AV_EXPORT VideoRendererId VideoRendererId_OpenGLWindow;
+extern Q_AV_EXPORT VideoRendererId VideoRendererId_VulkanWindow;
 
 Q_AV_EXPORT void VideoRenderer_RegisterAll();
 
@@ -23,6 +23,7 @@
 #define QTAV_VIDEOSHADER_H
 
 #include <QtAV/VideoFrame.h>
+#include <QtAV/ColorLUT.h>
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
 #include <QtGui/QOpenGLShaderProgram>
 #else
@@ -89,6 +90,8 @@ protected:
 private:
     void setVideoFormat(const VideoFormat& format);
     void setTextureTarget(int type);
+    void setDeinterlaceMode(DeinterlaceMode value);
+    void setColorManagement(bool enabled, ColorTransfer in, ColorTransfer out, ToneMapping toneMapping);
     friend class VideoMaterial;
 };
 
@@ -156,12 +159,47 @@ public:
     void setContrast(qreal value);
     void setHue(qreal value);
     void setSaturation(qreal value);
+    /*!
+     * \brief setDeinterlaceMode
+     * Interlaced frames (VideoFrame::isInterlaced()) are deinterlaced by the shader in given mode, and the field
+     * VideoFrame::field() is displayed. Progressive frames are not affected. Default is NoDeinterlace
+     */
+    void setDeinterlaceMode(DeinterlaceMode value);
+    DeinterlaceMode deinterlaceMode() const;
+    /*!
+     * \brief setOutputColorTransfer
+     * Frames of a different transfer (VideoFrame::colorTransfer()) or primaries are converted to the output in shader.
+     * Use ColorTransfer_PQ for an HDR10 surface, whose primaries are BT.2020. Only planar formats are converted.
+     * \param peakLuminance peak luminance of the display in nits. 0: 100 for SDR, 1000 for PQ
+     */
+    void setOutputColorTransfer(ColorTransfer value, qreal peakLuminance = 0);
+    ColorTransfer outputColorTransfer() const;
+    qreal outputPeakLuminance() const;
+    /*!
+     * \brief setToneMapping
+     * The curve mapping frames brighter than the output peak luminance. Default is ToneMappingBT2390
+     */
+    void setToneMapping(ToneMapping value);
+    ToneMapping toneMapping() const;
+    /*!
+     * \brief setColorLUT
+     * Apply a 3D LUT to rgb after yuv conversion (and tone mapping), with trilinear interpolation in shader.
+     * The LUT is stored in a 2D texture of size*size x size, so no 3D texture support is required. Invalid LUT: disable
+     */
+    void setColorLUT(const ColorLUT& value);
+    ColorLUT colorLUT() const;
+    /*!
+     * \brief textureMemory
+     * Estimated bytes of textures and PBOs allocated by the material. Textures from surface interop are not included
+     */
+    qint64 textureMemory() const;
 protected:
     // TODO: roi
     // whether to update texture is set internal
     void bindPlane(int p, bool updateTexture = true);
     VideoMaterial(VideoMaterialPrivate &d);
     DPTR_DECLARE(VideoMaterial)
+    friend class VideoShader;
 };
 
 class Q_AV_EXPORT TexturedGeometry {
@@ -0,0 +1,105 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_VIDEOWALLMANAGER_H
+#define QTAV_VIDEOWALLMANAGER_H
+
+#include <QtAV/QtAV_Global.h>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QSize>
+
+/*
+ * Keep many players of a video wall, e.g. 64 cameras, in the cpu/gpu budget of one host. Each player is given a quality
+ * tier by the visible size of its renderers and the focus:
+ *   FullDecode: the focused player. FFmpeg decoder priority 2 in the shared thread budget (VideoDecoder::setSoftwareThreadBudget())
+ *   ReducedDecode: visible tiles. Decoded at the tile size (AVPlayer::setReducedResolutionDecode()), priority 1
+ *   KeyFrameDecode: visible tiles exceeding maxDecoders(). Key frames only (AVPlayer::setKeyFrameOnlyDecode()), priority 0
+ *   Paused: hidden tiles. Resumed at the wall clock position
+ * Sizes are polled, and a tier is changed only if it's the same for 2 polls, because a change may reopen the decoder and seek.
+ * Players can follow a wall clock by AVClock::setReferenceClock(), so tiles of the same time are displayed together.
+ */
+namespace QtAV {
+
+class AVClock;
+class AVPlayer;
+class Q_AV_EXPORT VideoWallManager : public QObject
+{
+    Q_OBJECT
+public:
+    enum Tier {
+        FullDecode,
+        ReducedDecode,
+        KeyFrameDecode,
+        Paused
+    };
+    VideoWallManager(QObject *parent = 0);
+    ~VideoWallManager();
+    /// manage player. players are removed when destroyed. tier() is updated in next poll
+    void addPlayer(AVPlayer *player);
+    /// the player is restored to full quality, playing and not following clock()
+    void removePlayer(AVPlayer *player);
+    QList<AVPlayer*> players() const;
+    /*!
+     * \brief setVisibleSize
+     * The on-screen size of the player's tile, e.g. clipped by a scroll area or covered by another window, which the wall
+     * can not detect. An empty size is hidden.
+     * \param size invalid: the largest size of the player's renderers whose widget or window is visible (default)
+     */
+    void setVisibleSize(AVPlayer *player, const QSize& size);
+    /// the last polled visible size
+    QSize visibleSize(AVPlayer *player) const;
+    /// the focused player decodes at full quality. changed immediately. null: no focus
+    void setFocusPlayer(AVPlayer *player);
+    AVPlayer* focusPlayer() const;
+    /*!
+     * \brief setMaxDecoders
+     * Max players decoding every frame, i.e. FullDecode and ReducedDecode. Larger tiles are preferred, others decode key frames only.
+     * \param value <=0: no limit (default)
+     */
+    void setMaxDecoders(int value);
+    int maxDecoders() const;
+    /// poll interval in ms. default is 500
+    void setInterval(int ms);
+    int interval() const;
+    /*!
+     * \brief setClock
+     * Players follow clock by AVClock::setReferenceClock(), e.g. a running external clock or AVPlayer::masterClock() of a
+     * player not in the wall. Paused players are resumed at its position. It must live until it's replaced
+     * \param clock null: players use their own clocks (default)
+     */
+    void setClock(AVClock *clock);
+    AVClock* clock() const;
+    Tier tier(AVPlayer *player) const;
+    /// evaluate tiers now. called by the poll timer
+    void update();
+Q_SIGNALS:
+    void tierChanged(QtAV::AVPlayer *player, QtAV::VideoWallManager::Tier tier);
+protected:
+    void timerEvent(QTimerEvent *e) Q_DECL_OVERRIDE;
+private Q_SLOTS:
+    void onPlayerDestroyed(QObject *obj);
+private:
+    class Private;
+    Private *d;
+};
+} //namespace QtAV
+#endif // QTAV_VIDEOWALLMANAGER_H
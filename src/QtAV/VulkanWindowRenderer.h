@@ -0,0 +1,67 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_VULKANWINDOWRENDERER_H
+#define QTAV_VULKANWINDOWRENDERER_H
+#include <QtGui/QVulkanWindow>
+#include <QtAV/VideoRenderer.h>
+
+namespace QtAV {
+
+class VulkanWindowRendererPrivate;
+/*!
+ * \brief The VulkanWindowRenderer class
+ * Render video frames in a QVulkanWindow by VulkanVideoMaterial. Host memory frames are uploaded by command buffers
+ * of the renderer, and dma-buf frames of hardware decoders, e.g. vaapi, are imported without copy if supported.
+ * A default QVulkanInstance is used if vulkanInstance() is not set when the renderer is created.
+ * Orientation is not supported yet.
+ */
+class Q_AV_EXPORT VulkanWindowRenderer : public QVulkanWindow, public VideoRenderer
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(VulkanWindowRenderer)
+    Q_PROPERTY(qreal sourceAspectRatio READ sourceAspectRatio NOTIFY sourceAspectRatioChanged)
+public:
+    explicit VulkanWindowRenderer(QWindow *parent = 0);
+    ~VulkanWindowRenderer();
+    virtual VideoRendererId id() const Q_DECL_OVERRIDE;
+    virtual bool isSupported(VideoFormat::PixelFormat pixfmt) const Q_DECL_OVERRIDE;
+    QWindow* qwindow() Q_DECL_OVERRIDE Q_DECL_FINAL { return this; }
+    virtual QVulkanWindowRenderer* createRenderer() Q_DECL_OVERRIDE;
+Q_SIGNALS:
+    void sourceAspectRatioChanged(qreal value) Q_DECL_OVERRIDE Q_DECL_FINAL;
+protected:
+    virtual bool receiveFrame(const VideoFrame& frame) Q_DECL_OVERRIDE;
+    virtual void drawFrame() Q_DECL_OVERRIDE;
+    virtual void resizeEvent(QResizeEvent *) Q_DECL_OVERRIDE;
+private:
+    virtual bool onSetBrightness(qreal b) Q_DECL_OVERRIDE;
+    virtual bool onSetContrast(qreal c) Q_DECL_OVERRIDE;
+    virtual bool onSetHue(qreal h) Q_DECL_OVERRIDE;
+    virtual bool onSetSaturation(qreal s) Q_DECL_OVERRIDE;
+    // record the commands of the current frame in QVulkanWindowRenderer::startNextFrame()
+    void renderFrame();
+    friend class VulkanFrameRenderer;
+};
+typedef VulkanWindowRenderer VideoRendererVulkanWindow;
+
+} //namespace QtAV
+#endif // QTAV_VULKANWINDOWRENDERER_H
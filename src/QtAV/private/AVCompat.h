@@ -145,6 +145,10 @@ int avformat_alloc_output_context2(AVFormatContext **avctx, AVOutputFormat *ofor
 
 //FFmpeg2.0, Libav10 2013-03-08 - Reference counted buffers - lavu 52.19.100/52.8.0, lavc 55.0.100 / 55.0.0, lavf 55.0.100 / 55.0.0, lavd 54.4.100 / 54.0.0, lavfi 3.5.0
 #define QTAV_HAVE_AVBUFREF AV_MODULE_CHECK(LIBAVUTIL, 52, 8, 0, 19, 100)
+//ffmpeg2.1 libav10. av_packet_ref()/av_packet_unref()
+#define QTAV_HAVE_AVPACKET_REF AV_MODULE_CHECK(LIBAVCODEC, 55, 34, 1, 39, 101)
+//ffmpeg3.1 libav12. avcodec_send_packet()/avcodec_receive_frame()
+#define QTAV_HAVE_SEND_RECEIVE AV_MODULE_CHECK(LIBAVCODEC, 57, 16, 0, 37, 100)
 
 /*TODO: libav
 avutil: error.h
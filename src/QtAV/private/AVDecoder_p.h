@@ -26,52 +26,41 @@
 #include <QtCore/QHash>
 #include <QtCore/QMetaType>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QSize>
 #include <QtCore/QVector>
+#include "QtAV/Frame.h"
+#include "QtAV/VideoFrameAllocator.h"
 #include "QtAV/private/AVCompat.h"
 
 namespace QtAV {
 
+class Packet;
 // always define the class to avoid macro check when using it
-class AVFrameBuffers {
-#if QTAV_HAVE(AVBUFREF)
-    QVector<AVBufferRef*> buf;
-#endif
+class AVFrameBuffers : public FrameBuffer {
+    AVFrame *m_frame;
 public:
-    AVFrameBuffers(AVFrame* frame) {
+    /*!
+     * Keep a reference of a ref counted frame, i.e. its buffers and properties. Nothing is kept if frame is not ref counted.
+     */
+    AVFrameBuffers(AVFrame* frame) : m_frame(0) {
         Q_UNUSED(frame);
 #if QTAV_HAVE(AVBUFREF)
         if (!frame->buf[0]) { //not ref counted. duplicate data?
             return;
         }
-
-        buf.reserve(frame->nb_extended_buf + FF_ARRAY_ELEMS(frame->buf));
-        buf.resize(frame->nb_extended_buf + FF_ARRAY_ELEMS(frame->buf));
-        for (int i = 0; i < (int)FF_ARRAY_ELEMS(frame->buf); ++i) {
-            if (!frame->buf[i]) //so not use planes + nb_extended_buf!
-                continue;
-            buf[i] = av_buffer_ref(frame->buf[i]);
-            if (!buf[i]) {
-                qWarning("av_buffer_ref(frame->buf[%d]) error", i);
-            }
-        }
-        if (!frame->extended_buf)
-            return;
-        for (int i = 0; i < frame->nb_extended_buf; ++i) {
-            const int k = buf.size() + i - frame->nb_extended_buf;
-            buf[k] = av_buffer_ref(frame->extended_buf[i]);
-            if (!buf[k]) {
-                qWarning("av_buffer_ref(frame->extended_buf[%d]) error", i);
-            }
-        }
+        m_frame = av_frame_clone(frame);
+        if (!m_frame)
+            qWarning("av_frame_clone error");
 #endif //QTAV_HAVE(AVBUFREF)
     }
     ~AVFrameBuffers() {
 #if QTAV_HAVE(AVBUFREF)
-        foreach (AVBufferRef* b, buf) {
-            av_buffer_unref(&b);
-        }
+        av_frame_free(&m_frame);
 #endif //QTAV_HAVE(AVBUFREF)
     }
+    /// the ref counted frame, e.g. to feed libavfilter without copy. null if not ref counted
+    const AVFrame* frame() const { return m_frame;}
+    const AVFrame* avframe() const Q_DECL_OVERRIDE { return m_frame;}
 };
 typedef QSharedPointer<AVFrameBuffers> AVFrameBuffersRef;
 
@@ -112,6 +101,15 @@ public:
     virtual bool enableFrameRef() const { return true;}
     void applyOptionsForDict();
     void applyOptionsForContext();
+    /*!
+     * \brief sendReceive
+     * Send/receive decoding of FFmpeg based decoders (avcodec_send_packet()/avcodec_receive_frame()). Send the packet and
+     * take the first frame. Frames left in the decoder are taken by AVDecoder::receiveFrame(). If the caller did not take
+     * them and the decoder can not accept the packet, a frame is taken first, and undecoded_size is the packet size if
+     * it's still not accepted, so the thread decodes the packet again as it does for the rest data of old api.
+     * \return 1: a frame is decoded. 0: no frame yet. AVERROR_EOF: all frames are taken after an eof packet. <0: error
+     */
+    int sendReceive(const Packet& packet, AVFrame *frame);
 
     AVCodecContext *codec_ctx; //set once and not change
     bool available; //TODO: true only when context(and hw ctx) is ready
@@ -140,9 +138,32 @@ public:
         AVDecoderPrivate()
       , width(0)
       , height(0)
+      , pipeline_depth(2)
+      , surface_starvation(0)
+      , surface_bytes(0)
+      , bitstream_filtered(false)
     {}
     virtual ~VideoDecoderPrivate() {}
+    /*!
+     * surfaces a hardware decoder needs: codec reference frames + current frame + frames in frame threads + pipeline_depth
+     * \param frameThreads frames being decoded by other frame threads
+     */
+    int autoSurfaceCount(const AVCodecContext* avctx, int frameThreads) const;
+    /// stamp of the driver validating capability records. empty: records are only limited by age
+    virtual QByteArray capabilityStamp() const { return QByteArray();}
+    /*!
+     * record whether the hardware can decode codec, profile and bit depth of codec_ctx at its size. see VideoDecoder::isSupported()
+     * Call it with false only if the hardware or driver definitely rejects the stream, not for a transient error
+     * \param decoder VideoDecoder::name()
+     */
+    void reportCapability(const QString& decoder, bool supported) const;
     int width, height;
+    int pipeline_depth;
+    int surface_starvation; // no free surface in getBuffer(). updated in decoding thread
+    qint64 surface_bytes; // estimated memory of allocated hw surfaces. updated when surfaces are created and destroyed
+    VideoFrameAllocatorPtr frame_allocator;
+    QSize output_size_hint;
+    bool bitstream_filtered; // packets are filtered by the demuxer
 };
 } //namespace QtAV
 
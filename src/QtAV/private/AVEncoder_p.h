@@ -71,6 +71,7 @@ class AudioEncoderPrivate : public AVEncoderPrivate
 public:
     AudioEncoderPrivate()
         : AVEncoderPrivate()
+        , frame_size(0)
     {
         bit_rate = 64000;
     }
@@ -79,6 +80,7 @@ public:
 
     AudioResampler *resampler;
     AudioFormat format, format_used;
+    int frame_size; // set in open(). 0: variable
 };
 
 class Q_AV_PRIVATE_EXPORT VideoEncoderPrivate : public AVEncoderPrivate
@@ -91,6 +93,7 @@ public:
       , frame_rate(-1)
       , format_used(VideoFormat::Format_Invalid)
       , format(format_used)
+      , source_format(VideoFormat::Format_Invalid)
     {
         bit_rate = 400000;
     }
@@ -99,6 +102,7 @@ public:
     qreal frame_rate;
     VideoFormat::PixelFormat format_used;
     VideoFormat format;
+    VideoFormat::PixelFormat source_format; // used if format is not set and supported by codec
 };
 } //namespace QtAV
 #endif // QTAV_AVENCODER_P_H
@@ -37,6 +37,10 @@ public:
     bool available; // default is true. set to false when failed to create backend
     int buffer_size;
     int buffer_count;
+    /// low latency profile requested. open() may change buffer_size and buffer_count to the negotiated period
+    bool low_latency;
+    /// FFmpeg codec id of IEC 61937 bursts in data if not 0. set by AudioOutput before open(). format is the s16 stereo burst format
+    int passthrough_codec;
     AudioFormat format;
     /*!
      * \brief AudioOutputBackend
@@ -48,6 +52,13 @@ public:
     virtual bool open() = 0;
     virtual bool close() = 0;
     virtual bool write(const QByteArray& data) = 0; //MUST
+    /*!
+     * \brief writeShared
+     * data is an owned buffer that nobody modifies any more, e.g. the data of a pooled AudioFrame. A backend whose api queues
+     * buffers without copying can keep a reference of data until it's played, and put it back to FrameBufferPool when the
+     * slot is reused. Default is write(data)
+     */
+    virtual bool writeShared(const QByteArray& data) { return write(data);}
     virtual bool play() = 0; //MUST
     virtual bool isSupported(const AudioFormat& format) const { return isSupported(format.sampleFormat()) && isSupported(format.channelLayout());}
     virtual bool isSupported(AudioFormat::SampleFormat) const { return true;}
@@ -63,6 +74,12 @@ public:
      * \return the preferred channel layout. default is stero
      */
     virtual AudioFormat::ChannelLayout preferredChannelLayout() const { return AudioFormat::ChannelLayout_Stero;}
+    /*!
+     * \brief isPassthroughSupported
+     * \param codecId FFmpeg codec id, e.g. AV_CODEC_ID_AC3
+     * \return true if the device can receive IEC 61937 bursts of the codec, i.e. open() works with passthrough_codec. default is false
+     */
+    virtual bool isPassthroughSupported(int codecId) const { Q_UNUSED(codecId); return false;}
     /*!
      * \brief The BufferControl enum
      * Used to adapt to different audio playback backend. Usually you don't need this in application level development.
@@ -77,10 +94,22 @@ public:
         OffsetIndex = 1 << 5, //current playing offset
         OffsetBytes = 1 << 6, //current playing offset by bytes
         WritableBytes = 1 << 7,
+        /*!
+         * The backend pulls data by pullData() in its own data callback and write() is not called. AudioOutput writes
+         * data to a lock free ring and sleeps until the callback frees enough space, no polling.
+         */
+        Pull = 1 << 8,
     };
     virtual BufferControl bufferControl() const = 0;
     // called by callback with Callback control
     virtual void onCallback();
+    /*!
+     * \brief pullData
+     * Called by the data callback with Pull control. Copy queued data to data, and fill silence if less than bytes are queued.
+     * Never blocks.
+     * \return bytes of real data copied
+     */
+    int pullData(char* data, int bytes);
     //default return -1. means not the control
     virtual int getPlayedCount() {return -1;} //PlayedCount
     /*!
@@ -92,6 +121,12 @@ public:
     virtual int getOffset() {return -1;}        // OffsetIndex
     virtual int getOffsetByBytes()  {return -1;}// OffsetBytes
     virtual int getWritableBytes() {return -1;} //WritableBytes
+    /*!
+     * \brief getLatency
+     * Time in seconds from the data written or pulled to the data being heard, measured by the backend api.
+     * \return negative if not supported
+     */
+    virtual qreal getLatency() { return -1;}
     // not virtual. called in ctor
     AudioOutput::DeviceFeatures supportedFeatures() { return m_features;}
     /*!
@@ -36,6 +36,9 @@ public:
         in_samples_per_channel(0)
       , out_samples_per_channel(0)
       , speed(1.0)
+      , volume(1.0)
+      , volume_applied(true)
+      , passthrough(false)
     {
         in_format.setSampleFormat(AudioFormat::SampleFormat_Unknown);
         out_format.setSampleFormat(AudioFormat::SampleFormat_Float);
@@ -43,6 +46,9 @@ public:
 
     int in_samples_per_channel, out_samples_per_channel;
     qreal speed;
+    qreal volume;
+    bool volume_applied; // set by prepare()
+    bool passthrough; // set by prepare()
     AudioFormat in_format, out_format;
     QByteArray data_out;
 };
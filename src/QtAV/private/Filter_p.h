@@ -23,6 +23,8 @@
 #define QTAV_FILTER_P_H
 
 #include <QtAV/QtAV_Global.h>
+#include <QtAV/Statistics.h>
+#include <QtCore/QMutex>
 
 namespace QtAV {
 
@@ -37,9 +39,23 @@ public:
       , owned_by_target(false)
     {}
     virtual ~FilterPrivate() {}
+    void addTiming(qint64 ns) {
+        QMutexLocker lock(&timing_mutex);
+        Q_UNUSED(lock);
+        ++timing.frames;
+        timing.time.add(qreal(ns)/1000.0);
+    }
+    void addSkipped() {
+        QMutexLocker lock(&timing_mutex);
+        Q_UNUSED(lock);
+        ++timing.skipped;
+    }
 
     bool enabled;
     bool owned_by_target;
+    // profiling, see Filter::timing(). name is not used
+    mutable QMutex timing_mutex;
+    Statistics::FilterTiming timing;
 };
 
 class Q_AV_PRIVATE_EXPORT VideoFilterPrivate : public FilterPrivate
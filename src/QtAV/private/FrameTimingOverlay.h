@@ -0,0 +1,91 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_FRAMETIMINGOVERLAY_H
+#define QTAV_FRAMETIMINGOVERLAY_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QRect>
+#include <QtCore/QVector>
+#include <QtAV/QtAV_Global.h>
+
+QT_BEGIN_NAMESPACE
+class QPainter;
+QT_END_NAMESPACE
+namespace QtAV {
+
+class VideoFrame;
+/*!
+ * \brief The FrameTimingOverlay class
+ * Times of the last frames of a renderer: decode, upload, draw and the present interval, a stutter detector, and a graph of them
+ * painted over the video. Used by OpenGL renderers in the rendering thread only.
+ * Decode time is from "decode_time" metadata set by video thread if Statistics::isLatencyTracing(), so the overlay turns tracing on.
+ * The detector always runs. A presented frame stutters if its interval to the previous frame deviates from the frame duration
+ * by more than 3/4 vsync interval (half the frame duration if vsync is unknown), so 3:2 cadence is not a stutter but a missed
+ * vsync is. Intervals over 1s, e.g. paused, and timestamp jumps, e.g. seeking, are ignored. Playback speed is assumed to be 1.
+ * Enabled by default if environment var QTAV_FRAME_TIMING is 1.
+ */
+class Q_AV_PRIVATE_EXPORT FrameTimingOverlay
+{
+public:
+    enum Item { Decode, Upload, Draw, Present, ItemCount };
+    explicit FrameTimingOverlay(int frames = 120);
+    void setEnabled(bool value);
+    bool isEnabled() const;
+    /// number of frames in the graph
+    void setFrames(int value);
+    int frames() const;
+    /*!
+     * \brief frameDrawn
+     * Call after a frame is drawn. Repaints of the same frame are ignored
+     * \param uploadMs drawMs cpu time of uploading/binding textures and drawing
+     */
+    void frameDrawn(const VideoFrame& frame, qreal uploadMs, qreal drawMs);
+    /*!
+     * \brief framePresented
+     * Call after the drawn frame is presented, e.g. buffers swapped. Only the first presentation of a new frame is measured
+     * \param vsyncInterval in seconds. 0 if unknown
+     * \return true if a stutter is detected
+     */
+    bool framePresented(qreal vsyncInterval = 0);
+    int stutters() const;
+    /// paint the graph in the top left corner of viewport
+    void draw(QPainter *painter, const QRect& viewport) const;
+private:
+    struct Sample {
+        qreal ms[ItemCount];
+        qreal duration; // content frame duration in ms. 0 if unknown
+        bool stutter;
+    };
+    bool m_enabled;
+    int m_frames;
+    int m_stutters;
+    bool m_pending; // a new frame is drawn and not presented
+    qreal m_drawn_ts, m_presented_ts;
+    qint64 m_presented_ns;
+    Sample m_sample;
+    int m_next; // next slot in m_samples
+    QVector<Sample> m_samples;
+    QElapsedTimer m_clock;
+};
+
+} //namespace QtAV
+#endif //QTAV_FRAMETIMINGOVERLAY_H
@@ -22,28 +22,69 @@
 #ifndef QTAV_FRAME_P_H
 #define QTAV_FRAME_P_H
 
-#include <QtAV/QtAV_Global.h>
+#include <QtAV/Frame.h>
+#include <QtCore/QVarLengthArray>
 #include <QtCore/QVector>
 #include <QtCore/QVariant>
 #include <QtCore/QSharedData>
 
 namespace QtAV {
 
-class Frame;
+// plane arrays are stored in the frame. video has at most 4 planes, audio of more channels allocates
+enum { kInlinePlanes = 4 };
+// new elements are 0. QVarLengthArray does not initialize them
+template<typename T>
+inline void resizePlanes(QVarLengthArray<T, kInlinePlanes> *a, int size) {
+    const int old = a->size();
+    a->resize(size);
+    for (int i = old; i < size; ++i)
+        (*a)[i] = T();
+}
+template<typename T, typename C>
+inline void assignPlanes(QVarLengthArray<T, kInlinePlanes> *dst, const C& src) {
+    dst->resize(src.size());
+    for (int i = 0; i < src.size(); ++i)
+        (*dst)[i] = src[i];
+}
+
 class FramePrivate : public QSharedData
 {
     Q_DISABLE_COPY(FramePrivate)
 public:
     FramePrivate()
         : timestamp(0)
+        , side_mask(0)
     {}
     virtual ~FramePrivate() {}
+    /*!
+     * Called by Frame::bits() and constBits() if the plane address is not set, e.g. data of a hw decoded frame is still on gpu.
+     * Return true if planes are set.
+     */
+    virtual bool mapToHost() { return false; }
+    /*!
+     * Typed side data of the key stored by the derived class, e.g. "surface_interop" of video frames. Used by Frame::metaData()
+     * and setMetaData(). Return false if the key is not typed side data.
+     */
+    virtual bool sideMetaData(const QString& key, QVariant *value) const { Q_UNUSED(key); Q_UNUSED(value); return false;}
+    virtual bool setSideMetaData(const QString& key, const QVariant& value) { Q_UNUSED(key); Q_UNUSED(value); return false;}
+    virtual void availableSideMetaData(QVariantMap *map) const { Q_UNUSED(map);}
+    // metadata and side data of a frame converted or copied from other
+    virtual void copyMetaData(const FramePrivate* other) {
+        metadata = other->metadata;
+        buffer_ref = other->buffer_ref;
+        side_mask = other->side_mask;
+        for (int i = 0; i < Frame::SideDataCount; ++i)
+            side_data[i] = other->side_data[i];
+    }
 
-    QVector<uchar*> planes; //slice
-    QVector<int> line_sizes; //stride
+    QVarLengthArray<uchar*, kInlinePlanes> planes; //slice
+    QVarLengthArray<int, kInlinePlanes> line_sizes; //stride
     QVariantMap metadata;
     QByteArray data;
     qreal timestamp;
+    FrameBufferRef buffer_ref;
+    int side_mask; // bits of side_data set
+    qint64 side_data[Frame::SideDataCount];
 };
 
 } //namespace QtAV
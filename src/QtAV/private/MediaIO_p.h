@@ -30,17 +30,33 @@
 namespace QtAV {
 
 class MediaIO;
+class MediaIOReadAhead;
+class MediaIOWriteBehind;
 class Q_AV_PRIVATE_EXPORT MediaIOPrivate : public DPtrPrivate<MediaIO>
 {
 public:
     MediaIOPrivate()
         : ctx(0)
         , mode(MediaIO::Read)
+        , read_ahead(0)
+        , read_ahead_size(0)
+        , read_ahead_low(-1)
+        , write_behind(0)
+        , write_behind_size(0)
+        , write_behind_high(-1)
+        , buffer_size(-1)
+        , direct_read(false)
     {}
     // TODO: how to manage ctx?
     AVIOContext *ctx;
     MediaIO::AccessMode mode;
     QString url;
+    MediaIOReadAhead *read_ahead; // created in avioContext() if read_ahead_size > 0
+    int read_ahead_size, read_ahead_low;
+    MediaIOWriteBehind *write_behind; // created in avioContext() if write_behind_size > 0 and Write mode
+    int write_behind_size, write_behind_high;
+    int buffer_size; // avio buffer size. <=0: default
+    bool direct_read;
 };
 
 } //namespace QtAV
@@ -24,19 +24,70 @@
 
 #include "private/VideoRenderer_p.h"
 #include "QtAV/OpenGLVideo.h"
+#include "QtAV/private/FrameTimingOverlay.h"
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QPointer>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QtGui/QOpenGLBuffer>
+#include <QtGui/QOpenGLFramebufferObject>
+#endif
 
 namespace QtAV {
 
+class VideoFilter;
+
 class Q_AV_PRIVATE_EXPORT OpenGLRendererBasePrivate : public VideoRendererPrivate
 {
 public:
     OpenGLRendererBasePrivate(QPaintDevice *pd);
     virtual ~OpenGLRendererBasePrivate();
     void setupAspectRatio();
+    /*!
+     * Repaints without a new frame or a state change, e.g. paused, draw the last frame once into cache_fbo, then only blit it.
+     * Not used while playing, so there is no extra copy for new frames.
+     * \return true if the cache is blitted to the current framebuffer
+     */
+    bool drawCache();
+    bool prepareCache();
+    void releaseCache();
+    /*!
+     * Read back the current framebuffer for the capture filter. Called after painting, with filters and overlays drawn.
+     * Buffers whose readback is finished are delivered first, then the framebuffer is read into the next free buffer if
+     * newFrame. Nothing blocks unless pixel pack buffers are not supported.
+     */
+    void capture(bool newFrame);
+    void releaseCapture();
 
     QPainter *painter;
     OpenGLVideo glv;
     QMatrix4x4 matrix;
+    // content must be redrawn: new frame, resized, aspect ratio, orientation or color changed
+    bool damaged;
+    bool cache_valid;
+    QRect cache_roi;
+    qint64 latency_sent; // send time of the last traced frame, a frame can be swapped more than once
+    FrameTimingOverlay timing;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QOpenGLFramebufferObject *cache_fbo;
+#endif
+    QMutex capture_mutex;
+    QPointer<VideoFilter> capture_filter;
+    QAtomicInt capture_pending; // a new frame is received and not captured
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    // a ring of pixel pack buffers. a buffer is busy from glReadPixels() until it's mapped after its fence is signaled
+    struct CaptureBuffer {
+        CaptureBuffer() : pbo(QOpenGLBuffer::PixelPackBuffer), fence(0), busy(false), timestamp(0) {}
+        QOpenGLBuffer pbo;
+        void *fence;
+        bool busy;
+        QSize size;
+        qreal timestamp;
+    };
+    CaptureBuffer capture_buffers[3];
+    int capture_read; // the oldest busy buffer
+    int capture_write; // the next buffer to read into
+#endif
 };
 
 } //namespace QtAV
@@ -22,6 +22,7 @@
 #ifndef QTAV_PLAYERSUBTITLE_H
 #define QTAV_PLAYERSUBTITLE_H
 
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
 #include <QtCore/QVariant>
 #include <QtCore/QVector>
@@ -32,15 +33,19 @@ namespace QtAV {
 
 class AVPlayer;
 class Subtitle;
+class SubtitlePacketThread;
 /*!
  * \brief The PlayerSubtitle class
  * Bind Subtitle to AVPlayer. Used by SubtitleFilter and QuickSubtitle.
+ * Internal subtitle packets are queued in the demux thread and decoded in a thread of PlayerSubtitle, so decoding bitmap
+ * subtitles and adding libass events do not delay the demuxer or the gui thread.
  */
 class Q_AV_PRIVATE_EXPORT PlayerSubtitle : public QObject
 {
     Q_OBJECT
 public:
     PlayerSubtitle(QObject *parent = 0);
+    ~PlayerSubtitle();
     void setPlayer(AVPlayer* player);
     Subtitle* subtitle();
     /*!
@@ -72,12 +77,18 @@ private Q_SLOTS:
     void tryReload();
     void tryReloadInternalSub();
     void updateInternalSubtitleTracks(const QVariantList& tracks);
-    void processInternalSubtitlePacket(int track, const QtAV::Packet& packet);
+    // called in demux thread
+    void queueInternalSubtitlePacket(int track, const QtAV::Packet& packet);
     void processInternalSubtitleHeader(const QByteArray &codec, const QByteArray& data); //TODO: remove
 private:
     void connectSignals();
     void disconnectSignals();
     void tryReload(int flag); //1: internal, 2: external, 3: internal+external
+    void processInternalSubtitlePacket(const Packet& packet);
+    // queued packets are dropped. the decoding thread is stopped while the processor changes
+    void processHeader(const QByteArray& codec, const QByteArray& data);
+    void startPacketThread();
+    void stopPacketThread();
 private:
     bool m_auto;
     bool m_enabled; // TODO: m_enable_external
@@ -85,7 +96,10 @@ private:
     Subtitle *m_sub;
     QString m_file;
     QVariantList m_tracks;
+    QMutex m_pkt_mutex; // guards m_current_pkt, which is updated in demux thread
     QVector<Packet> m_current_pkt;
+    SubtitlePacketThread *m_thread;
+    friend class SubtitlePacketThread;
 };
 
 }
@@ -60,6 +60,8 @@ public:
     }
 
     QImage image;
+    VideoFrame image_frame; // owns the image data if it's converted from video_frame
+    QRect image_roi; // region of video_frame the image is scaled from. null: image is not scaled
     QPainter *painter;
 };
 
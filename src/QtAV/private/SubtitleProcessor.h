@@ -80,6 +80,8 @@ public:
     virtual QString getText(qreal pts) const = 0;
     // default null image
     virtual QImage getImage(qreal pts, QRect* boundingRect = 0);
+    // default invalid
+    virtual SubImageSet getSubImages(qreal pts, QRect* boundingRect = 0);
     void setFrameSize(int width, int height);
     QSize frameSize() const;
 
@@ -24,6 +24,7 @@
 
 #include <QtAV/private/AVOutput_p.h>
 #include <QtAV/VideoRenderer.h>
+#include <QtCore/QAtomicInt>
 #include <QtCore/QMutex>
 #include <QtCore/QRect>
 #include <QtAV/VideoFrame.h>
@@ -58,6 +59,8 @@ public:
       , contrast(0)
       , hue(0)
       , saturation(0)
+      , power_saving(false)
+      , update_posted(0)
     {
         //conv.setInFormat(PIX_FMT_YUV420P);
         //conv.setOutFormat(PIX_FMT_BGR32); //TODO: why not RGB32?
@@ -113,6 +116,9 @@ public:
     bool force_preferred;
 
     qreal brightness, contrast, hue, saturation;
+    bool power_saving;
+    // 1: an update request posted by updateUi() is not painted yet. used in power saving mode
+    QAtomicInt update_posted;
 };
 
 } //namespace QtAV
@@ -24,7 +24,9 @@
 
 #include "QtAV/VideoFrame.h"
 #include "QtAV/ColorTransform.h"
+#include "QtAV/ColorLUT.h"
 #include <QVector4D>
+#include <QtCore/QMutex>
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
 #include <QtGui/QOpenGLBuffer>
 #include <QtGui/QOpenGLShaderProgram>
@@ -56,7 +58,21 @@ public:
         , u_to8(-1)
         , u_opacity(-1)
         , u_c(-1)
+        , u_deint(-1)
+        , u_deintLines(-1)
+        , u_hdr(-1)
+        , u_gamut(-1)
+        , u_lut(-1)
+        , u_lutSize(-1)
+        , u_lutScale(-1)
+        , u_lutOffset(-1)
         , texture_target(GL_TEXTURE_2D)
+        , deinterlace(NoDeinterlace)
+        , color_managed(false)
+        , in_trc(ColorTransfer_SDR)
+        , out_trc(ColorTransfer_SDR)
+        , tone_mapping(ToneMappingBT2390)
+        , lut(false)
     {}
     virtual ~VideoShaderPrivate() {
         if (owns_program && program) {
@@ -76,17 +92,50 @@ public:
     int u_to8;
     int u_opacity;
     int u_c;
+    int u_deint;
+    int u_deintLines;
+    int u_hdr;
+    int u_gamut;
+    int u_lut;
+    int u_lutSize;
+    int u_lutScale;
+    int u_lutOffset;
     QVector<int> u_Texture;
     GLenum texture_target;
+    DeinterlaceMode deinterlace; // shader variant for interlaced frames
+    // shader variant converting transfer and primaries of frames to output
+    bool color_managed;
+    ColorTransfer in_trc, out_trc;
+    ToneMapping tone_mapping;
+    bool lut; // apply ColorLUT
     VideoFormat video_format;
     mutable QByteArray planar_frag, packed_frag;
     mutable QByteArray vert;
 };
 
+// storage of a texture. textures of the same key are interchangeable
+struct TextureKey {
+    TextureKey() : target(0), internal_format(0), format(0), type(0), width(0), height(0) {}
+    TextureKey(GLenum t, GLint ifmt, GLenum fmt, GLenum dt, int w, int h)
+        : target(t), internal_format(ifmt), format(fmt), type(dt), width(w), height(h) {}
+    bool operator==(const TextureKey& other) const {
+        return target == other.target && internal_format == other.internal_format && format == other.format
+                && type == other.type && width == other.width && height == other.height;
+    }
+    GLenum target;
+    GLint internal_format;
+    GLenum format;
+    GLenum type;
+    int width, height;
+};
+
 class VideoMaterial;
 class VideoMaterialPrivate : public DPtrPrivate<VideoMaterial>
 {
 public:
+    // a plane is uploaded from a ring of PBOs, so the driver can transfer frame N while frame N+1 is written to another one
+    // kLUTUnit: texture unit of ColorLUT. units before it are for planes
+    enum { kPBORingSize = 3, kLUTUnit = 4 };
     VideoMaterialPrivate()
         : update_texure(true)
         , init_textures_required(true)
@@ -98,8 +147,36 @@ public:
         , effective_tex_width_ratio(1.0)
         , target(GL_TEXTURE_2D)
         , try_pbo(true)
+        , tex16(false)
+        , pbo_slot(0)
+        , pbo_used(false)
+        , staged(false)
+        , persistent(false)
+        , deinterlace_mode(NoDeinterlace)
+        , deinterlace(NoDeinterlace)
+        , field_parity(0)
+        , in_trc(ColorTransfer_SDR)
+        , in_primaries(ColorPrimaries_BT709)
+        , out_trc(ColorTransfer_SDR)
+        , out_peak(0)
+        , tone_mapping(ToneMappingBT2390)
+        , lut_tex(0)
+        , lut_target(0)
+        , lut_changed(false)
+        , frame_data(0)
+        , frame_pts(0)
     {
+        for (int i = 0; i < kPBORingSize; ++i) {
+            pbo_storage[i] = 0;
+            pbo_storage_ptr[i] = 0;
+        }
+        for (int i = 0; i < 4; ++i) {
+            pbo_offset[i] = 0;
+            pbo_size[i] = 0;
+        }
+        pbo_storage_size = 0;
         textures.reserve(4);
+        texture_key.reserve(4);
         texture_size.reserve(4);
         texture_upload_size.reserve(4);
         effective_tex_width.reserve(4);
@@ -110,8 +187,11 @@ public:
         static bool enable_pbo = qgetenv("QTAV_PBO").toInt() > 0;
         if (try_pbo)
             try_pbo = enable_pbo;
-        pbo.reserve(4);
-        pbo.resize(4);
+        pbo.reserve(4*kPBORingSize);
+        pbo.resize(4*kPBORingSize);
+        pbo_fence.resize(kPBORingSize);
+        staging.resize(4);
+        staging_size.resize(4);
         // QOpenGLBuffer is shared, must initialize 1 by 1.
         for (int i = 0; i < pbo.size(); ++i)
             pbo[i] = QOpenGLBuffer(QOpenGLBuffer::PixelUnpackBuffer);
@@ -119,11 +199,60 @@ public:
     }
     ~VideoMaterialPrivate();
     bool initPBO(int plane, int size);
+    QOpenGLBuffer& currentPBO(int plane) { return pbo[plane*kPBORingSize + pbo_slot];}
+    /*!
+     * unmap the mapped slot without upload. call with staging_mutex locked in rendering thread
+     */
+    void unmapStaging();
+    bool initPersistentPBO();
+    void destroyPersistentPBO();
+    /*!
+     * Fence the slot just uploaded and map the planes of the next slot, so setCurrentFrame() can copy the next frame
+     * into it in the producer's thread. call with staging_mutex locked in rendering thread
+     */
+    void nextPBO();
     bool initTexture(GLuint tex, GLint internal_format, GLenum format, GLenum dataType, int width, int height);
+    /*!
+     * put the texture of plane into the texture pool of context (ShaderManager) if it's allocated by material, otherwise delete it
+     */
+    void releaseTexture(int plane);
     bool updateTextureParameters(const VideoFormat& fmt);
     bool ensureResources();
     bool ensureTextures();
     void setupQuality();
+    /*!
+     * bind the texture of lut to kLUTUnit, upload it first if lut is changed. lut is disabled if failed
+     */
+    bool bindLUT();
+    /*!
+     * bind the textures of current frame uploaded by a material of another context in the share group instead of uploading
+     * it again, e.g. a frame sent to several renderers by OutputSet. return false if no material holds it
+     */
+    bool bindSharedTextures();
+    // let materials of other contexts in the share group use the textures of current frame. call after upload
+    void publishTextures();
+    // convert transfer or primaries of current frame in shader
+    bool isColorManaged() const {
+        return video_format.isPlanar() && (in_trc != ColorTransfer_SDR || out_trc != ColorTransfer_SDR || in_primaries != ColorPrimaries_BT709);
+    }
+    qreal outputPeak() const {
+        if (out_peak > 0)
+            return out_peak;
+        return out_trc == ColorTransfer_PQ ? 1000.0 : 100.0;
+    }
+    // luminance of SDR white on output. BT.2408 reference white for HDR output
+    qreal sdrWhite() const { return out_trc == ColorTransfer_PQ ? 203.0 : outputPeak(); }
+    qreal sourcePeak() const {
+        if (in_trc == ColorTransfer_HLG)
+            return 1000.0;
+        if (in_trc != ColorTransfer_PQ)
+            return sdrWhite();
+        if (hdr.max_cll > 0)
+            return hdr.max_cll;
+        if (hdr.max_luminance > 0)
+            return hdr.max_luminance;
+        return 1000.0; // most HDR10 videos are mastered on 1000 nits displays
+    }
 
     bool update_texure; // reduce upload/map times. true: new frame not bound. false: current frame is bound
     bool init_textures_required; // e.g. target changed
@@ -144,6 +273,7 @@ public:
     // textures.d in updateTextureParameters() changed. happens in qml. why?
     quint8 workaround_vector_crash_on_linux[8];
     QVector<GLuint> textures; //texture ids. size is plane count
+    QVector<TextureKey> texture_key; // storage of textures. target is 0 if not allocated by material, e.g. interop
     QVector<QSize> texture_size;
     /*
      * actually if render a full frame, only plane 0 is enough. other planes are the same as texture size.
@@ -165,9 +295,50 @@ public:
     ColorTransform colorTransform;
     QMatrix4x4 matrix;
     bool try_pbo;
-    QVector<QOpenGLBuffer> pbo;
+    QVector<QOpenGLBuffer> pbo; // [plane*kPBORingSize + slot]
+    QVector<void*> pbo_fence; // fence of each slot after its upload is queued
+    int pbo_size[4]; // bytes of a pbo of each plane, i.e. kPBORingSize pbos of a plane
+    int pbo_slot; // slot for the next upload
+    bool pbo_used; // current frame is uploaded from pbos
+    /*
+     * Staging is the mapped memory of pbo_slot. The frame producer(e.g. VideoThread) copies host frames into it in
+     * setCurrentFrame(), and the rendering thread only has to unmap and glTexSubImage2D.
+     * staging_mutex protects frame and staging.
+     */
+    QMutex staging_mutex;
+    QVector<uchar*> staging; // mapped address of each plane in pbo_slot. 0: not mapped
+    QVector<int> staging_size;
+    bool staged; // data of frame is in staging
+    /*
+     * GL4.4/GL_ARB_buffer_storage: each slot is 1 buffer for all planes, mapped persistently and coherently once,
+     * so no glMapBuffer/glUnmapBuffer per frame. staging points to pbo_storage_ptr[pbo_slot] + pbo_offset[plane]
+     */
+    bool persistent;
+    GLuint pbo_storage[kPBORingSize];
+    uchar* pbo_storage_ptr[kPBORingSize];
+    int pbo_storage_size; // bytes of a slot
+    int pbo_offset[4];
     QVector2D vec_to8; //TODO: vec3 to support both RG and LA (.rga, vec_to8)
+    bool tex16; // planes are GL_R16/GL_RG16, see OpenGLHelper::is16BitTexture()
+    QVector2D vec_to16; // (65535/range, 0) for tex16
     QMatrix4x4 channel_map;
+    DeinterlaceMode deinterlace_mode; // set by user
+    DeinterlaceMode deinterlace; // mode of current frame. NoDeinterlace if progressive
+    int field_parity; // line parity of the displayed field, 0: top field
+    ColorTransfer in_trc; // of current frame
+    ColorPrimaries in_primaries;
+    HDRMetadata hdr;
+    ColorTransfer out_trc; // set by user
+    qreal out_peak; // nits. 0: default of out_trc
+    ToneMapping tone_mapping;
+    ColorLUT lut;
+    GLuint lut_tex;
+    GLenum lut_target; // the same as target so the shader samples it as planes
+    bool lut_changed;
+    // identity of the host memory frame, i.e. copies of the same VideoFrame. null: not shareable
+    const uchar* frame_data;
+    qreal frame_pts;
+    QVector<GLuint> shared_textures; // of another material. frame is kept to upload if they are gone
 };
 
 } //namespace QtAV
@@ -0,0 +1,133 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "SPDIFMuxer.h"
+#include "QtAV/Packet.h"
+#include "QtAV/private/AVCompat.h"
+#include <string.h>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+SPDIFMuxer::SPDIFMuxer()
+    : m_ctx(0)
+    , m_codec_id(0)
+    , m_out_size(0)
+{
+}
+
+SPDIFMuxer::~SPDIFMuxer()
+{
+    close();
+}
+
+bool SPDIFMuxer::isSupported(int codecId)
+{
+    return codecId == QTAV_CODEC_ID(AC3)
+            || codecId == QTAV_CODEC_ID(EAC3)
+            || codecId == QTAV_CODEC_ID(DTS);
+}
+
+bool SPDIFMuxer::open(AVCodecContext *avctx)
+{
+    close();
+    if (!avctx || !isSupported(avctx->codec_id) || avctx->sample_rate <= 0)
+        return false;
+    av_register_all();
+    AVOutputFormat *fmt = av_guess_format("spdif", NULL, NULL);
+    if (!fmt) {
+        qWarning("SPDIFMuxer: spdif muxer is not available");
+        return false;
+    }
+    m_ctx = avformat_alloc_context();
+    if (!m_ctx)
+        return false;
+    m_ctx->oformat = fmt;
+    AVStream *s = avformat_new_stream(m_ctx, NULL);
+    if (!s) {
+        close();
+        return false;
+    }
+    AVCodecContext *c = s->codec;
+    c->codec_type = AVMEDIA_TYPE_AUDIO;
+    c->codec_id = avctx->codec_id;
+    c->sample_rate = avctx->sample_rate;
+    c->channels = avctx->channels;
+    c->channel_layout = avctx->channel_layout;
+    // bursts are flushed after each packet, a small buffer is enough
+    const int buf_size = 4096;
+    unsigned char *buf = (unsigned char*)av_malloc(buf_size);
+    m_ctx->pb = avio_alloc_context(buf, buf_size, 1, this, NULL, &SPDIFMuxer::write, NULL);
+    if (!m_ctx->pb) {
+        av_free(buf);
+        close();
+        return false;
+    }
+    AV_ENSURE_OK(avformat_write_header(m_ctx, NULL), (close(), false));
+    m_codec_id = avctx->codec_id;
+    m_format.setSampleFormat(AudioFormat::SampleFormat_Signed16);
+    m_format.setChannelLayout(AudioFormat::ChannelLayout_Stero);
+    m_format.setSampleRate(m_codec_id == QTAV_CODEC_ID(EAC3) ? avctx->sample_rate*4 : avctx->sample_rate);
+    qDebug("SPDIFMuxer: %s passthrough at %dHz", avcodec_get_name(avctx->codec_id), m_format.sampleRate());
+    return true;
+}
+
+void SPDIFMuxer::close()
+{
+    if (!m_ctx)
+        return;
+    if (m_ctx->pb) {
+        av_free(m_ctx->pb->buffer);
+        av_free(m_ctx->pb);
+        m_ctx->pb = 0;
+    }
+    avformat_free_context(m_ctx);
+    m_ctx = 0;
+    m_codec_id = 0;
+}
+
+QByteArray SPDIFMuxer::mux(const Packet &packet)
+{
+    if (!m_ctx || !packet.isValid())
+        return QByteArray();
+    if (!m_out.isDetached())
+        m_out = QByteArray();
+    m_out_size = 0;
+    AVPacket pkt = *packet.asAVPacket(); // not owner, av_write_frame() does not take the reference
+    pkt.stream_index = 0;
+    pkt.pts = pkt.dts = AV_NOPTS_VALUE; // spdif ignores timestamps
+    AV_ENSURE_OK(av_write_frame(m_ctx, &pkt), QByteArray());
+    avio_flush(m_ctx->pb);
+    m_out.resize(m_out_size);
+    return m_out;
+}
+
+int SPDIFMuxer::write(void *opaque, unsigned char *buf, int size)
+{
+    SPDIFMuxer *m = static_cast<SPDIFMuxer*>(opaque);
+    // m_out keeps its capacity, the size is set after the packet is done
+    if (m->m_out.size() < m->m_out_size + size)
+        m->m_out.resize(m->m_out_size + size);
+    memcpy(m->m_out.data() + m->m_out_size, buf, size);
+    m->m_out_size += size;
+    return size;
+}
+} //namespace QtAV
@@ -0,0 +1,66 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_SPDIFMUXER_H
+#define QTAV_SPDIFMUXER_H
+
+#include <QtCore/QByteArray>
+#include "QtAV/AudioFormat.h"
+
+struct AVCodecContext;
+struct AVFormatContext;
+namespace QtAV {
+class Packet;
+/*!
+ * \brief The SPDIFMuxer class
+ * Wrap compressed audio packets in IEC 61937 bursts by FFmpeg's spdif muxer, so that a receiver connected by SPDIF or HDMI
+ * decodes them. The bursts are played as 2 channel s16 data of audioFormat(). Used by AudioThread for AudioOutput passthrough
+ */
+class SPDIFMuxer
+{
+public:
+    SPDIFMuxer();
+    ~SPDIFMuxer();
+    /// AC3, E-AC3 and DTS
+    static bool isSupported(int codecId);
+    bool open(AVCodecContext* avctx);
+    void close();
+    bool isOpen() const { return !!m_ctx;}
+    int codecId() const { return m_codec_id;}
+    /// E-AC3 bursts use 4x sample rate of the stream
+    const AudioFormat& audioFormat() const { return m_format;}
+    /*!
+     * \brief mux
+     * \return bursts of the packet. empty if more packets are required, e.g. E-AC3 frames are grouped.
+     * The result is reused by the next call if not referenced any more
+     */
+    QByteArray mux(const Packet& packet);
+private:
+    static int write(void* opaque, unsigned char* buf, int size);
+
+    AVFormatContext *m_ctx;
+    int m_codec_id;
+    AudioFormat m_format;
+    QByteArray m_out;
+    int m_out_size;
+};
+} //namespace QtAV
+#endif //QTAV_SPDIFMUXER_H
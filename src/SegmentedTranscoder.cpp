@@ -0,0 +1,419 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/SegmentedTranscoder.h"
+#include "QtAV/AVDemuxer.h"
+#include "QtAV/AVMuxer.h"
+#include "QtAV/AVPlayer.h"
+#include "QtAV/AVTranscoder.h"
+#include "QtAV/AudioOutput.h"
+#include <QtCore/QFile>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <limits>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+/*!
+ * Writes packets of segment files into one output without decoding. Timestamps of every stream in segment i are rebased to
+ * start at offsets[i], the start time of the segment in the source relative to the first segment.
+ */
+class ConcatThread : public QThread
+{
+public:
+    ConcatThread() : m_quit(false), m_ok(false) {}
+    void setInputs(const QStringList& files, const QVector<qreal>& offsets) {
+        m_files = files;
+        m_offsets = offsets;
+    }
+    void setOutput(const QString& file, const QString& fmt) {
+        m_output = file;
+        m_format = fmt;
+    }
+    void quit() { m_quit = true;}
+    bool isOk() const { return m_ok;}
+protected:
+    void run() Q_DECL_OVERRIDE {
+        m_ok = false;
+        if (m_files.isEmpty())
+            return;
+        // codec parameters of the output are from the 1st segment. it's alive until the muxer is closed
+        AVDemuxer first;
+        first.setMedia(m_files.first());
+        if (!first.load()) {
+            qWarning("concat: failed to load %s", m_files.first().toUtf8().constData());
+            return;
+        }
+        AVMuxer muxer;
+        muxer.setMedia(m_output);
+        if (!m_format.isEmpty())
+            muxer.setFormat(m_format);
+        muxer.copyVideoContext(first.videoCodecContext());
+        muxer.copyAudioContext(first.audioCodecContext());
+        if (!muxer.open()) {
+            qWarning("concat: failed to open %s", m_output.toUtf8().constData());
+            return;
+        }
+        bool ok = true;
+        for (int i = 0; i < m_files.size() && ok && !m_quit; ++i) {
+            AVDemuxer segment;
+            AVDemuxer *demuxer = &first;
+            if (i > 0) {
+                segment.setMedia(m_files.at(i));
+                if (!segment.load()) {
+                    qWarning("concat: failed to load %s", m_files.at(i).toUtf8().constData());
+                    ok = false;
+                    break;
+                }
+                demuxer = &segment;
+            }
+            ok = writeSegment(demuxer, &muxer, m_offsets.at(i));
+        }
+        muxer.close();
+        m_ok = ok && !m_quit;
+    }
+private:
+    bool writeSegment(AVDemuxer *demuxer, AVMuxer *muxer, qreal offset) {
+        const int vs = demuxer->videoStream();
+        const int as = demuxer->audioStream();
+        qreal v0 = -1, a0 = -1; // dts of the first packets in segment
+        while (!m_quit) {
+            if (!demuxer->readFrame()) {
+                if (demuxer->atEnd())
+                    break;
+                continue;
+            }
+            const int s = demuxer->stream();
+            if (s != vs && s != as)
+                continue;
+            Packet pkt(demuxer->packet());
+            qreal &t0 = s == vs ? v0 : a0;
+            if (t0 < 0.0)
+                t0 = pkt.dts;
+            pkt.pts = qMax<qreal>(0, pkt.pts - t0) + offset;
+            pkt.dts = qMax<qreal>(0, pkt.dts - t0) + offset;
+            if (s == vs)
+                muxer->writeVideo(pkt);
+            else
+                muxer->writeAudio(pkt);
+        }
+        return true;
+    }
+
+    volatile bool m_quit;
+    bool m_ok;
+    QStringList m_files;
+    QVector<qreal> m_offsets;
+    QString m_output, m_format;
+};
+
+class SegmentedTranscoder::Private
+{
+public:
+    struct Segment {
+        Segment() : start(0), stop(0), player(0), transcoder(0), done(false) {}
+        qreal start, stop; // source timestamps of the range [start, stop)
+        QString file;
+        AVPlayer *player;
+        AVTranscoder *transcoder;
+        bool done;
+    };
+
+    Private()
+        : running(false)
+        , nb_segments(0)
+        , max_parallel(0)
+        , nb_finished(0)
+        , next_segment(0)
+        , media_start(0)
+        , concat(0)
+    {}
+    ~Private() {
+        stopConcat();
+    }
+    void stopConcat() {
+        if (!concat)
+            return;
+        concat->quit();
+        concat->wait();
+        delete concat;
+        concat = 0;
+    }
+    void removeSegmentFiles() {
+        foreach (const Segment& s, segments) {
+            QFile::remove(s.file);
+        }
+    }
+    // key frame timestamps where ranges start. the 1st range starts at the beginning
+    bool split(int count);
+
+    bool running;
+    int nb_segments;
+    int max_parallel;
+    int nb_finished;
+    int next_segment;
+    qint64 media_start; // ms
+    QString file, output, format;
+    QVector<Segment> segments;
+    ConcatThread *concat;
+};
+
+bool SegmentedTranscoder::Private::split(int count)
+{
+    segments.clear();
+    AVDemuxer demuxer;
+    demuxer.setMedia(file);
+    demuxer.setSeekType(KeyFrameSeek);
+    if (!demuxer.load()) {
+        qWarning("SegmentedTranscoder: failed to load %s", file.toUtf8().constData());
+        return false;
+    }
+    media_start = demuxer.startTime();
+    const qint64 duration = demuxer.duration();
+    const int vs = demuxer.videoStream();
+    if (vs < 0 || duration <= 0 || !demuxer.isSeekable()) {
+        count = 1;
+        qDebug("SegmentedTranscoder: not a seekable video with duration. no parallel transcoding");
+    }
+    QVector<qreal> starts;
+    starts.append(-std::numeric_limits<qreal>::max());
+    for (int i = 1; i < count; ++i) {
+        if (!demuxer.seek(media_start + duration*i/count))
+            continue;
+        // the 1st video packet after seek is the key frame before the position
+        qreal key = -1;
+        for (int n = 0; n < 1024 && key < 0.0 && demuxer.readFrame(); ++n) {
+            if (demuxer.stream() != vs)
+                continue;
+            const Packet pkt(demuxer.packet());
+            if (pkt.hasKeyFrame)
+                key = pkt.pts;
+        }
+        if (key > starts.last()) // merge short GOPs
+            starts.append(key);
+    }
+    QString base(output);
+    const int dot = output.lastIndexOf(QLatin1Char('.'));
+    if (dot > output.lastIndexOf(QLatin1Char('/')))
+        base.truncate(dot);
+    for (int i = 0; i < starts.size(); ++i) {
+        Segment s;
+        s.start = starts.at(i);
+        s.stop = i + 1 < starts.size() ? starts.at(i + 1) : std::numeric_limits<qreal>::max();
+        s.file = QStringLiteral("%1.part%2.mkv").arg(base).arg(i);
+        segments.append(s);
+    }
+    return true;
+}
+
+SegmentedTranscoder::SegmentedTranscoder(QObject *parent)
+    : QObject(parent)
+    , d(new Private())
+{
+}
+
+SegmentedTranscoder::~SegmentedTranscoder()
+{
+    stop();
+}
+
+void SegmentedTranscoder::setMedia(const QString &fileName)
+{
+    d->file = fileName;
+}
+
+QString SegmentedTranscoder::media() const
+{
+    return d->file;
+}
+
+void SegmentedTranscoder::setOutputMedia(const QString &fileName)
+{
+    d->output = fileName;
+}
+
+QString SegmentedTranscoder::outputMedia() const
+{
+    return d->output;
+}
+
+void SegmentedTranscoder::setOutputFormat(const QString &fmt)
+{
+    d->format = fmt;
+}
+
+QString SegmentedTranscoder::outputFormatForced() const
+{
+    return d->format;
+}
+
+void SegmentedTranscoder::setSegments(int count)
+{
+    d->nb_segments = qMax(0, count);
+}
+
+int SegmentedTranscoder::segments() const
+{
+    return d->nb_segments;
+}
+
+void SegmentedTranscoder::setMaxParallel(int value)
+{
+    d->max_parallel = qMax(0, value);
+}
+
+int SegmentedTranscoder::maxParallel() const
+{
+    return d->max_parallel;
+}
+
+bool SegmentedTranscoder::isRunning() const
+{
+    return d->running;
+}
+
+int SegmentedTranscoder::finishedSegments() const
+{
+    return d->nb_finished;
+}
+
+void SegmentedTranscoder::start()
+{
+    if (isRunning())
+        return;
+    const int count = d->nb_segments > 0 ? d->nb_segments : QThread::idealThreadCount();
+    if (!d->split(qMax(1, count))) {
+        Q_EMIT finished(false);
+        return;
+    }
+    qDebug("SegmentedTranscoder: %d segments", d->segments.size());
+    d->running = true;
+    d->nb_finished = 0;
+    d->next_segment = 0;
+    Q_EMIT started();
+    const int parallel = d->max_parallel > 0 ? d->max_parallel : QThread::idealThreadCount();
+    for (int i = 0; i < qMax(1, parallel); ++i) {
+        if (!startNextSegment())
+            break;
+    }
+}
+
+void SegmentedTranscoder::stop()
+{
+    if (!isRunning())
+        return;
+    d->running = false;
+    d->next_segment = d->segments.size();
+    for (int i = 0; i < d->segments.size(); ++i) {
+        Private::Segment &s = d->segments[i];
+        if (!s.transcoder)
+            continue;
+        s.transcoder->disconnect(this);
+        s.player->stop();
+        s.transcoder->stop();
+        delete s.transcoder;
+        delete s.player;
+        s.transcoder = 0;
+        s.player = 0;
+    }
+    if (d->concat)
+        d->concat->disconnect(this);
+    d->stopConcat();
+    d->removeSegmentFiles();
+    Q_EMIT finished(false);
+}
+
+bool SegmentedTranscoder::startNextSegment()
+{
+    if (d->next_segment >= d->segments.size())
+        return false;
+    const int index = d->next_segment++;
+    Private::Segment &s = d->segments[index];
+    s.player = new AVPlayer(this);
+    s.player->setFile(d->file);
+    s.player->setOfflineMode(true);
+    s.player->audio()->setBackends(QStringList() << QStringLiteral("null"));
+    // decoding starts at the key frame. relative ms is rounded down to not seek to the next key frame
+    if (index > 0)
+        s.player->setStartPosition(qMax<qint64>(0, qint64(s.start*1000.0) - d->media_start));
+    s.transcoder = new AVTranscoder(this);
+    s.transcoder->setMediaSource(s.player);
+    s.transcoder->setOutputMedia(s.file);
+    s.transcoder->setOutputFormat(QStringLiteral("matroska"));
+    // frame accurate. stopPosition() of player is checked by a timer
+    s.transcoder->setTimeRange(s.start, s.stop);
+    Q_EMIT segmentCreated(index, s.transcoder);
+    if (!s.transcoder->videoEncoder()) {
+        s.transcoder->createVideoEncoder();
+        s.transcoder->videoEncoder()->setCodecName(QStringLiteral("libx264"));
+    }
+    connect(s.transcoder, SIGNAL(stopped()), SLOT(onSegmentStopped()));
+    s.transcoder->start();
+    s.player->play();
+    return true;
+}
+
+void SegmentedTranscoder::onSegmentStopped()
+{
+    AVTranscoder *t = qobject_cast<AVTranscoder*>(sender());
+    int index = 0;
+    while (index < d->segments.size() && d->segments.at(index).transcoder != t)
+        ++index;
+    if (index >= d->segments.size())
+        return;
+    Private::Segment &s = d->segments[index];
+    // we are in a signal of them
+    s.transcoder->deleteLater();
+    s.player->deleteLater();
+    s.transcoder = 0;
+    s.player = 0;
+    s.done = true;
+    d->nb_finished++;
+    Q_EMIT segmentFinished(index);
+    if (startNextSegment())
+        return;
+    if (d->nb_finished < d->segments.size())
+        return;
+    QStringList files;
+    QVector<qreal> offsets;
+    for (int i = 0; i < d->segments.size(); ++i) {
+        files.append(d->segments.at(i).file);
+        // the 1st segment starts at the beginning of media
+        offsets.append(i == 0 ? 0 : d->segments.at(i).start - qreal(d->media_start)/1000.0);
+    }
+    d->concat = new ConcatThread();
+    d->concat->setInputs(files, offsets);
+    d->concat->setOutput(d->output, d->format);
+    connect(d->concat, SIGNAL(finished()), SLOT(onConcatFinished()));
+    d->concat->start();
+}
+
+void SegmentedTranscoder::onConcatFinished()
+{
+    const bool ok = d->concat && d->concat->isOk();
+    d->stopConcat();
+    d->removeSegmentFiles();
+    d->running = false;
+    Q_EMIT finished(ok);
+}
+
+} //namespace QtAV
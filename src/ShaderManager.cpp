@@ -1,5 +1,6 @@
 #include "ShaderManager.h"
 #include "QtAV/VideoShader.h"
+#include "utils/OpenGLHelper.h"
 
 namespace QtAV {
 
@@ -31,11 +32,48 @@ VideoShader* ShaderManager::prepareMaterial(VideoMaterial *material)
     return shader;
 }
 
+ShaderManager* ShaderManager::current()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return 0;
+    return ctx->findChild<ShaderManager*>(QStringLiteral("__qtav_shader_manager"));
+#else
+    return 0;
+#endif
+}
+
+GLuint ShaderManager::takeTexture(const TextureKey &key)
+{
+    for (int i = texture_pool.size() - 1; i >= 0; --i) {
+        if (texture_pool.at(i).first == key)
+            return texture_pool.takeAt(i).second;
+    }
+    return 0;
+}
+
+void ShaderManager::releaseTexture(const TextureKey &key, GLuint tex)
+{
+    // enough for a few sizes of 3 planes
+    static const int kMaxPooled = 12;
+    if (!tex)
+        return;
+    texture_pool.append(qMakePair(key, tex));
+    if (texture_pool.size() <= kMaxPooled)
+        return;
+    GLuint old = texture_pool.takeFirst().second;
+    DYGL(glDeleteTextures(1, &old));
+}
+
 void ShaderManager::invalidated()
 {
     // TODO: thread safe required?
     qDeleteAll(shader_cache.values());
     shader_cache.clear();
+    for (int i = 0; i < texture_pool.size(); ++i)
+        DYGL(glDeleteTextures(1, &texture_pool[i].second));
+    texture_pool.clear();
 }
 
 } //namespace QtAV
@@ -24,6 +24,9 @@
 
 #include <QtCore/QObject>
 #include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QPair>
+#include "QtAV/private/VideoShader_p.h"
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
 #include <QtGui/QOpenGLContext>
 #else
@@ -48,6 +51,24 @@ public:
     explicit ShaderManager(QOpenGLContext *ctx);
     ~ShaderManager();
     VideoShader* prepareMaterial(VideoMaterial *material);
+    /*!
+     * \brief current
+     * The shader manager of current context created by OpenGLVideo. Always null for Qt4
+     */
+    static ShaderManager* current();
+    /*!
+     * \brief takeTexture
+     * Take an allocated texture released by a material of this context, so a size switch back to a previous size,
+     * e.g. adaptive streaming, does not reallocate gpu memory.
+     * \return 0 if no texture of the key is pooled
+     */
+    GLuint takeTexture(const TextureKey& key);
+    /*!
+     * \brief releaseTexture
+     * Put a texture into the pool. The least recently released one is deleted if pool is full.
+     * Must be called with the context current.
+     */
+    void releaseTexture(const TextureKey& key, GLuint tex);
 
 public Q_SLOTS:
     void invalidated();
@@ -55,6 +76,7 @@ public Q_SLOTS:
 private:
     QOpenGLContext *m_ctx;
     QHash<qint64, VideoShader*> shader_cache;
+    QList<QPair<TextureKey, GLuint> > texture_pool; // the last is the most recently released
 };
 } //namespace QtAV
 #endif // QTAV_SHADERMANAGER_H
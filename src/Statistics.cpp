@@ -20,7 +20,11 @@
 ******************************************************************************/
 
 #include "QtAV/Statistics.h"
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMutex>
+#include <QtCore/qmath.h>
 #include "utils/ring.h"
+#include "utils/SPSCQueue.h"
 
 namespace QtAV {
 
@@ -37,17 +41,172 @@ Statistics::AudioOnly::AudioOnly():
   , channels(0)
   , frame_size(0)
   , block_align(0)
+  , underruns(0)
 {
 }
 
+Statistics::Histogram::Histogram()
+{
+    reset();
+}
+
+void Statistics::Histogram::add(qreal value)
+{
+    if (value < 0)
+        value = 0;
+    ++m_count;
+    m_sum += value;
+    m_sum2 += value*value;
+    if (value > m_max)
+        m_max = value;
+    int i = 0;
+    while (i < BucketCount - 1 && value >= bucketValue(i + 1))
+        ++i;
+    ++m_buckets[i];
+}
+
+void Statistics::Histogram::reset()
+{
+    m_count = 0;
+    m_sum = m_sum2 = m_max = 0;
+    for (int i = 0; i < BucketCount; ++i)
+        m_buckets[i] = 0;
+}
+
+qreal Statistics::Histogram::mean() const
+{
+    if (m_count <= 0)
+        return 0;
+    return m_sum/qreal(m_count);
+}
+
+qreal Statistics::Histogram::standardDeviation() const
+{
+    if (m_count <= 1)
+        return 0;
+    const qreal m = mean();
+    const qreal v = m_sum2/qreal(m_count) - m*m;
+    return v > 0 ? qSqrt(v) : 0;
+}
+
+qint64 Statistics::Histogram::bucket(int i) const
+{
+    if (i < 0 || i >= BucketCount)
+        return 0;
+    return m_buckets[i];
+}
+
+qreal Statistics::Histogram::bucketValue(int i)
+{
+    if (i <= 0)
+        return 0;
+    return qreal(1 << (i - 1));
+}
+
+qreal Statistics::Histogram::percentile(qreal p) const
+{
+    if (m_count <= 0)
+        return 0;
+    const qreal rank = qBound<qreal>(0, p, 100)*qreal(m_count)/100.0;
+    qint64 n = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        if (m_buckets[i] <= 0 || qreal(n + m_buckets[i]) < rank) {
+            n += m_buckets[i];
+            continue;
+        }
+        const qreal lo = bucketValue(i);
+        const qreal hi = i < BucketCount - 1 ? bucketValue(i + 1) : m_max;
+        const qreal v = lo + (hi - lo)*(rank - qreal(n))/qreal(m_buckets[i]);
+        return qMin(v, m_max);
+    }
+    return m_max;
+}
+
+Statistics::FilterTiming::FilterTiming()
+    : frames(0)
+    , skipped(0)
+{
+}
+
+// monotonic, unlike QDateTime
+static qint64 nowNs()
+{
+    static QElapsedTimer timer;
+    if (!timer.isValid())
+        timer.start();
+    return timer.nsecsElapsed();
+}
+
+bool Statistics::latency_tracing = false;
+
+void Statistics::setLatencyTracing(bool value)
+{
+    nowNs(); // start the timer so that tagged times are > 0
+    latency_tracing = value;
+}
+
+qint64 Statistics::tracingTime()
+{
+    return nowNs();
+}
+
+class Statistics::Private : public QSharedData {
+public:
+    // writer side of a rate. only the counting thread touches it
+    struct Window {
+        Window() : begin(0), count(0) {}
+        qint64 begin; // ns
+        int count; // counter value at begin
+    };
+    Private() { reset();}
+    void reset() {
+        for (int i = 0; i < CounterCount; ++i) {
+            spsc::storeRelease(counters[i], 0);
+            spsc::storeRelease(rates[i], 0);
+            spsc::storeRelease(rate_time[i], 0);
+            windows[i] = Window();
+        }
+        spsc::storeRelease(video_queue, 0);
+        spsc::storeRelease(audio_queue, 0);
+        spsc::storeRelease(gop_length, 0);
+        for (int i = 0; i < MemoryUsageCount; ++i)
+            spsc::storeRelease(memory[i], 0);
+    }
+    qreal rate(Counter c, int now_ds) const {
+        const int t = spsc::loadAcquire(rate_time[c]);
+        if (t <= 0 || now_ds - t > 20)
+            return 0;
+        return qreal(spsc::loadAcquire(rates[c]))/10.0;
+    }
+
+    QAtomicInt counters[CounterCount]; // wraps after 2^31
+    QAtomicInt rates[CounterCount]; // per 10 seconds, i.e. 1 decimal of the rate per second
+    QAtomicInt rate_time[CounterCount]; // 100ms units from nowNs() start when the rate is updated
+    QAtomicInt video_queue, audio_queue;
+    QAtomicInt gop_length;
+    QAtomicInt memory[MemoryUsageCount]; // KiB
+    Window windows[CounterCount];
+};
+
 class Statistics::VideoOnly::Private : public QSharedData {
 public:
     Private()
         : pts(0)
         , history(ring<qreal>(30))
+        , last_swap(0)
+        , vsync_phase(0)
+        , vsync_period(0)
+        , target_vsync(0)
     {}
+    QMutex history_mutex; // pts and history. written in video thread, read in any thread
     qreal pts;
     ring<qreal> history;
+    // vsync timing in ns. written in rendering thread, read in video thread
+    QMutex vsync_mutex;
+    qint64 last_swap;
+    qint64 vsync_phase; // time of a recent vsync
+    qreal vsync_period;
+    qint64 target_vsync; // vsync the last delivered frame is scheduled for
 };
 
 Statistics::VideoOnly::VideoOnly():
@@ -56,6 +215,9 @@ Statistics::VideoOnly::VideoOnly():
   , coded_width(0)
   , coded_height(0)
   , gop_size(0)
+  , surface_starvation(0)
+  , filter_stage_frames(0)
+  , missed_vsync(0)
   , d(new Private())
 {
 }
@@ -66,6 +228,13 @@ Statistics::VideoOnly::VideoOnly(const VideoOnly& v)
   , coded_width(v.coded_width)
   , coded_height(v.coded_height)
   , gop_size(v.gop_size)
+  , pix_fmt(v.pix_fmt)
+  , surface_starvation(v.surface_starvation)
+  , filter_stage_frames(v.filter_stage_frames)
+  , decode_time_i(v.decode_time_i)
+  , decode_time_p(v.decode_time_p)
+  , decode_time_b(v.decode_time_b)
+  , missed_vsync(v.missed_vsync)
   , d(v.d)
 {
 }
@@ -77,6 +246,13 @@ Statistics::VideoOnly& Statistics::VideoOnly::operator =(const VideoOnly& v)
     coded_width = v.coded_width;
     coded_height = v.coded_height;
     gop_size = v.gop_size;
+    pix_fmt = v.pix_fmt;
+    surface_starvation = v.surface_starvation;
+    filter_stage_frames = v.filter_stage_frames;
+    decode_time_i = v.decode_time_i;
+    decode_time_p = v.decode_time_p;
+    decode_time_b = v.decode_time_b;
+    missed_vsync = v.missed_vsync;
     d = v.d;
     return *this;
 }
@@ -87,20 +263,90 @@ Statistics::VideoOnly::~VideoOnly()
 
 qreal Statistics::VideoOnly::pts() const
 {
+    QMutexLocker lock(&d->history_mutex);
+    Q_UNUSED(lock);
     return d->pts;
 }
 
 qint64 Statistics::VideoOnly::frameDisplayed(qreal pts)
 {
-    d->pts = pts;
     const qint64 msecs = QDateTime::currentMSecsSinceEpoch();
     const qreal t = (double)msecs/1000.0;
+    QMutexLocker lock(&d->history_mutex);
+    Q_UNUSED(lock);
+    d->pts = pts;
     d->history.push_back(t);
     return msecs;
 }
-// d->history is not thread safe!
+void Statistics::VideoOnly::frameSwapped(qreal refreshRate)
+{
+    const qint64 now = nowNs();
+    QMutexLocker lock(&d->vsync_mutex);
+    Q_UNUSED(lock);
+    const qint64 dt = d->last_swap > 0 ? now - d->last_swap : 0;
+    d->last_swap = now;
+    if (d->vsync_period <= 0 && refreshRate > 1)
+        d->vsync_period = 1e9/refreshRate;
+    if (d->vsync_period <= 0) {
+        // no nominal rate. guess from the first interval of continuous swaps, refined below
+        if (dt > 0 && dt < 100000000LL)
+            d->vsync_period = dt;
+        return;
+    }
+    // a swap interval is n periods. refine the period from intervals close to n periods
+    if (dt > 0 && dt < 250000000LL) {
+        const int n = qMax(1, qRound(qreal(dt)/d->vsync_period));
+        const qreal p = qreal(dt)/qreal(n);
+        if (qAbs(p - d->vsync_period) < d->vsync_period*0.05)
+            d->vsync_period += (p - d->vsync_period)*0.05;
+        else if (p < d->vsync_period*0.75 && refreshRate <= 1) // the guessed period was a multiple
+            d->vsync_period = p;
+    }
+    d->vsync_phase = now;
+    if (d->target_vsync > 0) {
+        const qint64 late = now - d->target_vsync;
+        if (late > d->vsync_period*0.5)
+            missed_vsync += qRound(qreal(late)/d->vsync_period);
+        d->target_vsync = 0;
+    }
+}
+
+qreal Statistics::VideoOnly::vsyncInterval() const
+{
+    QMutexLocker lock(&d->vsync_mutex);
+    Q_UNUSED(lock);
+    if (d->vsync_phase <= 0)
+        return 0;
+    return d->vsync_period/1e9;
+}
+
+qreal Statistics::VideoOnly::alignToVSync(qreal delay)
+{
+    QMutexLocker lock(&d->vsync_mutex);
+    Q_UNUSED(lock);
+    if (d->vsync_phase <= 0 || d->vsync_period <= 0)
+        return delay;
+    const qint64 now = nowNs();
+    // no swap for a long time, e.g. paused or hidden. the phase may drift
+    if (now - d->vsync_phase > 2000000000LL)
+        return delay;
+    const qreal due = qreal(now) + delay*1e9;
+    const qreal n = qRound((due - qreal(d->vsync_phase))/d->vsync_period);
+    qreal vsync = qreal(d->vsync_phase) + n*d->vsync_period;
+    // rendering and swap take time. deliver half an interval before the vsync
+    qreal deliver = vsync - d->vsync_period*0.5;
+    if (deliver < qreal(now)) { // too late for it. present asap, i.e. at the first vsync half an interval later
+        deliver = qreal(now);
+        vsync = qreal(d->vsync_phase) + qCeil((deliver + d->vsync_period*0.5 - qreal(d->vsync_phase))/d->vsync_period)*d->vsync_period;
+    }
+    d->target_vsync = qint64(vsync);
+    return (deliver - qreal(now))/1e9;
+}
+
 qreal Statistics::VideoOnly::currentDisplayFPS() const
 {
+    QMutexLocker lock(&d->history_mutex);
+    Q_UNUSED(lock);
     if (d->history.empty())
         return 0;
     // DO NOT use d->history.last-first
@@ -111,7 +357,34 @@ qreal Statistics::VideoOnly::currentDisplayFPS() const
     return (qreal)d->history.size()/dt;
 }
 
+Statistics::Snapshot::Snapshot()
+    : decoded_frames(0)
+    , dropped_frames(0)
+    , rendered_frames(0)
+    , late_frames(0)
+    , decode_fps(0)
+    , render_fps(0)
+    , video_bit_rate(0)
+    , audio_bit_rate(0)
+    , video_queue(0)
+    , audio_queue(0)
+    , video_input_bit_rate(0)
+    , audio_input_bit_rate(0)
+    , gop_length(0)
+    , i_frames(0)
+    , p_frames(0)
+    , b_frames(0)
+    , stutter_frames(0)
+    , packet_memory(0)
+    , frame_memory(0)
+    , texture_memory(0)
+    , surface_memory(0)
+{
+}
+
 Statistics::Statistics()
+    : latency(0)
+    , d(new Private())
 {
 }
 
@@ -127,6 +400,79 @@ void Statistics::reset()
     audio_only = AudioOnly();
     video_only = VideoOnly();
     metadata.clear();
+    latency = 0;
+    d->reset();
+}
+
+Statistics::Snapshot Statistics::snapshot() const
+{
+    const int now_ds = int(nowNs()/100000000LL);
+    Snapshot s;
+    s.decoded_frames = spsc::loadAcquire(d->counters[DecodedFrames]);
+    s.dropped_frames = spsc::loadAcquire(d->counters[DroppedFrames]);
+    s.rendered_frames = spsc::loadAcquire(d->counters[RenderedFrames]);
+    s.late_frames = spsc::loadAcquire(d->counters[LateFrames]);
+    s.decode_fps = d->rate(DecodedFrames, now_ds);
+    s.render_fps = d->rate(RenderedFrames, now_ds);
+    s.video_bit_rate = qint64(d->rate(VideoBytes, now_ds)*8.0);
+    s.audio_bit_rate = qint64(d->rate(AudioBytes, now_ds)*8.0);
+    s.video_queue = spsc::loadAcquire(d->video_queue);
+    s.audio_queue = spsc::loadAcquire(d->audio_queue);
+    s.video_input_bit_rate = qint64(d->rate(DemuxedVideoBytes, now_ds)*8.0);
+    s.audio_input_bit_rate = qint64(d->rate(DemuxedAudioBytes, now_ds)*8.0);
+    s.gop_length = spsc::loadAcquire(d->gop_length);
+    s.i_frames = spsc::loadAcquire(d->counters[IFrames]);
+    s.p_frames = spsc::loadAcquire(d->counters[PFrames]);
+    s.b_frames = spsc::loadAcquire(d->counters[BFrames]);
+    s.stutter_frames = spsc::loadAcquire(d->counters[StutterFrames]);
+    s.packet_memory = (qint64(spsc::loadAcquire(d->memory[VideoPacketMemory])) + spsc::loadAcquire(d->memory[AudioPacketMemory]))*1024LL;
+    s.frame_memory = (qint64(spsc::loadAcquire(d->memory[VideoFrameMemory])) + spsc::loadAcquire(d->memory[AudioFrameMemory]))*1024LL;
+    s.texture_memory = qint64(spsc::loadAcquire(d->memory[TextureMemory]))*1024LL;
+    s.surface_memory = qint64(spsc::loadAcquire(d->memory[SurfaceMemory]))*1024LL;
+    return s;
+}
+
+void Statistics::count(Counter c, int n)
+{
+    if (c < 0 || c >= CounterCount)
+        return;
+    const int value = d->counters[c].fetchAndAddRelease(n) + n;
+    Private::Window &w = d->windows[c];
+    const qint64 now = nowNs();
+    const qint64 dt = now - w.begin;
+    if (w.begin <= 0 || dt > 2000000000LL) { // start, or restart after a gap, e.g. paused
+        w.begin = now;
+        w.count = value - n;
+        return;
+    }
+    if (dt < 1000000000LL)
+        return;
+    spsc::storeRelease(d->rates[c], int(qreal(value - w.count)*1e10/qreal(dt)));
+    spsc::storeRelease(d->rate_time[c], qMax(1, int(now/100000000LL)));
+    w.begin = now;
+    w.count = value;
+}
+
+void Statistics::setVideoQueueSize(int packets)
+{
+    spsc::storeRelease(d->video_queue, packets);
+}
+
+void Statistics::setAudioQueueSize(int packets)
+{
+    spsc::storeRelease(d->audio_queue, packets);
+}
+
+void Statistics::setGopLength(int packets)
+{
+    spsc::storeRelease(d->gop_length, packets);
+}
+
+void Statistics::setMemoryUsage(MemoryUsage m, qint64 bytes)
+{
+    if (m < 0 || m >= MemoryUsageCount)
+        return;
+    spsc::storeRelease(d->memory[m], int((qMax<qint64>(0, bytes) + 1023LL)/1024LL));
 }
 
 } //namespace QtAV
@@ -0,0 +1,281 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/TraceRecorder.h"
+#include "QtAV/Statistics.h"
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
+#include <QtCore/QVector>
+#include "utils/SPSCQueue.h"
+#include "utils/Logger.h"
+
+namespace QtAV {
+namespace {
+struct Event {
+    const char* name;
+    const char* category;
+    qint64 begin;
+    qint64 end; // < 0: instant event
+};
+
+class ThreadBuffer
+{
+public:
+    ThreadBuffer(int size, int gen)
+        : ring(size)
+        , next(0)
+        , wrapped(0)
+        , generation(gen)
+        , alive(1)
+        , tid(0)
+    {}
+    // called by the owner thread only
+    void add(const Event& e) {
+        int n = spsc::loadRelaxed(next);
+        ring[n] = e;
+        if (++n == ring.size()) {
+            n = 0;
+            spsc::storeRelease(wrapped, 1);
+        }
+        spsc::storeRelease(next, n);
+    }
+
+    QVector<Event> ring;
+    QAtomicInt next;
+    QAtomicInt wrapped;
+    QAtomicInt generation; // events of an old generation are cleared
+    QAtomicInt alive; // 0 if the thread is finished
+    QString name;
+    int tid;
+};
+
+// owned by QThreadStorage, the buffer lives in the registry after the thread is finished
+class BufferRef
+{
+public:
+    explicit BufferRef(ThreadBuffer *b) : buffer(b) {}
+    ~BufferRef() { spsc::storeRelease(buffer->alive, 0);}
+    ThreadBuffer *buffer;
+};
+
+class Registry
+{
+public:
+    Registry() : buffer_size(8192), next_tid(1), generation(0) {}
+    QMutex mutex; // buffers, ring sizes and names
+    QList<ThreadBuffer*> buffers;
+    QThreadStorage<BufferRef*> local;
+    int buffer_size;
+    int next_tid;
+    QAtomicInt generation;
+};
+
+Registry& registry()
+{
+    // never destroyed. threads may finish after static objects are destroyed
+    static Registry *r = new Registry();
+    return *r;
+}
+
+ThreadBuffer* threadBuffer()
+{
+    Registry &r = registry();
+    if (r.local.hasLocalData())
+        return r.local.localData()->buffer;
+    QThread *t = QThread::currentThread();
+    QString name(t ? t->objectName() : QString());
+    QMutexLocker lock(&r.mutex);
+    Q_UNUSED(lock);
+    ThreadBuffer *b = new ThreadBuffer(r.buffer_size, spsc::loadAcquire(r.generation));
+    b->tid = r.next_tid++;
+    if (name.isEmpty()) {
+        if (QCoreApplication::instance() && t == QCoreApplication::instance()->thread())
+            name = QStringLiteral("main");
+        else
+            name = QStringLiteral("thread %1").arg(b->tid);
+    }
+    b->name = name;
+    r.buffers.append(b);
+    r.local.setLocalData(new BufferRef(b));
+    return b;
+}
+
+void record(const Event& e)
+{
+    ThreadBuffer *b = threadBuffer();
+    Registry &r = registry();
+    const int gen = spsc::loadAcquire(r.generation);
+    if (spsc::loadRelaxed(b->generation) != gen) { // cleared. rare, so lock to resize
+        QMutexLocker lock(&r.mutex);
+        Q_UNUSED(lock);
+        if (b->ring.size() != r.buffer_size)
+            b->ring.resize(r.buffer_size);
+        spsc::storeRelease(b->next, 0);
+        spsc::storeRelease(b->wrapped, 0);
+        spsc::storeRelease(b->generation, gen);
+    }
+    b->add(e);
+}
+
+QByteArray jsonString(const QByteArray& s)
+{
+    QByteArray json("\"");
+    for (int i = 0; i < s.size(); ++i) {
+        const char c = s.at(i);
+        if (c == '"' || c == '\\') {
+            json.append('\\').append(c);
+        } else if ((uchar)c < 0x20) {
+            char u[8];
+            qsnprintf(u, sizeof(u), "\\u%04x", (uchar)c);
+            json.append(u);
+        } else {
+            json.append(c);
+        }
+    }
+    return json.append('"');
+}
+
+QByteArray microseconds(qint64 ns)
+{
+    return QByteArray::number(double(ns)/1000.0, 'f', 3);
+}
+} //namespace
+
+bool TraceRecorder::enabled = false;
+
+void TraceRecorder::setEnabled(bool value)
+{
+    now(); // start the clock so that times of events are > 0
+    enabled = value;
+}
+
+void TraceRecorder::setBufferSize(int events)
+{
+    Registry &r = registry();
+    QMutexLocker lock(&r.mutex);
+    Q_UNUSED(lock);
+    r.buffer_size = qMax(events, 64);
+}
+
+int TraceRecorder::bufferSize()
+{
+    Registry &r = registry();
+    QMutexLocker lock(&r.mutex);
+    Q_UNUSED(lock);
+    return r.buffer_size;
+}
+
+void TraceRecorder::instant(const char *name, const char *category)
+{
+    if (!enabled)
+        return;
+    const Event e = { name, category, now(), -1};
+    record(e);
+}
+
+void TraceRecorder::complete(const char *name, const char *category, qint64 begin, qint64 end)
+{
+    if (begin <= 0)
+        return;
+    const Event e = { name, category, begin, qMax(begin, end)};
+    record(e);
+}
+
+qint64 TraceRecorder::now()
+{
+    return Statistics::tracingTime();
+}
+
+QByteArray TraceRecorder::toJson()
+{
+    Registry &r = registry();
+    QMutexLocker lock(&r.mutex);
+    Q_UNUSED(lock);
+    const int gen = spsc::loadAcquire(r.generation);
+    const QByteArray pid(QByteArray::number(QCoreApplication::applicationPid()));
+    QByteArray json("{\"traceEvents\":[");
+    bool first = true;
+    foreach (ThreadBuffer *b, r.buffers) {
+        const QByteArray tid(QByteArray::number(b->tid));
+        json.append(first ? "\n" : ",\n");
+        first = false;
+        json.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":").append(pid)
+                .append(",\"tid\":").append(tid)
+                .append(",\"args\":{\"name\":").append(jsonString(b->name.toUtf8())).append("}}");
+        if (spsc::loadAcquire(b->generation) != gen)
+            continue;
+        const int size = b->ring.size();
+        const int n = spsc::loadAcquire(b->next);
+        int start = 0, count = n;
+        if (spsc::loadAcquire(b->wrapped)) {
+            // the oldest events may be overwritten while reading
+            const int margin = qMin(64, size/4);
+            start = (n + margin) % size;
+            count = size - margin;
+        }
+        for (int i = 0; i < count; ++i) {
+            const Event &e = b->ring.at((start + i) % size);
+            if (!e.name || e.begin <= 0)
+                continue;
+            json.append(",\n{\"name\":").append(jsonString(e.name))
+                    .append(",\"cat\":").append(jsonString(e.category ? e.category : ""));
+            if (e.end < 0)
+                json.append(",\"ph\":\"i\",\"s\":\"t\"");
+            else
+                json.append(",\"ph\":\"X\",\"dur\":").append(microseconds(e.end - e.begin));
+            json.append(",\"ts\":").append(microseconds(e.begin))
+                    .append(",\"pid\":").append(pid)
+                    .append(",\"tid\":").append(tid).append("}");
+        }
+    }
+    json.append("\n],\"displayTimeUnit\":\"ms\"}\n");
+    return json;
+}
+
+bool TraceRecorder::save(const QString &fileName)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("TraceRecorder failed to open '%s': %s", qPrintable(fileName), qPrintable(f.errorString()));
+        return false;
+    }
+    const QByteArray json(toJson());
+    return f.write(json) == json.size();
+}
+
+void TraceRecorder::clear()
+{
+    Registry &r = registry();
+    QMutexLocker lock(&r.mutex);
+    Q_UNUSED(lock);
+    r.generation.fetchAndAddOrdered(1);
+    for (int i = r.buffers.size() - 1; i >= 0; --i) {
+        ThreadBuffer *b = r.buffers.at(i);
+        if (spsc::loadAcquire(b->alive))
+            continue;
+        r.buffers.removeAt(i);
+        delete b;
+    }
+}
+} //namespace QtAV
@@ -21,19 +21,86 @@
 #include "QtAV/VideoCapture.h"
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDir>
+#include <QtCore/QMutex>
 #include <QtCore/QRunnable>
 #include <QtCore/QThreadPool>
+#include <QtCore/QThreadStorage>
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
 #include <QtGui/QDesktopServices>
 #else
 #include <QtCore/QStandardPaths>
 #endif
+#include "QtAV/VideoEncoder.h"
+#include "QtAV/private/AVCompat.h"
 #include "utils/Logger.h"
 
 namespace QtAV {
 
 Q_GLOBAL_STATIC(QThreadPool, videoCaptureThreadPool)
 static bool app_is_dieing = false;
+
+// mjpeg encoder of a capture thread. reopened only if frame size or quality changes
+class JpegEncoder
+{
+public:
+    JpegEncoder()
+        : enc(VideoEncoder::create(QStringLiteral("FFmpeg")))
+        , quality(-2)
+    {}
+    ~JpegEncoder() {
+        if (!enc)
+            return;
+        enc->close();
+        delete enc;
+    }
+    bool encode(const VideoFrame& frame, int q, QByteArray *data) {
+        if (!enc)
+            return false;
+        VideoFrame f(frame);
+        // the same range as toImage(), i.e. full range
+        if (f.pixelFormat() != VideoFormat::Format_YUV420P || !f.hasHostData())
+            f = frame.to(VideoFormat::Format_YUV420P);
+        if (!f.isValid())
+            return false;
+        if (!enc->isOpen() || enc->width() != f.width() || enc->height() != f.height() || quality != q) {
+            enc->close();
+            enc->setCodecName(QStringLiteral("mjpeg"));
+            enc->setWidth(f.width());
+            enc->setHeight(f.height());
+            enc->setPixelFormat(VideoFormat::Format_YUV420P);
+            // q: 0-100 => qscale: 31-1. the same default as ffmpeg -q:v 2
+            const int qscale = q < 0 ? 2 : qBound(1, 31 - q*30/100, 31);
+            QVariantHash avcodec;
+            avcodec[QStringLiteral("strict")] = -1; // yuv420p instead of yuvj420p
+            avcodec[QStringLiteral("color_range")] = QStringLiteral("jpeg");
+            avcodec[QStringLiteral("flags")] = QStringLiteral("qscale");
+            avcodec[QStringLiteral("global_quality")] = qscale*FF_QP2LAMBDA;
+            QVariantHash opt;
+            opt[QStringLiteral("avcodec")] = avcodec;
+            enc->setOptions(opt);
+            if (!enc->open()) {
+                qWarning("VideoCapture failed to open mjpeg encoder");
+                return false;
+            }
+            quality = q;
+        }
+        if (!enc->encode(f))
+            return false;
+        *data = enc->encoded().data;
+        return !data->isEmpty();
+    }
+private:
+    VideoEncoder *enc;
+    int quality;
+};
+Q_GLOBAL_STATIC(QThreadStorage<JpegEncoder*>, jpegEncoders)
+
+static bool isJpegFormat(const QString& format)
+{
+    const QString f(format.toLower());
+    return f == QLatin1String("jpg") || f == QLatin1String("jpeg");
+}
+
 // TODO: cancel if qapp is quit
 class CaptureTask : public QRunnable
 {
@@ -42,6 +109,7 @@ public:
         : cap(c)
         , save(true)
         , original_fmt(false)
+        , direct_encode(false)
         , quality(-1)
         , format(QStringLiteral("PNG"))
         , qfmt(QImage::Format_ARGB32)
@@ -53,12 +121,18 @@ public:
             qDebug("app is dieing. cancel capture task %p", this);
             return;
         }
-        QImage image(frame.toImage());
-        if (image.isNull()) {
-            qWarning("Failed to convert to QImage");
-            return;
+        const bool direct = save && !original_fmt && direct_encode && isJpegFormat(format);
+        QImage image;
+        if (!direct || cap->receivers(SIGNAL(imageCaptured(QImage))) > 0) {
+            image = frame.toImage();
+            if (image.isNull()) {
+                qWarning("Failed to convert to QImage");
+                if (!direct)
+                    return;
+            } else {
+                QMetaObject::invokeMethod(cap, "imageCaptured", Q_ARG(QImage, image));
+            }
         }
-        QMetaObject::invokeMethod(cap, "imageCaptured", Q_ARG(QImage, image));
         if (!save)
             return;
         bool main_thread = QThread::currentThread() == qApp->thread();
@@ -91,33 +165,108 @@ public:
             QMetaObject::invokeMethod(cap, "saved", Q_ARG(QString, path));
             return;
         }
-        if (image.isNull())
-            return;
         path.append(format.toLower());
         qDebug("Saving capture to %s", qPrintable(path));
+        if (direct) {
+            if (saveJpeg(path))
+                return;
+            qDebug("Direct jpeg encoding failed. Save as QImage");
+            if (image.isNull())
+                image = frame.toImage();
+        }
+        if (image.isNull()) {
+            QMetaObject::invokeMethod(cap, "failed");
+            return;
+        }
         bool ok = image.save(path, format.toLatin1().constData(), quality);
         if (!ok) {
             qWarning("Failed to save capture");
             QMetaObject::invokeMethod(cap, "failed");
+            return;
         }
         QMetaObject::invokeMethod(cap, "saved", Q_ARG(QString, path));
     }
 
+    bool saveJpeg(const QString& path) {
+        if (!jpegEncoders()->hasLocalData())
+            jpegEncoders()->setLocalData(new JpegEncoder());
+        QByteArray data;
+        if (!jpegEncoders()->localData()->encode(frame, quality, &data))
+            return false;
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning("VideoCapture is failed to open file %s", qPrintable(path));
+            return false;
+        }
+        if (file.write(data) != data.size()) {
+            qWarning("VideoCapture is failed to write jpeg data");
+            file.close();
+            file.remove();
+            return false;
+        }
+        file.close();
+        QMetaObject::invokeMethod(cap, "saved", Q_ARG(QString, path));
+        return true;
+    }
+
     VideoCapture *cap;
     bool save;
     bool original_fmt;
+    bool direct_encode;
     int quality;
     QString format, dir, name;
     QImage::Format qfmt;
     VideoFrame frame;
 };
 
+// captures waiting for a worker or running. shared with the runners so that a runner started after VideoCapture is destroyed finds nothing to do
+class CaptureQueue
+{
+public:
+    CaptureQueue() : running(0) {}
+    ~CaptureQueue() { qDeleteAll(tasks); }
+    QMutex mutex;
+    QList<CaptureTask*> tasks;
+    int running;
+};
+
+// one runner is started for each queued task. if a task is dropped, a runner returns without taking one
+class CaptureRunner : public QRunnable
+{
+public:
+    CaptureRunner(const QSharedPointer<CaptureQueue>& q) : queue(q) {
+        setAutoDelete(true);
+    }
+    virtual void run() {
+        CaptureTask *task = 0;
+        {
+            QMutexLocker lock(&queue->mutex);
+            Q_UNUSED(lock);
+            if (queue->tasks.isEmpty())
+                return;
+            task = queue->tasks.takeFirst();
+            queue->running++;
+        }
+        task->run();
+        delete task;
+        QMutexLocker lock(&queue->mutex);
+        Q_UNUSED(lock);
+        queue->running--;
+    }
+private:
+    QSharedPointer<CaptureQueue> queue;
+};
+
 VideoCapture::VideoCapture(QObject *parent) :
     QObject(parent)
   , async(true)
   , auto_save(true)
   , original_fmt(false)
+  , direct_encode(false)
+  , max_pending(8)
+  , drop_policy(DropNewest)
   , qfmt(QImage::Format_ARGB32)
+  , queue(new CaptureQueue())
 {
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
     dir = QDesktopServices::storageLocation(QDesktopServices::PicturesLocation);
@@ -132,6 +281,15 @@ VideoCapture::VideoCapture(QObject *parent) :
     connect(qApp, SIGNAL(aboutToQuit()), SLOT(handleAppQuit()), Qt::DirectConnection);
 }
 
+VideoCapture::~VideoCapture()
+{
+    // not started tasks are useless now
+    QMutexLocker lock(&queue->mutex);
+    Q_UNUSED(lock);
+    qDeleteAll(queue->tasks);
+    queue->tasks.clear();
+}
+
 void VideoCapture::setAsync(bool value)
 {
     if (async == value)
@@ -171,6 +329,64 @@ bool VideoCapture::isOriginalFormat() const
     return original_fmt;
 }
 
+void VideoCapture::setMaxPendingCaptures(int value)
+{
+    if (value < 0)
+        value = 0;
+    if (max_pending == value)
+        return;
+    max_pending = value;
+    emit maxPendingCapturesChanged();
+}
+
+int VideoCapture::maxPendingCaptures() const
+{
+    return max_pending;
+}
+
+int VideoCapture::pendingCaptures() const
+{
+    QMutexLocker lock(&queue->mutex);
+    Q_UNUSED(lock);
+    return queue->tasks.size() + queue->running;
+}
+
+void VideoCapture::setDropPolicy(DropPolicy value)
+{
+    if (drop_policy == value)
+        return;
+    drop_policy = value;
+    emit dropPolicyChanged();
+}
+
+VideoCapture::DropPolicy VideoCapture::dropPolicy() const
+{
+    return drop_policy;
+}
+
+void VideoCapture::setDirectEncode(bool value)
+{
+    if (direct_encode == value)
+        return;
+    direct_encode = value;
+    emit directEncodeChanged();
+}
+
+bool VideoCapture::isDirectEncode() const
+{
+    return direct_encode;
+}
+
+void VideoCapture::setWorkerCount(int value)
+{
+    videoCaptureThreadPool()->setMaxThreadCount(value > 0 ? value : QThread::idealThreadCount());
+}
+
+int VideoCapture::workerCount()
+{
+    return videoCaptureThreadPool()->maxThreadCount();
+}
+
 void VideoCapture::handleAppQuit()
 {
     app_is_dieing = true;
@@ -195,13 +411,19 @@ void VideoCapture::request()
 void VideoCapture::start()
 {
     emit frameAvailable(frame); //TODO: no copy
-    if (!frame.isValid() || !frame.constBits(0)) { // if frame is always cloned, then size is at least width*height
+    if (!frame.isValid() || !frame.hasHostData()) { // if frame is always cloned, then size is at least width*height
         qDebug("Captured frame from hardware decoder surface.");
     }
+    if (isAsync() && max_pending > 0 && drop_policy == DropNewest && pendingCaptures() >= max_pending) {
+        qDebug("too many pending captures. drop the frame at %.3f", frame.timestamp());
+        emit dropped(frame.timestamp());
+        return;
+    }
     CaptureTask *task = new CaptureTask(this);
     // copy properties so the task will not be affect even if VideoCapture properties changed
     task->save = autoSave();
     task->original_fmt = original_fmt;
+    task->direct_encode = direct_encode;
     task->quality = qual;
     task->dir = dir;
     task->name = name;
@@ -209,7 +431,21 @@ void VideoCapture::start()
     task->qfmt = qfmt;
     task->frame = frame; //copy here and it's safe in capture thread because start() is called immediatly after setVideoFrame
     if (isAsync()) {
-        videoCaptureThreadPool()->start(task);
+        CaptureTask *dropped_task = 0;
+        {
+            QMutexLocker lock(&queue->mutex);
+            Q_UNUSED(lock);
+            // running tasks can not be dropped
+            if (max_pending > 0 && !queue->tasks.isEmpty() && queue->tasks.size() + queue->running >= max_pending)
+                dropped_task = queue->tasks.takeFirst();
+            queue->tasks.append(task);
+        }
+        if (dropped_task) {
+            qDebug("too many pending captures. drop the frame at %.3f", dropped_task->frame.timestamp());
+            emit dropped(dropped_task->frame.timestamp());
+            delete dropped_task;
+        }
+        videoCaptureThreadPool()->start(new CaptureRunner(queue));
     } else {
         task->run();
         delete task;
@@ -279,7 +515,11 @@ void VideoCapture::setVideoFrame(const VideoFrame &frame)
      * clone here may block VideoThread. But if not clone here, the frame may be
      * modified outside and is not safe.
      */
-    this->frame = frame.clone(); // TODO: no clone, use detach()
+    // a frame on gpu holds its surface. keep it so that it's converted by GLFrameConverter and only the image is read back
+    if (!frame.hasHostData() && !original_fmt)
+        this->frame = frame;
+    else
+        this->frame = frame.clone(); // TODO: no clone, use detach()
 }
 
 } //namespace QtAV
@@ -20,6 +20,7 @@
 ******************************************************************************/
 
 #include "QtAV/VideoFormat.h"
+#include <climits>
 #include <cmath>
 #include <QtCore/QVector>
 #ifndef QT_NO_DEBUG_STREAM
@@ -43,52 +44,43 @@ namespace QtAV {
 class VideoFormatPrivate : public QSharedData
 {
 public:
-    VideoFormatPrivate(VideoFormat::PixelFormat fmt)
+    VideoFormatPrivate(VideoFormat::PixelFormat fmt, bool warn = true)
         : pixfmt(fmt)
         , pixfmt_ff(QTAV_PIX_FMT_C(NONE))
         , qpixfmt(QImage::Format_Invalid)
-        , planes(0)
-        , bpp(0)
-        , bpp_pad(0)
-        , bpc(0)
         , pixdesc(0)
     {
+        reset();
         if (fmt == VideoFormat::Format_Invalid) {
             pixfmt_ff = QTAV_PIX_FMT_C(NONE);
             qpixfmt = QImage::Format_Invalid;
             return;
         }
-        init(fmt);
+        init(fmt, warn);
     }
     VideoFormatPrivate(AVPixelFormat fmt)
         : pixfmt(VideoFormat::Format_Invalid)
         , pixfmt_ff(fmt)
         , qpixfmt(QImage::Format_Invalid)
-        , planes(0)
-        , bpp(0)
-        , bpp_pad(0)
-        , bpc(0)
         , pixdesc(0)
     {
+        reset();
         init(fmt);
     }
     VideoFormatPrivate(QImage::Format fmt)
         : pixfmt(VideoFormat::Format_Invalid)
         , pixfmt_ff(QTAV_PIX_FMT_C(NONE))
         , qpixfmt(fmt)
-        , planes(0)
-        , bpp(0)
-        , bpp_pad(0)
-        , bpc(0)
         , pixdesc(0)
     {
+        reset();
         init(fmt);
     }
-    void init(VideoFormat::PixelFormat fmt) {
+    void init(VideoFormat::PixelFormat fmt, bool warn = true) {
         pixfmt = fmt;
         pixfmt_ff = (AVPixelFormat)VideoFormat::pixelFormatToFFmpeg((VideoFormat::PixelFormat)pixfmt);
         qpixfmt = VideoFormat::imageFormatFromPixelFormat(pixfmt);
-        init();
+        init(warn);
     }
     void init(QImage::Format fmt) {
         qpixfmt = fmt;
@@ -103,23 +95,23 @@ public:
         init();
     }
 
-    void init() {
+    void init(bool warn = true) {
+        reset();
         // FIXME: hack for invalid ffmpeg formats
         if (pixfmt == VideoFormat::Format_VYUY) {
             pixfmt_ff = QTAV_PIX_FMT_C(UYVY422);
         }
         // TODO: what if other formats not supported by ffmpeg? give attributes in QtAV?
         if (pixfmt_ff == QTAV_PIX_FMT_C(NONE)) {
-            qWarning("Invalid pixel format");
+            if (warn)
+                qWarning("Invalid pixel format");
             return;
         }
-        planes = qMax(av_pix_fmt_count_planes(pixfmt_ff), 0);
-        bpps.resize(planes);
-        bpps_pad.resize(planes);
-        channels.resize(planes);
+        planes = qBound(0, av_pix_fmt_count_planes(pixfmt_ff), (int)kMaxPlanes);
         pixdesc = const_cast<AVPixFmtDescriptor*>(av_pix_fmt_desc_get(pixfmt_ff));
         if (!pixdesc)
             return;
+        av_image_fill_max_pixsteps(max_pixsteps, max_pixstep_comps, pixdesc);
         initBpp();
     }
     QString name() const {
@@ -130,10 +122,18 @@ public:
             return 0;
         return pixdesc->flags;
     }
+    // the same as av_image_get_linesize() but from the precomputed pixel steps
     int bytesPerLine(int width, int plane) const {
-        return av_image_get_linesize(pixfmt_ff, width, plane);
+        if (!pixdesc || width <= 0 || plane < 0 || plane >= planes || (pixdesc->flags & (AV_PIX_FMT_FLAG_HWACCEL|AV_PIX_FMT_FLAG_BITSTREAM)))
+            return av_image_get_linesize(pixfmt_ff, width, plane);
+        const int s = max_pixstep_comps[plane] == 1 || max_pixstep_comps[plane] == 2 ? pixdesc->log2_chroma_w : 0;
+        const int w = (width + (1 << s) - 1) >> s;
+        if (max_pixsteps[plane] > INT_MAX/w) // overflow, let ffmpeg report the error
+            return av_image_get_linesize(pixfmt_ff, width, plane);
+        return max_pixsteps[plane]*w;
     }
 
+    enum { kMaxPlanes = 4 };
     VideoFormat::PixelFormat pixfmt;
     AVPixelFormat pixfmt_ff;
     QImage::Format qpixfmt;
@@ -141,12 +141,29 @@ public:
     quint8 bpp;
     quint8 bpp_pad;
     quint8 bpc;
-    QVector<int> bpps;
-    QVector<int> bpps_pad; //TODO: is it needed?
-    QVector<int> channels;
+    // fixed arrays, so a copy of the private data does not allocate
+    int bpps[kMaxPlanes];
+    int bpps_pad[kMaxPlanes]; //TODO: is it needed?
+    int channels[kMaxPlanes];
+    int max_pixsteps[kMaxPlanes];
+    int max_pixstep_comps[kMaxPlanes];
 
     AVPixFmtDescriptor *pixdesc;
 private:
+    void reset() {
+        planes = 0;
+        bpp = 0;
+        bpp_pad = 0;
+        bpc = 0;
+        pixdesc = 0;
+        for (int i = 0; i < kMaxPlanes; ++i) {
+            bpps[i] = 0;
+            bpps_pad[i] = 0;
+            channels[i] = 0;
+            max_pixsteps[i] = 0;
+            max_pixstep_comps[i] = 0;
+        }
+    }
     // from libavutil/pixdesc.c
     void initBpp() {
         //TODO: call later when bpp need
@@ -156,6 +173,8 @@ private:
         int log2_pixels = pixdesc->log2_chroma_w + pixdesc->log2_chroma_h;
         for (int c = 0; c < pixdesc->nb_components; c++) {
             const AVComponentDescriptor *comp = &pixdesc->comp[c];
+            if (comp->plane >= kMaxPlanes)
+                continue;
             int s = c == 1 || c == 2 ? 0 : log2_pixels; //?
             bpps[comp->plane] = (comp->depth_minus1 + 1) << s;
             bpps_pad[comp->plane] = (comp->step_minus1 + 1) << s;
@@ -367,6 +386,11 @@ static const struct {
     { VideoFormat::Format_RGBA64, QTAV_PIX_FMT_C(RGBA64) },
     { VideoFormat::Format_BGRA64, QTAV_PIX_FMT_C(BGRA64) },
 #endif //QTAV_USE_FFMPEG(LIBAVUTIL)
+// 2016-01 - lavu 55.6.0 / 55.16.100 - pixfmt.h: Add AV_PIX_FMT_P010
+#if AV_MODULE_CHECK(LIBAVUTIL, 55, 6, 0, 16, 100)
+    { VideoFormat::Format_P010LE, QTAV_PIX_FMT_C(P010LE) }, ///< like NV12, with 10bpp per component, data in the high bits, zeros in the low bits, little-endian
+    { VideoFormat::Format_P010BE, QTAV_PIX_FMT_C(P010BE) }, ///< like NV12, with 10bpp per component, data in the high bits, zeros in the low bits, big-endian
+#endif
     { VideoFormat::Format_Invalid, QTAV_PIX_FMT_C(NONE) },
 };
 
@@ -433,14 +457,65 @@ QImage::Format VideoFormat::imageFormatFromPixelFormat(PixelFormat format)
     return QImage::Format_Invalid;
 }
 
+/*
+ * Descriptors of all PixelFormat and AVPixelFormat values are computed once. A VideoFormat constructed from them shares
+ * the table entry, so construction is only a reference count increment, and modifying it detaches as usual.
+ */
+class VideoFormatTable
+{
+public:
+    VideoFormatTable() {
+        fmts.reserve(VideoFormat::Format_User - VideoFormat::Format_Invalid);
+        for (int i = VideoFormat::Format_Invalid; i < VideoFormat::Format_User; ++i)
+            fmts.append(QSharedDataPointer<VideoFormatPrivate>(new VideoFormatPrivate((VideoFormat::PixelFormat)i, false)));
+        ff_fmts.reserve(QTAV_PIX_FMT_C(NB));
+        for (int i = 0; i < QTAV_PIX_FMT_C(NB); ++i)
+            ff_fmts.append(QSharedDataPointer<VideoFormatPrivate>(new VideoFormatPrivate((AVPixelFormat)i)));
+    }
+    QSharedDataPointer<VideoFormatPrivate> get(VideoFormat::PixelFormat fmt) const {
+        const int i = fmt - VideoFormat::Format_Invalid;
+        if (i < 0 || i >= fmts.size())
+            return QSharedDataPointer<VideoFormatPrivate>(new VideoFormatPrivate(fmt));
+        if (fmt != VideoFormat::Format_Invalid && fmts.at(i)->pixfmt_ff == QTAV_PIX_FMT_C(NONE))
+            qWarning("Invalid pixel format");
+        return fmts.at(i);
+    }
+    QSharedDataPointer<VideoFormatPrivate> get(AVPixelFormat fmt) const {
+        if (fmt == QTAV_PIX_FMT_C(NONE))
+            return fmts.at(0);
+        if (fmt < 0 || fmt >= ff_fmts.size())
+            return QSharedDataPointer<VideoFormatPrivate>(new VideoFormatPrivate(fmt));
+        return ff_fmts.at(fmt);
+    }
+private:
+    QVector<QSharedDataPointer<VideoFormatPrivate> > fmts; // indexed by PixelFormat - Format_Invalid
+    QVector<QSharedDataPointer<VideoFormatPrivate> > ff_fmts; // indexed by AVPixelFormat
+};
+Q_GLOBAL_STATIC(VideoFormatTable, videoFormatTable)
+
+static QSharedDataPointer<VideoFormatPrivate> sharedFormat(VideoFormat::PixelFormat fmt)
+{
+    const VideoFormatTable *t = videoFormatTable();
+    if (!t) // destroyed at exit
+        return QSharedDataPointer<VideoFormatPrivate>(new VideoFormatPrivate(fmt));
+    return t->get(fmt);
+}
+
+static QSharedDataPointer<VideoFormatPrivate> sharedFormat(AVPixelFormat fmt)
+{
+    const VideoFormatTable *t = videoFormatTable();
+    if (!t)
+        return QSharedDataPointer<VideoFormatPrivate>(new VideoFormatPrivate(fmt));
+    return t->get(fmt);
+}
 
 VideoFormat::VideoFormat(PixelFormat format)
-    :d(new VideoFormatPrivate(format))
+    :d(sharedFormat(format))
 {
 }
 
 VideoFormat::VideoFormat(int formatFF)
-    :d(new VideoFormatPrivate((AVPixelFormat)formatFF))
+    :d(sharedFormat((AVPixelFormat)formatFF))
 {
 }
 
@@ -581,7 +656,7 @@ int VideoFormat::channels() const
 
 int VideoFormat::channels(int plane) const
 {
-    if (plane > d->channels.size())
+    if (plane < 0 || plane >= d->planes)
         return 0;
     return d->channels[plane];
 }
@@ -603,15 +678,15 @@ int VideoFormat::bitsPerPixelPadded() const
 
 int VideoFormat::bitsPerPixelPadded(int plane) const
 {
-    if (plane >= d->bpps.size())
+    if (plane < 0 || plane >= d->planes)
         return 0;
     return d->bpps_pad[plane];
 }
 
 int VideoFormat::bitsPerPixel(int plane) const
 {
-    //must be a valid index position in the vector
-    if (plane >= d->bpps.size())
+    //must be a valid plane index
+    if (plane < 0 || plane >= d->planes)
         return 0;
     return d->bpps[plane];
 }
@@ -718,6 +793,7 @@ bool VideoFormat::hasAlpha() const
 bool VideoFormat::isPlanar(PixelFormat pixfmt)
 {
     return pixfmt == Format_YUV420P || pixfmt == Format_NV12 || pixfmt == Format_NV21 || pixfmt == Format_YV12
+            || pixfmt == Format_P010LE || pixfmt == Format_P010BE
             || pixfmt == Format_YUV410P || pixfmt == Format_YUV411P || pixfmt == Format_YUV422P
             || pixfmt == Format_YUV444P || pixfmt == Format_AYUV444
         || pixfmt == Format_IMC1 || pixfmt == Format_IMC2 || pixfmt == Format_IMC3 || pixfmt == Format_IMC4
@@ -23,9 +23,18 @@
 #include "QtAV/private/Frame_p.h"
 #include "QtAV/SurfaceInterop.h"
 #include "ImageConverter.h"
+#if QTAV_HAVE(GLCONVERTER)
+#include "GLFrameConverter.h"
+#endif
+#include <QtCore/QMutex>
+#include <QtCore/QSemaphore>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QThreadStorage>
 #include <QtGui/QImage>
 #include "QtAV/private/AVCompat.h"
+#include "utils/FrameBufferPool.h"
 #include "utils/GPUMemCopy.h"
 #include "utils/Logger.h"
 
@@ -38,9 +47,302 @@ static const struct RegisterMetaTypes
         qRegisterMetaType<QtAV::VideoFrame>("QtAV::VideoFrame");
     }
 } _registerMetaTypes;
+
+/*!
+ * Converters of recent conversions in current thread, the most recently used first. Creating a SwsContext costs more than
+ * converting a thumbnail, so workloads alternating sizes or formats reuse the converters instead of setting up again.
+ */
+class ConverterCache
+{
+public:
+    ConverterCache() {}
+    ~ConverterCache() {
+        foreach (const Entry& e, m_entries) {
+            delete e.cvt;
+        }
+    }
+    ImageConverter* converter(int fmt_in, int w_in, int h_in, int fmt_out, int w_out, int h_out, const int eq[3]) {
+        const Entry key = { fmt_in, w_in, h_in, fmt_out, w_out, h_out, 0 };
+        ImageConverter *cvt = 0;
+        for (int i = 0; i < m_entries.size(); ++i) {
+            if (!m_entries.at(i).matches(key))
+                continue;
+            cvt = m_entries.at(i).cvt;
+            m_entries.move(i, 0);
+            break;
+        }
+        if (!cvt) {
+            if (m_entries.size() >= kMaxConverters) {
+                delete m_entries.last().cvt;
+                m_entries.removeLast();
+            }
+            cvt = new ImageConverterSWS();
+            cvt->setInFormat(fmt_in);
+            cvt->setOutFormat(fmt_out);
+            cvt->setInSize(w_in, h_in);
+            cvt->setOutSize(w_out, h_out);
+            Entry e(key);
+            e.cvt = cvt;
+            m_entries.prepend(e);
+        }
+        // converters are shared by VideoFrame::to() and VideoFrameConverter of current thread
+        cvt->setBrightness(eq[0]);
+        cvt->setContrast(eq[1]);
+        cvt->setSaturation(eq[2]);
+        return cvt;
+    }
+private:
+    Q_DISABLE_COPY(ConverterCache)
+    enum { kMaxConverters = 8 };
+    struct Entry {
+        int fmt_in, w_in, h_in;
+        int fmt_out, w_out, h_out;
+        ImageConverter *cvt;
+        bool matches(const Entry& e) const {
+            return fmt_in == e.fmt_in && w_in == e.w_in && h_in == e.h_in
+                    && fmt_out == e.fmt_out && w_out == e.w_out && h_out == e.h_out;
+        }
+    };
+    QList<Entry> m_entries;
+};
+Q_GLOBAL_STATIC(QThreadStorage<ConverterCache*>, converterCaches)
+
+// the output data is released after the frame of the result is created, so cached converters do not keep frame buffers
+static ImageConverter* cachedConverter(int fmt_in, int w_in, int h_in, int fmt_out, int w_out, int h_out, const int eq[3])
+{
+    QThreadStorage<ConverterCache*> *caches = converterCaches();
+    if (!caches->hasLocalData())
+        caches->setLocalData(new ConverterCache());
+    return caches->localData()->converter(fmt_in, w_in, h_in, fmt_out, w_out, h_out, eq);
+}
+
+static int s_alignment = 64;
+
+static inline int alignUp(int x, int align)
+{
+    return (x + align - 1) & ~(align - 1);
+}
+
+static inline uchar* alignUp(uchar* p, int align)
+{
+    return p + ((align - ((uintptr_t)p & (align - 1))) & (align - 1));
 }
 
-VideoFrame VideoFrame::fromGPU(const VideoFormat& fmt, int width, int height, int surface_h, quint8 *src[], int pitch[], bool optimized, bool swapUV)
+static inline int planeRows(const VideoFormat& fmt, int height, int plane)
+{
+    // plane 3 is alpha
+    return plane == 1 || plane == 2 ? fmt.chromaHeight(height) : height;
+}
+
+// copy back from gpu memory is bound by memory latency of 1 core. a large frame is split into row bands copied by
+// a few threads. more threads than memory channels does not help
+class CopyThreadPool : public QThreadPool
+{
+public:
+    CopyThreadPool() : QThreadPool() {
+        setMaxThreadCount(qBound(1, QThread::idealThreadCount() - 1, 3));
+    }
+};
+Q_GLOBAL_STATIC(CopyThreadPool, copyThreadPool)
+// smaller frames (e.g. 1080p nv12) are copied in 1 thread. waking up workers costs more
+static const int kParallelCopyMinBytes = 6*1024*1024;
+
+// a plane or rows of a plane to copy from gpu. if dst_v is set, interleaved uv is split to dst and dst_v
+struct CopyPlane {
+    CopyPlane() : dst(0), dst_v(0), dst_pitch(0), src(0), src_pitch(0), rows(0), uv_pairs(0) {}
+    uchar *dst;
+    uchar *dst_v;
+    int dst_pitch;
+    const quint8 *src;
+    int src_pitch;
+    int rows;
+    int uv_pairs;
+
+    void copy() const {
+        if (dst_v)
+            gpu_split_uv(dst, dst_v, dst_pitch, src, src_pitch, uv_pairs, rows);
+        else
+            gpu_memcpy(dst, src, size_t(src_pitch)*size_t(rows));
+    }
+    CopyPlane band(int y, int nb_rows) const {
+        CopyPlane b(*this);
+        b.dst += y*dst_pitch;
+        if (b.dst_v)
+            b.dst_v += y*dst_pitch;
+        b.src += y*src_pitch;
+        b.rows = nb_rows;
+        return b;
+    }
+};
+
+class CopyBandTask : public QRunnable
+{
+public:
+    CopyBandTask(const CopyPlane& band, QSemaphore *done)
+        : m_band(band), m_done(done)
+    {}
+    void run() Q_DECL_OVERRIDE {
+        m_band.copy();
+        m_done->release();
+    }
+private:
+    CopyPlane m_band;
+    QSemaphore *m_done;
+};
+
+// planes are split at rows, so every band starts at a pitch aligned address as the plane does
+static void copyPlanes(const CopyPlane* planes, int nb_planes, int total)
+{
+    const int nb_bands = total < kParallelCopyMinBytes ? 1 : copyThreadPool()->maxThreadCount() + 1;
+    if (nb_bands <= 1) {
+        for (int i = 0; i < nb_planes; ++i) {
+            planes[i].copy();
+        }
+        return;
+    }
+    const int band_bytes = (total + nb_bands - 1)/nb_bands;
+    QSemaphore done;
+    int nb_tasks = 0;
+    // the last band is copied in current thread
+    CopyPlane last;
+    for (int i = 0; i < nb_planes; ++i) {
+        const CopyPlane &p = planes[i];
+        const int rows = qMax(1, band_bytes/p.src_pitch);
+        for (int y = 0; y < p.rows; y += rows) {
+            if (last.rows > 0) {
+                copyThreadPool()->start(new CopyBandTask(last, &done));
+                ++nb_tasks;
+            }
+            last = p.band(y, qMin(rows, p.rows - y));
+        }
+    }
+    if (last.rows > 0)
+        last.copy();
+    done.acquire(nb_tasks);
+}
+}
+
+class VideoFramePrivate : public FramePrivate
+{
+    Q_DISABLE_COPY(VideoFramePrivate)
+public:
+    VideoFramePrivate()
+        : FramePrivate()
+        , width(0)
+        , height(0)
+        , color_space(ColorSpace_Unknow)
+        , color_trc(ColorTransfer_SDR)
+        , color_primaries(ColorPrimaries_BT709)
+        , interlaced(false)
+        , top_field_first(true)
+        , field(0)
+        , displayAspectRatio(0)
+        , format(VideoFormat::Format_Invalid)
+        , pooled(false)
+        , alignment(0)
+        , host_map_tried(false)
+    {
+        resizePlanes(&textures, 4);
+    }
+    VideoFramePrivate(int w, int h, const VideoFormat& fmt)
+        : FramePrivate()
+        , width(w)
+        , height(h)
+        , color_space(ColorSpace_Unknow)
+        , color_trc(ColorTransfer_SDR)
+        , color_primaries(ColorPrimaries_BT709)
+        , interlaced(false)
+        , top_field_first(true)
+        , field(0)
+        , displayAspectRatio(0)
+        , format(fmt)
+        , pooled(false)
+        , alignment(0)
+        , host_map_tried(false)
+    {
+        resizePlanes(&textures, 4);
+        if (!format.isValid())
+            return;
+        resizePlanes(&planes, format.planeCount());
+        resizePlanes(&line_sizes, format.planeCount());
+        resizePlanes(&textures, format.planeCount());
+    }
+    ~VideoFramePrivate() {
+        // the last frame referencing data is destroyed
+        if (pooled)
+            FrameBufferPool::instance().put(data);
+    }
+    // copy back a hw frame of the same format the first time host data is accessed. frames sharing this see the result
+    bool mapToHost() Q_DECL_OVERRIDE {
+        QMutexLocker lock(&host_mutex);
+        if (!planes.isEmpty() && planes[0])
+            return true;
+        if (host_map_tried)
+            return false;
+        host_map_tried = true;
+        const VideoSurfaceInteropPtr si(surface_interop);
+        if (!si)
+            return false;
+        VideoFrame f;
+        if (!si->map(HostMemorySurface, format, &f))
+            return false;
+        VideoFramePrivate *fd = f.d_func();
+        if (fd->format != format || fd->width != width || fd->height != height || fd->planes.size() != planes.size() || !fd->planes[0]) {
+            qDebug("VideoFrame: hw surface can not be mapped to host as %s", qPrintable(format.name()));
+            return false;
+        }
+        data = fd->data;
+        pooled = fd->pooled;
+        fd->pooled = false;
+        // line sizes first, planes are checked by other threads
+        for (int i = 0; i < planes.size(); ++i) {
+            line_sizes[i] = fd->line_sizes[i];
+            planes[i] = fd->planes[i];
+        }
+        return true;
+    }
+    // "surface_interop" is stored in surface_interop
+    bool sideMetaData(const QString& key, QVariant *value) const Q_DECL_OVERRIDE {
+        if (key != QLatin1String("surface_interop"))
+            return false;
+        if (surface_interop)
+            *value = QVariant::fromValue(surface_interop);
+        return true;
+    }
+    bool setSideMetaData(const QString& key, const QVariant& value) Q_DECL_OVERRIDE {
+        if (key != QLatin1String("surface_interop"))
+            return false;
+        surface_interop = value.value<VideoSurfaceInteropPtr>();
+        return true;
+    }
+    void availableSideMetaData(QVariantMap *map) const Q_DECL_OVERRIDE {
+        if (surface_interop)
+            map->insert(QStringLiteral("surface_interop"), QVariant::fromValue(surface_interop));
+    }
+    void copyMetaData(const FramePrivate* other) Q_DECL_OVERRIDE {
+        FramePrivate::copyMetaData(other);
+        surface_interop = static_cast<const VideoFramePrivate*>(other)->surface_interop;
+    }
+    int width, height;
+    ColorSpace color_space;
+    ColorTransfer color_trc;
+    ColorPrimaries color_primaries;
+    HDRMetadata hdr;
+    bool interlaced;
+    bool top_field_first;
+    int field;
+    float displayAspectRatio;
+    VideoFormat format;
+    QVarLengthArray<int, kInlinePlanes> textures;
+    bool pooled; // data is from FrameBufferPool
+    int alignment; // 0: default
+    bool host_map_tried;
+    mutable QMutex host_mutex;
+
+    VideoSurfaceInteropPtr surface_interop;
+};
+
+VideoFrame VideoFrame::fromGPU(const VideoFormat& fmt, int width, int height, int surface_h, quint8 *src[], int pitch[], bool optimized, bool swapUV, VideoFormat::PixelFormat hostFormat)
 {
     Q_ASSERT(src[0] && pitch[0] > 0 && "VideoFrame::fromGPU: src[0] and pitch[0] must be set");
     const int nb_planes = fmt.planeCount();
@@ -55,6 +357,42 @@ VideoFrame VideoFrame::fromGPU(const VideoFormat& fmt, int width, int height, in
         if (!src[i])
             src[i] = src[i-1] + pitch[i-1]*h[i-1];
     }
+    // at least 32 for avx2 copy
+    const int align = qMax(32, s_alignment);
+    const VideoFormat::PixelFormat pixfmt = fmt.pixelFormat();
+    if ((pixfmt == VideoFormat::Format_NV12 || pixfmt == VideoFormat::Format_NV21) && hostFormat == VideoFormat::Format_YUV420P) {
+        // deinterleave chroma while copying, so no converter pass over the frame later
+        const int yuv_size = pitch[0]*h[0] + pitch[1]*h[1];
+        int dst_pitch[] = { pitch[0], pitch[1]/2, pitch[1]/2 };
+        const int y_size = alignUp(pitch[0]*h[0], align);
+        const int c_size = alignUp(dst_pitch[1]*h[1], align);
+        QByteArray buf(FrameBufferPool::instance().get(align - 1 + y_size + 2*c_size));
+        QVector<uchar*> dst(3, 0);
+        dst[0] = alignUp((uchar*)buf.data(), align);
+        dst[1] = dst[0] + y_size;
+        dst[2] = dst[1] + c_size;
+        CopyPlane planes[2];
+        planes[0].dst = dst[0];
+        planes[0].dst_pitch = pitch[0];
+        planes[0].src = src[0];
+        planes[0].src_pitch = pitch[0];
+        planes[0].rows = h[0];
+        planes[1].dst = dst[1];
+        planes[1].dst_v = dst[2];
+        if ((pixfmt == VideoFormat::Format_NV21) != swapUV)
+            std::swap(planes[1].dst, planes[1].dst_v);
+        planes[1].dst_pitch = dst_pitch[1];
+        planes[1].src = src[1];
+        planes[1].src_pitch = pitch[1];
+        planes[1].rows = h[1];
+        planes[1].uv_pairs = (width + 1)/2;
+        copyPlanes(planes, 2, yuv_size);
+        VideoFrame frame(buf, width, height, VideoFormat(VideoFormat::Format_YUV420P));
+        frame.d_func()->pooled = true;
+        frame.setBits(dst);
+        frame.setBytesPerLine(dst_pitch);
+        return frame;
+    }
     if (swapUV) {
         std::swap(src[1], src[2]);
         std::swap(pitch[1], pitch[2]);
@@ -62,24 +400,30 @@ VideoFrame VideoFrame::fromGPU(const VideoFormat& fmt, int width, int height, in
     VideoFrame frame;
     if (optimized) {
         int yuv_size = 0;
+        int buf_size = align - 1;
         for (int i = 0; i < nb_planes; ++i) {
             yuv_size += pitch[i]*h[i];
+            buf_size += alignUp(pitch[i]*h[i], align);
         }
-        // additional 15 bytes to ensure 16 bytes aligned
-        QByteArray buf(15 + yuv_size, 0);
-        const int offset_16 = (16 - ((uintptr_t)buf.data() & 0x0f)) & 0x0f;
-        // plane 1, 2... is aligned?
-        uchar* plane_ptr = (uchar*)buf.data() + offset_16;
+        QByteArray buf(FrameBufferPool::instance().get(buf_size));
+        // every plane starts at an aligned address. line sizes are the gpu pitch, so a plane is copied in 1 pass
+        uchar* plane_ptr = alignUp((uchar*)buf.data(), align);
         QVector<uchar*> dst(nb_planes, 0);
+        CopyPlane planes[4];
         for (int i = 0; i < nb_planes; ++i) {
             dst[i] = plane_ptr;
             // TODO: add VideoFormat::planeWidth/Height() ?
             // pitch instead of surface_width
-            plane_ptr += pitch[i] * h[i];
-            gpu_memcpy(dst[i], src[i], pitch[i]*h[i]);
-
+            plane_ptr += alignUp(pitch[i] * h[i], align);
+            planes[i].dst = dst[i];
+            planes[i].dst_pitch = pitch[i];
+            planes[i].src = src[i];
+            planes[i].src_pitch = pitch[i];
+            planes[i].rows = h[i];
         }
+        copyPlanes(planes, nb_planes, yuv_size);
         frame = VideoFrame(buf, width, height, fmt);
+        frame.d_func()->pooled = true;
         frame.setBits(dst);
         frame.setBytesPerLine(pitch);
     } else {
@@ -93,47 +437,6 @@ VideoFrame VideoFrame::fromGPU(const VideoFormat& fmt, int width, int height, in
     return frame;
 }
 
-class VideoFramePrivate : public FramePrivate
-{
-    Q_DISABLE_COPY(VideoFramePrivate)
-public:
-    VideoFramePrivate()
-        : FramePrivate()
-        , width(0)
-        , height(0)
-        , color_space(ColorSpace_Unknow)
-        , displayAspectRatio(0)
-        , format(VideoFormat::Format_Invalid)
-        , textures(4, 0)
-    {}
-    VideoFramePrivate(int w, int h, const VideoFormat& fmt)
-        : FramePrivate()
-        , width(w)
-        , height(h)
-        , color_space(ColorSpace_Unknow)
-        , displayAspectRatio(0)
-        , format(fmt)
-        , textures(4, 0)
-    {
-        if (!format.isValid())
-            return;
-        planes.resize(format.planeCount());
-        line_sizes.resize(format.planeCount());
-        textures.resize(format.planeCount());
-        planes.reserve(format.planeCount());
-        line_sizes.reserve(format.planeCount());
-        textures.reserve(format.planeCount());
-    }
-    ~VideoFramePrivate() {}
-    int width, height;
-    ColorSpace color_space;
-    float displayAspectRatio;
-    VideoFormat format;
-    QVector<int> textures;
-
-    VideoSurfaceInteropPtr surface_interop;
-};
-
 VideoFrame::VideoFrame()
     : Frame(new VideoFramePrivate())
 {
@@ -155,7 +458,7 @@ VideoFrame::VideoFrame(const QVector<int>& textures, int width, int height, cons
     : Frame(new VideoFramePrivate(width, height, format))
 {
     Q_D(VideoFrame);
-    d->textures = textures;
+    assignPlanes(&d->textures, textures);
 }
 
 VideoFrame::VideoFrame(const QImage& image)
@@ -209,31 +512,50 @@ VideoFrame VideoFrame::clone() const
         // maybe in gpu memory, then bits() is not set
         qDebug("frame data not valid. size: %d", d->data.size());
         VideoFrame f(width(), height(), d->format);
-        f.d_ptr->metadata = d->metadata; // need metadata?
+        f.d_ptr->copyMetaData(d); // need metadata?
         f.setTimestamp(d->timestamp);
         f.setDisplayAspectRatio(d->displayAspectRatio);
+        f.setColorTransfer(d->color_trc);
+        f.setColorPrimaries(d->color_primaries);
+        f.setHDRMetadata(d->hdr);
+        f.setInterlaced(d->interlaced, d->top_field_first);
+        f.setField(d->field);
         return f;
     }
-    int bytes = 0;
-    for (int i = 0; i < d->format.planeCount(); ++i) {
-        bytes += bytesPerLine(i)*planeHeight(i);
+    const int align = alignment();
+    const int nb_planes = d->format.planeCount();
+    int bytes = align - 1;
+    for (int i = 0; i < nb_planes; ++i) {
+        bytes += alignUp(bytesPerLine(i), align)*planeRows(d->format, height(), i);
     }
 
-    QByteArray buf(bytes, 0);
-    char *dst = buf.data(); //must before buf is shared, otherwise data will be detached.
+    QByteArray buf(FrameBufferPool::instance().get(bytes));
+    uchar *dst = alignUp((uchar*)buf.data(), align); //must before buf is shared, otherwise data will be detached.
     VideoFrame f(buf, width(), height(), d->format);
-    const int nb_planes = d->format.planeCount();
+    f.d_func()->pooled = true;
+    f.d_func()->alignment = d->alignment;
     for (int i = 0; i < nb_planes; ++i) {
-        f.setBits((quint8*)dst, i);
-        f.setBytesPerLine(bytesPerLine(i), i);
-        const int plane_size = bytesPerLine(i)*planeHeight(i);
-        memcpy(dst, constBits(i), plane_size);
-        dst += plane_size;
+        const int pitch = alignUp(bytesPerLine(i), align);
+        const int rows = planeRows(d->format, height(), i);
+        f.setBits(dst, i);
+        f.setBytesPerLine(pitch, i);
+        if (pitch == bytesPerLine(i)) {
+            memcpy(dst, constBits(i), pitch*rows);
+        } else {
+            for (int y = 0; y < rows; ++y)
+                memcpy(dst + y*pitch, constBits(i) + y*bytesPerLine(i), bytesPerLine(i));
+        }
+        dst += pitch*rows;
     }
-    f.d_ptr->metadata = d->metadata; // need metadata?
+    f.d_ptr->copyMetaData(d); // need metadata?
     f.setTimestamp(d->timestamp);
     f.setDisplayAspectRatio(d->displayAspectRatio);
     f.setColorSpace(d->color_space);
+    f.setColorTransfer(d->color_trc);
+    f.setColorPrimaries(d->color_primaries);
+    f.setHDRMetadata(d->hdr);
+    f.setInterlaced(d->interlaced, d->top_field_first);
+    f.setField(d->field);
     return f;
 }
 
@@ -254,14 +576,78 @@ int VideoFrame::allocate()
                          , width(), height(), align);
     return bytes;
 #endif
-    int bytes = avpicture_get_size((AVPixelFormat)pixelFormatFFmpeg(), width(), height());
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat)pixelFormatFFmpeg());
+    if (desc && (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_PSEUDOPAL))) {
+        // palette is not a plane of VideoFormat
+        const int bytes = avpicture_get_size((AVPixelFormat)pixelFormatFFmpeg(), width(), height());
+        if (d->data.size() < bytes) {
+            if (d->pooled)
+                FrameBufferPool::instance().put(d->data);
+            d->data = FrameBufferPool::instance().get(bytes);
+            d->pooled = true;
+            memset(d->data.data(), 0, bytes);
+        }
+        init();
+        return bytes;
+    }
+    const int align = alignment();
+    const int nb_planes = d->format.planeCount();
+    int bytes = align - 1;
+    for (int i = 0; i < nb_planes; ++i) {
+        bytes += alignUp(d->format.bytesPerLine(width(), i), align)*planeRows(d->format, height(), i);
+    }
     if (d->data.size() < bytes) {
-        d->data = QByteArray(bytes, 0);
+        if (d->pooled)
+            FrameBufferPool::instance().put(d->data);
+        d->data = FrameBufferPool::instance().get(bytes);
+        d->pooled = true;
+        memset(d->data.data(), 0, bytes);
+    }
+    uchar *dst = alignUp((uchar*)d->data.constData(), align);
+    for (int i = 0; i < nb_planes; ++i) {
+        const int pitch = alignUp(d->format.bytesPerLine(width(), i), align);
+        setBits(dst, i);
+        setBytesPerLine(pitch, i);
+        dst += pitch*planeRows(d->format, height(), i);
     }
-    init();
     return bytes;
 }
 
+void VideoFrame::setAlignment(int bytes)
+{
+    if (bytes < 0 || (bytes & (bytes - 1))) {
+        qWarning("VideoFrame::setAlignment: %d is not a power of 2", bytes);
+        return;
+    }
+    d_func()->alignment = bytes;
+}
+
+bool VideoFrame::hasHostData() const
+{
+    Q_D(const VideoFrame);
+    return !d->planes.isEmpty() && d->planes[0];
+}
+
+int VideoFrame::alignment() const
+{
+    Q_D(const VideoFrame);
+    return d->alignment > 0 ? d->alignment : s_alignment;
+}
+
+void VideoFrame::setDefaultAlignment(int bytes)
+{
+    if (bytes <= 0 || (bytes & (bytes - 1))) {
+        qWarning("VideoFrame::setDefaultAlignment: %d is not a power of 2", bytes);
+        return;
+    }
+    s_alignment = bytes;
+}
+
+int VideoFrame::defaultAlignment()
+{
+    return s_alignment;
+}
+
 VideoFormat VideoFrame::format() const
 {
     return d_func()->format;
@@ -351,6 +737,93 @@ void VideoFrame::setColorSpace(ColorSpace value)
     d_func()->color_space = value;
 }
 
+ColorTransfer VideoFrame::colorTransfer() const
+{
+    return d_func()->color_trc;
+}
+
+void VideoFrame::setColorTransfer(ColorTransfer value)
+{
+    d_func()->color_trc = value;
+}
+
+ColorPrimaries VideoFrame::colorPrimaries() const
+{
+    return d_func()->color_primaries;
+}
+
+void VideoFrame::setColorPrimaries(ColorPrimaries value)
+{
+    d_func()->color_primaries = value;
+}
+
+HDRMetadata VideoFrame::hdrMetadata() const
+{
+    return d_func()->hdr;
+}
+
+void VideoFrame::setHDRMetadata(const HDRMetadata &value)
+{
+    d_func()->hdr = value;
+}
+
+bool VideoFrame::isInterlaced() const
+{
+    return d_func()->interlaced;
+}
+
+bool VideoFrame::isTopFieldFirst() const
+{
+    return d_func()->top_field_first;
+}
+
+void VideoFrame::setInterlaced(bool interlaced, bool topFieldFirst)
+{
+    Q_D(VideoFrame);
+    d->interlaced = interlaced;
+    d->top_field_first = topFieldFirst;
+}
+
+int VideoFrame::field() const
+{
+    return d_func()->field;
+}
+
+void VideoFrame::setField(int value)
+{
+    d_func()->field = value;
+}
+
+VideoFrame VideoFrame::secondField() const
+{
+    Q_D(const VideoFrame);
+    VideoFrame f(width(), height(), d->format);
+    if (!d->format.isValid())
+        return f;
+    VideoFramePrivate *fd = f.d_func();
+    // planes of a hw frame may be not mapped yet. the copy maps itself through surface_interop in metadata
+    QMutexLocker lock(&d->host_mutex);
+    Q_UNUSED(lock);
+    fd->planes = d->planes;
+    fd->line_sizes = d->line_sizes;
+    fd->textures = d->textures;
+    // a pooled buffer is put back when the last frame sharing it is destroyed
+    fd->data = d->data;
+    fd->pooled = d->pooled;
+    fd->alignment = d->alignment;
+    fd->copyMetaData(d);
+    fd->timestamp = d->timestamp;
+    fd->color_space = d->color_space;
+    fd->color_trc = d->color_trc;
+    fd->color_primaries = d->color_primaries;
+    fd->hdr = d->hdr;
+    fd->displayAspectRatio = d->displayAspectRatio;
+    fd->interlaced = d->interlaced;
+    fd->top_field_first = d->top_field_first;
+    fd->field = 1;
+    return f;
+}
+
 int VideoFrame::effectiveBytesPerLine(int plane) const
 {
     Q_D(const VideoFrame);
@@ -368,44 +841,98 @@ QImage VideoFrame::toImage(QImage::Format fmt, const QSize& dstSize, const QRect
 
 VideoFrame VideoFrame::to(const VideoFormat &fmt, const QSize& dstSize, const QRectF& roi) const
 {
-    if (!isValid() || !constBits(0)) {// hw surface. map to host. only supports rgb packed formats now
+    // a hw surface is mapped to fmt directly if not scaled. otherwise copied back in its own format and scaled and
+    // converted in 1 pass below, which downloads less data
+    const bool scaled = (dstSize.isValid() && dstSize != size()) || (roi.isValid() && roi != QRectF(0, 0, width(), height()));
+#if QTAV_HAVE(GLCONVERTER)
+    // scale and convert on gpu and read back the result only. fallback to copy back if failed
+    if (isValid() && !hasHostData() && GLFrameConverter::isSupported(fmt.pixelFormat())) {
+        const QRectF r(roi.isValid() ? roi & QRectF(0, 0, width(), height()) : QRectF());
+        int w = r.isValid() ? qRound(r.width()) : width();
+        int h = r.isValid() ? qRound(r.height()) : height();
+        if (dstSize.width() > 0)
+            w = dstSize.width();
+        if (dstSize.height() > 0)
+            h = dstSize.height();
+        const int pitch = w*fmt.bytesPerPixel();
+        if (w > 0 && h > 0) {
+            QByteArray data(FrameBufferPool::instance().get(pitch*h));
+            if (GLFrameConverter::convert(*this, r, fmt.pixelFormat(), QSize(w, h), (uchar*)data.data(), pitch)) {
+                VideoFrame f(data, w, h, fmt);
+                f.d_func()->pooled = true;
+                f.setBits((uchar*)data.constData(), 0);
+                f.setBytesPerLine(pitch, 0);
+                f.setColorSpace(ColorSpace_RGB);
+                f.setTimestamp(timestamp());
+                f.setDisplayAspectRatio(displayAspectRatio());
+                return f;
+            }
+            FrameBufferPool::instance().put(data);
+        }
+    }
+#endif //QTAV_HAVE(GLCONVERTER)
+    if (!isValid() || (!hasHostData() && (!scaled || !constBits(0)))) {
         Q_D(const VideoFrame);
-        const QVariant v = d->metadata.value(QStringLiteral("surface_interop"));
-        if (!v.isValid())
-            return VideoFrame();
-        VideoSurfaceInteropPtr si = v.value<VideoSurfaceInteropPtr>();
+        const VideoSurfaceInteropPtr si(d->surface_interop);
         if (!si)
             return VideoFrame();
         VideoFrame f;
         f.setDisplayAspectRatio(displayAspectRatio());
         f.setTimestamp(timestamp());
         if (si->map(HostMemorySurface, fmt, &f)) {
-            if ((!dstSize.isValid() ||dstSize == QSize(width(), height())) && (!roi.isValid() || roi == QRectF(0, 0, width(), height()))) //roi is not supported now
+            if ((!dstSize.isValid() ||dstSize == QSize(width(), height())) && (!roi.isValid() || roi == QRectF(0, 0, width(), height())))
                 return f;
             return f.to(fmt, dstSize, roi);
         }
         return VideoFrame();
     }
-    if (fmt.pixelFormatFFmpeg() == pixelFormatFFmpeg())
-        return *this;
     Q_D(const VideoFrame);
-    ImageConverterSWS conv;
-    conv.setInFormat(pixelFormatFFmpeg());
-    conv.setOutFormat(fmt.pixelFormatFFmpeg());
-    conv.setInSize(width(), height());
-    int w = width(), h = height();
+    const QRect frame_rect(0, 0, width(), height());
+    QRect r(frame_rect);
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat)pixelFormatFFmpeg());
+    // plane pointers can not point to a pixel of bitstream formats, and plane 1 of paletted formats is the palette
+    if (roi.isValid() && desc && !(desc->flags & (AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_PSEUDOPAL))) {
+        r = roi.toAlignedRect() & frame_rect;
+        if (r.isEmpty())
+            return VideoFrame();
+        // a chroma sample covers (1<<log2_chroma_w)x(1<<log2_chroma_h) pixels
+        r.setLeft(r.left() & ~((1 << desc->log2_chroma_w) - 1));
+        r.setTop(r.top() & ~((1 << desc->log2_chroma_h) - 1));
+    }
+    int w = r.width(), h = r.height();
     if (dstSize.width() > 0)
         w = dstSize.width();
     if (dstSize.height() > 0)
         h = dstSize.height();
-    conv.setOutSize(w, h);
-    if (!conv.convert(d->planes.constData(), d->line_sizes.constData())) {
+    if (fmt.pixelFormatFFmpeg() == pixelFormatFFmpeg() && r == frame_rect && w == width() && h == height())
+        return *this;
+    QVector<const quint8*> planes(d->planes.size());
+    // bytes between samples of a plane is the step of the first component in the plane, e.g. y of yuyv, u of nv12
+    int step[4] = { 0, 0, 0, 0 };
+    if (desc && !r.topLeft().isNull()) {
+        for (int c = desc->nb_components - 1; c >= 0; --c)
+            step[desc->comp[c].plane] = desc->comp[c].step_minus1 + 1;
+    }
+    for (int i = 0; i < planes.size(); ++i) {
+        planes[i] = d->planes[i];
+        if (!planes[i] || i >= 4 || !step[i])
+            continue;
+        const bool chroma = i == 1 || i == 2;
+        const int y = chroma ? r.top() >> desc->log2_chroma_h : r.top();
+        const int x = chroma ? r.left() >> desc->log2_chroma_w : r.left();
+        planes[i] += y*d->line_sizes[i] + x*step[i];
+    }
+    static const int no_eq[3] = { 0, 0, 0 };
+    ImageConverter *conv = cachedConverter(pixelFormatFFmpeg(), r.width(), r.height(), fmt.pixelFormatFFmpeg(), w, h, no_eq);
+    if (!conv->convert(planes.constData(), d->line_sizes.constData())) {
         qWarning() << "VideoFrame::to error: " << format() << "=>" << fmt;
         return VideoFrame();
     }
-    VideoFrame f(conv.outData(), w, h, fmt);
-    f.setBits(conv.outPlanes());
-    f.setBytesPerLine(conv.outLineSizes());
+    VideoFrame f(conv->outData(), w, h, fmt);
+    f.d_func()->pooled = true; // ImageConverter data is from FrameBufferPool
+    f.setBits(conv->outPlanes());
+    f.setBytesPerLine(conv->outLineSizes());
+    conv->releaseOutData();
     if (fmt.isRGB()) {
         f.setColorSpace(fmt.isPlanar() ? ColorSpace_GBR : ColorSpace_RGB);
     } else {
@@ -413,7 +940,7 @@ VideoFrame VideoFrame::to(const VideoFormat &fmt, const QSize& dstSize, const QR
     }
     f.setTimestamp(timestamp());
     f.setDisplayAspectRatio(displayAspectRatio());
-    f.d_ptr->metadata = d->metadata; // need metadata?
+    f.d_ptr->copyMetaData(d); // need metadata?
     return f;
 }
 
@@ -422,13 +949,42 @@ VideoFrame VideoFrame::to(VideoFormat::PixelFormat pixfmt, const QSize& dstSize,
     return to(VideoFormat(pixfmt), dstSize, roi);
 }
 
+void VideoFrame::setBufferPoolSize(qint64 bytes)
+{
+    FrameBufferPool::instance().setMaxBytes(bytes);
+}
+
+qint64 VideoFrame::bufferPoolSize()
+{
+    return FrameBufferPool::instance().maxBytes();
+}
+
+void VideoFrame::bufferPoolStatistics(qint64 *hits, qint64 *misses, qint64 *idleBytes, qint64 *inUseBytes)
+{
+    const FrameBufferPool &pool = FrameBufferPool::instance();
+    if (hits)
+        *hits = pool.hits();
+    if (misses)
+        *misses = pool.misses();
+    if (idleBytes)
+        *idleBytes = pool.idleBytes();
+    if (inUseBytes)
+        *inUseBytes = pool.inUseBytes();
+}
+
+void VideoFrame::setMemoryLimit(qint64 bytes)
+{
+    FrameBufferPool::instance().setMemoryLimit(bytes);
+}
+
+qint64 VideoFrame::memoryLimit()
+{
+    return FrameBufferPool::instance().memoryLimit();
+}
+
 void *VideoFrame::map(SurfaceType type, void *handle, int plane)
 {
     Q_D(VideoFrame);
-    const QVariant v = d->metadata.value(QStringLiteral("surface_interop"));
-    if (!v.isValid())
-        return 0;
-    d->surface_interop = v.value<VideoSurfaceInteropPtr>();
     if (!d->surface_interop)
         return 0;
     if (plane > planeCount())
@@ -436,6 +992,16 @@ void *VideoFrame::map(SurfaceType type, void *handle, int plane)
     return d->surface_interop->map(type, format(), handle, plane);
 }
 
+VideoSurfaceInteropPtr VideoFrame::surfaceInterop() const
+{
+    return d_func()->surface_interop;
+}
+
+void VideoFrame::setSurfaceInterop(const VideoSurfaceInteropPtr &value)
+{
+    d_func()->surface_interop = value;
+}
+
 void VideoFrame::unmap(void *handle)
 {
     Q_D(VideoFrame);
@@ -447,10 +1013,6 @@ void VideoFrame::unmap(void *handle)
 void* VideoFrame::createInteropHandle(void* handle, SurfaceType type, int plane)
 {
     Q_D(VideoFrame);
-    const QVariant v = d->metadata.value(QStringLiteral("surface_interop"));
-    if (!v.isValid())
-        return 0;
-    d->surface_interop = v.value<VideoSurfaceInteropPtr>();
     if (!d->surface_interop)
         return 0;
     if (plane > planeCount())
@@ -479,17 +1041,12 @@ void VideoFrame::init()
 }
 
 VideoFrameConverter::VideoFrameConverter()
-    : m_cvt(0)
 {
     memset(m_eq, 0, sizeof(m_eq));
 }
 
 VideoFrameConverter::~VideoFrameConverter()
 {
-    if (m_cvt) {
-        delete m_cvt;
-        m_cvt = 0;
-    }
 }
 
 void VideoFrameConverter::setEq(int brightness, int contrast, int saturation)
@@ -521,34 +1078,26 @@ VideoFrame VideoFrameConverter::convert(const VideoFrame &frame, int fffmt) cons
 {
     if (!frame.isValid() || fffmt == QTAV_PIX_FMT_C(NONE))
         return VideoFrame();
-    if (!frame.constBits(0)) // hw surface
+    if (!frame.hasHostData()) // hw surface
         return frame.to(VideoFormat::pixelFormatFromFFmpeg(fffmt));
     const VideoFormat format(frame.format());
     //if (fffmt == format.pixelFormatFFmpeg())
       //  return *this;
-    if (!m_cvt) {
-        m_cvt = new ImageConverterSWS();
-    }
-    m_cvt->setBrightness(m_eq[0]);
-    m_cvt->setContrast(m_eq[1]);
-    m_cvt->setSaturation(m_eq[2]);
-    m_cvt->setInFormat(format.pixelFormatFFmpeg());
-    m_cvt->setOutFormat(fffmt);
-    m_cvt->setInSize(frame.width(), frame.height());
-    m_cvt->setOutSize(frame.width(), frame.height());
+    ImageConverter *cvt = cachedConverter(format.pixelFormatFFmpeg(), frame.width(), frame.height(), fffmt, frame.width(), frame.height(), m_eq);
     QVector<const uchar*> pitch(format.planeCount());
     QVector<int> stride(format.planeCount());
     for (int i = 0; i < format.planeCount(); ++i) {
         pitch[i] = frame.constBits(i);
         stride[i] = frame.bytesPerLine(i);
     }
-    if (!m_cvt->convert(pitch.constData(), stride.constData())) {
+    if (!cvt->convert(pitch.constData(), stride.constData())) {
         return VideoFrame();
     }
     const VideoFormat fmt(fffmt);
-    VideoFrame f(m_cvt->outData(), frame.width(), frame.height(), fmt);
-    f.setBits(m_cvt->outPlanes());
-    f.setBytesPerLine(m_cvt->outLineSizes());
+    VideoFrame f(cvt->outData(), frame.width(), frame.height(), fmt);
+    f.setBits(cvt->outPlanes());
+    f.setBytesPerLine(cvt->outLineSizes());
+    cvt->releaseOutData();
     f.setTimestamp(frame.timestamp());
     f.setDisplayAspectRatio(frame.displayAspectRatio());
     // metadata?
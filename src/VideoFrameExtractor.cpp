@@ -20,17 +20,27 @@
 ******************************************************************************/
 
 #include "QtAV/VideoFrameExtractor.h"
+#include <algorithm>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QPair>
 #include <QtCore/QQueue>
 #include <QtCore/QRunnable>
 #include <QtCore/QScopedPointer>
 #include <QtCore/QStringList>
 #include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+#include <QtGui/QImage>
 #include "QtAV/VideoCapture.h"
 #include "QtAV/VideoDecoder.h"
 #include "QtAV/AVDemuxer.h"
 #include "QtAV/Packet.h"
 #include "utils/BlockingQueue.h"
+#include "utils/ThreadPolicy.h"
+#include "QtAV/private/AVCompat.h"
 #include "utils/Logger.h"
 
 // TODO: event and signal do not work
@@ -97,6 +107,140 @@ private:
     BlockingQueue<QRunnable*> tasks;
 };
 
+// LRU cache of extracted frames shared by all extractors. Thread safe
+class FrameCache
+{
+public:
+    static FrameCache& instance() {
+        static FrameCache cache;
+        return cache;
+    }
+    FrameCache() : max_bytes(32*1024*1024), bytes(0) {}
+    void setMaxBytes(qint64 value) {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        max_bytes = qMax<qint64>(0, value);
+        trim();
+    }
+    qint64 maxBytes() const {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        return max_bytes;
+    }
+    void setDirectory(const QString& value) {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        dir = value;
+        if (!dir.isEmpty())
+            QDir().mkpath(dir);
+    }
+    QString directory() const {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        return dir;
+    }
+    // the frame of position bucket (position/precision) and neighbours, and not farther than precision.
+    VideoFrame find(const QString& source, qint64 pos, int precision, const QSize& size) {
+        const qint64 p = qMax(1, precision);
+        const qint64 b = pos/p;
+        for (qint64 i = b - 1; i <= b + 1; ++i) {
+            const QString k(key(source, i, p, size));
+            VideoFrame f(get(k));
+            if (!f.isValid())
+                f = load(k);
+            if (f.isValid() && qAbs(qint64(f.timestamp()*1000.0) - pos) <= p)
+                return f;
+        }
+        return VideoFrame();
+    }
+    void add(const QString& source, qint64 pos, int precision, const QSize& size, const VideoFrame& frame) {
+        if (!frame.isValid())
+            return;
+        const qint64 p = qMax(1, precision);
+        const QString k(key(source, pos/p, p, size));
+        put(k, frame);
+        save(k, frame);
+    }
+private:
+    static QString key(const QString& source, qint64 bucket, qint64 precision, const QSize& size) {
+        return QStringLiteral("%1|%2|%3|%4x%5").arg(source).arg(bucket).arg(precision).arg(size.width()).arg(size.height());
+    }
+    static qint64 frameBytes(const VideoFrame& f) {
+        qint64 n = 0;
+        for (int i = 0; i < f.planeCount(); ++i)
+            n += qint64(f.bytesPerLine(i))*qint64(f.planeHeight(i));
+        return n;
+    }
+    VideoFrame get(const QString& k) {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        QHash<QString, VideoFrame>::const_iterator it = frames.constFind(k);
+        if (it == frames.constEnd())
+            return VideoFrame();
+        lru.removeOne(k);
+        lru.append(k);
+        return it.value();
+    }
+    void put(const QString& k, const VideoFrame& frame) {
+        if (!frame.hasHostData())
+            return;
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        const qint64 n = frameBytes(frame);
+        if (n > max_bytes)
+            return;
+        if (frames.contains(k)) {
+            bytes -= frameBytes(frames.value(k));
+            lru.removeOne(k);
+        }
+        frames.insert(k, frame);
+        lru.append(k);
+        bytes += n;
+        trim();
+    }
+    void trim() {
+        while (bytes > max_bytes && !lru.isEmpty()) {
+            const QString k(lru.takeFirst());
+            bytes -= frameBytes(frames.take(k));
+        }
+    }
+    QString filePath(const QString& k) const {
+        const QString d(directory());
+        if (d.isEmpty())
+            return QString();
+        return d + QLatin1Char('/') + QString::fromLatin1(QCryptographicHash::hash(k.toUtf8(), QCryptographicHash::Sha1).toHex()) + QStringLiteral(".png");
+    }
+    VideoFrame load(const QString& k) {
+        const QString path(filePath(k));
+        if (path.isEmpty() || !QFile::exists(path))
+            return VideoFrame();
+        QImage img(path);
+        if (img.isNull())
+            return VideoFrame();
+        VideoFrame f(VideoFrame(img).clone()); // VideoFrame(QImage) does not copy
+        f.setTimestamp(img.text(QStringLiteral("timestamp")).toDouble());
+        put(k, f);
+        return f;
+    }
+    void save(const QString& k, const VideoFrame& frame) {
+        const QString path(filePath(k));
+        if (path.isEmpty())
+            return;
+        QImage img(frame.toImage());
+        if (img.isNull())
+            return;
+        img.setText(QStringLiteral("timestamp"), QString::number(frame.timestamp(), 'f', 6));
+        img.save(path, "PNG");
+    }
+
+    mutable QMutex mutex;
+    qint64 max_bytes;
+    qint64 bytes;
+    QString dir;
+    QHash<QString, VideoFrame> frames;
+    QList<QString> lru; // least recently used first
+};
+
 // FIXME: avcodec_close() crash
 const int kDefaultPrecision = 500;
 class VideoFrameExtractorPrivate : public DPtrPrivate<VideoFrameExtractor>
@@ -108,10 +252,15 @@ public:
         , has_video(true)
         , auto_extract(true)
         , auto_precision(true)
+        , key_frame_only(false)
+        , decoder_key_frame_only(false)
         , seek_count(0)
         , position(-2*kDefaultPrecision)
         , precision(kDefaultPrecision)
         , decoder(0)
+        , gop_duration(0)
+        , last_key_pts(-1)
+        , decoded_pts(-1)
     {
         QVariantHash opt;
         opt[QString::fromLatin1("skip_frame")] = 8; // 8 for "avcodec", "NoRef" for "FFmpeg". see AVDiscard
@@ -121,6 +270,10 @@ public:
         opt[QString::fromLatin1("skip_frame")] = 0; // 0 for "avcodec", "Default" for "FFmpeg". see AVDiscard
         opt[QString::fromLatin1("skip_loop_filter")] = 0;
         dec_opt_normal[QString::fromLatin1("avcodec")] = opt; // avcodec need correct string or value in libavcodec
+        opt[QString::fromLatin1("skip_frame")] = 48; // AVDISCARD_NONKEY
+        opt[QString::fromLatin1("skip_loop_filter")] = 48;
+        opt[QString::fromLatin1("skip_idct")] = 48;
+        dec_opt_keyframe[QString::fromLatin1("avcodec")] = opt;
         codecs
 #if QTAV_HAVE(DXVA)
                     // << QStringLiteral("DXVA")
@@ -146,11 +299,16 @@ public:
 
     bool checkAndOpen() {
         const bool loaded = demuxer.fileName() == source && demuxer.isLoaded();
-        if (loaded && decoder && !demuxer.atEnd())
+        if (loaded && decoder && !demuxer.atEnd() && decoder_key_frame_only == key_frame_only)
             return true;
         seek_count = 0;
+        // an open decoder can be used by a new source with the same codec parameters
+        QScopedPointer<VideoDecoder> old_decoder;
         if (decoder) { // new source
-            decoder->close();
+            if (decoder->isOpen() && decoder_key_frame_only == key_frame_only)
+                old_decoder.reset(decoder.take());
+            else
+                decoder->close();
             decoder.reset(0);
         }
         if (!loaded || demuxer.atEnd()) {
@@ -173,6 +331,15 @@ public:
             else
                 precision = kDefaultPrecision;
         }
+        const QByteArray codec_key(codecKey(demuxer.videoCodecContext()));
+        if (old_decoder && codec_key == decoder_codec_key) {
+            qDebug("VideoFrameExtractor reuses decoder");
+            old_decoder->flush();
+            decoder.reset(old_decoder.take());
+            return true;
+        }
+        old_decoder.reset(0);
+        decoder_codec_key = codec_key;
         foreach (const QString& c, codecs) {
             VideoDecoderId cid = VideoDecoderFactory::id(c.toUtf8().constData());
             VideoDecoder *vd = VideoDecoderFactory::create(cid);
@@ -180,6 +347,16 @@ public:
                 continue;
             decoder.reset(vd);
             decoder->setCodecContext(demuxer.videoCodecContext());
+            AVCodecContext *avctx = demuxer.videoCodecContext();
+            AVCodec *codec = avcodec_find_decoder(avctx->codec_id);
+            if (key_frame_only && codec && codec->max_lowres > 0) {
+                // must be set before open. ffmpeg clamps the value to max_lowres
+                QVariantHash opt, lowres;
+                lowres[QString::fromLatin1("lowres")] = 1;
+                opt[QString::fromLatin1("avcodec")] = lowres;
+                decoder->setOptions(opt);
+            }
+            decoder_key_frame_only = key_frame_only;
             if (!decoder->open()) {
                 decoder.reset(0);
                 continue;
@@ -194,6 +371,17 @@ public:
         return !!decoder;
     }
 
+    // parameters a decoder is opened with. sps/pps etc. in extradata must be the same because packets may not repeat them
+    static QByteArray codecKey(AVCodecContext *avctx) {
+        if (!avctx)
+            return QByteArray();
+        const int v[] = { avctx->codec_id, (int)avctx->codec_tag, avctx->profile, avctx->level, avctx->width, avctx->height, avctx->pix_fmt };
+        QByteArray key((const char*)v, sizeof(v));
+        if (avctx->extradata && avctx->extradata_size > 0)
+            key.append((const char*)avctx->extradata, avctx->extradata_size);
+        return key;
+    }
+
     // return the key frame position
     bool extractInPrecision(qint64 value, int range) {
         frame = VideoFrame();
@@ -240,6 +428,27 @@ public:
             return false;
         }
         decoder->flush(); //must flush otherwise old frames will be decoded at the beginning
+        if (key_frame_only) {
+            decoder->setOptions(dec_opt_keyframe);
+            // non-key packets are discarded by decoder. more packets may be required by a decoder with delay
+            for (int i = 0; i < 16 && !frame.isValid(); ++i) {
+                if (i > 0) {
+                    if (demuxer.atEnd() || !demuxer.readFrame())
+                        break;
+                    if (demuxer.stream() != vstream)
+                        continue;
+                    pkt = demuxer.packet();
+                }
+                if (decoder->decode(pkt))
+                    frame = decoder->frame();
+            }
+            if (!frame.isValid()) {
+                qWarning("VideoFrameExtractor failed to decode key frame at %lld", value);
+                return false;
+            }
+            ++seek_count;
+            return true;
+        }
         decoder->setOptions(dec_opt_normal);
         // must decode key frame
         int k = 0;
@@ -320,6 +529,54 @@ public:
         // now we get the final frame
         return true;
     }
+    // decode from current demuxer position until a frame not earlier than value - range. seek to value if seek is true
+    bool decodeForward(qint64 value, int range, bool seek) {
+        const int vstream = demuxer.videoStream();
+        bool need_key = false;
+        if (seek) {
+            demuxer.seek(value);
+            decoder->flush();
+            need_key = true;
+            last_key_pts = -1;
+        }
+        // not accurate if the value is in gop. nonref frames are enough for thumbnails
+        bool drop = true;
+        decoder->setOptions(dec_opt_framedrop);
+        while (!demuxer.atEnd()) {
+            if (!demuxer.readFrame())
+                continue;
+            if (demuxer.stream() != vstream)
+                continue;
+            const Packet pkt = demuxer.packet();
+            if (!pkt.isValid())
+                continue;
+            const qint64 t = qint64(pkt.pts*1000.0);
+            if (pkt.hasKeyFrame) {
+                if (last_key_pts >= 0 && t > last_key_pts)
+                    gop_duration = qMax(gop_duration, t - last_key_pts);
+                last_key_pts = t;
+                need_key = false;
+            }
+            if (need_key)
+                continue;
+            // decode every frame near the value
+            if (drop && t >= value - range - gop_duration/4) {
+                drop = false;
+                decoder->setOptions(dec_opt_normal);
+            }
+            if (!decoder->decode(pkt))
+                continue;
+            const VideoFrame f = decoder->frame();
+            if (!f.isValid())
+                continue;
+            frame = f;
+            decoded_pts = qint64(f.timestamp()*1000.0);
+            if (decoded_pts >= value - range)
+                return true;
+        }
+        return frame.isValid();
+    }
+
     void releaseResourceInternal() {
         decoder.reset(0);
         demuxer.unload();
@@ -343,6 +600,10 @@ public:
     bool loading;
     bool auto_extract;
     bool auto_precision;
+    bool key_frame_only;
+    bool decoder_key_frame_only; // decoder is opened in key frame only mode (lowres)
+    QByteArray decoder_codec_key;
+    QSize frame_size;
     int seek_count;
     qint64 position;
     int precision;
@@ -352,11 +613,34 @@ public:
     VideoFrame frame;
     QStringList codecs;
     ExtractThread thread;
-    static QVariantHash dec_opt_framedrop, dec_opt_normal;
+    qint64 gop_duration; // max key frame interval read in batch mode
+    qint64 last_key_pts;
+    qint64 decoded_pts; // pts of frame in batch mode
+    static QVariantHash dec_opt_framedrop, dec_opt_normal, dec_opt_keyframe;
 };
 
+static bool lessThanPosition(const QPair<qint64, int>& a, const QPair<qint64, int>& b)
+{
+    return a.first < b.first;
+}
+
+// scale while converting to RGB32. keep aspect ratio if width or height <= 0. invalid size: no conversion
+static VideoFrame scaledFrame(const VideoFrame& frame, const QSize& size)
+{
+    if (!frame.isValid() || (!size.isValid() && size.width() <= 0 && size.height() <= 0))
+        return frame;
+    QSize s(size);
+    const qreal dar = frame.displayAspectRatio() > 0 ? frame.displayAspectRatio() : qreal(frame.width())/qreal(qMax(1, frame.height()));
+    if (s.width() <= 0)
+        s.setWidth(qRound(qreal(s.height())*dar));
+    else if (s.height() <= 0)
+        s.setHeight(qRound(qreal(s.width())/dar));
+    return frame.to(VideoFormat::Format_RGB32, s);
+}
+
 QVariantHash VideoFrameExtractorPrivate::dec_opt_framedrop;
 QVariantHash VideoFrameExtractorPrivate::dec_opt_normal;
+QVariantHash VideoFrameExtractorPrivate::dec_opt_keyframe;
 
 VideoFrameExtractor::VideoFrameExtractor(QObject *parent) :
     QObject(parent)
@@ -452,6 +736,21 @@ int VideoFrameExtractor::precision() const
     return d_func().precision;
 }
 
+void VideoFrameExtractor::setKeyFrameOnly(bool value)
+{
+    DPTR_D(VideoFrameExtractor);
+    if (d.key_frame_only == value)
+        return;
+    d.key_frame_only = value; // decoder is reopened in next extraction
+    d.frame = VideoFrame();
+    emit keyFrameOnlyChanged();
+}
+
+bool VideoFrameExtractor::keyFrameOnly() const
+{
+    return d_func().key_frame_only;
+}
+
 bool VideoFrameExtractor::event(QEvent *e)
 {
     //qDebug("event: %d", e->type());
@@ -496,9 +795,95 @@ void VideoFrameExtractor::extract()
 #endif //ASYNC_EVENT
 }
 
+void VideoFrameExtractor::extractBatch(const QList<qint64> &positions, const QSize &size)
+{
+    DPTR_D(VideoFrameExtractor);
+    if (!d.has_video || positions.isEmpty())
+        return;
+    if (!d.async) {
+        extractBatchInternal(positions, size);
+        return;
+    }
+    class ExtractBatchTask : public QRunnable {
+    public:
+        ExtractBatchTask(VideoFrameExtractor *e, const QList<qint64>& t, const QSize& s)
+            : extractor(e)
+            , positions(t)
+            , size(s)
+        {}
+        void run() {
+            extractor->extractBatchInternal(positions, size);
+        }
+    private:
+        VideoFrameExtractor *extractor;
+        QList<qint64> positions;
+        QSize size;
+    };
+    d.thread.addTask(new ExtractBatchTask(this, positions, size));
+}
+
+void VideoFrameExtractor::extractBatchInternal(const QList<qint64> &positions, const QSize &size)
+{
+    DPTR_D(VideoFrameExtractor);
+    int precision_old = precision();
+    if (!d.checkAndOpen()) {
+        emit error();
+        return;
+    }
+    if (precision_old != precision()) {
+        emit precisionChanged();
+    }
+    QList<QPair<qint64, int> > sorted;
+    sorted.reserve(positions.size());
+    for (int i = 0; i < positions.size(); ++i) {
+        qint64 value = positions.at(i);
+        if (value < d.demuxer.startTime())
+            value += d.demuxer.startTime();
+        sorted.append(qMakePair(value, i));
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), lessThanPosition);
+    const int range = precision();
+    d.frame = VideoFrame();
+    d.decoded_pts = -1;
+    d.gop_duration = 0;
+    d.last_key_pts = -1;
+    VideoFrame scaled;
+    qint64 scaled_pts = -1;
+    for (int i = 0; i < sorted.size(); ++i) {
+        const qint64 value = sorted.at(i).first;
+        // the current frame can be used for close positions
+        if (!d.frame.isValid() || d.decoded_pts < value - range) {
+            // seek only if value is not in current gop. gop is unknown before 2 key frames are read
+            const bool seek = !d.frame.isValid() || d.demuxer.atEnd() || value - d.decoded_pts > qMax<qint64>(d.gop_duration, range);
+            if (d.demuxer.atEnd() && !d.checkAndOpen()) {
+                emit error();
+                return;
+            }
+            if (!d.decodeForward(value, range, seek)) {
+                qWarning("VideoFrameExtractor failed to extract frame at %lld", value);
+                emit error();
+                continue;
+            }
+        }
+        if (scaled_pts != d.decoded_pts) {
+            scaled = scaledFrame(d.frame, size);
+            scaled_pts = d.decoded_pts;
+        }
+        emit batchFrameExtracted(sorted.at(i).second, positions.at(sorted.at(i).second), scaled);
+    }
+    d.extracted = d.frame.isValid();
+    emit batchFinished();
+}
+
 void VideoFrameExtractor::extractInternal(qint64 pos)
 {
     DPTR_D(VideoFrameExtractor);
+    const VideoFrame cached(FrameCache::instance().find(d.source, pos, precision(), d.frame_size));
+    if (cached.isValid()) {
+        d.extracted = true;
+        emit frameExtracted(cached);
+        return;
+    }
     int precision_old = precision();
     if (!d.checkAndOpen()) {
         emit error();
@@ -513,7 +898,340 @@ void VideoFrameExtractor::extractInternal(qint64 pos)
         emit error();
         return;
     }
-    emit frameExtracted(d.frame);
+    const VideoFrame frame(scaledFrame(d.frame, d.frame_size));
+    if (FrameCache::instance().maxBytes() > 0)
+        FrameCache::instance().add(d.source, pos, precision(), d.frame_size, frame);
+    emit frameExtracted(frame);
+}
+
+void VideoFrameExtractor::setFrameSize(const QSize &value)
+{
+    d_func().frame_size = value;
+}
+
+QSize VideoFrameExtractor::frameSize() const
+{
+    return d_func().frame_size;
+}
+
+void VideoFrameExtractor::setCacheSize(qint64 bytes)
+{
+    FrameCache::instance().setMaxBytes(bytes);
+}
+
+qint64 VideoFrameExtractor::cacheSize()
+{
+    return FrameCache::instance().maxBytes();
+}
+
+void VideoFrameExtractor::setDiskCacheDirectory(const QString &dir)
+{
+    FrameCache::instance().setDirectory(dir);
+}
+
+QString VideoFrameExtractor::diskCacheDirectory()
+{
+    return FrameCache::instance().directory();
+}
+
+struct ExtractRequest {
+    int id;
+    int priority;
+    qint64 position;
+    QString file;
+};
+
+class ExtractWorker;
+class VideoFrameExtractorPoolPrivate : public DPtrPrivate<VideoFrameExtractorPool>
+{
+public:
+    VideoFrameExtractorPoolPrivate()
+        : worker_count(qMax(1, QThread::idealThreadCount()/2))
+        , precision(kDefaultPrecision)
+        , key_frame_only(false)
+        , last_id(0)
+        , stop(false)
+        , thread_policy(QThread::LowPriority)
+    {}
+    // the highest priority request. the one of current file is preferred. return false if the worker must quit
+    bool take(int worker, const QString& file, ExtractRequest* r);
+    void startWorkers(VideoFrameExtractorPool* pool);
+    void stopWorkers();
+
+    int worker_count;
+    int precision;
+    bool key_frame_only;
+    QSize frame_size;
+    int last_id;
+    bool stop;
+    ThreadPolicy thread_policy;
+    QList<ExtractRequest> requests; // in request order
+    QList<ExtractWorker*> workers;
+    mutable QMutex mutex;
+    QWaitCondition cond;
+};
+
+class ExtractWorker : public QThread
+{
+public:
+    ExtractWorker(VideoFrameExtractorPool* pool, VideoFrameExtractorPoolPrivate* d, int index)
+        : m_pool(pool), m_d(d), m_index(index)
+    {}
+protected:
+    virtual void run() {
+        // no thread is started by extractor private
+        VideoFrameExtractorPrivate e;
+        ExtractRequest r;
+        ThreadPolicy policy;
+        {
+            QMutexLocker lock(&m_d->mutex);
+            Q_UNUSED(lock);
+            policy = m_d->thread_policy;
+        }
+        policy.apply();
+        while (m_d->take(m_index, e.source, &r)) {
+            QSize size;
+            {
+                QMutexLocker lock(&m_d->mutex);
+                Q_UNUSED(lock);
+                e.key_frame_only = m_d->key_frame_only;
+                e.auto_precision = m_d->precision < 0;
+                if (m_d->precision >= 0)
+                    e.precision = m_d->precision;
+                size = m_d->frame_size;
+            }
+            e.source = r.file;
+            if (!e.checkAndOpen() || !e.extractInPrecision(r.position, e.precision)) {
+                Q_EMIT m_pool->error(r.id, r.file, r.position);
+                continue;
+            }
+            Q_EMIT m_pool->frameExtracted(r.id, r.file, r.position, scaledFrame(e.frame, size));
+        }
+        e.releaseResourceInternal();
+    }
+private:
+    VideoFrameExtractorPool *m_pool;
+    VideoFrameExtractorPoolPrivate *m_d;
+    int m_index;
+};
+
+bool VideoFrameExtractorPoolPrivate::take(int worker, const QString &file, ExtractRequest *r)
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    while (!stop && worker < worker_count && requests.isEmpty())
+        cond.wait(&mutex);
+    if (stop || worker >= worker_count)
+        return false;
+    int best = 0;
+    for (int i = 1; i < requests.size(); ++i) {
+        const ExtractRequest& a = requests.at(i);
+        const ExtractRequest& b = requests.at(best);
+        if (a.priority > b.priority || (a.priority == b.priority && a.file == file && b.file != file))
+            best = i;
+    }
+    *r = requests.takeAt(best);
+    return true;
+}
+
+void VideoFrameExtractorPoolPrivate::startWorkers(VideoFrameExtractorPool *pool)
+{
+    // quit workers of index >= worker_count
+    cond.wakeAll();
+    for (int i = workers.size() - 1; i >= worker_count; --i) {
+        ExtractWorker *w = workers.takeLast();
+        w->wait();
+        delete w;
+    }
+    while (workers.size() < worker_count) {
+        ExtractWorker *w = new ExtractWorker(pool, this, workers.size());
+        workers.append(w);
+        w->start(QThread::LowPriority);
+    }
+}
+
+void VideoFrameExtractorPoolPrivate::stopWorkers()
+{
+    {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        stop = true;
+        requests.clear();
+    }
+    cond.wakeAll();
+    foreach (ExtractWorker *w, workers) {
+        w->wait();
+        delete w;
+    }
+    workers.clear();
+}
+
+VideoFrameExtractorPool::VideoFrameExtractorPool(QObject *parent)
+    : QObject(parent)
+{
+    DPTR_D(VideoFrameExtractorPool);
+    d.startWorkers(this);
+}
+
+VideoFrameExtractorPool::~VideoFrameExtractorPool()
+{
+    d_func().stopWorkers();
+}
+
+void VideoFrameExtractorPool::setWorkerCount(int value)
+{
+    DPTR_D(VideoFrameExtractorPool);
+    value = qMax(1, value);
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        if (d.worker_count == value)
+            return;
+        d.worker_count = value;
+    }
+    d.startWorkers(this);
+}
+
+int VideoFrameExtractorPool::workerCount() const
+{
+    DPTR_D(const VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.worker_count;
+}
+
+void VideoFrameExtractorPool::setPrecision(int value)
+{
+    DPTR_D(VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.precision = value;
+}
+
+int VideoFrameExtractorPool::precision() const
+{
+    DPTR_D(const VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.precision;
+}
+
+void VideoFrameExtractorPool::setKeyFrameOnly(bool value)
+{
+    DPTR_D(VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.key_frame_only = value;
+}
+
+bool VideoFrameExtractorPool::keyFrameOnly() const
+{
+    DPTR_D(const VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.key_frame_only;
+}
+
+void VideoFrameExtractorPool::setFrameSize(const QSize &value)
+{
+    DPTR_D(VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.frame_size = value;
+}
+
+QSize VideoFrameExtractorPool::frameSize() const
+{
+    DPTR_D(const VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.frame_size;
+}
+
+void VideoFrameExtractorPool::setThreadPolicy(QThread::Priority priority, quint64 cpuMask)
+{
+    DPTR_D(VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.thread_policy.priority = priority;
+    d.thread_policy.affinity = cpuMask;
+}
+
+QThread::Priority VideoFrameExtractorPool::threadPriority() const
+{
+    DPTR_D(const VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.thread_policy.priority;
+}
+
+quint64 VideoFrameExtractorPool::threadAffinity() const
+{
+    DPTR_D(const VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.thread_policy.affinity;
+}
+
+int VideoFrameExtractorPool::request(const QString &file, qint64 position, int priority)
+{
+    DPTR_D(VideoFrameExtractorPool);
+    ExtractRequest r;
+    r.position = position;
+    r.priority = priority;
+    r.file = file;
+    {
+        QMutexLocker lock(&d.mutex);
+        Q_UNUSED(lock);
+        r.id = ++d.last_id;
+        d.requests.append(r);
+    }
+    d.cond.wakeOne();
+    return r.id;
+}
+
+bool VideoFrameExtractorPool::setPriority(int id, int priority)
+{
+    DPTR_D(VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    for (int i = 0; i < d.requests.size(); ++i) {
+        if (d.requests.at(i).id == id) {
+            d.requests[i].priority = priority;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VideoFrameExtractorPool::cancel(int id)
+{
+    DPTR_D(VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    for (int i = 0; i < d.requests.size(); ++i) {
+        if (d.requests.at(i).id == id) {
+            d.requests.removeAt(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void VideoFrameExtractorPool::cancelAll()
+{
+    DPTR_D(VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.requests.clear();
+}
+
+int VideoFrameExtractorPool::pendingCount() const
+{
+    DPTR_D(const VideoFrameExtractorPool);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.requests.size();
 }
 
 } //namespace QtAV
@@ -22,10 +22,13 @@
 #include "QtAV/VideoShader.h"
 #include "QtAV/private/VideoShader_p.h"
 #include "QtAV/ColorTransform.h"
+#include "QtAV/TraceRecorder.h"
+#include "ShaderManager.h"
 #include "utils/OpenGLHelper.h"
 #include <cmath>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QFile>
+#include <QtCore/QMutex>
 #include "utils/Logger.h"
 
 #define YUVA_DONE 0
@@ -222,6 +225,10 @@ const char* VideoShader::fragmentShader() const
     if (d.video_format.isPlanar()) {
         if (d.video_format.bytesPerPixel(0) == 1) {
             frag.prepend("#define CHANNEL_8BIT\n");
+        } else if (OpenGLHelper::is16BitTexture(d.video_format)) {
+            frag.prepend("#define CHANNEL16_TO8\n");
+            if (d.video_format.planeCount() == 2)
+                frag.prepend("#define IS_BIPLANAR\n");
         }
 #if YUVA_DONE
         if (has_alpha)
@@ -239,6 +246,31 @@ const char* VideoShader::fragmentShader() const
     }
     if (textureTarget() == GL_TEXTURE_RECTANGLE)
         frag.prepend("#define MULTI_COORD\n");
+    if (d.deinterlace != NoDeinterlace) {
+        if (d.deinterlace == DeinterlaceBlend)
+            frag.prepend("#define DEINTERLACE_BLEND\n");
+        else if (d.deinterlace == DeinterlaceMotionAdaptive)
+            frag.prepend("#define DEINTERLACE_ADAPTIVE\n");
+        frag.prepend("#define DEINTERLACE\n");
+    }
+    if (d.color_managed && d.video_format.isPlanar()) {
+        if (d.in_trc == ColorTransfer_PQ)
+            frag.prepend("#define HDR_INPUT_PQ\n");
+        else if (d.in_trc == ColorTransfer_HLG)
+            frag.prepend("#define HDR_INPUT_HLG\n");
+        if (d.out_trc == ColorTransfer_PQ)
+            frag.prepend("#define HDR_OUTPUT_PQ\n");
+        if (d.tone_mapping == ToneMappingBT2390)
+            frag.prepend("#define TONEMAP_BT2390\n");
+        else if (d.tone_mapping == ToneMappingHable)
+            frag.prepend("#define TONEMAP_HABLE\n");
+        frag.prepend("#define COLOR_MANAGED\n");
+    }
+    if (d.lut) {
+        if (d.texture_target == GL_TEXTURE_RECTANGLE)
+            frag.prepend("#define LUT_TEXEL_COORD\n");
+        frag.prepend("#define COLOR_LUT\n");
+    }
     return frag.constData();
 }
 
@@ -261,6 +293,14 @@ void VideoShader::initialize(QOpenGLShaderProgram *shaderProgram)
     d.u_to8 = shaderProgram->uniformLocation("u_to8");
     d.u_opacity = shaderProgram->uniformLocation("u_opacity");
     d.u_c = shaderProgram->uniformLocation("u_c");
+    d.u_deint = shaderProgram->uniformLocation("u_deint");
+    d.u_deintLines = shaderProgram->uniformLocation("u_deintLines");
+    d.u_hdr = shaderProgram->uniformLocation("u_hdr");
+    d.u_gamut = shaderProgram->uniformLocation("u_gamut");
+    d.u_lut = shaderProgram->uniformLocation("u_lut");
+    d.u_lutSize = shaderProgram->uniformLocation("u_lutSize");
+    d.u_lutScale = shaderProgram->uniformLocation("u_lutScale");
+    d.u_lutOffset = shaderProgram->uniformLocation("u_lutOffset");
     d.u_Texture.resize(textureLocationCount());
     for (int i = 0; i < d.u_Texture.size(); ++i) {
         const QString tex_var = QStringLiteral("u_Texture%1").arg(i);
@@ -274,6 +314,12 @@ void VideoShader::initialize(QOpenGLShaderProgram *shaderProgram)
         qDebug("glGetUniformLocation(\"u_c\") = %d", d.u_c);
     if (d.u_to8 >= 0)
         qDebug("glGetUniformLocation(\"u_to8\") = %d", d.u_to8);
+    if (d.u_deint >= 0)
+        qDebug("glGetUniformLocation(\"u_deint\") = %d", d.u_deint);
+    if (d.u_hdr >= 0)
+        qDebug("glGetUniformLocation(\"u_hdr\") = %d", d.u_hdr);
+    if (d.u_lut >= 0)
+        qDebug("glGetUniformLocation(\"u_lut\") = %d", d.u_lut);
 }
 
 int VideoShader::textureLocationCount() const
@@ -332,6 +378,20 @@ void VideoShader::setVideoFormat(const VideoFormat &format)
     d_func().video_format = format;
 }
 
+void VideoShader::setDeinterlaceMode(DeinterlaceMode value)
+{
+    d_func().deinterlace = value;
+}
+
+void VideoShader::setColorManagement(bool enabled, ColorTransfer in, ColorTransfer out, ToneMapping toneMapping)
+{
+    DPTR_D(VideoShader);
+    d.color_managed = enabled;
+    d.in_trc = in;
+    d.out_trc = out;
+    d.tone_mapping = toneMapping;
+}
+
 QOpenGLShaderProgram* VideoShader::program()
 {
     DPTR_D(VideoShader);
@@ -372,6 +432,34 @@ bool VideoShader::update(VideoMaterial *material)
         program()->setUniformValue(d_func().u_to8, material->vectorTo8bit());
     if (channelMapLocation() >= 0)
         program()->setUniformValue(channelMapLocation(), material->channelMap());
+    DPTR_D(VideoShader);
+    const VideoMaterialPrivate &md = material->d_func();
+    if (d.u_hdr >= 0) {
+        // luminance in shader is in 10000 nits, the range of PQ
+        program()->setUniformValue(d.u_hdr, QVector4D(md.sourcePeak(), md.outputPeak(), md.sdrWhite(), 0)/10000.0f);
+        const ColorPrimaries out = md.out_trc == ColorTransfer_PQ ? ColorPrimaries_BT2020 : ColorPrimaries_BT709;
+        program()->setUniformValue(d.u_gamut, ColorTransform::gamutMatrix(md.in_primaries, out));
+    }
+    if (d.u_lut >= 0) {
+        program()->setUniformValue(d.u_lut, (GLint)VideoMaterialPrivate::kLUTUnit);
+        program()->setUniformValue(d.u_lutSize, (GLfloat)md.lut.size());
+        const QVector3D range(md.lut.domainMax() - md.lut.domainMin());
+        const QVector3D scale(range.x() > 0 ? 1.0/range.x() : 1.0, range.y() > 0 ? 1.0/range.y() : 1.0, range.z() > 0 ? 1.0/range.z() : 1.0);
+        program()->setUniformValue(d.u_lutScale, scale);
+        program()->setUniformValue(d.u_lutOffset, -md.lut.domainMin()*scale);
+    }
+    if (d.u_deint >= 0) {
+        // a comb is a line differs from the interpolated one by 10/255 more than the vertical gradient
+        static const float kCombThreshold = 10.0f/255.0f;
+        program()->setUniformValue(d.u_deint, QVector2D(md.field_parity, kCombThreshold));
+        GLfloat lines[4];
+        for (int i = 0; i < 4; ++i) {
+            // u_Texture1 and u_Texture2 are the same plane for biplanar formats
+            const int p = qMin(i, nb_planes - 1);
+            lines[i] = md.target == GL_TEXTURE_RECTANGLE || p >= md.texture_size.size() ? 1.0f : (GLfloat)md.texture_size[p].height();
+        }
+        program()->setUniformValue(d.u_deintLines, QVector4D(lines[0], lines[1], lines[2], lines[3]));
+    }
     //program()->setUniformValue(matrixLocation(), material->matrix()); //what about sgnode? state.combindMatrix()?
     // uniform end. attribute begins
     return true;
@@ -395,18 +483,28 @@ QByteArray VideoShader::shaderSourceFromFile(const QString &fileName) const
 void VideoShader::compile(QOpenGLShaderProgram *shaderProgram)
 {
     Q_ASSERT_X(!shaderProgram->isLinked(), "VideoShader::compile()", "Compile called multiple times!");
-    shaderProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader());
-    shaderProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader());
+    const QByteArray fs(fragmentShader());
+    const QByteArray vs(vertexShader());
+    char const *const *attr = attributeNames();
+    // attribute locations are stored in the binary too
+    QByteArray vs_key(vs);
+    for (int i = 0; attr[i]; ++i)
+        vs_key.append(attr[i]).append(';');
+    if (OpenGLHelper::loadProgramBinary(shaderProgram, vs_key, fs)) {
+        qDebug("program is loaded from binary cache");
+        return;
+    }
+    shaderProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, vs);
+    shaderProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, fs);
     int maxVertexAttribs = 0;
     DYGL(glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxVertexAttribs));
-    char const *const *attr = attributeNames();
     for (int i = 0; attr[i]; ++i) {
         if (i >= maxVertexAttribs) {
             qFatal("List of attribute names is either too long or not null-terminated.\n"
                    "Maximum number of attributes on this hardware is %i.\n"
                    "Vertex shader:\n%s\n"
                    "Fragment shader:\n%s\n",
-                   maxVertexAttribs, vertexShader(), fragmentShader());
+                   maxVertexAttribs, vs.constData(), fs.constData());
         }
         // why must min location == 0?
         if (*attr[i]) {
@@ -415,12 +513,91 @@ void VideoShader::compile(QOpenGLShaderProgram *shaderProgram)
         }
     }
 
+    OpenGLHelper::setProgramBinaryRetrievable(shaderProgram);
     if (!shaderProgram->link()) {
         qWarning("QSGMaterialShader: Shader compilation failed:");
         qWarning() << shaderProgram->log();
+        return;
     }
+    OpenGLHelper::saveProgramBinary(shaderProgram, vs_key, fs);
 }
 
+/*
+ * Textures of host memory frames uploaded by materials, so a material of another context in the same share group can bind
+ * them instead of uploading the same frame again. 1 entry per material, replaced by its next upload.
+ */
+class SharedTextures
+{
+public:
+    static SharedTextures& instance() {
+        static SharedTextures sTextures;
+        return sTextures;
+    }
+    static const void* currentGroup() {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+        static const bool enabled = qgetenv("QTAV_GL_SHARE_TEXTURES") != "0";
+        const QOpenGLContext *ctx = QOpenGLContext::currentContext();
+        return enabled && ctx ? ctx->shareGroup() : 0;
+#else
+        return 0;
+#endif
+    }
+    void publish(const VideoMaterialPrivate *owner, const void* group, const uchar* data, qreal pts, const QVector<TextureKey>& layout, const QVector<GLuint>& textures) {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        Entry *e = 0;
+        for (int i = 0; i < m_entries.size(); ++i) {
+            if (m_entries.at(i).owner == owner) {
+                e = &m_entries[i];
+                break;
+            }
+        }
+        if (!e) {
+            m_entries.append(Entry());
+            e = &m_entries.last();
+            e->owner = owner;
+        }
+        e->group = group;
+        e->data = data;
+        e->pts = pts;
+        e->layout = layout;
+        e->textures = textures;
+    }
+    void withdraw(const VideoMaterialPrivate *owner) {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        for (int i = 0; i < m_entries.size(); ++i) {
+            if (m_entries.at(i).owner == owner) {
+                m_entries.removeAt(i);
+                return;
+            }
+        }
+    }
+    // textures of the same frame in the same layout uploaded by another material
+    bool find(const VideoMaterialPrivate *user, const void* group, const uchar* data, qreal pts, const QVector<TextureKey>& layout, QVector<GLuint> *textures) {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        foreach (const Entry& e, m_entries) {
+            if (e.owner != user && e.group == group && e.data == data && e.pts == pts && e.layout == layout) {
+                *textures = e.textures;
+                return true;
+            }
+        }
+        return false;
+    }
+private:
+    struct Entry {
+        const VideoMaterialPrivate *owner;
+        const void* group;
+        const uchar* data;
+        qreal pts;
+        QVector<TextureKey> layout;
+        QVector<GLuint> textures;
+    };
+    QMutex m_mutex;
+    QList<Entry> m_entries;
+};
+
 VideoMaterial::VideoMaterial()
 {
 }
@@ -432,6 +609,13 @@ void VideoMaterial::setCurrentFrame(const VideoFrame &frame)
     // TODO: move to another function before rendering?
     d.width = frame.width();
     d.height = frame.height();
+    // type() changes, so a shader of the deinterlace variant is used
+    d.deinterlace = frame.isInterlaced() ? d.deinterlace_mode : NoDeinterlace;
+    // top field is the even lines. the first field in time is the top one if top field first
+    d.field_parity = (frame.field() == 0) == frame.isTopFieldFirst() ? 0 : 1;
+    d.in_trc = frame.colorTransfer();
+    d.in_primaries = frame.colorPrimaries();
+    d.hdr = frame.hdrMetadata();
     GLenum new_target = GL_TEXTURE_2D; // not d.target. because metadata "target" is not always set
     QByteArray t = frame.metaData(QStringLiteral("target")).toByteArray().toLower();
     if (t == QByteArrayLiteral("rect"))
@@ -445,7 +629,7 @@ void VideoMaterial::setCurrentFrame(const VideoFrame &frame)
     const VideoFormat fmt(frame.format());
     const int bpp_old = d.bpp;
     d.bpp = fmt.bitsPerPixel(0);
-    if (d.bpp > 8 && d.bpp != bpp_old) {
+    if (d.bpp > 8 && (d.bpp != bpp_old || fmt != d.video_format)) {
         const int range = (1 << d.bpp) - 1;
         // FFmpeg supports 9, 10, 12, 14, 16 bits
         // 10p in little endian: yyyyyyyy yy000000 => (L, L, L, A)  //(yyyyyyyy, 000000yy)?
@@ -453,6 +637,10 @@ void VideoMaterial::setCurrentFrame(const VideoFrame &frame)
             d.vec_to8 = QVector2D(256.0, 1.0)*255.0/(float)range;
         else
             d.vec_to8 = QVector2D(1.0, 256.0)*255.0/(float)range;
+        // GL_R16/GL_RG16 sample is x/65535. P010 data is in the high bits
+        const int shift = fmt.bytesPerPixel(0)*8 - d.bpp;
+        const bool msb = fmt.pixelFormat() == VideoFormat::Format_P010LE || fmt.pixelFormat() == VideoFormat::Format_P010BE;
+        d.vec_to16 = QVector2D(65535.0/(float)(range << (msb ? shift : 0)), 0);
     }
     // http://forum.doom9.org/archive/index.php/t-160211.html
     ColorSpace cs = frame.colorSpace();// ColorSpace_RGB;
@@ -462,6 +650,8 @@ void VideoMaterial::setCurrentFrame(const VideoFrame &frame)
                 cs = ColorSpace_GBR;
             else
                 cs = ColorSpace_RGB;
+        } else if (frame.colorPrimaries() == ColorPrimaries_BT2020 || frame.colorTransfer() != ColorTransfer_SDR) {
+            cs = ColorSpace_BT2020;
         } else {
             if (frame.width() >= 1280 || frame.height() > 576) //values from mpv
                 cs = ColorSpace_BT709;
@@ -470,7 +660,29 @@ void VideoMaterial::setCurrentFrame(const VideoFrame &frame)
         }
     }
     d.colorTransform.setInputColorSpace(cs);
+    QMutexLocker lock(&d.staging_mutex);
+    Q_UNUSED(lock);
     d.frame = frame;
+    d.shared_textures.clear();
+    // copies of a VideoFrame share the data. pbos are per material, so frames are not shared if they are used
+    d.frame_data = !d.try_pbo && frame.hasHostData() ? frame.constBits(0) : 0;
+    d.frame_pts = frame.timestamp();
+    // copy to the pbos mapped by the rendering thread, in the current (producer's) thread
+    d.staged = false;
+    if (d.try_pbo && d.staging[0] && fmt == d.video_format && frame.hasHostData()) {
+        bool match = true;
+        for (int i = 0; i < frame.planeCount(); ++i) {
+            if (!d.staging[i] || d.staging_size[i] != frame.bytesPerLine(i)*frame.planeHeight(i)) {
+                match = false;
+                break;
+            }
+        }
+        if (match) {
+            for (int i = 0; i < frame.planeCount(); ++i)
+                memcpy(d.staging[i], frame.constBits(i), d.staging_size[i]);
+            d.staged = true;
+        }
+    }
     if (fmt != d.video_format) {
         qDebug() << fmt;
         qDebug("pixel format changed: %s => %s %d", qPrintable(d.video_format.name()), qPrintable(fmt.name()), fmt.pixelFormat());
@@ -490,17 +702,25 @@ VideoShader* VideoMaterial::createShader() const
     VideoShader *shader = new VideoShader();
     shader->setVideoFormat(d.video_format);
     shader->setTextureTarget(d.target);
+    shader->setDeinterlaceMode(d.deinterlace);
+    shader->setColorManagement(d.isColorManaged(), d.in_trc, d.out_trc, d.tone_mapping);
+    shader->d_func().lut = d.lut.isValid();
     //resize texture locations to avoid access format later
     return shader;
 }
 
 QString VideoMaterial::typeName(qint64 value)
 {
-    return QString("gl material 8bit channel: %1, planar: %2, has alpha: %3, 2d texture: %4")
+    return QString("gl material 8bit channel: %1, planar: %2, has alpha: %3, 2d texture: %4, 16bit texture: %5, biplanar: %6, deinterlace: %7, color managed: %8, lut: %9")
             .arg(!!(value&1))
             .arg(!!(value&(1<<1)))
             .arg(!!(value&(1<<2)))
             .arg(!!(value&(1<<3)))
+            .arg(!!(value&(1<<4)))
+            .arg(!!(value&(1<<5)))
+            .arg((value>>6)&3)
+            .arg((value>>8)&0x3f)
+            .arg(!!(value&(1<<14)))
             ;
 }
 
@@ -509,13 +729,21 @@ qint64 VideoMaterial::type() const
     DPTR_D(const VideoMaterial);
     const VideoFormat &fmt = d.video_format;
     const bool tex_2d = d.target == GL_TEXTURE_2D;
-    // 2d,alpha,planar,8bit
-    return (tex_2d<<3)|(fmt.hasAlpha()<<2)|(fmt.isPlanar()<<1)|(fmt.bytesPerPixel(0) == 1);
+    const bool tex16 = OpenGLHelper::is16BitTexture(fmt);
+    const bool biplanar = tex16 && fmt.planeCount() == 2;
+    // tone mapping(2 bits),output pq,input transfer(2 bits),color managed
+    qint64 cm = 0;
+    if (d.isColorManaged())
+        cm = (d.tone_mapping<<4)|((d.out_trc == ColorTransfer_PQ)<<3)|(d.in_trc<<1)|1;
+    // lut,color management(6 bits),deinterlace(2 bits),biplanar,16bit,2d,alpha,planar,8bit
+    return (qint64(d.lut.isValid())<<14)|(cm<<8)|(qint64(d.deinterlace)<<6)|(biplanar<<5)|(tex16<<4)|(tex_2d<<3)|(fmt.hasAlpha()<<2)|(fmt.isPlanar()<<1)|(fmt.bytesPerPixel(0) == 1);
 }
 
 bool VideoMaterial::bind()
 {
     DPTR_D(VideoMaterial);
+    QMutexLocker lock(&d.staging_mutex);
+    Q_UNUSED(lock);
     if (!d.ensureResources())
         return false;
     const int nb_planes = d.textures.size(); //number of texture id
@@ -523,11 +751,29 @@ bool VideoMaterial::bind()
         return false;
     if (nb_planes > 4) //why?
         return false;
+    TraceRecorder::Span span(d.update_texure ? "upload" : "bind", "render");
     d.ensureTextures();
+    if (d.lut.isValid())
+        d.bindLUT();
+    if ((d.update_texure || !d.shared_textures.isEmpty()) && d.frame_data) {
+        if (d.bindSharedTextures()) {
+            d.update_texure = false; // frame is kept
+            return true;
+        }
+        if (!d.shared_textures.isEmpty()) { // the other material uploaded a new frame or released the textures
+            d.shared_textures.clear();
+            d.update_texure = true;
+        }
+    }
+    d.pbo_used = false;
     for (int i = 0; i < nb_planes; ++i) {
         const int p = (i + 1) % nb_planes; //0 must active at last?
         bindPlane(p, d.update_texure); // why? i: quick items display wrong textures
     }
+    if (d.pbo_used)
+        d.nextPBO();
+    if (d.update_texure && d.frame_data)
+        d.publishTextures();
 #if 0 //move to unbind should be fine
     if (d.update_texure) {
         d.update_texure = false;
@@ -560,20 +806,37 @@ void VideoMaterial::bindPlane(int p, bool updateTexture)
     // FIXME: why happens on win?
     if (d.frame.bytesPerLine(p) <= 0)
         return;
-    if (d.try_pbo) {
+    const GLvoid *pixels = d.frame.constBits(p);
+    if (d.try_pbo && d.persistent) {
+        // coherent mapping. written in setCurrentFrame() or here, no unmap or flush
+        if (!d.staged)
+            memcpy(d.staging[p], d.frame.constBits(p), qMin(d.staging_size[p], d.frame.bytesPerLine(p)*d.frame.planeHeight(p)));
+        OpenGLHelper::bindBuffer(GL_PIXEL_UNPACK_BUFFER, d.pbo_storage[d.pbo_slot]);
+        pixels = reinterpret_cast<const GLvoid*>(qptrdiff(d.pbo_offset[p]));
+        d.pbo_used = true;
+    } else if (d.try_pbo) {
         //qDebug("bind PBO %d", p);
-        QOpenGLBuffer &pb = d.pbo[p];
+        QOpenGLBuffer &pb = d.currentPBO(p);
         pb.bind();
-        // glMapBuffer() causes sync issue.
-        // Call glBufferData() with NULL pointer before glMapBuffer(), the previous data in PBO will be discarded and
-        // glMapBuffer() returns a new allocated pointer or an unused block immediately even if GPU is still working with the previous data.
-        // https://www.opengl.org/wiki/Buffer_Object_Streaming#Buffer_re-specification
-        pb.allocate(pb.size());
-        GLubyte* ptr = (GLubyte*)pb.map(QOpenGLBuffer::WriteOnly);
-        if (ptr) {
-            memcpy(ptr, d.frame.constBits(p), pb.size());
+        pixels = 0;
+        if (d.staging[p]) { // mapped in nextPBO()
+            if (!d.staged)
+                memcpy(d.staging[p], d.frame.constBits(p), qMin(pb.size(), d.frame.bytesPerLine(p)*d.frame.planeHeight(p)));
             pb.unmap();
+            d.staging[p] = 0;
+        } else {
+            // glMapBuffer() causes sync issue.
+            // Call glBufferData() with NULL pointer before glMapBuffer(), the previous data in PBO will be discarded and
+            // glMapBuffer() returns a new allocated pointer or an unused block immediately even if GPU is still working with the previous data.
+            // https://www.opengl.org/wiki/Buffer_Object_Streaming#Buffer_re-specification
+            pb.allocate(pb.size());
+            GLubyte* ptr = (GLubyte*)pb.map(QOpenGLBuffer::WriteOnly);
+            if (ptr) {
+                memcpy(ptr, d.frame.constBits(p), pb.size());
+                pb.unmap();
+            }
         }
+        d.pbo_used = true;
     }
     //qDebug("bpl[%d]=%d width=%d", p, frame.bytesPerLine(p), frame.planeWidth(p));
     DYGL(glBindTexture(d.target, tex));
@@ -582,10 +845,13 @@ void VideoMaterial::bindPlane(int p, bool updateTexture)
     DYGL(glTexParameteri(d.target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
     DYGL(glTexParameteri(d.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
     // TODO: data address use surfaceinterop.map()
-    DYGL(glTexSubImage2D(d.target, 0, 0, 0, d.texture_upload_size[p].width(), d.texture_upload_size[p].height(), d.data_format[p], d.data_type[p], d.try_pbo ? 0 : d.frame.constBits(p)));
+    OpenGLHelper::texSubImage2D(d.target, 0, 0, d.texture_upload_size[p].width(), d.texture_upload_size[p].height(), d.data_format[p], d.data_type[p], pixels, d.frame.bytesPerLine(p));
     //DYGL(glBindTexture(d.target, 0)); // no bind 0 because glActiveTexture was called
     if (d.try_pbo) {
-        d.pbo[p].release();
+        if (d.persistent)
+            OpenGLHelper::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        else
+            d.currentPBO(p).release();
     }
 }
 
@@ -616,6 +882,8 @@ void VideoMaterial::unbind()
     }
     if (d.update_texure) {
         d.update_texure = false;
+        QMutexLocker lock(&d.staging_mutex);
+        Q_UNUSED(lock);
         d.frame = VideoFrame(); //FIXME: why need this? we must unmap correctly before frame is reset.
     }
 }
@@ -642,7 +910,10 @@ int VideoMaterial::bpp() const
 
 QVector2D VideoMaterial::vectorTo8bit() const
 {
-    return d_func().vec_to8;
+    DPTR_D(const VideoMaterial);
+    if (d.tex16)
+        return d.vec_to16;
+    return d.vec_to8;
 }
 
 int VideoMaterial::planeCount() const
@@ -650,6 +921,23 @@ int VideoMaterial::planeCount() const
     return d_func().frame.planeCount();
 }
 
+qint64 VideoMaterial::textureMemory() const
+{
+    DPTR_D(const VideoMaterial);
+    qint64 bytes = 0;
+    for (int i = 0; i < d.texture_key.size(); ++i) {
+        const TextureKey &k = d.texture_key.at(i);
+        if (k.target) // 0: interop texture or not allocated
+            bytes += qint64(k.width)*k.height*OpenGLHelper::bytesOfGLFormat(k.format, k.type);
+    }
+    for (int i = 0; i < 4; ++i)
+        bytes += qint64(d.pbo_size[i])*VideoMaterialPrivate::kPBORingSize;
+    bytes += qint64(d.pbo_storage_size)*VideoMaterialPrivate::kPBORingSize;
+    if (d.lut_tex)
+        bytes += d.lut.data().size();
+    return bytes;
+}
+
 void VideoMaterial::setBrightness(qreal value)
 {
     d_func().colorTransform.setBrightness(value);
@@ -670,6 +958,57 @@ void VideoMaterial::setSaturation(qreal value)
     d_func().colorTransform.setSaturation(value);
 }
 
+void VideoMaterial::setDeinterlaceMode(DeinterlaceMode value)
+{
+    d_func().deinterlace_mode = value;
+}
+
+DeinterlaceMode VideoMaterial::deinterlaceMode() const
+{
+    return d_func().deinterlace_mode;
+}
+
+void VideoMaterial::setOutputColorTransfer(ColorTransfer value, qreal peakLuminance)
+{
+    DPTR_D(VideoMaterial);
+    d.out_trc = value;
+    d.out_peak = qMax<qreal>(0, peakLuminance);
+}
+
+ColorTransfer VideoMaterial::outputColorTransfer() const
+{
+    return d_func().out_trc;
+}
+
+qreal VideoMaterial::outputPeakLuminance() const
+{
+    return d_func().outputPeak();
+}
+
+void VideoMaterial::setToneMapping(ToneMapping value)
+{
+    d_func().tone_mapping = value;
+}
+
+ToneMapping VideoMaterial::toneMapping() const
+{
+    return d_func().tone_mapping;
+}
+
+void VideoMaterial::setColorLUT(const ColorLUT &value)
+{
+    DPTR_D(VideoMaterial);
+    QMutexLocker lock(&d.staging_mutex);
+    Q_UNUSED(lock);
+    d.lut = value;
+    d.lut_changed = true;
+}
+
+ColorLUT VideoMaterial::colorLUT() const
+{
+    return d_func().lut;
+}
+
 qreal VideoMaterial::validTextureWidth() const
 {
     return d_func().effective_tex_width_ratio;
@@ -771,21 +1110,118 @@ QRectF VideoMaterial::mapToTexture(int plane, const QRectF &roi, int normalize)
 
 bool VideoMaterialPrivate::initPBO(int plane, int size)
 {
-    QOpenGLBuffer &pb = pbo[plane];
-    if (!pb.isCreated()) {
-        qDebug("Creating PBO for plane %d, size: %d...", plane, size);
-        pb.create();
+    for (int i = 0; i < kPBORingSize; ++i) {
+        QOpenGLBuffer &pb = pbo[plane*kPBORingSize + i];
+        if (!pb.isCreated()) {
+            qDebug("Creating PBO %d for plane %d, size: %d...", i, plane, size);
+            pb.create();
+        }
+        if (!pb.bind()) {
+            qWarning("Failed to bind PBO for plane %d!!!!!!", plane);
+            try_pbo = false;
+            return false;
+        }
+        qDebug("Allocate PBO size %d", size);
+        pb.allocate(size);
+        pb.release();
     }
-    if (!pb.bind()) {
-        qWarning("Failed to bind PBO for plane %d!!!!!!", plane);
-        try_pbo = false;
-        return false;
+    pbo_size[plane] = size;
+    return true;
+}
+
+bool VideoMaterialPrivate::initPersistentPBO()
+{
+    destroyPersistentPBO();
+    // planes of a slot in 1 buffer
+    int size = 0;
+    for (int p = 0; p < frame.planeCount(); ++p) {
+        pbo_offset[p] = size;
+        staging_size[p] = frame.bytesPerLine(p)*frame.planeHeight(p);
+        size += (staging_size[p] + 63) & ~63;
     }
-    qDebug("Allocate PBO size %d", size);
-    pb.allocate(size);
+    for (int i = 0; i < kPBORingSize; ++i) {
+        void *ptr = 0;
+        pbo_storage[i] = OpenGLHelper::createPersistentBuffer(GL_PIXEL_UNPACK_BUFFER, size, &ptr);
+        if (!pbo_storage[i]) {
+            destroyPersistentPBO();
+            return false;
+        }
+        pbo_storage_ptr[i] = (uchar*)ptr;
+    }
+    qDebug("Persistent mapped PBO ring: %d x %d bytes", kPBORingSize, size);
+    pbo_storage_size = size;
+    pbo_slot = 0;
+    for (int p = 0; p < frame.planeCount(); ++p)
+        staging[p] = pbo_storage_ptr[pbo_slot] + pbo_offset[p];
+    staged = false;
     return true;
 }
 
+void VideoMaterialPrivate::destroyPersistentPBO()
+{
+    for (int i = 0; i < kPBORingSize; ++i) {
+        OpenGLHelper::deletePersistentBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_storage[i]);
+        pbo_storage[i] = 0;
+        pbo_storage_ptr[i] = 0;
+    }
+    pbo_storage_size = 0;
+    staging.fill(0);
+    staged = false;
+}
+
+void VideoMaterialPrivate::unmapStaging()
+{
+    if (persistent) { // always mapped
+        staging.fill(0);
+        staged = false;
+        return;
+    }
+    for (int p = 0; p < staging.size(); ++p) {
+        if (!staging[p])
+            continue;
+        QOpenGLBuffer &pb = currentPBO(p);
+        pb.bind();
+        pb.unmap();
+        pb.release();
+        staging[p] = 0;
+    }
+    staged = false;
+}
+
+void VideoMaterialPrivate::nextPBO()
+{
+    OpenGLHelper::deleteSync(pbo_fence[pbo_slot]);
+    pbo_fence[pbo_slot] = OpenGLHelper::fenceSync();
+    pbo_slot = (pbo_slot + 1) % kPBORingSize;
+    if (persistent) {
+        // gpu must finish reading the slot (kPBORingSize-1 frames ago) before it's overwritten. almost never blocks
+        if (!OpenGLHelper::isSyncSignaled(pbo_fence[pbo_slot], 100000000))
+            qWarning("PBO slot %d is still in use", pbo_slot);
+        for (int p = 0; p < video_format.planeCount(); ++p)
+            staging[p] = pbo_storage_ptr[pbo_slot] + pbo_offset[p];
+        staged = false;
+        return;
+    }
+    // the slot was used kPBORingSize-1 frames ago. re-specify the storage only if gpu may be still reading it
+    const bool idle = pbo_fence[pbo_slot] && OpenGLHelper::isSyncSignaled(pbo_fence[pbo_slot]);
+    for (int p = 0; p < video_format.planeCount(); ++p) {
+        QOpenGLBuffer &pb = currentPBO(p);
+        if (!pb.isCreated())
+            break;
+        pb.bind();
+        if (!idle)
+            pb.allocate(pb.size());
+        staging[p] = (uchar*)pb.map(QOpenGLBuffer::WriteOnly);
+        staging_size[p] = pb.size();
+        pb.release();
+        if (!staging[p]) {
+            unmapStaging();
+            break;
+        }
+    }
+    staged = false;
+}
+
 bool VideoMaterialPrivate::initTexture(GLuint tex, GLint internal_format, GLenum format, GLenum dataType, int width, int height)
 {
     DYGL(glBindTexture(target, tex));
@@ -798,13 +1234,100 @@ bool VideoMaterialPrivate::initTexture(GLuint tex, GLint internal_format, GLenum
     return true;
 }
 
-VideoMaterialPrivate::~VideoMaterialPrivate()
+void VideoMaterialPrivate::releaseTexture(int plane)
+{
+    GLuint &tex = textures[plane];
+    if (!tex)
+        return;
+    SharedTextures::instance().withdraw(this);
+    ShaderManager *manager = texture_key[plane].target ? ShaderManager::current() : 0;
+    if (manager)
+        manager->releaseTexture(texture_key[plane], tex);
+    else
+        DYGL(glDeleteTextures(1, &tex));
+    tex = 0;
+    texture_key[plane] = TextureKey();
+}
+
+bool VideoMaterialPrivate::bindSharedTextures()
 {
-    if (!textures.isEmpty()) {
-        DYGL(glDeleteTextures(textures.size(), textures.data()));
+    const void* group = SharedTextures::currentGroup();
+    if (!group)
+        return false;
+    // interop textures are not in the pool, the target of their key is 0
+    for (int i = 0; i < texture_key.size(); ++i) {
+        if (!texture_key[i].target)
+            return false;
     }
+    if (!SharedTextures::instance().find(this, group, frame_data, frame_pts, texture_key, &shared_textures))
+        return false;
+    const int nb_planes = shared_textures.size();
+    for (int i = 0; i < nb_planes; ++i) {
+        const int p = (i + 1) % nb_planes; // the same order as VideoMaterial::bind()
+        OpenGLHelper::glActiveTexture(GL_TEXTURE0 + p);
+        DYGL(glBindTexture(target, shared_textures[p]));
+    }
+    return true;
+}
+
+void VideoMaterialPrivate::publishTextures()
+{
+    const void* group = SharedTextures::currentGroup();
+    if (!group)
+        return;
+    for (int i = 0; i < texture_key.size(); ++i) {
+        if (!texture_key[i].target)
+            return;
+    }
+    // other contexts see the upload after it's flushed
+    DYGL(glFlush());
+    SharedTextures::instance().publish(this, group, frame_data, frame_pts, texture_key, textures);
+}
+
+VideoMaterialPrivate::~VideoMaterialPrivate()
+{
+    SharedTextures::instance().withdraw(this);
+    for (int i = 0; i < textures.size(); ++i)
+        releaseTexture(i);
     for (int i = 0; i < pbo.size(); ++i)
         pbo[i].destroy();
+    destroyPersistentPBO();
+    for (int i = 0; i < pbo_fence.size(); ++i)
+        OpenGLHelper::deleteSync(pbo_fence[i]);
+    if (lut_tex)
+        DYGL(glDeleteTextures(1, &lut_tex));
+}
+
+bool VideoMaterialPrivate::bindLUT()
+{
+    OpenGLHelper::glActiveTexture(GL_TEXTURE0 + kLUTUnit);
+    if (lut_tex && lut_target != target) { // rectangle texture shader samples the lut as rectangle texture
+        DYGL(glDeleteTextures(1, &lut_tex));
+        lut_tex = 0;
+    }
+    if (lut_tex && !lut_changed) {
+        DYGL(glBindTexture(target, lut_tex));
+        return true;
+    }
+    const int n = lut.size();
+    GLint max_size = 0;
+    DYGL(glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size));
+    if (n*n > max_size) {
+        qWarning("ColorLUT of size %d is too large for max texture size %d", n, max_size);
+        lut = ColorLUT();
+        return false;
+    }
+    if (!lut_tex)
+        DYGL(glGenTextures(1, &lut_tex));
+    lut_target = target;
+    DYGL(glBindTexture(target, lut_tex));
+    DYGL(glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    DYGL(glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    DYGL(glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    DYGL(glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    DYGL(glTexImage2D(target, 0, GL_RGBA, n*n, n, 0, GL_RGBA, GL_UNSIGNED_BYTE, lut.data().constData()));
+    lut_changed = false;
+    return true;
 }
 
 bool VideoMaterialPrivate::updateTextureParameters(const VideoFormat& fmt)
@@ -833,6 +1356,8 @@ bool VideoMaterialPrivate::updateTextureParameters(const VideoFormat& fmt)
         qWarning() << "No OpenGL support for " << fmt;
         return false;
     }
+    // 9~16 bit planes as GL_R16/GL_RG16: full precision and no LUMINANCE_ALPHA packing. the same check as the shader
+    tex16 = OpenGLHelper::is16BitTexture(fmt);
     qDebug("///////////bpp %d", fmt.bytesPerPixel());
     /*!
      * GLES internal_format == data_format, GL_LUMINANCE_ALPHA is 2 bytes
@@ -868,13 +1393,12 @@ bool VideoMaterialPrivate::updateTextureParameters(const VideoFormat& fmt)
      */
     // always delete old textures otherwise old textures are not initialized with correct parameters
     if (textures.size() > nb_planes) {
-        const int nb_delete = textures.size() - nb_planes;
-        qDebug("delete %d textures", nb_delete);
-        if (!textures.isEmpty()) {
-            DYGL(glDeleteTextures(nb_delete, textures.data() + nb_planes));
-        }
+        qDebug("delete %d textures", textures.size() - nb_planes);
+        for (int i = nb_planes; i < textures.size(); ++i)
+            releaseTexture(i);
     }
     textures.resize(nb_planes);
+    texture_key.resize(nb_planes);
     init_textures_required = true;
     return true;
 }
@@ -936,6 +1460,11 @@ bool VideoMaterialPrivate::ensureResources()
         try_pbo = try_pbo && OpenGLHelper::isPBOSupported();
         // check PBO support with bind() is fine, no need to check extensions
         if (try_pbo) {
+            unmapStaging(); // mapped planes of the old size
+            // write planes into persistently mapped buffers if supported. otherwise map and unmap every frame
+            persistent = OpenGLHelper::hasBufferStorage() && initPersistentPBO();
+        }
+        if (try_pbo && !persistent) {
             for (int i = 0; i < nb_planes; ++i) {
                 qDebug("Init PBO for plane %d", i);
                 if (!initPBO(i, frame.bytesPerLine(i)*frame.planeHeight(i))) {
@@ -957,9 +1486,8 @@ bool VideoMaterialPrivate::ensureTextures()
     for (int p = 0; p < nb_planes; ++p) {
         GLuint &tex = textures[p];
         if (tex) { // can be 0 if resized to a larger size
-            qDebug("deleting texture for plane %d (id=%u)", p, tex);
-            DYGL(glDeleteTextures(1, &tex));
-            tex = 0;
+            qDebug("releasing texture for plane %d (id=%u)", p, tex);
+            releaseTexture(p);
         }
         if (!tex) {
             qDebug("creating texture for plane %d", p);
@@ -967,8 +1495,18 @@ bool VideoMaterialPrivate::ensureTextures()
             if (handle) {
                 tex = *handle;
             } else {
-                DYGL(glGenTextures(1, &tex));
-                initTexture(tex, internal_format[p], data_format[p], data_type[p], texture_size[p].width(), texture_size[p].height());
+                // a texture of the same storage released before, e.g. adaptive streaming switches back to a previous size
+                const TextureKey key(target, internal_format[p], data_format[p], data_type[p], texture_size[p].width(), texture_size[p].height());
+                ShaderManager *manager = ShaderManager::current();
+                if (manager)
+                    tex = manager->takeTexture(key);
+                if (tex) {
+                    qDebug("reuse pooled texture for plane %d", p);
+                } else {
+                    DYGL(glGenTextures(1, &tex));
+                    initTexture(tex, key.internal_format, key.format, key.type, key.width, key.height);
+                }
+                texture_key[p] = key;
             }
             qDebug("texture for plane %d is created (id=%u)", p, tex);
         }
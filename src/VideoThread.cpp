@@ -29,12 +29,65 @@
 #include "QtAV/Statistics.h"
 #include "QtAV/Filter.h"
 #include "QtAV/FilterContext.h"
+#include "QtAV/TraceRecorder.h"
 #include "output/OutputSet.h"
 #include "QtAV/private/AVCompat.h"
 #include <QtCore/QFileInfo>
+#include <QtCore/QQueue>
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
 #include "utils/Logger.h"
 
 namespace QtAV {
+namespace {
+class FilterThreadPool : public QThreadPool
+{
+public:
+    FilterThreadPool() : QThreadPool() {
+        setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    }
+};
+Q_GLOBAL_STATIC(FilterThreadPool, filterThreadPool)
+
+class ReadOnlyFilterTask : public QRunnable
+{
+public:
+    ReadOnlyFilterTask(VideoFilter *filter, Statistics *statistics, const VideoFrame& frame, QSemaphore *done)
+        : m_filter(filter), m_statistics(statistics), m_frame(frame), m_done(done)
+    {}
+    void run() Q_DECL_OVERRIDE {
+        m_filter->apply(m_statistics, &m_frame);
+        m_done->release();
+    }
+private:
+    VideoFilter *m_filter;
+    Statistics *m_statistics;
+    VideoFrame m_frame;
+    QSemaphore *m_done;
+};
+
+// run filters concurrently and wait for all. the 1st filter runs in current thread
+void applyReadOnlyFilters(const QList<VideoFilter*>& filters, Statistics *statistics, const VideoFrame& frame)
+{
+    if (filters.isEmpty())
+        return;
+    VideoFrame f(frame);
+    if (filters.size() > 1) {
+        // copy back gpu data once, not concurrently in every filter
+        if (f.isValid() && !f.hasHostData())
+            f.constBits(0);
+        QSemaphore done;
+        for (int i = 1; i < filters.size(); ++i)
+            filterThreadPool()->start(new ReadOnlyFilterTask(filters.at(i), statistics, f, &done));
+        filters.first()->apply(statistics, &f);
+        done.acquire(filters.size() - 1);
+        return;
+    }
+    filters.first()->apply(statistics, &f);
+}
+} //namespace
 
 class VideoThreadPrivate : public AVThreadPrivate
 {
@@ -44,30 +97,533 @@ public:
       , force_fps(-1)
       , force_dt(-1)
       , last_deliver_time(0)
+      , single_frame(false)
+      , keep_last_frame(false)
+      , filter_stage_depth(0)
+      , field_rate(false)
+      , present_depth(0)
+      , fast_first_frame(false)
+      , reverse(false)
+      , reverse_cache_bytes(0)
+      , reverse_bytes(0)
+      , reverse_index(0)
+      , reverse_stride(1)
+      , reverse_pts(-1)
+      , reverse_seeking(false)
+      , key_frame_only(false)
       , capture(0)
       , filter_context(0)
+      , fallback_enabled(false)
+      , fallback_avctx(0)
+      , primary_dec(0)
+      , owned_dec(0)
+      , gop_valid(false)
+      , dec_errors(0)
+      , upgrade_time(0)
+      , upgrade_interval(kUpgradeIntervalMin)
     {
     }
     ~VideoThreadPrivate() {
         //not neccesary context is managed by filters.
         filter_context = 0;
+        if (owned_dec) {
+            delete owned_dec;
+            owned_dec = 0;
+        }
+    }
+    // cache packets since last key frame to feed a new decoder
+    void cachePacket(const Packet& pkt) {
+        if (!fallback_enabled || !pkt.isValid() || pkt.isEOF())
+            return;
+        if (pkt.hasKeyFrame) {
+            gop.clear();
+            gop_valid = true;
+        }
+        if (!gop_valid)
+            return;
+        if (gop.size() >= kMaxGopPackets) { // no key frame for a long time. not worth to replay
+            gop.clear();
+            gop_valid = false;
+            return;
+        }
+        gop.append(pkt);
+    }
+    void clearPacketCache() {
+        gop.clear();
+        gop_valid = false;
+        dec_errors = 0;
+    }
+    /*!
+     * called in video thread, or in filter stage thread if enabled
+     * \param skipped the frame will not be displayed. filters not requiring every frame are not applied
+     */
+    void applyFilters(VideoFrame& frame, bool skipped = false) {
+        QMutexLocker locker(&mutex);
+        Q_UNUSED(locker);
+        if (filters.isEmpty())
+            return;
+        TraceRecorder::Span span("filter", "video");
+        QList<VideoFilter*> read_only; // consecutive read only filters. run before the next filter modifies the frame
+        //sort filters by format. vo->defaultFormat() is the last
+        foreach (Filter *filter, filters) {
+            VideoFilter *vf = static_cast<VideoFilter*>(filter);
+            if (!vf->isEnabled())
+                continue;
+            if (skipped && !vf->needsEveryFrame()) {
+                vf->skip();
+                continue;
+            }
+            if (vf->isReadOnly() && vf->contextType() == VideoFilterContext::None) {
+                read_only.append(vf);
+                continue;
+            }
+            applyReadOnlyFilters(read_only, statistics, frame);
+            read_only.clear();
+            vf->prepareContext(filter_context, statistics, &frame);
+            vf->apply(statistics, &frame);
+        }
+        applyReadOnlyFilters(read_only, statistics, frame);
+    }
+    // frame type mix and decode time of frame types. dt: ns
+    void countPictureType(const VideoFrame& frame, qint64 dt) {
+        if (!frame.hasSideData(Frame::PictureType))
+            return;
+        const qreal us = qreal(dt)/1000.0;
+        switch (frame.sideData(Frame::PictureType)) {
+        case AV_PICTURE_TYPE_I:
+            statistics->count(Statistics::IFrames);
+            statistics->video_only.decode_time_i.add(us);
+            break;
+        case AV_PICTURE_TYPE_P:
+            statistics->count(Statistics::PFrames);
+            statistics->video_only.decode_time_p.add(us);
+            break;
+        case AV_PICTURE_TYPE_B:
+            statistics->count(Statistics::BFrames);
+            statistics->video_only.decode_time_b.add(us);
+            break;
+        default:
+            break;
+        }
     }
+    static FrameDropPolicy::PictureType pictureType(const VideoFrame& frame) {
+        if (!frame.hasSideData(Frame::PictureType))
+            return FrameDropPolicy::UnknownPicture;
+        switch (frame.sideData(Frame::PictureType)) {
+        case AV_PICTURE_TYPE_I: return FrameDropPolicy::IPicture;
+        case AV_PICTURE_TYPE_P: return FrameDropPolicy::PPicture;
+        case AV_PICTURE_TYPE_B: return FrameDropPolicy::BPicture;
+        default: return FrameDropPolicy::UnknownPicture;
+        }
+    }
+    // seconds between 2 frames at clock speed
+    qreal frameInterval() const {
+        qreal fps = force_fps > 0 ? force_fps : statistics->video.frame_rate;
+        if (fps <= 0)
+            fps = 25.0;
+        const qreal speed = clock->speed() > 0 ? clock->speed() : 1.0;
+        return 1.0/(fps*speed);
+    }
+    // the displayed frame and deliver time are written by the video thread or the presenter, and read by capture tasks
+    void setDisplayed(const VideoFrame& frame, qint64 deliverTime) {
+        QMutexLocker lock(&displayed_mutex);
+        Q_UNUSED(lock);
+        if (frame.isValid())
+            displayed_frame = frame;
+        last_deliver_time = deliverTime;
+    }
+    VideoFrame displayedFrame() const {
+        QMutexLocker lock(&displayed_mutex);
+        Q_UNUSED(lock);
+        return displayed_frame;
+    }
+    qint64 lastDeliverTime() const {
+        QMutexLocker lock(&displayed_mutex);
+        Q_UNUSED(lock);
+        return last_deliver_time;
+    }
+    static qint64 frameBytes(const VideoFrame& frame) {
+        qint64 bytes = 0;
+        for (int i = 0; i < frame.planeCount(); ++i)
+            bytes += qint64(frame.bytesPerLine(i))*frame.planeHeight(i);
+        return bytes;
+    }
+    // reverse mode. cache a decoded frame of the current gop
+    void cacheReverseFrame(VideoFrame frame) {
+        if (!frame.isValid())
+            return;
+        foreach (qreal t, reverse_skip) {
+            if (qAbs(frame.timestamp() - t) < 0.0005) // frame of a decode only packet
+                return;
+        }
+        if (reverse_index++ % reverse_stride)
+            return;
+        QSize s(frame.size());
+        if (reverse_size.isValid() && (s.width() > reverse_size.width() || s.height() > reverse_size.height()))
+            s.scale(reverse_size, Qt::KeepAspectRatio);
+        // copy gpu frames back, so decoder surfaces are not held by the cache
+        if (!frame.hasHostData() || s != frame.size()) {
+            const qreal t = frame.timestamp();
+            frame = frame.to(frame.format(), s);
+            if (!frame.isValid())
+                return;
+            frame.setTimestamp(t);
+        }
+        reverse_frames.append(frame);
+        reverse_bytes += frameBytes(frame);
+        while (reverse_cache_bytes > 0 && reverse_bytes > reverse_cache_bytes && reverse_frames.size() > 1) {
+            // keep every other frame, and cache every other frame of the rest of the gop
+            QVector<VideoFrame> kept;
+            kept.reserve(reverse_frames.size()/2 + 1);
+            reverse_bytes = 0;
+            for (int i = 0; i < reverse_frames.size(); i += 2) {
+                kept.append(reverse_frames.at(i));
+                reverse_bytes += frameBytes(reverse_frames.at(i));
+            }
+            reverse_frames = kept;
+            reverse_stride *= 2;
+        }
+    }
+    void clearReverse() {
+        reverse_frames.clear();
+        reverse_skip.clear();
+        reverse_bytes = 0;
+        reverse_index = 0;
+        reverse_stride = 1;
+        reverse_pts = -1;
+    }
+    enum {
+        kMaxDecodeErrors = 3, // consecutive decode errors to fallback
+        kMaxGopPackets = 600,
+        kUpgradeIntervalMin = 10000, // ms
+        kUpgradeIntervalMax = 300000
+    };
 
     VideoFrameConverter conv;
     qreal force_fps; // <=0: ignore
     // not const.
     int force_dt; //unit: ms. force_fps = 1/force_dt.  <=0: ignore
-    qint64 last_deliver_time;
+    qint64 last_deliver_time; // protected by displayed_mutex
+    bool single_frame;
+    volatile bool keep_last_frame;
+    int filter_stage_depth; // frames in filter stage thread. 0: filters run in video thread
+    ThreadPolicy filter_policy; // of the filter stage thread
+    bool field_rate; // deliver the 2nd field of interlaced frames
+    int present_depth; // frames decoded ahead and presented by VideoPresenter. 0: presented in video thread
+    bool fast_first_frame; // the 1st frame is a poster delivered without waiting
+    // reverse mode
+    volatile bool reverse;
+    qint64 reverse_cache_bytes;
+    QSize reverse_size;
+    QAtomicInt reverse_steps; // frame steps requested when paused
+    // used in video thread only
+    QVector<VideoFrame> reverse_frames; // decoded frames of a gop, displayed from the last one
+    QVector<qreal> reverse_skip; // timestamps of decode only packets
+    qint64 reverse_bytes;
+    int reverse_index; // frames decoded in the gop
+    int reverse_stride; // cache 1 of every reverse_stride frames
+    qreal reverse_pts; // the last displayed
+    bool reverse_seeking; // report seekFinished() for the 1st displayed frame
+    volatile bool key_frame_only; // trick play
+    FrameDropPolicyPtr drop_policy;
 
     double pts; //current decoded pts. for capture. TODO: remove
     VideoCapture *capture;
     VideoFilterContext *filter_context;//TODO: use own smart ptr. QSharedPointer "=" is ugly
-    VideoFrame displayed_frame;
+    VideoFrame displayed_frame; // protected by displayed_mutex
+    mutable QMutex displayed_mutex;
+
+    // decoder fallback. protected by mutex
+    bool fallback_enabled;
+    QVector<VideoDecoderId> fallback_ids;
+    AVCodecContext *fallback_avctx;
+    QVariantHash fallback_opt;
+    // used in video thread only
+    VideoDecoder *primary_dec; // set by setDecoder(). not owned
+    VideoDecoder *owned_dec; // opened by switchDecoder()
+    QList<Packet> gop;
+    bool gop_valid; // gop starts with a key frame
+    int dec_errors;
+    qint64 upgrade_time; // try decoders of higher priority after this time
+    qint64 upgrade_interval;
+};
+
+/*!
+ * Runs the filters of a video thread in its own thread. The video thread put()s decoded frames and take()s filtered
+ * frames in the same order, so decoding the next frame overlaps filtering the previous ones.
+ */
+class VideoFilterStage : public QThread
+{
+public:
+    explicit VideoFilterStage(VideoThreadPrivate *d)
+        : m_d(d)
+        , m_stop(false)
+        , m_busy(false)
+        , m_generation(0)
+    {
+        setObjectName(QStringLiteral("VideoFilterStage"));
+    }
+    ~VideoFilterStage() { finish();}
+    void put(const VideoFrame& frame, bool skipped = false) {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_in.enqueue(Item(frame, skipped));
+        m_cond.wakeAll();
+    }
+    /*!
+     * \brief take
+     * Take the oldest filtered frame. If wait is true, wait for it while frames are queued or being filtered
+     * \param skipped the value given to put()
+     * \return false if no filtered frame
+     */
+    bool take(VideoFrame *frame, bool wait, bool *skipped = 0) {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        while (wait && m_out.isEmpty() && (m_busy || !m_in.isEmpty()) && !m_stop)
+            m_cond.wait(&m_mutex);
+        if (m_out.isEmpty())
+            return false;
+        const Item item(m_out.dequeue());
+        *frame = item.frame;
+        if (skipped)
+            *skipped = item.skipped;
+        return true;
+    }
+    /// frames put but not taken
+    int pending() const {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        return m_in.size() + m_out.size() + (m_busy ? 1 : 0);
+    }
+    /// drop all frames, e.g. after seek. the frame being filtered is dropped when done
+    void flush() {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_in.clear();
+        m_out.clear();
+        ++m_generation;
+    }
+    void finish() {
+        if (!isRunning())
+            return;
+        {
+            QMutexLocker lock(&m_mutex);
+            Q_UNUSED(lock);
+            m_stop = true;
+            m_cond.wakeAll();
+        }
+        wait();
+        m_in.clear();
+        m_out.clear();
+        m_stop = false;
+    }
+protected:
+    virtual void run() {
+        m_d->filter_policy.apply();
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        while (!m_stop) {
+            if (m_in.isEmpty()) {
+                m_cond.wait(&m_mutex);
+                continue;
+            }
+            Item item(m_in.dequeue());
+            const int generation = m_generation;
+            m_busy = true;
+            lock.unlock();
+            m_d->applyFilters(item.frame, item.skipped);
+            lock.relock();
+            m_busy = false;
+            if (generation == m_generation)
+                m_out.enqueue(item);
+            m_cond.wakeAll();
+        }
+    }
+private:
+    struct Item {
+        Item(const VideoFrame& f = VideoFrame(), bool s = false) : frame(f), skipped(s) {}
+        VideoFrame frame;
+        bool skipped;
+    };
+    VideoThreadPrivate *m_d;
+    bool m_stop;
+    bool m_busy;
+    int m_generation;
+    QQueue<Item> m_in, m_out;
+    mutable QMutex m_mutex;
+    QWaitCondition m_cond;
+};
+
+/*!
+ * Presents decoded frames at their due time in its own thread, so decoding runs ahead by a few frames and a slow frame
+ * (e.g. a key frame) is absorbed by the queue instead of delaying presentation. Frames on gpu hold decoder surfaces and
+ * are limited separately, a decoder has a fixed number of surfaces.
+ */
+class VideoPresenter : public QThread
+{
+public:
+    VideoPresenter(VideoThread *thread, VideoThreadPrivate *d)
+        : m_thread(thread)
+        , m_d(d)
+        , m_stop(false)
+        , m_busy(false)
+        , m_gpu(0)
+        , m_generation(0)
+    {
+        setObjectName(QStringLiteral("VideoPresenter"));
+    }
+    ~VideoPresenter() { finish();}
+    /*!
+     * \brief put
+     * Queue a frame. If the queue is full, wait for a presented frame at most timeout ms
+     * \param immediate present without waiting for the clock, e.g. the 1st frame after seek
+     * \param capacity max frames queued. gpuCapacity: max frames on gpu queued
+     * \return false if the queue is still full
+     */
+    bool put(const VideoFrame& frame, bool immediate, int capacity, int gpuCapacity, ulong timeout) {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        const bool gpu = !frame.hasHostData();
+        if (!m_stop && isFull(gpu, capacity, gpuCapacity))
+            m_cond.wait(&m_mutex, timeout);
+        if (!m_stop && isFull(gpu, capacity, gpuCapacity))
+            return false;
+        m_queue.enqueue(Item(frame, immediate, gpu));
+        if (gpu)
+            ++m_gpu;
+        m_cond.wakeAll();
+        return true;
+    }
+    /// frames put but not presented
+    int pending() const {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        return m_queue.size() + (m_busy ? 1 : 0);
+    }
+    /// drop all frames and wait for the frame being presented, e.g. after seek or before the video thread delivers frames itself
+    void flush() {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_queue.clear();
+        m_gpu = 0;
+        ++m_generation;
+        m_cond.wakeAll();
+        while (m_busy && !m_stop)
+            m_cond.wait(&m_mutex, 20);
+    }
+    /// wait until all frames are presented, e.g. at the end of stream. return false if stop becomes true
+    bool drain(volatile bool *stop) {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        while ((m_busy || !m_queue.isEmpty()) && !m_stop && !*stop)
+            m_cond.wait(&m_mutex, 20);
+        return !*stop;
+    }
+    void finish() {
+        if (!isRunning())
+            return;
+        {
+            QMutexLocker lock(&m_mutex);
+            Q_UNUSED(lock);
+            m_stop = true;
+            m_cond.wakeAll();
+        }
+        wait();
+        m_queue.clear();
+        m_gpu = 0;
+        m_stop = false;
+    }
+protected:
+    virtual void run() {
+        m_d->thread_policy.apply();
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        while (!m_stop) {
+            if (m_queue.isEmpty()) {
+                m_cond.wait(&m_mutex);
+                continue;
+            }
+            const Item &head = m_queue.head();
+            if (!head.immediate && !m_d->offline) {
+                // the clock is checked in slices, it can be paused or corrected by audio
+                const qreal speed = m_d->clock->speed() > 0 ? m_d->clock->speed() : 1.0;
+                const qreal delay = (head.frame.timestamp() - m_d->clock->value())/speed;
+                if (delay > 0 && delay < 1.0) {
+                    const qreal wait = m_d->statistics->video_only.alignToVSync(delay);
+                    if (wait > 0.001) {
+                        m_cond.wait(&m_mutex, qBound<ulong>(1, ulong(wait*1000.0), 20));
+                        continue;
+                    }
+                }
+            }
+            Item item(m_queue.dequeue());
+            if (item.gpu)
+                --m_gpu;
+            const int generation = m_generation;
+            m_busy = true;
+            m_cond.wakeAll(); // a slot is free
+            lock.unlock();
+            VideoFrame field;
+            const bool ok = present(item, &field);
+            lock.relock();
+            m_busy = false;
+            // the 2nd field of interlaced frame is presented in the middle of 2 frames
+            if (ok && field.isValid() && generation == m_generation)
+                m_queue.prepend(Item(field, false, false, true));
+            m_cond.wakeAll();
+        }
+    }
+private:
+    struct Item {
+        Item(const VideoFrame& f = VideoFrame(), bool i = false, bool g = false, bool s = false)
+            : frame(f), immediate(i), gpu(g), second_field(s) {}
+        VideoFrame frame;
+        bool immediate;
+        bool gpu; // counted in m_gpu
+        bool second_field;
+    };
+    bool isFull(bool gpu, int capacity, int gpuCapacity) const {
+        return m_queue.size() >= capacity || (gpu && m_gpu >= gpuCapacity);
+    }
+    bool present(Item& item, VideoFrame *field) {
+        VideoFrame &frame = item.frame;
+        if (!item.second_field)
+            m_d->clock->updateVideoTime(frame.timestamp());
+        if (!m_thread->deliverVideoFrame(frame))
+            return false;
+        Statistics *st = m_d->statistics;
+        const qint64 deliver_time = st->video_only.frameDisplayed(frame.timestamp());
+        if (item.second_field) {
+            m_d->setDisplayed(VideoFrame(), deliver_time);
+            return true;
+        }
+        m_d->setDisplayed(frame, deliver_time);
+        st->count(Statistics::RenderedFrames);
+        if (!item.immediate && frame.timestamp() < m_d->clock->value() - 0.04)
+            st->count(Statistics::LateFrames);
+        // frame is still interlaced if no filter or conversion for renderer changed it
+        if (m_d->field_rate && frame.isInterlaced() && !item.immediate) {
+            const qreal fps = st->video.frame_rate;
+            *field = frame.secondField();
+            field->setTimestamp(frame.timestamp() + (fps > 0 ? 0.5/fps : 0.02));
+        }
+        return true;
+    }
+    VideoThread *m_thread;
+    VideoThreadPrivate *m_d;
+    bool m_stop;
+    bool m_busy;
+    int m_gpu; // frames on gpu in queue
+    int m_generation;
+    QQueue<Item> m_queue;
+    mutable QMutex m_mutex;
+    QWaitCondition m_cond;
 };
 
 VideoThread::VideoThread(QObject *parent) :
     AVThread(*new VideoThreadPrivate(), parent)
 {
+    setObjectName(QStringLiteral("VideoThread"));
 }
 
 //it is called in main thread usually, but is being used in video thread,
@@ -118,7 +674,7 @@ void VideoThread::addCaptureTask()
 
 VideoFrame VideoThread::displayedFrame() const
 {
-    return d_func().displayed_frame;
+    return d_func().displayedFrame();
 }
 
 void VideoThread::setFrameRate(qreal value)
@@ -132,6 +688,105 @@ void VideoThread::setFrameRate(qreal value)
     }
 }
 
+void VideoThread::setSingleFrame(bool value)
+{
+    d_func().single_frame = value;
+}
+
+void VideoThread::setKeepLastFrame(bool value)
+{
+    d_func().keep_last_frame = value;
+}
+
+void VideoThread::setFilterStage(int frames)
+{
+    d_func().filter_stage_depth = qMax(frames, 0);
+}
+
+void VideoThread::setFilterThreadPolicy(const ThreadPolicy &policy)
+{
+    d_func().filter_policy = policy;
+}
+
+int VideoThread::filterStage() const
+{
+    return d_func().filter_stage_depth;
+}
+
+void VideoThread::setPresentQueue(int frames)
+{
+    d_func().present_depth = qMax(frames, 0);
+}
+
+int VideoThread::presentQueue() const
+{
+    return d_func().present_depth;
+}
+
+void VideoThread::setFieldRate(bool value)
+{
+    d_func().field_rate = value;
+}
+
+void VideoThread::setFastFirstFrame(bool value)
+{
+    d_func().fast_first_frame = value;
+}
+
+void VideoThread::setReverse(bool value, qint64 cacheBytes, const QSize &maxSize)
+{
+    DPTR_D(VideoThread);
+    d.reverse_cache_bytes = cacheBytes;
+    d.reverse_size = maxSize;
+    d.reverse = value;
+    if (!value)
+        d.reverse_steps.fetchAndStoreOrdered(0);
+}
+
+bool VideoThread::isReverse() const
+{
+    return d_func().reverse;
+}
+
+void VideoThread::stepBackward()
+{
+    d_func().reverse_steps.ref();
+    wakeUp(); // paused
+}
+
+void VideoThread::setKeyFrameOnly(bool value)
+{
+    d_func().key_frame_only = value;
+}
+
+bool VideoThread::isKeyFrameOnly() const
+{
+    return d_func().key_frame_only;
+}
+
+void VideoThread::setFrameDropPolicy(const FrameDropPolicyPtr &policy)
+{
+    class PolicyTask : public QRunnable {
+    public:
+        PolicyTask(VideoThreadPrivate *d, const FrameDropPolicyPtr& p) : priv(d), policy(p) {}
+        void run() Q_DECL_OVERRIDE {
+            priv->drop_policy = policy;
+            if (policy)
+                policy->reset();
+        }
+    private:
+        VideoThreadPrivate *priv;
+        FrameDropPolicyPtr policy;
+    };
+    PolicyTask *task = new PolicyTask(&d_func(), policy);
+    if (isRunning()) {
+        scheduleTask(task);
+    } else {
+        task->run();
+        delete task;
+    }
+}
+
 void VideoThread::setBrightness(int val)
 {
     setEQ(val, 101, 101);
@@ -181,25 +836,20 @@ void VideoThread::setEQ(int b, int c, int s)
 
 void VideoThread::applyFilters(VideoFrame &frame)
 {
-    DPTR_D(VideoThread);
-    QMutexLocker locker(&d.mutex);
-    Q_UNUSED(locker);
-    if (!d.filters.isEmpty()) {
-        //sort filters by format. vo->defaultFormat() is the last
-        foreach (Filter *filter, d.filters) {
-            VideoFilter *vf = static_cast<VideoFilter*>(filter);
-            if (!vf->isEnabled())
-                continue;
-            vf->prepareContext(d.filter_context, d.statistics, &frame);
-            vf->apply(d.statistics, &frame);
-        }
-    }
+    d_func().applyFilters(frame);
 }
 
 // filters on vo will not change video frame, so it's safe to protect frame only in every individual vo
 bool VideoThread::deliverVideoFrame(VideoFrame &frame)
 {
     DPTR_D(VideoThread);
+    // converted frames have no metadata
+    const bool tracing = Statistics::isLatencyTracing() && d.statistics;
+    qint64 demuxed = 0, filtered = 0;
+    if (tracing) {
+        demuxed = frame.sideData(Frame::DemuxTime);
+        filtered = frame.sideData(Frame::FilteredTime);
+    }
     /*
      * TODO: video renderers sorted by preferredPixelFormat() and convert in AVOutputSet.
      * Convert only once for the renderers has the same preferredPixelFormat().
@@ -238,19 +888,179 @@ bool VideoThread::deliverVideoFrame(VideoFrame &frame)
             frame = outFrame;
         }
     }
-    d.outputSet->sendVideoFrame(frame); //TODO: group by format, convert group by group
     d.outputSet->unlock();
+    if (tracing) {
+        const qint64 now = Statistics::tracingTime();
+        d.statistics->video.addLatency(Statistics::LatencyOutput, filtered, now);
+        // renderers report present and total latency when the frame is on screen
+        frame.setSideData(Frame::DemuxTime, demuxed);
+        frame.setSideData(Frame::SentTime, now);
+    }
+    d.outputSet->sendVideoFrame(frame); //TODO: group by format, convert group by group
 
     emit frameDelivered();
     return true;
 }
 
 //TODO: if output is null or dummy, the use duration to wait
+void VideoThread::setDecoderFallback(const QVector<VideoDecoderId> &ids, AVCodecContext *avctx, const QVariantHash &options)
+{
+    DPTR_D(VideoThread);
+    QMutexLocker locker(&d.mutex);
+    Q_UNUSED(locker);
+    d.fallback_ids = ids;
+    d.fallback_avctx = avctx;
+    d.fallback_opt = options;
+    d.fallback_enabled = ids.size() > 1 && avctx;
+}
+
+VideoDecoder* VideoThread::switchDecoder(VideoDecoder *current, bool upgrade)
+{
+    DPTR_D(VideoThread);
+    QVector<VideoDecoderId> ids;
+    AVCodecContext *avctx = 0;
+    QVariantHash opt;
+    {
+        QMutexLocker locker(&d.mutex);
+        Q_UNUSED(locker);
+        ids = d.fallback_ids;
+        avctx = d.fallback_avctx;
+        opt = d.fallback_opt;
+    }
+    if (!avctx || ids.isEmpty())
+        return 0;
+    int idx = ids.indexOf(current->id());
+    if (idx < 0) // not in list. e.g. priority changed. try all
+        idx = upgrade ? ids.size() : -1;
+    const int begin = upgrade ? 0 : idx + 1;
+    const int end = upgrade ? idx : ids.size();
+    VideoDecoder *vd = 0;
+    for (int i = begin; i < end; ++i) {
+        if (d.primary_dec && d.primary_dec != current && d.primary_dec->id() == ids[i]) {
+            // reuse the decoder set by user. it was closed when switching away
+            if (d.primary_dec->open()) {
+                vd = d.primary_dec;
+                break;
+            }
+            continue;
+        }
+        VideoDecoder *tmp = VideoDecoder::create(ids[i]);
+        if (!tmp)
+            continue;
+        tmp->setCodecContext(avctx); // copy the demuxer's context. current decoder's context may be modified by hw decoder
+        if (!tmp->isSupported()) {
+            delete tmp;
+            continue;
+        }
+        tmp->setOptions(opt);
+        tmp->setPipelineDepth(current->pipelineDepth());
+        if (tmp->open()) {
+            vd = tmp;
+            break;
+        }
+        delete tmp;
+    }
+    if (!vd) {
+        if (upgrade)
+            d.upgrade_interval = qMin<qint64>(d.upgrade_interval*2, VideoThreadPrivate::kUpgradeIntervalMax);
+        else
+            qWarning("no fallback decoder for %s", current->name().toUtf8().constData());
+        return 0;
+    }
+    qDebug("video decoder %s %s to %s", current->name().toUtf8().constData(), upgrade ? "upgrades" : "falls back", vd->name().toUtf8().constData());
+    vd->resizeVideoFrame(0, 0);
+    setDecoder(vd);
+    current->close();
+    if (current == d.owned_dec) {
+        delete d.owned_dec;
+        d.owned_dec = 0;
+    }
+    if (vd != d.primary_dec)
+        d.owned_dec = vd;
+    if (!upgrade) {
+        // decode from last key frame. frames before the failed packet were already rendered
+        foreach (const Packet& p, d.gop) {
+            if (vd->decode(p))
+                vd->frame();
+        }
+        d.upgrade_interval = VideoThreadPrivate::kUpgradeIntervalMin;
+    }
+    d.upgrade_time = QDateTime::currentMSecsSinceEpoch() + d.upgrade_interval;
+    d.dec_errors = 0;
+    d.statistics->video.decoder = vd->name();
+    d.statistics->video.decoder_detail = vd->description();
+    return vd;
+}
+
+bool VideoThread::reverseStep(bool wait)
+{
+    DPTR_D(VideoThread);
+    VideoDecoder *dec = static_cast<VideoDecoder*>(d.dec);
+    while (d.reverse_frames.isEmpty()) {
+        if (d.stop || !dec || !d.reverse)
+            return false;
+        if (!wait && d.packets.isEmpty()) // the gop is not read yet
+            return false;
+        const Packet pkt(d.packets.take());
+        if (pkt.isEOF()) { // end of the gop. get delayed frames
+            for (int i = 0; i < 64 && dec->decode(pkt); ++i)
+                d.cacheReverseFrame(dec->frame());
+            dec->flush();
+            d.reverse_skip.clear();
+            d.reverse_index = 0;
+            d.reverse_stride = 1;
+            continue;
+        }
+        if (!pkt.isValid()) {
+            if (pkt.pts < 0) // not blocking, e.g. stopped
+                return false;
+            // seek. a new start position
+            dec->flush();
+            d.clearReverse();
+            d.clearPacketCache();
+            d.reverse_seeking = true;
+            continue;
+        }
+        if (pkt.isDecodeOnly)
+            d.reverse_skip.append(pkt.pts);
+        d.statistics->count(Statistics::VideoBytes, pkt.data.size());
+        if (!dec->decode(pkt))
+            continue;
+        do {
+            d.statistics->count(Statistics::DecodedFrames);
+            d.cacheReverseFrame(dec->frame());
+        } while (dec->receiveFrame());
+    }
+    VideoFrame frame(d.reverse_frames.takeLast());
+    d.reverse_bytes -= VideoThreadPrivate::frameBytes(frame);
+    const qreal pts = frame.timestamp();
+    if (wait && d.reverse_pts > pts) {
+        const qreal speed = d.clock->speed() > 0 ? d.clock->speed() : 1.0;
+        const qreal delay = (d.reverse_pts - pts)/speed;
+        if (delay < 1.0)
+            waitAndCheck(d.statistics->video_only.alignToVSync(delay)*1000UL, pts);
+    }
+    d.reverse_pts = pts;
+    d.applyFilters(frame);
+    if (!deliverVideoFrame(frame))
+        return false;
+    d.clock->updateValue(pts);
+    d.statistics->count(Statistics::RenderedFrames);
+    d.statistics->video.current_time = QTime(0, 0, 0).addMSecs(int(pts * 1000.0));
+    d.setDisplayed(frame, d.statistics->video_only.frameDisplayed(pts));
+    if (d.reverse_seeking) {
+        d.reverse_seeking = false;
+        Q_EMIT seekFinished(qint64(pts*1000.0));
+    }
+    return true;
+}
+
 void VideoThread::run()
 {
     DPTR_D(VideoThread);
     if (!d.dec || !d.dec->isAvailable() || !d.outputSet)
         return;
+    d.thread_policy.apply();
     resetState();
     if (d.capture->autoSave()) {
         d.capture->setCaptureName(QFileInfo(d.statistics->url).completeBaseName());
@@ -258,6 +1068,14 @@ void VideoThread::run()
     //not neccesary context is managed by filters.
     d.filter_context = 0;
     VideoDecoder *dec = static_cast<VideoDecoder*>(d.dec);
+    if (d.owned_dec && d.owned_dec != dec) { // decoder was changed by user after last run
+        delete d.owned_dec;
+        d.owned_dec = 0;
+    }
+    if (dec != d.owned_dec)
+        d.primary_dec = dec;
+    d.clearPacketCache();
+    d.upgrade_interval = VideoThreadPrivate::kUpgradeIntervalMin;
     //used to initialize the decoder's frame size
     dec->resizeVideoFrame(0, 0);
     Packet pkt;
@@ -278,24 +1096,82 @@ void VideoThread::run()
     const int kNbSlowSkip = 120; // about 1s for 120fps video
     // kNbSlowFrameDrop: if video frame slow count > kNbSlowFrameDrop, skip decoding nonref frames. only some of ffmpeg based decoders support it.
     const int kNbSlowFrameDrop = 10;
+    // kTrickPlayLate: in key frame only mode, a key frame later than it (s) at normal speed is dropped before decoding
+    const qreal kTrickPlayLate = 0.1;
     bool sync_audio = d.clock->clockType() == AVClock::AudioClock;
     bool sync_video = d.clock->clockType() == AVClock::VideoClock; // no frame drop
     const qint64 start_time = QDateTime::currentMSecsSinceEpoch();
-    bool skip_render = false; // keep true if decoded frame does not reach desired time
+    bool skip_render = false; // the decoded frame is late and not displayed. only filters need every frame run on it
     qreal v_a = 0;
     const char* pkt_data = NULL; // workaround for libav9 decode fail but error code >= 0
+    qreal fallback_pts0 = -1; // frames of packets replayed by a fallback decoder are not rendered
+    // seamless loop: after a decode only packet, frames older than the last one are the pre-roll of the loop and not rendered
+    bool loop_preroll = false;
+    qreal last_pts = -1;
+    /* decode_lag: the decoded frame is older than the packet sent to decoder, e.g. frame threads hold 1 packet per thread
+     * and return the frame of the 1st packet. Waiting by packet dts makes frames late by the lag, which can be >1s if
+     * many threads are used for intra only codecs like prores. So compare the clock with dts - decode_lag
+     */
+    qreal decode_lag = 0;
+    bool keep_frame = false; // single frame is displayed
+    // frames delivered after filter stage are older than decoded frames by stage_lag
+    VideoFilterStage stage(&d);
+    VideoFilterStage *filter_stage = 0;
+    if (d.filter_stage_depth > 0 && !d.single_frame) {
+        filter_stage = &stage;
+        stage.start();
+    }
+    d.statistics->video_only.filter_stage_frames = 0;
+    VideoPresenter presenter(this, &d);
+    VideoPresenter *present = 0;
+    if (d.present_depth > 0 && !d.single_frame && d.force_fps <= 0) {
+        present = &presenter;
+        presenter.start();
+    }
+    int gpu_capacity = d.present_depth; // frames on gpu in present queue. reduced if the decoder runs out of surfaces
+    int surface_starvation = 0;
+    qreal stage_lag = 0;
+    qint64 trace_dequeue = 0, trace_decode = 0; // ns. trace_dequeue is set only for latency tracing
+    bool eof_decoded = false;
+    bool frames_left = false; // the last decoding got a frame. more frames of the packet may be left in the decoder
+    bool poster = d.fast_first_frame; // the 1st frame is not delivered yet
     while (true) {
         processNextTask();
         //TODO: why put it at the end of loop then playNextFrame() not work?
         //processNextTask tryPause(timeout) and  and continue outter loop
-        if (tryPause()) { //DO NOT continue, or playNextFrame() will fail
+        if (poster && !d.stop && !d.reverse) {
+            // the poster is displayed in paused state, like a step
+        } else if (tryPause()) { //DO NOT continue, or playNextFrame() will fail
 
         } else {
-            if (isPaused())
-                continue; //timeout. process pending tasks
+            if (isPaused()) {
+                // frame steps backward are displayed in paused state
+                if (d.reverse && d.reverse_steps.fetchAndAddOrdered(0) > 0) {
+                    if (present) // forward frames queued before reverse are stale
+                        present->flush();
+                    if (reverseStep(false))
+                        d.reverse_steps.deref();
+                }
+                continue; // a task or a step backward. process it and wait again
+            }
+        }
+        if (d.reverse) {
+            pkt = Packet();
+            if (d.stop)
+                break;
+            if (present)
+                present->flush();
+            reverseStep(true);
+            continue;
         }
         if(!pkt.isValid() && !pkt.isEOF()) { // can't seek back if eof packet is read
             pkt = d.packets.take(); //wait to dequeue
+            if (Statistics::isLatencyTracing())
+                trace_dequeue = Statistics::tracingTime();
+            d.statistics->count(Statistics::VideoBytes, pkt.data.size());
+            d.statistics->setVideoQueueSize(d.packets.size());
+            d.statistics->setMemoryUsage(Statistics::VideoPacketMemory, d.packets.bufferedBytes());
+            d.cachePacket(pkt);
         }
         if (pkt.isEOF()) {
             d.render_pts0 = -1;
@@ -312,6 +1188,19 @@ void VideoThread::run()
                 qDebug("Invalid packet! flush video codec context!!!!!!!!!! video packet queue size: %d", d.packets.size());  
                 d.dec->flush(); //d.dec instead of dec because d.dec maybe changed in processNextTask() but dec is not
                 d.render_pts0 = pkt.pts;
+                d.clearPacketCache();
+                fallback_pts0 = -1;
+                loop_preroll = false;
+                last_pts = -1;
+                d.clearReverse();
+                decode_lag = 0;
+                if (filter_stage)
+                    filter_stage->flush();
+                stage_lag = 0;
+                if (d.drop_policy)
+                    d.drop_policy->reset();
+                if (present)
+                    present->flush();
                 continue;
             }
         }
@@ -325,13 +1214,19 @@ void VideoThread::run()
             sync_audio = false;
             sync_video = false;
         }
+        // a copy, the policy can be replaced by a task while waiting
+        const FrameDropPolicyPtr policy(d.drop_policy);
         const qreal dts = pkt.dts; //FIXME: pts and dts
         // TODO: delta ref time
-        qreal diff = dts - d.clock->value() + v_a;
+        qreal diff = dts - decode_lag - stage_lag - d.clock->value() + v_a;
         if (pkt.isEOF())
             diff = qMin<qreal>(1.0, qMax<qreal>(d.delay, 1.0/d.statistics->video_only.currentDisplayFPS()));
-        if (diff < 0 && sync_video)
+        if (d.offline || (diff < 0 && sync_video))
             diff = 0; // this ensures no frame drop
+        if (pkt.isDecodeOnly) {
+            diff = 0; // decode as fast as possible. dts is of the previous loop
+            loop_preroll = true;
+        }
         if (diff > kSyncThreshold) {
             nb_dec_fast++;
         } else {
@@ -342,12 +1237,43 @@ void VideoThread::run()
             nb_dec_slow = 0;
             nb_dec_fast = 0;
         }
+        if (d.key_frame_only && !pkt.isEOF() && !pkt.isDecodeOnly) {
+            // trick play: key frames are far apart. pace them by the clock instead of the slow/fast heuristics below
+            nb_dec_slow = 0;
+            nb_dec_fast = 0;
+            const qreal speed = d.clock->speed() > 0 ? d.clock->speed() : 1.0;
+            if (!seeking && !d.offline) {
+                if (diff < -kTrickPlayLate*speed) { // decoding it costs more than showing the next one in time
+                    d.delay = 0;
+                    pkt = Packet();
+                    continue;
+                }
+                if (diff > 0)
+                    waitAndCheck(d.statistics->video_only.alignToVSync(diff/speed)*1000UL, dts);
+            }
+            diff = 0;
+        }
+        if (poster) // no wait or drop. the clock may not run yet
+            diff = 0;
         //qDebug("nb_fast: %d. diff: %f, dts: %f, clock: %f", nb_dec_fast, diff, dts, clock()->value());
-        if (d.delay < -0.5 && d.delay > diff) {
+        // the policy replaces the slow count heuristics. no drop if synced to video or in trick play
+        const bool use_policy = policy && !seeking && !sync_video && !d.offline && !d.key_frame_only && !poster;
+        const qreal frame_interval = d.frameInterval();
+        FrameDropPolicy::Decision drop = FrameDropPolicy::DecodeAll;
+        if (use_policy) {
+            if (!pkt.isEOF() && !pkt.isDecodeOnly)
+                drop = policy->decide(-diff, frame_interval, pkt.hasKeyFrame);
+            if (drop == FrameDropPolicy::DropToKeyFrame && !pkt.hasKeyFrame) {
+                qtavDebugLimited(LogVideo, 1000, "video is too late. skip decoding until next key frame. v-a: %.3f", diff);
+                wait_key_frame = true;
+                pkt = Packet();
+                continue;
+            }
+        } else if (d.delay < -0.5 && d.delay > diff) {
             if (!seeking) {
                 // ensure video will not later than 2s
                 if (diff < -2 || (nb_dec_slow > kNbSlowSkip && diff < -1.0 && !pkt.hasKeyFrame)) {
-                    qDebug("video is too slow. skip decoding until next key frame.");
+                    qtavDebugLimited(LogVideo, 1000, "video is too slow. skip decoding until next key frame.");
                     // TODO: when to reset so frame drop flag can reset?
                     nb_dec_slow = 0;
                     wait_key_frame = true;
@@ -356,12 +1282,12 @@ void VideoThread::run()
                     continue;
                 } else {
                     nb_dec_slow++;
-                    qDebug("frame slow count: %d. v-a: %.3f", nb_dec_slow, diff);
+                    qtavDebugLimited(LogVideo, 1000, "frame slow count: %d. v-a: %.3f", nb_dec_slow, diff);
                 }
             }
         } else {
             if (nb_dec_slow > kNbSlowFrameDrop) {
-                qDebug("decrease 1 slow frame: %d", nb_dec_slow);
+                qtavDebugLimited(LogVideo, 1000, "decrease 1 slow frame: %d", nb_dec_slow);
                 nb_dec_slow = qMax(0, nb_dec_slow-1); // nb_dec_slow < kNbSlowFrameDrop will reset decoder frame drop flag
             }
         }
@@ -371,24 +1297,25 @@ void VideoThread::run()
          *after seeking forward, a packet may be the old, v packet may be
          *the new packet, then the d.delay is very large, omit it.
         */
-        if (pkt.pts < d.render_pts0) // skip rendering until decoded frame reaches desired pts
-            skip_render = true;
+        // frames before render_pts0 are dropped after decoding, the others are displayed unless the video is too slow
+        skip_render = false;
         if (seeking)
             diff = 0; // TODO: here?
         if (!sync_audio && diff > 0) {
             // wait to dts reaches
-            if (d.force_fps < 0.0 && diff < 2.0)
-                waitAndCheck(diff*1000UL, dts); // TODO: count decoding and filter time
+            if (d.force_fps < 0.0 && diff < 2.0 && !present) // the presenter waits, decode ahead
+                waitAndCheck(d.statistics->video_only.alignToVSync(diff)*1000UL, dts); // TODO: count decoding and filter time
             diff = 0; // TODO: can not change delay!
         }
         // update here after wait
-        d.clock->updateVideoTime(dts); // FIXME: dts or pts?
+        if (!pkt.isDecodeOnly && !present) // updated by presenter
+            d.clock->updateVideoTime(dts); // FIXME: dts or pts?
         if (qAbs(diff) < 0.5) {
             if (diff < -kSyncThreshold) { //Speed up. drop frame?
                 //continue;
             }
         } else if (!seeking) { //when to drop off?
-            qDebug("delay %fs @%fs", diff, d.clock->value());
+            qtavDebugLimited(LogVideo, 1000, "delay %fs @%fs", diff, d.clock->value());
             if (diff < 0) {
                 if (!pkt.hasKeyFrame) {
                     // if continue without decoding, we must wait to the next key frame, then we may skip to many frames
@@ -396,7 +1323,7 @@ void VideoThread::run()
                     //pkt = Packet();
                     //continue;
                 }
-                skip_render = !pkt.hasKeyFrame;
+                skip_render = !use_policy && !pkt.hasKeyFrame; // the policy decides after decoding
                 if (skip_render) {
                     if (nb_dec_slow < kNbSlowSkip/2) {
                         skip_render = false;
@@ -405,21 +1332,22 @@ void VideoThread::run()
                         skip_render = nb_dec_slow % skip_every; // skip rendering every 3 frames
                     }
                 }
-            } else {
+            } else if (!present) {
                 const double s = qMin<qreal>(0.01*(nb_dec_fast>>1), diff);
-                qWarning("video too fast!!! sleep %.2f s, nb fast: %d, v_a: %.4f", s, nb_dec_fast, v_a);
+                qtavWarningLimited(LogVideo, 1000, "video too fast!!! sleep %.2f s, nb fast: %d, v_a: %.4f", s, nb_dec_fast, v_a);
                 waitAndCheck(s*1000UL, dts);
                 diff = 0;
             }
         }
         //audio packet not cleaned up?
-        if (diff > 0 && diff < 1.0 && !seeking) {
+        if (diff > 0 && diff < 1.0 && !seeking && !present) {
             // can not change d.delay here! we need it to comapre to next loop
-            waitAndCheck(diff*1000UL, dts);
+            // present at the vsync nearest to the due time instead of sleeping to the due time
+            waitAndCheck(d.statistics->video_only.alignToVSync(diff)*1000UL, dts);
         }
         if (wait_key_frame) {
             if (!pkt.hasKeyFrame) {
-                qDebug("waiting for key frame. queue size: %d. pkt.size: %d", d.packets.size(), pkt.data.size());
+                qtavDebugLimited(LogVideo, 1000, "waiting for key frame. queue size: %d. pkt.size: %d", d.packets.size(), pkt.data.size());
                 pkt = Packet();
                 continue;
             }
@@ -427,21 +1355,26 @@ void VideoThread::run()
         }
         QVariantHash *dec_opt_old = dec_opt;
         if (!seeking) { // MAYBE not seeking
-            if (nb_dec_slow < kNbSlowFrameDrop) {
+            if (use_policy) {
+                QVariantHash *opt = drop == FrameDropPolicy::DecodeAll ? &d.dec_opt_normal : &d.dec_opt_framedrop;
+                if (dec_opt != opt)
+                    qtavDebug(LogVideo, "frame drop policy: %s", drop == FrameDropPolicy::DecodeAll ? "normal" : "noref");
+                dec_opt = opt;
+            } else if (nb_dec_slow < kNbSlowFrameDrop) {
                 if (dec_opt == &d.dec_opt_framedrop) {
-                    qDebug("frame drop normal. nb_dec_slow: %d, line: %d", nb_dec_slow, __LINE__);
+                    qtavDebug(LogVideo, "frame drop normal. nb_dec_slow: %d", nb_dec_slow);
                     dec_opt = &d.dec_opt_normal;
                 }
             } else {
                 if (dec_opt == &d.dec_opt_normal) {
-                    qDebug("frame drop noref. nb_dec_slow: %d, line: %d", nb_dec_slow, __LINE__);
+                    qtavDebug(LogVideo, "frame drop noref. nb_dec_slow: %d", nb_dec_slow);
                     dec_opt = &d.dec_opt_framedrop;
                 }
             }
         } else { // seeking
             if (seek_count > 0) {
                 if (dec_opt == &d.dec_opt_normal) {
-                    qDebug("seeking... frame drop noref. nb_dec_slow: %d, line: %d", nb_dec_slow, __LINE__);
+                    qtavDebug(LogVideo, "seeking... frame drop noref. nb_dec_slow: %d", nb_dec_slow);
                     dec_opt = &d.dec_opt_framedrop;
                 }
             } else {
@@ -452,29 +1385,69 @@ void VideoThread::run()
         // decoder maybe changed in processNextTask(). code above MUST use d.dec but not dec
         if (dec != static_cast<VideoDecoder*>(d.dec)) {
             dec = static_cast<VideoDecoder*>(d.dec);
+            if (dec != d.owned_dec) { // changed by user
+                if (d.owned_dec) {
+                    delete d.owned_dec;
+                    d.owned_dec = 0;
+                }
+                d.primary_dec = dec;
+                d.upgrade_interval = VideoThreadPrivate::kUpgradeIntervalMin;
+            }
+            d.dec_errors = 0;
             if (!pkt.hasKeyFrame) {
                 wait_key_frame = true;
                 continue;
             }
             qDebug("decoder changed. decoding key frame");
+        } else if (pkt.hasKeyFrame && dec != d.primary_dec && d.fallback_enabled && !seeking
+                   && QDateTime::currentMSecsSinceEpoch() >= d.upgrade_time) {
+            // a key frame can be decoded by any decoder. try decoders of higher priority
+            VideoDecoder *vd = switchDecoder(dec, true);
+            if (vd)
+                dec = vd;
+            else
+                d.upgrade_time = QDateTime::currentMSecsSinceEpoch() + d.upgrade_interval;
         }
         if (dec_opt != dec_opt_old)
             dec->setOptions(*dec_opt);
-        if (!dec->decode(pkt)) {
-            qWarning("Decode video failed. undecoded: %d", dec->undecodedSize());
+        trace_decode = Statistics::tracingTime(); // for decode time statistics too
+        bool dec_ok = false;
+        bool received = false; // a frame left in the decoder is taken. pkt is not decoded yet
+        {
+            TraceRecorder::Span span("decode", "video");
+            if (frames_left)
+                received = dec->receiveFrame();
+            dec_ok = received || dec->decode(pkt);
+        }
+        frames_left = dec_ok;
+        if (!dec_ok) {
+            qtavWarningLimited(LogVideo, 1000, "Decode video failed. undecoded: %d", dec->undecodedSize());
             if (pkt.isEOF()) {
                 qDebug("decode eof done");
+                eof_decoded = true;
                 break;
             }
+            if (d.fallback_enabled && ++d.dec_errors >= VideoThreadPrivate::kMaxDecodeErrors) {
+                if (!d.gop_valid)
+                    wait_key_frame = true; // new decoder must start from a key frame
+                VideoDecoder *vd = switchDecoder(dec, false);
+                if (vd) {
+                    dec = vd;
+                    fallback_pts0 = pkt.pts;
+                }
+                d.dec_errors = 0;
+            }
             pkt = Packet();
             continue;
         }
         // reduce here to ensure to decode the rest data in the next loop
-        if (!pkt.isEOF())
+        if (!pkt.isEOF() && !received)
             pkt.data = QByteArray::fromRawData(pkt.data.constData() + pkt.data.size() - dec->undecodedSize(), dec->undecodedSize());
         VideoFrame frame = dec->frame();
         if (!frame.isValid()) {
-            qWarning("invalid video frame from decoder. undecoded data size: %d", pkt.data.size());
+            qtavWarningLimited(LogVideo, 1000, "invalid video frame from decoder. undecoded data size: %d", pkt.data.size());
+            if (received)
+                continue;
             if (pkt_data == pkt.data.constData()) //FIXME: for libav9. what about other versions?
                 pkt = Packet();
             else
@@ -482,14 +1455,60 @@ void VideoThread::run()
             continue;
         }
         pkt_data = pkt.data.constData();
+        d.dec_errors = 0;
+        d.statistics->count(Statistics::DecodedFrames);
+        {
+            const qint64 decode_ns = Statistics::tracingTime() - trace_decode;
+            d.countPictureType(frame, decode_ns);
+            if (policy)
+                policy->frameDecoded(VideoThreadPrivate::pictureType(frame), decode_ns/1000LL);
+        }
+        if (Statistics::isLatencyTracing()) {
+            // a frame is attributed to the packet finishing it. decoder delay is counted in the decode stage
+            const qint64 now = Statistics::tracingTime();
+            Statistics::Common &st = d.statistics->video;
+            st.addLatency(Statistics::LatencyDemux, pkt.demuxTime, pkt.enqueueTime);
+            st.addLatency(Statistics::LatencyQueue, pkt.enqueueTime, trace_dequeue);
+            st.addLatency(Statistics::LatencyWait, trace_dequeue, trace_decode);
+            st.addLatency(Statistics::LatencyDecode, trace_decode, now);
+            frame.setSideData(Frame::DemuxTime, pkt.demuxTime);
+            frame.setSideData(Frame::DecodedTime, now);
+            frame.setSideData(Frame::DecodeDuration, (now - trace_decode)/1000LL); // us. for renderer frame timing
+        }
+        d.statistics->video_only.surface_starvation = dec->surfaceStarvation();
+        d.statistics->setMemoryUsage(Statistics::SurfaceMemory, dec->surfaceMemory());
+        if (frame.hasHostData()) {
+            // the decoded frame, frames in the filter stage and the one displayed by the renderer
+            qint64 bytes = 0;
+            for (int i = 0; i < frame.planeCount(); ++i)
+                bytes += qint64(frame.bytesPerLine(i))*frame.planeHeight(i);
+            d.statistics->setMemoryUsage(Statistics::VideoFrameMemory, bytes*(2 + d.statistics->video_only.filter_stage_frames + (present ? present->pending() : 0)));
+        } else {
+            d.statistics->setMemoryUsage(Statistics::VideoFrameMemory, 0);
+        }
         if (frame.timestamp() <= 0)
             frame.setTimestamp(pkt.pts); // pkt.pts is wrong. >= real timestamp
         const qreal pts = frame.timestamp();
+        if (!pkt.isEOF()) {
+            const qreal lag = dts - pts;
+            if (qAbs(lag) > 2.0) // timestamp discontinuity
+                decode_lag = 0;
+            else // lag < 0 if b frames are reordered without decode delay
+                decode_lag = (decode_lag*7.0 + qMax<qreal>(0.0, lag))/8.0;
+        }
+        if (fallback_pts0 >= 0.0) {
+            if (pts < fallback_pts0) // delayed frame of replayed packets
+                continue;
+            fallback_pts0 = -1;
+        }
+        if (loop_preroll && pts < last_pts)
+            continue;
+        last_pts = pts;
         // seek finished because we can ensure no packet before seek decoded when render_pts0 is set
         //qDebug("pts0: %f, pts: %f", d.render_pts0, pts);
         if (d.render_pts0 >= 0.0) {
             if (pts < d.render_pts0) {
-                if (!pkt.isEOF())
+                if (!pkt.isEOF() && !received)
                     pkt = Packet();
                 continue;
             }
@@ -502,7 +1521,33 @@ void VideoThread::run()
         }
         Q_ASSERT(d.statistics);
         d.statistics->video.current_time = QTime(0, 0, 0).addMSecs(int(pts * 1000.0)); //TODO: is it expensive?
-        applyFilters(frame);
+        if (use_policy && !pkt.isDecodeOnly)
+            skip_render = !policy->render(VideoThreadPrivate::pictureType(frame), d.clock->value() - pts, frame_interval);
+        if (filter_stage) {
+            filter_stage->put(frame, skip_render);
+            // deliver a filtered frame if ready. wait for it only if the stage is full
+            const bool got = filter_stage->take(&frame, poster || filter_stage->pending() > d.filter_stage_depth, &skip_render);
+            d.statistics->video_only.filter_stage_frames = filter_stage->pending();
+            if (!got)
+                continue;
+            const qreal lag = pts - frame.timestamp();
+            if (qAbs(lag) > 2.0)
+                stage_lag = 0;
+            else
+                stage_lag = (stage_lag*7.0 + qMax<qreal>(0.0, lag))/8.0;
+        } else {
+            d.applyFilters(frame, skip_render);
+        }
+        if (skip_render) { // filters requiring every frame have seen it
+            d.statistics->count(Statistics::DroppedFrames);
+            continue;
+        }
+        if (Statistics::isLatencyTracing()) {
+            // metadata travels with the frame through the filter stage thread
+            const qint64 now = Statistics::tracingTime();
+            d.statistics->video.addLatency(Statistics::LatencyFilter, frame.sideData(Frame::DecodedTime), now);
+            frame.setSideData(Frame::FilteredTime, now);
+        }
 
         //while can pause, processNextTask, not call outset.puase which is deperecated
         while (d.outputSet->canPauseThread()) {
@@ -512,7 +1557,7 @@ void VideoThread::run()
         }
         if (d.force_dt > 0) {
             const qint64 now = QDateTime::currentMSecsSinceEpoch();
-            const qint64 delta = qint64(d.force_dt) - (now - d.last_deliver_time);
+            const qint64 delta = qint64(d.force_dt) - (now - d.lastDeliverTime());
             if (frame.timestamp() <= 0) {
                 // TODO: what if seek happens during playback?
                 const int msecs_started(now + qMax(0LL, delta) - start_time);
@@ -543,12 +1588,46 @@ void VideoThread::run()
                     waitAndCheck(display_wait*1000UL, pts); // TODO: count decoding and filter time
             }
         }
+        if (present) {
+            // surfaces held by queued frames are not available to the decoder
+            const int starvation = dec->surfaceStarvation();
+            if (starvation > surface_starvation && gpu_capacity > 1) {
+                --gpu_capacity;
+                qDebug("decoder surfaces are not enough. frames on gpu in present queue: %d", gpu_capacity);
+            }
+            surface_starvation = starvation;
+            while (!present->put(frame, seeking || d.offline || poster, d.present_depth, gpu_capacity, 20) && !d.stop)
+                processNextTask();
+            poster = false;
+            startClock();
+            continue;
+        }
         // no return even if d.stop is true. ensure frame is displayed. otherwise playing an image may be failed to display
         if (!deliverVideoFrame(frame))
             continue;
-        d.last_deliver_time = d.statistics->video_only.frameDisplayed(frame.timestamp());
+        poster = false;
+        startClock();
+        d.statistics->count(Statistics::RenderedFrames);
+        if (!seeking && frame.timestamp() < d.clock->value() - 0.04)
+            d.statistics->count(Statistics::LateFrames);
         // TODO: store original frame. now the frame is filtered and maybe converted to renderer perferred format
-        d.displayed_frame = frame;
+        d.setDisplayed(frame, d.statistics->video_only.frameDisplayed(frame.timestamp()));
+        if (d.single_frame) {
+            qDebug("single frame is displayed. video thread stops");
+            keep_frame = true;
+            break;
+        }
+        // frame is still interlaced if no filter or conversion for renderer changed it
+        if (d.field_rate && frame.isInterlaced() && !seeking) {
+            const qreal fps = d.statistics->video.frame_rate;
+            VideoFrame field(frame.secondField());
+            field.setTimestamp(frame.timestamp() + (fps > 0 ? 0.5/fps : 0.02));
+            const qreal delay = field.timestamp() - (sync_video ? frame.timestamp() : d.clock->value());
+            if (delay > 0 && delay < 1.0 && !d.offline)
+                waitAndCheck(d.statistics->video_only.alignToVSync(delay)*1000UL, field.timestamp());
+            if (deliverVideoFrame(field))
+                d.setDisplayed(VideoFrame(), d.statistics->video_only.frameDisplayed(field.timestamp()));
+        }
         if (d.clock->clockType() == AVClock::AudioClock) {
             const qreal v_a_ = frame.timestamp() - d.clock->value();
             if (!qFuzzyIsNull(v_a_)) {
@@ -575,8 +1654,38 @@ void VideoThread::run()
             //qDebug("v_a:%.4f, v_a_: %.4f", v_a, v_a_);
         }
     }
+    if (filter_stage) {
+        // display the frames still in filter stage at the end of stream
+        VideoFrame frame;
+        bool skipped = false;
+        while (eof_decoded && !d.stop && filter_stage->take(&frame, true, &skipped)) {
+            if (skipped)
+                continue;
+            if (present) {
+                while (!present->put(frame, false, d.present_depth, gpu_capacity, 20) && !d.stop) {}
+                continue;
+            }
+            const qreal delay = frame.timestamp() - (sync_video ? d.displayedFrame().timestamp() : d.clock->value());
+            if (delay > 0 && delay < 1.0 && !d.offline)
+                waitAndCheck(delay*1000UL, frame.timestamp());
+            if (sync_video)
+                d.clock->updateVideoTime(frame.timestamp());
+            if (!deliverVideoFrame(frame))
+                continue;
+            d.setDisplayed(frame, d.statistics->video_only.frameDisplayed(frame.timestamp()));
+        }
+        filter_stage->finish();
+        d.statistics->video_only.filter_stage_frames = 0;
+    }
+    if (present) {
+        // display the queued frames at the end of stream
+        if (eof_decoded)
+            present->drain(&d.stop);
+        present->finish();
+    }
     d.packets.clear();
-    d.outputSet->sendVideoFrame(VideoFrame()); // TODO: let user decide what to display
+    if (!keep_frame && !d.keep_last_frame)
+        d.outputSet->sendVideoFrame(VideoFrame()); // TODO: let user decide what to display
     qDebug("Video thread stops running...");
 }
 
@@ -25,7 +25,10 @@
 
 #include "AVThread.h"
 #include <QtCore/QSize>
+#include <QtAV/VideoDecoderTypes.h>
+#include <QtAV/FrameDropPolicy.h>
 
+struct AVCodecContext;
 namespace QtAV {
 
 class VideoCapture;
@@ -35,17 +38,96 @@ class VideoThread : public AVThread
 {
     Q_OBJECT
     DPTR_DECLARE_PRIVATE(VideoThread)
+    friend class VideoPresenter; // deliverVideoFrame()
 public:
     explicit VideoThread(QObject *parent = 0);
     VideoCapture *setVideoCapture(VideoCapture* cap); //ensure thread safe
     VideoCapture *videoCapture() const;
     VideoFrame displayedFrame() const;
     void setFrameRate(qreal value);
+    /*!
+     * \brief setSingleFrame
+     * Stop running after the first frame is displayed, and keep it displayed. e.g. cover art of music. Set before start()
+     */
+    void setSingleFrame(bool value);
+    /*!
+     * \brief setKeepLastFrame
+     * Keep the last frame displayed when stopped instead of clearing the renderers, e.g. the next media will be played at once.
+     */
+    void setKeepLastFrame(bool value);
+    /*!
+     * \brief setFilterStage
+     * Run the filters in a separate thread, so decoding overlaps filtering and a slow filter does not slow down decoding.
+     * Filters must not depend on the thread they run in. Not used in single frame mode. Set before start()
+     * \param frames max frames decoded but not delivered yet. 0: filters run in video thread (default)
+     */
+    void setFilterStage(int frames);
+    int filterStage() const;
+    /// scheduling of the filter stage thread. thread_policy() of the video thread is used by the presenter. Set before start()
+    void setFilterThreadPolicy(const ThreadPolicy& policy);
+    /*!
+     * \brief setPresentQueue
+     * Decode ahead of presentation. Decoded frames are queued and a presenter thread delivers each one at its due time, so
+     * the variable cost of decoding (e.g. a key frame) does not delay presentation. Frames on gpu are limited to fewer than
+     * frames if the decoder runs out of surfaces. Not used in single frame mode or with a forced frame rate. Set before start()
+     * \param frames queue depth, 2~4 is enough. 0: frames are presented by video thread (default)
+     */
+    void setPresentQueue(int frames);
+    int presentQueue() const;
+    /*!
+     * \brief setFieldRate
+     * Deliver an interlaced frame twice, the second field (VideoFrame::secondField()) is delivered in the middle of 2
+     * frames, so renderers deinterlacing in shader display at field rate. Set before start()
+     */
+    void setFieldRate(bool value);
+    /*!
+     * \brief setFastFirstFrame
+     * Deliver the first decoded frame at once as a poster, without waiting for the clock, frame drop, filter stage or present
+     * queue, even if the thread is paused. Later frames are synchronized as usual. Set before start()
+     */
+    void setFastFirstFrame(bool value);
+    /*!
+     * \brief setReverse
+     * Display video backward. Packets are GOPs queued by AVDemuxThread::setReverse(), each ends with an eof packet. A GOP is
+     * decoded into a cache and displayed from the last frame, paced by timestamps and clock speed, and the clock is updated
+     * by displayed frames. Frames of decode only packets are not cached. Filter stage and field rate output are not used.
+     * \param cacheBytes max bytes of cached frames of a GOP. If exceeded, every other frame is dropped. <=0: no limit
+     * \param maxSize frames larger than it are scaled down before cached. invalid: original size
+     */
+    void setReverse(bool value, qint64 cacheBytes = 0, const QSize& maxSize = QSize());
+    bool isReverse() const;
+    /// display the previous frame in reverse mode when paused
+    void stepBackward();
+    /*!
+     * \brief setKeyFrameOnly
+     * Trick play. Packets are key frames forwarded by AVDemuxThread::setKeyFrameOnly(). A frame is displayed when the clock
+     * reaches it, and a frame already late is dropped without decoding, so the cost does not grow with clock speed. Slow
+     * decoding heuristics and decoder frame drop are not used. Thread safe
+     */
+    void setKeyFrameOnly(bool value);
+    bool isKeyFrameOnly() const;
+    /*!
+     * \brief setFrameDropPolicy
+     * Decide frames to drop by the policy instead of the built-in slow count heuristics. Null: the heuristics
+     */
+    void setFrameDropPolicy(const FrameDropPolicyPtr& policy);
     //virtual bool event(QEvent *event);
     void setBrightness(int val);
     void setContrast(int val);
     void setSaturation(int val);
     void setEQ(int b, int c, int s);
+    /*!
+     * \brief setDecoderFallback
+     * If the current decoder fails to decode several packets in a row (e.g. a hardware decoder after a driver reset or a
+     * resolution its surfaces do not support), the next decoder after it in ids is opened in video thread and fed from the
+     * last key frame, so playback continues without stop and seek. Decoders before the current one are tried again at key
+     * frames later to upgrade back.
+     * The decoder set by setDecoder() is owned by the caller, and a switched in decoder is owned by video thread.
+     * \param ids decoder priority, usually the same as AVPlayer::videoDecoderPriority(). empty: disable fallback
+     * \param avctx codec context to open new decoders, e.g. AVDemuxer::videoCodecContext(). must be valid while running
+     * \param options options of new decoders
+     */
+    void setDecoderFallback(const QVector<VideoDecoderId>& ids, AVCodecContext* avctx, const QVariantHash& options = QVariantHash());
 
 public Q_SLOTS:
     void addCaptureTask();
@@ -54,6 +136,20 @@ protected:
     // deliver video frame to video renderers. frame may be converted to a suitable format for renderer
     bool deliverVideoFrame(VideoFrame &frame);
     virtual void run();
+    /*!
+     * \brief switchDecoder
+     * Open a decoder in fallback list after (upgrade is false) or before (upgrade is true) current decoder and replace
+     * current decoder. Cached packets since last key frame are decoded by the new decoder if upgrade is false
+     * \return the new decoder, or null if no decoder can be opened
+     */
+    VideoDecoder* switchDecoder(VideoDecoder* current, bool upgrade);
+    /*!
+     * \brief reverseStep
+     * Display the last cached frame in reverse mode. The next GOP is decoded if the cache is empty.
+     * \param wait block to take packets, and wait for the frame due time
+     * \return false if no frame is displayed
+     */
+    bool reverseStep(bool wait);
     // wait for value msec. every usleep is a small time, then process next task and get new delay
 };
 
@@ -0,0 +1,372 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/VideoWallManager.h"
+#include <algorithm>
+#include <QtCore/QPointer>
+#include <QtCore/QTimerEvent>
+#include <QtCore/QVector>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QtGui/QWindow>
+#endif
+#include "QtAV/AVClock.h"
+#include "QtAV/AVPlayer.h"
+#include "QtAV/VideoRenderer.h"
+#include "utils/Logger.h"
+
+namespace QtAV {
+namespace {
+// a tier is changed if it's wanted for the number of polls
+static const int kStablePolls = 2;
+
+QSize visibleRendererSize(VideoRenderer *vo)
+{
+    const QSize s(vo->rendererSize());
+    if (!s.isValid() || s.isEmpty()) // not shown yet
+        return QSize(0, 0);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    // e.g. minimized or covered on platforms reporting it. widgets and quick items report by setVisibleSize()
+    QWindow *w = vo->qwindow();
+    if (w && !w->isExposed())
+        return QSize(0, 0);
+#endif
+    return s;
+}
+
+// weight of the decoder in DecodeThreadScheduler. applied when the decoder is opened
+void setDecoderPriority(AVPlayer *player, int priority)
+{
+    const QString kPriority(QStringLiteral("priority"));
+    QVariantHash opt(player->optionsForVideoCodec());
+    // the same as AVPlayer's battery saver: properties are top level if no "FFmpeg" key
+    const QString name(opt.contains(QStringLiteral("FFmpeg")) ? QStringLiteral("FFmpeg") : QStringLiteral("ffmpeg"));
+    if (opt.contains(name)) {
+        QVariantHash ffmpeg(opt.value(name).toHash());
+        if (ffmpeg.value(kPriority) == priority)
+            return;
+        ffmpeg[kPriority] = priority;
+        opt[name] = ffmpeg;
+    } else {
+        if (opt.value(kPriority) == priority)
+            return;
+        opt[kPriority] = priority;
+    }
+    player->setOptionsForVideoCodec(opt);
+}
+
+struct TileArea {
+    int index;
+    qint64 area;
+    bool operator<(const TileArea& other) const { return area > other.area;} // larger first
+};
+} //namespace
+
+class VideoWallManager::Private
+{
+public:
+    struct Tile {
+        Tile(AVPlayer *p = 0)
+            : player(p)
+            , size(0, 0)
+            , tier(FullDecode)
+            , pending(FullDecode)
+            , pending_polls(0)
+            , paused(false)
+            , reduced(p ? p->isReducedResolutionDecode() : false)
+        {}
+        AVPlayer *player; // not deref after destroyed
+        QSize user_size; // invalid: polled
+        QSize size;
+        Tier tier; // applied tier
+        Tier pending; // wanted in the last polls
+        int pending_polls;
+        bool paused; // paused by the wall
+        bool reduced; // setting before added
+    };
+    Private()
+        : focus(0)
+        , max_decoders(0)
+        , interval(500)
+        , timer_id(0)
+    {}
+    int indexOf(const AVPlayer *player) const {
+        for (int i = 0; i < tiles.size(); ++i) {
+            if (tiles[i].player == player)
+                return i;
+        }
+        return -1;
+    }
+    void pollSize(Tile *t) {
+        if (t->user_size.isValid()) {
+            t->size = t->user_size;
+            return;
+        }
+        QSize s(0, 0);
+        foreach (VideoRenderer *vo, t->player->videoOutputs()) {
+            const QSize vs(visibleRendererSize(vo));
+            if (qint64(vs.width())*vs.height() > qint64(s.width())*s.height())
+                s = vs;
+        }
+        t->size = s;
+    }
+    // immediate: apply a wanted tier without waiting for stable polls
+    void update(VideoWallManager *q, bool immediate);
+    void apply(VideoWallManager *q, Tile *t, Tier tier);
+
+    QList<Tile> tiles;
+    AVPlayer *focus;
+    int max_decoders;
+    int interval;
+    int timer_id;
+    QPointer<AVClock> clock;
+};
+
+void VideoWallManager::Private::update(VideoWallManager *q, bool immediate)
+{
+    QVector<Tier> wanted(tiles.size(), Paused);
+    QVector<TileArea> visible;
+    int decoders = 0;
+    for (int i = 0; i < tiles.size(); ++i) {
+        Tile &t = tiles[i];
+        pollSize(&t);
+        if (t.size.isEmpty())
+            continue;
+        if (t.player == focus) {
+            wanted[i] = FullDecode;
+            ++decoders;
+            continue;
+        }
+        TileArea a;
+        a.index = i;
+        a.area = qint64(t.size.width())*t.size.height();
+        visible.append(a);
+    }
+    std::sort(visible.begin(), visible.end());
+    foreach (const TileArea& a, visible) {
+        if (max_decoders <= 0 || decoders < max_decoders) {
+            wanted[a.index] = ReducedDecode;
+            ++decoders;
+        } else {
+            wanted[a.index] = KeyFrameDecode;
+        }
+    }
+    for (int i = 0; i < tiles.size(); ++i) {
+        Tile &t = tiles[i];
+        // a stopped player is not changed, e.g. still loading
+        if (!t.player->isPlaying())
+            continue;
+        if (wanted[i] == t.tier) {
+            t.pending_polls = 0;
+            continue;
+        }
+        if (wanted[i] == t.pending) {
+            ++t.pending_polls;
+        } else {
+            t.pending = wanted[i];
+            t.pending_polls = 1;
+        }
+        if (immediate || t.pending_polls >= kStablePolls)
+            apply(q, &t, wanted[i]);
+    }
+}
+
+void VideoWallManager::Private::apply(VideoWallManager *q, Tile *t, Tier tier)
+{
+    AVPlayer *player = t->player;
+    qDebug("video wall tier %d => %d: %dx%d", t->tier, tier, t->size.width(), t->size.height());
+    t->tier = tier;
+    t->pending_polls = 0;
+    setDecoderPriority(player, tier == FullDecode ? 2 : (tier == ReducedDecode ? 1 : 0));
+    if (tier == Paused) {
+        // keep the user's pause
+        if (!player->isPaused()) {
+            player->pause(true);
+            t->paused = true;
+        }
+        Q_EMIT q->tierChanged(player, tier);
+        return;
+    }
+    player->setKeyFrameOnlyDecode(tier == KeyFrameDecode);
+    // reopens the decoder at the new size if needed
+    player->setReducedResolutionDecode(tier != FullDecode);
+    if (t->paused) {
+        t->paused = false;
+        player->pause(false);
+        // continue at the clock position instead of decoding the frames since paused
+        if (!player->isLiveMode() && player->isSeekable())
+            player->seek(player->position());
+    }
+    Q_EMIT q->tierChanged(player, tier);
+}
+
+VideoWallManager::VideoWallManager(QObject *parent)
+    : QObject(parent)
+    , d(new Private())
+{
+    d->timer_id = startTimer(d->interval);
+}
+
+VideoWallManager::~VideoWallManager()
+{
+    while (!d->tiles.isEmpty())
+        removePlayer(d->tiles.last().player);
+    delete d;
+}
+
+void VideoWallManager::addPlayer(AVPlayer *player)
+{
+    if (!player || d->indexOf(player) >= 0)
+        return;
+    d->tiles.append(Private::Tile(player));
+    connect(player, SIGNAL(destroyed(QObject*)), SLOT(onPlayerDestroyed(QObject*)));
+    if (d->clock)
+        player->masterClock()->setReferenceClock(d->clock);
+}
+
+void VideoWallManager::removePlayer(AVPlayer *player)
+{
+    const int i = d->indexOf(player);
+    if (i < 0)
+        return;
+    const Private::Tile t(d->tiles.takeAt(i));
+    disconnect(player, 0, this, 0);
+    if (d->focus == player)
+        d->focus = 0;
+    setDecoderPriority(player, 1);
+    player->setKeyFrameOnlyDecode(false);
+    player->setReducedResolutionDecode(t.reduced);
+    if (t.paused)
+        player->pause(false);
+    if (d->clock)
+        player->masterClock()->setReferenceClock(0);
+}
+
+QList<AVPlayer*> VideoWallManager::players() const
+{
+    QList<AVPlayer*> ps;
+    foreach (const Private::Tile& t, d->tiles) {
+        ps.append(t.player);
+    }
+    return ps;
+}
+
+void VideoWallManager::setVisibleSize(AVPlayer *player, const QSize &size)
+{
+    const int i = d->indexOf(player);
+    if (i < 0)
+        return;
+    d->tiles[i].user_size = size;
+}
+
+QSize VideoWallManager::visibleSize(AVPlayer *player) const
+{
+    const int i = d->indexOf(player);
+    if (i < 0)
+        return QSize();
+    return d->tiles[i].size;
+}
+
+void VideoWallManager::setFocusPlayer(AVPlayer *player)
+{
+    if (d->focus == player)
+        return;
+    d->focus = d->indexOf(player) >= 0 ? player : 0;
+    d->update(this, true);
+}
+
+AVPlayer* VideoWallManager::focusPlayer() const
+{
+    return d->focus;
+}
+
+void VideoWallManager::setMaxDecoders(int value)
+{
+    d->max_decoders = value;
+}
+
+int VideoWallManager::maxDecoders() const
+{
+    return d->max_decoders;
+}
+
+void VideoWallManager::setInterval(int ms)
+{
+    if (d->interval == ms)
+        return;
+    d->interval = ms;
+    killTimer(d->timer_id);
+    d->timer_id = startTimer(ms);
+}
+
+int VideoWallManager::interval() const
+{
+    return d->interval;
+}
+
+void VideoWallManager::setClock(AVClock *clock)
+{
+    if (d->clock == clock)
+        return;
+    d->clock = clock;
+    foreach (const Private::Tile& t, d->tiles) {
+        t.player->masterClock()->setReferenceClock(clock);
+    }
+}
+
+AVClock* VideoWallManager::clock() const
+{
+    return d->clock;
+}
+
+VideoWallManager::Tier VideoWallManager::tier(AVPlayer *player) const
+{
+    const int i = d->indexOf(player);
+    if (i < 0)
+        return FullDecode;
+    return d->tiles[i].tier;
+}
+
+void VideoWallManager::update()
+{
+    d->update(this, true);
+}
+
+void VideoWallManager::timerEvent(QTimerEvent *e)
+{
+    if (e->timerId() != d->timer_id) {
+        QObject::timerEvent(e);
+        return;
+    }
+    d->update(this, false);
+}
+
+void VideoWallManager::onPlayerDestroyed(QObject *obj)
+{
+    // the player is being destroyed, do not restore its settings
+    const int i = d->indexOf(static_cast<AVPlayer*>(obj));
+    if (i < 0)
+        return;
+    if (d->focus == d->tiles[i].player)
+        d->focus = 0;
+    d->tiles.removeAt(i);
+}
+
+} //namespace QtAV
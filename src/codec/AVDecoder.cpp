@@ -21,6 +21,7 @@
 
 #include <QtAV/AVDecoder.h>
 #include <QtAV/private/AVDecoder_p.h>
+#include <QtAV/Packet.h>
 #include <QtAV/version.h>
 #include "utils/internal.h"
 #include "utils/Logger.h"
@@ -137,6 +138,11 @@ void AVDecoder::flush()
     avcodec_flush_buffers(d_func().codec_ctx);
 }
 
+bool AVDecoder::receiveFrame()
+{
+    return false;
+}
+
 /*
  * do nothing if equal
  * close the old one. the codec context can not be shared in more than 1 decoder.
@@ -249,6 +255,39 @@ void AVDecoderPrivate::applyOptionsForDict()
     Internal::setOptionsToDict(options.value(QStringLiteral("avcodec")), &dict);
 }
 
+int AVDecoderPrivate::sendReceive(const Packet &packet, AVFrame *frame)
+{
+    undecoded_size = 0;
+#if QTAV_HAVE(SEND_RECEIVE)
+    // a null packet enters draining mode
+    const AVPacket *pkt = packet.isEOF() ? NULL : packet.asAVPacket();
+    int ret = avcodec_send_packet(codec_ctx, pkt);
+    if (ret == AVERROR(EAGAIN)) {
+        // output is full because frames were not taken by receiveFrame(). take one, then the packet may be accepted
+        ret = avcodec_receive_frame(codec_ctx, frame);
+        if (ret < 0)
+            return ret;
+        const int sent = avcodec_send_packet(codec_ctx, pkt);
+        if (sent == AVERROR(EAGAIN))
+            undecoded_size = packet.data.size();
+        else if (sent < 0 && sent != AVERROR_EOF) // the frame is still returned. the packet is lost
+            qWarning("avcodec_send_packet error: %s", av_err2str(sent));
+        return 1;
+    }
+    // AVERROR_EOF: already draining, e.g. the eof packet is decoded again
+    if (ret < 0 && ret != AVERROR_EOF)
+        return ret;
+    ret = avcodec_receive_frame(codec_ctx, frame);
+    if (ret == AVERROR(EAGAIN))
+        return 0;
+    return ret < 0 ? ret : 1;
+#else
+    Q_UNUSED(packet);
+    Q_UNUSED(frame);
+    return AVERROR(ENOSYS);
+#endif //QTAV_HAVE(SEND_RECEIVE)
+}
+
 void AVDecoderPrivate::applyOptionsForContext()
 {
     if (!codec_ctx)
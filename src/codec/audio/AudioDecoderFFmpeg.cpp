@@ -48,6 +48,7 @@ public:
     }
     bool decode(const QByteArray &encoded) Q_DECL_FINAL;
     bool decode(const Packet& packet) Q_DECL_FINAL;
+    bool receiveFrame() Q_DECL_FINAL;
     AudioFrame frame() Q_DECL_FINAL;
 Q_SIGNALS:
     void codecNameChanged();
@@ -96,6 +97,16 @@ bool AudioDecoderFFmpeg::decode(const Packet &packet)
         return false;
     DPTR_D(AudioDecoderFFmpeg);
     d.decoded.clear();
+#if QTAV_HAVE(SEND_RECEIVE)
+    const int ret = d.sendReceive(packet, d.frame);
+    if (ret == 0)
+        return !packet.isEOF();
+    if (ret < 0) {
+        if (ret != AVERROR_EOF)
+            qWarning("[AudioDecoder] %s", av_err2str(ret));
+        return false;
+    }
+#else
     int got_frame_ptr = 0;
     int ret = 0;
     if (packet.isEOF()) {
@@ -120,6 +131,7 @@ bool AudioDecoderFFmpeg::decode(const Packet &packet)
         qWarning("[AudioDecoder] got_frame_ptr=false. decoded: %d, un: %d", ret, d.undecoded_size);
         return !packet.isEOF();
     }
+#endif //QTAV_HAVE(SEND_RECEIVE)
 #if USE_AUDIO_FRAME
     return true;
 #endif
@@ -132,6 +144,29 @@ bool AudioDecoderFFmpeg::decode(const Packet &packet)
     return !d.decoded.isEmpty();
 }
 
+bool AudioDecoderFFmpeg::receiveFrame()
+{
+#if QTAV_HAVE(SEND_RECEIVE)
+    if (!isAvailable())
+        return false;
+    DPTR_D(AudioDecoderFFmpeg);
+    d.decoded.clear();
+    d.undecoded_size = 0;
+    if (avcodec_receive_frame(d.codec_ctx, d.frame) < 0) // EAGAIN: a new packet is required
+        return false;
+#if USE_AUDIO_FRAME
+    return true;
+#endif
+    d.resampler->setInSampesPerChannel(d.frame->nb_samples);
+    if (!d.resampler->convert((const quint8**)d.frame->extended_data))
+        return false;
+    d.decoded = d.resampler->outData();
+    return true;
+#else
+    return false;
+#endif //QTAV_HAVE(SEND_RECEIVE)
+}
+
 //
 bool AudioDecoderFFmpeg::decode(const QByteArray &encoded)
 {
@@ -69,4 +69,9 @@ const AudioFormat& AudioEncoder::audioFormat() const
     return d_func().format_used;
 }
 
+int AudioEncoder::frameSize() const
+{
+    return d_func().frame_size;
+}
+
 } //namespace QtAV
@@ -27,6 +27,10 @@
 #include "QtAV/version.h"
 #include "utils/Logger.h"
 
+#ifndef AV_CODEC_CAP_SMALL_LAST_FRAME
+#define AV_CODEC_CAP_SMALL_LAST_FRAME CODEC_CAP_SMALL_LAST_FRAME
+#endif
+
 /*!
  * options (properties) are from libavcodec/options_table.h
  * enum name here must convert to lower case to fit the names in avcodec. done in AVEncoder.setOptions()
@@ -58,7 +62,6 @@ class AudioEncoderFFmpegPrivate Q_DECL_FINAL: public AudioEncoderPrivate
 public:
     AudioEncoderFFmpegPrivate()
         : AudioEncoderPrivate()
-        , frame_size(0)
     {
         avcodec_register_all();
         // NULL: codec-specific defaults won't be initialized, which may result in suboptimal default settings (this is important mainly for encoders, e.g. libx264).
@@ -67,8 +70,8 @@ public:
     bool open() Q_DECL_OVERRIDE;
     bool close() Q_DECL_OVERRIDE;
 
-    int frame_size; // used if avctx->frame_size == 0
     QByteArray buffer;
+    QByteArray padded; // the last frame with silence if codec requires frame_size samples
 };
 
 bool AudioEncoderFFmpegPrivate::open()
@@ -146,11 +149,12 @@ bool AudioEncoderFFmpegPrivate::open()
     int pcm_hack = 0;
     int buffer_size = 0;
     frame_size = avctx->frame_size;
-    if (frame_size <= 1)
+    if (frame_size <= 1) {
         pcm_hack = av_get_bits_per_sample(avctx->codec_id)/8;
+        frame_size = 0; // any size
+    }
     if (pcm_hack) {
-        frame_size = 16384; // "enough"
-        buffer_size = frame_size*pcm_hack*format_used.channels()*2+200;
+        buffer_size = 16384*pcm_hack*format_used.channels()*2+200; // "enough". resized in encode() if not
     } else {
         buffer_size = frame_size*format_used.bytesPerSample()*format_used.channels()*2+200;
     }
@@ -187,9 +191,9 @@ bool AudioEncoderFFmpeg::encode(const AudioFrame &frame)
         f->format = fmt.sampleFormatFFmpeg();
         f->channel_layout = fmt.channelLayoutFFmpeg();
         // f->channels = fmt.channels(); //remove? not availale in libav9
-        // must be (not the last frame) exactly frame_size unless CODEC_CAP_VARIABLE_FRAME_SIZE is set (frame_size==0)
-        // TODO: mpv use pcmhack for avctx.frame_size==0. can we use input frame.samplesPerChannel?
-        f->nb_samples = d.frame_size;
+        // must be (not the last frame) exactly frame_size unless CODEC_CAP_VARIABLE_FRAME_SIZE is set (frame_size==0).
+        // AudioEncodeFilter batches samples into frame_size
+        f->nb_samples = frame.samplesPerChannel();
         /// f->quality = d.avctx->global_quality; //TODO
         // TODO: record last pts. mpv compute pts internally and also use playback time
         f->pts = int64_t(frame.timestamp()*fmt.sampleRate()); // TODO
@@ -197,10 +201,26 @@ bool AudioEncoderFFmpeg::encode(const AudioFrame &frame)
         const int nb_planes = frame.planeCount();
         // bytes between 2 samples on a plane. TODO: add to AudioFormat? what about bytesPerFrame?
         const int sample_stride = fmt.isPlanar() ? fmt.bytesPerSample() : fmt.bytesPerSample()*fmt.channels();
-        for (int i = 0; i < nb_planes; ++i) {
-            f->linesize[i] = f->nb_samples * sample_stride;// frame.bytesPerLine(i); //
-            f->extended_data[i] = (uint8_t*)frame.constBits(i);
+        if (d.frame_size > 0 && f->nb_samples < d.frame_size && !(d.avctx->codec->capabilities & AV_CODEC_CAP_SMALL_LAST_FRAME)) {
+            // a short last frame. fill silence
+            const int line = d.frame_size*sample_stride;
+            d.padded.resize(line*nb_planes);
+            for (int i = 0; i < nb_planes; ++i) {
+                f->extended_data[i] = (uint8_t*)d.padded.data() + i*line;
+                memcpy(f->extended_data[i], frame.constBits(i), f->nb_samples*sample_stride);
+            }
+            av_samples_set_silence(f->extended_data, f->nb_samples, d.frame_size - f->nb_samples, fmt.channels(), (AVSampleFormat)f->format);
+            f->nb_samples = d.frame_size;
+        } else {
+            for (int i = 0; i < nb_planes; ++i)
+                f->extended_data[i] = (uint8_t*)frame.constBits(i);
         }
+        for (int i = 0; i < nb_planes; ++i)
+            f->linesize[i] = f->nb_samples * sample_stride;
+        // variable frame size codecs, e.g. pcm
+        const int buffer_size = f->nb_samples*fmt.bytesPerSample()*fmt.channels()*2+200;
+        if (d.buffer.size() < buffer_size)
+            d.buffer.resize(buffer_size);
     }
     AVPacket pkt;
     av_init_packet(&pkt);
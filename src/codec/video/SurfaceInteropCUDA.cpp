@@ -522,7 +522,44 @@ namespace QtAV {
 namespace cuda {
 GLInteropResource::GLInteropResource(CUdevice d, CUvideodecoder decoder, CUvideoctxlock lk)
     : InteropResource(d, decoder, lk)
-{}
+{
+    memset(mapped_frame, 0, sizeof(mapped_frame));
+    memset(fence, 0, sizeof(fence));
+}
+
+GLInteropResource::~GLInteropResource()
+{
+    // streams and events are created in decoder's context
+    AutoCtxLock locker((cuda_api*)this, lock);
+    Q_UNUSED(locker);
+    for (int i = 0; i < 2; ++i) {
+        releaseMappedFrame(i, true);
+        if (fence[i])
+            CUDA_WARN(cuEventDestroy(fence[i]));
+        fence[i] = 0;
+        if (res[i].stream)
+            CUDA_WARN(cuStreamDestroy(res[i].stream));
+        res[i].stream = 0;
+    }
+}
+
+bool GLInteropResource::releaseMappedFrame(int plane, bool wait)
+{
+    if (!mapped_frame[plane])
+        return true;
+    if (fence[plane]) {
+        CUresult r = cuEventQuery(fence[plane]);
+        if (r == CUDA_ERROR_NOT_READY) {
+            if (!wait)
+                return false;
+            // usually the copy finished a vsync ago, so no wait here
+            CUDA_WARN(cuEventSynchronize(fence[plane]));
+        }
+    }
+    CUDA_WARN(cuvidUnmapVideoFrame(dec, mapped_frame[plane]));
+    mapped_frame[plane] = 0;
+    return true;
+}
 
 bool GLInteropResource::map(int picIndex, const CUVIDPROCPARAMS &param, GLuint tex, int w, int h, int H, int plane)
 {
@@ -530,17 +567,32 @@ bool GLInteropResource::map(int picIndex, const CUVIDPROCPARAMS &param, GLuint t
     Q_UNUSED(locker);
     if (!ensureResource(w, h, H, tex, plane)) // TODO surface size instead of frame size because we copy the device data
         return false;
-    //CUDA_ENSURE(cuCtxPushCurrent(ctx), false);
+    // the decoder can map only ulNumOutputSurfaces frames at the same time. the other plane may be still copying
+    releaseMappedFrame(plane, true);
     CUdeviceptr devptr;
     unsigned int pitch;
-
     CUDA_ENSURE(cuvidMapVideoFrame(dec, picIndex, &devptr, &pitch, const_cast<CUVIDPROCPARAMS*>(&param)), false);
-    CUVIDAutoUnmapper unmapper(this, dec, devptr);
-    Q_UNUSED(unmapper);
-    // TODO: why can not use res[plane].stream? CUDA_ERROR_INVALID_HANDLE
-    CUDA_ENSURE(cuGraphicsMapResources(1, &res[plane].cuRes, 0), false);
+    if (!copyPlane(devptr, pitch, h, H, plane)) {
+        CUDA_WARN(cuvidUnmapVideoFrame(dec, devptr));
+        return false;
+    }
+    if (!res[plane].stream || !fence[plane]) { // copied synchronously
+        CUDA_WARN(cuvidUnmapVideoFrame(dec, devptr));
+        return true;
+    }
+    CUDA_WARN(cuEventRecord(fence[plane], res[plane].stream));
+    mapped_frame[plane] = devptr;
+    return true;
+}
+
+bool GLInteropResource::copyPlane(CUdeviceptr devptr, unsigned int pitch, int h, int H, int plane)
+{
+    // resources, streams and events are in decoder's context, so stream ordered map is fine
+    CUstream stream = res[plane].stream;
+    CUDA_ENSURE(cuGraphicsMapResources(1, &res[plane].cuRes, stream), false);
     CUarray array;
-    CUDA_ENSURE(cuGraphicsSubResourceGetMappedArray(&array, res[plane].cuRes, 0, 0), false);
+    CUDA_CHECK(cuGraphicsSubResourceGetMappedArray(&array, res[plane].cuRes, 0, 0),
+               CUDA_WARN(cuGraphicsUnmapResources(1, &res[plane].cuRes, stream)); return false;);
 
     CUDA_MEMCPY2D cu2d;
     memset(&cu2d, 0, sizeof(cu2d));
@@ -558,54 +610,25 @@ bool GLInteropResource::map(int picIndex, const CUVIDPROCPARAMS &param, GLuint t
         cu2d.srcY = H; // skip the padding height
         cu2d.Height /= 2;
     }
-    if (res[plane].stream)
-        CUDA_ENSURE(cuMemcpy2DAsync(&cu2d, res[plane].stream), false);
+    bool ok = true;
+    if (stream)
+        CUDA_CHECK(cuMemcpy2DAsync(&cu2d, stream), ok = false;);
     else
-        CUDA_ENSURE(cuMemcpy2D(&cu2d), false);
-    //TODO: delay cuCtxSynchronize && unmap. do it in unmap(tex)?
-    // map to an already mapped resource will crash. sometimes I can not unmap the resource in unmap(tex) because if context switch error
-    // so I simply unmap the resource here
-    if (WORKAROUND_UNMAP_CONTEXT_SWITCH) {
-        if (res[plane].stream) {
-            //CUDA_WARN(cuCtxSynchronize(), false); //wait too long time? use cuStreamQuery?
-            CUDA_WARN(cuStreamSynchronize(res[plane].stream)); //slower than CtxSynchronize
-        }
-        /*
-         * This function provides the synchronization guarantee that any CUDA work issued
-         * in \p stream before ::cuGraphicsUnmapResources() will complete before any
-         * subsequently issued graphics work begins.
-         * The graphics API from which \p resources were registered
-         * should not access any resources while they are mapped by CUDA. If an
-         * application does so, the results are undefined.
-         */
-        CUDA_ENSURE(cuGraphicsUnmapResources(1, &res[plane].cuRes, 0), false);
-    } else {
-        // call it at last. current context will be used by other cuda calls (unmap() for example)
-        CUDA_ENSURE(cuCtxPopCurrent(&ctx), false); // not required
-    }
-    return true;
+        CUDA_CHECK(cuMemcpy2D(&cu2d), ok = false;);
+    /*
+     * This function provides the synchronization guarantee that any CUDA work issued
+     * in \p stream before ::cuGraphicsUnmapResources() will complete before any
+     * subsequently issued graphics work begins.
+     * So the render thread never waits for the copy. Always unmap here, map an already mapped resource will crash
+     */
+    CUDA_ENSURE(cuGraphicsUnmapResources(1, &res[plane].cuRes, stream), false);
+    return ok;
 }
 
 bool GLInteropResource::unmap(GLuint tex)
 {
     Q_UNUSED(tex);
-    if (WORKAROUND_UNMAP_CONTEXT_SWITCH)
-        return true;
-    int plane = -1;
-    if (res[0].texture == tex)
-        plane = 0;
-    else if (res[1].texture == tex)
-        plane = 1;
-    else
-        return false;
-    // FIXME: why cuCtxPushCurrent gives CUDA_ERROR_INVALID_CONTEXT if opengl viewport changed?
-    CUDA_WARN(cuCtxPushCurrent(ctx));
-    CUDA_WARN(cuStreamSynchronize(res[plane].stream));
-    // FIXME: need a correct context. But why we have to push context even though map/unmap are called in the same thread
-    // Because the decoder switch the context in another thread so we have to switch the context back?
-    // to workaround the context issue, we must pop the context that valid in map() and push it here
-    CUDA_ENSURE(cuGraphicsUnmapResources(1, &res[plane].cuRes, 0), false);
-    CUDA_ENSURE(cuCtxPopCurrent(&ctx), false);
+    // resource is unmapped in map() on the stream. the mapped frame is released when the fence is signaled
     return true;
 }
 
@@ -618,14 +641,18 @@ bool GLInteropResource::ensureResource(int w, int h, int H, GLuint tex, int plan
     if (!ctx) {
         // TODO: how to use pop/push decoder's context without the context in opengl context
         CUDA_ENSURE(cuCtxCreate(&ctx, CU_CTX_SCHED_BLOCKING_SYNC, dev), false);
-        if (USE_STREAM) {
-            CUDA_WARN(cuStreamCreate(&res[0].stream, CU_STREAM_DEFAULT));
-            CUDA_WARN(cuStreamCreate(&res[1].stream, CU_STREAM_DEFAULT));
-        }
         qDebug("cuda contex on gl thread: %p", ctx);
         CUDA_ENSURE(cuCtxPopCurrent(&ctx), false); // TODO: why cuMemcpy2D need this
     }
+    // created in decoder's context (locked in map()) like the registered resources and mapped frames.
+    // a stream of ctx is an invalid handle there
+    if (USE_STREAM && !r.stream)
+        CUDA_WARN(cuStreamCreate(&r.stream, CU_STREAM_DEFAULT));
+    if (r.stream && !fence[plane])
+        CUDA_WARN(cuEventCreate(&fence[plane], CU_EVENT_DISABLE_TIMING));
     if (r.cuRes) {
+        if (r.stream) // the stream ordered unmap of last copy
+            CUDA_WARN(cuStreamSynchronize(r.stream));
         CUDA_ENSURE(cuGraphicsUnregisterResource(r.cuRes), false);
         r.cuRes = NULL;
     }
@@ -148,15 +148,28 @@ class GLInteropResource Q_DECL_FINAL: public InteropResource
 {
 public:
     GLInteropResource(CUdevice d, CUvideodecoder decoder, CUvideoctxlock lk);
+    ~GLInteropResource();
+    /*!
+     * Copy the plane on the stream of the plane without waiting for the copy. cuGraphicsUnmapResources() on the stream
+     * guarantees the copy completes before later GL commands. The decoded frame stays mapped until the fence (an event
+     * recorded after the copy) is signaled, and is unmapped in next map() of the plane.
+     */
     bool map(int picIndex, const CUVIDPROCPARAMS& param, GLuint tex, int w, int h, int H, int plane) Q_DECL_OVERRIDE;
     bool unmap(GLuint tex) Q_DECL_OVERRIDE;
 private:
+    // d2d copy the plane of mapped frame to the texture array. decoder context must be locked
+    bool copyPlane(CUdeviceptr devptr, unsigned int pitch, int h, int H, int plane);
+    // cuvidUnmapVideoFrame() the frame mapped for plane if its copy is finished. wait for the fence if wait is true
+    bool releaseMappedFrame(int plane, bool wait);
     /*
      * TODO: do we need to check h, H etc? interop is created by decoder and frame size does not change in the playback.
      * playing a new stream will recreate the decoder and interop
      * All we need to ensure is register when texture changed. But there's no way to check the texture change.
      */
     bool ensureResource(int w, int h, int H, GLuint tex, int plane);
+
+    CUdeviceptr mapped_frame[2]; // 0: not mapped
+    CUevent fence[2];
 };
 #endif //QTAV_HAVE(CUDA_GL)
 } //namespace cuda
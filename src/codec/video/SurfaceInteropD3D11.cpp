@@ -0,0 +1,450 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#include "SurfaceInteropD3D11.h"
+#include "QtAV/VideoFrame.h"
+#include "utils/Logger.h"
+#define DX_LOG_COMPONENT "D3D11"
+#include "utils/DirectXHelper.h"
+
+namespace QtAV {
+namespace d3d11 {
+
+InteropResource::InteropResource(ID3D11Device *dev)
+    : d3ddev(dev)
+    , dx_texture(NULL)
+    , width(0)
+    , height(0)
+    , video_dev(NULL)
+    , video_ctx(NULL)
+    , vp_enum(NULL)
+    , vp(NULL)
+    , vp_width(0)
+    , vp_height(0)
+    , vp_out_width(0)
+    , vp_out_height(0)
+    , target(NULL)
+    , target_view(NULL)
+{
+    d3ddev->AddRef();
+    DX_WARN(d3ddev->QueryInterface(__uuidof(ID3D11VideoDevice), (void**)&video_dev));
+    ID3D11DeviceContext *ctx = NULL;
+    d3ddev->GetImmediateContext(&ctx);
+    DX_WARN(ctx->QueryInterface(__uuidof(ID3D11VideoContext), (void**)&video_ctx));
+    SafeRelease(&ctx);
+}
+
+InteropResource::~InteropResource()
+{
+    InteropResource::releaseVideoProcessor();
+    releaseDX();
+    SafeRelease(&video_ctx);
+    SafeRelease(&video_dev);
+    SafeRelease(&d3ddev);
+}
+
+void InteropResource::releaseDX()
+{
+    SafeRelease(&dx_texture);
+}
+
+void InteropResource::releaseVideoProcessor()
+{
+    SafeRelease(&target_view);
+    SafeRelease(&target);
+    SafeRelease(&vp);
+    SafeRelease(&vp_enum);
+    vp_width = vp_height = 0;
+    vp_out_width = vp_out_height = 0;
+}
+
+bool InteropResource::ensureVideoProcessor(ID3D11Texture2D *surface, int w, int h)
+{
+    if (!video_dev || !video_ctx)
+        return false;
+    D3D11_TEXTURE2D_DESC desc;
+    surface->GetDesc(&desc);
+    if (vp && vp_width == (int)desc.Width && vp_height == (int)desc.Height && vp_out_width == w && vp_out_height == h)
+        return true;
+    releaseVideoProcessor();
+    D3D11_VIDEO_PROCESSOR_CONTENT_DESC cd;
+    ZeroMemory(&cd, sizeof(cd));
+    cd.InputFrameFormat = D3D11_VIDEO_FRAME_FORMAT_PROGRESSIVE;
+    cd.InputWidth = desc.Width;
+    cd.InputHeight = desc.Height;
+    cd.OutputWidth = w;
+    cd.OutputHeight = h;
+    cd.Usage = D3D11_VIDEO_USAGE_PLAYBACK_NORMAL;
+    DX_ENSURE_OK(video_dev->CreateVideoProcessorEnumerator(&cd, &vp_enum), false);
+    UINT flags = 0;
+    DX_ENSURE_OK(vp_enum->CheckVideoProcessorFormat(DXGI_FORMAT_B8G8R8A8_UNORM, &flags), false);
+    if (!(flags & D3D11_VIDEO_PROCESSOR_FORMAT_SUPPORT_OUTPUT)) {
+        qWarning("D3D11 video processor does not support BGRA output");
+        return false;
+    }
+    DX_ENSURE_OK(video_dev->CreateVideoProcessor(vp_enum, 0, &vp), false);
+    // decoder may not write the full range flag. keep the stream as it is
+    video_ctx->VideoProcessorSetStreamAutoProcessingMode(vp, 0, FALSE);
+    vp_width = desc.Width;
+    vp_height = desc.Height;
+    vp_out_width = w;
+    vp_out_height = h;
+    return true;
+}
+
+bool InteropResource::blit(ID3D11Texture2D *surface, int index, ID3D11VideoProcessorOutputView *out, int w, int h)
+{
+    D3D11_VIDEO_PROCESSOR_INPUT_VIEW_DESC id;
+    ZeroMemory(&id, sizeof(id));
+    id.FourCC = 0;
+    id.ViewDimension = D3D11_VPIV_DIMENSION_TEXTURE2D;
+    id.Texture2D.MipSlice = 0;
+    id.Texture2D.ArraySlice = index;
+    ID3D11VideoProcessorInputView *in_view = NULL;
+    DX_ENSURE_OK(video_dev->CreateVideoProcessorInputView(surface, vp_enum, &id, &in_view), false);
+    const RECT src = { 0, 0, w, h};
+    video_ctx->VideoProcessorSetStreamSourceRect(vp, 0, TRUE, &src);
+    D3D11_VIDEO_PROCESSOR_STREAM stream;
+    ZeroMemory(&stream, sizeof(stream));
+    stream.Enable = TRUE;
+    stream.pInputSurface = in_view;
+    // nv12 -> bgra on gpu. neither ANGLE nor d2d can sample a nv12 texture
+    const HRESULT hr = video_ctx->VideoProcessorBlt(vp, out, 0, 1, &stream);
+    SafeRelease(&in_view);
+    DX_ENSURE_OK(hr, false);
+    return true;
+}
+
+bool InteropResource::map(ID3D11Texture2D *surface, int index, ID3D11Texture2D *tex, int w, int h)
+{
+    if (!tex || !ensureVideoProcessor(surface, w, h))
+        return false;
+    if (tex != target) {
+        SafeRelease(&target_view);
+        SafeRelease(&target);
+        D3D11_VIDEO_PROCESSOR_OUTPUT_VIEW_DESC od;
+        od.ViewDimension = D3D11_VPOV_DIMENSION_TEXTURE2D;
+        od.Texture2D.MipSlice = 0;
+        DX_ENSURE_OK(video_dev->CreateVideoProcessorOutputView(tex, vp_enum, &od, &target_view), false);
+        target = tex;
+        target->AddRef();
+    }
+    return blit(surface, index, target_view, w, h);
+}
+
+ID3D11Texture2D* InteropResource::createTexture(int w, int h)
+{
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Width = w;
+    desc.Height = h;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+    ID3D11Texture2D *tex = NULL;
+    DX_ENSURE_OK(d3ddev->CreateTexture2D(&desc, NULL, &tex), NULL);
+    return tex;
+}
+
+SurfaceInteropD3D11::~SurfaceInteropD3D11()
+{
+    SafeRelease(&m_surface);
+}
+
+void SurfaceInteropD3D11::setSurface(ID3D11Texture2D *surface, int index, int frame_w, int frame_h)
+{
+    m_surface = surface;
+    m_surface->AddRef();
+    m_index = index;
+    frame_width = frame_w;
+    frame_height = frame_h;
+}
+
+void* SurfaceInteropD3D11::map(SurfaceType type, const VideoFormat &fmt, void *handle, int plane)
+{
+    if (!handle)
+        return NULL;
+
+    if (!m_surface)
+        return 0;
+    if (type == GLTextureSurface) {
+        if (!fmt.isRGB())
+            return NULL;
+        if (m_resource->map(m_surface, m_index, *((GLuint*)handle), frame_width, frame_height, plane))
+            return handle;
+    } else if (type == DXTextureSurface) {
+        if (!fmt.isRGB())
+            return NULL;
+        if (m_resource->map(m_surface, m_index, *((ID3D11Texture2D**)handle), frame_width, frame_height))
+            return handle;
+    } else if (type == HostMemorySurface) {
+        return mapToHost(fmt, handle, plane);
+    }
+    return NULL;
+}
+
+void SurfaceInteropD3D11::unmap(void *handle)
+{
+    m_resource->unmap(*((GLuint*)handle));
+}
+
+void* SurfaceInteropD3D11::createHandle(void *handle, SurfaceType type, const VideoFormat &fmt, int plane, int planeWidth, int planeHeight)
+{
+    Q_UNUSED(plane);
+    Q_UNUSED(planeWidth);
+    Q_UNUSED(planeHeight);
+    if (!handle || type != DXTextureSurface || !fmt.isRGB())
+        return NULL;
+    ID3D11Texture2D **tex = (ID3D11Texture2D**)handle;
+    *tex = m_resource->createTexture(frame_width, frame_height);
+    return *tex ? handle : NULL;
+}
+
+void* SurfaceInteropD3D11::mapToHost(const VideoFormat &format, void *handle, int plane)
+{
+    Q_UNUSED(plane);
+    D3D11_TEXTURE2D_DESC desc;
+    m_surface->GetDesc(&desc);
+    if (desc.Format != DXGI_FORMAT_NV12) {
+        qWarning("unsupported d3d11 pixel format: %#x", desc.Format);
+        return NULL;
+    }
+    ID3D11Device *dev = NULL;
+    m_surface->GetDevice(&dev);
+    ID3D11DeviceContext *ctx = NULL;
+    dev->GetImmediateContext(&ctx);
+    // decoded surface is not cpu readable. copy the slice to a staging texture
+    desc.ArraySize = 1;
+    desc.MipLevels = 1;
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    desc.MiscFlags = 0;
+    ID3D11Texture2D *staging = NULL;
+    void *ret = NULL;
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    DX_CHECK(dev->CreateTexture2D(&desc, NULL, &staging), goto end;);
+    ctx->CopySubresourceRegion(staging, 0, 0, 0, 0, m_surface, m_index, NULL);
+    DX_CHECK(ctx->Map(staging, 0, D3D11_MAP_READ, 0, &mapped), goto end;);
+    {
+    const VideoFormat fmt(VideoFormat::Format_NV12);
+    int pitch[3] = { (int)mapped.RowPitch, 0, 0}; //compute chroma later
+    quint8 *src[] = { (quint8*)mapped.pData, 0, 0}; //compute chroma later
+    VideoFrame frame(VideoFrame::fromGPU(fmt, frame_width, frame_height, desc.Height, src, pitch, true, false, format.pixelFormat()));
+    ctx->Unmap(staging, 0);
+    if (format != fmt)
+        frame = frame.to(format);
+    VideoFrame *f = reinterpret_cast<VideoFrame*>(handle);
+    frame.setTimestamp(f->timestamp());
+    *f = frame;
+    ret = f;
+    }
+end:
+    SafeRelease(&staging);
+    SafeRelease(&ctx);
+    SafeRelease(&dev);
+    return ret;
+}
+} //namespace d3d11
+} //namespace QtAV
+
+#if QTAV_HAVE(D3D11_EGL)
+#define EGL_ENSURE(x, ...) \
+    do { \
+        if (!(x)) { \
+            EGLint err = eglGetError(); \
+            qWarning("EGL error@%d<<%s. " #x ": %#x %s", __LINE__, __FILE__, err, eglQueryString(eglGetCurrentDisplay(), err)); \
+            return __VA_ARGS__; \
+        } \
+    } while(0)
+
+#if QTAV_HAVE(GUI_PRIVATE)
+#include <qpa/qplatformnativeinterface.h>
+#include <QtGui/QGuiApplication>
+#endif //QTAV_HAVE(GUI_PRIVATE)
+#ifdef QT_OPENGL_ES_2_ANGLE_STATIC
+#define CAPI_LINK_EGL
+#else
+#define EGL_CAPI_NS
+#endif //QT_OPENGL_ES_2_ANGLE_STATIC
+#include "capi/egl_api.h"
+#include <EGL/eglext.h> //include after egl_capi.h to match types
+
+namespace QtAV {
+namespace d3d11 {
+class EGL {
+public:
+    EGL() : dpy(EGL_NO_DISPLAY), surface(EGL_NO_SURFACE) {}
+    EGLDisplay dpy;
+    EGLSurface surface;
+};
+
+EGLInteropResource::EGLInteropResource(ID3D11Device *dev)
+    : InteropResource(dev)
+    , egl(new EGL())
+    , vp_out(NULL)
+    , dx_query(NULL)
+{
+    D3D11_QUERY_DESC qd;
+    qd.Query = D3D11_QUERY_EVENT;
+    qd.MiscFlags = 0;
+    DX_WARN(d3ddev->CreateQuery(&qd, &dx_query));
+}
+
+EGLInteropResource::~EGLInteropResource()
+{
+    releaseEGL();
+    if (egl) {
+        delete egl;
+        egl = NULL;
+    }
+    releaseVideoProcessor();
+    SafeRelease(&dx_query);
+}
+
+void EGLInteropResource::releaseEGL() {
+    if (egl->surface != EGL_NO_SURFACE) {
+        eglReleaseTexImage(egl->dpy, egl->surface, EGL_BACK_BUFFER);
+        eglDestroySurface(egl->dpy, egl->surface);
+        egl->surface = EGL_NO_SURFACE;
+    }
+}
+
+void EGLInteropResource::releaseVideoProcessor()
+{
+    // output view is created by the video processor enumerator
+    SafeRelease(&vp_out);
+    InteropResource::releaseVideoProcessor();
+}
+
+bool EGLInteropResource::ensureSurface(int w, int h) {
+    if (dx_texture && egl->surface != EGL_NO_SURFACE && width == w && height == h) {
+        if (vp_out)
+            return true;
+        D3D11_VIDEO_PROCESSOR_OUTPUT_VIEW_DESC od;
+        od.ViewDimension = D3D11_VPOV_DIMENSION_TEXTURE2D;
+        od.Texture2D.MipSlice = 0;
+        DX_ENSURE_OK(video_dev->CreateVideoProcessorOutputView(dx_texture, vp_enum, &od, &vp_out), false);
+        return true;
+    }
+    releaseEGL();
+#if QTAV_HAVE(GUI_PRIVATE)
+    QPlatformNativeInterface *nativeInterface = QGuiApplication::platformNativeInterface();
+    egl->dpy = static_cast<EGLDisplay>(nativeInterface->nativeResourceForContext("eglDisplay", QOpenGLContext::currentContext()));
+    EGLConfig egl_cfg = static_cast<EGLConfig>(nativeInterface->nativeResourceForContext("eglConfig", QOpenGLContext::currentContext()));
+#else
+    egl->dpy = eglGetCurrentDisplay();
+    EGLint cfg_id = 0;
+    EGL_ENSURE(eglQueryContext(egl->dpy, eglGetCurrentContext(), EGL_CONFIG_ID , &cfg_id) == EGL_TRUE, false);
+    EGLint nb_cfg = 0;
+    EGL_ENSURE(eglGetConfigs(egl->dpy, NULL, 0, &nb_cfg) == EGL_TRUE, false);
+    QVector<EGLConfig> cfgs(nb_cfg); //check > 0
+    EGL_ENSURE(eglGetConfigs(egl->dpy, cfgs.data(), cfgs.size(), &nb_cfg) == EGL_TRUE, false);
+    EGLConfig egl_cfg = NULL;
+    for (int i = 0; i < nb_cfg; ++i) {
+        EGLint id = 0;
+        eglGetConfigAttrib(egl->dpy, cfgs[i], EGL_CONFIG_ID, &id);
+        if (id == cfg_id) {
+            egl_cfg = cfgs[i];
+            break;
+        }
+    }
+#endif
+    qDebug("egl display:%p config: %p", egl->dpy, egl_cfg);
+    // d3d11 shared textures can only be opened by ANGLE with this extension. EGL_ANGLE_query_surface_pointer gives ANGLE's own texture on another device
+    QList<QByteArray> extensions = QByteArray(eglQueryString(egl->dpy, EGL_EXTENSIONS)).split(' ');
+    if (!extensions.contains("EGL_ANGLE_d3d_share_handle_client_buffer")) {
+        qWarning("EGL extension 'EGL_ANGLE_d3d_share_handle_client_buffer' is required!");
+        return false;
+    }
+    releaseDX();
+    // same device as decoder, so the video processor can write to the texture directly. ANGLE opens it by the legacy share handle
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Width = w;
+    desc.Height = h;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+    desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
+    DX_ENSURE_OK(d3ddev->CreateTexture2D(&desc, NULL, &dx_texture), false);
+    IDXGIResource *res = NULL;
+    HANDLE share_handle = NULL;
+    DX_ENSURE_OK(dx_texture->QueryInterface(__uuidof(IDXGIResource), (void**)&res), false);
+    DX_WARN(res->GetSharedHandle(&share_handle));
+    SafeRelease(&res);
+    if (!share_handle)
+        return false;
+    // egl surface size must match d3d texture's
+    EGLint attribs[] = {
+        EGL_WIDTH, w,
+        EGL_HEIGHT, h,
+        EGL_TEXTURE_FORMAT, EGL_TEXTURE_RGBA,
+        EGL_TEXTURE_TARGET, EGL_TEXTURE_2D,
+        EGL_NONE
+    };
+    EGL_ENSURE((egl->surface = eglCreatePbufferFromClientBuffer(egl->dpy, EGL_D3D_TEXTURE_2D_SHARE_HANDLE_ANGLE, share_handle, egl_cfg, attribs)), false);
+    qDebug("pbuffer surface from d3d11 shared texture: %p", egl->surface);
+    SafeRelease(&vp_out);
+    D3D11_VIDEO_PROCESSOR_OUTPUT_VIEW_DESC od;
+    od.ViewDimension = D3D11_VPOV_DIMENSION_TEXTURE2D;
+    od.Texture2D.MipSlice = 0;
+    DX_ENSURE_OK(video_dev->CreateVideoProcessorOutputView(dx_texture, vp_enum, &od, &vp_out), false);
+    width = w;
+    height = h;
+    return true;
+}
+
+bool EGLInteropResource::map(ID3D11Texture2D *surface, int index, GLuint tex, int w, int h, int)
+{
+    if (!ensureVideoProcessor(surface, w, h) || !ensureSurface(w, h)) {
+        releaseEGL();
+        releaseVideoProcessor();
+        releaseDX();
+        return false;
+    }
+    if (!blit(surface, index, vp_out, w, h))
+        return false;
+    if (dx_query) {
+        // ANGLE uses its own device. flush and wait for the blt as dxva EGL interop does, with the same iteration limit
+        ID3D11DeviceContext *ctx = NULL;
+        d3ddev->GetImmediateContext(&ctx);
+        ctx->End(dx_query);
+        ctx->Flush();
+        int k = 0;
+        while (ctx->GetData(dx_query, NULL, 0, 0) == S_FALSE && ++k < 10) {
+            Sleep(1);
+        }
+        SafeRelease(&ctx);
+    }
+    DYGL(glBindTexture(GL_TEXTURE_2D, tex));
+    eglBindTexImage(egl->dpy, egl->surface, EGL_BACK_BUFFER);
+    DYGL(glBindTexture(GL_TEXTURE_2D, 0));
+    return true;
+}
+} //namespace d3d11
+} //namespace QtAV
+#endif //QTAV_HAVE(D3D11_EGL)
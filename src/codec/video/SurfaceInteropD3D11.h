@@ -0,0 +1,156 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_SURFACEINTEROPD3D11_H
+#define QTAV_SURFACEINTEROPD3D11_H
+#include <d3d11.h>
+#include "QtAV/SurfaceInterop.h"
+#include "utils/OpenGLHelper.h"
+// ANGLE d3d11 backend opens a shared d3d11 texture as a pbuffer
+#if QTAV_HAVE(EGL_CAPI) // always use dynamic load
+#if defined(QT_OPENGL_DYNAMIC) || defined(QT_OPENGL_ES_2) || defined(QT_OPENGL_ES_2_ANGLE)
+#define QTAV_HAVE_D3D11_EGL 1
+#endif
+#endif //QTAV_HAVE(EGL_CAPI)
+
+namespace QtAV {
+namespace d3d11 {
+
+/*!
+ * \brief The InteropResource class
+ * Used directly if frames are rendered by d3d11 or dxgi based renderers, e.g. Direct2D. It converts the decoded slice to a
+ * BGRA texture with ID3D11VideoProcessor. OpenGL interop is implemented by subclasses.
+ */
+class InteropResource
+{
+public:
+    InteropResource(ID3D11Device *dev);
+    virtual ~InteropResource();
+    /*!
+     * \brief map
+     * \param surface d3d11 decoded texture array
+     * \param index array slice of the decoded picture in surface
+     * \param tex opengl texture
+     * \param w frame width(visual width) without alignment, <= d3d11 surface width
+     * \param h frame height(visual height)
+     * \param plane useless now
+     * \return true if success
+     */
+    virtual bool map(ID3D11Texture2D* surface, int index, GLuint tex, int w, int h, int plane) {
+        Q_UNUSED(surface);
+        Q_UNUSED(index);
+        Q_UNUSED(tex);
+        Q_UNUSED(w);
+        Q_UNUSED(h);
+        Q_UNUSED(plane);
+        return false;
+    }
+    virtual bool unmap(GLuint tex) { Q_UNUSED(tex); return true;}
+    /*!
+     * \brief map
+     * Convert the decoded slice to target on gpu.
+     * \param target a w x h BGRA texture on the decoder device, e.g. from createTexture()
+     */
+    bool map(ID3D11Texture2D* surface, int index, ID3D11Texture2D* target, int w, int h);
+    /// a w x h BGRA texture on the decoder device. It can be a video processor output and a dxgi surface of d2d bitmaps
+    ID3D11Texture2D* createTexture(int w, int h);
+protected:
+    void releaseDX();
+    virtual void releaseVideoProcessor();
+    /// w, h: output size
+    bool ensureVideoProcessor(ID3D11Texture2D *surface, int w, int h);
+    bool blit(ID3D11Texture2D *surface, int index, ID3D11VideoProcessorOutputView *out, int w, int h);
+
+    ID3D11Device *d3ddev;
+    ID3D11Texture2D *dx_texture; // size is frame size(visual size) for display
+    int width, height; // video frame width and dx_texture width without alignment, not decoded surface width
+    ID3D11VideoDevice *video_dev;
+    ID3D11VideoContext *video_ctx;
+    ID3D11VideoProcessorEnumerator *vp_enum;
+    ID3D11VideoProcessor *vp;
+    int vp_width, vp_height; // decoded surface size the video processor is created for
+    int vp_out_width, vp_out_height;
+private:
+    ID3D11Texture2D *target; // referenced, so the cached view never belongs to a new texture at the same address
+    ID3D11VideoProcessorOutputView *target_view;
+};
+typedef QSharedPointer<InteropResource> InteropResourcePtr;
+
+class SurfaceInteropD3D11 Q_DECL_FINAL: public VideoSurfaceInterop
+{
+public:
+    SurfaceInteropD3D11(const InteropResourcePtr& res) : m_surface(0), m_index(0), m_resource(res), frame_width(0), frame_height(0) {}
+    ~SurfaceInteropD3D11();
+    /*!
+     * \brief setSurface
+     * \param surface d3d11 decoded texture array
+     * \param index array slice of the decoded picture
+     * \param frame_w frame width(visual width) without alignment, <= d3d11 surface width
+     * \param frame_h frame height(visual height)
+     */
+    void setSurface(ID3D11Texture2D* surface, int index, int frame_w, int frame_h);
+    /*!
+     * GLTextureSurface only supports rgb32
+     * DXTextureSurface: handle is ID3D11Texture2D**. the texture from createHandle() is filled with the frame in BGRA
+     */
+    void* map(SurfaceType type, const VideoFormat& fmt, void* handle, int plane) Q_DECL_OVERRIDE;
+    void unmap(void *handle) Q_DECL_OVERRIDE;
+    /// DXTextureSurface: create a frame size BGRA texture on the decoder device into *(ID3D11Texture2D**)handle. the caller releases it
+    void* createHandle(void* handle, SurfaceType type, const VideoFormat &fmt, int plane, int planeWidth, int planeHeight) Q_DECL_OVERRIDE;
+protected:
+    /// copy from gpu through a staging texture and convert to target format if necessary
+    void* mapToHost(const VideoFormat &format, void *handle, int plane);
+private:
+    ID3D11Texture2D *m_surface;
+    int m_index;
+    InteropResourcePtr m_resource;
+    int frame_width, frame_height;
+};
+
+#if QTAV_HAVE(D3D11_EGL)
+class EGL;
+/*!
+ * \brief The EGLInteropResource class
+ * The decoded NV12 slice is converted to a shared BGRA texture by ID3D11VideoProcessor on gpu,
+ * and the texture is bound to gl as an ANGLE pbuffer (EGL_ANGLE_d3d_share_handle_client_buffer).
+ */
+class EGLInteropResource Q_DECL_FINAL: public InteropResource
+{
+public:
+    EGLInteropResource(ID3D11Device *dev);
+    ~EGLInteropResource();
+    bool map(ID3D11Texture2D *surface, int index, GLuint tex, int w, int h, int) Q_DECL_OVERRIDE;
+
+protected:
+    void releaseVideoProcessor() Q_DECL_OVERRIDE;
+private:
+    void releaseEGL();
+    bool ensureSurface(int w, int h);
+
+    EGL* egl;
+    ID3D11VideoProcessorOutputView *vp_out;
+    ID3D11Query *dx_query;
+};
+#endif //QTAV_HAVE(D3D11_EGL)
+} //namespace d3d11
+} //namespace QtAV
+
+#endif // QTAV_SURFACEINTEROPD3D11_H
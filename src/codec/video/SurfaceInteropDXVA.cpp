@@ -127,7 +127,7 @@ void* SurfaceInteropDXVA::mapToHost(const VideoFormat &format, void *handle, int
     Q_ASSERT(src[0] && pitch[0] > 0);
     const bool swap_uv = desc.Format ==  MAKEFOURCC('I','M','C','3');
     // try to use SSE. fallback to normal copy if SSE is not supported
-    VideoFrame frame(VideoFrame::fromGPU(fmt, frame_width, frame_height, desc.Height, src, pitch, true, swap_uv));
+    VideoFrame frame(VideoFrame::fromGPU(fmt, frame_width, frame_height, desc.Height, src, pitch, true, swap_uv, format.pixelFormat()));
     if (format != fmt)
         frame = frame.to(format);
     VideoFrame *f = reinterpret_cast<VideoFrame*>(handle);
@@ -21,8 +21,12 @@
 
 #include <QtAV/VideoDecoder.h>
 #include <QtAV/private/AVDecoder_p.h>
+#include <QtAV/VideoFormat.h>
 #include <QtCore/QSize>
 #include "QtAV/private/factory.h"
+#include "utils/CapabilityCache.h"
+#include "utils/DecodeThreadScheduler.h"
+#include "utils/DevicePlacement.h"
 #include "utils/Logger.h"
 
 namespace QtAV {
@@ -31,6 +35,7 @@ FACTORY_DEFINE(VideoDecoder)
 
 extern void RegisterVideoDecoderFFmpeg_Man();
 extern void RegisterVideoDecoderDXVA_Man();
+extern void RegisterVideoDecoderD3D11_Man();
 extern void RegisterVideoDecoderCUDA_Man();
 extern void RegisterVideoDecoderVAAPI_Man();
 extern void RegisterVideoDecoderVDA_Man();
@@ -42,6 +47,9 @@ void VideoDecoder_RegisterAll()
 #if QTAV_HAVE(DXVA)
     RegisterVideoDecoderDXVA_Man();
 #endif //QTAV_HAVE(DXVA)
+#if QTAV_HAVE(D3D11VA)
+    RegisterVideoDecoderD3D11_Man();
+#endif //QTAV_HAVE(D3D11VA)
 #if QTAV_HAVE(CUDA)
     RegisterVideoDecoderCUDA_Man();
 #endif //QTAV_HAVE(CUDA)
@@ -66,11 +74,167 @@ VideoDecoder* VideoDecoder::create(const QString& name)
     return VideoDecoderFactory::create(VideoDecoderFactory::id(name.toUtf8().constData(), false));
 }
 
+void VideoDecoder::setSoftwareThreadBudget(int value)
+{
+    DecodeThreadScheduler::instance().setMaxThreads(value);
+}
+
+int VideoDecoder::softwareThreadBudget()
+{
+    return DecodeThreadScheduler::instance().maxThreads();
+}
+
+void VideoDecoder::setCapabilityCacheDir(const QString &dir)
+{
+    CapabilityCache::instance().setDirectory(dir);
+}
+
+QString VideoDecoder::capabilityCacheDir()
+{
+    return CapabilityCache::instance().directory();
+}
+
+void VideoDecoder::setDeviceUtilization(const QString &decoder, int device, int percent)
+{
+    DevicePlacement::instance().setUtilization(decoder, device, percent);
+}
+
 VideoDecoder::VideoDecoder(VideoDecoderPrivate &d):
     AVDecoder(d)
 {
 }
 
+// capability record of a stream: [max decoded width, height, min rejected width, height]. rejected -1: never rejected
+static QString capabilityRecordKey(const AVCodecContext *avctx)
+{
+    return QStringLiteral("%1:%2:%3").arg(avctx->codec_id).arg(avctx->profile).arg(VideoFormat((int)avctx->pix_fmt).bitsPerComponent());
+}
+
+static QString capabilityKey(const QString& decoder)
+{
+    return decoder + QStringLiteral("/decode");
+}
+
+void VideoDecoderPrivate::reportCapability(const QString &decoder, bool supported) const
+{
+    if (!codec_ctx)
+        return;
+    const QString key(capabilityKey(decoder));
+    const QByteArray stamp(capabilityStamp());
+    QVariantHash caps;
+    CapabilityCache::instance().get(key, stamp, &caps);
+    const QString rk(capabilityRecordKey(codec_ctx));
+    const QVariantList old(caps.value(rk).toList());
+    QVariantList r(old);
+    if (r.size() != 4)
+        r = QVariantList() << 0 << 0 << -1 << -1;
+    const int w = codec_ctx->width;
+    const int h = codec_ctx->height;
+    if (supported) {
+        r[0] = qMax(r[0].toInt(), w);
+        r[1] = qMax(r[1].toInt(), h);
+        // rejected at a size not larger than a decoded one. the rejection was not about the size
+        if (r[2].toInt() <= w && r[3].toInt() <= h) {
+            r[2] = -1;
+            r[3] = -1;
+        }
+    } else if (r[2].toInt() < 0 || (w <= r[2].toInt() && h <= r[3].toInt())) {
+        // a stream not smaller than the smallest rejected one is rejected too
+        r[2] = w;
+        r[3] = h;
+    }
+    if (r == old) // avoid writing the disk cache for every open
+        return;
+    caps.insert(rk, r);
+    CapabilityCache::instance().put(key, stamp, caps);
+}
+
+int VideoDecoderPrivate::autoSurfaceCount(const AVCodecContext *avctx, int frameThreads) const
+{
+    int refs = 2; // mpeg1/2, vc1 etc.: 2 reference frames
+    switch (avctx->codec_id) {
+    case QTAV_CODEC_ID(H264):
+#ifdef FF_PROFILE_HEVC_MAIN
+    case QTAV_CODEC_ID(HEVC):
+#endif
+        // refs is from sps if known. reordered frames stay in dpb too
+        refs = avctx->refs > 0 ? qMin(16, avctx->refs + avctx->has_b_frames) : 16;
+        break;
+    default:
+        break;
+    }
+    return refs + 1 + qMax(0, frameThreads) + qMax(0, pipeline_depth);
+}
+
+void VideoDecoder::setPipelineDepth(int frames)
+{
+    d_func().pipeline_depth = frames;
+}
+
+int VideoDecoder::pipelineDepth() const
+{
+    return d_func().pipeline_depth;
+}
+
+void VideoDecoder::setOutputSizeHint(const QSize &size)
+{
+    d_func().output_size_hint = size;
+}
+
+QSize VideoDecoder::outputSizeHint() const
+{
+    return d_func().output_size_hint;
+}
+
+QString VideoDecoder::requiredBitstreamFilter() const
+{
+    return QString();
+}
+
+void VideoDecoder::setBitstreamFiltered(bool value)
+{
+    d_func().bitstream_filtered = value;
+}
+
+bool VideoDecoder::isBitstreamFiltered() const
+{
+    return d_func().bitstream_filtered;
+}
+
+int VideoDecoder::surfaceStarvation() const
+{
+    return d_func().surface_starvation;
+}
+
+qint64 VideoDecoder::surfaceMemory() const
+{
+    return d_func().surface_bytes;
+}
+
+void VideoDecoder::setFrameAllocator(const VideoFrameAllocatorPtr &allocator)
+{
+    d_func().frame_allocator = allocator;
+}
+
+VideoFrameAllocatorPtr VideoDecoder::frameAllocator() const
+{
+    return d_func().frame_allocator;
+}
+
+bool VideoDecoder::isSupported() const
+{
+    DPTR_D(const VideoDecoder);
+    if (!d.codec_ctx)
+        return true;
+    QVariantHash caps;
+    if (!CapabilityCache::instance().get(capabilityKey(name()), d.capabilityStamp(), &caps))
+        return true;
+    const QVariantList r(caps.value(capabilityRecordKey(d.codec_ctx)).toList());
+    if (r.size() != 4 || r[2].toInt() < 0)
+        return true;
+    return d.codec_ctx->width < r[2].toInt() || d.codec_ctx->height < r[3].toInt();
+}
+
 QString VideoDecoder::name() const
 {
     return QLatin1String(VideoDecoderFactory::name(id()).c_str());
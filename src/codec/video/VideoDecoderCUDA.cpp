@@ -22,6 +22,7 @@
 #include "QtAV/VideoDecoder.h"
 #include "QtAV/private/AVDecoder_p.h"
 #include "QtAV/private/prepost.h"
+#include <QtCore/QFile>
 #include <QtCore/QQueue>
 #if QTAV_HAVE(DLLAPI_CUDA)
 #include "dllapi.h"
@@ -30,7 +31,7 @@
 #include "utils/BlockingQueue.h"
 
 /*
- * TODO: VC1, HEVC bsf
+ * TODO: VC1 bsf. HEVC is filtered only by the demuxer, see requiredBitstreamFilter()
  */
 #define COPY_ON_DECODE 1
 #define FILTER_ANNEXB_CUVID 0
@@ -44,6 +45,8 @@
 
 #include "cuda/helper_cuda.h"
 #include "cuda/cuda_api.h"
+#include "utils/CapabilityCache.h"
+#include "utils/DevicePlacement.h"
 #include "utils/Logger.h"
 #include "SurfaceInteropCUDA.h"
 
@@ -52,6 +55,22 @@
 namespace QtAV {
 
 static const unsigned int kMaxDecodeSurfaces = 20;
+static const char kCapsKey[] = "CUDA";
+// the stamp changes if the driver is installed or upgraded. empty if the driver is not found
+static QByteArray driverStamp()
+{
+#if defined(Q_OS_WIN)
+    return CapabilityCache::fileStamp(QStringList() << QString::fromLocal8Bit(qgetenv("SystemRoot")) + QStringLiteral("/System32/nvcuda.dll"));
+#elif defined(Q_OS_MAC)
+    return CapabilityCache::fileStamp(QStringList() << QStringLiteral("/Library/Frameworks/CUDA.framework"));
+#else
+    // kernel module version. files in /proc have no modification time
+    QFile f(QStringLiteral("/proc/driver/nvidia/version"));
+    if (!f.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return f.readLine();
+#endif
+}
 class VideoDecoderCUDAPrivate;
 class VideoDecoderCUDA : public VideoDecoder
 {
@@ -61,10 +80,13 @@ class VideoDecoderCUDA : public VideoDecoder
     Q_PROPERTY(int surfaces READ surfaces WRITE setSurfaces)
     Q_PROPERTY(Flags flags READ flags WRITE setFlags)
     Q_PROPERTY(Deinterlace deinterlace READ deinterlace WRITE setDeinterlace)
+    Q_PROPERTY(int device READ device WRITE setDevice)
+    Q_PROPERTY(DevicePolicy devicePolicy READ devicePolicy WRITE setDevicePolicy)
     Q_FLAGS(Flags)
     Q_ENUMS(Flags)
     Q_ENUMS(Deinterlace)
     Q_ENUMS(CopyMode)
+    Q_ENUMS(DevicePolicy)
 public:
     enum Flags {
         Default = cudaVideoCreate_Default,   // Default operation mode: use dedicated video engines
@@ -82,14 +104,21 @@ public:
         DirectCopy, // use the same host address without additional copy to frame. If address does not change, it should be safe
         GenericCopy
     };
+    enum DevicePolicy {
+        DefaultDevice = DevicePlacement::DefaultDevice, // the graphics device with max gflops
+        RoundRobinDevice = DevicePlacement::RoundRobin,
+        LeastLoadedDevice = DevicePlacement::LeastLoaded // fewest decoders, then lowest VideoDecoder::setDeviceUtilization()
+    };
 
     VideoDecoderCUDA();
     ~VideoDecoderCUDA();
     VideoDecoderId id() const Q_DECL_OVERRIDE;
     QString description() const Q_DECL_OVERRIDE;
     void flush() Q_DECL_OVERRIDE;
+    QString requiredBitstreamFilter() const Q_DECL_OVERRIDE;
     QTAV_DEPRECATED bool decode(const QByteArray &encoded) Q_DECL_FINAL;
     bool decode(const Packet &packet) Q_DECL_OVERRIDE Q_DECL_FINAL;
+    bool receiveFrame() Q_DECL_OVERRIDE Q_DECL_FINAL;
     virtual VideoFrame frame();
 
     // properties
@@ -101,6 +130,16 @@ public:
     void setDeinterlace(Deinterlace di);
     CopyMode copyMode() const;
     void setCopyMode(CopyMode value);
+    /*!
+     * \brief setDevice
+     * CUDA device index for contexts created later. -1: chosen by devicePolicy (default).
+     * ZeroCopy ignores devicePolicy and uses the default device, which renders the frames. Set the device of the gpu driving
+     * the display explicitly if it's not the default one
+     */
+    void setDevice(int value);
+    int device() const;
+    void setDevicePolicy(DevicePolicy value);
+    DevicePolicy devicePolicy() const;
 Q_SIGNALS:
     void copyModeChanged(CopyMode value);
 };
@@ -165,12 +204,12 @@ public:
       , host_data_size(0)
       , create_flags(cudaVideoCreate_Default)
       , deinterlace(cudaVideoDeinterlaceMode_Adaptive)
+      , surface_auto(true)
       , nb_dec_surface(kMaxDecodeSurfaces)
       , copy_mode(VideoDecoderCUDA::GenericCopy) //TODO: check whether intel driver is used
+      , device_request(-1)
+      , device_policy(DevicePlacement::DefaultDevice)
     {
-#if QTAV_HAVE(DLLAPI_CUDA)
-        can_load = dllapi::testLoad("nvcuvid");
-#endif //QTAV_HAVE(DLLAPI_CUDA)
         available = false;
         bitstream_filter_ctx = 0;
         cuctx = 0;
@@ -184,17 +223,13 @@ public:
         frame_queue.setThreshold(10);
         surface_in_use.resize(nb_dec_surface);
         surface_in_use.fill(false);
-        if (!can_load)
-            return;
-        if (!isLoaded()) //cuda_api
-            return;
     }
     ~VideoDecoderCUDAPrivate() {
         if (bitstream_filter_ctx)
             av_bitstream_filter_close(bitstream_filter_ctx);
         if (!can_load)
             return;
-        if (!isLoaded()) //cuda_api
+        if (!cuctx) // never opened. cuda_api is not loaded
             return;
         // if not reset here, CUDA_ERROR_CONTEXT_IS_DESTROYED in ~cuda::InteropResource()
         // QSharedPointer.reset() is in qt5
@@ -202,6 +237,7 @@ public:
         releaseCuda();
     }
     bool open() Q_DECL_OVERRIDE;
+    QByteArray capabilityStamp() const Q_DECL_OVERRIDE { return driverStamp();}
     bool initCuda();
     bool releaseCuda();
     bool createCUVIDDecoder(cudaVideoCodec cudaCodec, int cw, int ch);
@@ -256,6 +292,9 @@ public:
     static int CUDAAPI HandlePictureDecode(void *obj, CUVIDPICPARAMS *cuvidpic) {
         VideoDecoderCUDAPrivate *p = reinterpret_cast<VideoDecoderCUDAPrivate*>(obj);
         //qDebug("%s @%d tid=%p dec=%p idx=%d inUse=%d", __FUNCTION__, __LINE__, QThread::currentThread(), p->dec, cuvidpic->CurrPicIdx, p->surface_in_use[cuvidpic->CurrPicIdx]);
+        // the picture is not processed yet but its surface is decoded again
+        if (cuvidpic->CurrPicIdx < p->surface_in_use.size() && p->surface_in_use[cuvidpic->CurrPicIdx])
+            ++p->surface_starvation;
         p->doDecodePicture(cuvidpic);
         return 1;
     }
@@ -297,12 +336,15 @@ public:
     BlockingQueue<CUVIDPARSERDISPINFO*> frame_queue;
 #endif
     QVector<bool> surface_in_use;
+    bool surface_auto;
     int nb_dec_surface;
     QString description;
 
     AVBitStreamFilterContext *bitstream_filter_ctx; //TODO: rename bsf_ctx
 
     VideoDecoderCUDA::CopyMode copy_mode;
+    int device_request;
+    DevicePlacement::Policy device_policy;
     cuda::InteropResourcePtr interop_res; //may be still used in video frames when decoder is destroyed
 };
 
@@ -311,13 +353,15 @@ VideoDecoderCUDA::VideoDecoderCUDA():
 {
     // dynamic properties about static property details. used by UI
     // format: detail_property
-    setProperty("detail_surfaces", tr("Decoding surfaces."));
+    setProperty("detail_surfaces", tr("Decoding surfaces.") + QStringLiteral(" ") + tr("0: auto"));
     setProperty("detail_flags", tr("Decoder flags"));
     setProperty("detail_copyMode", tr("Performace: ZeroCopy > DirectCopy > GenericCopy"
                                       "ZeroCopy: no copy back from GPU to System memory. Directly render the decoded data on GPU.\n"
                                       "DirectCopy: copy back to host memory but video frames use the same host memory address and maybe not safe.\n"
                                       "GenericCopy: copy back to host memory and each video frame."
                                       ));
+    setProperty("detail_device", tr("CUDA device index.") + QStringLiteral(" ") + tr("-1: auto"));
+    setProperty("detail_devicePolicy", tr("Choose a device for the decoder if device is auto. Not used by ZeroCopy"));
 }
 
 VideoDecoderCUDA::~VideoDecoderCUDA()
@@ -337,6 +381,20 @@ QString VideoDecoderCUDA::description() const
     return QStringLiteral("NVIDIA CUVID");
 }
 
+QString VideoDecoderCUDA::requiredBitstreamFilter() const
+{
+    DPTR_D(const VideoDecoderCUDA);
+    const AVCodecContext *avctx = d.codec_ctx;
+    // cuvid parses Annex B only. avcC/hvcC extradata (mp4, mkv, flv) starts with version 1
+    if (!avctx || !avctx->extradata || avctx->extradata_size < 6 || avctx->extradata[0] != 1)
+        return QString();
+    if (avctx->codec_id == QTAV_CODEC_ID(H264))
+        return QStringLiteral("h264_mp4toannexb");
+    if (avctx->codec_id == QTAV_CODEC_ID(HEVC))
+        return QStringLiteral("hevc_mp4toannexb");
+    return QString();
+}
+
 void VideoDecoderCUDA::flush()
 {
     DPTR_D(VideoDecoderCUDA);
@@ -412,7 +470,8 @@ bool VideoDecoderCUDA::decode(const Packet &packet)
     uint8_t *outBuf = 0;
     int outBufSize = 0;
     int filtered = 0;
-    if (d.bitstream_filter_ctx) {
+    // no copy if filtered by the demuxer
+    if (d.bitstream_filter_ctx && !isBitstreamFiltered()) {
         // h264_mp4toannexb_filter does not use last parameter 'keyFrame', so just set 0
         //return: 0: not changed, no outBuf allocated. >0: ok. <0: fail
         filtered = av_bitstream_filter_filter(d.bitstream_filter_ctx, d.codec_ctx, NULL, &outBuf, &outBufSize
@@ -447,6 +506,12 @@ bool VideoDecoderCUDA::decode(const Packet &packet)
     // video thread: if dec.hasFrame() keep pkt for the next loop and not decode, direct display the frame
 }
 
+bool VideoDecoderCUDA::receiveFrame()
+{
+    // a packet can display several frames, e.g. field pairs. then they are queued by the parser
+    return !d_func().frame_queue.isEmpty();
+}
+
 VideoFrame VideoDecoderCUDA::frame()
 {
     DPTR_D(VideoDecoderCUDA);
@@ -466,9 +531,10 @@ int VideoDecoderCUDA::surfaces() const
 
 void VideoDecoderCUDA::setSurfaces(int n)
 {
+    DPTR_D(VideoDecoderCUDA);
+    d.surface_auto = n <= 0;
     if (n <= 0)
         n = kMaxDecodeSurfaces;
-    DPTR_D(VideoDecoderCUDA);
     d.nb_dec_surface = n;
     d.surface_in_use.resize(n);
     d.surface_in_use.fill(false);
@@ -508,10 +574,44 @@ void VideoDecoderCUDA::setCopyMode(CopyMode value)
     Q_EMIT copyModeChanged(value);
 }
 
+void VideoDecoderCUDA::setDevice(int value)
+{
+    d_func().device_request = qMax(-1, value);
+}
+
+int VideoDecoderCUDA::device() const
+{
+    return d_func().device_request;
+}
+
+void VideoDecoderCUDA::setDevicePolicy(DevicePolicy value)
+{
+    d_func().device_policy = (DevicePlacement::Policy)value;
+}
+
+VideoDecoderCUDA::DevicePolicy VideoDecoderCUDA::devicePolicy() const
+{
+    return (DevicePolicy)d_func().device_policy;
+}
+
 bool VideoDecoderCUDAPrivate::open()
 {
     //TODO: destroy decoder
     // d.available is true if cuda decoder is ready
+    if (mapCodecFromFFmpeg(codec_ctx->codec_id) == cudaVideoCodec_NumCodecs) {
+        qWarning("Codec %s is not supported by CUDA", avcodec_get_name(codec_ctx->codec_id));
+        reportCapability(QStringLiteral("CUDA"), false);
+        return false;
+    }
+    QVariantHash caps;
+    if (CapabilityCache::instance().get(QLatin1String(kCapsKey), driverStamp(), &caps) && caps.value(QStringLiteral("device")).toInt() < 0) {
+        qWarning("VideoDecoderCUDAPrivate::open(): no CUDA device (cached capabilities)");
+        return false;
+    }
+#if QTAV_HAVE(DLLAPI_CUDA)
+    // probe the library when the decoder is selected, not when it's created
+    can_load = dllapi::testLoad("nvcuvid");
+#endif //QTAV_HAVE(DLLAPI_CUDA)
     if (!can_load) {
         qWarning("VideoDecoderCUDAPrivate::open(): CUVID library not available");
         return false;
@@ -521,26 +621,84 @@ bool VideoDecoderCUDAPrivate::open()
     if (!cuctx)
         available = initCuda();
     setBSF(codec_ctx->codec_id);
+    if (surface_auto) {
+        nb_dec_surface = qMin<int>(autoSurfaceCount(codec_ctx, 0), kMaxDecodeSurfaces);
+        surface_in_use.resize(nb_dec_surface);
+        surface_in_use.fill(false);
+    }
     // max decoder surfaces is computed in createCUVIDDecoder. createCUVIDParser use the value
-    return createCUVIDDecoder(mapCodecFromFFmpeg(codec_ctx->codec_id), codec_ctx->coded_width, codec_ctx->coded_height)
-            && createCUVIDParser();
+    if (!createCUVIDDecoder(mapCodecFromFFmpeg(codec_ctx->codec_id), codec_ctx->coded_width, codec_ctx->coded_height)
+            || !createCUVIDParser())
+        return false;
+    reportCapability(QStringLiteral("CUDA"), true);
+    return true;
 }
 
 bool VideoDecoderCUDAPrivate::initCuda()
 {
-    CUDA_ENSURE(cuInit(0), false);
-    cudev = GetMaxGflopsGraphicsDeviceId();
-
-    int clockRate;
-    cuDeviceGetAttribute(&clockRate, CU_DEVICE_ATTRIBUTE_CLOCK_RATE, cudev);
-    int major, minor;
-    CUDA_WARN(cuDeviceComputeCapability(&major, &minor, cudev));
-    char devname[256];
-    CUDA_WARN(cuDeviceGetName(devname, 256, cudev));
-    description = QStringLiteral("CUDA device: %1 %2.%3 %4 MHz @%5").arg(QLatin1String((const char*)devname)).arg(major).arg(minor).arg(clockRate/1000).arg(cudev);
+    const QByteArray caps_stamp(driverStamp());
+    QVariantHash caps;
+    const bool cached = CapabilityCache::instance().get(QLatin1String(kCapsKey), caps_stamp, &caps);
+    const CUresult ret = cuInit(0);
+    if (ret == CUDA_ERROR_NO_DEVICE) {
+        caps.clear();
+        caps.insert(QStringLiteral("device"), -1);
+        CapabilityCache::instance().put(QLatin1String(kCapsKey), caps_stamp, caps);
+    }
+    CUDA_ENSURE(ret, false);
+    // the device with max gflops and its attributes. enumerating all devices is slow on some drivers
+    if (!cached) {
+        caps.clear();
+        cudev = GetMaxGflopsGraphicsDeviceId();
+        int clockRate = 0;
+        int major = 0, minor = 0;
+        char devname[256];
+        devname[0] = 0;
+        if (cudev >= 0) {
+            cuDeviceGetAttribute(&clockRate, CU_DEVICE_ATTRIBUTE_CLOCK_RATE, cudev);
+            CUDA_WARN(cuDeviceComputeCapability(&major, &minor, cudev));
+            CUDA_WARN(cuDeviceGetName(devname, 256, cudev));
+        }
+        caps.insert(QStringLiteral("device"), (int)cudev);
+        caps.insert(QStringLiteral("name"), QString::fromLatin1((const char*)devname));
+        caps.insert(QStringLiteral("major"), major);
+        caps.insert(QStringLiteral("minor"), minor);
+        caps.insert(QStringLiteral("clock"), clockRate);
+        CapabilityCache::instance().put(QLatin1String(kCapsKey), caps_stamp, caps);
+    }
+    cudev = caps.value(QStringLiteral("device")).toInt();
+    if (cudev < 0) {
+        qWarning("No CUDA device available");
+        return false;
+    }
+    const int default_dev = cudev;
+    int count = 0;
+    CUDA_WARN(cuDeviceGetCount(&count));
+    // interop textures are registered in the context of the rendering gpu. the default device is a graphics device
+    const DevicePlacement::Policy policy = copy_mode == VideoDecoderCUDA::ZeroCopy ? DevicePlacement::DefaultDevice : device_policy;
+    cudev = DevicePlacement::instance().acquire(this, QStringLiteral("CUDA"), qMax(count, default_dev + 1), device_request, policy, default_dev);
+    if (cudev != default_dev) { // attributes of the default device are cached only
+        int clockRate = 0;
+        int major = 0, minor = 0;
+        char devname[256];
+        devname[0] = 0;
+        cuDeviceGetAttribute(&clockRate, CU_DEVICE_ATTRIBUTE_CLOCK_RATE, cudev);
+        CUDA_WARN(cuDeviceComputeCapability(&major, &minor, cudev));
+        CUDA_WARN(cuDeviceGetName(devname, 256, cudev));
+        caps.insert(QStringLiteral("name"), QString::fromLatin1((const char*)devname));
+        caps.insert(QStringLiteral("major"), major);
+        caps.insert(QStringLiteral("minor"), minor);
+        caps.insert(QStringLiteral("clock"), clockRate);
+    }
+    description = QStringLiteral("CUDA device: %1 %2.%3 %4 MHz @%5").arg(caps.value(QStringLiteral("name")).toString())
+            .arg(caps.value(QStringLiteral("major")).toInt()).arg(caps.value(QStringLiteral("minor")).toInt())
+            .arg(caps.value(QStringLiteral("clock")).toInt()/1000).arg(cudev);
 
     // cuD3DCtxCreate > cuGLCtxCreate(deprecated) > cuCtxCreate (fallback if d3d and gl return status is failed)
-    CUDA_ENSURE(cuCtxCreate(&cuctx, CU_CTX_SCHED_BLOCKING_SYNC, cudev), false); //CU_CTX_SCHED_AUTO?
+    const CUresult ctx_ret = cuCtxCreate(&cuctx, CU_CTX_SCHED_BLOCKING_SYNC, cudev); //CU_CTX_SCHED_AUTO?
+    if (ctx_ret != CUDA_SUCCESS)
+        DevicePlacement::instance().release(this);
+    CUDA_ENSURE(ctx_ret, false);
     CUDA_ENSURE(cuCtxPopCurrent(&cuctx), false);
     CUDA_ENSURE(cuvidCtxLockCreate(&vid_ctx_lock, cuctx), 0);
     {
@@ -565,6 +723,7 @@ bool VideoDecoderCUDAPrivate::releaseCuda()
     if (dec) {
         CUDA_WARN(cuvidDestroyDecoder(dec));
         dec = 0;
+        surface_bytes = 0;
     }
     if (parser) {
         CUDA_WARN(cuvidDestroyVideoParser(parser));
@@ -583,6 +742,7 @@ bool VideoDecoderCUDAPrivate::releaseCuda()
         CUDA_WARN(cuvidCtxLockDestroy(vid_ctx_lock));
         vid_ctx_lock = 0;
     }
+    DevicePlacement::instance().release(this);
     if (cuctx) {
         CUDA_ENSURE(cuCtxDestroy(cuctx), false);
         cuctx = 0;
@@ -632,6 +792,7 @@ bool VideoDecoderCUDAPrivate::createCUVIDDecoder(cudaVideoCodec cudaCodec, int c
     // create the decoder
     available = false;
     CUDA_ENSURE(cuvidCreateDecoder(&dec, &dec_create_info), false);
+    surface_bytes = qint64(dec_create_info.ulNumDecodeSurfaces)*cw*ch*3/2; // nv12
     available = true;
     if (copy_mode == VideoDecoderCUDA::ZeroCopy) {
 #if QTAV_HAVE(CUDA_GL)
@@ -774,7 +935,7 @@ bool VideoDecoderCUDAPrivate::processDecodedData(CUVIDPARSERDISPINFO *cuviddisp,
             }
             cuda::SurfaceInteropCUDA *interop = new cuda::SurfaceInteropCUDA(interop_res);
             interop->setSurface(cuviddisp->picture_index, proc_params, codec_ctx->width, codec_ctx->height, ch); //TODO: both surface size(for copy 2d) and frame size(for map host)
-            frame.setMetaData(QStringLiteral("surface_interop"), QVariant::fromValue(VideoSurfaceInteropPtr(interop)));
+            frame.setSurfaceInterop(VideoSurfaceInteropPtr(interop));
         } else {
             uchar *planes[] = {
                 host_data,
@@ -789,6 +950,9 @@ bool VideoDecoderCUDAPrivate::processDecodedData(CUVIDPARSERDISPINFO *cuviddisp,
         frame.setTimestamp((double)cuviddisp->timestamp/1000.0);
         if (codec_ctx && codec_ctx->sample_aspect_ratio.num > 1) //skip 1/1 because is the default value
             frame.setDisplayAspectRatio(frame.displayAspectRatio()*av_q2d(codec_ctx->sample_aspect_ratio));
+        // fields are not processed by cuvid in weave mode. let the renderer deinterlace
+        if (deinterlace == cudaVideoDeinterlaceMode_Weave && !cuviddisp->progressive_frame)
+            frame.setInterlaced(true, cuviddisp->top_field_first);
         if (copy_mode == VideoDecoderCUDA::GenericCopy)
             frame = frame.clone();
         if (outFrame) {
@@ -29,6 +29,9 @@
 extern "C" {
 #include <libcedarv/libcedarv.h>
 }
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
 #include "utils/Logger.h"
 
 // TODO: neon+nv12+opengl crash
@@ -43,7 +46,13 @@ void tiled_deinterleave_to_planar(void *src, void *dst1, void *dst2,
                                   unsigned int width, unsigned int height);
 }
 #endif //NO_NEON_OPT
+#if QTAV_HAVE(NEON)
+// utils/TiledYUV_NEON.cpp
+void TiledToPlanar_NEON(void *src, void *dst, unsigned int dst_pitch, unsigned int width, unsigned int height);
+void TiledDeinterleaveToPlanar_NEON(void *src, void *dst1, void *dst2, unsigned int dst_pitch, unsigned int width, unsigned int height);
+#endif //QTAV_HAVE(NEON)
 namespace QtAV {
+bool detect_neon(); // GPUMemCopy.cpp
 
 class VideoDecoderCedarvPrivate;
 class VideoDecoderCedarv : public VideoDecoder
@@ -54,6 +63,7 @@ class VideoDecoderCedarv : public VideoDecoder
     Q_PROPERTY(bool neon READ neon WRITE setNeon NOTIFY neonChanged)
 #endif
     Q_PROPERTY(PixFmt outputPixelFormat READ outputPixelFormat WRITE setOutputPixelFormat NOTIFY outputPixelFormatChanged)
+    Q_PROPERTY(int threads READ threads WRITE setThreads NOTIFY threadsChanged)
     Q_ENUMS(PixFmt)
 public:
     enum PixFmt {
@@ -74,9 +84,16 @@ public:
     bool neon() const;
     void setOutputPixelFormat(PixFmt value);
     PixFmt outputPixelFormat() const;
+    /*!
+     * \brief setThreads
+     * threads converting the tiled output to planar. 0: all cores (default). 1: in decoder thread
+     */
+    void setThreads(int value);
+    int threads() const;
 Q_SIGNALS:
     void neonChanged();
     void outputPixelFormatChanged();
+    void threadsChanged();
 };
 
 extern VideoDecoderId VideoDecoderId_Cedarv;
@@ -195,6 +212,87 @@ static void map32x32_to_nv12_UV(void* srcC, void* tarUV, unsigned int dst_pitch,
 }
 #endif
 
+typedef void (*map_y_t)(void* src, void* dst, unsigned int dst_pitch, unsigned int w, unsigned int h);
+typedef void (*map_c_t)(void* src, void* dst1, void* dst2, unsigned int dst_pitch, unsigned int w, unsigned int h);
+
+// a band of tile rows is converted as a smaller picture, so all kernels(C, asm, NEON) are used unchanged
+struct TiledPlane {
+    TiledPlane() : map_y(0), map_c(0), src(0), dst(0), dst2(0), dst_pitch(0), width(0), height(0) {}
+    map_y_t map_y;
+    map_c_t map_c; // deinterleave to dst and dst2 if set
+    quint8 *src, *dst, *dst2;
+    unsigned int dst_pitch, width, height;
+
+    unsigned int tileRows() const { return (height + 31) >> 5;}
+    TiledPlane band(unsigned int row, unsigned int rows) const {
+        TiledPlane b(*this);
+        b.src += row*FFALIGN(width, 32)*32; // a tile row has ceil(width/32) 1024 bytes tiles
+        b.dst += row*32*dst_pitch;
+        if (b.dst2)
+            b.dst2 += row*32*dst_pitch;
+        b.height = qMin(rows*32, height - row*32);
+        return b;
+    }
+    void convert() const {
+        if (map_c)
+            map_c(src, dst, dst2, dst_pitch, width, height);
+        else
+            map_y(src, dst, dst_pitch, width, height);
+    }
+};
+
+class TiledBandTask : public QRunnable
+{
+public:
+    TiledBandTask(const TiledPlane& band, QSemaphore *done) : m_band(band), m_done(done) {}
+    void run() Q_DECL_OVERRIDE {
+        m_band.convert();
+        m_done->release();
+    }
+private:
+    TiledPlane m_band;
+    QSemaphore *m_done;
+};
+
+// the decoder thread does a band too
+class TiledThreadPool : public QThreadPool
+{
+public:
+    TiledThreadPool() : QThreadPool() {
+        setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    }
+};
+Q_GLOBAL_STATIC(TiledThreadPool, tiledThreadPool)
+
+// planes are split to threads bands of tile rows. the last band is converted in current thread
+static void convertTiled(const TiledPlane* planes, int nb_planes, int threads)
+{
+    if (threads <= 0)
+        threads = tiledThreadPool()->maxThreadCount() + 1;
+    if (threads <= 1) {
+        for (int i = 0; i < nb_planes; ++i)
+            planes[i].convert();
+        return;
+    }
+    QSemaphore done;
+    int nb_tasks = 0;
+    TiledPlane last;
+    for (int i = 0; i < nb_planes; ++i) {
+        const TiledPlane &p = planes[i];
+        const unsigned int rows = (p.tileRows() + threads - 1)/threads;
+        for (unsigned int r = 0; r < p.tileRows(); r += rows) {
+            if (last.height > 0) {
+                tiledThreadPool()->start(new TiledBandTask(last, &done));
+                ++nb_tasks;
+            }
+            last = p.band(r, qMin(rows, p.tileRows() - r));
+        }
+    }
+    if (last.height > 0)
+        last.convert();
+    done.acquire(nb_tasks);
+}
+
 typedef struct {
     enum AVCodecID id;
     cedarv_stream_format_e format;
@@ -279,7 +377,15 @@ public:
         , map_y(map32x32_to_yuv_Y)
         , map_c(map32x32_to_yuv_C)
         , pixfmt(VideoDecoderCedarv::NV12)
-    {}
+        , threads(0)
+    {
+#if QTAV_HAVE(NEON)
+        if (detect_neon()) {
+            map_y = TiledToPlanar_NEON;
+            map_c = TiledDeinterleaveToPlanar_NEON;
+        }
+#endif
+    }
     ~VideoDecoderCedarvPrivate() {
         if (!cedarv)
             return;
@@ -293,11 +399,10 @@ public:
 
     CEDARV_DECODER *cedarv;
     cedarv_picture_t cedarPicture;
-    typedef void (*map_y_t)(void* src, void* dst, unsigned int dst_pitch, unsigned int w, unsigned int h);
     map_y_t map_y;
-    typedef void (*map_c_t)(void* src, void* dst1, void* dst2, unsigned int dst_pitch, unsigned int w, unsigned int h);
     map_c_t map_c;
     VideoDecoderCedarv::PixFmt pixfmt;
+    int threads;
 };
 
 VideoDecoderCedarv::VideoDecoderCedarv()
@@ -316,7 +421,11 @@ void VideoDecoderCedarv::setNeon(bool value)
         return;
     DPTR_D(VideoDecoderCedarv);
     if (value) {
-#ifndef NO_NEON_OPT //Don't HAVE_NEON
+        // intrinsics if built, otherwise libvdpau-sunxi asm
+#if QTAV_HAVE(NEON)
+        d.map_y = TiledToPlanar_NEON;
+        d.map_c = TiledDeinterleaveToPlanar_NEON;
+#elif !defined(NO_NEON_OPT) //Don't HAVE_NEON
         d.map_y = tiled_to_planar;
         d.map_c = tiled_deinterleave_to_planar;
 #endif
@@ -340,6 +449,19 @@ VideoDecoderCedarv::PixFmt VideoDecoderCedarv::outputPixelFormat() const
     return d_func().pixfmt;
 }
 
+void VideoDecoderCedarv::setThreads(int value)
+{
+    if (threads() == value)
+        return;
+    d_func().threads = value;
+    emit threadsChanged();
+}
+
+int VideoDecoderCedarv::threads() const
+{
+    return d_func().threads;
+}
+
 bool VideoDecoderCedarv::neon() const
 {
     return d_func().map_y != map32x32_to_yuv_Y;
@@ -507,11 +629,26 @@ VideoFrame VideoDecoderCedarv::frame()
     if (nv12)
         pitch[1] = dst_y_stride;
 
-    d.map_y(d.cedarPicture.y, plane[0], display_w_align, pitch[0], display_h_align);
-    if (nv12)
-        d.map_y(d.cedarPicture.u, plane[1], pitch[1], display_w_align, display_h_align/2);
-    else
-        d.map_c(d.cedarPicture.u, plane[1], plane[2], pitch[1], display_w_align, display_h_align/2); //vdpau use w, h/2
+    // 1080p output is ~3MB read from uncached memory. split to cores. A20 has 2 cores
+    TiledPlane planes[2];
+    planes[0].map_y = d.map_y;
+    planes[0].src = (quint8*)d.cedarPicture.y;
+    planes[0].dst = plane[0];
+    planes[0].dst_pitch = pitch[0];
+    planes[0].width = display_w_align;
+    planes[0].height = display_h_align;
+    planes[1].src = (quint8*)d.cedarPicture.u;
+    planes[1].dst = plane[1];
+    planes[1].dst_pitch = pitch[1];
+    planes[1].width = display_w_align; //vdpau use w, h/2
+    planes[1].height = display_h_align/2;
+    if (nv12) {
+        planes[1].map_y = d.map_y;
+    } else {
+        planes[1].map_c = d.map_c;
+        planes[1].dst2 = plane[2];
+    }
+    convertTiled(planes, 2, d.threads);
 
     const VideoFormat fmt(nv12 ? VideoFormat::Format_NV12 : VideoFormat::Format_YUV420P);
     VideoFrame frame(buf, display_w_align, display_h_align, fmt);
@@ -0,0 +1,609 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "VideoDecoderFFmpegHW.h"
+#include "VideoDecoderFFmpegHW_p.h"
+#include "QtAV/private/AVCompat.h"
+#include "QtAV/private/prepost.h"
+#include "utils/Logger.h"
+#include "SurfaceInteropD3D11.h"
+#define DX_LOG_COMPONENT "D3D11VA"
+#include "utils/DirectXHelper.h"
+
+// see VideoDecoderDXVA.cpp
+#ifndef FF_PROFILE_HEVC_MAIN //libav does not define it
+#define AV_CODEC_ID_HEVC QTAV_CODEC_ID(NONE)
+#define FF_PROFILE_HEVC_MAIN -1
+#define FF_PROFILE_HEVC_MAIN_10 -1
+#endif
+
+extern "C" {
+#include <libavcodec/d3d11va.h> //will include d3d11.h
+}
+#define VA_D3D11_MAX_SURFACE_COUNT (64)
+
+#include <d3d11.h>
+#include <d3d10.h> // ID3D10Multithread
+
+// decoder profile guids are the same as dxva2 mode guids
+#define MS_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+    static const GUID name = { l, w1, w2, {b1, b2, b3, b4, b5, b6, b7, b8}}
+
+MS_GUID(IID_ID3D10Multithread_QtAV, 0x9b7e4e00, 0x342c, 0x4106, 0xa1, 0x9f, 0x4f, 0x27, 0x04, 0xf6, 0x89, 0xf0);
+
+MS_GUID(D3D11_NoEncrypt,               0x1b81bed0, 0xa0c7, 0x11d3, 0xb9, 0x84, 0x00, 0xc0, 0x4f, 0x2e, 0x73, 0xc5);
+MS_GUID(D3D11_ModeMPEG2_VLD,           0xee27417f, 0x5e28, 0x4e65, 0xbe, 0xea, 0x1d, 0x26, 0xb5, 0x08, 0xad, 0xc9);
+MS_GUID(D3D11_ModeMPEG2and1_VLD,       0x86695f12, 0x340e, 0x4f04, 0x9f, 0xd3, 0x92, 0x53, 0xdd, 0x32, 0x74, 0x60);
+MS_GUID(D3D11_ModeH264_E,              0x1b81be68, 0xa0c7, 0x11d3, 0xb9, 0x84, 0x00, 0xc0, 0x4f, 0x2e, 0x73, 0xc5);
+MS_GUID(D3D11_ModeH264_F,              0x1b81be69, 0xa0c7, 0x11d3, 0xb9, 0x84, 0x00, 0xc0, 0x4f, 0x2e, 0x73, 0xc5);
+MS_GUID(D3D11_Intel_H264_NoFGT_ClearVideo, 0x604F8E68, 0x4951, 0x4c54, 0x88, 0xFE, 0xAB, 0xD2, 0x5C, 0x15, 0xB3, 0xD6);
+MS_GUID(D3D11_ModeVC1_D,               0x1b81beA3, 0xa0c7, 0x11d3, 0xb9, 0x84, 0x00, 0xc0, 0x4f, 0x2e, 0x73, 0xc5);
+MS_GUID(D3D11_ModeVC1_D2010,           0x1b81beA4, 0xa0c7, 0x11d3, 0xb9, 0x84, 0x00, 0xc0, 0x4f, 0x2e, 0x73, 0xc5);
+MS_GUID(D3D11_ModeHEVC_VLD_Main,       0x5b11d51b, 0x2f4c, 0x4452, 0xbc, 0xc3, 0x09, 0xf2, 0xa1, 0x16, 0x0c, 0xc0);
+MS_GUID(D3D11_ModeHEVC_VLD_Main10,     0x107af0e0, 0xef1a, 0x4d19, 0xab, 0xa8, 0x67, 0xa1, 0x63, 0x07, 0x3d, 0x13);
+
+namespace QtAV {
+
+class VideoDecoderD3D11Private;
+class VideoDecoderD3D11 : public VideoDecoderFFmpegHW
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(VideoDecoderD3D11)
+    Q_PROPERTY(int surfaces READ surfaces WRITE setSurfaces)
+public:
+    VideoDecoderD3D11();
+    VideoDecoderId id() const Q_DECL_OVERRIDE;
+    QString description() const Q_DECL_OVERRIDE;
+    VideoFrame frame() Q_DECL_OVERRIDE;
+    // properties
+    void setSurfaces(int num);
+    int surfaces() const;
+};
+
+extern VideoDecoderId VideoDecoderId_D3D11;
+FACTORY_REGISTER_ID_AUTO(VideoDecoder, D3D11, "D3D11")
+
+void RegisterVideoDecoderD3D11_Man()
+{
+    FACTORY_REGISTER_ID_MAN(VideoDecoder, D3D11, "D3D11")
+}
+
+typedef struct {
+    ID3D11VideoDecoderOutputView *view;
+    int index; // array slice in the decoded texture
+    int refcount;
+    unsigned int order;
+} va_surface_t;
+
+static const int PROF_MPEG2_SIMPLE[] = { FF_PROFILE_MPEG2_SIMPLE, 0 };
+static const int PROF_MPEG2_MAIN[]   = { FF_PROFILE_MPEG2_SIMPLE, FF_PROFILE_MPEG2_MAIN, 0 };
+static const int PROF_H264_HIGH[]    = { FF_PROFILE_H264_CONSTRAINED_BASELINE, FF_PROFILE_H264_MAIN, FF_PROFILE_H264_HIGH, 0 };
+static const int PROF_HEVC_MAIN[]    = { FF_PROFILE_HEVC_MAIN, 0 };
+static const int PROF_HEVC_MAIN10[]  = { FF_PROFILE_HEVC_MAIN, FF_PROFILE_HEVC_MAIN_10, 0 };
+typedef struct {
+    const char   *name;
+    const GUID   *guid;
+    int          codec;
+    const int    *profiles;
+} d3d11va_mode_t;
+/* Prefered modes must come first. only NV12 output decoders are listed */
+static const d3d11va_mode_t d3d11va_modes[] = {
+    { "MPEG-2 variable-length decoder",                                               &D3D11_ModeMPEG2_VLD,               QTAV_CODEC_ID(MPEG2VIDEO), PROF_MPEG2_SIMPLE },
+    { "MPEG-2 & MPEG-1 variable-length decoder",                                      &D3D11_ModeMPEG2and1_VLD,           QTAV_CODEC_ID(MPEG2VIDEO), PROF_MPEG2_MAIN },
+    { "MPEG-2 & MPEG-1 variable-length decoder",                                      &D3D11_ModeMPEG2and1_VLD,           QTAV_CODEC_ID(MPEG1VIDEO), NULL },
+    { "H.264 variable-length decoder, film grain technology",                         &D3D11_ModeH264_F,                  QTAV_CODEC_ID(H264), PROF_H264_HIGH },
+    { "H.264 variable-length decoder, no film grain technology (Intel ClearVideo)",   &D3D11_Intel_H264_NoFGT_ClearVideo, QTAV_CODEC_ID(H264), PROF_H264_HIGH },
+    { "H.264 variable-length decoder, no film grain technology",                      &D3D11_ModeH264_E,                  QTAV_CODEC_ID(H264), PROF_H264_HIGH },
+    { "VC-1 variable-length decoder",                                                 &D3D11_ModeVC1_D,                   QTAV_CODEC_ID(VC1), NULL },
+    { "VC-1 variable-length decoder",                                                 &D3D11_ModeVC1_D,                   QTAV_CODEC_ID(WMV3), NULL },
+    { "VC-1 variable-length decoder",                                                 &D3D11_ModeVC1_D2010,               QTAV_CODEC_ID(VC1), NULL },
+    { "VC-1 variable-length decoder",                                                 &D3D11_ModeVC1_D2010,               QTAV_CODEC_ID(WMV3), NULL },
+    { "HEVC Main profile",                                                            &D3D11_ModeHEVC_VLD_Main,           QTAV_CODEC_ID(HEVC), PROF_HEVC_MAIN },
+    // TODO: P010 output for main10
+    { NULL, NULL, 0, NULL }
+};
+
+static bool checkProfile(const d3d11va_mode_t *mode, int profile)
+{
+    if (!mode->profiles || !mode->profiles[0] || profile <= 0)
+        return true;
+    for (const int *p = &mode->profiles[0]; *p; ++p) {
+        if (*p == profile)
+            return true;
+    }
+    return false;
+}
+
+class VideoDecoderD3D11Private Q_DECL_FINAL: public VideoDecoderFFmpegHWPrivate
+{
+public:
+    VideoDecoderD3D11Private():
+        VideoDecoderFFmpegHWPrivate()
+    {
+#if QTAV_HAVE(D3D11_EGL)
+        if (OpenGLHelper::isOpenGLES())
+            copy_mode = VideoDecoderFFmpegHW::ZeroCopy;
+#endif
+        d3d11_dll = 0;
+        d3ddev = 0;
+        d3dctx = 0;
+        video_dev = 0;
+        video_ctx = 0;
+        decoder = 0;
+        texture = 0;
+        staging = 0;
+        surface_order = 0;
+        surface_width = surface_height = 0;
+        memset(surfaces, 0, sizeof(surfaces));
+        // d3d11.dll is loaded in open() when the decoder is selected
+        // set by user. don't reset in when call destroy
+        surface_auto = true;
+        surface_count = 0;
+    }
+    virtual ~VideoDecoderD3D11Private()
+    {
+        unloadDll();
+    }
+
+    bool loadDll();
+    bool unloadDll();
+    bool createDevice();
+    void destroyDevice();
+    bool findDecoderProfile(GUID *input);
+    bool createDecoder(int codec_id, int w, int h);
+    void destroyDecoder();
+    bool ensureStaging();
+
+    bool setup(AVCodecContext *avctx) Q_DECL_OVERRIDE;
+    bool open() Q_DECL_OVERRIDE;
+    QByteArray capabilityStamp() const Q_DECL_OVERRIDE { return DXHelper::DriverStamp();}
+    void close() Q_DECL_OVERRIDE;
+    // get aligned value depending on codec
+    int aligned(int x);
+
+    bool getBuffer(void **opaque, uint8_t **data) Q_DECL_OVERRIDE;
+    void releaseBuffer(void *opaque, uint8_t *data) Q_DECL_OVERRIDE;
+    AVPixelFormat vaPixelFormat() const Q_DECL_OVERRIDE { return QTAV_PIX_FMT_C(D3D11VA_VLD);}
+
+    HINSTANCE d3d11_dll;
+    ID3D11Device *d3ddev;
+    ID3D11DeviceContext *d3dctx;
+    ID3D11VideoDevice *video_dev;
+    ID3D11VideoContext *video_ctx;
+    GUID input;
+
+    D3D11_VIDEO_DECODER_CONFIG cfg;
+    ID3D11VideoDecoder *decoder;
+    ID3D11Texture2D *texture; // NV12 texture array. a slice for each surface
+    ID3D11Texture2D *staging; // cpu readable copy of 1 slice
+
+    AVD3D11VAContext hw_ctx;
+    bool surface_auto;
+    unsigned     surface_count;
+    unsigned     surface_order;
+    int          surface_width;
+    int          surface_height;
+
+    va_surface_t surfaces[VA_D3D11_MAX_SURFACE_COUNT];
+    ID3D11VideoDecoderOutputView* hw_surfaces[VA_D3D11_MAX_SURFACE_COUNT];
+
+    d3d11::InteropResourcePtr interop_res; //may be still used in video frames when decoder is destroyed
+};
+
+VideoDecoderD3D11::VideoDecoderD3D11()
+    : VideoDecoderFFmpegHW(*new VideoDecoderD3D11Private())
+{
+    // dynamic properties about static property details. used by UI
+    // format: detail_property
+    setProperty("detail_surfaces", tr("Decoding surfaces.") + QStringLiteral(" ") + tr("0: auto"));
+}
+
+VideoDecoderId VideoDecoderD3D11::id() const
+{
+    return VideoDecoderId_D3D11;
+}
+
+QString VideoDecoderD3D11::description() const
+{
+    DPTR_D(const VideoDecoderD3D11);
+    if (!d.description.isEmpty())
+        return d.description;
+    return QStringLiteral("D3D11 Video Acceleration");
+}
+
+VideoFrame VideoDecoderD3D11::frame()
+{
+    DPTR_D(VideoDecoderD3D11);
+    if (!d.frame->opaque || !d.frame->data[0])
+        return VideoFrame();
+    if (d.frame->width <= 0 || d.frame->height <= 0 || !d.codec_ctx)
+        return VideoFrame();
+
+    const va_surface_t *surface = (va_surface_t*)d.frame->opaque;
+    if (copyMode() == ZeroCopy && d.interop_res) {
+        d3d11::SurfaceInteropD3D11 *interop = new d3d11::SurfaceInteropD3D11(d.interop_res);
+        interop->setSurface(d.texture, surface->index, width(), height());
+        VideoFrame f(width(), height(), VideoFormat::Format_RGB32);
+        f.setBytesPerLine(d.width * 4); //used by gl to compute texture size
+        f.setSurfaceInterop(VideoSurfaceInteropPtr(interop));
+        f.setTimestamp(d.frame->pkt_pts/1000.0);
+        f.setDisplayAspectRatio(d.getDAR(d.frame));
+        return f;
+    }
+    if (!d.ensureStaging())
+        return VideoFrame();
+    d.d3dctx->CopySubresourceRegion(d.staging, 0, 0, 0, 0, d.texture, surface->index, NULL);
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    DX_ENSURE_OK(d.d3dctx->Map(d.staging, 0, D3D11_MAP_READ, 0, &mapped), VideoFrame());
+    int pitch[3] = { (int)mapped.RowPitch, 0, 0}; //compute chroma later
+    uint8_t *src[] = { (uint8_t*)mapped.pData, 0, 0}; //compute chroma later
+    const VideoFrame f(copyToFrame(VideoFormat::Format_NV12, d.surface_height, src, pitch, false));
+    d.d3dctx->Unmap(d.staging, 0);
+    return f;
+}
+
+void VideoDecoderD3D11::setSurfaces(int num)
+{
+    DPTR_D(VideoDecoderD3D11);
+    d.surface_count = num;
+    d.surface_auto = num <= 0;
+}
+
+int VideoDecoderD3D11::surfaces() const
+{
+    return d_func().surface_count;
+}
+
+bool VideoDecoderD3D11Private::getBuffer(void **opaque, uint8_t **data)
+{
+    /* Grab an unused surface, in case none are, try the oldest */
+    unsigned i, old;
+    for (i = 0, old = 0; i < surface_count; i++) {
+        va_surface_t *surface = &surfaces[i];
+        if (!surface->refcount)
+            break;
+        if (surface->order < surfaces[old].order)
+            old = i;
+    }
+    if (i >= surface_count) {
+        i = old;
+        ++surface_starvation;
+    }
+    va_surface_t *surface = &surfaces[i];
+    surface->refcount = 1;
+    surface->order = surface_order++;
+    *data = (uint8_t*)surface->view; // ff_d3d11va_get_surface() reads data[3]
+    *opaque = surface;
+    return true;
+}
+
+void VideoDecoderD3D11Private::releaseBuffer(void *opaque, uint8_t *data)
+{
+    Q_UNUSED(data);
+    va_surface_t *surface = (va_surface_t*)opaque;
+    surface->refcount--;
+}
+
+bool VideoDecoderD3D11Private::loadDll() {
+    d3d11_dll = LoadLibrary(TEXT("D3D11.DLL"));
+    if (!d3d11_dll) {
+        qWarning("cannot load d3d11.dll");
+        return false;
+    }
+    return true;
+}
+
+bool VideoDecoderD3D11Private::unloadDll() {
+    if (d3d11_dll)
+        FreeLibrary(d3d11_dll);
+    return true;
+}
+
+bool VideoDecoderD3D11Private::createDevice()
+{
+    PFN_D3D11_CREATE_DEVICE fCreateDevice = (PFN_D3D11_CREATE_DEVICE)GetProcAddress(d3d11_dll, "D3D11CreateDevice");
+    if (!fCreateDevice) {
+        qWarning("cannot load function D3D11CreateDevice");
+        return false;
+    }
+    static const D3D_FEATURE_LEVEL levels[] = {
+        D3D_FEATURE_LEVEL_11_1,
+        D3D_FEATURE_LEVEL_11_0,
+        D3D_FEATURE_LEVEL_10_1,
+        D3D_FEATURE_LEVEL_10_0,
+        D3D_FEATURE_LEVEL_9_3,
+    };
+    // bgra support is required by d2d device contexts which draw the decoded textures
+    const UINT flags = D3D11_CREATE_DEVICE_VIDEO_SUPPORT | D3D11_CREATE_DEVICE_BGRA_SUPPORT;
+    HRESULT hr = fCreateDevice(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, flags, levels, sizeof(levels)/sizeof(levels[0]), D3D11_SDK_VERSION, &d3ddev, NULL, &d3dctx);
+    if (hr == E_INVALIDARG) // D3D_FEATURE_LEVEL_11_1 is not recognized by d3d11.0 runtime (win7 without platform update)
+        hr = fCreateDevice(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, flags, &levels[1], sizeof(levels)/sizeof(levels[0]) - 1, D3D11_SDK_VERSION, &d3ddev, NULL, &d3dctx);
+    DX_ENSURE_OK(hr, false);
+    // ffmpeg decodes in decoder thread and the interop/copy runs in render thread, both with the immediate context
+    ID3D10Multithread *mt = NULL;
+    if (SUCCEEDED(d3ddev->QueryInterface(IID_ID3D10Multithread_QtAV, (void**)&mt))) {
+        mt->SetMultithreadProtected(TRUE);
+        SafeRelease(&mt);
+    }
+    DX_ENSURE_OK(d3ddev->QueryInterface(__uuidof(ID3D11VideoDevice), (void**)&video_dev), false);
+    DX_ENSURE_OK(d3dctx->QueryInterface(__uuidof(ID3D11VideoContext), (void**)&video_ctx), false);
+    IDXGIDevice *dxgi_dev = NULL;
+    if (SUCCEEDED(d3ddev->QueryInterface(__uuidof(IDXGIDevice), (void**)&dxgi_dev))) {
+        IDXGIAdapter *adapter = NULL;
+        if (SUCCEEDED(dxgi_dev->GetAdapter(&adapter))) {
+            DXGI_ADAPTER_DESC desc;
+            if (SUCCEEDED(adapter->GetDesc(&desc))) {
+                description = QString().sprintf("D3D11VA (%s, vendor %lu, device %lu, revision %lu)",
+                                                qPrintable(QString::fromWCharArray(desc.Description)),
+                                                (unsigned long)desc.VendorId, (unsigned long)desc.DeviceId, (unsigned long)desc.Revision);
+                qDebug("D3D11VA description:  %s", description.toUtf8().constData());
+            }
+            SafeRelease(&adapter);
+        }
+        SafeRelease(&dxgi_dev);
+    }
+    return true;
+}
+
+void VideoDecoderD3D11Private::destroyDevice()
+{
+    SafeRelease(&video_ctx);
+    SafeRelease(&video_dev);
+    SafeRelease(&d3dctx);
+    SafeRelease(&d3ddev);
+}
+
+bool VideoDecoderD3D11Private::findDecoderProfile(GUID *input)
+{
+    const UINT count = video_dev->GetVideoDecoderProfileCount();
+    QVector<GUID> profiles(count);
+    for (UINT i = 0; i < count; ++i)
+        video_dev->GetVideoDecoderProfile(i, &profiles[i]);
+    /* Try all supported mode by our priority */
+    for (const d3d11va_mode_t *mode = d3d11va_modes; mode->name; ++mode) {
+        if (!mode->codec || mode->codec != codec_ctx->codec_id)
+            continue;
+        if (!profiles.contains(*mode->guid))
+            continue;
+        qDebug("Check profile support: %s", AVDecoderPrivate::getProfileName(codec_ctx));
+        if (!checkProfile(mode, codec_ctx->profile))
+            continue;
+        BOOL supported = FALSE;
+        if (FAILED(video_dev->CheckVideoDecoderFormat(mode->guid, DXGI_FORMAT_NV12, &supported)) || !supported)
+            continue;
+        qDebug("Using '%s' to decode to NV12", mode->name);
+        *input = *mode->guid;
+        return true;
+    }
+    return false;
+}
+
+bool VideoDecoderD3D11Private::createDecoder(int codec_id, int w, int h)
+{
+    if (!video_dev || !d3ddev) {
+        qWarning("d3d11 is not ready. ID3D11VideoDevice: %p, ID3D11Device: %p", video_dev, d3ddev);
+        return false;
+    }
+    surface_width = aligned(w);
+    surface_height = aligned(h);
+    if (surface_auto)
+        surface_count = autoSurfaceCount(codec_ctx, (codec_ctx->active_thread_type & FF_THREAD_FRAME) ? codec_ctx->thread_count : 0);
+    surface_count = qMin<unsigned>(surface_count, VA_D3D11_MAX_SURFACE_COUNT);
+    if (surface_count == 0)
+        surface_count = 16 + 4;
+    qDebug("D3D11 createDecoder id %d %dx%d, surfaces: %u", codec_id, surface_width, surface_height, surface_count);
+    D3D11_TEXTURE2D_DESC tex_desc;
+    ZeroMemory(&tex_desc, sizeof(tex_desc));
+    tex_desc.Width = surface_width;
+    tex_desc.Height = surface_height;
+    tex_desc.MipLevels = 1;
+    tex_desc.ArraySize = surface_count;
+    tex_desc.Format = DXGI_FORMAT_NV12;
+    tex_desc.SampleDesc.Count = 1;
+    tex_desc.Usage = D3D11_USAGE_DEFAULT;
+    tex_desc.BindFlags = D3D11_BIND_DECODER;
+    DX_ENSURE_OK(d3ddev->CreateTexture2D(&tex_desc, NULL, &texture), false);
+    surface_bytes = qint64(surface_count)*surface_width*surface_height*3/2; // nv12
+    memset(surfaces, 0, sizeof(surfaces));
+    for (unsigned i = 0; i < surface_count; i++) {
+        D3D11_VIDEO_DECODER_OUTPUT_VIEW_DESC view_desc;
+        ZeroMemory(&view_desc, sizeof(view_desc));
+        view_desc.DecodeProfile = input;
+        view_desc.ViewDimension = D3D11_VDOV_DIMENSION_TEXTURE2D;
+        view_desc.Texture2D.ArraySlice = i;
+        DX_ENSURE_OK(video_dev->CreateVideoDecoderOutputView(texture, &view_desc, &surfaces[i].view), false);
+        surfaces[i].index = i;
+    }
+
+    D3D11_VIDEO_DECODER_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Guid = input;
+    desc.SampleWidth = w;
+    desc.SampleHeight = h;
+    desc.OutputFormat = DXGI_FORMAT_NV12;
+    UINT cfg_count = 0;
+    DX_ENSURE_OK(video_dev->GetVideoDecoderConfigCount(&desc, &cfg_count), false);
+    qDebug("we got %d decoder configurations", cfg_count);
+    /* Select the best decoder configuration */
+    int cfg_score = 0;
+    for (UINT i = 0; i < cfg_count; i++) {
+        D3D11_VIDEO_DECODER_CONFIG c;
+        if (FAILED(video_dev->GetVideoDecoderConfig(&desc, i, &c)))
+            continue;
+        int score;
+        if (c.ConfigBitstreamRaw == 1)
+            score = 1;
+        else if (codec_id == QTAV_CODEC_ID(H264) && c.ConfigBitstreamRaw == 2)
+            score = 2;
+        else
+            continue;
+        if (IsEqualGUID(c.guidConfigBitstreamEncryption, D3D11_NoEncrypt))
+            score += 16;
+        if (cfg_score < score) {
+            cfg = c;
+            cfg_score = score;
+        }
+    }
+    if (cfg_score <= 0) {
+        qWarning("Failed to find a supported decoder configuration");
+        return false;
+    }
+    DX_ENSURE_OK(video_dev->CreateVideoDecoder(&desc, &cfg, &decoder), false);
+    qDebug("ID3D11VideoDevice::CreateVideoDecoder succeed. decoder=%p", decoder);
+    return true;
+}
+
+void VideoDecoderD3D11Private::destroyDecoder()
+{
+    SafeRelease(&decoder);
+    for (unsigned i = 0; i < VA_D3D11_MAX_SURFACE_COUNT; i++) {
+        SafeRelease(&surfaces[i].view);
+    }
+    SafeRelease(&staging);
+    SafeRelease(&texture);
+    surface_bytes = 0;
+}
+
+bool VideoDecoderD3D11Private::ensureStaging()
+{
+    if (staging)
+        return true;
+    D3D11_TEXTURE2D_DESC desc;
+    texture->GetDesc(&desc);
+    desc.ArraySize = 1;
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    desc.MiscFlags = 0;
+    DX_ENSURE_OK(d3ddev->CreateTexture2D(&desc, NULL, &staging), false);
+    return true;
+}
+
+static bool check_ffmpeg_hwaccel(const char* name)
+{
+    avcodec_register_all();
+    AVHWAccel *hwa = av_hwaccel_next(0);
+    while (hwa) {
+        if (strcmp(name, hwa->name) == 0)
+            return true;
+        hwa = av_hwaccel_next(hwa);
+    }
+    return false;
+}
+
+// hwaccel_context
+bool VideoDecoderD3D11Private::setup(AVCodecContext *avctx)
+{
+    const int w = codedWidth(avctx);
+    const int h = codedHeight(avctx);
+    if (decoder && surface_width == aligned(w) && surface_height == aligned(h)) {
+        avctx->hwaccel_context = &hw_ctx;
+        return true;
+    }
+    width = avctx->width; // not necessary. set in decode()
+    height = avctx->height;
+    releaseUSWC();
+    destroyDecoder();
+    avctx->hwaccel_context = NULL;
+    if (!createDecoder(avctx->codec_id, w, h))
+        return false;
+    avctx->hwaccel_context = &hw_ctx;
+    memset(&hw_ctx, 0, sizeof(hw_ctx));
+#ifdef FF_DXVA2_WORKAROUND_INTEL_CLEARVIDEO
+    if (IsEqualGUID(input, D3D11_Intel_H264_NoFGT_ClearVideo))
+        hw_ctx.workaround |= FF_DXVA2_WORKAROUND_INTEL_CLEARVIDEO;
+#endif
+    hw_ctx.decoder = decoder;
+    hw_ctx.video_context = video_ctx;
+    hw_ctx.cfg = &cfg;
+    hw_ctx.surface_count = surface_count;
+    hw_ctx.surface = hw_surfaces;
+    memset(hw_surfaces, 0, sizeof(hw_surfaces));
+    for (unsigned i = 0; i < surface_count; i++)
+        hw_ctx.surface[i] = surfaces[i].view;
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 24, 100) // FFmpeg 3.0
+    // the device is multithread protected. no extra lock is required
+    hw_ctx.context_mutex = INVALID_HANDLE_VALUE;
+#endif
+    initUSWC(surface_width);
+    return true;
+}
+
+bool VideoDecoderD3D11Private::open()
+{
+    if (!d3d11_dll && !loadDll())
+        return false;
+    if (!prepare())
+        return false;
+    // runtime check. d3d11va hwaccels are added in FFmpeg 2.7
+    const QByteArray hwa_name = QByteArray(avcodec_get_name(codec_ctx->codec_id)).append("_d3d11va");
+    if (!check_ffmpeg_hwaccel(hwa_name.constData())) {
+        qWarning("%s is not supported by current FFmpeg runtime.", hwa_name.constData());
+        reportCapability(QStringLiteral("D3D11"), false);
+        return false;
+    }
+    if (!createDevice()) {
+        qWarning("Failed to create Direct3D11 device");
+        goto error;
+    }
+    if (!findDecoderProfile(&input)) {
+        qWarning("No D3D11 decoder profile for %s", avcodec_get_name(codec_ctx->codec_id));
+        reportCapability(QStringLiteral("D3D11"), false);
+        goto error;
+    }
+    interop_res.clear();
+#if QTAV_HAVE(D3D11_EGL)
+    if (OpenGLHelper::isOpenGLES())
+        interop_res = d3d11::InteropResourcePtr(new d3d11::EGLInteropResource(d3ddev));
+#endif
+    // dxgi based renderers(Direct2D) draw the decoded textures on the decoder device. opengl renderers without ANGLE copy them back
+    if (!interop_res && copy_mode == VideoDecoderFFmpegHW::ZeroCopy)
+        interop_res = d3d11::InteropResourcePtr(new d3d11::InteropResource(d3ddev));
+    reportCapability(QStringLiteral("D3D11"), true);
+    return true;
+error:
+    close();
+    return false;
+}
+
+void VideoDecoderD3D11Private::close()
+{
+    restore();
+    releaseUSWC();
+    destroyDecoder();
+    destroyDevice();
+}
+
+int VideoDecoderD3D11Private::aligned(int x)
+{
+    // from lavfilters
+    int align = 16;
+    // MPEG-2 needs higher alignment on Intel cards, and it doesn't seem to harm anything to do it for all cards.
+    if (codec_ctx->codec_id == QTAV_CODEC_ID(MPEG2VIDEO))
+      align <<= 1;
+    else if (codec_ctx->codec_id == QTAV_CODEC_ID(HEVC))
+      align = 128;
+    return FFALIGN(x, align);
+}
+
+} //namespace QtAV
+
+#include "VideoDecoderD3D11.moc"
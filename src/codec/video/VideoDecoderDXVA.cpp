@@ -309,7 +309,7 @@ static const d3d_format_t d3d_formats[] = {
     { "YV12",   (D3DFORMAT)MAKEFOURCC('Y','V','1','2'),    VideoFormat::Format_YUV420P },
     { "NV12",   (D3DFORMAT)MAKEFOURCC('N','V','1','2'),    VideoFormat::Format_NV12 },
     { "IMC3",   (D3DFORMAT)MAKEFOURCC('I','M','C','3'),    VideoFormat::Format_YUV420P },
-    { "P010",   (D3DFORMAT)MAKEFOURCC('P','0','1','0'),    VideoFormat::Format_YUV420P10LE },
+    { "P010",   (D3DFORMAT)MAKEFOURCC('P','0','1','0'),    VideoFormat::Format_P010LE },
     { "P016",   (D3DFORMAT)MAKEFOURCC('P','0','1','6'),    VideoFormat::Format_YUV420P16LE },
     { NULL, D3DFMT_UNKNOWN, VideoFormat::Format_Invalid }
 };
@@ -377,7 +377,7 @@ public:
         decoder = 0;
         surface_order = 0;
         surface_width = surface_height = 0;
-        available = loadDll();
+        // d3d9.dll and dxva2.dll are loaded in open() when the decoder is selected
         // set by user. don't reset in when call destroy
         surface_auto = true;
         surface_count = 0;
@@ -403,6 +403,7 @@ public:
 
     bool setup(AVCodecContext *avctx) Q_DECL_OVERRIDE;
     bool open() Q_DECL_OVERRIDE;
+    QByteArray capabilityStamp() const Q_DECL_OVERRIDE { return DXHelper::DriverStamp();}
     void close() Q_DECL_OVERRIDE;
     // get aligned value depending on codec
     int aligned(int x);
@@ -482,7 +483,7 @@ VideoFrame VideoDecoderDXVA::frame()
         interop->setSurface(d3d, width(), height());
         VideoFrame f(width(), height(), VideoFormat::Format_RGB32); //p->width()
         f.setBytesPerLine(d.width * 4); //used by gl to compute texture size
-        f.setMetaData(QStringLiteral("surface_interop"), QVariant::fromValue(VideoSurfaceInteropPtr(interop)));
+        f.setSurfaceInterop(VideoSurfaceInteropPtr(interop));
         f.setTimestamp(d.frame->pkt_pts/1000.0);
         f.setDisplayAspectRatio(d.getDAR(d.frame));
         return f;
@@ -559,8 +560,10 @@ bool VideoDecoderDXVAPrivate::getBuffer(void **opaque, uint8_t **data)//vlc_va_t
         if (surface->order < surfaces[old].order)
             old = i;
     }
-    if (i >= surface_count)
+    if (i >= surface_count) {
         i = old;
+        ++surface_starvation;
+    }
     va_surface_t *surface = &surfaces[i];
     surface->refcount = 1;
     surface->order = surface_order++;
@@ -587,6 +590,7 @@ bool VideoDecoderDXVAPrivate::loadDll() {
     if (!hdxva2_dll) {
         qWarning("cannot load dxva2.dll");
         FreeLibrary(hd3d9_dll);
+        hd3d9_dll = 0;
         return false;
     }
     return true;
@@ -764,22 +768,9 @@ bool VideoDecoderDXVAPrivate::DxCreateVideoDecoder(int codec_id, int w, int h)
     /* Allocates all surfaces needed for the decoder */
     surface_width = aligned(w);
     surface_height = aligned(h);
-    if (surface_auto) {
-        switch (codec_id) {
-        case QTAV_CODEC_ID(HEVC):
-        case QTAV_CODEC_ID(H264):
-            surface_count = 16 + 4;
-            break;
-        case QTAV_CODEC_ID(MPEG1VIDEO):
-        case QTAV_CODEC_ID(MPEG2VIDEO):
-            surface_count = 2 + 4;
-        default:
-            surface_count = 2 + 4;
-            break;
-        }
-        if (codec_ctx->active_thread_type & FF_THREAD_FRAME)
-            surface_count += codec_ctx->thread_count;
-    }
+    if (surface_auto)
+        surface_count = autoSurfaceCount(codec_ctx, (codec_ctx->active_thread_type & FF_THREAD_FRAME) ? codec_ctx->thread_count : 0);
+    surface_count = qMin<unsigned>(surface_count, VA_DXVA2_MAX_SURFACE_COUNT);
     qDebug(">>>>>>>>>>>>>>>>>>>>>surfaces: %d, active_thread_type: %d, threads: %d, refs: %d", surface_count, codec_ctx->active_thread_type, codec_ctx->thread_count, codec_ctx->refs);
     if (surface_count == 0) {
         qWarning("internal error: wrong surface count.  %u auto=%d", surface_count, surface_auto);
@@ -807,6 +798,8 @@ bool VideoDecoderDXVAPrivate::DxCreateVideoDecoder(int codec_id, int w, int h)
         surface->order = 0;
     }
     qDebug("IDirectXVideoAccelerationService_CreateSurface succeed with %d surfaces (%dx%d)", surface_count, w, h);
+    const int bpp = VideoFormat(pixelFormatFromD3D(render)).bitsPerPixel();
+    surface_bytes = qint64(surface_count)*surface_width*surface_height*(bpp > 0 ? bpp : 12)/8;
 
     /* */
     DXVA2_VideoDesc dsc;
@@ -877,6 +870,7 @@ void VideoDecoderDXVAPrivate::DxDestroyVideoDecoder()
     for (unsigned i = 0; i < surface_count; i++) {
         SafeRelease(&surfaces[i].d3d);
     }
+    surface_bytes = 0;
 }
 
 bool VideoDecoderDXVAPrivate::DxResetVideoDecoder()
@@ -944,6 +938,8 @@ bool VideoDecoderDXVAPrivate::setup(AVCodecContext *avctx)
 
 bool VideoDecoderDXVAPrivate::open()
 {
+    if (!hdxva2_dll && !loadDll())
+        return false;
     if (!prepare())
         return false;
     if (codec_ctx->codec_id == QTAV_CODEC_ID(HEVC)) {
@@ -952,6 +948,7 @@ bool VideoDecoderDXVAPrivate::open()
             qWarning("HEVC DXVA2 is supported by current FFmpeg runtime.");
         } else {
             qWarning("HEVC DXVA2 is not supported by current FFmpeg runtime.");
+            reportCapability(QStringLiteral("DXVA"), false);
             return false;
         }
     }
@@ -970,6 +967,7 @@ bool VideoDecoderDXVAPrivate::open()
     }
     if (!DxFindVideoServiceConversion(&input, &render)) {
         qWarning("DxFindVideoServiceConversion failed");
+        reportCapability(QStringLiteral("DXVA"), false);
         goto error;
     }
     IDirect3DDevice9Ex *devEx;
@@ -990,6 +988,7 @@ bool VideoDecoderDXVAPrivate::open()
     if (!OpenGLHelper::isOpenGLES())
         interop_res = dxva::InteropResourcePtr(new dxva::GLInteropResource(d3ddev));
 #endif
+    reportCapability(QStringLiteral("DXVA"), true);
     return true;
 error:
     close();
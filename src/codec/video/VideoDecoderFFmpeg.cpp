@@ -23,6 +23,7 @@
 #include "QtAV/private/AVCompat.h"
 #include "QtAV/private/prepost.h"
 #include "QtAV/version.h"
+#include "utils/DecodeThreadScheduler.h"
 #include "utils/Logger.h"
 
 /*!
@@ -44,8 +45,11 @@ class VideoDecoderFFmpeg : public VideoDecoderFFmpegBase
     // Force a strict standard compliance when encoding (accepted values: -2 to 2)
     //Q_PROPERTY(StrictType strict READ strict WRITE setStrict)
     Q_PROPERTY(DiscardType skip_frame READ skipFrame WRITE setSkipFrame)
+    Q_PROPERTY(int lowres READ lowres WRITE setLowres) // -1: auto from outputSizeHint()
     Q_PROPERTY(int threads READ threads WRITE setThreads) // 0 is auto
     Q_PROPERTY(ThreadFlags thread_type READ threadFlags WRITE setThreadFlags)
+    // weight of auto threads in VideoDecoder::softwareThreadBudget(). takes effect in next open
+    Q_PROPERTY(int priority READ priority WRITE setPriority)
     Q_PROPERTY(MotionVectorVisFlags vismv READ motionVectorVisFlags WRITE setMotionVectorVisFlags)
     //Q_PROPERTY(BugFlags bug READ bugFlags WRITE setBugFlags)
     Q_ENUMS(StrictType)
@@ -130,10 +134,20 @@ public:
     StrictType strict() const;
     void setSkipFrame(DiscardType value);
     DiscardType skipFrame() const;
+    /*!
+     * \brief setLowres
+     * Decode at 1/(2^value) resolution. Only some codecs support it, e.g. mpeg1/2, mpeg4 part 2, mjpeg and jpeg2000. The value
+     * is limited by the codec. Applied in open().
+     * \param value -1 (default): computed from outputSizeHint(), 0: full resolution
+     */
+    void setLowres(int value);
+    int lowres() const;
     void setThreads(int value);
     int threads() const;
     void setThreadFlags(ThreadFlags value);
     ThreadFlags threadFlags() const;
+    void setPriority(int value);
+    int priority() const;
     void setMotionVectorVisFlags(MotionVectorVisFlags value);
     MotionVectorVisFlags motionVectorVisFlags() const;
     void setBugFlags(BugFlags value);
@@ -160,20 +174,43 @@ public:
       , skip_idct(VideoDecoderFFmpeg::Default)
       , strict(VideoDecoderFFmpeg::Normal)
       , skip_frame(VideoDecoderFFmpeg::Default)
+      , lowres(-1)
       , thread_type(VideoDecoderFFmpeg::DefaultType)
       , threads(0)
+      , priority(1)
       , debug_mv(VideoDecoderFFmpeg::No)
       , bug(VideoDecoderFFmpeg::autodetect)
     {}
+    ~VideoDecoderFFmpegPrivate() {
+        // avcodec_open2() may fail after open(), then close() is not called
+        DecodeThreadScheduler::instance().release(this);
+    }
     bool open() Q_DECL_OVERRIDE {
         av_opt_set_int(codec_ctx, "skip_loop_filter", (int64_t)skip_loop_filter, 0);
         av_opt_set_int(codec_ctx, "skip_idct", (int64_t)skip_idct, 0);
         av_opt_set_int(codec_ctx, "strict", (int64_t)strict, 0);
         av_opt_set_int(codec_ctx, "skip_frame", (int64_t)skip_frame, 0);
-        av_opt_set_int(codec_ctx, "threads", (int64_t)threads, 0);
+        const int lr = computeLowres();
+        if (lr > 0)
+            qDebug("decode at 1/%d resolution", 1 << lr);
+        av_opt_set_int(codec_ctx, "lowres", (int64_t)lr, 0);
+        int nb_threads = threads;
+        if (nb_threads <= 0) { // auto. share the process wide budget with other decoders
+            // frames of intra only codecs (mjpeg, prores, dnxhd etc.) never wait for others in frame threads,
+            // so they scale with threads much better than inter codecs. each thread decodes 1 packet
+            const int weight = isIntraOnly(codec_ctx->codec_id) ? 2 : 1;
+            nb_threads = DecodeThreadScheduler::instance().acquire(this, priority*weight);
+        }
+        av_opt_set_int(codec_ctx, "threads", (int64_t)nb_threads, 0);
         av_opt_set_int(codec_ctx, "thread_type", (int64_t)thread_type, 0);
         av_opt_set_int(codec_ctx, "vismv", (int64_t)debug_mv, 0);
         av_opt_set_int(codec_ctx, "bug", (int64_t)bug, 0);
+#if QTAV_HAVE(AVBUFREF)
+        // frames kept by filters, VideoCapture and renderers hold the buffers of QtAV's pool instead of ffmpeg's
+        codec_ctx->get_buffer2 = getPoolBuffer2;
+        codec_ctx->opaque = static_cast<VideoDecoderPrivate*>(this); // for frame_allocator
+        codec_ctx->thread_safe_callbacks = 1; // FrameBufferPool and VideoFrameAllocator are thread safe
+#endif //QTAV_HAVE(AVBUFREF)
         //CODEC_FLAG_EMU_EDGE: deprecated in ffmpeg >=? & libav>=10. always set by ffmpeg
 #if 0
         if (fast) {
@@ -206,13 +243,45 @@ public:
 #endif
         return true;
     }
+    void close() Q_DECL_OVERRIDE {
+        DecodeThreadScheduler::instance().release(this);
+        if (codec_ctx && codec_ctx->opaque == static_cast<VideoDecoderPrivate*>(this))
+            codec_ctx->opaque = 0;
+    }
+    static bool isIntraOnly(AVCodecID id) {
+#ifdef AV_CODEC_PROP_INTRA_ONLY
+        const AVCodecDescriptor *cd = avcodec_descriptor_get(id);
+        return cd && (cd->props & AV_CODEC_PROP_INTRA_ONLY);
+#else
+        Q_UNUSED(id);
+        return false;
+#endif
+    }
+
+    // the largest lowres supported by codec that the frame size is not smaller than output_size_hint
+    int computeLowres() const {
+        const AVCodec *codec = avcodec_find_decoder(codec_ctx->codec_id);
+        const int max_lowres = codec ? codec->max_lowres : 0;
+        if (lowres >= 0)
+            return qMin(lowres, max_lowres);
+        if (!output_size_hint.isValid() || codec_ctx->width <= 0 || codec_ctx->height <= 0)
+            return 0;
+        int lr = 0;
+        while (lr < max_lowres
+               && (codec_ctx->width >> (lr+1)) >= output_size_hint.width()
+               && (codec_ctx->height >> (lr+1)) >= output_size_hint.height())
+            ++lr;
+        return lr;
+    }
 
     int skip_loop_filter;
     int skip_idct;
     int strict;
     int skip_frame;
+    int lowres;
     int thread_type;
     int threads;
+    int priority;
     int debug_mv;
     int bug;
 };
@@ -227,6 +296,7 @@ VideoDecoderFFmpeg::VideoDecoderFFmpeg():
     setProperty("detail_skip_idct", tr("Force skipping of idct to speed up decoding for frame types (-1=None, "
                                        "0=Default, 1=B-frames, 2=P-frames, 3=B+P frames, 4=all frames)"));
     setProperty("detail_skip_frame", tr("Force skipping frames for speed up decoding."));
+    setProperty("detail_lowres", tr("Decode at 1/2, 1/4 or 1/8 resolution if supported by codec. -1: auto from display size"));
 }
 
 VideoDecoderId VideoDecoderFFmpeg::id() const
@@ -249,7 +319,7 @@ VideoFrame VideoDecoderFFmpeg::frame()
     frame.setBits(d.frame->data);
     frame.setBytesPerLine(d.frame->linesize);
     frame.setTimestamp((double)d.frame->pkt_pts/1000.0); // in s. what about AVFrame.pts?
-    frame.setMetaData(QStringLiteral("avbuf"), QVariant::fromValue(AVFrameBuffersRef(new AVFrameBuffers(d.frame))));
+    frame.setBufferRef(AVFrameBuffersRef(new AVFrameBuffers(d.frame)));
     d.updateColorDetails(&frame);
     return frame;
 }
@@ -306,6 +376,16 @@ VideoDecoderFFmpeg::DiscardType VideoDecoderFFmpeg::skipFrame() const
     return (DiscardType)d_func().skip_frame;
 }
 
+void VideoDecoderFFmpeg::setLowres(int value)
+{
+    d_func().lowres = value;
+}
+
+int VideoDecoderFFmpeg::lowres() const
+{
+    return d_func().lowres;
+}
+
 void VideoDecoderFFmpeg::setThreads(int value)
 {
     DPTR_D(VideoDecoderFFmpeg);
@@ -332,6 +412,16 @@ VideoDecoderFFmpeg::ThreadFlags VideoDecoderFFmpeg::threadFlags() const
     return (ThreadFlags)d_func().thread_type;
 }
 
+void VideoDecoderFFmpeg::setPriority(int value)
+{
+    d_func().priority = value;
+}
+
+int VideoDecoderFFmpeg::priority() const
+{
+    return d_func().priority;
+}
+
 void VideoDecoderFFmpeg::setMotionVectorVisFlags(MotionVectorVisFlags value)
 {
     DPTR_D(VideoDecoderFFmpeg);
@@ -364,8 +454,10 @@ void i18n() {
     QObject::tr("skip_idct");
     QObject::tr("strict");
     QObject::tr("skip_frame");
+    QObject::tr("lowres");
     QObject::tr("threads");
     QObject::tr("thread_type");
+    QObject::tr("priority");
     QObject::tr("vismv");
     QObject::tr("bug");
 }
@@ -20,11 +20,23 @@
 ******************************************************************************/
 
 #include "VideoDecoderFFmpegBase.h"
+#include "utils/FrameBufferPool.h"
 #include "utils/Logger.h"
+extern "C" {
+#include <libavutil/imgutils.h>
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(55, 17, 103)
+#include <libavutil/mastering_display_metadata.h>
+#endif
+}
+#ifndef AV_CODEC_CAP_DR1
+#define AV_CODEC_CAP_DR1 CODEC_CAP_DR1
+#endif
 
 namespace QtAV {
 
 extern ColorSpace colorSpaceFromFFmpeg(AVColorSpace cs);
+extern ColorTransfer colorTransferFromFFmpeg(AVColorTransferCharacteristic trc);
+extern ColorPrimaries colorPrimariesFromFFmpeg(AVColorPrimaries cp);
 
 void VideoDecoderFFmpegBasePrivate::updateColorDetails(VideoFrame *f)
 {
@@ -32,6 +44,36 @@ void VideoDecoderFFmpegBasePrivate::updateColorDetails(VideoFrame *f)
     if (cs != ColorSpace_Unknow)
         cs = colorSpaceFromFFmpeg(codec_ctx->colorspace);
     f->setColorSpace(cs);
+    f->setColorTransfer(colorTransferFromFFmpeg(codec_ctx->color_trc));
+    f->setColorPrimaries(colorPrimariesFromFFmpeg(codec_ctx->color_primaries));
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(55, 17, 103)
+    if (f->colorTransfer() != ColorTransfer_SDR) {
+        // usually on key frames only. keep the last values for other frames
+        AVFrameSideData *sd = av_frame_get_side_data(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA);
+        if (sd) {
+            const AVMasteringDisplayMetadata *m = (const AVMasteringDisplayMetadata*)sd->data;
+            if (m->has_luminance) {
+                hdr.max_luminance = av_q2d(m->max_luminance);
+                hdr.min_luminance = av_q2d(m->min_luminance);
+            }
+        }
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(55, 60, 100)
+        sd = av_frame_get_side_data(frame, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL);
+        if (sd) {
+            const AVContentLightMetadata *cll = (const AVContentLightMetadata*)sd->data;
+            hdr.max_cll = cll->MaxCLL;
+            hdr.max_fall = cll->MaxFALL;
+        }
+#endif
+        f->setHDRMetadata(hdr);
+    } else {
+        hdr = HDRMetadata();
+    }
+#endif
+    // AVPictureType. used by statistics of frame types
+    if (frame->pict_type != AV_PICTURE_TYPE_NONE)
+        f->setSideData(Frame::PictureType, frame->pict_type);
+    f->setInterlaced(frame->interlaced_frame, frame->top_field_first);
 }
 
 qreal VideoDecoderFFmpegBasePrivate::getDAR(AVFrame *f)
@@ -48,6 +90,104 @@ qreal VideoDecoderFFmpegBasePrivate::getDAR(AVFrame *f)
     return dar;
 }
 
+#if QTAV_HAVE(AVBUFREF)
+static const int kPlaneAlign = 64; // enough for avx512 and cache line. ffmpeg STRIDE_ALIGN is <= 64
+
+static void freePoolBuffer(void *opaque, uint8_t *data)
+{
+    Q_UNUSED(data);
+    QByteArray *buf = static_cast<QByteArray*>(opaque);
+    FrameBufferPool::instance().put(*buf);
+    delete buf;
+}
+
+struct AllocatedBuffer {
+    VideoFrameAllocatorPtr allocator;
+    void *handle;
+};
+
+static void freeAllocatedBuffer(void *opaque, uint8_t *data)
+{
+    Q_UNUSED(data);
+    AllocatedBuffer *buf = static_cast<AllocatedBuffer*>(opaque);
+    buf->allocator->release(buf->handle);
+    delete buf;
+}
+
+static void setPlanes(AVFrame *frame, uint8_t *data[4], const int linesize[4])
+{
+    for (int i = 0; i < 4; ++i) {
+        frame->data[i] = data[i];
+        frame->linesize[i] = linesize[i];
+    }
+    for (int i = 4; i < AV_NUM_DATA_POINTERS; ++i) {
+        frame->data[i] = 0;
+        frame->linesize[i] = 0;
+    }
+    frame->extended_data = frame->data;
+}
+
+int VideoDecoderFFmpegBasePrivate::getPoolBuffer2(AVCodecContext *ctx, AVFrame *frame, int flags)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    if (!desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) || !ctx->codec || !(ctx->codec->capabilities & AV_CODEC_CAP_DR1))
+        return avcodec_default_get_buffer2(ctx, frame, flags);
+    // the same as ffmpeg's default video buffer: padded size and a linesize aligned for SIMD
+    int w = frame->width, h = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(ctx, &w, &h, linesize_align);
+    int linesize[4] = { 0 };
+    int unaligned = 0;
+    do {
+        if (av_image_fill_linesizes(linesize, (AVPixelFormat)frame->format, w) < 0)
+            return avcodec_default_get_buffer2(ctx, frame, flags);
+        // increase alignment of w for next try (rhs gives the lowest bit set in w)
+        w += w & ~(w - 1);
+        unaligned = 0;
+        for (int i = 0; i < 4; ++i)
+            unaligned |= linesize[i] % linesize_align[i];
+    } while (unaligned);
+    // decode into memory of the renderer, e.g. XVideo shm images, so it's never copied
+    VideoDecoderPrivate *vd = static_cast<VideoDecoderPrivate*>(ctx->opaque);
+    if (vd && vd->frame_allocator) {
+        int align = 1;
+        for (int i = 0; i < 4; ++i)
+            align = qMax(align, linesize_align[i]);
+        uint8_t *planes[4] = { 0 };
+        int pitches[4] = { 0 };
+        void *handle = vd->frame_allocator->allocate(VideoFormat::pixelFormatFromFFmpeg(frame->format), w, h, align, planes, pitches);
+        if (handle) {
+            AllocatedBuffer *buf = new AllocatedBuffer();
+            buf->allocator = vd->frame_allocator;
+            buf->handle = handle;
+            frame->buf[0] = av_buffer_create(planes[0], pitches[0]*h, freeAllocatedBuffer, buf, 0);
+            if (!frame->buf[0]) {
+                freeAllocatedBuffer(buf, 0);
+                return AVERROR(ENOMEM);
+            }
+            setPlanes(frame, planes, pitches);
+            return 0;
+        }
+    }
+    uint8_t *data[4] = { 0 };
+    const int size = av_image_fill_pointers(data, (AVPixelFormat)frame->format, h, NULL, linesize);
+    if (size <= 0)
+        return avcodec_default_get_buffer2(ctx, frame, flags);
+    // 16 + STRIDE_ALIGN - 1 padding for overreading the last line, the same as ffmpeg
+    QByteArray *buf = new QByteArray(FrameBufferPool::instance().get(size + 16 + kPlaneAlign - 1 + kPlaneAlign));
+    uint8_t *base = (uint8_t*)buf->data();
+    base += (kPlaneAlign - ((uintptr_t)base & (kPlaneAlign - 1))) & (kPlaneAlign - 1);
+    frame->buf[0] = av_buffer_create(base, size + 16 + kPlaneAlign - 1, freePoolBuffer, buf, 0);
+    if (!frame->buf[0]) {
+        freePoolBuffer(buf, 0);
+        return AVERROR(ENOMEM);
+    }
+    av_image_fill_pointers(data, (AVPixelFormat)frame->format, h, base, linesize);
+    setPlanes(frame, data, linesize);
+    return 0;
+}
+#endif //QTAV_HAVE(AVBUFREF)
+
 VideoDecoderFFmpegBase::VideoDecoderFFmpegBase(VideoDecoderFFmpegBasePrivate &d):
     VideoDecoder(d)
 {
@@ -102,6 +242,16 @@ bool VideoDecoderFFmpegBase::decode(const Packet &packet)
     if (!isAvailable())
         return false;
     DPTR_D(VideoDecoderFFmpegBase);
+#if QTAV_HAVE(SEND_RECEIVE)
+    const int ret = d.sendReceive(packet, d.frame);
+    if (ret == 0)
+        return !packet.isEOF();
+    if (ret < 0) {
+        if (ret != AVERROR_EOF)
+            qWarning("[VideoDecoderFFmpegBase] %s", av_err2str(ret));
+        return false;
+    }
+#else
     // some decoders might in addition need other fields like flags&AV_PKT_FLAG_KEY
     // const AVPacket*: ffmpeg >= 1.0. no libav
     int got_frame_ptr = 0;
@@ -125,6 +275,7 @@ bool VideoDecoderFFmpegBase::decode(const Packet &packet)
         qWarning("no frame could be decompressed: %s %d/%d", av_err2str(ret), d.undecoded_size, packet.data.size());
         return !packet.isEOF();
     }
+#endif //QTAV_HAVE(SEND_RECEIVE)
     if (!d.codec_ctx->width || !d.codec_ctx->height)
         return false;
     //qDebug("codec %dx%d, frame %dx%d", d.codec_ctx->width, d.codec_ctx->height, d.frame->width, d.frame->height);
@@ -134,4 +285,23 @@ bool VideoDecoderFFmpegBase::decode(const Packet &packet)
     return true;
 }
 
+bool VideoDecoderFFmpegBase::receiveFrame()
+{
+#if QTAV_HAVE(SEND_RECEIVE)
+    if (!isAvailable())
+        return false;
+    DPTR_D(VideoDecoderFFmpegBase);
+    d.undecoded_size = 0;
+    if (avcodec_receive_frame(d.codec_ctx, d.frame) < 0) // EAGAIN: a new packet is required
+        return false;
+    if (!d.codec_ctx->width || !d.codec_ctx->height)
+        return false;
+    d.width = d.frame->width;
+    d.height = d.frame->height;
+    return true;
+#else
+    return false;
+#endif //QTAV_HAVE(SEND_RECEIVE)
+}
+
 } //namespace QtAV
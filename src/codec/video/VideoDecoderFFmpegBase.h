@@ -36,6 +36,7 @@ class VideoDecoderFFmpegBase : public VideoDecoder
 public:
     QTAV_DEPRECATED virtual bool decode(const QByteArray &encoded) Q_DECL_OVERRIDE;
     virtual bool decode(const Packet& packet) Q_DECL_OVERRIDE;
+    virtual bool receiveFrame() Q_DECL_OVERRIDE;
 protected:
     VideoDecoderFFmpegBase(VideoDecoderFFmpegBasePrivate &d);
 private:
@@ -60,8 +61,19 @@ public:
     }
     void updateColorDetails(VideoFrame* f);
     qreal getDAR(AVFrame *f);
+#if QTAV_HAVE(AVBUFREF)
+    /*!
+     * AVCodecContext.get_buffer2 allocating frame planes from FrameBufferPool. A buffer is returned to the pool when
+     * the last AVBufferRef is released, e.g. by the last VideoFrame holding AVFrameBuffers of it.
+     * Falls back to avcodec_default_get_buffer2() for hw formats and codecs without direct rendering.
+     * Planes are allocated by VideoDecoderPrivate::frame_allocator instead if AVCodecContext.opaque is the decoder and
+     * the allocator accepts the frame.
+     */
+    static int getPoolBuffer2(AVCodecContext *ctx, AVFrame *frame, int flags);
+#endif //QTAV_HAVE(AVBUFREF)
 
     AVFrame *frame; //set once and not change
+    HDRMetadata hdr; // from the side data of the last frame having it
 };
 
 } //namespace QtAV
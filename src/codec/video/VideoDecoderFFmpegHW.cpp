@@ -22,6 +22,8 @@
 #include "VideoDecoderFFmpegHW.h"
 #include "VideoDecoderFFmpegHW_p.h"
 #include <algorithm>
+#include <QtCore/QRunnable>
+#include "QtAV/Packet.h"
 #include "utils/Logger.h"
 #ifndef Q_UNLIKELY
 #define Q_UNLIKELY(x) (!!(x))
@@ -251,6 +253,41 @@ void VideoDecoderFFmpegHWPrivate::releaseUSWC()
         gpu_mem.cleanCache();
 }
 
+class HostCopyTask : public QRunnable
+{
+public:
+    HostCopyTask(VideoDecoderFFmpegHWPrivate *d) : d(d) {}
+    void run() Q_DECL_OVERRIDE {
+        // map to host by the surface interop, i.e. VideoFrame::fromGPU()
+        d->copy_out = d->copy_in.to(d->copy_in.format());
+        if (d->copy_out.isValid())
+            d->copy_out.setColorSpace(d->copy_in.colorSpace());
+        d->copy_in = VideoFrame(); // release the surface
+    }
+private:
+    VideoDecoderFFmpegHWPrivate *d;
+};
+
+VideoFrame VideoDecoderFFmpegHWPrivate::asyncCopy(const VideoFrame &surfaceFrame)
+{
+    copy_pool.waitForDone();
+    VideoFrame f(copy_out);
+    copy_out = VideoFrame();
+    if (surfaceFrame.isValid()) {
+        copy_in = surfaceFrame;
+        copy_pool.start(new HostCopyTask(this));
+    }
+    return f;
+}
+
+void VideoDecoderFFmpegHWPrivate::resetAsyncCopy()
+{
+    copy_pool.waitForDone();
+    copy_in = VideoFrame();
+    copy_out = VideoFrame();
+    copy_draining = false;
+}
+
 VideoDecoderFFmpegHW::VideoDecoderFFmpegHW(VideoDecoderFFmpegHWPrivate &d):
     VideoDecoderFFmpegBase(d)
 {
@@ -261,6 +298,7 @@ VideoDecoderFFmpegHW::VideoDecoderFFmpegHW(VideoDecoderFFmpegHWPrivate &d):
                 .arg(tr("Not implemented for all codecs"))
                 .arg(tr("OptimizedCopy: copy from USWC memory optimized by SSE4.1"))
                 .arg(tr("GenericCopy: slowest. Generic cpu copy")));
+    setProperty("detail_asyncCopy", tr("OptimizedCopy only. Copy back in another thread while decoding the next packet. 1 frame delay"));
 }
 
 void VideoDecoderFFmpegHW::setCopyMode(CopyMode value)
@@ -277,6 +315,48 @@ VideoDecoderFFmpegHW::CopyMode VideoDecoderFFmpegHW::copyMode() const
     return d_func().copy_mode;
 }
 
+void VideoDecoderFFmpegHW::setAsyncCopy(bool value)
+{
+    DPTR_D(VideoDecoderFFmpegHW);
+    if (d.async_copy == value)
+        return;
+    d.async_copy = value;
+    emit asyncCopyChanged();
+}
+
+bool VideoDecoderFFmpegHW::isAsyncCopy() const
+{
+    return d_func().async_copy;
+}
+
+bool VideoDecoderFFmpegHW::decode(const Packet &packet)
+{
+    DPTR_D(VideoDecoderFFmpegHW);
+    d.copy_draining = false;
+    if (VideoDecoderFFmpegBase::decode(packet))
+        return true;
+    if (!d.asyncCopyEnabled() || !packet.isEOF())
+        return false;
+    // the frame of the previous packet is still being copied
+    d.copy_pool.waitForDone();
+    if (!d.copy_out.isValid())
+        return false;
+    d.copy_draining = true;
+    return true;
+}
+
+bool VideoDecoderFFmpegHW::receiveFrame()
+{
+    d_func().copy_draining = false;
+    return VideoDecoderFFmpegBase::receiveFrame();
+}
+
+void VideoDecoderFFmpegHW::flush()
+{
+    d_func().resetAsyncCopy();
+    VideoDecoderFFmpegBase::flush();
+}
+
 VideoFrame VideoDecoderFFmpegHW::copyToFrame(const VideoFormat& fmt, int surface_h, quint8 *src[], int pitch[], bool swapUV)
 {
     DPTR_D(VideoDecoderFFmpegHW);
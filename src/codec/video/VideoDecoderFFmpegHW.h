@@ -33,6 +33,7 @@ class VideoDecoderFFmpegHW : public VideoDecoderFFmpegBase
     Q_DISABLE_COPY(VideoDecoderFFmpegHW)
     DPTR_DECLARE_PRIVATE(VideoDecoderFFmpegHW)
     Q_PROPERTY(CopyMode copyMode READ copyMode WRITE setCopyMode NOTIFY copyModeChanged)
+    Q_PROPERTY(bool asyncCopy READ isAsyncCopy WRITE setAsyncCopy NOTIFY asyncCopyChanged)
     Q_ENUMS(CopyMode)
 public:
     enum CopyMode {
@@ -45,8 +46,21 @@ public:
     // properties
     void setCopyMode(CopyMode value);
     CopyMode copyMode() const;
+    /*!
+     * \brief setAsyncCopy
+     * OptimizedCopy only. The surface of a decoded frame is copied back to host memory in a worker thread while the next
+     * packet is being decoded, so frame() returns the frame of the previous packet. A surface is released as soon as its
+     * copy completes. The last frame is returned by decoding eof packets. Decoders not supporting it copy synchronously (now
+     * VA-API only). Call it before open()
+     */
+    void setAsyncCopy(bool value);
+    bool isAsyncCopy() const;
+    bool decode(const Packet& packet) Q_DECL_OVERRIDE;
+    bool receiveFrame() Q_DECL_OVERRIDE;
+    void flush() Q_DECL_OVERRIDE;
 Q_SIGNALS:
     void copyModeChanged();
+    void asyncCopyChanged();
 protected:
     VideoDecoderFFmpegHW(VideoDecoderFFmpegHWPrivate &d);
 private:
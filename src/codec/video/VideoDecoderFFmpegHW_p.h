@@ -23,6 +23,7 @@
 #define QTAV_VIDEODECODERFFMPEGHW_P_H
 
 #include "VideoDecoderFFmpegHW.h"
+#include <QtCore/QThreadPool>
 #include "utils/GPUMemCopy.h"
 
 /*!
@@ -38,14 +39,18 @@ public:
     VideoDecoderFFmpegHWPrivate()
         : VideoDecoderFFmpegBasePrivate()
         , copy_mode(VideoDecoderFFmpegHW::OptimizedCopy)
+        , async_copy(false)
+        , copy_draining(false)
     {
         get_format = 0;
         get_buffer = 0;
         release_buffer = 0;
         reget_buffer = 0;
         get_buffer2 = 0;
+        copy_pool.setMaxThreadCount(1);
+        copy_pool.setExpiryTimeout(-1);
     }
-    virtual ~VideoDecoderFFmpegHWPrivate() {} //ctx is 0 now
+    virtual ~VideoDecoderFFmpegHWPrivate() { copy_pool.waitForDone();} //ctx is 0 now
     bool enableFrameRef() const Q_DECL_OVERRIDE { return false;} //because of ffmpeg_get_va_buffer2?
     bool prepare();
     void restore() {
@@ -73,6 +78,16 @@ public:
     int codedHeight(AVCodecContext *avctx) const;
     bool initUSWC(int lineSize);
     void releaseUSWC();
+    bool asyncCopyEnabled() const { return async_copy && copy_mode == VideoDecoderFFmpegHW::OptimizedCopy;}
+    /*!
+     * \brief asyncCopy
+     * Start to copy surfaceFrame (a frame with "surface_interop" mappable to HostMemorySurface) to host memory in copy_pool
+     * and return the host frame copied from the previous one. surfaceFrame holds the surface until the copy completes.
+     * An invalid surfaceFrame returns the pending frame only, e.g. when draining
+     */
+    VideoFrame asyncCopy(const VideoFrame& surfaceFrame);
+    // wait for the pending copy and drop it. call it before surfaces are destroyed
+    void resetAsyncCopy();
 
     AVPixelFormat pixfmt; //store old one
     //store old values because it does not own AVCodecContext
@@ -87,6 +102,10 @@ public:
     // TODO: flag enable, disable, auto
     VideoDecoderFFmpegHW::CopyMode copy_mode;
     GPUMemCopy gpu_mem;
+    bool async_copy;
+    bool copy_draining; // decode() got no new frame but a copy is pending
+    QThreadPool copy_pool; // 1 thread, at most 1 copy in progress
+    VideoFrame copy_in, copy_out; // accessed by copy_pool only between start() and waitForDone()
 };
 
 } //namespace QtAV
@@ -23,8 +23,11 @@
 #include "VideoDecoderFFmpegHW_p.h"
 #include <algorithm>
 #include <list>
+#include <QtCore/QFile>
 #include <QtCore/QList>
+#include <QtCore/QHash>
 #include <QtCore/QMetaEnum>
+#include <QtCore/QMutex>
 #include <QtCore/QStringList>
 #include <QtCore/QThread>
 extern "C" {
@@ -36,6 +39,8 @@ extern "C" {
 #include "QtAV/private/AVCompat.h"
 #include "QtAV/private/prepost.h"
 #include "vaapi/SurfaceInteropVAAPI.h"
+#include "utils/CapabilityCache.h"
+#include "utils/DevicePlacement.h"
 #include "utils/Logger.h"
 
 #define VERSION_CHK(major, minor, patch) \
@@ -55,13 +60,21 @@ class VideoDecoderVAAPI : public VideoDecoderFFmpegHW
     Q_PROPERTY(int surfaces READ surfaces WRITE setSurfaces)
     //Q_PROPERTY(QStringList displayPriority READ displayPriority WRITE setDisplayPriority)
     Q_PROPERTY(DisplayType display READ display WRITE setDisplay)
+    Q_PROPERTY(int device READ device WRITE setDevice)
+    Q_PROPERTY(DevicePolicy devicePolicy READ devicePolicy WRITE setDevicePolicy)
     Q_ENUMS(DisplayType)
+    Q_ENUMS(DevicePolicy)
 public:
     enum DisplayType {
         X11,
         GLX,
         DRM
     };
+    enum DevicePolicy {
+        DefaultDevice = DevicePlacement::DefaultDevice, // the first render node
+        RoundRobinDevice = DevicePlacement::RoundRobin,
+        LeastLoadedDevice = DevicePlacement::LeastLoaded // fewest decoders, then lowest VideoDecoder::setDeviceUtilization()
+    };
     VideoDecoderVAAPI();
     VideoDecoderId id() const Q_DECL_OVERRIDE;
     QString description() const Q_DECL_OVERRIDE;
@@ -76,6 +89,16 @@ public:
     QStringList displayPriority() const;
     DisplayType display() const;
     void setDisplay(DisplayType disp);
+    /*!
+     * \brief setDevice
+     * Index of the DRM render node /dev/dri/renderD(128+index) used by DRM display. X11 and GLX displays use the gpu of
+     * the X server. -1: chosen by devicePolicy (default). EGL interop (DRM + ZeroCopy) ignores devicePolicy and uses the
+     * first render node, because dma-buf is imported by the rendering gpu
+     */
+    void setDevice(int value);
+    int device() const;
+    void setDevicePolicy(DevicePolicy value);
+    DevicePolicy devicePolicy() const;
 };
 extern VideoDecoderId VideoDecoderId_VAAPI;
 FACTORY_REGISTER_ID_AUTO(VideoDecoder, VAAPI, "VAAPI")
@@ -142,6 +165,22 @@ static bool isProfileSupportedByRuntime(const VAProfile *profiles, int count, VA
     return false;
 }
 
+static const char kCapsKey[] = "VAAPI";
+// directories of va drivers. the stamp changes if a driver is installed or upgraded
+static QByteArray driverStamp()
+{
+    QStringList dirs;
+    const QByteArray env(qgetenv("LIBVA_DRIVERS_PATH"));
+    if (!env.isEmpty()) {
+        dirs = QString::fromLocal8Bit(env.constData()).split(QLatin1Char(':'), QString::SkipEmptyParts);
+    } else {
+        dirs << QStringLiteral("/usr/lib/dri") << QStringLiteral("/usr/lib64/dri") << QStringLiteral("/usr/local/lib/dri")
+             << QStringLiteral("/usr/lib/x86_64-linux-gnu/dri") << QStringLiteral("/usr/lib/i386-linux-gnu/dri")
+             << QStringLiteral("/usr/lib/arm-linux-gnueabihf/dri") << QStringLiteral("/usr/lib/aarch64-linux-gnu/dri");
+    }
+    return CapabilityCache::fileStamp(dirs) + qgetenv("LIBVA_DRIVER_NAME");
+}
+
 const codec_profile_t* findProfileEntry(AVCodecID codec, int profile, const codec_profile_t* p0 = NULL)
 {
     if (codec == QTAV_CODEC_ID(NONE))
@@ -172,8 +211,13 @@ public:
     VideoDecoderVAAPIPrivate()
         : support_4k(true)
     {
-        if (VAAPI_DRM::isLoaded())
+        if (VAAPI_DRM::isLoaded()) {
             display_type = VideoDecoderVAAPI::DRM;
+#if VA_EGL_INTEROP
+            // no gl context is current here. frame() falls back to copy mode if the renderer can not map EGLImages
+            copy_mode = VideoDecoderFFmpegHW::ZeroCopy;
+#endif //VA_EGL_INTEROP
+        }
 #ifndef QT_NO_OPENGL
         if (VAAPI_GLX::isLoaded()) {
             display_type = VideoDecoderVAAPI::GLX;
@@ -189,6 +233,9 @@ public:
 #endif //QT_NO_OPENGL
         }
         drm_fd = -1;
+        drm_device = -1;
+        device_request = -1;
+        device_policy = DevicePlacement::DefaultDevice;
         display_x11 = 0;
         config_id = VA_INVALID_ID;
         context_id = VA_INVALID_ID;
@@ -204,19 +251,32 @@ public:
         disable_derive = true;
     }
     bool open() Q_DECL_OVERRIDE;
+    QByteArray capabilityStamp() const Q_DECL_OVERRIDE { return driverStamp();}
     void close() Q_DECL_OVERRIDE;
     bool ensureSurfaces(int count, int w, int h);
     bool prepareVAImage(int w, int h);
     bool setup(AVCodecContext *avctx) Q_DECL_OVERRIDE;
     bool getBuffer(void **opaque, uint8_t **data) Q_DECL_OVERRIDE;
     void releaseBuffer(void *opaque, uint8_t *data) Q_DECL_OVERRIDE;
+    surface_ptr findSurface(VASurfaceID id) const;
     AVPixelFormat vaPixelFormat() const Q_DECL_OVERRIDE { return QTAV_PIX_FMT_C(VAAPI_VLD); }
+    // DRM display + zero copy: dma-buf to EGLImage. no X11 required
+    bool isEGLInterop() const {
+#if VA_EGL_INTEROP
+        return display_type == VideoDecoderVAAPI::DRM && copy_mode == VideoDecoderFFmpegHW::ZeroCopy;
+#else
+        return false;
+#endif //VA_EGL_INTEROP
+    }
 
     bool support_4k;
     VideoDecoderVAAPI::DisplayType display_type;
     QList<VideoDecoderVAAPI::DisplayType> display_priority;
     Display *display_x11;
     int drm_fd;
+    int drm_device; // render node index. -1: card0
+    int device_request;
+    DevicePlacement::Policy device_policy;
     display_ptr display;
 
     VAConfigID    config_id;
@@ -250,6 +310,8 @@ VideoDecoderVAAPI::VideoDecoderVAAPI()
     setProperty("detail_surfaces", tr("Decoding surfaces.") + QStringLiteral(" ") + tr("0: auto"));
     setProperty("detail_derive", tr("Maybe faster if display is not GLX"));
     setProperty("detail_display", tr("GLX is fastest. No data copyback from gpu."));
+    setProperty("detail_device", tr("DRM render node index.") + QStringLiteral(" ") + tr("-1: auto"));
+    setProperty("detail_devicePolicy", tr("Choose a render node for DRM display if device is auto. Not used by EGL interop"));
 }
 
 VideoDecoderId VideoDecoderVAAPI::id() const
@@ -304,31 +366,44 @@ void VideoDecoderVAAPI::setDisplay(DisplayType disp)
     d.display_type = disp;
 }
 
+void VideoDecoderVAAPI::setDevice(int value)
+{
+    d_func().device_request = qMax(-1, value);
+}
+
+int VideoDecoderVAAPI::device() const
+{
+    return d_func().device_request;
+}
+
+void VideoDecoderVAAPI::setDevicePolicy(DevicePolicy value)
+{
+    d_func().device_policy = (DevicePlacement::Policy)value;
+}
+
+VideoDecoderVAAPI::DevicePolicy VideoDecoderVAAPI::devicePolicy() const
+{
+    return (DevicePolicy)d_func().device_policy;
+}
+
 extern ColorSpace colorSpaceFromFFmpeg(AVColorSpace cs);
 VideoFrame VideoDecoderVAAPI::frame()
 {
     DPTR_D(VideoDecoderVAAPI);
+    if (d.copy_draining)
+        return d.asyncCopy(VideoFrame());
     if (!d.frame->opaque || !d.frame->data[0])
         return VideoFrame();
     VASurfaceID surface_id = (VASurfaceID)(uintptr_t)d.frame->data[3];
     VAStatus status = VA_STATUS_SUCCESS;
-    if (display() == GLX || (copyMode() == ZeroCopy && display() == X11)) {
-        surface_ptr p;
-        std::list<surface_ptr>::iterator it = d.surfaces_used.begin();
-        for (; it != d.surfaces_used.end() && !p; ++it) {
-            if((*it)->get() == surface_id) {
-                p = *it;
-                break;
-            }
-        }
-        if (!p) {
-            for (it = d.surfaces_free.begin(); it != d.surfaces_free.end() && !p; ++it) {
-                if((*it)->get() == surface_id) {
-                    p = *it;
-                    break;
-                }
-            }
-        }
+#if VA_EGL_INTEROP
+    if (d.isEGLInterop() && !static_cast<EGLInteropResource*>(d.interop_res.data())->isUsable()) {
+        qWarning("VAAPI - EGL interop is not usable by the renderer. fall back to copy mode");
+        d.copy_mode = VideoDecoderFFmpegHW::OptimizedCopy;
+    }
+#endif //VA_EGL_INTEROP
+    if (display() == GLX || (copyMode() == ZeroCopy && display() == X11) || d.isEGLInterop()) {
+        surface_ptr p(d.findSurface(surface_id));
         if (!p) {
             qWarning("VAAPI - Unable to find surface");
             return VideoFrame();
@@ -336,9 +411,16 @@ VideoFrame VideoDecoderVAAPI::frame()
         SurfaceInteropVAAPI *interop = new SurfaceInteropVAAPI(d.interop_res);
         interop->setSurface(p, d.width, d.height);
 
-        VideoFrame f(d.width, d.height, VideoFormat::Format_RGB32); //p->width()
-        f.setBytesPerLine(d.width*4); //used by gl to compute texture size
-        f.setMetaData(QStringLiteral("surface_interop"), QVariant::fromValue(VideoSurfaceInteropPtr(interop)));
+        VideoFrame f;
+        if (d.isEGLInterop()) { // textures of each plane are EGLImages of the surface
+            f = VideoFrame(d.width, d.height, VideoFormat::Format_NV12);
+            f.setBytesPerLine(d.width, 0); //used by gl to compute texture size
+            f.setBytesPerLine(d.width, 1);
+        } else {
+            f = VideoFrame(d.width, d.height, VideoFormat::Format_RGB32); //p->width()
+            f.setBytesPerLine(d.width*4); //used by gl to compute texture size
+        }
+        f.setSurfaceInterop(VideoSurfaceInteropPtr(interop));
         f.setTimestamp(double(d.frame->pkt_pts)/1000.0);
         f.setDisplayAspectRatio(d.getDAR(d.frame));
 
@@ -349,8 +431,25 @@ VideoFrame VideoDecoderVAAPI::frame()
             p->setColorSpace(VA_SRC_BT601);
         else
             p->setColorSpace(VA_SRC_BT709);
+        if (d.isEGLInterop()) // yuv textures. converted by shader instead of vaPutSurface/vaCopySurfaceGLX
+            d.updateColorDetails(&f);
         return f;
     }
+    if (d.asyncCopyEnabled()) {
+        // the surface is held by the interop, so it is not reused before the copy completes. no gl resource is required to map to host
+        surface_ptr p(d.findSurface(surface_id));
+        if (p) {
+            SurfaceInteropVAAPI *interop = new SurfaceInteropVAAPI(d.interop_res);
+            interop->setSurface(p, d.width, d.height);
+            VideoFrame f(d.width, d.height, VideoFormat::Format_NV12);
+            f.setSurfaceInterop(VideoSurfaceInteropPtr(interop));
+            f.setTimestamp(double(d.frame->pkt_pts)/1000.0);
+            f.setDisplayAspectRatio(d.getDAR(d.frame));
+            d.updateColorDetails(&f);
+            return d.asyncCopy(f);
+        }
+        qWarning("VAAPI - Unable to find surface. copy synchronously");
+    }
 #if VA_CHECK_VERSION(0,31,0)
     if ((status = vaSyncSurface(d.display->get(), surface_id)) != VA_STATUS_SUCCESS) {
         qWarning("vaSyncSurface(VADisplay:%p, VASurfaceID:%#x) == %#x", d.display->get(), surface_id, status);
@@ -435,6 +534,40 @@ QStringList VideoDecoderVAAPI::displayPriority() const
     return names;
 }
 
+/*
+ * VA displays shared by all decoders of all players in the process. Connecting the display and vaInitialize() are slow
+ * on many drivers, so a display of each type is created once and reused by every decoder opened later.
+ * Never released: va libraries may be unloaded before static objects are destroyed.
+ */
+struct SharedDisplay {
+    SharedDisplay() : x11(0), drm_fd(-1), version_major(0), version_minor(0) {}
+    display_ptr display;
+    Display *x11;
+    int drm_fd;
+    int version_major;
+    int version_minor;
+};
+static QMutex sDisplayMutex;
+static QHash<int, SharedDisplay>& sharedDisplays()
+{
+    static QHash<int, SharedDisplay> *displays = new QHash<int, SharedDisplay>();
+    return *displays;
+}
+// DRM displays of different render nodes are shared separately
+static int sharedDisplayKey(VideoDecoderVAAPI::DisplayType dt, int drmDevice)
+{
+    if (dt != VideoDecoderVAAPI::DRM || drmDevice < 0)
+        return dt;
+    return dt | ((drmDevice + 1) << 8);
+}
+static int renderNodeCount()
+{
+    int n = 0;
+    while (n < 64 && QFile::exists(QStringLiteral("/dev/dri/renderD%1").arg(128 + n)))
+        ++n;
+    return n;
+}
+
 bool VideoDecoderVAAPIPrivate::open()
 {
     if (!prepare())
@@ -446,20 +579,33 @@ bool VideoDecoderVAAPIPrivate::open()
         qWarning("codec(%s) or profile(%s) is not supported", avcodec_get_name(codec_ctx->codec_id), getProfileName(codec_ctx->codec_id, codec_ctx->profile));
         return false;
     }
+    // profiles probed by the last decoder of this or a previous process. skip connecting the display and vaInitialize() if none matches
+    const QByteArray caps_stamp(driverStamp());
+    QVariantHash caps;
+    if (CapabilityCache::instance().get(QLatin1String(kCapsKey), caps_stamp, &caps)) {
+        QVector<VAProfile> cached;
+        foreach (const QVariant& v, caps.value(QStringLiteral("profiles")).toList()) {
+            cached.append((VAProfile)v.toInt());
+        }
+        const codec_profile_t *p = pe;
+        while (p && !isProfileSupportedByRuntime(cached.constData(), cached.size(), p->va_profile)) {
+            p = findProfileEntry(codec_ctx->codec_id, codec_ctx->profile, p);
+        }
+        if (!p) {
+            qDebug("Codec or profile is not supported by the hardware (cached capabilities)");
+            reportCapability(QStringLiteral("VAAPI"), false);
+            return false;
+        }
+    }
     int threads = 1;
     if (codec_ctx->thread_type & (FF_THREAD_FRAME|FF_THREAD_SLICE)) {
         if (codec_ctx->thread_count <= 0) { // default is 0. auto set by ff
             threads = QThread::idealThreadCount();//av_cpu_count() is not available in old ffmpeg
         }
     }
-    int surface_count =  2 + 1 + threads;
-    qDebug("before open, default surface_count: %d  thread mode: %d, codec_ctx->thread_count:%d, cpu: %d, ref:%d", surface_count, codec_ctx->thread_type, codec_ctx->thread_count, threads, codec_ctx->refs);
-    if (codec_ctx->codec_id == QTAV_CODEC_ID(H264))
-        surface_count = 16+2 + threads;
-#ifdef FF_PROFILE_HEVC_MAIN
-    if (codec_ctx->codec_id == QTAV_CODEC_ID(HEVC))
-        surface_count = 16+2 + threads;
-#endif
+    // + 1 surface being copied back if async copy
+    const int surface_count = autoSurfaceCount(codec_ctx, threads) + (asyncCopyEnabled() ? 1 : 0);
+    qDebug("before open, default surface_count: %d  thread mode: %d, codec_ctx->thread_count:%d, cpu: %d, ref:%d, pipeline depth: %d", surface_count, codec_ctx->thread_type, codec_ctx->thread_count, threads, codec_ctx->refs, pipeline_depth);
     // TODO: vp8,9
     if (surface_auto)
         nb_surfaces = surface_count;
@@ -470,14 +616,41 @@ bool VideoDecoderVAAPIPrivate::open()
     image.image_id = VA_INVALID_ID;
     /* Create a VA display */
     VADisplay disp = 0;
+    bool shared = false;
+    drm_device = -1;
     foreach (VideoDecoderVAAPI::DisplayType dt, display_priority) {
+        if (dt == VideoDecoderVAAPI::DRM && VAAPI_DRM::isLoaded()) {
+            // no render node: card0 as before
+            const int nodes = renderNodeCount();
+            if (nodes > 0) {
+                const DevicePlacement::Policy policy = copy_mode == VideoDecoderFFmpegHW::ZeroCopy ? DevicePlacement::DefaultDevice : device_policy; // EGL interop
+                drm_device = DevicePlacement::instance().acquire(this, QStringLiteral("VAAPI"), nodes, device_request, policy, 0);
+            }
+        }
+        {
+            QMutexLocker lock(&sDisplayMutex);
+            Q_UNUSED(lock);
+            QHash<int, SharedDisplay>::const_iterator it = sharedDisplays().constFind(sharedDisplayKey(dt, drm_device));
+            if (it != sharedDisplays().constEnd()) {
+                display = it->display;
+                display_x11 = it->x11;
+                version_major = it->version_major;
+                version_minor = it->version_minor;
+                display_type = dt;
+                disp = display->get();
+                shared = true;
+                qDebug("use shared va display %p", disp);
+                break;
+            }
+        }
         if (dt == VideoDecoderVAAPI::DRM) {
             if (!VAAPI_DRM::isLoaded())
                 continue;
             qDebug("vaGetDisplay DRM...............");
 // get drm use udev: https://gitorious.org/hwdecode-demos/hwdecode-demos/commit/d591cf14b83bedc8a5fa9f2fcb53d279e2f76d7f?diffmode=sidebyside
             // try drmOpen()?
-            drm_fd = ::open("/dev/dri/card0", O_RDWR);
+            const QByteArray node(drm_device < 0 ? QByteArray("/dev/dri/card0") : QStringLiteral("/dev/dri/renderD%1").arg(128 + drm_device).toLatin1());
+            drm_fd = ::open(node.constData(), O_RDWR);
             if(drm_fd == -1) {
                 qWarning("Could not access rendering device");
                 continue;
@@ -524,14 +697,33 @@ bool VideoDecoderVAAPIPrivate::open()
         if (disp)
             break;
     }
+    if (display_type != VideoDecoderVAAPI::DRM) {
+        DevicePlacement::instance().release(this);
+        drm_device = -1;
+    }
     if (!disp/* || vaDisplayIsValid(display) != 0*/) {
         qWarning("Could not get a VAAPI device");
         return false;
     }
-    display = display_ptr(new display_t(disp));
-    if (vaInitialize(disp, &version_major, &version_minor)) {
-        qWarning("Failed to initialize the VAAPI device");
-        return false;
+    if (!shared) {
+        display = display_ptr(new display_t(disp));
+        if (vaInitialize(disp, &version_major, &version_minor)) {
+            qWarning("Failed to initialize the VAAPI device");
+            return false;
+        }
+        SharedDisplay sd;
+        sd.display = display;
+        sd.x11 = display_x11;
+        sd.drm_fd = drm_fd;
+        sd.version_major = version_major;
+        sd.version_minor = version_minor;
+        QMutexLocker lock(&sDisplayMutex);
+        Q_UNUSED(lock);
+        const int key = sharedDisplayKey(display_type, drm_device);
+        if (!sharedDisplays().contains(key)) { // another decoder may be opened at the same time
+            sharedDisplays().insert(key, sd);
+            drm_fd = -1; // owned by the shared display
+        }
     }
     vendor = QString::fromLatin1(vaQueryVendorString(disp));
     //if (!vendor.toLower().contains(QLatin1Strin("intel")))
@@ -543,6 +735,8 @@ bool VideoDecoderVAAPIPrivate::open()
     int idx = p.staticMetaObject.indexOfEnumerator("DisplayType");
     const QMetaEnum me = p.staticMetaObject.enumerator(idx);
     description += QStringLiteral(" Display: ") + QString::fromLatin1(me.valueToKey(display_type));
+    if (drm_device >= 0)
+        description += QStringLiteral(" renderD%1").arg(128 + drm_device);
     // check 4k support. from xbmc
     int major, minor, micro;
     if (sscanf(vendor.toUtf8().constData(), "Intel i965 driver - %d.%d.%d", &major, &minor, &micro) == 3) {
@@ -558,6 +752,7 @@ bool VideoDecoderVAAPIPrivate::open()
     }
     if (!support_4k && (codec_ctx->width > 1920 || codec_ctx->height > 1088)) {
         qWarning("VAAPI: frame size (%dx%d) is too large", codec_ctx->width, codec_ctx->height);
+        reportCapability(QStringLiteral("VAAPI"), false);
         return false;
     }
     /* Check if the selected profile is supported */
@@ -569,12 +764,20 @@ bool VideoDecoderVAAPIPrivate::open()
     }
     QVector<VAProfile> supported_profiles(nb_profiles, VAProfileNone);
     VA_ENSURE_TRUE(vaQueryConfigProfiles(disp, supported_profiles.data(), &nb_profiles), false);
+    QVariantList profiles;
+    for (int i = 0; i < nb_profiles; ++i) {
+        profiles.append((int)supported_profiles[i]);
+    }
+    caps.insert(QStringLiteral("profiles"), profiles);
+    caps.insert(QStringLiteral("vendor"), vendor);
+    CapabilityCache::instance().put(QLatin1String(kCapsKey), caps_stamp, caps);
     while (pe && !isProfileSupportedByRuntime(supported_profiles.constData(), nb_profiles, pe->va_profile)) {
         qDebug("Codec or profile %d is not directly supported by the hardware. Checking alternative profiles", pe->va_profile);
         pe = findProfileEntry(codec_ctx->codec_id, codec_ctx->profile, pe);
     }
     if (!pe) {
         qDebug("Codec or profile is not directly supported by the hardware.");
+        reportCapability(QStringLiteral("VAAPI"), false);
         return false;
     }
     qDebug("using profile %d: %s, %s",  pe->va_profile, avcodec_get_name(codec_ctx->codec_id), getProfileName(pe->codec, pe->profile));
@@ -584,8 +787,10 @@ bool VideoDecoderVAAPIPrivate::open()
     attrib.type = VAConfigAttribRTFormat;
     VA_ENSURE_TRUE(vaGetConfigAttributes(disp, pe->va_profile, VAEntrypointVLD, &attrib, 1), false);
     /* Not sure what to do if not, I don't have a way to test */
-    if ((attrib.value & VA_RT_FORMAT_YUV420) == 0)
+    if ((attrib.value & VA_RT_FORMAT_YUV420) == 0) {
+        reportCapability(QStringLiteral("VAAPI"), false);
         return false;
+    }
     //vaCreateConfig(display, pe->va_profile, VAEntrypointVLD, NULL, 0, &config_id)
     VA_ENSURE_TRUE(vaCreateConfig(disp, pe->va_profile, VAEntrypointVLD, &attrib, 1, &config_id), false);
     supports_derive = false;
@@ -599,7 +804,7 @@ bool VideoDecoderVAAPIPrivate::open()
     }
     VA_ENSURE_TRUE(vaCreateContext(display->get(), config_id, surface_width, surface_height, VA_PROGRESSIVE, surfaces.data(), surfaces.size(), &context_id), false);
     if (display_type != VideoDecoderVAAPI::GLX && (display_type != VideoDecoderVAAPI::X11 || copy_mode != VideoDecoderFFmpegHW::ZeroCopy)) {
-        // copy-back mode
+        // copy-back mode. egl interop needs it too to fall back if the renderer has no EGL display
         if (!prepareVAImage(surface_width, surface_height))
             return false;
         initUSWC(surface_width);
@@ -612,12 +817,17 @@ bool VideoDecoderVAAPIPrivate::open()
     if (display_type == VideoDecoderVAAPI::X11)
         interop_res = InteropResourcePtr(new X11InteropResource());
 #endif //VA_X11_INTEROP
+#if VA_EGL_INTEROP
+    if (isEGLInterop())
+        interop_res = InteropResourcePtr(new EGLInteropResource());
+#endif //VA_EGL_INTEROP
     /* Setup the ffmpeg hardware context */
     memset(&hw_ctx, 0, sizeof(hw_ctx));
     hw_ctx.display = display->get();
     hw_ctx.config_id = config_id;
     hw_ctx.context_id = context_id;
     codec_ctx->hwaccel_context = &hw_ctx;
+    reportCapability(QStringLiteral("VAAPI"), true);
     return true;
 }
 
@@ -643,6 +853,7 @@ bool VideoDecoderVAAPIPrivate::ensureSurfaces(int count, int w, int h)
         //qDebug("surface id: %p %dx%d", surfaces.at(i), w, height);
         surfaces_free.push_back(surface_ptr(new surface_t(w, h, surfaces[i], display)));
     }
+    surface_bytes = qint64(surfaces.size())*w*h*3/2; // VA_RT_FORMAT_YUV420
     return true;
 }
 
@@ -722,6 +933,7 @@ bool VideoDecoderVAAPIPrivate::setup(AVCodecContext *avctx)
 void VideoDecoderVAAPIPrivate::close()
 {
     restore();
+    resetAsyncCopy(); // the pending copy maps a surface
     // do not call vaDestroySurfaces here because they are destroyed by surface_t
     if (image.image_id != VA_INVALID_ID) {
         VAWARN(vaDestroyImage(display->get(), image.image_id));
@@ -744,15 +956,32 @@ void VideoDecoderVAAPIPrivate::close()
         ::close(drm_fd);
         drm_fd = -1;
     }
+    DevicePlacement::instance().release(this);
+    drm_device = -1;
     releaseUSWC();
     nb_surfaces = 0;
     surfaces.clear();
     surfaces_free.clear();
     surfaces_used.clear();
+    surface_bytes = 0;
     surface_width = 0;
     surface_height = 0;
 }
 
+surface_ptr VideoDecoderVAAPIPrivate::findSurface(VASurfaceID id) const
+{
+    std::list<surface_ptr>::const_iterator it = surfaces_used.begin();
+    for (; it != surfaces_used.end(); ++it) {
+        if ((*it)->get() == id)
+            return *it;
+    }
+    for (it = surfaces_free.begin(); it != surfaces_free.end(); ++it) {
+        if ((*it)->get() == id)
+            return *it;
+    }
+    return surface_ptr();
+}
+
 bool VideoDecoderVAAPIPrivate::getBuffer(void **opaque, uint8_t **data)
 {
     VASurfaceID id = (VASurfaceID)(quintptr)*data;
@@ -773,6 +1002,7 @@ bool VideoDecoderVAAPIPrivate::getBuffer(void **opaque, uint8_t **data)
     } else {
         for (; it != surfaces_free.end() && it->count() > 1; ++it) {}
         if (it == surfaces_free.end()) {
+            ++surface_starvation;
             if (!surfaces_free.empty())
                 qWarning("VAAPI - renderer still using all freed up surfaces by decoder. unable to find free surface, trying to allocate a new one");
 
@@ -360,7 +360,7 @@ VideoFrame VideoDecoderVDA::frame()
     } else {
         f = copyToFrame(fmt, d.height, src, pitch, false);
     }
-    f.setMetaData(QStringLiteral("surface_interop"), QVariant::fromValue(VideoSurfaceInteropPtr(new SurfaceInteropCVBuffer(cv_buffer, zero_copy))));
+    f.setSurfaceInterop(VideoSurfaceInteropPtr(new SurfaceInteropCVBuffer(cv_buffer, zero_copy)));
     return f;
 }
 
@@ -26,6 +26,7 @@
 #include "QtAV/private/AVCompat.h"
 #include "QtAV/private/prepost.h"
 #include "utils/OpenGLHelper.h"
+#include <QtCore/QSysInfo>
 #include <assert.h>
 #ifdef __cplusplus
 extern "C" {
@@ -34,6 +35,11 @@ extern "C" {
 #ifdef __cplusplus
 }
 #endif //__cplusplus
+#ifdef Q_OS_IOS
+#include <CoreVideo/CVOpenGLESTextureCache.h>
+#include <objc/runtime.h>
+#include <objc/message.h>
+#endif //Q_OS_IOS
 #include "utils/Logger.h"
 
 #ifdef MAC_OS_X_VERSION_MIN_REQUIRED
@@ -46,6 +52,47 @@ extern "C" {
 #endif
 
 namespace QtAV {
+#ifdef Q_OS_IOS
+/*!
+ * CVOpenGLESTextureCache of the EAGLContext rendering the frames. CGLTexImageIOSurface2D is not available on iOS, gl textures of
+ * buffer planes are created by the cache without copy. Used in rendering thread
+ */
+class TextureCache
+{
+public:
+    TextureCache() : cache(NULL), context(NULL) {}
+    ~TextureCache() {
+        if (cache)
+            CFRelease(cache);
+    }
+    CVOpenGLESTextureCacheRef current() {
+        // [EAGLContext currentContext]
+        void *ctx = ((void* (*)(id, SEL))objc_msgSend)((id)objc_getClass("EAGLContext"), sel_registerName("currentContext"));
+        if (cache && ctx == context) {
+            // textures released by frames are recycled
+            CVOpenGLESTextureCacheFlush(cache, 0);
+            return cache;
+        }
+        if (cache) {
+            CFRelease(cache);
+            cache = NULL;
+        }
+        context = ctx;
+        if (!context)
+            return NULL;
+        const CVReturn err = CVOpenGLESTextureCacheCreate(kCFAllocatorDefault, NULL, (CVEAGLContext)context, NULL, &cache);
+        if (err != kCVReturnSuccess) {
+            qWarning("CVOpenGLESTextureCacheCreate error: %d", err);
+            cache = NULL;
+        }
+        return cache;
+    }
+private:
+    CVOpenGLESTextureCacheRef cache;
+    void *context;
+};
+typedef QSharedPointer<TextureCache> TextureCachePtr;
+#endif //Q_OS_IOS
 
 class VideoDecoderVideoToolboxPrivate;
 // qt4 moc can not correctly process Q_DECL_FINAL here
@@ -95,10 +142,15 @@ public:
             out_fmt = VideoDecoderVideoToolbox::UYVY;
         copy_mode = VideoDecoderFFmpegHW::ZeroCopy;
         description = QStringLiteral("VideoToolbox");
+#ifdef Q_OS_IOS
+        texture_cache = TextureCachePtr(new TextureCache());
+#endif
     }
     ~VideoDecoderVideoToolboxPrivate() {qDebug("~VideoDecoderVideoToolboxPrivate");}
     bool open() Q_DECL_OVERRIDE;
     void close() Q_DECL_OVERRIDE;
+    // the system decoder is upgraded with the os
+    QByteArray capabilityStamp() const Q_DECL_OVERRIDE { return QByteArray::number(QSysInfo::MacintoshVersion);}
 
     bool setup(AVCodecContext *avctx) Q_DECL_OVERRIDE;
     bool getBuffer(void **opaque, uint8_t **data) Q_DECL_OVERRIDE;
@@ -106,6 +158,9 @@ public:
     AVPixelFormat vaPixelFormat() const Q_DECL_OVERRIDE { return AV_PIX_FMT_VIDEOTOOLBOX;}
 
     VideoDecoderVideoToolbox::PixelFormat out_fmt;
+#ifdef Q_OS_IOS
+    TextureCachePtr texture_cache; // may be still used by frames when decoder is destroyed
+#endif
 };
 
 typedef struct {
@@ -203,13 +258,29 @@ VideoFrame VideoDecoderVideoToolbox::frame()
     class SurfaceInteropCVBuffer Q_DECL_FINAL: public VideoSurfaceInterop {
         bool glinterop;
         CVPixelBufferRef cvbuf; // keep ref until video frame is destroyed
+#ifdef Q_OS_IOS
+        TextureCachePtr texture_cache;
+        CVOpenGLESTextureRef textures[3]; // keep the plane textures until the frame is destroyed
+#endif
     public:
         SurfaceInteropCVBuffer(CVPixelBufferRef cv, bool gl) : glinterop(gl), cvbuf(cv) {
             CVPixelBufferRetain(cvbuf); // videotoolbox need it for map and CVPixelBufferRelease
+#ifdef Q_OS_IOS
+            memset(textures, 0, sizeof(textures));
+#endif
         }
         ~SurfaceInteropCVBuffer() {
+#ifdef Q_OS_IOS
+            for (size_t i = 0; i < sizeof(textures)/sizeof(textures[0]); ++i) {
+                if (textures[i])
+                    CFRelease(textures[i]);
+            }
+#endif
             CVPixelBufferRelease(cvbuf);
         }
+#ifdef Q_OS_IOS
+        void setTextureCache(const TextureCachePtr& cache) { texture_cache = cache;}
+#endif
         void* mapToHost(const VideoFormat &format, void *handle, int plane) {
             Q_UNUSED(plane);
             CVPixelBufferLockBaseAddress(cvbuf, 0);
@@ -247,9 +318,47 @@ VideoFrame VideoDecoderVideoToolbox::frame()
             }
             if (type != GLTextureSurface)
                 return 0;
+            // yuv planes use the same formats as VideoMaterial, e.g. GL_RED/GL_RG for core profile where GL_LUMINANCE is invalid
+            GLint gl_iformat[4];
+            GLenum gl_format[4], gl_dtype[4];
+            const bool planar = fmt.isPlanar() && plane < fmt.planeCount() && plane < 4
+                    && OpenGLHelper::videoFormatToGL(fmt, gl_iformat, gl_format, gl_dtype);
+#ifdef Q_OS_IOS
+            // NV12, YUV420P planes only. packed 422 has no ES format
+            if (!planar || plane >= 3)
+                return 0;
+            CVOpenGLESTextureCacheRef cache = texture_cache ? texture_cache->current() : NULL;
+            if (!cache)
+                return 0;
+            if (textures[plane]) {
+                CFRelease(textures[plane]);
+                textures[plane] = NULL;
+            }
+            const CVReturn err = CVOpenGLESTextureCacheCreateTextureFromImage(kCFAllocatorDefault, cache, cvbuf, NULL, GL_TEXTURE_2D
+                    , gl_iformat[plane], (GLsizei)CVPixelBufferGetWidthOfPlane(cvbuf, plane), (GLsizei)CVPixelBufferGetHeightOfPlane(cvbuf, plane)
+                    , gl_format[plane], gl_dtype[plane], plane, &textures[plane]);
+            if (err != kCVReturnSuccess) {
+                qWarning("error creating texture from CVPixelBuffer at plane %d: %d", plane, err);
+                return 0;
+            }
+            // the cache owns the texture. VideoMaterial binds it as the plane texture
+            const GLuint tex = CVOpenGLESTextureGetName(textures[plane]);
+            *((GLuint*)handle) = tex;
+            DYGL(glBindTexture(GL_TEXTURE_2D, tex));
+            DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+            DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+            DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+            DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+            DYGL(glBindTexture(GL_TEXTURE_2D, 0));
+            return handle;
+#else
             // https://www.opengl.org/registry/specs/APPLE/rgb_422.txt
             // TODO: check extension GL_APPLE_rgb_422 and rectangle?
             IOSurfaceRef surface  = CVPixelBufferGetIOSurface(cvbuf);
+            if (!surface) {
+                qWarning("CVPixelBuffer is not backed by IOSurface");
+                return 0;
+            }
             int w = IOSurfaceGetWidthOfPlane(surface, plane);
             int h = IOSurfaceGetHeightOfPlane(surface, plane);
             //qDebug("plane:%d, iosurface %dx%d, ctx: %p", plane, w, h, CGLGetCurrentContext());
@@ -258,8 +367,11 @@ VideoFrame VideoDecoderVideoToolbox::frame()
             GLenum format = GL_BGRA;
             GLenum dtype = GL_UNSIGNED_INT_8_8_8_8_REV;
             const GLenum target = GL_TEXTURE_RECTANGLE;
-            // TODO: GL_RED, GL_RG is better for gl >= 3.0
-            if (pixfmt == NV12) {
+            if (planar) {
+                iformat = (GLenum)gl_iformat[plane];
+                format = gl_format[plane];
+                dtype = gl_dtype[plane];
+            } else if (pixfmt == NV12) {
                 dtype = GL_UNSIGNED_BYTE;
                 if (plane == 0) {
                     iformat = format = GL_LUMINANCE;
@@ -279,6 +391,7 @@ VideoFrame VideoDecoderVideoToolbox::frame()
             }
             DYGL(glBindTexture(target, 0));
             return handle;
+#endif //Q_OS_IOS
         }
         void* createHandle(void* handle, SurfaceType type, const VideoFormat &fmt, int plane, int planeWidth, int planeHeight) Q_DECL_OVERRIDE {
             Q_UNUSED(type);
@@ -289,6 +402,10 @@ VideoFrame VideoDecoderVideoToolbox::frame()
             if (!glinterop)
                 return 0;
             GLuint *tex = (GLuint*)handle;
+#ifdef Q_OS_IOS
+            *tex = 0; // textures are from the cache in map()
+            return handle;
+#endif
             DYGL(glGenTextures(1, tex));
             // no init required
             return handle;
@@ -339,14 +456,20 @@ VideoFrame VideoDecoderVideoToolbox::frame()
         f.setTimestamp(double(d.frame->pkt_pts)/1000.0);
         f.setDisplayAspectRatio(d.getDAR(d.frame));
         if (zero_copy) {
+#ifndef Q_OS_IOS
             f.setMetaData(QStringLiteral("target"), QByteArrayLiteral("rect"));
+#endif
         } else {
             f.setBits(src); // only set for copy back mode
         }
     } else {
         f = copyToFrame(fmt, d.height, src, pitch, false);
     }
-    f.setMetaData(QStringLiteral("surface_interop"), QVariant::fromValue(VideoSurfaceInteropPtr(new SurfaceInteropCVBuffer(cv_buffer, zero_copy))));
+    SurfaceInteropCVBuffer *interop = new SurfaceInteropCVBuffer(cv_buffer, zero_copy);
+#ifdef Q_OS_IOS
+    interop->setTextureCache(d.texture_cache);
+#endif
+    f.setSurfaceInterop(VideoSurfaceInteropPtr(interop));
     return f;
 }
 
@@ -385,6 +508,9 @@ bool VideoDecoderVideoToolboxPrivate::setup(AVCodecContext *avctx)
     int err = av_videotoolbox_default_init2(codec_ctx, vtctx);
     if (err < 0) {
         qWarning("Failed to init videotoolbox decoder (%#x): %s", err, videotoolbox_err_str(err));
+        // ENOSYS can be a busy decoder
+        if (err == AVERROR(EINVAL))
+            reportCapability(QStringLiteral("VideoToolbox"), false);
         return false;
     }
     initUSWC(codedWidth(avctx));
@@ -412,7 +538,10 @@ bool VideoDecoderVideoToolboxPrivate::open()
     codec_ctx->thread_count = 1; // to avoid crash at av_videotoolbox_alloc_context/av_videotoolbox_default_free. I have no idea how the are called
     qDebug("opening VideoToolbox module");
     // codec/profile check?
-    return setup(codec_ctx);
+    if (!setup(codec_ctx))
+        return false;
+    reportCapability(QStringLiteral("VideoToolbox"), true);
+    return true;
 }
 
 void VideoDecoderVideoToolboxPrivate::close()
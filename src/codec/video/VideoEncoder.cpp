@@ -111,4 +111,19 @@ VideoFormat::PixelFormat VideoEncoder::pixelFormat() const
     return d_func().format_used;
 }
 
+void VideoEncoder::setSourcePixelFormat(VideoFormat::PixelFormat format)
+{
+    d_func().source_format = format;
+}
+
+VideoFormat::PixelFormat VideoEncoder::sourcePixelFormat() const
+{
+    return d_func().source_format;
+}
+
+QVector<VideoFormat::PixelFormat> VideoEncoder::supportedPixelFormats() const
+{
+    return QVector<VideoFormat::PixelFormat>();
+}
+
 } //namespace QtAV
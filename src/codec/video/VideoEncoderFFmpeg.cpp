@@ -26,6 +26,21 @@
 #include "QtAV/private/prepost.h"
 #include "QtAV/version.h"
 #include "utils/Logger.h"
+// hw encoders accepting only hw frames, e.g. h264_vaapi, get frames from AVCodecContext.hw_frames_ctx. ff3.1
+#define QTAV_HAVE_hwframes_encoder FFMPEG_MODULE_CHECK(LIBAVCODEC, 57, 48, 101)
+#if QTAV_HAVE_hwframes_encoder
+extern "C" {
+#include <libavutil/hwcontext.h>
+#include <libavutil/pixdesc.h>
+}
+#if QTAV_HAVE(VAAPI)
+extern "C" {
+#include <libavutil/hwcontext_vaapi.h>
+}
+#include "QtAV/SurfaceInterop.h"
+#include "vaapi/SurfaceInteropVAAPI.h"
+#endif //QTAV_HAVE(VAAPI)
+#endif //QTAV_HAVE_hwframes_encoder
 
 /*!
  * options (properties) are from libavcodec/options_table.h
@@ -42,9 +57,22 @@ class VideoEncoderFFmpeg Q_DECL_FINAL: public VideoEncoder
 public:
     VideoEncoderFFmpeg();
     VideoEncoderId id() const Q_DECL_OVERRIDE;
+    QVector<VideoFormat::PixelFormat> supportedPixelFormats() const Q_DECL_OVERRIDE;
     bool encode(const VideoFrame &frame = VideoFrame()) Q_DECL_OVERRIDE;
 };
 
+static AVCodec* findEncoder(const QString& name)
+{
+    AVCodec *codec = avcodec_find_encoder_by_name(name.toUtf8().constData());
+    if (!codec) {
+        const AVCodecDescriptor* cd = avcodec_descriptor_get_by_name(name.toUtf8().constData());
+        if (cd) {
+            codec = avcodec_find_encoder(cd->id);
+        }
+    }
+    return codec;
+}
+
 static const VideoEncoderId VideoEncoderId_FFmpeg = mkid::id32base36_6<'F', 'F', 'm', 'p', 'e', 'g'>::value;
 FACTORY_REGISTER_ID_AUTO(VideoEncoder, FFmpeg, "FFmpeg")
 
@@ -53,12 +81,28 @@ void RegisterVideoEncoderFFmpeg_Man()
     FACTORY_REGISTER_ID_MAN(VideoEncoder, FFmpeg, "FFmpeg")
 }
 
+#if QTAV_HAVE_hwframes_encoder && QTAV_HAVE(VAAPI)
+namespace {
+void releaseSurface(void *opaque, uint8_t *data)
+{
+    Q_UNUSED(opaque);
+    delete (vaapi::surface_ptr*)data;
+}
+} //namespace
+#endif
+
 class VideoEncoderFFmpegPrivate Q_DECL_FINAL: public VideoEncoderPrivate
 {
 public:
     VideoEncoderFFmpegPrivate()
         : VideoEncoderPrivate()
         , nb_encoded(0)
+#if QTAV_HAVE_hwframes_encoder
+        , codec(0)
+        , hw_format(AV_PIX_FMT_NONE)
+        , hw_frames(0)
+        , hw_display(0)
+#endif
     {
         avcodec_register_all();
         // NULL: codec-specific defaults won't be initialized, which may result in suboptimal default settings (this is important mainly for encoders, e.g. libx264).
@@ -66,11 +110,137 @@ public:
     }
     bool open() Q_DECL_OVERRIDE;
     bool close() Q_DECL_OVERRIDE;
+#if QTAV_HAVE_hwframes_encoder
+    /*!
+     * Open the hw encoder with frames context of the first frame's device: the VADisplay of a frame from VideoDecoderVAAPI
+     * in zero copy mode, otherwise the default device of hw_format
+     */
+    bool openHW(const VideoFrame& frame);
+    // the frame is not copied if it's a surface on the device, otherwise host data is uploaded
+    AVFrame* hwFrame(const VideoFrame& frame);
+#endif
 
     qint64 nb_encoded;
     QByteArray buffer;
+#if QTAV_HAVE_hwframes_encoder
+    AVCodec *codec; // for hw encoders opened by the first frame
+    AVPixelFormat hw_format; // AV_PIX_FMT_NONE: host frames
+    AVBufferRef *hw_frames;
+    void *hw_display; // VADisplay of hw_frames
+#endif
 };
 
+static void setHostFrame(AVFrame *f, const VideoFrame& frame)
+{
+    f->format = frame.format().pixelFormatFFmpeg();
+    f->width = frame.width();
+    f->height = frame.height();
+    const int nb_planes = frame.planeCount();
+    for (int i = 0; i < nb_planes; ++i) {
+        f->linesize[i] = frame.bytesPerLine(i);
+        f->data[i] = (uint8_t*)frame.constBits(i);
+    }
+}
+
+#if QTAV_HAVE_hwframes_encoder
+bool VideoEncoderFFmpegPrivate::openHW(const VideoFrame &frame)
+{
+    av_buffer_unref(&hw_frames);
+    hw_display = 0;
+    AVBufferRef *device = 0;
+    int ret = 0;
+#if QTAV_HAVE(VAAPI)
+    vaapi::surface_ptr surface;
+    const VideoSurfaceInteropPtr ip = frame.surfaceInterop();
+    if (hw_format == AV_PIX_FMT_VAAPI && ip && ip->map(VAAPISurface, frame.format(), &surface) && surface) {
+        // the display is not terminated by ffmpeg because it's not opened by ffmpeg
+        device = av_hwdevice_ctx_alloc(AV_HWDEVICE_TYPE_VAAPI);
+        if (!device)
+            return false;
+        AVVAAPIDeviceContext *va_device = (AVVAAPIDeviceContext*)((AVHWDeviceContext*)device->data)->hwctx;
+        va_device->display = surface->vadisplay();
+        ret = av_hwdevice_ctx_init(device);
+        if (ret >= 0)
+            hw_display = va_device->display;
+    } else
+#endif //QTAV_HAVE(VAAPI)
+    {
+        AVHWDeviceType type;
+        if (hw_format == AV_PIX_FMT_VAAPI) {
+            type = AV_HWDEVICE_TYPE_VAAPI;
+        } else if (hw_format == AV_PIX_FMT_CUDA) {
+            type = AV_HWDEVICE_TYPE_CUDA;
+        } else {
+            qWarning("unsupported hw encoder pixel format %s", av_get_pix_fmt_name(hw_format));
+            return false;
+        }
+        ret = av_hwdevice_ctx_create(&device, type, NULL, NULL, 0);
+    }
+    if (ret >= 0) {
+        hw_frames = av_hwframe_ctx_alloc(device);
+        if (hw_frames) {
+            AVHWFramesContext *frames = (AVHWFramesContext*)hw_frames->data;
+            frames->format = hw_format;
+            frames->sw_format = (AVPixelFormat)VideoFormat::pixelFormatToFFmpeg(format_used);
+            frames->width = width;
+            frames->height = height;
+            // 0: surfaces for uploading are allocated when needed. zero copy frames are not from the pool
+            frames->initial_pool_size = 0;
+            ret = av_hwframe_ctx_init(hw_frames);
+            if (ret < 0)
+                av_buffer_unref(&hw_frames);
+        }
+    }
+    av_buffer_unref(&device); // referenced by hw_frames
+    AV_ENSURE_OK(ret, false);
+    if (!hw_frames)
+        return false;
+    avctx->hw_frames_ctx = av_buffer_ref(hw_frames);
+    AV_ENSURE_OK(avcodec_open2(avctx, codec, &dict), false);
+    qDebug("hw encoder %s is open. zero copy: %d", codec->name, !!hw_display);
+    return true;
+}
+
+AVFrame* VideoEncoderFFmpegPrivate::hwFrame(const VideoFrame &frame)
+{
+    AVFrame *f = av_frame_alloc();
+    if (!f)
+        return 0;
+#if QTAV_HAVE(VAAPI)
+    if (hw_display) {
+        vaapi::surface_ptr surface;
+        const VideoSurfaceInteropPtr ip = frame.surfaceInterop();
+        if (ip && ip->map(VAAPISurface, frame.format(), &surface) && surface && surface->vadisplay() == hw_display) {
+            f->format = AV_PIX_FMT_VAAPI;
+            f->width = frame.width();
+            f->height = frame.height();
+            f->data[3] = (uint8_t*)(uintptr_t)surface->get();
+            // the decoder does not reuse the surface until the encoder releases the frame
+            vaapi::surface_ptr *holder = new vaapi::surface_ptr(surface);
+            f->buf[0] = av_buffer_create((uint8_t*)holder, sizeof(vaapi::surface_ptr), releaseSurface, NULL, AV_BUFFER_FLAG_READONLY);
+            if (!f->buf[0])
+                delete holder;
+            f->hw_frames_ctx = av_buffer_ref(hw_frames);
+            if (!f->buf[0] || !f->hw_frames_ctx)
+                av_frame_free(&f);
+            return f;
+        }
+    }
+#endif //QTAV_HAVE(VAAPI)
+    AVFrame *host = av_frame_alloc();
+    setHostFrame(host, frame);
+    int ret = av_hwframe_get_buffer(hw_frames, f, 0);
+    if (ret >= 0)
+        ret = av_hwframe_transfer_data(f, host, 0);
+    av_frame_free(&host);
+    if (ret < 0) {
+        qWarning("failed to upload frame to hw encoder: %s", av_err2str(ret));
+        av_frame_free(&f);
+    }
+    return f;
+}
+#endif //QTAV_HAVE_hwframes_encoder
+
 bool VideoEncoderFFmpegPrivate::open()
 {
     nb_encoded = 0LL;
@@ -80,17 +250,28 @@ bool VideoEncoderFFmpegPrivate::open()
         AV_ENSURE_OK(avcodec_open2(avctx, codec, &dict), false);
         return true;
     }
-    AVCodec *codec = avcodec_find_encoder_by_name(codec_name.toUtf8().constData());
-    if (!codec) {
-        const AVCodecDescriptor* cd = avcodec_descriptor_get_by_name(codec_name.toUtf8().constData());
-        if (cd) {
-            codec = avcodec_find_encoder(cd->id);
-        }
-    }
+    AVCodec *codec = findEncoder(codec_name);
     if (!codec) {
         qWarning() << "Can not find encoder for codec " << codec_name;
         return false;
     }
+#if QTAV_HAVE_hwframes_encoder
+    this->codec = codec;
+    av_buffer_unref(&hw_frames);
+    hw_display = 0;
+    // encoders accepting only hw formats, e.g. h264_vaapi. others, e.g. nvenc, qsv and videotoolbox accept host frames too
+    hw_format = AV_PIX_FMT_NONE;
+    if (codec->pix_fmts) {
+        hw_format = codec->pix_fmts[0];
+        for (const AVPixelFormat *p = codec->pix_fmts; *p != AV_PIX_FMT_NONE; ++p) {
+            const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(*p);
+            if (!desc || !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+                hw_format = AV_PIX_FMT_NONE;
+                break;
+            }
+        }
+    }
+#endif //QTAV_HAVE_hwframes_encoder
     if (avctx) {
         avcodec_free_context(&avctx);
         avctx = 0;
@@ -100,7 +281,21 @@ bool VideoEncoderFFmpegPrivate::open()
     avctx->height = height;
     // reset format_used to user defined format. important to update default format if format is invalid
     format_used = format.pixelFormat();
-    if (format.pixelFormat() == VideoFormat::Format_Invalid) {
+#if QTAV_HAVE_hwframes_encoder
+    if (hw_format != AV_PIX_FMT_NONE && format_used == VideoFormat::Format_Invalid)
+        format_used = VideoFormat::Format_NV12; // sw_format of hw frames, i.e. the format of input frames
+#endif
+    if (format_used == VideoFormat::Format_Invalid && source_format != VideoFormat::Format_Invalid && codec->pix_fmts) {
+        // no conversion if source frames are supported
+        const AVPixelFormat src = (AVPixelFormat)VideoFormat::pixelFormatToFFmpeg(source_format);
+        for (const AVPixelFormat *p = codec->pix_fmts; *p != AV_PIX_FMT_NONE; ++p) {
+            if (*p == src) {
+                format_used = source_format;
+                break;
+            }
+        }
+    }
+    if (format_used == VideoFormat::Format_Invalid) {
         if (codec->pix_fmts) {
             qDebug("use first supported pixel format: %d", codec->pix_fmts[0]);
             format_used = VideoFormat::pixelFormatFromFFmpeg((int)codec->pix_fmts[0]);
@@ -111,6 +306,10 @@ bool VideoEncoderFFmpegPrivate::open()
     }
     //avctx->sample_aspect_ratio =
     avctx->pix_fmt = (AVPixelFormat)VideoFormat::pixelFormatToFFmpeg(format_used);
+#if QTAV_HAVE_hwframes_encoder
+    if (hw_format != AV_PIX_FMT_NONE)
+        avctx->pix_fmt = hw_format;
+#endif
     if (frame_rate > 0)
         avctx->time_base = av_d2q(1.0/frame_rate, frame_rate*1001.0+2);
     else
@@ -134,16 +333,25 @@ bool VideoEncoderFFmpegPrivate::open()
 #endif //FF_PROFILE_HEVC_MAIN
 #endif
     applyOptionsForContext();
-    AV_ENSURE_OK(avcodec_open2(avctx, codec, &dict), false);
     // from mpv ao_lavc
     const int buffer_size = qMax<int>(qMax<int>(width*height*6+200, FF_MIN_BUFFER_SIZE), sizeof(AVPicture));//??
     buffer.resize(buffer_size);
+#if QTAV_HAVE_hwframes_encoder
+    if (hw_format != AV_PIX_FMT_NONE) // the device is known when the first frame comes
+        return true;
+#endif
+    AV_ENSURE_OK(avcodec_open2(avctx, codec, &dict), false);
     return true;
 }
 
 bool VideoEncoderFFmpegPrivate::close()
 {
     AV_ENSURE_OK(avcodec_close(avctx), false);
+#if QTAV_HAVE_hwframes_encoder
+    av_buffer_unref(&avctx->hw_frames_ctx);
+    av_buffer_unref(&hw_frames);
+    hw_display = 0;
+#endif
     return true;
 }
 
@@ -158,15 +366,49 @@ VideoEncoderId VideoEncoderFFmpeg::id() const
     return VideoEncoderId_FFmpeg;
 }
 
+QVector<VideoFormat::PixelFormat> VideoEncoderFFmpeg::supportedPixelFormats() const
+{
+    QVector<VideoFormat::PixelFormat> fmts;
+    avcodec_register_all();
+    const AVCodec *codec = codecName().isEmpty() ? 0 : findEncoder(codecName());
+    if (!codec || !codec->pix_fmts)
+        return fmts;
+    for (const AVPixelFormat *p = codec->pix_fmts; *p != AV_PIX_FMT_NONE; ++p) {
+        const VideoFormat::PixelFormat fmt = VideoFormat::pixelFormatFromFFmpeg(*p);
+        if (fmt != VideoFormat::Format_Invalid) // hw formats
+            fmts.append(fmt);
+    }
+#if QTAV_HAVE_hwframes_encoder
+    if (fmts.isEmpty()) // uploaded to hw frames
+        fmts.append(VideoFormat::Format_NV12);
+#endif
+    return fmts;
+}
+
 bool VideoEncoderFFmpeg::encode(const VideoFrame &frame)
 {
     DPTR_D(VideoEncoderFFmpeg);
     AVFrame *f = NULL;
+#if QTAV_HAVE_hwframes_encoder
+    if (d.hw_format != AV_PIX_FMT_NONE && !avcodec_is_open(d.avctx)) {
+        if (!frame.isValid()) // not opened, nothing to flush
+            return false;
+        if (!d.openHW(frame))
+            return false;
+    }
+#endif
     if (frame.isValid()) {
-        f = av_frame_alloc();
-        f->format = frame.format().pixelFormatFFmpeg();
-        f->width = frame.width();
-        f->height = frame.height();
+#if QTAV_HAVE_hwframes_encoder
+        if (d.hw_format != AV_PIX_FMT_NONE) {
+            f = d.hwFrame(frame);
+            if (!f)
+                return false;
+        } else
+#endif
+        {
+            f = av_frame_alloc();
+            setHostFrame(f, frame);
+        }
 //        f->quality = d.avctx->global_quality;
         switch (timestampMode()) {
         case TimestampCopy:
@@ -179,11 +421,6 @@ bool VideoEncoderFFmpeg::encode(const VideoFrame &frame)
             break;
         }
         // pts is set in muxer
-        const int nb_planes = frame.planeCount();
-        for (int i = 0; i < nb_planes; ++i) {
-            f->linesize[i] = frame.bytesPerLine(i);
-            f->data[i] = (uint8_t*)frame.constBits(i);
-        }
         if (d.avctx->width <= 0) {
             d.avctx->width = frame.width();
         }
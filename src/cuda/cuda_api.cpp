@@ -52,10 +52,19 @@
 class cuda_api::context {
 public:
     context()
-        : loaded(true) {
+        : loaded(true)
+        , tried(false) {
 #if !NV_CONFIG(DLLAPI_CUDA) && !defined(CUDA_LINK)
         loaded = false;
         memset(&api, 0, sizeof(api));
+#endif // !NV_CONFIG(DLLAPI_CUDA) && !defined(CUDA_LINK)
+    }
+    // libraries are loaded by the first isLoaded() or api call, i.e. when a decoder is opened rather than created
+    void load() {
+        if (tried)
+            return;
+        tried = true;
+#if !NV_CONFIG(DLLAPI_CUDA) && !defined(CUDA_LINK)
         cuda_dll.setFileName(QStringLiteral("cuda"));
         if (!cuda_dll.isLoaded())
             cuda_dll.load();
@@ -83,6 +92,8 @@ public:
         cuda_dll.unload();
     }
 
+    QLibrary& cudaLib() { load(); return cuda_dll;}
+    QLibrary& cuvidLib() { load(); return cuvid_dll;}
     QLibrary cuda_dll;
     QLibrary cuvid_dll;
     typedef struct {
@@ -122,6 +133,16 @@ public:
         tcuStreamQuery* cuStreamQuery;
         typedef CUresult CUDAAPI tcuStreamSynchronize(CUstream hStream);
         tcuStreamSynchronize* cuStreamSynchronize;
+        typedef CUresult CUDAAPI tcuEventCreate(CUevent *phEvent, unsigned int Flags);
+        tcuEventCreate* cuEventCreate;
+        typedef CUresult CUDAAPI tcuEventDestroy(CUevent hEvent);
+        tcuEventDestroy* cuEventDestroy;
+        typedef CUresult CUDAAPI tcuEventRecord(CUevent hEvent, CUstream hStream);
+        tcuEventRecord* cuEventRecord;
+        typedef CUresult CUDAAPI tcuEventQuery(CUevent hEvent);
+        tcuEventQuery* cuEventQuery;
+        typedef CUresult CUDAAPI tcuEventSynchronize(CUevent hEvent);
+        tcuEventSynchronize* cuEventSynchronize;
 
         typedef CUresult CUDAAPI tcuDeviceGetCount(int *count);
         tcuDeviceGetCount* cuDeviceGetCount;
@@ -182,6 +203,7 @@ public:
     api_t api;
 #endif // !NV_CONFIG(DLLAPI_CUDA) && !defined(CUDA_LINK)
     bool loaded;
+    bool tried;
 };
 
 cuda_api::cuda_api()
@@ -196,6 +218,7 @@ cuda_api::~cuda_api()
 
 bool cuda_api::isLoaded() const
 {
+    ctx->load();
     return ctx->loaded;
 }
 
@@ -212,7 +235,7 @@ CUresult cuda_api::cuGetErrorName(CUresult error, const char **pStr)
         return CUDA_SUCCESS;
     }
     if (!ctx->api.cuGetErrorName) {
-        ctx->api.cuGetErrorName = (context::api_t::tcuGetErrorName*)ctx->cuda_dll.resolve("cuGetErrorName");
+        ctx->api.cuGetErrorName = (context::api_t::tcuGetErrorName*)ctx->cudaLib().resolve("cuGetErrorName");
         if (!ctx->api.cuGetErrorName) {
             fallback = true;
             return cuGetErrorName(error, pStr);
@@ -229,7 +252,7 @@ CUresult cuda_api::cuGetErrorString(CUresult error, const char **pStr)
         return CUDA_SUCCESS;
     }
     if (!ctx->api.cuGetErrorString) {
-        ctx->api.cuGetErrorString = (context::api_t::tcuGetErrorString*)ctx->cuda_dll.resolve("cuGetErrorString");
+        ctx->api.cuGetErrorString = (context::api_t::tcuGetErrorString*)ctx->cudaLib().resolve("cuGetErrorString");
         if (!ctx->api.cuGetErrorString) {
             fallback = true;
             return cuGetErrorString(error, pStr);
@@ -241,7 +264,7 @@ CUresult cuda_api::cuGetErrorString(CUresult error, const char **pStr)
 CUresult cuda_api::cuInit(unsigned int Flags)
 {
     if (!ctx->api.cuInit)
-        ctx->api.cuInit = (context::api_t::tcuInit*)ctx->cuda_dll.resolve("cuInit");
+        ctx->api.cuInit = (context::api_t::tcuInit*)ctx->cudaLib().resolve("cuInit");
     assert(ctx->api.cuInit);
     return ctx->api.cuInit(Flags);
 }
@@ -249,7 +272,7 @@ CUresult cuda_api::cuInit(unsigned int Flags)
 CUresult cuda_api::cuCtxCreate(CUcontext *pctx, unsigned int flags, CUdevice dev)
 {
     if (!ctx->api.cuCtxCreate)
-        ctx->api.cuCtxCreate = (context::api_t::tcuCtxCreate*)ctx->cuda_dll.resolve("cuCtxCreate");
+        ctx->api.cuCtxCreate = (context::api_t::tcuCtxCreate*)ctx->cudaLib().resolve("cuCtxCreate");
     assert(ctx->api.cuCtxCreate);
     return ctx->api.cuCtxCreate(pctx, flags, dev);
 }
@@ -257,7 +280,7 @@ CUresult cuda_api::cuCtxCreate(CUcontext *pctx, unsigned int flags, CUdevice dev
 CUresult cuda_api::cuD3D9CtxCreate(CUcontext *pCtx, CUdevice *pCudaDevice, unsigned int Flags, IDirect3DDevice9 *pD3DDevice)
 {
     if (!ctx->api.cuD3D9CtxCreate)
-        ctx->api.cuD3D9CtxCreate = (context::api_t::tcuD3D9CtxCreate*)ctx->cuda_dll.resolve("cuD3D9CtxCreate");
+        ctx->api.cuD3D9CtxCreate = (context::api_t::tcuD3D9CtxCreate*)ctx->cudaLib().resolve("cuD3D9CtxCreate");
     assert(ctx->api.cuD3D9CtxCreate);
     return ctx->api.cuD3D9CtxCreate(pCtx, pCudaDevice, Flags, pD3DDevice);
 }
@@ -265,7 +288,7 @@ CUresult cuda_api::cuD3D9CtxCreate(CUcontext *pCtx, CUdevice *pCudaDevice, unsig
 CUresult cuda_api::cuGraphicsD3D9RegisterResource(CUgraphicsResource *pCudaResource, IDirect3DResource9 *pD3DResource, unsigned int Flags)
 {
     if (!ctx->api.cuGraphicsD3D9RegisterResource)
-        ctx->api.cuGraphicsD3D9RegisterResource = (context::api_t::tcuGraphicsD3D9RegisterResource*)ctx->cuda_dll.resolve("cuGraphicsD3D9RegisterResource");
+        ctx->api.cuGraphicsD3D9RegisterResource = (context::api_t::tcuGraphicsD3D9RegisterResource*)ctx->cudaLib().resolve("cuGraphicsD3D9RegisterResource");
     assert(ctx->api.cuGraphicsD3D9RegisterResource);
     return ctx->api.cuGraphicsD3D9RegisterResource(pCudaResource, pD3DResource, Flags);
 }
@@ -273,7 +296,7 @@ CUresult cuda_api::cuGraphicsD3D9RegisterResource(CUgraphicsResource *pCudaResou
 CUresult cuda_api::cuGLCtxCreate(CUcontext *pctx, unsigned int flags, CUdevice dev)
 {
     if (!ctx->api.cuGLCtxCreate)
-        ctx->api.cuGLCtxCreate = (context::api_t::tcuGLCtxCreate*)ctx->cuda_dll.resolve("cuGLCtxCreate");
+        ctx->api.cuGLCtxCreate = (context::api_t::tcuGLCtxCreate*)ctx->cudaLib().resolve("cuGLCtxCreate");
     assert(ctx->api.cuGLCtxCreate);
     return ctx->api.cuGLCtxCreate(pctx, flags, dev);
 }
@@ -281,7 +304,7 @@ CUresult cuda_api::cuGLCtxCreate(CUcontext *pctx, unsigned int flags, CUdevice d
 CUresult cuda_api::cuCtxDestroy(CUcontext cuctx)
 {
     if (!ctx->api.cuCtxDestroy)
-        ctx->api.cuCtxDestroy = (context::api_t::tcuCtxDestroy*)this->ctx->cuda_dll.resolve("cuCtxDestroy");
+        ctx->api.cuCtxDestroy = (context::api_t::tcuCtxDestroy*)this->ctx->cudaLib().resolve("cuCtxDestroy");
     assert(ctx->api.cuCtxDestroy);
     return ctx->api.cuCtxDestroy(cuctx);
 }
@@ -289,7 +312,7 @@ CUresult cuda_api::cuCtxDestroy(CUcontext cuctx)
 CUresult cuda_api::cuCtxPushCurrent(CUcontext cuctx)
 {
     if (!ctx->api.cuCtxPushCurrent)
-        ctx->api.cuCtxPushCurrent = (context::api_t::tcuCtxPushCurrent*)this->ctx->cuda_dll.resolve("cuCtxPushCurrent");
+        ctx->api.cuCtxPushCurrent = (context::api_t::tcuCtxPushCurrent*)this->ctx->cudaLib().resolve("cuCtxPushCurrent");
     assert(ctx->api.cuCtxPushCurrent);
     return ctx->api.cuCtxPushCurrent(cuctx);
 }
@@ -297,7 +320,7 @@ CUresult cuda_api::cuCtxPushCurrent(CUcontext cuctx)
 CUresult cuda_api::cuCtxPopCurrent(CUcontext *pctx)
 {
     if (!ctx->api.cuCtxPopCurrent)
-        ctx->api.cuCtxPopCurrent = (context::api_t::tcuCtxPopCurrent*)this->ctx->cuda_dll.resolve("cuCtxPopCurrent");
+        ctx->api.cuCtxPopCurrent = (context::api_t::tcuCtxPopCurrent*)this->ctx->cudaLib().resolve("cuCtxPopCurrent");
     assert(ctx->api.cuCtxPopCurrent);
     return ctx->api.cuCtxPopCurrent(pctx);
 }
@@ -305,7 +328,7 @@ CUresult cuda_api::cuCtxPopCurrent(CUcontext *pctx)
 CUresult cuda_api::cuCtxGetCurrent(CUcontext *pctx)
 {
     if (!ctx->api.cuCtxGetCurrent)
-        ctx->api.cuCtxGetCurrent = (context::api_t::tcuCtxGetCurrent*)this->ctx->cuda_dll.resolve("cuCtxGetCurrent");
+        ctx->api.cuCtxGetCurrent = (context::api_t::tcuCtxGetCurrent*)this->ctx->cudaLib().resolve("cuCtxGetCurrent");
     assert(ctx->api.cuCtxGetCurrent);
     return ctx->api.cuCtxGetCurrent(pctx);
 }
@@ -313,7 +336,7 @@ CUresult cuda_api::cuCtxGetCurrent(CUcontext *pctx)
 CUresult cuda_api::cuMemAllocHost(void **pp, unsigned int bytesize)
 {
     if(!ctx->api.cuMemAllocHost)
-        ctx->api.cuMemAllocHost = (context::api_t::tcuMemAllocHost*)ctx->cuda_dll.resolve("cuMemAllocHost");
+        ctx->api.cuMemAllocHost = (context::api_t::tcuMemAllocHost*)ctx->cudaLib().resolve("cuMemAllocHost");
     assert(ctx->api.cuMemAllocHost);
     return ctx->api.cuMemAllocHost(pp, bytesize);
 }
@@ -321,7 +344,7 @@ CUresult cuda_api::cuMemAllocHost(void **pp, unsigned int bytesize)
 CUresult cuda_api::cuMemFreeHost(void *p)
 {
     if (!ctx->api.cuMemFreeHost)
-        ctx->api.cuMemFreeHost = (context::api_t::tcuMemFreeHost*)ctx->cuda_dll.resolve("cuMemFreeHost");
+        ctx->api.cuMemFreeHost = (context::api_t::tcuMemFreeHost*)ctx->cudaLib().resolve("cuMemFreeHost");
     assert(ctx->api.cuMemFreeHost);
     return ctx->api.cuMemFreeHost(p);
 }
@@ -329,7 +352,7 @@ CUresult cuda_api::cuMemFreeHost(void *p)
 CUresult cuda_api::cuMemcpyDtoH(void *dstHost, CUdeviceptr srcDevice, unsigned int ByteCount)
 {
     if (!ctx->api.cuMemcpyDtoH)
-        ctx->api.cuMemcpyDtoH = (context::api_t::tcuMemcpyDtoH*)ctx->cuda_dll.resolve("cuMemcpyDtoH");
+        ctx->api.cuMemcpyDtoH = (context::api_t::tcuMemcpyDtoH*)ctx->cudaLib().resolve("cuMemcpyDtoH");
     assert(ctx->api.cuMemcpyDtoH);
     return ctx->api.cuMemcpyDtoH(dstHost, srcDevice, ByteCount);
 }
@@ -337,7 +360,7 @@ CUresult cuda_api::cuMemcpyDtoH(void *dstHost, CUdeviceptr srcDevice, unsigned i
 CUresult cuda_api::cuMemcpyDtoHAsync(void *dstHost, CUdeviceptr srcDevice, unsigned int ByteCount, CUstream hStream)
 {
     if (!ctx->api.cuMemcpyDtoHAsync)
-        ctx->api.cuMemcpyDtoHAsync = (context::api_t::tcuMemcpyDtoHAsync*)ctx->cuda_dll.resolve("cuMemcpyDtoHAsync");
+        ctx->api.cuMemcpyDtoHAsync = (context::api_t::tcuMemcpyDtoHAsync*)ctx->cudaLib().resolve("cuMemcpyDtoHAsync");
     assert(ctx->api.cuMemcpyDtoHAsync);
     return ctx->api.cuMemcpyDtoHAsync(dstHost, srcDevice, ByteCount, hStream);
 }
@@ -345,7 +368,7 @@ CUresult cuda_api::cuMemcpyDtoHAsync(void *dstHost, CUdeviceptr srcDevice, unsig
 CUresult cuda_api::cuMemcpy2DAsync(const CUDA_MEMCPY2D *pCopy, CUstream hStream)
 {
     if (!ctx->api.cuMemcpy2DAsync)
-        ctx->api.cuMemcpy2DAsync = (context::api_t::tcuMemcpy2DAsync*)ctx->cuda_dll.resolve("cuMemcpy2DAsync");
+        ctx->api.cuMemcpy2DAsync = (context::api_t::tcuMemcpy2DAsync*)ctx->cudaLib().resolve("cuMemcpy2DAsync");
     assert(ctx->api.cuMemcpy2DAsync);
     return ctx->api.cuMemcpy2DAsync(pCopy, hStream);
 }
@@ -353,7 +376,7 @@ CUresult cuda_api::cuMemcpy2DAsync(const CUDA_MEMCPY2D *pCopy, CUstream hStream)
 CUresult cuda_api::cuMemcpy2D(const CUDA_MEMCPY2D *pCopy)
 {
     if (!ctx->api.cuMemcpy2D)
-        ctx->api.cuMemcpy2D = (context::api_t::tcuMemcpy2D*)ctx->cuda_dll.resolve("cuMemcpy2D");
+        ctx->api.cuMemcpy2D = (context::api_t::tcuMemcpy2D*)ctx->cudaLib().resolve("cuMemcpy2D");
     assert(ctx->api.cuMemcpy2D);
     return ctx->api.cuMemcpy2D(pCopy);
 }
@@ -361,7 +384,7 @@ CUresult cuda_api::cuMemcpy2D(const CUDA_MEMCPY2D *pCopy)
 CUresult cuda_api::cuStreamCreate(CUstream *phStream, unsigned int Flags)
 {
     if (!ctx->api.cuStreamCreate)
-        ctx->api.cuStreamCreate = (context::api_t::tcuStreamCreate*)ctx->cuda_dll.resolve("cuStreamCreate");
+        ctx->api.cuStreamCreate = (context::api_t::tcuStreamCreate*)ctx->cudaLib().resolve("cuStreamCreate");
     assert(ctx->api.cuStreamCreate);
     return ctx->api.cuStreamCreate(phStream, Flags);
 }
@@ -369,7 +392,7 @@ CUresult cuda_api::cuStreamCreate(CUstream *phStream, unsigned int Flags)
 CUresult cuda_api::cuStreamDestroy(CUstream hStream)
 {
     if (!ctx->api.cuStreamDestroy)
-        ctx->api.cuStreamDestroy = (context::api_t::tcuStreamDestroy*)ctx->cuda_dll.resolve("cuStreamDestroy");
+        ctx->api.cuStreamDestroy = (context::api_t::tcuStreamDestroy*)ctx->cudaLib().resolve("cuStreamDestroy");
     assert(ctx->api.cuStreamDestroy);
     return ctx->api.cuStreamDestroy(hStream);
 }
@@ -377,7 +400,7 @@ CUresult cuda_api::cuStreamDestroy(CUstream hStream)
 CUresult cuda_api::cuStreamQuery(CUstream hStream)
 {
     if (!ctx->api.cuStreamQuery)
-        ctx->api.cuStreamQuery = (context::api_t::tcuStreamQuery*)ctx->cuda_dll.resolve("cuStreamQuery");
+        ctx->api.cuStreamQuery = (context::api_t::tcuStreamQuery*)ctx->cudaLib().resolve("cuStreamQuery");
     assert(ctx->api.cuStreamQuery);
     return ctx->api.cuStreamQuery(hStream);
 }
@@ -385,15 +408,55 @@ CUresult cuda_api::cuStreamQuery(CUstream hStream)
 CUresult cuda_api::cuStreamSynchronize(CUstream hStream)
 {
     if (!ctx->api.cuStreamSynchronize)
-        ctx->api.cuStreamSynchronize = (context::api_t::tcuStreamSynchronize*)ctx->cuda_dll.resolve("cuStreamSynchronize");
+        ctx->api.cuStreamSynchronize = (context::api_t::tcuStreamSynchronize*)ctx->cudaLib().resolve("cuStreamSynchronize");
     assert(ctx->api.cuStreamSynchronize);
     return ctx->api.cuStreamSynchronize(hStream);
 }
 
+CUresult cuda_api::cuEventCreate(CUevent *phEvent, unsigned int Flags)
+{
+    if (!ctx->api.cuEventCreate)
+        ctx->api.cuEventCreate = (context::api_t::tcuEventCreate*)ctx->cudaLib().resolve("cuEventCreate");
+    assert(ctx->api.cuEventCreate);
+    return ctx->api.cuEventCreate(phEvent, Flags);
+}
+
+CUresult cuda_api::cuEventDestroy(CUevent hEvent)
+{
+    if (!ctx->api.cuEventDestroy)
+        ctx->api.cuEventDestroy = (context::api_t::tcuEventDestroy*)ctx->cudaLib().resolve("cuEventDestroy");
+    assert(ctx->api.cuEventDestroy);
+    return ctx->api.cuEventDestroy(hEvent);
+}
+
+CUresult cuda_api::cuEventRecord(CUevent hEvent, CUstream hStream)
+{
+    if (!ctx->api.cuEventRecord)
+        ctx->api.cuEventRecord = (context::api_t::tcuEventRecord*)ctx->cudaLib().resolve("cuEventRecord");
+    assert(ctx->api.cuEventRecord);
+    return ctx->api.cuEventRecord(hEvent, hStream);
+}
+
+CUresult cuda_api::cuEventQuery(CUevent hEvent)
+{
+    if (!ctx->api.cuEventQuery)
+        ctx->api.cuEventQuery = (context::api_t::tcuEventQuery*)ctx->cudaLib().resolve("cuEventQuery");
+    assert(ctx->api.cuEventQuery);
+    return ctx->api.cuEventQuery(hEvent);
+}
+
+CUresult cuda_api::cuEventSynchronize(CUevent hEvent)
+{
+    if (!ctx->api.cuEventSynchronize)
+        ctx->api.cuEventSynchronize = (context::api_t::tcuEventSynchronize*)ctx->cudaLib().resolve("cuEventSynchronize");
+    assert(ctx->api.cuEventSynchronize);
+    return ctx->api.cuEventSynchronize(hEvent);
+}
+
 CUresult cuda_api::cuDeviceGetCount(int *count)
 {
     if (!ctx->api.cuDeviceGetCount)
-        ctx->api.cuDeviceGetCount = (context::api_t::tcuDeviceGetCount*)ctx->cuda_dll.resolve("cuDeviceGetCount");
+        ctx->api.cuDeviceGetCount = (context::api_t::tcuDeviceGetCount*)ctx->cudaLib().resolve("cuDeviceGetCount");
     assert(ctx->api.cuDeviceGetCount);
     return ctx->api.cuDeviceGetCount(count);
 }
@@ -401,7 +464,7 @@ CUresult cuda_api::cuDeviceGetCount(int *count)
 CUresult cuda_api::cuDriverGetVersion(int *driverVersion)
 {
     if (!ctx->api.cuDriverGetVersion)
-        ctx->api.cuDriverGetVersion = (context::api_t::tcuDriverGetVersion*)ctx->cuda_dll.resolve("cuDriverGetVersion");
+        ctx->api.cuDriverGetVersion = (context::api_t::tcuDriverGetVersion*)ctx->cudaLib().resolve("cuDriverGetVersion");
     assert(ctx->api.cuDriverGetVersion);
     return ctx->api.cuDriverGetVersion(driverVersion);
 }
@@ -409,7 +472,7 @@ CUresult cuda_api::cuDriverGetVersion(int *driverVersion)
 CUresult cuda_api::cuDeviceGetName(char *name, int len, CUdevice dev)
 {
     if (!ctx->api.cuDeviceGetName)
-        ctx->api.cuDeviceGetName = (context::api_t::tcuDeviceGetName*)ctx->cuda_dll.resolve("cuDeviceGetName");
+        ctx->api.cuDeviceGetName = (context::api_t::tcuDeviceGetName*)ctx->cudaLib().resolve("cuDeviceGetName");
     assert(ctx->api.cuDeviceGetName);
     return ctx->api.cuDeviceGetName(name, len, dev);
 }
@@ -417,7 +480,7 @@ CUresult cuda_api::cuDeviceGetName(char *name, int len, CUdevice dev)
 CUresult cuda_api::cuDeviceComputeCapability(int *major, int *minor, CUdevice dev)
 {
     if (!ctx->api.cuDeviceComputeCapability)
-        ctx->api.cuDeviceComputeCapability = (context::api_t::tcuDeviceComputeCapability*)ctx->cuda_dll.resolve("cuDeviceComputeCapability");
+        ctx->api.cuDeviceComputeCapability = (context::api_t::tcuDeviceComputeCapability*)ctx->cudaLib().resolve("cuDeviceComputeCapability");
     assert(ctx->api.cuDeviceComputeCapability);
     return ctx->api.cuDeviceComputeCapability(major, minor, dev);
 }
@@ -425,7 +488,7 @@ CUresult cuda_api::cuDeviceComputeCapability(int *major, int *minor, CUdevice de
 CUresult cuda_api::cuDeviceGetAttribute(int *pi, CUdevice_attribute attrib, CUdevice dev)
 {
     if (!ctx->api.cuDeviceGetAttribute)
-        ctx->api.cuDeviceGetAttribute = (context::api_t::tcuDeviceGetAttribute*)ctx->cuda_dll.resolve("cuDeviceGetAttribute");
+        ctx->api.cuDeviceGetAttribute = (context::api_t::tcuDeviceGetAttribute*)ctx->cudaLib().resolve("cuDeviceGetAttribute");
     assert(ctx->api.cuDeviceGetAttribute);
     return ctx->api.cuDeviceGetAttribute(pi, attrib, dev);
 }
@@ -433,7 +496,7 @@ CUresult cuda_api::cuDeviceGetAttribute(int *pi, CUdevice_attribute attrib, CUde
 CUresult cuda_api::cuGraphicsGLRegisterImage(CUgraphicsResource *pCudaResource, GLuint image, GLenum target, unsigned int Flags)
 {
     if (!ctx->api.cuGraphicsGLRegisterImage)
-        ctx->api.cuGraphicsGLRegisterImage = (context::api_t::tcuGraphicsGLRegisterImage*)ctx->cuda_dll.resolve("cuGraphicsGLRegisterImage");
+        ctx->api.cuGraphicsGLRegisterImage = (context::api_t::tcuGraphicsGLRegisterImage*)ctx->cudaLib().resolve("cuGraphicsGLRegisterImage");
     assert(ctx->api.cuGraphicsGLRegisterImage);
     return ctx->api.cuGraphicsGLRegisterImage(pCudaResource, image, target, Flags);
 }
@@ -441,7 +504,7 @@ CUresult cuda_api::cuGraphicsGLRegisterImage(CUgraphicsResource *pCudaResource,
 CUresult cuda_api::cuGraphicsUnregisterResource(CUgraphicsResource resource)
 {
     if (!ctx->api.cuGraphicsUnregisterResource)
-        ctx->api.cuGraphicsUnregisterResource = (context::api_t::tcuGraphicsUnregisterResource*)ctx->cuda_dll.resolve("cuGraphicsUnregisterResource");
+        ctx->api.cuGraphicsUnregisterResource = (context::api_t::tcuGraphicsUnregisterResource*)ctx->cudaLib().resolve("cuGraphicsUnregisterResource");
     assert(ctx->api.cuGraphicsUnregisterResource);
     return ctx->api.cuGraphicsUnregisterResource(resource);
 }
@@ -449,7 +512,7 @@ CUresult cuda_api::cuGraphicsUnregisterResource(CUgraphicsResource resource)
 CUresult cuda_api::cuGraphicsMapResources(unsigned int count, CUgraphicsResource *resources, CUstream hStream)
 {
     if (!ctx->api.cuGraphicsMapResources)
-        ctx->api.cuGraphicsMapResources = (context::api_t::tcuGraphicsMapResources*)ctx->cuda_dll.resolve("cuGraphicsMapResources");
+        ctx->api.cuGraphicsMapResources = (context::api_t::tcuGraphicsMapResources*)ctx->cudaLib().resolve("cuGraphicsMapResources");
     assert(ctx->api.cuGraphicsMapResources);
     return ctx->api.cuGraphicsMapResources(count, resources, hStream);
 }
@@ -457,7 +520,7 @@ CUresult cuda_api::cuGraphicsMapResources(unsigned int count, CUgraphicsResource
 CUresult cuda_api::cuGraphicsSubResourceGetMappedArray(CUarray *pArray, CUgraphicsResource resource, unsigned int arrayIndex, unsigned int mipLevel)
 {
     if (!ctx->api.cuGraphicsSubResourceGetMappedArray)
-        ctx->api.cuGraphicsSubResourceGetMappedArray = (context::api_t::tcuGraphicsSubResourceGetMappedArray*)ctx->cuda_dll.resolve("cuGraphicsSubResourceGetMappedArray");
+        ctx->api.cuGraphicsSubResourceGetMappedArray = (context::api_t::tcuGraphicsSubResourceGetMappedArray*)ctx->cudaLib().resolve("cuGraphicsSubResourceGetMappedArray");
     assert(ctx->api.cuGraphicsSubResourceGetMappedArray);
     return ctx->api.cuGraphicsSubResourceGetMappedArray(pArray, resource, arrayIndex, mipLevel);
 }
@@ -465,7 +528,7 @@ CUresult cuda_api::cuGraphicsSubResourceGetMappedArray(CUarray *pArray, CUgraphi
 CUresult cuda_api::cuGraphicsUnmapResources(unsigned int count, CUgraphicsResource *resources, CUstream hStream)
 {
     if (!ctx->api.cuGraphicsUnmapResources)
-        ctx->api.cuGraphicsUnmapResources = (context::api_t::tcuGraphicsUnmapResources*)ctx->cuda_dll.resolve("cuGraphicsUnmapResources");
+        ctx->api.cuGraphicsUnmapResources = (context::api_t::tcuGraphicsUnmapResources*)ctx->cudaLib().resolve("cuGraphicsUnmapResources");
     assert(ctx->api.cuGraphicsUnmapResources);
     return ctx->api.cuGraphicsUnmapResources(count, resources, hStream);
 }
@@ -481,7 +544,7 @@ CUresult cuda_api::cuGraphicsUnmapResources(unsigned int count, CUgraphicsResour
 CUresult cuda_api::cuvidCtxLockCreate(CUvideoctxlock *pLock, CUcontext cuctx)
 {
     if (!ctx->api.cuvidCtxLockCreate)
-        ctx->api.cuvidCtxLockCreate = (context::api_t::tcuvidCtxLockCreate*)this->ctx->cuvid_dll.resolve("cuvidCtxLockCreate");
+        ctx->api.cuvidCtxLockCreate = (context::api_t::tcuvidCtxLockCreate*)this->ctx->cuvidLib().resolve("cuvidCtxLockCreate");
     assert(ctx->api.cuvidCtxLockCreate);
     return ctx->api.cuvidCtxLockCreate(pLock, cuctx);
 }
@@ -489,7 +552,7 @@ CUresult cuda_api::cuvidCtxLockCreate(CUvideoctxlock *pLock, CUcontext cuctx)
 CUresult cuda_api::cuvidCtxLockDestroy(CUvideoctxlock lck)
 {
     if (!ctx->api.cuvidCtxLockDestroy)
-        ctx->api.cuvidCtxLockDestroy = (context::api_t::tcuvidCtxLockDestroy*)ctx->cuvid_dll.resolve("cuvidCtxLockDestroy");
+        ctx->api.cuvidCtxLockDestroy = (context::api_t::tcuvidCtxLockDestroy*)ctx->cuvidLib().resolve("cuvidCtxLockDestroy");
     assert(ctx->api.cuvidCtxLockDestroy);
     return ctx->api.cuvidCtxLockDestroy(lck);
 }
@@ -497,7 +560,7 @@ CUresult cuda_api::cuvidCtxLockDestroy(CUvideoctxlock lck)
 CUresult cuda_api::cuvidCtxLock(CUvideoctxlock lck, unsigned int reserved_flags)
 {
     if (!ctx->api.cuvidCtxLock)
-        ctx->api.cuvidCtxLock = (context::api_t::tcuvidCtxLock*)ctx->cuvid_dll.resolve("cuvidCtxLock");
+        ctx->api.cuvidCtxLock = (context::api_t::tcuvidCtxLock*)ctx->cuvidLib().resolve("cuvidCtxLock");
     assert(ctx->api.cuvidCtxLock);
     return ctx->api.cuvidCtxLock(lck, reserved_flags);
 }
@@ -505,7 +568,7 @@ CUresult cuda_api::cuvidCtxLock(CUvideoctxlock lck, unsigned int reserved_flags)
 CUresult cuda_api::cuvidCtxUnlock(CUvideoctxlock lck, unsigned int reserved_flags)
 {
     if (!ctx->api.cuvidCtxUnlock)
-        ctx->api.cuvidCtxUnlock = (context::api_t::tcuvidCtxUnlock*)ctx->cuvid_dll.resolve("cuvidCtxUnlock");
+        ctx->api.cuvidCtxUnlock = (context::api_t::tcuvidCtxUnlock*)ctx->cuvidLib().resolve("cuvidCtxUnlock");
     assert(ctx->api.cuvidCtxUnlock);
     return ctx->api.cuvidCtxUnlock(lck, reserved_flags);
 }
@@ -513,7 +576,7 @@ CUresult cuda_api::cuvidCtxUnlock(CUvideoctxlock lck, unsigned int reserved_flag
 CUresult cuda_api::cuCtxSynchronize()
 {
     if (!ctx->api.cuCtxSynchronize)
-        ctx->api.cuCtxSynchronize = (context::api_t::tcuCtxSynchronize*)ctx->cuda_dll.resolve("cuCtxSynchronize");
+        ctx->api.cuCtxSynchronize = (context::api_t::tcuCtxSynchronize*)ctx->cudaLib().resolve("cuCtxSynchronize");
     assert(ctx->api.cuCtxSynchronize);
     return ctx->api.cuCtxSynchronize();
 }
@@ -521,7 +584,7 @@ CUresult cuda_api::cuCtxSynchronize()
 CUresult cuda_api::cuvidCreateVideoParser(CUvideoparser *pObj, CUVIDPARSERPARAMS *pParams)
 {
     if (!ctx->api.cuvidCreateVideoParser)
-        ctx->api.cuvidCreateVideoParser = (context::api_t::tcuvidCreateVideoParser*)ctx->cuvid_dll.resolve("cuvidCreateVideoParser");
+        ctx->api.cuvidCreateVideoParser = (context::api_t::tcuvidCreateVideoParser*)ctx->cuvidLib().resolve("cuvidCreateVideoParser");
     assert(ctx->api.cuvidCreateVideoParser);
     return ctx->api.cuvidCreateVideoParser(pObj, pParams);
 }
@@ -529,7 +592,7 @@ CUresult cuda_api::cuvidCreateVideoParser(CUvideoparser *pObj, CUVIDPARSERPARAMS
 CUresult cuda_api::cuvidParseVideoData(CUvideoparser obj, CUVIDSOURCEDATAPACKET *pPacket)
 {
     if (!ctx->api.cuvidParseVideoData)
-        ctx->api.cuvidParseVideoData = (context::api_t::tcuvidParseVideoData*)ctx->cuvid_dll.resolve("cuvidParseVideoData");
+        ctx->api.cuvidParseVideoData = (context::api_t::tcuvidParseVideoData*)ctx->cuvidLib().resolve("cuvidParseVideoData");
     assert(ctx->api.cuvidParseVideoData);
     return ctx->api.cuvidParseVideoData(obj, pPacket);
 }
@@ -537,7 +600,7 @@ CUresult cuda_api::cuvidParseVideoData(CUvideoparser obj, CUVIDSOURCEDATAPACKET
 CUresult cuda_api::cuvidDestroyVideoParser(CUvideoparser obj)
 {
     if (!ctx->api.cuvidDestroyVideoParser)
-        ctx->api.cuvidDestroyVideoParser = (context::api_t::tcuvidDestroyVideoParser*)ctx->cuvid_dll.resolve("cuvidDestroyVideoParser");
+        ctx->api.cuvidDestroyVideoParser = (context::api_t::tcuvidDestroyVideoParser*)ctx->cuvidLib().resolve("cuvidDestroyVideoParser");
     assert(ctx->api.cuvidDestroyVideoParser);
     return ctx->api.cuvidDestroyVideoParser(obj);
 }
@@ -546,7 +609,7 @@ CUresult cuda_api::cuvidDestroyVideoParser(CUvideoparser obj)
 CUresult cuda_api::cuvidCreateDecoder(CUvideodecoder *phDecoder, CUVIDDECODECREATEINFO *pdci)
 {
     if (!ctx->api.cuvidCreateDecoder)
-        ctx->api.cuvidCreateDecoder = (context::api_t::tcuvidCreateDecoder*)ctx->cuvid_dll.resolve("cuvidCreateDecoder");
+        ctx->api.cuvidCreateDecoder = (context::api_t::tcuvidCreateDecoder*)ctx->cuvidLib().resolve("cuvidCreateDecoder");
     assert(ctx->api.cuvidCreateDecoder);
     return ctx->api.cuvidCreateDecoder(phDecoder, pdci);
 }
@@ -554,7 +617,7 @@ CUresult cuda_api::cuvidCreateDecoder(CUvideodecoder *phDecoder, CUVIDDECODECREA
 CUresult cuda_api::cuvidDestroyDecoder(CUvideodecoder hDecoder)
 {
     if (!ctx->api.cuvidDestroyDecoder)
-        ctx->api.cuvidDestroyDecoder = (context::api_t::tcuvidDestroyDecoder*)ctx->cuvid_dll.resolve("cuvidDestroyDecoder");
+        ctx->api.cuvidDestroyDecoder = (context::api_t::tcuvidDestroyDecoder*)ctx->cuvidLib().resolve("cuvidDestroyDecoder");
     assert(ctx->api.cuvidDestroyDecoder);
     return ctx->api.cuvidDestroyDecoder(hDecoder);
 }
@@ -563,7 +626,7 @@ CUresult cuda_api::cuvidDestroyDecoder(CUvideodecoder hDecoder)
 CUresult cuda_api::cuvidDecodePicture(CUvideodecoder hDecoder, CUVIDPICPARAMS *pPicParams)
 {
     if (!ctx->api.cuvidDecodePicture)
-        ctx->api.cuvidDecodePicture = (context::api_t::tcuvidDecodePicture*)   ctx->cuvid_dll.resolve("cuvidDecodePicture");
+        ctx->api.cuvidDecodePicture = (context::api_t::tcuvidDecodePicture*)   ctx->cuvidLib().resolve("cuvidDecodePicture");
     assert(ctx->api.cuvidDecodePicture);
     return ctx->api.cuvidDecodePicture(hDecoder, pPicParams);
 }
@@ -572,7 +635,7 @@ CUresult cuda_api::cuvidDecodePicture(CUvideodecoder hDecoder, CUVIDPICPARAMS *p
 CUresult cuda_api::cuvidMapVideoFrame(CUvideodecoder hDecoder, int nPicIdx, unsigned int *pDevPtr, unsigned int *pPitch, CUVIDPROCPARAMS *pVPP)
 {
     if (!ctx->api.cuvidMapVideoFrame)
-        ctx->api.cuvidMapVideoFrame = (context::api_t::tcuvidMapVideoFrame*)ctx->cuvid_dll.resolve("cuvidMapVideoFrame");
+        ctx->api.cuvidMapVideoFrame = (context::api_t::tcuvidMapVideoFrame*)ctx->cuvidLib().resolve("cuvidMapVideoFrame");
     assert(ctx->api.cuvidMapVideoFrame);
     return ctx->api.cuvidMapVideoFrame(hDecoder, nPicIdx, pDevPtr, pPitch, pVPP);
 }
@@ -581,7 +644,7 @@ CUresult cuda_api::cuvidMapVideoFrame(CUvideodecoder hDecoder, int nPicIdx, unsi
 CUresult cuda_api::cuvidUnmapVideoFrame(CUvideodecoder hDecoder, unsigned int DevPtr)
 {
     if (!ctx->api.cuvidUnmapVideoFrame)
-        ctx->api.cuvidUnmapVideoFrame = (context::api_t::tcuvidUnmapVideoFrame*)ctx->cuvid_dll.resolve("cuvidUnmapVideoFrame");
+        ctx->api.cuvidUnmapVideoFrame = (context::api_t::tcuvidUnmapVideoFrame*)ctx->cuvidLib().resolve("cuvidUnmapVideoFrame");
     assert(ctx->api.cuvidUnmapVideoFrame);
     return ctx->api.cuvidUnmapVideoFrame(hDecoder, DevPtr);
 }
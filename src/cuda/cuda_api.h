@@ -72,6 +72,11 @@ public:
     CUresult cuStreamDestroy(CUstream hStream);
     CUresult cuStreamQuery(CUstream hStream);
     CUresult cuStreamSynchronize(CUstream hStream);
+    CUresult cuEventCreate(CUevent *phEvent, unsigned int Flags);
+    CUresult cuEventDestroy(CUevent hEvent);
+    CUresult cuEventRecord(CUevent hEvent, CUstream hStream);
+    CUresult cuEventQuery(CUevent hEvent);
+    CUresult cuEventSynchronize(CUevent hEvent);
     CUresult cuDeviceGetCount(int *count);
     CUresult cuDriverGetVersion(int *driverVersion);
     CUresult cuDeviceGetName(char *name, int len, CUdevice dev);
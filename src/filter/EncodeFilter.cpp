@@ -23,24 +23,120 @@
 #include "QtAV/private/Filter_p.h"
 #include "QtAV/AudioEncoder.h"
 #include "QtAV/VideoEncoder.h"
+#include <QtCore/QThread>
+#include <limits>
+#include <string.h>
+#include "utils/BlockingQueue.h"
 #include "utils/Logger.h"
 
 namespace QtAV {
 
+/*!
+ * Encodes the queued frames of an encode filter in order. finish() stops the thread after the frames queued before it are encoded.
+ */
+template<typename F, class T>
+class EncodeThread : public QThread
+{
+public:
+    EncodeThread(T *filter, int capacity) : m_filter(filter) {
+        m_queue.setCapacity(capacity);
+        m_queue.setThreshold(1); // wake up for every frame
+    }
+    void put(const F& frame) { m_queue.put(frame); }
+    // drop: discard frames not encoded
+    void finish(bool drop = false) {
+        m_stop.ref();
+        if (drop)
+            m_queue.clear();
+        m_queue.put(F());
+        wait();
+    }
+protected:
+    void run() Q_DECL_OVERRIDE {
+        for (;;) {
+            const F frame(m_queue.take());
+            if (!frame.isValid()) {
+                if (m_stop.fetchAndAddRelaxed(0))
+                    break;
+                continue;
+            }
+            m_filter->encode(frame);
+        }
+    }
+private:
+    T *m_filter;
+    QAtomicInt m_stop;
+    BlockingQueue<F> m_queue;
+};
+
 class AudioEncodeFilterPrivate Q_DECL_FINAL : public AudioFilterPrivate
 {
 public:
-    AudioEncodeFilterPrivate() : enc(0) {}
+    AudioEncodeFilterPrivate()
+        : enc(0), async(false), thread(0)
+        , range_start(-std::numeric_limits<qreal>::max())
+        , range_stop(std::numeric_limits<qreal>::max())
+        , range_ended(false)
+        , fifo_samples(0)
+        , fifo_pts(0)
+    {}
     ~AudioEncodeFilterPrivate() {
+        finish(true); // the filter is being destroyed
         if (enc) {
             enc->close();
             delete enc;
         }
     }
+    void finish(bool drop = false) {
+        if (!thread)
+            return;
+        thread->finish(drop);
+        delete thread;
+        thread = 0;
+    }
 
     AudioEncoder* enc;
+    bool async;
+    EncodeThread<AudioFrame, AudioEncodeFilter> *thread;
+    qreal range_start, range_stop;
+    bool range_ended;
+    // samples less than encoder frame size. a frame is copied to fifo only if fifo is not empty or samples are not enough
+    QVector<QByteArray> fifo;
+    int fifo_samples;
+    qreal fifo_pts;
+    AudioFormat fifo_format;
 };
 
+// a frame referencing samples [offset, offset+samples) of planes. no copy
+static AudioFrame sliceAudio(const AudioFormat& fmt, const QVector<const uchar*>& planes, int offset, int samples, qreal timestamp)
+{
+    const int stride = fmt.isPlanar() ? fmt.bytesPerSample() : fmt.bytesPerSample()*fmt.channels();
+    AudioFrame f(fmt);
+    for (int i = 0; i < planes.size(); ++i) {
+        f.setBytesPerLine(samples*stride, i);
+        f.setBits((uchar*)planes[i] + offset*stride, i);
+    }
+    f.setSamplesPerChannel(samples);
+    f.setTimestamp(timestamp);
+    return f;
+}
+
+static QVector<const uchar*> audioPlanes(const AudioFrame& frame)
+{
+    QVector<const uchar*> planes(frame.planeCount());
+    for (int i = 0; i < planes.size(); ++i)
+        planes[i] = frame.constBits(i);
+    return planes;
+}
+
+static QVector<const uchar*> audioPlanes(const QVector<QByteArray>& data)
+{
+    QVector<const uchar*> planes(data.size());
+    for (int i = 0; i < planes.size(); ++i)
+        planes[i] = (const uchar*)data[i].constData();
+    return planes;
+}
+
 AudioEncodeFilter::AudioEncodeFilter(QObject *parent)
     : AudioFilter(*new AudioEncodeFilterPrivate(), parent)
 {
@@ -62,9 +158,67 @@ AudioEncoder* AudioEncodeFilter::encoder() const
     return d_func().enc;
 }
 
+void AudioEncodeFilter::setAsync(bool value)
+{
+    DPTR_D(AudioEncodeFilter);
+    if (d.async == value)
+        return;
+    d.async = value;
+    if (!value)
+        d.finish();
+}
+
+bool AudioEncodeFilter::isAsync() const
+{
+    return d_func().async;
+}
+
+void AudioEncodeFilter::finish()
+{
+    DPTR_D(AudioEncodeFilter);
+    d.finish();
+    if (d.fifo_samples <= 0 || !d.enc || !d.enc->isOpen())
+        return;
+    const AudioFrame f(sliceAudio(d.fifo_format, audioPlanes(d.fifo), 0, d.fifo_samples, d.fifo_pts));
+    d.fifo_samples = 0;
+    if (!d.enc->encode(f))
+        return;
+    Q_EMIT frameEncoded(d.enc->encoded());
+}
+
+void AudioEncodeFilter::setTimeRange(qreal start, qreal stop)
+{
+    DPTR_D(AudioEncodeFilter);
+    d.range_start = start;
+    d.range_stop = stop;
+    d.range_ended = false;
+}
+
 void AudioEncodeFilter::process(Statistics *statistics, AudioFrame *frame)
 {
     Q_UNUSED(statistics);
+    DPTR_D(AudioEncodeFilter);
+    if (frame && frame->isValid()) {
+        if (frame->timestamp() < d.range_start)
+            return;
+        if (frame->timestamp() >= d.range_stop) {
+            if (!d.range_ended) {
+                d.range_ended = true;
+                Q_EMIT timeRangeEnded();
+            }
+            return;
+        }
+    }
+    if (d.async) {
+        if (!frame || !frame->isValid())
+            return;
+        if (!d.thread) {
+            d.thread = new EncodeThread<AudioFrame, AudioEncodeFilter>(this, 32);
+            d.thread->start();
+        }
+        d.thread->put(*frame);
+        return;
+    }
     encode(*frame);
 }
 
@@ -85,24 +239,81 @@ void AudioEncodeFilter::encode(const AudioFrame& frame)
     AudioFrame f(frame);
     if (f.format() != d.enc->audioFormat())
         f = f.to(d.enc->audioFormat());
-    if (!d.enc->encode(f))
+    const int n = d.enc->frameSize();
+    if (n <= 0 || !f.isValid()) {
+        if (!d.enc->encode(f))
+            return;
+        Q_EMIT frameEncoded(d.enc->encoded());
         return;
-    Q_EMIT frameEncoded(d.enc->encoded());
+    }
+    // batch into frames of exact frame size. whole frames in the input are encoded in place
+    const AudioFormat fmt(f.format());
+    const int stride = fmt.isPlanar() ? fmt.bytesPerSample() : fmt.bytesPerSample()*fmt.channels();
+    if (d.fifo_format != fmt || d.fifo.size() != f.planeCount() || d.fifo[0].size() != n*stride) {
+        if (d.fifo_samples > 0)
+            qWarning("AudioEncodeFilter: audio format changed. %d samples are dropped", d.fifo_samples);
+        d.fifo_format = fmt;
+        d.fifo.fill(QByteArray(n*stride, 0), f.planeCount());
+        d.fifo_samples = 0;
+    }
+    const QVector<const uchar*> planes(audioPlanes(f));
+    const int total = f.samplesPerChannel();
+    int offset = 0;
+    QVector<AudioFrame> frames;
+    if (d.fifo_samples > 0) {
+        offset = qMin(n - d.fifo_samples, total);
+        for (int i = 0; i < planes.size(); ++i)
+            memcpy(d.fifo[i].data() + d.fifo_samples*stride, planes[i], offset*stride);
+        d.fifo_samples += offset;
+        if (d.fifo_samples < n)
+            return;
+        frames.append(sliceAudio(fmt, audioPlanes(d.fifo), 0, n, d.fifo_pts));
+    }
+    for (; total - offset >= n; offset += n)
+        frames.append(sliceAudio(fmt, planes, offset, n, f.timestamp() + qreal(offset)/qreal(fmt.sampleRate())));
+    foreach (const AudioFrame& af, frames) {
+        if (d.enc->encode(af))
+            Q_EMIT frameEncoded(d.enc->encoded());
+    }
+    // fifo is not referenced now
+    d.fifo_samples = total - offset;
+    if (d.fifo_samples <= 0)
+        return;
+    d.fifo_pts = f.timestamp() + qreal(offset)/qreal(fmt.sampleRate());
+    for (int i = 0; i < planes.size(); ++i)
+        memcpy(d.fifo[i].data(), planes[i] + offset*stride, d.fifo_samples*stride);
 }
 
 
 class VideoEncodeFilterPrivate Q_DECL_FINAL : public VideoFilterPrivate
 {
 public:
-    VideoEncodeFilterPrivate() : enc(0) {}
+    VideoEncodeFilterPrivate()
+        : enc(0), async(false), thread(0)
+        , range_start(-std::numeric_limits<qreal>::max())
+        , range_stop(std::numeric_limits<qreal>::max())
+        , range_ended(false)
+    {}
     ~VideoEncodeFilterPrivate() {
+        finish(true); // the filter is being destroyed
         if (enc) {
             enc->close();
             delete enc;
         }
     }
+    void finish(bool drop = false) {
+        if (!thread)
+            return;
+        thread->finish(drop);
+        delete thread;
+        thread = 0;
+    }
 
     VideoEncoder* enc;
+    bool async;
+    EncodeThread<VideoFrame, VideoEncodeFilter> *thread;
+    qreal range_start, range_stop;
+    bool range_ended;
 };
 
 VideoEncodeFilter::VideoEncodeFilter(QObject *parent)
@@ -126,9 +337,59 @@ VideoEncoder* VideoEncodeFilter::encoder() const
     return d_func().enc;
 }
 
+void VideoEncodeFilter::setAsync(bool value)
+{
+    DPTR_D(VideoEncodeFilter);
+    if (d.async == value)
+        return;
+    d.async = value;
+    if (!value)
+        d.finish();
+}
+
+bool VideoEncodeFilter::isAsync() const
+{
+    return d_func().async;
+}
+
+void VideoEncodeFilter::finish()
+{
+    d_func().finish();
+}
+
+void VideoEncodeFilter::setTimeRange(qreal start, qreal stop)
+{
+    DPTR_D(VideoEncodeFilter);
+    d.range_start = start;
+    d.range_stop = stop;
+    d.range_ended = false;
+}
+
 void VideoEncodeFilter::process(Statistics *statistics, VideoFrame *frame)
 {
     Q_UNUSED(statistics);
+    DPTR_D(VideoEncodeFilter);
+    if (frame && frame->isValid()) {
+        if (frame->timestamp() < d.range_start)
+            return;
+        if (frame->timestamp() >= d.range_stop) {
+            if (!d.range_ended) {
+                d.range_ended = true;
+                Q_EMIT timeRangeEnded();
+            }
+            return;
+        }
+    }
+    if (d.async) {
+        if (!frame || !frame->isValid())
+            return;
+        if (!d.thread) {
+            d.thread = new EncodeThread<VideoFrame, VideoEncodeFilter>(this, 8);
+            d.thread->start();
+        }
+        d.thread->put(*frame);
+        return;
+    }
     encode(*frame);
 }
 
@@ -141,6 +402,8 @@ void VideoEncodeFilter::encode(const VideoFrame& frame)
     if (!d.enc->isOpen() && frame.isValid()) {
         d.enc->setWidth(frame.width());
         d.enc->setHeight(frame.height());
+        // the encoder uses the source format if possible, then no frame is converted
+        d.enc->setSourcePixelFormat(frame.pixelFormat());
         if (!d.enc->open()) { // TODO: error()
             qWarning("Failed to open encoder");
             return;
@@ -151,8 +414,8 @@ void VideoEncodeFilter::encode(const VideoFrame& frame)
         qWarning("Frame size (%dx%d) and video encoder size (%dx%d) mismatch! Close encoder please.", d.enc->width(), d.enc->height(), frame.width(), frame.height());
         return;
     }
-    // TODO: async
     VideoFrame f(frame);
+    // a frame on gpu is copied back in the encoder format directly, e.g. nv12 surface to yuv420p
     if (f.pixelFormat() != d.enc->pixelFormat())
         f = f.to(d.enc->pixelFormat());
     if (!d.enc->encode(f))
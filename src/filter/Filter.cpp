@@ -24,7 +24,9 @@
 #include "QtAV/Statistics.h"
 #include "QtAV/AVOutput.h"
 #include "QtAV/AVPlayer.h"
+#include <QtCore/QElapsedTimer>
 #include "filter/FilterManager.h"
+#include "utils/SPSCQueue.h"
 #include "utils/Logger.h"
 
 /*
@@ -37,6 +39,27 @@
  * if delete target first, target remove the filter but not delete it (parent not null now).
  */
 namespace QtAV {
+namespace {
+QAtomicInt sProfiling(0);
+// measures apply() if profiling is enabled
+class ApplyTimer
+{
+public:
+    ApplyTimer(FilterPrivate *d)
+        : m_d(Filter::isProfilingEnabled() ? d : 0)
+    {
+        if (m_d)
+            m_timer.start();
+    }
+    ~ApplyTimer() {
+        if (m_d)
+            m_d->addTiming(m_timer.nsecsElapsed());
+    }
+private:
+    FilterPrivate *m_d;
+    QElapsedTimer m_timer;
+};
+} //namespace
 
 Filter::Filter(FilterPrivate &d, QObject *parent)
     : QObject(parent)
@@ -76,6 +99,39 @@ bool Filter::isOwnedByTarget() const
     return d_func().owned_by_target;
 }
 
+void Filter::setProfilingEnabled(bool value)
+{
+    spsc::storeRelease(sProfiling, value);
+}
+
+bool Filter::isProfilingEnabled()
+{
+    return spsc::loadRelaxed(sProfiling);
+}
+
+Statistics::FilterTiming Filter::timing() const
+{
+    DPTR_D(const Filter);
+    Statistics::FilterTiming t;
+    {
+        QMutexLocker lock(&d.timing_mutex);
+        Q_UNUSED(lock);
+        t = d.timing;
+    }
+    t.name = QString::fromLatin1(metaObject()->className());
+    if (!objectName().isEmpty())
+        t.name.append(QLatin1String(" ")).append(objectName());
+    return t;
+}
+
+void Filter::resetTiming()
+{
+    DPTR_D(Filter);
+    QMutexLocker lock(&d.timing_mutex);
+    Q_UNUSED(lock);
+    d.timing = Statistics::FilterTiming();
+}
+
 bool Filter::uninstall()
 {
     return FilterManager::instance().uninstallFilter(this); // TODO: target
@@ -97,9 +153,16 @@ bool AudioFilter::installTo(AVPlayer *player)
 
 void AudioFilter::apply(Statistics *statistics, AudioFrame *frame)
 {
+    ApplyTimer timer(&d_func());
+    Q_UNUSED(timer);
     process(statistics, frame);
 }
 
+int AudioFilter::blockSize() const
+{
+    return 0;
+}
+
 VideoFilter::VideoFilter(QObject *parent)
     : Filter(*new VideoFilterPrivate(), parent)
 {}
@@ -122,6 +185,16 @@ VideoFilterContext::Type VideoFilter::contextType() const
     return VideoFilterContext::None;
 }
 
+bool VideoFilter::isReadOnly() const
+{
+    return false;
+}
+
+bool VideoFilter::needsEveryFrame() const
+{
+    return true;
+}
+
 bool VideoFilter::installTo(AVPlayer *player)
 {
     return player->installVideoFilter(this);
@@ -161,7 +234,15 @@ void VideoFilter::prepareContext(VideoFilterContext *&context, Statistics *stati
 
 void VideoFilter::apply(Statistics *statistics, VideoFrame *frame)
 {
+    ApplyTimer timer(&d_func());
+    Q_UNUSED(timer);
     process(statistics, frame);
 }
 
+void VideoFilter::skip()
+{
+    if (isProfilingEnabled())
+        d_func().addSkipped();
+}
+
 } //namespace QtAV
@@ -52,6 +52,7 @@ VideoFilterContext::VideoFilterContext():
   , paint_device(0)
   , video_width(0)
   , video_height(0)
+  , opengl(0)
   , own_painter(false)
   , own_paint_device(false)
 {
@@ -130,6 +131,7 @@ void VideoFilterContext::shareFrom(VideoFilterContext *vctx)
     own_paint_device = false;
     video_width = vctx->video_width;
     video_height = vctx->video_height;
+    opengl = vctx->opengl;
 }
 
 QPainterFilterContext::QPainterFilterContext()
@@ -117,6 +117,16 @@ QList<Filter *> FilterManager::videoFilters(AVPlayer *player) const
     return d.vfilter_player_map.value(player);
 }
 
+QList<Statistics::FilterTiming> FilterManager::timings(AVPlayer *player) const
+{
+    QList<Statistics::FilterTiming> t;
+    foreach (Filter *f, videoFilters(player))
+        t.append(f->timing());
+    foreach (Filter *f, audioFilters(player))
+        t.append(f->timing());
+    return t;
+}
+
 // called by AVOutput/AVPlayer.uninstall imediatly
 bool FilterManager::unregisterAudioFilter(Filter *filter, AVPlayer *player)
 {
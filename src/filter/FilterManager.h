@@ -48,6 +48,11 @@ public:
     QList<Filter *> audioFilters(AVPlayer* player) const;
     bool registerVideoFilter(Filter *filter, AVPlayer *player, int pos = 0x7FFFFFFF);
     QList<Filter*> videoFilters(AVPlayer* player) const;
+    /*!
+     * \brief timings
+     * Filter::timing() of video filters then audio filters of player. Requires Filter::setProfilingEnabled(true)
+     */
+    QList<Statistics::FilterTiming> timings(AVPlayer* player) const;
     bool unregisterAudioFilter(Filter *filter, AVPlayer *player);
     bool unregisterVideoFilter(Filter *filter, AVPlayer *player);
     bool unregisterFilter(Filter *filter, AVOutput *output);
@@ -0,0 +1,231 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/FrameTapFilter.h"
+#include "QtAV/private/Filter_p.h"
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+class FrameTapThread : public QThread
+{
+public:
+    FrameTapThread(FrameTapFilter *filter, FrameTapFilterPrivate *priv) : m_filter(filter), d(priv) {}
+protected:
+    void run() Q_DECL_OVERRIDE;
+private:
+    FrameTapFilter *m_filter;
+    FrameTapFilterPrivate *d;
+};
+
+class FrameTapFilterPrivate Q_DECL_FINAL : public VideoFilterPrivate
+{
+public:
+    FrameTapFilterPrivate()
+        : rate(5)
+        , format(VideoFormat::Format_RGB32)
+        , last_pts(-1)
+        , dropped(0)
+        , stop(false)
+        , thread(0)
+    {}
+    ~FrameTapFilterPrivate() {
+        finish();
+    }
+    void finish() {
+        if (!thread)
+            return;
+        {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            stop = true;
+            pending = VideoFrame();
+            cond.wakeAll();
+        }
+        thread->wait();
+        delete thread;
+        thread = 0;
+        stop = false;
+    }
+    // the latest frame wins. in the video thread
+    void put(const VideoFrame& frame) {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        if (pending.isValid())
+            dropped++;
+        pending = frame;
+        cond.wakeAll();
+    }
+    VideoFrame convert(const VideoFrame& frame) {
+        QSize s;
+        VideoFormat::PixelFormat fmt;
+        {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            s = size;
+            fmt = format;
+        }
+        if (s.width() > 0 && s.height() <= 0)
+            s.setHeight(qRound(qreal(s.width())/frame.displayAspectRatio()));
+        else if (s.height() > 0 && s.width() <= 0)
+            s.setWidth(qRound(qreal(s.height())*frame.displayAspectRatio()));
+        if (!s.isValid() || s.isEmpty() || s == frame.size())
+            s = QSize();
+        if (fmt == VideoFormat::Format_Invalid)
+            fmt = frame.pixelFormat();
+        if (!s.isValid() && fmt == frame.pixelFormat() && frame.hasHostData())
+            return frame;
+        return frame.to(fmt, s);
+    }
+
+    qreal rate;
+    QSize size;
+    VideoFormat::PixelFormat format;
+    // in the video thread only
+    qreal last_pts;
+
+    QMutex mutex;
+    QWaitCondition cond;
+    VideoFrame pending;
+    int dropped;
+    bool stop;
+    FrameTapThread *thread;
+};
+
+void FrameTapThread::run()
+{
+    for (;;) {
+        VideoFrame frame;
+        {
+            QMutexLocker lock(&d->mutex);
+            Q_UNUSED(lock);
+            while (!d->stop && !d->pending.isValid())
+                d->cond.wait(&d->mutex);
+            if (d->stop)
+                break;
+            frame = d->pending;
+            d->pending = VideoFrame();
+        }
+        frame = d->convert(frame);
+        if (!frame.isValid()) {
+            qWarning("FrameTapFilter failed to convert frame");
+            continue;
+        }
+        Q_EMIT m_filter->frameAvailable(frame);
+    }
+}
+
+FrameTapFilter::FrameTapFilter(QObject *parent)
+    : VideoFilter(*new FrameTapFilterPrivate(), parent)
+{
+}
+
+FrameTapFilter::~FrameTapFilter()
+{
+    // stop emitting signals before the QObject is destroyed
+    d_func().finish();
+}
+
+void FrameTapFilter::setFrameRate(qreal value)
+{
+    DPTR_D(FrameTapFilter);
+    if (d.rate == value)
+        return;
+    d.rate = value;
+    Q_EMIT frameRateChanged();
+}
+
+qreal FrameTapFilter::frameRate() const
+{
+    return d_func().rate;
+}
+
+void FrameTapFilter::setFrameSize(const QSize &value)
+{
+    DPTR_D(FrameTapFilter);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (d.size == value)
+        return;
+    d.size = value;
+    lock.unlock();
+    Q_EMIT frameSizeChanged();
+}
+
+QSize FrameTapFilter::frameSize() const
+{
+    DPTR_D(const FrameTapFilter);
+    QMutexLocker lock(&const_cast<FrameTapFilterPrivate&>(d).mutex);
+    Q_UNUSED(lock);
+    return d.size;
+}
+
+void FrameTapFilter::setPixelFormat(VideoFormat::PixelFormat value)
+{
+    DPTR_D(FrameTapFilter);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    if (d.format == value)
+        return;
+    d.format = value;
+    lock.unlock();
+    Q_EMIT pixelFormatChanged();
+}
+
+VideoFormat::PixelFormat FrameTapFilter::pixelFormat() const
+{
+    DPTR_D(const FrameTapFilter);
+    QMutexLocker lock(&const_cast<FrameTapFilterPrivate&>(d).mutex);
+    Q_UNUSED(lock);
+    return d.format;
+}
+
+int FrameTapFilter::droppedFrames() const
+{
+    DPTR_D(const FrameTapFilter);
+    QMutexLocker lock(&const_cast<FrameTapFilterPrivate&>(d).mutex);
+    Q_UNUSED(lock);
+    return d.dropped;
+}
+
+void FrameTapFilter::process(Statistics *statistics, VideoFrame *frame)
+{
+    Q_UNUSED(statistics);
+    if (!frame || !frame->isValid())
+        return;
+    DPTR_D(FrameTapFilter);
+    const qreal t = frame->timestamp();
+    // restart after seeking backward
+    if (d.rate > 0 && d.last_pts >= 0 && t >= d.last_pts && t < d.last_pts + 1.0/d.rate)
+        return;
+    d.last_pts = t;
+    if (!d.thread) {
+        d.thread = new FrameTapThread(this, &d);
+        d.thread->start();
+    }
+    // frame data is shared, e.g. decoder buffers or gpu surface, no copy here
+    d.put(*frame);
+}
+
+} //namespace QtAV
@@ -20,12 +20,14 @@
 ******************************************************************************/
 
 #include "QtAV/LibAVFilter.h"
+#include <QtCore/QMutex>
 #include <QtCore/QSharedPointer>
 #include "QtAV/private/Filter_p.h"
 #include "QtAV/Statistics.h"
 #include "QtAV/AudioFrame.h"
 #include "QtAV/VideoFrame.h"
 #include "QtAV/private/AVCompat.h"
+#include "QtAV/private/AVDecoder_p.h"
 #include "utils/internal.h"
 #include "utils/Logger.h"
 
@@ -37,12 +39,41 @@
 // TODO: enabled = false if no libavfilter
 // NO COPY in push/pull
 #define QTAV_HAVE_av_buffersink_get_frame (LIBAV_MODULE_CHECK(LIBAVFILTER, 4, 2, 0) || FFMPEG_MODULE_CHECK(LIBAVFILTER, 3, 79, 100)) //3.79.101: ff2.0.4
+#define QTAV_HAVE_avfilter_graph_send_command (QTAV_HAVE(AVFILTER) && FFMPEG_MODULE_CHECK(LIBAVFILTER, 2, 52, 100))
+// graphs of hw filters(scale_vaapi, deinterlace_vaapi etc.) fed with surfaces from VideoDecoderVAAPI. ff3.1: buffersrc hw_frames_ctx
+#define QTAV_HAVE_vaapi_filter (QTAV_HAVE(AVFILTER) && QTAV_HAVE(VAAPI) && FFMPEG_MODULE_CHECK(LIBAVFILTER, 6, 47, 100))
+#if QTAV_HAVE_vaapi_filter
+extern "C" {
+#include <libavutil/hwcontext.h>
+#include <libavutil/hwcontext_vaapi.h>
+}
+#include "vaapi/SurfaceInteropVAAPI.h"
+#endif //QTAV_HAVE_vaapi_filter
 
 namespace QtAV {
+#if QTAV_HAVE_vaapi_filter
+namespace {
+// null if frame is not from VideoDecoderVAAPI in zero copy mode
+vaapi::surface_ptr vaapiSurface(const VideoFrame& frame, VideoSurfaceInteropPtr *interop = 0)
+{
+    vaapi::surface_ptr surface;
+    const VideoSurfaceInteropPtr ip = frame.surfaceInterop();
+    if (ip && ip->map(VAAPISurface, frame.format(), &surface) && interop)
+        *interop = ip;
+    return surface;
+}
+
+void releaseSurface(void *opaque, uint8_t *data)
+{
+    Q_UNUSED(opaque);
+    delete (vaapi::surface_ptr*)data;
+}
+} //namespace
+#endif //QTAV_HAVE_vaapi_filter
 
 #if QTAV_HAVE(AVFILTER)
 // local types can not be used as template parameters
-class AVFrameHolder {
+class AVFrameHolder : public FrameBuffer {
 public:
     AVFrameHolder() {
         m_frame = av_frame_alloc();
@@ -57,7 +88,10 @@ public:
 #endif
     }
     AVFrame* frame() { return m_frame;}
-#if !QTAV_HAVE_av_buffersink_get_frame
+#if QTAV_HAVE_av_buffersink_get_frame
+    // a ref counted frame from buffersink. the next graph can reference it
+    const AVFrame* avframe() const Q_DECL_OVERRIDE { return m_frame;}
+#else
     AVFilterBufferRef** bufferRef() { return &picref;}
     // copy properties and data ptrs(no deep copy).
     void copyBufferToFrame() { avfilter_copy_buf_props(m_frame, picref);}
@@ -85,11 +119,17 @@ public:
         out_filter_ctx = 0;
         avfilter_register_all();
 #endif //QTAV_HAVE(AVFILTER)
+#if QTAV_HAVE_vaapi_filter
+        hw_frames = 0;
+#endif
     }
     ~Private() {
 #if QTAV_HAVE(AVFILTER)
         avfilter_graph_free(&filter_graph);
 #endif //QTAV_HAVE(AVFILTER)
+#if QTAV_HAVE_vaapi_filter
+        av_buffer_unref(&hw_frames);
+#endif
         if (avframe) {
             av_frame_free(&avframe);
             avframe = 0;
@@ -103,8 +143,131 @@ public:
         status = LibAVFilter::NotConfigured;
         return true;
     }
+    struct Command {
+        QByteArray target, command, arg;
+    };
+    struct FilterArgs {
+        QString name;
+        QStringList keys, values;
+    };
+    // "a=k1=v1:k2=v2,b". false for labels, multiple chains, positional values or escaped chars
+    static bool parseChain(const QString& opt, QList<FilterArgs> *chain) {
+        if (opt.contains(QLatin1Char(';')) || opt.contains(QLatin1Char('[')) || opt.contains(QLatin1Char('\\')) || opt.contains(QLatin1Char('\'')))
+            return false;
+        foreach (const QString& f, opt.split(QLatin1Char(','))) {
+            FilterArgs fa;
+            const int eq = f.indexOf(QLatin1Char('='));
+            fa.name = f.left(eq).trimmed();
+            if (fa.name.isEmpty())
+                return false;
+            if (eq > 0) {
+                foreach (const QString& kv, f.mid(eq + 1).split(QLatin1Char(':'))) {
+                    const int i = kv.indexOf(QLatin1Char('='));
+                    if (i <= 0)
+                        return false;
+                    fa.keys.append(kv.left(i).trimmed());
+                    fa.values.append(kv.mid(i + 1).trimmed());
+                }
+            }
+            chain->append(fa);
+        }
+        return true;
+    }
+    /*!
+     * Compare options with the configured ones. If only argument values changed, send them to the filter instances
+     * (named "Parsed_<name>_<index>" by avfilter_graph_parse) as commands. Return false if the graph must be rebuilt
+     */
+    bool applyOptionCommands() {
+#if QTAV_HAVE_avfilter_graph_send_command
+        if (!filter_graph || !avframe || configured_options.isEmpty())
+            return false;
+        QList<FilterArgs> from, to;
+        if (!parseChain(configured_options, &from) || !parseChain(options, &to) || from.size() != to.size())
+            return false;
+        QList<Command> cmds;
+        for (int i = 0; i < to.size(); ++i) {
+            if (from[i].name != to[i].name || from[i].keys != to[i].keys)
+                return false;
+            const QByteArray target(QStringLiteral("Parsed_%1_%2").arg(to[i].name).arg(i).toUtf8());
+            for (int k = 0; k < to[i].keys.size(); ++k) {
+                if (from[i].values[k] == to[i].values[k])
+                    continue;
+                Command c;
+                c.target = target;
+                c.command = to[i].keys[k].toUtf8();
+                c.arg = to[i].values[k].toUtf8();
+                cmds.append(c);
+            }
+        }
+        foreach (const Command& c, cmds) {
+            char res[256] = {0};
+            const int ret = avfilter_graph_send_command(filter_graph, c.target.constData(), c.command.constData(), c.arg.constData(), res, sizeof(res), 0);
+            if (ret < 0) {
+                qDebug("libavfilter command %s %s=%s is not applied (%s). rebuild the graph", c.target.constData(), c.command.constData(), c.arg.constData(), av_err2str(ret));
+                return false;
+            }
+        }
+        configured_options = options;
+        status = LibAVFilter::ConfigureOk;
+        return true;
+#else
+        return false;
+#endif
+    }
+    // call before pushing a frame in filtering thread
+    void prepareGraph() {
+        if (status == LibAVFilter::NotConfigured)
+            applyOptionCommands();
+        QList<Command> cmds;
+        {
+            QMutexLocker lock(&cmd_mutex);
+            Q_UNUSED(lock);
+            cmds.swap(commands);
+        }
+#if QTAV_HAVE_avfilter_graph_send_command
+        if (status != LibAVFilter::ConfigureOk || !filter_graph)
+            return;
+        foreach (const Command& c, cmds) {
+            char res[256] = {0};
+            const int ret = avfilter_graph_send_command(filter_graph, c.target.constData(), c.command.constData(), c.arg.constData(), res, sizeof(res), 0);
+            if (ret < 0)
+                qWarning("libavfilter command %s %s %s error: %s", c.target.constData(), c.command.constData(), c.arg.constData(), av_err2str(ret));
+        }
+#endif
+    }
     bool pushAudioFrame(Frame *frame, bool changed, const QString& args);
     bool pushVideoFrame(Frame *frame, bool changed, const QString& args);
+#if QTAV_HAVE_vaapi_filter
+    /*!
+     * create the frames context of va surfaces as buffersrc input, on the display of the decoder. The display is not
+     * terminated by ffmpeg because it's not opened by ffmpeg
+     */
+    bool setupVAAPIFrames(const vaapi::surface_ptr& surface) {
+        av_buffer_unref(&hw_frames);
+        AVBufferRef *device = av_hwdevice_ctx_alloc(AV_HWDEVICE_TYPE_VAAPI);
+        if (!device)
+            return false;
+        AVVAAPIDeviceContext *va_device = (AVVAAPIDeviceContext*)((AVHWDeviceContext*)device->data)->hwctx;
+        va_device->display = surface->vadisplay();
+        int ret = av_hwdevice_ctx_init(device);
+        if (ret >= 0) {
+            hw_frames = av_hwframe_ctx_alloc(device);
+            if (hw_frames) {
+                AVHWFramesContext *frames = (AVHWFramesContext*)hw_frames->data;
+                frames->format = AV_PIX_FMT_VAAPI;
+                frames->sw_format = AV_PIX_FMT_NV12;
+                frames->width = surface->width();
+                frames->height = surface->height();
+                ret = av_hwframe_ctx_init(hw_frames); // input surfaces are not from its pool
+                if (ret < 0)
+                    av_buffer_unref(&hw_frames);
+            }
+        }
+        av_buffer_unref(&device); // referenced by hw_frames
+        AV_ENSURE_OK(ret, false);
+        return !!hw_frames;
+    }
+#endif //QTAV_HAVE_vaapi_filter
 
     bool setup(const QString& args, bool video) {
         if (avframe) {
@@ -112,6 +275,7 @@ public:
             avframe = 0;
         }
         status = LibAVFilter::ConfigureFailed;
+        configured_options.clear();
 #if QTAV_HAVE(AVFILTER)
         avfilter_graph_free(&filter_graph);
         filter_graph = avfilter_graph_alloc();
@@ -126,6 +290,17 @@ public:
                                                "in", buffersrc_args.toUtf8().constData(), NULL,
                                                filter_graph)
                      , false);
+#if QTAV_HAVE_vaapi_filter
+        if (video && hw_frames) {
+            AVBufferSrcParameters *par = av_buffersrc_parameters_alloc();
+            if (!par)
+                return false;
+            par->hw_frames_ctx = hw_frames; // referenced by buffersrc
+            const int ret = av_buffersrc_parameters_set(in_filter_ctx, par);
+            av_free(par);
+            AV_ENSURE_OK(ret, false);
+        }
+#endif //QTAV_HAVE_vaapi_filter
         /* buffer video sink: to terminate the filter chain. */
         AVFilter *buffersink = avfilter_get_by_name(video ? "buffersink" : "abuffersink");
         Q_ASSERT(buffersink);
@@ -164,6 +339,7 @@ public:
         AV_ENSURE_OK(avfilter_graph_config(filter_graph, NULL), false);
         avframe = av_frame_alloc();
         status = LibAVFilter::ConfigureOk;
+        configured_options = options;
         return true;
 #endif //QTAV_HAVE(AVFILTER)
         return false;
@@ -173,9 +349,15 @@ public:
     AVFilterContext *in_filter_ctx;
     AVFilterContext *out_filter_ctx;
 #endif //QTAV_HAVE(AVFILTER)
+#if QTAV_HAVE_vaapi_filter
+    AVBufferRef *hw_frames; // AVHWFramesContext of input va surfaces. null for host frames
+#endif
     AVFrame *avframe;
     QString options;
+    QString configured_options; // options of the running graph
     LibAVFilter::Status status;
+    QMutex cmd_mutex;
+    QList<Command> commands; // from sendCommand()
 };
 
 QStringList LibAVFilter::videoFilters()
@@ -231,6 +413,17 @@ QString LibAVFilter::options() const
     return priv->options;
 }
 
+void LibAVFilter::sendCommand(const QString &target, const QString &command, const QString &arg)
+{
+    Private::Command c;
+    c.target = target.toUtf8();
+    c.command = command.toUtf8();
+    c.arg = arg.toUtf8();
+    QMutexLocker lock(&priv->cmd_mutex);
+    Q_UNUSED(lock);
+    priv->commands.append(c);
+}
+
 LibAVFilter::Status LibAVFilter::status() const
 {
     return priv->status;
@@ -330,11 +523,18 @@ void LibAVFilterVideo::process(Statistics *statistics, VideoFrame *frame)
     DPTR_D(LibAVFilterVideo);
     //Status old = status();
     bool changed = false;
-    if (d.width != frame->width() || d.height != frame->height() || d.pixfmt != frame->pixelFormatFFmpeg()) {
+    AVPixelFormat pixfmt = (AVPixelFormat)frame->pixelFormatFFmpeg();
+#if QTAV_HAVE_vaapi_filter
+    VideoSurfaceInteropPtr va_interop;
+    const vaapi::surface_ptr va_surface = vaapiSurface(*frame, &va_interop);
+    if (va_surface)
+        pixfmt = AV_PIX_FMT_VAAPI;
+#endif //QTAV_HAVE_vaapi_filter
+    if (d.width != frame->width() || d.height != frame->height() || d.pixfmt != pixfmt) {
         changed = true;
         d.width = frame->width();
         d.height = frame->height();
-        d.pixfmt = (AVPixelFormat)frame->pixelFormatFFmpeg();
+        d.pixfmt = pixfmt;
     }
     bool ok = pushVideoFrame(frame, changed);
     //if (old != status())
@@ -346,10 +546,33 @@ void LibAVFilterVideo::process(Statistics *statistics, VideoFrame *frame)
     if (!ref)
         return;
     const AVFrame *f = ref->frame();
+#if QTAV_HAVE_vaapi_filter
+    if (f->format == AV_PIX_FMT_VAAPI) {
+        // a va surface allocated by the graph. rendered by the interop of the decoder, without copy
+        if (!va_surface) {
+            qWarning("LibAVFilterVideo: va surface output requires va surface input");
+            return;
+        }
+        vaapi::surface_ptr surface(new vaapi::surface_t(f->width, f->height, (VASurfaceID)(uintptr_t)f->data[3], va_surface->display(), false));
+        surface->setColorSpace(va_surface->colorSpace());
+        vaapi::SurfaceInteropVAAPI *interop = new vaapi::SurfaceInteropVAAPI(static_cast<vaapi::SurfaceInteropVAAPI*>(va_interop.data())->resource());
+        interop->setSurface(surface, f->width, f->height);
+        // the same host format as decoder output, in which gl computes texture size
+        VideoFrame vf(f->width, f->height, frame->format());
+        for (int i = 0; i < vf.planeCount(); ++i)
+            vf.setBytesPerLine(frame->bytesPerLine(i)*f->width/qMax(frame->width(), 1), i);
+        vf.setSurfaceInterop(VideoSurfaceInteropPtr(interop));
+        vf.setBufferRef(ref); // keeps the surface
+        vf.setTimestamp(f->pts/1000000.0);
+        vf.setDisplayAspectRatio(frame->displayAspectRatio());
+        *frame = vf;
+        return;
+    }
+#endif //QTAV_HAVE_vaapi_filter
     VideoFrame vf(f->width, f->height, VideoFormat(f->format));
     vf.setBits((quint8**)f->data);
     vf.setBytesPerLine((int*)f->linesize);
-    vf.setMetaData(QStringLiteral("avframe_hoder_ref"), QVariant::fromValue(ref));
+    vf.setBufferRef(ref);
     vf.setTimestamp(ref->frame()->pts/1000000.0); //pkt_pts?
     //vf.setMetaData(frame->availableMetaData());
     *frame = vf;
@@ -454,7 +677,7 @@ void LibAVFilterAudio::process(Statistics *statistics, AudioFrame *frame)
     af.setBits(f->extended_data); // TODO: ref
     af.setBytesPerLine(f->linesize[0], 0); // for correct alignment
     af.setSamplesPerChannel(f->nb_samples);
-    af.setMetaData(QStringLiteral("avframe_hoder_ref"), QVariant::fromValue(ref));
+    af.setBufferRef(ref);
     af.setTimestamp(ref->frame()->pts/1000000.0); //pkt_pts?
     //af.setMetaData(frame->availableMetaData());
     *frame = af;
@@ -472,6 +695,41 @@ bool LibAVFilter::Private::pushVideoFrame(Frame *frame, bool changed, const QStr
 {
 #if QTAV_HAVE(AVFILTER)
     VideoFrame *vf = static_cast<VideoFrame*>(frame);
+    if (!changed)
+        prepareGraph();
+#if QTAV_HAVE_vaapi_filter
+    const vaapi::surface_ptr surface = vaapiSurface(*vf);
+    if (surface) {
+        if (status == LibAVFilter::NotConfigured || !avframe || changed || !hw_frames) {
+            if (!setupVAAPIFrames(surface) || !setup(args, true)) {
+                qWarning("setup vaapi filter graph error");
+                return false;
+            }
+        }
+        AVFrame *f = av_frame_alloc();
+        if (!f)
+            return false;
+        f->format = AV_PIX_FMT_VAAPI;
+        f->width = vf->width();
+        f->height = vf->height();
+        f->pts = frame->timestamp() * 1000000.0; // time_base is 1/1000000
+        f->data[3] = (uint8_t*)(uintptr_t)surface->get();
+        // the decoder does not reuse the surface until the graph releases the frame
+        vaapi::surface_ptr *holder = new vaapi::surface_ptr(surface);
+        f->buf[0] = av_buffer_create((uint8_t*)holder, sizeof(vaapi::surface_ptr), releaseSurface, NULL, AV_BUFFER_FLAG_READONLY);
+        if (!f->buf[0])
+            delete holder;
+        f->hw_frames_ctx = av_buffer_ref(hw_frames);
+        const int ret = f->buf[0] && f->hw_frames_ctx ? av_buffersrc_add_frame(in_filter_ctx, f) : AVERROR(ENOMEM);
+        av_frame_free(&f);
+        AV_ENSURE_OK(ret, false);
+        return true;
+    }
+    if (hw_frames) { // host frames now
+        av_buffer_unref(&hw_frames);
+        changed = true;
+    }
+#endif //QTAV_HAVE_vaapi_filter
     if (status == LibAVFilter::NotConfigured || !avframe || changed) {
         if (!setup(args, true)) {
             qWarning("setup video filter graph error");
@@ -479,6 +737,24 @@ bool LibAVFilter::Private::pushVideoFrame(Frame *frame, bool changed, const QStr
             return false;
         }
     }
+#if QTAV_HAVE(AVBUFREF) && QTAV_HAVE_av_buffersink_get_frame
+    // the decoded or filtered AVFrame is referenced instead of copied in buffersrc, if previous filters did not replace the planes
+    const FrameBufferRef bufs(vf->bufferRef());
+    const AVFrame *src = bufs ? bufs->avframe() : 0;
+    bool same = src && src->width == vf->width() && src->height == vf->height() && src->format == vf->pixelFormatFFmpeg();
+    for (int i = 0; same && i < vf->planeCount(); ++i)
+        same = src->data[i] == vf->constBits(i) && src->linesize[i] == vf->bytesPerLine(i);
+    if (same) {
+        AVFrame *ref = av_frame_clone(src);
+        if (ref) {
+            ref->pts = frame->timestamp() * 1000000.0; // time_base is 1/1000000
+            const int ret = av_buffersrc_add_frame(in_filter_ctx, ref); // takes the reference
+            av_frame_free(&ref);
+            AV_ENSURE_OK(ret, false);
+            return true;
+        }
+    }
+#endif
     avframe->pts = frame->timestamp() * 1000000.0; // time_base is 1/1000000
     avframe->width = vf->width();
     avframe->height = vf->height();
@@ -505,6 +781,8 @@ bool LibAVFilter::Private::pushVideoFrame(Frame *frame, bool changed, const QStr
 bool LibAVFilter::Private::pushAudioFrame(Frame *frame, bool changed, const QString &args)
 {
 #if QTAV_HAVE(AVFILTER)
+    if (!changed)
+        prepareGraph();
     if (status == LibAVFilter::NotConfigured || !avframe || changed) {
         if (!setup(args, false)) {
             qWarning("setup audio filter graph error");
@@ -21,10 +21,15 @@
 
 #include "QtAV/SubtitleFilter.h"
 #include "QtAV/private/Filter_p.h"
+#ifndef QT_NO_OPENGL
+#include "QtAV/OpenGLVideo.h"
+#endif
 #include "QtAV/private/PlayerSubtitle.h"
 #include "QtAV/Subtitle.h"
 #include "QtAV/VideoFrame.h"
 #include <QtCore/QScopedPointer>
+#include <QtGui/QFontMetrics>
+#include <QtGui/QPainter>
 #include "utils/Logger.h"
 
 namespace QtAV {
@@ -36,6 +41,7 @@ public:
         : player_sub(new PlayerSubtitle(0))
         , rect(0.0, 0.0, 1.0, 0.9)
         , color(Qt::white)
+        , text_dirty(true)
     {
         font.setPointSize(22);
     }
@@ -68,11 +74,46 @@ public:
         }
         return r;
     }
+    /*!
+     * rasterize text into an image of its bounding rect if text, style or device size changed. The same image is drawn
+     * for later frames, so a gl paint engine uploads it once (texture cache of QImage::cacheKey()) and only blends the rect
+     */
+    void updateTextImage(const QString& txt, QPaintDevice *dev) {
+        const QSize size(dev->width(), dev->height());
+        if (!text_dirty && txt == text && size == device_size)
+            return;
+        text_dirty = false;
+        text = txt;
+        device_size = size;
+        const int flags = Qt::AlignHCenter | Qt::AlignBottom;
+        const QRect r(realRect(size.width(), size.height()));
+        const QRect br(QFontMetrics(font, dev).boundingRect(r, flags, text));
+        text_pos = br.topLeft();
+        if (br.isEmpty()) {
+            text_image = QImage();
+            return;
+        }
+        text_image = QImage(br.size(), QImage::Format_ARGB32_Premultiplied);
+        text_image.fill(0);
+        // the same font size as drawing on dev
+        text_image.setDotsPerMeterX(qRound(qreal(dev->logicalDpiX())/0.0254));
+        text_image.setDotsPerMeterY(qRound(qreal(dev->logicalDpiY())/0.0254));
+        QPainter p(&text_image);
+        p.setFont(font);
+        p.setPen(color);
+        p.drawText(QRect(QPoint(), br.size()), flags, text);
+    }
 
     QScopedPointer<PlayerSubtitle> player_sub;
     QRectF rect;
     QFont font;
     QColor color;
+    // plain text cache
+    bool text_dirty; // style changed
+    QString text;
+    QSize device_size;
+    QPoint text_pos;
+    QImage text_image;
 };
 
 SubtitleFilter::SubtitleFilter(QObject *parent) :
@@ -81,6 +122,8 @@ SubtitleFilter::SubtitleFilter(QObject *parent) :
 {
     DPTR_D(SubtitleFilter);
     setSubtitle(d.player_sub->subtitle());
+    // images of the next 2 cues are rendered in a worker thread, not in the thread applying this filter
+    d.player_sub->subtitle()->setLookahead(2);
     connect(this, SIGNAL(enabledChanged(bool)), d.player_sub.data(), SLOT(onEnabledChanged(bool)));
     connect(d.player_sub.data(), SIGNAL(autoLoadChanged(bool)), this, SIGNAL(autoLoadChanged(bool)));
     connect(d.player_sub.data(), SIGNAL(fileChanged()), this, SIGNAL(fileChanged()));
@@ -117,6 +160,7 @@ void SubtitleFilter::setRect(const QRectF &r)
     if (d.rect == r)
         return;
     d.rect = r;
+    d.text_dirty = true;
     emit rectChanged();
 }
 
@@ -131,6 +175,7 @@ void SubtitleFilter::setFont(const QFont &f)
     if (d.font == f)
         return;
     d.font = f;
+    d.text_dirty = true;
     emit fontChanged();
 }
 
@@ -145,6 +190,7 @@ void SubtitleFilter::setColor(const QColor &c)
     if (d.color == c)
         return;
     d.color = c;
+    d.text_dirty = true;
     emit colorChanged();
 }
 
@@ -168,6 +214,25 @@ void SubtitleFilter::process(Statistics *statistics, VideoFrame *frame)
     if (d.player_sub->subtitle()->canRender()) {
         if (frame && frame->timestamp() > 0.0)
             d.player_sub->subtitle()->setTimestamp(frame->timestamp()); //TODO: set to current display video frame's timestamp
+#ifndef QT_NO_OPENGL
+        // composited by OpenGLVideo from alpha masks in a texture atlas, no cpu blending
+        if (ctx->opengl) {
+            const QRectF target(0, 0, ctx->paint_device->width(), ctx->paint_device->height());
+            const SubImageSet subs(d.player_sub->subtitle()->getSubImages(target.width(), target.height()));
+            if (subs.isValid()) {
+                if (subs.isEmpty())
+                    return;
+                const bool native = ctx->painter && ctx->painter->isActive();
+                if (native)
+                    ctx->painter->beginNativePainting();
+                const bool ok = ctx->opengl->renderSubImages(subs, target);
+                if (native)
+                    ctx->painter->endNativePainting();
+                if (ok)
+                    return;
+            }
+        }
+#endif //QT_NO_OPENGL
         QRect rect;
         /*
          * image quality maybe to low if use video frame resolution for large display.
@@ -175,16 +240,20 @@ void SubtitleFilter::process(Statistics *statistics, VideoFrame *frame)
          * if use renderer's resolution, we have to map bounding rect from video frame coordinate to renderer's
          */
         //QImage img = d.player_sub->subtitle()->getImage(statistics->video_only.width, statistics->video_only.height, &rect);
-        QImage img = d.player_sub->subtitle()->getImage(ctx->paint_device->width(), ctx->paint_device->height(), &rect);
+        // the processor returns the same image if it does not change (libass detect_change), keep it shared to reuse the texture
+        const QImage img(d.player_sub->subtitle()->getImage(ctx->paint_device->width(), ctx->paint_device->height(), &rect));
         if (img.isNull())
             return;
         ctx->drawImage(rect, img);
         return;
     }
-    ctx->font = d.font;
-    ctx->pen.setColor(d.color);
-    ctx->rect = d.realRect(ctx->paint_device->width(), ctx->paint_device->height());
-    ctx->drawPlainText(ctx->rect, Qt::AlignHCenter | Qt::AlignBottom, d.player_sub->subtitle()->getText());
+    const QString text(d.player_sub->subtitle()->getText());
+    if (text.isEmpty())
+        return;
+    d.updateTextImage(text, ctx->paint_device);
+    if (d.text_image.isNull())
+        return;
+    ctx->drawImage(QPointF(d.text_pos), d.text_image);
 }
 
 } //namespace QtAV
@@ -0,0 +1,532 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/MediaIO.h"
+#include "QtAV/private/MediaIO_p.h"
+#include "QtAV/private/mkid.h"
+#include "QtAV/private/prepost.h"
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtCore/QUrl>
+#include <QtCore/QWaitCondition>
+#if QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
+#include <QtCore/QElapsedTimer>
+#else
+#include <QtCore/QTime>
+typedef QTime QElapsedTimer;
+#endif
+#include <string.h>
+#include "utils/Logger.h"
+
+namespace QtAV {
+static const char kHLSName[] = "HLS";
+class HLSIOPrivate;
+/*!
+ * \brief The HLSIO class
+ * Read a HLS stream as a continuous byte stream of its segments, e.g. MPEG-TS, so AVDemuxer demuxes it as a normal ts
+ * stream. The next prefetchSegments() segments are downloaded in parallel by worker threads while the current one is read,
+ * so a segment boundary does not stall the demux thread. Downloaded segments are kept in memory, or in cacheDir() if not empty.
+ * The first variant of a master playlist is used. A live playlist is reloaded when less than prefetchSegments() segments
+ * are unread. Encrypted segments and byte ranges are not supported. Not seekable.
+ * The transport is libavformat's protocols the same as HTTPRangeIO.
+ * protocols: "hls+http", "hls+https" (hls+http://host/index.m3u8 => http://host/index.m3u8)
+ * properties: prefetchSegments, cacheDir. Set them before avioContext() is called. lastDownloadTime is read only
+ * signal: segmentDownloaded(qint64 sequence, qint64 bytes, qint64 msecs), emitted in a worker thread
+ */
+class HLSIO Q_DECL_FINAL: public MediaIO
+{
+    Q_OBJECT
+    Q_PROPERTY(int prefetchSegments READ prefetchSegments WRITE setPrefetchSegments)
+    Q_PROPERTY(QString cacheDir READ cacheDir WRITE setCacheDir)
+    Q_PROPERTY(qint64 lastDownloadTime READ lastDownloadTime)
+    DPTR_DECLARE_PRIVATE(HLSIO)
+public:
+    HLSIO();
+    QString name() const Q_DECL_OVERRIDE { return QLatin1String(kHLSName);}
+    const QStringList& protocols() const Q_DECL_OVERRIDE
+    {
+        static QStringList p = QStringList() << QStringLiteral("hls+http") << QStringLiteral("hls+https");
+        return p;
+    }
+    bool isSeekable() const Q_DECL_OVERRIDE { return false;}
+    bool isWritable() const Q_DECL_OVERRIDE { return false;}
+    qint64 read(char *data, qint64 maxSize) Q_DECL_OVERRIDE;
+    qint64 write(const char*, qint64) Q_DECL_OVERRIDE { return 0;}
+    bool seek(qint64, int) Q_DECL_OVERRIDE { return false;}
+    qint64 position() const Q_DECL_OVERRIDE;
+    qint64 size() const Q_DECL_OVERRIDE { return 0;}
+
+    /// number of segments downloaded ahead of the current one. default is 3
+    void setPrefetchSegments(int value);
+    int prefetchSegments() const;
+    /// directory to store downloaded segments until they are read. empty(default): in memory
+    void setCacheDir(const QString& value);
+    QString cacheDir() const;
+    /// download time of the last segment in msecs
+    qint64 lastDownloadTime() const;
+Q_SIGNALS:
+    void segmentDownloaded(qint64 sequence, qint64 bytes, qint64 msecs);
+protected:
+    void onUrlChanged() Q_DECL_OVERRIDE;
+private:
+    friend class HLSIOPrivate;
+};
+
+static const MediaIOId MediaIOId_HLS = mkid::id32base36_3<'H','L','S'>::value;
+FACTORY_REGISTER_ID_TYPE(MediaIO, MediaIOId_HLS, HLSIO, kHLSName)
+
+class HLSFetcher : public QThread
+{
+public:
+    HLSFetcher(HLSIOPrivate *p) : QThread(0), d(p) {}
+protected:
+    void run() Q_DECL_OVERRIDE;
+private:
+    HLSIOPrivate *d;
+};
+
+static int hlsInterruptCb(void *opaque)
+{
+    return *static_cast<volatile bool*>(opaque) ? 1 : 0;
+}
+
+class HLSIOPrivate Q_DECL_FINAL: public MediaIOPrivate
+{
+public:
+    typedef struct {
+        qint64 seq; // media sequence number
+        QByteArray url;
+    } Segment;
+
+    HLSIOPrivate()
+        : MediaIOPrivate()
+        , prefetch(3)
+        , opened(false)
+        , ok(false)
+        , endlist(false)
+        , init_sent(false)
+        , stop(false)
+        , target_duration(10)
+        , last_seq(-1)
+        , offset(0)
+        , pos(0)
+        , last_download_time(0)
+    {}
+    ~HLSIOPrivate() {
+        close();
+    }
+    // load the playlist and start workers. called in the thread which first reads
+    bool ensureOpen() {
+        if (opened)
+            return ok;
+        opened = true;
+        if (href.isEmpty())
+            return false;
+        media_url = href;
+        QByteArray text(download(media_url));
+        QByteArray variant(variantUrl(text, media_url));
+        if (!variant.isEmpty()) {
+            qDebug("HLSIO variant playlist: %s", variant.constData());
+            media_url = variant;
+            text = download(media_url);
+        }
+        {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            if (!parse(text, media_url))
+                return false;
+        }
+        reload_timer.start();
+        for (int i = 0; i < prefetch; ++i) {
+            HLSFetcher *t = new HLSFetcher(this);
+            workers.append(t);
+            t->start();
+        }
+        ok = true;
+        return true;
+    }
+    void close() {
+        {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            stop = true;
+            cond_fetch.wakeAll();
+            cond_done.wakeAll();
+        }
+        foreach (HLSFetcher *t, workers) {
+            t->wait();
+            delete t;
+        }
+        workers.clear();
+        foreach (qint64 seq, cached) {
+            QFile::remove(QString::fromUtf8(done.value(seq).constData()));
+        }
+        cached.clear();
+        segments.clear();
+        queued.clear();
+        fetching.clear();
+        done.clear();
+        failed.clear();
+        init_url.clear();
+        data.clear();
+        opened = ok = endlist = init_sent = false;
+        stop = false;
+        target_duration = 10;
+        last_seq = -1;
+        offset = 0;
+        pos = 0;
+    }
+    // read the whole url. empty if error
+    QByteArray download(const QByteArray& url) {
+        AVIOInterruptCB cb;
+        cb.callback = hlsInterruptCb;
+        cb.opaque = (void*)&stop;
+        AVIOContext *ctx = 0;
+        const int ret = avio_open2(&ctx, url.constData(), AVIO_FLAG_READ, &cb, NULL);
+        if (ret < 0) {
+            qWarning("HLSIO failed to open '%s': %s", url.constData(), av_err2str(ret));
+            return QByteArray();
+        }
+        const qint64 size = avio_size(ctx);
+        QByteArray buf;
+        if (size > 0)
+            buf.reserve(size);
+        char tmp[64*1024];
+        while (!stop) {
+            const int n = avio_read(ctx, (unsigned char*)tmp, sizeof(tmp));
+            if (n <= 0)
+                break;
+            buf.append(tmp, n);
+        }
+        avio_close(ctx);
+        return buf;
+    }
+    static QByteArray resolve(const QByteArray& base, const QByteArray& uri) {
+        return QUrl::fromEncoded(base).resolved(QUrl::fromEncoded(uri)).toEncoded();
+    }
+    // the 1st variant of a master playlist. empty if text is a media playlist
+    static QByteArray variantUrl(const QByteArray& text, const QByteArray& base) {
+        const QList<QByteArray> lines(text.split('\n'));
+        bool stream_inf = false;
+        foreach (QByteArray line, lines) {
+            line = line.trimmed();
+            if (line.startsWith("#EXT-X-STREAM-INF")) {
+                stream_inf = true;
+                continue;
+            }
+            if (stream_inf && !line.isEmpty() && !line.startsWith('#'))
+                return resolve(base, line);
+        }
+        return QByteArray();
+    }
+    // append new segments of a media playlist. mutex must be locked
+    bool parse(const QByteArray& text, const QByteArray& base) {
+        if (!text.startsWith("#EXTM3U")) {
+            qWarning("HLSIO: not a m3u8 playlist");
+            return false;
+        }
+        const QList<QByteArray> lines(text.split('\n'));
+        qint64 seq = 0;
+        foreach (QByteArray line, lines) {
+            line = line.trimmed();
+            if (line.isEmpty())
+                continue;
+            if (line.startsWith("#EXT-X-MEDIA-SEQUENCE:")) {
+                seq = line.mid(22).toLongLong();
+            } else if (line.startsWith("#EXT-X-TARGETDURATION:")) {
+                target_duration = qMax(1, line.mid(22).toInt());
+            } else if (line.startsWith("#EXT-X-ENDLIST")) {
+                endlist = true;
+            } else if (line.startsWith("#EXT-X-KEY:")) {
+                if (!line.contains("METHOD=NONE")) {
+                    qWarning("HLSIO: encrypted segments are not supported");
+                    return false;
+                }
+            } else if (line.startsWith("#EXT-X-BYTERANGE")) {
+                qWarning("HLSIO: byte range segments are not supported");
+                return false;
+            } else if (line.startsWith("#EXT-X-MAP:")) {
+                const int p = line.indexOf("URI=\"");
+                if (p > 0 && init_url.isEmpty()) {
+                    const int e = line.indexOf('"', p + 5);
+                    init_url = resolve(base, line.mid(p + 5, e - p - 5));
+                }
+            } else if (!line.startsWith('#')) {
+                if (seq > last_seq) {
+                    Segment s;
+                    s.seq = seq;
+                    s.url = resolve(base, line);
+                    segments.append(s);
+                    last_seq = seq;
+                }
+                ++seq;
+            }
+        }
+        return true;
+    }
+    // reload a live playlist. wait at least half of target duration since the last reload if wait is true
+    void reload(bool wait) {
+        const qint64 interval = target_duration*500;
+        if (!wait && reload_timer.elapsed() < interval)
+            return;
+        if (wait) {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            // QThread::msleep() is protected in Qt4. close() wakes it up
+            while (!stop && reload_timer.elapsed() < interval)
+                cond_done.wait(&mutex, 20);
+        }
+        if (stop)
+            return;
+        reload_timer.restart();
+        const QByteArray text(download(media_url));
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        parse(text, media_url);
+    }
+    // request the current and the next prefetch segments. mutex must be locked
+    void schedule() {
+        queued.clear();
+        for (int i = 0; i < qMin(segments.size(), prefetch + 1); ++i) {
+            const Segment &s = segments.at(i);
+            if (done.contains(s.seq) || fetching.contains(s.seq) || failed.contains(s.seq))
+                continue;
+            queued.append(s);
+        }
+        if (!queued.isEmpty())
+            cond_fetch.wakeAll();
+    }
+    // make the next segment current. return false if no more segments
+    bool nextSegment() {
+        QMutexLocker lock(&mutex);
+        while (segments.isEmpty()) {
+            if (endlist || stop)
+                return false;
+            lock.unlock();
+            reload(true);
+            lock.relock();
+        }
+        const qint64 seq = segments.first().seq;
+        schedule();
+        while (!done.contains(seq) && !failed.contains(seq) && !stop)
+            cond_done.wait(&mutex);
+        segments.removeFirst();
+        failed.remove(seq);
+        const QByteArray d(done.take(seq));
+        const bool in_file = cached.remove(seq);
+        schedule();
+        const bool need_reload = !endlist && segments.size() <= prefetch;
+        lock.unlock();
+        // never play the previous segment again if this one is not available
+        data.clear();
+        if (!in_file) {
+            data = d;
+        } else {
+            QFile f(QString::fromUtf8(d.constData()));
+            if (f.open(QIODevice::ReadOnly))
+                data = f.readAll();
+            else
+                qWarning() << "HLSIO: failed to open " << f.fileName() << ": " << f.errorString();
+            f.close();
+            f.remove();
+        }
+        offset = 0;
+        if (data.isEmpty())
+            qWarning("HLSIO: skip segment %lld", seq);
+        if (need_reload)
+            reload(false);
+        return !stop;
+    }
+    void fetchLoop() {
+        QMutexLocker lock(&mutex);
+        while (!stop) {
+            if (queued.isEmpty()) {
+                cond_fetch.wait(&mutex);
+                continue;
+            }
+            const Segment s = queued.takeFirst();
+            fetching.insert(s.seq);
+            lock.unlock();
+            QElapsedTimer t;
+            t.start();
+            QByteArray d;
+            for (int i = 0; i < 2 && d.isEmpty() && !stop; ++i) // retry once
+                d = download(s.url);
+            const qint64 msecs = t.elapsed();
+            const qint64 bytes = d.size();
+            bool in_file = false;
+            if (!cache_dir.isEmpty() && !d.isEmpty()) {
+                const QByteArray h(QCryptographicHash::hash(s.url, QCryptographicHash::Sha1).toHex());
+                const QString path(QStringLiteral("%1/%2.seg").arg(cache_dir).arg(QString::fromLatin1(h.constData())));
+                QFile f(path);
+                if (f.open(QIODevice::WriteOnly | QIODevice::Truncate) && f.write(d) == d.size()) {
+                    d = path.toUtf8();
+                    in_file = true;
+                } else {
+                    qWarning() << "HLSIO: failed to write " << path << ": " << f.errorString() << ". keep in memory";
+                    f.close();
+                    f.remove();
+                }
+            }
+            lock.relock();
+            fetching.remove(s.seq);
+            if (bytes <= 0 || d.isEmpty())
+                failed.insert(s.seq);
+            else
+                done.insert(s.seq, d);
+            if (in_file)
+                cached.insert(s.seq);
+            last_download_time = msecs;
+            cond_done.wakeAll();
+            if (bytes > 0) {
+                lock.unlock();
+                Q_EMIT static_cast<HLSIO*>(dptr_ptr())->segmentDownloaded(s.seq, bytes, msecs);
+                lock.relock();
+            }
+        }
+    }
+
+    int prefetch;
+    QString cache_dir;
+    QByteArray href; // playlist url for libavformat
+    QByteArray media_url; // media playlist
+    QByteArray init_url; // EXT-X-MAP
+    bool opened, ok, endlist, init_sent;
+    volatile bool stop;
+    int target_duration; // seconds
+    qint64 last_seq;
+    QElapsedTimer reload_timer;
+    QByteArray data; // current segment
+    int offset; // in data
+    qint64 pos;
+    qint64 last_download_time;
+    QMutex mutex;
+    QWaitCondition cond_fetch, cond_done;
+    QList<HLSFetcher*> workers;
+    QList<Segment> segments; // unread segments, the 1st one is the next to read
+    QList<Segment> queued;
+    QSet<qint64> fetching, failed;
+    QHash<qint64, QByteArray> done; // data, or file path if in cached
+    QSet<qint64> cached; // segments of done saved in cache_dir
+};
+
+void HLSFetcher::run()
+{
+    d->fetchLoop();
+}
+
+HLSIO::HLSIO()
+    : MediaIO(*new HLSIOPrivate())
+{
+    setBufferSize(256*1024);
+}
+
+void HLSIO::setPrefetchSegments(int value)
+{
+    DPTR_D(HLSIO);
+    if (d.opened) {
+        qWarning("HLSIO.prefetchSegments must be set before open");
+        return;
+    }
+    d.prefetch = qMax(1, value);
+}
+
+int HLSIO::prefetchSegments() const
+{
+    return d_func().prefetch;
+}
+
+void HLSIO::setCacheDir(const QString &value)
+{
+    DPTR_D(HLSIO);
+    if (d.opened) {
+        qWarning("HLSIO.cacheDir must be set before open");
+        return;
+    }
+    if (!value.isEmpty() && !QDir().mkpath(value)) {
+        qWarning() << "HLSIO: failed to create cache directory " << value;
+        return;
+    }
+    d.cache_dir = value;
+}
+
+QString HLSIO::cacheDir() const
+{
+    return d_func().cache_dir;
+}
+
+qint64 HLSIO::lastDownloadTime() const
+{
+    HLSIOPrivate &d = const_cast<HLSIOPrivate&>(d_func());
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    return d.last_download_time;
+}
+
+qint64 HLSIO::read(char *data, qint64 maxSize)
+{
+    DPTR_D(HLSIO);
+    if (!d.ensureOpen())
+        return 0;
+    while (d.offset >= d.data.size()) {
+        if (!d.init_sent) {
+            d.init_sent = true;
+            if (!d.init_url.isEmpty()) {
+                d.data = d.download(d.init_url);
+                d.offset = 0;
+                continue;
+            }
+        }
+        if (!d.nextSegment())
+            return 0;
+    }
+    const int n = (int)qMin<qint64>(maxSize, d.data.size() - d.offset);
+    memcpy(data, d.data.constData() + d.offset, n);
+    d.offset += n;
+    d.pos += n;
+    return n;
+}
+
+qint64 HLSIO::position() const
+{
+    return d_func().pos;
+}
+
+void HLSIO::onUrlChanged()
+{
+    DPTR_D(HLSIO);
+    d.close();
+    // open lazily in the io thread
+    QString path(url());
+    if (path.startsWith(QLatin1String("hls+")))
+        path.remove(0, 4);
+    d.href = path.toUtf8();
+}
+
+} //namespace QtAV
+#include "HLSIO.moc"
@@ -0,0 +1,444 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/MediaIO.h"
+#include "QtAV/private/MediaIO_p.h"
+#include "QtAV/private/mkid.h"
+#include "QtAV/private/prepost.h"
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+#include <string.h>
+#include "utils/Logger.h"
+
+namespace QtAV {
+static const char kHTTPRangeName[] = "HTTPRange";
+// attempts of read() to get a chunk before it reports an error. each fetch already retries once with a new connection
+static const int kChunkAttempts = 3;
+class HTTPRangeIOPrivate;
+/*!
+ * \brief The HTTPRangeIO class
+ * Read a remote file by fixed size chunks. Each chunk is a ranged request, and several chunks are fetched in parallel
+ * by connections() worker threads, then read() returns them in order. Recently fetched chunks are kept in a LRU cache,
+ * so seeking back and forth (scrubbing) does not fetch again.
+ * The transport is libavformat's http(s) protocol, a seek of the protocol context is a request with "Range: bytes=offset-".
+ * size() is Content-Length. If the server does not report a size or is not seekable, fallback to sequential read.
+ * protocols: "http+range", "https+range" (http+range://host/path => http://host/path)
+ * properties: connections, chunkSize, cacheChunks. Set them before avioContext() is called
+ */
+class HTTPRangeIO Q_DECL_FINAL: public MediaIO
+{
+    Q_OBJECT
+    Q_PROPERTY(int connections READ connections WRITE setConnections)
+    Q_PROPERTY(int chunkSize READ chunkSize WRITE setChunkSize)
+    Q_PROPERTY(int cacheChunks READ cacheChunks WRITE setCacheChunks)
+    DPTR_DECLARE_PRIVATE(HTTPRangeIO)
+public:
+    HTTPRangeIO();
+    QString name() const Q_DECL_OVERRIDE { return QLatin1String(kHTTPRangeName);}
+    const QStringList& protocols() const Q_DECL_OVERRIDE
+    {
+        static QStringList p = QStringList() << QStringLiteral("http+range") << QStringLiteral("https+range");
+        return p;
+    }
+    bool isSeekable() const Q_DECL_OVERRIDE;
+    bool isWritable() const Q_DECL_OVERRIDE { return false;}
+    qint64 read(char *data, qint64 maxSize) Q_DECL_OVERRIDE;
+    qint64 write(const char*, qint64) Q_DECL_OVERRIDE { return 0;}
+    bool seek(qint64 offset, int from) Q_DECL_OVERRIDE;
+    qint64 position() const Q_DECL_OVERRIDE;
+    qint64 size() const Q_DECL_OVERRIDE;
+
+    /// number of parallel connections. default is 4
+    void setConnections(int value);
+    int connections() const;
+    /// bytes of a ranged request. default is 1MB
+    void setChunkSize(int value);
+    int chunkSize() const;
+    /// max chunks in LRU cache. default is 32. always >= connections()
+    void setCacheChunks(int value);
+    int cacheChunks() const;
+protected:
+    void onUrlChanged() Q_DECL_OVERRIDE;
+};
+
+static const MediaIOId MediaIOId_HTTPRange = mkid::id32base36_5<'H','T','T','P','R'>::value;
+FACTORY_REGISTER_ID_TYPE(MediaIO, MediaIOId_HTTPRange, HTTPRangeIO, kHTTPRangeName)
+
+class HTTPRangeFetcher : public QThread
+{
+public:
+    HTTPRangeFetcher(HTTPRangeIOPrivate *p) : QThread(0), d(p) {}
+protected:
+    void run() Q_DECL_OVERRIDE;
+private:
+    HTTPRangeIOPrivate *d;
+};
+
+static int interruptCb(void *opaque)
+{
+    return *static_cast<volatile bool*>(opaque) ? 1 : 0;
+}
+
+class HTTPRangeIOPrivate Q_DECL_FINAL: public MediaIOPrivate
+{
+public:
+    HTTPRangeIOPrivate()
+        : MediaIOPrivate()
+        , connections(4)
+        , chunk_size(1024*1024)
+        , cache_chunks(32)
+        , opened(false)
+        , ranged(false)
+        , stop(false)
+        , ctx0(0)
+        , pos(0)
+        , size(0)
+    {}
+    ~HTTPRangeIOPrivate() {
+        close();
+    }
+    // open the 1st connection to get Content-Length. called in the thread which first uses the io
+    bool ensureOpen() {
+        if (opened)
+            return ctx0 != 0;
+        opened = true;
+        if (href.isEmpty())
+            return false;
+        ctx0 = openContext();
+        if (!ctx0)
+            return false;
+        size = avio_size(ctx0);
+        ranged = size > 0 && !!(ctx0->seekable & AVIO_SEEKABLE_NORMAL);
+        qDebug("HTTPRangeIO size: %lld, ranged request: %d", size, ranged);
+        if (!ranged)
+            return true;
+        // the 1st connection is used by the 1st worker
+        for (int i = 0; i < connections; ++i) {
+            HTTPRangeFetcher *t = new HTTPRangeFetcher(this);
+            workers.append(t);
+            t->start();
+        }
+        return true;
+    }
+    void close() {
+        {
+            QMutexLocker lock(&mutex);
+            Q_UNUSED(lock);
+            stop = true;
+            cond_fetch.wakeAll();
+            cond_chunk.wakeAll();
+        }
+        foreach (HTTPRangeFetcher *t, workers) {
+            t->wait();
+            delete t;
+        }
+        workers.clear();
+        if (ctx0)
+            avio_close(ctx0);
+        ctx0 = 0;
+        chunks.clear();
+        lru.clear();
+        queued.clear();
+        fetching.clear();
+        failed.clear();
+        opened = false;
+        ranged = false;
+        stop = false;
+        pos = 0;
+        size = 0;
+    }
+    AVIOContext* openContext() {
+        AVIOInterruptCB cb;
+        cb.callback = interruptCb;
+        cb.opaque = (void*)&stop;
+        AVIOContext *ctx = 0;
+        const int ret = avio_open2(&ctx, href.constData(), AVIO_FLAG_READ, &cb, NULL);
+        if (ret < 0) {
+            qWarning("HTTPRangeIO failed to open '%s': %s", href.constData(), av_err2str(ret));
+            return 0;
+        }
+        return ctx;
+    }
+    // request chunks in [idx, idx+connections). requests out of the window are dropped, e.g. after seek. mutex must be locked
+    void schedule(qint64 idx) {
+        queued.clear();
+        const qint64 nb_chunks = (size + chunk_size - 1)/chunk_size;
+        for (qint64 i = idx; i < qMin(nb_chunks, idx + connections); ++i) {
+            if (chunks.contains(i) || fetching.contains(i) || failed.contains(i))
+                continue;
+            queued.append(i);
+        }
+        if (!queued.isEmpty())
+            cond_fetch.wakeAll();
+    }
+    // mutex must be locked
+    void touch(qint64 idx) {
+        lru.removeOne(idx);
+        lru.append(idx);
+    }
+    // mutex must be locked
+    void insert(qint64 idx, const QByteArray& data) {
+        chunks.insert(idx, data);
+        touch(idx);
+        const int cap = qMax(cache_chunks, connections + 1);
+        while (lru.size() > cap)
+            chunks.remove(lru.takeFirst());
+    }
+    // fetch in worker thread. return empty if error
+    QByteArray fetch(AVIOContext *ctx, qint64 idx) {
+        const qint64 offset = idx*chunk_size;
+        const int len = (int)qMin<qint64>(chunk_size, size - offset);
+        QByteArray data(len, 0);
+        if (avio_seek(ctx, offset, SEEK_SET) != offset)
+            return QByteArray();
+        int n = 0;
+        while (n < len && !stop) {
+            const int ret = avio_read(ctx, (unsigned char*)data.data() + n, len - n);
+            if (ret <= 0)
+                break;
+            n += ret;
+        }
+        if (n <= 0)
+            return QByteArray();
+        data.resize(n);
+        return data;
+    }
+    void fetchLoop() {
+        AVIOContext *ctx = 0;
+        QMutexLocker lock(&mutex);
+        if (ctx0) { // reuse the connection opened in ensureOpen()
+            ctx = ctx0;
+            ctx0 = 0;
+        }
+        while (!stop) {
+            if (queued.isEmpty()) {
+                cond_fetch.wait(&mutex);
+                continue;
+            }
+            const qint64 idx = queued.takeFirst();
+            fetching.insert(idx);
+            lock.unlock();
+            QByteArray data;
+            // retry once with a new connection, e.g. the server closed a keep-alive connection
+            for (int i = 0; i < 2 && data.isEmpty() && !stop; ++i) {
+                if (!ctx || i > 0) {
+                    if (ctx)
+                        avio_close(ctx);
+                    ctx = openContext();
+                }
+                if (ctx)
+                    data = fetch(ctx, idx);
+            }
+            lock.relock();
+            fetching.remove(idx);
+            if (data.isEmpty())
+                failed.insert(idx);
+            else
+                insert(idx, data);
+            cond_chunk.wakeAll();
+        }
+        lock.unlock();
+        if (ctx)
+            avio_close(ctx);
+    }
+
+    int connections;
+    int chunk_size;
+    int cache_chunks;
+    QByteArray href; // url for libavformat
+    bool opened, ranged;
+    volatile bool stop;
+    AVIOContext *ctx0; // the 1st connection. used for sequential read if not ranged
+    qint64 pos;
+    qint64 size;
+    QMutex mutex;
+    QWaitCondition cond_fetch, cond_chunk;
+    QList<HTTPRangeFetcher*> workers;
+    QHash<qint64, QByteArray> chunks;
+    QList<qint64> lru; // least recently used first
+    QList<qint64> queued;
+    QSet<qint64> fetching, failed;
+};
+
+void HTTPRangeFetcher::run()
+{
+    d->fetchLoop();
+}
+
+HTTPRangeIO::HTTPRangeIO()
+    : MediaIO(*new HTTPRangeIOPrivate())
+{
+    // chunks are in memory, larger buffer only reduces avio callbacks
+    setBufferSize(256*1024);
+}
+
+void HTTPRangeIO::setConnections(int value)
+{
+    DPTR_D(HTTPRangeIO);
+    if (d.opened) {
+        qWarning("HTTPRangeIO.connections must be set before open");
+        return;
+    }
+    d.connections = qMax(1, value);
+}
+
+int HTTPRangeIO::connections() const
+{
+    return d_func().connections;
+}
+
+void HTTPRangeIO::setChunkSize(int value)
+{
+    DPTR_D(HTTPRangeIO);
+    if (d.opened) {
+        qWarning("HTTPRangeIO.chunkSize must be set before open");
+        return;
+    }
+    d.chunk_size = qMax(64*1024, value);
+}
+
+int HTTPRangeIO::chunkSize() const
+{
+    return d_func().chunk_size;
+}
+
+void HTTPRangeIO::setCacheChunks(int value)
+{
+    DPTR_D(HTTPRangeIO);
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    d.cache_chunks = value;
+}
+
+int HTTPRangeIO::cacheChunks() const
+{
+    return d_func().cache_chunks;
+}
+
+bool HTTPRangeIO::isSeekable() const
+{
+    HTTPRangeIOPrivate &d = const_cast<HTTPRangeIOPrivate&>(d_func());
+    return d.ensureOpen() && d.ranged;
+}
+
+qint64 HTTPRangeIO::read(char *data, qint64 maxSize)
+{
+    DPTR_D(HTTPRangeIO);
+    if (!d.ensureOpen())
+        return 0;
+    if (!d.ranged) {
+        const int ret = avio_read(d.ctx0, (unsigned char*)data, (int)maxSize);
+        if (ret == 0 || ret == AVERROR_EOF)
+            return 0;
+        if (ret < 0) {
+            qWarning("HTTPRangeIO read error: %s", av_err2str(ret));
+            return -1;
+        }
+        d.pos += ret;
+        return ret;
+    }
+    if (d.pos >= d.size)
+        return 0;
+    const qint64 idx = d.pos/d.chunk_size;
+    QMutexLocker lock(&d.mutex);
+    Q_UNUSED(lock);
+    for (int i = 0; i < kChunkAttempts && !d.chunks.contains(idx) && !d.stop; ++i) {
+        if (i > 0) {
+            qWarning("HTTPRangeIO failed to fetch chunk %lld. retry %d", idx, i);
+            d.failed.remove(idx);
+            d.cond_chunk.wait(&d.mutex, 200*i); // a transient error may need a while to recover
+            if (d.stop)
+                break;
+        }
+        d.schedule(idx);
+        while (!d.chunks.contains(idx) && !d.failed.contains(idx) && !d.stop)
+            d.cond_chunk.wait(&d.mutex);
+    }
+    if (!d.chunks.contains(idx)) {
+        qWarning("HTTPRangeIO failed to fetch chunk %lld", idx);
+        d.failed.remove(idx); // try again in next read, e.g. after seeking
+        return -1; // not eof
+    }
+    const QByteArray &chunk = d.chunks[idx];
+    const int offset = int(d.pos - idx*d.chunk_size);
+    const int n = (int)qMin<qint64>(maxSize, chunk.size() - offset);
+    if (n <= 0) { // server returns less than Content-Length
+        qWarning("HTTPRangeIO chunk %lld is truncated", idx);
+        return -1;
+    }
+    memcpy(data, chunk.constData() + offset, n);
+    d.touch(idx);
+    d.pos += n;
+    // prefetch the next window as soon as a chunk is consumed
+    if (offset + n >= chunk.size())
+        d.schedule(idx + 1);
+    return n;
+}
+
+bool HTTPRangeIO::seek(qint64 offset, int from)
+{
+    DPTR_D(HTTPRangeIO);
+    if (!isSeekable())
+        return false;
+    // the same as QIODeviceIO
+    if (from == 2) {
+        offset = d.size - offset;
+    } else if (from == 1) {
+        offset = d.pos + offset;
+    }
+    if (offset < 0 || offset > d.size)
+        return false;
+    // fetch is scheduled in read()
+    d.pos = offset;
+    return true;
+}
+
+qint64 HTTPRangeIO::position() const
+{
+    return d_func().pos;
+}
+
+qint64 HTTPRangeIO::size() const
+{
+    HTTPRangeIOPrivate &d = const_cast<HTTPRangeIOPrivate&>(d_func());
+    if (!d.ensureOpen())
+        return 0;
+    return d.ranged ? d.size : 0;
+}
+
+void HTTPRangeIO::onUrlChanged()
+{
+    DPTR_D(HTTPRangeIO);
+    d.close();
+    // open lazily in the io thread. opening here blocks the thread calling setUrl(), e.g. gui thread
+    QString path(url());
+    const int p = path.indexOf(QLatin1String("+range:"));
+    if (p > 0)
+        path.remove(p, 6); // "+range"
+    d.href = path.toUtf8();
+}
+
+} //namespace QtAV
+#include "HTTPRangeIO.moc"
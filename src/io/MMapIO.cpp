@@ -0,0 +1,197 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/MediaIO.h"
+#include "QtAV/private/MediaIO_p.h"
+#include "QtAV/private/mkid.h"
+#include "QtAV/private/prepost.h"
+#include <QtCore/QFile>
+#include <string.h>
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+#include "utils/Logger.h"
+
+namespace QtAV {
+static const char kMMapName[] = "MMap";
+class MMapIOPrivate;
+/*!
+ * \brief The MMapIO class
+ * Local file io. The whole file is mapped into memory, and read() copies from the mapping, so no read() syscall
+ * is required and data is read from page cache directly. Sequential access is hinted to the kernel.
+ * If the file can not be mapped (e.g. not enough address space on 32bit), fallback to QFile io.
+ * protocols: "mmap" (mmap:/path/to/file)
+ */
+class MMapIO Q_DECL_FINAL: public MediaIO
+{
+    Q_OBJECT
+    DPTR_DECLARE_PRIVATE(MMapIO)
+public:
+    MMapIO();
+    QString name() const Q_DECL_OVERRIDE { return QLatin1String(kMMapName);}
+    const QStringList& protocols() const Q_DECL_OVERRIDE
+    {
+        static QStringList p = QStringList() << QStringLiteral("mmap");
+        return p;
+    }
+    bool isSeekable() const Q_DECL_OVERRIDE;
+    bool isWritable() const Q_DECL_OVERRIDE { return false;}
+    qint64 read(char *data, qint64 maxSize) Q_DECL_OVERRIDE;
+    qint64 write(const char*, qint64) Q_DECL_OVERRIDE { return 0;}
+    bool seek(qint64 offset, int from) Q_DECL_OVERRIDE;
+    qint64 position() const Q_DECL_OVERRIDE;
+    qint64 size() const Q_DECL_OVERRIDE;
+protected:
+    void onUrlChanged() Q_DECL_OVERRIDE;
+};
+
+static const MediaIOId MediaIOId_MMap = mkid::id32base36_4<'M','M','a','p'>::value;
+FACTORY_REGISTER_ID_TYPE(MediaIO, MediaIOId_MMap, MMapIO, kMMapName)
+
+class MMapIOPrivate Q_DECL_FINAL: public MediaIOPrivate
+{
+public:
+    MMapIOPrivate()
+        : MediaIOPrivate()
+        , data(0)
+        , pos(0)
+    {}
+    ~MMapIOPrivate() {
+        close();
+    }
+    void close() {
+        if (data)
+            file.unmap(data);
+        data = 0;
+        pos = 0;
+        if (file.isOpen())
+            file.close();
+    }
+    // hint the kernel to read ahead from pos
+    void adviseFrom(qint64 from) {
+#if defined(Q_OS_UNIX) && defined(MADV_WILLNEED)
+        static const qint64 kPageMask = 4096 - 1;
+        static const qint64 kWillNeed = 4*1024*1024;
+        if (!data)
+            return;
+        from &= ~kPageMask;
+        const qint64 len = qMin(kWillNeed, file.size() - from);
+        if (len > 0)
+            ::madvise(data + from, len, MADV_WILLNEED);
+#else
+        Q_UNUSED(from);
+#endif
+    }
+    QFile file;
+    uchar *data;
+    qint64 pos;
+};
+
+MMapIO::MMapIO()
+    : MediaIO(*new MMapIOPrivate())
+{
+    // no syscall for read(), so larger buffer only reduces avio callbacks
+    setBufferSize(1024*1024);
+}
+
+bool MMapIO::isSeekable() const
+{
+    return d_func().file.isOpen();
+}
+
+qint64 MMapIO::read(char *data, qint64 maxSize)
+{
+    DPTR_D(MMapIO);
+    if (!d.data)
+        return d.file.isOpen() ? d.file.read(data, maxSize) : 0;
+    const qint64 n = qMax<qint64>(0, qMin(maxSize, d.file.size() - d.pos));
+    memcpy(data, d.data + d.pos, n);
+    d.pos += n;
+    return n;
+}
+
+bool MMapIO::seek(qint64 offset, int from)
+{
+    DPTR_D(MMapIO);
+    if (!d.file.isOpen())
+        return false;
+    // the same as QIODeviceIO
+    if (from == 2) {
+        offset = d.file.size() - offset;
+    } else if (from == 1) {
+        offset = position() + offset;
+    }
+    if (offset < 0 || offset > d.file.size())
+        return false;
+    if (!d.data)
+        return d.file.seek(offset);
+    // random access, e.g. scrubbing. prefetch new location instead of the fault-in of every page
+    if (offset != d.pos)
+        d.adviseFrom(offset);
+    d.pos = offset;
+    return true;
+}
+
+qint64 MMapIO::position() const
+{
+    DPTR_D(const MMapIO);
+    if (!d.data)
+        return d.file.pos();
+    return d.pos;
+}
+
+qint64 MMapIO::size() const
+{
+    return d_func().file.size();
+}
+
+void MMapIO::onUrlChanged()
+{
+    DPTR_D(MMapIO);
+    d.close();
+    QString path(url());
+    if (path.startsWith(QLatin1String("mmap:")))
+        path = path.mid(5);
+    if (path.startsWith(QLatin1String("//"))) // mmap://path
+        path = path.mid(2);
+    d.file.setFileName(path);
+    if (path.isEmpty())
+        return;
+    if (!d.file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open [" << d.file.fileName() << "]: " << d.file.errorString();
+        return;
+    }
+    if (d.file.size() <= 0)
+        return;
+    d.data = d.file.map(0, d.file.size());
+    if (!d.data) {
+        qWarning() << "Failed to map [" << d.file.fileName() << "]: " << d.file.errorString() << ". fallback to QFile read";
+        return;
+    }
+#if defined(Q_OS_UNIX) && defined(MADV_SEQUENTIAL)
+    // aggressive read ahead and pages can be freed soon after they are read
+    if (::madvise(d.data, d.file.size(), MADV_SEQUENTIAL) != 0)
+        qDebug("madvise MADV_SEQUENTIAL error");
+#endif
+}
+
+} //namespace QtAV
+#include "MMapIO.moc"
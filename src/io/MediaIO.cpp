@@ -24,9 +24,15 @@
 #include "QtAV/private/MediaIO_p.h"
 #include "QtAV/private/factory.h"
 #include <QtCore/QStringList>
+#include "MediaIOReadAhead.h"
+#include "MediaIOWriteBehind.h"
 
 namespace QtAV {
 
+#define IODATA_BUFFER_SIZE 32768 // default
+// AVIOContext.direct
+#define AVIO_DIRECT (FFMPEG_MODULE_CHECK(LIBAVFORMAT, 54, 29, 104) || LIBAV_MODULE_CHECK(LIBAVFORMAT, 55, 0, 0))
+
 FACTORY_DEFINE(MediaIO)
 
 QStringList MediaIO::builtInNames()
@@ -74,7 +80,11 @@ MediaIO* MediaIO::createForUrl(const QString &url)
 static int av_read(void *opaque, unsigned char *buf, int buf_size)
 {
     MediaIO* io = static_cast<MediaIO*>(opaque);
-    return io->read((char*)buf, buf_size);
+    const qint64 ret = io->read((char*)buf, buf_size);
+    // 0 is eof
+    if (ret < 0)
+        return AVERROR(EIO);
+    return ret;
 }
 
 static int av_write(void *opaque, unsigned char *buf, int buf_size)
@@ -83,6 +93,18 @@ static int av_write(void *opaque, unsigned char *buf, int buf_size)
     return io->write((const char*)buf, buf_size);
 }
 
+// MediaIO seek from. return < 0 if not supported
+static int avWhence2From(int whence)
+{
+    if (whence == SEEK_SET)
+        return 0;
+    if (whence == SEEK_CUR)
+        return 1;
+    if (whence == SEEK_END)
+        return 2;
+    return -1;
+}
+
 static int64_t av_seek(void *opaque, int64_t offset, int whence)
 {
     if (whence == SEEK_SET && offset < 0)
@@ -96,18 +118,67 @@ static int64_t av_seek(void *opaque, int64_t offset, int whence)
         // return the filesize without seeking anywhere. Supporting this is optional.
         return io->size() > 0 ? io->size() : 0;
     }
-    int from = whence;
-    if (whence == SEEK_SET)
-        from = 0;
-    else if (whence == SEEK_CUR)
-        from = 1;
-    else if (whence == SEEK_END)
-        from = 2;
+    int from = avWhence2From(whence);
+    if (from < 0)
+        from = whence;
     if (!io->seek(offset, from))
         return -1;
     return io->position();
 }
 
+static int ra_read(void *opaque, unsigned char *buf, int buf_size)
+{
+    MediaIOReadAhead* ra = static_cast<MediaIOReadAhead*>(opaque);
+    const qint64 ret = ra->read((char*)buf, buf_size);
+    if (ret < 0)
+        return AVERROR(EIO);
+    return ret;
+}
+
+static int64_t ra_seek(void *opaque, int64_t offset, int whence)
+{
+    if (whence == SEEK_SET && offset < 0)
+        return -1;
+    MediaIOReadAhead* ra = static_cast<MediaIOReadAhead*>(opaque);
+    if (!ra->mediaIO()->isSeekable()) {
+        qWarning("Can not seek. MediaIO[%s] is not a seekable IO", MediaIO::staticMetaObject.className());
+        return -1;
+    }
+    if (whence == AVSEEK_SIZE)
+        return ra->size() > 0 ? ra->size() : 0;
+    int from = avWhence2From(whence);
+    if (from < 0)
+        from = whence;
+    if (!ra->seek(offset, from))
+        return -1;
+    return ra->position();
+}
+
+static int wb_write(void *opaque, unsigned char *buf, int buf_size)
+{
+    MediaIOWriteBehind* wb = static_cast<MediaIOWriteBehind*>(opaque);
+    return wb->write((const char*)buf, buf_size);
+}
+
+static int64_t wb_seek(void *opaque, int64_t offset, int whence)
+{
+    if (whence == SEEK_SET && offset < 0)
+        return -1;
+    MediaIOWriteBehind* wb = static_cast<MediaIOWriteBehind*>(opaque);
+    if (!wb->mediaIO()->isSeekable()) {
+        qWarning("Can not seek. MediaIO[%s] is not a seekable IO", MediaIO::staticMetaObject.className());
+        return -1;
+    }
+    if (whence == AVSEEK_SIZE)
+        return wb->size() > 0 ? wb->size() : 0;
+    int from = avWhence2From(whence);
+    if (from < 0)
+        from = whence;
+    if (!wb->seek(offset, from))
+        return -1;
+    return wb->position();
+}
+
 MediaIO::MediaIO(QObject *parent)
     : QObject(parent)
 {}
@@ -157,25 +228,117 @@ MediaIO::AccessMode MediaIO::accessMode() const
     return d_func().mode;
 }
 
+void MediaIO::setReadAhead(int bufferSize, int lowWatermark)
+{
+    DPTR_D(MediaIO);
+    if (d.ctx) {
+        qWarning("MediaIO.setReadAhead() must be called before avioContext()");
+        return;
+    }
+    d.read_ahead_size = bufferSize;
+    d.read_ahead_low = lowWatermark;
+}
+
+int MediaIO::readAheadSize() const
+{
+    return d_func().read_ahead_size;
+}
+
+int MediaIO::readAheadLowWatermark() const
+{
+    return d_func().read_ahead_low;
+}
+
+void MediaIO::setWriteBehind(int bufferSize, int highWatermark)
+{
+    DPTR_D(MediaIO);
+    if (d.ctx) {
+        qWarning("MediaIO.setWriteBehind() must be called before avioContext()");
+        return;
+    }
+    d.write_behind_size = bufferSize;
+    d.write_behind_high = highWatermark;
+}
+
+int MediaIO::writeBehindSize() const
+{
+    return d_func().write_behind_size;
+}
+
+int MediaIO::writeBehindHighWatermark() const
+{
+    return d_func().write_behind_high;
+}
+
+void MediaIO::setBufferSize(int value)
+{
+    DPTR_D(MediaIO);
+    if (d.ctx) {
+        qWarning("MediaIO.setBufferSize() must be called before avioContext()");
+        return;
+    }
+    d.buffer_size = value;
+}
+
+int MediaIO::bufferSize() const
+{
+    DPTR_D(const MediaIO);
+    return d.buffer_size > 0 ? d.buffer_size : IODATA_BUFFER_SIZE;
+}
+
+void MediaIO::setDirectRead(bool value)
+{
+    DPTR_D(MediaIO);
+    if (d.ctx) {
+        qWarning("MediaIO.setDirectRead() must be called before avioContext()");
+        return;
+    }
+#if !AVIO_DIRECT
+    if (value)
+        qWarning("MediaIO direct read is not supported by current FFmpeg");
+#endif
+    d.direct_read = value;
+}
+
+bool MediaIO::isDirectRead() const
+{
+    return d_func().direct_read;
+}
+
 const QStringList& MediaIO::protocols() const
 {
     static QStringList no_protocols;
     return no_protocols;
 }
 
-#define IODATA_BUFFER_SIZE 32768 //
 
 void* MediaIO::avioContext()
 {
     DPTR_D(MediaIO);
     // buffer will be released in av_probe_input_buffer2=>ffio_rewind_with_probe_data. always is? may be another context
-    unsigned char* buf = (unsigned char*)av_malloc(IODATA_BUFFER_SIZE);
+    const int buf_size = bufferSize();
+    unsigned char* buf = (unsigned char*)av_malloc(buf_size);
     // open for write if 1. SET 0 if open for read otherwise data ptr in av_read(data, ...) does not change
     const int write_flag = (accessMode() == Write) && isWritable();
-    d.ctx = avio_alloc_context(buf, IODATA_BUFFER_SIZE, write_flag, this, &av_read, write_flag ? &av_write : NULL, &av_seek);
+    if (!write_flag && d.read_ahead_size > 0) {
+        d.read_ahead = new MediaIOReadAhead(this, d.read_ahead_size, d.read_ahead_low);
+        d.read_ahead->start();
+        d.ctx = avio_alloc_context(buf, buf_size, 0, d.read_ahead, &ra_read, NULL, &ra_seek);
+    } else if (write_flag && d.write_behind_size > 0) {
+        d.write_behind = new MediaIOWriteBehind(this, d.write_behind_size, d.write_behind_high);
+        d.write_behind->start();
+        d.ctx = avio_alloc_context(buf, buf_size, 1, d.write_behind, NULL, &wb_write, &wb_seek);
+    } else {
+        d.ctx = avio_alloc_context(buf, buf_size, write_flag, this, &av_read, write_flag ? &av_write : NULL, &av_seek);
+    }
     // if seekable==false, containers that estimate duration from pts(or bit rate) will not seek to the last frame when computing duration
     // but it's still seekable if call seek outside(e.g. from demuxer)
     d.ctx->seekable = isSeekable() && !isVariableSize() ? AVIO_SEEKABLE_NORMAL : 0;
+#if AVIO_DIRECT
+    // avio_read() calls read callback with caller's buffer if size is large
+    if (!write_flag && d.direct_read)
+        d.ctx->direct = 1;
+#endif
     return d.ctx;
 }
 
@@ -184,10 +347,22 @@ void MediaIO::release()
     DPTR_D(MediaIO);
     if (!d.ctx)
         return;
+    if (d.write_behind)
+        avio_flush(d.ctx); // write data in avio buffer to the ring while opaque is valid
     d.ctx->opaque = 0; //in avio_close() opaque is URLContext* and will call ffurl_close()
     //d.ctx->buffer = 0; //already released by ffio_rewind_with_probe_data; may be another context was freed
     avio_close(d.ctx); //avio_closep defined since ffmpeg1.1
     d.ctx = 0;
+    if (d.read_ahead) {
+        d.read_ahead->stop();
+        delete d.read_ahead;
+        d.read_ahead = 0;
+    }
+    if (d.write_behind) {
+        d.write_behind->stop(); // buffered data is written
+        delete d.write_behind;
+        d.write_behind = 0;
+    }
 }
 
 } //namespace QtAV
@@ -0,0 +1,228 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "MediaIOReadAhead.h"
+#include <string.h>
+#include "QtAV/MediaIO.h"
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+static const int kChunkSize = 64*1024;
+static const int kMinChunkSize = 4*1024;
+
+MediaIOReadAhead::MediaIOReadAhead(MediaIO *io, int size, int lowWatermark)
+    : QThread(0)
+    , m_io(io)
+    , m_head(0)
+    , m_len(0)
+    , m_back(0)
+    , m_low(lowWatermark)
+    , m_pos(io->position())
+    , m_size(io->size())
+    , m_generation(0)
+    , m_seek_pending(false)
+    , m_seek_ok(false)
+    , m_seek_offset(0)
+    , m_seek_from(0)
+    , m_eof(false)
+    , m_stop(false)
+    , m_filling(true)
+    , m_error(false)
+{
+    m_ring.resize(qMax(size, 2*kChunkSize));
+    if (m_low < 0 || m_low >= m_ring.size())
+        m_low = m_ring.size()/2;
+}
+
+MediaIOReadAhead::~MediaIOReadAhead()
+{
+    stop();
+}
+
+qint64 MediaIOReadAhead::read(char *data, qint64 maxSize)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    while ((m_len == 0 || m_seek_pending) && !m_eof && !m_stop)
+        m_cond_data.wait(&m_mutex);
+    if (m_len == 0 && m_error)
+        return -1;
+    const int n = (int)qMin<qint64>(maxSize, m_len);
+    pop(data, n);
+    if (m_len <= m_low)
+        m_cond_fill.wakeAll();
+    return n;
+}
+
+bool MediaIOReadAhead::seek(qint64 offset, int from)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    qint64 pos = -1;
+    if (from == 0)
+        pos = offset;
+    else if (from == 1)
+        pos = m_pos + offset;
+    // from end: the meaning is defined by the MediaIO, let the source seek
+    if (!m_seek_pending && pos >= m_pos - m_back && pos <= m_pos + m_len) {
+        if (pos >= m_pos) {
+            pop(0, int(pos - m_pos));
+        } else { // move back
+            const int d = int(m_pos - pos);
+            m_head -= d;
+            if (m_head < 0)
+                m_head += m_ring.size();
+            m_len += d;
+            m_back -= d;
+            m_pos = pos;
+        }
+        if (m_len <= m_low)
+            m_cond_fill.wakeAll();
+        return true;
+    }
+    ++m_generation;
+    m_head = m_len = m_back = 0;
+    m_eof = m_error = false;
+    m_seek_offset = offset;
+    m_seek_from = from;
+    m_seek_pending = true;
+    m_cond_fill.wakeAll();
+    while (m_seek_pending && !m_stop)
+        m_cond_data.wait(&m_mutex);
+    return m_seek_ok;
+}
+
+qint64 MediaIOReadAhead::position() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_pos;
+}
+
+qint64 MediaIOReadAhead::size() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_size;
+}
+
+int MediaIOReadAhead::buffered() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_len;
+}
+
+void MediaIOReadAhead::stop()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_stop = true;
+        m_cond_fill.wakeAll();
+        m_cond_data.wakeAll();
+    }
+    wait();
+}
+
+void MediaIOReadAhead::run()
+{
+    QByteArray chunk(kChunkSize, 0);
+    QMutexLocker lock(&m_mutex);
+    while (!m_stop) {
+        if (m_seek_pending) {
+            const qint64 offset = m_seek_offset;
+            const int from = m_seek_from;
+            const int gen = m_generation;
+            lock.unlock();
+            const bool ok = m_io->seek(offset, from);
+            const qint64 pos = m_io->position();
+            lock.relock();
+            if (gen != m_generation) // a new seek request
+                continue;
+            m_seek_ok = ok;
+            m_pos = pos;
+            m_seek_pending = false;
+            m_filling = true;
+            m_cond_data.wakeAll();
+            continue;
+        }
+        // fill until full, then wait until buffered data is lower than the low watermark
+        const int space = m_ring.size() - m_len;
+        if (m_eof || space < kMinChunkSize || (!m_filling && m_len > m_low)) {
+            m_filling = false;
+            m_cond_fill.wait(&m_mutex);
+            if (m_len <= m_low)
+                m_filling = true;
+            continue;
+        }
+        const int gen = m_generation;
+        const int n = qMin(space, chunk.size());
+        lock.unlock();
+        const qint64 ret = m_io->read(chunk.data(), n);
+        const qint64 size = m_io->size();
+        lock.relock();
+        m_size = size;
+        if (gen != m_generation) // seek requested while reading. source position will be reset by the seek
+            continue;
+        if (ret <= 0) {
+            m_eof = true;
+            m_error = ret < 0;
+        }
+        else
+            push(chunk.constData(), (int)ret);
+        m_cond_data.wakeAll();
+    }
+}
+
+void MediaIOReadAhead::push(const char *data, int size)
+{
+    const int cap = m_ring.size();
+    int tail = m_head + m_len;
+    if (tail >= cap)
+        tail -= cap;
+    const int n1 = qMin(size, cap - tail);
+    memcpy(m_ring.data() + tail, data, n1);
+    if (n1 < size)
+        memcpy(m_ring.data(), data + n1, size - n1);
+    m_len += size;
+    m_back = qMin(m_back, cap - m_len); // overwritten
+}
+
+void MediaIOReadAhead::pop(char *data, int size)
+{
+    const int cap = m_ring.size();
+    if (data) {
+        const int n1 = qMin(size, cap - m_head);
+        memcpy(data, m_ring.constData() + m_head, n1);
+        if (n1 < size)
+            memcpy(data + n1, m_ring.constData(), size - n1);
+    }
+    m_head += size;
+    if (m_head >= cap)
+        m_head -= cap;
+    m_len -= size;
+    m_back += size;
+    m_pos += size;
+}
+
+} //namespace QtAV
@@ -0,0 +1,82 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_MEDIAIOREADAHEAD_H
+#define QTAV_MEDIAIOREADAHEAD_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+namespace QtAV {
+
+class MediaIO;
+/*!
+ * \brief The MediaIOReadAhead class
+ * Reads a MediaIO in a background thread into a bounded byte ring. read(), seek() and position() are called in demux thread
+ * instead of the MediaIO's, and the MediaIO is only accessed in the background thread.
+ * The ring keeps already read bytes until they are overwritten, so small backward seeks (probing, index parsing) and forward
+ * seeks inside buffered data do not touch the source.
+ */
+class MediaIOReadAhead : public QThread
+{
+public:
+    /*!
+     * \param size ring buffer size in bytes
+     * \param lowWatermark start to fill the ring again if buffered bytes <= lowWatermark. < 0: size/2
+     */
+    MediaIOReadAhead(MediaIO *io, int size, int lowWatermark = -1);
+    ~MediaIOReadAhead();
+    MediaIO* mediaIO() const { return m_io;}
+    /// block until some data is available, eof reaches or stopped. return 0 if no more data
+    qint64 read(char *data, qint64 maxSize);
+    bool seek(qint64 offset, int from);
+    qint64 position() const;
+    qint64 size() const;
+    /// bytes can be read without waiting for the source
+    int buffered() const;
+    void stop();
+protected:
+    void run() Q_DECL_OVERRIDE;
+private:
+    // m_mutex must be locked
+    void push(const char* data, int size);
+    void pop(char* data, int size); // drop if data is null
+
+    MediaIO *m_io;
+    mutable QMutex m_mutex;
+    QWaitCondition m_cond_data, m_cond_fill;
+    QByteArray m_ring;
+    int m_head, m_len;
+    int m_back; // bytes before m_head that still can be read again after seek
+    int m_low;
+    qint64 m_pos; // source position of m_head
+    qint64 m_size;
+    int m_generation; // increased on seek, data read before it is dropped
+    bool m_seek_pending, m_seek_ok;
+    qint64 m_seek_offset;
+    int m_seek_from;
+    bool m_eof, m_stop, m_filling;
+    bool m_error; // m_eof is a read error of the source
+};
+} //namespace QtAV
+#endif // QTAV_MEDIAIOREADAHEAD_H
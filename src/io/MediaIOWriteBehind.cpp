@@ -0,0 +1,217 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "MediaIOWriteBehind.h"
+#include <string.h>
+#include "QtAV/MediaIO.h"
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+static const int kBlockSize = 64*1024;
+
+MediaIOWriteBehind::MediaIOWriteBehind(MediaIO *io, int size, int highWatermark, int blockSize)
+    : QThread(0)
+    , m_io(io)
+    , m_head(0)
+    , m_len(0)
+    , m_high(highWatermark)
+    , m_block(blockSize > 0 ? blockSize : kBlockSize)
+    , m_pos(io->position())
+    , m_io_pos(m_pos)
+    , m_size(io->size())
+    , m_seek_pending(false)
+    , m_seek_ok(false)
+    , m_seek_offset(0)
+    , m_seek_from(0)
+    , m_flush(false)
+    , m_error(false)
+    , m_stop(false)
+{
+    m_ring.resize(qMax(size, 2*m_block));
+    if (m_high <= 0 || m_high > m_ring.size())
+        m_high = m_ring.size();
+}
+
+MediaIOWriteBehind::~MediaIOWriteBehind()
+{
+    stop();
+}
+
+qint64 MediaIOWriteBehind::write(const char *data, qint64 maxSize)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    const int cap = m_ring.size();
+    qint64 done = 0;
+    while (done < maxSize) {
+        // back-pressure
+        while (m_len >= m_high && !m_error && !m_stop)
+            m_cond_space.wait(&m_mutex);
+        if (m_error || m_stop)
+            break;
+        const int n = (int)qMin<qint64>(maxSize - done, m_high - m_len);
+        int tail = m_head + m_len;
+        if (tail >= cap)
+            tail -= cap;
+        const int n1 = qMin(n, cap - tail);
+        memcpy(m_ring.data() + tail, data + done, n1);
+        if (n1 < n)
+            memcpy(m_ring.data(), data + done + n1, n - n1);
+        m_len += n;
+        m_pos += n;
+        done += n;
+        if (m_len >= m_block)
+            m_cond_data.wakeAll();
+    }
+    if (done == 0 && m_error)
+        return -1;
+    return done;
+}
+
+bool MediaIOWriteBehind::seek(qint64 offset, int from)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    // muxers often seek to the current position
+    if ((from == 0 && offset == m_pos) || (from == 1 && offset == 0))
+        return true;
+    m_flush = true;
+    m_cond_data.wakeAll();
+    while ((m_len > 0 || m_flush) && !m_error && !m_stop)
+        m_cond_done.wait(&m_mutex);
+    if (m_stop)
+        return false;
+    m_seek_offset = offset;
+    m_seek_from = from;
+    m_seek_pending = true;
+    m_cond_data.wakeAll();
+    while (m_seek_pending && !m_stop)
+        m_cond_done.wait(&m_mutex);
+    return m_seek_ok;
+}
+
+qint64 MediaIOWriteBehind::position() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_pos;
+}
+
+qint64 MediaIOWriteBehind::size() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return qMax(m_size, m_pos);
+}
+
+bool MediaIOWriteBehind::flush()
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_flush = true;
+    m_cond_data.wakeAll();
+    while ((m_len > 0 || m_flush) && !m_error && !m_stop)
+        m_cond_done.wait(&m_mutex);
+    return !m_error;
+}
+
+int MediaIOWriteBehind::buffered() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_len;
+}
+
+void MediaIOWriteBehind::stop()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_stop = true;
+        m_cond_data.wakeAll();
+        m_cond_space.wakeAll();
+        m_cond_done.wakeAll();
+    }
+    wait();
+}
+
+void MediaIOWriteBehind::run()
+{
+    const int cap = m_ring.size();
+    QMutexLocker lock(&m_mutex);
+    while (true) {
+        if (m_seek_pending) { // ring is empty
+            const qint64 offset = m_seek_offset;
+            const int from = m_seek_from;
+            lock.unlock();
+            const bool ok = m_io->seek(offset, from);
+            const qint64 pos = m_io->position();
+            lock.relock();
+            m_seek_ok = ok;
+            m_pos = m_io_pos = pos;
+            m_seek_pending = false;
+            m_cond_done.wakeAll();
+            continue;
+        }
+        if (m_len == 0) {
+            if (m_stop)
+                break;
+            if (m_flush) {
+                m_flush = false;
+                m_cond_done.wakeAll();
+            }
+            m_cond_data.wait(&m_mutex);
+            continue;
+        }
+        int n = qMin(m_len, cap - m_head);
+        if (!m_flush && !m_stop && n == m_len) {
+            // not wrapped. write whole blocks and end at an aligned offset. the rest is written with later data
+            n = int((m_io_pos + n)/m_block*m_block - m_io_pos);
+            if (n <= 0) {
+                m_cond_data.wait(&m_mutex);
+                continue;
+            }
+        }
+        // [m_head, m_head+n) is not touched by write() until it's released
+        const char *data = m_ring.constData() + m_head;
+        lock.unlock();
+        const qint64 ret = m_io->write(data, n);
+        const qint64 size = m_io->size();
+        lock.relock();
+        m_size = size;
+        if (ret < n) {
+            qWarning("MediaIOWriteBehind: failed to write %d bytes at %lld", n, m_io_pos);
+            m_error = true;
+            m_len = 0; // drop
+        } else {
+            m_head += n;
+            if (m_head >= cap)
+                m_head -= cap;
+            m_len -= n;
+            m_io_pos += n;
+        }
+        m_cond_space.wakeAll();
+    }
+    m_cond_done.wakeAll();
+}
+
+} //namespace QtAV
@@ -0,0 +1,80 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_MEDIAIOWRITEBEHIND_H
+#define QTAV_MEDIAIOWRITEBEHIND_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+namespace QtAV {
+
+class MediaIO;
+/*!
+ * \brief The MediaIOWriteBehind class
+ * Writes to a MediaIO in a background thread from a bounded byte ring. write(), seek() and position() are called in mux thread
+ * instead of the MediaIO's, and the MediaIO is only accessed in the background thread.
+ * Small writes from the muxer are coalesced, the MediaIO gets writes of whole blocks ended at block aligned offsets except
+ * the last one before a seek or stop. write() blocks if buffered bytes reaches the high watermark.
+ */
+class MediaIOWriteBehind : public QThread
+{
+public:
+    /*!
+     * \param size ring buffer size in bytes
+     * \param highWatermark write() waits until buffered bytes is less than it. <= 0 or > size: size
+     * \param blockSize coalesced write size. <= 0: 64KB
+     */
+    MediaIOWriteBehind(MediaIO *io, int size, int highWatermark = -1, int blockSize = -1);
+    ~MediaIOWriteBehind();
+    MediaIO* mediaIO() const { return m_io;}
+    /// block if the ring is full. return -1 if a previous write of the MediaIO failed
+    qint64 write(const char *data, qint64 maxSize);
+    /// all buffered data is written before seeking
+    bool seek(qint64 offset, int from);
+    qint64 position() const;
+    qint64 size() const;
+    /// block until all buffered data is written. return false if a write failed
+    bool flush();
+    int buffered() const;
+    /// write buffered data and then stop
+    void stop();
+protected:
+    void run() Q_DECL_OVERRIDE;
+private:
+    MediaIO *m_io;
+    mutable QMutex m_mutex;
+    QWaitCondition m_cond_space, m_cond_data, m_cond_done;
+    QByteArray m_ring;
+    int m_head, m_len;
+    int m_high, m_block;
+    qint64 m_pos; // position after buffered data
+    qint64 m_io_pos; // source position of m_head
+    qint64 m_size;
+    bool m_seek_pending, m_seek_ok;
+    qint64 m_seek_offset;
+    int m_seek_from;
+    bool m_flush, m_error, m_stop;
+};
+} //namespace QtAV
+#endif // QTAV_MEDIAIOWRITEBEHIND_H
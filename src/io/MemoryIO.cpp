@@ -0,0 +1,181 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/MediaIO.h"
+#include "QtAV/private/MediaIO_p.h"
+#include "QtAV/private/mkid.h"
+#include "QtAV/private/prepost.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QResource>
+#include <string.h>
+#include "utils/Logger.h"
+
+namespace QtAV {
+static const char kMemoryName[] = "Memory";
+class MemoryIOPrivate;
+/*!
+ * \brief The MemoryIO class
+ * Read only io of data already in memory, e.g. short clips embedded in the application. read() is a memcpy without
+ * QIODevice calls, and direct read is enabled, so packet data is copied from the source memory into packets once.
+ * properties:
+ *   data - read/write. QByteArray. Use QByteArray::fromRawData() to play user memory without a copy, the memory must be
+ * valid until the io is released.
+ * protocols: "memory". memory:path plays an uncompressed resource (memory::/a.wav or memory:qrc:/a.wav) from its data
+ * in the executable without a copy. Compressed resources are uncompressed once
+ */
+class MemoryIO Q_DECL_FINAL: public MediaIO
+{
+    Q_OBJECT
+    Q_PROPERTY(QByteArray data READ data WRITE setData NOTIFY dataChanged)
+    DPTR_DECLARE_PRIVATE(MemoryIO)
+public:
+    MemoryIO();
+    QString name() const Q_DECL_OVERRIDE { return QLatin1String(kMemoryName);}
+    const QStringList& protocols() const Q_DECL_OVERRIDE
+    {
+        static QStringList p = QStringList() << QStringLiteral("memory");
+        return p;
+    }
+    void setData(const QByteArray& value);
+    QByteArray data() const;
+    bool isSeekable() const Q_DECL_OVERRIDE { return true;}
+    bool isWritable() const Q_DECL_OVERRIDE { return false;}
+    qint64 read(char *data, qint64 maxSize) Q_DECL_OVERRIDE;
+    qint64 write(const char*, qint64) Q_DECL_OVERRIDE { return 0;}
+    bool seek(qint64 offset, int from) Q_DECL_OVERRIDE;
+    qint64 position() const Q_DECL_OVERRIDE;
+    qint64 size() const Q_DECL_OVERRIDE;
+Q_SIGNALS:
+    void dataChanged();
+protected:
+    void onUrlChanged() Q_DECL_OVERRIDE;
+};
+
+static const MediaIOId MediaIOId_Memory = mkid::id32base36_3<'M','e','m'>::value;
+FACTORY_REGISTER_ID_TYPE(MediaIO, MediaIOId_Memory, MemoryIO, kMemoryName)
+
+class MemoryIOPrivate Q_DECL_FINAL: public MediaIOPrivate
+{
+public:
+    MemoryIOPrivate()
+        : MediaIOPrivate()
+        , pos(0)
+    {}
+    QByteArray data;
+    qint64 pos;
+};
+
+MemoryIO::MemoryIO()
+    : MediaIO(*new MemoryIOPrivate())
+{
+    // demuxer reads larger than the avio buffer (packets, except tiny ones) are copied to the demuxer's memory directly.
+    // the buffer is only for probing and headers
+    setBufferSize(4096);
+    setDirectRead(true);
+}
+
+void MemoryIO::setData(const QByteArray &value)
+{
+    DPTR_D(MemoryIO);
+    // QByteArray::fromRawData() can not be compared by value cheaply
+    if (d.data.constData() == value.constData() && d.data.size() == value.size())
+        return;
+    d.data = value;
+    d.pos = 0;
+    Q_EMIT dataChanged();
+}
+
+QByteArray MemoryIO::data() const
+{
+    return d_func().data;
+}
+
+qint64 MemoryIO::read(char *data, qint64 maxSize)
+{
+    DPTR_D(MemoryIO);
+    const qint64 n = qMax<qint64>(0, qMin(maxSize, d.data.size() - d.pos));
+    if (n <= 0)
+        return 0;
+    memcpy(data, d.data.constData() + d.pos, n);
+    d.pos += n;
+    return n;
+}
+
+bool MemoryIO::seek(qint64 offset, int from)
+{
+    DPTR_D(MemoryIO);
+    // the same as QIODeviceIO
+    if (from == 2) {
+        offset = d.data.size() - offset;
+    } else if (from == 1) {
+        offset = d.pos + offset;
+    }
+    if (offset < 0 || offset > d.data.size())
+        return false;
+    d.pos = offset;
+    return true;
+}
+
+qint64 MemoryIO::position() const
+{
+    return d_func().pos;
+}
+
+qint64 MemoryIO::size() const
+{
+    return d_func().data.size();
+}
+
+void MemoryIO::onUrlChanged()
+{
+    QString path(url());
+    if (path.startsWith(QLatin1String("memory:")))
+        path = path.mid(7);
+    if (path.isEmpty())
+        return;
+    if (path.startsWith(QLatin1String("qrc:")))
+        path = path.mid(3); // keep ':'
+    if (!path.startsWith(QLatin1Char(':')))
+        path.prepend(QLatin1Char(':'));
+    QResource res(path);
+    if (!res.isValid()) {
+        qWarning() << "Invalid resource [" << path << "]";
+        setData(QByteArray());
+        return;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    if (res.compressionAlgorithm() == QResource::NoCompression) {
+#else
+    if (!res.isCompressed()) {
+#endif
+        // resource data is valid while the resource is registered
+        setData(QByteArray::fromRawData((const char*)res.data(), res.size()));
+        return;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    setData(res.uncompressedData());
+#else
+    setData(qUncompress(res.data(), res.size()));
+#endif
+}
+
+} //namespace QtAV
+#include "MemoryIO.moc"
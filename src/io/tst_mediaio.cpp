@@ -1,4 +1,5 @@
 #include <QtAV/MediaIO.h>
+#include <QtCore/QTemporaryFile>
 #include <QtDebug>
 #include <QtTest/QTest>
 using namespace QtAV;
@@ -9,6 +10,7 @@ private slots:
     void create();
     void createForProtocol();
     void read();
+    void readMMap();
 };
 
 void tst_MediaIO::create() {
@@ -49,5 +51,30 @@ void tst_MediaIO::read() {
     delete in;
 }
 
+void tst_MediaIO::readMMap() {
+    QTemporaryFile f;
+    QVERIFY(f.open());
+    QByteArray data(100*1024+1, 0);
+    for (int i = 0; i < data.size(); ++i)
+        data[i] = char(i%251);
+    f.write(data);
+    f.flush();
+    MediaIO *in = MediaIO::createForUrl("mmap:" + f.fileName());
+    QVERIFY(in);
+    QCOMPARE(in->name(), QString("MMap"));
+    QVERIFY(in->isSeekable());
+    QCOMPARE(in->size(), qint64(data.size()));
+    QByteArray data2(data.size(), 0);
+    QCOMPARE(in->read(data2.data(), 1024), qint64(1024));
+    QCOMPARE(in->read(data2.data() + 1024, data2.size()), qint64(data.size() - 1024));
+    QCOMPARE(data, data2);
+    QCOMPARE(in->read(data2.data(), 1), qint64(0));
+    QVERIFY(in->seek(10, 0));
+    QCOMPARE(in->position(), qint64(10));
+    QCOMPARE(in->read(data2.data(), 1), qint64(1));
+    QCOMPARE(data2.at(0), data.at(10));
+    delete in;
+}
+
 QTEST_MAIN(tst_MediaIO)
 #include "tst_avinput.moc"
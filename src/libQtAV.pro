@@ -29,6 +29,8 @@ config_libcedarv: CONFIG *= neon config_simd #need by qt4 addSimdCompiler(). neo
 ## sse2 sse4_1 may be defined in Qt5 qmodule.pri but is not included. Qt4 defines sse and sse2
 sse4_1|config_sse4_1|contains(TARGET_ARCH_SUB, sse4.1): CONFIG *= sse4_1 config_simd
 sse2|config_sse2|contains(TARGET_ARCH_SUB, sse2): CONFIG *= sse2 config_simd
+avx2|config_avx2|contains(TARGET_ARCH_SUB, avx2): CONFIG *= avx2 config_simd
+contains(TARGET_ARCH_SUB, neon): CONFIG *= neon config_simd
 
 #release: DEFINES += QT_NO_DEBUG_OUTPUT
 #var with '_' can not pass to pri?
@@ -83,7 +85,26 @@ sse4_1 {
 sse2 {
   DEFINES += QTAV_HAVE_SSE2=1
   !config_simd: CONFIG *= simd
-  SSE2_SOURCES += utils/CopyFrame_SSE2.cpp
+  SSE2_SOURCES += utils/CopyFrame_SSE2.cpp \
+                  utils/ImageConvert_SSE2.cpp \
+                  utils/AudioVolume_SSE2.cpp \
+                  utils/BlendASS_SSE2.cpp \
+                  utils/AudioTimeStretch_SSE2.cpp
+}
+## built with avx2 flags but used only if cpu supports it
+avx2 {
+  DEFINES += QTAV_HAVE_AVX2=1
+  !config_simd: CONFIG *= simd
+  AVX2_SOURCES += utils/CopyFrame_AVX2.cpp \
+                  utils/AudioVolume_AVX2.cpp \
+                  utils/AudioTimeStretch_AVX2.cpp
+}
+neon {
+  DEFINES += QTAV_HAVE_NEON=1
+  !config_simd: CONFIG *= simd
+  NEON_SOURCES += utils/CopyFrame_NEON.cpp \
+                  utils/AudioVolume_NEON.cpp \
+                  utils/AudioTimeStretch_NEON.cpp
 }
 
 *msvc* {
@@ -93,9 +114,11 @@ sse2 {
     QMAKE_LFLAGS *= /NODEFAULTLIB:libcmt.lib /NODEFAULTLIB:libcmtd.lib #for msbuild vs2013
     INCLUDEPATH += compat/msvc
 }
+# lock free single producer single consumer packet queue between demux thread and AVThread
+!no_spsc_queue: DEFINES += QTAV_HAVE_SPSC_QUEUE=1
 #UINT64_C: C99 math features, need -D__STDC_CONSTANT_MACROS in CXXFLAGS
 DEFINES += __STDC_CONSTANT_MACROS
-android: CONFIG += config_opensl
+android: CONFIG += config_opensl config_aaudio
 
 config_swresample {
     DEFINES += QTAV_HAVE_SWRESAMPLE=1
@@ -180,6 +203,10 @@ config_openal {
       static_openal:!android: LIBS += -lasound
     }
 }
+config_aaudio { # libaaudio.so is loaded at runtime
+    SOURCES += output/audio/AudioOutputAAudio.cpp
+    DEFINES *= QTAV_HAVE_AAUDIO=1
+}
 config_opensl {
     SOURCES += output/audio/AudioOutputOpenSL.cpp
     DEFINES *= QTAV_HAVE_OPENSL=1
@@ -226,6 +253,14 @@ config_dxva {
   }
     LIBS += -lole32
 }
+config_d3d11va {
+    DEFINES *= QTAV_HAVE_D3D11VA=1
+    SOURCES += codec/video/VideoDecoderD3D11.cpp
+  contains(QT_CONFIG, opengl) {
+    HEADERS += codec/video/SurfaceInteropD3D11.h
+    SOURCES += codec/video/SurfaceInteropD3D11.cpp
+  }
+}
 config_vaapi* {
     DEFINES *= QTAV_HAVE_VAAPI=1
     SOURCES += codec/video/VideoDecoderVAAPI.cpp  vaapi/vaapi_helper.cpp
@@ -234,6 +269,10 @@ config_vaapi* {
     HEADERS += vaapi/SurfaceInteropVAAPI.h
     SOURCES += vaapi/SurfaceInteropVAAPI.cpp
   #}
+  contains(QT_CONFIG, egl)|contains(QT_CONFIG, opengles2) { # dma-buf + EGLImage interop
+    DEFINES *= QTAV_HAVE_VAAPI_EGL=1
+    LIBS += -lEGL
+  }
     LIBS += -lva #dynamic load va-glx va-x11 using dllapi
 }
 config_libcedarv {
@@ -244,6 +283,7 @@ config_libcedarv {
     !config_simd: CONFIG *= simd #addSimdCompiler xxx_ASM
     CONFIG += no_clang_integrated_as #see qtbase/src/gui/painting/painting.pri. add -fno-integrated-as from simd.prf
     NEON_ASM += codec/video/tiled_yuv.S #from libvdpau-sunxi
+    NEON_SOURCES += utils/TiledYUV_NEON.cpp
     LIBS += -lvecore -lcedarv
     OTHER_FILES += $$NEON_ASM
 }
@@ -264,25 +304,60 @@ config_videotoolbox {
 config_gl|config_opengl {
   OTHER_FILES += shaders/planar.f.glsl shaders/rgb.f.glsl
   SDK_HEADERS *= \
+    QtAV/GLSLFilter.h \
     QtAV/OpenGLRendererBase.h \
     QtAV/OpenGLVideo.h \
-    QtAV/VideoShader.h
+    QtAV/VideoShader.h \
+    QtAV/ColorLUT.h
   SDK_PRIVATE_HEADERS = \
-    QtAV/private/OpenGLRendererBase_p.h
+    QtAV/private/OpenGLRendererBase_p.h \
+    QtAV/private/FrameTimingOverlay.h
   HEADERS *= \
     utils/OpenGLHelper.h \
     ShaderManager.h
   SOURCES *= \
     output/video/OpenGLRendererBase.cpp \
+    output/video/FrameTimingOverlay.cpp \
+    GLSLFilter.cpp \
     OpenGLVideo.cpp \
     VideoShader.cpp \
+    ColorLUT.cpp \
     ShaderManager.cpp \
     utils/OpenGLHelper.cpp
 }
+config_opengl {
+  DEFINES *= QTAV_HAVE_GLCONVERTER=1
+  HEADERS *= GLFrameConverter.h
+  SOURCES *= GLFrameConverter.cpp
+}
 config_openglwindow {
   SDK_HEADERS *= QtAV/OpenGLWindowRenderer.h
   SOURCES *= output/video/OpenGLWindowRenderer.cpp
 }
+# opt-in: CONFIG+=config_vulkan. shaders are compiled to spir-v headers by glslangValidator
+config_vulkan:versionAtLeast(QT_VERSION, 5.15.0):qtConfig(vulkan) {
+  DEFINES *= QTAV_HAVE_VULKAN=1
+  SDK_HEADERS *= QtAV/VulkanWindowRenderer.h
+  HEADERS *= vulkan/VulkanVideoMaterial.h
+  SOURCES *= \
+    output/video/VulkanWindowRenderer.cpp \
+    vulkan/VulkanVideoMaterial.cpp
+  VULKAN_SHADERS = shaders/vulkan/video_v.vert shaders/vulkan/video_f.frag
+  OTHER_FILES += $$VULKAN_SHADERS
+  spirv.input = VULKAN_SHADERS
+  spirv.output = ${QMAKE_FILE_BASE}.spv.h
+  spirv.commands = glslangValidator -V --vn ${QMAKE_FILE_BASE}_spv ${QMAKE_FILE_IN} -o ${QMAKE_FILE_OUT}
+  spirv.CONFIG += no_link target_predeps
+  QMAKE_EXTRA_COMPILERS += spirv
+  INCLUDEPATH += $$OUT_PWD
+}
+# synchronize clocks of players on different hosts
+!no_network {
+  QT *= network
+  DEFINES *= QTAV_HAVE_NETWORK=1 QTAV_HAVE_NETWORK_CLOCK=1
+  SDK_HEADERS *= QtAV/NetworkClock.h
+  SOURCES *= NetworkClock.cpp
+}
 config_libass {
 #link against libass instead of dynamic load
   !capi|android|ios|winrt|config_libass_link {
@@ -330,10 +405,22 @@ SOURCES += \
     subtitle/SubtitleProcessor.cpp \
     subtitle/SubtitleProcessorFFmpeg.cpp \
     utils/GPUMemCopy.cpp \
+    utils/ImageConvert.cpp \
     utils/Logger.cpp \
     AudioThread.cpp \
+    SPDIFMuxer.cpp \
     utils/internal.cpp \
+    utils/StreamInfoCache.cpp \
+    utils/CapabilityCache.cpp \
+    utils/FrameBufferPool.cpp \
+    utils/AudioTimeStretch.cpp \
+    utils/DecodeThreadScheduler.cpp \
+    utils/DevicePlacement.cpp \
+    utils/ThreadPolicy.cpp \
+    utils/TimeshiftBuffer.cpp \
+    utils/BitstreamFilter.cpp \
     AVThread.cpp \
+    KeyFrameIndexer.cpp \
     AudioFormat.cpp \
     AudioFrame.cpp \
     AudioResampler.cpp \
@@ -348,6 +435,7 @@ SOURCES += \
     AVMuxer.cpp \
     AVDemuxer.cpp \
     AVDemuxThread.cpp \
+    PacketRecorder.cpp \
     ColorTransform.cpp \
     Frame.cpp \
     filter/Filter.cpp \
@@ -356,6 +444,7 @@ SOURCES += \
     filter/LibAVFilter.cpp \
     filter/SubtitleFilter.cpp \
     filter/EncodeFilter.cpp \
+    filter/FrameTapFilter.cpp \
     ImageConverter.cpp \
     ImageConverterFF.cpp \
     Packet.cpp \
@@ -364,15 +453,24 @@ SOURCES += \
     AVPlayer.cpp \
     AVPlayerPrivate.cpp \
     AVTranscoder.cpp \
+    SegmentedTranscoder.cpp \
     AVClock.cpp \
     VideoCapture.cpp \
     VideoFormat.cpp \
     VideoFrame.cpp \
+    FrameDropPolicy.cpp \
     io/MediaIO.cpp \
+    io/MediaIOReadAhead.cpp \
+    io/MediaIOWriteBehind.cpp \
+    io/HTTPRangeIO.cpp \
+    io/HLSIO.cpp \
+    io/MMapIO.cpp \
+    io/MemoryIO.cpp \
     io/QIODeviceIO.cpp \
     output/audio/AudioOutput.cpp \
     output/audio/AudioOutputBackend.cpp \
     output/audio/AudioOutputNull.cpp \
+    output/audio/AudioMixer.cpp \
     output/video/VideoRenderer.cpp \
     output/video/VideoRendererTypes.cpp \
     output/video/VideoOutput.cpp \
@@ -380,6 +478,9 @@ SOURCES += \
     output/AVOutput.cpp \
     output/OutputSet.cpp \
     Statistics.cpp \
+    TraceRecorder.cpp \
+    MetricsExporter.cpp \
+    VideoWallManager.cpp \
     codec/video/VideoDecoder.cpp \
     codec/video/VideoDecoderTypes.cpp \
     codec/video/VideoDecoderFFmpegBase.cpp \
@@ -403,6 +504,7 @@ SDK_HEADERS *= \
     QtAV/AudioFormat.h \
     QtAV/AudioFrame.h \
     QtAV/AudioOutput.h \
+    QtAV/AudioMixer.h \
     QtAV/AVDecoder.h \
     QtAV/AVEncoder.h \
     QtAV/AVDemuxer.h \
@@ -412,12 +514,14 @@ SDK_HEADERS *= \
     QtAV/FilterContext.h \
     QtAV/LibAVFilter.h \
     QtAV/EncodeFilter.h \
+    QtAV/FrameTapFilter.h \
     QtAV/Frame.h \
     QtAV/QPainterRenderer.h \
     QtAV/Packet.h \
     QtAV/AVError.h \
     QtAV/AVPlayer.h \
     QtAV/AVTranscoder.h \
+    QtAV/SegmentedTranscoder.h \
     QtAV/VideoCapture.h \
     QtAV/VideoRenderer.h \
     QtAV/VideoRendererTypes.h \
@@ -430,9 +534,14 @@ SDK_HEADERS *= \
     QtAV/VideoEncoder.h \
     QtAV/VideoFormat.h \
     QtAV/VideoFrame.h \
+    QtAV/VideoFrameAllocator.h \
+    QtAV/FrameDropPolicy.h \
     QtAV/VideoFrameExtractor.h \
     QtAV/FactoryDefine.h \
     QtAV/Statistics.h \
+    QtAV/TraceRecorder.h \
+    QtAV/MetricsExporter.h \
+    QtAV/VideoWallManager.h \
     QtAV/Subtitle.h \
     QtAV/SubtitleFilter.h \
     QtAV/SurfaceInterop.h \
@@ -465,9 +574,12 @@ HEADERS *= \
     $$SDK_PRIVATE_HEADERS \
     AVPlayerPrivate.h \
     AVDemuxThread.h \
+    PacketRecorder.h \
+    KeyFrameIndexer.h \
     AVThread.h \
     AVThread_p.h \
     AudioThread.h \
+    SPDIFMuxer.h \
     PacketBuffer.h \
     VideoThread.h \
     ImageConverter.h \
@@ -476,10 +588,23 @@ HEADERS *= \
     codec/video/VideoDecoderFFmpegHW.h \
     codec/video/VideoDecoderFFmpegHW_p.h \
     filter/FilterManager.h \
+    io/MediaIOReadAhead.h \
+    io/MediaIOWriteBehind.h \
     subtitle/CharsetDetector.h \
     subtitle/PlainText.h \
     utils/BlockingQueue.h \
+    utils/SPSCQueue.h \
+    utils/StreamInfoCache.h \
+    utils/CapabilityCache.h \
+    utils/FrameBufferPool.h \
+    utils/AudioTimeStretch.h \
+    utils/DecodeThreadScheduler.h \
+    utils/DevicePlacement.h \
+    utils/ThreadPolicy.h \
+    utils/TimeshiftBuffer.h \
+    utils/BitstreamFilter.h \
     utils/GPUMemCopy.h \
+    utils/ImageConvert.h \
     utils/Logger.h \
     utils/SharedPtr.h \
     utils/ring.h \
@@ -20,24 +20,109 @@
 ******************************************************************************/
 
 #include "output/OutputSet.h"
+#include <QtCore/QRunnable>
 #include "QtAV/AVPlayer.h"
 #include "QtAV/VideoRenderer.h"
 
 namespace QtAV {
 
+class OutputMailbox
+{
+public:
+    OutputMailbox(AVOutput* o) : output(o), pending(false), scheduled(false), removed(false) {}
+    // call receive() if the output is not removed. an in progress delivery blocks remove()
+    void deliver(const VideoFrame& f) {
+        QMutexLocker lock(&deliver_mutex);
+        Q_UNUSED(lock);
+        if (removed || !output->isAvailable())
+            return;
+        VideoRenderer *vo = static_cast<VideoRenderer*>(output);
+        // frames from the source of a follower set are not converted for the renderer
+        if (f.isValid() && !vo->isSupported(f.pixelFormat())) {
+            vo->receive(f.to(vo->preferredPixelFormat()));
+            return;
+        }
+        vo->receive(f);
+    }
+    // replace the pending frame. return true if a drain task must be started
+    bool post(const VideoFrame& f) {
+        QMutexLocker lock(&frame_mutex);
+        Q_UNUSED(lock);
+        frame = f;
+        pending = true;
+        if (scheduled)
+            return false;
+        scheduled = true;
+        return true;
+    }
+    bool take(VideoFrame* f) {
+        QMutexLocker lock(&frame_mutex);
+        Q_UNUSED(lock);
+        if (!pending) {
+            scheduled = false;
+            return false;
+        }
+        *f = frame;
+        frame = VideoFrame();
+        pending = false;
+        return true;
+    }
+    // wait for the delivery in progress. no receive() call on output after return
+    void remove() {
+        QMutexLocker lock(&deliver_mutex);
+        Q_UNUSED(lock);
+        removed = true;
+    }
+
+    AVOutput *output;
+private:
+    QMutex frame_mutex;
+    VideoFrame frame;
+    bool pending;
+    bool scheduled;
+    QMutex deliver_mutex;
+    bool removed;
+};
+
+class MailboxDrainer : public QRunnable
+{
+public:
+    MailboxDrainer(const QSharedPointer<OutputMailbox>& box) : m_box(box) {}
+    virtual void run() {
+        VideoFrame frame;
+        while (m_box->take(&frame)) {
+            m_box->deliver(frame);
+        }
+    }
+private:
+    QSharedPointer<OutputMailbox> m_box;
+};
+
 OutputSet::OutputSet(AVPlayer *player):
     QObject(player)
   , mCanPauseThread(false)
   , mpPlayer(player)
   , mPauseCount(0)
+  , mSource(0)
 {
 }
 
 OutputSet::~OutputSet()
 {
+    if (mSource)
+        mSource->removeFollower(this);
+    {
+        QMutexLocker lock(&mFollowerMutex);
+        Q_UNUSED(lock);
+        foreach (OutputSet *set, mFollowers) {
+            set->mSource = 0;
+        }
+        mFollowers.clear();
+    }
     mCond.wakeAll();
     //delete? may be deleted by vo's parent
     clearOutputs();
+    mPool.waitForDone();
 }
 
 void OutputSet::lock()
@@ -52,46 +137,127 @@ void OutputSet::unlock()
 
 QList<AVOutput *> OutputSet::outputs()
 {
+    QMutexLocker lock(&mListMutex);
+    Q_UNUSED(lock);
     return mOutputs;
 }
 
 void OutputSet::sendVideoFrame(const VideoFrame &frame)
 {
-    if (mOutputs.isEmpty())
+    {
+        QMutexLocker lock(&mFollowerMutex);
+        Q_UNUSED(lock);
+        foreach (OutputSet *set, mFollowers) {
+            set->postVideoFrame(frame);
+        }
+    }
+    QList<QSharedPointer<OutputMailbox> > boxes;
+    {
+        QMutexLocker lock(&mListMutex);
+        Q_UNUSED(lock);
+        boxes = mMailboxes; // readers never block writers for long
+    }
+    if (boxes.isEmpty())
+        return;
+    if (boxes.size() == 1) {
+        boxes.first()->deliver(frame);
         return;
-    foreach(AVOutput *output, mOutputs) {
-        if (!output->isAvailable())
-            continue;
-        ((VideoRenderer*)output)->receive(frame);
+    }
+    foreach (const QSharedPointer<OutputMailbox>& box, boxes) {
+        if (box->post(frame))
+            mPool.start(new MailboxDrainer(box));
     }
 }
 
-void OutputSet::clearOutputs()
+void OutputSet::postVideoFrame(const VideoFrame &frame)
 {
-    QMutexLocker lock(&mMutex);
+    QList<QSharedPointer<OutputMailbox> > boxes;
+    {
+        QMutexLocker lock(&mListMutex);
+        Q_UNUSED(lock);
+        boxes = mMailboxes;
+    }
+    foreach (const QSharedPointer<OutputMailbox>& box, boxes) {
+        if (box->post(frame))
+            mPool.start(new MailboxDrainer(box));
+    }
+}
+
+void OutputSet::addFollower(OutputSet *set)
+{
+    if (!set || set == this || set->mSource == this)
+        return;
+    if (set->mSource)
+        set->mSource->removeFollower(set);
+    QMutexLocker lock(&mFollowerMutex);
     Q_UNUSED(lock);
-    if (mOutputs.isEmpty())
+    mFollowers.append(set);
+    set->mSource = this;
+}
+
+void OutputSet::removeFollower(OutputSet *set)
+{
+    QMutexLocker lock(&mFollowerMutex);
+    Q_UNUSED(lock);
+    if (!mFollowers.removeAll(set))
         return;
-    foreach(AVOutput *output, mOutputs) {
-        output->removeOutputSet(this);
+    set->mSource = 0;
+}
+
+void OutputSet::clearOutputs()
+{
+    QList<QSharedPointer<OutputMailbox> > boxes;
+    {
+        QMutexLocker lock(&mMutex);
+        Q_UNUSED(lock);
+        QMutexLocker list_lock(&mListMutex);
+        Q_UNUSED(list_lock);
+        if (mOutputs.isEmpty())
+            return;
+        foreach(AVOutput *output, mOutputs) {
+            output->removeOutputSet(this);
+        }
+        mOutputs.clear();
+        boxes = mMailboxes;
+        mMailboxes.clear();
+    }
+    foreach (const QSharedPointer<OutputMailbox>& box, boxes) {
+        box->remove();
     }
-    mOutputs.clear();
 }
 
 void OutputSet::addOutput(AVOutput *output)
 {
     QMutexLocker lock(&mMutex);
     Q_UNUSED(lock);
+    QMutexLocker list_lock(&mListMutex);
+    Q_UNUSED(list_lock);
     mOutputs.append(output);
+    mMailboxes.append(QSharedPointer<OutputMailbox>(new OutputMailbox(output)));
+    // 1 drain task for each output at most
+    mPool.setMaxThreadCount(qMax(2, mOutputs.size()));
     output->addOutputSet(this);
 }
 
 void OutputSet::removeOutput(AVOutput *output)
 {
-    QMutexLocker lock(&mMutex);
-    Q_UNUSED(lock);
-    mOutputs.removeAll(output);
-    output->removeOutputSet(this);
+    QList<QSharedPointer<OutputMailbox> > removed;
+    {
+        QMutexLocker lock(&mMutex);
+        Q_UNUSED(lock);
+        QMutexLocker list_lock(&mListMutex);
+        Q_UNUSED(list_lock);
+        int i = -1;
+        while ((i = mOutputs.indexOf(output)) >= 0) {
+            mOutputs.removeAt(i);
+            removed.append(mMailboxes.takeAt(i));
+        }
+        output->removeOutputSet(this);
+    }
+    // the output can be destroyed after return
+    foreach (const QSharedPointer<OutputMailbox>& box, removed) {
+        box->remove();
+    }
 }
 
 void OutputSet::notifyPauseChange(AVOutput *output)
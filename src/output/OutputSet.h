@@ -24,6 +24,8 @@
 
 #include <QtCore/QObject>
 #include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QThreadPool>
 #include <QtCore/QWaitCondition>
 #include "QtAV/QtAV_Global.h"
 #include "QtAV/AVOutput.h"
@@ -32,6 +34,7 @@ namespace QtAV {
 
 class AVPlayer;
 class VideoFrame;
+class OutputMailbox;
 class OutputSet : public QObject
 {
     Q_OBJECT
@@ -39,21 +42,34 @@ public:
     OutputSet(AVPlayer *player);
     virtual ~OutputSet();
 
-    //required when accessing renderers
+    //required when accessing renderers. do not call sendVideoFrame() with the lock
     void lock();
     void unlock();
 
-    //implicity shared
-    //QList<AVOutput*> outputs();
+    // a snapshot of current outputs. implicitly shared (copy on write), so it's safe to iterate without lock
     QList<AVOutput*> outputs();
 
     //each(OutputOperation(data))
     //
     void sendData(const QByteArray& data);
+    /*!
+     * \brief sendVideoFrame
+     * Delivered to the only output directly. If there are more outputs, the frame is put into the latest frame mailbox of
+     * each output, and the mailboxes are drained by a thread pool, so a slow output drops frames instead of blocking the
+     * caller and other outputs. The lock is not held while delivering.
+     */
     void sendVideoFrame(const VideoFrame& frame);
 
     void clearOutputs();
     void addOutput(AVOutput* output);
+    /*!
+     * \brief addFollower
+     * Frames sent to this set are posted to the latest frame mailboxes of outputs in set too, e.g. outputs of another player
+     * showing the same source. Posting never blocks, so a slow follower drops frames. Links are removed when either set
+     * is destroyed. Call in the thread of the sets
+     */
+    void addFollower(OutputSet* set);
+    void removeFollower(OutputSet* set);
 
     void notifyPauseChange(AVOutput *output);
     bool canPauseThread() const;
@@ -71,10 +87,19 @@ public slots:
     void removeOutput(AVOutput *output);
 
 private:
+    // put the frame into the mailbox of each output and drain them in mPool, even if there is only 1 output
+    void postVideoFrame(const VideoFrame& frame);
+
     volatile bool mCanPauseThread;
     AVPlayer *mpPlayer;
     int mPauseCount; //pause AVThread if equals to mOutputs.size()
     QList<AVOutput*> mOutputs;
+    QList<QSharedPointer<OutputMailbox> > mMailboxes; // the same order as mOutputs
+    QThreadPool mPool; // drains mailboxes
+    QMutex mListMutex; // guards mOutputs and mMailboxes only, never held while delivering
+    QList<OutputSet*> mFollowers;
+    OutputSet *mSource; // this set is a follower of
+    QMutex mFollowerMutex; // guards mFollowers, held while posting to followers
     QMutex mMutex;
     QWaitCondition mCond; //pause
 };
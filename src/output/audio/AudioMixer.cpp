@@ -0,0 +1,420 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/AudioMixer.h"
+#include "QtAV/AudioOutput.h"
+#include "QtAV/AudioResampler.h"
+#include "QtAV/AudioResamplerTypes.h"
+#include "QtAV/private/AudioOutputBackend.h"
+#include "QtAV/private/mkid.h"
+#include "QtAV/private/prepost.h"
+#include <QtCore/QMutex>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QThread>
+#include <string.h>
+#include "utils/SPSCQueue.h"
+#include "utils/Logger.h"
+
+int MixSamplesFloat_SSE2(float* dst, const float* src, int nb_samples, float volume);
+int MixSamplesFloat_AVX2(float* dst, const float* src, int nb_samples, float volume);
+int MixSamplesFloat_NEON(float* dst, const float* src, int nb_samples, float volume);
+
+namespace QtAV {
+bool detect_sse2(); // GPUMemCopy.cpp
+bool detect_avx2();
+bool detect_neon();
+
+// dst += src*volume. simd kernels process a multiple of 8 samples
+static void mix_samples_float(float* dst, const float* src, int nb_samples, float volume)
+{
+    int n = 0;
+#if QTAV_HAVE(AVX2)
+    if (detect_avx2())
+        n = MixSamplesFloat_AVX2(dst, src, nb_samples, volume);
+    else
+#endif
+#if QTAV_HAVE(SSE2)
+    if (detect_sse2())
+        n = MixSamplesFloat_SSE2(dst, src, nb_samples, volume);
+    else
+#endif
+#if QTAV_HAVE(NEON)
+    if (detect_neon())
+        n = MixSamplesFloat_NEON(dst, src, nb_samples, volume);
+    else
+#endif
+    {}
+    for (int i = n; i < nb_samples; ++i)
+        dst[i] += src[i]*volume;
+}
+
+static const char kName[] = "Mixer";
+/*!
+ * A source of AudioMixer. Data written by AudioOutput is pulled by the mixer thread.
+ */
+class AudioOutputMixer Q_DECL_FINAL: public AudioOutputBackend
+{
+public:
+    AudioOutputMixer(QObject *parent = 0);
+    ~AudioOutputMixer();
+    QString name() const Q_DECL_FINAL { return QString::fromLatin1(kName);}
+    bool isSupported(AudioFormat::SampleFormat sampleFormat) const Q_DECL_FINAL;
+    bool isSupported(AudioFormat::ChannelLayout channelLayout) const Q_DECL_FINAL;
+    AudioFormat::SampleFormat preferredSampleFormat() const Q_DECL_FINAL { return AudioFormat::SampleFormat_Float;}
+    AudioFormat::ChannelLayout preferredChannelLayout() const Q_DECL_FINAL;
+    bool open() Q_DECL_FINAL;
+    bool close() Q_DECL_FINAL;
+    BufferControl bufferControl() const Q_DECL_FINAL { return Pull;}
+    bool write(const QByteArray&) Q_DECL_FINAL { return true;} // data is pulled by the mixer
+    bool play() Q_DECL_FINAL { return true;}
+    qreal getLatency() Q_DECL_FINAL;
+    bool setVolume(qreal value) Q_DECL_FINAL;
+    qreal getVolume() const Q_DECL_FINAL { return gain;}
+    bool setMute(bool value = true) Q_DECL_FINAL;
+    bool getMute() const Q_DECL_FINAL { return mute;}
+    /*!
+     * Called by the mixer thread with the mixer locked. Add frames of data in mixer format fmt to dst.
+     */
+    void mixTo(float* dst, int frames, const AudioFormat& fmt);
+
+    bool opened;
+    float gain;
+    bool mute;
+private:
+    QScopedPointer<AudioResampler> resampler; // if sample rate is not the mixer's
+    QByteArray in; // pulled data in source format
+    QByteArray resampled; // in mixer format
+    int resampled_pos;
+};
+
+typedef AudioOutputMixer AudioOutputBackendMixer;
+static const AudioOutputBackendId AudioOutputBackendId_Mixer = mkid::id32base36_5<'M', 'i', 'x', 'e', 'r'>::value;
+FACTORY_REGISTER_ID_AUTO(AudioOutputBackend, Mixer, kName)
+
+void RegisterAudioOutputMixer_Man()
+{
+    FACTORY_REGISTER_ID_MAN(AudioOutputBackend, Mixer, kName)
+}
+
+class AudioMixerThread : public QThread
+{
+public:
+    AudioMixerThread(AudioMixerPrivate* mixer) : d(mixer) {}
+protected:
+    void run() Q_DECL_OVERRIDE;
+private:
+    AudioMixerPrivate *d;
+};
+
+class AudioMixerPrivate : public DPtrPrivate<AudioMixer>
+{
+public:
+    AudioMixerPrivate()
+        : ao(0)
+        , thread(this)
+        , stop(0)
+    {
+        format.setSampleFormat(AudioFormat::SampleFormat_Float);
+        format.setChannelLayout(AudioFormat::ChannelLayout_Stero);
+        format.setSampleRate(48000);
+    }
+    ~AudioMixerPrivate() {
+        stopThread();
+        if (ao) {
+            delete ao;
+            ao = 0;
+        }
+    }
+    AudioOutput* output() {
+        if (!ao)
+            ao = new AudioOutput();
+        return ao;
+    }
+    bool addSource(AudioOutputMixer* s);
+    void removeSource(AudioOutputMixer* s);
+    void stopThread() {
+        if (!thread.isRunning())
+            return;
+        stop.fetchAndStoreOrdered(1);
+        thread.wait();
+    }
+    /// mix and play a period. return the period in ms if not played
+    int mix(QByteArray& out, qreal& pts);
+
+    QMutex open_mutex; // serialize adding and removing sources
+    QMutex mutex; // sources, volumes and resamplers
+    AudioFormat format;
+    AudioOutput *ao;
+    QList<AudioOutputMixer*> sources;
+    AudioMixerThread thread;
+    QAtomicInt stop;
+};
+
+void AudioMixerThread::run()
+{
+    QByteArray out;
+    qreal pts = 0;
+    while (!spsc::loadAcquire(d->stop)) {
+        const int ms = d->mix(out, pts);
+        if (ms > 0)
+            msleep(ms);
+    }
+}
+
+bool AudioMixerPrivate::addSource(AudioOutputMixer *s)
+{
+    QMutexLocker open_lock(&open_mutex);
+    Q_UNUSED(open_lock);
+    if (sources.isEmpty()) {
+        output()->close();
+        ao->setAudioFormat(format);
+        if (!ao->open()) {
+            qWarning("AudioMixer: failed to open audio output %s", qPrintable(ao->backend()));
+            return false;
+        }
+        qDebug() << "AudioMixer format: " << ao->audioFormat();
+    }
+    {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        sources.append(s);
+    }
+    if (!thread.isRunning()) {
+        stop.fetchAndStoreOrdered(0);
+        thread.start(QThread::HighPriority);
+    }
+    return true;
+}
+
+void AudioMixerPrivate::removeSource(AudioOutputMixer *s)
+{
+    QMutexLocker open_lock(&open_mutex);
+    Q_UNUSED(open_lock);
+    {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        if (!sources.removeOne(s) || !sources.isEmpty())
+            return;
+    }
+    stopThread();
+    ao->close();
+}
+
+int AudioMixerPrivate::mix(QByteArray &out, qreal &pts)
+{
+    const AudioFormat &fmt = ao->audioFormat();
+    const int bpf = qMax(fmt.bytesPerFrame(), 1);
+    const qreal rate = qMax(fmt.sampleRate(), 1);
+    const int frames = qMax(ao->bufferSize()/bpf, 1);
+    // ao may still reference the last period
+    if (!out.isDetached() || out.size() != frames*bpf)
+        out = QByteArray(frames*bpf, 0);
+    else
+        memset(out.data(), 0, out.size());
+    {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        foreach (AudioOutputMixer *s, sources) {
+            s->mixTo((float*)out.data(), frames, fmt);
+        }
+    }
+    pts += (qreal)frames/rate;
+    // blocks until the device has space, which paces the sources
+    if (ao->play(out, pts))
+        return 0;
+    return qMax(1, int((qreal)frames*1000.0/rate));
+}
+
+AudioOutputMixer::AudioOutputMixer(QObject *parent)
+    : AudioOutputBackend(AudioOutput::DeviceFeatures()|AudioOutput::SetVolume|AudioOutput::SetMute, parent)
+    , opened(false)
+    , gain(1.0f)
+    , mute(false)
+    , resampled_pos(0)
+{
+}
+
+AudioOutputMixer::~AudioOutputMixer()
+{
+    close();
+}
+
+bool AudioOutputMixer::isSupported(AudioFormat::SampleFormat sampleFormat) const
+{
+    return sampleFormat == AudioFormat::SampleFormat_Float;
+}
+
+bool AudioOutputMixer::isSupported(AudioFormat::ChannelLayout channelLayout) const
+{
+    return channelLayout == preferredChannelLayout();
+}
+
+AudioFormat::ChannelLayout AudioOutputMixer::preferredChannelLayout() const
+{
+    return AudioMixer::instance().audioFormat().channelLayout();
+}
+
+bool AudioOutputMixer::open()
+{
+    close();
+    AudioMixerPrivate &d = AudioMixer::instance().d_func();
+    const AudioFormat &mf = d.format;
+    if (format.sampleFormat() != AudioFormat::SampleFormat_Float || format.channels() != mf.channels()) {
+        qWarning() << "AudioMixer: unsupported source format " << format;
+        return false;
+    }
+    resampled.clear();
+    resampled_pos = 0;
+    if (format.sampleRate() != mf.sampleRate()) {
+        AudioResampler *conv = AudioResamplerFactory::create(AudioResamplerId_FF);
+        if (!conv)
+            conv = AudioResamplerFactory::create(AudioResamplerId_Libav);
+        if (!conv) {
+            qWarning("AudioMixer: no audio resampler is available");
+            return false;
+        }
+        resampler.reset(conv);
+        resampler->setInAudioFormat(format);
+        resampler->setOutAudioFormat(mf);
+        if (!resampler->prepare()) {
+            resampler.reset();
+            return false;
+        }
+    }
+    opened = d.addSource(this);
+    if (!opened)
+        resampler.reset();
+    return opened;
+}
+
+bool AudioOutputMixer::close()
+{
+    if (!opened)
+        return true;
+    AudioMixerPrivate &d = AudioMixer::instance().d_func();
+    d.removeSource(this);
+    opened = false;
+    QMutexLocker lock(&d.mutex); // mixTo() is not running now
+    Q_UNUSED(lock);
+    resampler.reset();
+    return true;
+}
+
+qreal AudioOutputMixer::getLatency()
+{
+    AudioOutput *ao = AudioMixer::instance().output();
+    if (!ao->isOpen())
+        return -1;
+    // the mixer thread keeps the device queue full
+    return ao->latency() + (qreal)ao->bufferSizeTotal()/(qreal)qMax(ao->audioFormat().bytesPerSecond(), 1);
+}
+
+bool AudioOutputMixer::setVolume(qreal value)
+{
+    QMutexLocker lock(&AudioMixer::instance().d_func().mutex);
+    Q_UNUSED(lock);
+    gain = value;
+    return true;
+}
+
+bool AudioOutputMixer::setMute(bool value)
+{
+    QMutexLocker lock(&AudioMixer::instance().d_func().mutex);
+    Q_UNUSED(lock);
+    mute = value;
+    return true;
+}
+
+void AudioOutputMixer::mixTo(float *dst, int frames, const AudioFormat &fmt)
+{
+    const int bpf = fmt.bytesPerFrame();
+    const int bytes = frames*bpf;
+    const char *src = 0;
+    if (!resampler) {
+        in.resize(bytes);
+        pullData(in.data(), bytes);
+        src = in.constData();
+    } else {
+        while (resampled.size() - resampled_pos < bytes) {
+            // a little more than required. the rest is used next time
+            const int need = (bytes - (resampled.size() - resampled_pos))/bpf;
+            const int in_frames = int((qint64)need*format.sampleRate()/fmt.sampleRate()) + 1;
+            in.resize(in_frames*format.bytesPerFrame());
+            pullData(in.data(), in.size());
+            const quint8 *planes[] = { (const quint8*)in.constData() };
+            resampler->setInSampesPerChannel(in_frames);
+            if (!resampler->convert(planes))
+                return;
+            if (resampled_pos > 0) {
+                resampled.remove(0, resampled_pos);
+                resampled_pos = 0;
+            }
+            resampled.append(resampler->outData());
+        }
+        src = resampled.constData() + resampled_pos;
+        resampled_pos += bytes;
+    }
+    if (mute || gain <= 0.0f)
+        return;
+    mix_samples_float(dst, (const float*)src, frames*fmt.channels(), gain);
+}
+
+AudioMixer& AudioMixer::instance()
+{
+    static AudioMixer sMixer;
+    return sMixer;
+}
+
+AudioMixer::AudioMixer()
+{
+}
+
+AudioMixer::~AudioMixer()
+{
+}
+
+AudioOutput* AudioMixer::output() const
+{
+    return const_cast<AudioMixerPrivate&>(d_func()).output();
+}
+
+void AudioMixer::setAudioFormat(const AudioFormat &format)
+{
+    DPTR_D(AudioMixer);
+    QMutexLocker lock(&d.open_mutex);
+    Q_UNUSED(lock);
+    d.format = format;
+    d.format.setSampleFormat(AudioFormat::SampleFormat_Float);
+}
+
+AudioFormat AudioMixer::audioFormat() const
+{
+    return d_func().format;
+}
+
+int AudioMixer::sourceCount() const
+{
+    DPTR_D(const AudioMixer);
+    QMutexLocker lock(&const_cast<AudioMixerPrivate&>(d).mutex);
+    Q_UNUSED(lock);
+    return d.sources.size();
+}
+} //namespace QtAV
@@ -30,15 +30,32 @@
 typedef QTime QElapsedTimer;
 #endif
 #include "utils/ring.h"
+#include "utils/SPSCQueue.h"
 #include "utils/Logger.h"
 
 #define AO_USE_TIMER 1
 
+int ScaleSamplesS16_SSE2(short* dst, const short* src, int nb_samples, int volume);
+int ScaleSamplesFloat_SSE2(float* dst, const float* src, int nb_samples, float volume);
+int ScaleSamplesS16_AVX2(short* dst, const short* src, int nb_samples, int volume);
+int ScaleSamplesFloat_AVX2(float* dst, const float* src, int nb_samples, float volume);
+int ScaleSamplesS16_NEON(short* dst, const short* src, int nb_samples, int volume);
+int ScaleSamplesFloat_NEON(float* dst, const float* src, int nb_samples, float volume);
+
 namespace QtAV {
+bool detect_sse2(); // GPUMemCopy.cpp
+bool detect_avx2();
+bool detect_neon();
 
 // chunk
 static const int kBufferSize = 1024*4;
 static const int kBufferCount = 8;
+// low latency profile: 4 chunks of 5ms. backends may enlarge the chunk to the device period
+static const qint64 kLowLatencyChunkUs = 5000LL;
+static const int kLowLatencyBufferCount = 4;
+// power saving profile: 8 chunks of 100ms
+static const qint64 kPowerSavingChunkUs = 100000LL;
+static const int kPowerSavingBufferCount = 8;
 
 typedef void (*scale_samples_func)(quint8 *dst, const quint8 *src, int nb_samples, int volume, float volumef);
 
@@ -90,7 +107,53 @@ static inline void scale_samples(quint8 *dst, const quint8 *src, int nb_samples,
         smp_dst[i] = smp_src[i] * (T)volume;
 }
 
-scale_samples_func get_scaler(AudioFormat::SampleFormat fmt, qreal vol, int* voli)
+// simd kernels process a multiple of 8 or 16 samples, the rest is scaled by the C version
+static void scale_samples_s16_simd(quint8 *dst, const quint8 *src, int nb_samples, int volume, float volumef)
+{
+    int n = 0;
+#if QTAV_HAVE(AVX2)
+    if (detect_avx2())
+        n = ScaleSamplesS16_AVX2((short*)dst, (const short*)src, nb_samples, volume);
+    else
+#endif
+#if QTAV_HAVE(SSE2)
+    if (detect_sse2())
+        n = ScaleSamplesS16_SSE2((short*)dst, (const short*)src, nb_samples, volume);
+    else
+#endif
+#if QTAV_HAVE(NEON)
+    if (detect_neon())
+        n = ScaleSamplesS16_NEON((short*)dst, (const short*)src, nb_samples, volume);
+    else
+#endif
+    {}
+    scale_samples_s16_small(dst + n*2, src + n*2, nb_samples - n, volume, volumef);
+}
+
+static void scale_samples_float_simd(quint8 *dst, const quint8 *src, int nb_samples, int volume, float volumef)
+{
+    int n = 0;
+#if QTAV_HAVE(AVX2)
+    if (detect_avx2())
+        n = ScaleSamplesFloat_AVX2((float*)dst, (const float*)src, nb_samples, volumef);
+    else
+#endif
+#if QTAV_HAVE(SSE2)
+    if (detect_sse2())
+        n = ScaleSamplesFloat_SSE2((float*)dst, (const float*)src, nb_samples, volumef);
+    else
+#endif
+#if QTAV_HAVE(NEON)
+    if (detect_neon())
+        n = ScaleSamplesFloat_NEON((float*)dst, (const float*)src, nb_samples, volumef);
+    else
+#endif
+    {}
+    scale_samples<float>(dst + n*4, src + n*4, nb_samples - n, volume, volumef);
+}
+
+// exported for tests/microbench
+Q_AV_PRIVATE_EXPORT scale_samples_func get_scaler(AudioFormat::SampleFormat fmt, qreal vol, int* voli)
 {
     int v = (int)(vol * 256.0 + 0.5);
     if (voli)
@@ -101,13 +164,15 @@ scale_samples_func get_scaler(AudioFormat::SampleFormat fmt, qreal vol, int* vol
         return v < 0x1000000 ? scale_samples_u8_small : scale_samples_u8;
     case AudioFormat::SampleFormat_Signed16:
     case AudioFormat::SampleFormat_Signed16Planar:
+        if (v < 0x8000)
+            return scale_samples_s16_simd;
         return v < 0x10000 ? scale_samples_s16_small : scale_samples_s16;
     case AudioFormat::SampleFormat_Signed32:
     case AudioFormat::SampleFormat_Signed32Planar:
         return scale_samples_s32;
     case AudioFormat::SampleFormat_Float:
     case AudioFormat::SampleFormat_FloatPlanar:
-        return scale_samples<float>;
+        return scale_samples_float_simd;
     case AudioFormat::SampleFormat_Double:
     case AudioFormat::SampleFormat_DoublePlanar:
         return scale_samples<double>;
@@ -128,6 +193,8 @@ public:
       , speed(1.0)
       , nb_buffers(kBufferCount)
       , buffer_size(kBufferSize)
+      , user_nb_buffers(kBufferCount)
+      , user_buffer_size(kBufferSize)
       , features(0)
       , play_pos(0)
       , processed_remain(0)
@@ -138,6 +205,23 @@ public:
       , index_enqueue(-1)
       , index_deuqueue(-1)
       , frame_infos(ring<FrameInfo>(nb_buffers))
+      , pull(false)
+      , pull_silence(0)
+      , pulled_last(0)
+      , pulled_bytes(0)
+      , pull_waiting(0)
+      , pull_watermark(0)
+      , low_latency(false)
+      , power_saving(false)
+      , preserves_pitch(true)
+      , passthrough(false)
+      , passthrough_codec(0)
+      , volume_applied(false)
+      , data_shared(false)
+      , underruns(0)
+      , underruns_reported(0)
+      , pull_fed(0)
+      , pull_starving(false)
     {
         available = false;
     }
@@ -165,7 +249,66 @@ public:
 #if AO_USE_TIMER
         timer.invalidate();
 #endif
-        frame_infos = ring<FrameInfo>(nb_buffers);
+        // the pull ring holds nb_buffers chunks and the callback may be reading 1 more
+        frame_infos = ring<FrameInfo>(pull ? qMax<int>(nb_buffers, pull_ring.capacity()/qMax(buffer_size, 1)) + 2 : nb_buffers);
+    }
+    /*!
+     * Pull mode. Wait until the ring has space for bytes or the output is closed. The data callback wakes us if the
+     * space reaches pull_watermark, the timeout is only a fallback if the device stops calling back.
+     */
+    bool waitPullSpace(int bytes) {
+        bytes = qMin(bytes, pull_ring.capacity());
+        while (pull_ring.writable() < bytes) {
+            if (!available)
+                return false;
+            const qint64 us = format.durationForBytes(bytes - pull_ring.writable());
+            QMutexLocker lock(&pull_mutex);
+            Q_UNUSED(lock);
+            spsc::storeRelease(pull_watermark, bytes);
+            pull_waiting.fetchAndStoreOrdered(1);
+            // check again. the callback may free space before pull_waiting is set
+            if (available && pull_ring.writable() < bytes)
+                pull_cond.wait(&pull_mutex, qMax<qint64>(us/1000LL, 1LL) + 100LL);
+            pull_waiting.fetchAndStoreOrdered(0);
+        }
+        return available;
+    }
+    void wakePull() {
+        QMutexLocker lock(&pull_mutex);
+        Q_UNUSED(lock);
+        pull_cond.wakeAll();
+    }
+    void resetTiming() {
+        callback_interval.reset();
+        buffer_fill.reset();
+        wait_time.reset();
+        callback_timer.invalidate();
+        push_timer.invalidate();
+        spsc::storeRelease(underruns, 0);
+        underruns_reported = 0;
+        spsc::storeRelease(pull_fed, 0);
+        pull_starving = false;
+    }
+    /// msecs since last call, restarts t. < 0 if t was not started
+    static qreal restartMs(QElapsedTimer& t) {
+        if (!t.isValid()) {
+            t.start();
+            return -1;
+        }
+#if QT_VERSION >= QT_VERSION_CHECK(4, 8, 0)
+        const qint64 ns = t.nsecsElapsed();
+        t.start();
+        return qreal(ns)/1000000.0;
+#else
+        return qreal(t.restart());
+#endif
+    }
+    /// msecs of data enqueued to the backend and not processed. push mode
+    qreal queuedMs() const {
+        qint64 bytes = 0;
+        for (int i = 0; i < (int)frame_infos.size(); ++i)
+            bytes += frame_infos.at(i).data_size;
+        return qreal(format.durationForBytes(bytes))/1000.0;
     }
     /// call this if sample format or volume is changed
     void updateSampleScaleFunc();
@@ -182,6 +325,9 @@ public:
     //AudioFrame audio_frame;
     quint32 nb_buffers;
     qint32 buffer_size;
+    // set by user. buffer_size and nb_buffers are replaced by the profile and the backend in open()
+    quint32 user_nb_buffers;
+    qint32 user_buffer_size;
     int features;
     int play_pos; // index or bytes
     int processed_remain;
@@ -197,6 +343,32 @@ public:
     // the index of current enqueue/dequeue
     int index_enqueue, index_deuqueue;
     ring<FrameInfo> frame_infos;
+    // pull mode. pull_ring is written in audio thread and read in the backend's data callback
+    bool pull;
+    char pull_silence;
+    int pulled_last; // pulled_bytes when frame_infos was updated last time. audio thread only
+    SPSCByteRing pull_ring;
+    QAtomicInt pulled_bytes; // total bytes read by the callback. wraps around
+    QAtomicInt pull_waiting;
+    QAtomicInt pull_watermark;
+    QMutex pull_mutex; // only used to sleep and wake, never held while reading or writing the ring
+    QWaitCondition pull_cond;
+    bool low_latency;
+    bool power_saving;
+    bool preserves_pitch;
+    bool passthrough;
+    int passthrough_codec;
+    bool volume_applied; // data of current play() is scaled by caller
+    bool data_shared; // data of current play() can be referenced by backend without copying
+    // timing statistics since open(). In pull mode callback_interval, buffer_fill, callback_timer and pull_starving are
+    // written in the callback thread only
+    Statistics::Histogram callback_interval, buffer_fill, wait_time;
+    QElapsedTimer callback_timer;
+    QElapsedTimer push_timer; // time of waitForNextBuffer() in receiveData()
+    QAtomicInt underruns;
+    int underruns_reported; // audio thread only
+    QAtomicInt pull_fed; // data was written to the pull ring. no underrun before the 1st write
+    bool pull_starving;
 };
 
 void AudioOutputPrivate::updateSampleScaleFunc()
@@ -216,6 +388,10 @@ void AudioOutputPrivate::playInitialData()
 {
     if (!backend)
         return;
+    if (pull) { // the callback fills silence until data is written
+        backend->play();
+        return;
+    }
     const char c = (format.sampleFormat() == AudioFormat::SampleFormat_Unsigned8
                     || format.sampleFormat() == AudioFormat::SampleFormat_Unsigned8Planar)
             ? 0x80 : 0;
@@ -267,6 +443,9 @@ AudioOutput::AudioOutput(QObject* parent)
 #if QTAV_HAVE(PULSEAUDIO)&& !defined(Q_OS_MAC)
             << QStringLiteral("Pulse")
 #endif
+#if QTAV_HAVE(AAUDIO)
+            << QStringLiteral("AAudio") // not available before android 8.0
+#endif
 #if QTAV_HAVE(OPENSL)
             << QStringLiteral("OpenSL")
 #endif
@@ -307,15 +486,24 @@ void AudioOutput::setBackends(const QStringList &backendNames)
     DPTR_D(AudioOutput);
     if (d.backends == backendNames)
         return;
-    d.update_backend = true;
     d.backends = backendNames;
-    // create backend here because we have to check format support before open which needs a backend
-    d.update_backend = false;
     if (d.backend) {
         d.backend->close();
         delete d.backend;
         d.backend = 0;
     }
+    // the backend is created by ensureBackend() when format support is checked or open() is called
+    d.update_backend = true;
+    emit backendsChanged();
+}
+
+void AudioOutput::ensureBackend() const
+{
+    AudioOutput *q = const_cast<AudioOutput*>(this);
+    AudioOutputPrivate &d = q->d_func();
+    if (!d.update_backend)
+        return;
+    d.update_backend = false;
     // TODO: empty backends use dummy backend
     if (!d.backends.isEmpty()) {
         foreach (const QString& b, d.backends) {
@@ -328,15 +516,16 @@ void AudioOutput::setBackends(const QStringList &backendNames)
             d.backend = NULL;
         }
     }
-    if (d.backend) {
-        // default: set all features when backend is ready
-        setDeviceFeatures(d.backend->supportedFeatures());
-        // connect volumeReported
-        connect(d.backend, SIGNAL(volumeReported(qreal)), SLOT(reportVolume(qreal)));
-        connect(d.backend, SIGNAL(muteReported(bool)), SLOT(reportMute(bool)));
-    }
-
-    emit backendsChanged();
+    if (!d.backend)
+        return;
+    // may be created in the thread checking format support, e.g. AVPlayer loading thread
+    if (d.backend->thread() != thread())
+        d.backend->moveToThread(thread());
+    // default: set all features when backend is ready
+    q->setDeviceFeatures(d.backend->supportedFeatures());
+    // connect volumeReported
+    connect(d.backend, SIGNAL(volumeReported(qreal)), q, SLOT(reportVolume(qreal)));
+    connect(d.backend, SIGNAL(muteReported(bool)), q, SLOT(reportMute(bool)));
 }
 
 QStringList AudioOutput::backends() const
@@ -346,28 +535,69 @@ QStringList AudioOutput::backends() const
 
 QString AudioOutput::backend() const
 {
+    ensureBackend();
     DPTR_D(const AudioOutput);
     if (d.backend)
         return d.backend->name();
     return QString();
 }
 
+void AudioOutput::getTimingStatistics(Statistics::AudioOnly *st) const
+{
+    if (!st)
+        return;
+    DPTR_D(const AudioOutput);
+    st->backend = backend();
+    st->callback_interval = d.callback_interval;
+    st->buffer_fill = d.buffer_fill;
+    st->wait_time = d.wait_time;
+    st->underruns = spsc::loadAcquire(d.underruns);
+}
+
 bool AudioOutput::open()
 {
+    ensureBackend();
     DPTR_D(AudioOutput);
     QMutexLocker lock(&d.mutex);
     Q_UNUSED(lock);
     d.available = false;
-    d.resetStatus();
     if (!d.backend)
         return false;
+    d.pull = !!(d.backend->bufferControl() & AudioOutputBackend::Pull);
+    d.buffer_size = d.user_buffer_size;
+    d.nb_buffers = d.user_nb_buffers;
+    d.resetStatus();
+    d.resetTiming();
+    if (d.low_latency) {
+        const int frame_bytes = qMax(d.format.bytesPerFrame(), 1);
+        d.buffer_size = qMax(d.format.bytesForDuration(kLowLatencyChunkUs)/frame_bytes, 1)*frame_bytes;
+        d.nb_buffers = kLowLatencyBufferCount;
+    } else if (d.power_saving) {
+        const int frame_bytes = qMax(d.format.bytesPerFrame(), 1);
+        d.buffer_size = qMax(d.format.bytesForDuration(kPowerSavingChunkUs)/frame_bytes, 1)*frame_bytes;
+        d.nb_buffers = kPowerSavingBufferCount;
+    }
+    if (d.pull) {
+        d.pull_ring.resize(bufferSizeTotal());
+        d.pull_silence = d.format.isUnsigned() && !d.format.isFloat() ? (char)0x80 : 0;
+        d.pulled_last = 0;
+        spsc::storeRelease(d.pulled_bytes, 0);
+    }
     d.backend->audio = this;
     d.backend->buffer_size = bufferSize();
     d.backend->buffer_count = bufferCount();
+    d.backend->low_latency = d.low_latency;
+    d.backend->passthrough_codec = d.passthrough_codec;
     d.backend->format = audioFormat();
     // TODO: open next backend if fail and emit backendChanged()
     if (!d.backend->open())
         return false;
+    // the backend may negotiate its own period. the pull ring is in use now and keeps its size
+    if (d.backend->buffer_size > 0)
+        d.buffer_size = d.backend->buffer_size;
+    if (d.backend->buffer_count > 0)
+        d.nb_buffers = d.backend->buffer_count;
+    d.resetStatus();
     d.available = true;
     d.tryVolume(volume());
     d.tryMute(isMute());
@@ -381,6 +611,7 @@ bool AudioOutput::close()
     QMutexLocker lock(&d.mutex);
     Q_UNUSED(lock);
     d.available = false;
+    d.wakePull();
     d.resetStatus();
     if (!d.backend)
         return false;
@@ -403,6 +634,29 @@ bool AudioOutput::play(const QByteArray &data, qreal pts)
     return d.backend->play();
 }
 
+bool AudioOutput::play(const QByteArray &data, qreal pts, bool volumeApplied)
+{
+    DPTR_D(AudioOutput);
+    d.volume_applied = volumeApplied;
+    const bool ret = play(data, pts);
+    d.volume_applied = false;
+    return ret;
+}
+
+bool AudioOutput::play(const AudioFrame &frame, bool volumeApplied)
+{
+    DPTR_D(AudioOutput);
+    AudioFrame f(frame);
+    d.volume_applied = volumeApplied;
+    d.data_shared = true;
+    const bool ret = play(f.data(), frame.timestamp());
+    d.volume_applied = false;
+    d.data_shared = false;
+    // release before f, so the last reference puts the buffer back to the pool
+    d.data = QByteArray();
+    return ret;
+}
+
 bool AudioOutput::receiveData(const QByteArray &data, qreal pts)
 {
     DPTR_D(AudioOutput);
@@ -417,6 +671,8 @@ bool AudioOutput::receiveData(const QByteArray &data, qreal pts)
     } else {
         if (!qFuzzyCompare(volume(), (qreal)1.0)
                 && d.sw_volume
+                && !d.volume_applied
+                && !d.passthrough_codec // scaling breaks the bursts
                 && d.scale_samples
                 ) {
             // TODO: af_volume needs samples_align to get nb_samples
@@ -425,15 +681,54 @@ bool AudioOutput::receiveData(const QByteArray &data, qreal pts)
             d.scale_samples(dst, dst, nb_samples, d.volume_i, volume());
         }
     }
+    const int queued = d.frame_infos.size();
+    d.push_timer.start();
     // wait after all data processing finished to reduce time error
     if (!waitForNextBuffer()) {
         qWarning("ao backend maybe not open");
         d.resetStatus();
         return false;
     }
+    qreal wait_ms = AudioOutputPrivate::restartMs(d.push_timer);
+    if (!d.pull && d.backend) {
+        const AudioOutputBackend::BufferControl f = d.backend->bufferControl();
+        // a blocking write never starves because nothing is queued
+        if (!(f & AudioOutputBackend::Blocking) && (int)d.frame_infos.size() < queued) {
+            if (!(f & (AudioOutputBackend::CountCallback|AudioOutputBackend::BytesCallback))) {
+                const qreal ms = AudioOutputPrivate::restartMs(d.callback_timer);
+                if (ms >= 0)
+                    d.callback_interval.add(ms);
+            }
+            d.buffer_fill.add(d.queuedMs());
+            if (d.frame_infos.empty())
+                d.underruns.ref();
+        }
+    }
+    const int nb_underruns = spsc::loadAcquire(d.underruns);
+    if (nb_underruns != d.underruns_reported) {
+        d.underruns_reported = nb_underruns;
+        Q_EMIT underrun(nb_underruns);
+    }
     d.frame_infos.push_back(AudioOutputPrivate::FrameInfo(pts, data.size()));
     if (!d.backend || !isOpen())
         return false;
+    if (d.pull) {
+        // data larger than the ring is written in parts
+        int written = d.pull_ring.write(d.data.constData(), d.data.size());
+        while (written < d.data.size()) {
+            d.push_timer.start();
+            if (!d.waitPullSpace(d.data.size() - written))
+                return false;
+            wait_ms += AudioOutputPrivate::restartMs(d.push_timer);
+            written += d.pull_ring.write(d.data.constData() + written, d.data.size() - written);
+        }
+        d.wait_time.add(wait_ms);
+        spsc::storeRelease(d.pull_fed, 1);
+        return true;
+    }
+    d.wait_time.add(wait_ms);
+    if (d.data_shared)
+        return d.backend->writeShared(d.data);
     return d.backend->write(d.data);
 }
 
@@ -443,8 +738,8 @@ void AudioOutput::setAudioFormat(const AudioFormat& format)
     // no support check because that may require an open device(AL) while this function is called before ao.open()
     if (d.format == format)
         return;
-    d.updateSampleScaleFunc();
     d.format = format;
+    d.updateSampleScaleFunc(); // depends on the new sample format
 }
 
 AudioFormat& AudioOutput::audioFormat()
@@ -497,6 +792,12 @@ qreal AudioOutput::volume() const
     return qMax<qreal>(d_func().vol, 0);
 }
 
+qreal AudioOutput::softwareVolume() const
+{
+    DPTR_D(const AudioOutput);
+    return d.sw_volume ? volume() : 1.0;
+}
+
 void AudioOutput::setMute(bool value)
 {
     DPTR_D(AudioOutput);
@@ -522,8 +823,19 @@ qreal AudioOutput::speed() const
     return d_func().speed;
 }
 
+void AudioOutput::setPreservesPitch(bool value)
+{
+    d_func().preserves_pitch = value;
+}
+
+bool AudioOutput::preservesPitch() const
+{
+    return d_func().preserves_pitch;
+}
+
 bool AudioOutput::isSupported(const AudioFormat &format) const
 {
+    ensureBackend();
     DPTR_D(const AudioOutput);
     if (!d.backend)
         return false;
@@ -532,6 +844,7 @@ bool AudioOutput::isSupported(const AudioFormat &format) const
 
 bool AudioOutput::isSupported(AudioFormat::SampleFormat sampleFormat) const
 {
+    ensureBackend();
     DPTR_D(const AudioOutput);
     if (!d.backend)
         return false;
@@ -540,6 +853,7 @@ bool AudioOutput::isSupported(AudioFormat::SampleFormat sampleFormat) const
 
 bool AudioOutput::isSupported(AudioFormat::ChannelLayout channelLayout) const
 {
+    ensureBackend();
     DPTR_D(const AudioOutput);
     if (!d.backend)
         return false;
@@ -548,6 +862,7 @@ bool AudioOutput::isSupported(AudioFormat::ChannelLayout channelLayout) const
 
 AudioFormat::SampleFormat AudioOutput::preferredSampleFormat() const
 {
+    ensureBackend();
     DPTR_D(const AudioOutput);
     if (!d.backend)
         return AudioFormat::SampleFormat_Signed16;
@@ -556,6 +871,7 @@ AudioFormat::SampleFormat AudioOutput::preferredSampleFormat() const
 
 AudioFormat::ChannelLayout AudioOutput::preferredChannelLayout() const
 {
+    ensureBackend();
     DPTR_D(const AudioOutput);
     if (!d.backend)
         return AudioFormat::ChannelLayout_Stero;
@@ -570,6 +886,7 @@ int AudioOutput::bufferSize() const
 void AudioOutput::setBufferSize(int value)
 {
     d_func().buffer_size = value;
+    d_func().user_buffer_size = value;
 }
 
 int AudioOutput::bufferCount() const
@@ -580,6 +897,64 @@ int AudioOutput::bufferCount() const
 void AudioOutput::setBufferCount(int value)
 {
     d_func().nb_buffers = value;
+    d_func().user_nb_buffers = value;
+}
+
+void AudioOutput::setLowLatency(bool value)
+{
+    d_func().low_latency = value;
+}
+
+bool AudioOutput::isLowLatency() const
+{
+    return d_func().low_latency;
+}
+
+void AudioOutput::setPowerSaving(bool value)
+{
+    d_func().power_saving = value;
+}
+
+bool AudioOutput::isPowerSaving() const
+{
+    return d_func().power_saving && !d_func().low_latency;
+}
+
+void AudioOutput::setPassthrough(bool value)
+{
+    d_func().passthrough = value;
+}
+
+bool AudioOutput::isPassthrough() const
+{
+    return d_func().passthrough;
+}
+
+bool AudioOutput::isPassthroughSupported(int codecId) const
+{
+    ensureBackend();
+    DPTR_D(const AudioOutput);
+    if (!d.backend)
+        return false;
+    return d.backend->isPassthroughSupported(codecId);
+}
+
+void AudioOutput::setPassthroughCodec(int codecId)
+{
+    d_func().passthrough_codec = codecId;
+}
+
+int AudioOutput::passthroughCodec() const
+{
+    return d_func().passthrough_codec;
+}
+
+qreal AudioOutput::latency() const
+{
+    DPTR_D(const AudioOutput);
+    if (!d.backend || !d.available)
+        return 0;
+    return qMax<qreal>(d.backend->getLatency(), 0);
 }
 
 // no virtual functions inside because it can be called in ctor
@@ -602,6 +977,7 @@ AudioOutput::DeviceFeatures AudioOutput::deviceFeatures() const
 
 AudioOutput::DeviceFeatures AudioOutput::supportedDeviceFeatures() const
 {
+    ensureBackend();
     DPTR_D(const AudioOutput);
     if (!d.backend)
         return NoFeature;
@@ -718,6 +1094,19 @@ bool AudioOutput::waitForNextBuffer()
         d.processed_remain += processed;
         d.processed_remain -= d.data.size(); //ensure d.processed_remain later is greater
         remove = -processed;
+    } else if (f & AudioOutputBackend::Pull) {
+        if (!d.waitPullSpace(d.data.size()))
+            return false;
+        // pop the chunks completely read by the callback. the rest bytes are counted next time
+        const int pulled = spsc::loadAcquire(d.pulled_bytes);
+        int free_bytes = d.processed_remain + (int)((unsigned)pulled - (unsigned)d.pulled_last);
+        d.pulled_last = pulled;
+        while (!d.frame_infos.empty() && free_bytes >= d.frame_infos.front().data_size) {
+            free_bytes -= d.frame_infos.front().data_size;
+            d.frame_infos.pop_front();
+        }
+        d.processed_remain = d.frame_infos.empty() ? 0 : free_bytes;
+        return true;
     } else if (f & AudioOutputBackend::OffsetIndex) {
         int n = d.backend->getOffset();
         int processed = n - d.play_pos;
@@ -769,7 +1158,13 @@ bool AudioOutput::waitForNextBuffer()
 qreal AudioOutput::timestamp() const
 {
     DPTR_D(const AudioOutput);
-    return d.frame_infos.front().timestamp;
+    const AudioOutputPrivate::FrameInfo &fi = d.frame_infos.front();
+    if (!d.pull)
+        return fi.timestamp;
+    // timestamp is the end of the chunk. the position of the last byte read by the callback matches getLatency() of pull backends
+    const int pulled = spsc::loadAcquire(d.pulled_bytes);
+    const int read = qBound(0, d.processed_remain + (int)((unsigned)pulled - (unsigned)d.pulled_last), fi.data_size);
+    return fi.timestamp - qreal(d.format.durationForBytes(fi.data_size - read))/1000000.0;
 }
 
 void AudioOutput::reportVolume(qreal value)
@@ -796,6 +1191,36 @@ void AudioOutput::reportMute(bool value)
 
 void AudioOutput::onCallback()
 {
-    d_func().onCallback();
+    DPTR_D(AudioOutput);
+    // pull mode records the interval in pullData()
+    if (!d.pull) {
+        const qreal ms = AudioOutputPrivate::restartMs(d.callback_timer);
+        if (ms >= 0)
+            d.callback_interval.add(ms);
+    }
+    d.onCallback();
+}
+
+int AudioOutput::pullData(char *data, int bytes)
+{
+    DPTR_D(AudioOutput);
+    const qreal ms = AudioOutputPrivate::restartMs(d.callback_timer);
+    if (ms >= 0)
+        d.callback_interval.add(ms);
+    d.buffer_fill.add(qreal(d.format.durationForBytes(d.pull_ring.readable()))/1000.0);
+    const int n = d.pull_ring.read(data, bytes);
+    if (n < bytes) {
+        memset(data + n, d.pull_silence, bytes - n);
+        // count once per gap. silence before the 1st write and while paused is expected
+        if (!d.pull_starving && !d.paused && spsc::loadAcquire(d.pull_fed))
+            d.underruns.ref();
+        d.pull_starving = true;
+    } else {
+        d.pull_starving = false;
+    }
+    d.pulled_bytes.fetchAndAddOrdered(n);
+    if (spsc::loadOrdered(d.pull_waiting) && d.pull_ring.writable() >= spsc::loadAcquire(d.pull_watermark))
+        d.wakePull();
+    return n;
 }
 } //namespace QtAV
@@ -0,0 +1,385 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/private/AudioOutputBackend.h"
+#include "QtAV/private/mkid.h"
+#include "QtAV/private/prepost.h"
+#include <string.h>
+#include <time.h>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QLibrary>
+#include <aaudio/AAudio.h>
+#include "utils/Logger.h"
+
+// ref: https://developer.android.com/ndk/guides/audio/aaudio/aaudio
+namespace QtAV {
+
+/*
+ * libaaudio.so is loaded at runtime, so the library still works on android < 8.0, where OpenSL is used instead.
+ * Only types and constants of AAudio.h are used here
+ */
+class AAudioAPI
+{
+public:
+    AAudioAPI() { memset(&createStreamBuilder, 0, (char*)&lib - (char*)&createStreamBuilder); }
+    bool load() {
+        lib.setFileName(QStringLiteral("aaudio"));
+        if (!lib.load()) {
+            qDebug("AAudio is not available: %s", lib.errorString().toUtf8().constData());
+            return false;
+        }
+#define AAUDIO_RESOLVE(var, sym) do { \
+            var = (var##_t)lib.resolve(#sym); \
+            if (!var) { \
+                qWarning("AAudio: failed to resolve " #sym); \
+                return false; \
+            } \
+        } while (0)
+        AAUDIO_RESOLVE(createStreamBuilder, AAudio_createStreamBuilder);
+        AAUDIO_RESOLVE(convertResultToText, AAudio_convertResultToText);
+        AAUDIO_RESOLVE(setDirection, AAudioStreamBuilder_setDirection);
+        AAUDIO_RESOLVE(setSharingMode, AAudioStreamBuilder_setSharingMode);
+        AAUDIO_RESOLVE(setPerformanceMode, AAudioStreamBuilder_setPerformanceMode);
+        AAUDIO_RESOLVE(setSampleRate, AAudioStreamBuilder_setSampleRate);
+        AAUDIO_RESOLVE(setChannelCount, AAudioStreamBuilder_setChannelCount);
+        AAUDIO_RESOLVE(setFormat, AAudioStreamBuilder_setFormat);
+        AAUDIO_RESOLVE(setDataCallback, AAudioStreamBuilder_setDataCallback);
+        AAUDIO_RESOLVE(setErrorCallback, AAudioStreamBuilder_setErrorCallback);
+        AAUDIO_RESOLVE(openStream, AAudioStreamBuilder_openStream);
+        AAUDIO_RESOLVE(deleteBuilder, AAudioStreamBuilder_delete);
+        AAUDIO_RESOLVE(requestStart, AAudioStream_requestStart);
+        AAUDIO_RESOLVE(requestStop, AAudioStream_requestStop);
+        AAUDIO_RESOLVE(close, AAudioStream_close);
+        AAUDIO_RESOLVE(getState, AAudioStream_getState);
+        AAUDIO_RESOLVE(getSampleRate, AAudioStream_getSampleRate);
+        AAUDIO_RESOLVE(getChannelCount, AAudioStream_getChannelCount);
+        AAUDIO_RESOLVE(getFormat, AAudioStream_getFormat);
+        AAUDIO_RESOLVE(getSharingMode, AAudioStream_getSharingMode);
+        AAUDIO_RESOLVE(getPerformanceMode, AAudioStream_getPerformanceMode);
+        AAUDIO_RESOLVE(getFramesPerBurst, AAudioStream_getFramesPerBurst);
+        AAUDIO_RESOLVE(getBufferSizeInFrames, AAudioStream_getBufferSizeInFrames);
+        AAUDIO_RESOLVE(setBufferSizeInFrames, AAudioStream_setBufferSizeInFrames);
+        AAUDIO_RESOLVE(getBufferCapacityInFrames, AAudioStream_getBufferCapacityInFrames);
+        AAUDIO_RESOLVE(getXRunCount, AAudioStream_getXRunCount);
+        AAUDIO_RESOLVE(getFramesWritten, AAudioStream_getFramesWritten);
+        AAUDIO_RESOLVE(getTimestamp, AAudioStream_getTimestamp);
+#undef AAUDIO_RESOLVE
+        return true;
+    }
+
+    typedef aaudio_result_t (*createStreamBuilder_t)(AAudioStreamBuilder**);
+    typedef const char* (*convertResultToText_t)(aaudio_result_t);
+    typedef void (*setDirection_t)(AAudioStreamBuilder*, aaudio_direction_t);
+    typedef void (*setSharingMode_t)(AAudioStreamBuilder*, aaudio_sharing_mode_t);
+    typedef void (*setPerformanceMode_t)(AAudioStreamBuilder*, aaudio_performance_mode_t);
+    typedef void (*setSampleRate_t)(AAudioStreamBuilder*, int32_t);
+    typedef void (*setChannelCount_t)(AAudioStreamBuilder*, int32_t);
+    typedef void (*setFormat_t)(AAudioStreamBuilder*, aaudio_format_t);
+    typedef void (*setDataCallback_t)(AAudioStreamBuilder*, AAudioStream_dataCallback, void*);
+    typedef void (*setErrorCallback_t)(AAudioStreamBuilder*, AAudioStream_errorCallback, void*);
+    typedef aaudio_result_t (*openStream_t)(AAudioStreamBuilder*, AAudioStream**);
+    typedef aaudio_result_t (*deleteBuilder_t)(AAudioStreamBuilder*);
+    typedef aaudio_result_t (*requestStart_t)(AAudioStream*);
+    typedef aaudio_result_t (*requestStop_t)(AAudioStream*);
+    typedef aaudio_result_t (*close_t)(AAudioStream*);
+    typedef aaudio_stream_state_t (*getState_t)(AAudioStream*);
+    typedef int32_t (*getSampleRate_t)(AAudioStream*);
+    typedef int32_t (*getChannelCount_t)(AAudioStream*);
+    typedef aaudio_format_t (*getFormat_t)(AAudioStream*);
+    typedef aaudio_sharing_mode_t (*getSharingMode_t)(AAudioStream*);
+    typedef aaudio_performance_mode_t (*getPerformanceMode_t)(AAudioStream*);
+    typedef int32_t (*getFramesPerBurst_t)(AAudioStream*);
+    typedef int32_t (*getBufferSizeInFrames_t)(AAudioStream*);
+    typedef aaudio_result_t (*setBufferSizeInFrames_t)(AAudioStream*, int32_t);
+    typedef int32_t (*getBufferCapacityInFrames_t)(AAudioStream*);
+    typedef int32_t (*getXRunCount_t)(AAudioStream*);
+    typedef int64_t (*getFramesWritten_t)(AAudioStream*);
+    typedef aaudio_result_t (*getTimestamp_t)(AAudioStream*, clockid_t, int64_t*, int64_t*);
+
+    createStreamBuilder_t createStreamBuilder;
+    convertResultToText_t convertResultToText;
+    setDirection_t setDirection;
+    setSharingMode_t setSharingMode;
+    setPerformanceMode_t setPerformanceMode;
+    setSampleRate_t setSampleRate;
+    setChannelCount_t setChannelCount;
+    setFormat_t setFormat;
+    setDataCallback_t setDataCallback;
+    setErrorCallback_t setErrorCallback;
+    openStream_t openStream;
+    deleteBuilder_t deleteBuilder;
+    requestStart_t requestStart;
+    requestStop_t requestStop;
+    close_t close;
+    getState_t getState;
+    getSampleRate_t getSampleRate;
+    getChannelCount_t getChannelCount;
+    getFormat_t getFormat;
+    getSharingMode_t getSharingMode;
+    getPerformanceMode_t getPerformanceMode;
+    getFramesPerBurst_t getFramesPerBurst;
+    getBufferSizeInFrames_t getBufferSizeInFrames;
+    setBufferSizeInFrames_t setBufferSizeInFrames;
+    getBufferCapacityInFrames_t getBufferCapacityInFrames;
+    getXRunCount_t getXRunCount;
+    getFramesWritten_t getFramesWritten;
+    getTimestamp_t getTimestamp;
+    QLibrary lib; // MUST be the last member, see ctor
+};
+
+static const char kName[] = "AAudio";
+/*!
+ * Pull samples from AudioOutput's lock free ring in the data callback of the stream. The low latency profile requests an
+ * exclusive low latency stream, starts with a device buffer of 2 bursts, and adds 1 burst once an underrun is counted.
+ * The stream is reopened on the default device if it is disconnected, e.g. headphones are unplugged.
+ */
+class AudioOutputAAudio Q_DECL_FINAL: public AudioOutputBackend
+{
+    Q_OBJECT
+public:
+    AudioOutputAAudio(QObject *parent = 0);
+    ~AudioOutputAAudio();
+    QString name() const Q_DECL_OVERRIDE { return QLatin1String(kName);}
+    bool isSupported(AudioFormat::SampleFormat sampleFormat) const Q_DECL_OVERRIDE;
+    bool isSupported(AudioFormat::ChannelLayout channelLayout) const Q_DECL_OVERRIDE;
+    bool open() Q_DECL_OVERRIDE;
+    bool close() Q_DECL_OVERRIDE;
+    BufferControl bufferControl() const Q_DECL_OVERRIDE { return Pull;}
+    bool write(const QByteArray& data) Q_DECL_OVERRIDE;
+    bool play() Q_DECL_OVERRIDE;
+    qreal getLatency() Q_DECL_OVERRIDE;
+
+private Q_SLOTS:
+    void reopen();
+private:
+    static aaudio_data_callback_result_t dataCallback(AAudioStream *stream, void *userData, void *audioData, int32_t numFrames);
+    static void errorCallback(AAudioStream *stream, void *userData, aaudio_result_t error);
+
+    AAudioAPI aa;
+    AAudioStream *m_stream;
+    int m_burst; // frames
+    int m_capacity; // frames
+    int m_xruns; // underruns handled in data callback
+    bool m_tune; // enlarge the device buffer on underrun
+    bool m_playing;
+};
+
+typedef AudioOutputAAudio AudioOutputBackendAAudio;
+static const AudioOutputBackendId AudioOutputBackendId_AAudio = mkid::id32base36_6<'A', 'A', 'u', 'd', 'i', 'o'>::value;
+FACTORY_REGISTER_ID_AUTO(AudioOutputBackend, AAudio, kName)
+
+void RegisterAudioOutputAAudio_Man()
+{
+    FACTORY_REGISTER_ID_MAN(AudioOutputBackend, AAudio, kName)
+}
+
+#define AAUDIO_ENSURE_OK(FUNC, ...) \
+    do { \
+        aaudio_result_t ret = FUNC; \
+        if (ret != AAUDIO_OK) { \
+            qWarning("AudioOutputAAudio Error>>> " #FUNC " (%d): %s", ret, aa.convertResultToText(ret)); \
+            return __VA_ARGS__; \
+        } \
+    } while(0)
+
+static aaudio_format_t toAAudioFormat(AudioFormat::SampleFormat fmt)
+{
+    switch (fmt) {
+    case AudioFormat::SampleFormat_Signed16:
+        return AAUDIO_FORMAT_PCM_I16;
+    case AudioFormat::SampleFormat_Float:
+        return AAUDIO_FORMAT_PCM_FLOAT;
+    default:
+        return AAUDIO_FORMAT_INVALID;
+    }
+}
+
+aaudio_data_callback_result_t AudioOutputAAudio::dataCallback(AAudioStream *stream, void *userData, void *audioData, int32_t numFrames)
+{
+    AudioOutputAAudio *ao = reinterpret_cast<AudioOutputAAudio*>(userData);
+    ao->pullData((char*)audioData, numFrames*ao->format.bytesPerFrame());
+    if (ao->m_tune) {
+        // the first underruns after start are expected. a larger buffer costs 1 burst of latency each time
+        const int xruns = ao->aa.getXRunCount(stream);
+        if (xruns > ao->m_xruns) {
+            ao->m_xruns = xruns;
+            const int size = ao->aa.getBufferSizeInFrames(stream) + ao->m_burst;
+            if (size <= ao->m_capacity)
+                ao->aa.setBufferSizeInFrames(stream, size);
+        }
+    }
+    return AAUDIO_CALLBACK_RESULT_CONTINUE;
+}
+
+void AudioOutputAAudio::errorCallback(AAudioStream *stream, void *userData, aaudio_result_t error)
+{
+    Q_UNUSED(stream);
+    AudioOutputAAudio *ao = reinterpret_cast<AudioOutputAAudio*>(userData);
+    qWarning("AAudio stream error (%d): %s", error, ao->aa.convertResultToText(error));
+    if (error != AAUDIO_ERROR_DISCONNECTED)
+        return;
+    // the stream can not be closed in the callback thread
+    QMetaObject::invokeMethod(ao, "reopen", Qt::QueuedConnection);
+}
+
+AudioOutputAAudio::AudioOutputAAudio(QObject *parent)
+    : AudioOutputBackend(AudioOutput::NoFeature, parent)
+    , m_stream(0)
+    , m_burst(0)
+    , m_capacity(0)
+    , m_xruns(0)
+    , m_tune(false)
+    , m_playing(false)
+{
+    available = aa.load();
+}
+
+AudioOutputAAudio::~AudioOutputAAudio()
+{
+    close();
+}
+
+bool AudioOutputAAudio::isSupported(AudioFormat::SampleFormat sampleFormat) const
+{
+    return toAAudioFormat(sampleFormat) != AAUDIO_FORMAT_INVALID;
+}
+
+bool AudioOutputAAudio::isSupported(AudioFormat::ChannelLayout channelLayout) const
+{
+    return channelLayout == AudioFormat::ChannelLayout_Mono || channelLayout == AudioFormat::ChannelLayout_Stero;
+}
+
+bool AudioOutputAAudio::open()
+{
+    if (!available)
+        return false;
+    AAudioStreamBuilder *builder = 0;
+    AAUDIO_ENSURE_OK(aa.createStreamBuilder(&builder), false);
+    aa.setDirection(builder, AAUDIO_DIRECTION_OUTPUT);
+    if (low_latency) {
+        // exclusive mode is not guaranteed. a shared stream is opened if the device is in use
+        aa.setSharingMode(builder, AAUDIO_SHARING_MODE_EXCLUSIVE);
+        aa.setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+    } else {
+        aa.setSharingMode(builder, AAUDIO_SHARING_MODE_SHARED);
+        aa.setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_NONE);
+    }
+    aa.setSampleRate(builder, format.sampleRate());
+    aa.setChannelCount(builder, format.channels());
+    aa.setFormat(builder, toAAudioFormat(format.sampleFormat()));
+    aa.setDataCallback(builder, AudioOutputAAudio::dataCallback, this);
+    aa.setErrorCallback(builder, AudioOutputAAudio::errorCallback, this);
+    const aaudio_result_t ret = aa.openStream(builder, &m_stream);
+    aa.deleteBuilder(builder);
+    if (ret != AAUDIO_OK) {
+        qWarning("AAudio failed to open stream (%d): %s", ret, aa.convertResultToText(ret));
+        m_stream = 0;
+        return false;
+    }
+    // sample rate is converted by aaudio if requested, but not the sample format or channels
+    if (aa.getSampleRate(m_stream) != format.sampleRate()
+            || aa.getChannelCount(m_stream) != format.channels()
+            || aa.getFormat(m_stream) != toAAudioFormat(format.sampleFormat())) {
+        qWarning("AAudio stream format %d %dHz %dch is not supported", aa.getFormat(m_stream), aa.getSampleRate(m_stream), aa.getChannelCount(m_stream));
+        close();
+        return false;
+    }
+    m_burst = qMax(aa.getFramesPerBurst(m_stream), 1);
+    m_capacity = aa.getBufferCapacityInFrames(m_stream);
+    m_xruns = 0;
+    const int frame_bytes = qMax(format.bytesPerFrame(), 1);
+    const int total = buffer_size*buffer_count;
+    // the device buffer is a multiple of bursts. chunks of AudioOutput match the burst in low latency profile
+    int frames = (buffer_size/frame_bytes + m_burst - 1)/m_burst*m_burst;
+    m_tune = low_latency;
+    if (low_latency) {
+        frames = 2*m_burst;
+        buffer_size = m_burst*frame_bytes;
+        buffer_count = qMax(total/buffer_size, 2);
+    }
+    if (m_capacity > 0)
+        frames = qMin(frames, m_capacity);
+    aa.setBufferSizeInFrames(m_stream, frames);
+    qDebug("AAudio stream opened. sharing mode: %d, performance mode: %d, burst: %d, buffer: %d/%d frames"
+           , aa.getSharingMode(m_stream), aa.getPerformanceMode(m_stream), m_burst, aa.getBufferSizeInFrames(m_stream), m_capacity);
+    return true;
+}
+
+bool AudioOutputAAudio::close()
+{
+    m_playing = false;
+    if (!m_stream)
+        return true;
+    aa.requestStop(m_stream);
+    AAUDIO_ENSURE_OK(aa.close(m_stream), false);
+    m_stream = 0;
+    return true;
+}
+
+bool AudioOutputAAudio::write(const QByteArray &data)
+{
+    Q_UNUSED(data); // data is pulled in dataCallback()
+    return true;
+}
+
+bool AudioOutputAAudio::play()
+{
+    if (!m_stream)
+        return false;
+    m_playing = true;
+    const aaudio_stream_state_t st = aa.getState(m_stream);
+    if (st == AAUDIO_STREAM_STATE_STARTING || st == AAUDIO_STREAM_STATE_STARTED)
+        return true;
+    AAUDIO_ENSURE_OK(aa.requestStart(m_stream), false);
+    return true;
+}
+
+qreal AudioOutputAAudio::getLatency()
+{
+    if (!m_stream)
+        return -1;
+    // the time the next written frame is presented, estimated from the latest presented frame
+    int64_t pos = 0, ns = 0;
+    if (aa.getTimestamp(m_stream, CLOCK_MONOTONIC, &pos, &ns) != AAUDIO_OK)
+        return -1;
+    const int64_t written = aa.getFramesWritten(m_stream);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t now_ns = int64_t(now.tv_sec)*1000000000LL + now.tv_nsec;
+    const qreal t = qreal(written - pos)/qreal(format.sampleRate()) + qreal(ns - now_ns)/1000000000.0;
+    return qMax<qreal>(t, 0);
+}
+
+void AudioOutputAAudio::reopen()
+{
+    if (!m_stream)
+        return;
+    const bool playing = m_playing;
+    qDebug("AAudio stream is disconnected. reopen on the default device");
+    close();
+    if (!open())
+        return;
+    if (playing)
+        play();
+}
+
+} //namespace QtAV
+#include "AudioOutputAAudio.moc"
@@ -21,6 +21,7 @@
 
 #include "QtAV/private/AudioOutputBackend.h"
 #include "QtAV/private/factory.h"
+#include <string.h>
 
 namespace QtAV {
 
@@ -30,6 +31,8 @@ AudioOutputBackend::AudioOutputBackend(AudioOutput::DeviceFeatures f, QObject *p
     , available(true)
     , buffer_size(0)
     , buffer_count(0)
+    , low_latency(false)
+    , passthrough_codec(0)
     , m_features(f)
 {}
 
@@ -40,6 +43,15 @@ void AudioOutputBackend::onCallback()
     audio->onCallback();
 }
 
+int AudioOutputBackend::pullData(char *data, int bytes)
+{
+    if (!audio) {
+        memset(data, format.isUnsigned() && !format.isFloat() ? 0x80 : 0, bytes);
+        return 0;
+    }
+    return audio->pullData(data, bytes);
+}
+
 
 FACTORY_DEFINE(AudioOutputBackend)
 
@@ -52,6 +64,8 @@ void AudioOutput_RegisterAll()
     // check whether ids are registered automatically
     if (!AudioOutputBackendFactory::registeredIds().empty())
         return;
+    extern void RegisterAudioOutputMixer_Man();
+    RegisterAudioOutputMixer_Man();
 #if QTAV_HAVE(PORTAUDIO)
     extern void RegisterAudioOutputPortAudio_Man();
     RegisterAudioOutputPortAudio_Man();
@@ -60,6 +74,10 @@ void AudioOutput_RegisterAll()
     extern void RegisterAudioOutputOpenAL_Man();
     RegisterAudioOutputOpenAL_Man();
 #endif //QTAV_HAVE(OPENAL)
+#if QTAV_HAVE(AAUDIO)
+    extern void RegisterAudioOutputAAudio_Man();
+    RegisterAudioOutputAAudio_Man();
+#endif //QTAV_HAVE(AAUDIO)
 #if QTAV_HAVE(OPENSL)
     extern void RegisterAudioOutputOpenSL_Man();
     RegisterAudioOutputOpenSL_Man();
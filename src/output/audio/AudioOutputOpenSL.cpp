@@ -22,6 +22,7 @@
 #include "QtAV/private/AudioOutputBackend.h"
 #include <QtCore/QSemaphore>
 #include <QtCore/QThread>
+#include <QtCore/QVector>
 #include <SLES/OpenSLES.h>
 #ifdef Q_OS_ANDROID
 #include <SLES/OpenSLES_Android.h>
@@ -29,6 +30,7 @@
 #endif
 #include "QtAV/private/mkid.h"
 #include "QtAV/private/prepost.h"
+#include "utils/FrameBufferPool.h"
 #include "utils/Logger.h"
 
 namespace QtAV {
@@ -51,6 +53,7 @@ public:
     BufferControl bufferControl() const Q_DECL_OVERRIDE;
     void onCallback() Q_DECL_OVERRIDE;
     bool write(const QByteArray& data) Q_DECL_OVERRIDE;
+    bool writeShared(const QByteArray& data) Q_DECL_OVERRIDE;
     bool play() Q_DECL_OVERRIDE;
     //default return -1. means not the control
     int getPlayedCount() Q_DECL_OVERRIDE;
@@ -64,6 +67,9 @@ public:
     static void bufferQueueCallback(SLBufferQueueItf bufferQueue, void *context);
     static void playCallback(SLPlayItf player, void *ctx, SLuint32 event);
 private:
+    // enqueue data and keep ref in the next slot. sem must be acquired
+    bool enqueue(const char* data, int size, const QByteArray& ref);
+
     SLObjectItf engineObject;
     SLEngineItf engine;
     SLObjectItf m_outputMixObject;
@@ -83,6 +89,10 @@ private:
     // Enqueue does not copy data. We MUST keep the data until it is played out
     int queue_data_write;
     QByteArray queue_data;
+    // buffers enqueued by writeShared(), one slot for each enqueued buffer. at most buffer_count buffers are queued, so the
+    // buffer in the slot to write is already played out
+    QVector<QByteArray> queued;
+    int queued_write;
 };
 
 typedef AudioOutputOpenSL AudioOutputBackendOpenSL;
@@ -173,6 +183,7 @@ AudioOutputOpenSL::AudioOutputOpenSL(QObject *parent)
     , m_notifyInterval(1000)
     , buffers_queued(0)
     , queue_data_write(0)
+    , queued_write(0)
 {
     available = false;
     SL_ENSURE_OK(slCreateEngine(&engineObject, 0, 0, 0, 0, 0));
@@ -226,6 +237,8 @@ void AudioOutputOpenSL::onCallback()
 bool AudioOutputOpenSL::open()
 {
     queue_data.resize(buffer_size*buffer_count);
+    queued.resize(buffer_count);
+    queued_write = 0;
     SLDataLocator_BufferQueue bufferQueueLocator = { SL_DATALOCATOR_BUFFERQUEUE, (SLuint32)buffer_count };
     SLDataFormat_PCM pcmFormat = audioFormatToSL(format);
     SLDataSource audioSrc = { &bufferQueueLocator, &pcmFormat };
@@ -322,6 +335,10 @@ bool AudioOutputOpenSL::close()
     m_bufferQueueItf = NULL;
     queue_data.clear();
     queue_data_write = 0;
+    for (int i = 0; i < queued.size(); ++i)
+        FrameBufferPool::instance().put(queued[i]);
+    queued.clear();
+    queued_write = 0;
     return true;
 }
 
@@ -335,18 +352,38 @@ bool AudioOutputOpenSL::write(const QByteArray& data)
         queue_data_write = 0;
     memcpy((char*)queue_data.constData() + queue_data_write, data.constData(), data.size());
     //qDebug("enqueue %p, queue_data_write: %d", data.constData(), queue_data_write);
+    if (!enqueue(queue_data.constData() + queue_data_write, data.size(), QByteArray()))
+        return false;
+    queue_data_write += data.size();
+    if (queue_data_write == queue_data.size())
+        queue_data_write = 0;
+    return true;
+}
+
+bool AudioOutputOpenSL::writeShared(const QByteArray &data)
+{
+    if (bufferControl() & CountCallback)
+        sem.acquire();
+    // Enqueue() does not copy, so data is played directly
+    return enqueue(data.constData(), data.size(), data);
+}
+
+bool AudioOutputOpenSL::enqueue(const char *data, int size, const QByteArray &ref)
+{
+    if (!queued.isEmpty()) {
+        FrameBufferPool::instance().put(queued[queued_write]);
+        queued[queued_write] = ref;
+        queued_write = (queued_write + 1) % queued.size();
+    }
 #ifdef Q_OS_ANDROID
     if (m_android)
-        SL_ENSURE_OK((*m_bufferQueueItf_android)->Enqueue(m_bufferQueueItf_android, queue_data.constData() + queue_data_write, data.size()), false);
+        SL_ENSURE_OK((*m_bufferQueueItf_android)->Enqueue(m_bufferQueueItf_android, data, size), false);
     else
-        SL_ENSURE_OK((*m_bufferQueueItf)->Enqueue(m_bufferQueueItf, queue_data.constData() + queue_data_write, data.size()), false);
+        SL_ENSURE_OK((*m_bufferQueueItf)->Enqueue(m_bufferQueueItf, data, size), false);
 #else
-    SL_ENSURE_OK((*m_bufferQueueItf)->Enqueue(m_bufferQueueItf, queue_data.constData() + queue_data_write, data.size()), false);
+    SL_ENSURE_OK((*m_bufferQueueItf)->Enqueue(m_bufferQueueItf, data, size), false);
 #endif
     buffers_queued++;
-    queue_data_write += data.size();
-    if (queue_data_write == queue_data.size())
-        queue_data_write = 0;
     return true;
 }
 
@@ -23,6 +23,7 @@
 #include "QtAV/private/AudioOutputBackend.h"
 #include "QtAV/private/mkid.h"
 #include "QtAV/private/prepost.h"
+#include <QtCore/QAtomicInt>
 #include <portaudio.h>
 #include "utils/Logger.h"
 
@@ -39,12 +40,16 @@ public:
     bool close() Q_DECL_FINAL;
     virtual BufferControl bufferControl() const Q_DECL_FINAL;
     virtual bool write(const QByteArray& data) Q_DECL_FINAL;
-    virtual bool play() Q_DECL_FINAL { return true;}
+    virtual bool play() Q_DECL_FINAL;
+    qreal getLatency() Q_DECL_FINAL;
 private:
+    static int streamCallback(const void *input, void *output, unsigned long frameCount, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags, void *userData);
+
     bool initialized;
     PaStreamParameters *outputParameters;
     PaStream *stream;
     double outputLatency;
+    QAtomicInt latency_us; // measured in stream callback
 };
 
 typedef AudioOutputPortAudio AudioOutputBackendPortAudio;
@@ -61,6 +66,8 @@ AudioOutputPortAudio::AudioOutputPortAudio(QObject *parent)
     , initialized(false)
     , outputParameters(new PaStreamParameters)
     , stream(0)
+    , outputLatency(0)
+    , latency_us(-1)
 {
     PaError err = paNoError;
     if ((err = Pa_Initialize()) != paNoError) {
@@ -102,21 +109,49 @@ AudioOutputPortAudio::~AudioOutputPortAudio()
 
 AudioOutputBackend::BufferControl AudioOutputPortAudio::bufferControl() const
 {
-    return Blocking;
+    return Pull;
 }
 
 bool AudioOutputPortAudio::write(const QByteArray& data)
 {
-    if (Pa_IsStreamStopped(stream))
-        Pa_StartStream(stream);
-    PaError err = Pa_WriteStream(stream, data.constData(), data.size()/format.channels()/format.bytesPerSample());
-    if (err == paUnanticipatedHostError) {
-        qWarning("Write portaudio stream error: %s", Pa_GetErrorText(err));
-        return   false;
+    Q_UNUSED(data); // data is pulled in streamCallback()
+    return true;
+}
+
+bool AudioOutputPortAudio::play()
+{
+    if (!Pa_IsStreamStopped(stream))
+        return true;
+    PaError err = Pa_StartStream(stream);
+    if (err != paNoError) {
+        qWarning("Start portaudio stream error: %s", Pa_GetErrorText(err));
+        return false;
     }
     return true;
 }
 
+int AudioOutputPortAudio::streamCallback(const void *input, void *output, unsigned long frameCount, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags, void *userData)
+{
+    Q_UNUSED(input);
+    Q_UNUSED(statusFlags);
+    AudioOutputPortAudio *ao = reinterpret_cast<AudioOutputPortAudio*>(userData);
+    ao->pullData((char*)output, frameCount*ao->format.bytesPerFrame());
+    // the last sample of this buffer is heard at dac time + buffer duration. some host apis do not provide the time
+    if (timeInfo && timeInfo->outputBufferDacTime > 0 && timeInfo->outputBufferDacTime >= timeInfo->currentTime) {
+        const double t = timeInfo->outputBufferDacTime - timeInfo->currentTime + double(frameCount)/double(ao->format.sampleRate());
+        ao->latency_us.fetchAndStoreRelease(int(t*1000000.0));
+    }
+    return paContinue;
+}
+
+qreal AudioOutputPortAudio::getLatency()
+{
+    const int us = latency_us.fetchAndAddAcquire(0);
+    if (us >= 0)
+        return qreal(us)/1000000.0;
+    return stream ? outputLatency : -1;
+}
+
 //TODO: what about planar, int8, int24 etc that FFmpeg or Pa not support?
 static int toPaSampleFormat(AudioFormat::SampleFormat format)
 {
@@ -139,7 +174,16 @@ bool AudioOutputPortAudio::open()
 {
     outputParameters->sampleFormat = toPaSampleFormat(format.sampleFormat());
     outputParameters->channelCount = format.channels();
-    PaError err = Pa_OpenStream(&stream, NULL, outputParameters, format.sampleRate(), 0, paNoFlag, NULL, NULL);
+    const PaDeviceInfo *deviceInfo = Pa_GetDeviceInfo(outputParameters->device);
+    unsigned long frames = paFramesPerBufferUnspecified;
+    if (low_latency) {
+        frames = buffer_size/qMax(format.bytesPerFrame(), 1);
+        outputParameters->suggestedLatency = deviceInfo ? deviceInfo->defaultLowOutputLatency : 0;
+    } else {
+        outputParameters->suggestedLatency = deviceInfo ? deviceInfo->defaultHighOutputLatency : 0;
+    }
+    latency_us.fetchAndStoreRelease(-1);
+    PaError err = Pa_OpenStream(&stream, NULL, outputParameters, format.sampleRate(), frames, paNoFlag, AudioOutputPortAudio::streamCallback, this);
     if (err != paNoError) {
         qWarning("Open portaudio stream error: %s", Pa_GetErrorText(err));
         return false;
@@ -21,10 +21,13 @@
 
 #include "QtAV/private/AudioOutputBackend.h"
 #include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QMetaObject>
+#include <QtCore/QMutex>
 #include <pulse/pulseaudio.h>
 #include "QtAV/private/mkid.h"
 #include "QtAV/private/prepost.h"
+#include "QtAV/private/AVCompat.h"
 #include "utils/Logger.h"
 #ifndef Q_LIKELY
 #define Q_LIKELY(x) (!!(x))
@@ -40,6 +43,7 @@ public:
     QString name() const Q_DECL_FINAL { return QString::fromLatin1(kName);}
     bool isSupported(AudioFormat::SampleFormat sampleFormat) const Q_DECL_FINAL;
     bool isSupported(AudioFormat::ChannelLayout channelLayout) const Q_DECL_FINAL;
+    bool isPassthroughSupported(int codecId) const Q_DECL_FINAL;
     bool open() Q_DECL_FINAL;
     bool close() Q_DECL_FINAL;
 
@@ -47,7 +51,7 @@ protected:
     bool write(const QByteArray& data) Q_DECL_FINAL;
     bool play() Q_DECL_FINAL;
     BufferControl bufferControl() const Q_DECL_FINAL;
-    int getWritableBytes() Q_DECL_FINAL;
+    qreal getLatency() Q_DECL_FINAL;
 
     bool setVolume(qreal value) Q_DECL_FINAL;
     qreal getVolume() const Q_DECL_FINAL;
@@ -63,6 +67,8 @@ private:
     static void writeCallback(pa_stream *s, size_t length, void *userdata);
     static void  successCallback(pa_stream*s, int success, void *userdata);
     static void sinkInfoCallback(struct pa_context *c, const struct pa_sink_input_info *i, int is_last, void *userdata);
+    // record the stream time and written data in mainloop thread, so getLatency() does not lock the mainloop
+    void updateTiming(pa_stream *s);
 
     bool waitPAOperation(pa_operation *op) const {
         if (!op) {
@@ -81,7 +87,12 @@ private:
     pa_context *ctx;
     pa_stream *stream;
     pa_sink_input_info info;
-    size_t writable_size; //has the same effect as pa_stream_writable_size
+    quint64 written; // bytes written by writeCallback(). mainloop thread only
+    QMutex timing_mutex; // guards the following timing snapshot
+    bool timing_valid;
+    pa_usec_t stream_time; // pa_stream_get_time(), interpolated by the server timing info
+    pa_usec_t written_time; // duration of written bytes
+    QElapsedTimer timing_timer; // restarted when the snapshot is taken
 };
 
 typedef AudioOutputPulse AudioOutputBackendPulse;
@@ -218,18 +229,36 @@ void AudioOutputPulse::stateCallback(pa_stream *s, void *userdata)
 
 void AudioOutputPulse::latencyUpdateCallback(pa_stream *s, void *userdata)
 {
-    Q_UNUSED(s);
-    Q_UNUSED(userdata);
+    reinterpret_cast<AudioOutputPulse*>(userdata)->updateTiming(s);
 }
 
 void AudioOutputPulse::writeCallback(pa_stream *s, size_t length, void *userdata)
 {
-    Q_UNUSED(s);
     // length: writable bytes. callback is called pirioddically
     AudioOutputPulse *p = reinterpret_cast<AudioOutputPulse*>(userdata);
-    //qDebug("write callback: %d + %d", p->writable_size, length);
-    p->writable_size = length;
-    p->onCallback();
+    // pull mode. silence is written if not enough data is queued, otherwise the callback will not be called again after underflow
+    void *dst = 0;
+    size_t n = length;
+    if (pa_stream_begin_write(s, &dst, &n) < 0 || !dst)
+        return;
+    p->pullData((char*)dst, (int)n);
+    if (pa_stream_write(s, dst, n, NULL, 0LL, PA_SEEK_RELATIVE) >= 0)
+        p->written += n;
+    p->updateTiming(s);
+}
+
+void AudioOutputPulse::updateTiming(pa_stream *s)
+{
+    pa_usec_t t = 0;
+    if (pa_stream_get_time(s, &t) < 0) // no timing info yet
+        return;
+    const pa_usec_t w = pa_bytes_to_usec(written, pa_stream_get_sample_spec(s));
+    QMutexLocker lock(&timing_mutex);
+    Q_UNUSED(lock);
+    stream_time = t;
+    written_time = w;
+    timing_timer.restart();
+    timing_valid = true;
 }
 
 void AudioOutputPulse::successCallback(pa_stream *s, int success, void *userdata)
@@ -255,7 +284,8 @@ void AudioOutputPulse::sinkInfoCallback(pa_context *c, const pa_sink_input_info
 
 bool AudioOutputPulse::init(const AudioFormat &format)
 {
-    writable_size = 0;
+    written = 0;
+    timing_valid = false;
     loop = pa_threaded_mainloop_new();
     if (pa_threaded_mainloop_start(loop) < 0) {
         qWarning("PulseAudio failed to start mainloop");
@@ -295,7 +325,15 @@ bool AudioOutputPulse::init(const AudioFormat &format)
     // setup format
     pa_format_info *fi = pa_format_info_new();
     fi->encoding = PA_ENCODING_PCM;
-    pa_format_info_set_sample_format(fi, sampleFormatToPulse(format.sampleFormat()));
+    if (passthrough_codec == QTAV_CODEC_ID(AC3))
+        fi->encoding = PA_ENCODING_AC3_IEC61937;
+    else if (passthrough_codec == QTAV_CODEC_ID(EAC3))
+        fi->encoding = PA_ENCODING_EAC3_IEC61937;
+    else if (passthrough_codec == QTAV_CODEC_ID(DTS))
+        fi->encoding = PA_ENCODING_DTS_IEC61937;
+    // sink negotiates the sample format of IEC 61937 streams
+    if (fi->encoding == PA_ENCODING_PCM)
+        pa_format_info_set_sample_format(fi, sampleFormatToPulse(format.sampleFormat()));
     pa_format_info_set_channels(fi, format.channels());
     pa_format_info_set_rate(fi, format.sampleRate());
    // pa_format_info_set_channel_map(fi, NULL); // TODO
@@ -327,8 +365,12 @@ bool AudioOutputPulse::init(const AudioFormat &format)
     ba.prebuf = 1;//(uint32_t)-1; // play as soon as possible
     ba.minreq = (uint32_t)-1;
     ba.fragsize = (uint32_t)-1;
-    // PA_STREAM_NOT_MONOTONIC?
-    pa_stream_flags_t flags = pa_stream_flags_t(PA_STREAM_NOT_MONOTONIC|PA_STREAM_INTERPOLATE_TIMING|PA_STREAM_AUTO_TIMING_UPDATE);
+    // ask the server for the whole latency tlength requested in chunks of minreq, sink latency included. the write callback
+    // is called once per minreq
+    ba.maxlength = (uint32_t)-1;
+    ba.tlength = buffer_size*buffer_count;
+    ba.minreq = buffer_size;
+    pa_stream_flags_t flags = pa_stream_flags_t(PA_STREAM_NOT_MONOTONIC|PA_STREAM_INTERPOLATE_TIMING|PA_STREAM_AUTO_TIMING_UPDATE|PA_STREAM_ADJUST_LATENCY);
     if (pa_stream_connect_playback(stream, NULL /*sink*/, &ba, flags, NULL, NULL) < 0) {
         qWarning("PulseAudio failed: pa_stream_connect_playback");
         return false;
@@ -348,6 +390,14 @@ bool AudioOutputPulse::init(const AudioFormat &format)
         qWarning("PulseAudio stream is suspende");
         return false;
     }
+    // the server may enlarge the requested period
+    const pa_buffer_attr *attr = pa_stream_get_buffer_attr(stream);
+    if (attr && attr->minreq > 0 && attr->minreq != (uint32_t)-1) {
+        const int frame_bytes = qMax(format.bytesPerFrame(), 1);
+        buffer_size = qMax<int>(attr->minreq/frame_bytes, 1)*frame_bytes;
+        buffer_count = qMax<int>(attr->tlength/buffer_size, 2);
+        qDebug("PulseAudio buffer: tlength %u, minreq %u", attr->tlength, attr->minreq);
+    }
     return true;
 }
 
@@ -359,7 +409,10 @@ AudioOutputPulse::AudioOutputPulse(QObject *parent)
     , loop(0)
     , ctx(0)
     , stream(0)
-    , writable_size(0)
+    , written(0)
+    , timing_valid(false)
+    , stream_time(0)
+    , written_time(0)
 {
     //setDeviceFeatures(DeviceFeatures()|SetVolume|SetMute);
 }
@@ -379,6 +432,12 @@ bool AudioOutputPulse::isSupported(AudioFormat::ChannelLayout channelLayout) con
     return true;
 }
 
+bool AudioOutputPulse::isPassthroughSupported(int codecId) const
+{
+    // the stream fails to connect if the sink is not configured for the encoding, then AVPlayer decodes the stream
+    return codecId == QTAV_CODEC_ID(AC3) || codecId == QTAV_CODEC_ID(EAC3) || codecId == QTAV_CODEC_ID(DTS);
+}
+
 bool AudioOutputPulse::open()
 {
     if (!init(format)) {
@@ -419,27 +478,25 @@ bool AudioOutputPulse::close()
 
 AudioOutputBackend::BufferControl AudioOutputPulse::bufferControl() const
 {
-    return BytesCallback;
+    return Pull;
 }
 
-int AudioOutputPulse::getWritableBytes()
+qreal AudioOutputPulse::getLatency()
 {
-    //return writable_size;
-    if (!loop || !stream) {
-        qWarning("pulseaudio is not open");
-        return 0;
-    }
-    ScopedPALocker palock(loop);
-    Q_UNUSED(palock);
-    return pa_stream_writable_size(stream);
+    if (!loop || !stream)
+        return -1;
+    QMutexLocker lock(&timing_mutex);
+    Q_UNUSED(lock);
+    if (!timing_valid)
+        return -1;
+    // the stream time keeps going since the snapshot because silence is written on underflow
+    const qint64 heard = qint64(stream_time) + timing_timer.nsecsElapsed()/1000LL;
+    return qMax<qreal>(qreal(qint64(written_time) - heard)/1000000.0, 0);
 }
 
 bool AudioOutputPulse::write(const QByteArray &data)
 {
-    ScopedPALocker palock(loop);
-    Q_UNUSED(palock);
-    PA_ENSURE_TRUE(pa_stream_write(stream, data.constData(), data.size(), NULL, 0LL, PA_SEEK_RELATIVE) >= 0, false);
-    writable_size -= data.size();
+    Q_UNUSED(data); // data is pulled in writeCallback()
     return true;
 }
 
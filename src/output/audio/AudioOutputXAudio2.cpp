@@ -24,7 +24,9 @@
 #include "QtAV/private/prepost.h"
 #include <QtCore/QLibrary>
 #include <QtCore/QSemaphore>
+#include <QtCore/QVector>
 #include "QtAV/private/AVCompat.h"
+#include "utils/FrameBufferPool.h"
 #include "utils/Logger.h"
 
 #define DX_LOG_COMPONENT "XAudio2"
@@ -50,6 +52,7 @@ public:
     BufferControl bufferControl() const Q_DECL_OVERRIDE;
     void onCallback() Q_DECL_OVERRIDE;
     bool write(const QByteArray& data) Q_DECL_OVERRIDE;
+    bool writeShared(const QByteArray& data) Q_DECL_OVERRIDE;
     bool play() Q_DECL_OVERRIDE;
 
     bool setVolume(qreal value) Q_DECL_OVERRIDE;
@@ -72,6 +75,9 @@ public:
     }
 
 private:
+    // submit data and keep ref in the next slot. sem must be acquired
+    bool submit(const char* data, int size, const QByteArray& ref);
+
     bool xaudio2_winsdk;
     // TODO: com ptr
     IXAudio2SourceVoice* source_voice;
@@ -88,6 +94,9 @@ private:
     QSemaphore sem;
     int queue_data_write;
     QByteArray queue_data;
+    // buffers submitted by writeShared(). at most buffer_count buffers are queued, so the buffer in the slot to write is played out
+    QVector<QByteArray> queued;
+    int queued_write;
 
     QLibrary dll;
 };
@@ -106,6 +115,7 @@ AudioOutputXAudio2::AudioOutputXAudio2(QObject *parent)
     , xaudio2_winsdk(true)
     , source_voice(NULL)
     , queue_data_write(0)
+    , queued_write(0)
 {
     memset(&dxsdk, 0, sizeof(dxsdk));
     available = false;
@@ -209,8 +219,19 @@ bool AudioOutputXAudio2::open()
     }
     DX_ENSURE_OK(source_voice->Start(0, XAUDIO2_COMMIT_NOW), false);
     qDebug("source_voice:%p", source_voice);
+    if (low_latency) {
+        // the engine processes 10ms quantum. a smaller buffer is consumed in 1 pass and the queue underflows
+        const int frame_bytes = qMax(format.bytesPerFrame(), 1);
+        const int quantum = (format.bytesForDuration(10000LL) + frame_bytes - 1)/frame_bytes*frame_bytes;
+        if (buffer_size < quantum) {
+            buffer_count = qMax(2, buffer_size*buffer_count/quantum);
+            buffer_size = quantum;
+        }
+    }
 
     queue_data.resize(buffer_size*buffer_count);
+    queued.resize(buffer_count);
+    queued_write = 0;
     sem.release(buffer_count - sem.available());
     return true;
 }
@@ -242,6 +263,10 @@ bool AudioOutputXAudio2::close()
 
     queue_data.clear();
     queue_data_write = 0;
+    for (int i = 0; i < queued.size(); ++i)
+        FrameBufferPool::instance().put(queued[i]);
+    queued.clear();
+    queued_write = 0;
     return true;
 }
 
@@ -283,15 +308,34 @@ bool AudioOutputXAudio2::write(const QByteArray &data)
     if (s < data.size())
         queue_data_write = 0;
     memcpy((char*)queue_data.constData() + queue_data_write, data.constData(), data.size());
+    const char* buf = queue_data.constData() + queue_data_write;
+    queue_data_write += data.size();
+    if (queue_data_write == queue_data.size())
+        queue_data_write = 0;
+    return submit(buf, data.size(), QByteArray());
+}
+
+bool AudioOutputXAudio2::writeShared(const QByteArray &data)
+{
+    if (bufferControl() & CountCallback)
+        sem.acquire();
+    // SubmitSourceBuffer() does not copy, so data is played directly
+    return submit(data.constData(), data.size(), data);
+}
+
+bool AudioOutputXAudio2::submit(const char *data, int size, const QByteArray &ref)
+{
+    if (!queued.isEmpty()) {
+        FrameBufferPool::instance().put(queued[queued_write]);
+        queued[queued_write] = ref;
+        queued_write = (queued_write + 1) % queued.size();
+    }
     XAUDIO2_BUFFER xb; //IMPORTANT! wrong value(playbegin/length, loopbegin/length) will result in commit sourcebuffer fail
     memset(&xb, 0, sizeof(XAUDIO2_BUFFER));
-    xb.AudioBytes = data.size();
+    xb.AudioBytes = size;
     //xb.Flags = XAUDIO2_END_OF_STREAM;
     xb.pContext = this;
-    xb.pAudioData = (const BYTE*)(queue_data.constData() + queue_data_write);
-    queue_data_write += data.size();
-    if (queue_data_write == queue_data.size())
-        queue_data_write = 0;
+    xb.pAudioData = (const BYTE*)data;
     DX_ENSURE_OK(source_voice->SubmitSourceBuffer(&xb, NULL), false);
     // TODO: XAUDIO2_E_DEVICE_INVALIDATED
     return true;
@@ -29,6 +29,14 @@
 //#define CINTERFACE //http://rxlib.ru/faqs/faqc_en/15596.html
 //#include <windows.h>
 #include <d2d1.h>
+// d3d11 decoded frames are converted and drawn on the decoder device by a d2d 1.1 device context, without copying back.
+// d2d1_1.h is in windows 8 sdk (vs2012)
+#if QTAV_HAVE(D3D11VA) && defined(_MSC_VER) && _MSC_VER >= 1700
+#define QTAV_HAVE_D2D_DXGI 1
+#include <d2d1_1.h>
+#include <d3d11.h>
+#include <dxgi1_2.h>
+#endif
 
 //TODO: why we can link d2d app without it's lib?
 //TODO: only for mingw. why undef?
@@ -116,6 +124,20 @@ public:
       , bitmap_width(0)
       , bitmap_height(0)
       , interpolation(D2D1_BITMAP_INTERPOLATION_MODE_LINEAR)
+      , hwnd(0)
+#if QTAV_HAVE(D2D_DXGI)
+      , d2d_factory1(0)
+      , d2d_mt(0)
+      , d2d_device(0)
+      , device_context(0)
+      , swap_chain(0)
+      , target_bitmap(0)
+      , d3d_device(0)
+      , dx_texture(0)
+      , dx_bitmap(0)
+      , dx_width(0)
+      , dx_height(0)
+#endif
     {
         dll.setFileName(QStringLiteral("d2d1"));
         if (!dll.load()) {
@@ -169,6 +191,9 @@ public:
     }
     ~Direct2DRendererPrivate() {
         destroyDeviceResource();
+#if QTAV_HAVE(D2D_DXGI)
+        SafeRelease(&d2d_factory1);
+#endif
         SafeRelease(&d2d_factory);//vlc does not call this. why? bug?
         dll.unload();
     }
@@ -195,9 +220,10 @@ public:
             (UINT32)p.width(),
             (UINT32)p.height()
         };//d.renderer_width, d.renderer_height?
+        hwnd = (HWND)p.winId();
         // Create a Direct2D render target.
         D2D1_HWND_RENDER_TARGET_PROPERTIES hwnd_rtp = {
-            (HWND)p.winId(),
+            hwnd,
             size,
             //TODO: what do these mean?
             D2D1_PRESENT_OPTIONS_RETAIN_CONTENTS //D2D1_PRESENT_OPTIONS_IMMEDIATELY /* this might need fiddling */
@@ -215,9 +241,171 @@ public:
         return hr == S_OK;
     }
     void destroyDeviceResource() {
+#if QTAV_HAVE(D2D_DXGI)
+        // hwnd may change
+        releaseDXGI();
+#endif
         SafeRelease(&render_target);
         SafeRelease(&bitmap);
     }
+    // the dxgi device context if d3d11 frames are drawn, otherwise the hwnd render target
+    ID2D1RenderTarget* target() const {
+#if QTAV_HAVE(D2D_DXGI)
+        if (device_context)
+            return device_context;
+#endif
+        return render_target;
+    }
+#if QTAV_HAVE(D2D_DXGI)
+    void releaseDeviceContext() {
+        SafeRelease(&dx_bitmap);
+        if (device_context)
+            device_context->SetTarget(NULL);
+        SafeRelease(&target_bitmap);
+        SafeRelease(&device_context);
+        SafeRelease(&swap_chain);
+        SafeRelease(&d2d_device);
+        SafeRelease(&d2d_mt);
+        SafeRelease(&d3d_device);
+    }
+    void releaseDXGI() {
+        releaseDeviceContext();
+        SafeRelease(&dx_texture);
+        dx_width = dx_height = 0;
+    }
+    bool createTargetBitmap() {
+        IDXGISurface *back = NULL;
+        HRESULT hr = swap_chain->GetBuffer(0, __uuidof(IDXGISurface), (void**)&back);
+        if (SUCCEEDED(hr)) {
+            D2D1_BITMAP_PROPERTIES1 bp;
+            bp.pixelFormat.format = DXGI_FORMAT_B8G8R8A8_UNORM;
+            bp.pixelFormat.alphaMode = D2D1_ALPHA_MODE_IGNORE; // hwnd swap chain has no alpha
+            bp.dpiX = bitmap_properties.dpiX;
+            bp.dpiY = bitmap_properties.dpiY;
+            bp.bitmapOptions = D2D1_BITMAP_OPTIONS_TARGET | D2D1_BITMAP_OPTIONS_CANNOT_DRAW;
+            bp.colorContext = NULL;
+            hr = device_context->CreateBitmapFromDxgiSurface(back, &bp, &target_bitmap);
+        }
+        SafeRelease(&back);
+        if (FAILED(hr)) {
+            qWarning("Failed to create d2d target bitmap from swap chain (%#lx)", hr);
+            return false;
+        }
+        device_context->SetTarget(target_bitmap);
+        return true;
+    }
+    // the device context and swap chain must be on the decoder device to draw its textures
+    bool ensureDeviceContext(ID3D11Device *dev) {
+        if (device_context && dev == d3d_device)
+            return true;
+        releaseDeviceContext();
+        if (!d2d_factory1 && FAILED(d2d_factory->QueryInterface(__uuidof(ID2D1Factory1), (void**)&d2d_factory1))) {
+            qWarning("Direct2D 1.1 is not available. d3d11 frames will be copied to host memory");
+            return false;
+        }
+        IDXGIDevice *dxgi_dev = NULL;
+        IDXGIAdapter *adapter = NULL;
+        IDXGIFactory2 *dxgi_factory = NULL;
+        HRESULT hr = dev->QueryInterface(__uuidof(IDXGIDevice), (void**)&dxgi_dev);
+        if (SUCCEEDED(hr))
+            hr = d2d_factory1->CreateDevice(dxgi_dev, &d2d_device);
+        if (SUCCEEDED(hr))
+            hr = d2d_device->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE, &device_context);
+        if (SUCCEEDED(hr))
+            hr = dxgi_dev->GetAdapter(&adapter);
+        if (SUCCEEDED(hr))
+            hr = adapter->GetParent(__uuidof(IDXGIFactory2), (void**)&dxgi_factory);
+        if (SUCCEEDED(hr)) {
+            DXGI_SWAP_CHAIN_DESC1 desc;
+            ZeroMemory(&desc, sizeof(desc)); // 0 width and height: window size
+            desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+            desc.SampleDesc.Count = 1;
+            desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+            desc.BufferCount = 1;
+            // keeps the back buffer like D2D1_PRESENT_OPTIONS_RETAIN_CONTENTS, so background is not drawn for every frame
+            desc.SwapEffect = DXGI_SWAP_EFFECT_SEQUENTIAL;
+            hr = dxgi_factory->CreateSwapChainForHwnd(dev, hwnd, &desc, NULL, NULL, &swap_chain);
+        }
+        SafeRelease(&dxgi_factory);
+        SafeRelease(&adapter);
+        SafeRelease(&dxgi_dev);
+        if (FAILED(hr) || !createTargetBitmap()) {
+            qWarning("Failed to create d2d device context on d3d11 decoder device (%#lx)", hr);
+            releaseDeviceContext();
+            return false;
+        }
+        d3d_device = dev;
+        d3d_device->AddRef();
+        // the video processor uses the immediate context d2d uses
+        d2d_factory1->QueryInterface(__uuidof(ID2D1Multithread), (void**)&d2d_mt);
+        update_background = true;
+        qDebug("Direct2D draws d3d11 textures directly");
+        return true;
+    }
+    void resizeSwapChain() {
+        if (!swap_chain)
+            return;
+        device_context->SetTarget(NULL);
+        SafeRelease(&target_bitmap);
+        const HRESULT hr = swap_chain->ResizeBuffers(0, 0, 0, DXGI_FORMAT_UNKNOWN, 0);
+        if (FAILED(hr) || !createTargetBitmap()) {
+            qWarning("Failed to resize swap chain (%#lx)", hr);
+            releaseDXGI();
+        }
+    }
+    // convert the decoded slice to a BGRA texture on gpu, and wrap it as a d2d bitmap
+    bool receiveDXGI(const VideoFrame& frame) {
+        if (!hwnd)
+            return false;
+        VideoFrame f(frame);
+        if (dx_texture && (dx_width != f.width() || dx_height != f.height())) {
+            SafeRelease(&dx_bitmap);
+            SafeRelease(&dx_texture);
+        }
+        // the decoder may be reopened on another device, then the texture is recreated once
+        for (int i = 0; i < 2; ++i) {
+            if (!dx_texture) {
+                if (!f.createInteropHandle(&dx_texture, DXTextureSurface, 0))
+                    return false;
+                dx_width = f.width();
+                dx_height = f.height();
+            }
+            ID3D11Device *dev = NULL;
+            dx_texture->GetDevice(&dev);
+            const bool ok = ensureDeviceContext(dev);
+            SafeRelease(&dev);
+            if (!ok)
+                return false;
+            if (!dx_bitmap) {
+                IDXGISurface *surface = NULL;
+                if (FAILED(dx_texture->QueryInterface(__uuidof(IDXGISurface), (void**)&surface)))
+                    return false;
+                D2D1_BITMAP_PROPERTIES1 bp;
+                bp.pixelFormat = pixel_format;
+                bp.dpiX = bitmap_properties.dpiX;
+                bp.dpiY = bitmap_properties.dpiY;
+                bp.bitmapOptions = D2D1_BITMAP_OPTIONS_NONE;
+                bp.colorContext = NULL;
+                const HRESULT hr = device_context->CreateBitmapFromDxgiSurface(surface, &bp, &dx_bitmap);
+                SafeRelease(&surface);
+                if (FAILED(hr)) {
+                    qWarning("Failed to create d2d bitmap from d3d11 texture (%#lx)", hr);
+                    return false;
+                }
+            }
+            if (d2d_mt)
+                d2d_mt->Enter();
+            const bool mapped = !!f.map(DXTextureSurface, &dx_texture);
+            if (d2d_mt)
+                d2d_mt->Leave();
+            if (mapped)
+                return true;
+            SafeRelease(&dx_bitmap);
+            SafeRelease(&dx_texture);
+        }
+        return false;
+    }
+#endif //QTAV_HAVE(D2D_DXGI)
     void recreateDeviceResource() {
         qDebug("D2DERR_RECREATE_TARGET");
         QMutexLocker locker(&img_mutex);
@@ -255,6 +443,9 @@ public:
     }
     //it seems that only D2D1_BITMAP_INTERPOLATION_MODE(used in DrawBitmap) matters when drawing an image
     void setupQuality() {
+        ID2D1RenderTarget *render_target = target();
+        if (!render_target)
+            return;
         switch (quality) {
         case VideoRenderer::QualityFastest:
             interpolation = D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR;
@@ -282,6 +473,19 @@ public:
     int bitmap_width, bitmap_height; //can not use src_width, src height because bitmap not update when they changes
     D2D1_BITMAP_INTERPOLATION_MODE interpolation;
     QLibrary dll;
+    HWND hwnd;
+#if QTAV_HAVE(D2D_DXGI)
+    ID2D1Factory1 *d2d_factory1;
+    ID2D1Multithread *d2d_mt;
+    ID2D1Device *d2d_device;
+    ID2D1DeviceContext *device_context;
+    IDXGISwapChain1 *swap_chain;
+    ID2D1Bitmap1 *target_bitmap;
+    ID3D11Device *d3d_device; // the decoder device of the current frames
+    ID3D11Texture2D *dx_texture; // video processor output on d3d_device
+    ID2D1Bitmap1 *dx_bitmap; // dxgi surface of dx_texture
+    int dx_width, dx_height;
+#endif
 };
 
 Direct2DRenderer::Direct2DRenderer(QWidget *parent, Qt::WindowFlags f):
@@ -311,6 +515,20 @@ bool Direct2DRenderer::receiveFrame(const VideoFrame& frame)
     if (!frame.isValid())
         return false;
     DPTR_D(Direct2DRenderer);
+#if QTAV_HAVE(D2D_DXGI)
+    if (!frame.hasHostData()) {
+        if (d.receiveDXGI(frame)) {
+            d.video_frame = frame;
+            update();
+            return true;
+        }
+    }
+    // host frames are drawn by the hwnd render target
+    if (d.device_context) {
+        d.releaseDXGI();
+        d.update_background = true;
+    }
+#endif
     if (!d.prepareBitmap(frame.width(), frame.height()))
         return false;
     HRESULT hr = S_OK;
@@ -348,7 +566,7 @@ void Direct2DRenderer::drawBackground()
 {
     DPTR_D(Direct2DRenderer);
     D2D1_COLOR_F c = {0, 0, 0, 255};
-    d.render_target->Clear(&c); //const D2D1_COlOR_F&?
+    d.target()->Clear(&c); //const D2D1_COlOR_F&?
 //http://msdn.microsoft.com/en-us/library/windows/desktop/dd535473(v=vs.85).aspx
     //ID2D1SolidColorBrush *brush;
     //d.render_target->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), &brush);
@@ -376,8 +594,15 @@ void Direct2DRenderer::drawFrame()
         (FLOAT)roi.right(),
         (FLOAT)roi.bottom()
     };
+    ID2D1Bitmap *bitmap = d.bitmap;
+#if QTAV_HAVE(D2D_DXGI)
+    if (d.device_context)
+        bitmap = d.dx_bitmap;
+#endif
+    if (!bitmap)
+        return;
     //d.render_target->SetTransform
-    d.render_target->DrawBitmap(d.bitmap
+    d.target()->DrawBitmap(bitmap
                                 , &out_rect
                                 , 1 //opacity
                                 , d.interpolation
@@ -387,20 +612,48 @@ void Direct2DRenderer::drawFrame()
 void Direct2DRenderer::paintEvent(QPaintEvent *)
 {
     DPTR_D(Direct2DRenderer);
-    if (!d.render_target) {
+    // the dxgi device context can be released in AVThread when frames change to host memory
+    ID2D1RenderTarget *render_target = 0;
+#if QTAV_HAVE(D2D_DXGI)
+    IDXGISwapChain1 *swap_chain = 0;
+#endif
+    {
+        QMutexLocker locker(&d.img_mutex);
+        Q_UNUSED(locker);
+        render_target = d.target();
+        if (render_target)
+            render_target->AddRef();
+#if QTAV_HAVE(D2D_DXGI)
+        swap_chain = d.swap_chain;
+        if (swap_chain)
+            swap_chain->AddRef();
+#endif
+    }
+    if (!render_target) {
         qWarning("No render target!!!");
         return;
     }
     //http://www.daimakuai.net/?page_id=1574
-    d.render_target->BeginDraw();
+    render_target->BeginDraw();
     handlePaintEvent();
     HRESULT hr = S_OK;
     {
         //if d2d factory is D2D1_FACTORY_TYPE_SINGLE_THREADED, we need to lock
         //QMutexLocker locker(&d.img_mutex);
         //Q_UNUSED(locker);
-        hr = d.render_target->EndDraw(NULL, NULL); //TODO: why it need lock? otherwise crash
+        hr = render_target->EndDraw(NULL, NULL); //TODO: why it need lock? otherwise crash
     }
+#if QTAV_HAVE(D2D_DXGI)
+    if (swap_chain) {
+        if (SUCCEEDED(hr)) {
+            hr = swap_chain->Present(1, 0);
+            if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET)
+                hr = D2DERR_RECREATE_TARGET;
+        }
+        SafeRelease(&swap_chain);
+    }
+#endif
+    SafeRelease(&render_target);
     if (hr == D2DERR_RECREATE_TARGET) {
         d.recreateDeviceResource();
     }
@@ -421,6 +674,13 @@ void Direct2DRenderer::resizeEvent(QResizeEvent *e)
         // EndDraw.
         d.render_target->Resize(&size); //D2D1_SIZE_U&?
     }
+#if QTAV_HAVE(D2D_DXGI)
+    {
+        QMutexLocker locker(&d.img_mutex);
+        Q_UNUSED(locker);
+        d.resizeSwapChain();
+    }
+#endif
     update();
 }
 
@@ -0,0 +1,181 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/private/FrameTimingOverlay.h"
+#include <string.h>
+#include <QtGui/QPainter>
+#include "QtAV/Statistics.h"
+#include "QtAV/VideoFrame.h"
+
+namespace QtAV {
+
+static const qreal kMaxIntervalMs = 1000.0; // longer intervals are pauses or seeks
+static const qreal kGraphMs = 50.0; // full scale of the graph
+static const int kStep = 2; // pixels per frame
+
+FrameTimingOverlay::FrameTimingOverlay(int frames)
+    : m_enabled(false)
+    , m_frames(0)
+    , m_stutters(0)
+    , m_pending(false)
+    , m_drawn_ts(-1)
+    , m_presented_ts(-1)
+    , m_presented_ns(0)
+    , m_next(0)
+{
+    memset(&m_sample, 0, sizeof(m_sample));
+    m_clock.start();
+    setFrames(frames);
+    static const bool enable = qgetenv("QTAV_FRAME_TIMING").toInt() > 0;
+    setEnabled(enable);
+}
+
+void FrameTimingOverlay::setEnabled(bool value)
+{
+    m_enabled = value;
+    // not turned off, others may use tracing
+    if (value)
+        Statistics::setLatencyTracing(true);
+}
+
+bool FrameTimingOverlay::isEnabled() const
+{
+    return m_enabled;
+}
+
+void FrameTimingOverlay::setFrames(int value)
+{
+    value = qMax(2, value);
+    if (value == m_frames)
+        return;
+    m_frames = value;
+    m_samples.clear();
+    m_samples.reserve(value);
+    m_next = 0;
+}
+
+int FrameTimingOverlay::frames() const
+{
+    return m_frames;
+}
+
+void FrameTimingOverlay::frameDrawn(const VideoFrame &frame, qreal uploadMs, qreal drawMs)
+{
+    if (!frame.isValid())
+        return;
+    const qreal ts = frame.timestamp();
+    if (ts == m_drawn_ts)
+        return;
+    m_drawn_ts = ts;
+    m_pending = true;
+    m_sample.ms[Decode] = m_enabled ? qreal(frame.sideData(Frame::DecodeDuration))/1000.0 : 0;
+    m_sample.ms[Upload] = uploadMs;
+    m_sample.ms[Draw] = drawMs;
+    m_sample.ms[Present] = 0;
+    m_sample.duration = 0;
+    m_sample.stutter = false;
+}
+
+bool FrameTimingOverlay::framePresented(qreal vsyncInterval)
+{
+    if (!m_pending)
+        return false;
+    m_pending = false;
+    const qint64 now = m_clock.nsecsElapsed();
+    const qreal interval = m_presented_ns > 0 ? qreal(now - m_presented_ns)/1e6 : 0;
+    const qreal duration = m_presented_ts >= 0 ? (m_drawn_ts - m_presented_ts)*1000.0 : 0;
+    m_presented_ns = now;
+    m_presented_ts = m_drawn_ts;
+    m_sample.ms[Present] = interval;
+    if (interval > 0 && interval < kMaxIntervalMs && duration > 0 && duration < kMaxIntervalMs) {
+        m_sample.duration = duration;
+        const qreal tolerance = vsyncInterval > 0 ? vsyncInterval*750.0 : duration*0.5;
+        m_sample.stutter = qAbs(interval - duration) > tolerance;
+        if (m_sample.stutter)
+            ++m_stutters;
+    }
+    if (m_samples.size() < m_frames) {
+        m_samples.append(m_sample);
+    } else {
+        m_samples[m_next] = m_sample;
+        m_next = (m_next + 1) % m_frames;
+    }
+    return m_sample.stutter;
+}
+
+int FrameTimingOverlay::stutters() const
+{
+    return m_stutters;
+}
+
+void FrameTimingOverlay::draw(QPainter *painter, const QRect &viewport) const
+{
+    if (!painter || m_samples.isEmpty())
+        return;
+    static const QColor colors[ItemCount] = { QColor(Qt::yellow), QColor(Qt::cyan), QColor(Qt::magenta), QColor(Qt::white) };
+    static const char* const names[ItemCount] = { "decode", "upload", "draw", "present" };
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing, false);
+    const int text_h = painter->fontMetrics().height();
+    const QRect box(viewport.left() + 8, viewport.top() + 8, m_frames*kStep + 8, 100 + 12 + text_h);
+    const QRect g(box.left() + 4, box.top() + 4, m_frames*kStep, 100);
+    painter->fillRect(box, QColor(0, 0, 0, 160));
+#define GRAPH_Y(ms) (qreal(g.bottom()) - qMin<qreal>(ms, kGraphMs)*qreal(g.height())/kGraphMs)
+    painter->setPen(QColor(255, 255, 255, 64));
+    painter->drawLine(QPointF(g.left(), GRAPH_Y(1000.0/60.0)), QPointF(g.right(), GRAPH_Y(1000.0/60.0)));
+    painter->drawLine(QPointF(g.left(), GRAPH_Y(1000.0/30.0)), QPointF(g.right(), GRAPH_Y(1000.0/30.0)));
+    const int n = m_samples.size();
+    const int first = n < m_frames ? 0 : m_next; // oldest
+    QVector<QPointF> points[ItemCount + 1]; // + content frame duration
+    painter->setPen(QColor(255, 0, 0, 192));
+    for (int i = 0; i < n; ++i) {
+        const Sample &s = m_samples[(first + i) % n];
+        const qreal x = g.left() + i*kStep;
+        if (s.stutter)
+            painter->drawLine(QPointF(x, g.top()), QPointF(x, g.bottom()));
+        for (int k = 0; k < ItemCount; ++k)
+            points[k].append(QPointF(x, GRAPH_Y(s.ms[k])));
+        if (s.duration > 0)
+            points[ItemCount].append(QPointF(x, GRAPH_Y(s.duration)));
+    }
+    painter->setPen(QPen(QColor(128, 128, 128), 1, Qt::DashLine));
+    painter->drawPolyline(points[ItemCount].constData(), points[ItemCount].size());
+    for (int k = 0; k < ItemCount; ++k) {
+        painter->setPen(colors[k]);
+        painter->drawPolyline(points[k].constData(), points[k].size());
+    }
+#undef GRAPH_Y
+    // values of the last frame
+    const Sample &last = m_samples[(first + n - 1) % n];
+    int x = g.left();
+    const int y = g.bottom() + 4 + painter->fontMetrics().ascent();
+    for (int k = 0; k < ItemCount; ++k) {
+        const QString text(QStringLiteral("%1 %2 ").arg(QLatin1String(names[k])).arg(last.ms[k], 0, 'f', 1));
+        painter->setPen(colors[k]);
+        painter->drawText(x, y, text);
+        x += painter->fontMetrics().width(text);
+    }
+    painter->setPen(m_stutters > 0 ? QColor(Qt::red) : QColor(Qt::white));
+    painter->drawText(x, y, QStringLiteral("ms stutters %1").arg(m_stutters));
+    painter->restore();
+}
+
+} //namespace QtAV
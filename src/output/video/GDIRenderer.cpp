@@ -192,6 +192,8 @@ public:
     HDC        off_dc;
     HBITMAP    off_bitmap;
 #endif //USE_GRAPHICS
+    VideoFrame scaled_frame; // RGB32 in out_rect size
+    QRect scaled_roi; // region of video_frame scaled_frame is scaled from. null: not scaled
 };
 
 GDIRenderer::GDIRenderer(QWidget *parent, Qt::WindowFlags f):
@@ -225,9 +227,24 @@ QPaintEngine* GDIRenderer::paintEngine() const
 bool GDIRenderer::receiveFrame(const VideoFrame& frame)
 {
     DPTR_D(GDIRenderer);
-    if (frame.constBits(0))
-        d.video_frame = frame;
-    else
+    d.scaled_frame = VideoFrame();
+    d.scaled_roi = QRect();
+    /*
+     * StretchBlt scales on cpu for every paint, and GetHBITMAP copies the frame. scale to the output size and convert
+     * to RGB32(BI_RGB) in 1 pass by ImageConverter(SIMD) here, then the frame memory is blitted 1:1
+     * video_frame is the source frame, realROI() depends on it
+     */
+    d.video_frame = frame;
+    if (d.out_rect.isValid()) {
+        const QRect roi = realROI();
+        d.scaled_frame = frame.to(VideoFormat::Format_RGB32, d.out_rect.size(), roi);
+        if (d.scaled_frame.isValid()) {
+            d.scaled_roi = roi;
+            update();
+            return true;
+        }
+    }
+    if (!frame.constBits(0))
         d.video_frame = frame.to(frame.pixelFormat());
     update();
     return true;
@@ -255,9 +272,27 @@ void GDIRenderer::drawFrame()
      * Improving Performance by Avoiding Automatic Scaling
      * TODO: How about QPainter?
      */
+    const bool scaled = !d.scaled_roi.isNull();
+    const VideoFrame &frame = scaled ? d.scaled_frame : d.video_frame;
+    if (scaled && frame.size() == d.out_rect.size()) {
+        BITMAPINFO bmi;
+        ZeroMemory(&bmi, sizeof(bmi));
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = frame.bytesPerLine(0)/4;
+        bmi.bmiHeader.biHeight = -frame.height(); // top-down
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+        SetDIBitsToDevice(d.device_context
+                          , d.out_rect.left(), d.out_rect.top()
+                          , frame.width(), frame.height()
+                          , 0, 0, 0, frame.height()
+                          , frame.constBits(0), &bmi, DIB_RGB_COLORS);
+        return;
+    }
     //steps to use BitBlt: http://bbs.csdn.net/topics/60183502
-    Bitmap bitmap(d.video_frame.width(), d.video_frame.height(), d.video_frame.bytesPerLine(0)
-                  , PixelFormat32bppRGB, (BYTE*)d.video_frame.constBits(0));
+    Bitmap bitmap(frame.width(), frame.height(), frame.bytesPerLine(0)
+                  , PixelFormat32bppRGB, (BYTE*)frame.constBits(0));
 #if USE_GRAPHICS
     if (d.graphics)
         d.graphics->DrawImage(&bitmap, d.out_rect.x(), d.out_rect.y(), d.out_rect.width(), d.out_rect.height());
@@ -268,7 +303,8 @@ void GDIRenderer::drawFrame()
     }
     HDC hdc = d.device_context;
     HBITMAP hbmp_old = (HBITMAP)SelectObject(d.off_dc, d.off_bitmap);
-    QRect roi = realROI();
+    // out_rect may be changed by resizing before the next frame
+    QRect roi = scaled ? QRect(QPoint(), frame.size()) : realROI();
     // && image.size() != size()
     //assume that the image data is already scaled to out_size(NOT renderer size!)
         StretchBlt(hdc
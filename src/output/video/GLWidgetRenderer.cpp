@@ -34,14 +34,6 @@
 //TODO: check gl errors
 //glEGLImageTargetTexture2DOES:http://software.intel.com/en-us/articles/using-opengl-es-to-accelerate-apps-with-legacy-2d-guis
 
-
-//#ifdef GL_EXT_unpack_subimage
-#ifndef GL_UNPACK_ROW_LENGTH
-#ifdef GL_UNPACK_ROW_LENGTH_EXT
-#define GL_UNPACK_ROW_LENGTH GL_UNPACK_ROW_LENGTH_EXT
-#endif //GL_UNPACK_ROW_LENGTH_EXT
-#endif //GL_UNPACK_ROW_LENGTH
-
 #include "QtAV/ColorTransform.h"
 #include "QtAV/FilterContext.h"
 
@@ -693,9 +685,6 @@ void GLWidgetRendererPrivate::uploadPlane(int p, GLint internalFormat, GLenum fo
     glBindTexture(GL_TEXTURE_2D, textures[p]);
     ////nv12: 2
     //glPixelStorei(GL_UNPACK_ALIGNMENT, 1);//GetAlign(video_frame.bytesPerLine(p)));
-#if defined(GL_UNPACK_ROW_LENGTH)
-//    glPixelStorei(GL_UNPACK_ROW_LENGTH, video_frame.bytesPerLine(p));
-#endif
     //qDebug("bpl[%d]=%d width=%d", p, video_frame.bytesPerLine(p), video_frame.planeWidth(p));
     // This is necessary for non-power-of-two textures
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -705,21 +694,18 @@ void GLWidgetRendererPrivate::uploadPlane(int p, GLint internalFormat, GLenum fo
     //FIXME: more cpu usage then qpainter. FBO, VBO?
     //roi for planes?
     if (ROI_TEXCOORDS || roi.size() == video_frame.size()) {
-        glTexSubImage2D(GL_TEXTURE_2D
-                     , 0                //level
-                     , 0                // xoffset
-                     , 0                // yoffset
+        OpenGLHelper::texSubImage2D(GL_TEXTURE_2D, 0, 0
                      , texture_upload_size[p].width()
                      , texture_upload_size[p].height()
                      , format          //format, must the same as internal format?
                      , data_type[p]
-                     , video_frame.bits(p));
+                     , video_frame.bits(p)
+                     , video_frame.bytesPerLine(p));
     } else {
         int roi_x = roi.x();
         int roi_y = roi.y();
         int roi_w = roi.width();
         int roi_h = roi.height();
-        int plane_w = video_frame.planeWidth(p);
         VideoFormat fmt = video_frame.format();
         if (p == 0) {
             plane0Size = QSize(roi_w, roi_h); //
@@ -730,45 +716,12 @@ void GLWidgetRendererPrivate::uploadPlane(int p, GLint internalFormat, GLenum fo
             roi_h = fmt.chromaHeight(roi_h);
         }
         qDebug("roi: %d, %d %dx%d", roi_x, roi_y, roi_w, roi_h);
-#if 0// defined(GL_UNPACK_ROW_LENGTH) && defined(GL_UNPACK_SKIP_PIXELS)
-// http://stackoverflow.com/questions/205522/opengl-subtexturing
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, plane_w);
-        //glPixelStorei or compute pointer
-        glPixelStorei(GL_UNPACK_SKIP_PIXELS, roi_x);
-        glPixelStorei(GL_UNPACK_SKIP_ROWS, roi_y);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, roi_w, roi_h, 0, format, GL_UNSIGNED_BYTE, video_frame.bits(p));
-        //glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, roi_w, roi_h, format, GL_UNSIGNED_BYTE, video_frame.bits(p));
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
-        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
-#else // GL ES
-//define it? or any efficient way?
-        //glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, roi_w, roi_h, 0, format, GL_UNSIGNED_BYTE, NULL);
-        const char *src = (char*)video_frame.bits(p) + roi_y*plane_w + roi_x*fmt.bytesPerPixel(p);
-#define UPLOAD_LINE 1
-#if UPLOAD_LINE
-        for (int y = 0; y < roi_h; y++) {
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, roi_w, 1, format, GL_UNSIGNED_BYTE, src);
-        }
-#else
-        int line_size = roi_w*fmt.bytesPerPixel(p);
-        char *sub = (char*)malloc(roi_h*line_size);
-        char *dst = sub;
-        for (int y = 0; y < roi_h; y++) {
-            memcpy(dst, src, line_size);
-            src += video_frame.bytesPerLine(p);
-            dst += line_size;
-        }
-        // FIXME: crash
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, roi_w, roi_h, format, GL_UNSIGNED_BYTE, sub);
-        free(sub);
-#endif //UPLOAD_LINE
-#endif //GL_UNPACK_ROW_LENGTH
+        // http://stackoverflow.com/questions/205522/opengl-subtexturing
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, roi_w, roi_h, 0, format, data_type[p], NULL);
+        const char *src = (const char*)video_frame.constBits(p) + roi_y*video_frame.bytesPerLine(p) + roi_x*fmt.bytesPerPixel(p);
+        // 1 call with GL_UNPACK_ROW_LENGTH if supported, otherwise line by line
+        OpenGLHelper::texSubImage2D(GL_TEXTURE_2D, 0, 0, roi_w, roi_h, format, data_type[p], src, video_frame.bytesPerLine(p));
     }
-#if defined(GL_UNPACK_ROW_LENGTH)
-//    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-#endif
     //glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
@@ -22,8 +22,12 @@
 #include "QtAV/OpenGLRendererBase.h"
 #include "QtAV/private/OpenGLRendererBase_p.h"
 #include "QtAV/OpenGLVideo.h"
+#include "QtAV/Filter.h"
 #include "QtAV/FilterContext.h"
+#include "QtAV/Statistics.h"
+#include "QtAV/TraceRecorder.h"
 #include <QResizeEvent>
+#include <string.h>
 #include "utils/OpenGLHelper.h"
 #include "utils/Logger.h"
 
@@ -31,10 +35,19 @@ namespace QtAV {
 
 OpenGLRendererBasePrivate::OpenGLRendererBasePrivate(QPaintDevice* pd)
     : painter(new QPainter())
+    , damaged(true)
+    , cache_valid(false)
+    , latency_sent(0)
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    , cache_fbo(0)
+    , capture_read(0)
+    , capture_write(0)
+#endif
 {
     filter_context = VideoFilterContext::create(VideoFilterContext::QtPainter);
     filter_context->paint_device = pd;
     filter_context->painter = painter;
+    filter_context->opengl = &glv;
 }
 
 OpenGLRendererBasePrivate::~OpenGLRendererBasePrivate() {
@@ -46,12 +59,190 @@ OpenGLRendererBasePrivate::~OpenGLRendererBasePrivate() {
 
 void OpenGLRendererBasePrivate::setupAspectRatio()
 {
+    damaged = true;
     matrix.setToIdentity();
     matrix.scale((GLfloat)out_rect.width()/(GLfloat)renderer_width, (GLfloat)out_rect.height()/(GLfloat)renderer_height, 1);
     if (orientation)
         matrix.rotate(orientation, 0, 0, 1); // Z axis
 }
 
+bool OpenGLRendererBasePrivate::drawCache()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (!cache_valid || !cache_fbo)
+        return false;
+    GLint vp[4];
+    DYGL(glGetIntegerv(GL_VIEWPORT, vp));
+    const QRect rect(vp[0], vp[1], vp[2], vp[3]);
+    if (rect.size() != cache_fbo->size()) {
+        cache_valid = false;
+        return false;
+    }
+    // target 0: the default framebuffer of context, also correct for QOpenGLWidget
+    QOpenGLFramebufferObject::blitFramebuffer(0, rect, cache_fbo, QRect(QPoint(), cache_fbo->size()));
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool OpenGLRendererBasePrivate::prepareCache()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (!QOpenGLFramebufferObject::hasOpenGLFramebufferBlit())
+        return false;
+    GLint vp[4];
+    DYGL(glGetIntegerv(GL_VIEWPORT, vp));
+    const QSize size(vp[2], vp[3]);
+    if (size.isEmpty())
+        return false;
+    if (cache_fbo && cache_fbo->size() != size)
+        releaseCache();
+    if (!cache_fbo)
+        cache_fbo = new QOpenGLFramebufferObject(size);
+    return cache_fbo->isValid();
+#else
+    return false;
+#endif
+}
+
+void OpenGLRendererBasePrivate::releaseCache()
+{
+    cache_valid = false;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (!cache_fbo)
+        return;
+    delete cache_fbo;
+    cache_fbo = 0;
+#endif
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+static const uchar* mapPackBuffer(QOpenGLBuffer *pbo)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
+    if (OpenGLHelper::isOpenGLES())
+        return (const uchar*)pbo->mapRange(0, pbo->size(), QOpenGLBuffer::RangeRead);
+#endif
+    if (OpenGLHelper::isOpenGLES())
+        return 0;
+    return (const uchar*)pbo->map(QOpenGLBuffer::ReadOnly);
+}
+
+// rows of src are bottom up
+static VideoFrame captureToFrame(const uchar *src, const QSize &size, qreal timestamp)
+{
+    // opengl es can only read GL_RGBA
+    const VideoFormat fmt(OpenGLHelper::isOpenGLES() ? VideoFormat::Format_RGBA32 : VideoFormat::Format_BGRA32);
+    const int pitch = size.width()*4;
+    QByteArray data(pitch*size.height(), Qt::Uninitialized);
+    for (int y = 0; y < size.height(); ++y)
+        memcpy(data.data() + y*pitch, src + (size.height() - 1 - y)*pitch, pitch);
+    VideoFrame f(data, size.width(), size.height(), fmt);
+    f.setBits((uchar*)data.constData(), 0);
+    f.setBytesPerLine(pitch, 0);
+    f.setColorSpace(ColorSpace_RGB);
+    f.setTimestamp(timestamp);
+    return f;
+}
+#endif //QT_VERSION
+
+void OpenGLRendererBasePrivate::capture(bool newFrame)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    // buffers are used only in the rendering thread. the filter may emit signals and change capture filter when applied
+    VideoFilter *filter = 0;
+    {
+        QMutexLocker lock(&capture_mutex);
+        Q_UNUSED(lock);
+        filter = capture_filter;
+    }
+    if (!filter) {
+        releaseCapture();
+        return;
+    }
+    // deliver in order. stop at the first readback not finished, the render loop never waits for gpu
+    while (capture_buffers[capture_read].busy) {
+        CaptureBuffer &b = capture_buffers[capture_read];
+        if (!OpenGLHelper::isSyncSignaled(b.fence))
+            break;
+        OpenGLHelper::deleteSync(b.fence);
+        b.fence = 0;
+        b.busy = false;
+        capture_read = (capture_read + 1) % 3;
+        if (!b.pbo.bind())
+            continue;
+        const uchar *src = mapPackBuffer(&b.pbo);
+        if (src) {
+            VideoFrame f(captureToFrame(src, b.size, b.timestamp));
+            b.pbo.unmap();
+            b.pbo.release();
+            filter->apply(statistics, &f);
+        } else {
+            b.pbo.release();
+        }
+    }
+    if (!newFrame)
+        return;
+    GLint vp[4];
+    DYGL(glGetIntegerv(GL_VIEWPORT, vp));
+    const QSize size(vp[2], vp[3]);
+    if (size.isEmpty())
+        return;
+    const GLenum gl_fmt = OpenGLHelper::isOpenGLES() ? GL_RGBA : GL_BGRA;
+    DYGL(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+    // es2: no pixel pack buffer. read synchronously
+    const QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (OpenGLHelper::isOpenGLES() && (ctx->format().majorVersion() < 3 || QT_VERSION < QT_VERSION_CHECK(5, 4, 0))) {
+        QByteArray buf(size.width()*size.height()*4, Qt::Uninitialized);
+        DYGL(glReadPixels(vp[0], vp[1], size.width(), size.height(), gl_fmt, GL_UNSIGNED_BYTE, buf.data()));
+        VideoFrame f(captureToFrame((const uchar*)buf.constData(), size, video_frame.timestamp()));
+        filter->apply(statistics, &f);
+        return;
+    }
+    CaptureBuffer &b = capture_buffers[capture_write];
+    if (b.busy) { // the ring is full, i.e. gpu is 3 frames behind. drop this frame
+        qDebug("capture buffers are busy. frame @%.3f is not captured", video_frame.timestamp());
+        return;
+    }
+    if (!b.pbo.isCreated()) {
+        if (!b.pbo.create())
+            return;
+        b.pbo.setUsagePattern(QOpenGLBuffer::StreamRead);
+    }
+    if (!b.pbo.bind())
+        return;
+    if (b.pbo.size() != size.width()*size.height()*4)
+        b.pbo.allocate(size.width()*size.height()*4);
+    // returns without waiting for the rendering, the copy is done by gpu. no fence: mapped in the next paint
+    DYGL(glReadPixels(vp[0], vp[1], size.width(), size.height(), gl_fmt, GL_UNSIGNED_BYTE, 0));
+    b.pbo.release();
+    b.fence = OpenGLHelper::fenceSync();
+    b.busy = true;
+    b.size = size;
+    b.timestamp = video_frame.timestamp();
+    capture_write = (capture_write + 1) % 3;
+#else
+    Q_UNUSED(newFrame);
+#endif //QT_VERSION
+}
+
+void OpenGLRendererBasePrivate::releaseCapture()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    for (int i = 0; i < 3; ++i) {
+        CaptureBuffer &b = capture_buffers[i];
+        if (b.fence)
+            OpenGLHelper::deleteSync(b.fence);
+        b.fence = 0;
+        b.busy = false;
+        if (b.pbo.isCreated())
+            b.pbo.destroy();
+    }
+    capture_read = capture_write = 0;
+#endif
+}
+
 OpenGLRendererBase::OpenGLRendererBase(OpenGLRendererBasePrivate &d)
     : VideoRenderer(d)
 {
@@ -60,6 +251,8 @@ OpenGLRendererBase::OpenGLRendererBase(OpenGLRendererBasePrivate &d)
 
 OpenGLRendererBase::~OpenGLRendererBase()
 {
+   d_func().releaseCache();
+   d_func().releaseCapture();
    d_func().glv.setOpenGLContext(0);
 }
 
@@ -68,13 +261,49 @@ bool OpenGLRendererBase::isSupported(VideoFormat::PixelFormat pixfmt) const
     return OpenGLVideo::isSupported(pixfmt);
 }
 
+OpenGLVideo* OpenGLRendererBase::opengl() const
+{
+    return const_cast<OpenGLVideo*>(&d_func().glv);
+}
+
+void OpenGLRendererBase::setFrameTimingOverlay(bool value)
+{
+    DPTR_D(OpenGLRendererBase);
+    if (d.timing.isEnabled() == value)
+        return;
+    d.timing.setEnabled(value);
+    updateUi();
+}
+
+bool OpenGLRendererBase::isFrameTimingOverlay() const
+{
+    return d_func().timing.isEnabled();
+}
+
+void OpenGLRendererBase::setCaptureFilter(VideoFilter *filter)
+{
+    DPTR_D(OpenGLRendererBase);
+    QMutexLocker lock(&d.capture_mutex);
+    Q_UNUSED(lock);
+    d.capture_filter = filter;
+    // buffers are released in the rendering thread by the next paint
+}
+
+VideoFilter* OpenGLRendererBase::captureFilter() const
+{
+    return d_func().capture_filter;
+}
+
 bool OpenGLRendererBase::receiveFrame(const VideoFrame& frame)
 {
     DPTR_D(OpenGLRendererBase);
     d.video_frame = frame;
+    d.damaged = true;
+    d.capture_pending = 1;
 
     d.glv.setCurrentFrame(frame);
-
+    if (d.glv.isAsyncUpload()) // updated by OpenGLVideo::frameUploaded()
+        return true;
     onUpdate(); //can not call updateGL() directly because no event and paintGL() will in video thread
     return true;
 }
@@ -92,10 +321,41 @@ void OpenGLRendererBase::drawBackground()
 void OpenGLRendererBase::drawFrame()
 {
     DPTR_D(OpenGLRendererBase);
+    TraceRecorder::Span span("draw", "render");
+    QElapsedTimer draw_timer;
+    draw_timer.start();
     QRect roi = realROI();
+    if (roi != d.cache_roi) {
+        d.cache_roi = roi;
+        d.damaged = true;
+    }
+    // glsl filter parameters may change between repaints
+    if (!d.glv.filters().isEmpty())
+        d.damaged = true;
+    if (!d.damaged && d.drawCache())
+        return;
+    // the 2nd paint of the same content. draw into the cache so later repaints are only a blit
+    const bool to_cache = !d.damaged && !d.glv.isAsyncUpload() && d.prepareCache();
+    d.damaged = false;
+    d.cache_valid = false;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (to_cache) {
+        d.cache_fbo->bind();
+        d.glv.fill(QColor(Qt::black));
+        d.glv.render(QRectF(), roi, d.matrix);
+        d.cache_fbo->bindDefault();
+        d.cache_valid = true;
+        d.drawCache();
+        d.timing.frameDrawn(d.video_frame, d.glv.uploadTime(), qreal(draw_timer.nsecsElapsed())/1e6);
+        return;
+    }
+#else
+    Q_UNUSED(to_cache);
+#endif
     //d.glv.render(QRectF(-1, 1, 2, -2), roi, d.matrix);
     // QRectF() means the whole viewport
     d.glv.render(QRectF(), roi, d.matrix);
+    d.timing.frameDrawn(d.video_frame, d.glv.uploadTime(), qreal(draw_timer.nsecsElapsed())/1e6);
 }
 
 void OpenGLRendererBase::onInitializeGL()
@@ -132,8 +392,15 @@ void OpenGLRendererBase::onPaintGL()
      */
     handlePaintEvent();
     //context()->swapBuffers(this);
+    if (d.timing.isEnabled() && d.painter && d.filter_context) {
+        if (!d.painter->isActive())
+            d.painter->begin(d.filter_context->paint_device);
+        d.timing.draw(d.painter, QRect(0, 0, rendererWidth(), rendererHeight()));
+    }
     if (d.painter && d.painter->isActive())
         d.painter->end();
+    // also releases the buffers after the filter is removed
+    d.capture(d.capture_pending.fetchAndStoreRelaxed(0) != 0);
 }
 
 void OpenGLRendererBase::onResizeGL(int w, int h)
@@ -154,6 +421,32 @@ void OpenGLRendererBase::onResizeEvent(int w, int h)
     d.setupAspectRatio();
     //QOpenGLWindow::resizeEvent(e); //will call resizeGL(). TODO:will call paintEvent()?
 }
+void OpenGLRendererBase::onFrameSwapped(qreal refreshRate)
+{
+    DPTR_D(OpenGLRendererBase);
+    if (!d.statistics)
+        return;
+    d.statistics->video_only.frameSwapped(refreshRate);
+    if (d.timing.framePresented(d.statistics->video_only.vsyncInterval()))
+        d.statistics->count(Statistics::StutterFrames);
+    d.statistics->setMemoryUsage(Statistics::TextureMemory, d.glv.textureMemory());
+    if (!Statistics::isLatencyTracing())
+        return;
+    qint64 demuxed = 0, sent = 0;
+    {
+        QMutexLocker locker(&d.img_mutex);
+        Q_UNUSED(locker);
+        sent = d.video_frame.sideData(Frame::SentTime);
+        demuxed = d.video_frame.sideData(Frame::DemuxTime);
+    }
+    if (sent <= 0 || sent == d.latency_sent)
+        return;
+    d.latency_sent = sent;
+    const qint64 now = Statistics::tracingTime();
+    d.statistics->video.addLatency(Statistics::LatencyPresent, sent, now);
+    d.statistics->video.addLatency(Statistics::LatencyTotal, demuxed, now);
+}
+
 //TODO: out_rect not correct when top level changed
 void OpenGLRendererBase::onShowEvent()
 {
@@ -190,24 +483,28 @@ bool OpenGLRendererBase::onSetOrientation(int value)
 bool OpenGLRendererBase::onSetBrightness(qreal b)
 {
     d_func().glv.setBrightness(b);
+    d_func().damaged = true;
     return true;
 }
 
 bool OpenGLRendererBase::onSetContrast(qreal c)
 {
     d_func().glv.setContrast(c);
+    d_func().damaged = true;
     return true;
 }
 
 bool OpenGLRendererBase::onSetHue(qreal h)
 {
     d_func().glv.setHue(h);
+    d_func().damaged = true;
     return true;
 }
 
 bool OpenGLRendererBase::onSetSaturation(qreal s)
 {
     d_func().glv.setSaturation(s);
+    d_func().damaged = true;
     return true;
 }
 
@@ -22,6 +22,8 @@
 #include "QtAVWidgets/OpenGLWidgetRenderer.h"
 #include "QtAV/private/OpenGLRendererBase_p.h"
 #include <QResizeEvent>
+#include <QtGui/QScreen>
+#include <QtGui/QWindow>
 
 namespace QtAV {
 
@@ -44,6 +46,15 @@ OpenGLWidgetRenderer::OpenGLWidgetRenderer(QWidget *parent, Qt::WindowFlags f):
 {
     setAcceptDrops(true);
     setFocusPolicy(Qt::StrongFocus);
+    // upload in a thread with a shared context. repaint when a frame is uploaded instead of received
+    static const bool async_upload = qgetenv("QTAV_GL_ASYNC_UPLOAD").toInt() > 0;
+    DPTR_D(OpenGLWidgetRenderer);
+    d.glv.setAsyncUpload(async_upload);
+    connect(&d.glv, SIGNAL(frameUploaded()), SLOT(update()), Qt::QueuedConnection);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
+    // no Q_OBJECT, so not a slot
+    connect(this, &QOpenGLWidget::frameSwapped, this, &OpenGLWidgetRenderer::handleFrameSwapped);
+#endif
 }
 
 void OpenGLWidgetRenderer::onUpdate()
@@ -72,6 +83,12 @@ void OpenGLWidgetRenderer::resizeEvent(QResizeEvent *e)
     QOpenGLWidget::resizeEvent(e); //will call resizeGL(). TODO:will call paintEvent()?
 }
 
+void OpenGLWidgetRenderer::handleFrameSwapped()
+{
+    QWindow *w = window()->windowHandle();
+    onFrameSwapped(w && w->screen() ? w->screen()->refreshRate() : 0);
+}
+
 void OpenGLWidgetRenderer::showEvent(QShowEvent *)
 {
     onShowEvent();
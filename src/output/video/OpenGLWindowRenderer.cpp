@@ -22,6 +22,7 @@
 #include "QtAV/OpenGLWindowRenderer.h"
 #include "QtAV/private/OpenGLRendererBase_p.h"
 #include <QResizeEvent>
+#include <QtGui/QScreen>
 #include "utils/Logger.h"
 
 namespace QtAV {
@@ -38,6 +39,12 @@ OpenGLWindowRenderer::OpenGLWindowRenderer(UpdateBehavior updateBehavior, QWindo
     QOpenGLWindow(updateBehavior, parent)
   , OpenGLRendererBase(*new OpenGLWindowRendererPrivate(this))
 {
+    // upload in a thread with a shared context. repaint when a frame is uploaded instead of received
+    static const bool async_upload = qgetenv("QTAV_GL_ASYNC_UPLOAD").toInt() > 0;
+    DPTR_D(OpenGLWindowRenderer);
+    d.glv.setAsyncUpload(async_upload);
+    connect(&d.glv, SIGNAL(frameUploaded()), SLOT(update()), Qt::QueuedConnection);
+    connect(this, SIGNAL(frameSwapped()), SLOT(handleFrameSwapped()));
 }
 
 void OpenGLWindowRenderer::onUpdate()
@@ -61,6 +68,11 @@ void OpenGLWindowRenderer::resizeGL(int w, int h)
     onResizeGL(w, h);
 }
 
+void OpenGLWindowRenderer::handleFrameSwapped()
+{
+    onFrameSwapped(screen() ? screen()->refreshRate() : 0);
+}
+
 void OpenGLWindowRenderer::resizeEvent(QResizeEvent *e)
 {
     onResizeEvent(e->size().width(), e->size().height());
@@ -57,6 +57,24 @@ bool QPainterRenderer::prepareFrame(const VideoFrame &frame)
      * avoid the lock and use the ref data directly and safely
      */
     // already locked in a larger scope of receive()
+    d.image_frame = VideoFrame();
+    d.image_roi = QRect();
+    /*
+     * scale to the output size and convert to RGB32 in 1 pass by ImageConverter(SIMD), instead of smooth scaling
+     * by QPainter in every paint. RGB32 is the native layout of raster paint engine, so painting is a 1:1 blit.
+     * video_frame is the source frame, realROI() depends on it
+     */
+    if (orientation() == 0 && d.out_rect.isValid()) {
+        d.video_frame = frame;
+        const QRect roi = realROI();
+        const VideoFrame f(frame.to(VideoFormat::Format_RGB32, d.out_rect.size(), roi));
+        if (f.isValid()) {
+            d.image_frame = f;
+            d.image_roi = roi;
+            d.image = QImage((uchar*)f.constBits(), f.width(), f.height(), f.bytesPerLine(), QImage::Format_RGB32);
+            return true;
+        }
+    }
     //If use d.data.data() it will eat more cpu, deep copy?
     if (frame.constBits(0))
         d.video_frame = frame;
@@ -85,6 +103,14 @@ void QPainterRenderer::drawFrame()
         d.image.fill(Qt::black); //maemo 4.7.0: QImage.fill(uint)
     }
     QRect roi = realROI();
+    if (orientation() == 0 && !d.image_roi.isNull()) {
+        // scaled in prepareFrame(). out_rect may be changed by resizing before the next frame
+        if (d.image.size() == d.out_rect.size())
+            d.painter->drawImage(d.out_rect.topLeft(), d.image);
+        else
+            d.painter->drawImage(d.out_rect, d.image);
+        return;
+    }
     if (orientation() == 0) {
         //assume that the image data is already scaled to out_size(NOT renderer size!)
         if (roi.size() == d.out_rect.size()) {
@@ -96,6 +122,8 @@ void QPainterRenderer::drawFrame()
         }
         return;
     }
+    if (!d.image_roi.isNull()) // orientation is changed after the frame is scaled
+        roi = d.image.rect();
     // render to whole renderer rect in painter's transformed coordinate
     // scale ratio is different from gl based renderers. gl always fill the whole rect
     d.painter->save();
@@ -141,6 +141,13 @@ QGraphicsItem* VideoOutput::graphicsItem()
     return d_func().impl->graphicsItem();
 }
 
+VideoFrameAllocatorPtr VideoOutput::frameAllocator()
+{
+    if (!isAvailable())
+        return VideoFrameAllocatorPtr();
+    return d_func().impl->frameAllocator();
+}
+
 bool VideoOutput::receiveFrame(const VideoFrame& frame)
 {
     if (!isAvailable())
@@ -235,6 +242,15 @@ bool VideoOutput::onSetQuality(Quality q)
     return d.impl->quality() == q;
 }
 
+bool VideoOutput::onSetPowerSaving(bool value)
+{
+    if (!isAvailable())
+        return false;
+    DPTR_D(VideoOutput);
+    d.impl->setPowerSaving(value);
+    return d.impl->isPowerSaving() == value;
+}
+
 bool VideoOutput::onSetOrientation(int value)
 {
     if (!isAvailable())
@@ -199,6 +199,28 @@ VideoRenderer::Quality VideoRenderer::quality() const
     return d_func().quality;
 }
 
+void VideoRenderer::setPowerSaving(bool value)
+{
+    DPTR_D(VideoRenderer);
+    if (d.power_saving == value)
+        return;
+    if (!onSetPowerSaving(value))
+        return;
+    d.power_saving = value;
+    d.update_posted = 0;
+}
+
+bool VideoRenderer::onSetPowerSaving(bool value)
+{
+    Q_UNUSED(value);
+    return true;
+}
+
+bool VideoRenderer::isPowerSaving() const
+{
+    return d_func().power_saving;
+}
+
 void VideoRenderer::setInSize(const QSize& s)
 {
     setInSize(s.width(), s.height());
@@ -436,6 +458,8 @@ bool VideoRenderer::needDrawFrame() const
 void VideoRenderer::handlePaintEvent()
 {
     DPTR_D(VideoRenderer);
+    // requests posted from now on need another repaint
+    d.update_posted = 0;
     d.setupQuality();
     //begin paint. how about QPainter::beginNativePainting()?
     {
@@ -599,6 +623,10 @@ bool VideoRenderer::onSetSaturation(qreal s)
 
 void VideoRenderer::updateUi()
 {
+    DPTR_D(VideoRenderer);
+    // the pending request will paint the latest content
+    if (d.power_saving && !d.update_posted.testAndSetOrdered(0, 1))
+        return;
     QObject *obj = (QObject*)qwindow();
     if (!obj)
         obj = (QObject*)widget();
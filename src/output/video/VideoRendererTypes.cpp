@@ -28,6 +28,9 @@
 #include "QtAV/OpenGLWindowRenderer.h"
 #endif //QT_NO_OPENGL
 #endif
+#if QTAV_HAVE(VULKAN)
+#include "QtAV/VulkanWindowRenderer.h"
+#endif
 #include "QtAV/private/factory.h"
 #include "QtAV/private/mkid.h"
 
@@ -36,6 +39,7 @@ namespace QtAV {
 FACTORY_DEFINE(VideoRenderer)
 
 VideoRendererId VideoRendererId_OpenGLWindow = mkid::id32base36_6<'Q', 'O', 'G', 'L', 'W', 'w'>::value;
+VideoRendererId VideoRendererId_VulkanWindow = mkid::id32base36_6<'Q', 'V', 'K', 'W', 'w', 'w'>::value;
 
 #if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
 #ifndef QT_NO_OPENGL
@@ -52,6 +56,19 @@ VideoRendererId OpenGLWindowRenderer::id() const
 }
 #endif //QT_NO_OPENGL
 #endif //qt5.4.0
+#if QTAV_HAVE(VULKAN)
+FACTORY_REGISTER_ID_AUTO(VideoRenderer, VulkanWindow, "VulkanWindow")
+
+void RegisterVideoRendererVulkanWindow_Man()
+{
+    FACTORY_REGISTER_ID_MAN(VideoRenderer, VulkanWindow, "VulkanWindow")
+}
+
+VideoRendererId VulkanWindowRenderer::id() const
+{
+    return VideoRendererId_VulkanWindow;
+}
+#endif //QTAV_HAVE(VULKAN)
 
 void VideoRenderer_RegisterAll()
 {
@@ -60,5 +77,8 @@ void VideoRenderer_RegisterAll()
     RegisterVideoRendererOpenGLWindow_Man();
 #endif //QT_NO_OPENGL
 #endif
+#if QTAV_HAVE(VULKAN)
+    RegisterVideoRendererVulkanWindow_Man();
+#endif
 }
 }//namespace QtAV
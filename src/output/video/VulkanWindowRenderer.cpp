@@ -0,0 +1,174 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAV/VulkanWindowRenderer.h"
+#include "QtAV/private/VideoRenderer_p.h"
+#include <cstring>
+#include <QtGui/QResizeEvent>
+#include <QtGui/QVulkanFunctions>
+#include <QtGui/QVulkanInstance>
+#include "vulkan/VulkanVideoMaterial.h"
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+class VulkanInstanceHolder
+{
+public:
+    VulkanInstanceHolder() {
+        inst.setExtensions(VulkanVideoMaterial::instanceExtensions());
+        if (!inst.create())
+            qWarning("failed to create vulkan instance: %d", inst.errorCode());
+    }
+    QVulkanInstance inst;
+};
+Q_GLOBAL_STATIC(VulkanInstanceHolder, defaultInstance)
+
+class VulkanWindowRendererPrivate : public VideoRendererPrivate
+{
+public:
+    VulkanVideoMaterial material;
+};
+
+class VulkanFrameRenderer : public QVulkanWindowRenderer
+{
+public:
+    VulkanFrameRenderer(VulkanWindowRenderer *w) : m_w(w) {}
+    void initResources() Q_DECL_OVERRIDE {
+        if (!m_w->d_func().material.initResources())
+            qWarning("failed to init vulkan video resources");
+    }
+    void releaseResources() Q_DECL_OVERRIDE {
+        m_w->d_func().material.releaseResources();
+    }
+    void startNextFrame() Q_DECL_OVERRIDE {
+        m_w->renderFrame();
+    }
+private:
+    VulkanWindowRenderer *m_w;
+};
+
+VulkanWindowRenderer::VulkanWindowRenderer(QWindow *parent)
+    : QVulkanWindow(parent)
+    , VideoRenderer(*new VulkanWindowRendererPrivate())
+{
+    DPTR_D(VulkanWindowRenderer);
+    if (!vulkanInstance()) {
+        if (defaultInstance()->inst.isValid())
+            setVulkanInstance(&defaultInstance()->inst);
+    }
+    d.material.setupWindow(this);
+    setPreferredPixelFormat(VideoFormat::Format_YUV420P);
+}
+
+VulkanWindowRenderer::~VulkanWindowRenderer()
+{
+    // resources of the material must be released before the material is destroyed with the private
+    destroy();
+}
+
+bool VulkanWindowRenderer::isSupported(VideoFormat::PixelFormat pixfmt) const
+{
+    return VulkanVideoMaterial::isSupported(pixfmt);
+}
+
+QVulkanWindowRenderer* VulkanWindowRenderer::createRenderer()
+{
+    return new VulkanFrameRenderer(this);
+}
+
+bool VulkanWindowRenderer::receiveFrame(const VideoFrame& frame)
+{
+    DPTR_D(VulkanWindowRenderer);
+    d.video_frame = frame;
+    d.material.setCurrentFrame(frame);
+    updateUi(); // requestUpdate() must be called in gui thread
+    return true;
+}
+
+void VulkanWindowRenderer::drawFrame()
+{
+    // frames are drawn in renderFrame()
+}
+
+void VulkanWindowRenderer::renderFrame()
+{
+    DPTR_D(VulkanWindowRenderer);
+    d.update_posted = 0;
+    const bool has_frame = d.material.upload();
+    VkCommandBuffer cb = currentCommandBuffer();
+    const QSize sz = swapChainImageSize();
+    VkClearValue clear[3];
+    memset(clear, 0, sizeof(clear));
+    clear[1].depthStencil.depth = 1.0f;
+    VkRenderPassBeginInfo rp;
+    memset(&rp, 0, sizeof(rp));
+    rp.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rp.renderPass = defaultRenderPass();
+    rp.framebuffer = currentFramebuffer();
+    rp.renderArea.extent.width = sz.width();
+    rp.renderArea.extent.height = sz.height();
+    rp.clearValueCount = sampleCountFlagBits() > VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
+    rp.pClearValues = clear;
+    QVulkanDeviceFunctions *df = vulkanInstance()->deviceFunctions(device());
+    df->vkCmdBeginRenderPass(cb, &rp, VK_SUBPASS_CONTENTS_INLINE);
+    if (has_frame && d.renderer_width > 0 && d.renderer_height > 0) {
+        // out_rect is in device independent pixels
+        const qreal sx = qreal(sz.width())/qreal(d.renderer_width);
+        const qreal sy = qreal(sz.height())/qreal(d.renderer_height);
+        const QRectF target(d.out_rect.x()*sx, d.out_rect.y()*sy, d.out_rect.width()*sx, d.out_rect.height()*sy);
+        d.material.draw(cb, target, realROI());
+    }
+    df->vkCmdEndRenderPass(cb);
+    frameReady();
+}
+
+void VulkanWindowRenderer::resizeEvent(QResizeEvent *e)
+{
+    resizeRenderer(e->size());
+    QVulkanWindow::resizeEvent(e);
+}
+
+bool VulkanWindowRenderer::onSetBrightness(qreal b)
+{
+    d_func().material.setBrightness(b);
+    return true;
+}
+
+bool VulkanWindowRenderer::onSetContrast(qreal c)
+{
+    d_func().material.setContrast(c);
+    return true;
+}
+
+bool VulkanWindowRenderer::onSetHue(qreal h)
+{
+    d_func().material.setHue(h);
+    return true;
+}
+
+bool VulkanWindowRenderer::onSetSaturation(qreal s)
+{
+    d_func().material.setSaturation(s);
+    return true;
+}
+
+} //namespace QtAV
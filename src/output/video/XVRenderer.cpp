@@ -27,6 +27,7 @@
 #include <QWidget>
 #include <QResizeEvent>
 #include <QtCore/qmath.h>
+#include <QtCore/QMutex>
 //#error qtextstream.h must be included before any header file that defines Status. Xlib.h defines Status
 #include <QtCore/QTextStream> //build error
 #include <sys/shm.h>
@@ -44,6 +45,202 @@ inline int scaleEQValue(int val, int min, int max)
     return (val + 100)*((qAbs(min) + qAbs(max)))/200 - qAbs(min);
 }
 
+#ifdef _XSHM_H_
+/*!
+ * Shared memory images the FFmpeg decoder decodes YUV420P frames into, so they are put to the X server without copy.
+ * Decoder threads only take and create shm segments. X requests (layout query, XShmAttach) are sent by the renderer.
+ * The pool lives until the last frame in its memory is destroyed, which can be after the renderer.
+ */
+class XvShmFramePool : public VideoFrameAllocator
+{
+public:
+    enum { kMaxImages = 24 }; // codec references + frame threads + frames held after decoding
+    XvShmFramePool(Display *display, XvPortID port, int formatId)
+        : m_display(display)
+        , m_port(port)
+        , m_format_id(formatId)
+        , m_serial(0)
+        , m_data_size(0)
+    {
+        for (int i = 0; i < 3; ++i)
+            m_pitches[i] = m_offsets[i] = 0;
+    }
+    ~XvShmFramePool() {
+        foreach (Image *img, m_images)
+            destroy(img);
+    }
+    void* allocate(VideoFormat::PixelFormat fmt, int width, int height, int align, quint8* data[4], int linesize[4]) Q_DECL_OVERRIDE {
+        if (fmt != VideoFormat::Format_YUV420P)
+            return 0;
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_requested = QSize(width, height);
+        if (!m_display || m_size != m_requested || m_data_size <= 0)
+            return 0;
+        // YV12 planes are Y, V, U
+        const int plane[] = { 0, 2, 1 };
+        for (int i = 0; i < 3; ++i) {
+            if (m_offsets[plane[i]] % align || m_pitches[plane[i]] % align)
+                return 0;
+        }
+        Image *img = 0;
+        foreach (Image *i, m_images) {
+            if (!i->in_use) {
+                img = i;
+                break;
+            }
+        }
+        if (!img) {
+            if (m_images.size() >= kMaxImages)
+                return 0;
+            img = new Image();
+            img->serial = m_serial;
+            img->shmid = shmget(IPC_PRIVATE, m_data_size + 16 + align, IPC_CREAT | 0777);
+            if (img->shmid < 0) {
+                delete img;
+                return 0;
+            }
+            img->addr = (char*)shmat(img->shmid, 0, 0); // page aligned
+            if (img->addr == (char*)-1) {
+                shmctl(img->shmid, IPC_RMID, 0);
+                delete img;
+                return 0;
+            }
+            m_images.append(img);
+        }
+        img->in_use = true;
+        for (int i = 0; i < 3; ++i) {
+            data[i] = (quint8*)img->addr + m_offsets[plane[i]];
+            linesize[i] = m_pitches[plane[i]];
+        }
+        data[3] = 0;
+        linesize[3] = 0;
+        return img;
+    }
+    void release(void* handle) Q_DECL_OVERRIDE {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        Image *img = static_cast<Image*>(handle);
+        img->in_use = false;
+        if (!m_display || img->serial != m_serial) { // renderer is destroyed or size changed
+            m_images.removeAll(img);
+            destroy(img);
+        }
+    }
+    /*!
+     * Query the layout of the size requested by the decoder, so the following frames can be decoded into images.
+     * Called by the renderer when a frame not in the pool is received.
+     */
+    void prepare() {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        if (!m_display || !m_requested.isValid() || m_requested == m_size)
+            return;
+        XShmSegmentInfo info;
+        XvImage *img = XvShmCreateImage(m_display, m_port, m_format_id, 0, m_requested.width(), m_requested.height(), &info);
+        if (!img)
+            return;
+        qDebug("XVideo direct decode: %dx%d, %d bytes", m_requested.width(), m_requested.height(), img->data_size);
+        m_size = m_requested;
+        m_data_size = img->data_size;
+        for (int i = 0; i < 3 && i < img->num_planes; ++i) {
+            m_pitches[i] = img->pitches[i];
+            m_offsets[i] = img->offsets[i];
+        }
+        XFree(img);
+        ++m_serial;
+        for (int i = m_images.size() - 1; i >= 0; --i) {
+            if (m_images.at(i)->in_use)
+                continue;
+            destroy(m_images.at(i));
+            m_images.removeAt(i);
+        }
+    }
+    /*!
+     * The attached XvImage whose Y plane is bits, i.e. a frame decoded into the pool. 0 if bits is not in the pool
+     */
+    XvImage* image(const uchar* bits) {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        if (!m_display || !bits)
+            return 0;
+        foreach (Image *img, m_images) {
+            if (!img->in_use || img->serial != m_serial || (const uchar*)img->addr + m_offsets[0] != bits)
+                continue;
+            if (img->xv_image)
+                return img->xv_image;
+            img->xv_image = XvShmCreateImage(m_display, m_port, m_format_id, img->addr, m_size.width(), m_size.height(), &img->info);
+            if (!img->xv_image)
+                return 0;
+            img->info.shmid = img->shmid;
+            img->info.shmaddr = img->addr;
+            img->info.readOnly = 0;
+            if (!XShmAttach(m_display, &img->info)) {
+                qWarning("XVideo direct decode: attach to shm failed");
+                XFree(img->xv_image);
+                img->xv_image = 0;
+                return 0;
+            }
+            XSync(m_display, False);
+            shmctl(img->shmid, IPC_RMID, 0); // freed after the last detach
+            img->shmid = -1;
+            return img->xv_image;
+        }
+        return 0;
+    }
+    /// the renderer and its display are being destroyed. memory referenced by frames is kept until release()
+    void detach() {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        for (int i = m_images.size() - 1; i >= 0; --i) {
+            Image *img = m_images.at(i);
+            if (img->xv_image) {
+                XShmDetach(m_display, &img->info);
+                XFree(img->xv_image);
+                img->xv_image = 0;
+            }
+            if (!img->in_use) {
+                destroy(img);
+                m_images.removeAt(i);
+            }
+        }
+        m_display = 0;
+    }
+private:
+    struct Image {
+        Image() : serial(0), shmid(-1), addr(0), in_use(false), xv_image(0) {}
+        int serial; // layout
+        int shmid; // -1 if removed after attach
+        char *addr;
+        bool in_use;
+        XvImage *xv_image; // 0 if not attached
+        XShmSegmentInfo info;
+    };
+    // m_mutex is locked
+    void destroy(Image *img) {
+        if (img->xv_image && m_display) {
+            XShmDetach(m_display, &img->info);
+            XFree(img->xv_image);
+        }
+        if (img->shmid >= 0)
+            shmctl(img->shmid, IPC_RMID, 0);
+        shmdt(img->addr);
+        delete img;
+    }
+
+    QMutex m_mutex;
+    Display *m_display;
+    XvPortID m_port;
+    int m_format_id;
+    int m_serial;
+    QSize m_requested; // padded size of the last allocate()
+    QSize m_size; // size of the layout
+    int m_data_size;
+    int m_pitches[3], m_offsets[3];
+    QList<Image*> m_images;
+};
+#endif //_XSHM_H_
+
 class XVRendererPrivate;
 class XVRenderer: public QWidget, public VideoRenderer
 {
@@ -66,6 +263,7 @@ public:
      * false: no double buffer, should reimplement paintEngine() to return 0 to avoid flicker
      */
     virtual QWidget* widget() Q_DECL_OVERRIDE { return this; }
+    virtual VideoFrameAllocatorPtr frameAllocator() Q_DECL_OVERRIDE;
 protected:
     virtual bool receiveFrame(const VideoFrame& frame) Q_DECL_OVERRIDE;
     virtual bool needUpdateBackground() const Q_DECL_OVERRIDE;
@@ -115,6 +313,7 @@ public:
       , xv_image_width(0)
       , xv_image_height(0)
       , xv_port(0)
+      , direct_image(0)
     {
 #ifndef _XSHM_H_
         use_shm = false;
@@ -149,6 +348,12 @@ public:
             qCritical("YV12 port not found!");
             return;
         }
+#ifdef _XSHM_H_
+        // let the decoder decode into shm images. QTAV_XV_DIRECT=0 to copy every frame
+        static const bool direct = qgetenv("QTAV_XV_DIRECT") != "0";
+        if (use_shm && direct && XShmQueryExtension(display))
+            frame_pool = QSharedPointer<XvShmFramePool>(new XvShmFramePool(display, xv_port, format_id));
+#endif //_XSHM_H_
     }
     ~XVRendererPrivate() {
         if (xv_adaptor_info) {
@@ -156,6 +361,10 @@ public:
             xv_adaptor_info = 0;
         }
         destroyXVImage();
+#ifdef _XSHM_H_
+        if (frame_pool)
+            frame_pool->detach();
+#endif //_XSHM_H_
         if (gc) {
             XFreeGC(display, gc);
             gc = 0;
@@ -269,7 +478,9 @@ no_shm:
     GC gc;
 #ifdef _XSHM_H_
     XShmSegmentInfo shm;
+    QSharedPointer<XvShmFramePool> frame_pool;
 #endif //_XSHM_H_
+    XvImage *direct_image; // image of the frame pool holding video_frame. 0: video_frame is copied to xv_image
 };
 
 bool XVRendererPrivate::XvSetPortAttributeIfExists(const char *key, int value)
@@ -396,9 +607,31 @@ void CopyFromYv12(quint8 *dst[], size_t dst_pitch[],
      CopyPlane(dst[2], dst_pitch[2], src[2], src_pitch[2], width/2, height/2);
 }
 
+VideoFrameAllocatorPtr XVRenderer::frameAllocator()
+{
+#ifdef _XSHM_H_
+    return d_func().frame_pool;
+#else
+    return VideoFrameAllocatorPtr();
+#endif //_XSHM_H_
+}
+
 bool XVRenderer::receiveFrame(const VideoFrame& frame)
 {
     DPTR_D(XVRenderer);
+    d.direct_image = 0;
+#ifdef _XSHM_H_
+    if (d.frame_pool && frame.isValid() && frame.hasHostData()) {
+        // decoded into shm by the decoder. keep the frame until the next one so the memory is not reused while displayed
+        d.direct_image = d.frame_pool->image(frame.constBits(0));
+        if (d.direct_image) {
+            d.video_frame = frame;
+            update();
+            return true;
+        }
+        d.frame_pool->prepare();
+    }
+#endif //_XSHM_H_
     if (frame.isValid()) {
         if (!d.prepareImage(frame.width(), frame.height()))
             return false;
@@ -512,8 +745,9 @@ void XVRenderer::drawFrame()
     DPTR_D(XVRenderer);
     QRect roi = realROI();
 #ifdef _XSHM_H_
-        if (d.use_shm) {
-            XvShmPutImage(d.display, d.xv_port, winId(), d.gc, d.xv_image
+        if (d.use_shm || d.direct_image) {
+            // the direct image is padded. roi is in the visible frame
+            XvShmPutImage(d.display, d.xv_port, winId(), d.gc, d.direct_image ? d.direct_image : d.xv_image
                           , roi.x(), roi.y(), roi.width(), roi.height()
                           , d.out_rect.x(), d.out_rect.y(), d.out_rect.width(), d.out_rect.height()
                           , false /*true: send event*/);
@@ -34,12 +34,82 @@ varying vec2 v_TexCoords0;
 uniform mat4 u_colorMatrix;
 uniform float u_opacity;
 uniform mat4 u_c;
+#ifdef DEINTERLACE
+#if defined(GL_ES) && defined(GL_FRAGMENT_PRECISION_HIGH)
+#define fieldp highp
+#else
+#define fieldp mediump
+#endif
+// x: line parity of the displayed field, 0: top field (even lines), 1: bottom field. y: comb threshold
+uniform vec2 u_deint;
+// lines of each texture. 1.0 for rectangle textures, whose coordinates are in texels
+uniform vec4 u_deintLines;
+vec4 texture2DField(sampler2D tex, fieldp vec2 coord, fieldp float lines)
+{
+    fieldp float dy = 1.0/lines;
+    fieldp float line = floor(coord.y*lines);
+    fieldp vec2 c = vec2(coord.x, (line + 0.5)*dy);
+    vec4 cur = texture2D(tex, c);
+    vec4 above = texture2D(tex, vec2(c.x, c.y - dy));
+    vec4 below = texture2D(tex, vec2(c.x, c.y + dy));
+#ifdef DEINTERLACE_BLEND
+    return (above + 2.0*cur + below)*0.25;
+#else
+    if (abs(mod(line, 2.0) - u_deint.x) < 0.5) // a line of the displayed field
+        return cur;
+    vec4 interp = (above + below)*0.5;
+#ifdef DEINTERLACE_ADAPTIVE
+    // a line of the other field combs with its neighbours only if something moves. ignore the vertical gradient of edges
+    vec4 comb = abs(cur - interp) - abs(above - below)*0.5;
+    if (max(max(comb.r, comb.g), max(comb.b, comb.a)) < u_deint.y)
+        return cur;
+#endif //DEINTERLACE_ADAPTIVE
+    return interp;
+#endif //DEINTERLACE_BLEND
+}
+#define texture2DPlane(tex, coord, plane) texture2DField(tex, coord, u_deintLines[plane])
+#else
+#define texture2DPlane(tex, coord, plane) texture2D(tex, coord)
+#endif //DEINTERLACE
+#ifdef COLOR_LUT
+#if defined(GL_ES) && defined(GL_FRAGMENT_PRECISION_HIGH)
+#define lutp highp
+#else
+#define lutp mediump
+#endif
+// size*size x size. texel (r + b*size, g) is the output of (r, g, b), see ColorLUT
+uniform sampler2D u_lut;
+uniform float u_lutSize;
+// map input in LUT domain to [0, 1]
+uniform vec3 u_lutScale;
+uniform vec3 u_lutOffset;
+vec3 colorLUT(vec3 rgb)
+{
+    lutp float n = u_lutSize;
+    lutp vec3 i = clamp(rgb*u_lutScale + u_lutOffset, 0.0, 1.0)*(n - 1.0);
+    lutp float b0 = floor(i.b);
+    lutp float b1 = min(b0 + 1.0, n - 1.0);
+    // bilinear in 2 slices of blue by texture filtering, then linear between them
+    lutp vec2 c0 = vec2(b0*n + i.r + 0.5, i.g + 0.5);
+    lutp vec2 c1 = vec2(b1*n + i.r + 0.5, c0.y);
+#ifndef LUT_TEXEL_COORD
+    lutp vec2 texel = vec2(1.0/(n*n), 1.0/n);
+    c0 *= texel;
+    c1 *= texel;
+#endif //LUT_TEXEL_COORD
+    return mix(texture2D(u_lut, c0).rgb, texture2D(u_lut, c1).rgb, i.b - b0);
+}
+#endif //COLOR_LUT
 
 void main() {
-    vec4 c = texture2D(u_Texture0, v_TexCoords0);
+    vec4 c = texture2DPlane(u_Texture0, v_TexCoords0, 0);
     c = u_c * c;
 #ifndef HAS_ALPHA
     c.a = 1.0;
 #endif //HAS_ALPHA
-    gl_FragColor = clamp(u_colorMatrix * c, 0.0, 1.0) * u_opacity;
+    gl_FragColor = clamp(u_colorMatrix * c, 0.0, 1.0);
+#ifdef COLOR_LUT
+    gl_FragColor.rgb = colorLUT(gl_FragColor.rgb);
+#endif //COLOR_LUT
+    gl_FragColor *= u_opacity;
 }
@@ -54,6 +54,164 @@ uniform mat4 u_colorMatrix;
 #ifndef CHANNEL_8BIT
 uniform vec2 u_to8;
 #endif
+#ifdef DEINTERLACE
+#if defined(GL_ES) && defined(GL_FRAGMENT_PRECISION_HIGH)
+#define fieldp highp
+#else
+#define fieldp mediump
+#endif
+// x: line parity of the displayed field, 0: top field (even lines), 1: bottom field. y: comb threshold
+uniform vec2 u_deint;
+// lines of each texture. 1.0 for rectangle textures, whose coordinates are in texels
+uniform vec4 u_deintLines;
+vec4 texture2DField(sampler2D tex, fieldp vec2 coord, fieldp float lines)
+{
+    fieldp float dy = 1.0/lines;
+    fieldp float line = floor(coord.y*lines);
+    fieldp vec2 c = vec2(coord.x, (line + 0.5)*dy);
+    vec4 cur = texture2D(tex, c);
+    vec4 above = texture2D(tex, vec2(c.x, c.y - dy));
+    vec4 below = texture2D(tex, vec2(c.x, c.y + dy));
+#ifdef DEINTERLACE_BLEND
+    return (above + 2.0*cur + below)*0.25;
+#else
+    if (abs(mod(line, 2.0) - u_deint.x) < 0.5) // a line of the displayed field
+        return cur;
+    vec4 interp = (above + below)*0.5;
+#ifdef DEINTERLACE_ADAPTIVE
+    // a line of the other field combs with its neighbours only if something moves. ignore the vertical gradient of edges
+    vec4 comb = abs(cur - interp) - abs(above - below)*0.5;
+    if (max(max(comb.r, comb.g), max(comb.b, comb.a)) < u_deint.y)
+        return cur;
+#endif //DEINTERLACE_ADAPTIVE
+    return interp;
+#endif //DEINTERLACE_BLEND
+}
+#define texture2DPlane(tex, coord, plane) texture2DField(tex, coord, u_deintLines[plane])
+#else
+#define texture2DPlane(tex, coord, plane) texture2D(tex, coord)
+#endif //DEINTERLACE
+#ifdef COLOR_MANAGED
+#if defined(GL_ES) && defined(GL_FRAGMENT_PRECISION_HIGH)
+precision highp float; // mediump is not enough for PQ
+#endif
+// linear light is in 10000 nits. x: peak luminance of source, y: peak luminance of display, z: SDR white
+uniform vec4 u_hdr;
+uniform mat3 u_gamut; // linear rgb of source primaries to output primaries
+#ifdef HDR_OUTPUT_PQ
+const vec3 kLuma = vec3(0.2627, 0.6780, 0.0593);
+#else
+const vec3 kLuma = vec3(0.2126, 0.7152, 0.0722);
+#endif
+// SMPTE ST 2084
+const float kPQ_m1 = 0.1593017578125;
+const float kPQ_m2 = 78.84375;
+const float kPQ_c1 = 0.8359375;
+const float kPQ_c2 = 18.8515625;
+const float kPQ_c3 = 18.6875;
+vec3 pqToLinear(vec3 e)
+{
+    vec3 p = pow(max(e, vec3(0.0)), vec3(1.0/kPQ_m2));
+    return pow(max(p - kPQ_c1, vec3(0.0))/(kPQ_c2 - kPQ_c3*p), vec3(1.0/kPQ_m1));
+}
+vec3 linearToPQ(vec3 l)
+{
+    vec3 p = pow(max(l, vec3(0.0)), vec3(kPQ_m1));
+    return pow((kPQ_c1 + kPQ_c2*p)/(1.0 + kPQ_c3*p), vec3(kPQ_m2));
+}
+#ifdef HDR_INPUT_HLG
+// inverse OETF of ARIB STD-B67 and OOTF of a 1000 nits display (BT.2100)
+vec3 hlgToLinear(vec3 e)
+{
+    vec3 s = mix(e*e/3.0, (exp((e - 0.55991073)/0.17883277) + 0.28466892)/12.0, step(0.5, e));
+    float y = dot(s, vec3(0.2627, 0.6780, 0.0593));
+    return s*pow(max(y, 1e-6), 0.2)*0.1;
+}
+#endif //HDR_INPUT_HLG
+#ifdef TONEMAP_HABLE
+float hable(float x)
+{
+    return (x*(0.15*x + 0.05) + 0.004)/(x*(0.15*x + 0.5) + 0.06) - 0.02/0.3;
+}
+#endif //TONEMAP_HABLE
+// l: max component in linear light
+float toneMap(float l)
+{
+#if defined(TONEMAP_BT2390)
+    // EETF of BT.2390 in PQ space, relative to source peak. black level is 0
+    float src = linearToPQ(vec3(u_hdr.x)).x;
+    float max_lum = linearToPQ(vec3(u_hdr.y)).x/src;
+    float e = min(linearToPQ(vec3(l)).x/src, 1.0);
+    float ks = 1.5*max_lum - 0.5;
+    if (e > ks) {
+        float t = (e - ks)/(1.0 - ks);
+        float t2 = t*t;
+        float t3 = t2*t;
+        e = (2.0*t3 - 3.0*t2 + 1.0)*ks + (t3 - 2.0*t2 + t)*(1.0 - ks) + (-2.0*t3 + 3.0*t2)*max_lum;
+    }
+    return pqToLinear(vec3(e*src)).x;
+#elif defined(TONEMAP_HABLE)
+    return hable(l/u_hdr.y)/hable(u_hdr.x/u_hdr.y)*u_hdr.y;
+#else
+    return min(l, u_hdr.y);
+#endif
+}
+// non-linear rgb of the source to non-linear rgb of the output
+vec3 colorManage(vec3 rgb)
+{
+#if defined(HDR_INPUT_PQ)
+    vec3 l = pqToLinear(rgb);
+#elif defined(HDR_INPUT_HLG)
+    vec3 l = hlgToLinear(rgb);
+#else
+    vec3 l = pow(rgb, vec3(2.4))*u_hdr.z; // BT.1886
+#endif
+    l = u_gamut*l;
+    // desaturate out of gamut colors to their luminance instead of clipping each component, so hue is kept
+    float y = max(dot(l, kLuma), 0.0);
+    float m = min(min(l.r, l.g), l.b);
+    if (m < 0.0)
+        l = mix(vec3(y), l, y/(y - m));
+    // scale rgb by the mapped max component, which keeps hue and saturation
+    float peak = max(max(l.r, l.g), l.b);
+    if (u_hdr.x > u_hdr.y && peak > 0.0)
+        l *= toneMap(peak)/peak;
+#ifdef HDR_OUTPUT_PQ
+    return linearToPQ(l);
+#else
+    return pow(clamp(l/u_hdr.y, 0.0, 1.0), vec3(1.0/2.4));
+#endif
+}
+#endif //COLOR_MANAGED
+#ifdef COLOR_LUT
+#if defined(GL_ES) && defined(GL_FRAGMENT_PRECISION_HIGH)
+#define lutp highp
+#else
+#define lutp mediump
+#endif
+// size*size x size. texel (r + b*size, g) is the output of (r, g, b), see ColorLUT
+uniform sampler2D u_lut;
+uniform float u_lutSize;
+// map input in LUT domain to [0, 1]
+uniform vec3 u_lutScale;
+uniform vec3 u_lutOffset;
+vec3 colorLUT(vec3 rgb)
+{
+    lutp float n = u_lutSize;
+    lutp vec3 i = clamp(rgb*u_lutScale + u_lutOffset, 0.0, 1.0)*(n - 1.0);
+    lutp float b0 = floor(i.b);
+    lutp float b1 = min(b0 + 1.0, n - 1.0);
+    // bilinear in 2 slices of blue by texture filtering, then linear between them
+    lutp vec2 c0 = vec2(b0*n + i.r + 0.5, i.g + 0.5);
+    lutp vec2 c1 = vec2(b1*n + i.r + 0.5, c0.y);
+#ifndef LUT_TEXEL_COORD
+    lutp vec2 texel = vec2(1.0/(n*n), 1.0/n);
+    c0 *= texel;
+    c1 *= texel;
+#endif //LUT_TEXEL_COORD
+    return mix(texture2D(u_lut, c0).rgb, texture2D(u_lut, c1).rgb, i.b - b0);
+}
+#endif //COLOR_LUT
 #if defined(YUV_MAT_GLSL)
 //http://en.wikipedia.org/wiki/YUV calculation used
 //http://www.fourcc.org/fccyvrgb.php
@@ -81,23 +239,41 @@ void main()
 {
     gl_FragColor = clamp(u_colorMatrix
                          * vec4(
-#ifndef CHANNEL_8BIT
-                             dot(texture2D(u_Texture0, v_TexCoords0).ra, u_to8),
-                             dot(texture2D(u_Texture1, v_TexCoords1).ra, u_to8),
-                             dot(texture2D(u_Texture2, v_TexCoords2).ra, u_to8),
+#if defined(CHANNEL16_TO8)
+// GL_R16 for planar, GL_RG16 for semi-planar(P010) chroma. u_to8.x: 65535/range
+                             texture2DPlane(u_Texture0, v_TexCoords0, 0).r*u_to8.x,
+                             texture2DPlane(u_Texture1, v_TexCoords1, 1).r*u_to8.x,
+#ifdef IS_BIPLANAR
+                             texture2DPlane(u_Texture2, v_TexCoords2, 2).g*u_to8.x,
+#else
+                             texture2DPlane(u_Texture2, v_TexCoords2, 2).r*u_to8.x,
+#endif //IS_BIPLANAR
+#elif !defined(CHANNEL_8BIT)
+                             dot(texture2DPlane(u_Texture0, v_TexCoords0, 0).ra, u_to8),
+                             dot(texture2DPlane(u_Texture1, v_TexCoords1, 1).ra, u_to8),
+                             dot(texture2DPlane(u_Texture2, v_TexCoords2, 2).ra, u_to8),
 #else
 // use r, g, a to work for both yv12 and nv12. idea from xbmc
-                             texture2D(u_Texture0, v_TexCoords0).r,
-                             texture2D(u_Texture1, v_TexCoords1).g,
-                             texture2D(u_Texture2, v_TexCoords2).a,
+                             texture2DPlane(u_Texture0, v_TexCoords0, 0).r,
+                             texture2DPlane(u_Texture1, v_TexCoords1, 1).g,
+                             texture2DPlane(u_Texture2, v_TexCoords2, 2).a,
 #endif //CHANNEL_8BIT
                              1)
-                         , 0.0, 1.0) * u_opacity;
+                         , 0.0, 1.0);
+#ifdef COLOR_MANAGED
+    gl_FragColor.rgb = colorManage(gl_FragColor.rgb);
+#endif //COLOR_MANAGED
+#ifdef COLOR_LUT
+    gl_FragColor.rgb = colorLUT(gl_FragColor.rgb);
+#endif //COLOR_LUT
+    gl_FragColor *= u_opacity;
 #ifdef HAS_ALPHA
-#ifndef CHANNEL_8BIT
-    gl_FragColor.a *= dot(texture2D(u_Texture3, v_TexCoords3).ra, u_to8); //GL_LUMINANCE_ALPHA
+#if defined(CHANNEL16_TO8)
+    gl_FragColor.a *= texture2DPlane(u_Texture3, v_TexCoords3, 3).r*u_to8.x; //GL_R16
+#elif !defined(CHANNEL_8BIT)
+    gl_FragColor.a *= dot(texture2DPlane(u_Texture3, v_TexCoords3, 3).ra, u_to8); //GL_LUMINANCE_ALPHA
 #else //8bit
-    gl_FragColor.a *= texture2D(u_Texture3, v_TexCoords3).a; //GL_ALPHA
+    gl_FragColor.a *= texture2DPlane(u_Texture3, v_TexCoords3, 3).a; //GL_ALPHA
 #endif //CHANNEL_8BIT
 #endif //HAS_ALPHA
 }
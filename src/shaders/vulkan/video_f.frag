@@ -0,0 +1,47 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#version 450
+// 1: packed rgb, 2: luma and interleaved chroma (nv12, p010), 3: planar yuv
+layout(constant_id = 0) const int kPlanes = 3;
+layout(binding = 0) uniform sampler2D u_Texture0;
+layout(binding = 1) uniform sampler2D u_Texture1;
+layout(binding = 2) uniform sampler2D u_Texture2;
+layout(push_constant) uniform PushConstants {
+    mat4 colorMatrix; // yuv to rgb, color adjustment and range of 16 bit planes
+    vec4 targetRect;
+    vec4 texRect;
+} pc;
+layout(location = 0) in vec2 v_TexCoords;
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+    vec4 c;
+    if (kPlanes == 1) {
+        c = vec4(texture(u_Texture0, v_TexCoords).rgb, 1.0);
+    } else if (kPlanes == 2) {
+        c = vec4(texture(u_Texture0, v_TexCoords).r, texture(u_Texture1, v_TexCoords).rg, 1.0);
+    } else {
+        c = vec4(texture(u_Texture0, v_TexCoords).r, texture(u_Texture1, v_TexCoords).r, texture(u_Texture2, v_TexCoords).r, 1.0);
+    }
+    fragColor = vec4(clamp(pc.colorMatrix*c, 0.0, 1.0).rgb, 1.0);
+}
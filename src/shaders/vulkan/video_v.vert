@@ -0,0 +1,42 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#version 450
+// compiled to SPIR-V at build time, see vulkan/VulkanVideoMaterial
+// the same block as video_f.frag
+layout(push_constant) uniform PushConstants {
+    mat4 colorMatrix;
+    vec4 targetRect; // x, y, width, height in NDC
+    vec4 texRect; // normalized
+} pc;
+layout(location = 0) out vec2 v_TexCoords;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main()
+{
+    // triangle strip without vertex buffer: (0,0), (1,0), (0,1), (1,1)
+    vec2 p = vec2(float(gl_VertexIndex & 1), float(gl_VertexIndex >> 1));
+    v_TexCoords = pc.texRect.xy + p*pc.texRect.zw;
+    gl_Position = vec4(pc.targetRect.xy + p*pc.targetRect.zw, 0.0, 1.0);
+}
@@ -22,12 +22,46 @@
 #include "QtAV/private/PlayerSubtitle.h"
 #include <QtCore/QDir>
 #include <QtCore/QFileInfo>
+#include <QtCore/QThread>
 #include "QtAV/AVPlayer.h"
 #include "QtAV/Subtitle.h"
+#include "PacketBuffer.h"
 #include "utils/Logger.h"
 
 namespace QtAV {
 
+class SubtitlePacketThread : public QThread
+{
+public:
+    SubtitlePacketThread(PlayerSubtitle *ps) : m_ps(ps), m_stop(false) {}
+    void start() {
+        m_stop = false;
+        queue.setBlocking(true);
+        queue.blockFull(false); // never block the demuxer
+        QThread::start();
+    }
+    void stop() {
+        m_stop = true;
+        queue.setBlocking(false);
+        wait();
+        queue.clear();
+    }
+    PacketBuffer queue; // put in demux thread
+protected:
+    void run() Q_DECL_OVERRIDE {
+        while (!m_stop) {
+            const Packet pkt(queue.take());
+            if (m_stop)
+                break;
+            if (pkt.isValid())
+                m_ps->processInternalSubtitlePacket(pkt);
+        }
+    }
+private:
+    PlayerSubtitle *m_ps;
+    volatile bool m_stop;
+};
+
 extern QString getLocalPath(const QString& fullPath);
 
 // /xx/oo/a.01.mov => /xx/oo/a.01. native dir separator => /
@@ -63,9 +97,16 @@ PlayerSubtitle::PlayerSubtitle(QObject *parent)
     , m_enabled(true)
     , m_player(0)
     , m_sub(new Subtitle(this))
+    , m_thread(new SubtitlePacketThread(this))
 {
 }
 
+PlayerSubtitle::~PlayerSubtitle()
+{
+    stopPacketThread();
+    delete m_thread;
+}
+
 Subtitle* PlayerSubtitle::subtitle()
 {
     return m_sub;
@@ -149,13 +190,13 @@ void PlayerSubtitle::onPlayerStart()
         if (m_file.isEmpty()) {
             const int n = m_player->currentSubtitleStream();
             if (n < 0 || m_tracks.isEmpty() || m_tracks.size() <= n) {
-                m_sub->processHeader(QByteArray(), QByteArray()); // reset
+                processHeader(QByteArray(), QByteArray()); // reset
                 return;
             }
             QVariantMap track = m_tracks[n].toMap();
             QByteArray codec(track.value(QStringLiteral("codec")).toByteArray());
             QByteArray data(track.value(QStringLiteral("extra")).toByteArray());
-            m_sub->processHeader(codec, data);
+            processHeader(codec, data);
         } else {
             m_sub->loadAsync();
         }
@@ -218,7 +259,7 @@ void PlayerSubtitle::tryReload(int flag)
     const int kReloadExternal = 1<<1;
     if (flag & kReloadExternal) {
         if (!m_file.isEmpty() && m_enabled) { //engine changed
-            m_sub->processHeader(QByteArray(), QByteArray()); // reset
+            processHeader(QByteArray(), QByteArray()); // reset
             m_sub->loadAsync();
             return;
         }
@@ -227,7 +268,7 @@ void PlayerSubtitle::tryReload(int flag)
         if (!m_enabled)
             return;
         if (flag & kReloadExternal) {
-            m_sub->processHeader(QByteArray(), QByteArray()); // reset
+            processHeader(QByteArray(), QByteArray()); // reset
             m_sub->loadAsync();
         }
         return;
@@ -235,7 +276,7 @@ void PlayerSubtitle::tryReload(int flag)
 
     const int n = m_player->currentSubtitleStream();
     if (n < 0 || m_tracks.isEmpty() || m_tracks.size() <= n) {
-        m_sub->processHeader(QByteArray(), QByteArray()); // reset, null processor
+        processHeader(QByteArray(), QByteArray()); // reset, null processor
         //try to fallback to external sub if an invalid internal sub track is set
         if ((flag & kReloadExternal) && m_enabled)
             m_sub->loadAsync();
@@ -244,28 +285,69 @@ void PlayerSubtitle::tryReload(int flag)
     QVariantMap track = m_tracks[n].toMap();
     QByteArray codec(track.value(QStringLiteral("codec")).toByteArray());
     QByteArray data(track.value(QStringLiteral("extra")).toByteArray());
-    m_sub->processHeader(codec, data);
-    Packet pkt(m_current_pkt[n]);
+    processHeader(codec, data);
+    Packet pkt;
+    {
+        QMutexLocker lock(&m_pkt_mutex);
+        Q_UNUSED(lock);
+        if (n < m_current_pkt.size())
+            pkt = m_current_pkt[n];
+    }
     if (pkt.isValid()) {
-        processInternalSubtitlePacket(n, pkt);
+        processInternalSubtitlePacket(pkt);
     }
 }
 
 void  PlayerSubtitle::updateInternalSubtitleTracks(const QVariantList &tracks)
 {
     m_tracks = tracks;
+    QMutexLocker lock(&m_pkt_mutex);
+    Q_UNUSED(lock);
     m_current_pkt.resize(tracks.size());
 }
 
-void PlayerSubtitle::processInternalSubtitlePacket(int track, const QtAV::Packet &packet)
+void PlayerSubtitle::queueInternalSubtitlePacket(int track, const QtAV::Packet &packet)
+{
+    {
+        QMutexLocker lock(&m_pkt_mutex);
+        Q_UNUSED(lock);
+        if (track >= 0 && track < m_current_pkt.size())
+            m_current_pkt[track] = packet;
+    }
+    if (m_thread->isRunning())
+        m_thread->queue.put(packet);
+}
+
+void PlayerSubtitle::processInternalSubtitlePacket(const Packet &packet)
 {
     m_sub->processLine(packet.data, packet.pts, packet.duration);
-    m_current_pkt[track] = packet;
 }
 
-void PlayerSubtitle::processInternalSubtitleHeader(const QByteArray& codec, const QByteArray &data)
+void PlayerSubtitle::processHeader(const QByteArray &codec, const QByteArray &data)
 {
+    const bool running = m_thread->isRunning();
+    if (running)
+        stopPacketThread();
     m_sub->processHeader(codec, data);
+    if (running)
+        startPacketThread();
+}
+
+void PlayerSubtitle::startPacketThread()
+{
+    if (!m_thread->isRunning())
+        m_thread->start();
+}
+
+void PlayerSubtitle::stopPacketThread()
+{
+    if (m_thread->isRunning())
+        m_thread->stop();
+}
+
+void PlayerSubtitle::processInternalSubtitleHeader(const QByteArray& codec, const QByteArray &data)
+{
+    processHeader(codec, data);
 }
 
 void PlayerSubtitle::connectSignals()
@@ -273,13 +355,15 @@ void PlayerSubtitle::connectSignals()
     connect(m_player, SIGNAL(sourceChanged()), this, SLOT(onPlayerSourceChanged()));
     connect(m_player, SIGNAL(positionChanged(qint64)), this, SLOT(onPlayerPositionChanged()));
     connect(m_player, SIGNAL(started()), this, SLOT(onPlayerStart()));
-    connect(m_player, SIGNAL(internalSubtitlePacketRead(int,QtAV::Packet)), this, SLOT(processInternalSubtitlePacket(int,QtAV::Packet)));
+    // queue in demux thread
+    connect(m_player, SIGNAL(internalSubtitlePacketRead(int,QtAV::Packet)), this, SLOT(queueInternalSubtitlePacket(int,QtAV::Packet)), Qt::DirectConnection);
     connect(m_player, SIGNAL(internalSubtitleHeaderRead(QByteArray,QByteArray)), this, SLOT(processInternalSubtitleHeader(QByteArray,QByteArray)));
     connect(m_player, SIGNAL(internalSubtitleTracksChanged(QVariantList)), this, SLOT(updateInternalSubtitleTracks(QVariantList)));
     // try to reload internal subtitle track. if failed and external subtitle is enabled, fallback to external
     connect(m_player, SIGNAL(subtitleStreamChanged(int)), this, SLOT(tryReloadInternalSub()));
     connect(m_sub, SIGNAL(codecChanged()), this, SLOT(tryReload()));
     connect(m_sub, SIGNAL(enginesChanged()), this, SLOT(tryReload()));
+    startPacketThread();
 }
 
 void PlayerSubtitle::disconnectSignals()
@@ -287,11 +371,12 @@ void PlayerSubtitle::disconnectSignals()
     disconnect(m_player, SIGNAL(sourceChanged()), this, SLOT(onPlayerSourceChanged()));
     disconnect(m_player, SIGNAL(positionChanged(qint64)), this, SLOT(onPlayerPositionChanged()));
     disconnect(m_player, SIGNAL(started()), this, SLOT(onPlayerStart()));
-    disconnect(m_player, SIGNAL(internalSubtitlePacketRead(int,QtAV::Packet)), this, SLOT(processInternalSubtitlePacket(int,QtAV::Packet)));
+    disconnect(m_player, SIGNAL(internalSubtitlePacketRead(int,QtAV::Packet)), this, SLOT(queueInternalSubtitlePacket(int,QtAV::Packet)));
     disconnect(m_player, SIGNAL(internalSubtitleHeaderRead(QByteArray,QByteArray)), this, SLOT(processInternalSubtitleHeader(QByteArray,QByteArray)));
     disconnect(m_player, SIGNAL(internalSubtitleTracksChanged(QVariantList)), this, SLOT(updateInternalSubtitleTracks(QVariantList)));
     disconnect(m_sub, SIGNAL(codecChanged()), this, SLOT(tryReload()));
     disconnect(m_sub, SIGNAL(enginesChanged()), this, SLOT(tryReload()));
+    stopPacketThread();
 }
 
 } //namespace QtAV
@@ -27,19 +27,76 @@
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QIODevice>
-#include <QtCore/QLinkedList>
+#include <QtCore/QMap>
 #include <QtCore/QRegExp>
 #include <QtCore/QRunnable>
 #include <QtCore/QThreadPool>
 #include <QtCore/QTextCodec>
 #include <QtCore/QTextStream>
 #include <QtCore/QMutexLocker>
+#include <QtCore/QVector>
 #include "subtitle/CharsetDetector.h"
 #include "utils/Logger.h"
 
 namespace QtAV {
 
 const int kMaxSubtitleSize = 10 * 1024 * 1024; // TODO: remove because we find the matched extenstions
+const int kCharsetProbeSize = 64 * 1024;
+// a pre-rendered image is taken if it's not later than the beginning of its cue by this time
+const qreal kPrerenderTolerance = 0.1;
+
+static bool beginLessThan(const SubtitleFrame& a, const SubtitleFrame& b)
+{
+    return a.begin < b.begin || (a.begin == b.begin && a.end < b.end);
+}
+
+static bool timeLessThanBegin(qreal t, const SubtitleFrame& f)
+{
+    return t < f.begin;
+}
+
+/*!
+ * Interval index of frames sorted by begin time. A segment tree stores max end time of each range, so all frames at a time
+ * are found in O(k*log(n)): only ranges of frames beginning before t and having an end >= t are visited.
+ */
+class SubtitleIndex
+{
+public:
+    SubtitleIndex() : m_size(0) {}
+    void build(const QVector<SubtitleFrame>& frames) {
+        m_size = 1;
+        while (m_size < frames.size())
+            m_size <<= 1;
+        m_max_end.fill(-1, 2*m_size);
+        for (int i = 0; i < frames.size(); ++i)
+            m_max_end[m_size + i] = frames.at(i).end;
+        for (int i = m_size - 1; i > 0; --i)
+            m_max_end[i] = qMax(m_max_end[2*i], m_max_end[2*i+1]);
+    }
+    /*!
+     * indices of frames covering t in begin order.
+     * \param count number of frames beginning <= t, i.e. upper bound of t
+     */
+    void find(qreal t, int count, QVector<int> *result) const {
+        result->clear();
+        if (count > 0)
+            find(1, 0, m_size, t, count, result);
+    }
+private:
+    void find(int node, int lo, int hi, qreal t, int count, QVector<int> *result) const {
+        if (lo >= count || m_max_end[node] < t)
+            return;
+        if (hi - lo == 1) {
+            result->append(lo);
+            return;
+        }
+        const int mid = (lo + hi)/2;
+        find(2*node, lo, mid, t, count, result);
+        find(2*node+1, mid, hi, t, count, result);
+    }
+    int m_size; // leaves, power of 2
+    QVector<qreal> m_max_end;
+};
 
 class Subtitle::Private {
 public:
@@ -53,9 +110,16 @@ public:
         , codec("AutoDetect")
         , t(0)
         , delay(0)
-        , current_count(0)
+        , index_dirty(true)
+        , lookahead(0)
         , force_font_file(false)
-    {}
+    {
+        load_pool.setMaxThreadCount(1);
+        prerender_pool.setMaxThreadCount(1);
+    }
+    bool isCanceled(int id) const {
+        return const_cast<QAtomicInt&>(load_id).fetchAndAddRelaxed(0) != id;
+    }
     void reset() {
         QMutexLocker lock(&mutex);
         Q_UNUSED(lock);
@@ -66,8 +130,17 @@ public:
         t = 0;
         frame = SubtitleFrame();
         frames.clear();
-        itf = frames.begin();
-        current_count = 0;
+        current.clear();
+        index_dirty = true;
+        clearPrerendered();
+    }
+    // keep frames in begin order
+    void addFrame(const SubtitleFrame& f) {
+        if (frames.isEmpty() || !beginLessThan(f, frames.last()))
+            frames.append(f);
+        else
+            frames.insert(std::upper_bound(frames.begin(), frames.end(), f, beginLessThan) - frames.begin(), f);
+        index_dirty = true;
     }
     // width/height == 0: do not create image
     // return true if both frame time and content(currently is text) changed
@@ -86,8 +159,16 @@ public:
      * support raw data
      * \param data utf8 subtitle content
      */
-    bool processRawData(const QByteArray& data);
+    bool processRawData(const QByteArray& data, int id);
     bool processRawData(SubtitleProcessor* sp, const QByteArray& data);
+    // mutex must be locked
+    void clearPrerendered() {
+        prerendered.clear();
+        prerender_gen.ref();
+    }
+    bool takePrerendered(qreal t, const QSize& size, QImage *image, QRect *boundingRect);
+    void schedulePrerender(qreal t);
+    class Prerenderer;
 
     bool loaded;
     bool fuzzy_match;
@@ -98,7 +179,7 @@ public:
     QList<SubtitleProcessor*> processors;
     QByteArray codec;
     QStringList engine_names;
-    QLinkedList<SubtitleFrame> frames;
+    QVector<SubtitleFrame> frames; // sorted by begin
     QUrl url;
     QByteArray raw_data;
     QString file_name;
@@ -112,12 +193,24 @@ public:
     SubtitleFrame frame;
     QString current_text;
     QImage current_image;
-    QLinkedList<SubtitleFrame>::iterator itf;
-    /* number of subtitle frames at current time.
-     * <0 means itf is the last. >0 means itf is the 1st
-     */
-    int current_count;
+    // indices of frames at current time
+    QVector<int> current;
+    SubtitleIndex index;
+    bool index_dirty;
     QMutex mutex;
+    // increased by load(), loadAsync() and cancelLoad(). a loading of an old id stops at the next check and is not published
+    QAtomicInt load_id;
+    QThreadPool load_pool; // 1 thread to load in order
+    struct PrerenderedImage {
+        QImage image;
+        QRect rect;
+    };
+    int lookahead;
+    // begin time of a cue -> image at that time in prerender_size
+    QMap<qreal, PrerenderedImage> prerendered;
+    QSize prerender_size;
+    QThreadPool prerender_pool; // 1 thread
+    QAtomicInt prerender_gen; // increased if pre-rendered images are invalid. pre-rendering of an old generation stops
 
     bool force_font_file;
     QString font_file;
@@ -134,6 +227,9 @@ Subtitle::Subtitle(QObject *parent) :
 
 Subtitle::~Subtitle()
 {
+    cancelLoad();
+    priv->load_pool.waitForDone();
+    priv->prerender_pool.waitForDone();
     if (priv) {
         delete priv;
         priv = 0;
@@ -340,6 +436,27 @@ qreal Subtitle::delay() const
     return priv->delay;
 }
 
+void Subtitle::setLookahead(int cues)
+{
+    if (cues < 0)
+        cues = 0;
+    if (priv->lookahead == cues)
+        return;
+    {
+        QMutexLocker lock(&priv->mutex);
+        Q_UNUSED(lock);
+        priv->lookahead = cues;
+        if (!cues)
+            priv->clearPrerendered();
+    }
+    Q_EMIT lookaheadChanged();
+}
+
+int Subtitle::lookahead() const
+{
+    return priv->lookahead;
+}
+
 QString Subtitle::fontFile() const
 {
     return priv->font_file;
@@ -390,6 +507,26 @@ void Subtitle::setFontFileForced(bool value)
 
 void Subtitle::load()
 {
+    // cancel and wait for async loading
+    const int id = priv->load_id.fetchAndAddOrdered(1) + 1;
+    priv->load_pool.waitForDone();
+    doLoad(id);
+}
+
+void Subtitle::cancelLoad()
+{
+    priv->load_id.fetchAndAddOrdered(1);
+}
+
+bool Subtitle::isLoading() const
+{
+    return priv->load_pool.activeThreadCount() > 0;
+}
+
+void Subtitle::doLoad(int id)
+{
+    if (priv->isCanceled(id))
+        return;
     SubtitleProcessor *old_processor = priv->processor;
     priv->reset();
     Q_EMIT contentChanged(); //notify user to update subtitle
@@ -403,7 +540,7 @@ void Subtitle::load()
     // raw data is set, file name and url are empty
     QByteArray u8 = priv->raw_data;
     if (!u8.isEmpty()) {
-        priv->loaded = priv->processRawData(u8);
+        priv->loaded = priv->processRawData(u8, id);
         if (priv->loaded)
             Q_EMIT loaded();
         checkCapability();
@@ -415,9 +552,9 @@ void Subtitle::load()
     QFile f(QUrl::fromPercentEncoding(priv->url.toEncoded()));
     if (f.exists()) {
         u8 = priv->readFromFile(f.fileName());
-        if (u8.isEmpty())
+        if (u8.isEmpty() || priv->isCanceled(id))
             return;
-        priv->loaded = priv->processRawData(u8);
+        priv->loaded = priv->processRawData(u8, id);
         if (priv->loaded)
             Q_EMIT loaded(QUrl::fromPercentEncoding(priv->url.toEncoded()));
         checkCapability();
@@ -434,12 +571,14 @@ void Subtitle::load()
         return;
     }
     foreach (const QString& path, paths) {
+        if (priv->isCanceled(id))
+            return;
         if (path.isEmpty())
             continue;
         u8 = priv->readFromFile(path);
         if (u8.isEmpty())
             continue;
-        if (!priv->processRawData(u8))
+        if (!priv->processRawData(u8, id))
             continue;
         priv->loaded = true;
         Q_EMIT loaded(path);
@@ -468,15 +607,17 @@ void Subtitle::loadAsync()
 {
     class Loader : public QRunnable {
     public:
-        Loader(Subtitle *sub) : m_sub(sub) {}
+        Loader(Subtitle *sub, int id) : m_sub(sub), m_id(id) {}
         void run() {
-            if (m_sub)
-                m_sub->load();
+            m_sub->doLoad(m_id);
         }
     private:
-        Subtitle *m_sub;
+        Subtitle *m_sub; // the destructor waits for loaders
+        int m_id;
     };
-    QThreadPool::globalInstance()->start(new Loader(this));
+    // the previous loading is canceled. tasks run in order in load_pool
+    const int id = priv->load_id.fetchAndAddOrdered(1) + 1;
+    priv->load_pool.start(new Loader(this, id));
 }
 
 bool Subtitle::canRender() const
@@ -490,18 +631,14 @@ QString Subtitle::getText() const
     Q_UNUSED(lock);
     if (!isLoaded())
         return QString();
-    if (!priv->current_count)
+    if (priv->current.isEmpty())
         return QString();
     if (!priv->update_text)
         return priv->current_text;
     priv->update_text = false;
     priv->current_text.clear();
-    const int count = qAbs(priv->current_count);
-    QLinkedList<SubtitleFrame>::iterator it = priv->current_count > 0 ? priv->itf : priv->itf + (priv->current_count+1);
-    for (int i = 0; i < count; ++i) {
-        priv->current_text.append(it->text).append(QStringLiteral("\n"));
-        ++it;
-    }
+    foreach (int i, priv->current)
+        priv->current_text.append(priv->frames.at(i).text).append(QStringLiteral("\n"));
     priv->current_text = priv->current_text.trimmed();
     return priv->current_text;
 }
@@ -515,7 +652,7 @@ QImage Subtitle::getImage(int width, int height, QRect* boundingRect)
     if (width == 0 || height == 0)
         return QImage();
 #if 0
-    if (!priv->current_count) //seems ok to use this code
+    if (priv->current.isEmpty()) //seems ok to use this code
         return QImage();
     // always render the image to support animations
     if (!priv->update_image
@@ -525,136 +662,190 @@ QImage Subtitle::getImage(int width, int height, QRect* boundingRect)
     priv->update_image = false;
     if (!canRender())
         return QImage();
+    const qreal t = priv->t - priv->delay;
+    if (priv->lookahead > 0) {
+        QImage image;
+        if (priv->takePrerendered(t, QSize(width, height), &image, boundingRect)) {
+            priv->current_image = image;
+            priv->schedulePrerender(t);
+            return priv->current_image;
+        }
+    }
     priv->processor->setFrameSize(width, height);
     // TODO: store bounding rect here and not in processor
-    priv->current_image = priv->processor->getImage(priv->t - priv->delay, boundingRect);
+    priv->current_image = priv->processor->getImage(t, boundingRect);
+    if (priv->lookahead > 0)
+        priv->schedulePrerender(t);
     return priv->current_image;
 }
 
+SubImageSet Subtitle::getSubImages(int width, int height, QRect *boundingRect)
+{
+    QMutexLocker lock(&priv->mutex);
+    Q_UNUSED(lock);
+    if (!isLoaded())
+        return SubImageSet();
+    if (width == 0 || height == 0)
+        return SubImageSet();
+    if (!canRender())
+        return SubImageSet();
+    priv->processor->setFrameSize(width, height);
+    return priv->processor->getSubImages(priv->t - priv->delay, boundingRect);
+}
+
 bool Subtitle::processHeader(const QByteArray& codec, const QByteArray &data)
 {
     qDebug() << "codec: " << codec;
     qDebug() << "header: " << data;
     SubtitleProcessor *old_processor = priv->processor;
-    priv->reset(); // reset for the new subtitle stream (internal)
+    // reset for the new subtitle stream (internal). processLine() in another thread does nothing until the processor is set
+    priv->reset();
     if (priv->processors.isEmpty())
         return false;
-    foreach (SubtitleProcessor *sp, priv->processors) {
-        if (sp->supportedTypes().contains(QLatin1String(codec))) {
-            priv->processor = sp;
+    SubtitleProcessor *sp = 0;
+    foreach (SubtitleProcessor *p, priv->processors) {
+        if (p->supportedTypes().contains(QLatin1String(codec))) {
+            sp = p;
             qDebug() << "current subtitle processor: " << sp->name();
             break;
         }
     }
-    if (old_processor != priv->processor)
-        Q_EMIT engineChanged();
-    if (!priv->processor) {
+    if (!sp) {
+        if (old_processor)
+            Q_EMIT engineChanged();
         qWarning("No subtitle processor supports the codec '%s'", codec.constData());
         return false;
     }
-    if (!priv->processor->processHeader(codec, data))
-        return false;
-    priv->loaded = true;
-
-    priv->processor->setFontFile(priv->font_file);
-    priv->processor->setFontsDir(priv->fonts_dir);
-    priv->processor->setFontFileForced(priv->force_font_file);
-    return true;
+    const bool ok = sp->processHeader(codec, data);
+    if (ok) {
+        sp->setFontFile(priv->font_file);
+        sp->setFontsDir(priv->fonts_dir);
+        sp->setFontFileForced(priv->force_font_file);
+    }
+    {
+        QMutexLocker lock(&priv->mutex);
+        Q_UNUSED(lock);
+        priv->processor = sp;
+        priv->loaded = ok;
+    }
+    if (old_processor != sp)
+        Q_EMIT engineChanged();
+    return ok;
 }
 
 bool Subtitle::processLine(const QByteArray &data, qreal pts, qreal duration)
 {
+    // called in the decoding thread of PlayerSubtitle. rendering waits for at most 1 line
+    QMutexLocker lock(&priv->mutex);
+    Q_UNUSED(lock);
     if (!priv->processor)
         return false;
     SubtitleFrame f = priv->processor->processLine(data, pts, duration);
     if (!f.isValid())
         return false; // TODO: if seek to previous position, an invalid frame is returned.
-    if (priv->frames.isEmpty() || priv->frames.last() < f) {
-        priv->frames.append(f);
-        priv->itf = priv->frames.begin();
-        return true;
-    }
-    // usually add to the end. TODO: test
-    QLinkedList<SubtitleFrame>::iterator it = priv->frames.end();
-    if (it != priv->frames.begin())
-        --it;
-    while (it != priv->frames.begin() && f < (*it)) {--it;}
-    if (it != priv->frames.begin()) // found in middle, insert before next
-        ++it;
-    priv->frames.insert(it, f);
-    priv->itf = it;
+    // usually add to the end
+    priv->addFrame(f);
     return true;
 }
 
 // DO NOT set frame's image to reduce memory usage
 // assume frame.text is already set
 // check previous text if now no subtitle
-bool Subtitle::Private::prepareCurrentFrame()
+class Subtitle::Private::Prerenderer : public QRunnable
 {
-    if (frames.isEmpty())
-        return false;
-    QLinkedList<SubtitleFrame>::iterator it = itf;
-    int found = 0;
-    const int old_current_count = current_count;
-    const qreal t = this->t - delay;
-    if (t < it->begin) {
-        while (it != frames.begin()) {
-            --it;
-            if (t > it->end) {
-                if (found > 0)
-                    break;
-                // no subtitle at that time. check previous text
-                if (old_current_count) {
-                    current_count = 0;
-                    return true;
-                }
-                return false;
-            }
-            if (t >= (*it).begin) {
-                if (found == 0)
-                    itf = it;
-                found++;
-            }
-        }
-        current_count = -found;
-        if (found > 0) {
-            frame = *it;
-            return true;
+public:
+    Prerenderer(Subtitle::Private *priv, const QList<qreal>& times, int gen) : m_priv(priv), m_times(times), m_gen(gen) {}
+    void run() {
+        // lock for every cue, so getImage() waits for at most 1 rendering
+        foreach (qreal t, m_times) {
+            QMutexLocker lock(&m_priv->mutex);
+            Q_UNUSED(lock);
+            if (m_priv->prerender_gen.fetchAndAddRelaxed(0) != m_gen || !m_priv->loaded || !m_priv->processor || !m_priv->processor->canRender())
+                return;
+            if (m_priv->prerendered.contains(t))
+                continue;
+            m_priv->processor->setFrameSize(m_priv->prerender_size.width(), m_priv->prerender_size.height());
+            PrerenderedImage image;
+            image.image = m_priv->processor->getImage(t, &image.rect);
+            m_priv->prerendered.insert(t, image);
         }
-        // no subtitle at that time. it == begin(). check previous text
-        if (old_current_count)
-            return true;
+    }
+private:
+    Subtitle::Private *m_priv; // Subtitle waits for pre-rendering in destructor
+    QList<qreal> m_times;
+    int m_gen;
+};
+
+bool Subtitle::Private::takePrerendered(qreal t, const QSize &size, QImage *image, QRect *boundingRect)
+{
+    if (size != prerender_size) {
+        clearPrerendered();
+        prerender_size = size;
+        return false;
+    }
+    const int n = std::upper_bound(frames.constBegin(), frames.constEnd(), t, timeLessThanBegin) - frames.constBegin();
+    if (n == 0)
+        return false;
+    // the latest cue beginning at or before t. images of earlier cues will never be used
+    const qreal begin = frames.at(n-1).begin;
+    QMap<qreal, PrerenderedImage>::iterator it = prerendered.begin();
+    while (it != prerendered.end() && it.key() < begin)
+        it = prerendered.erase(it);
+    if (it == prerendered.end() || it.key() != begin)
         return false;
+    // later images of a cue can be different because of animations
+    const bool ok = t - begin <= kPrerenderTolerance;
+    if (ok) {
+        *image = it.value().image;
+        if (boundingRect)
+            *boundingRect = it.value().rect;
     }
-    bool it_changed = false;
-    while (it != frames.end()) {
-        if (t > it->end) {
-            ++it;
-            it_changed = true;
+    prerendered.erase(it);
+    return ok;
+}
+
+void Subtitle::Private::schedulePrerender(qreal t)
+{
+    if (prerender_size.isEmpty() || prerender_pool.activeThreadCount() > 0)
+        return;
+    QList<qreal> times;
+    int cues = 0;
+    qreal last_begin = t;
+    const int n = std::upper_bound(frames.constBegin(), frames.constEnd(), t, timeLessThanBegin) - frames.constBegin();
+    for (int i = n; i < frames.size() && cues < lookahead; ++i) {
+        const qreal begin = frames.at(i).begin;
+        if (begin == last_begin)
             continue;
-        }
-        if (t < it->begin) {
-            if (found > 0)
-                break;
-            // no subtitle at that time. check previous text
-            if (old_current_count) {
-                current_count = 0;
-                return true;
-            }
-            return false;
-        }
-        if (found == 0)
-            itf = it;
-        ++found;
-        ++it;
+        last_begin = begin;
+        ++cues;
+        if (!prerendered.contains(begin))
+            times.append(begin);
+    }
+    if (times.isEmpty())
+        return;
+    prerender_pool.start(new Prerenderer(this, times, prerender_gen.fetchAndAddRelaxed(0)));
+}
+
+bool Subtitle::Private::prepareCurrentFrame()
+{
+    if (frames.isEmpty())
+        return false;
+    if (index_dirty) {
+        index.build(frames);
+        index_dirty = false;
     }
-    current_count = found;
-    if (found > 0)
-        return it_changed || current_count != old_current_count;
-    // no subtitle at that time, it == end(). check previous text
-    if (old_current_count)
-        return true;
-    return false;
+    const qreal t = this->t - delay;
+    // frames beginning <= t
+    const int count = std::upper_bound(frames.begin(), frames.end(), t, timeLessThanBegin) - frames.begin();
+    QVector<int> found;
+    index.find(t, count, &found);
+    if (found == current)
+        return false;
+    current = found;
+    if (!current.isEmpty())
+        frame = frames.at(current.first());
+    // no subtitle at that time now. previous text is cleared
+    return true;
 }
 
 QStringList Subtitle::Private::find()
@@ -747,7 +938,8 @@ QByteArray Subtitle::Private::readFromFile(const QString &path)
         } else if (codec.toLower() == "autodetect") {
             CharsetDetector det;
             if (det.isAvailable()) {
-                QByteArray charset = det.detect(f.readAll());
+                // the leading part is enough to detect, and much faster for large files
+                QByteArray charset = det.detect(f.read(kCharsetProbeSize));
                 qDebug("charset>>>>>>>>: %s", charset.constData());
                 f.seek(0);
                 if (!charset.isEmpty())
@@ -760,29 +952,49 @@ QByteArray Subtitle::Private::readFromFile(const QString &path)
     return ts.readAll().toUtf8();
 }
 
-bool Subtitle::Private::processRawData(const QByteArray &data)
+bool Subtitle::Private::processRawData(const QByteArray &data, int id)
 {
-    processor = 0;
-    frames.clear();
+    {
+        QMutexLocker lock(&mutex);
+        Q_UNUSED(lock);
+        processor = 0;
+        frames.clear();
+        current.clear();
+        index_dirty = true;
+        clearPrerendered();
+    }
     if (data.size() > kMaxSubtitleSize)
         return false;
-    foreach (SubtitleProcessor* sp, processors) {
-        if (processRawData(sp, data)) {
-            processor = sp;
+    // processors are not used by rendering while processor is null
+    SubtitleProcessor *sp = 0;
+    foreach (SubtitleProcessor* p, processors) {
+        if (isCanceled(id))
+            return false;
+        if (processRawData(p, data)) {
+            sp = p;
             break;
         }
     }
-    if (!processor)
+    if (!sp)
         return false;
-    QList<SubtitleFrame> fs(processor->frames());
+    QList<SubtitleFrame> fs(sp->frames());
     if (fs.isEmpty())
         return false;
-    std::sort(fs.begin(), fs.end());
+    std::sort(fs.begin(), fs.end(), beginLessThan);
+    QVector<SubtitleFrame> sorted;
+    sorted.reserve(fs.size());
     foreach (const SubtitleFrame& f, fs) {
-       frames.push_back(f);
+       sorted.push_back(f);
     }
-    itf = frames.begin();
-    frame = *itf;
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    if (isCanceled(id))
+        return false;
+    processor = sp;
+    frames = sorted;
+    current.clear();
+    index_dirty = true;
+    frame = frames.first();
     return true;
 }
 
@@ -53,6 +53,13 @@ QImage SubtitleProcessor::getImage(qreal pts, QRect *boundingRect)
     return QImage();
 }
 
+SubImageSet SubtitleProcessor::getSubImages(qreal pts, QRect *boundingRect)
+{
+    Q_UNUSED(pts)
+    Q_UNUSED(boundingRect)
+    return SubImageSet();
+}
+
 void SubtitleProcessor::setFrameSize(int width, int height)
 {
     if (width == m_width && height == m_height)
@@ -21,7 +21,6 @@
 
 #include "QtAV/private/SubtitleProcessor.h"
 #include <QtCore/QCoreApplication>
-#include <QtCore/QEventLoop>
 #include <QtCore/QDir>
 #include <QtCore/QFile>
 #include <QtCore/QMutex>
@@ -38,7 +37,70 @@
 #include <stdarg.h>
 #include <string>  //include after ass_api.h, stdio.h is included there in a different namespace
 
+int BlendASSRow_SSE2(unsigned* dst, const unsigned char* src, int w, unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+
 namespace QtAV {
+bool detect_sse2(); // GPUMemCopy.cpp
+static void ass_msg_cb(int level, const char *fmt, va_list va, void *data);
+
+/*!
+ * libass objects shared by all processors in the process.
+ * Loading fonts by the font provider (fontconfig scans all system fonts) can take seconds, so the renderer with default
+ * fonts is created once in a background thread started by the first processor. Subtitles are parsed without waiting for
+ * it and are rendered once it's ready. Processors with default font settings render with this renderer, so font and
+ * glyph caches are shared by all subtitles and players.
+ * libass objects from the same library are not thread safe, processors use them with mutex locked.
+ */
+class LibASSShared : protected ass::api
+{
+public:
+    LibASSShared();
+    ~LibASSShared();
+    ASS_Library* library() const { return m_lib;}
+    // start loading default fonts if not started
+    void initFontsAsync();
+    // renderer with default fonts. null if fonts are still loading. mutex must be locked
+    ASS_Renderer* renderer() const { return m_renderer;}
+    /*!
+     * \brief use
+     * Render for user with renderer() in width x height. mutex must be locked
+     * \return true if the last image of renderer() was rendered for another user or size
+     */
+    bool use(const void *user, int width, int height);
+    /*!
+     * \brief createRenderer
+     * Create a renderer and load fonts. Empty fontFile or fontsDir uses the default one. Blocks until fonts are loaded,
+     * mutex must not be locked
+     */
+    ASS_Renderer* createRenderer(const QString& fontFile, const QString& fontsDir, bool forceFontFile);
+    QMutex mutex;
+private:
+    // font_mutex must be locked
+    void resolveDefaultFonts();
+    void loadDefaultFonts();
+
+    class FontThread : public QThread {
+    public:
+        FontThread(LibASSShared *s) : m_s(s) {}
+        void run() Q_DECL_OVERRIDE { m_s->loadDefaultFonts();}
+    private:
+        LibASSShared *m_s;
+    };
+    ASS_Library *m_lib;
+    ASS_Renderer *m_renderer;
+    const void *m_user;
+    int m_width, m_height;
+    bool m_fonts_started;
+    // serializes fonts loading. ass_set_fonts_dir() changes the library, and ass_set_fonts() reads it
+    QMutex font_mutex;
+    // resolved default fonts settings
+    QString conf; //FC_CONFIG_FILE?
+    QString font; // if exists, fontconfig will be disabled and directly use this font
+    QString fontsdir;
+    QByteArray family; //fallback to Arial?
+    FontThread m_thread;
+};
+Q_GLOBAL_STATIC(LibASSShared, sharedASS)
 
 class SubtitleProcessorLibASS Q_DECL_FINAL: public SubtitleProcessor, protected ass::api
 {
@@ -56,6 +118,7 @@ public:
     bool canRender() const Q_DECL_OVERRIDE { return true;}
     QString getText(qreal pts) const Q_DECL_OVERRIDE;
     QImage getImage(qreal pts, QRect *boundingRect = 0) Q_DECL_OVERRIDE;
+    SubImageSet getSubImages(qreal pts, QRect *boundingRect = 0) Q_DECL_OVERRIDE;
     bool processHeader(const QByteArray& codec, const QByteArray& data) Q_DECL_OVERRIDE;
     SubtitleFrame processLine(const QByteArray& data, qreal pts = -1, qreal duration = 0) Q_DECL_OVERRIDE;
     void setFontFile(const QString& file) Q_DECL_OVERRIDE;
@@ -64,8 +127,13 @@ public:
 protected:
     void onFrameSizeChanged(int width, int height) Q_DECL_OVERRIDE;
 private:
-    bool initRenderer();
-    void updateFontCacheAsync();
+    // default font settings are rendered by the shared renderer, others by a private one
+    bool useSharedRenderer() const { return font_file.isEmpty() && fonts_dir.isEmpty() && !force_font_file;}
+    // check library and track, then update font cache if necessary
+    bool prepareRenderer();
+    // m_mutex must be locked. return null if the renderer is not ready
+    ASS_Image* renderFrame(qreal pts);
+    void releaseRenderer();
     // render 1 ass image into a 32bit QImage with alpha channel.
     //use dstX, dstY instead of img->dst_x/y because image size is small then ass renderer size
     void renderASS32(QImage *image, ASS_Image* img, int dstX, int dstY);
@@ -75,14 +143,21 @@ private:
     QString font_file;
     QString fonts_dir;
     QByteArray m_codec;
-    ASS_Library *m_ass;
-    ASS_Renderer *m_renderer;
+    ASS_Library *m_ass; // shared
+    ASS_Renderer *m_renderer; // private renderer for user font settings
     ASS_Track *m_track;
     QList<SubtitleFrame> m_frames;
     //cache the image for the last invocation. return this if image does not change
     QImage m_image;
+    // the image returned before m_image. reused as the render target if no one else holds it and the size does not change
+    QImage m_image_spare;
     QRect m_bound;
-    mutable QMutex m_mutex;
+    // increased if libass detects a change
+    int m_render_id;
+    int m_image_id;
+    SubImageSet m_sub_images;
+    QRect m_sub_images_bound;
+    QMutex &m_mutex; // shared by all processors
 };
 
 static const SubtitleProcessorId SubtitleProcessorId_LibASS = QStringLiteral("qtav.subtitle.processor.libass");
@@ -128,39 +203,233 @@ static void ass_msg_cb(int level, const char *fmt, va_list va, void *data)
         qDebug() << msg;
 }
 
+LibASSShared::LibASSShared()
+    : m_lib(0)
+    , m_renderer(0)
+    , m_user(0)
+    , m_width(0)
+    , m_height(0)
+    , m_fonts_started(false)
+    , m_thread(this)
+{
+    if (!ass::api::loaded())
+        return;
+    m_lib = ass_library_init();
+    if (!m_lib) {
+        qWarning("ass_library_init failed!");
+        return;
+    }
+    ass_set_message_cb(m_lib, ass_msg_cb, NULL);
+}
+
+LibASSShared::~LibASSShared()
+{
+    // the renderer and library are not released at exit. processors may still exist, and ass dll may be unloaded
+    m_thread.wait();
+}
+
+void LibASSShared::initFontsAsync()
+{
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    if (!m_lib || m_fonts_started)
+        return;
+    m_fonts_started = true;
+    m_thread.start(QThread::LowPriority);
+}
+
+bool LibASSShared::use(const void *user, int width, int height)
+{
+    bool changed = m_user != user;
+    m_user = user;
+    if (width > 0 && height > 0 && (width != m_width || height != m_height)) {
+        m_width = width;
+        m_height = height;
+        ass_set_frame_size(m_renderer, width, height);
+        changed = true;
+    }
+    return changed;
+}
+
+void LibASSShared::loadDefaultFonts()
+{
+    ASS_Renderer *r = createRenderer(QString(), QString(), false);
+    QMutexLocker lock(&mutex);
+    Q_UNUSED(lock);
+    m_renderer = r;
+}
+
+ASS_Renderer* LibASSShared::createRenderer(const QString &fontFile, const QString &fontsDir, bool forceFontFile)
+{
+    if (!m_lib)
+        return 0;
+    QMutexLocker lock(&font_mutex);
+    Q_UNUSED(lock);
+    resolveDefaultFonts();
+    //ass_set_extract_fonts(m_lib, 1); // embedded fonts are added to the library when parsing, lock mutex here if enabled
+    //ass_set_style_overrides(m_lib, 0);
+    ASS_Renderer *r = ass_renderer_init(m_lib);
+    if (!r) {
+        qWarning("ass_renderer_init failed!");
+        return 0;
+    }
+#if LIBASS_VERSION >= 0x01000000
+    ass_set_shaper(r, ASS_SHAPING_SIMPLE);
+#endif
+    // prefer user settings
+    const QString ft(fontFile.isEmpty() ? font : fontFile);
+    const QString dir(fontsDir.isEmpty() ? fontsdir : fontsDir);
+    // setup libass. the dir is read only when fonts are loaded below
+    ass_set_fonts_dir(m_lib, dir.isEmpty() ? NULL : dir.toUtf8().constData());
+    /* ass_set_fonts:
+     * fc/dfp=false(auto font provider): Prefer font provider to find a font(FC needs fonts.conf) in font_dir, or provider's configuration. If failed, try the given font
+     * fc/dfp=true(no font provider): only try the given font
+     */
+    // user can prefer font provider(forceFontFile=false), or disable font provider to force the given font
+    // if provider is enabled, libass can fallback to the given font if provider can not provide a font
+    if (ft.isEmpty()) { // always use font provider if not font file is set
+        qDebug("No font file is set, use font provider");
+        ass_set_fonts(r, NULL, family.constData(), !forceFontFile, conf.toUtf8().constData(), 1);
+    } else {
+        qDebug("Font file is set. force font file: %d", forceFontFile);
+        ass_set_fonts(r, ft.toUtf8().constData(), family.constData(), !forceFontFile, conf.toUtf8().constData(), 1);
+    }
+    //ass_fonts_update(r); // update in ass_set_fonts(....,1)
+    return r;
+}
+
+// TODO: set font cache dir. default is working dir which may be not writable on some platforms
+void LibASSShared::resolveDefaultFonts()
+{
+    // appdir/fonts/fonts.conf => appfontsdir/fonts.conf
+    // TODO: modify fontconfig cache dir in fonts.conf <dir></dir> then save to conf
+    if (conf.isEmpty()) {
+        conf = qApp->applicationDirPath().append(QLatin1String("/fonts/fonts.conf"));
+        if (!QFile(conf).exists()) {
+            conf =  Internal::Path::appFontsDir().append(QStringLiteral("/fonts.conf"));
+            QFile fc(conf);
+            if (!fc.exists()) {
+                QFile qrc_fc(QStringLiteral(":/fonts/fonts.conf"));
+                if (qrc_fc.exists()) {
+                    if (!QDir(Internal::Path::appFontsDir()).exists()) {
+                        if (!QDir().mkpath(Internal::Path::appFontsDir())) {
+                            qWarning("Failed to create fonts dir: %s", Internal::Path::appFontsDir().toUtf8().constData());
+                        }
+                    }
+                    qrc_fc.open(QIODevice::ReadOnly);
+                    fc.open(QIODevice::WriteOnly);
+                    fc.write(qrc_fc.readAll());
+                    qrc_fc.close();
+                    fc.close();
+                }
+            }
+        }
+        qDebug() << "FontConfig: " << conf;
+    }
+
+    // TODO: let user choose default font or FC
+    /*
+     * appdir/fonts has fonts
+     * - has default.ttf: use default.ttf and disable FC.
+     * - no default.ttf: appdir/fonts as FC fonts dir
+     * appFontsDir (appdir/fonts has no fonts)
+     * - no fonts:
+     *      - has qrc:/fonts/default.ttf: disable FC, save to appFontsDir and use the font
+     * - has fonts:
+     *      - has default.ttf and size>0: disable FC, save to appFontsDir and use the font
+     *      - no default.ttf: appFontsDir as FC fonts dir
+     * fontsDir if it has font files (appFontsDir has no fonts and qrc has no default.ttf): as FC fonts dir
+     * Skip setting fonts dir
+     */
+    if (fontsdir.isEmpty()) {
+        fontsdir = qApp->applicationDirPath().append(QLatin1String("/fonts"));
+        QDir d(fontsdir);
+        static const QStringList ft_filters = QStringList() << QStringLiteral("*.ttf") << QStringLiteral("*.otf") << QStringLiteral("*.ttc");
+        QStringList fonts = d.entryList(ft_filters, QDir::Files);
+        if (fonts.isEmpty()) {
+            fontsdir = Internal::Path::appFontsDir();
+            d = QDir(fontsdir);
+            fonts = d.entryList(ft_filters, QDir::Files);
+            if (fonts.isEmpty()) {
+                QFile qrc_ft(QStringLiteral(":/fonts/default.ttf"));
+                if (qrc_ft.exists() && qrc_ft.size() > 0) {
+                    if (!QDir(Internal::Path::appFontsDir()).exists()) {
+                        if (!QDir().mkpath(Internal::Path::appFontsDir())) {
+                            qWarning("Failed to create fonts dir: %s", Internal::Path::appFontsDir().toUtf8().constData());
+                        }
+                    }
+                    font = fontsdir.append(QStringLiteral("/default.ttf"));
+                    QFile ft(font);
+                    qrc_ft.open(QIODevice::ReadOnly);
+                    ft.open(QIODevice::WriteOnly);
+                    ft.write(qrc_ft.readAll());
+                    qrc_ft.close();
+                    ft.close();
+                } else {
+                    qDebug() << "No fonts in appFontsDir '" << fontsdir << "'' and no default font in qrc";
+                    fontsdir = Internal::Path::fontsDir(); //maybe empty (winrt)
+                    d = QDir(fontsdir);
+                    fonts = d.entryList(ft_filters, QDir::Files);
+                    if (fonts.isEmpty())
+                        fontsdir = QString();
+                    //if (fontsdir.isEmpty())
+                      //  fontsdir = Internal::Path::appFontsDir();
+                }
+            } else {
+                // check appFontsDir/default.ttf
+                qDebug() << "fonts dir: " << fontsdir << "  font files: " << fonts;
+                if (fonts.contains(QLatin1String("default.ttf"), Qt::CaseInsensitive)) {
+                    font = fontsdir.append(QStringLiteral("/default.ttf"));
+                }
+            }
+        } else {
+            // check appdir/fonts/default.ttf
+            qDebug() << "fonts dir: " << fontsdir << "  font files: " << fonts;
+            if (fonts.contains(QLatin1String("default.ttf"), Qt::CaseInsensitive)) {
+                font = fontsdir.append(QStringLiteral("/default.ttf"));
+            }
+        }
+    }
+    if (family.isEmpty()) {
+        family = qgetenv("QTAV_SUB_FONT_FAMILY_DEFAULT");
+          //Setting default font to the Arial from default.ttf (used if FontConfig fails)
+        if (family.isEmpty())
+            family = QByteArrayLiteral("Arial");
+    }
+}
+
 SubtitleProcessorLibASS::SubtitleProcessorLibASS()
     : m_update_cache(true)
-    , force_font_file(true)
+    , force_font_file(false)
     , m_ass(0)
     , m_renderer(0)
     , m_track(0)
+    , m_render_id(1)
+    , m_image_id(0)
+    , m_mutex(sharedASS()->mutex)
 {
     if (!ass::api::loaded())
         return;
-    m_ass = ass_library_init();
-    if (!m_ass) {
-        qWarning("ass_library_init failed!");
+    m_ass = sharedASS()->library();
+    if (!m_ass)
         return;
-    }
-    ass_set_message_cb(m_ass, ass_msg_cb, NULL);
+    // fonts are ready or loading while the subtitle is parsed
+    sharedASS()->initFontsAsync();
 }
 
 SubtitleProcessorLibASS::~SubtitleProcessorLibASS()
 { // ass dll is loaded if ass objects are available
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
     if (m_track) {
         ass_free_track(m_track);
         m_track = 0;
     }
     if (m_renderer) {
-        QMutexLocker lock(&m_mutex);
-        Q_UNUSED(lock);
-        ass_renderer_done(m_renderer); // check async update cache!!
+        ass_renderer_done(m_renderer);
         m_renderer = 0;
     }
-    if (m_ass) {
-        ass_library_done(m_ass);
-        m_ass = 0;
-    }
+    // the library is shared
 }
 
 SubtitleProcessorId SubtitleProcessorLibASS::id() const
@@ -306,41 +575,65 @@ QString SubtitleProcessorLibASS::getText(qreal pts) const
     return text.trimmed();
 }
 
-QImage SubtitleProcessorLibASS::getImage(qreal pts, QRect *boundingRect)
+// ASS_Image.color: 0xRRGGBBAA, AA is transparency
+#define _r(c)  ((c)>>24)
+#define _g(c)  (((c)>>16)&0xFF)
+#define _b(c)  (((c)>>8)&0xFF)
+#define _a(c)  ((c)&0xFF)
+
+bool SubtitleProcessorLibASS::prepareRenderer()
 { // ass dll is loaded if ass library is available
     {
     QMutexLocker lock(&m_mutex);
     Q_UNUSED(lock);
     if (!m_ass) {
         qWarning("ass library not available");
-        return QImage();
+        return false;
     }
     if (!m_track) {
         qWarning("ass track not available");
-        return QImage();
-    }
-    if (!m_renderer) {
-        initRenderer();
-        if (!m_renderer) {
-            qWarning("ass renderer not available");
-            return QImage();
-        }
+        return false;
     }
     }
     if (m_update_cache)
         updateFontCache();
+    return true;
+}
+
+ASS_Image* SubtitleProcessorLibASS::renderFrame(qreal pts)
+{
+    ASS_Renderer *renderer = m_renderer;
+    bool changed = false;
+    if (!renderer && useSharedRenderer()) {
+        renderer = sharedASS()->renderer();
+        if (!renderer) // default fonts are loading
+            return 0;
+        // change detection of libass compares with the last image of the renderer, which may be rendered by another processor
+        changed = sharedASS()->use(this, frameSize().width(), frameSize().height());
+    }
+    if (!renderer) //reset in setFontXXX
+        return 0;
+    int detect_change = 0;
+    ASS_Image *img = ass_render_frame(renderer, m_track, (long long)(pts * 1000.0), &detect_change);
+    // getImage() and getSubImages() may be both used, each result is valid if it's made from the latest change
+    if (detect_change || changed)
+        ++m_render_id;
+    return img;
+}
 
+QImage SubtitleProcessorLibASS::getImage(qreal pts, QRect *boundingRect)
+{
+    if (!prepareRenderer())
+        return QImage();
     QMutexLocker lock(&m_mutex);
     Q_UNUSED(lock);
-    if (!m_renderer) //reset in setFontXXX
-        return QImage();
-    int detect_change = 0;
-    ASS_Image *img = ass_render_frame(m_renderer, m_track, (long long)(pts * 1000.0), &detect_change);
-    if (!detect_change) {
+    ASS_Image *img = renderFrame(pts);
+    if (m_image_id == m_render_id) {
         if (boundingRect)
             *boundingRect = m_bound;
         return m_image;
     }
+    m_image_id = m_render_id;
     QRect rect(0, 0, 0, 0);
     ASS_Image *i = img;
     while (i) {
@@ -351,7 +644,13 @@ QImage SubtitleProcessorLibASS::getImage(qreal pts, QRect *boundingRect)
     if (boundingRect) {
         *boundingRect = m_bound;
     }
-    QImage image(rect.size(), QImage::Format_ARGB32);
+    // m_image was the result of the last call and may still be in use, render into the spare one, e.g. karaoke effects change every frame
+    QImage image;
+    if (m_image_spare.size() == rect.size() && m_image_spare.isDetached())
+        image = m_image_spare;
+    else
+        image = QImage(rect.size(), QImage::Format_ARGB32);
+    m_image_spare = QImage();
     image.fill(Qt::transparent);
     i = img;
     while (i) {
@@ -362,17 +661,51 @@ QImage SubtitleProcessorLibASS::getImage(qreal pts, QRect *boundingRect)
         renderASS32(&image, i, i->dst_x - rect.x(), i->dst_y - rect.y());
         i = i->next;
     }
+    m_image_spare = m_image;
     m_image = image;
     return image;
 }
 
+SubImageSet SubtitleProcessorLibASS::getSubImages(qreal pts, QRect *boundingRect)
+{
+    if (!prepareRenderer())
+        return SubImageSet();
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    ASS_Image *img = renderFrame(pts);
+    if (m_sub_images.id != m_render_id || m_sub_images.w != frameSize().width() || m_sub_images.h != frameSize().height()) {
+        m_sub_images = SubImageSet(frameSize().width(), frameSize().height(), m_render_id);
+        m_sub_images_bound = QRect();
+        for (ASS_Image *i = img; i; i = i->next) {
+            if (i->w <= 0 || i->h <= 0)
+                continue;
+            const quint8 a = 255 - _a(i->color);
+            if (a == 0)
+                continue;
+            m_sub_images_bound |= QRect(i->dst_x, i->dst_y, i->w, i->h);
+            SubImage s(i->dst_x, i->dst_y, i->w, i->h, i->w);
+            s.color = qRgba(_r(i->color), _g(i->color), _b(i->color), a);
+            s.data.resize(i->w*i->h);
+            const uchar *src = i->bitmap;
+            char *dst = s.data.data();
+            for (int y = 0; y < i->h; ++y) {
+                memcpy(dst, src, i->w);
+                src += i->stride;
+                dst += i->w;
+            }
+            m_sub_images.images.append(s);
+        }
+    }
+    if (boundingRect)
+        *boundingRect = m_sub_images_bound;
+    return m_sub_images;
+}
+
 void SubtitleProcessorLibASS::onFrameSizeChanged(int width, int height)
 {
     if (width < 0 || height < 0)
         return;
-    if (!m_renderer) {
-        initRenderer();
-    }
+    // the shared renderer is resized when rendering, the private one is resized when created
     if (!m_renderer)
         return;
     ass_set_frame_size(m_renderer, width, height);
@@ -427,172 +760,36 @@ void SubtitleProcessorLibASS::setFontsDir(const QString &dir)
     }
 }
 
-bool SubtitleProcessorLibASS::initRenderer()
+void SubtitleProcessorLibASS::updateFontCache()
 {
-    //ass_set_extract_fonts(m_ass, 1);
-    //ass_set_style_overrides(m_ass, 0);
-    m_renderer = ass_renderer_init(m_ass);
-    if (!m_renderer) {
-        qWarning("ass_renderer_init failed!");
-        return false;
+    if (!m_ass)
+        return;
+    m_update_cache = false;
+    if (useSharedRenderer()) {
+        releaseRenderer();
+        return;
     }
-#if LIBASS_VERSION >= 0x01000000
-    ass_set_shaper(m_renderer, ASS_SHAPING_SIMPLE);
-#endif
-    return true;
-}
-// TODO: set font cache dir. default is working dir which may be not writable on some platforms
-void SubtitleProcessorLibASS::updateFontCache()
-{ // ass dll is loaded if renderer is valid
+    // the renderer is private until it's ready, so the shared mutex is not locked while fonts are loading
+    ASS_Renderer *r = sharedASS()->createRenderer(font_file, fonts_dir, force_font_file);
+    if (!r)
+        return;
     QMutexLocker lock(&m_mutex);
     Q_UNUSED(lock);
-    if (!m_renderer)
-        return;
-    // appdir/fonts/fonts.conf => appfontsdir/fonts.conf
-    // TODO: modify fontconfig cache dir in fonts.conf <dir></dir> then save to conf
-    static QString conf; //FC_CONFIG_FILE?
-    if (conf.isEmpty()) {
-        conf = qApp->applicationDirPath().append(QLatin1String("/fonts/fonts.conf"));
-        if (!QFile(conf).exists()) {
-            conf =  Internal::Path::appFontsDir().append(QStringLiteral("/fonts.conf"));
-            QFile fc(conf);
-            if (!fc.exists()) {
-                QFile qrc_fc(QStringLiteral(":/fonts/fonts.conf"));
-                if (qrc_fc.exists()) {
-                    if (!QDir(Internal::Path::appFontsDir()).exists()) {
-                        if (!QDir().mkpath(Internal::Path::appFontsDir())) {
-                            qWarning("Failed to create fonts dir: %s", Internal::Path::appFontsDir().toUtf8().constData());
-                        }
-                    }
-                    qrc_fc.open(QIODevice::ReadOnly);
-                    fc.open(QIODevice::WriteOnly);
-                    fc.write(qrc_fc.readAll());
-                    qrc_fc.close();
-                    fc.close();
-                }
-            }
-        }
-        qDebug() << "FontConfig: " << conf;
-    }
-
-    // TODO: let user choose default font or FC
-    /*
-     * appdir/fonts has fonts
-     * - has default.ttf: use default.ttf and disable FC.
-     * - no default.ttf: appdir/fonts as FC fonts dir
-     * appFontsDir (appdir/fonts has no fonts)
-     * - no fonts:
-     *      - has qrc:/fonts/default.ttf: disable FC, save to appFontsDir and use the font
-     * - has fonts:
-     *      - has default.ttf and size>0: disable FC, save to appFontsDir and use the font
-     *      - no default.ttf: appFontsDir as FC fonts dir
-     * fontsDir if it has font files (appFontsDir has no fonts and qrc has no default.ttf): as FC fonts dir
-     * Skip setting fonts dir
-     */
-    static QString font; // if exists, fontconfig will be disabled and directly use this font
-    static QString fontsdir;
-    if (fontsdir.isEmpty()) {
-        fontsdir = qApp->applicationDirPath().append(QLatin1String("/fonts"));
-        QDir d(fontsdir);
-        static const QStringList ft_filters = QStringList() << QStringLiteral("*.ttf") << QStringLiteral("*.otf") << QStringLiteral("*.ttc");
-        QStringList fonts = d.entryList(ft_filters, QDir::Files);
-        if (fonts.isEmpty()) {
-            fontsdir = Internal::Path::appFontsDir();
-            d = QDir(fontsdir);
-            fonts = d.entryList(ft_filters, QDir::Files);
-            if (fonts.isEmpty()) {
-                QFile qrc_ft(QStringLiteral(":/fonts/default.ttf"));
-                if (qrc_ft.exists() && qrc_ft.size() > 0) {
-                    if (!QDir(Internal::Path::appFontsDir()).exists()) {
-                        if (!QDir().mkpath(Internal::Path::appFontsDir())) {
-                            qWarning("Failed to create fonts dir: %s", Internal::Path::appFontsDir().toUtf8().constData());
-                        }
-                    }
-                    font = fontsdir.append(QStringLiteral("/default.ttf"));
-                    QFile ft(font);
-                    qrc_ft.open(QIODevice::ReadOnly);
-                    ft.open(QIODevice::WriteOnly);
-                    ft.write(qrc_ft.readAll());
-                    qrc_ft.close();
-                    ft.close();
-                } else {
-                    qDebug() << "No fonts in appFontsDir '" << fontsdir << "'' and no default font in qrc";
-                    fontsdir = Internal::Path::fontsDir(); //maybe empty (winrt)
-                    d = QDir(fontsdir);
-                    fonts = d.entryList(ft_filters, QDir::Files);
-                    if (fonts.isEmpty())
-                        fontsdir = QString();
-                    //if (fontsdir.isEmpty())
-                      //  fontsdir = Internal::Path::appFontsDir();
-                }
-            } else {
-                // check appFontsDir/default.ttf
-                qDebug() << "fonts dir: " << fontsdir << "  font files: " << fonts;
-                if (fonts.contains(QLatin1String("default.ttf"), Qt::CaseInsensitive)) {
-                    font = fontsdir.append(QStringLiteral("/default.ttf"));
-                }
-            }
-        } else {
-            // check appdir/fonts/default.ttf
-            qDebug() << "fonts dir: " << fontsdir << "  font files: " << fonts;
-            if (fonts.contains(QLatin1String("default.ttf"), Qt::CaseInsensitive)) {
-                font = fontsdir.append(QStringLiteral("/default.ttf"));
-            }
-        }
-    }
-    static QByteArray family; //fallback to Arial?
-    if (family.isEmpty()) {
-        family = qgetenv("QTAV_SUB_FONT_FAMILY_DEFAULT");
-          //Setting default font to the Arial from default.ttf (used if FontConfig fails)
-        if (family.isEmpty())
-            family = QByteArrayLiteral("Arial");
-    }
-    // prefer user settings
-    if (!font_file.isEmpty())
-        font = font_file;
-    if (!fonts_dir.isEmpty())
-        fontsdir = fonts_dir;
-    // setup libass
-    if (!fontsdir.isEmpty())
-        ass_set_fonts_dir(m_ass, fontsdir.toUtf8().constData());
-    /* ass_set_fonts:
-     * fc/dfp=false(auto font provider): Prefer font provider to find a font(FC needs fonts.conf) in font_dir, or provider's configuration. If failed, try the given font
-     * fc/dfp=true(no font provider): only try the given font
-     */
-    // user can prefer font provider(force_font_file=false), or disable font provider to force the given font
-    // if provider is enabled, libass can fallback to the given font if provider can not provide a font
-    if (font.isEmpty()) { // always use font provider if not font file is set
-        qDebug("No font file is set, use font provider");
-        ass_set_fonts(m_renderer, NULL, family.constData(), !force_font_file, conf.toUtf8().constData(), 1);
-    } else {
-        qDebug("Font file is set. force font file: %d", force_font_file);
-        ass_set_fonts(m_renderer, font.toUtf8().constData(), family.constData(), !force_font_file, conf.toUtf8().constData(), 1);
-    }
-    //ass_fonts_update(m_renderer); // update in ass_set_fonts(....,1)
-    m_update_cache = false; //TODO: set true if user set a new font or fonts dir
+    if (m_renderer)
+        ass_renderer_done(m_renderer);
+    m_renderer = r;
+    if (frameSize().width() > 0 && frameSize().height() > 0)
+        ass_set_frame_size(m_renderer, frameSize().width(), frameSize().height());
 }
 
-void SubtitleProcessorLibASS::updateFontCacheAsync()
+void SubtitleProcessorLibASS::releaseRenderer()
 {
-    class FontCacheUpdater : public QThread {
-        SubtitleProcessorLibASS *sp;
-    public:
-        FontCacheUpdater(SubtitleProcessorLibASS *p) : sp(p) {}
-        void run() {
-            if (!sp)
-                return;
-            sp->updateFontCache();
-        }
-    };
-    FontCacheUpdater updater(this);
-    QEventLoop loop;
-    //QObject::connect(&updater, SIGNAL(finished()), &loop, SLOT(quit()));
-    updater.start();
-    while (updater.isRunning()) {
-        loop.processEvents();
-    }
-    //loop.exec(); // what if updater is finished before exec()?
-    //updater.wait();
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (!m_renderer)
+        return;
+    ass_renderer_done(m_renderer);
+    m_renderer = 0;
 }
 
 void SubtitleProcessorLibASS::processTrack(ASS_Track *track)
@@ -609,11 +806,6 @@ void SubtitleProcessorLibASS::processTrack(ASS_Track *track)
     }
 }
 
-#define _r(c)  ((c)>>24)
-#define _g(c)  (((c)>>16)&0xFF)
-#define _b(c)  (((c)>>8)&0xFF)
-#define _a(c)  ((c)&0xFF)
-
 #define qRgba2(r, g, b, a) ((a << 24) | (r << 16) | (g  << 8) | b)
 
 /*
@@ -664,8 +856,17 @@ void SubtitleProcessorLibASS::renderASS32(QImage *image, ASS_Image *img, int dst
     quint8 *src = img->bitmap;
     // use QRgb to avoid endian issue
     QRgb *dst = (QRgb*)image->constBits() + dstY * image->width() + dstX;
+#if QTAV_HAVE(SSE2)
+    const bool sse2 = detect_sse2();
+#endif
     for (int y = 0; y < img->h; ++y) {
-        for (int x = 0; x < img->w; ++x) {
+        int x = 0;
+#if QTAV_HAVE(SSE2)
+        // 4 pixels per step, the rest is blended below
+        if (sse2)
+            x = BlendASSRow_SSE2((unsigned*)dst, src, img->w, r, g, b, a);
+#endif
+        for (; x < img->w; ++x) {
             const unsigned k = ((unsigned) src[x])*a/255;
 #if USE_QRGBA
             const unsigned A = qAlpha(dst[x]);
@@ -692,10 +893,12 @@ void SubtitleProcessorLibASS::renderASS32(QImage *image, ASS_Image *img, int dst
                 // no need to &0xff because always be 0~255
                 dst[x] += qRgba2(k*(r-qRed(dst[x]))/255, k*(g-qGreen(dst[x]))/255, k*(b-qBlue(dst[x]))/255, k*(a-A)/255);
 #else
-                const unsigned R = ARGB32_R(c);
-                const unsigned G = ARGB32_G(c);
-                const unsigned B = ARGB32_B(c);
-                ARGB32_ADD(c, r == R ? 0 : k*(r-R)/255, g == G ? 0 : k*(g-G)/255, b == B ? 0 : k*(b-B)/255, a == A ? 0 : k*(a-A)/255);
+                // signed: k*(c-C)/255 must be rounded toward 0 if c < C
+                const int R = ARGB32_R(c);
+                const int G = ARGB32_G(c);
+                const int B = ARGB32_B(c);
+                const int K = k;
+                ARGB32_ADD(c, K*(r-R)/255, K*(g-G)/255, K*(b-B)/255, K*(a-(int)A)/255);
 #endif
             }
         }
@@ -0,0 +1,249 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "AudioTimeStretch.h"
+#include "QtAV/QtAV_Global.h"
+#include <math.h>
+#include <string.h>
+
+int DotProductFloat_SSE2(const float* a, const float* b, int n, float* sum);
+int DotProductFloat_AVX2(const float* a, const float* b, int n, float* sum);
+int DotProductFloat_NEON(const float* a, const float* b, int n, float* sum);
+
+namespace QtAV {
+bool detect_sse2(); // GPUMemCopy.cpp
+bool detect_avx2();
+bool detect_neon();
+namespace {
+// SoundTouch's defaults, good for both speech and music
+enum {
+    kSequenceMs = 40,
+    kSeekMs = 15,
+    kOverlapMs = 8
+};
+
+// simd kernels process a multiple of 8 or 16 floats, the rest is summed here
+float dot_product(const float* a, const float* b, int n)
+{
+    float sum = 0;
+    int i = 0;
+#if QTAV_HAVE(AVX2)
+    if (detect_avx2())
+        i = DotProductFloat_AVX2(a, b, n, &sum);
+    else
+#endif
+#if QTAV_HAVE(SSE2)
+    if (detect_sse2())
+        i = DotProductFloat_SSE2(a, b, n, &sum);
+    else
+#endif
+#if QTAV_HAVE(NEON)
+    if (detect_neon())
+        i = DotProductFloat_NEON(a, b, n, &sum);
+    else
+#endif
+    {}
+    for (; i < n; ++i)
+        sum += a[i]*b[i];
+    return sum;
+}
+} //namespace
+
+AudioTimeStretch::AudioTimeStretch()
+    : m_speed(1.0)
+    , m_channels(0)
+    , m_sequence(0)
+    , m_seek(0)
+    , m_overlap(0)
+    , m_in_start(0)
+    , m_in_end(0)
+    , m_pos(0)
+    , m_has_tail(false)
+{
+}
+
+bool AudioTimeStretch::isSupported(const AudioFormat &format)
+{
+    if (!format.isValid() || format.isPlanar() || format.channels() <= 0)
+        return false;
+    return format.sampleFormat() == AudioFormat::SampleFormat_Signed16
+            || format.sampleFormat() == AudioFormat::SampleFormat_Float;
+}
+
+void AudioTimeStretch::setAudioFormat(const AudioFormat &format)
+{
+    if (m_format == format)
+        return;
+    m_format = format;
+    m_channels = isSupported(format) ? format.channels() : 0;
+    const int sr = format.sampleRate();
+    m_sequence = sr*kSequenceMs/1000;
+    m_seek = sr*kSeekMs/1000;
+    m_overlap = sr*kOverlapMs/1000;
+    m_tail.resize(m_overlap*m_channels);
+    m_tail_mono.resize(m_overlap);
+    m_mono.resize(m_seek + m_overlap);
+    flush();
+}
+
+void AudioTimeStretch::setSpeed(qreal speed)
+{
+    if (speed <= 0)
+        return;
+    m_speed = speed;
+}
+
+void AudioTimeStretch::flush()
+{
+    m_in_start = m_in_end = 0;
+    m_pos = 0;
+    m_has_tail = false;
+}
+
+QByteArray AudioTimeStretch::process(const QByteArray &data)
+{
+    if (m_channels <= 0 || m_overlap <= 0)
+        return QByteArray();
+    const int ch = m_channels;
+    const int bps = m_format.bytesPerSample();
+    appendInput(data.constData(), data.size()/(ch*bps));
+    // a sequence and the continuation after it must be in the input for any start in the search window
+    const int avail = m_in_end - m_in_start;
+    int n = 0;
+    for (double p = m_pos; int(p) + m_seek + m_sequence + m_overlap <= avail; p += m_sequence*m_speed)
+        ++n;
+    if (n == 0)
+        return QByteArray();
+    const int out_bytes = n*m_sequence*ch*bps;
+    if (!m_out.isDetached() || out_bytes > m_out.capacity())
+        m_out = QByteArray();
+    m_out.resize(out_bytes);
+    char *dst = m_out.data();
+    for (int s = 0; s < n; ++s) {
+        const int base = m_in_start + int(m_pos);
+        const int start = m_has_tail ? base + seekBest(base) : base;
+        const float *src = m_in.constData() + start*ch;
+        if (m_has_tail) {
+            // crossfade from the continuation of the last sequence to the new one
+            float *t = m_tail.data();
+            for (int i = 0; i < m_overlap; ++i) {
+                const float w = float(i)/float(m_overlap);
+                for (int c = 0; c < ch; ++c, ++t)
+                    *t += (src[i*ch + c] - *t)*w;
+            }
+            store(m_tail.constData(), m_overlap*ch, dst);
+        } else {
+            store(src, m_overlap*ch, dst);
+        }
+        dst += m_overlap*ch*bps;
+        store(src + m_overlap*ch, (m_sequence - m_overlap)*ch, dst);
+        dst += (m_sequence - m_overlap)*ch*bps;
+        memcpy(m_tail.data(), src + m_sequence*ch, m_overlap*ch*sizeof(float));
+        const float *t = m_tail.constData();
+        for (int i = 0; i < m_overlap; ++i) {
+            float m = 0;
+            for (int c = 0; c < ch; ++c)
+                m += *t++;
+            m_tail_mono[i] = m;
+        }
+        m_has_tail = true;
+        m_pos += m_sequence*m_speed;
+    }
+    // the nominal position can be after the input end for speed > 1, then the following input is skipped
+    const int consumed = qMin(int(m_pos), m_in_end - m_in_start);
+    m_in_start += consumed;
+    m_pos -= consumed;
+    return m_out;
+}
+
+void AudioTimeStretch::appendInput(const char *data, int frames)
+{
+    if (frames <= 0)
+        return;
+    const int ch = m_channels;
+    if (m_in_start > 0 && (m_in_end + frames)*ch > m_in.size()) {
+        memmove(m_in.data(), m_in.constData() + m_in_start*ch, (m_in_end - m_in_start)*ch*sizeof(float));
+        m_in_end -= m_in_start;
+        m_in_start = 0;
+    }
+    if ((m_in_end + frames)*ch > m_in.size())
+        m_in.resize((m_in_end + frames)*ch);
+    float *dst = m_in.data() + m_in_end*ch;
+    const int nb_samples = frames*ch;
+    if (m_format.sampleFormat() == AudioFormat::SampleFormat_Float) {
+        memcpy(dst, data, nb_samples*sizeof(float));
+    } else {
+        const short *src = (const short*)data;
+        for (int i = 0; i < nb_samples; ++i)
+            dst[i] = float(src[i])*(1.0f/32768.0f);
+    }
+    m_in_end += frames;
+}
+
+int AudioTimeStretch::seekBest(int base)
+{
+    const int ch = m_channels;
+    const int len = m_seek + m_overlap;
+    const float *src = m_in.constData() + base*ch;
+    float *mono = m_mono.data();
+    for (int i = 0; i < len; ++i) {
+        float m = 0;
+        for (int c = 0; c < ch; ++c)
+            m += *src++;
+        mono[i] = m;
+    }
+    double energy = 0;
+    for (int i = 0; i < m_overlap; ++i)
+        energy += mono[i]*mono[i];
+    // normalized cross correlation. energy of the window is updated incrementally
+    int best = 0;
+    double best_score = 0;
+    for (int k = 0; k < m_seek; ++k) {
+        if (energy > 1e-9) {
+            const double score = dot_product(m_tail_mono.constData(), mono + k, m_overlap)/sqrt(energy);
+            if (score > best_score) {
+                best_score = score;
+                best = k;
+            }
+        }
+        energy += mono[k + m_overlap]*mono[k + m_overlap] - mono[k]*mono[k];
+    }
+    return best;
+}
+
+void AudioTimeStretch::store(const float *src, int nb_samples, char *dst) const
+{
+    if (m_format.sampleFormat() == AudioFormat::SampleFormat_Float) {
+        memcpy(dst, src, nb_samples*sizeof(float));
+        return;
+    }
+    short *d = (short*)dst;
+    for (int i = 0; i < nb_samples; ++i) {
+        const float x = src[i]*32768.0f;
+        if (x >= 32767.0f)
+            d[i] = 32767;
+        else if (x <= -32768.0f)
+            d[i] = -32768;
+        else
+            d[i] = short(x < 0 ? x - 0.5f : x + 0.5f);
+    }
+}
+} //namespace QtAV
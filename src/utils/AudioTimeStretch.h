@@ -0,0 +1,80 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_AUDIOTIMESTRETCH_H
+#define QTAV_AUDIOTIMESTRETCH_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QVector>
+#include "QtAV/AudioFormat.h"
+
+namespace QtAV {
+/*!
+ * \brief The AudioTimeStretch class
+ * Change the tempo of packed s16 or float audio without changing the pitch, by WSOLA(waveform similarity overlap-add).
+ * The output is made of fixed length sequences cut from the input, and neighbours are crossfaded. The start of a sequence is
+ * searched in a small window after its nominal position, where the waveform is the most similar to the natural continuation
+ * of the last sequence. The similarity is computed on all channels mixed down, by SIMD kernels if possible.
+ * Used by AudioThread if AudioOutput::preservesPitch() is true and speed is not 1.0
+ */
+class AudioTimeStretch
+{
+public:
+    AudioTimeStretch();
+    static bool isSupported(const AudioFormat& format);
+    /// buffered samples are discarded if format is changed
+    void setAudioFormat(const AudioFormat& format);
+    const AudioFormat& audioFormat() const { return m_format;}
+    /// tempo ratio. 2.0: output is half as long as input. can be changed at any time
+    void setSpeed(qreal speed);
+    qreal speed() const { return m_speed;}
+    /// discard buffered samples, e.g. after seeking
+    void flush();
+    /*!
+     * \brief process
+     * Append data and return the stretched samples available now, about data.size()/speed() bytes on average. The result can
+     * be empty while buffering. It's reused by the next call if not referenced any more, so no allocation is required for each call
+     */
+    QByteArray process(const QByteArray& data);
+    /// input samples per channel buffered and not output yet
+    int bufferedSamples() const { return m_in_end - m_in_start;}
+private:
+    void appendInput(const char* data, int frames);
+    // offset of the best sequence start in [base, base + seek) of the input
+    int seekBest(int base);
+    void store(const float* src, int nb_samples, char* dst) const;
+
+    AudioFormat m_format;
+    qreal m_speed;
+    int m_channels;
+    int m_sequence, m_seek, m_overlap; // in samples per channel
+    // interleaved float input. samples in [m_in_start, m_in_end) are not consumed
+    QVector<float> m_in;
+    int m_in_start, m_in_end;
+    double m_pos; // nominal start of the next sequence, relative to m_in_start
+    bool m_has_tail;
+    QVector<float> m_tail; // natural continuation of the last sequence, m_overlap samples
+    QVector<float> m_tail_mono;
+    QVector<float> m_mono; // mixed down search window
+    QByteArray m_out;
+};
+} //namespace QtAV
+#endif //QTAV_AUDIOTIMESTRETCH_H
@@ -0,0 +1,72 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <immintrin.h>
+
+// 256 bit version of AudioVolume_SSE2.cpp. unpack and pack work in 128 bit lanes, so the sample order is kept
+
+int ScaleSamplesS16_AVX2(short* dst, const short* src, int nb_samples, int volume)
+{
+    if (volume < 0 || volume > 0x7fff)
+        return 0;
+    const __m256i vol = _mm256_set1_epi16((short)volume);
+    const __m256i round = _mm256_set1_epi32(128);
+    int i = 0;
+    for (; i + 16 <= nb_samples; i += 16) {
+        const __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        const __m256i lo = _mm256_mullo_epi16(s, vol);
+        const __m256i hi = _mm256_mulhi_epi16(s, vol);
+        __m256i p0 = _mm256_unpacklo_epi16(lo, hi);
+        __m256i p1 = _mm256_unpackhi_epi16(lo, hi);
+        p0 = _mm256_srai_epi32(_mm256_add_epi32(p0, round), 8);
+        p1 = _mm256_srai_epi32(_mm256_add_epi32(p1, round), 8);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packs_epi32(p0, p1));
+    }
+    return i;
+}
+
+int ScaleSamplesFloat_AVX2(float* dst, const float* src, int nb_samples, float volume)
+{
+    const __m256 vol = _mm256_set1_ps(volume);
+    int i = 0;
+    for (; i + 16 <= nb_samples; i += 16) {
+        const __m256 s0 = _mm256_loadu_ps(src + i);
+        const __m256 s1 = _mm256_loadu_ps(src + i + 8);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(s0, vol));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(s1, vol));
+    }
+    _mm256_zeroupper();
+    return i;
+}
+
+int MixSamplesFloat_AVX2(float* dst, const float* src, int nb_samples, float volume)
+{
+    const __m256 vol = _mm256_set1_ps(volume);
+    int i = 0;
+    for (; i + 16 <= nb_samples; i += 16) {
+        const __m256 s0 = _mm256_mul_ps(_mm256_loadu_ps(src + i), vol);
+        const __m256 s1 = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), vol);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), s0));
+        _mm256_storeu_ps(dst + i + 8, _mm256_add_ps(_mm256_loadu_ps(dst + i + 8), s1));
+    }
+    _mm256_zeroupper();
+    return i;
+}
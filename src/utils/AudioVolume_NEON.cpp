@@ -0,0 +1,61 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <arm_neon.h>
+
+// NEON version of AudioVolume_SSE2.cpp. vrshrq_n_s32(x, 8) is (x + 128) >> 8, vqmovn_s32 saturates to 16 bit
+
+int ScaleSamplesS16_NEON(short* dst, const short* src, int nb_samples, int volume)
+{
+    if (volume < 0 || volume > 0x7fff)
+        return 0;
+    const int16x4_t vol = vdup_n_s16((int16_t)volume);
+    int i = 0;
+    for (; i + 8 <= nb_samples; i += 8) {
+        const int16x8_t s = vld1q_s16(src + i);
+        const int32x4_t p0 = vrshrq_n_s32(vmull_s16(vget_low_s16(s), vol), 8);
+        const int32x4_t p1 = vrshrq_n_s32(vmull_s16(vget_high_s16(s), vol), 8);
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(p0), vqmovn_s32(p1)));
+    }
+    return i;
+}
+
+int ScaleSamplesFloat_NEON(float* dst, const float* src, int nb_samples, float volume)
+{
+    int i = 0;
+    for (; i + 8 <= nb_samples; i += 8) {
+        const float32x4_t s0 = vld1q_f32(src + i);
+        const float32x4_t s1 = vld1q_f32(src + i + 4);
+        vst1q_f32(dst + i, vmulq_n_f32(s0, volume));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(s1, volume));
+    }
+    return i;
+}
+
+int MixSamplesFloat_NEON(float* dst, const float* src, int nb_samples, float volume)
+{
+    int i = 0;
+    for (; i + 8 <= nb_samples; i += 8) {
+        vst1q_f32(dst + i, vmlaq_n_f32(vld1q_f32(dst + i), vld1q_f32(src + i), volume));
+        vst1q_f32(dst + i + 4, vmlaq_n_f32(vld1q_f32(dst + i + 4), vld1q_f32(src + i + 4), volume));
+    }
+    return i;
+}
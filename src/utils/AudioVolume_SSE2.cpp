@@ -0,0 +1,72 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <emmintrin.h>
+
+// volume kernels of AudioOutput. volume is Q8 fixed point for integer samples: (s*volume + 128) >> 8, saturated.
+// Results are the same as the C version in AudioOutput.cpp. return processed samples, the caller scales the rest
+
+int ScaleSamplesS16_SSE2(short* dst, const short* src, int nb_samples, int volume)
+{
+    if (volume < 0 || volume > 0x7fff) // a 16 bit multiplier. 128x gain is never used
+        return 0;
+    const __m128i vol = _mm_set1_epi16((short)volume);
+    const __m128i round = _mm_set1_epi32(128);
+    int i = 0;
+    for (; i + 8 <= nb_samples; i += 8) {
+        const __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        const __m128i lo = _mm_mullo_epi16(s, vol);
+        const __m128i hi = _mm_mulhi_epi16(s, vol);
+        __m128i p0 = _mm_unpacklo_epi16(lo, hi); // 32 bit products
+        __m128i p1 = _mm_unpackhi_epi16(lo, hi);
+        p0 = _mm_srai_epi32(_mm_add_epi32(p0, round), 8);
+        p1 = _mm_srai_epi32(_mm_add_epi32(p1, round), 8);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(p0, p1));
+    }
+    return i;
+}
+
+int ScaleSamplesFloat_SSE2(float* dst, const float* src, int nb_samples, float volume)
+{
+    const __m128 vol = _mm_set1_ps(volume);
+    int i = 0;
+    for (; i + 8 <= nb_samples; i += 8) {
+        const __m128 s0 = _mm_loadu_ps(src + i);
+        const __m128 s1 = _mm_loadu_ps(src + i + 4);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(s0, vol));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(s1, vol));
+    }
+    return i;
+}
+
+// AudioMixer: dst += src*volume
+int MixSamplesFloat_SSE2(float* dst, const float* src, int nb_samples, float volume)
+{
+    const __m128 vol = _mm_set1_ps(volume);
+    int i = 0;
+    for (; i + 8 <= nb_samples; i += 8) {
+        const __m128 s0 = _mm_mul_ps(_mm_loadu_ps(src + i), vol);
+        const __m128 s1 = _mm_mul_ps(_mm_loadu_ps(src + i + 4), vol);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), s0));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), s1));
+    }
+    return i;
+}
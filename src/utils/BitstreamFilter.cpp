@@ -0,0 +1,166 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "BitstreamFilter.h"
+#include <QtCore/QStringList>
+#include "QtAV/private/AVCompat.h"
+#include "utils/Logger.h"
+
+#define QTAV_HAVE_AVBSF FFMPEG_MODULE_CHECK(LIBAVCODEC, 57, 37, 100)
+#if FFMPEG_MODULE_CHECK(LIBAVCODEC, 58, 91, 100)
+extern "C" {
+#include <libavcodec/bsf.h>
+}
+#endif
+
+namespace QtAV {
+
+BitstreamFilter::BitstreamFilter()
+{}
+
+BitstreamFilter::~BitstreamFilter()
+{
+    close();
+}
+
+bool BitstreamFilter::isSupported()
+{
+    return QTAV_HAVE_AVBSF;
+}
+
+bool BitstreamFilter::open(const QString &filters, const AVCodecContext *avctx, const AVRational &timeBase)
+{
+    close();
+#if QTAV_HAVE_AVBSF
+    const QStringList names(filters.split(QLatin1Char(','), QString::SkipEmptyParts));
+    if (names.isEmpty() || !avctx)
+        return false;
+    AVCodecParameters *par = avcodec_parameters_alloc();
+    int ret = avcodec_parameters_from_context(par, avctx);
+    AVRational tb = timeBase;
+    foreach (const QString& name, names) {
+        if (ret < 0)
+            break;
+        const AVBitStreamFilter *f = av_bsf_get_by_name(name.trimmed().toUtf8().constData());
+        if (!f) {
+            qWarning("bitstream filter '%s' not found", name.toUtf8().constData());
+            ret = AVERROR_BSF_NOT_FOUND;
+            break;
+        }
+        AVBSFContext *ctx = 0;
+        if ((ret = av_bsf_alloc(f, &ctx)) < 0)
+            break;
+        m_ctx.append(ctx);
+        // the output of a filter is the input of the next
+        if ((ret = avcodec_parameters_copy(ctx->par_in, par)) < 0)
+            break;
+        ctx->time_base_in = tb;
+        if ((ret = av_bsf_init(ctx)) < 0) {
+            qWarning("failed to init bitstream filter '%s': %s", f->name, av_err2str(ret));
+            break;
+        }
+        ret = avcodec_parameters_copy(par, ctx->par_out);
+        tb = ctx->time_base_out;
+    }
+    avcodec_parameters_free(&par);
+    if (ret < 0) {
+        close();
+        return false;
+    }
+    m_filters = filters;
+    return true;
+#else
+    Q_UNUSED(filters);
+    Q_UNUSED(avctx);
+    Q_UNUSED(timeBase);
+    qWarning("bitstream filter api is not supported by the FFmpeg");
+    return false;
+#endif //QTAV_HAVE_AVBSF
+}
+
+void BitstreamFilter::close()
+{
+#if QTAV_HAVE_AVBSF
+    foreach (AVBSFContext *ctx, m_ctx) {
+        av_bsf_free(&ctx);
+    }
+#endif //QTAV_HAVE_AVBSF
+    m_ctx.clear();
+    m_filters.clear();
+}
+
+bool BitstreamFilter::isOpen() const
+{
+    return !m_ctx.isEmpty();
+}
+
+bool BitstreamFilter::filter(AVPacket *pkt)
+{
+#if QTAV_HAVE_AVBSF
+    // the filters used for demuxed packets output 1 packet for 1 input, so no packet is left in the chain
+    foreach (AVBSFContext *ctx, m_ctx) {
+        // owned by the filter after sending. no copy
+        int ret = av_bsf_send_packet(ctx, pkt);
+        if (ret < 0) {
+            qWarning("failed to send packet to bitstream filter '%s': %s", ctx->filter->name, av_err2str(ret));
+            av_packet_unref(pkt);
+            return false;
+        }
+        ret = av_bsf_receive_packet(ctx, pkt);
+        if (ret == AVERROR(EAGAIN))
+            return false;
+        if (ret < 0) {
+            qWarning("bitstream filter '%s' error: %s", ctx->filter->name, av_err2str(ret));
+            return false;
+        }
+    }
+    return true;
+#else
+    Q_UNUSED(pkt);
+    return true;
+#endif //QTAV_HAVE_AVBSF
+}
+
+bool BitstreamFilter::applyParameters(AVCodecContext *avctx) const
+{
+#if QTAV_HAVE_AVBSF
+    if (m_ctx.isEmpty() || !avctx)
+        return false;
+    const AVCodecParameters *par = m_ctx.last()->par_out;
+    if (!par->extradata || par->extradata_size <= 0)
+        return false;
+    if (avctx->extradata_size == par->extradata_size && !memcmp(avctx->extradata, par->extradata, par->extradata_size))
+        return false;
+    uint8_t *extradata = (uint8_t*)av_mallocz(par->extradata_size + FF_INPUT_BUFFER_PADDING_SIZE);
+    if (!extradata)
+        return false;
+    memcpy(extradata, par->extradata, par->extradata_size);
+    av_freep(&avctx->extradata);
+    avctx->extradata = extradata;
+    avctx->extradata_size = par->extradata_size;
+    return true;
+#else
+    Q_UNUSED(avctx);
+    return false;
+#endif //QTAV_HAVE_AVBSF
+}
+
+} //namespace QtAV
@@ -0,0 +1,75 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_BITSTREAMFILTER_H
+#define QTAV_BITSTREAMFILTER_H
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+struct AVBSFContext;
+struct AVCodecContext;
+struct AVPacket;
+struct AVRational;
+namespace QtAV {
+/*!
+ * \brief The BitstreamFilter class
+ * A chain of FFmpeg bitstream filters (AVBSFContext) for the packets of a stream, e.g. "h264_mp4toannexb", "hevc_mp4toannexb"
+ * or "extract_extradata". Packets are filtered in place and stay refcounted, so no copy is made except the filters' own
+ * output. Requires FFmpeg >= 3.1, otherwise open() fails. Not thread safe.
+ */
+class BitstreamFilter
+{
+public:
+    BitstreamFilter();
+    ~BitstreamFilter();
+    /// whether the FFmpeg bitstream filter api is available
+    static bool isSupported();
+    /*!
+     * \brief open
+     * \param filters comma separated filter names
+     * \param avctx parameters of the input stream
+     * \param timeBase time base of the input packets
+     * \return false if a filter is not found or does not support the codec
+     */
+    bool open(const QString& filters, const AVCodecContext* avctx, const AVRational& timeBase);
+    void close();
+    bool isOpen() const;
+    QString filters() const { return m_filters;}
+    /*!
+     * \brief filter
+     * Replace pkt by the filtered packet. Properties (pts, flags etc.) are kept by the filters
+     * \return false if no packet is output, e.g. the filters need more input or failed. pkt is unreferenced then
+     */
+    bool filter(AVPacket* pkt);
+    /*!
+     * \brief applyParameters
+     * Copy extradata of the filtered stream, e.g. Annex B SPS/PPS for h264_mp4toannexb, to avctx, so a decoder opened with
+     * avctx accepts the filtered packets. Call it after open()
+     * \return true if avctx is changed
+     */
+    bool applyParameters(AVCodecContext* avctx) const;
+private:
+    QString m_filters;
+    QList<AVBSFContext*> m_ctx; // filters in chain order
+};
+} //namespace QtAV
+#endif //QTAV_BITSTREAMFILTER_H
@@ -0,0 +1,77 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <emmintrin.h>
+
+// alpha blending of libass bitmaps for SubtitleProcessorLibASS::renderASS32. dst is ARGB32 in memory order B, G, R, A.
+// k = src*a/255. dst pixel is set to (r, g, b, k) if its alpha is 0, otherwise C' = C + k*(c-C)/255 for every channel (a for alpha).
+// Results are the same as the C version. return processed pixels, the caller blends the rest
+
+// x/255 for x in [0, 255*255]
+static inline __m128i div255_epu16(__m128i x)
+{
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+// D + k*(c-D)/255, rounded toward 0 as C integer division
+static inline __m128i blend_epi16(__m128i D, __m128i c, __m128i k)
+{
+    const __m128i d = _mm_sub_epi16(c, D);
+    const __m128i s = _mm_srai_epi16(d, 15);
+    const __m128i q = div255_epu16(_mm_mullo_epi16(_mm_sub_epi16(_mm_xor_si128(d, s), s), k));
+    return _mm_add_epi16(D, _mm_sub_epi16(_mm_xor_si128(q, s), s));
+}
+
+static inline __m128i blend2_epi16(__m128i D, __m128i c, __m128i rgb_mask, __m128i k)
+{
+    const __m128i set = _mm_or_si128(_mm_and_si128(c, rgb_mask), _mm_andnot_si128(rgb_mask, k));
+    // broadcast alpha == 0 of each pixel to its 4 channels
+    __m128i z = _mm_cmpeq_epi16(D, _mm_setzero_si128());
+    z = _mm_shufflehi_epi16(_mm_shufflelo_epi16(z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_or_si128(_mm_and_si128(z, set), _mm_andnot_si128(z, blend_epi16(D, c, k)));
+}
+
+int BlendASSRow_SSE2(unsigned* dst, const unsigned char* src, int w, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c = _mm_setr_epi16(b, g, r, a, b, g, r, a);
+    const __m128i rgb_mask = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+    const __m128i va = _mm_set1_epi16(a);
+    int x = 0;
+    for (; x + 4 <= w; x += 4) {
+        const int s4 = (int)src[x] | ((int)src[x+1] << 8) | ((int)src[x+2] << 16) | ((int)src[x+3] << 24);
+        if (s4 == 0) {
+            // k == 0 keeps the pixel unless its alpha is 0
+            const __m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(d, 24), zero)) == 0)
+                continue;
+        }
+        __m128i k = div255_epu16(_mm_mullo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(s4), zero), va)); // k0 k1 k2 k3
+        k = _mm_unpacklo_epi16(k, k);
+        const __m128i k01 = _mm_unpacklo_epi32(k, k);
+        const __m128i k23 = _mm_unpackhi_epi32(k, k);
+        const __m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+        const __m128i d01 = blend2_epi16(_mm_unpacklo_epi8(d, zero), c, rgb_mask, k01);
+        const __m128i d23 = blend2_epi16(_mm_unpackhi_epi8(d, zero), c, rgb_mask, k23);
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(d01, d23));
+    }
+    return x;
+}
@@ -25,6 +25,7 @@
 
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QScopedPointer>
+#include <QtCore/QVector>
 #include <QtCore/QWaitCondition>
 
 //TODO: block full and empty condition separately
@@ -47,6 +48,11 @@ public:
     void setThreshold(int min); //wake up and enqueue
 
     void put(const T& t);
+    /*!
+     * \brief put
+     * Put all elements with 1 lock and at most 1 wait. The queue may exceed capacity by ts.size() - 1
+     */
+    void put(const QVector<T>& ts);
     T take();
     void setBlocking(bool block); //will wake if false. called when no more data can enqueue
     void blockEmpty(bool block);
@@ -153,6 +159,28 @@ void BlockingQueue<T, Container>::put(const T& t)
     }
 }
 
+template <typename T, template <typename> class Container>
+void BlockingQueue<T, Container>::put(const QVector<T>& ts)
+{
+    if (ts.isEmpty())
+        return;
+    QWriteLocker locker(&lock);
+    Q_UNUSED(locker);
+    if (checkFull()) {
+        if (full_callback) {
+            full_callback->call();
+        }
+        if (block_full)
+            cond_full.wait(&lock);
+    }
+    for (int i = 0; i < ts.size(); ++i) {
+        queue.enqueue(ts.at(i));
+        onPut(ts.at(i));
+    }
+    if (checkEnough())
+        cond_empty.wakeAll();
+}
+
 template <typename T, template <typename> class Container>
 T BlockingQueue<T, Container>::take()
 {
@@ -0,0 +1,161 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "CapabilityCache.h"
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+static const quint32 kMagic = 0x51484350; // "QHCP"
+static const quint32 kVersion = 1;
+static const char kFileName[] = "hwcaps.dat";
+
+CapabilityCache& CapabilityCache::instance()
+{
+    static CapabilityCache sCache;
+    return sCache;
+}
+
+CapabilityCache::CapabilityCache()
+    : m_loaded(false)
+{}
+
+void CapabilityCache::setDirectory(const QString &dir)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_dir == dir)
+        return;
+    m_dir = dir;
+    m_loaded = false;
+    if (m_dir.isEmpty())
+        return;
+    if (!QDir().mkpath(m_dir)) {
+        qWarning() << "CapabilityCache: failed to create directory " << m_dir;
+        m_dir.clear();
+    }
+}
+
+QString CapabilityCache::directory() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_dir;
+}
+
+bool CapabilityCache::get(const QString &key, const QByteArray &stamp, QVariantHash *caps)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (!m_loaded)
+        load();
+    QHash<QString, Entry>::const_iterator it = m_entries.constFind(key);
+    if (it == m_entries.constEnd())
+        return false;
+    const qint64 age = QDateTime::currentMSecsSinceEpoch()/1000LL - it->time;
+    if (it->stamp != stamp || age < 0 || age > kMaxAgeDays*24*3600) {
+        qDebug() << "CapabilityCache: " << key << " is out of date";
+        m_entries.remove(key);
+        return false;
+    }
+    *caps = it->caps;
+    return true;
+}
+
+void CapabilityCache::put(const QString &key, const QByteArray &stamp, const QVariantHash &caps)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (!m_loaded)
+        load();
+    Entry e;
+    e.stamp = stamp;
+    e.time = QDateTime::currentMSecsSinceEpoch()/1000LL;
+    e.caps = caps;
+    m_entries.insert(key, e);
+    save();
+}
+
+QByteArray CapabilityCache::fileStamp(const QStringList &paths)
+{
+    QByteArray s;
+    foreach (const QString& p, paths) {
+        const QFileInfo fi(p);
+        if (!fi.exists())
+            continue;
+        s += fi.absoluteFilePath().toUtf8();
+        s += ':' + QByteArray::number(fi.size()) + ':' + QByteArray::number(fi.lastModified().toMSecsSinceEpoch()/1000LL) + ';';
+    }
+    return s;
+}
+
+QString CapabilityCache::filePath() const
+{
+    return m_dir + QLatin1Char('/') + QLatin1String(kFileName);
+}
+
+void CapabilityCache::load()
+{
+    m_loaded = true;
+    if (m_dir.isEmpty())
+        return;
+    QFile f(filePath());
+    if (!f.open(QIODevice::ReadOnly))
+        return;
+    QDataStream ds(&f);
+    ds.setVersion(QDataStream::Qt_4_6);
+    quint32 magic = 0, version = 0, nb = 0;
+    ds >> magic >> version >> nb;
+    if (magic != kMagic || version != kVersion || ds.status() != QDataStream::Ok || nb > 1024)
+        return;
+    for (quint32 i = 0; i < nb; ++i) {
+        QString key;
+        Entry e;
+        ds >> key >> e.stamp >> e.time >> e.caps;
+        if (ds.status() != QDataStream::Ok)
+            return;
+        if (!m_entries.contains(key)) // probed in this process before the directory was set
+            m_entries.insert(key, e);
+    }
+}
+
+void CapabilityCache::save() const
+{
+    if (m_dir.isEmpty())
+        return;
+    QFile f(filePath());
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "CapabilityCache: failed to write " << f.fileName() << ": " << f.errorString();
+        return;
+    }
+    QDataStream ds(&f);
+    ds.setVersion(QDataStream::Qt_4_6);
+    ds << kMagic << kVersion << (quint32)m_entries.size();
+    for (QHash<QString, Entry>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+        ds << it.key() << it->stamp << it->time << it->caps;
+}
+
+} //namespace QtAV
@@ -0,0 +1,74 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_CAPABILITYCACHE_H
+#define QTAV_CAPABILITYCACHE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVariant>
+
+namespace QtAV {
+/*!
+ * \brief The CapabilityCache class
+ * Results of slow hardware capability probes, e.g. VA-API profiles of the driver and the CUDA device picked by the decoder,
+ * keyed by backend name. Hardware decoders look them up in open() to skip the probe, or to fail before loading the driver
+ * if the cached result says the codec can not be decoded. Entries are kept in memory, and in a file in directory() if
+ * setDirectory() is called with a non-empty path, so a cold start does not probe again.
+ * An entry is valid only if its stamp, e.g. fileStamp() of the driver files, does not change and it is not older than kMaxAgeDays.
+ */
+class CapabilityCache
+{
+public:
+    static CapabilityCache& instance();
+    /// dir empty: disable disk cache
+    void setDirectory(const QString& dir);
+    QString directory() const;
+    /// find a valid entry in memory, then in disk cache. return false if not found or stamp does not match
+    bool get(const QString& key, const QByteArray& stamp, QVariantHash *caps);
+    void put(const QString& key, const QByteArray& stamp, const QVariantHash& caps);
+    /*!
+     * \brief fileStamp
+     * Path, size and modification time of the existing files or directories. Changes if a driver is installed or upgraded
+     */
+    static QByteArray fileStamp(const QStringList& paths);
+private:
+    CapabilityCache();
+    QString filePath() const;
+    void load();
+    void save() const;
+
+    enum { kMaxAgeDays = 30 };
+    typedef struct {
+        QByteArray stamp;
+        qint64 time; // secs since epoch
+        QVariantHash caps;
+    } Entry;
+    mutable QMutex m_mutex;
+    QString m_dir;
+    bool m_loaded;
+    QHash<QString, Entry> m_entries;
+};
+} //namespace QtAV
+#endif // QTAV_CAPABILITYCACHE_H
@@ -0,0 +1,137 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <immintrin.h>
+#include <stdint.h> //intptr_t
+#include <string.h>
+
+// 256 bit version of CopyFrame_SSE4 and memcpy_sse4. see CopyFrame_SSE2.cpp
+// vmovntdqa ymm requires 32 bytes aligned address. The caller must ensure src, cache block and pitch are 32 bytes aligned
+
+#define CACHED_BUFFER_SIZE 4096
+#define UINT unsigned int
+
+// copy plane
+void CopyFrame_AVX2(void *pSrc, void *pDest, void *pCacheBlock, UINT width, UINT height, UINT pitch)
+{
+    __m256i y0, y1;
+    __m256i *pCache;
+    UINT x, y, yLoad, yStore;
+
+    // a row larger than the cache block (8K frames) is copied row by row. the cache is at least 1 row
+    UINT rowsPerBlock = pitch < CACHED_BUFFER_SIZE ? CACHED_BUFFER_SIZE / pitch : 1;
+    const UINT width64 = (width + 63) & ~0x03f;
+    const UINT extraPitch = (pitch - width64) / 32;
+
+    __m256i *pLoad  = (__m256i*)pSrc;
+    __m256i *pStore = (__m256i*)pDest;
+
+    const bool dst_unaligned = !!((intptr_t)pDest & 0x1f);
+    for (y = 0; y < height; y += rowsPerBlock) {
+        if (y + rowsPerBlock > height)
+            rowsPerBlock = height - y;
+
+        pCache = (__m256i *)pCacheBlock;
+
+        _mm_mfence();
+
+        // load rows of pitch width into cached block, a cache line at a time
+        for (yLoad = 0; yLoad < rowsPerBlock; yLoad++) {
+            for (x = 0; x < pitch; x += 64) {
+                y0 = _mm256_stream_load_si256(pLoad + 0);
+                y1 = _mm256_stream_load_si256(pLoad + 1);
+                _mm256_store_si256(pCache + 0, y0);
+                _mm256_store_si256(pCache + 1, y1);
+                pCache += 2;
+                pLoad += 2;
+            }
+        }
+
+        _mm_mfence();
+
+        pCache = (__m256i *)pCacheBlock;
+        // store rows of frame width from cached block
+        for (yStore = 0; yStore < rowsPerBlock; yStore++) {
+            for (x = 0; x < width64; x += 64) {
+                y0 = _mm256_load_si256(pCache);
+                y1 = _mm256_load_si256(pCache + 1);
+                if (dst_unaligned) {
+                    _mm256_storeu_si256(pStore, y0);
+                    _mm256_storeu_si256(pStore + 1, y1);
+                } else {
+                    // vmovntdq
+                    _mm256_stream_si256(pStore, y0);
+                    _mm256_stream_si256(pStore + 1, y1);
+                }
+                pCache += 2;
+                pStore += 2;
+            }
+            pCache += extraPitch;
+            pStore += extraPitch;
+        }
+    }
+    _mm_sfence();
+    _mm256_zeroupper(); // avoid avx-sse transition penalty in the caller
+}
+
+// src and dst must be 32 bytes aligned
+void *memcpy_avx2(void* dst, const void* src, size_t size)
+{
+    static const size_t kRegsInLoop = 8; // 256 bytes every loop
+    if (!dst || !src)
+        return NULL;
+    size_t reminder = size & (kRegsInLoop * sizeof(__m256i) - 1);
+    __m256i* pTrg = (__m256i*)dst;
+    __m256i* pTrgEnd = pTrg + ((size - reminder) >> 5);
+    __m256i* pSrc = (__m256i*)src;
+
+    _mm_sfence();
+    while (pTrg < pTrgEnd) {
+        const __m256i y0 = _mm256_stream_load_si256(pSrc);
+        const __m256i y1 = _mm256_stream_load_si256(pSrc + 1);
+        const __m256i y2 = _mm256_stream_load_si256(pSrc + 2);
+        const __m256i y3 = _mm256_stream_load_si256(pSrc + 3);
+        const __m256i y4 = _mm256_stream_load_si256(pSrc + 4);
+        const __m256i y5 = _mm256_stream_load_si256(pSrc + 5);
+        const __m256i y6 = _mm256_stream_load_si256(pSrc + 6);
+        const __m256i y7 = _mm256_stream_load_si256(pSrc + 7);
+        pSrc += kRegsInLoop;
+        _mm256_store_si256(pTrg    , y0);
+        _mm256_store_si256(pTrg + 1, y1);
+        _mm256_store_si256(pTrg + 2, y2);
+        _mm256_store_si256(pTrg + 3, y3);
+        _mm256_store_si256(pTrg + 4, y4);
+        _mm256_store_si256(pTrg + 5, y5);
+        _mm256_store_si256(pTrg + 6, y6);
+        _mm256_store_si256(pTrg + 7, y7);
+        pTrg += kRegsInLoop;
+    }
+    // copy in 32 byte steps
+    const size_t end = reminder >> 5;
+    for (size_t i = 0; i < end; ++i)
+        _mm256_store_si256(pTrg + i, _mm256_stream_load_si256(pSrc + i));
+    // last bytes. shouldn't happen as strides are modulo 32
+    reminder &= 31;
+    if (reminder)
+        memcpy(pTrg + end, pSrc + end, reminder);
+    _mm256_zeroupper();
+    return dst;
+}
@@ -0,0 +1,104 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <arm_neon.h>
+#include <stdint.h>
+#include <string.h>
+
+// arm has no streaming load from uncached memory like movntdqa. Reading 64 bytes per iteration with NEON registers makes
+// full bursts on the bus, which is much faster than byte or word reads of libc memcpy on uncached buffers (e.g. cedarv)
+#define UINT unsigned int
+
+void *memcpy_neon(void* dst, const void* src, size_t size)
+{
+    if (!dst || !src)
+        return NULL;
+    uint8_t *d = (uint8_t*)dst;
+    const uint8_t *s = (const uint8_t*)src;
+    for (size_t n = size >> 6; n > 0; --n) {
+#if defined(__GNUC__)
+        __builtin_prefetch(s + 256);
+#endif
+        const uint8x16_t q0 = vld1q_u8(s);
+        const uint8x16_t q1 = vld1q_u8(s + 16);
+        const uint8x16_t q2 = vld1q_u8(s + 32);
+        const uint8x16_t q3 = vld1q_u8(s + 48);
+        vst1q_u8(d, q0);
+        vst1q_u8(d + 16, q1);
+        vst1q_u8(d + 32, q2);
+        vst1q_u8(d + 48, q3);
+        s += 64;
+        d += 64;
+    }
+    size &= 63;
+    if (size)
+        memcpy(d, s, size);
+    return dst;
+}
+
+// split rows of interleaved 2 component (uv) plane into 2 planes. see SplitUV_SSE2
+void SplitUV_NEON(void *pSrc, void *pDstU, void *pDstV, UINT pairs, UINT height, UINT srcPitch, UINT dstPitch, UINT bytes, UINT shift)
+{
+    const int16x8_t sh = vdupq_n_s16(-(int16_t)shift); // shift left by negative value is shift right
+    for (UINT y = 0; y < height; ++y) {
+        const uint8_t *src = (const uint8_t*)pSrc + y*srcPitch;
+        uint8_t *u = (uint8_t*)pDstU + y*dstPitch;
+        uint8_t *v = (uint8_t*)pDstV + y*dstPitch;
+        UINT x = 0;
+        if (bytes == 1) {
+            for (; x + 16 <= pairs; x += 16) {
+                const uint8x16x2_t uv = vld2q_u8(src + 2*x);
+                vst1q_u8(u + x, uv.val[0]);
+                vst1q_u8(v + x, uv.val[1]);
+            }
+            for (; x < pairs; ++x) {
+                u[x] = src[2*x];
+                v[x] = src[2*x+1];
+            }
+            continue;
+        }
+        const uint16_t *s16 = (const uint16_t*)src;
+        uint16_t *u16 = (uint16_t*)u;
+        uint16_t *v16 = (uint16_t*)v;
+        for (; x + 8 <= pairs; x += 8) {
+            const uint16x8x2_t uv = vld2q_u16(s16 + 2*x);
+            vst1q_u16(u16 + x, vshlq_u16(uv.val[0], sh));
+            vst1q_u16(v16 + x, vshlq_u16(uv.val[1], sh));
+        }
+        for (; x < pairs; ++x) {
+            u16[x] = s16[2*x] >> shift;
+            v16[x] = s16[2*x+1] >> shift;
+        }
+    }
+}
+
+// copy plane. no cache block is used
+void CopyFrame_NEON(void *pSrc, void *pDest, void *pCacheBlock, UINT width, UINT height, UINT pitch)
+{
+    (void)pCacheBlock;
+    const uint8_t *s = (const uint8_t*)pSrc;
+    uint8_t *d = (uint8_t*)pDest;
+    for (UINT y = 0; y < height; ++y) {
+        memcpy_neon(d, s, width);
+        s += pitch;
+        d += pitch;
+    }
+}
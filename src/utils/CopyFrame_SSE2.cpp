@@ -56,7 +56,8 @@ void CopyFrame_SSE2(void *pSrc, void *pDest, void *pCacheBlock, UINT width, UINT
     __m128i		*pCache;
     UINT		x, y, yLoad, yStore;
 
-    UINT rowsPerBlock = CACHED_BUFFER_SIZE / pitch;
+    // a row larger than the cache block (8K frames) is copied row by row. the cache is at least 1 row
+    UINT rowsPerBlock = pitch < CACHED_BUFFER_SIZE ? CACHED_BUFFER_SIZE / pitch : 1;
     const UINT width64 = (width + 63) & ~0x03f;
     const UINT extraPitch = (pitch - width64) / 16;
 
@@ -238,3 +239,57 @@ void *memcpy_sse2(void* dst, const void* src, size_t size)
 
     return dst;
 }
+
+// split rows of interleaved 2 component (uv) plane into 2 planes, e.g. nv12 to yuv420p
+// bytes: bytes per component, 1 or 2. shift: right shift of 16 bit components, e.g. 6 for p010 to get values in low bits
+void SplitUV_SSE2(void *pSrc, void *pDstU, void *pDstV, UINT pairs, UINT height, UINT srcPitch, UINT dstPitch, UINT bytes, UINT shift)
+{
+    const __m128i mask8 = _mm_set1_epi16(0x00ff);
+    const __m128i mask16 = _mm_set1_epi32(0x0000ffff);
+    // no unsigned saturation for 32 to 16 bit in sse2. add a bias to pack in signed range
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    for (UINT y = 0; y < height; ++y) {
+        uint8_t *src = (uint8_t*)pSrc + y*srcPitch;
+        uint8_t *u = (uint8_t*)pDstU + y*dstPitch;
+        uint8_t *v = (uint8_t*)pDstV + y*dstPitch;
+        __m128i *pLoad = (__m128i*)src;
+        const bool src_unaligned = !!((intptr_t)src & 0x0f);
+        UINT x = 0;
+        if (bytes == 1) {
+            for (; x + 16 <= pairs; x += 16) {
+                const __m128i x0 = src_unaligned ? _mm_loadu_si128(pLoad) : STREAM_LOAD_SI128(pLoad);
+                const __m128i x1 = src_unaligned ? _mm_loadu_si128(pLoad + 1) : STREAM_LOAD_SI128(pLoad + 1);
+                pLoad += 2;
+                _mm_storeu_si128((__m128i*)(u + x), _mm_packus_epi16(_mm_and_si128(x0, mask8), _mm_and_si128(x1, mask8)));
+                _mm_storeu_si128((__m128i*)(v + x), _mm_packus_epi16(_mm_srli_epi16(x0, 8), _mm_srli_epi16(x1, 8)));
+            }
+            for (; x < pairs; ++x) {
+                u[x] = src[2*x];
+                v[x] = src[2*x+1];
+            }
+            continue;
+        }
+        uint16_t *u16 = (uint16_t*)u;
+        uint16_t *v16 = (uint16_t*)v;
+        for (; x + 8 <= pairs; x += 8) {
+            __m128i x0 = src_unaligned ? _mm_loadu_si128(pLoad) : STREAM_LOAD_SI128(pLoad);
+            __m128i x1 = src_unaligned ? _mm_loadu_si128(pLoad + 1) : STREAM_LOAD_SI128(pLoad + 1);
+            pLoad += 2;
+            x0 = _mm_srl_epi16(x0, sh);
+            x1 = _mm_srl_epi16(x1, sh);
+            const __m128i u0 = _mm_sub_epi32(_mm_and_si128(x0, mask16), bias32);
+            const __m128i u1 = _mm_sub_epi32(_mm_and_si128(x1, mask16), bias32);
+            const __m128i v0 = _mm_sub_epi32(_mm_srli_epi32(x0, 16), bias32);
+            const __m128i v1 = _mm_sub_epi32(_mm_srli_epi32(x1, 16), bias32);
+            _mm_storeu_si128((__m128i*)(u16 + x), _mm_add_epi16(_mm_packs_epi32(u0, u1), bias16));
+            _mm_storeu_si128((__m128i*)(v16 + x), _mm_add_epi16(_mm_packs_epi32(v0, v1), bias16));
+        }
+        const uint16_t *s16 = (const uint16_t*)src;
+        for (; x < pairs; ++x) {
+            u16[x] = s16[2*x] >> shift;
+            v16[x] = s16[2*x+1] >> shift;
+        }
+    }
+}
@@ -39,3 +39,8 @@ void *memcpy_sse4(void* dst, const void* src, size_t size)
 {
     return sse4::memcpy_sse2(dst, src, size);
 }
+
+void SplitUV_SSE4(void *pSrc, void *pDstU, void *pDstV, UINT pairs, UINT height, UINT srcPitch, UINT dstPitch, UINT bytes, UINT shift)
+{
+    sse4::SplitUV_SSE2(pSrc, pDstU, pDstV, pairs, height, srcPitch, dstPitch, bytes, shift);
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "DecodeThreadScheduler.h"
+#include <QtCore/QThread>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+DecodeThreadScheduler& DecodeThreadScheduler::instance()
+{
+    static DecodeThreadScheduler sScheduler;
+    return sScheduler;
+}
+
+DecodeThreadScheduler::DecodeThreadScheduler()
+    : m_max_threads(0)
+    , m_active_threads(0)
+{}
+
+void DecodeThreadScheduler::setMaxThreads(int value)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_max_threads = qMax(0, value);
+}
+
+int DecodeThreadScheduler::maxThreads() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return maxThreadsLocked();
+}
+
+int DecodeThreadScheduler::activeThreads() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_active_threads;
+}
+
+int DecodeThreadScheduler::acquire(const void *key, int priority)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    QHash<const void*, Share>::iterator it = m_shares.find(key);
+    if (it != m_shares.end()) {
+        m_active_threads -= it.value().threads;
+        m_shares.erase(it);
+    }
+    Share s;
+    s.priority = priority;
+    s.threads = 0;
+    s.target = 1;
+    it = m_shares.insert(key, s);
+    rebalanceLocked();
+    it.value().threads = it.value().target;
+    m_active_threads += it.value().threads;
+    qDebug("decode threads: %d (priority: %d). active: %d/%d", it.value().threads, priority, m_active_threads, maxThreadsLocked());
+    return it.value().threads;
+}
+
+void DecodeThreadScheduler::release(const void *key)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    QHash<const void*, Share>::iterator it = m_shares.find(key);
+    if (it == m_shares.end())
+        return;
+    m_active_threads -= it.value().threads;
+    m_shares.erase(it);
+    rebalanceLocked();
+}
+
+void DecodeThreadScheduler::rebalanceLocked()
+{
+    int weights = 0;
+    foreach (const Share& s, m_shares) {
+        weights += qMax(0, s.priority);
+    }
+    const int total = maxThreadsLocked();
+    QHash<const void*, Share>::iterator it = m_shares.begin();
+    for (; it != m_shares.end(); ++it) {
+        Share &s = it.value();
+        s.target = s.priority > 0 ? qMax(1, total*s.priority/weights) : 1;
+        if (s.threads > 0 && s.threads != s.target)
+            qDebug("decode threads of %p: %d => %d when opened again", it.key(), s.threads, s.target);
+    }
+}
+
+int DecodeThreadScheduler::maxThreadsLocked() const
+{
+    if (m_max_threads > 0)
+        return m_max_threads;
+    return qMax(1, QThread::idealThreadCount());
+}
+
+} //namespace QtAV
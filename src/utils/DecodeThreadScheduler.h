@@ -0,0 +1,74 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_DECODETHREADSCHEDULER_H
+#define QTAV_DECODETHREADSCHEDULER_H
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+
+namespace QtAV {
+/*!
+ * \brief The DecodeThreadScheduler class
+ * Process wide budget of software decoding threads. Many decoders running at the same time, e.g. a video wall, share
+ * maxThreads() instead of creating idealThreadCount() threads each.
+ * A decoder acquires its thread count before the codec is opened and releases it when closed. The count is a share of
+ * maxThreads() weighted by the priorities of all registered decoders. At least 1 thread is given.
+ * Shares are recomputed when a decoder is added or released. The thread count of an opened codec can not be changed, so
+ * a new share is applied when the decoder is opened again, e.g. seek to a new stream, and activeThreads() can be
+ * larger than maxThreads() until then.
+ * Priority: <=0 background (always 1 thread), 1 normal, >1 visible or focused players.
+ */
+class DecodeThreadScheduler
+{
+public:
+    static DecodeThreadScheduler& instance();
+    /// 0: QThread::idealThreadCount() (default). Takes effect for decoders opened later
+    void setMaxThreads(int value);
+    int maxThreads() const;
+    /// threads held by opened decoders
+    int activeThreads() const;
+    /*!
+     * \brief acquire
+     * \param key the decoder. acquire() again with the same key releases the old share first
+     * \return thread count the decoder should use
+     */
+    int acquire(const void* key, int priority = 1);
+    void release(const void* key);
+private:
+    DecodeThreadScheduler();
+    // m_mutex must be locked
+    int maxThreadsLocked() const;
+    // m_mutex must be locked. update target of all shares
+    void rebalanceLocked();
+
+    struct Share {
+        int threads; // used by the opened decoder
+        int priority;
+        int target; // fair share now
+    };
+    mutable QMutex m_mutex;
+    QHash<const void*, Share> m_shares;
+    int m_max_threads;
+    int m_active_threads;
+};
+} //namespace QtAV
+#endif // QTAV_DECODETHREADSCHEDULER_H
@@ -0,0 +1,110 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "DevicePlacement.h"
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+DevicePlacement& DevicePlacement::instance()
+{
+    static DevicePlacement sPlacement;
+    return sPlacement;
+}
+
+int DevicePlacement::acquire(const void *key, const QString &backend, int count, int device, Policy policy, int defaultDevice)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    releaseLocked(key);
+    if (count <= 0)
+        return -1;
+    int dev = qBound(0, defaultDevice, count - 1);
+    if (device >= 0) {
+        if (device < count)
+            dev = device;
+        else
+            qWarning("%s device %d is out of range [0, %d). use device %d", qPrintable(backend), device, count, dev);
+    } else if (policy == RoundRobin) {
+        int &next = m_next[backend];
+        dev = next % count;
+        next = (dev + 1) % count;
+    } else if (policy == LeastLoaded) {
+        const QHash<int, int> &active = m_active[backend];
+        const QHash<int, int> &utilization = m_utilization[backend];
+        // the default device wins a tie, so 1 player behaves as without placement
+        int best_sessions = active.value(dev);
+        int best_load = utilization.value(dev, -1);
+        for (int i = 0; i < count; ++i) {
+            const int n = active.value(i);
+            const int load = utilization.value(i, -1);
+            if (n < best_sessions || (n == best_sessions && load >= 0 && best_load >= 0 && load < best_load)) {
+                dev = i;
+                best_sessions = n;
+                best_load = load;
+            }
+        }
+    }
+    Session s;
+    s.backend = backend;
+    s.device = dev;
+    m_sessions.insert(key, s);
+    const int n = ++m_active[backend][dev];
+    qDebug("%s decoder placed on device %d/%d. sessions: %d", qPrintable(backend), dev, count, n);
+    return dev;
+}
+
+void DevicePlacement::release(const void *key)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    releaseLocked(key);
+}
+
+int DevicePlacement::sessions(const QString &backend, int device) const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_active.value(backend).value(device);
+}
+
+void DevicePlacement::setUtilization(const QString &backend, int device, int percent)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (percent < 0)
+        m_utilization[backend].remove(device);
+    else
+        m_utilization[backend][device] = qMin(percent, 100);
+}
+
+void DevicePlacement::releaseLocked(const void *key)
+{
+    QHash<const void*, Session>::iterator it = m_sessions.find(key);
+    if (it == m_sessions.end())
+        return;
+    QHash<int, int> &active = m_active[it.value().backend];
+    if (--active[it.value().device] <= 0)
+        active.remove(it.value().device);
+    m_sessions.erase(it);
+}
+
+} //namespace QtAV
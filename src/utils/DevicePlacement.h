@@ -0,0 +1,75 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_DEVICEPLACEMENT_H
+#define QTAV_DEVICEPLACEMENT_H
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+namespace QtAV {
+/*!
+ * \brief The DevicePlacement class
+ * Process wide placement of hardware decoder sessions on the devices of a backend, e.g. "CUDA" or "VAAPI", when there
+ * are several GPUs. A decoder acquires a device when its context is created and releases it when the context is destroyed.
+ * Device utilization, e.g. NVDEC engine load read by the application from NVML, can be reported by setUtilization().
+ */
+class DevicePlacement
+{
+public:
+    enum Policy {
+        DefaultDevice, // the device the backend picks without placement, e.g. the max gflops CUDA device
+        RoundRobin,
+        LeastLoaded // the fewest active sessions, then the lowest reported utilization
+    };
+    static DevicePlacement& instance();
+    /*!
+     * \brief acquire
+     * \param key the decoder. acquire() again with the same key releases the old device first
+     * \param count number of devices of backend
+     * \param device >=0: use the device if it's < count, and ignore policy
+     * \param defaultDevice used by DefaultDevice policy and if device is out of range
+     * \return the device index the decoder should use
+     */
+    int acquire(const void* key, const QString& backend, int count, int device, Policy policy, int defaultDevice);
+    void release(const void* key);
+    /// active sessions on device of backend
+    int sessions(const QString& backend, int device) const;
+    /// percent: 0~100. <0: unknown
+    void setUtilization(const QString& backend, int device, int percent);
+private:
+    DevicePlacement() {}
+    // m_mutex must be locked
+    void releaseLocked(const void* key);
+
+    struct Session {
+        QString backend;
+        int device;
+    };
+    mutable QMutex m_mutex;
+    QHash<const void*, Session> m_sessions;
+    QHash<QString, QHash<int, int> > m_active; // backend => device => sessions
+    QHash<QString, QHash<int, int> > m_utilization;
+    QHash<QString, int> m_next; // next round robin device of the backend
+};
+} //namespace QtAV
+#endif // QTAV_DEVICEPLACEMENT_H
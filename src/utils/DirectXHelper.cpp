@@ -20,6 +20,8 @@
 ******************************************************************************/
 
 #include "DirectXHelper.h"
+#include <QtCore/QSettings>
+#include <QtCore/QStringList>
 #include "utils/Logger.h"
 
 namespace QtAV {
@@ -106,5 +108,19 @@ IDirect3DDevice9* CreateDevice9(HINSTANCE dll, IDirect3D9** d3d9, D3DADAPTER_IDE
     qDebug("IDirect3DDevice9 created");
     return d3d9dev;
 }
+
+QByteArray DriverStamp()
+{
+    // display adapter device class
+    QSettings reg(QStringLiteral("HKEY_LOCAL_MACHINE\\SYSTEM\\CurrentControlSet\\Control\\Class\\{4d36e968-e325-11ce-bfc1-08002be10318}"), QSettings::NativeFormat);
+    QByteArray s;
+    foreach (const QString& adapter, reg.childGroups()) {
+        const QString ver(reg.value(adapter + QStringLiteral("/DriverVersion")).toString());
+        if (ver.isEmpty())
+            continue;
+        s += reg.value(adapter + QStringLiteral("/DriverDesc")).toString().toUtf8() + ':' + ver.toUtf8() + ';';
+    }
+    return s;
+}
 } // namespace DXHelper
 } //namespace QtAV
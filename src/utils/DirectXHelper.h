@@ -23,6 +23,7 @@
 #define QTAV_DIRECTXHELPER_H
 
 #include <d3d9.h>
+#include <QtCore/QByteArray>
 
 namespace QtAV {
 
@@ -52,6 +53,8 @@ template <class T> void SafeRelease(T **ppT) {
 namespace DXHelper {
 IDirect3DDevice9* CreateDevice9Ex(HINSTANCE dll, IDirect3D9Ex **d3d9ex, D3DADAPTER_IDENTIFIER9* d3dai = NULL);
 IDirect3DDevice9* CreateDevice9(HINSTANCE dll, IDirect3D9 **d3d9, D3DADAPTER_IDENTIFIER9* d3dai = NULL);
+/// description and version of installed display drivers, read from registry without creating a device. changes if a driver is upgraded
+QByteArray DriverStamp();
 } //namespace DXHelper
 
 } //namespace QtAV
@@ -0,0 +1,158 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "FrameBufferPool.h"
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+FrameBufferPool& FrameBufferPool::instance()
+{
+    static FrameBufferPool sPool;
+    return sPool;
+}
+
+FrameBufferPool::FrameBufferPool()
+    : m_idle_bytes(0)
+    , m_max_bytes(64*1024*1024) // about 5 4K yuv420p frames
+    , m_in_use_bytes(0)
+    , m_limit(0)
+    , m_hits(0)
+    , m_misses(0)
+{}
+
+QByteArray FrameBufferPool::get(int bytes)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    // the newest is more likely in cache
+    for (int i = m_free.size() - 1; i >= 0; --i) {
+        const int cap = m_free.at(i).capacity();
+        if (cap < bytes || cap > bytes + bytes/8)
+            continue;
+        m_idle_bytes -= cap;
+        m_in_use_bytes += cap;
+        ++m_hits;
+        QByteArray buf(m_free.takeAt(i));
+        lock.unlock();
+        buf.resize(bytes); // no reallocation, buf is detached
+        return buf;
+    }
+    ++m_misses;
+    m_in_use_bytes += bytes;
+    trim(); // free idle buffers before allocating if the limit is exceeded
+    lock.unlock();
+    QByteArray buf;
+    buf.resize(bytes);
+    // put() and trim() count the capacity, which can be larger than requested
+    lock.relock();
+    m_in_use_bytes += buf.capacity() - bytes;
+    return buf;
+}
+
+void FrameBufferPool::put(QByteArray &buf)
+{
+    if (buf.isEmpty() || !buf.isDetached()) { // accounted when the last holder puts it
+        buf = QByteArray();
+        return;
+    }
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_in_use_bytes = qMax<qint64>(0, m_in_use_bytes - buf.capacity());
+    if (buf.capacity() > m_max_bytes) {
+        lock.unlock();
+        buf = QByteArray();
+        return;
+    }
+    m_idle_bytes += buf.capacity();
+    m_free.append(buf);
+    buf = QByteArray();
+    trim();
+}
+
+void FrameBufferPool::setMaxBytes(qint64 value)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_max_bytes = qMax<qint64>(0, value);
+    trim();
+}
+
+qint64 FrameBufferPool::maxBytes() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_max_bytes;
+}
+
+qint64 FrameBufferPool::hits() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_hits;
+}
+
+qint64 FrameBufferPool::misses() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_misses;
+}
+
+qint64 FrameBufferPool::idleBytes() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_idle_bytes;
+}
+
+qint64 FrameBufferPool::inUseBytes() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_in_use_bytes;
+}
+
+void FrameBufferPool::setMemoryLimit(qint64 value)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_limit = qMax<qint64>(0, value);
+    trim();
+}
+
+qint64 FrameBufferPool::memoryLimit() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_limit;
+}
+
+void FrameBufferPool::trim()
+{
+    while (!m_free.isEmpty() && (m_idle_bytes > m_max_bytes || m_free.size() > kMaxBuffers
+                                 || (m_limit > 0 && m_in_use_bytes + m_idle_bytes > m_limit))) {
+        m_idle_bytes -= m_free.first().capacity();
+        m_free.removeFirst();
+    }
+}
+
+} //namespace QtAV
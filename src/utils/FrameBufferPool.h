@@ -0,0 +1,70 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_FRAMEBUFFERPOOL_H
+#define QTAV_FRAMEBUFFERPOOL_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+
+namespace QtAV {
+/*!
+ * \brief The FrameBufferPool class
+ * Reuse frame data buffers of the same size, e.g. video frames of the same format and size, instead of allocating a new one
+ * for each frame. A buffer is put back by the frame holding it when the last reference of the frame is destroyed.
+ * A buffer whose capacity is a little larger than requested is also reused, so sizes varying by a few samples, e.g. resampled
+ * audio, still hit the pool. Idle buffers are limited by maxBytes(), the oldest ones are freed first.
+ * Buffers taken by get() are accounted in inUseBytes() until the last holder puts them back. If memoryLimit() is set,
+ * idle buffers are freed as soon as in use + idle bytes exceed it, so a process under pressure keeps no cache.
+ */
+class FrameBufferPool
+{
+public:
+    static FrameBufferPool& instance();
+    /// a detached buffer of bytes. content is undefined
+    QByteArray get(int bytes);
+    /// keep buf for reuse if it's not shared. buf will be empty. MUST be a buffer returned by get()
+    void put(QByteArray& buf);
+    /// max bytes of idle buffers. 0: disable pooling
+    void setMaxBytes(qint64 value);
+    qint64 maxBytes() const;
+    qint64 hits() const;
+    qint64 misses() const;
+    qint64 idleBytes() const;
+    qint64 inUseBytes() const;
+    /// max bytes of in use + idle buffers before idle buffers are freed. 0: no limit
+    void setMemoryLimit(qint64 value);
+    qint64 memoryLimit() const;
+private:
+    FrameBufferPool();
+    // m_mutex must be locked
+    void trim();
+
+    enum { kMaxBuffers = 32 };
+    mutable QMutex m_mutex;
+    QList<QByteArray> m_free; // oldest first
+    qint64 m_idle_bytes, m_max_bytes;
+    qint64 m_in_use_bytes, m_limit;
+    qint64 m_hits, m_misses;
+};
+} //namespace QtAV
+#endif // QTAV_FRAMEBUFFERPOOL_H
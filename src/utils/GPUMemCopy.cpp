@@ -21,6 +21,7 @@
 
 #include "GPUMemCopy.h"
 #include "QtAV/QtAV_Global.h"
+#include <stdint.h> //intptr_t
 #include <string.h> //memcpy
 #include <algorithm>
 extern "C" {
@@ -30,12 +31,35 @@ extern "C" {
 #define UINT unsigned int
 void CopyFrame_SSE2(void *pSrc, void *pDest, void *pCacheBlock, UINT width, UINT height, UINT pitch);
 void CopyFrame_SSE4(void *pSrc, void *pDest, void *pCacheBlock, UINT width, UINT height, UINT pitch);
+void CopyFrame_AVX2(void *pSrc, void *pDest, void *pCacheBlock, UINT width, UINT height, UINT pitch);
+void CopyFrame_NEON(void *pSrc, void *pDest, void *pCacheBlock, UINT width, UINT height, UINT pitch);
 
 void *memcpy_sse2(void* dst, const void* src, size_t size);
 void *memcpy_sse4(void* dst, const void* src, size_t size);
+void *memcpy_avx2(void* dst, const void* src, size_t size);
+void *memcpy_neon(void* dst, const void* src, size_t size);
+void SplitUV_SSE2(void *pSrc, void *pDstU, void *pDstV, UINT pairs, UINT height, UINT srcPitch, UINT dstPitch, UINT bytes, UINT shift);
+void SplitUV_SSE4(void *pSrc, void *pDstU, void *pDstV, UINT pairs, UINT height, UINT srcPitch, UINT dstPitch, UINT bytes, UINT shift);
+void SplitUV_NEON(void *pSrc, void *pDstU, void *pDstV, UINT pairs, UINT height, UINT srcPitch, UINT dstPitch, UINT bytes, UINT shift);
 
 namespace QtAV {
-
+// kernels are selected at runtime. a kernel is built if the compiler supports it, and used only if the cpu supports it
+bool detect_avx2() {
+#ifdef AV_CPU_FLAG_AVX2
+    static bool is_avx2 = !!(av_get_cpu_flags() & AV_CPU_FLAG_AVX2);
+    return is_avx2;
+#else
+    return false;
+#endif
+}
+bool detect_neon() {
+#ifdef AV_CPU_FLAG_NEON
+    static bool is_neon = !!(av_get_cpu_flags() & AV_CPU_FLAG_NEON);
+    return is_neon;
+#else
+    return false;
+#endif
+}
 bool detect_sse4() {
     static bool is_sse4 = !!(av_get_cpu_flags() & AV_CPU_FLAG_SSE4);
     return is_sse4;
@@ -47,6 +71,10 @@ bool detect_sse2() {
 
 bool GPUMemCopy::isAvailable()
 {
+#if QTAV_HAVE(AVX2)
+    if (detect_avx2())
+        return true;
+#endif
 #if QTAV_HAVE(SSE4_1)
     if (detect_sse4())
         return true;
@@ -54,6 +82,10 @@ bool GPUMemCopy::isAvailable()
 #if QTAV_HAVE(SSE2)
     if (detect_sse2())
         return true;
+#endif
+#if QTAV_HAVE(NEON)
+    if (detect_neon())
+        return true;
 #endif
     return false;
 }
@@ -61,10 +93,8 @@ bool GPUMemCopy::isAvailable()
 GPUMemCopy::GPUMemCopy()
     : mInitialized(false)
 {
-#if QTAV_HAVE(SSE2)
     mCache.buffer = 0;
     mCache.size = 0;
-#endif
 }
 
 GPUMemCopy::~GPUMemCopy()
@@ -81,9 +111,9 @@ bool GPUMemCopy::isReady() const
 bool GPUMemCopy::initCache(unsigned width)
 {
     mInitialized = false;
-#if QTAV_HAVE(SSE2)
-    mCache.size = std::max<size_t>((width + 0x0f) & ~ 0x0f, CACHED_BUFFER_SIZE);
-    mCache.buffer = (unsigned char*)qMallocAligned(mCache.size, 16);
+#if QTAV_HAVE(SSE2) || QTAV_HAVE(NEON)
+    mCache.size = std::max<size_t>((width + 0x3f) & ~ 0x3f, CACHED_BUFFER_SIZE);
+    mCache.buffer = (unsigned char*)qMallocAligned(mCache.size, 64); // cache line. avx2 requires 32
     mInitialized = !!mCache.buffer;
     return mInitialized;
 #else
@@ -96,41 +126,116 @@ bool GPUMemCopy::initCache(unsigned width)
 void GPUMemCopy::cleanCache()
 {
     mInitialized = false;
-#if QTAV_HAVE(SSE2)
     if (mCache.buffer) {
         qFreeAligned(mCache.buffer);
     }
     mCache.buffer = 0;
     mCache.size = 0;
-#endif
 }
 
 void GPUMemCopy::copyFrame(void *pSrc, void *pDest, unsigned width, unsigned height, unsigned pitch)
 {
+    // kernels load a whole pitch into the cache block if a row does not fit in CACHED_BUFFER_SIZE. callers init the cache with width in pixels
+    if (mCache.buffer && pitch > mCache.size) {
+        qFreeAligned(mCache.buffer);
+        mCache.size = (pitch + 0x3f) & ~0x3f;
+        mCache.buffer = (unsigned char*)qMallocAligned(mCache.size, 64);
+        if (!mCache.buffer) {
+            mCache.size = 0;
+            mInitialized = false;
+        }
+    }
+    if (!mCache.buffer)
+        goto c_copy;
+#if QTAV_HAVE(AVX2)
+    if (detect_avx2() && !(((intptr_t)pSrc | pitch) & 0x3f)) { // kernel steps in 64 bytes
+        CopyFrame_AVX2(pSrc, pDest, mCache.buffer, width, height, pitch);
+        return;
+    }
+#endif
 #if QTAV_HAVE(SSE4_1)
-    if (detect_sse4())
+    if (detect_sse4()) {
         CopyFrame_SSE4(pSrc, pDest, mCache.buffer, width, height, pitch);
-#elif QTAV_HAVE(SSE2)
-    if (detect_sse2())
+        return;
+    }
+#endif
+#if QTAV_HAVE(SSE2)
+    if (detect_sse2()) {
         CopyFrame_SSE2(pSrc, pDest, mCache.buffer, width, height, pitch);
-#else
-    Q_UNUSED(pSrc);
-    Q_UNUSED(pDest);
-    Q_UNUSED(width);
-    Q_UNUSED(height);
-    Q_UNUSED(pitch);
+        return;
+    }
+#endif
+#if QTAV_HAVE(NEON)
+    if (detect_neon()) {
+        CopyFrame_NEON(pSrc, pDest, mCache.buffer, width, height, pitch);
+        return;
+    }
 #endif
+c_copy:
+    for (unsigned y = 0; y < height; ++y) {
+        memcpy((char*)pDest + y*pitch, (const char*)pSrc + y*pitch, width);
+    }
 }
 
 void* gpu_memcpy(void *dst, const void *src, size_t size)
 {
+#if QTAV_HAVE(AVX2)
+    if (detect_avx2() && !(((intptr_t)src | (intptr_t)dst) & 0x1f))
+        return memcpy_avx2(dst, src, size);
+#endif
 #if QTAV_HAVE(SSE4_1)
     if (detect_sse4())
         return memcpy_sse4(dst, src, size);
-#elif QTAV_HAVE(SSE2)
+#endif
+#if QTAV_HAVE(SSE2)
     if (detect_sse2())
         return memcpy_sse2(dst, src, size);
+#endif
+#if QTAV_HAVE(NEON)
+    if (detect_neon())
+        return memcpy_neon(dst, src, size);
 #endif
     return memcpy(dst, src, size);
 }
+
+void gpu_split_uv(void *dstU, void *dstV, int dstPitch, const void *src, int srcPitch, int pairs, int height, int bytesPerComponent, int shift)
+{
+#if QTAV_HAVE(SSE4_1)
+    if (detect_sse4()) {
+        SplitUV_SSE4((void*)src, dstU, dstV, pairs, height, srcPitch, dstPitch, bytesPerComponent, shift);
+        return;
+    }
+#endif
+#if QTAV_HAVE(SSE2)
+    if (detect_sse2()) {
+        SplitUV_SSE2((void*)src, dstU, dstV, pairs, height, srcPitch, dstPitch, bytesPerComponent, shift);
+        return;
+    }
+#endif
+#if QTAV_HAVE(NEON)
+    if (detect_neon()) {
+        SplitUV_NEON((void*)src, dstU, dstV, pairs, height, srcPitch, dstPitch, bytesPerComponent, shift);
+        return;
+    }
+#endif
+    for (int y = 0; y < height; ++y) {
+        const unsigned char *s = (const unsigned char*)src + y*srcPitch;
+        unsigned char *u = (unsigned char*)dstU + y*dstPitch;
+        unsigned char *v = (unsigned char*)dstV + y*dstPitch;
+        if (bytesPerComponent == 1) {
+            for (int x = 0; x < pairs; ++x) {
+                u[x] = s[2*x];
+                v[x] = s[2*x+1];
+            }
+            continue;
+        }
+        const unsigned short *s16 = (const unsigned short*)s;
+        unsigned short *u16 = (unsigned short*)u;
+        unsigned short *v16 = (unsigned short*)v;
+        for (int x = 0; x < pairs; ++x) {
+            u16[x] = s16[2*x] >> shift;
+            v16[x] = s16[2*x+1] >> shift;
+        }
+    }
+}
 } //namespace QtAV
@@ -23,10 +23,12 @@
 #define GPUMemCopy_H
 
 #include <stddef.h>
+#include <QtAV/QtAV_Global.h>
 
 namespace QtAV {
 
-class GPUMemCopy
+// exported for tests/microbench
+class Q_AV_PRIVATE_EXPORT GPUMemCopy
 {
 public:
     static bool isAvailable();
@@ -47,7 +49,15 @@ private:
     cache_t mCache;
 };
 
-void* gpu_memcpy(void* dst, const void* src, size_t size);
+Q_AV_PRIVATE_EXPORT void* gpu_memcpy(void* dst, const void* src, size_t size);
+/*!
+ * \brief gpu_split_uv
+ * Copy an interleaved chroma plane (NV12/NV21 UV, P010/P016 UV) from gpu memory to 2 planes in 1 pass, using streaming load if possible
+ * \param pairs uv pairs in a row, i.e. chroma width
+ * \param bytesPerComponent 1 or 2
+ * \param shift right shift of 16 bit components, e.g. 6 for P010 to get 10 bit values in low bits like yuv420p10le
+ */
+void gpu_split_uv(void* dstU, void* dstV, int dstPitch, const void* src, int srcPitch, int pairs, int height, int bytesPerComponent = 1, int shift = 0);
 
 } //namespace QtAV
 
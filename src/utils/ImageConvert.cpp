@@ -0,0 +1,145 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "ImageConvert.h"
+#include "QtAV/QtAV_Global.h"
+#include <QtCore/QVarLengthArray>
+
+int YUVToRGBARow_SSE2(const unsigned char* y, const unsigned char* u, const unsigned char* v, int uvStep, bool subsampled, unsigned char* dst, int width, bool rgba);
+int BoxDown2Row_SSE2(const unsigned char* r0, const unsigned char* r1, unsigned char* dst, int dstWidth, int bpp);
+
+namespace QtAV {
+bool detect_sse2(); // GPUMemCopy.cpp
+namespace {
+// Q10 coefficients of BT.601 full range. must be the same as ImageConvert_SSE2.cpp
+enum {
+    kCR_V = 1436,
+    kCG_U = 352,
+    kCG_V = 731,
+    kCB_U = 1815
+};
+
+inline unsigned char clip_uint8(int x)
+{
+    return x < 0 ? 0 : (x > 255 ? 255 : x);
+}
+
+void yuv_to_rgba_row(const unsigned char* y, const unsigned char* u, const unsigned char* v, int uvStep, bool subsampled, unsigned char* dst, int width, bool rgba)
+{
+    int x = 0;
+#if QTAV_HAVE(SSE2)
+    if (detect_sse2())
+        x = YUVToRGBARow_SSE2(y, u, v, uvStep, subsampled, dst, width, rgba);
+#endif
+    for (; x < width; ++x) {
+        const int c = (subsampled ? x >> 1 : x)*uvStep;
+        const int Y = y[x];
+        // same as mulhi((c-128)<<6, coeff) of the simd version
+        const int U = (u[c] - 128)*64;
+        const int V = (v[c] - 128)*64;
+        const unsigned char r = clip_uint8(Y + ((V*kCR_V) >> 16));
+        const unsigned char g = clip_uint8(Y - ((U*kCG_U) >> 16) - ((V*kCG_V) >> 16));
+        const unsigned char b = clip_uint8(Y + ((U*kCB_U) >> 16));
+        unsigned char *d = dst + 4*x;
+        d[0] = rgba ? r : b;
+        d[1] = g;
+        d[2] = rgba ? b : r;
+        d[3] = 255;
+    }
+}
+
+void box_down2_row(const unsigned char* r0, const unsigned char* r1, unsigned char* dst, int dstWidth, int bpp)
+{
+    int x = 0;
+#if QTAV_HAVE(SSE2)
+    if (detect_sse2())
+        x = BoxDown2Row_SSE2(r0, r1, dst, dstWidth, bpp);
+#endif
+    for (; x < dstWidth; ++x) {
+        const int i = 2*x*bpp;
+        for (int k = 0; k < bpp; ++k)
+            dst[x*bpp+k] = (r0[i+k] + r0[i+bpp+k] + r1[i+k] + r1[i+bpp+k] + 2) >> 2;
+    }
+}
+
+/*!
+ * 1 output row from factor rows of src.
+ * tmp: 2*2*dstWidth*bpp bytes for factor 4
+ */
+void box_down_row(const unsigned char* src, int srcStride, unsigned char* dst, int dstWidth, int factor, int bpp, unsigned char* tmp)
+{
+    if (factor == 2) {
+        box_down2_row(src, src + srcStride, dst, dstWidth, bpp);
+        return;
+    }
+    // factor 4 is 2 passes of factor 2
+    unsigned char *t0 = tmp;
+    unsigned char *t1 = tmp + 2*dstWidth*bpp;
+    box_down2_row(src, src + srcStride, t0, 2*dstWidth, bpp);
+    box_down2_row(src + 2*srcStride, src + 3*srcStride, t1, 2*dstWidth, bpp);
+    box_down2_row(t0, t1, dst, dstWidth, bpp);
+}
+} //namespace
+
+void yuv420_to_rgba(const unsigned char* const src[], const int srcStride[], int uvStep, unsigned char* dst, int dstStride, int width, int height, bool rgba)
+{
+    for (int y = 0; y < height; ++y) {
+        const int c = y >> 1;
+        yuv_to_rgba_row(src[0] + y*srcStride[0], src[1] + c*srcStride[1], src[2] + c*srcStride[2], uvStep, true, dst + y*dstStride, width, rgba);
+    }
+}
+
+bool yuv420p_to_rgba_down(const unsigned char* const src[], const int srcStride[], unsigned char* dst, int dstStride, int dstWidth, int dstHeight, int factor, bool rgba)
+{
+    if (factor != 2 && factor != 4)
+        return false;
+    // scaled planes are 444, chroma of factor 2 is used directly
+    const int cf = factor/2;
+    QVarLengthArray<unsigned char, 4096> buf(3*dstWidth + 4*dstWidth);
+    unsigned char *Y = buf.data();
+    unsigned char *U = Y + dstWidth;
+    unsigned char *V = U + dstWidth;
+    unsigned char *tmp = V + dstWidth;
+    for (int y = 0; y < dstHeight; ++y) {
+        box_down_row(src[0] + y*factor*srcStride[0], srcStride[0], Y, dstWidth, factor, 1, tmp);
+        const unsigned char *u = src[1] + y*cf*srcStride[1];
+        const unsigned char *v = src[2] + y*cf*srcStride[2];
+        if (cf > 1) {
+            box_down_row(u, srcStride[1], U, dstWidth, cf, 1, tmp);
+            box_down_row(v, srcStride[2], V, dstWidth, cf, 1, tmp);
+            u = U;
+            v = V;
+        }
+        yuv_to_rgba_row(Y, u, v, 1, false, dst + y*dstStride, dstWidth, rgba);
+    }
+    return true;
+}
+
+bool box_down(const unsigned char* src, int srcStride, unsigned char* dst, int dstStride, int dstWidth, int dstHeight, int factor, int bpp)
+{
+    if ((factor != 2 && factor != 4) || (bpp != 1 && bpp != 4))
+        return false;
+    QVarLengthArray<unsigned char, 4096> tmp(factor == 4 ? 4*dstWidth*bpp : 1);
+    for (int y = 0; y < dstHeight; ++y)
+        box_down_row(src + y*factor*srcStride, srcStride, dst + y*dstStride, dstWidth, factor, bpp, tmp.data());
+    return true;
+}
+} //namespace QtAV
@@ -0,0 +1,51 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_IMAGECONVERT_H
+#define QTAV_IMAGECONVERT_H
+
+/*
+ * Fast paths of the most common conversions without swscale. Used by ImageConverterFF, others are converted by swscale.
+ * YUV to RGB is BT.601 full range as ImageConverterFF sets for swscale, with no equalizer.
+ * Kernels are selected at runtime like gpu_memcpy()
+ */
+namespace QtAV {
+/*!
+ * \brief yuv420_to_rgba
+ * yuv420p, nv12 or nv21 to 4 bytes rgb of the same size
+ * \param src planar: y, u, v. interleaved: y, u, v where v = u+1 for nv12, u = v+1 for nv21
+ * \param uvStep 1: planar, 2: interleaved
+ * \param rgba output byte order is r, g, b, a. otherwise b, g, r, a
+ */
+void yuv420_to_rgba(const unsigned char* const src[], const int srcStride[], int uvStep, unsigned char* dst, int dstStride, int width, int height, bool rgba);
+/*!
+ * \brief yuv420p_to_rgba_down
+ * yuv420p to 4 bytes rgb scaled down by factor 2 or 4 with box filter. width and height of source are dstWidth*factor and dstHeight*factor
+ */
+bool yuv420p_to_rgba_down(const unsigned char* const src[], const int srcStride[], unsigned char* dst, int dstStride, int dstWidth, int dstHeight, int factor, bool rgba);
+/*!
+ * \brief box_down
+ * Scale down a plane by factor 2 or 4 with box filter
+ * \param bpp bytes per pixel, 1 or 4. channels are averaged separately
+ */
+bool box_down(const unsigned char* src, int srcStride, unsigned char* dst, int dstStride, int dstWidth, int dstHeight, int factor, int bpp);
+} //namespace QtAV
+#endif //QTAV_IMAGECONVERT_H
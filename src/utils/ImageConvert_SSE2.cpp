@@ -0,0 +1,120 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+#include <emmintrin.h>
+
+// BT.601 full range, the same coefficients ImageConverterFF sets for swscale. (c-128)<<6 * coeff>>16 with Q10 coefficients
+// Results are the same as the C version in ImageConvert.cpp
+#define CR_V 1436
+#define CG_U 352
+#define CG_V 731
+#define CB_U 1815
+
+// 8 chroma values of 8 pixels in 16 bit lanes from interleaved uv. loading 8 bytes at u takes the even bytes: u0 u1 u2 u3
+static inline __m128i load_chroma_uv(const unsigned char* c)
+{
+    __m128i x = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)c), _mm_setzero_si128());
+    x = _mm_and_si128(x, _mm_set1_epi32(0x0000ffff));
+    return _mm_or_si128(x, _mm_slli_epi32(x, 16));
+}
+
+static inline __m128i load_chroma_420(const unsigned char* c)
+{
+    __m128i x = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int*)c), _mm_setzero_si128());
+    return _mm_unpacklo_epi16(x, x);
+}
+
+static inline __m128i load_chroma_444(const unsigned char* c)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)c), _mm_setzero_si128());
+}
+
+/*!
+ * uvStep: 1 for planar chroma, 2 for interleaved chroma. subsampled: 1 chroma sample for 2 pixels, otherwise 1 for 1 pixel (planar only)
+ * return converted pixels, a multiple of 8. the caller converts the rest
+ */
+int YUVToRGBARow_SSE2(const unsigned char* y, const unsigned char* u, const unsigned char* v, int uvStep, bool subsampled, unsigned char* dst, int width, bool rgba)
+{
+    if (uvStep == 2 && !subsampled)
+        return 0;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c128 = _mm_set1_epi16(128);
+    const __m128i alpha = _mm_set1_epi8((char)0xff);
+    const __m128i cr_v = _mm_set1_epi16(CR_V);
+    const __m128i cg_u = _mm_set1_epi16(CG_U);
+    const __m128i cg_v = _mm_set1_epi16(CG_V);
+    const __m128i cb_u = _mm_set1_epi16(CB_U);
+    int x = 0;
+    // x+8 < width: interleaved v (or u) starts 1 byte after, and 8 bytes are loaded
+    for (; x + 8 < width; x += 8) {
+        __m128i U, V;
+        if (uvStep == 2) {
+            U = load_chroma_uv(u + x);
+            V = load_chroma_uv(v + x);
+        } else if (subsampled) {
+            U = load_chroma_420(u + x/2);
+            V = load_chroma_420(v + x/2);
+        } else {
+            U = load_chroma_444(u + x);
+            V = load_chroma_444(v + x);
+        }
+        U = _mm_slli_epi16(_mm_sub_epi16(U, c128), 6);
+        V = _mm_slli_epi16(_mm_sub_epi16(V, c128), 6);
+        const __m128i Y = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(y + x)), zero);
+        const __m128i R = _mm_add_epi16(Y, _mm_mulhi_epi16(V, cr_v));
+        const __m128i G = _mm_sub_epi16(Y, _mm_add_epi16(_mm_mulhi_epi16(U, cg_u), _mm_mulhi_epi16(V, cg_v)));
+        const __m128i B = _mm_add_epi16(Y, _mm_mulhi_epi16(U, cb_u));
+        const __m128i c0 = _mm_packus_epi16(rgba ? R : B, zero);
+        const __m128i c2 = _mm_packus_epi16(rgba ? B : R, zero);
+        const __m128i c01 = _mm_unpacklo_epi8(c0, _mm_packus_epi16(G, zero));
+        const __m128i c23 = _mm_unpacklo_epi8(c2, alpha);
+        _mm_storeu_si128((__m128i*)(dst + 4*x), _mm_unpacklo_epi16(c01, c23));
+        _mm_storeu_si128((__m128i*)(dst + 4*x + 16), _mm_unpackhi_epi16(c01, c23));
+    }
+    return x;
+}
+
+/*!
+ * average 2x2 blocks of 2 rows. bpp: bytes per pixel, 1 or 4.
+ * return output pixels. the caller processes the rest
+ */
+int BoxDown2Row_SSE2(const unsigned char* r0, const unsigned char* r1, unsigned char* dst, int dstWidth, int bpp)
+{
+    int x = 0;
+    if (bpp == 1) {
+        const __m128i mask = _mm_set1_epi16(0x00ff);
+        for (; x + 16 <= dstWidth; x += 16) {
+            const __m128i a = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(r0 + 2*x)), _mm_loadu_si128((const __m128i*)(r1 + 2*x)));
+            const __m128i b = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(r0 + 2*x + 16)), _mm_loadu_si128((const __m128i*)(r1 + 2*x + 16)));
+            const __m128i ha = _mm_avg_epu16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8));
+            const __m128i hb = _mm_avg_epu16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8));
+            _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(ha, hb));
+        }
+    } else if (bpp == 4) {
+        for (; x + 4 <= dstWidth; x += 4) {
+            const __m128 a = _mm_castsi128_ps(_mm_avg_epu8(_mm_loadu_si128((const __m128i*)(r0 + 8*x)), _mm_loadu_si128((const __m128i*)(r1 + 8*x))));
+            const __m128 b = _mm_castsi128_ps(_mm_avg_epu8(_mm_loadu_si128((const __m128i*)(r0 + 8*x + 16)), _mm_loadu_si128((const __m128i*)(r1 + 8*x + 16))));
+            const __m128i even = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+            _mm_storeu_si128((__m128i*)(dst + 4*x), _mm_avg_epu8(even, odd));
+        }
+    }
+    return x;
+}
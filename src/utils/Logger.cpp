@@ -23,7 +23,9 @@
  * DO NOT appear qDebug, qWanring etc in Logger.cpp! They are undefined and redefined to QtAV:Internal::Logger.xxx
  */
 // we need LogLevel so must include QtAV_Global.h
+#include <QtCore/QDateTime>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 #include "QtAV/QtAV_Global.h"
 #include "Logger.h"
 
@@ -33,6 +35,59 @@ void ffmpeg_version_print();
 namespace QtAV {
 namespace Internal {
 static QString gQtAVLogTag = QString();
+static volatile int gLogCategoryMask = ~0; // bit i: LogCategory i is enabled
+static const char* const kLogCategoryNames[] = { "default", "demux", "video", "audio", "render" };
+
+const char* logCategoryName(LogCategory c)
+{
+    if ((int)c < 0 || (int)c >= (int)LogCategoryCount)
+        return kLogCategoryNames[0];
+    return kLogCategoryNames[c];
+}
+
+static int logCategoryFromName(const QString& name)
+{
+    for (int i = 0; i < (int)LogCategoryCount; ++i) {
+        if (name == QLatin1String(kLogCategoryNames[i]))
+            return i;
+    }
+    return -1;
+}
+
+bool isLogEnabled(LogCategory c, QtMsgType t)
+{
+    QtAVDebug d; // initialize something. e.g. environment check
+    Q_UNUSED(d);
+    const int v = (int)logLevel();
+    if (v <= (int)LogOff)
+        return false;
+    if ((int)t < (int)QtCriticalMsg && !(gLogCategoryMask & (1 << (int)c)))
+        return false;
+    if (v >= (int)LogAll)
+        return true;
+    if (t == QtDebugMsg)
+        return v <= (int)LogDebug;
+    if (t == QtWarningMsg)
+        return v <= (int)LogWarning;
+    if (t == QtCriticalMsg)
+        return v <= (int)LogCritical;
+    return true;
+}
+
+bool LogRateLimit::allow(int intervalMs, int *n)
+{
+    // not atomic. at worst a few more messages are logged
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (last > 0 && now - last < intervalMs) {
+        ++suppressed;
+        return false;
+    }
+    last = now;
+    if (n)
+        *n = suppressed;
+    suppressed = 0;
+    return true;
+}
 
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
 typedef Logger::Context QMessageLogger;
@@ -240,6 +295,11 @@ QtAVDebug::QtAVDebug(QtMsgType t, QDebug *d)
     if (!env.isEmpty()) {
         gQtAVLogTag = QString::fromUtf8(env);
     }
+    env = qgetenv("QTAV_LOG_DISABLE");
+    if (!env.isEmpty()) {
+        foreach (const QString& c, QString::fromLatin1(env).split(QLatin1Char(','), QString::SkipEmptyParts))
+            setLogCategoryEnabled(c.trimmed().toLower(), false);
+    }
 
     if ((int)logLevel() > (int)LogOff) {
         print_library_info();
@@ -274,6 +334,25 @@ QtAVDebug debug(const char *msg, ...)
 #endif
 
 } //namespace Internal
+
+void setLogCategoryEnabled(const QString &category, bool value)
+{
+    const int c = Internal::logCategoryFromName(category);
+    if (c < 0) // no qWarning() here, see above
+        return;
+    if (value)
+        Internal::gLogCategoryMask |= 1 << c;
+    else
+        Internal::gLogCategoryMask &= ~(1 << c);
+}
 } // namespace QtAV
 
+#else
+namespace QtAV {
+void setLogCategoryEnabled(const QString &category, bool value)
+{
+    Q_UNUSED(category);
+    Q_UNUSED(value);
+}
+} // namespace QtAV
 #endif //QTAV_NO_LOG_LEVEL
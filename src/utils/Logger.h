@@ -33,6 +33,7 @@
   Environment var
   QTAV_LOG_TAG: prefix the value to log message
   QTAV_LOG_LEVEL: set log level, can be "off", "debug", "warning", "critical", "fatal", "all"
+  QTAV_LOG_DISABLE: categories to disable, e.g. "video,audio". see setLogCategoryEnabled()
  */
 
 #include <QtDebug> //always include
@@ -60,6 +61,32 @@
 namespace QtAV {
 namespace Internal {
 
+/*
+ * Category logging for code running per packet or frame. A message is formatted only if its category and type are enabled:
+ *   qtavDebug(LogVideo, "frame slow count: %d", n);
+ * *Limited() variants log a message at most once per interval for the call site, and count the suppressed ones:
+ *   qtavWarningLimited(LogVideo, 1000, "video too fast!!! sleep %.2f s", s);
+ * Messages of a QtMsgType lower than QTAV_LOG_MIN_TYPE are stripped at compile time, e.g. -DQTAV_LOG_MIN_TYPE=1 for no debug.
+ */
+enum LogCategory {
+    LogDefault,
+    LogDemux,
+    LogVideo,
+    LogAudio,
+    LogRender,
+    LogCategoryCount
+};
+const char* logCategoryName(LogCategory c);
+// level and category check without formatting
+bool isLogEnabled(LogCategory c, QtMsgType t);
+// state of a rate limited call site. POD, so a static one is zero initialized without a constructor
+struct LogRateLimit {
+    qint64 last; // msecs
+    int suppressed;
+    /// return true if a message can be logged now. suppressed: messages dropped since the last logged one
+    bool allow(int intervalMs, int *suppressed);
+};
+
 // internal use when building QtAV library
 class QtAVDebug {
 public:
@@ -224,6 +251,33 @@ inline QtAVDebug qWarning() { return QtAVDebug(QtWarningMsg); }
 #define qCritical QtAV::Internal::Logger(__FILE__, __LINE__, Q_FUNC_INFO).critical
 #define qFatal QtAV::Internal::Logger(__FILE__, __LINE__, Q_FUNC_INFO).fatal
 
+#ifndef QTAV_LOG_MIN_TYPE
+#define QTAV_LOG_MIN_TYPE 0
+#endif
+#define QTAV_LOG_ENABLED(CAT, TYPE) ((int)TYPE >= QTAV_LOG_MIN_TYPE && QtAV::Internal::isLogEnabled(QtAV::Internal::CAT, TYPE))
+#define QTAV_LOG_IMPL(CAT, TYPE, FUNC, ...) \
+    do { \
+        if (QTAV_LOG_ENABLED(CAT, TYPE)) \
+            QtAV::Internal::Logger(__FILE__, __LINE__, Q_FUNC_INFO, QtAV::Internal::logCategoryName(QtAV::Internal::CAT)).FUNC(__VA_ARGS__); \
+    } while (0)
+#define QTAV_LOG_LIMITED_IMPL(CAT, TYPE, FUNC, MS, ...) \
+    do { \
+        if (QTAV_LOG_ENABLED(CAT, TYPE)) { \
+            static QtAV::Internal::LogRateLimit qtav_log_limit = { 0, 0 }; \
+            int qtav_log_suppressed = 0; \
+            if (qtav_log_limit.allow(MS, &qtav_log_suppressed)) { \
+                const QtAV::Internal::Logger qtav_logger(__FILE__, __LINE__, Q_FUNC_INFO, QtAV::Internal::logCategoryName(QtAV::Internal::CAT)); \
+                qtav_logger.FUNC(__VA_ARGS__); \
+                if (qtav_log_suppressed > 0) \
+                    qtav_logger.FUNC("%d similar messages suppressed", qtav_log_suppressed); \
+            } \
+        } \
+    } while (0)
+#define qtavDebug(CAT, ...) QTAV_LOG_IMPL(CAT, QtDebugMsg, debug, __VA_ARGS__)
+#define qtavWarning(CAT, ...) QTAV_LOG_IMPL(CAT, QtWarningMsg, warning, __VA_ARGS__)
+#define qtavDebugLimited(CAT, MS, ...) QTAV_LOG_LIMITED_IMPL(CAT, QtDebugMsg, debug, MS, __VA_ARGS__)
+#define qtavWarningLimited(CAT, MS, ...) QTAV_LOG_LIMITED_IMPL(CAT, QtWarningMsg, warning, MS, __VA_ARGS__)
+
 } // namespace Internal
 } // namespace QtAV
 
@@ -22,7 +22,14 @@
 #include "OpenGLHelper.h"
 #include <string.h> //strstr
 #include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
 #include <QtGui/QMatrix4x4>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QtCore/QStandardPaths>
+#endif
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
 #if QT_VERSION >= QT_VERSION_CHECK(4, 8, 0)
 #include <QtOpenGL/QGLFunctions>
@@ -94,6 +101,420 @@ bool isPBOSupported() {
     return support;
 }
 
+bool has16BitTexture()
+{
+    static bool support = false;
+    static bool checked = false;
+    if (checked)
+        return support;
+    const QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx) {
+        qWarning("no gl context for has16BitTexture");
+        return false;
+    }
+    if (isOpenGLES()) {
+        // sized internal formats are es3 only
+        const char* exts[] = {
+            "GL_EXT_texture_norm16",
+            NULL
+        };
+        support = ctx->format().majorVersion() >= 3 && hasExtension(exts);
+    } else {
+        const char* exts[] = {
+            "GL_ARB_texture_rg",
+            NULL
+        };
+        support = ctx->format().majorVersion() >= 3 || hasExtension(exts);
+    }
+    qDebug() << "16bit texture: " << support;
+    checked = true;
+    return support;
+}
+
+bool is16BitTexture(const VideoFormat &fmt)
+{
+    if (!fmt.isPlanar() || fmt.isRGB())
+        return false;
+    if (fmt.bitsPerComponent() <= 8 || fmt.bitsPerComponent() > 16) // 0: uneven
+        return false;
+    // GL_UNSIGNED_SHORT is native endian
+    if (fmt.isBigEndian() != (Q_BYTE_ORDER == Q_BIG_ENDIAN))
+        return false;
+    return has16BitTexture();
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+// GLsync is not declared by es2 and old gl headers
+typedef void* (QOPENGLF_APIENTRYP type_glFenceSync)(GLenum condition, GLbitfield flags);
+typedef GLenum (QOPENGLF_APIENTRYP type_glClientWaitSync)(void* sync, GLbitfield flags, quint64 timeout);
+typedef void (QOPENGLF_APIENTRYP type_glWaitSync)(void* sync, GLbitfield flags, quint64 timeout);
+typedef void (QOPENGLF_APIENTRYP type_glDeleteSync)(void* sync);
+static type_glFenceSync qtav_glFenceSync = 0;
+static type_glClientWaitSync qtav_glClientWaitSync = 0;
+static type_glWaitSync qtav_glWaitSync = 0;
+static type_glDeleteSync qtav_glDeleteSync = 0;
+
+static bool resolveSync()
+{
+    static bool resolved = false;
+    if (resolved)
+        return !!qtav_glFenceSync;
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return false;
+    const bool es = isOpenGLES();
+    const int major = ctx->format().majorVersion();
+    const int minor = ctx->format().minorVersion();
+    const char* exts[] = { "GL_ARB_sync", NULL };
+    if ((es && major >= 3) || (!es && (major > 3 || (major == 3 && minor >= 2) || hasExtension(exts)))) {
+        qtav_glFenceSync = (type_glFenceSync)ctx->getProcAddress("glFenceSync");
+        qtav_glClientWaitSync = (type_glClientWaitSync)ctx->getProcAddress("glClientWaitSync");
+        qtav_glWaitSync = (type_glWaitSync)ctx->getProcAddress("glWaitSync");
+        qtav_glDeleteSync = (type_glDeleteSync)ctx->getProcAddress("glDeleteSync");
+        if (!qtav_glFenceSync || !qtav_glClientWaitSync || !qtav_glWaitSync || !qtav_glDeleteSync)
+            qtav_glFenceSync = 0;
+    }
+    qDebug() << "fence sync: " << !!qtav_glFenceSync;
+    resolved = true;
+    return !!qtav_glFenceSync;
+}
+#endif //QT_VERSION
+
+void* fenceSync()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (!resolveSync())
+        return 0;
+    return qtav_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#else
+    return 0;
+#endif
+}
+
+bool isSyncSignaled(void *sync, quint64 timeoutNs)
+{
+    if (!sync)
+        return true;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (!resolveSync())
+        return true;
+    // GL_SYNC_FLUSH_COMMANDS_BIT, otherwise may wait forever
+    const GLenum ret = qtav_glClientWaitSync(sync, timeoutNs ? 0x00000001 : 0, timeoutNs);
+    return ret == GL_ALREADY_SIGNALED || ret == GL_CONDITION_SATISFIED;
+#else
+    Q_UNUSED(timeoutNs);
+    return true;
+#endif
+}
+
+void waitSync(void *sync)
+{
+    if (!sync)
+        return;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (!resolveSync())
+        return;
+    qtav_glWaitSync(sync, 0, Q_UINT64_C(0xFFFFFFFFFFFFFFFF)); //GL_TIMEOUT_IGNORED
+#endif
+}
+
+bool isFenceSyncSupported()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    return resolveSync();
+#else
+    return false;
+#endif
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (QOPENGLF_APIENTRYP type_glBufferStorage)(GLenum target, qopengl_GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void* (QOPENGLF_APIENTRYP type_glMapBufferRange)(GLenum target, qopengl_GLintptr offset, qopengl_GLsizeiptr length, GLbitfield access);
+typedef GLboolean (QOPENGLF_APIENTRYP type_glUnmapBuffer)(GLenum target);
+static type_glBufferStorage qtav_glBufferStorage = 0;
+static type_glMapBufferRange qtav_glMapBufferRange = 0;
+static type_glUnmapBuffer qtav_glUnmapBuffer = 0;
+#endif //QT_VERSION
+
+bool hasBufferStorage()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    static bool support = false;
+    static bool checked = false;
+    if (checked)
+        return support;
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx) {
+        qWarning("no gl context for hasBufferStorage");
+        return false;
+    }
+    const int major = ctx->format().majorVersion();
+    const int minor = ctx->format().minorVersion();
+    if (isOpenGLES()) {
+        const char* exts[] = { "GL_EXT_buffer_storage", NULL };
+        if (hasExtension(exts))
+            qtav_glBufferStorage = (type_glBufferStorage)ctx->getProcAddress("glBufferStorageEXT");
+    } else {
+        const char* exts[] = { "GL_ARB_buffer_storage", NULL };
+        if (major > 4 || (major == 4 && minor >= 4) || hasExtension(exts))
+            qtav_glBufferStorage = (type_glBufferStorage)ctx->getProcAddress("glBufferStorage");
+    }
+    if (qtav_glBufferStorage) {
+        qtav_glMapBufferRange = (type_glMapBufferRange)ctx->getProcAddress("glMapBufferRange");
+        if (!qtav_glMapBufferRange)
+            qtav_glMapBufferRange = (type_glMapBufferRange)ctx->getProcAddress("glMapBufferRangeEXT");
+        qtav_glUnmapBuffer = (type_glUnmapBuffer)ctx->getProcAddress("glUnmapBuffer");
+        if (!qtav_glUnmapBuffer)
+            qtav_glUnmapBuffer = (type_glUnmapBuffer)ctx->getProcAddress("glUnmapBufferOES");
+    }
+    // coherent memory must not be overwritten while gpu reads it, so fences are required
+    support = qtav_glBufferStorage && qtav_glMapBufferRange && qtav_glUnmapBuffer && isFenceSyncSupported();
+    qDebug() << "buffer storage: " << support;
+    checked = true;
+    return support;
+#else
+    return false;
+#endif
+}
+
+GLuint createPersistentBuffer(GLenum target, int size, void **ptr)
+{
+    *ptr = 0;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (!hasBufferStorage())
+        return 0;
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    GLuint buf = 0;
+    f->glGenBuffers(1, &buf);
+    if (!buf)
+        return 0;
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    f->glBindBuffer(target, buf);
+    qtav_glBufferStorage(target, size, NULL, flags);
+    *ptr = qtav_glMapBufferRange(target, 0, size, flags);
+    f->glBindBuffer(target, 0);
+    if (!*ptr) {
+        qWarning("failed to map buffer storage persistently");
+        f->glDeleteBuffers(1, &buf);
+        return 0;
+    }
+    return buf;
+#else
+    Q_UNUSED(target);
+    Q_UNUSED(size);
+    return 0;
+#endif
+}
+
+void deletePersistentBuffer(GLenum target, GLuint buffer)
+{
+    if (!buffer)
+        return;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    f->glBindBuffer(target, buffer);
+    qtav_glUnmapBuffer(target);
+    f->glBindBuffer(target, 0);
+    f->glDeleteBuffers(1, &buffer);
+#else
+    Q_UNUSED(target);
+#endif
+}
+
+void bindBuffer(GLenum target, GLuint buffer)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QOpenGLContext::currentContext()->functions()->glBindBuffer(target, buffer);
+#else
+    Q_UNUSED(target);
+    Q_UNUSED(buffer);
+#endif
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+typedef void (QOPENGLF_APIENTRYP type_glGetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (QOPENGLF_APIENTRYP type_glProgramBinary)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (QOPENGLF_APIENTRYP type_glProgramParameteri)(GLuint program, GLenum pname, GLint value);
+static type_glGetProgramBinary qtav_glGetProgramBinary = 0;
+static type_glProgramBinary qtav_glProgramBinary = 0;
+static type_glProgramParameteri qtav_glProgramParameteri = 0;
+
+static bool resolveProgramBinary()
+{
+    static bool resolved = false;
+    if (resolved)
+        return !!qtav_glProgramBinary;
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return false;
+    resolved = true;
+    if (qgetenv("QTAV_SHADER_CACHE") == "0") {
+        qDebug("program binary cache is disabled");
+        return false;
+    }
+    const int major = ctx->format().majorVersion();
+    const int minor = ctx->format().minorVersion();
+    if (isOpenGLES()) {
+        const char* exts[] = { "GL_OES_get_program_binary", NULL };
+        if (major >= 3) {
+            qtav_glGetProgramBinary = (type_glGetProgramBinary)ctx->getProcAddress("glGetProgramBinary");
+            qtav_glProgramBinary = (type_glProgramBinary)ctx->getProcAddress("glProgramBinary");
+            qtav_glProgramParameteri = (type_glProgramParameteri)ctx->getProcAddress("glProgramParameteri");
+        } else if (hasExtension(exts)) {
+            qtav_glGetProgramBinary = (type_glGetProgramBinary)ctx->getProcAddress("glGetProgramBinaryOES");
+            qtav_glProgramBinary = (type_glProgramBinary)ctx->getProcAddress("glProgramBinaryOES");
+        }
+    } else {
+        const char* exts[] = { "GL_ARB_get_program_binary", NULL };
+        if (major > 4 || (major == 4 && minor >= 1) || hasExtension(exts)) {
+            qtav_glGetProgramBinary = (type_glGetProgramBinary)ctx->getProcAddress("glGetProgramBinary");
+            qtav_glProgramBinary = (type_glProgramBinary)ctx->getProcAddress("glProgramBinary");
+            qtav_glProgramParameteri = (type_glProgramParameteri)ctx->getProcAddress("glProgramParameteri");
+        }
+    }
+    if (!qtav_glGetProgramBinary)
+        qtav_glProgramBinary = 0;
+    if (qtav_glProgramBinary) {
+        // some drivers expose the api without any binary format
+        GLint nb_formats = 0;
+        DYGL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nb_formats));
+        if (nb_formats <= 0)
+            qtav_glProgramBinary = 0;
+    }
+    qDebug() << "program binary: " << !!qtav_glProgramBinary;
+    return !!qtav_glProgramBinary;
+}
+
+static QString programBinaryPath(const QByteArray& vs, const QByteArray& fs)
+{
+    static QString dir;
+    if (dir.isEmpty()) {
+        dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        if (dir.isEmpty())
+            dir = QDir::tempPath() + QStringLiteral("/QtAV");
+        dir.append(QStringLiteral("/shaders"));
+    }
+    // a driver update changes the version string and invalidates the binaries
+    QCryptographicHash h(QCryptographicHash::Sha1);
+    h.addData(QByteArray((const char*)DYGL(glGetString(GL_VENDOR))));
+    h.addData(QByteArray((const char*)DYGL(glGetString(GL_RENDERER))));
+    h.addData(QByteArray((const char*)DYGL(glGetString(GL_VERSION))));
+    h.addData(vs);
+    h.addData(fs);
+    return dir + QStringLiteral("/") + QString::fromLatin1(h.result().toHex()) + QStringLiteral(".bin");
+}
+#endif //QT_VERSION
+
+bool loadProgramBinary(QOpenGLShaderProgram *program, const QByteArray &vs, const QByteArray &fs)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (!resolveProgramBinary())
+        return false;
+    QFile f(programBinaryPath(vs, fs));
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data(f.readAll());
+    f.close();
+    quint32 fmt = 0;
+    if (data.size() <= (int)sizeof(fmt))
+        return false;
+    memcpy(&fmt, data.constData(), sizeof(fmt));
+    qtav_glProgramBinary(program->programId(), fmt, data.constData() + sizeof(fmt), data.size() - sizeof(fmt));
+    // no shader is added, so link() only checks GL_LINK_STATUS
+    if (program->link())
+        return true;
+    qDebug("program binary is rejected by driver: %s", qPrintable(f.fileName()));
+    f.remove();
+    return false;
+#else
+    Q_UNUSED(program);
+    Q_UNUSED(vs);
+    Q_UNUSED(fs);
+    return false;
+#endif
+}
+
+void saveProgramBinary(QOpenGLShaderProgram *program, const QByteArray &vs, const QByteArray &fs)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (!program->isLinked() || !resolveProgramBinary())
+        return;
+    GLint len = 0;
+    QOpenGLContext::currentContext()->functions()->glGetProgramiv(program->programId(), GL_PROGRAM_BINARY_LENGTH, &len);
+    if (len <= 0)
+        return;
+    QByteArray data(len + sizeof(quint32), 0);
+    GLenum fmt = 0;
+    GLsizei written = 0;
+    qtav_glGetProgramBinary(program->programId(), len, &written, &fmt, data.data() + sizeof(quint32));
+    if (written <= 0)
+        return;
+    const quint32 fmt32 = fmt;
+    memcpy(data.data(), &fmt32, sizeof(fmt32));
+    data.resize(written + sizeof(quint32));
+    QFile f(programBinaryPath(vs, fs));
+    QDir().mkpath(QFileInfo(f).absolutePath());
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning("failed to open program binary cache: %s", qPrintable(f.errorString()));
+        return;
+    }
+    f.write(data);
+#else
+    Q_UNUSED(program);
+    Q_UNUSED(vs);
+    Q_UNUSED(fs);
+#endif
+}
+
+void setProgramBinaryRetrievable(QOpenGLShaderProgram *program)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (!resolveProgramBinary() || !qtav_glProgramParameteri)
+        return;
+    qtav_glProgramParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#else
+    Q_UNUSED(program);
+#endif
+}
+
+void deleteSync(void *sync)
+{
+    if (!sync)
+        return;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    if (!resolveSync())
+        return;
+    qtav_glDeleteSync(sync);
+#endif
+}
+
 // glActiveTexture in Qt4 on windows release mode crash for me
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
 #ifndef QT_OPENGL_ES
@@ -140,6 +561,50 @@ void glActiveTexture(GLenum texture)
 #endif
 }
 
+bool hasUnpackRowLength()
+{
+    static bool support = false;
+    static bool checked = false;
+    if (checked)
+        return support;
+    const QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx) {
+        qWarning("no gl context for hasUnpackRowLength");
+        return false;
+    }
+    if (isOpenGLES()) {
+        const char* exts[] = { "GL_EXT_unpack_subimage", NULL };
+        support = ctx->format().majorVersion() >= 3 || hasExtension(exts);
+    } else {
+        support = true;
+    }
+    qDebug() << "GL_UNPACK_ROW_LENGTH: " << support;
+    checked = true;
+    return support;
+}
+
+void texSubImage2D(GLenum target, GLint x, GLint y, GLsizei w, GLsizei h, GLenum format, GLenum type, const GLvoid *pixels, int stride)
+{
+    const int bpt = bytesOfGLFormat(format, type);
+    const int line = w*bpt;
+    if (stride <= 0 || stride == line || h == 1) {
+        DYGL(glTexSubImage2D(target, 0, x, y, w, h, format, type, pixels));
+        return;
+    }
+    // row length is in texels. lines are also aligned to GL_UNPACK_ALIGNMENT, 4 by default
+    if (stride % bpt == 0 && (stride & 3) == 0 && hasUnpackRowLength()) {
+        DYGL(glPixelStorei(GL_UNPACK_ROW_LENGTH, stride/bpt));
+        DYGL(glTexSubImage2D(target, 0, x, y, w, h, format, type, pixels));
+        DYGL(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+        return;
+    }
+    const char *src = (const char*)pixels; // also works if it's an offset in pbo
+    for (int i = 0; i < h; ++i) {
+        DYGL(glTexSubImage2D(target, 0, x, y + i, w, 1, format, type, src));
+        src += stride;
+    }
+}
+
 typedef struct {
     GLint internal_format;
     GLenum format;
@@ -160,7 +625,16 @@ static const gl_param_t gl_param_compat[] = { // it's legacy
     { GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE},
     { GL_LUMINANCE_ALPHA, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE},
 };
-// TODO: new formats GL_RED,...GL_RGB16
+/*!
+  used if is16BitTexture(). sampled value is normalized by 65535, not truncated to 8 bits
+  c: number of channels(components) in the plane
+    result is gl_param_16[c-1]
+*/
+static const gl_param_t gl_param_16[] = {
+    { GL_R16, GL_RED, GL_UNSIGNED_SHORT},
+    { GL_RG16, GL_RG, GL_UNSIGNED_SHORT},
+};
+// TODO: new formats GL_RGB16
 typedef struct {
     VideoFormat::PixelFormat pixfmt;
     quint8 channels[4];
@@ -327,6 +801,20 @@ bool videoFormatToGL(const VideoFormat& fmt, GLint* internal_format, GLenum* dat
     GLint *i_f = internal_format;
     GLenum *d_f = data_format;
     GLenum *d_t = data_type;
+    if (is16BitTexture(fmt)) {
+        for (int p = 0; p < fmt.planeCount(); ++p) {
+            const int c = fmt.channels(p) - 1;
+            if (c < 0 || c >= (int)ARRAY_SIZE(gl_param_16))
+                return false;
+            const gl_param_t f = gl_param_16[c];
+            *(i_f++) = f.internal_format;
+            *(d_f++) = f.format;
+            *(d_t++) = f.type;
+        }
+        if (mat)
+            *mat = QMatrix4x4();
+        return true;
+    }
     for (int p = 0; p < fmt.planeCount(); ++p) {
         // for packed rgb(swizzle required) and planar formats
         const int c = (fmt.channels(p)-1) + 4*((fmt.bitsPerComponent() + 7)/8 - 1);
@@ -406,10 +894,12 @@ int bytesOfGLFormat(GLenum format, GLenum dataType)
       case GL_RGB:
         return 3*component_size;
       case GL_LUMINANCE_ALPHA:
+      case GL_RG:
         // mpv returns 2
         return 2*component_size;
       case GL_LUMINANCE:
       case GL_ALPHA:
+      case GL_RED:
         return 1*component_size;
 #ifdef GL_LUMINANCE16
     case GL_LUMINANCE16:
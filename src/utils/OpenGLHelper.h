@@ -93,6 +93,26 @@ typedef QGLBuffer QOpenGLBuffer;
 #ifndef GL_BGR
 #define GL_BGR 0x80E0
 #endif
+// GL3, GL_ARB_texture_rg, GL_EXT_texture_rg. GL_EXT_texture_norm16 uses the same values
+#ifndef GL_RED
+#define GL_RED 0x1903
+#endif
+#ifndef GL_RG
+#define GL_RG 0x8227
+#endif
+#ifndef GL_R16
+#define GL_R16 0x822A
+#endif
+#ifndef GL_RG16
+#define GL_RG16 0x822C
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+// desktop GL, es3 and GL_EXT_unpack_subimage(GL_UNPACK_ROW_LENGTH_EXT has the same value)
+#ifndef GL_UNPACK_ROW_LENGTH
+#define GL_UNPACK_ROW_LENGTH 0x0CF2
+#endif
 // for dynamicgl. qglfunctions before qt5.3 does not have portable gl functions
 #ifdef QT_OPENGL_DYNAMIC
 #define DYGL(glFunc) QOpenGLContext::currentContext()->functions()->glFunc
@@ -115,7 +135,80 @@ bool isOpenGLES();
  */
 bool hasExtension(const char* exts[]);
 bool isPBOSupported();
+/*!
+ * \brief has16BitTexture
+ * Normalized 16 bit textures GL_R16 and GL_RG16 are supported. Current OpenGL context must be valid.
+ */
+bool has16BitTexture();
+/*!
+ * \brief is16BitTexture
+ * true if planes of fmt are uploaded as GL_R16/GL_RG16 by videoFormatToGL(), i.e. planar 9~16 bit formats in native endian
+ * if has16BitTexture(). Otherwise 2 bytes components are uploaded as GL_LUMINANCE_ALPHA and combined in shader
+ */
+bool is16BitTexture(const VideoFormat& fmt);
+/*!
+ * \brief fenceSync
+ * Insert a fence sync object(GL3.2, GL_ARB_sync, ES3) into current context's command stream. Qt5 only.
+ * \return 0 if not supported
+ */
+void* fenceSync();
+/*!
+ * \brief isSyncSignaled
+ * Commands before the fence are completed. true if sync is 0
+ * \param timeoutNs max time to block waiting for it. 0: never blocks
+ */
+bool isSyncSignaled(void* sync, quint64 timeoutNs = 0);
+/*!
+ * \brief waitSync
+ * Commands after it in current context are not executed by gpu until sync is signaled. Does not block the cpu.
+ * sync can be from another context in the share group
+ */
+void waitSync(void* sync);
+void deleteSync(void* sync);
+bool isFenceSyncSupported();
+/*!
+ * \brief hasBufferStorage
+ * Immutable buffer storage that can be mapped persistently (GL4.4, GL_ARB_buffer_storage, GL_EXT_buffer_storage). Qt5 only
+ */
+bool hasBufferStorage();
+/*!
+ * \brief createPersistentBuffer
+ * Create a buffer with immutable storage of size bytes, which is mapped persistently and coherently for writing,
+ * so data written to the address is visible to gpu without unmap or flush. hasBufferStorage() must be true.
+ * \param ptr the mapped address
+ * \return buffer id. 0 if failed
+ */
+GLuint createPersistentBuffer(GLenum target, int size, void** ptr);
+void deletePersistentBuffer(GLenum target, GLuint buffer);
+void bindBuffer(GLenum target, GLuint buffer);
+/*!
+ * \brief loadProgramBinary
+ * Load a linked program from the on-disk program binary cache (GL4.1, GL_ARB_get_program_binary, es3, GL_OES_get_program_binary)
+ * instead of compiling the shaders. The cache is in CacheLocation/shaders and keyed by GL vendor, renderer, version and
+ * the shader sources. Set environment var QTAV_SHADER_CACHE=0 to disable. Qt5 only
+ * \return true if program is linked from the binary. Otherwise program is untouched and shaders must be compiled
+ */
+bool loadProgramBinary(QOpenGLShaderProgram* program, const QByteArray& vs, const QByteArray& fs);
+/*!
+ * \brief saveProgramBinary
+ * Store the linked program in the program binary cache. Call setProgramBinaryRetrievable() before linking the program
+ */
+void saveProgramBinary(QOpenGLShaderProgram* program, const QByteArray& vs, const QByteArray& fs);
+void setProgramBinaryRetrievable(QOpenGLShaderProgram* program);
 void glActiveTexture(GLenum texture);
+/*!
+ * \brief hasUnpackRowLength
+ * GL_UNPACK_ROW_LENGTH is supported (desktop GL, es3, GL_EXT_unpack_subimage). Current OpenGL context must be valid.
+ */
+bool hasUnpackRowLength();
+/*!
+ * \brief texSubImage2D
+ * Upload a w x h rect whose lines are stride bytes apart to the bound texture of target. It's 1 glTexSubImage2D call if
+ * stride is the size of w texels or GL_UNPACK_ROW_LENGTH is supported, otherwise lines are uploaded one by one.
+ * pixels can be an offset in the bound GL_PIXEL_UNPACK_BUFFER
+ * \param stride <=0: lines are tightly packed
+ */
+void texSubImage2D(GLenum target, GLint x, GLint y, GLsizei w, GLsizei h, GLenum format, GLenum type, const GLvoid* pixels, int stride);
 /*!
  * \brief videoFormatToGL
  * \param fmt
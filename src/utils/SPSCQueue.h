@@ -0,0 +1,538 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_SPSCQUEUE_H
+#define QTAV_SPSCQUEUE_H
+
+#include <string.h>
+#include <vector>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+#include "utils/ring.h"
+
+namespace QtAV {
+namespace spsc {
+// Qt4 has no loadAcquire()/storeRelease()
+inline int loadRelaxed(const QAtomicInt& a) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    return a.load();
+#else
+    return a;
+#endif
+}
+inline int loadAcquire(const QAtomicInt& a) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    return a.loadAcquire();
+#else
+    return const_cast<QAtomicInt&>(a).fetchAndAddAcquire(0);
+#endif
+}
+inline void storeRelease(QAtomicInt& a, int v) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    a.storeRelease(v);
+#else
+    a.fetchAndStoreRelease(v);
+#endif
+}
+// full barrier. used by the sleep/wake handshake
+inline int loadOrdered(const QAtomicInt& a) {
+    return const_cast<QAtomicInt&>(a).fetchAndAddOrdered(0);
+}
+enum { CacheLineSize = 64 };
+} //namespace spsc
+
+/*!
+ * \brief The SPSCQueue class
+ * Single producer single consumer queue. enqueue() must be called in 1 thread and dequeue()/head()/clear() in another 1 thread.
+ * The hot path is a fixed array ring with atomic indices. If the ring is full, new elements spill into a locked RingQueue
+ * until the consumer drains it, so enqueue() never fails nor blocks and the order is kept.
+ */
+template<typename T>
+class SPSCQueue
+{
+public:
+    explicit SPSCQueue(int slots = 512)
+        : m_ring((slots < 2 ? 2 : slots) + 1) // 1 slot is always empty to distinguish full from empty
+        , m_head(0)
+        , m_tail(0)
+        , m_spilled(0)
+        , m_nb_spilled(0)
+    {}
+    int slots() const { return (int)m_ring.size() - 1;}
+    /// producer thread
+    void enqueue(const T& t);
+    /// consumer thread. return false if empty
+    bool dequeue(T* t);
+    /// consumer thread. the queue must not be empty
+    T head() const;
+    /// consumer thread or consumer is excluded by caller
+    void clear();
+    /// any thread. the value may be out of date when returned
+    bool isEmpty() const { return size() == 0;}
+    int size() const {
+        int n = spsc::loadAcquire(m_tail) - spsc::loadAcquire(m_head);
+        if (n < 0)
+            n += (int)m_ring.size();
+        return n + spsc::loadAcquire(m_nb_spilled);
+    }
+private:
+    int next(int i) const { return ++i == (int)m_ring.size() ? 0 : i;}
+
+    std::vector<T> m_ring;
+    // head and tail are written by different threads. keep them in different cache lines
+    QAtomicInt m_head; // written by consumer
+    char m_pad0[spsc::CacheLineSize - sizeof(QAtomicInt)];
+    QAtomicInt m_tail; // written by producer
+    char m_pad1[spsc::CacheLineSize - sizeof(QAtomicInt)];
+    QAtomicInt m_spilled; // 1: set by producer when ring is full, reset by consumer when m_spill is drained
+    QAtomicInt m_nb_spilled;
+    mutable QMutex m_spill_mutex;
+    RingQueue<T> m_spill;
+};
+
+template<typename T>
+void SPSCQueue<T>::enqueue(const T &t)
+{
+    // elements in ring are always older than elements in m_spill, so use ring only if nothing was spilled
+    if (!spsc::loadAcquire(m_spilled)) {
+        const int tail = spsc::loadRelaxed(m_tail);
+        const int n = next(tail);
+        if (n != spsc::loadAcquire(m_head)) {
+            m_ring[tail] = t;
+            spsc::storeRelease(m_tail, n);
+            return;
+        }
+    }
+    QMutexLocker lock(&m_spill_mutex);
+    Q_UNUSED(lock);
+    m_spill.enqueue(t);
+    m_nb_spilled.fetchAndAddOrdered(1);
+    spsc::storeRelease(m_spilled, 1);
+}
+
+template<typename T>
+bool SPSCQueue<T>::dequeue(T *t)
+{
+    const int head = spsc::loadRelaxed(m_head);
+    if (head != spsc::loadAcquire(m_tail)) {
+        *t = m_ring[head];
+        m_ring[head] = T(); // release the shared data now
+        spsc::storeRelease(m_head, next(head));
+        return true;
+    }
+    if (!spsc::loadAcquire(m_spilled))
+        return false;
+    QMutexLocker lock(&m_spill_mutex);
+    Q_UNUSED(lock);
+    if (m_spill.isEmpty())
+        return false;
+    *t = m_spill.dequeue();
+    m_nb_spilled.fetchAndAddOrdered(-1);
+    if (m_spill.isEmpty()) // the ring is empty too, producer can use it again
+        spsc::storeRelease(m_spilled, 0);
+    return true;
+}
+
+template<typename T>
+T SPSCQueue<T>::head() const
+{
+    const int head = spsc::loadRelaxed(m_head);
+    if (head != spsc::loadAcquire(m_tail))
+        return m_ring[head];
+    QMutexLocker lock(&m_spill_mutex);
+    Q_UNUSED(lock);
+    if (m_spill.isEmpty())
+        return T();
+    return m_spill.head();
+}
+
+template<typename T>
+void SPSCQueue<T>::clear()
+{
+    T t;
+    while (dequeue(&t)) {}
+}
+
+/*!
+ * \brief The SPSCBlockingQueue class
+ * The same api and behavior as BlockingQueue, but put() must be called in 1 thread and take() in another 1 thread.
+ * No lock is shared by producer and consumer unless the queue is empty or full and the other side must wait.
+ * The rest functions can be called in any thread. clear() is serialized with take()
+ */
+template <typename T>
+class SPSCBlockingQueue
+{
+public:
+    explicit SPSCBlockingQueue(int slots = 512);
+    virtual ~SPSCBlockingQueue() {}
+
+    void setCapacity(int max); //enqueue is allowed if less than capacity
+    void setThreshold(int min); //wake up and enqueue
+
+    void put(const T& t);
+    // put all elements with at most 1 wait and 1 wake. the queue may exceed capacity by ts.size() - 1
+    void put(const QVector<T>& ts);
+    T take();
+    void setBlocking(bool block); //will wake if false. called when no more data can enqueue
+    void blockEmpty(bool block);
+    void blockFull(bool block);
+    void clear();
+    bool isEmpty() const;
+    bool isEnough() const; //size > thres
+    bool isFull() const; //size >= cap
+    int size() const;
+    int threshold() const;
+    int capacity() const;
+
+    class StateChangeCallback
+    {
+    public:
+        virtual ~StateChangeCallback(){}
+        virtual void call() = 0;
+    };
+    // not thread safe. set before put() and take()
+    void setEmptyCallback(StateChangeCallback* call);
+    void setThresholdCallback(StateChangeCallback* call);
+    void setFullCallback(StateChangeCallback* call);
+
+protected:
+    // called in producer or consumer thread without lock. must be safe to be called concurrently
+    virtual bool checkFull() const;
+    virtual bool checkEmpty() const;
+    virtual bool checkEnough() const;
+    // onPut() is always called in producer thread, onTake() in consumer thread or in clear() with T()
+    virtual void onPut(const T&) {}
+    virtual void onTake(const T&) {}
+
+    volatile bool block_empty, block_full;
+    int cap, thres;
+    SPSCQueue<T> queue;
+private:
+    void wakeFull();
+    QMutex take_lock; // take() vs clear(). uncontended in producer/consumer loops
+    QMutex wait_lock; // only used to sleep and wake
+    QWaitCondition cond_full, cond_empty;
+    QAtomicInt waiting_full, waiting_empty;
+    QScopedPointer<StateChangeCallback> empty_callback, threshold_callback, full_callback;
+};
+
+template <typename T>
+SPSCBlockingQueue<T>::SPSCBlockingQueue(int slots)
+    : block_empty(true), block_full(true), cap(48), thres(32)
+    , queue(slots)
+    , waiting_full(0)
+    , waiting_empty(0)
+    , empty_callback(0)
+    , threshold_callback(0)
+    , full_callback(0)
+{
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::setCapacity(int max)
+{
+    cap = max;
+    if (thres > cap)
+        thres = cap;
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::setThreshold(int min)
+{
+    if (min > cap)
+        return;
+    thres = min;
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::put(const T &t)
+{
+    if (checkFull()) {
+        if (full_callback)
+            full_callback->call();
+        if (block_full) {
+            QMutexLocker lock(&wait_lock);
+            Q_UNUSED(lock);
+            waiting_full.fetchAndStoreOrdered(1);
+            // check again. consumer may take and wake before waiting_full is set
+            if (block_full && checkFull())
+                cond_full.wait(&wait_lock);
+            waiting_full.fetchAndStoreOrdered(0);
+        }
+    }
+    queue.enqueue(t);
+    onPut(t); // emit bufferProgressChanged here if buffering
+    if (spsc::loadOrdered(waiting_empty) && checkEnough()) {
+        QMutexLocker lock(&wait_lock);
+        Q_UNUSED(lock);
+        cond_empty.wakeAll(); //emit buffering finished here
+    }
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::put(const QVector<T> &ts)
+{
+    if (ts.isEmpty())
+        return;
+    if (checkFull()) {
+        if (full_callback)
+            full_callback->call();
+        if (block_full) {
+            QMutexLocker lock(&wait_lock);
+            Q_UNUSED(lock);
+            waiting_full.fetchAndStoreOrdered(1);
+            if (block_full && checkFull())
+                cond_full.wait(&wait_lock);
+            waiting_full.fetchAndStoreOrdered(0);
+        }
+    }
+    for (int i = 0; i < ts.size(); ++i) {
+        queue.enqueue(ts.at(i));
+        onPut(ts.at(i));
+    }
+    if (spsc::loadOrdered(waiting_empty) && checkEnough()) {
+        QMutexLocker lock(&wait_lock);
+        Q_UNUSED(lock);
+        cond_empty.wakeAll();
+    }
+}
+
+template <typename T>
+T SPSCBlockingQueue<T>::take()
+{
+    if (!checkEnough()) {
+        wakeFull();
+        if (checkEmpty()) {
+            if (empty_callback) {
+                empty_callback->call();
+            }
+            if (block_empty) {
+                QMutexLocker lock(&wait_lock);
+                Q_UNUSED(lock);
+                waiting_empty.fetchAndStoreOrdered(1);
+                if (block_empty && checkEmpty())
+                    cond_empty.wait(&wait_lock); //block when empty only
+                waiting_empty.fetchAndStoreOrdered(0);
+            }
+        }
+    }
+    QMutexLocker locker(&take_lock);
+    Q_UNUSED(locker);
+    T t;
+    if (!queue.dequeue(&t)) {
+        qWarning("Queue is still empty");
+        if (empty_callback) {
+            empty_callback->call();
+        }
+        return T();
+    }
+    onTake(t); // emit start buffering here if empty
+    return t;
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::setBlocking(bool block)
+{
+    QMutexLocker lock(&wait_lock);
+    Q_UNUSED(lock);
+    block_empty = block_full = block;
+    if (!block) {
+        cond_empty.wakeAll();
+        cond_full.wakeAll();
+    }
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::blockEmpty(bool block)
+{
+    QMutexLocker lock(&wait_lock);
+    Q_UNUSED(lock);
+    block_empty = block;
+    if (!block)
+        cond_empty.wakeAll();
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::blockFull(bool block)
+{
+    // wait_lock is never held while calling callbacks, so it's safe to call in empty callback
+    QMutexLocker lock(&wait_lock);
+    Q_UNUSED(lock);
+    block_full = block;
+    if (!block)
+        cond_full.wakeAll();
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::clear()
+{
+    {
+        QMutexLocker locker(&take_lock);
+        Q_UNUSED(locker);
+        queue.clear();
+        onTake(T());
+    }
+    wakeFull();
+}
+
+template <typename T>
+bool SPSCBlockingQueue<T>::isEmpty() const
+{
+    return queue.isEmpty();
+}
+
+template <typename T>
+bool SPSCBlockingQueue<T>::isEnough() const
+{
+    return queue.size() >= thres;
+}
+
+template <typename T>
+bool SPSCBlockingQueue<T>::isFull() const
+{
+    return queue.size() >= cap;
+}
+
+template <typename T>
+int SPSCBlockingQueue<T>::size() const
+{
+    return queue.size();
+}
+
+template <typename T>
+int SPSCBlockingQueue<T>::threshold() const
+{
+    return thres;
+}
+
+template <typename T>
+int SPSCBlockingQueue<T>::capacity() const
+{
+    return cap;
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::setEmptyCallback(StateChangeCallback *call)
+{
+    empty_callback.reset(call);
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::setThresholdCallback(StateChangeCallback *call)
+{
+    threshold_callback.reset(call);
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::setFullCallback(StateChangeCallback *call)
+{
+    full_callback.reset(call);
+}
+
+template <typename T>
+bool SPSCBlockingQueue<T>::checkFull() const
+{
+    return queue.size() >= cap;
+}
+
+template <typename T>
+bool SPSCBlockingQueue<T>::checkEmpty() const
+{
+    return queue.isEmpty();
+}
+
+template <typename T>
+bool SPSCBlockingQueue<T>::checkEnough() const
+{
+    return queue.size() >= thres;
+}
+
+template <typename T>
+void SPSCBlockingQueue<T>::wakeFull()
+{
+    if (!spsc::loadOrdered(waiting_full))
+        return;
+    QMutexLocker lock(&wait_lock);
+    Q_UNUSED(lock);
+    cond_full.wakeAll();
+}
+
+/*!
+ * \brief The SPSCByteRing class
+ * Lock free fifo of bytes with a fixed capacity. write() must be called in 1 thread and read() in another 1 thread,
+ * e.g. an audio output thread and an audio device callback. Neither side ever blocks or allocates.
+ */
+class SPSCByteRing
+{
+public:
+    explicit SPSCByteRing(int capacity = 0) : m_read(0), m_write(0) { resize(capacity);}
+    /// neither producer nor consumer is running. old data is discarded
+    void resize(int capacity) {
+        m_data.resize((capacity < 1 ? 1 : capacity) + 1); // 1 byte is always empty to distinguish full from empty
+        spsc::storeRelease(m_read, 0);
+        spsc::storeRelease(m_write, 0);
+    }
+    int capacity() const { return (int)m_data.size() - 1;}
+    /// any thread. the value may be out of date when returned
+    int readable() const {
+        const int n = spsc::loadAcquire(m_write) - spsc::loadAcquire(m_read);
+        return n < 0 ? n + (int)m_data.size() : n;
+    }
+    int writable() const { return capacity() - readable();}
+    /// producer thread. return bytes written, less than bytes if full
+    int write(const char* data, int bytes) {
+        const int size = (int)m_data.size();
+        const int w = spsc::loadRelaxed(m_write);
+        int free = spsc::loadAcquire(m_read) - w - 1;
+        if (free < 0)
+            free += size;
+        const int n = qMin(bytes, free);
+        const int n1 = qMin(n, size - w);
+        memcpy(&m_data[w], data, n1);
+        memcpy(&m_data[0], data + n1, n - n1);
+        spsc::storeRelease(m_write, (w + n) % size);
+        return n;
+    }
+    /// consumer thread. return bytes read
+    int read(char* data, int bytes) {
+        const int size = (int)m_data.size();
+        const int r = spsc::loadRelaxed(m_read);
+        int avail = spsc::loadAcquire(m_write) - r;
+        if (avail < 0)
+            avail += size;
+        const int n = qMin(bytes, avail);
+        const int n1 = qMin(n, size - r);
+        memcpy(data, &m_data[r], n1);
+        memcpy(data + n1, &m_data[0], n - n1);
+        spsc::storeRelease(m_read, (r + n) % size);
+        return n;
+    }
+private:
+    std::vector<char> m_data;
+    QAtomicInt m_read; // written by consumer
+    char m_pad0[spsc::CacheLineSize - sizeof(QAtomicInt)];
+    QAtomicInt m_write; // written by producer
+};
+} //namespace QtAV
+#endif // QTAV_SPSCQUEUE_H
@@ -0,0 +1,202 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "StreamInfoCache.h"
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+static const quint32 kMagic = 0x51534943; // "QSIC"
+static const quint32 kVersion = 2;
+static const char kSuffix[] = ".sic";
+
+StreamInfoCache& StreamInfoCache::instance()
+{
+    static StreamInfoCache sCache;
+    return sCache;
+}
+
+StreamInfoCache::StreamInfoCache()
+    : m_max_bytes(0)
+{}
+
+void StreamInfoCache::setDirectory(const QString &dir, qint64 maxBytes)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_dir = dir;
+    m_max_bytes = maxBytes;
+    if (m_dir.isEmpty())
+        return;
+    if (!QDir().mkpath(m_dir)) {
+        qWarning() << "StreamInfoCache: failed to create directory " << m_dir;
+        m_dir.clear();
+        return;
+    }
+    trim();
+}
+
+QString StreamInfoCache::directory() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_dir;
+}
+
+qint64 StreamInfoCache::maxBytes() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_max_bytes;
+}
+
+bool StreamInfoCache::get(const QString &key, Entry *e)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    QHash<QString, Entry>::const_iterator it = m_entries.constFind(key);
+    if (it != m_entries.constEnd()) {
+        *e = it.value();
+        return true;
+    }
+    if (m_dir.isEmpty() || !load(key, e))
+        return false;
+    m_keys.append(key);
+    if (m_keys.size() > kMaxEntries)
+        m_entries.remove(m_keys.takeFirst());
+    m_entries.insert(key, *e);
+    return true;
+}
+
+void StreamInfoCache::put(const QString &key, const Entry &e)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (!m_entries.contains(key)) {
+        m_keys.append(key);
+        if (m_keys.size() > kMaxEntries)
+            m_entries.remove(m_keys.takeFirst());
+    }
+    m_entries.insert(key, e);
+    if (m_dir.isEmpty())
+        return;
+    save(key, e);
+    trim();
+}
+
+void StreamInfoCache::setKeyFrames(const QString &key, int stream, const QVector<qint64> &keyframes)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    QHash<QString, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end())
+        return;
+    it.value().keyframe_stream = stream;
+    it.value().keyframes = keyframes;
+    if (m_dir.isEmpty())
+        return;
+    save(key, it.value());
+    trim();
+}
+
+QString StreamInfoCache::filePath(const QString &key) const
+{
+    const QByteArray h(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex());
+    return m_dir + QLatin1Char('/') + QString::fromLatin1(h.constData()) + QLatin1String(kSuffix);
+}
+
+bool StreamInfoCache::load(const QString &key, Entry *e) const
+{
+    QFile f(filePath(key));
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream ds(&f);
+    ds.setVersion(QDataStream::Qt_4_6);
+    quint32 magic = 0, version = 0;
+    ds >> magic >> version;
+    if (magic != kMagic || version != kVersion)
+        return false;
+    QString k;
+    ds >> k;
+    if (k != key) // hash collision
+        return false;
+    Entry r;
+    quint32 nb_streams = 0;
+    ds >> r.size >> r.mtime >> r.format >> r.start_time >> r.duration >> nb_streams;
+    if (ds.status() != QDataStream::Ok || nb_streams > 1024)
+        return false;
+    r.streams.resize(nb_streams);
+    for (int i = 0; i < r.streams.size(); ++i) {
+        Stream &s = r.streams[i];
+        qint32 type = 0, codec_id = 0;
+        ds >> type >> codec_id >> s.width >> s.height >> s.pix_fmt >> s.sample_rate >> s.channels >> s.sample_fmt
+           >> s.channel_layout >> s.avg_frame_rate.num >> s.avg_frame_rate.den >> s.extradata;
+        s.type = (AVMediaType)type;
+        s.codec_id = (AVCodecID)codec_id;
+    }
+    qint32 keyframe_stream = -1;
+    ds >> keyframe_stream >> r.keyframes;
+    r.keyframe_stream = keyframe_stream;
+    if (ds.status() != QDataStream::Ok)
+        return false;
+    *e = r;
+    return true;
+}
+
+void StreamInfoCache::save(const QString &key, const Entry &e) const
+{
+    QFile f(filePath(key));
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "StreamInfoCache: failed to write " << f.fileName() << ": " << f.errorString();
+        return;
+    }
+    QDataStream ds(&f);
+    ds.setVersion(QDataStream::Qt_4_6);
+    ds << kMagic << kVersion << key;
+    ds << e.size << e.mtime << e.format << e.start_time << e.duration << (quint32)e.streams.size();
+    foreach (const Stream& s, e.streams) {
+        ds << (qint32)s.type << (qint32)s.codec_id << s.width << s.height << s.pix_fmt << s.sample_rate << s.channels << s.sample_fmt
+           << s.channel_layout << s.avg_frame_rate.num << s.avg_frame_rate.den << s.extradata;
+    }
+    ds << (qint32)e.keyframe_stream << e.keyframes;
+}
+
+void StreamInfoCache::trim() const
+{
+    if (m_max_bytes <= 0)
+        return;
+    QDir dir(m_dir);
+    // newest first
+    const QFileInfoList files(dir.entryInfoList(QStringList() << QStringLiteral("*%1").arg(QLatin1String(kSuffix)), QDir::Files, QDir::Time));
+    qint64 bytes = 0;
+    foreach (const QFileInfo& fi, files) {
+        bytes += fi.size();
+        if (bytes > m_max_bytes)
+            QFile::remove(fi.absoluteFilePath());
+    }
+}
+
+} //namespace QtAV
@@ -0,0 +1,94 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_STREAMINFOCACHE_H
+#define QTAV_STREAMINFOCACHE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include "QtAV/private/AVCompat.h"
+
+namespace QtAV {
+/*!
+ * \brief The StreamInfoCache class
+ * Stream layout, codec parameters and key frame index of a full probe (avformat_open_input() + avformat_find_stream_info()), keyed by url.
+ * AVDemuxer uses them to skip probing the same media again. Entries are kept in memory, and in a size bounded directory
+ * if setDirectory() is called with a non-empty path, so they are still valid after the application restarts.
+ * An entry is valid only if the fingerprint (size, mtime) of the media does not change. Validation is done by the user.
+ */
+class StreamInfoCache
+{
+public:
+    typedef struct {
+        AVMediaType type;
+        AVCodecID codec_id;
+        int width, height;
+        int pix_fmt;
+        int sample_rate, channels;
+        int sample_fmt;
+        qint64 channel_layout;
+        AVRational avg_frame_rate;
+        QByteArray extradata;
+    } Stream;
+    typedef struct {
+        qint64 size; // media size in bytes. <=0: unknown
+        qint64 mtime; // local file modification time in seconds since epoch. 0: not a local file
+        QByteArray format; // AVInputFormat.name
+        qint64 start_time, duration; // AVFormatContext.start_time, duration
+        QVector<Stream> streams;
+        int keyframe_stream; // -1: no key frame index
+        QVector<qint64> keyframes; // (pts, dts, pos) of key frames in keyframe_stream
+    } Entry;
+
+    static StreamInfoCache& instance();
+    /*!
+     * \brief setDirectory
+     * \param dir empty: disable disk cache
+     * \param maxBytes total size of cache files. the oldest files are removed if exceeded
+     */
+    void setDirectory(const QString& dir, qint64 maxBytes);
+    QString directory() const;
+    qint64 maxBytes() const;
+    /// find an entry in memory, then in disk cache. return false if not found
+    bool get(const QString& key, Entry *e);
+    void put(const QString& key, const Entry& e);
+    /// update key frame index of an existing entry. keyframes is (pts, dts, pos) array
+    void setKeyFrames(const QString& key, int stream, const QVector<qint64>& keyframes);
+private:
+    StreamInfoCache();
+    QString filePath(const QString& key) const;
+    bool load(const QString& key, Entry *e) const;
+    void save(const QString& key, const Entry& e) const;
+    void trim() const;
+
+    enum { kMaxEntries = 64 };
+    mutable QMutex m_mutex;
+    QString m_dir;
+    qint64 m_max_bytes;
+    QHash<QString, Entry> m_entries;
+    QList<QString> m_keys; // insertion order
+};
+} //namespace QtAV
+#endif // QTAV_STREAMINFOCACHE_H
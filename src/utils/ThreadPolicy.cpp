@@ -0,0 +1,119 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "ThreadPolicy.h"
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#ifndef Q_OS_WINRT
+#include <QtCore/QLibrary>
+#endif //Q_OS_WINRT
+#elif defined(Q_OS_MAC)
+#include <Availability.h>
+#include <pthread.h>
+#if __MAC_OS_X_VERSION_MAX_ALLOWED >= 101000 || __IPHONE_OS_VERSION_MAX_ALLOWED >= 80000
+#include <pthread/qos.h>
+#define QTAV_HAVE_QOS_CLASS 1
+#endif
+#elif defined(Q_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "utils/Logger.h"
+
+namespace QtAV {
+
+static bool setRealtime()
+{
+#if defined(Q_OS_WIN)
+#ifndef Q_OS_WINRT
+    // avrt.dll is vista+
+    typedef HANDLE (WINAPI *AvSetMmThreadCharacteristicsW_t)(LPCWSTR, LPDWORD);
+    static AvSetMmThreadCharacteristicsW_t AvSetMmThreadCharacteristicsW = (AvSetMmThreadCharacteristicsW_t)QLibrary::resolve(QStringLiteral("avrt"), "AvSetMmThreadCharacteristicsW");
+    if (!AvSetMmThreadCharacteristicsW)
+        return false;
+    DWORD task = 0;
+    // reverted when the thread exits
+    if (!AvSetMmThreadCharacteristicsW(L"Pro Audio", &task)) {
+        qWarning("AvSetMmThreadCharacteristics error: %lu", GetLastError());
+        return false;
+    }
+    return true;
+#endif //Q_OS_WINRT
+#elif defined(QTAV_HAVE_QOS_CLASS)
+    const int ret = pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+    if (ret) {
+        qWarning("pthread_set_qos_class_self_np error: %d", ret);
+        return false;
+    }
+    return true;
+#elif defined(Q_OS_LINUX)
+    // a low real-time priority. higher than any normal thread but below system real-time threads
+    sched_param sp;
+    sp.sched_priority = qMin(sched_get_priority_min(SCHED_FIFO) + 4, sched_get_priority_max(SCHED_FIFO));
+    const int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    if (ret) {
+        qWarning("SCHED_FIFO is not allowed (error %d). grant CAP_SYS_NICE or RLIMIT_RTPRIO", ret);
+        return false;
+    }
+    return true;
+#endif
+    return false;
+}
+
+static bool setAffinity(quint64 mask)
+{
+#if defined(Q_OS_WIN)
+    const DWORD_PTR m = (DWORD_PTR)mask;
+    if (!m || !SetThreadAffinityMask(GetCurrentThread(), m)) {
+        qWarning("SetThreadAffinityMask error: %lu", GetLastError());
+        return false;
+    }
+    return true;
+#elif defined(Q_OS_LINUX)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < 64 && i < CPU_SETSIZE; ++i) {
+        if (mask & (Q_UINT64_C(1) << i))
+            CPU_SET(i, &set);
+    }
+    // 0: the calling thread. pthread_setaffinity_np() is not in android
+    if (sched_setaffinity(0, sizeof(set), &set)) {
+        qWarning("sched_setaffinity error");
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(mask);
+    qDebug("thread cpu affinity is not supported");
+    return false;
+#endif
+}
+
+void ThreadPolicy::apply() const
+{
+    QThread *t = QThread::currentThread();
+    if (!(realtime && setRealtime()) && priority != QThread::InheritPriority && t->priority() != priority)
+        t->setPriority(priority);
+    if (affinity)
+        setAffinity(affinity);
+}
+
+} //namespace QtAV
@@ -0,0 +1,47 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_THREADPOLICY_H
+#define QTAV_THREADPOLICY_H
+
+#include <QtCore/QThread>
+
+namespace QtAV {
+/*!
+ * \brief The ThreadPolicy struct
+ * Scheduling of a pipeline thread. Applied by the thread itself at the beginning of run(), because cpu affinity and
+ * real-time scheduling can only be set for the calling thread on some platforms.
+ */
+struct ThreadPolicy
+{
+    ThreadPolicy(QThread::Priority p = QThread::InheritPriority) : priority(p), affinity(0), realtime(false) {}
+    QThread::Priority priority; // InheritPriority: unchanged
+    quint64 affinity; // bit i: cpu i. 0: any cpu
+    /*
+     * SCHED_FIFO on linux (requires CAP_SYS_NICE or RLIMIT_RTPRIO), MMCSS "Pro Audio" task on windows and
+     * QOS_CLASS_USER_INTERACTIVE on apple. priority is used if not allowed
+     */
+    bool realtime;
+    /// apply to the calling thread
+    void apply() const;
+};
+} //namespace QtAV
+#endif // QTAV_THREADPOLICY_H
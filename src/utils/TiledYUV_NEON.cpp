@@ -0,0 +1,111 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include <arm_neon.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * cedarv output planes are 32x32 byte tiles. lines of a tile are continuous, and tiles of a tile row are continuous.
+ * Same as tiled_yuv.S from libvdpau-sunxi, but the compiler can schedule it for the target core (-mtune), and the last
+ * tile column is copied exactly, so nothing is written out of the plane if width is not a multiple of 32
+ */
+#define UINT unsigned int
+
+static inline UINT min_u(UINT a, UINT b) { return a < b ? a : b;}
+
+void TiledToPlanar_NEON(void *src, void *dst, UINT dst_pitch, UINT width, UINT height)
+{
+    const uint8_t *s = (const uint8_t*)src;
+    uint8_t *d = (uint8_t*)dst;
+    const UINT tiles = (width + 31) >> 5;
+    for (UINT y = 0; y < height; y += 32) {
+        const UINT lines = min_u(32, height - y);
+        for (UINT t = 0; t < tiles; ++t) {
+            const uint8_t *ts = s + t*1024;
+            uint8_t *td = d + t*32;
+            const UINT n = min_u(32, width - t*32);
+#if defined(__GNUC__)
+            __builtin_prefetch(ts + 1024);
+#endif
+            for (UINT l = 0; l < lines; ++l) {
+                if (n == 32) {
+                    const uint8x16_t q0 = vld1q_u8(ts);
+                    const uint8x16_t q1 = vld1q_u8(ts + 16);
+                    vst1q_u8(td, q0);
+                    vst1q_u8(td + 16, q1);
+                } else {
+                    memcpy(td, ts, n);
+                }
+                ts += 32;
+                td += dst_pitch;
+            }
+        }
+        s += tiles*1024;
+        d += 32*dst_pitch;
+    }
+}
+
+// width: bytes of an interleaved line, i.e. luma width
+void TiledDeinterleaveToPlanar_NEON(void *src, void *dst1, void *dst2, UINT dst_pitch, UINT width, UINT height)
+{
+    const uint8_t *s = (const uint8_t*)src;
+    uint8_t *d1 = (uint8_t*)dst1;
+    uint8_t *d2 = (uint8_t*)dst2;
+    const UINT tiles = (width + 31) >> 5;
+    for (UINT y = 0; y < height; y += 32) {
+        const UINT lines = min_u(32, height - y);
+        for (UINT t = 0; t < tiles; ++t) {
+            const uint8_t *ts = s + t*1024;
+            uint8_t *u = d1 + t*16;
+            uint8_t *v = d2 + t*16;
+            const UINT pairs = min_u(32, width - t*32)/2;
+#if defined(__GNUC__)
+            __builtin_prefetch(ts + 1024);
+#endif
+            for (UINT l = 0; l < lines; ++l) {
+                if (pairs == 16) {
+                    const uint8x16x2_t uv = vld2q_u8(ts);
+                    vst1q_u8(u, uv.val[0]);
+                    vst1q_u8(v, uv.val[1]);
+                } else {
+                    UINT x = 0;
+                    if (pairs >= 8) {
+                        const uint8x8x2_t uv = vld2_u8(ts);
+                        vst1_u8(u, uv.val[0]);
+                        vst1_u8(v, uv.val[1]);
+                        x = 8;
+                    }
+                    for (; x < pairs; ++x) {
+                        u[x] = ts[2*x];
+                        v[x] = ts[2*x+1];
+                    }
+                }
+                ts += 32;
+                u += dst_pitch;
+                v += dst_pitch;
+            }
+        }
+        s += tiles*1024;
+        d1 += 32*dst_pitch;
+        d2 += 32*dst_pitch;
+    }
+}
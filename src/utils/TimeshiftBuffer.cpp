@@ -0,0 +1,212 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "TimeshiftBuffer.h"
+
+namespace QtAV {
+
+TimeshiftBuffer::TimeshiftBuffer()
+    : m_max_duration(0)
+    , m_max_bytes(0)
+    , m_video(true)
+    , m_end(0)
+    , m_bytes(0)
+    , m_seg(0)
+    , m_pos(0)
+    , m_cursor_lost(false)
+{}
+
+void TimeshiftBuffer::setLimits(qint64 duration, qint64 bytes)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_max_duration = duration;
+    m_max_bytes = bytes;
+    if (m_max_duration <= 0) {
+        m_segments.clear();
+        m_bytes = 0;
+        m_seg = m_pos = 0;
+        return;
+    }
+    trim();
+}
+
+bool TimeshiftBuffer::isEnabled() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_max_duration > 0;
+}
+
+void TimeshiftBuffer::reset(bool hasVideo)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_video = hasVideo;
+    m_segments.clear();
+    m_end = 0;
+    m_bytes = 0;
+    m_seg = m_pos = 0;
+    m_cursor_lost = false;
+}
+
+void TimeshiftBuffer::append(const Packet &pkt, bool video)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_max_duration <= 0 || !pkt.isValid())
+        return;
+    // a segment can be decoded from its first packet
+    if (m_video ? video && pkt.hasKeyFrame : (m_segments.isEmpty() || pkt.pts - m_segments.last().start >= 1.0)) {
+        Segment s;
+        s.start = pkt.pts;
+        s.bytes = 0;
+        m_segments.append(s);
+    } else if (m_segments.isEmpty()) {
+        return;
+    }
+    Segment &s = m_segments.last();
+    Entry e;
+    e.packet = pkt;
+    e.video = video;
+    s.entries.append(e);
+    s.bytes += pkt.data.size();
+    m_bytes += pkt.data.size();
+    m_end = qMax(m_end, pkt.pts);
+    trim();
+}
+
+bool TimeshiftBuffer::range(qint64 *startTime, qint64 *endTime) const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_segments.isEmpty())
+        return false;
+    if (startTime)
+        *startTime = qint64(m_segments.first().start*1000.0);
+    if (endTime)
+        *endTime = qint64(m_end*1000.0);
+    return true;
+}
+
+qint64 TimeshiftBuffer::bytes() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_bytes;
+}
+
+bool TimeshiftBuffer::seek(qint64 *pos)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    if (m_segments.isEmpty())
+        return false;
+    m_pos = 0;
+    m_cursor_lost = false;
+    const qreal t = qreal(*pos)/1000.0;
+    if (t > m_end) {
+        m_seg = m_segments.size() - 1;
+        *pos = qint64(m_segments.last().start*1000.0);
+        return true;
+    }
+    // segments are sorted by start time
+    int lo = 0, hi = m_segments.size() - 1;
+    while (lo < hi) {
+        const int mid = (lo + hi + 1)/2;
+        if (m_segments.at(mid).start <= t)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    m_seg = lo;
+    return true;
+}
+
+bool TimeshiftBuffer::peek(Packet *pkt, bool *video) const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    int seg = m_seg, pos = m_pos;
+    while (seg < m_segments.size() && pos >= m_segments.at(seg).entries.size()) {
+        ++seg;
+        pos = 0;
+    }
+    if (seg >= m_segments.size())
+        return false;
+    const Entry &e = m_segments.at(seg).entries.at(pos);
+    *pkt = e.packet;
+    *video = e.video;
+    return true;
+}
+
+void TimeshiftBuffer::next()
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    while (m_seg < m_segments.size() && m_pos >= m_segments.at(m_seg).entries.size()) {
+        // stay at the end of the last segment, packets appended later are read from here
+        if (m_seg + 1 >= m_segments.size())
+            return;
+        ++m_seg;
+        m_pos = 0;
+    }
+    if (m_seg < m_segments.size())
+        ++m_pos;
+}
+
+bool TimeshiftBuffer::atEnd() const
+{
+    Packet pkt;
+    bool video;
+    return !peek(&pkt, &video);
+}
+
+bool TimeshiftBuffer::takeCursorLost()
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    const bool lost = m_cursor_lost;
+    m_cursor_lost = false;
+    return lost;
+}
+
+void TimeshiftBuffer::trim()
+{
+    // keep the latest segment and at least max duration
+    while (m_segments.size() > 1) {
+        const bool too_long = (m_end - m_segments.at(1).start)*1000.0 >= qreal(m_max_duration);
+        const bool too_large = m_max_bytes > 0 && m_bytes > m_max_bytes;
+        if (!too_long && !too_large)
+            break;
+        m_bytes -= m_segments.first().bytes;
+        m_segments.removeFirst();
+        if (m_seg > 0) {
+            --m_seg;
+        } else {
+            if (m_pos > 0)
+                m_cursor_lost = true;
+            m_pos = 0;
+        }
+    }
+}
+
+} //namespace QtAV
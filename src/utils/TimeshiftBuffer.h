@@ -0,0 +1,92 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_TIMESHIFTBUFFER_H
+#define QTAV_TIMESHIFTBUFFER_H
+
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QVector>
+#include "QtAV/Packet.h"
+
+namespace QtAV {
+/*!
+ * \brief The TimeshiftBuffer class
+ * A memory ring of demuxed audio and video packets of a live stream, segmented by video key frames (by 1s if no video).
+ * The oldest segments are removed if the recorded duration or bytes exceed the limits. Packet data is implicitly shared,
+ * so recording does not copy. Packets are read at a cursor, which is moved to the start of a segment by seek(), so seeking
+ * inside the buffer does not touch the source. Thread safe.
+ */
+class TimeshiftBuffer
+{
+public:
+    TimeshiftBuffer();
+    /*!
+     * \brief setLimits
+     * \param duration max recorded duration in ms. <=0: disable and clear
+     * \param bytes max recorded bytes. <=0: no limit
+     */
+    void setLimits(qint64 duration, qint64 bytes);
+    bool isEnabled() const;
+    /// clear recorded packets. segments start at video key frames if hasVideo
+    void reset(bool hasVideo);
+    void append(const Packet& pkt, bool video);
+    /// recorded range [startTime(), endTime()] in ms. return false if empty
+    bool range(qint64 *startTime, qint64 *endTime) const;
+    qint64 bytes() const;
+    /*!
+     * \brief seek
+     * Move the cursor to the last segment starting at or before *pos (ms), or the first segment. If *pos is after the recorded
+     * range, the cursor is moved to the latest segment, i.e. the nearest position to live.
+     * \param pos the start of the segment is returned if the cursor is moved to the latest segment
+     * \return false if nothing is recorded
+     */
+    bool seek(qint64 *pos);
+    /// the packet at the cursor. return false if the cursor is at the end, i.e. live
+    bool peek(Packet *pkt, bool *video) const;
+    void next();
+    bool atEnd() const;
+    /// segments removed at the cursor since the last call, i.e. playback jumped forward because the buffer is full
+    bool takeCursorLost();
+private:
+    void trim();
+
+    typedef struct {
+        Packet packet;
+        bool video;
+    } Entry;
+    typedef struct {
+        qreal start; // pts of the key frame, s
+        qint64 bytes;
+        QVector<Entry> entries;
+    } Segment;
+    mutable QMutex m_mutex;
+    qint64 m_max_duration, m_max_bytes;
+    bool m_video;
+    qreal m_end; // max pts, s
+    qint64 m_bytes;
+    QList<Segment> m_segments;
+    // read cursor. m_seg == m_segments.size(): at the end
+    int m_seg, m_pos;
+    bool m_cursor_lost;
+};
+} //namespace QtAV
+#endif //QTAV_TIMESHIFTBUFFER_H
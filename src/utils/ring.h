@@ -65,6 +65,47 @@ public:
   size_t capacity() const {return N;}
 };
 
+/*!
+ * \brief The RingQueue class
+ * QQueue like api (can be used as BlockingQueue's container). Elements are never overwritten, the capacity is doubled
+ * if full and never shrinks, so no allocation after warm up. QQueue allocates every large element on heap.
+ */
+template<typename T>
+class RingQueue {
+public:
+  RingQueue(int capacity = 64) : m_ring(capacity < 2 ? 2 : capacity) {}
+  void enqueue(const T &t) {
+    if (m_ring.size() == m_ring.capacity())
+      grow();
+    m_ring.push_back(t);
+  }
+  T dequeue() {
+    T t(m_ring.front());
+    m_ring.front() = T(); // release shared data
+    m_ring.pop_front();
+    return t;
+  }
+  T &head() { return m_ring.front(); }
+  const T &head() const { return m_ring.front(); }
+  const T &operator[](int i) const { return m_ring.at(i);}
+  bool isEmpty() const { return m_ring.empty();}
+  int size() const { return (int)m_ring.size();}
+  int capacity() const { return (int)m_ring.capacity();}
+  // keep the capacity
+  void clear() {
+    while (!isEmpty())
+      dequeue();
+  }
+private:
+  void grow() {
+    ring<T> r(2*m_ring.capacity());
+    for (size_t i = 0; i < m_ring.size(); ++i)
+      r.push_back(m_ring[i]);
+    m_ring = r;
+  }
+  ring<T> m_ring;
+};
+
 template<typename T, typename C>
 void ring_api<T,C>::push_back(const T &t) {
     if (m_s == capacity()) {
@@ -26,10 +26,54 @@
 #if VA_X11_INTEROP
 #include <va/va_x11.h>
 #endif
+#if VA_DMABUF_EXPORT
+#include <unistd.h>
+#endif
+#if VA_EGL_INTEROP
+#include <va/va_drmcommon.h>
+#ifndef DRM_FORMAT_R8
+#define DRM_FORMAT_R8 0x20203852 // fourcc_code('R', '8', ' ', ' '), see drm_fourcc.h
+#endif
+#ifndef DRM_FORMAT_GR88
+#define DRM_FORMAT_GR88 0x38385247 // fourcc_code('G', 'R', '8', '8')
+#endif
+#ifndef GL_TEXTURE_SWIZZLE_R
+#define GL_TEXTURE_SWIZZLE_R 0x8E42
+#define GL_TEXTURE_SWIZZLE_G 0x8E43
+#define GL_TEXTURE_SWIZZLE_B 0x8E44
+#define GL_TEXTURE_SWIZZLE_A 0x8E45
+#endif
+#ifndef GL_RED
+#define GL_RED 0x1903
+#endif
+#ifndef GL_GREEN
+#define GL_GREEN 0x1904
+#endif
+#endif //VA_EGL_INTEROP
 
 namespace QtAV {
 namespace vaapi {
 
+SurfaceInteropVAAPI::SurfaceInteropVAAPI(const InteropResourcePtr& res)
+    : frame_width(0)
+    , frame_height(0)
+    , m_resource(res)
+{
+#if VA_DMABUF_EXPORT
+    m_prime_exported = false;
+#endif
+}
+
+SurfaceInteropVAAPI::~SurfaceInteropVAAPI()
+{
+#if VA_DMABUF_EXPORT
+    if (m_prime_exported) {
+        for (uint32_t i = 0; i < m_prime.num_objects; ++i)
+            ::close(m_prime.objects[i].fd);
+    }
+#endif
+}
+
 void SurfaceInteropVAAPI::setSurface(const surface_ptr& surface,  int w, int h) {
     m_surface = surface;
     frame_width = (w ? w : surface->width());
@@ -40,7 +84,15 @@ void* SurfaceInteropVAAPI::map(SurfaceType type, const VideoFormat &fmt, void *h
 {
     if (!handle)
         return NULL;
-    if (!fmt.isRGB())
+    if (type == VAAPISurface) {
+        if (!m_surface)
+            return NULL;
+        *((surface_ptr*)handle) = m_surface;
+        return handle;
+    }
+    if (type == DmaBufSurface)
+        return mapToDmaBuf(handle);
+    if (!fmt.isRGB() && fmt.pixelFormat() != VideoFormat::Format_NV12) // nv12: EGLInteropResource
         return 0;
 
     if (!m_surface)
@@ -60,6 +112,46 @@ void SurfaceInteropVAAPI::unmap(void *handle)
     m_resource->unmap(*((GLuint*)handle));
 }
 
+void* SurfaceInteropVAAPI::mapToDmaBuf(void *handle)
+{
+#if VA_DMABUF_EXPORT
+    if (!m_surface)
+        return NULL;
+    if (!m_prime_exported) {
+        VAWARN(vaSyncSurface(m_surface->vadisplay(), m_surface->get()));
+        // 1 layer with all planes, the same layout as the surface
+        VAStatus st = vaExportSurfaceHandle(m_surface->vadisplay(), m_surface->get(), VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2
+                                            , VA_EXPORT_SURFACE_READ_ONLY | VA_EXPORT_SURFACE_COMPOSED_LAYERS, &m_prime);
+        if (st != VA_STATUS_SUCCESS) {
+            qWarning("vaExportSurfaceHandle error: %#x %s", st, vaErrorStr(st));
+            return NULL;
+        }
+        m_prime_exported = true;
+    }
+    if (m_prime.num_layers < 1 || m_prime.layers[0].num_planes > 4)
+        return NULL;
+    DmaBufSurfaceInfo *info = reinterpret_cast<DmaBufSurfaceInfo*>(handle);
+    // layers[] is an anonymous struct type
+#define PRIME_LAYER m_prime.layers[0]
+    info->fourcc = PRIME_LAYER.drm_format;
+    info->modifier = m_prime.objects[PRIME_LAYER.object_index[0]].drm_format_modifier;
+    info->width = frame_width;
+    info->height = frame_height;
+    info->planes = PRIME_LAYER.num_planes;
+    for (uint32_t i = 0; i < PRIME_LAYER.num_planes; ++i) {
+        info->fd[i] = m_prime.objects[PRIME_LAYER.object_index[i]].fd;
+        info->size[i] = m_prime.objects[PRIME_LAYER.object_index[i]].size;
+        info->offset[i] = PRIME_LAYER.offset[i];
+        info->pitch[i] = PRIME_LAYER.pitch[i];
+    }
+#undef PRIME_LAYER
+    return handle;
+#else
+    Q_UNUSED(handle);
+    return NULL;
+#endif //VA_DMABUF_EXPORT
+}
+
 void* SurfaceInteropVAAPI::mapToHost(const VideoFormat &format, void *handle, int plane)
 {
     Q_UNUSED(plane);
@@ -125,7 +217,7 @@ void* SurfaceInteropVAAPI::mapToHost(const VideoFormat &format, void *handle, in
         src[i] = (uint8_t*)p_base + image.offsets[i];
         pitch[i] = image.pitches[i];
     }
-    VideoFrame frame = VideoFrame::fromGPU(fmt, frame_width, frame_height, m_surface->height(), src, pitch, true, swap_uv);
+    VideoFrame frame = VideoFrame::fromGPU(fmt, frame_width, frame_height, m_surface->height(), src, pitch, true, swap_uv, format.pixelFormat());
     if (format != fmt)
         frame = frame.to(format);
     VAWARN(vaUnmapBuffer(m_surface->vadisplay(), image.buf));
@@ -303,6 +395,136 @@ bool X11InteropResource::unmap(GLuint tex)
 }
 
 #endif //VA_X11_INTEROP
+#if VA_EGL_INTEROP
+EGLInteropResource::EGLInteropResource()
+    : InteropResource()
+    , fp_eglCreateImageKHR(0)
+    , fp_eglDestroyImageKHR(0)
+    , fp_glEGLImageTargetTexture2DOES(0)
+    , egl_dpy(EGL_NO_DISPLAY)
+    , egl_failed(0)
+    , buffer_acquired(false)
+{
+    egl_image[0] = egl_image[1] = EGL_NO_IMAGE_KHR;
+    va_image.image_id = VA_INVALID_ID;
+}
+
+EGLInteropResource::~EGLInteropResource()
+{
+    // FIXME: the context of egl_dpy may be not current
+    destroyImages();
+}
+
+bool EGLInteropResource::ensureEGL()
+{
+    if (egl_dpy != EGL_NO_DISPLAY)
+        return true;
+    EGLDisplay dpy = eglGetCurrentDisplay();
+    if (dpy == EGL_NO_DISPLAY) {
+        qWarning("vaapi: no current EGL display. EGL interop requires an EGL context");
+        return false;
+    }
+    const char *exts = eglQueryString(dpy, EGL_EXTENSIONS);
+    if (!exts || !strstr(exts, "EGL_EXT_image_dma_buf_import")) {
+        qWarning("vaapi: EGL_EXT_image_dma_buf_import is not supported");
+        return false;
+    }
+    fp_eglCreateImageKHR = (eglCreateImageKHR_t)eglGetProcAddress("eglCreateImageKHR");
+    fp_eglDestroyImageKHR = (eglDestroyImageKHR_t)eglGetProcAddress("eglDestroyImageKHR");
+    fp_glEGLImageTargetTexture2DOES = (glEGLImageTargetTexture2DOES_t)eglGetProcAddress("glEGLImageTargetTexture2DOES");
+    if (!fp_eglCreateImageKHR || !fp_eglDestroyImageKHR || !fp_glEGLImageTargetTexture2DOES) {
+        qWarning("vaapi: EGLImage functions not found");
+        return false;
+    }
+    egl_dpy = dpy;
+    return true;
+}
+
+void EGLInteropResource::destroyImages()
+{
+    for (int i = 0; i < 2; ++i) {
+        if (egl_image[i] != EGL_NO_IMAGE_KHR)
+            fp_eglDestroyImageKHR(egl_dpy, egl_image[i]);
+        egl_image[i] = EGL_NO_IMAGE_KHR;
+    }
+    if (!surface_exported)
+        return;
+    if (buffer_acquired)
+        VAWARN(vaReleaseBufferHandle(surface_exported->vadisplay(), va_image.buf));
+    buffer_acquired = false;
+    if (va_image.image_id != VA_INVALID_ID)
+        VAWARN(vaDestroyImage(surface_exported->vadisplay(), va_image.image_id));
+    va_image.image_id = VA_INVALID_ID;
+    surface_exported = surface_ptr();
+}
+
+bool EGLInteropResource::ensureImages(const surface_ptr &surface, int w, int h)
+{
+    destroyImages();
+    VAWARN(vaSyncSurface(surface->vadisplay(), surface->get()));
+    VA_ENSURE_TRUE(vaDeriveImage(surface->vadisplay(), surface->get(), &va_image), false);
+    surface_exported = surface;
+    if (va_image.format.fourcc != VA_FOURCC_NV12) {
+        qWarning("vaapi: EGL interop supports NV12 surface only. surface format: %#x", va_image.format.fourcc);
+        destroyImages();
+        return false;
+    }
+    memset(&va_buffer, 0, sizeof(va_buffer));
+    va_buffer.mem_type = VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME;
+    VAStatus st = vaAcquireBufferHandle(surface->vadisplay(), va_image.buf, &va_buffer);
+    if (st != VA_STATUS_SUCCESS) {
+        qWarning("vaAcquireBufferHandle error: %#x %s", st, vaErrorStr(st));
+        destroyImages();
+        return false;
+    }
+    buffer_acquired = true;
+    static const EGLint drm_fmt[] = { DRM_FORMAT_R8, DRM_FORMAT_GR88 };
+    for (int i = 0; i < 2; ++i) {
+        const EGLint attribs[] = {
+            EGL_WIDTH, i == 0 ? w : (w+1)/2,
+            EGL_HEIGHT, i == 0 ? h : (h+1)/2,
+            EGL_LINUX_DRM_FOURCC_EXT, drm_fmt[i],
+            EGL_DMA_BUF_PLANE0_FD_EXT, (EGLint)va_buffer.handle,
+            EGL_DMA_BUF_PLANE0_OFFSET_EXT, (EGLint)va_image.offsets[i],
+            EGL_DMA_BUF_PLANE0_PITCH_EXT, (EGLint)va_image.pitches[i],
+            EGL_NONE
+        };
+        egl_image[i] = fp_eglCreateImageKHR(egl_dpy, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, NULL, attribs);
+        if (egl_image[i] == EGL_NO_IMAGE_KHR) {
+            qWarning("vaapi: eglCreateImageKHR error %#x for plane %d", eglGetError(), i);
+            destroyImages();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool EGLInteropResource::map(const surface_ptr &surface, GLuint tex, int w, int h, int plane)
+{
+    if (plane < 0 || plane > 1)
+        return false;
+    if (!ensureEGL()) {
+        egl_failed.fetchAndStoreOrdered(1);
+        return false;
+    }
+    // planes are mapped in order. export the surface once for all planes
+    if (plane == 0 || surface_exported.get() != surface.get()) {
+        if (!ensureImages(surface, w, h))
+            return false;
+    }
+    DYGL(glBindTexture(GL_TEXTURE_2D, tex));
+    fp_glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, egl_image[plane]);
+    if (plane == 1) {
+        // nv12 shader samples chroma as GL_LUMINANCE_ALPHA (.g and .a). swizzle RG to LLLA
+        DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED));
+        DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED));
+        DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED));
+        DYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_GREEN));
+    }
+    DYGL(glBindTexture(GL_TEXTURE_2D, 0));
+    return true;
+}
+#endif //VA_EGL_INTEROP
 } //namespace QtAV
 } //namespace vaapi
 
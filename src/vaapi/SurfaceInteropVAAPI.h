@@ -22,6 +22,7 @@
 #ifndef QTAV_SURFACEINTEROPVAAPI_H
 #define QTAV_SURFACEINTEROPVAAPI_H
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QMap>
 #include <QtCore/QSharedPointer>
 #include <QtCore/QMutex>
@@ -29,9 +30,25 @@
 #include "vaapi_helper.h"
 
 #define VA_X11_INTEROP !defined(QT_OPENGL_ES_2)
-#if defined(QT_OPENGL_ES_2)
+// export va surfaces as DRM PRIME (dma-buf) and import as EGLImage. requires EGL_EXT_image_dma_buf_import. no X11/GLX
+#if QTAV_HAVE(VAAPI_EGL) && VA_CHECK_VERSION(0, 36, 0)
+#define VA_EGL_INTEROP 1
+#else
+#define VA_EGL_INTEROP 0
+#endif
+// export va surfaces as dma-buf with layout and modifier for other apis, e.g. vulkan
+#if VA_CHECK_VERSION(1, 1, 0)
+#define VA_DMABUF_EXPORT 1
+#include <va/va_drmcommon.h>
+#else
+#define VA_DMABUF_EXPORT 0
+#endif
+#if defined(QT_OPENGL_ES_2) || VA_EGL_INTEROP
 #include <EGL/egl.h>
 #endif
+#if VA_EGL_INTEROP
+#include <EGL/eglext.h>
+#endif
 #if VA_X11_INTEROP
 #include <GL/glx.h>
 #endif
@@ -71,14 +88,26 @@ typedef QSharedPointer<InteropResource> InteropResourcePtr;
 class SurfaceInteropVAAPI Q_DECL_FINAL: public VideoSurfaceInterop
 {
 public:
-    SurfaceInteropVAAPI(const InteropResourcePtr& res) : frame_width(0), frame_height(0), m_resource(res) {}
+    SurfaceInteropVAAPI(const InteropResourcePtr& res);
+    ~SurfaceInteropVAAPI();
     void setSurface(const surface_ptr& surface,  int w, int h); // use surface->width/height if w/h is 0
+    /*!
+     * VAAPISurface: handle is a surface_ptr* and is set to the surface. used to feed vaapi filters
+     * DmaBufSurface: the surface is exported by vaExportSurfaceHandle() once, fds are closed when the interop is destroyed
+     */
     void* map(SurfaceType type, const VideoFormat& fmt, void* handle, int plane) Q_DECL_OVERRIDE;
     void unmap(void *handle) Q_DECL_OVERRIDE;
+    // used to create interops of other surfaces on the same display
+    InteropResourcePtr resource() const { return m_resource;}
 protected:
     void* mapToHost(const VideoFormat &format, void *handle, int plane);
+    void* mapToDmaBuf(void *handle);
 private:
     int frame_width, frame_height;
+#if VA_DMABUF_EXPORT
+    VADRMPRIMESurfaceDescriptor m_prime;
+    bool m_prime_exported;
+#endif
     // NOTE: must ensure va-x11/va-glx is unloaded after all va calls(don't know why, but it's true), for example vaTerminate(), to avoid crash
     // so declare InteropResourcePtr first then surface_ptr. InteropResource (va-xxx.so) will be destroyed later than surface_t (vaTerminate())
     InteropResourcePtr m_resource;
@@ -119,6 +148,47 @@ private:
     static glXReleaseTexImage_t glXReleaseTexImage;
 };
 #endif //VA_X11_INTEROP
+#if VA_EGL_INTEROP
+/*!
+ * \brief The EGLInteropResource class
+ * Zero copy for NV12 frames rendered by an EGL context, e.g. Wayland, X11 EGL and eglfs. The surface is exported by
+ * vaAcquireBufferHandle() as a dma-buf, then each plane is imported as an EGLImage (R8 for luma, GR88 for chroma)
+ * and bound to the plane texture. The frame must be NV12.
+ */
+class EGLInteropResource Q_DECL_FINAL: public InteropResource
+{
+public:
+    EGLInteropResource();
+    ~EGLInteropResource() Q_DECL_OVERRIDE;
+    bool map(const surface_ptr &surface, GLuint tex, int w, int h, int plane) Q_DECL_OVERRIDE;
+    /*!
+     * \brief isUsable
+     * false if map() found no current EGL display with dma-buf import, e.g. the renderer is not EGL based.
+     * The decoder must fall back to copy mode then. Can be called in any thread.
+     */
+    bool isUsable() const { return const_cast<QAtomicInt&>(egl_failed).fetchAndAddRelaxed(0) == 0; }
+private:
+    bool ensureEGL();
+    bool ensureImages(const surface_ptr &surface, int w, int h);
+    void destroyImages();
+
+    typedef EGLImageKHR (*eglCreateImageKHR_t)(EGLDisplay dpy, EGLContext ctx, EGLenum target, EGLClientBuffer buffer, const EGLint *attrib_list);
+    typedef EGLBoolean (*eglDestroyImageKHR_t)(EGLDisplay dpy, EGLImageKHR image);
+    typedef void (*glEGLImageTargetTexture2DOES_t)(GLenum target, void *image);
+    eglCreateImageKHR_t fp_eglCreateImageKHR;
+    eglDestroyImageKHR_t fp_eglDestroyImageKHR;
+    glEGLImageTargetTexture2DOES_t fp_glEGLImageTargetTexture2DOES;
+
+    EGLDisplay egl_dpy;
+    QAtomicInt egl_failed; // set in the render thread, read in the decoder thread
+    EGLImageKHR egl_image[2];
+    // the exported surface. keep it until the next frame because the textures sample its memory
+    surface_ptr surface_exported;
+    VAImage va_image;
+    VABufferInfo va_buffer;
+    bool buffer_acquired;
+};
+#endif //VA_EGL_INTEROP
 
 } //namespace vaapi
 } //namespace QtAV
@@ -219,16 +219,18 @@ typedef QSharedPointer<display_t> display_ptr;
 
 class surface_t {
 public:
-    surface_t(int w, int h, VASurfaceID id, const display_ptr& display)
+    // owned: destroy the surface in dtor. false if it's allocated by others, e.g. libavfilter
+    surface_t(int w, int h, VASurfaceID id, const display_ptr& display, bool owned = true)
         : m_id(id)
         , m_display(display)
         , m_width(w)
         , m_height(h)
         , color_space(VA_SRC_BT709)
+        , m_owned(owned)
     {}
     ~surface_t() {
         //qDebug("VAAPI - destroying surface 0x%x", (int)m_id);
-        if (m_id != VA_INVALID_SURFACE)
+        if (m_owned && m_id != VA_INVALID_SURFACE)
             VAWARN(vaDestroySurfaces(m_display->get(), &m_id, 1))
     }
     operator VASurfaceID() const { return m_id;}
@@ -244,6 +246,7 @@ private:
     display_ptr m_display;
     int m_width, m_height;
     int color_space;
+    bool m_owned;
 };
 typedef SharedPtr<surface_t> surface_ptr;
 #ifndef QT_NO_OPENGL
@@ -0,0 +1,1102 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "VulkanVideoMaterial.h"
+#include <QtGui/QVulkanFunctions>
+#include <stdint.h>
+#include <string.h>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#define VK_DMABUF_IMPORT 1
+#else
+#define VK_DMABUF_IMPORT 0
+#endif
+#include "QtAV/SurfaceInterop.h"
+#include "QtAV/private/AVCompat.h"
+#include "utils/Logger.h"
+// SPIR-V arrays video_v_spv and video_f_spv generated from shaders/vulkan by glslangValidator, see libQtAV.pro
+#include "video_v.spv.h"
+#include "video_f.spv.h"
+
+#ifndef DRM_FORMAT_NV12
+#define DRM_FORMAT_NV12 0x3231564E // fourcc_code('N', 'V', '1', '2'), see drm_fourcc.h
+#endif
+#ifndef DRM_FORMAT_P010
+#define DRM_FORMAT_P010 0x30313050 // fourcc_code('P', '0', '1', '0')
+#endif
+
+namespace QtAV {
+
+static const int kMaxPlanes = 3;
+// mat4 colorMatrix, vec4 targetRect, vec4 texRect
+static const uint32_t kPushConstantsSize = 24*sizeof(float);
+
+static int texelBytes(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_R8_UNORM: return 1;
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R16_UNORM: return 2;
+    default: return 4;
+    }
+}
+
+bool VulkanVideoMaterial::planeFormats(const VideoFormat &fmt, VkFormat *formats, int *planes)
+{
+    switch (fmt.pixelFormatFFmpeg()) {
+    case QTAV_PIX_FMT_C(BGRA):
+        formats[0] = VK_FORMAT_B8G8R8A8_UNORM;
+        *planes = 1;
+        return true;
+    case QTAV_PIX_FMT_C(RGBA):
+        formats[0] = VK_FORMAT_R8G8B8A8_UNORM;
+        *planes = 1;
+        return true;
+    case QTAV_PIX_FMT_C(YUV420P):
+    case QTAV_PIX_FMT_C(YUV422P):
+    case QTAV_PIX_FMT_C(YUV444P):
+    case QTAV_PIX_FMT_C(YUVJ420P):
+        formats[0] = formats[1] = formats[2] = VK_FORMAT_R8_UNORM;
+        *planes = 3;
+        return true;
+    case QTAV_PIX_FMT_C(NV12):
+        formats[0] = VK_FORMAT_R8_UNORM;
+        formats[1] = VK_FORMAT_R8G8_UNORM;
+        *planes = 2;
+        return true;
+    case QTAV_PIX_FMT_C(YUV420P10LE):
+    case QTAV_PIX_FMT_C(YUV422P10LE):
+    case QTAV_PIX_FMT_C(YUV444P10LE):
+        formats[0] = formats[1] = formats[2] = VK_FORMAT_R16_UNORM;
+        *planes = 3;
+        return true;
+#if AV_MODULE_CHECK(LIBAVUTIL, 55, 6, 0, 16, 100)
+    case QTAV_PIX_FMT_C(P010LE):
+        formats[0] = VK_FORMAT_R16_UNORM;
+        formats[1] = VK_FORMAT_R16G16_UNORM;
+        *planes = 2;
+        return true;
+#endif
+    default:
+        break;
+    }
+    return false;
+}
+
+bool VulkanVideoMaterial::isSupported(VideoFormat::PixelFormat pixfmt)
+{
+    VkFormat formats[kMaxPlanes];
+    int planes = 0;
+    return planeFormats(VideoFormat(pixfmt), formats, &planes);
+}
+
+QByteArrayList VulkanVideoMaterial::instanceExtensions()
+{
+    // dependencies of the device extensions on vulkan 1.0
+    return QByteArrayList()
+            << QByteArrayLiteral("VK_KHR_get_physical_device_properties2")
+            << QByteArrayLiteral("VK_KHR_external_memory_capabilities");
+}
+
+QByteArrayList VulkanVideoMaterial::deviceExtensions()
+{
+    return QByteArrayList()
+            << QByteArrayLiteral("VK_KHR_timeline_semaphore")
+#if VK_DMABUF_IMPORT
+            << QByteArrayLiteral("VK_KHR_external_memory")
+            << QByteArrayLiteral("VK_KHR_external_memory_fd")
+            << QByteArrayLiteral("VK_KHR_dedicated_allocation")
+            << QByteArrayLiteral("VK_KHR_get_memory_requirements2")
+            << QByteArrayLiteral("VK_KHR_bind_memory2")
+            << QByteArrayLiteral("VK_KHR_image_format_list")
+            << QByteArrayLiteral("VK_KHR_sampler_ycbcr_conversion")
+            << QByteArrayLiteral("VK_KHR_maintenance1")
+            << QByteArrayLiteral("VK_EXT_external_memory_dma_buf")
+            << QByteArrayLiteral("VK_EXT_image_drm_format_modifier")
+            << QByteArrayLiteral("VK_EXT_queue_family_foreign")
+#endif //VK_DMABUF_IMPORT
+               ;
+}
+
+VulkanVideoMaterial::VulkanVideoMaterial()
+    : m_window(0)
+    , m_dev(VK_NULL_HANDLE)
+    , m_df(0)
+    , m_pending_changed(false)
+    , m_range_scale(1.0f)
+    , m_sampler_planes(0)
+    , m_draw_planes(0)
+    , m_draw_count(0)
+    , m_slot(0)
+    , m_cmd_pool(VK_NULL_HANDLE)
+    , m_timeline(VK_NULL_HANDLE)
+    , m_timeline_value(0)
+    , m_timeline_enabled(false)
+    , m_dmabuf(false)
+    , m_sampler(VK_NULL_HANDLE)
+    , m_set_layout(VK_NULL_HANDLE)
+    , m_desc_pool(VK_NULL_HANDLE)
+    , m_pipeline_layout(VK_NULL_HANDLE)
+    , m_pipeline_cache(VK_NULL_HANDLE)
+    , m_vkWaitSemaphores(0)
+    , m_vkGetMemoryFdProperties(0)
+{
+    for (int i = 0; i < kMaxPlanes; ++i)
+        m_pipelines[i] = VK_NULL_HANDLE;
+}
+
+VulkanVideoMaterial::~VulkanVideoMaterial()
+{
+    // the window calls releaseResources() before the device is destroyed
+}
+
+void VulkanVideoMaterial::setupWindow(QVulkanWindow *window)
+{
+    m_window = window;
+    // unsupported extensions are ignored
+    window->setDeviceExtensions(deviceExtensions());
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+    // timeline semaphores must be enabled as a device feature. the feature is required by the extension
+    window->setEnabledFeaturesModifier([this](VkPhysicalDeviceFeatures2 &features) {
+        m_timeline_enabled = false;
+        if (!m_window->supportedDeviceExtensions().contains(QByteArrayLiteral("VK_KHR_timeline_semaphore")))
+            return;
+        memset(&m_timeline_features, 0, sizeof(m_timeline_features));
+        m_timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+        m_timeline_features.timelineSemaphore = VK_TRUE;
+        m_timeline_features.pNext = features.pNext;
+        features.pNext = &m_timeline_features;
+        m_timeline_enabled = true;
+    });
+#endif
+}
+
+void VulkanVideoMaterial::setCurrentFrame(const VideoFrame &frame)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_pending = frame;
+    m_pending_changed = true;
+}
+
+VideoFrame VulkanVideoMaterial::currentFrame() const
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    return m_pending;
+}
+
+void VulkanVideoMaterial::setBrightness(qreal value)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_color_transform.setBrightness(value);
+}
+
+void VulkanVideoMaterial::setContrast(qreal value)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_color_transform.setContrast(value);
+}
+
+void VulkanVideoMaterial::setHue(qreal value)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_color_transform.setHue(value);
+}
+
+void VulkanVideoMaterial::setSaturation(qreal value)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_color_transform.setSaturation(value);
+}
+
+bool VulkanVideoMaterial::initResources()
+{
+    Q_ASSERT(m_window && "setupWindow() is not called");
+    m_dev = m_window->device();
+    QVulkanInstance *inst = m_window->vulkanInstance();
+    m_df = inst->deviceFunctions(m_dev);
+    QVulkanFunctions *f = inst->functions();
+    if (m_timeline_enabled) {
+        m_vkWaitSemaphores = (PFN_vkWaitSemaphoresKHR)f->vkGetDeviceProcAddr(m_dev, "vkWaitSemaphoresKHR");
+        if (!m_vkWaitSemaphores)
+            m_vkWaitSemaphores = (PFN_vkWaitSemaphoresKHR)f->vkGetDeviceProcAddr(m_dev, "vkWaitSemaphores");
+        VkSemaphoreTypeCreateInfoKHR type;
+        memset(&type, 0, sizeof(type));
+        type.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        type.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        type.initialValue = 0;
+        VkSemaphoreCreateInfo sci;
+        memset(&sci, 0, sizeof(sci));
+        sci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        sci.pNext = &type;
+        if (!m_vkWaitSemaphores || m_df->vkCreateSemaphore(m_dev, &sci, 0, &m_timeline) != VK_SUCCESS) {
+            m_timeline = VK_NULL_HANDLE;
+            m_timeline_enabled = false;
+        }
+        m_timeline_value = 0;
+    }
+    qDebug("vulkan upload sync: %s", m_timeline_enabled ? "timeline semaphore" : "fences");
+#if VK_DMABUF_IMPORT
+    const QByteArrayList exts(deviceExtensions());
+    const QVulkanInfoVector<QVulkanExtension> supported(m_window->supportedDeviceExtensions());
+    m_dmabuf = true;
+    foreach (const QByteArray& e, exts) {
+        if (e != "VK_KHR_timeline_semaphore" && !supported.contains(e)) {
+            m_dmabuf = false;
+            break;
+        }
+    }
+    if (m_dmabuf) {
+        m_vkGetMemoryFdProperties = (PFN_vkGetMemoryFdPropertiesKHR)f->vkGetDeviceProcAddr(m_dev, "vkGetMemoryFdPropertiesKHR");
+        m_dmabuf = !!m_vkGetMemoryFdProperties;
+    }
+    qDebug("vulkan dma-buf import: %d", m_dmabuf);
+#endif //VK_DMABUF_IMPORT
+
+    VkCommandPoolCreateInfo cpi;
+    memset(&cpi, 0, sizeof(cpi));
+    cpi.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cpi.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    cpi.queueFamilyIndex = m_window->graphicsQueueFamilyIndex();
+    if (m_df->vkCreateCommandPool(m_dev, &cpi, 0, &m_cmd_pool) != VK_SUCCESS) {
+        qWarning("failed to create vulkan command pool");
+        return false;
+    }
+
+    VkSamplerCreateInfo si;
+    memset(&si, 0, sizeof(si));
+    si.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    si.magFilter = VK_FILTER_LINEAR;
+    si.minFilter = VK_FILTER_LINEAR;
+    si.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    si.addressModeU = si.addressModeV = si.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    si.maxAnisotropy = 1.0f;
+    if (m_df->vkCreateSampler(m_dev, &si, 0, &m_sampler) != VK_SUCCESS) {
+        qWarning("failed to create vulkan sampler");
+        return false;
+    }
+
+    VkDescriptorSetLayoutBinding bindings[kMaxPlanes];
+    memset(bindings, 0, sizeof(bindings));
+    for (int i = 0; i < kMaxPlanes; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo dli;
+    memset(&dli, 0, sizeof(dli));
+    dli.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    dli.bindingCount = kMaxPlanes;
+    dli.pBindings = bindings;
+    if (m_df->vkCreateDescriptorSetLayout(m_dev, &dli, 0, &m_set_layout) != VK_SUCCESS)
+        return false;
+
+    const int nb_sets = m_window->concurrentFrameCount();
+    VkDescriptorPoolSize ps;
+    ps.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    ps.descriptorCount = nb_sets*kMaxPlanes;
+    VkDescriptorPoolCreateInfo dpi;
+    memset(&dpi, 0, sizeof(dpi));
+    dpi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    dpi.maxSets = nb_sets;
+    dpi.poolSizeCount = 1;
+    dpi.pPoolSizes = &ps;
+    if (m_df->vkCreateDescriptorPool(m_dev, &dpi, 0, &m_desc_pool) != VK_SUCCESS)
+        return false;
+    m_sets.resize(nb_sets);
+    QVector<VkDescriptorSetLayout> layouts(nb_sets, m_set_layout);
+    VkDescriptorSetAllocateInfo dai;
+    memset(&dai, 0, sizeof(dai));
+    dai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    dai.descriptorPool = m_desc_pool;
+    dai.descriptorSetCount = nb_sets;
+    dai.pSetLayouts = layouts.constData();
+    if (m_df->vkAllocateDescriptorSets(m_dev, &dai, m_sets.data()) != VK_SUCCESS)
+        return false;
+
+    VkPushConstantRange pcr;
+    pcr.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pcr.offset = 0;
+    pcr.size = kPushConstantsSize;
+    VkPipelineLayoutCreateInfo pli;
+    memset(&pli, 0, sizeof(pli));
+    pli.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pli.setLayoutCount = 1;
+    pli.pSetLayouts = &m_set_layout;
+    pli.pushConstantRangeCount = 1;
+    pli.pPushConstantRanges = &pcr;
+    if (m_df->vkCreatePipelineLayout(m_dev, &pli, 0, &m_pipeline_layout) != VK_SUCCESS)
+        return false;
+    VkPipelineCacheCreateInfo pci;
+    memset(&pci, 0, sizeof(pci));
+    pci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    m_df->vkCreatePipelineCache(m_dev, &pci, 0, &m_pipeline_cache);
+    return ensurePipelines();
+}
+
+void VulkanVideoMaterial::releaseResources()
+{
+    if (!m_dev)
+        return;
+    m_df->vkDeviceWaitIdle(m_dev);
+    for (int i = 0; i < m_slots.size(); ++i) {
+        UploadSlot &s = m_slots[i];
+        destroyPlanes(s.imported);
+        s.frame = VideoFrame();
+        if (s.buffer)
+            m_df->vkDestroyBuffer(m_dev, s.buffer, 0);
+        if (s.memory)
+            m_df->vkFreeMemory(m_dev, s.memory, 0);
+        if (s.fence)
+            m_df->vkDestroyFence(m_dev, s.fence, 0);
+    }
+    m_slots.clear();
+    destroyPlanes(m_planes);
+    m_draw_planes = 0;
+    m_draw_count = 0;
+    m_format = VideoFormat();
+    for (int i = 0; i < kMaxPlanes; ++i) {
+        if (m_pipelines[i])
+            m_df->vkDestroyPipeline(m_dev, m_pipelines[i], 0);
+        m_pipelines[i] = VK_NULL_HANDLE;
+    }
+    if (m_pipeline_cache)
+        m_df->vkDestroyPipelineCache(m_dev, m_pipeline_cache, 0);
+    if (m_pipeline_layout)
+        m_df->vkDestroyPipelineLayout(m_dev, m_pipeline_layout, 0);
+    if (m_desc_pool) // sets are freed with the pool
+        m_df->vkDestroyDescriptorPool(m_dev, m_desc_pool, 0);
+    m_sets.clear();
+    if (m_set_layout)
+        m_df->vkDestroyDescriptorSetLayout(m_dev, m_set_layout, 0);
+    if (m_sampler)
+        m_df->vkDestroySampler(m_dev, m_sampler, 0);
+    if (m_cmd_pool) // command buffers are freed with the pool
+        m_df->vkDestroyCommandPool(m_dev, m_cmd_pool, 0);
+    if (m_timeline)
+        m_df->vkDestroySemaphore(m_dev, m_timeline, 0);
+    m_pipeline_cache = VK_NULL_HANDLE;
+    m_pipeline_layout = VK_NULL_HANDLE;
+    m_desc_pool = VK_NULL_HANDLE;
+    m_set_layout = VK_NULL_HANDLE;
+    m_sampler = VK_NULL_HANDLE;
+    m_cmd_pool = VK_NULL_HANDLE;
+    m_timeline = VK_NULL_HANDLE;
+    m_dev = VK_NULL_HANDLE;
+    // frames to upload again for a new device
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_pending_changed = m_pending.isValid();
+}
+
+bool VulkanVideoMaterial::ensurePipelines()
+{
+    VkShaderModuleCreateInfo smi;
+    memset(&smi, 0, sizeof(smi));
+    smi.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    VkShaderModule vs = VK_NULL_HANDLE, fs = VK_NULL_HANDLE;
+    smi.codeSize = sizeof(video_v_spv);
+    smi.pCode = video_v_spv;
+    m_df->vkCreateShaderModule(m_dev, &smi, 0, &vs);
+    smi.codeSize = sizeof(video_f_spv);
+    smi.pCode = video_f_spv;
+    m_df->vkCreateShaderModule(m_dev, &smi, 0, &fs);
+    if (!vs || !fs) {
+        qWarning("failed to create vulkan shader modules");
+        if (vs)
+            m_df->vkDestroyShaderModule(m_dev, vs, 0);
+        if (fs)
+            m_df->vkDestroyShaderModule(m_dev, fs, 0);
+        return false;
+    }
+    VkSpecializationMapEntry entry;
+    entry.constantID = 0;
+    entry.offset = 0;
+    entry.size = sizeof(int32_t);
+    int32_t planes = 0;
+    VkSpecializationInfo spec;
+    spec.mapEntryCount = 1;
+    spec.pMapEntries = &entry;
+    spec.dataSize = sizeof(planes);
+    spec.pData = &planes;
+    VkPipelineShaderStageCreateInfo stages[2];
+    memset(stages, 0, sizeof(stages));
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vs;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fs;
+    stages[1].pName = "main";
+    stages[1].pSpecializationInfo = &spec;
+    // quad from gl_VertexIndex, no vertex buffer
+    VkPipelineVertexInputStateCreateInfo vi;
+    memset(&vi, 0, sizeof(vi));
+    vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VkPipelineInputAssemblyStateCreateInfo ia;
+    memset(&ia, 0, sizeof(ia));
+    ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    VkPipelineViewportStateCreateInfo vp;
+    memset(&vp, 0, sizeof(vp));
+    vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    vp.viewportCount = 1;
+    vp.scissorCount = 1;
+    VkPipelineRasterizationStateCreateInfo rs;
+    memset(&rs, 0, sizeof(rs));
+    rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rs.polygonMode = VK_POLYGON_MODE_FILL;
+    rs.cullMode = VK_CULL_MODE_NONE;
+    rs.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rs.lineWidth = 1.0f;
+    VkPipelineMultisampleStateCreateInfo ms;
+    memset(&ms, 0, sizeof(ms));
+    ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    ms.rasterizationSamples = m_window->sampleCountFlagBits();
+    // the default render pass has a depth stencil attachment
+    VkPipelineDepthStencilStateCreateInfo ds;
+    memset(&ds, 0, sizeof(ds));
+    ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    VkPipelineColorBlendAttachmentState att;
+    memset(&att, 0, sizeof(att));
+    att.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo cb;
+    memset(&cb, 0, sizeof(cb));
+    cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    cb.attachmentCount = 1;
+    cb.pAttachments = &att;
+    const VkDynamicState dyn_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dyn;
+    memset(&dyn, 0, sizeof(dyn));
+    dyn.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dyn.dynamicStateCount = sizeof(dyn_states)/sizeof(dyn_states[0]);
+    dyn.pDynamicStates = dyn_states;
+    VkGraphicsPipelineCreateInfo gpi;
+    memset(&gpi, 0, sizeof(gpi));
+    gpi.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    gpi.stageCount = 2;
+    gpi.pStages = stages;
+    gpi.pVertexInputState = &vi;
+    gpi.pInputAssemblyState = &ia;
+    gpi.pViewportState = &vp;
+    gpi.pRasterizationState = &rs;
+    gpi.pMultisampleState = &ms;
+    gpi.pDepthStencilState = &ds;
+    gpi.pColorBlendState = &cb;
+    gpi.pDynamicState = &dyn;
+    gpi.layout = m_pipeline_layout;
+    gpi.renderPass = m_window->defaultRenderPass();
+    bool ok = true;
+    // 1 pipeline per shader variant. the spec constant is the number of sampled planes
+    for (int i = 0; i < kMaxPlanes; ++i) {
+        planes = i + 1;
+        if (m_df->vkCreateGraphicsPipelines(m_dev, m_pipeline_cache, 1, &gpi, 0, &m_pipelines[i]) != VK_SUCCESS) {
+            qWarning("failed to create vulkan pipeline for %d planes", planes);
+            m_pipelines[i] = VK_NULL_HANDLE;
+            ok = false;
+        }
+    }
+    m_df->vkDestroyShaderModule(m_dev, vs, 0);
+    m_df->vkDestroyShaderModule(m_dev, fs, 0);
+    return ok;
+}
+
+bool VulkanVideoMaterial::ensureSlots(int count)
+{
+    if (m_slots.size() == count)
+        return true;
+    m_df->vkDeviceWaitIdle(m_dev);
+    for (int i = count; i < m_slots.size(); ++i) {
+        UploadSlot &s = m_slots[i];
+        destroyPlanes(s.imported);
+        if (s.buffer)
+            m_df->vkDestroyBuffer(m_dev, s.buffer, 0);
+        if (s.memory)
+            m_df->vkFreeMemory(m_dev, s.memory, 0);
+        if (s.fence)
+            m_df->vkDestroyFence(m_dev, s.fence, 0);
+        if (s.cmd)
+            m_df->vkFreeCommandBuffers(m_dev, m_cmd_pool, 1, &s.cmd);
+    }
+    const int old = m_slots.size();
+    m_slots.resize(count);
+    m_slot = 0;
+    for (int i = old; i < count; ++i) {
+        UploadSlot &s = m_slots[i];
+        VkCommandBufferAllocateInfo cai;
+        memset(&cai, 0, sizeof(cai));
+        cai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cai.commandPool = m_cmd_pool;
+        cai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cai.commandBufferCount = 1;
+        if (m_df->vkAllocateCommandBuffers(m_dev, &cai, &s.cmd) != VK_SUCCESS)
+            return false;
+        if (m_timeline_enabled)
+            continue;
+        VkFenceCreateInfo fi;
+        memset(&fi, 0, sizeof(fi));
+        fi.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (m_df->vkCreateFence(m_dev, &fi, 0, &s.fence) != VK_SUCCESS)
+            return false;
+    }
+    return true;
+}
+
+void VulkanVideoMaterial::waitSlot(UploadSlot &slot)
+{
+    if (!slot.value) // not submitted
+        return;
+    if (m_timeline_enabled) {
+        VkSemaphoreWaitInfoKHR wi;
+        memset(&wi, 0, sizeof(wi));
+        wi.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        wi.semaphoreCount = 1;
+        wi.pSemaphores = &m_timeline;
+        wi.pValues = &slot.value;
+        m_vkWaitSemaphores(m_dev, &wi, UINT64_MAX);
+    } else {
+        m_df->vkWaitForFences(m_dev, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+        m_df->vkResetFences(m_dev, 1, &slot.fence);
+    }
+    slot.value = 0;
+    // frames drawn from imported planes of the slot are completed, see upload()
+    destroyPlanes(slot.imported);
+    slot.frame = VideoFrame();
+}
+
+bool VulkanVideoMaterial::ensureStaging(UploadSlot &slot, VkDeviceSize size)
+{
+    if (slot.buffer && slot.size >= size)
+        return true;
+    if (slot.buffer)
+        m_df->vkDestroyBuffer(m_dev, slot.buffer, 0);
+    if (slot.memory)
+        m_df->vkFreeMemory(m_dev, slot.memory, 0); // unmapped implicitly
+    slot.buffer = VK_NULL_HANDLE;
+    slot.memory = VK_NULL_HANDLE;
+    slot.mapped = 0;
+    slot.size = 0;
+    VkBufferCreateInfo bi;
+    memset(&bi, 0, sizeof(bi));
+    bi.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bi.size = size;
+    bi.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bi.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (m_df->vkCreateBuffer(m_dev, &bi, 0, &slot.buffer) != VK_SUCCESS)
+        return false;
+    VkMemoryRequirements req;
+    m_df->vkGetBufferMemoryRequirements(m_dev, slot.buffer, &req);
+    VkMemoryAllocateInfo ai;
+    memset(&ai, 0, sizeof(ai));
+    ai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    ai.allocationSize = req.size;
+    ai.memoryTypeIndex = m_window->hostVisibleMemoryIndex(); // coherent, no flush
+    if (m_df->vkAllocateMemory(m_dev, &ai, 0, &slot.memory) != VK_SUCCESS)
+        return false;
+    m_df->vkBindBufferMemory(m_dev, slot.buffer, slot.memory, 0);
+    // mapped persistently
+    if (m_df->vkMapMemory(m_dev, slot.memory, 0, req.size, 0, &slot.mapped) != VK_SUCCESS)
+        return false;
+    slot.size = size;
+    return true;
+}
+
+bool VulkanVideoMaterial::createPlane(Plane &p, VkFormat format, int width, int height)
+{
+    VkImageCreateInfo ii;
+    memset(&ii, 0, sizeof(ii));
+    ii.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    ii.imageType = VK_IMAGE_TYPE_2D;
+    ii.format = format;
+    ii.extent.width = width;
+    ii.extent.height = height;
+    ii.extent.depth = 1;
+    ii.mipLevels = 1;
+    ii.arrayLayers = 1;
+    ii.samples = VK_SAMPLE_COUNT_1_BIT;
+    ii.tiling = VK_IMAGE_TILING_OPTIMAL;
+    ii.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    ii.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    ii.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (m_df->vkCreateImage(m_dev, &ii, 0, &p.image) != VK_SUCCESS) {
+        p.image = VK_NULL_HANDLE;
+        return false;
+    }
+    VkMemoryRequirements req;
+    m_df->vkGetImageMemoryRequirements(m_dev, p.image, &req);
+    VkMemoryAllocateInfo ai;
+    memset(&ai, 0, sizeof(ai));
+    ai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    ai.allocationSize = req.size;
+    ai.memoryTypeIndex = m_window->deviceLocalMemoryIndex();
+    if (!(req.memoryTypeBits & (1u << ai.memoryTypeIndex)) || m_df->vkAllocateMemory(m_dev, &ai, 0, &p.memory) != VK_SUCCESS) {
+        p.memory = VK_NULL_HANDLE;
+        return false;
+    }
+    m_df->vkBindImageMemory(m_dev, p.image, p.memory, 0);
+    p.format = format;
+    p.width = width;
+    p.height = height;
+    return createView(p);
+}
+
+bool VulkanVideoMaterial::createView(Plane &p)
+{
+    VkImageViewCreateInfo vi;
+    memset(&vi, 0, sizeof(vi));
+    vi.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    vi.image = p.image;
+    vi.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    vi.format = p.format;
+    vi.components.r = vi.components.g = vi.components.b = vi.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    vi.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    vi.subresourceRange.levelCount = 1;
+    vi.subresourceRange.layerCount = 1;
+    if (m_df->vkCreateImageView(m_dev, &vi, 0, &p.view) != VK_SUCCESS) {
+        p.view = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+void VulkanVideoMaterial::destroyPlane(Plane &p)
+{
+    if (p.view)
+        m_df->vkDestroyImageView(m_dev, p.view, 0);
+    if (p.image)
+        m_df->vkDestroyImage(m_dev, p.image, 0);
+    if (p.memory)
+        m_df->vkFreeMemory(m_dev, p.memory, 0);
+    p = Plane();
+}
+
+void VulkanVideoMaterial::destroyPlanes(QVector<Plane> &planes)
+{
+    for (int i = 0; i < planes.size(); ++i)
+        destroyPlane(planes[i]);
+    planes.clear();
+}
+
+static void imageBarrier(QVulkanDeviceFunctions *df, VkCommandBuffer cmd, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout
+                         , VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage
+                         , uint32_t srcQueue = VK_QUEUE_FAMILY_IGNORED, uint32_t dstQueue = VK_QUEUE_FAMILY_IGNORED)
+{
+    VkImageMemoryBarrier b;
+    memset(&b, 0, sizeof(b));
+    b.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    b.srcAccessMask = srcAccess;
+    b.dstAccessMask = dstAccess;
+    b.oldLayout = oldLayout;
+    b.newLayout = newLayout;
+    b.srcQueueFamilyIndex = srcQueue;
+    b.dstQueueFamilyIndex = dstQueue;
+    b.image = image;
+    b.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    b.subresourceRange.levelCount = 1;
+    b.subresourceRange.layerCount = 1;
+    df->vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, 0, 0, 0, 1, &b);
+}
+
+bool VulkanVideoMaterial::uploadHost(UploadSlot &slot, const VideoFrame &frame)
+{
+    const VideoFormat &fmt = frame.format();
+    VkFormat formats[kMaxPlanes];
+    int nb_planes = 0;
+    if (!planeFormats(fmt, formats, &nb_planes))
+        return false;
+    const int w = frame.width(), h = frame.height();
+    if (fmt != m_format || m_planes.size() != nb_planes || m_planes[0].width != w || m_planes[0].height != h) {
+        // the planes may be sampled by frames in flight
+        m_df->vkDeviceWaitIdle(m_dev);
+        destroyPlanes(m_planes);
+        m_format = VideoFormat();
+        m_planes.resize(nb_planes);
+        for (int i = 0; i < nb_planes; ++i) {
+            if (!createPlane(m_planes[i], formats[i], i == 0 ? w : fmt.chromaWidth(w), i == 0 ? h : fmt.chromaHeight(h))) {
+                qWarning("failed to create vulkan image for plane %d", i);
+                destroyPlanes(m_planes);
+                return false;
+            }
+        }
+        m_format = fmt;
+    }
+    // planes are copied with their strides, bufferRowLength skips the padding
+    VkBufferImageCopy copies[kMaxPlanes];
+    memset(copies, 0, sizeof(copies));
+    VkDeviceSize size = 0;
+    for (int i = 0; i < nb_planes; ++i) {
+        const int bpt = texelBytes(m_planes[i].format);
+        const int stride = frame.bytesPerLine(i);
+        const int pitch = stride % bpt ? m_planes[i].width*bpt : stride;
+        copies[i].bufferOffset = size;
+        copies[i].bufferRowLength = pitch/bpt;
+        copies[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copies[i].imageSubresource.layerCount = 1;
+        copies[i].imageExtent.width = m_planes[i].width;
+        copies[i].imageExtent.height = m_planes[i].height;
+        copies[i].imageExtent.depth = 1;
+        size += ((VkDeviceSize)pitch*m_planes[i].height + 15) & ~(VkDeviceSize)15;
+    }
+    if (!ensureStaging(slot, size))
+        return false;
+    for (int i = 0; i < nb_planes; ++i) {
+        const int stride = frame.bytesPerLine(i);
+        const int pitch = copies[i].bufferRowLength*texelBytes(m_planes[i].format);
+        uchar *dst = (uchar*)slot.mapped + copies[i].bufferOffset;
+        const uchar *src = frame.constBits(i);
+        if (pitch == stride) {
+            memcpy(dst, src, (size_t)stride*m_planes[i].height);
+            continue;
+        }
+        for (int y = 0; y < m_planes[i].height; ++y)
+            memcpy(dst + y*pitch, src + y*stride, pitch);
+    }
+    VkCommandBufferBeginInfo bi;
+    memset(&bi, 0, sizeof(bi));
+    bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    m_df->vkBeginCommandBuffer(slot.cmd, &bi);
+    for (int i = 0; i < nb_planes; ++i) {
+        // the whole image is written, old content is discarded. waits for the previous frames sampling it
+        imageBarrier(m_df, slot.cmd, m_planes[i].image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+                     , 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        m_df->vkCmdCopyBufferToImage(slot.cmd, slot.buffer, m_planes[i].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copies[i]);
+        // frame commands are submitted later to the same queue, so the barrier makes the planes visible to them
+        imageBarrier(m_df, slot.cmd, m_planes[i].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                     , VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+    m_df->vkEndCommandBuffer(slot.cmd);
+    if (!submit(slot))
+        return false;
+    m_draw_planes = m_planes.constData();
+    m_draw_count = nb_planes;
+    m_sampler_planes = nb_planes;
+    return true;
+}
+
+bool VulkanVideoMaterial::importDmaBuf(UploadSlot &slot, const VideoFrame &frame)
+{
+#if VK_DMABUF_IMPORT
+    if (!m_dmabuf || frame.hasHostData())
+        return false;
+    VideoFrame f(frame);
+    DmaBufSurfaceInfo info;
+    memset(&info, 0, sizeof(info));
+    if (!f.map(DmaBufSurface, &info))
+        return false;
+    VkFormat formats[2];
+    if (info.fourcc == DRM_FORMAT_NV12) {
+        formats[0] = VK_FORMAT_R8_UNORM;
+        formats[1] = VK_FORMAT_R8G8_UNORM;
+    } else if (info.fourcc == DRM_FORMAT_P010) {
+        formats[0] = VK_FORMAT_R16_UNORM;
+        formats[1] = VK_FORMAT_R16G16_UNORM;
+    } else {
+        return false;
+    }
+    if (info.planes != 2)
+        return false;
+    // each plane is imported as an image of the plane format at the plane offset
+    slot.imported.resize(2);
+    for (int i = 0; i < 2; ++i) {
+        Plane &p = slot.imported[i];
+        p.format = formats[i];
+        p.width = i == 0 ? info.width : (info.width + 1)/2;
+        p.height = i == 0 ? info.height : (info.height + 1)/2;
+        VkExternalMemoryImageCreateInfoKHR emi;
+        memset(&emi, 0, sizeof(emi));
+        emi.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO_KHR;
+        emi.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+        VkSubresourceLayout layout;
+        memset(&layout, 0, sizeof(layout));
+        layout.offset = info.offset[i];
+        layout.rowPitch = info.pitch[i];
+        VkImageDrmFormatModifierExplicitCreateInfoEXT mi;
+        memset(&mi, 0, sizeof(mi));
+        mi.sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_EXPLICIT_CREATE_INFO_EXT;
+        mi.pNext = &emi;
+        mi.drmFormatModifier = info.modifier;
+        mi.drmFormatModifierPlaneCount = 1;
+        mi.pPlaneLayouts = &layout;
+        VkImageCreateInfo ii;
+        memset(&ii, 0, sizeof(ii));
+        ii.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        ii.pNext = &mi;
+        ii.imageType = VK_IMAGE_TYPE_2D;
+        ii.format = p.format;
+        ii.extent.width = p.width;
+        ii.extent.height = p.height;
+        ii.extent.depth = 1;
+        ii.mipLevels = 1;
+        ii.arrayLayers = 1;
+        ii.samples = VK_SAMPLE_COUNT_1_BIT;
+        ii.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+        ii.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+        ii.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ii.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (m_df->vkCreateImage(m_dev, &ii, 0, &p.image) != VK_SUCCESS) {
+            qWarning("vulkan: failed to create image of dma-buf plane %d, modifier %#llx", i, (unsigned long long)info.modifier);
+            p.image = VK_NULL_HANDLE;
+            destroyPlanes(slot.imported);
+            return false;
+        }
+        VkMemoryFdPropertiesKHR fdp;
+        memset(&fdp, 0, sizeof(fdp));
+        fdp.sType = VK_STRUCTURE_TYPE_MEMORY_FD_PROPERTIES_KHR;
+        m_vkGetMemoryFdProperties(m_dev, VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT, info.fd[i], &fdp);
+        VkMemoryRequirements req;
+        m_df->vkGetImageMemoryRequirements(m_dev, p.image, &req);
+        const uint32_t types = req.memoryTypeBits & fdp.memoryTypeBits;
+        uint32_t type = 0;
+        while (type < 32 && !(types & (1u << type)))
+            ++type;
+        // the memory takes the ownership of the fd if succeeded
+        const int fd = types ? ::dup(info.fd[i]) : -1;
+        VkImportMemoryFdInfoKHR imp;
+        memset(&imp, 0, sizeof(imp));
+        imp.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR;
+        imp.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+        imp.fd = fd;
+        VkMemoryDedicatedAllocateInfoKHR ded;
+        memset(&ded, 0, sizeof(ded));
+        ded.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR;
+        ded.pNext = &imp;
+        ded.image = p.image;
+        VkMemoryAllocateInfo ai;
+        memset(&ai, 0, sizeof(ai));
+        ai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        ai.pNext = &ded;
+        ai.allocationSize = qMax<VkDeviceSize>(req.size, info.size[i]);
+        ai.memoryTypeIndex = type;
+        if (fd < 0 || m_df->vkAllocateMemory(m_dev, &ai, 0, &p.memory) != VK_SUCCESS) {
+            qWarning("vulkan: failed to import dma-buf plane %d", i);
+            if (fd >= 0)
+                ::close(fd);
+            p.memory = VK_NULL_HANDLE;
+            destroyPlanes(slot.imported);
+            return false;
+        }
+        m_df->vkBindImageMemory(m_dev, p.image, p.memory, 0);
+        if (!createView(p)) {
+            destroyPlanes(slot.imported);
+            return false;
+        }
+    }
+    VkCommandBufferBeginInfo bi;
+    memset(&bi, 0, sizeof(bi));
+    bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    m_df->vkBeginCommandBuffer(slot.cmd, &bi);
+    // acquire the ownership from the decoder
+    for (int i = 0; i < 2; ++i) {
+        imageBarrier(m_df, slot.cmd, slot.imported[i].image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                     , 0, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                     , VK_QUEUE_FAMILY_FOREIGN_EXT, m_window->graphicsQueueFamilyIndex());
+    }
+    m_df->vkEndCommandBuffer(slot.cmd);
+    if (!submit(slot)) {
+        destroyPlanes(slot.imported);
+        return false;
+    }
+    // the surface is not reused by the decoder while the frame is alive
+    slot.frame = frame;
+    m_draw_planes = slot.imported.constData();
+    m_draw_count = 2;
+    m_sampler_planes = 2;
+    return true;
+#else
+    Q_UNUSED(slot);
+    Q_UNUSED(frame);
+    return false;
+#endif //VK_DMABUF_IMPORT
+}
+
+bool VulkanVideoMaterial::submit(UploadSlot &slot)
+{
+    VkSubmitInfo si;
+    memset(&si, 0, sizeof(si));
+    si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    si.commandBufferCount = 1;
+    si.pCommandBuffers = &slot.cmd;
+    VkTimelineSemaphoreSubmitInfoKHR ti;
+    const quint64 value = m_timeline_value + 1;
+    if (m_timeline_enabled) {
+        memset(&ti, 0, sizeof(ti));
+        ti.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        ti.signalSemaphoreValueCount = 1;
+        ti.pSignalSemaphoreValues = &value;
+        si.pNext = &ti;
+        si.signalSemaphoreCount = 1;
+        si.pSignalSemaphores = &m_timeline;
+    }
+    // QVulkanWindow submits the frame commands to the same queue after startNextFrame()
+    const VkResult r = m_df->vkQueueSubmit(m_window->graphicsQueue(), 1, &si, m_timeline_enabled ? VK_NULL_HANDLE : slot.fence);
+    if (r != VK_SUCCESS) {
+        qWarning("vulkan: upload submit error %d", r);
+        return false;
+    }
+    m_timeline_value = value;
+    slot.value = value;
+    return true;
+}
+
+void VulkanVideoMaterial::updateColorMatrix(const VideoFrame &frame)
+{
+    const VideoFormat &fmt = frame.format();
+    ColorSpace cs = frame.colorSpace();
+    if (fmt.isRGB()) {
+        cs = ColorSpace_RGB;
+    } else if (cs == ColorSpace_Unknow) {
+        if (frame.colorPrimaries() == ColorPrimaries_BT2020 || frame.colorTransfer() != ColorTransfer_SDR)
+            cs = ColorSpace_BT2020;
+        else if (frame.width() >= 1280 || frame.height() > 576) //values from mpv
+            cs = ColorSpace_BT709;
+        else
+            cs = ColorSpace_BT601;
+    }
+    m_range_scale = 1.0f;
+    if (!fmt.isRGB() && fmt.bytesPerPixel(0) == 2) {
+        // R16 sample is x/65535. P010 data is in the high bits
+        const int bpc = fmt.bitsPerComponent();
+        int range = (1 << bpc) - 1;
+#if AV_MODULE_CHECK(LIBAVUTIL, 55, 6, 0, 16, 100)
+        if (fmt.pixelFormat() == VideoFormat::Format_P010LE)
+            range <<= 16 - bpc;
+#endif
+        m_range_scale = 65535.0f/(float)range;
+    }
+    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(lock);
+    m_color_transform.setInputColorSpace(cs);
+    m_color_matrix = m_color_transform.matrix();
+    if (m_range_scale != 1.0f) {
+        QMatrix4x4 s;
+        s.scale(m_range_scale, m_range_scale, m_range_scale);
+        m_color_matrix = m_color_matrix*s;
+    }
+}
+
+bool VulkanVideoMaterial::upload()
+{
+    VideoFrame frame;
+    {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        if (!m_pending_changed)
+            return m_draw_count > 0;
+        frame = m_pending;
+        m_pending_changed = false;
+    }
+    if (!frame.isValid()) {
+        m_draw_count = 0;
+        return false;
+    }
+    // a slot is reused after concurrentFrameCount() later uploads, then frames sampling its imported planes are completed
+    if (!ensureSlots(m_window->concurrentFrameCount() + 1))
+        return false;
+    UploadSlot &slot = m_slots[m_slot];
+    m_slot = (m_slot + 1) % m_slots.size();
+    waitSlot(slot);
+    bool ok = importDmaBuf(slot, frame);
+    if (!ok) {
+        VideoFrame host(frame);
+        VkFormat formats[kMaxPlanes];
+        int nb_planes = 0;
+        if (!planeFormats(host.format(), formats, &nb_planes))
+            host = host.to(VideoFormat::Format_YUV420P);
+        else if (!host.hasHostData()) // hw surface
+            host = host.to(host.format());
+        ok = host.isValid() && uploadHost(slot, host);
+        if (ok)
+            frame = host;
+    }
+    if (!ok) {
+        m_draw_count = 0;
+        return false;
+    }
+    updateColorMatrix(frame);
+    m_frame_size = QSizeF(frame.width(), frame.height());
+    return true;
+}
+
+void VulkanVideoMaterial::draw(VkCommandBuffer cb, const QRectF &target, const QRectF &roi)
+{
+    if (!m_draw_count || !m_pipelines[m_sampler_planes - 1])
+        return;
+    // the set of the current frame is not used by frames in flight
+    VkDescriptorSet set = m_sets[m_window->currentFrame()];
+    VkDescriptorImageInfo images[kMaxPlanes];
+    VkWriteDescriptorSet writes[kMaxPlanes];
+    memset(writes, 0, sizeof(writes));
+    for (int i = 0; i < kMaxPlanes; ++i) {
+        // unused bindings must be valid too
+        const Plane &p = m_draw_planes[i < m_draw_count ? i : 0];
+        images[i].sampler = m_sampler;
+        images[i].imageView = p.view;
+        images[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[i].pImageInfo = &images[i];
+    }
+    m_df->vkUpdateDescriptorSets(m_dev, kMaxPlanes, writes, 0, 0);
+
+    const QSize sz(m_window->swapChainImageSize());
+    VkViewport vp;
+    vp.x = vp.y = 0;
+    vp.width = sz.width();
+    vp.height = sz.height();
+    vp.minDepth = 0;
+    vp.maxDepth = 1;
+    VkRect2D scissor;
+    scissor.offset.x = scissor.offset.y = 0;
+    scissor.extent.width = sz.width();
+    scissor.extent.height = sz.height();
+    float pc[24];
+    memcpy(pc, m_color_matrix.constData(), 16*sizeof(float)); // column major
+    // vulkan ndc y is down as the window
+    pc[16] = 2.0f*target.x()/sz.width() - 1.0f;
+    pc[17] = 2.0f*target.y()/sz.height() - 1.0f;
+    pc[18] = 2.0f*target.width()/sz.width();
+    pc[19] = 2.0f*target.height()/sz.height();
+    const QRectF r(roi.isValid() ? roi : QRectF(QPointF(), m_frame_size));
+    pc[20] = r.x()/m_frame_size.width();
+    pc[21] = r.y()/m_frame_size.height();
+    pc[22] = r.width()/m_frame_size.width();
+    pc[23] = r.height()/m_frame_size.height();
+    m_df->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines[m_sampler_planes - 1]);
+    m_df->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout, 0, 1, &set, 0, 0);
+    m_df->vkCmdSetViewport(cb, 0, 1, &vp);
+    m_df->vkCmdSetScissor(cb, 0, 1, &scissor);
+    m_df->vkCmdPushConstants(cb, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, kPushConstantsSize, pc);
+    m_df->vkCmdDraw(cb, 4, 1, 0, 0);
+}
+
+} //namespace QtAV
@@ -0,0 +1,160 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_VULKANVIDEOMATERIAL_H
+#define QTAV_VULKANVIDEOMATERIAL_H
+
+#include <QtCore/QByteArrayList>
+#include <QtCore/QMutex>
+#include <QtCore/QSizeF>
+#include <QtCore/QVector>
+#include <QtGui/QMatrix4x4>
+#include <QtGui/QVulkanWindow>
+#include "QtAV/ColorTransform.h"
+#include "QtAV/VideoFrame.h"
+
+namespace QtAV {
+
+/*!
+ * \brief The VulkanVideoMaterial class
+ * Vulkan counterpart of VideoMaterial. Planes are sampled from 1 image per plane and converted to rgb in the fragment shader.
+ * Host memory frames are copied to a ring of staging buffers and uploaded by command buffers of the material, submitted to
+ * the graphics queue before the frame commands of QVulkanWindow. A staging buffer is reused only when the upload of it is
+ * completed, tracked by a timeline semaphore, or a fence per buffer if timeline semaphores are not enabled.
+ * Frames of an interop that can export dma-buf, e.g. vaapi, are imported as images without copy if the device supports
+ * VK_EXT_external_memory_dma_buf and VK_EXT_image_drm_format_modifier.
+ * setCurrentFrame() and color adjustments are thread safe, others must be called in the rendering thread of the window.
+ */
+class VulkanVideoMaterial
+{
+public:
+    VulkanVideoMaterial();
+    ~VulkanVideoMaterial();
+    static bool isSupported(VideoFormat::PixelFormat pixfmt);
+    // extensions used if supported. set them to QVulkanInstance and QVulkanWindow before the window is shown
+    static QByteArrayList instanceExtensions();
+    static QByteArrayList deviceExtensions();
+    /*!
+     * \brief setupWindow
+     * Set device extensions, and enable timeline semaphores if possible (Qt>=6.7). Call it before the window is shown
+     */
+    void setupWindow(QVulkanWindow *window);
+
+    void setCurrentFrame(const VideoFrame& frame);
+    VideoFrame currentFrame() const;
+    void setBrightness(qreal value);
+    void setContrast(qreal value);
+    void setHue(qreal value);
+    void setSaturation(qreal value);
+
+    // QVulkanWindowRenderer::initResources() and releaseResources()
+    bool initResources();
+    void releaseResources();
+    /*!
+     * \brief upload
+     * Submit the upload of the current frame if it's changed. Call it in startNextFrame() before the render pass begins
+     * \return false if there is nothing to draw
+     */
+    bool upload();
+    /*!
+     * \brief draw
+     * Record the draw commands into the render pass of the current frame of the window
+     * \param target target rect in pixels of the swap chain image
+     * \param roi rect in pixels of the frame
+     */
+    void draw(VkCommandBuffer cb, const QRectF& target, const QRectF& roi);
+
+private:
+    // planes of a frame to sample
+    struct Plane {
+        Plane() : image(VK_NULL_HANDLE), memory(VK_NULL_HANDLE), view(VK_NULL_HANDLE), format(VK_FORMAT_UNDEFINED), width(0), height(0) {}
+        VkImage image;
+        VkDeviceMemory memory;
+        VkImageView view;
+        VkFormat format;
+        int width, height;
+    };
+    struct UploadSlot {
+        UploadSlot() : buffer(VK_NULL_HANDLE), memory(VK_NULL_HANDLE), mapped(0), size(0), cmd(VK_NULL_HANDLE), fence(VK_NULL_HANDLE), value(0) {}
+        VkBuffer buffer;
+        VkDeviceMemory memory;
+        void *mapped;
+        VkDeviceSize size;
+        VkCommandBuffer cmd;
+        VkFence fence; // if no timeline semaphore
+        quint64 value; // timeline value signaled when the upload is completed
+        VideoFrame frame; // the frame of imported planes is kept until they are not used
+        QVector<Plane> imported;
+    };
+    // plane formats and the rgb matrix for fmt. planes is the number of samplers the shader uses
+    static bool planeFormats(const VideoFormat& fmt, VkFormat* formats, int* planes);
+    bool ensurePipelines();
+    bool ensureSlots(int count);
+    void waitSlot(UploadSlot &slot);
+    bool ensureStaging(UploadSlot &slot, VkDeviceSize size);
+    bool createPlane(Plane &p, VkFormat format, int width, int height);
+    bool createView(Plane &p);
+    void destroyPlane(Plane &p);
+    void destroyPlanes(QVector<Plane> &planes);
+    bool uploadHost(UploadSlot &slot, const VideoFrame& frame);
+    bool importDmaBuf(UploadSlot &slot, const VideoFrame& frame);
+    bool submit(UploadSlot &slot);
+    void updateColorMatrix(const VideoFrame& frame);
+
+    QVulkanWindow *m_window;
+    VkDevice m_dev;
+    QVulkanDeviceFunctions *m_df;
+    mutable QMutex m_mutex; // guards the pending frame and color transform
+    VideoFrame m_pending;
+    bool m_pending_changed;
+    ColorTransform m_color_transform;
+    VideoFormat m_format; // of the current planes
+    QMatrix4x4 m_color_matrix;
+    float m_range_scale; // 16 bit sample value to 1.0
+    QSizeF m_frame_size;
+    int m_sampler_planes;
+    QVector<Plane> m_planes; // host memory frames are uploaded to them
+    const Plane *m_draw_planes; // the planes to draw, m_planes or imported
+    int m_draw_count;
+    QVector<UploadSlot> m_slots;
+    int m_slot;
+    VkCommandPool m_cmd_pool;
+    VkSemaphore m_timeline;
+    quint64 m_timeline_value;
+    bool m_timeline_enabled;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR m_timeline_features; // chained to the device features
+#endif
+    bool m_dmabuf;
+    VkSampler m_sampler;
+    VkDescriptorSetLayout m_set_layout;
+    VkDescriptorPool m_desc_pool;
+    QVector<VkDescriptorSet> m_sets; // 1 per concurrent frame of the window
+    VkPipelineLayout m_pipeline_layout;
+    VkPipelineCache m_pipeline_cache;
+    VkPipeline m_pipelines[3]; // indexed by sampler count - 1
+    // 1.2 and extension entry points
+    PFN_vkWaitSemaphoresKHR m_vkWaitSemaphores;
+    PFN_vkGetMemoryFdPropertiesKHR m_vkGetMemoryFdProperties;
+};
+
+} //namespace QtAV
+#endif //QTAV_VULKANVIDEOMATERIAL_H
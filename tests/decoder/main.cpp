@@ -1,81 +1,346 @@
+/*
+ * decode only benchmark.
+ * decoder -f file [-vd FFmpeg,VAAPI:copyMode=OptimizedCopy] [-n frames] [-check] [-o result.json]
+ *   -vd: decoders to test, separated by ','. options of a decoder are after ':', separated by ';'. default is all registered decoders
+ *   -n: max frames to decode for each decoder. 0 (default): to the end of file
+ *   -check: copy every frame to host memory and compare with the first decoder. otherwise frame content is not touched
+ *   -o: write the result in json to a file instead of stdout
+ */
 #include <QCoreApplication>
 #include <QtDebug>
-#include <QtCore/QDateTime>
-#include <QtCore/QQueue>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
 #include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtCore/QtAlgorithms>
 #include <QtAV/AVDemuxer.h>
 #include <QtAV/VideoDecoder.h>
+#include <QtAV/VideoDecoderTypes.h>
+#include <QtAV/VideoFrame.h>
 #include <QtAV/Packet.h>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
 
 using namespace QtAV;
 
+// user + system time of all threads in us, including driver threads of hw decoders
+static qint64 processCpuTime()
+{
+#ifdef Q_OS_WIN
+    FILETIME c, e, k, u;
+    if (!GetProcessTimes(GetCurrentProcess(), &c, &e, &k, &u))
+        return 0;
+    ULARGE_INTEGER kt, ut;
+    kt.LowPart = k.dwLowDateTime;
+    kt.HighPart = k.dwHighDateTime;
+    ut.LowPart = u.dwLowDateTime;
+    ut.HighPart = u.dwHighDateTime;
+    return qint64(kt.QuadPart + ut.QuadPart)/10LL;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+    return qint64(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)*1000000LL + qint64(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+#endif
+}
+
+// values must be sorted
+static qreal percentile(const QVector<qreal>& values, qreal p)
+{
+    if (values.isEmpty())
+        return 0;
+    const int i = qBound(0, int(p*qreal(values.size() - 1) + 0.5), values.size() - 1);
+    return values[i];
+}
+
+static QString jsonString(const QString& s)
+{
+    QString r(s);
+    r.replace(QLatin1String("\\"), QLatin1String("\\\\"));
+    r.replace(QLatin1String("\""), QLatin1String("\\\""));
+    r.replace(QLatin1String("\n"), QLatin1String("\\n"));
+    return QStringLiteral("\"%1\"").arg(r);
+}
+
+static QString jsonNumber(qreal v)
+{
+    return QString::number(v, 'f', 3);
+}
+
+// ms values
+static QString jsonStats(QVector<qreal> values)
+{
+    if (values.isEmpty())
+        return QStringLiteral("null");
+    qSort(values);
+    qreal sum = 0;
+    foreach (qreal v, values) {
+        sum += v;
+    }
+    return QStringLiteral("{\"mean\": %1, \"p50\": %2, \"p90\": %3, \"p99\": %4, \"max\": %5}")
+            .arg(jsonNumber(sum/qreal(values.size())))
+            .arg(jsonNumber(percentile(values, 0.5)))
+            .arg(jsonNumber(percentile(values, 0.9)))
+            .arg(jsonNumber(percentile(values, 0.99)))
+            .arg(jsonNumber(values.last()));
+}
+
+static const QSize kThumbSize(64, 36);
+static const int kMaxCheckFrames = 2000;
+// mean absolute difference per color component. frames may be converted to rgb in different ways by decoders, so not bit exact
+static const qreal kMaxThumbDiff = 8.0;
+
+static qreal thumbDiff(const QByteArray& a, const QByteArray& b)
+{
+    if (a.size() != b.size() || a.isEmpty())
+        return 255.0;
+    const uchar *p = (const uchar*)a.constData();
+    const uchar *q = (const uchar*)b.constData();
+    qint64 sum = 0;
+    int n = 0;
+    for (int i = 0; i < a.size(); ++i) {
+        if (i % 4 == 3) // alpha
+            continue;
+        sum += qAbs(int(p[i]) - int(q[i]));
+        ++n;
+    }
+    return qreal(sum)/qreal(n);
+}
+
+static QByteArray thumbnail(const VideoFrame& frame)
+{
+    VideoFrame f(frame.to(VideoFormat::Format_RGB32, kThumbSize));
+    if (!f.isValid() || !f.constBits(0))
+        return QByteArray();
+    QByteArray data;
+    const int line = kThumbSize.width()*4;
+    for (int y = 0; y < f.height(); ++y) {
+        data.append((const char*)f.constBits(0) + y*f.bytesPerLine(0), line);
+    }
+    return data;
+}
+
+struct Result {
+    Result() : created(false), opened(false), width(0), height(0), frames(0), open_ms(0), wall_ms(0), cpu_ms(0), mismatches(0), max_diff(0) {}
+    QString name;
+    QString detail;
+    bool created;
+    bool opened;
+    int width, height;
+    int frames;
+    qreal open_ms;
+    qreal wall_ms;
+    qreal cpu_ms;
+    QVector<qreal> frame_ms;
+    QVector<qreal> copy_ms;
+    int mismatches;
+    qreal max_diff;
+    QVector<QByteArray> thumbs;
+};
+
+static bool decodeFile(const QString& file, const QString& name, const QVariantHash& opt, int maxFrames, bool check, Result *r)
+{
+    r->name = name;
+    VideoDecoder *dec = VideoDecoder::create(name);
+    if (!dec)
+        return false;
+    r->created = true;
+    AVDemuxer demux;
+    demux.setMedia(file);
+    if (!demux.load()) {
+        qWarning("Failed to load file: %s", file.toUtf8().constData());
+        delete dec;
+        return false;
+    }
+    if (!opt.isEmpty())
+        dec->setOptions(opt);
+    dec->setCodecContext(demux.videoCodecContext());
+    QElapsedTimer timer;
+    timer.start();
+    r->opened = dec->open();
+    r->open_ms = qreal(timer.nsecsElapsed())/1e6;
+    r->detail = dec->description();
+    if (!r->opened) {
+        delete dec;
+        return false;
+    }
+    const int vstream = demux.videoStream();
+    const qint64 cpu0 = processCpuTime();
+    timer.restart();
+    bool eof = false;
+    while (!eof && (maxFrames <= 0 || r->frames < maxFrames)) {
+        Packet pkt;
+        if (demux.atEnd() || !demux.readFrame()) {
+            if (!demux.atEnd())
+                continue;
+            pkt = Packet::createEOF(); // drain delayed frames
+            eof = true;
+        } else {
+            if (demux.stream() != vstream)
+                continue;
+            pkt = demux.packet();
+        }
+        do {
+            QElapsedTimer t;
+            t.start();
+            if (!dec->decode(pkt))
+                break;
+            // why is faster to call frame() for hwdec? no frame() is very slow for VDA
+            // copy mode decoders copy back to host memory here
+            const VideoFrame frame(dec->frame());
+            if (!frame.isValid())
+                break;
+            r->frame_ms.append(qreal(t.nsecsElapsed())/1e6);
+            if (r->frames++ == 0) {
+                r->width = frame.width();
+                r->height = frame.height();
+            }
+            if (check && r->frames <= kMaxCheckFrames) {
+                if (!frame.constBits(0)) { // zero copy surface
+                    t.restart();
+                    const VideoFrame host(frame.to(VideoFormat::Format_RGB32));
+                    if (host.isValid())
+                        r->copy_ms.append(qreal(t.nsecsElapsed())/1e6);
+                }
+                r->thumbs.append(thumbnail(frame));
+            }
+            if (!eof || (maxFrames > 0 && r->frames >= maxFrames))
+                break;
+        } while (true);
+    }
+    r->wall_ms = qreal(timer.nsecsElapsed())/1e6;
+    r->cpu_ms = qreal(processCpuTime() - cpu0)/1000.0;
+    dec->close();
+    delete dec;
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     QCoreApplication a(argc, argv);
+    const QStringList args(a.arguments());
     QString file = QString::fromLatin1("test.avi");
-    int idx = a.arguments().indexOf(QLatin1String("-f"));
-    if (idx > 0)
-        file = a.arguments().at(idx + 1);
-    QString decName = QString::fromLatin1("FFmpeg");
-    idx = a.arguments().indexOf(QLatin1String("-vc"));
+    int idx = args.indexOf(QLatin1String("-f"));
+    if (idx > 0 && idx + 1 < args.size())
+        file = args.at(idx + 1);
+    QStringList decs;
+    idx = args.indexOf(QLatin1String("-vc"));
     if (idx < 0)
-        idx = a.arguments().indexOf(QLatin1String("-vd"));
-    if (idx > 0)
-        decName = a.arguments().at(idx + 1);
+        idx = args.indexOf(QLatin1String("-vd"));
+    if (idx > 0 && idx + 1 < args.size())
+        decs = args.at(idx + 1).split(QLatin1Char(','), QString::SkipEmptyParts);
+    if (decs.isEmpty()) {
+        foreach (VideoDecoderId vid, GetRegistedVideoDecoderIds()) {
+            decs.append(QString::fromLatin1(VideoDecoderFactory::name(vid).c_str()));
+        }
+    }
+    int maxFrames = 0;
+    idx = args.indexOf(QLatin1String("-n"));
+    if (idx > 0 && idx + 1 < args.size())
+        maxFrames = args.at(idx + 1).toInt();
+    const bool check = args.contains(QLatin1String("-check"));
+    QString out;
+    idx = args.indexOf(QLatin1String("-o"));
+    if (idx > 0 && idx + 1 < args.size())
+        out = args.at(idx + 1);
 
-    QString opt;
-    QVariantHash decopt;
-    idx = decName.indexOf(QLatin1String(":"));
-    if (idx > 0) {
-        opt = decName.right(decName.size() - idx -1);
-        decName = decName.left(idx);
-        QStringList opts(opt.split(QString::fromLatin1(";")));
-        QVariantHash subopt;
-        foreach (QString o, opts) {
-            idx = o.indexOf(QLatin1String(":"));
-            subopt[o.left(idx)] = o.right(o.size() - idx - 1);
+    QString format;
+    qreal fps = 0;
+    {
+        AVDemuxer demux;
+        demux.setMedia(file);
+        if (!demux.load() || demux.videoStream() < 0) {
+            qWarning("Failed to load video of file: %s", file.toUtf8().constData());
+            return 1;
         }
-        decopt[decName] = subopt;
+        format = demux.formatName();
+        fps = demux.frameRate();
     }
-    qDebug() << decopt;
 
-    VideoDecoder *dec = VideoDecoder::create(decName);
-    if (!dec) {
-        fprintf(stderr, "Can not find decoder: %s\n", decName.toUtf8().constData());
-        return 1;
+    QList<Result> results;
+    foreach (const QString& d, decs) {
+        // name:opt1=value1;opt2=value2
+        QString name(d);
+        QVariantHash decopt;
+        idx = d.indexOf(QLatin1Char(':'));
+        if (idx > 0) {
+            name = d.left(idx);
+            const QStringList opts(d.mid(idx + 1).split(QLatin1Char(';'), QString::SkipEmptyParts));
+            foreach (const QString& o, opts) {
+                int i = o.indexOf(QLatin1Char('='));
+                if (i < 0)
+                    i = o.indexOf(QLatin1Char(':'));
+                decopt[o.left(i)] = o.mid(i + 1);
+            }
+            QVariantHash tmp;
+            tmp[name] = decopt;
+            decopt = tmp;
+        }
+        Result r;
+        fprintf(stderr, "decoding with %s...\n", name.toUtf8().constData());
+        decodeFile(file, name, decopt, maxFrames, check, &r);
+        results.append(r);
     }
-    if (!decopt.isEmpty())
-        dec->setOptions(decopt);
-    AVDemuxer demux;
-    demux.setMedia(file);
-    if (!demux.load()) {
-        qWarning("Failed to load file: %s", file.toUtf8().constData());
-        return 1;
+    // the 1st decoder decoded frames is the reference
+    if (check) {
+        int ref = -1;
+        for (int i = 0; i < results.size(); ++i) {
+            if (!results[i].thumbs.isEmpty()) {
+                ref = i;
+                break;
+            }
+        }
+        for (int i = ref + 1; ref >= 0 && i < results.size(); ++i) {
+            Result &r = results[i];
+            for (int j = 0; j < r.thumbs.size(); ++j) {
+                const qreal diff = j < results[ref].thumbs.size() ? thumbDiff(r.thumbs[j], results[ref].thumbs[j]) : 255.0;
+                r.max_diff = qMax(r.max_diff, diff);
+                if (diff > kMaxThumbDiff)
+                    r.mismatches++;
+            }
+        }
     }
 
-    dec->setCodecContext(demux.videoCodecContext());
-    dec->open();
-    int count = 0;
-    int vstream = demux.videoStream();
-    QQueue<qint64> t;
-    qint64 t0 = QDateTime::currentMSecsSinceEpoch();
-    while (!demux.atEnd()) {
-        if (!demux.readFrame())
-            continue;
-        if (demux.stream() != vstream)
-            continue;
-        const Packet pkt = demux.packet();
-        if (dec->decode(pkt)) {
-            VideoFrame frame = dec->frame(); // why is faster to call frame() for hwdec? no frame() is very slow for VDA
-            Q_UNUSED(frame);
-            count++;
-            const qint64 now = QDateTime::currentMSecsSinceEpoch();
-            const qint64 dt = now - t0;
-            t.enqueue(now);
-            printf("decode count: %d, elapsed: %lld, fps: %.1f/%.1f\r", count, dt, count*1000.0/dt, t.size()*1000.0/(now - t.first()));fflush(0);
-            if (t.size() > 10)
-                t.dequeue();
+    QStringList items;
+    foreach (const Result& r, results) {
+        QStringList kv;
+        kv << QStringLiteral("\"name\": %1").arg(jsonString(r.name))
+           << QStringLiteral("\"description\": %1").arg(jsonString(r.detail))
+           << QStringLiteral("\"available\": %1").arg(QLatin1String(r.created ? "true" : "false"))
+           << QStringLiteral("\"opened\": %1").arg(QLatin1String(r.opened ? "true" : "false"))
+           << QStringLiteral("\"open_ms\": %1").arg(jsonNumber(r.open_ms))
+           << QStringLiteral("\"width\": %1").arg(r.width)
+           << QStringLiteral("\"height\": %1").arg(r.height)
+           << QStringLiteral("\"frames\": %1").arg(r.frames)
+           << QStringLiteral("\"wall_ms\": %1").arg(jsonNumber(r.wall_ms))
+           << QStringLiteral("\"fps\": %1").arg(jsonNumber(r.wall_ms > 0 ? qreal(r.frames)*1000.0/r.wall_ms : 0))
+           << QStringLiteral("\"cpu_ms\": %1").arg(jsonNumber(r.cpu_ms))
+           << QStringLiteral("\"cpu_ms_per_frame\": %1").arg(jsonNumber(r.frames > 0 ? r.cpu_ms/qreal(r.frames) : 0))
+           << QStringLiteral("\"frame_ms\": %1").arg(jsonStats(r.frame_ms))
+           << QStringLiteral("\"copy_ms\": %1").arg(jsonStats(r.copy_ms));
+        if (check) {
+            kv << QStringLiteral("\"checked_frames\": %1").arg(r.thumbs.size())
+               << QStringLiteral("\"mismatch_frames\": %1").arg(r.mismatches)
+               << QStringLiteral("\"max_diff\": %1").arg(jsonNumber(r.max_diff));
         }
+        items << QStringLiteral("    {\n      %1\n    }").arg(kv.join(QStringLiteral(",\n      ")));
+    }
+    const QString json = QStringLiteral("{\n  \"file\": %1,\n  \"format\": %2,\n  \"frame_rate\": %3,\n  \"decoders\": [\n%4\n  ]\n}\n")
+            .arg(jsonString(file)).arg(jsonString(format)).arg(jsonNumber(fps))
+            .arg(items.join(QStringLiteral(",\n")));
+    if (out.isEmpty()) {
+        printf("%s", json.toUtf8().constData());
+        fflush(stdout);
+        return 0;
+    }
+    QFile f(out);
+    if (!f.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        qWarning("Failed to open output file: %s", out.toUtf8().constData());
+        return 1;
     }
+    f.write(json.toUtf8());
     return 0;
 }
@@ -0,0 +1,628 @@
+/******************************************************************************
+    microbench:  this file is part of QtAV examples
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ * Micro benchmarks of core primitives: packet queues under contention, memory and frame copies, pixel format conversions,
+ * audio resampling and volume scaling.
+ * A case runs in batches of about 2ms until -time msecs is spent. Time per item (a packet, a frame, a buffer) is the median of
+ * batches, min and p90 show the noise. Cases are selected by substrings of names with -filter.
+ * microbench [-filter queue,copy] [-time 200] [-list] [-o result.json]
+ */
+#include <QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <QtCore/QtAlgorithms>
+#include <QtAV>
+#include <QtAV/AudioResampler.h>
+#include <QtAV/AudioResamplerTypes.h>
+#include <string.h>
+// private headers. classes are exported by Q_AV_PRIVATE_EXPORT
+#include "PacketBuffer.h"
+#include "ImageConverter.h"
+#include "utils/BlockingQueue.h"
+#include "utils/GPUMemCopy.h"
+#include "utils/ring.h"
+#include "utils/SPSCQueue.h"
+
+using namespace QtAV;
+
+namespace QtAV {
+// AudioOutput.cpp
+typedef void (*scale_samples_func)(quint8 *dst, const quint8 *src, int nb_samples, int volume, float volumef);
+Q_AV_PRIVATE_EXPORT scale_samples_func get_scaler(AudioFormat::SampleFormat fmt, qreal vol, int* voli);
+} //namespace QtAV
+
+static const qint64 kBatchNs = 2000000LL;
+
+class Bench
+{
+public:
+    Bench(const QString& name, int items = 1, qint64 bytesPerItem = 0) : m_name(name), m_items(items), m_bytes(bytesPerItem) {}
+    virtual ~Bench() {}
+    QString name() const { return m_name;}
+    // items processed by a run(), e.g. packets transfered
+    int items() const { return m_items;}
+    // bytes processed per item for throughput. 0: not reported
+    qint64 bytesPerItem() const { return m_bytes;}
+    // false if the case is not available, e.g. not supported by the cpu or not built in
+    virtual bool init() { return true;}
+    virtual void run() = 0;
+protected:
+    QString m_name;
+    int m_items;
+    qint64 m_bytes;
+};
+
+struct Result {
+    Result() : available(false), runs(0), min_ns(0), median_ns(0), p90_ns(0) {}
+    QString name;
+    bool available;
+    qint64 runs;
+    qreal min_ns, median_ns, p90_ns; // per item
+    qint64 bytes;
+};
+
+static Result measure(Bench *b, int ms)
+{
+    Result r;
+    r.name = b->name();
+    r.bytes = b->bytesPerItem();
+    if (!b->init())
+        return r;
+    r.available = true;
+    // warm up caches, pools and lazy initializations, and find a batch size
+    int n = 1;
+    QElapsedTimer t;
+    forever {
+        t.start();
+        for (int i = 0; i < n; ++i)
+            b->run();
+        if (t.nsecsElapsed() >= kBatchNs || n >= (1 << 20))
+            break;
+        n *= 2;
+    }
+    QVector<qreal> ns;
+    QElapsedTimer total;
+    total.start();
+    while (total.elapsed() < ms || ns.size() < 5) {
+        t.start();
+        for (int i = 0; i < n; ++i)
+            b->run();
+        ns.append(qreal(t.nsecsElapsed())/qreal(n*b->items()));
+        r.runs += n;
+    }
+    qSort(ns);
+    r.min_ns = ns.first();
+    r.median_ns = ns.at(ns.size()/2);
+    r.p90_ns = ns.at(qMin(ns.size() - 1, int(qreal(ns.size())*0.9)));
+    return r;
+}
+
+static void fill(void* data, size_t size)
+{
+    uchar *p = (uchar*)data;
+    for (size_t i = 0; i < size; ++i)
+        p[i] = uchar(i*7 + (i >> 8));
+}
+
+static QString sizeName(qint64 bytes)
+{
+    if (bytes >= 1024*1024)
+        return QStringLiteral("%1M").arg(bytes/(1024*1024));
+    if (bytes >= 1024)
+        return QStringLiteral("%1K").arg(bytes/1024);
+    return QString::number(bytes);
+}
+
+/// queues
+
+template<class Q>
+class Producer : public QThread
+{
+public:
+    Producer(Q *q, int count) : m_q(q), m_count(count) {
+        m_pkt.data = QByteArray(4096, 0);
+        m_pkt.pts = 0;
+    }
+    void run() Q_DECL_OVERRIDE {
+        for (int i = 0; i < m_count; ++i) {
+            m_pkt.pts = qreal(i)*0.04;
+            m_q->put(m_pkt);
+        }
+    }
+private:
+    Q *m_q;
+    int m_count;
+    Packet m_pkt;
+};
+
+// 1 producer thread, the consumer is the calling thread. no work between put and take, so it's the worst contention
+template<class Q>
+class QueueBench : public Bench
+{
+public:
+    QueueBench(const QString& name, int count = 10000) : Bench(QStringLiteral("queue/%1").arg(name), count) {}
+    bool init() Q_DECL_OVERRIDE {
+        m_q.setCapacity(48);
+        m_q.setThreshold(32);
+        return true;
+    }
+    void run() Q_DECL_OVERRIDE {
+        Producer<Q> producer(&m_q, items());
+        producer.start();
+        int taken = 0;
+        while (taken < items()) {
+            if (m_q.take().isValid())
+                ++taken;
+        }
+        producer.wait();
+    }
+protected:
+    Q m_q;
+};
+
+class PacketBufferBench : public QueueBench<PacketBuffer>
+{
+public:
+    PacketBufferBench() : QueueBench<PacketBuffer>(QStringLiteral("PacketBuffer")) {}
+    bool init() Q_DECL_OVERRIDE {
+        m_q.setBufferMode(BufferPackets);
+        m_q.setBufferValue(32);
+        m_q.setBufferMax(1.5);
+        return true;
+    }
+};
+
+/// copies
+
+class MemcpyBench : public Bench
+{
+public:
+    MemcpyBench(qint64 size, bool gpu)
+        : Bench(QStringLiteral("copy/%1/%2").arg(QLatin1String(gpu ? "gpu_memcpy" : "memcpy")).arg(sizeName(size)), 1, size)
+        , m_gpu(gpu)
+        , m_src(size, 0)
+        , m_dst(size, 0)
+    {}
+    bool init() Q_DECL_OVERRIDE {
+        if (m_gpu && !GPUMemCopy::isAvailable())
+            return false;
+        fill(m_src.data(), m_src.size());
+        return true;
+    }
+    void run() Q_DECL_OVERRIDE {
+        if (m_gpu)
+            gpu_memcpy(m_dst.data(), m_src.constData(), m_src.size());
+        else
+            memcpy(m_dst.data(), m_src.constData(), m_src.size());
+    }
+private:
+    bool m_gpu;
+    QByteArray m_src, m_dst;
+};
+
+// a luma plane. buffers are 64 bytes aligned like gpu surfaces
+class CopyFrameBench : public Bench
+{
+public:
+    CopyFrameBench(int width, int height)
+        : Bench(QStringLiteral("copy/GPUMemCopy::copyFrame/%1x%2").arg(width).arg(height), 1, qint64(width)*qint64(height))
+        , m_width(width)
+        , m_height(height)
+        , m_pitch((width + 63) & ~63)
+        , m_src(0)
+        , m_dst(0)
+    {}
+    ~CopyFrameBench() {
+        qFreeAligned(m_src);
+        qFreeAligned(m_dst);
+    }
+    bool init() Q_DECL_OVERRIDE {
+        if (!GPUMemCopy::isAvailable() || !m_copy.initCache(m_width))
+            return false;
+        m_src = qMallocAligned(m_pitch*m_height, 64);
+        m_dst = qMallocAligned(m_pitch*m_height, 64);
+        if (!m_src || !m_dst)
+            return false;
+        fill(m_src, m_pitch*m_height);
+        return true;
+    }
+    void run() Q_DECL_OVERRIDE {
+        m_copy.copyFrame(m_src, m_dst, m_width, m_height, m_pitch);
+    }
+private:
+    int m_width, m_height, m_pitch;
+    void *m_src, *m_dst;
+    GPUMemCopy m_copy;
+};
+
+/// video frames and conversions
+
+static VideoFrame makeFrame(VideoFormat::PixelFormat fmt, const QSize& size)
+{
+    VideoFrame f(size.width(), size.height(), VideoFormat(fmt));
+    f.allocate();
+    for (int i = 0; i < f.planeCount(); ++i)
+        fill(f.bits(i), f.bytesPerLine(i)*f.planeHeight(i));
+    return f;
+}
+
+static QString frameName(VideoFormat::PixelFormat fmt, const QSize& size)
+{
+    return QStringLiteral("%1 %2x%3").arg(VideoFormat(fmt).name()).arg(size.width()).arg(size.height());
+}
+
+static qint64 frameBytes(VideoFormat::PixelFormat fmt, const QSize& size)
+{
+    return qint64(VideoFormat(fmt).bitsPerPixel())*qint64(size.width()*size.height())/8LL;
+}
+
+class CloneBench : public Bench
+{
+public:
+    CloneBench(VideoFormat::PixelFormat fmt, const QSize& size)
+        : Bench(QStringLiteral("frame/clone/%1").arg(frameName(fmt, size)), 1, frameBytes(fmt, size))
+        , m_fmt(fmt), m_size(size)
+    {}
+    bool init() Q_DECL_OVERRIDE {
+        m_frame = makeFrame(m_fmt, m_size);
+        return m_frame.isValid();
+    }
+    void run() Q_DECL_OVERRIDE {
+        // the result is released at once, so frame buffer pool is hit from the 2nd run
+        m_frame.clone();
+    }
+private:
+    VideoFormat::PixelFormat m_fmt;
+    QSize m_size;
+    VideoFrame m_frame;
+};
+
+class FrameToBench : public Bench
+{
+public:
+    FrameToBench(VideoFormat::PixelFormat fmt, const QSize& size, VideoFormat::PixelFormat outFmt, const QSize& outSize = QSize())
+        : Bench(QStringLiteral("frame/to/%1 => %2").arg(frameName(fmt, size)).arg(frameName(outFmt, outSize.isValid() ? outSize : size))
+                , 1, frameBytes(fmt, size))
+        , m_fmt(fmt), m_out_fmt(outFmt), m_size(size), m_out_size(outSize)
+    {}
+    bool init() Q_DECL_OVERRIDE {
+        m_frame = makeFrame(m_fmt, m_size);
+        return m_frame.to(m_out_fmt, m_out_size).isValid();
+    }
+    void run() Q_DECL_OVERRIDE {
+        m_frame.to(m_out_fmt, m_out_size);
+    }
+private:
+    VideoFormat::PixelFormat m_fmt, m_out_fmt;
+    QSize m_size, m_out_size;
+    VideoFrame m_frame;
+};
+
+class ImageConverterBench : public Bench
+{
+public:
+    ImageConverterBench(const char* name, VideoFormat::PixelFormat fmt, VideoFormat::PixelFormat outFmt, const QSize& size, int threads = 0)
+        : Bench(QStringLiteral("convert/%1%2/%3 => %4").arg(QLatin1String(name))
+                .arg(threads > 0 ? QStringLiteral(" threads=%1").arg(threads) : QString())
+                .arg(frameName(fmt, size)).arg(VideoFormat(outFmt).name()), 1, frameBytes(fmt, size))
+        , m_conv(0), m_threads(threads), m_name(name), m_fmt(fmt), m_out_fmt(outFmt), m_size(size)
+    {}
+    ~ImageConverterBench() { delete m_conv;}
+    bool init() Q_DECL_OVERRIDE {
+        m_conv = ImageConverterFactory::create(ImageConverterFactory::id(m_name));
+        if (!m_conv)
+            return false;
+        if (m_threads > 0 && ImageConverterFactory::id(m_name) == ImageConverterFactory::id("FFmpeg"))
+            static_cast<ImageConverterFF*>(m_conv)->setThreads(m_threads);
+        m_frame = makeFrame(m_fmt, m_size);
+        m_conv->setInFormat(m_fmt);
+        m_conv->setInSize(m_size.width(), m_size.height());
+        m_conv->setOutFormat(m_out_fmt);
+        m_conv->setOutSize(m_size.width(), m_size.height());
+        for (int i = 0; i < m_frame.planeCount(); ++i) {
+            m_planes.append(m_frame.constBits(i));
+            m_strides.append(m_frame.bytesPerLine(i));
+        }
+        return m_conv->check() && m_conv->convert(m_planes.constData(), m_strides.constData());
+    }
+    void run() Q_DECL_OVERRIDE {
+        m_conv->convert(m_planes.constData(), m_strides.constData());
+    }
+private:
+    ImageConverter *m_conv;
+    int m_threads;
+    std::string m_name;
+    VideoFormat::PixelFormat m_fmt, m_out_fmt;
+    QSize m_size;
+    VideoFrame m_frame;
+    QVector<const quint8*> m_planes;
+    QVector<int> m_strides;
+};
+
+/// audio
+
+static const int kAudioSamples = 1024; // per channel, a typical decoded frame
+
+class ResamplerBench : public Bench
+{
+public:
+    ResamplerBench(AudioFormat::SampleFormat fmt, int rate, AudioFormat::SampleFormat outFmt, int outRate)
+        : Bench(QString(), kAudioSamples, 0)
+        , m_conv(0)
+    {
+        m_in.setSampleFormat(fmt);
+        m_in.setSampleRate(rate);
+        m_in.setChannels(2);
+        m_out.setSampleFormat(outFmt);
+        m_out.setSampleRate(outRate);
+        m_out.setChannels(2);
+        m_name = QStringLiteral("audio/AudioResampler::convert/%1 %2Hz => %3 %4Hz")
+                .arg(m_in.sampleFormatName()).arg(rate).arg(m_out.sampleFormatName()).arg(outRate);
+        m_bytes = m_in.bytesPerSample()*m_in.channels(); // input bytes of a sample of all channels
+    }
+    ~ResamplerBench() { delete m_conv;}
+    bool init() Q_DECL_OVERRIDE {
+        m_conv = AudioResamplerFactory::create(AudioResamplerId_FF);
+        if (!m_conv)
+            m_conv = AudioResamplerFactory::create(AudioResamplerId_Libav);
+        if (!m_conv)
+            return false;
+        m_conv->setInAudioFormat(m_in);
+        m_conv->setOutAudioFormat(m_out);
+        m_conv->setInSampesPerChannel(kAudioSamples);
+        m_data = QByteArray(kAudioSamples*m_in.bytesPerSample()*m_in.channels(), 0);
+        fill(m_data.data(), m_data.size());
+        m_planes = (const quint8*)m_data.constData();
+        return m_conv->convert(&m_planes);
+    }
+    void run() Q_DECL_OVERRIDE {
+        m_conv->convert(&m_planes);
+    }
+private:
+    AudioResampler *m_conv;
+    AudioFormat m_in, m_out;
+    QByteArray m_data;
+    const quint8 *m_planes; // packed formats only
+};
+
+class VolumeBench : public Bench
+{
+public:
+    VolumeBench(const char* name, AudioFormat::SampleFormat fmt, int bytesPerSample, qreal volume)
+        : Bench(QStringLiteral("audio/volume/%1 x%2").arg(QLatin1String(name)).arg(volume), 4096, bytesPerSample)
+        , m_fmt(fmt), m_volume(volume), m_volume_i(0), m_scale(0)
+    {}
+    bool init() Q_DECL_OVERRIDE {
+        m_scale = get_scaler(m_fmt, m_volume, &m_volume_i);
+        if (!m_scale)
+            return false;
+        m_data = QByteArray(items()*bytesPerItem(), 0);
+        // small values so that float samples are not nan/denormal
+        for (int i = 0; i < m_data.size(); ++i)
+            m_data[i] = char(i & 0x3f);
+        return true;
+    }
+    void run() Q_DECL_OVERRIDE {
+        // in place as AudioOutput does. the volume is < 1, so values never overflow
+        quint8 *dst = (quint8*)m_data.data();
+        m_scale(dst, dst, items(), m_volume_i, float(m_volume));
+    }
+private:
+    AudioFormat::SampleFormat m_fmt;
+    qreal m_volume;
+    int m_volume_i;
+    scale_samples_func m_scale;
+    QByteArray m_data;
+};
+
+/// video format
+
+// construct formats as frames and converters do for each picture
+class FormatCtorBench : public Bench
+{
+public:
+    FormatCtorBench(bool ffmpeg)
+        : Bench(QStringLiteral("format/VideoFormat(%1)").arg(ffmpeg ? QStringLiteral("AVPixelFormat") : QStringLiteral("PixelFormat")), 4)
+        , m_ffmpeg(ffmpeg)
+    {}
+    bool init() Q_DECL_OVERRIDE {
+        static const VideoFormat::PixelFormat fmts[] = {
+            VideoFormat::Format_YUV420P, VideoFormat::Format_NV12, VideoFormat::Format_RGB32, VideoFormat::Format_YUV420P10LE
+        };
+        for (int i = 0; i < items(); ++i) {
+            m_fmts[i] = fmts[i];
+            m_ff_fmts[i] = VideoFormat::pixelFormatToFFmpeg(fmts[i]);
+        }
+        return true;
+    }
+    void run() Q_DECL_OVERRIDE {
+        for (int i = 0; i < items(); ++i) {
+            if (m_ffmpeg)
+                m_sink = VideoFormat(m_ff_fmts[i]).planeCount();
+            else
+                m_sink = VideoFormat(m_fmts[i]).planeCount();
+        }
+    }
+private:
+    bool m_ffmpeg;
+    VideoFormat::PixelFormat m_fmts[4];
+    int m_ff_fmts[4];
+    volatile int m_sink;
+};
+
+// queries used per frame by copy, upload and convert
+class FormatQueryBench : public Bench
+{
+public:
+    FormatQueryBench(VideoFormat::PixelFormat fmt)
+        : Bench(QStringLiteral("format/query/%1").arg(VideoFormat(fmt).name()))
+        , m_fmt(fmt)
+    {}
+    bool init() Q_DECL_OVERRIDE { return m_fmt.isValid();}
+    void run() Q_DECL_OVERRIDE {
+        int v = 0;
+        for (int i = 0; i < m_fmt.planeCount(); ++i) {
+            v += m_fmt.bytesPerLine(1920, i);
+            v += m_fmt.chromaHeight(1080);
+            v += m_fmt.bitsPerPixel(i);
+            v += m_fmt.channels(i);
+        }
+        m_sink = v;
+    }
+private:
+    VideoFormat m_fmt;
+    volatile int m_sink;
+};
+
+static QList<Bench*> createBenchmarks()
+{
+    QList<Bench*> benchs;
+    benchs << new QueueBench<BlockingQueue<Packet, RingQueue> >(QStringLiteral("BlockingQueue"))
+           << new QueueBench<SPSCBlockingQueue<Packet> >(QStringLiteral("SPSCBlockingQueue"))
+           << new PacketBufferBench();
+    static const qint64 sizes[] = { 4096, 64*1024, 1024*1024, 8*1024*1024 };
+    for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); ++i) {
+        benchs << new MemcpyBench(sizes[i], false) << new MemcpyBench(sizes[i], true);
+    }
+    static const QSize frames[] = { QSize(1280, 720), QSize(1920, 1080), QSize(3840, 2160) };
+    for (size_t i = 0; i < sizeof(frames)/sizeof(frames[0]); ++i) {
+        benchs << new CopyFrameBench(frames[i].width(), frames[i].height());
+    }
+    for (size_t i = 0; i < sizeof(frames)/sizeof(frames[0]); ++i) {
+        benchs << new CloneBench(VideoFormat::Format_YUV420P, frames[i]);
+    }
+    const QSize hd(1920, 1080);
+    benchs << new FrameToBench(VideoFormat::Format_YUV420P, hd, VideoFormat::Format_RGB32)
+           << new FrameToBench(VideoFormat::Format_NV12, hd, VideoFormat::Format_YUV420P)
+           << new FrameToBench(VideoFormat::Format_YUV420P, hd, VideoFormat::Format_YUV420P, QSize(1280, 720))
+           << new FrameToBench(VideoFormat::Format_YUV420P, QSize(3840, 2160), VideoFormat::Format_RGB32, hd);
+    static const char* const converters[] = { "FFmpeg", "IPP" };
+    for (size_t i = 0; i < sizeof(converters)/sizeof(converters[0]); ++i) {
+        benchs << new ImageConverterBench(converters[i], VideoFormat::Format_YUV420P, VideoFormat::Format_RGB32, hd)
+               << new ImageConverterBench(converters[i], VideoFormat::Format_NV12, VideoFormat::Format_RGB32, hd)
+               << new ImageConverterBench(converters[i], VideoFormat::Format_YUV420P, VideoFormat::Format_RGB32, QSize(3840, 2160));
+    }
+    benchs << new ImageConverterBench("FFmpeg", VideoFormat::Format_YUV420P, VideoFormat::Format_RGB32, QSize(3840, 2160), 1);
+    benchs << new FormatCtorBench(false) << new FormatCtorBench(true)
+           << new FormatQueryBench(VideoFormat::Format_YUV420P)
+           << new FormatQueryBench(VideoFormat::Format_NV12)
+           << new FormatQueryBench(VideoFormat::Format_RGB32);
+    benchs << new ResamplerBench(AudioFormat::SampleFormat_Signed16, 44100, AudioFormat::SampleFormat_Signed16, 48000)
+           << new ResamplerBench(AudioFormat::SampleFormat_Signed16, 48000, AudioFormat::SampleFormat_Float, 48000)
+           << new ResamplerBench(AudioFormat::SampleFormat_Float, 44100, AudioFormat::SampleFormat_Float, 48000);
+    benchs << new VolumeBench("u8", AudioFormat::SampleFormat_Unsigned8, 1, 0.5)
+           << new VolumeBench("s16", AudioFormat::SampleFormat_Signed16, 2, 0.5)
+           << new VolumeBench("s32", AudioFormat::SampleFormat_Signed32, 4, 0.5)
+           << new VolumeBench("float", AudioFormat::SampleFormat_Float, 4, 0.5)
+           << new VolumeBench("double", AudioFormat::SampleFormat_Double, 8, 0.5);
+    return benchs;
+}
+
+static QString jsonString(const QString& s)
+{
+    QString r(s);
+    r.replace(QLatin1String("\\"), QLatin1String("\\\\"));
+    r.replace(QLatin1String("\""), QLatin1String("\\\""));
+    r.replace(QLatin1String("\n"), QLatin1String("\\n"));
+    return QStringLiteral("\"%1\"").arg(r);
+}
+
+static QString jsonNumber(qreal v)
+{
+    return QString::number(v, 'f', 3);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    const QStringList args(a.arguments());
+    QStringList filters;
+    int idx = args.indexOf(QLatin1String("-filter"));
+    if (idx > 0 && idx + 1 < args.size())
+        filters = args.at(idx + 1).split(QLatin1Char(','), QString::SkipEmptyParts);
+    int ms = 200;
+    idx = args.indexOf(QLatin1String("-time"));
+    if (idx > 0 && idx + 1 < args.size())
+        ms = args.at(idx + 1).toInt();
+    QString out;
+    idx = args.indexOf(QLatin1String("-o"));
+    if (idx > 0 && idx + 1 < args.size())
+        out = args.at(idx + 1);
+    const bool list = args.contains(QLatin1String("-list"));
+
+    QList<Bench*> benchs(createBenchmarks());
+    QStringList items;
+    foreach (Bench *b, benchs) {
+        bool selected = filters.isEmpty();
+        foreach (const QString& f, filters) {
+            if (b->name().contains(f, Qt::CaseInsensitive)) {
+                selected = true;
+                break;
+            }
+        }
+        if (!selected)
+            continue;
+        if (list) {
+            printf("%s\n", b->name().toUtf8().constData());
+            continue;
+        }
+        const Result r(measure(b, ms));
+        if (!r.available)
+            fprintf(stderr, "%-60s not available\n", r.name.toUtf8().constData());
+        else if (r.bytes > 0)
+            fprintf(stderr, "%-60s %12.1f ns %10.1f MB/s\n", r.name.toUtf8().constData(), r.median_ns, qreal(r.bytes)*1e3/r.median_ns);
+        else
+            fprintf(stderr, "%-60s %12.1f ns\n", r.name.toUtf8().constData(), r.median_ns);
+        QStringList kv;
+        kv << QStringLiteral("\"name\": %1").arg(jsonString(r.name))
+           << QStringLiteral("\"available\": %1").arg(QLatin1String(r.available ? "true" : "false"));
+        if (r.available) {
+            kv << QStringLiteral("\"runs\": %1").arg(r.runs)
+               << QStringLiteral("\"items_per_run\": %1").arg(b->items())
+               << QStringLiteral("\"min_ns\": %1").arg(jsonNumber(r.min_ns))
+               << QStringLiteral("\"median_ns\": %1").arg(jsonNumber(r.median_ns))
+               << QStringLiteral("\"p90_ns\": %1").arg(jsonNumber(r.p90_ns));
+            if (r.bytes > 0)
+                kv << QStringLiteral("\"mb_per_s\": %1").arg(jsonNumber(qreal(r.bytes)*1e3/r.median_ns));
+        }
+        items << QStringLiteral("    {%1}").arg(kv.join(QStringLiteral(", ")));
+    }
+    qDeleteAll(benchs);
+    if (list)
+        return 0;
+    const QString json = QStringLiteral("{\n  \"version\": %1,\n  \"time_ms\": %2,\n  \"results\": [\n%3\n  ]\n}\n")
+            .arg(jsonString(QtAV_Version_String())).arg(ms).arg(items.join(QStringLiteral(",\n")));
+    if (out.isEmpty()) {
+        printf("%s", json.toUtf8().constData());
+        fflush(stdout);
+        return 0;
+    }
+    QFile f(out);
+    if (!f.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        qWarning("Failed to open output file: %s", out.toUtf8().constData());
+        return 1;
+    }
+    f.write(json.toUtf8());
+    return 0;
+}
@@ -0,0 +1,11 @@
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = microbench
+
+PROJECTROOT = $$PWD/../..
+include($$PROJECTROOT/src/libQtAV.pri)
+preparePaths($$OUT_PWD/../../out)
+# PacketBuffer layout depends on it. must be the same as libQtAV.pro
+!no_spsc_queue: DEFINES += QTAV_HAVE_SPSC_QUEUE=1
+
+SOURCES += main.cpp
@@ -0,0 +1,550 @@
+/******************************************************************************
+    playback:  this file is part of QtAV examples
+    Copyright (C) 2025 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ * End to end playback benchmark
+ * Every file of the corpus is played headless by AVPlayer with the null audio output and a null video renderer which accepts
+ * any pixel format and never touches frame data. For each file:
+ *  - time to first frame: from play() to the first frame received by the renderer
+ *  - playback of -t seconds in real time: rendered, dropped and late frames counted by Statistics, cpu usage
+ *  - -seeks seeks to fixed positions: latency from seek() to the first frame received by the renderer after seek finished
+ * Synthetic clips can be generated with -synthetic WxH@fps:seconds, encoded as mpeg4 in matroska to the temp dir.
+ * The results are written as JSON to stdout, or to a file with -o. With -baseline, the results are compared with a previous
+ * result file (Qt5 only), regressions are printed to stderr and the exit code is 2 if there is any.
+ * playback -i file1[,file2...] [-synthetic 1280x720@30:10] [-t 10] [-seeks 10] [-key] [-speed 1] [-vd FFmpeg,VAAPI] [-o result.json] [-baseline old.json [-tolerance 10]]
+ */
+#include <QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+#include <QtCore/QtAlgorithms>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#endif
+#include <QtAV>
+#include <QtAV/AVMuxer.h>
+#include <QtAV/VideoDecoderTypes.h>
+#include <QtAV/VideoEncoder.h>
+#include <QtAV/VideoRenderer.h>
+#include <math.h>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace QtAV;
+
+static const int kFrameTimeout = 5000; // ms
+static const int kSeekSettle = 500; // ms of playback after a seek before the next one
+// not a registered renderer. AVPlayer only uses the id for printing
+static const VideoRendererId kNullRendererId = 0x4e756c6c; // "Null"
+
+// user + system time of all threads in us
+static qint64 processCpuTime()
+{
+#ifdef Q_OS_WIN
+    FILETIME c, e, k, u;
+    if (!GetProcessTimes(GetCurrentProcess(), &c, &e, &k, &u))
+        return 0;
+    ULARGE_INTEGER kt, ut;
+    kt.LowPart = k.dwLowDateTime;
+    kt.HighPart = k.dwHighDateTime;
+    ut.LowPart = u.dwLowDateTime;
+    ut.HighPart = u.dwHighDateTime;
+    return qint64(kt.QuadPart + ut.QuadPart)/10LL;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+    return qint64(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)*1000000LL + qint64(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+#endif
+}
+
+// peak resident set size of the process in KB. it never decreases, so the value of a run includes previous runs
+static qint64 peakRss()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+    return qint64(pmc.PeakWorkingSetSize)/1024LL;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+#ifdef Q_OS_MAC
+    return qint64(ru.ru_maxrss)/1024LL; // bytes
+#else
+    return qint64(ru.ru_maxrss);
+#endif
+#endif
+}
+
+// current resident set size in KB. 0 if unknown
+static qint64 currentRss()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+    return qint64(pmc.WorkingSetSize)/1024LL;
+#elif defined(Q_OS_LINUX)
+    QFile f(QStringLiteral("/proc/self/status"));
+    if (!f.open(QIODevice::ReadOnly))
+        return 0;
+    foreach (const QByteArray& line, f.readAll().split('\n')) {
+        if (line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+    }
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+// values must be sorted
+static qreal percentile(const QVector<qreal>& values, qreal p)
+{
+    if (values.isEmpty())
+        return 0;
+    const int i = qBound(0, int(p*qreal(values.size() - 1) + 0.5), values.size() - 1);
+    return values[i];
+}
+
+static QString jsonString(const QString& s)
+{
+    QString r(s);
+    r.replace(QLatin1String("\\"), QLatin1String("\\\\"));
+    r.replace(QLatin1String("\""), QLatin1String("\\\""));
+    r.replace(QLatin1String("\n"), QLatin1String("\\n"));
+    return QStringLiteral("\"%1\"").arg(r);
+}
+
+static QString jsonNumber(qreal v)
+{
+    return QString::number(v, 'f', 3);
+}
+
+// ms values
+static QString jsonStats(QVector<qreal> values)
+{
+    if (values.isEmpty())
+        return QStringLiteral("null");
+    qSort(values);
+    qreal sum = 0;
+    foreach (qreal v, values) {
+        sum += v;
+    }
+    return QStringLiteral("{\"mean\": %1, \"p50\": %2, \"p90\": %3, \"p99\": %4, \"max\": %5}")
+            .arg(jsonNumber(sum/qreal(values.size())))
+            .arg(jsonNumber(percentile(values, 0.5)))
+            .arg(jsonNumber(percentile(values, 0.9)))
+            .arg(jsonNumber(percentile(values, 0.99)))
+            .arg(jsonNumber(values.last()));
+}
+
+static QStringList listArg(const QStringList& args, const QString& key, const QString& def)
+{
+    const int idx = args.indexOf(key);
+    if (idx > 0 && idx + 1 < args.size())
+        return args.at(idx + 1).split(QLatin1Char(','), QString::SkipEmptyParts);
+    return def.split(QLatin1Char(','), QString::SkipEmptyParts);
+}
+
+static QString stringArg(const QStringList& args, const QString& key, const QString& def = QString())
+{
+    const int idx = args.indexOf(key);
+    if (idx > 0 && idx + 1 < args.size())
+        return args.at(idx + 1);
+    return def;
+}
+
+/*!
+ * Accepts any pixel format so that frames are never converted, and does not touch frame data. Records the arrival time of the
+ * first frame after arm() and emits frameArrived() for it.
+ */
+class NullRenderer : public QObject, public VideoRenderer
+{
+    Q_OBJECT
+public:
+    NullRenderer(const QElapsedTimer *clock) : QObject(0), m_clock(clock), m_armed(false), m_arrived(-1) {}
+    VideoRendererId id() const Q_DECL_OVERRIDE { return kNullRendererId;}
+    bool isSupported(VideoFormat::PixelFormat) const Q_DECL_OVERRIDE { return true;}
+    // ns of m_clock. -1 if no frame is received after arm()
+    qint64 arrivedTime() const {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        return m_arrived;
+    }
+public Q_SLOTS:
+    void arm() {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_armed = true;
+        m_arrived = -1;
+    }
+Q_SIGNALS:
+    void frameArrived();
+protected:
+    bool receiveFrame(const VideoFrame&) Q_DECL_OVERRIDE {
+        {
+            QMutexLocker lock(&m_mutex);
+            Q_UNUSED(lock);
+            if (!m_armed)
+                return true;
+            m_armed = false;
+            m_arrived = m_clock->nsecsElapsed();
+        }
+        Q_EMIT frameArrived();
+        return true;
+    }
+    void drawFrame() Q_DECL_OVERRIDE {}
+private:
+    const QElapsedTimer *m_clock;
+    mutable QMutex m_mutex;
+    bool m_armed;
+    qint64 m_arrived;
+};
+
+// return false if timeout
+static bool waitSignal(QObject *sender, const char* signal, int ms)
+{
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    QObject::connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
+    QObject::connect(sender, signal, &loop, SLOT(quit()));
+    timer.start(ms);
+    loop.exec();
+    return timer.isActive();
+}
+
+struct Config {
+    QString file;
+    QVector<VideoDecoderId> decoders;
+    qreal duration; // seconds of playback before seeks
+    int seeks;
+    bool key_seek;
+    qreal speed;
+};
+
+struct Result {
+    Result() : ok(false), media_duration_ms(0), width(0), height(0), ttff_ms(-1), play_ms(0), cpu_ms(0)
+      , seek_timeouts(0), peak_rss_kb(0), rss_kb(0) {}
+    bool ok;
+    qint64 media_duration_ms;
+    int width, height;
+    qreal ttff_ms;
+    qreal play_ms;
+    qreal cpu_ms;
+    Statistics::Snapshot counters; // of the playback only
+    QVector<qreal> seek_ms;
+    int seek_timeouts;
+    qint64 peak_rss_kb;
+    qint64 rss_kb;
+};
+
+static bool runPlayback(const Config& c, Result *r)
+{
+    QElapsedTimer clock;
+    clock.start();
+    NullRenderer renderer(&clock);
+    AVPlayer player;
+    player.audio()->setBackends(QStringList() << QStringLiteral("null"));
+    if (!c.decoders.isEmpty())
+        player.setPriority(c.decoders);
+    player.setSeekType(c.key_seek ? KeyFrameSeek : AccurateSeek);
+    player.setSpeed(c.speed);
+    player.setRenderer(&renderer);
+    player.setFile(c.file);
+    // the 1st frame after a seek is rendered after seek finished
+    QObject::connect(&player, SIGNAL(seekFinished()), &renderer, SLOT(arm()), Qt::DirectConnection);
+
+    renderer.arm();
+    qint64 t0 = clock.nsecsElapsed();
+    player.play();
+    if (!waitSignal(&renderer, SIGNAL(frameArrived()), kFrameTimeout)) {
+        qWarning("no frame in %d ms: %s", kFrameTimeout, c.file.toUtf8().constData());
+        player.stop();
+        return false;
+    }
+    r->ttff_ms = qreal(renderer.arrivedTime() - t0)/1e6;
+    r->media_duration_ms = player.duration();
+    r->width = player.statistics().video_only.width;
+    r->height = player.statistics().video_only.height;
+
+    const Statistics::Snapshot s0(player.statistics().snapshot());
+    const qint64 cpu0 = processCpuTime();
+    t0 = clock.nsecsElapsed();
+    if (c.duration > 0 && player.isPlaying())
+        waitSignal(&player, SIGNAL(stopped()), int(c.duration*1000.0));
+    r->play_ms = qreal(clock.nsecsElapsed() - t0)/1e6;
+    r->cpu_ms = qreal(processCpuTime() - cpu0)/1000.0;
+    const Statistics::Snapshot s1(player.statistics().snapshot());
+    r->counters = s1;
+    r->counters.decoded_frames = s1.decoded_frames - s0.decoded_frames;
+    r->counters.dropped_frames = s1.dropped_frames - s0.dropped_frames;
+    r->counters.rendered_frames = s1.rendered_frames - s0.rendered_frames;
+    r->counters.late_frames = s1.late_frames - s0.late_frames;
+
+    if (c.seeks > 0 && player.isPlaying() && player.isSeekable() && r->media_duration_ms > 0) {
+        for (int i = 0; i < c.seeks; ++i) {
+            // deterministic positions spread over [0, 0.9) of the media, so results of different runs are comparable
+            const qreal frac = fmod(qreal(i + 1)*0.618033988749895, 1.0)*0.9;
+            const qint64 pos = player.mediaStartPosition() + qint64(frac*qreal(r->media_duration_ms));
+            t0 = clock.nsecsElapsed();
+            player.seek(pos);
+            if (waitSignal(&renderer, SIGNAL(frameArrived()), kFrameTimeout))
+                r->seek_ms.append(qreal(renderer.arrivedTime() - t0)/1e6);
+            else
+                r->seek_timeouts++;
+            if (!player.isPlaying())
+                break;
+            waitSignal(&player, SIGNAL(stopped()), kSeekSettle);
+        }
+    }
+    player.stop();
+    r->rss_kb = currentRss();
+    r->peak_rss_kb = peakRss();
+    r->ok = true;
+    return true;
+}
+
+// a moving gradient, so that encoded frames are not trivial
+static bool createSyntheticClip(const QString& spec, const QString& file)
+{
+    // WxH@fps:seconds
+    QSize size(1280, 720);
+    qreal fps = 30;
+    qreal seconds = 10;
+    const QStringList parts(spec.split(QLatin1Char(':')));
+    const QStringList geometry(parts.first().split(QLatin1Char('@')));
+    const QStringList wh(geometry.first().split(QLatin1Char('x')));
+    if (wh.size() == 2)
+        size = QSize(wh.at(0).toInt(), wh.at(1).toInt());
+    if (geometry.size() > 1)
+        fps = geometry.at(1).toDouble();
+    if (parts.size() > 1)
+        seconds = parts.at(1).toDouble();
+    if (size.isEmpty() || fps <= 0 || seconds <= 0) {
+        qWarning("invalid synthetic clip: %s", spec.toUtf8().constData());
+        return false;
+    }
+    VideoEncoder *venc = VideoEncoder::create(QStringLiteral("FFmpeg"));
+    if (!venc)
+        return false;
+    venc->setCodecName(QStringLiteral("mpeg4"));
+    venc->setBitRate(qint64(size.width()*size.height())*fps/8); // ~0.125 bits per pixel
+    venc->setWidth(size.width());
+    venc->setHeight(size.height());
+    venc->setFrameRate(fps);
+    venc->setSourcePixelFormat(VideoFormat::Format_YUV420P);
+    if (!venc->open()) {
+        qWarning("failed to open mpeg4 encoder");
+        delete venc;
+        return false;
+    }
+    AVMuxer mux;
+    mux.setMedia(file);
+    mux.setFormat(QStringLiteral("matroska"));
+    mux.copyProperties(venc);
+    if (!mux.open()) {
+        qWarning("failed to open muxer: %s", file.toUtf8().constData());
+        delete venc;
+        return false;
+    }
+    const int frames = int(fps*seconds);
+    for (int i = 0; i < frames; ++i) {
+        VideoFrame frame(size.width(), size.height(), VideoFormat(VideoFormat::Format_YUV420P));
+        frame.allocate();
+        for (int p = 0; p < frame.planeCount(); ++p) {
+            uchar *bits = frame.bits(p);
+            for (int y = 0; y < frame.planeHeight(p); ++y) {
+                uchar *line = bits + y*frame.bytesPerLine(p);
+                for (int x = 0; x < frame.effectivePlaneWidth(p); ++x)
+                    line[x] = p == 0 ? uchar(x + y + i*4) : uchar(128 + ((x*p + i) & 31));
+            }
+        }
+        frame.setTimestamp(qreal(i)/fps);
+        if (frame.pixelFormat() != venc->pixelFormat())
+            frame = frame.to(venc->pixelFormat());
+        if (venc->encode(frame))
+            mux.writeVideo(venc->encoded());
+    }
+    while (venc->encode())
+        mux.writeVideo(venc->encoded());
+    mux.close();
+    venc->close();
+    delete venc;
+    return true;
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+// lower is better for all values. returns number of regressions
+static int compareBaseline(const QByteArray& current, const QString& baseline, qreal tolerance)
+{
+    QFile f(baseline);
+    if (!f.open(QIODevice::ReadOnly)) {
+        qWarning("Failed to open baseline file: %s", baseline.toUtf8().constData());
+        return 0;
+    }
+    const QJsonArray base(QJsonDocument::fromJson(f.readAll()).object().value(QStringLiteral("results")).toArray());
+    const QJsonArray cur(QJsonDocument::fromJson(current).object().value(QStringLiteral("results")).toArray());
+    static const char* const keys[] = {
+        "ttff_ms", "seek_ms/p50", "seek_ms/p90", "dropped_frames", "late_frames", "cpu_ms_per_frame", "peak_rss_kb"
+    };
+    int regressions = 0;
+    foreach (const QJsonValue& cv, cur) {
+        const QJsonObject c(cv.toObject());
+        QJsonObject b;
+        foreach (const QJsonValue& bv, base) {
+            if (bv.toObject().value(QStringLiteral("file")) == c.value(QStringLiteral("file"))) {
+                b = bv.toObject();
+                break;
+            }
+        }
+        if (b.isEmpty())
+            continue;
+        for (size_t i = 0; i < sizeof(keys)/sizeof(keys[0]); ++i) {
+            const QStringList path(QString::fromLatin1(keys[i]).split(QLatin1Char('/')));
+            QJsonValue x(c.value(path.first())), y(b.value(path.first()));
+            if (path.size() > 1) {
+                x = x.toObject().value(path.last());
+                y = y.toObject().value(path.last());
+            }
+            if (!x.isDouble() || !y.isDouble())
+                continue;
+            const qreal old = y.toDouble(), now = x.toDouble();
+            // small absolute changes of small values, e.g. 0 => 1 dropped frame, are noise
+            if (now <= old*(1.0 + tolerance/100.0) || now - old < 1.0)
+                continue;
+            fprintf(stderr, "regression %s %s: %.3f => %.3f\n", c.value(QStringLiteral("file")).toString().toUtf8().constData(), keys[i], old, now);
+            ++regressions;
+        }
+    }
+    return regressions;
+}
+#endif //QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    const QStringList args(a.arguments());
+    if (args.contains(QLatin1String("-h"))) {
+        printf("./playback -i file1[,file2...] [-synthetic WxH@fps:seconds[,...]] [-t seconds] [-seeks n] [-key] [-speed 1] [-vd FFmpeg,VAAPI] [-o result.json] [-baseline old.json [-tolerance percent]]\n");
+        return 0;
+    }
+    const QStringList synthetics(listArg(args, QStringLiteral("-synthetic"), QString()));
+    QStringList files(listArg(args, QStringLiteral("-i"), synthetics.isEmpty() ? QStringLiteral("test.avi") : QString()));
+    QStringList temps;
+    foreach (const QString& spec, synthetics) {
+        const QString file(QDir::temp().absoluteFilePath(QStringLiteral("qtav_playback_bench_%1.mkv").arg(temps.size())));
+        fprintf(stderr, "generating synthetic clip %s...\n", spec.toUtf8().constData());
+        if (!createSyntheticClip(spec, file))
+            continue;
+        temps.append(file);
+        files.append(file);
+    }
+    Config c;
+    foreach (const QString& name, listArg(args, QStringLiteral("-vd"), QString())) {
+        const VideoDecoderId id = VideoDecoderFactory::id(name.toStdString(), false);
+        if (id)
+            c.decoders.append(id);
+    }
+    c.duration = stringArg(args, QStringLiteral("-t"), QStringLiteral("10")).toDouble();
+    c.seeks = stringArg(args, QStringLiteral("-seeks"), QStringLiteral("10")).toInt();
+    c.key_seek = args.contains(QLatin1String("-key"));
+    c.speed = stringArg(args, QStringLiteral("-speed"), QStringLiteral("1")).toDouble();
+    const QString out(stringArg(args, QStringLiteral("-o")));
+    const QString baseline(stringArg(args, QStringLiteral("-baseline")));
+    const qreal tolerance = stringArg(args, QStringLiteral("-tolerance"), QStringLiteral("10")).toDouble();
+
+    QStringList items;
+    for (int i = 0; i < files.size(); ++i) {
+        c.file = files.at(i);
+        // synthetic clips are named by spec, so results can be compared between runs
+        const int t = temps.indexOf(c.file);
+        const QString name(t >= 0 ? QStringLiteral("synthetic:%1").arg(synthetics.at(t)) : c.file);
+        fprintf(stderr, "playing %s...\n", name.toUtf8().constData());
+        Result r;
+        runPlayback(c, &r);
+        QStringList kv;
+        kv << QStringLiteral("\"file\": %1").arg(jsonString(name))
+           << QStringLiteral("\"ok\": %1").arg(QLatin1String(r.ok ? "true" : "false"))
+           << QStringLiteral("\"duration_ms\": %1").arg(r.media_duration_ms)
+           << QStringLiteral("\"width\": %1").arg(r.width)
+           << QStringLiteral("\"height\": %1").arg(r.height)
+           << QStringLiteral("\"ttff_ms\": %1").arg(jsonNumber(r.ttff_ms))
+           << QStringLiteral("\"play_ms\": %1").arg(jsonNumber(r.play_ms))
+           << QStringLiteral("\"decoded_frames\": %1").arg(r.counters.decoded_frames)
+           << QStringLiteral("\"rendered_frames\": %1").arg(r.counters.rendered_frames)
+           << QStringLiteral("\"dropped_frames\": %1").arg(r.counters.dropped_frames)
+           << QStringLiteral("\"late_frames\": %1").arg(r.counters.late_frames)
+           << QStringLiteral("\"render_fps\": %1").arg(jsonNumber(r.play_ms > 0 ? qreal(r.counters.rendered_frames)*1000.0/r.play_ms : 0))
+           << QStringLiteral("\"cpu_ms\": %1").arg(jsonNumber(r.cpu_ms))
+           << QStringLiteral("\"cpu_percent\": %1").arg(jsonNumber(r.play_ms > 0 ? r.cpu_ms*100.0/r.play_ms : 0))
+           << QStringLiteral("\"cpu_ms_per_frame\": %1").arg(jsonNumber(r.counters.decoded_frames > 0 ? r.cpu_ms/qreal(r.counters.decoded_frames) : 0))
+           << QStringLiteral("\"seeks\": %1").arg(r.seek_ms.size())
+           << QStringLiteral("\"seek_timeouts\": %1").arg(r.seek_timeouts)
+           << QStringLiteral("\"seek_ms\": %1").arg(jsonStats(r.seek_ms))
+           << QStringLiteral("\"rss_kb\": %1").arg(r.rss_kb)
+           << QStringLiteral("\"peak_rss_kb\": %1").arg(r.peak_rss_kb);
+        items << QStringLiteral("    {\n      %1\n    }").arg(kv.join(QStringLiteral(",\n      ")));
+    }
+    foreach (const QString& file, temps) {
+        QFile::remove(file);
+    }
+    const QString json = QStringLiteral("{\n  \"version\": %1,\n  \"play_seconds\": %2,\n  \"seek_type\": %3,\n  \"speed\": %4,\n  \"results\": [\n%5\n  ]\n}\n")
+            .arg(jsonString(QtAV_Version_String())).arg(jsonNumber(c.duration))
+            .arg(jsonString(QLatin1String(c.key_seek ? "key" : "accurate"))).arg(jsonNumber(c.speed))
+            .arg(items.join(QStringLiteral(",\n")));
+    if (out.isEmpty()) {
+        printf("%s", json.toUtf8().constData());
+        fflush(stdout);
+    } else {
+        QFile f(out);
+        if (!f.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+            qWarning("Failed to open output file: %s", out.toUtf8().constData());
+            return 1;
+        }
+        f.write(json.toUtf8());
+    }
+    if (!baseline.isEmpty()) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+        if (compareBaseline(json.toUtf8(), baseline, tolerance) > 0)
+            return 2;
+#else
+        Q_UNUSED(tolerance);
+        qWarning("-baseline requires Qt5");
+#endif
+    }
+    return 0;
+}
+
+#include "main.moc"
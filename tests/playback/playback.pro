@@ -0,0 +1,10 @@
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = playback
+
+PROJECTROOT = $$PWD/../..
+include($$PROJECTROOT/src/libQtAV.pri)
+preparePaths($$OUT_PWD/../../out)
+
+SOURCES += main.cpp
+win32: LIBS += -lpsapi # GetProcessMemoryInfo
@@ -25,18 +25,35 @@
 #include <QtAVWidgets>
 #include <QFile>
 #include <QBuffer>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QScopedPointer>
+#include <ctime>
 
 using namespace QtAV;
 
+/*
+ * usage: qiodevice [-direct] [-buffer bytes] [-quit] file
+ * -direct: MediaIO direct read mode
+ * -buffer: MediaIO buffer size
+ * -quit: quit when QFile playback finished, and print wall and cpu time
+ */
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    const QStringList args(a.arguments());
+    const bool direct = args.contains(QString::fromLatin1("-direct"));
+    const bool quit = args.contains(QString::fromLatin1("-quit"));
+    int buffer_size = 0;
+    const int idx = args.indexOf(QString::fromLatin1("-buffer"));
+    if (idx > 0 && idx + 1 < args.size())
+        buffer_size = args.at(idx+1).toInt();
 
-    QFile vidfile(a.arguments().last());
+    QFile vidfile(args.last());
 
     if (!vidfile.open(QIODevice::ReadOnly))
         return 1;
 
+    QScopedPointer<MediaIO> io; // deleted after the players
     AVPlayer player[2];
     WidgetRenderer renderer[2];
     renderer[0].show();
@@ -52,9 +69,25 @@ int main(int argc, char *argv[])
     if (buf.open(QIODevice::ReadOnly)) {
         player[1].setIODevice(&buf);
     }
-    player[0].setIODevice(&vidfile);
+    if (direct || buffer_size > 0) {
+        io.reset(MediaIO::create(QString::fromLatin1("QIODevice")));
+        io->setProperty("device", QVariant::fromValue<QIODevice*>(&vidfile));
+        io->setBufferSize(buffer_size);
+        io->setDirectRead(direct);
+        player[0].setInput(io.data());
+    } else {
+        player[0].setIODevice(&vidfile);
+    }
+    if (quit)
+        QObject::connect(&player[0], SIGNAL(stopped()), &a, SLOT(quit()));
+    QElapsedTimer timer;
+    timer.start();
+    const std::clock_t cpu0 = std::clock();
     player[0].play();
     player[1].play();
 
-    return a.exec();
+    const int ret = a.exec();
+    qDebug("QFile io direct read: %d, buffer size: %d. wall time: %lldms, cpu time: %lldms", direct, buffer_size
+           , timer.elapsed(), qint64(std::clock() - cpu0)*1000LL/CLOCKS_PER_SEC);
+    return ret;
 }
@@ -3,7 +3,10 @@ TEMPLATE = subdirs
 SUBDIRS += \
     ao \
     decoder \
-    subtitle
+    microbench \
+    playback \
+    subtitle \
+    transcode
 
 !no-widgets {
   SUBDIRS += \
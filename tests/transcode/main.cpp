@@ -18,152 +18,374 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+/*
+ * Transcode throughput benchmark
+ * Every file of the corpus is transcoded with every combination of video codec, output format, encoder threads and async mode.
+ * A configuration is run twice:
+ *  - by AVTranscoder and an AVPlayer in offline mode, for end to end fps, cpu usage and peak memory.
+ *  - by a serial pipeline of the same components, for time per stage (demux, decode, filter, encode, mux). The filter stage
+ *    is the pixel format conversion for the encoder. Audio is not included.
+ * The results are written as JSON to stdout, or to a file with -o.
+ */
 #include <QCoreApplication>
-#include <QtDebug>
 #include <QtCore/QDir>
 #include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFile>
 #include <QtCore/QStringList>
 #include <QtAV>
-#include <QtAV/VideoEncoder.h>
 #include <QtAV/AVMuxer.h>
+#include <QtAV/AVTranscoder.h>
+#include <QtAV/VideoEncoder.h>
+#include <limits>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 
 using namespace QtAV;
 
-int main(int argc, char *argv[])
+// user + system time of all threads in us
+static qint64 processCpuTime()
 {
-    QCoreApplication a(argc, argv);
-    QString file = QString::fromLatin1("test.avi");
-    int idx = a.arguments().indexOf(QLatin1String("-i"));
-    if (idx > 0)
-        file = a.arguments().at(idx + 1);
-    QString decName = QString::fromLatin1("FFmpeg");
-    idx = a.arguments().indexOf(QLatin1String("-d:v"));
-    if (idx > 0)
-        decName = a.arguments().at(idx + 1);
-    QString outFile = QString::fromLatin1("/tmp/out.mp4");
-    idx = a.arguments().indexOf(QLatin1String("-o"));
-    if (idx > 0)
-        outFile = a.arguments().at(idx + 1);
-    QDir().mkpath(outFile.left(outFile.lastIndexOf(QLatin1Char('/'))+1));
-
-    QString cv = QString::fromLatin1("libx264");
-    idx = a.arguments().indexOf(QLatin1String("-c:v"));
-    if (idx > 0)
-        cv = a.arguments().at(idx + 1);
-
-    QString fmt;
-    idx = a.arguments().indexOf(QLatin1String("-f"));
-    if (idx > 0)
-        fmt = a.arguments().at(idx + 1);
-
-
-    QString opt;
-    QVariantHash decopt;
-    idx = decName.indexOf(QLatin1String(":"));
-    if (idx > 0) {
-        opt = decName.right(decName.size() - idx -1);
-        decName = decName.left(idx);
-        QStringList opts(opt.split(QString::fromLatin1(";")));
-        QVariantHash subopt;
-        foreach (QString o, opts) {
-            idx = o.indexOf(QLatin1String(":"));
-            subopt[o.left(idx)] = o.right(o.size() - idx - 1);
-        }
-        decopt[decName] = subopt;
-    }
-    qDebug() << decopt;
+#ifdef Q_OS_WIN
+    FILETIME c, e, k, u;
+    if (!GetProcessTimes(GetCurrentProcess(), &c, &e, &k, &u))
+        return 0;
+    ULARGE_INTEGER kt, ut;
+    kt.LowPart = k.dwLowDateTime;
+    kt.HighPart = k.dwHighDateTime;
+    ut.LowPart = u.dwLowDateTime;
+    ut.HighPart = u.dwHighDateTime;
+    return qint64(kt.QuadPart + ut.QuadPart)/10LL;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+    return qint64(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)*1000000LL + qint64(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+#endif
+}
 
-    VideoDecoderId cid = VideoDecoderFactory::id(decName.toStdString());
-    if (cid <= 0) {
-        qWarning("Can not find decoder: %s", decName.toUtf8().constData());
-        return 1;
-    }
-    VideoDecoder *dec = VideoDecoderFactory::create(cid);
-    if (!decopt.isEmpty())
-        dec->setOptions(decopt);
-    AVDemuxer demux;
-    demux.setMedia(file);
-    if (!demux.load()) {
-        qWarning("Failed to load file: %s", file.toUtf8().constData());
-        return 1;
+// peak resident set size of the process in KB. it never decreases, so the value of a run includes previous runs
+static qint64 peakRss()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+    return qint64(pmc.PeakWorkingSetSize)/1024LL;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+#ifdef Q_OS_MAC
+    return qint64(ru.ru_maxrss)/1024LL; // bytes
+#else
+    return qint64(ru.ru_maxrss);
+#endif
+#endif
+}
+
+static QString jsonString(const QString& s)
+{
+    QString r(s);
+    r.replace(QLatin1String("\\"), QLatin1String("\\\\"));
+    r.replace(QLatin1String("\""), QLatin1String("\\\""));
+    r.replace(QLatin1String("\n"), QLatin1String("\\n"));
+    return QStringLiteral("\"%1\"").arg(r);
+}
+
+static QString jsonNumber(qreal v)
+{
+    return QString::number(v, 'f', 3);
+}
+
+static QStringList listArg(const QStringList& args, const QString& key, const QString& def)
+{
+    const int idx = args.indexOf(key);
+    if (idx > 0 && idx + 1 < args.size())
+        return args.at(idx + 1).split(QLatin1Char(','), QString::SkipEmptyParts);
+    return def.split(QLatin1Char(','), QString::SkipEmptyParts);
+}
+
+struct Config {
+    QString file;
+    QString codec;
+    QString format;
+    int threads; // 0: auto
+    bool async;
+    qreal duration; // seconds. <= 0: whole file
+};
+
+struct Result {
+    Result() : ok(false), frames(0), wall_ms(0), cpu_ms(0), peak_rss_kb(0), stage_frames(0), stage_wall_ms(0) {
+        for (int i = 0; i < StageCount; ++i)
+            stage_ms[i] = 0;
     }
+    enum { Demux, Decode, Filter, Encode, Mux, StageCount };
+    bool ok;
+    int frames;
+    qreal wall_ms;
+    qreal cpu_ms;
+    qint64 peak_rss_kb;
+    int stage_frames;
+    qreal stage_wall_ms;
+    qreal stage_ms[StageCount];
+};
 
-    dec->setCodecContext(demux.videoCodecContext());
-    dec->open();
+class FrameCounter : public QObject
+{
+    Q_OBJECT
+public:
+    FrameCounter() : frames(0) {}
+    QAtomicInt frames;
+public Q_SLOTS:
+    void onVideoFrameEncoded() { frames.ref();}
+};
+
+static QString outputFile(const Config& c)
+{
+    return QDir::temp().absoluteFilePath(QStringLiteral("qtav_transcode_bench.%1").arg(c.format));
+}
+
+static void setEncoder(VideoEncoder *venc, const Config& c)
+{
+    venc->setCodecName(c.codec);
+    venc->setBitRate(1024*1024);
+    QVariantHash opt;
+    opt[QStringLiteral("threads")] = c.threads;
+    QVariantHash avcodec;
+    avcodec[QStringLiteral("avcodec")] = opt;
+    venc->setOptions(avcodec);
+}
+
+static bool runTranscoder(const Config& c, Result *r)
+{
+    AVPlayer player;
+    player.setFile(c.file);
+    player.setOfflineMode(true);
+    player.audio()->setBackends(QStringList() << QStringLiteral("null"));
+    AVTranscoder avt;
+    avt.setMediaSource(&player);
+    avt.setOutputMedia(outputFile(c));
+    avt.setOutputFormat(c.format);
+    if (!avt.createVideoEncoder())
+        return false;
+    setEncoder(avt.videoEncoder(), c);
+    avt.setAsync(c.async);
+    if (c.duration > 0) {
+        AVDemuxer demux;
+        demux.setMedia(c.file);
+        if (demux.load())
+            avt.setTimeRange(-std::numeric_limits<qreal>::max(), qreal(demux.startTime())/1000.0 + c.duration);
+    }
+    FrameCounter counter;
+    QObject::connect(&avt, SIGNAL(videoFrameEncoded(qreal)), &counter, SLOT(onVideoFrameEncoded()), Qt::DirectConnection);
+    QEventLoop loop;
+    QObject::connect(&avt, SIGNAL(stopped()), &loop, SLOT(quit()));
+    const qint64 cpu0 = processCpuTime();
     QElapsedTimer timer;
     timer.start();
-    int count = 0;
-    int vstream = demux.videoStream();
-    VideoEncoder *venc = VideoEncoder::create(QString::fromUtf8("FFmpeg"));
-    venc->setCodecName(cv);
-    //venc->setCodecName("png");
-    venc->setBitRate(1024*1024);
-    //venc->setPixelFormat(VideoFormat::Format_RGBA32);
+    avt.start();
+    player.play();
+    loop.exec();
+    r->wall_ms = qreal(timer.nsecsElapsed())/1e6;
+    r->cpu_ms = qreal(processCpuTime() - cpu0)/1000.0;
+    r->peak_rss_kb = peakRss();
+    r->frames = counter.frames.fetchAndAddRelaxed(0);
+    r->ok = r->frames > 0;
+    return r->ok;
+}
+
+static bool runStages(const Config& c, Result *r)
+{
+    AVDemuxer demux;
+    demux.setMedia(c.file);
+    if (!demux.load() || demux.videoStream() < 0)
+        return false;
+    VideoDecoder *dec = VideoDecoder::create(QStringLiteral("FFmpeg"));
+    if (!dec)
+        return false;
+    dec->setCodecContext(demux.videoCodecContext());
+    if (!dec->open()) {
+        delete dec;
+        return false;
+    }
+    VideoEncoder *venc = VideoEncoder::create(QStringLiteral("FFmpeg"));
+    setEncoder(venc, c);
     AVMuxer mux;
-    //mux.setMedia("/Users/wangbin/Movies/m3u8/bbb%05d.ts");
-    //mux.setMedia("/Users/wangbin/Movies/img2/bbb%05d.png");
-    mux.setMedia(outFile);
-    QVariantHash muxopt, avfopt;
-    avfopt[QString::fromLatin1("segment_time")] = 4;
-    avfopt[QString::fromLatin1("segment_list_size")] = 0;
-    avfopt[QString::fromLatin1("segment_list")] = outFile.left(outFile.lastIndexOf(QLatin1Char('/'))+1).append(QString::fromLatin1("index.m3u8"));
-    avfopt[QString::fromLatin1("segment_format")] = QString::fromLatin1("mpegts");
-    muxopt[QString::fromLatin1("avformat")] = avfopt;
-    qreal fps = 0;
-    while (!demux.atEnd()) {
-        if (!demux.readFrame())
-            continue;
-        if (demux.stream() != vstream)
-            continue;
-        const Packet pkt = demux.packet();
-        if (dec->decode(pkt)) {
-            VideoFrame frame = dec->frame(); // why is faster to call frame() for hwdec? no frame() is very slow for VDA
-            if (!frame)
+    mux.setMedia(outputFile(c));
+    mux.setFormat(c.format);
+    const int vstream = demux.videoStream();
+    const qreal stop = c.duration > 0 ? qreal(demux.startTime())/1000.0 + c.duration : std::numeric_limits<qreal>::max();
+    QElapsedTimer total, t;
+    total.start();
+    bool eof = false;
+    while (!eof) {
+        t.start();
+        Packet pkt;
+        if (!demux.readFrame()) {
+            r->stage_ms[Result::Demux] += qreal(t.nsecsElapsed())/1e6;
+            if (!demux.atEnd())
+                continue;
+            pkt = Packet::createEOF();
+            eof = true;
+        } else {
+            r->stage_ms[Result::Demux] += qreal(t.nsecsElapsed())/1e6;
+            if (demux.stream() != vstream)
                 continue;
+            pkt = demux.packet();
+            if (pkt.pts >= stop) {
+                pkt = Packet::createEOF();
+                eof = true;
+            }
+        }
+        do {
+            t.restart();
+            if (!dec->decode(pkt))
+                break;
+            VideoFrame frame(dec->frame());
+            r->stage_ms[Result::Decode] += qreal(t.nsecsElapsed())/1e6;
+            if (!frame.isValid())
+                break;
             if (!venc->isOpen()) {
                 venc->setWidth(frame.width());
                 venc->setHeight(frame.height());
+                venc->setSourcePixelFormat(frame.pixelFormat());
                 if (!venc->open()) {
-                    qWarning("failed to open encoder");
-                    return 1;
+                    qWarning("failed to open encoder %s", c.codec.toUtf8().constData());
+                    delete venc;
+                    delete dec;
+                    return false;
                 }
-            }
-            if (!mux.isOpen()) {
                 mux.copyProperties(venc);
-                mux.setOptions(muxopt);
-                if (!fmt.isEmpty())
-                    mux.setFormat(fmt);
-                //mux.setFormat("segment");
-               // mux.setFormat("image2");
                 if (!mux.open()) {
-                    qWarning("failed to open muxer");
-                    return 1;
+                    qWarning("failed to open muxer %s", c.format.toUtf8().constData());
+                    delete venc;
+                    delete dec;
+                    return false;
                 }
-                //mux.setOptions(muxopt);
             }
+            t.restart();
             if (frame.pixelFormat() != venc->pixelFormat())
                 frame = frame.to(venc->pixelFormat());
-            if (venc->encode(frame)) {
-                Packet pkt(venc->encoded());
-                mux.writeVideo(pkt);
-                count++;
-                if (count%20 == 0) {
-                    fps = qreal(count*1000)/qreal(timer.elapsed());
-                }
-                printf("decode count: %d, fps: %.2f frame size: %dx%d %d\r", count, fps, frame.width(), frame.height(), frame.data().size());fflush(0);
+            r->stage_ms[Result::Filter] += qreal(t.nsecsElapsed())/1e6;
+            t.restart();
+            const bool encoded = venc->encode(frame);
+            r->stage_ms[Result::Encode] += qreal(t.nsecsElapsed())/1e6;
+            r->stage_frames++;
+            if (encoded) {
+                t.restart();
+                mux.writeVideo(venc->encoded());
+                r->stage_ms[Result::Mux] += qreal(t.nsecsElapsed())/1e6;
             }
-        }
+        } while (eof); // drain decoder
     }
-    // get delayed frames
-    while (venc->encode()) {
-        qDebug("encode delayed frames...\r");
-        Packet pkt(venc->encoded());
+    // delayed frames
+    t.restart();
+    while (venc->isOpen() && venc->encode()) {
+        const Packet pkt(venc->encoded());
+        r->stage_ms[Result::Encode] += qreal(t.nsecsElapsed())/1e6;
+        t.restart();
         mux.writeVideo(pkt);
+        r->stage_ms[Result::Mux] += qreal(t.nsecsElapsed())/1e6;
+        t.restart();
     }
-    qint64 elapsed = timer.elapsed();
-    int msec = elapsed/1000LL+1;
-    qDebug("decoded frames: %d, time: %d, average speed: %d", count, msec, count/msec);
-    venc->close();
+    t.restart();
     mux.close();
+    r->stage_ms[Result::Mux] += qreal(t.nsecsElapsed())/1e6;
+    r->stage_wall_ms = qreal(total.nsecsElapsed())/1e6;
+    venc->close();
+    dec->close();
+    delete venc;
+    delete dec;
+    return r->stage_frames > 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    const QStringList args(a.arguments());
+    if (args.contains(QLatin1String("-h"))) {
+        printf("./transcode -i file1[,file2...] [-c:v libx264,mpeg4] [-f matroska,mp4] [-threads 0,1] [-async 0,1] [-t seconds] [-no-stages] [-o result.json]\n");
+        return 0;
+    }
+    const QStringList files(listArg(args, QStringLiteral("-i"), QStringLiteral("test.avi")));
+    const QStringList codecs(listArg(args, QStringLiteral("-c:v"), QStringLiteral("libx264,mpeg4")));
+    const QStringList formats(listArg(args, QStringLiteral("-f"), QStringLiteral("matroska,mp4")));
+    const QStringList threads(listArg(args, QStringLiteral("-threads"), QStringLiteral("0,1")));
+    const QStringList asyncs(listArg(args, QStringLiteral("-async"), QStringLiteral("0")));
+    qreal duration = 0;
+    int idx = args.indexOf(QLatin1String("-t"));
+    if (idx > 0 && idx + 1 < args.size())
+        duration = args.at(idx + 1).toDouble();
+    const bool stages = !args.contains(QLatin1String("-no-stages"));
+    QString out;
+    idx = args.indexOf(QLatin1String("-o"));
+    if (idx > 0 && idx + 1 < args.size())
+        out = args.at(idx + 1);
+
+    QStringList items;
+    foreach (const QString& file, files) {
+        foreach (const QString& codec, codecs) {
+            foreach (const QString& format, formats) {
+                foreach (const QString& th, threads) {
+                    foreach (const QString& as, asyncs) {
+                        Config c;
+                        c.file = file;
+                        c.codec = codec;
+                        c.format = format;
+                        c.threads = th.toInt();
+                        c.async = as.toInt() != 0;
+                        c.duration = duration;
+                        fprintf(stderr, "%s: %s/%s threads: %d async: %d...\n", file.toUtf8().constData(), codec.toUtf8().constData()
+                                , format.toUtf8().constData(), c.threads, c.async);
+                        Result r;
+                        runTranscoder(c, &r);
+                        if (stages)
+                            runStages(c, &r);
+                        QFile::remove(outputFile(c));
+                        QStringList kv;
+                        kv << QStringLiteral("\"file\": %1").arg(jsonString(c.file))
+                           << QStringLiteral("\"codec\": %1").arg(jsonString(c.codec))
+                           << QStringLiteral("\"format\": %1").arg(jsonString(c.format))
+                           << QStringLiteral("\"threads\": %1").arg(c.threads)
+                           << QStringLiteral("\"async\": %1").arg(QLatin1String(c.async ? "true" : "false"))
+                           << QStringLiteral("\"ok\": %1").arg(QLatin1String(r.ok ? "true" : "false"))
+                           << QStringLiteral("\"frames\": %1").arg(r.frames)
+                           << QStringLiteral("\"wall_ms\": %1").arg(jsonNumber(r.wall_ms))
+                           << QStringLiteral("\"fps\": %1").arg(jsonNumber(r.wall_ms > 0 ? qreal(r.frames)*1000.0/r.wall_ms : 0))
+                           << QStringLiteral("\"cpu_ms\": %1").arg(jsonNumber(r.cpu_ms))
+                           << QStringLiteral("\"cpu_percent\": %1").arg(jsonNumber(r.wall_ms > 0 ? r.cpu_ms*100.0/r.wall_ms : 0))
+                           << QStringLiteral("\"peak_rss_kb\": %1").arg(r.peak_rss_kb);
+                        if (stages) {
+                            kv << QStringLiteral("\"stages\": {\"frames\": %1, \"wall_ms\": %2, \"demux_ms\": %3, \"decode_ms\": %4, \"filter_ms\": %5, \"encode_ms\": %6, \"mux_ms\": %7}")
+                                  .arg(r.stage_frames).arg(jsonNumber(r.stage_wall_ms))
+                                  .arg(jsonNumber(r.stage_ms[Result::Demux])).arg(jsonNumber(r.stage_ms[Result::Decode]))
+                                  .arg(jsonNumber(r.stage_ms[Result::Filter])).arg(jsonNumber(r.stage_ms[Result::Encode]))
+                                  .arg(jsonNumber(r.stage_ms[Result::Mux]));
+                        }
+                        items << QStringLiteral("    {\n      %1\n    }").arg(kv.join(QStringLiteral(",\n      ")));
+                    }
+                }
+            }
+        }
+    }
+    const QString json = QStringLiteral("{\n  \"results\": [\n%1\n  ]\n}\n").arg(items.join(QStringLiteral(",\n")));
+    if (out.isEmpty()) {
+        printf("%s", json.toUtf8().constData());
+        fflush(stdout);
+        return 0;
+    }
+    QFile f(out);
+    if (!f.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        qWarning("Failed to open output file: %s", out.toUtf8().constData());
+        return 1;
+    }
+    f.write(json.toUtf8());
     return 0;
 }
+
+#include "main.moc"
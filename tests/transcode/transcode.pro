@@ -7,3 +7,4 @@ include($$PROJECTROOT/src/libQtAV.pri)
 preparePaths($$OUT_PWD/../../out)
 
 SOURCES += main.cpp
+win32: LIBS += -lpsapi # GetProcessMemoryInfo
@@ -0,0 +1,185 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#include "QtAVWidgets/OpenGLVideoWall.h"
+#include <algorithm> //std::sort
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtGui/QOpenGLFunctions>
+#include "QtAV/OpenGLVideo.h"
+#include "QtAV/VideoFrame.h"
+#include "QtAV/VideoRenderer.h"
+#include "QtAV/private/mkid.h"
+
+namespace QtAV {
+
+// cells are not created by VideoRendererFactory, so the id is not registered
+static const VideoRendererId VideoRendererId_OpenGLVideoWall = mkid::id32base36_6<'G', 'L', 'W', 'a', 'l', 'l'>::value;
+
+class OpenGLVideoWallTile : public VideoRenderer
+{
+public:
+    explicit OpenGLVideoWallTile(QWidget *wall)
+        : VideoRenderer()
+        , m_wall(wall)
+        , m_dirty(false)
+    {
+        setPreferredPixelFormat(VideoFormat::Format_YUV420P);
+    }
+    ~OpenGLVideoWallTile() {
+        glv.setOpenGLContext(0);
+    }
+    virtual VideoRendererId id() const Q_DECL_OVERRIDE { return VideoRendererId_OpenGLVideoWall; }
+    virtual bool isSupported(VideoFormat::PixelFormat pixfmt) const Q_DECL_OVERRIDE {
+        return OpenGLVideo::isSupported(pixfmt);
+    }
+    // called in paintGL()
+    VideoFormat::PixelFormat updateFrame() {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        if (m_dirty) {
+            glv.setCurrentFrame(m_frame);
+            m_dirty = false;
+        }
+        return m_frame.isValid() ? m_frame.pixelFormat() : VideoFormat::Format_Invalid;
+    }
+    void render() {
+        glv.render(QRectF(videoRect().translated(cell.topLeft())), realROI());
+    }
+
+    OpenGLVideo glv;
+    QRect cell;
+protected:
+    virtual bool receiveFrame(const VideoFrame& frame) Q_DECL_OVERRIDE {
+        QMutexLocker lock(&m_mutex);
+        Q_UNUSED(lock);
+        m_frame = frame;
+        m_dirty = true;
+        // update requests are merged, so all cells are repainted in one paint event
+        QMetaObject::invokeMethod(m_wall, "update", Qt::QueuedConnection);
+        return true;
+    }
+    virtual void drawFrame() Q_DECL_OVERRIDE {} // drawn by the wall
+private:
+    QWidget *m_wall;
+    bool m_dirty;
+    QMutex m_mutex;
+    VideoFrame m_frame;
+};
+
+OpenGLVideoWall::OpenGLVideoWall(QWidget *parent, Qt::WindowFlags f)
+    : QOpenGLWidget(parent, f)
+    , m_rows(0)
+    , m_cols(0)
+{
+}
+
+OpenGLVideoWall::~OpenGLVideoWall()
+{
+    setGrid(0, 0);
+}
+
+void OpenGLVideoWall::setGrid(int rows, int cols)
+{
+    // gl resources of cells must be released with the context current
+    if (context())
+        makeCurrent();
+    qDeleteAll(m_tiles);
+    m_tiles.clear();
+    m_rows = qMax(rows, 0);
+    m_cols = qMax(cols, 0);
+    for (int i = 0; i < m_rows*m_cols; ++i) {
+        OpenGLVideoWallTile *tile = new OpenGLVideoWallTile(this);
+        if (context()) // all cells share the ShaderManager of the context
+            tile->glv.setOpenGLContext(context());
+        m_tiles.append(tile);
+    }
+    if (context()) {
+        layoutCells(width(), height());
+        doneCurrent();
+    }
+    update();
+}
+
+int OpenGLVideoWall::rows() const
+{
+    return m_rows;
+}
+
+int OpenGLVideoWall::cols() const
+{
+    return m_cols;
+}
+
+VideoRenderer* OpenGLVideoWall::renderer(int row, int col) const
+{
+    if (row < 0 || row >= m_rows || col < 0 || col >= m_cols)
+        return 0;
+    return m_tiles.at(row*m_cols + col);
+}
+
+void OpenGLVideoWall::initializeGL()
+{
+    foreach (OpenGLVideoWallTile *tile, m_tiles) {
+        tile->glv.setOpenGLContext(context());
+    }
+}
+
+void OpenGLVideoWall::paintGL()
+{
+    QOpenGLFunctions *f = context()->functions();
+    f->glClearColor(0, 0, 0, 1);
+    f->glClear(GL_COLOR_BUFFER_BIT);
+    // group cells by format, then cells of the same material type use the same program successively
+    QVector<QPair<int, OpenGLVideoWallTile*> > order;
+    order.reserve(m_tiles.size());
+    foreach (OpenGLVideoWallTile *tile, m_tiles) {
+        const VideoFormat::PixelFormat pixfmt = tile->updateFrame();
+        if (pixfmt != VideoFormat::Format_Invalid)
+            order.append(qMakePair((int)pixfmt, tile));
+    }
+    std::sort(order.begin(), order.end());
+    for (int i = 0; i < order.size(); ++i) {
+        order[i].second->render();
+    }
+}
+
+void OpenGLVideoWall::resizeGL(int w, int h)
+{
+    context()->functions()->glViewport(0, 0, w, h);
+    layoutCells(w, h);
+}
+
+void OpenGLVideoWall::layoutCells(int w, int h)
+{
+    if (m_rows <= 0 || m_cols <= 0)
+        return;
+    const int cw = w/m_cols;
+    const int ch = h/m_rows;
+    for (int i = 0; i < m_tiles.size(); ++i) {
+        OpenGLVideoWallTile *tile = m_tiles[i];
+        tile->cell = QRect((i%m_cols)*cw, (i/m_cols)*ch, cw, ch);
+        tile->resizeRenderer(cw, ch);
+        tile->glv.setProjectionMatrixToRect(QRectF(0, 0, w, h));
+    }
+}
+
+} //namespace QtAV
@@ -0,0 +1,73 @@
+/******************************************************************************
+    QtAV:  Media play library based on Qt and FFmpeg
+    Copyright (C) 2015 Wang Bin <wbsecg1@gmail.com>
+
+*   This file is part of QtAV
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef QTAV_OPENGLVIDEOWALL_H
+#define QTAV_OPENGLVIDEOWALL_H
+
+#include <QtAVWidgets/global.h>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
+#include <QtWidgets/QOpenGLWidget>
+#else
+#include <QtAVWidgets/QOpenGLWidget.h>
+#endif //QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
+#include <QtCore/QVector>
+
+namespace QtAV {
+
+class VideoRenderer;
+class OpenGLVideoWallTile;
+/*!
+ * \brief The OpenGLVideoWall class
+ * Composite a grid of videos in one OpenGL widget. Each cell has a renderer() for an AVPlayer. Frames received by the cells
+ * are drawn in one paintGL() with one context, i.e. one swap for the whole wall instead of one context switch and swap for
+ * every video. Cells of the same pixel format are drawn successively, so the shader of a material type is bound once per pass
+ * and shared by all cells through the ShaderManager of the context.
+ */
+class Q_AVWIDGETS_EXPORT OpenGLVideoWall : public QOpenGLWidget
+{
+public:
+    explicit OpenGLVideoWall(QWidget* parent = 0, Qt::WindowFlags f = 0);
+    ~OpenGLVideoWall();
+    /*!
+     * \brief setGrid
+     * Create rows x cols cells. Renderers of old cells are deleted, so detach them from players first.
+     */
+    void setGrid(int rows, int cols);
+    int rows() const;
+    int cols() const;
+    /*!
+     * \brief renderer
+     * The renderer of a cell. It's owned by the wall. Use it as AVPlayer::setRenderer(). widget() is null
+     */
+    VideoRenderer* renderer(int row, int col) const;
+protected:
+    virtual void initializeGL() Q_DECL_OVERRIDE;
+    virtual void paintGL() Q_DECL_OVERRIDE;
+    virtual void resizeGL(int w, int h) Q_DECL_OVERRIDE;
+private:
+    void layoutCells(int w, int h);
+
+    int m_rows, m_cols;
+    QVector<OpenGLVideoWallTile*> m_tiles;
+};
+
+} //namespace QtAV
+#endif // QTAV_OPENGLVIDEOWALL_H
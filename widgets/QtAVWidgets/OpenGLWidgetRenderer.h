@@ -48,6 +48,8 @@ protected:
     virtual void resizeGL(int w, int h) Q_DECL_OVERRIDE;
     virtual void resizeEvent(QResizeEvent *e) Q_DECL_OVERRIDE;
     virtual void showEvent(QShowEvent *) Q_DECL_OVERRIDE;
+private:
+    void handleFrameSwapped();
 };
 typedef OpenGLWidgetRenderer VideoRendererOpenGLWidget;
 
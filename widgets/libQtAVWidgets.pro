@@ -72,8 +72,10 @@ SOURCES *= \
     $$QTAVSRC/output/video/WidgetRenderer.cpp
 
 contains(QT_CONFIG, opengl):greaterThan(QT_MAJOR_VERSION, 4) {
-  SDK_HEADERS *= QtAVWidgets/OpenGLWidgetRenderer.h
-  SOURCES *= $$QTAVSRC/output/video/OpenGLWidgetRenderer.cpp
+  SDK_HEADERS *= QtAVWidgets/OpenGLWidgetRenderer.h \
+      QtAVWidgets/OpenGLVideoWall.h
+  SOURCES *= $$QTAVSRC/output/video/OpenGLWidgetRenderer.cpp \
+      OpenGLVideoWall.cpp
   lessThan(QT_MINOR_VERSION, 4) {
     SDK_HEADERS *= QtAVWidgets/QOpenGLWidget.h
     SOURCES *= QOpenGLWidget.cpp
@@ -101,6 +103,8 @@ config_direct2d {
   DEFINES *= QTAV_HAVE_DIRECT2D=1
   !*msvc*: INCLUDEPATH += $$PROJECTROOT/contrib/d2d1headers
   SOURCES += $$QTAVSRC/output/video/Direct2DRenderer.cpp
+  # draw d3d11va decoded textures by a d2d 1.1 device context
+  config_d3d11va: DEFINES *= QTAV_HAVE_D3D11VA=1
   #LIBS += -lD2d1
 }
 config_xv {